@@ -0,0 +1,267 @@
+#!/usr/bin/env python3
+"""Performance regression harness of the modelzoo models.
+
+Runs every model of config.yaml under every setting on synthetic data and
+writes, per run, the steps/sec, the p50/p99 step time, the peak RSS and HBM
+and the top 10 op types of the step time to <output_dir>/<time>/results.json.
+With --baseline, the runs are compared to the results.json of a previous
+release and the script fails when a run slowed down beyond the tolerance.
+"""
+import argparse
+import json
+import os
+import shlex
+import shutil
+import socket
+import subprocess
+import sys
+import threading
+import time
+
+import yaml
+
+import synthetic_data
+
+CUR_PATH = os.path.dirname(os.path.realpath(__file__))
+MODELZOO_PATH = os.path.dirname(os.path.dirname(CUR_PATH))
+HBM_POLL_SECS = 0.5
+
+
+def get_arg_parser():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--config',
+                        help='full path of the config file',
+                        default=os.path.join(CUR_PATH, 'config.yaml'))
+    parser.add_argument('--output_dir',
+                        help='full path of the output directory',
+                        default=os.path.join(CUR_PATH, 'regression_result'))
+    parser.add_argument('--baseline',
+                        help='results.json of the baseline to compare with',
+                        default=None)
+    parser.add_argument('--models',
+                        help='comma separated models, all by default',
+                        default=None)
+    parser.add_argument('--settings',
+                        help='comma separated settings, all by default',
+                        default=None)
+    return parser
+
+
+def has_gpu():
+    if shutil.which('nvidia-smi') is None:
+        return False
+    return subprocess.call(['nvidia-smi', '-L'],
+                           stdout=subprocess.DEVNULL,
+                           stderr=subprocess.DEVNULL) == 0
+
+
+def free_port():
+    with socket.socket() as s:
+        s.bind(('localhost', 0))
+        return s.getsockname()[1]
+
+
+class HbmMonitor(object):
+    """Polls the peak device memory used by a process."""
+
+    def __init__(self, pid):
+        self._pid = str(pid)
+        self._done = threading.Event()
+        self.peak_mb = 0
+        self._thread = threading.Thread(target=self._poll)
+        self._thread.start()
+
+    def _poll(self):
+        while not self._done.wait(HBM_POLL_SECS):
+            try:
+                out = subprocess.check_output([
+                    'nvidia-smi', '--query-compute-apps=pid,used_memory',
+                    '--format=csv,noheader,nounits'
+                ]).decode()
+            except (OSError, subprocess.CalledProcessError):
+                continue
+            used = sum(
+                int(line.split(',')[1]) for line in out.splitlines()
+                if line.split(',')[0].strip() == self._pid)
+            self.peak_mb = max(self.peak_mb, used)
+
+    def stop(self):
+        self._done.set()
+        self._thread.join()
+
+
+def wait(proc):
+    """Waits for proc, returns its exit code and peak RSS in MB."""
+    _, status, rusage = os.wait4(proc.pid, 0)
+    if os.WIFSIGNALED(status):
+        proc.returncode = -os.WTERMSIG(status)
+    else:
+        proc.returncode = os.WEXITSTATUS(status)
+    return proc.returncode, rusage.ru_maxrss / 1024.0
+
+
+def run(config, model, setting, data_dir, run_dir):
+    model_config = config['models'][model]
+    steps = config['steps']
+    name = '%s_%s' % (model, setting)
+    result_file = os.path.join(run_dir, name + '.json')
+    checkpoint_dir = os.path.join(run_dir, name + '_checkpoint')
+    train_py = os.path.join(MODELZOO_PATH, model, 'train.py')
+    args = [
+        '--data_location', data_dir, '--steps',
+        str(steps), '--batch_size',
+        str(model_config['batch_size']), '--no_eval', '--save_steps',
+        str(steps),
+        model_config.get('checkpoint_flag', '--checkpoint'), checkpoint_dir
+    ] + shlex.split(config.get('modelArgs') or '')
+
+    env = dict(os.environ)
+    env['BENCHMARK_WARMUP_STEPS'] = str(config['warmup_steps'])
+    env['BENCHMARK_TRACE_STEPS'] = str(config['trace_steps'])
+    if setting != 'gpu':
+        env['CUDA_VISIBLE_DEVICES'] = ''
+    ps = None
+    log = open(os.path.join(run_dir, name + '.log'), 'w')
+    if setting == 'ps':
+        cluster = {
+            'ps': ['localhost:%d' % free_port()],
+            'chief': ['localhost:%d' % free_port()]
+        }
+        ps_env = dict(env)
+        ps_env['TF_CONFIG'] = json.dumps({
+            'cluster': cluster,
+            'task': {
+                'type': 'ps',
+                'index': 0
+            }
+        })
+        ps_log = open(os.path.join(run_dir, name + '_ps.log'), 'w')
+        ps = subprocess.Popen([sys.executable, train_py] + args,
+                              cwd=os.path.dirname(train_py),
+                              env=ps_env,
+                              stdout=ps_log,
+                              stderr=subprocess.STDOUT)
+        env['TF_CONFIG'] = json.dumps({
+            'cluster': cluster,
+            'task': {
+                'type': 'chief',
+                'index': 0
+            }
+        })
+
+    start = time.time()
+    proc = subprocess.Popen(
+        [sys.executable,
+         os.path.join(CUR_PATH, 'run_model.py'), result_file, train_py] +
+        args,
+        cwd=os.path.dirname(train_py),
+        env=env,
+        stdout=log,
+        stderr=subprocess.STDOUT)
+    hbm = HbmMonitor(proc.pid) if setting == 'gpu' else None
+    returncode, peak_rss_mb = wait(proc)
+    log.close()
+    result = {
+        'model': model,
+        'setting': setting,
+        'batch_size': model_config['batch_size'],
+        'steps': steps,
+        'returncode': returncode,
+        'wall_secs': time.time() - start,
+        'peak_rss_mb': peak_rss_mb,
+    }
+    if hbm:
+        hbm.stop()
+        result['peak_hbm_mb'] = hbm.peak_mb
+    if ps:
+        # The PS serves until it is killed.
+        ps.kill()
+        _, result['ps_peak_rss_mb'] = wait(ps)
+        ps_log.close()
+    if returncode == 0 and os.path.exists(result_file):
+        with open(result_file) as f:
+            result.update(json.load(f))
+        result['samples_per_sec'] = \
+            result['steps_per_sec'] * model_config['batch_size']
+    shutil.rmtree(checkpoint_dir, ignore_errors=True)
+    return result
+
+
+def compare(results, baseline, tolerance):
+    """Prints the runs against the baseline, returns the regressed ones."""
+    baseline_runs = {(r['model'], r['setting']): r
+                     for r in baseline['runs'] if 'samples_per_sec' in r}
+    regressions = []
+    print('%-20s%-8s%16s%16s%10s' %
+          ('Model', 'Setting', 'samples/sec', 'baseline', 'change'))
+    for r in results['runs']:
+        base = baseline_runs.get((r['model'], r['setting']))
+        if 'samples_per_sec' not in r or base is None:
+            continue
+        change = r['samples_per_sec'] / base['samples_per_sec'] - 1
+        print('%-20s%-8s%16.1f%16.1f%9.1f%%' %
+              (r['model'], r['setting'], r['samples_per_sec'],
+               base['samples_per_sec'], 100 * change))
+        if change < -tolerance:
+            regressions.append(r)
+    return regressions
+
+
+def main(args):
+    with open(args.config, 'r', encoding='utf-8') as f:
+        config = yaml.safe_load(f.read())
+    models = args.models.split(',') if args.models else list(
+        config['models'])
+    settings = args.settings.split(',') if args.settings else \
+        config['settings']
+    current_time = time.strftime('%Y-%m-%d-%H-%M-%S')
+    run_dir = os.path.join(args.output_dir, current_time)
+    os.makedirs(run_dir)
+    gpu = has_gpu()
+
+    results = {'time': current_time, 'host': socket.gethostname(), 'runs': []}
+    for model in models:
+        data_format = config['models'][model]['data']
+        data_dir = os.path.join(args.output_dir, 'data', data_format)
+        synthetic_data.write_dataset(data_format, data_dir,
+                                     config['synthetic_rows'],
+                                     config['synthetic_vocab_size'])
+        for setting in settings:
+            if setting == 'gpu' and not gpu:
+                print('Skipping %s on gpu, there is no GPU' % model)
+                continue
+            print('Testing %s on %s ...' % (model, setting))
+            result = run(config, model, setting, data_dir, run_dir)
+            if result['returncode'] != 0:
+                print('[ERROR] %s on %s failed, see %s_%s.log' %
+                      (model, setting, model, setting))
+            results['runs'].append(result)
+            with open(os.path.join(run_dir, 'results.json'), 'w') as f:
+                json.dump(results, f, indent=2)
+
+    print('=' * 80)
+    print('%-20s%-8s%16s%10s%10s%12s%12s' % ('Model', 'Setting', 'samples/sec',
+                                             'p50 ms', 'p99 ms', 'RSS MB',
+                                             'HBM MB'))
+    for r in results['runs']:
+        if 'samples_per_sec' not in r:
+            continue
+        print('%-20s%-8s%16.1f%10.2f%10.2f%12.0f%12s' %
+              (r['model'], r['setting'], r['samples_per_sec'],
+               r['step_time_ms']['p50'], r['step_time_ms']['p99'],
+               r['peak_rss_mb'], r.get('peak_hbm_mb', '-')))
+    print('Results are written to %s' % os.path.join(run_dir, 'results.json'))
+
+    failed = [r for r in results['runs'] if r['returncode'] != 0]
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        regressions = compare(results, baseline, config['tolerance'])
+        for r in regressions:
+            print('[REGRESSION] %s on %s' % (r['model'], r['setting']))
+        failed += regressions
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(get_arg_parser().parse_args()))
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""Runs the train.py of a modelzoo model and records its step times.
+
+Usage: python run_model.py <result.json> <train.py> [train.py args...]
+
+A hook is added to the MonitoredTrainingSession of the model. It times the
+steps after the warmup, traces a few steps to break the step time down by
+op type, and writes the results as JSON when the session ends. The warmup
+and traced steps are set by BENCHMARK_WARMUP_STEPS and
+BENCHMARK_TRACE_STEPS, and the traced steps are not timed.
+"""
+import json
+import os
+import runpy
+import sys
+import time
+
+import tensorflow as tf
+from tensorflow.core.protobuf import config_pb2
+
+TOP_OPS = 10
+
+
+def _percentile(sorted_values, p):
+    if not sorted_values:
+        return 0.0
+    index = min(int(len(sorted_values) * p / 100.0), len(sorted_values) - 1)
+    return sorted_values[index]
+
+
+def _op_type(node_stats):
+    # The timeline label reads 'name = OpType(inputs)'.
+    label = node_stats.timeline_label
+    if ' = ' in label:
+        return label.split(' = ', 1)[1].split('(', 1)[0]
+    return node_stats.node_name.split(':')[0]
+
+
+class BenchmarkHook(tf.train.SessionRunHook):
+
+    def __init__(self, result_file, warmup_steps, trace_steps):
+        self._result_file = result_file
+        self._warmup_steps = warmup_steps
+        self._trace_steps = trace_steps
+        self._step = 0
+        self._step_times = []
+        self._timed_start = None
+        self._timed_seconds = 0.0
+        self._op_micros = {}
+
+    def _tracing(self):
+        return (self._warmup_steps <= self._step <
+                self._warmup_steps + self._trace_steps)
+
+    def before_run(self, run_context):
+        self._start = time.time()
+        if self._tracing():
+            return tf.train.SessionRunArgs(
+                None,
+                options=config_pb2.RunOptions(
+                    trace_level=config_pb2.RunOptions.FULL_TRACE))
+        return None
+
+    def after_run(self, run_context, run_values):
+        end = time.time()
+        if self._tracing():
+            self._aggregate(run_values.run_metadata.step_stats)
+        elif self._step >= self._warmup_steps:
+            self._step_times.append(end - self._start)
+            self._timed_seconds += end - self._start
+        self._step += 1
+
+    def _aggregate(self, step_stats):
+        for dev_stats in step_stats.dev_stats:
+            # The GPU kernels are in the stream:all device, the other
+            # streams repeat them.
+            if '/stream:' in dev_stats.device and \
+                    not dev_stats.device.endswith('/stream:all'):
+                continue
+            suffix = ' (GPU)' if '/stream:all' in dev_stats.device else ''
+            for node_stats in dev_stats.node_stats:
+                key = _op_type(node_stats) + suffix
+                self._op_micros[key] = (self._op_micros.get(key, 0) +
+                                        node_stats.all_end_rel_micros)
+
+    def end(self, session):
+        step_times = sorted(self._step_times)
+        total_micros = float(sum(self._op_micros.values())) or 1.0
+        top_ops = sorted(self._op_micros.items(),
+                         key=lambda kv: kv[1],
+                         reverse=True)[:TOP_OPS]
+        result = {
+            'tf_version': tf.__version__,
+            'git_version': tf.version.GIT_VERSION,
+            'timed_steps': len(step_times),
+            'steps_per_sec':
+            len(step_times) / self._timed_seconds
+            if self._timed_seconds > 0 else 0.0,
+            'step_time_ms': {
+                'mean':
+                1000.0 * sum(step_times) / len(step_times)
+                if step_times else 0.0,
+                'p50': 1000.0 * _percentile(step_times, 50),
+                'p99': 1000.0 * _percentile(step_times, 99),
+            },
+            'top_ops': [{
+                'op': op,
+                'micros_per_step': micros / max(self._trace_steps, 1),
+                'fraction': micros / total_micros,
+            } for op, micros in top_ops],
+        }
+        with open(self._result_file, 'w') as f:
+            json.dump(result, f, indent=2)
+
+
+def _patch_monitored_training_session(hook):
+    create = tf.train.MonitoredTrainingSession
+
+    def create_with_hook(*args, **kwargs):
+        kwargs['hooks'] = list(kwargs.get('hooks') or []) + [hook]
+        return create(*args, **kwargs)
+
+    tf.train.MonitoredTrainingSession = create_with_hook
+    tf.compat.v1.train.MonitoredTrainingSession = create_with_hook
+
+
+if __name__ == '__main__':
+    result_file, train_py = sys.argv[1], sys.argv[2]
+    _patch_monitored_training_session(
+        BenchmarkHook(result_file,
+                      int(os.getenv('BENCHMARK_WARMUP_STEPS', '100')),
+                      int(os.getenv('BENCHMARK_TRACE_STEPS', '5'))))
+    sys.argv = [train_py] + sys.argv[3:]
+    sys.path.insert(0, os.path.dirname(os.path.abspath(train_py)))
+    runpy.run_path(train_py, run_name='__main__')
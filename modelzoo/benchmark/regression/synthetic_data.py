@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""Writes synthetic datasets in the formats read by the modelzoo models.
+
+Three formats cover the models:
+  criteo: train.csv/eval.csv, a click label, 13 integer and 26 categorical
+          columns, as read by wide_and_deep, deepfm, dlrm, dcn, dcnv2 and
+          masknet.
+  taobao: taobao_train_data/taobao_test_data, clk and buy labels and 18
+          categorical columns, '|' separating the ids of the multi-valued
+          ones, as read by dssm, bst, esmm, mmoe, ple, dbmtl and
+          simple_multitask.
+  amazon: local_train_splitByUser/local_test_splitByUser, their _neg
+          files and the uid/mid/cat vocabularies, '\x02' separating the ids
+          of the histories, as read by din and dien.
+
+The ids are Zipf distributed, like the ids of real recommendation data, and
+the files only depend on the seed.
+"""
+import argparse
+import os
+import random
+
+NUM_CRITEO_INTEGERS = 13
+NUM_CRITEO_CATEGORIES = 26
+NUM_TAOBAO_CATEGORIES = 18
+# The columns of the taobao data which hold lists of ids.
+TAOBAO_LIST_COLUMNS = (15, 16)
+MAX_HISTORY_LENGTH = 100
+
+
+class ZipfIds(object):
+    """Samples ids in [0, vocab_size) with P(id) ~ 1 / (id + 1)^exponent."""
+
+    def __init__(self, rng, vocab_size, exponent=1.1):
+        self._rng = rng
+        weights = [1.0 / (i + 1)**exponent for i in range(vocab_size)]
+        total = sum(weights)
+        self._cdf = []
+        acc = 0.0
+        for w in weights:
+            acc += w / total
+            self._cdf.append(acc)
+
+    def sample(self):
+        u = self._rng.random()
+        lo, hi = 0, len(self._cdf) - 1
+        while lo < hi:
+            mid = (lo + hi) // 2
+            if self._cdf[mid] < u:
+                lo = mid + 1
+            else:
+                hi = mid
+        return lo
+
+
+def _write_criteo(data_dir, num_rows, rng, vocab_size):
+    ids = [ZipfIds(rng, vocab_size) for _ in range(NUM_CRITEO_CATEGORIES)]
+    for name, rows in (('train.csv', num_rows), ('eval.csv', num_rows // 10)):
+        with open(os.path.join(data_dir, name), 'w') as f:
+            for _ in range(rows):
+                fields = [str(int(rng.random() < 0.25))]
+                fields += [
+                    str(rng.randrange(1000))
+                    for _ in range(NUM_CRITEO_INTEGERS)
+                ]
+                fields += ['%08x' % c.sample() for c in ids]
+                f.write(','.join(fields) + '\n')
+
+
+def _write_taobao(data_dir, num_rows, rng, vocab_size):
+    ids = [ZipfIds(rng, vocab_size) for _ in range(NUM_TAOBAO_CATEGORIES)]
+    for name, rows in (('taobao_train_data', num_rows),
+                       ('taobao_test_data', num_rows // 10)):
+        with open(os.path.join(data_dir, name), 'w') as f:
+            for _ in range(rows):
+                clk = rng.random() < 0.25
+                buy = clk and rng.random() < 0.1
+                fields = [str(int(clk)), str(int(buy))]
+                for i, c in enumerate(ids):
+                    length = rng.randint(1, 5) if i in TAOBAO_LIST_COLUMNS \
+                        else 1
+                    fields.append('|'.join(
+                        str(c.sample()) for _ in range(length)))
+                f.write(','.join(fields) + '\n')
+
+
+def _write_amazon(data_dir, num_rows, rng, vocab_size):
+    num_users = max(vocab_size // 10, 1)
+    num_categories = max(vocab_size // 100, 1)
+    items = ZipfIds(rng, vocab_size)
+    for name, size, prefix in (('uid_voc.txt', num_users, 'U'),
+                               ('mid_voc.txt', vocab_size, 'M'),
+                               ('cat_voc.txt', num_categories, 'C')):
+        with open(os.path.join(data_dir, name), 'w') as f:
+            f.write('default_%s\n' % prefix.lower())
+            for i in range(size):
+                f.write('%s%d\n' % (prefix, i))
+
+    def history(length):
+        item_ids = [items.sample() for _ in range(length)]
+        return ('\x02'.join('M%d' % i for i in item_ids),
+                '\x02'.join('C%d' % (i % num_categories) for i in item_ids))
+
+    for name, rows in (('local_train_splitByUser', num_rows),
+                       ('local_test_splitByUser', num_rows // 10)):
+        with open(os.path.join(data_dir, name), 'w') as f, \
+                open(os.path.join(data_dir, name + '_neg'), 'w') as neg:
+            for _ in range(rows):
+                item = items.sample()
+                length = rng.randint(1, MAX_HISTORY_LENGTH)
+                his_items, his_categories = history(length)
+                f.write('\t'.join([
+                    str(int(rng.random() < 0.5)),
+                    'U%d' % rng.randrange(num_users),
+                    'M%d' % item,
+                    'C%d' % (item % num_categories), his_items, his_categories
+                ]) + '\n')
+                neg.write('\t'.join(history(length)) + '\n')
+
+
+WRITERS = {
+    'criteo': _write_criteo,
+    'taobao': _write_taobao,
+    'amazon': _write_amazon,
+}
+
+
+def write_dataset(data_format, data_dir, num_rows, vocab_size=100000,
+                  seed=2023):
+    """Writes the dataset unless data_dir already holds it."""
+    done = os.path.join(data_dir, '.done')
+    if os.path.exists(done):
+        return
+    if not os.path.isdir(data_dir):
+        os.makedirs(data_dir)
+    WRITERS[data_format](data_dir, num_rows, random.Random(seed), vocab_size)
+    open(done, 'w').close()
+
+
+def get_arg_parser():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--format',
+                        help='data format',
+                        choices=sorted(WRITERS),
+                        required=True)
+    parser.add_argument('--data_dir',
+                        help='full path of the output directory',
+                        required=True)
+    parser.add_argument('--rows',
+                        help='number of training samples',
+                        type=int,
+                        default=200000)
+    parser.add_argument('--vocab_size',
+                        help='number of distinct ids of a column',
+                        type=int,
+                        default=100000)
+    parser.add_argument('--seed', help='random seed', type=int, default=2023)
+    return parser
+
+
+if __name__ == '__main__':
+    args = get_arg_parser().parse_args()
+    write_dataset(args.format, args.data_dir, args.rows, args.vocab_size,
+                  args.seed)
@@ -14,6 +14,8 @@ limitations under the License.
 #include <pwd.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
 #include <ctime>
@@ -23,7 +25,9 @@ limitations under the License.
 
 #include "aos_string.h"
 #include "oss_define.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/env.h"
@@ -31,6 +35,7 @@ limitations under the License.
 #include "tensorflow/core/platform/file_system_helper.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 namespace io {
@@ -46,6 +51,11 @@ constexpr char kOSSAccessIdKey[] = "id";
 constexpr char kOSSAccessKeyKey[] = "key";
 constexpr char kOSSHostKey[] = "host";
 constexpr char kDelim[] = "/";
+constexpr char kOSSReadAheadMBEnvKey[] = "OSS_READ_AHEAD_MB";
+constexpr char kOSSReadChunkMBEnvKey[] = "OSS_READ_CHUNK_MB";
+constexpr char kOSSReadThreadsEnvKey[] = "OSS_READ_THREADS";
+constexpr char kOSSUploadThreadsEnvKey[] = "OSS_UPLOAD_THREADS";
+constexpr char kOSSUploadBufferMBEnvKey[] = "OSS_UPLOAD_BUFFER_MB";
 
 void oss_initialize_with_throwable() {
   if (aos_http_io_initialize(NULL, 0) != AOSE_OK) {
@@ -115,6 +125,79 @@ class OSSConnection {
   oss_request_options_t* _options = NULL;
 };
 
+// Reads the ranges of the random access files in parallel.
+thread::ThreadPool* ReadThreadPool() {
+  static thread::ThreadPool* pool = [] {
+    int64 num_threads = 8;
+    TF_CHECK_OK(ReadInt64FromEnvVar(kOSSReadThreadsEnvKey, 8, &num_threads));
+    return new thread::ThreadPool(Env::Default(), "oss_read",
+                                  std::max<int64>(1, num_threads));
+  }();
+  return pool;
+}
+
+// The bytes of a ranged GET of a parallel read.
+size_t ReadChunkBytes() {
+  static size_t chunk_bytes = [] {
+    int64 chunk_mb = 8;
+    TF_CHECK_OK(ReadInt64FromEnvVar(kOSSReadChunkMBEnvKey, 8, &chunk_mb));
+    return static_cast<size_t>(std::max<int64>(1, chunk_mb)) << 20;
+  }();
+  return chunk_bytes;
+}
+
+// Reads the bytes [range_start, range_end] of 'object' into 'dst', returns
+// the number of bytes read in 'bytes_read'.
+Status ReadRangeFromOSS(const std::string& host, const std::string& access_id,
+                        const std::string& access_key,
+                        const std::string& bucket, const std::string& object,
+                        size_t range_start, size_t range_end, char* dst,
+                        size_t* bytes_read) {
+  OSSConnection conn(host, access_id, access_key);
+  aos_pool_t* _pool = conn.getPool();
+  oss_request_options_t* _options = conn.getRequestOptions();
+  aos_string_t bucket_;
+  aos_string_t object_;
+  aos_table_t* headers_;
+  aos_list_t tmp_buffer;
+  aos_table_t* resp_headers;
+
+  aos_list_init(&tmp_buffer);
+  aos_str_set(&bucket_, bucket.c_str());
+  aos_str_set(&object_, object.c_str());
+  headers_ = aos_table_make(_pool, 1);
+
+  std::string range("bytes=");
+  range.append(std::to_string(range_start))
+      .append("-")
+      .append(std::to_string(range_end));
+  apr_table_set(headers_, "Range", range.c_str());
+  VLOG(1) << "read from OSS with " << range.c_str();
+
+  aos_status_t* s =
+      oss_get_object_to_buffer(_options, &bucket_, &object_, headers_, NULL,
+                               &tmp_buffer, &resp_headers);
+  if (!aos_status_is_ok(s)) {
+    string msg;
+    oss_error_message(s, &msg);
+    VLOG(0) << "read " << object << " failed, errMsg: " << msg;
+    return errors::Internal("read failed: ", object, " errMsg: ", msg);
+  }
+
+  // copy data to the destination
+  const size_t capacity = range_end - range_start + 1;
+  aos_buf_t* content = NULL;
+  size_t pos = 0;
+  aos_list_for_each_entry(aos_buf_t, content, &tmp_buffer, node) {
+    const size_t size =
+        std::min<size_t>(aos_buf_size(content), capacity - pos);
+    std::copy(content->pos, content->pos + size, dst + pos);
+    pos += size;
+  }
+  *bytes_read = pos;
+  return Status::OK();
+}
+
 class OSSRandomAccessFile : public RandomAccessFile {
  public:
   OSSRandomAccessFile(const std::string& endPoint, const std::string& accessKey,
@@ -192,64 +275,59 @@ class OSSRandomAccessFile : public RandomAccessFile {
 
  private:
   /// A helper function to actually read the data from OSS. This function loads
-  /// buffer_ from OSS based on its current capacity.
+  /// buffer_ from OSS based on its current capacity. A range of more than one
+  /// chunk is read by parallel ranged GETs of a chunk each.
   Status LoadBufferFromOSS(size_t desired_buffer_size) const
       EXCLUSIVE_LOCKS_REQUIRED(mu_) {
     size_t range_start = buffer_start_offset_;
     size_t range_end = buffer_start_offset_ + std::min(buffer_.capacity() - 1,
                                                        desired_buffer_size - 1);
     range_end = std::min(range_end, total_file_length_ - 1);
-
-    OSSConnection conn(shost, sak, ssk);
-    aos_pool_t* _pool = conn.getPool();
-    oss_request_options_t* _options = conn.getRequestOptions();
-    aos_string_t bucket_;
-    aos_string_t object_;
-    aos_table_t* headers_;
-    aos_list_t tmp_buffer;
-    aos_table_t* resp_headers;
-
-    aos_list_init(&tmp_buffer);
-    aos_str_set(&_options->config->endpoint, shost.c_str());
-    aos_str_set(&_options->config->access_key_id, sak.c_str());
-    aos_str_set(&_options->config->access_key_secret, ssk.c_str());
-    _options->config->is_cname = 0;
-    _options->ctl = aos_http_controller_create(_options->pool, 0);
-    aos_str_set(&bucket_, sbucket.c_str());
-    aos_str_set(&object_, sobject.c_str());
-    headers_ = aos_table_make(_pool, 1);
-
-    std::string range("bytes=");
-    range.append(std::to_string(range_start))
-        .append("-")
-        .append(std::to_string(range_end));
-    apr_table_set(headers_, "Range", range.c_str());
-    VLOG(1) << "read from OSS with " << range.c_str();
-
-    aos_status_t* s =
-        oss_get_object_to_buffer(_options, &bucket_, &object_, headers_, NULL,
-                                 &tmp_buffer, &resp_headers);
-    if (aos_status_is_ok(s)) {
-      aos_buf_t* content = NULL;
-      int64_t size = 0;
-      int64_t pos = 0;
-      buffer_.clear();
-      buffer_size_ = 0;
-
-      // copy data to local buffer
-      aos_list_for_each_entry(aos_buf_t, content, &tmp_buffer, node) {
-        size = aos_buf_size(content);
-        std::copy(content->pos, content->pos + size, buffer_.begin() + pos);
-        pos += size;
-      }
-      buffer_size_ = pos;
+    const size_t length = range_end - range_start + 1;
+    buffer_.resize(length);
+    buffer_size_ = 0;
+
+    const size_t chunk_bytes = ReadChunkBytes();
+    if (length <= chunk_bytes) {
+      TF_RETURN_IF_ERROR(ReadRangeFromOSS(shost, sak, ssk, sbucket, sobject,
+                                          range_start, range_end,
+                                          buffer_.data(), &buffer_size_));
       return Status::OK();
-    } else {
-      string msg;
-      oss_error_message(s, &msg);
-      VLOG(0) << "read " << sobject << " failed, errMsg: " << msg;
-      return errors::Internal("read failed: ", sobject, " errMsg: ", msg);
     }
+
+    const size_t num_chunks = (length + chunk_bytes - 1) / chunk_bytes;
+    BlockingCounter counter(num_chunks);
+    mutex status_mu;
+    Status status;
+    std::atomic<size_t> bytes_read(0);
+    for (size_t i = 0; i < num_chunks; ++i) {
+      const size_t chunk_start = range_start + i * chunk_bytes;
+      const size_t chunk_end =
+          std::min(range_end, chunk_start + chunk_bytes - 1);
+      char* dst = buffer_.data() + i * chunk_bytes;
+      ReadThreadPool()->Schedule([&, chunk_start, chunk_end, dst]() {
+        size_t chunk_read = 0;
+        Status s = ReadRangeFromOSS(shost, sak, ssk, sbucket, sobject,
+                                    chunk_start, chunk_end, dst, &chunk_read);
+        if (s.ok() && chunk_read != chunk_end - chunk_start + 1) {
+          s = errors::Internal("read failed: ", sobject, " got ", chunk_read,
+                               " bytes from ", chunk_start, " to ", chunk_end);
+        }
+        if (s.ok()) {
+          bytes_read += chunk_read;
+        } else {
+          mutex_lock l(status_mu);
+          status.Update(s);
+        }
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+    TF_RETURN_IF_ERROR(status);
+    VLOG(1) << "read " << sobject << " from " << range_start << " to "
+            << range_end << " in " << num_chunks << " chunks";
+    buffer_size_ = bytes_read;
+    return Status::OK();
   }
 
   std::string shost;
@@ -279,6 +357,57 @@ class OSSReadOnlyMemoryRegion : public ReadOnlyMemoryRegion {
   uint64 length_;
 };
 
+// Uploads the parts of the writable files in the background.
+thread::ThreadPool* UploadThreadPool() {
+  static thread::ThreadPool* pool = [] {
+    int64 num_threads = 8;
+    TF_CHECK_OK(ReadInt64FromEnvVar(kOSSUploadThreadsEnvKey, 8, &num_threads));
+    return new thread::ThreadPool(Env::Default(), "oss_upload",
+                                  std::max<int64>(1, num_threads));
+  }();
+  return pool;
+}
+
+// Bounds the bytes of the parts being uploaded by all the writable files, so
+// a writer faster than the network blocks instead of buffering a whole
+// checkpoint in memory.
+class UploadBudget {
+ public:
+  static UploadBudget* Global() {
+    static UploadBudget* budget = [] {
+      int64 limit_mb = 1024;
+      TF_CHECK_OK(ReadInt64FromEnvVar(kOSSUploadBufferMBEnvKey, 1024,
+                                      &limit_mb));
+      return new UploadBudget(limit_mb << 20);
+    }();
+    return budget;
+  }
+
+  // Blocks until 'bytes' fit in the budget. A part bigger than the budget
+  // is let through alone.
+  void Acquire(int64 bytes) {
+    mutex_lock l(mu_);
+    while (in_flight_ > 0 && in_flight_ + bytes > limit_) {
+      cv_.wait(l);
+    }
+    in_flight_ += bytes;
+  }
+
+  void Release(int64 bytes) {
+    mutex_lock l(mu_);
+    in_flight_ -= bytes;
+    cv_.notify_all();
+  }
+
+ private:
+  explicit UploadBudget(int64 limit) : limit_(limit) {}
+
+  const int64 limit_;
+  mutex mu_;
+  condition_variable cv_;
+  int64 in_flight_ GUARDED_BY(mu_) = 0;
+};
+
 class OSSWritableFile : public WritableFile {
  public:
   OSSWritableFile(const std::string& endPoint, const std::string& accessKey,
@@ -295,7 +424,10 @@ class OSSWritableFile : public WritableFile {
     InitAprPool();
   }
 
-  ~OSSWritableFile() { ReleaseAprPool(); }
+  ~OSSWritableFile() {
+    _WaitForUploads().IgnoreError();
+    ReleaseAprPool();
+  }
 
   Status Append(StringPiece data) override {
     mutex_lock lock(mu_);
@@ -307,7 +439,7 @@ class OSSWritableFile : public WritableFile {
 
     aos_buf_t* tmp_buf = aos_create_buf(pool_, data.size() + 1);
     aos_buf_append_string(pool_, tmp_buf, data.data(), data.size());
-    aos_list_add_tail(&tmp_buf->node, &buffer_);
+    aos_list_add_tail(&tmp_buf->node, buffer_);
     return Status::OK();
   }
 
@@ -316,6 +448,7 @@ class OSSWritableFile : public WritableFile {
     TF_RETURN_IF_ERROR(_CheckClosed());
     InitAprPool();
     TF_RETURN_IF_ERROR(_FlushInternal());
+    TF_RETURN_IF_ERROR(_WaitForUploads());
     aos_table_t* complete_headers = NULL;
     aos_table_t* resp_headers = NULL;
     aos_status_t* status = NULL;
@@ -393,7 +526,8 @@ class OSSWritableFile : public WritableFile {
       aos_str_set(&object_, sobject.c_str());
 
       headers_ = aos_table_make(pool_, 1);
-      aos_list_init(&buffer_);
+      buffer_ = static_cast<aos_list_t*>(aos_palloc(pool_, sizeof(aos_list_t)));
+      aos_list_init(buffer_);
     }
   }
 
@@ -429,36 +563,68 @@ class OSSWritableFile : public WritableFile {
     return Status::OK();
   }
 
+  // Hands the buffered part over to the upload thread pool, with the apr
+  // pool holding it. Blocks while the parts being uploaded exceed the budget.
   Status _FlushInternal() {
-    aos_table_t* resp_headers = NULL;
-    aos_status_s* status = NULL;
-    aos_string_t uploadId;
-    if (CurrentBufferLength() > 0) {
-      _InitMultiUpload();
-
-      aos_str_set(&uploadId, upload_id_.c_str());
-      status =
-          oss_upload_part_from_buffer(options_, &bucket_, &object_, &uploadId,
-                                      part_number_, &buffer_, &resp_headers);
-
-      if (!aos_status_is_ok(status)) {
-        string msg;
-        oss_error_message(status, &msg);
-        VLOG(0) << "Upload multipart " << sobject << " failed, errMsg: " << msg;
-        return errors::Internal("Upload multipart failed: ", sobject,
-                                " errMsg: ", msg);
+    const int64 bytes = CurrentBufferLength();
+    if (bytes > 0) {
+      TF_RETURN_IF_ERROR(_InitMultiUpload());
+      UploadBudget::Global()->Acquire(bytes);
+      {
+        mutex_lock l(upload_mu_);
+        ++pending_parts_;
       }
 
-      VLOG(1) << " upload " << sobject << " with part" << part_number_
-              << " succ";
-      part_number_++;
-      ReleaseAprPool();
+      aos_pool_t* pool = pool_;
+      oss_request_options_t* options = options_;
+      aos_list_t* buffer = buffer_;
+      const int64_t part_number = part_number_++;
+      pool_ = NULL;
       InitAprPool();
+      UploadThreadPool()->Schedule([this, pool, options, buffer, part_number,
+                                    bytes]() {
+        aos_string_t bucket, object, upload_id;
+        aos_str_set(&bucket, sbucket.c_str());
+        aos_str_set(&object, sobject.c_str());
+        aos_str_set(&upload_id, upload_id_.c_str());
+        aos_table_t* resp_headers = NULL;
+        aos_status_s* status =
+            oss_upload_part_from_buffer(options, &bucket, &object, &upload_id,
+                                        part_number, buffer, &resp_headers);
+        Status s;
+        if (!aos_status_is_ok(status)) {
+          string msg;
+          oss_error_message(status, &msg);
+          VLOG(0) << "Upload multipart " << sobject
+                  << " failed, errMsg: " << msg;
+          s = errors::Internal("Upload multipart failed: ", sobject,
+                               " errMsg: ", msg);
+        } else {
+          VLOG(1) << " upload " << sobject << " with part" << part_number
+                  << " succ";
+        }
+        aos_pool_destroy(pool);
+        UploadBudget::Global()->Release(bytes);
+
+        mutex_lock l(upload_mu_);
+        upload_status_.Update(s);
+        --pending_parts_;
+        upload_cv_.notify_all();
+      });
     }
     return Status::OK();
   }
 
-  const size_t CurrentBufferLength() { return aos_buf_list_len(&buffer_); }
+  // Waits for the parts being uploaded, returns the first error of them.
+  Status _WaitForUploads() {
+    mutex_lock l(upload_mu_);
+    while (pending_parts_ > 0) {
+      upload_cv_.wait(l);
+    }
+    return upload_status_;
+  }
+
+  const size_t CurrentBufferLength() { return aos_buf_list_len(buffer_); }
 
   Status _CheckClosed() {
     if (is_closed_) {
@@ -480,16 +646,27 @@ class OSSWritableFile : public WritableFile {
   aos_string_t bucket_;
   aos_string_t object_;
   aos_table_t* headers_ = NULL;
-  aos_list_t buffer_;
+  aos_list_t* buffer_ = NULL;
   std::string upload_id_;
 
   bool is_closed_;
   mutex mu_;
   int64_t part_number_;
+
+  mutex upload_mu_;
+  condition_variable upload_cv_;
+  int pending_parts_ GUARDED_BY(upload_mu_) = 0;
+  Status upload_status_ GUARDED_BY(upload_mu_);
 };
 }  // namespace
 
-OSSFileSystem::OSSFileSystem() {}
+OSSFileSystem::OSSFileSystem() {
+  int64 read_ahead_mb = read_ahead_bytes_ >> 20;
+  TF_CHECK_OK(ReadInt64FromEnvVar(kOSSReadAheadMBEnvKey, read_ahead_mb,
+                                  &read_ahead_mb));
+  read_ahead_bytes_ = static_cast<size_t>(std::max<int64>(0, read_ahead_mb))
+                      << 20;
+}
 
 // Splits a oss path to endpoint bucket object and token
 // For example
@@ -116,8 +116,9 @@ class OSSFileSystem : public FileSystem {
                           std::string& access_id, std::string& access_key);
 
   // The number of bytes to read ahead for buffering purposes
-  //  in the RandomAccessFile implementation. Defaults to 5Mb.
-  const size_t read_ahead_bytes_ = 5 * 1024 * 1024;
+  //  in the RandomAccessFile implementation. Defaults to 5Mb, set by
+  //  OSS_READ_AHEAD_MB.
+  size_t read_ahead_bytes_ = 5 * 1024 * 1024;
 
   // The number of bytes for each upload part. Defaults to 64MB
   const size_t upload_part_bytes_ = 64 * 1024 * 1024;
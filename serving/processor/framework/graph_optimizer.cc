@@ -21,6 +21,10 @@ limitations under the License.
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/protobuf/meta_graph.pb.h"
 #include "tensorflow/core/graph/graph_constructor.h"
+#include "tensorflow/core/graph/tensor_id.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/util/device_name_utils.h"
 
 namespace tensorflow {
 namespace processor {
@@ -543,6 +547,16 @@ const std::string& GetDenseRestoreAllNameSuffix() {
   return suffix;
 }
 
+const std::string& GetEmbeddingServerJobName() {
+  static std::string name("ps");
+  return name;
+}
+
+const std::string& GetServingJobName() {
+  static std::string name("worker");
+  return name;
+}
+
 GraphOptimizer::GraphOptimizer(
     const std::string& signature_name,
     MetaGraphDef* mgdef,
@@ -611,6 +625,18 @@ Status SavedModelOptimizer::RunNativeTFGraphPass() {
                         option_.path, option_.size));
   }
 
+  if (option_.quantize_dense) {
+    TF_RETURN_IF_ERROR(QuantizeDenseLayers());
+  }
+
+  if (option_.xla_dense) {
+    TF_RETURN_IF_ERROR(MarkDenseSubGraphForXla());
+  }
+
+  if (option_.embedding_server_count > 0) {
+    TF_RETURN_IF_ERROR(PlaceEmbeddingsOnServers());
+  }
+
   // Add other passes here
 
   // replace the graph def in saved_model_bundle
@@ -654,6 +680,16 @@ Status SavedModelOptimizer::RunODLGraphPass() {
   s = RewriteDefaultValueOp();
   if (!s.ok()) return s;
 
+  if (option_.quantize_dense) {
+    s = QuantizeDenseLayers();
+    if (!s.ok()) return s;
+  }
+
+  if (option_.xla_dense) {
+    s = MarkDenseSubGraphForXla();
+    if (!s.ok()) return s;
+  }
+
   // replace the graph def in saved_model_bundle
   graph_.ToGraphDef(meta_graph_def_->mutable_graph_def());
 
@@ -2376,6 +2412,306 @@ Status SavedModelOptimizer::RewriteEmbeddingVariableAttr(
   return Status::OK();
 }
 
+namespace {
+
+// The weights and biases QuantizedDense quantizes once, read from a
+// variable or a constant, unlike the embeddings looked up.
+bool IsDenseParameter(const Node* node) {
+  while (node->IsIdentity()) {
+    const Node* input = nullptr;
+    if (!node->input_node(0, &input).ok()) return false;
+    node = input;
+  }
+  return node->type_string() == "Const" ||
+         node->type_string() == "VariableV2" ||
+         node->type_string() == "ReadVariableOp";
+}
+
+// The out edge of node when it is its only one.
+const Edge* GetSingleOutEdge(const Node* node) {
+  const Edge* out_edge = nullptr;
+  for (const Edge* edge : node->out_edges()) {
+    if (out_edge != nullptr) return nullptr;
+    out_edge = edge;
+  }
+  return out_edge;
+}
+
+} // namespace
+
+Status SavedModelOptimizer::QuantizeDenseLayers() {
+  std::vector<Node*> matmul_nodes;
+  for (Node* node : graph_.op_nodes()) {
+    if (node->type_string() == "MatMul") {
+      matmul_nodes.push_back(node);
+    }
+  }
+
+  int count = 0;
+  for (Node* matmul : matmul_nodes) {
+    DataType dtype;
+    bool transpose_a = false;
+    bool transpose_b = false;
+    TF_RETURN_IF_ERROR(GetNodeAttr(matmul->attrs(), "T", &dtype));
+    TF_RETURN_IF_ERROR(
+        GetNodeAttr(matmul->attrs(), "transpose_a", &transpose_a));
+    TF_RETURN_IF_ERROR(
+        GetNodeAttr(matmul->attrs(), "transpose_b", &transpose_b));
+    if (dtype != DT_FLOAT || transpose_a || transpose_b) continue;
+
+    const Edge* bias_add_edge = GetSingleOutEdge(matmul);
+    if (bias_add_edge == nullptr || bias_add_edge->dst_input() != 0 ||
+        bias_add_edge->dst()->type_string() != "BiasAdd") {
+      continue;
+    }
+    Node* bias_add = bias_add_edge->dst();
+    // The layers without an activation, the logits and the projections
+    // the outputs are sensitive to, stay in FP32.
+    const Edge* relu_edge = GetSingleOutEdge(bias_add);
+    if (relu_edge == nullptr || relu_edge->dst()->type_string() != "Relu") {
+      continue;
+    }
+    Node* relu = relu_edge->dst();
+
+    const Edge* x_edge = nullptr;
+    const Edge* w_edge = nullptr;
+    const Edge* bias_edge = nullptr;
+    TF_RETURN_IF_ERROR(matmul->input_edge(0, &x_edge));
+    TF_RETURN_IF_ERROR(matmul->input_edge(1, &w_edge));
+    TF_RETURN_IF_ERROR(bias_add->input_edge(1, &bias_edge));
+    if (!IsDenseParameter(w_edge->src()) ||
+        !IsDenseParameter(bias_edge->src())) {
+      continue;
+    }
+
+    std::vector<SrcInfo> input_info = {
+        {x_edge->src(), x_edge->src_output()},
+        {w_edge->src(), w_edge->src_output()},
+        {bias_edge->src(), bias_edge->src_output()}};
+    for (Node* node : {matmul, bias_add, relu}) {
+      for (const Edge* edge : node->in_edges()) {
+        if (edge->IsControlEdge()) {
+          input_info.push_back({edge->src(), Graph::kControlSlot});
+        }
+      }
+    }
+
+    // The QuantizedDense node takes the name of the Relu node, which
+    // the signature and the fetches refer to.
+    NodeDef dense_def;
+    dense_def.set_name(relu->name());
+    dense_def.set_op("QuantizedDense");
+    dense_def.set_device(relu->requested_device());
+    AddNodeAttr("activation", "relu", &dense_def);
+    AddNodeAttr("calibration_steps", option_.int8_calibration_steps,
+                &dense_def);
+    AddNodeAttr("max_relative_error", option_.int8_max_relative_error,
+                &dense_def);
+
+    std::vector<const Edge*> out_edges(relu->out_edges().begin(),
+                                       relu->out_edges().end());
+    std::vector<std::pair<Node*, int>> outputs;
+    for (const Edge* edge : out_edges) {
+      outputs.emplace_back(edge->dst(), edge->dst_input());
+    }
+    graph_.RemoveNode(relu);
+    graph_.RemoveNode(bias_add);
+    graph_.RemoveNode(matmul);
+
+    Status s;
+    Node* dense = graph_.AddNode(dense_def, &s);
+    TF_RETURN_IF_ERROR(s);
+    for (size_t i = 0; i < input_info.size(); ++i) {
+      const int slot = input_info[i].src_slot == Graph::kControlSlot
+                           ? Graph::kControlSlot
+                           : static_cast<int>(i);
+      graph_.AddEdge(input_info[i].src_node, input_info[i].src_slot,
+                     dense, slot);
+    }
+    for (const auto& output : outputs) {
+      const int src_slot =
+          output.second == Graph::kControlSlot ? Graph::kControlSlot : 0;
+      graph_.AddEdge(dense, src_slot, output.first, output.second);
+    }
+    ++count;
+  }
+
+  LOG(INFO) << "[SavedModelOptimizer] Rewrite " << count
+            << " dense layers into QuantizedDense.";
+  return Status::OK();
+}
+
+namespace {
+
+// The ops looking up the embeddings, from EVs, hash tables or variables.
+bool IsEmbeddingLookup(const Node* node) {
+  static const std::unordered_set<std::string> lookup_ops = {
+      "KvResourceGather", "KvResourceGatherV1", "KvLookup",
+      "LookupTableFind", "LookupTableFindV2", "ResourceGather"};
+  if (lookup_ops.count(node->type_string())) {
+    return true;
+  }
+  if (node->type_string() != "Gather" && node->type_string() != "GatherV2") {
+    return false;
+  }
+  const Node* params = nullptr;
+  if (!node->input_node(0, &params).ok()) return false;
+  while (params->IsIdentity()) {
+    if (!params->input_node(0, &params).ok()) return false;
+  }
+  return params->IsVariable() || params->type_string() == "ReadVariableOp";
+}
+
+} // namespace
+
+Status SavedModelOptimizer::MarkDenseSubGraphForXla() {
+  auto sig = meta_graph_def_->signature_def().find(signature_name_);
+  if (sig == meta_graph_def_->signature_def().end()) {
+    return tensorflow::errors::Internal(
+        "Not found the signature_def with user specified signature name.",
+        signature_name_);
+  }
+
+  std::unordered_map<std::string, Node*> nodes_by_name;
+  for (Node* node : graph_.op_nodes()) {
+    nodes_by_name[node->name()] = node;
+  }
+
+  // The nodes the outputs are computed from, besides the save, restore and
+  // update sub-graphs.
+  std::vector<bool> is_output_input(graph_.num_node_ids(), false);
+  std::vector<Node*> stack;
+  for (const auto& output : sig->second.outputs()) {
+    const TensorId id = ParseTensorName(output.second.name());
+    auto it = nodes_by_name.find(std::string(id.first));
+    if (it != nodes_by_name.end()) {
+      stack.push_back(it->second);
+    }
+  }
+  // The embedding lookups, and the nodes computing the ids they look up.
+  std::vector<bool> is_sparse(graph_.num_node_ids(), false);
+  std::vector<Node*> sparse_stack;
+  while (!stack.empty()) {
+    Node* node = stack.back();
+    stack.pop_back();
+    if (is_output_input[node->id()]) continue;
+    is_output_input[node->id()] = true;
+    if (IsEmbeddingLookup(node)) {
+      sparse_stack.push_back(node);
+    }
+    for (const Edge* edge : node->in_edges()) {
+      if (edge->src()->IsOp()) stack.push_back(edge->src());
+    }
+  }
+  while (!sparse_stack.empty()) {
+    Node* node = sparse_stack.back();
+    sparse_stack.pop_back();
+    if (is_sparse[node->id()]) continue;
+    is_sparse[node->id()] = true;
+    for (const Edge* edge : node->in_edges()) {
+      if (edge->src()->IsOp()) sparse_stack.push_back(edge->src());
+    }
+  }
+
+  // The attributes of tf.contrib.compiler.jit.experimental_jit_scope, which
+  // XLA clusters the nodes of whatever the global jit level. The nodes
+  // without XLA kernels, e.g. the combiners of the embeddings, are left out
+  // of the clusters by XLA.
+  int count = 0;
+  for (Node* node : graph_.op_nodes()) {
+    if (!is_output_input[node->id()] || is_sparse[node->id()] ||
+        node->attrs().Find("_XlaCompile") != nullptr) {
+      continue;
+    }
+    node->AddAttr("_XlaCompile", true);
+    node->AddAttr("_XlaScope", std::string("dense"));
+    ++count;
+  }
+
+  LOG(INFO) << "[SavedModelOptimizer] Mark " << count
+            << " nodes of the dense sub-graph for XLA.";
+  return Status::OK();
+}
+
+namespace {
+
+// The task of the embedding server of a partition part_i of an EV, as
+// partitioned in the checkpoint, or of an EV not partitioned.
+int EmbeddingServerTask(const std::string& var_name, int server_count) {
+  static const std::string part_prefix("/part_");
+  const size_t pos = var_name.rfind(part_prefix);
+  if (pos != std::string::npos) {
+    const size_t begin = pos + part_prefix.size();
+    const size_t end = var_name.find('/', begin);
+    int32 part = 0;
+    if (strings::safe_strto32(
+            var_name.substr(begin, end == std::string::npos ?
+                                   std::string::npos : end - begin),
+            &part) && part >= 0) {
+      return part % server_count;
+    }
+  }
+  return Hash64(var_name) % server_count;
+}
+
+} // namespace
+
+Status SavedModelOptimizer::PlaceEmbeddingsOnServers() {
+  const int server_count = option_.embedding_server_count;
+
+  // The EVs, and the ops on their handles, e.g. the lookups, imports and
+  // initializations, through the Identity of the handles.
+  std::vector<bool> is_placed(graph_.num_node_ids(), false);
+  int var_count = 0;
+  for (Node* var : graph_.op_nodes()) {
+    if (var->type_string() != "KvVarHandleOp") continue;
+    const std::string device = strings::StrCat(
+        "/job:", GetEmbeddingServerJobName(), "/replica:0/task:",
+        EmbeddingServerTask(var->name(), server_count), "/device:CPU:0");
+    std::vector<Node*> stack = {var};
+    while (!stack.empty()) {
+      Node* node = stack.back();
+      stack.pop_back();
+      if (is_placed[node->id()]) continue;
+      is_placed[node->id()] = true;
+      node->set_requested_device(device);
+      if (node != var && !node->IsIdentity()) continue;
+      for (const Edge* edge : node->out_edges()) {
+        if (!edge->IsControlEdge() && edge->dst()->IsOp() &&
+            edge->dst()->input_type(edge->dst_input()) == DT_RESOURCE) {
+          stack.push_back(edge->dst());
+        }
+      }
+    }
+    ++var_count;
+  }
+
+  // The rest of the graph runs in the processor, which the partitioning of
+  // the graph connects to each server by the _Send and _Recv of the ids and
+  // embeddings, in a single RunGraph of the server per request.
+  for (Node* node : graph_.op_nodes()) {
+    if (is_placed[node->id()]) continue;
+    DeviceNameUtils::ParsedName device;
+    if (!DeviceNameUtils::ParseFullName(node->requested_device(), &device)) {
+      return tensorflow::errors::InvalidArgument(
+          "Invalid device of node ", node->name(), ": ",
+          node->requested_device());
+    }
+    if (device.has_job) continue;
+    device.has_job = true;
+    device.job = GetServingJobName();
+    device.has_replica = true;
+    device.replica = 0;
+    device.has_task = true;
+    device.task = 0;
+    node->set_requested_device(DeviceNameUtils::ParsedNameToString(device));
+  }
+
+  LOG(INFO) << "[SavedModelOptimizer] Place " << var_count
+            << " embedding variables on " << server_count
+            << " embedding servers.";
+  return Status::OK();
+}
+
 } // namespace processor
 } // namespace tensorflow
-
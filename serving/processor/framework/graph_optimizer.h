@@ -123,6 +123,8 @@ const std::string& GetIncrCkptNodeName();
 const std::string& GetKvRestoreAllNameSuffix();
 const std::string& GetKvIncrRestoreAllNameSuffix();
 const std::string& GetDenseRestoreAllNameSuffix();
+const std::string& GetEmbeddingServerJobName();
+const std::string& GetServingJobName();
  
 struct GraphOptimizerOption {
   // Convert EV ops to HashTable ops
@@ -150,6 +152,30 @@ struct GraphOptimizerOption {
   embedding::StorageType st = embedding::StorageType::DEFAULT;
   std::string path;
   std::vector<int64> size;
+
+  // Post-training INT8 quantization of the dense layers of the towers,
+  // MatMul + BiasAdd + Relu of variable or constant weights, rewritten into
+  // QuantizedDense. Each layer calibrates in FP32 on its first
+  // int8_calibration_steps runs, the warmup requests, and then runs in INT8
+  // unless its relative error exceeds int8_max_relative_error or INT8 is
+  // not faster. The embeddings and the layers without an activation, e.g.
+  // the logits, stay in FP32.
+  bool quantize_dense = false;
+  int int8_calibration_steps = 16;
+  float int8_max_relative_error = 0.03;
+
+  // Mark the dense sub-graph, the nodes the signature outputs are computed
+  // from besides the embedding lookups and the ids they look up, for XLA to
+  // cluster and compile, while the lookups stay in TF.
+  bool xla_dense = false;
+
+  // Serve the embeddings from embedding_server_count embedding servers,
+  // the tasks of the job GetEmbeddingServerJobName(). The partition part_i
+  // of an EV, with its lookups and restores, is placed on the task
+  // i % embedding_server_count, as partitioned in the checkpoint, and an
+  // EV not partitioned on a task by the hash of its name. The rest of the
+  // graph runs in the processor, task 0 of the job GetServingJobName().
+  int embedding_server_count = 0;
 };
 
 struct SrcInfo {
@@ -267,6 +293,15 @@ class SavedModelOptimizer : public GraphOptimizer {
   Status RewriteEmbeddingVariableAttr(embedding::StorageType st, const std::string& path,
                                       const std::vector<int64>& size);
 
+  // Rewrite dense layers into QuantizedDense ops.
+  Status QuantizeDenseLayers();
+
+  // Mark the dense sub-graph for XLA compilation.
+  Status MarkDenseSubGraphForXla();
+
+  // Place the embeddings on the embedding servers.
+  Status PlaceEmbeddingsOnServers();
+
   Node* storage_pointer_node_ = nullptr;// storage placeholder node
   Node* version_node_ = nullptr; // version placeholder node
   Node* incr_ckpt_node_ = nullptr; // indicate if import incr ckpt
@@ -1784,5 +1784,194 @@ TEST(GraphOptimizerTest, ShardEmbeddingOptimizer2) {
   EXPECT_TRUE(1);
 }
 
+TEST(GraphOptimizerTest, QuantizeDenseLayers) {
+  GraphDef graph_def;
+  auto add_node = [&graph_def](const std::string& name,
+                               const std::string& op,
+                               const std::vector<std::string>& inputs) {
+    NodeDef* node = graph_def.add_node();
+    node->set_name(name);
+    node->set_op(op);
+    for (const auto& input : inputs) {
+      node->add_input(input);
+    }
+    return node;
+  };
+  AddNodeAttr("dtype", DT_FLOAT, add_node("x", "Placeholder", {}));
+  // A hidden layer of variables, and the logits.
+  for (const std::string layer : {"dense", "logits"}) {
+    for (const std::string var : {"/kernel", "/bias"}) {
+      NodeDef* var_node = add_node(layer + var, "VariableV2", {});
+      AddNodeAttr("dtype", DT_FLOAT, var_node);
+      AddNodeAttr("shape", TensorShape({}), var_node);
+      AddNodeAttr("T", DT_FLOAT,
+                  add_node(layer + var + "/read", "Identity",
+                           {layer + var}));
+    }
+  }
+  AddNodeAttr("T", DT_FLOAT,
+              add_node("dense/MatMul", "MatMul",
+                       {"x", "dense/kernel/read"}));
+  AddNodeAttr("T", DT_FLOAT,
+              add_node("dense/BiasAdd", "BiasAdd",
+                       {"dense/MatMul", "dense/bias/read"}));
+  AddNodeAttr("T", DT_FLOAT,
+              add_node("dense/Relu", "Relu", {"dense/BiasAdd"}));
+  AddNodeAttr("T", DT_FLOAT,
+              add_node("logits/MatMul", "MatMul",
+                       {"dense/Relu", "logits/kernel/read"}));
+  AddNodeAttr("T", DT_FLOAT,
+              add_node("logits/BiasAdd", "BiasAdd",
+                       {"logits/MatMul", "logits/bias/read"}));
+
+  MetaGraphDef meta_graph_def;
+  *meta_graph_def.mutable_graph_def() = graph_def;
+  GraphOptimizerOption option;
+  option.native_tf_mode = true;
+  option.quantize_dense = true;
+  option.int8_calibration_steps = 4;
+  SavedModelOptimizer opt("serving_default", &meta_graph_def, option);
+  EXPECT_TRUE(opt.Optimize().ok());
+
+  std::unordered_map<std::string, NodeDef> nodes;
+  for (const auto& node : meta_graph_def.graph_def().node()) {
+    nodes[node.name()] = node;
+  }
+  EXPECT_EQ(0, nodes.count("dense/MatMul"));
+  EXPECT_EQ(0, nodes.count("dense/BiasAdd"));
+  const NodeDef& dense = nodes["dense/Relu"];
+  EXPECT_EQ("QuantizedDense", dense.op());
+  ASSERT_EQ(3, dense.input_size());
+  EXPECT_EQ("x", dense.input(0));
+  EXPECT_EQ("dense/kernel/read", dense.input(1));
+  EXPECT_EQ("dense/bias/read", dense.input(2));
+  EXPECT_EQ(4, dense.attr().at("calibration_steps").i());
+  // The logits have no activation and stay in FP32.
+  EXPECT_EQ("MatMul", nodes["logits/MatMul"].op());
+  EXPECT_EQ("dense/Relu", nodes["logits/MatMul"].input(0));
+}
+
+TEST(GraphOptimizerTest, MarkDenseSubGraphForXla) {
+  GraphDef graph_def;
+  auto add_node = [&graph_def](const std::string& name,
+                               const std::string& op,
+                               const std::vector<std::string>& inputs) {
+    NodeDef* node = graph_def.add_node();
+    node->set_name(name);
+    node->set_op(op);
+    for (const auto& input : inputs) {
+      node->add_input(input);
+    }
+    return node;
+  };
+  AddNodeAttr("dtype", DT_INT64, add_node("ids", "Placeholder", {}));
+  for (const std::string var : {"embedding", "kernel"}) {
+    NodeDef* var_node = add_node(var, "VariableV2", {});
+    AddNodeAttr("dtype", DT_FLOAT, var_node);
+    AddNodeAttr("shape", TensorShape({}), var_node);
+    AddNodeAttr("T", DT_FLOAT, add_node(var + "/read", "Identity", {var}));
+  }
+  NodeDef* axis = add_node("axis", "Const", {});
+  AddNodeAttr("dtype", DT_INT32, axis);
+  Tensor axis_value(DT_INT32, TensorShape({}));
+  axis_value.scalar<int32>()() = 0;
+  AddNodeAttr("value", axis_value, axis);
+  NodeDef* lookup = add_node("lookup", "GatherV2",
+                             {"embedding/read", "ids", "axis"});
+  AddNodeAttr("Tparams", DT_FLOAT, lookup);
+  AddNodeAttr("Tindices", DT_INT64, lookup);
+  AddNodeAttr("Taxis", DT_INT32, lookup);
+  AddNodeAttr("T", DT_FLOAT,
+              add_node("logits", "MatMul", {"lookup", "kernel/read"}));
+
+  MetaGraphDef meta_graph_def;
+  *meta_graph_def.mutable_graph_def() = graph_def;
+  TensorInfo output;
+  output.set_name("logits:0");
+  (*(*meta_graph_def.mutable_signature_def())["serving_default"]
+        .mutable_outputs())["logits"] = output;
+  GraphOptimizerOption option;
+  option.native_tf_mode = true;
+  option.xla_dense = true;
+  SavedModelOptimizer opt("serving_default", &meta_graph_def, option);
+  EXPECT_TRUE(opt.Optimize().ok());
+
+  std::unordered_map<std::string, NodeDef> nodes;
+  for (const auto& node : meta_graph_def.graph_def().node()) {
+    nodes[node.name()] = node;
+  }
+  EXPECT_TRUE(nodes["logits"].attr().at("_XlaCompile").b());
+  EXPECT_EQ("dense", nodes["logits"].attr().at("_XlaScope").s());
+  EXPECT_TRUE(nodes["kernel/read"].attr().at("_XlaCompile").b());
+  // The lookup and its ids stay in TF.
+  for (const std::string name : {"lookup", "ids", "embedding/read"}) {
+    EXPECT_EQ(0, nodes[name].attr().count("_XlaCompile")) << name;
+  }
+}
+
+TEST(GraphOptimizerTest, PlaceEmbeddingsOnServers) {
+  GraphDef graph_def;
+  auto add_node = [&graph_def](const std::string& name,
+                               const std::string& op,
+                               const std::vector<std::string>& inputs) {
+    NodeDef* node = graph_def.add_node();
+    node->set_name(name);
+    node->set_op(op);
+    for (const auto& input : inputs) {
+      node->add_input(input);
+    }
+    return node;
+  };
+  AddNodeAttr("dtype", DT_INT64, add_node("ids", "Placeholder", {}));
+  NodeDef* default_value = add_node("default_value", "Const", {});
+  AddNodeAttr("dtype", DT_FLOAT, default_value);
+  AddNodeAttr("value", Tensor(DT_FLOAT, TensorShape({4})), default_value);
+  std::vector<std::string> lookups;
+  for (const std::string var : {"item/part_0", "item/part_1",
+                                "item/part_2", "user"}) {
+    NodeDef* var_node = add_node(var, "KvVarHandleOp", {});
+    AddNodeAttr("dtype", DT_FLOAT, var_node);
+    AddNodeAttr("Tkeys", DT_INT64, var_node);
+    AddNodeAttr("shape", TensorShape({4}), var_node);
+    AddNodeAttr("shared_name", var, var_node);
+    NodeDef* lookup = add_node(var + "/lookup", "KvResourceGather",
+                               {var, "ids", "default_value"});
+    AddNodeAttr("dtype", DT_FLOAT, lookup);
+    AddNodeAttr("Tkeys", DT_INT64, lookup);
+    lookups.push_back(var + "/lookup");
+  }
+  NodeDef* concat = add_node("concat", "AddN", lookups);
+  AddNodeAttr("N", static_cast<int>(lookups.size()), concat);
+  AddNodeAttr("T", DT_FLOAT, concat);
+
+  MetaGraphDef meta_graph_def;
+  *meta_graph_def.mutable_graph_def() = graph_def;
+  GraphOptimizerOption option;
+  option.native_tf_mode = true;
+  option.embedding_server_count = 2;
+  SavedModelOptimizer opt("serving_default", &meta_graph_def, option);
+  EXPECT_TRUE(opt.Optimize().ok());
+
+  std::unordered_map<std::string, NodeDef> nodes;
+  for (const auto& node : meta_graph_def.graph_def().node()) {
+    nodes[node.name()] = node;
+  }
+  // The partitions of the checkpoint, with their lookups, on the servers.
+  for (const std::string var : {"item/part_0", "item/part_2"}) {
+    EXPECT_EQ("/job:ps/replica:0/task:0/device:CPU:0", nodes[var].device());
+    EXPECT_EQ(nodes[var].device(), nodes[var + "/lookup"].device());
+  }
+  EXPECT_EQ("/job:ps/replica:0/task:1/device:CPU:0",
+            nodes["item/part_1"].device());
+  EXPECT_EQ(nodes["item/part_1"].device(),
+            nodes["item/part_1/lookup"].device());
+  EXPECT_EQ(0, nodes["user"].device().find("/job:ps/"));
+  EXPECT_EQ(nodes["user"].device(), nodes["user/lookup"].device());
+  // The ids and the combination of the embeddings in the processor.
+  for (const std::string name : {"ids", "default_value", "concat"}) {
+    EXPECT_EQ("/job:worker/replica:0/task:0", nodes[name].device()) << name;
+  }
+}
+
 } // namespace processor
 } // namespace tensorflow
@@ -0,0 +1,296 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "serving/processor/framework/kernels/kv_import_scheduler.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace processor {
+
+namespace {
+constexpr char kKvImportThreadsEnvKey[] = "KV_IMPORT_THREADS";
+constexpr char kKvImportBlockMBEnvKey[] = "KV_IMPORT_BLOCK_MB";
+constexpr char kKvImportMaxBlocksEnvKey[] = "KV_IMPORT_MAX_BLOCKS";
+constexpr int64 kLogIntervalMicros = 10 * 1000 * 1000;
+}  // namespace
+
+constexpr int KvImportScheduler::kMaxBlocksPerPartition;
+
+struct KvImportScheduler::ImportState {
+  std::string name;
+  size_t key_bytes;
+  size_t value_bytes;
+  int64 block_keys;
+  WriteFn write;
+  DoneCallback done;
+  int64 start_us;
+
+  // Guarded by the mu_ of the scheduler.
+  Status status;
+  int pending_streams = 0;
+  int64 num_keys = 0;
+};
+
+// A partition being imported.
+struct KvImportScheduler::Stream {
+  std::shared_ptr<ImportState> import;
+  // Released once the partition is read.
+  std::unique_ptr<Partition> partition;
+  // The keys left to read, only used by the reading thread.
+  int64 left_keys;
+
+  // Guarded by the mu_ of the scheduler.
+  bool started = false;
+  bool reading = false;
+  bool waiting = false;
+  bool exhausted = false;
+  bool finished = false;
+  // The blocks being read or written.
+  int in_flight = 0;
+};
+
+struct KvImportScheduler::Block {
+  std::unique_ptr<char[]> keys;
+  std::unique_ptr<char[]> values;
+  int64 num_keys;
+};
+
+KvImportScheduler::KvImportScheduler(int num_threads, int64 block_bytes,
+                                     int max_blocks)
+    : block_bytes_(std::max<int64>(block_bytes, 1)),
+      max_blocks_(std::max(max_blocks, 1)),
+      threads_(new thread::ThreadPool(Env::Default(), "kv_import",
+                                      std::max(num_threads, 1))),
+      free_blocks_(max_blocks_) {}
+
+KvImportScheduler::~KvImportScheduler() {
+  // Waits for the scheduled reads and writes.
+  threads_.reset();
+}
+
+KvImportScheduler* KvImportScheduler::Global() {
+  static KvImportScheduler* scheduler = []() {
+    int64 num_threads = 8;
+    int64 block_mb = 32;
+    int64 max_blocks = 16;
+    TF_CHECK_OK(ReadInt64FromEnvVar(kKvImportThreadsEnvKey, 8,
+                                    &num_threads));
+    TF_CHECK_OK(ReadInt64FromEnvVar(kKvImportBlockMBEnvKey, 32, &block_mb));
+    TF_CHECK_OK(ReadInt64FromEnvVar(kKvImportMaxBlocksEnvKey, 16,
+                                    &max_blocks));
+    return new KvImportScheduler(num_threads, block_mb << 20, max_blocks);
+  }();
+  return scheduler;
+}
+
+void KvImportScheduler::Import(
+    const std::string& name,
+    std::vector<std::unique_ptr<Partition>> partitions,
+    size_t key_bytes, size_t value_bytes, WriteFn write,
+    DoneCallback done) {
+  auto import = std::make_shared<ImportState>();
+  import->name = name;
+  import->key_bytes = key_bytes;
+  import->value_bytes = value_bytes;
+  import->block_keys = std::max<int64>(
+      block_bytes_ / std::max(key_bytes, value_bytes), 1);
+  import->write = std::move(write);
+  import->done = std::move(done);
+  import->start_us = Env::Default()->NowMicros();
+
+  std::vector<std::shared_ptr<Stream>> streams;
+  for (auto& partition : partitions) {
+    if (partition->NumKeys() <= 0) {
+      continue;
+    }
+    auto stream = std::make_shared<Stream>();
+    stream->import = import;
+    stream->left_keys = partition->NumKeys();
+    stream->partition = std::move(partition);
+    streams.emplace_back(std::move(stream));
+  }
+  if (streams.empty()) {
+    import->done(Status::OK());
+    return;
+  }
+
+  mutex_lock lock(mu_);
+  ++num_imports_;
+  import->pending_streams = streams.size();
+  for (const auto& stream : streams) {
+    MaybeReadLocked(stream);
+  }
+}
+
+void KvImportScheduler::MaybeReadLocked(
+    const std::shared_ptr<Stream>& stream) {
+  if (stream->finished || stream->exhausted || stream->reading ||
+      stream->in_flight >= kMaxBlocksPerPartition ||
+      !stream->import->status.ok()) {
+    return;
+  }
+  if (free_blocks_ == 0) {
+    if (!stream->waiting) {
+      stream->waiting = true;
+      // The partitions that have started go first, so that they finish
+      // and release their readers before the others open theirs.
+      if (stream->started) {
+        waiting_.push_front(stream);
+      } else {
+        waiting_.push_back(stream);
+      }
+    }
+    return;
+  }
+  --free_blocks_;
+  stream->reading = true;
+  stream->started = true;
+  ++stream->in_flight;
+  threads_->Schedule([this, stream]() { ReadBlock(stream); });
+}
+
+void KvImportScheduler::WakeWaitingLocked(DoneImports* done_imports) {
+  while (free_blocks_ > 0 && !waiting_.empty()) {
+    std::shared_ptr<Stream> stream = std::move(waiting_.front());
+    waiting_.pop_front();
+    stream->waiting = false;
+    MaybeReadLocked(stream);
+    // The streams of a failed import are not read again.
+    MaybeFinishLocked(stream, done_imports);
+  }
+}
+
+void KvImportScheduler::MaybeFinishLocked(
+    const std::shared_ptr<Stream>& stream, DoneImports* done_imports) {
+  const bool done_reading =
+      stream->exhausted || !stream->import->status.ok();
+  if (stream->finished || !done_reading || stream->reading ||
+      stream->in_flight > 0 || stream->waiting) {
+    return;
+  }
+  stream->finished = true;
+  stream->partition.reset();
+  if (--stream->import->pending_streams == 0) {
+    --num_imports_;
+    done_imports->emplace_back(stream->import);
+  }
+}
+
+void KvImportScheduler::FinishImports(const DoneImports& done_imports) {
+  for (const auto& import : done_imports) {
+    if (import->status.ok()) {
+      VLOG(1) << "[KvImport] Imported " << import->num_keys << " keys of "
+              << import->name << " in "
+              << (Env::Default()->NowMicros() - import->start_us) / 1000
+              << " ms";
+    }
+    import->done(import->status);
+  }
+}
+
+void KvImportScheduler::ReadBlock(const std::shared_ptr<Stream>& stream) {
+  ImportState* import = stream->import.get();
+  auto block = std::make_shared<Block>();
+  block->num_keys = std::min(stream->left_keys, import->block_keys);
+  block->keys.reset(new char[block->num_keys * import->key_bytes]);
+  block->values.reset(new char[block->num_keys * import->value_bytes]);
+  Status s = stream->partition->Read(block->num_keys, block->keys.get(),
+                                     block->values.get());
+  if (s.ok()) {
+    stream->left_keys -= block->num_keys;
+  }
+
+  DoneImports done_imports;
+  {
+    mutex_lock lock(mu_);
+    stream->reading = false;
+    if (!s.ok()) {
+      import->status.Update(s);
+      --stream->in_flight;
+      ++free_blocks_;
+      WakeWaitingLocked(&done_imports);
+    } else {
+      stream->exhausted = stream->left_keys <= 0;
+      threads_->Schedule([this, stream, block]() {
+        WriteBlock(stream, block);
+      });
+      // The next block is read while this one is written.
+      MaybeReadLocked(stream);
+    }
+    MaybeFinishLocked(stream, &done_imports);
+  }
+  FinishImports(done_imports);
+}
+
+void KvImportScheduler::WriteBlock(const std::shared_ptr<Stream>& stream,
+                                   const std::shared_ptr<Block>& block) {
+  Status s = stream->import->write(
+      block->keys.get(), block->values.get(), block->num_keys,
+      [this, stream, block](const Status& s) {
+        OnWritten(stream, block, s);
+      });
+  // The callback is not called when the write fails.
+  if (!s.ok()) {
+    OnWritten(stream, block, s);
+  }
+}
+
+void KvImportScheduler::OnWritten(const std::shared_ptr<Stream>& stream,
+                                  const std::shared_ptr<Block>& block,
+                                  const Status& s) {
+  const int64 num_keys = block->num_keys;
+  block->keys.reset();
+  block->values.reset();
+
+  ImportState* import = stream->import.get();
+  DoneImports done_imports;
+  {
+    mutex_lock lock(mu_);
+    --stream->in_flight;
+    ++free_blocks_;
+    if (s.ok()) {
+      import->num_keys += num_keys;
+      num_keys_ += num_keys;
+      num_bytes_ += num_keys * (import->key_bytes + import->value_bytes);
+    } else {
+      import->status.Update(s);
+    }
+    // The stream gets its block back before the waiting ones.
+    MaybeReadLocked(stream);
+    WakeWaitingLocked(&done_imports);
+    MaybeFinishLocked(stream, &done_imports);
+    MaybeLogProgressLocked();
+  }
+  FinishImports(done_imports);
+}
+
+void KvImportScheduler::MaybeLogProgressLocked() {
+  const int64 now_us = Env::Default()->NowMicros();
+  if (now_us - last_log_us_ < kLogIntervalMicros) {
+    return;
+  }
+  last_log_us_ = now_us;
+  LOG(INFO) << "[KvImport] " << num_imports_ << " variables importing, "
+            << waiting_.size() << " partitions waiting, imported "
+            << num_keys_ << " keys, " << (num_bytes_ >> 20) << " MB";
+}
+
+} // namespace processor
+} // namespace tensorflow
@@ -0,0 +1,127 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef SERVING_PROCESSOR_FRAMEWORK_KERNELS_KV_IMPORT_SCHEDULER_H_
+#define SERVING_PROCESSOR_FRAMEWORK_KERNELS_KV_IMPORT_SCHEDULER_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace processor {
+
+// Imports the partitions of the EmbeddingVariables of a checkpoint into the
+// feature store, the partitions of all the KvImport ops of the process at
+// the same time.
+//
+// A partition is read block by block, the next block of a partition is read
+// while the previous one is written, so that the reads from the checkpoint
+// overlap with the writes to the feature store. At most max_blocks blocks
+// of block_bytes keys and as many values are read or written at a time,
+// which bounds the memory of the imports and the load on the feature store.
+// The partitions that have started get the free blocks first, so that few
+// partitions are open at a time. The progress of the imports is logged
+// every 10 seconds.
+//
+// The global scheduler is configured by the environment variables
+// KV_IMPORT_THREADS, 8 by default, KV_IMPORT_BLOCK_MB, 32 by default, and
+// KV_IMPORT_MAX_BLOCKS, 16 by default.
+class KvImportScheduler {
+ public:
+  // A partition of an EmbeddingVariable in the checkpoint.
+  class Partition {
+   public:
+    virtual ~Partition() {}
+    virtual int64 NumKeys() const = 0;
+    // Reads the next num_keys keys and values. Called by one thread at a
+    // time.
+    virtual Status Read(int64 num_keys, char* keys, char* values) = 0;
+  };
+
+  typedef std::function<void(const Status&)> DoneCallback;
+  // Writes num_keys keys and values, calls done once they are written,
+  // unless it fails.
+  typedef std::function<Status(const char* keys, const char* values,
+                               int64 num_keys, DoneCallback done)> WriteFn;
+
+  KvImportScheduler(int num_threads, int64 block_bytes, int max_blocks);
+  ~KvImportScheduler();
+
+  static KvImportScheduler* Global();
+
+  // Imports the partitions, of key_bytes keys and value_bytes values, by
+  // write. done is called once they are all written or one of them fails.
+  void Import(const std::string& name,
+              std::vector<std::unique_ptr<Partition>> partitions,
+              size_t key_bytes, size_t value_bytes, WriteFn write,
+              DoneCallback done);
+
+  // The blocks read or written at most by a partition.
+  static constexpr int kMaxBlocksPerPartition = 2;
+
+ private:
+  struct ImportState;
+  struct Stream;
+  struct Block;
+
+  typedef std::vector<std::shared_ptr<ImportState>> DoneImports;
+
+  // Reads the next block of stream when it may, or queues it until a block
+  // is free.
+  void MaybeReadLocked(const std::shared_ptr<Stream>& stream)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Gives the free blocks to the waiting streams.
+  void WakeWaitingLocked(DoneImports* done_imports)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Adds the import of stream to done_imports when stream is its last one
+  // to finish.
+  void MaybeFinishLocked(const std::shared_ptr<Stream>& stream,
+                         DoneImports* done_imports)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void FinishImports(const DoneImports& done_imports);
+  void ReadBlock(const std::shared_ptr<Stream>& stream);
+  void WriteBlock(const std::shared_ptr<Stream>& stream,
+                  const std::shared_ptr<Block>& block);
+  void OnWritten(const std::shared_ptr<Stream>& stream,
+                 const std::shared_ptr<Block>& block, const Status& s);
+  void MaybeLogProgressLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const int64 block_bytes_;
+  const int max_blocks_;
+  std::unique_ptr<thread::ThreadPool> threads_;
+
+  mutex mu_;
+  int free_blocks_ GUARDED_BY(mu_);
+  // The streams waiting for a free block.
+  std::deque<std::shared_ptr<Stream>> waiting_ GUARDED_BY(mu_);
+  int num_imports_ GUARDED_BY(mu_) = 0;
+  int64 num_keys_ GUARDED_BY(mu_) = 0;
+  int64 num_bytes_ GUARDED_BY(mu_) = 0;
+  int64 last_log_us_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(KvImportScheduler);
+};
+
+} // namespace processor
+} // namespace tensorflow
+
+#endif // SERVING_PROCESSOR_FRAMEWORK_KERNELS_KV_IMPORT_SCHEDULER_H_
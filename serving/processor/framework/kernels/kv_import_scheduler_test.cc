@@ -0,0 +1,204 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "serving/processor/framework/kernels/kv_import_scheduler.h"
+
+#include <atomic>
+#include <cstring>
+#include <set>
+
+#include "gtest/gtest.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace processor {
+namespace {
+
+// The keys first_key..first_key + num_keys - 1, of values 2 * key.
+class FakePartition : public KvImportScheduler::Partition {
+ public:
+  FakePartition(int64 first_key, int64 num_keys, bool fail = false)
+      : next_key_(first_key), num_keys_(num_keys), fail_(fail) {}
+
+  int64 NumKeys() const override { return num_keys_; }
+
+  Status Read(int64 num_keys, char* keys, char* values) override {
+    if (fail_) {
+      return errors::DataLoss("Can not read the partition");
+    }
+    EXPECT_FALSE(reading_.exchange(true));
+    for (int64 i = 0; i < num_keys; ++i, ++next_key_) {
+      const int64 value = 2 * next_key_;
+      memcpy(keys + i * sizeof(int64), &next_key_, sizeof(int64));
+      memcpy(values + i * sizeof(int64), &value, sizeof(int64));
+    }
+    reading_ = false;
+    return Status::OK();
+  }
+
+ private:
+  int64 next_key_;
+  const int64 num_keys_;
+  const bool fail_;
+  std::atomic<bool> reading_{false};
+};
+
+// Collects the written keys, checks their values and the blocks in flight.
+class FakeStore {
+ public:
+  KvImportScheduler::WriteFn WriteFn() {
+    return [this](const char* keys, const char* values, int64 num_keys,
+                  KvImportScheduler::DoneCallback done) {
+      const int in_flight = ++in_flight_;
+      int max = max_in_flight_;
+      while (in_flight > max &&
+             !max_in_flight_.compare_exchange_weak(max, in_flight)) {
+      }
+      {
+        mutex_lock lock(mu_);
+        for (int64 i = 0; i < num_keys; ++i) {
+          int64 key, value;
+          memcpy(&key, keys + i * sizeof(int64), sizeof(int64));
+          memcpy(&value, values + i * sizeof(int64), sizeof(int64));
+          EXPECT_EQ(2 * key, value);
+          EXPECT_TRUE(keys_.insert(key).second);
+        }
+      }
+      Env::Default()->SleepForMicroseconds(100);
+      --in_flight_;
+      done(Status::OK());
+      return Status::OK();
+    };
+  }
+
+  size_t NumKeys() {
+    mutex_lock lock(mu_);
+    return keys_.size();
+  }
+
+  std::atomic<int> in_flight_{0};
+  std::atomic<int> max_in_flight_{0};
+
+ private:
+  mutex mu_;
+  std::set<int64> keys_;
+};
+
+Status RunImport(KvImportScheduler* scheduler,
+                 std::vector<std::unique_ptr<KvImportScheduler::Partition>>
+                     partitions,
+                 FakeStore* store) {
+  Notification done;
+  Status status;
+  scheduler->Import("emb", std::move(partitions), sizeof(int64),
+                    sizeof(int64), store->WriteFn(),
+                    [&done, &status](const Status& s) {
+                      status = s;
+                      done.Notify();
+                    });
+  done.WaitForNotification();
+  return status;
+}
+
+TEST(KvImportSchedulerTest, ImportsAllPartitions) {
+  // Blocks of 10 keys.
+  KvImportScheduler scheduler(4, 10 * sizeof(int64), 3);
+  FakeStore store;
+  std::vector<std::unique_ptr<KvImportScheduler::Partition>> partitions;
+  partitions.emplace_back(new FakePartition(0, 95));
+  partitions.emplace_back(new FakePartition(1000, 0));
+  partitions.emplace_back(new FakePartition(2000, 10));
+  partitions.emplace_back(new FakePartition(3000, 1));
+  EXPECT_TRUE(RunImport(&scheduler, std::move(partitions), &store).ok());
+  EXPECT_EQ(106, store.NumKeys());
+  EXPECT_LE(store.max_in_flight_, 3);
+}
+
+TEST(KvImportSchedulerTest, ConcurrentImports) {
+  KvImportScheduler scheduler(8, 16 * sizeof(int64), 4);
+  FakeStore store;
+  std::vector<std::thread> threads;
+  std::atomic<int> num_ok{0};
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([i, &scheduler, &store, &num_ok]() {
+      std::vector<std::unique_ptr<KvImportScheduler::Partition>> partitions;
+      for (int p = 0; p < 4; ++p) {
+        partitions.emplace_back(
+            new FakePartition((i * 4 + p) * 1000, 100 + p));
+      }
+      if (RunImport(&scheduler, std::move(partitions), &store).ok()) {
+        ++num_ok;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(8, num_ok);
+  EXPECT_EQ(8 * (100 + 101 + 102 + 103), store.NumKeys());
+  EXPECT_LE(store.max_in_flight_, 4);
+}
+
+TEST(KvImportSchedulerTest, EmptyImport) {
+  KvImportScheduler scheduler(2, 1024, 2);
+  FakeStore store;
+  std::vector<std::unique_ptr<KvImportScheduler::Partition>> partitions;
+  partitions.emplace_back(new FakePartition(0, 0));
+  EXPECT_TRUE(RunImport(&scheduler, std::move(partitions), &store).ok());
+  EXPECT_EQ(0, store.NumKeys());
+}
+
+TEST(KvImportSchedulerTest, ReadFailure) {
+  KvImportScheduler scheduler(4, 10 * sizeof(int64), 2);
+  FakeStore store;
+  std::vector<std::unique_ptr<KvImportScheduler::Partition>> partitions;
+  partitions.emplace_back(new FakePartition(0, 500));
+  partitions.emplace_back(new FakePartition(1000, 50, /*fail=*/true));
+  partitions.emplace_back(new FakePartition(2000, 500));
+  Status s = RunImport(&scheduler, std::move(partitions), &store);
+  EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+
+  // The scheduler still imports the others.
+  partitions.clear();
+  partitions.emplace_back(new FakePartition(5000, 30));
+  EXPECT_TRUE(RunImport(&scheduler, std::move(partitions), &store).ok());
+}
+
+TEST(KvImportSchedulerTest, WriteFailure) {
+  KvImportScheduler scheduler(4, 10 * sizeof(int64), 2);
+  std::vector<std::unique_ptr<KvImportScheduler::Partition>> partitions;
+  partitions.emplace_back(new FakePartition(0, 100));
+  partitions.emplace_back(new FakePartition(1000, 100));
+  Notification done;
+  Status status;
+  scheduler.Import(
+      "emb", std::move(partitions), sizeof(int64), sizeof(int64),
+      [](const char* keys, const char* values, int64 num_keys,
+         KvImportScheduler::DoneCallback done) {
+        return errors::Unavailable("The feature store is down");
+      },
+      [&done, &status](const Status& s) {
+        status = s;
+        done.Notify();
+      });
+  done.WaitForNotification();
+  EXPECT_TRUE(errors::IsUnavailable(status)) << status;
+}
+
+} // namespace
+} // namespace processor
+} // namespace tensorflow
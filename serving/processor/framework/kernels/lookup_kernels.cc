@@ -20,6 +20,8 @@ limitations under the License.
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 #include "serving/processor/storage/redis_feature_store.h"
+#include "serving/processor/framework/kernels/kv_import_scheduler.h"
+#include "serving/processor/framework/util/latency_stats.h"
 #include "serving/processor/storage/feature_store_mgr.h"
 
 namespace tensorflow {
@@ -104,6 +106,12 @@ class KvLookupOp : public AsyncOpKernel {
             "hashmap's value_len should same with output's dimension(1)",
             std::to_string(dim_len_), std::to_string(out->NumElements() / N)));
 
+    const int64 start_us = Env::Default()->NowMicros();
+    auto timed_done = [start_us, done]() {
+      LatencyStats::Global()->Record(LatencyStage::FEATURE_STORE,
+          Env::Default()->NowMicros() - start_us);
+      done();
+    };
     Status s = storageMgr->GetValues(
         model_version_value,
         feature_name_to_id_,
@@ -112,9 +120,9 @@ class KvLookupOp : public AsyncOpKernel {
         sizeof(TValue) * dim_len_, N,
         (const char*)default_values.data(),
         make_lookup_callback<TValue>(
-            ctx, N, *out, default_values,
-            std::move(done)));
+            ctx, N, *out, default_values, timed_done));
 
+    // The callback is not called when GetValues fails.
     if (!s.ok()) {
       ctx->SetStatus(s);
       done();
@@ -407,11 +415,10 @@ class KvImportOp : public AsyncOpKernel {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("dim_len", &dim_len_));
   }
 
-  // NOTE(jiankeng.pt):
-  // In order to prevent excessive traffic pressure on the network,
-  // here we send variable block by block(128MB).
-  // The subsequent block will be sent after the storage return OK status.
-  //
+  // The partitions are imported by the KvImportScheduler, block by block
+  // and concurrently with the other KvImport ops, under a global limit of
+  // the blocks in flight, which prevents excessive traffic pressure on the
+  // network and the storage.
   void ComputeAsync(OpKernelContext* ctx, DoneCallback done) override {
     size_t key_size = sizeof(TKey);
     size_t value_size = sizeof(TValue);
@@ -439,9 +446,11 @@ class KvImportOp : public AsyncOpKernel {
     const Tensor& t_incr_ckpt = ctx->input(4);
     const bool is_incr_ckpt = t_incr_ckpt.scalar<bool>()();
 
-    // create for read from file
-    BundleReader* reader = new BundleReader(Env::Default(), file_name_str);
-    OP_REQUIRES_OK(ctx, reader->status());
+    // create for read the shapes of the partitions, every partition is
+    // read by a reader of its own.
+    std::unique_ptr<BundleReader> reader(
+        new BundleReader(Env::Default(), file_name_str));
+    OP_REQUIRES_OK_ASYNC(ctx, reader->status(), done);
 
     std::string tensor_key = strings::StrCat(tensor_name_str, "-keys");
     std::string tensor_value = strings::StrCat(tensor_name_str, "-values");
@@ -450,70 +459,72 @@ class KvImportOp : public AsyncOpKernel {
       tensor_value = strings::StrCat(tensor_name_str, "-sparse_incr_values");
     }
 
-    bool maybe_partition_var = false;
-    int partition_num = 1;
-    int curr_part_index = 0;
-
     // 1) check variable without partition
+    std::vector<std::pair<std::string, std::string>> parts;
     TensorShape key_shape;
     Status key_status = reader->LookupTensorShape(tensor_key, &key_shape);
-    if (!key_status.ok()) {
-      // not found, check partition variable below
-      if (errors::IsNotFound(key_status)) {
-        maybe_partition_var = true;
-      } else {
-        OP_REQUIRES_OK(ctx, key_status);
-      }
+    if (key_status.ok()) {
+      parts.emplace_back(tensor_key, tensor_value);
+    } else if (!errors::IsNotFound(key_status)) {
+      OP_REQUIRES_OK_ASYNC(ctx, key_status, done);
     }
 
     // 2) check variable with partition
-    if (maybe_partition_var) {
-      tensor_key = strings::StrCat(part0_tensor_name_str, "-keys");
-      tensor_value = strings::StrCat(part0_tensor_name_str, "-values");
-      key_status = reader->LookupTensorShape(tensor_key, &key_shape);
-      OP_REQUIRES_OK(ctx, key_status);
-
-      for (int i = 1; ; ++i) {
-        std::string tmp_key = strings::StrCat(
+    if (parts.empty()) {
+      for (int i = 0; ; ++i) {
+        std::string part_key = strings::StrCat(
             part_tensor_name_str, std::to_string(i), "-keys");
-        key_status = reader->LookupTensorShape(tmp_key, &key_shape);
-        if (errors::IsNotFound(key_status)) break;
-        OP_REQUIRES_OK(ctx, key_status);
-        ++partition_num;
+        key_status = reader->LookupTensorShape(part_key, &key_shape);
+        // part_0 has to exist.
+        if (i > 0 && errors::IsNotFound(key_status)) break;
+        OP_REQUIRES_OK_ASYNC(ctx, key_status, done);
+        parts.emplace_back(part_key, strings::StrCat(
+            part_tensor_name_str, std::to_string(i), "-values"));
       }
     }
 
-    int64 total_keys_num = GetTotalKeysNum(
-        part_tensor_name_str, tensor_key, tensor_value,
-        reader, ctx, dim_len_, curr_part_index,
-        partition_num, key_size, value_size);
-    // All partitions' key num equal 0
-    if (total_keys_num < 0 ||
-        curr_part_index >= partition_num) {
-      // NOTE: total_keys_num < 0, ctx will be set error
-      //       status in GetTotalKeysNum func;
-      //       curr_part_index >= partition_num: normal case.
+    std::vector<std::unique_ptr<KvImportScheduler::Partition>> partitions;
+    for (const auto& part : parts) {
+      TensorShape value_shape;
+      OP_REQUIRES_OK_ASYNC(
+          ctx, reader->LookupTensorShape(part.first, &key_shape), done);
+      OP_REQUIRES_OK_ASYNC(
+          ctx, reader->LookupTensorShape(part.second, &value_shape), done);
+      OP_REQUIRES_ASYNC(ctx, value_shape.dim_size(1) == dim_len_,
+          errors::InvalidArgument(
+              "value_shape.dim_size(1) not equal the dim_len attr value. ",
+              value_shape.dim_size(1), " vs ", dim_len_), done);
+      if (key_shape.dim_size(0) == 0) {
+        LOG(WARNING) << "Current variable partitions' key num is 0. "
+                     << part.first << ", " << part.second;
+        continue;
+      }
+      partitions.emplace_back(new BundlePartition(
+          file_name_str, part.first, part.second, key_shape.dim_size(0),
+          key_size, value_size * dim_len_));
+    }
+    if (partitions.empty()) {
       LOG(WARNING) << "All variable partitions' key num is 0. variable name:"
                    << tensor_name_str;
       done();
       return;
     }
 
-    char* key_buffer = new char[BUFFER_SIZE];
-    char* value_buffer = new char[BUFFER_SIZE];
-
-    Status s = InternalImportValues(
-        ctx, dim_len_, key_size, value_size,
-        total_keys_num, curr_part_index,
-        partition_num, part_tensor_name_str,
-        tensor_key, tensor_value, key_buffer,
-        value_buffer, reader, feature_name_to_id_,
-        model_version_value, storageMgr, std::move(done));
-
-    if (!s.ok()) {
-      ctx->SetStatus(s);
-      done();
-    }
+    const int64 feature_name_to_id = feature_name_to_id_;
+    const size_t value_bytes = value_size * dim_len_;
+    KvImportScheduler::Global()->Import(
+        tensor_name_str, std::move(partitions), key_size, value_bytes,
+        [storageMgr, model_version_value, feature_name_to_id, key_size,
+         value_bytes](const char* keys, const char* values, int64 num_keys,
+                      KvImportScheduler::DoneCallback write_done) {
+          return storageMgr->SetValues(
+              model_version_value, feature_name_to_id, keys, values,
+              key_size, value_bytes, num_keys, std::move(write_done));
+        },
+        [ctx, done](const Status& s) {
+          ctx->SetStatus(s);
+          done();
+        });
   }
 
  private:
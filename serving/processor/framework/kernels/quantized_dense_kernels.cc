@@ -0,0 +1,402 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/cpu_isa_dispatch.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+namespace processor {
+
+namespace {
+
+// x and w are quantized to [-kInt8Max, kInt8Max] and kept widened to int16,
+// so that _mm512_madd_epi16 multiplies and adds 32 of them per instruction,
+// twice the FP32 FMAs, and their products can not overflow, unlike the
+// u8 * s8 ones of _mm512_maddubs_epi16.
+constexpr int kInt8Max = 127;
+// The rows of the quantized x and w are padded with zeros to a multiple of
+// kInt8Lanes.
+constexpr int64 kInt8Lanes = 32;
+// The output channels computed together, for a row of x to be loaded once
+// for all of them. Their weights stay in L1 for all the rows of a shard.
+constexpr int64 kChannelBlock = 4;
+
+inline float Activate(float v, bool relu) {
+  return relu && v < 0.0f ? 0.0f : v;
+}
+
+inline int16 QuantizeValue(float v, float inv_scale) {
+  const float q = std::min(std::max(v * inv_scale, -1.0f * kInt8Max),
+                           1.0f * kInt8Max);
+  return static_cast<int16>(std::lrint(q));
+}
+
+// y[r, j] = act(scales[j] * dot(qx[r], qw[j]) + bias[j]) for the rows
+// [row_begin, row_end).
+void QuantizedDenseRows(const int16* qx, const int16* qw, const float* scales,
+                        const float* bias, int64 k_pad, int64 n, bool relu,
+                        int64 row_begin, int64 row_end, float* y) {
+  for (int64 j0 = 0; j0 < n; j0 += kChannelBlock) {
+    const int64 j1 = std::min(n, j0 + kChannelBlock);
+    for (int64 r = row_begin; r < row_end; ++r) {
+      const int16* a = qx + r * k_pad;
+      for (int64 j = j0; j < j1; ++j) {
+        const int16* b = qw + j * k_pad;
+        int32 acc = 0;
+        for (int64 i = 0; i < k_pad; ++i) {
+          acc += static_cast<int32>(a[i]) * b[i];
+        }
+        y[r * n + j] = Activate(scales[j] * acc + bias[j], relu);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+#ifdef TF_CPU_ISA_AVX512
+TF_CPU_ISA_AVX512_BEGIN
+namespace {
+
+// The AVX512 variant of QuantizedDenseRows, called when the CPU supports
+// AVX512 whatever the -march of the build.
+void QuantizedDenseRowsAvx512(const int16* qx, const int16* qw,
+                              const float* scales, const float* bias,
+                              int64 k_pad, int64 n, bool relu,
+                              int64 row_begin, int64 row_end, float* y) {
+  for (int64 j0 = 0; j0 < n; j0 += kChannelBlock) {
+    const int64 j1 = std::min(n, j0 + kChannelBlock);
+    for (int64 r = row_begin; r < row_end; ++r) {
+      const int16* a = qx + r * k_pad;
+      if (j1 - j0 == kChannelBlock) {
+        const int16* b = qw + j0 * k_pad;
+        __m512i acc0 = _mm512_setzero_si512();
+        __m512i acc1 = _mm512_setzero_si512();
+        __m512i acc2 = _mm512_setzero_si512();
+        __m512i acc3 = _mm512_setzero_si512();
+        for (int64 i = 0; i < k_pad; i += kInt8Lanes) {
+          const __m512i va = _mm512_loadu_si512(a + i);
+          acc0 = _mm512_add_epi32(
+              acc0, _mm512_madd_epi16(va, _mm512_loadu_si512(b + i)));
+          acc1 = _mm512_add_epi32(
+              acc1,
+              _mm512_madd_epi16(va, _mm512_loadu_si512(b + k_pad + i)));
+          acc2 = _mm512_add_epi32(
+              acc2,
+              _mm512_madd_epi16(va, _mm512_loadu_si512(b + 2 * k_pad + i)));
+          acc3 = _mm512_add_epi32(
+              acc3,
+              _mm512_madd_epi16(va, _mm512_loadu_si512(b + 3 * k_pad + i)));
+        }
+        float* out = y + r * n + j0;
+        out[0] = Activate(
+            scales[j0] * _mm512_reduce_add_epi32(acc0) + bias[j0], relu);
+        out[1] = Activate(
+            scales[j0 + 1] * _mm512_reduce_add_epi32(acc1) + bias[j0 + 1],
+            relu);
+        out[2] = Activate(
+            scales[j0 + 2] * _mm512_reduce_add_epi32(acc2) + bias[j0 + 2],
+            relu);
+        out[3] = Activate(
+            scales[j0 + 3] * _mm512_reduce_add_epi32(acc3) + bias[j0 + 3],
+            relu);
+        continue;
+      }
+      for (int64 j = j0; j < j1; ++j) {
+        const int16* b = qw + j * k_pad;
+        __m512i acc = _mm512_setzero_si512();
+        for (int64 i = 0; i < k_pad; i += kInt8Lanes) {
+          acc = _mm512_add_epi32(
+              acc, _mm512_madd_epi16(_mm512_loadu_si512(a + i),
+                                     _mm512_loadu_si512(b + i)));
+        }
+        y[r * n + j] = Activate(
+            scales[j] * _mm512_reduce_add_epi32(acc) + bias[j], relu);
+      }
+    }
+  }
+}
+
+}  // namespace
+TF_CPU_ISA_END
+#endif  // TF_CPU_ISA_AVX512
+
+class QuantizedDenseOp : public OpKernel {
+ public:
+  explicit QuantizedDenseOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    std::string activation;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("activation", &activation));
+    relu_ = activation == "relu";
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("calibration_steps",
+                                     &calibration_steps_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("max_relative_error",
+                                     &max_relative_error_));
+#ifdef TF_CPU_ISA_AVX512
+    use_avx512_ = CpuIsaSupported(CpuIsa::kAvx512);
+#endif  // TF_CPU_ISA_AVX512
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& x = ctx->input(0);
+    const Tensor& w = ctx->input(1);
+    const Tensor& bias = ctx->input(2);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsMatrix(x.shape()),
+                errors::InvalidArgument("x must be a matrix, got ",
+                                        x.shape().DebugString()));
+    OP_REQUIRES(ctx, TensorShapeUtils::IsMatrix(w.shape()),
+                errors::InvalidArgument("w must be a matrix, got ",
+                                        w.shape().DebugString()));
+    OP_REQUIRES(ctx, TensorShapeUtils::IsVector(bias.shape()),
+                errors::InvalidArgument("bias must be a vector, got ",
+                                        bias.shape().DebugString()));
+    OP_REQUIRES(ctx, x.dim_size(1) == w.dim_size(0),
+                errors::InvalidArgument(
+                    "The inner dimensions of x ", x.shape().DebugString(),
+                    " and w ", w.shape().DebugString(), " differ"));
+    OP_REQUIRES(ctx, bias.dim_size(0) == w.dim_size(1),
+                errors::InvalidArgument(
+                    "bias ", bias.shape().DebugString(),
+                    " does not match the output channels of w ",
+                    w.shape().DebugString()));
+
+    Tensor* y = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(
+        0, TensorShape({x.dim_size(0), w.dim_size(1)}), &y));
+    if (y->NumElements() == 0) {
+      return;
+    }
+
+    {
+      tf_shared_lock l(mu_);
+      if (mode_ != Mode::kCalibrating && IsQuantized(w)) {
+        if (mode_ == Mode::kInt8) {
+          ComputeInt8(ctx, x, bias, y);
+        } else {
+          ComputeFloat(ctx, x, w, bias, y);
+        }
+        return;
+      }
+    }
+
+    // The weights are quantized once per session, which restores them before
+    // it serves, and again when a variable is assigned a new tensor.
+    mutex_lock l(mu_);
+    if (!IsQuantized(w)) {
+      QuantizeWeights(w);
+    }
+    switch (mode_) {
+      case Mode::kInt8:
+        ComputeInt8(ctx, x, bias, y);
+        break;
+      case Mode::kFloat:
+        ComputeFloat(ctx, x, w, bias, y);
+        break;
+      case Mode::kCalibrating:
+        Calibrate(ctx, x, w, bias, y);
+        break;
+    }
+  }
+
+ private:
+  enum class Mode { kCalibrating, kInt8, kFloat };
+
+  bool IsQuantized(const Tensor& w) const SHARED_LOCKS_REQUIRED(mu_) {
+    return weights_ == w.tensor_data().data() && k_ == w.dim_size(0) &&
+           n_ == w.dim_size(1);
+  }
+
+  // Quantizes w per output channel, symmetric, into qweights_ transposed.
+  void QuantizeWeights(const Tensor& w) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    k_ = w.dim_size(0);
+    n_ = w.dim_size(1);
+    k_pad_ = (k_ + kInt8Lanes - 1) / kInt8Lanes * kInt8Lanes;
+    weights_ = w.tensor_data().data();
+    const float* src = w.flat<float>().data();
+    weight_scales_.assign(n_, 1.0f);
+    qweights_.assign(n_ * k_pad_, 0);
+    for (int64 j = 0; j < n_; ++j) {
+      float absmax = 0.0f;
+      for (int64 i = 0; i < k_; ++i) {
+        absmax = std::max(absmax, std::abs(src[i * n_ + j]));
+      }
+      if (absmax > 0.0f) {
+        weight_scales_[j] = absmax / kInt8Max;
+      }
+      const float inv_scale = 1.0f / weight_scales_[j];
+      int16* dst = qweights_.data() + j * k_pad_;
+      for (int64 i = 0; i < k_; ++i) {
+        dst[i] = QuantizeValue(src[i * n_ + j], inv_scale);
+      }
+    }
+  }
+
+  void ComputeFloat(OpKernelContext* ctx, const Tensor& x, const Tensor& w,
+                    const Tensor& bias, Tensor* y) {
+    const Eigen::ThreadPoolDevice& d = ctx->eigen_cpu_device();
+    const Eigen::Index m = x.dim_size(0);
+    const Eigen::Index n = w.dim_size(1);
+    auto out = y->matrix<float>();
+    if (x.dim_size(1) == 0) {
+      out.device(d) = out.constant(0.0f);
+    } else {
+      const Eigen::array<Eigen::IndexPair<Eigen::Index>, 1> dims = {
+          Eigen::IndexPair<Eigen::Index>(1, 0)};
+      out.device(d) = x.matrix<float>().contract(w.matrix<float>(), dims);
+    }
+    const auto b = bias.vec<float>()
+                       .reshape(Eigen::array<Eigen::Index, 2>{1, n})
+                       .broadcast(Eigen::array<Eigen::Index, 2>{m, 1});
+    if (relu_) {
+      out.device(d) = (out + b).cwiseMax(0.0f);
+    } else {
+      out.device(d) = out + b;
+    }
+  }
+
+  void ComputeInt8(OpKernelContext* ctx, const Tensor& x, const Tensor& bias,
+                   Tensor* y) SHARED_LOCKS_REQUIRED(mu_) {
+    const int64 m = x.dim_size(0);
+    Tensor qx;
+    OP_REQUIRES_OK(ctx, ctx->allocate_temp(
+        DT_INT16, TensorShape({m, k_pad_}), &qx));
+    std::vector<float> scales(n_);
+    for (int64 j = 0; j < n_; ++j) {
+      scales[j] = input_scale_ * weight_scales_[j];
+    }
+
+    const float* src = x.flat<float>().data();
+    int16* qx_data = qx.flat<int16>().data();
+    const int16* qw = qweights_.data();
+    const float* b = bias.flat<float>().data();
+    float* out = y->flat<float>().data();
+    const float inv_scale = 1.0f / input_scale_;
+    auto work = [&](int64 begin, int64 end) {
+      for (int64 r = begin; r < end; ++r) {
+        int16* dst = qx_data + r * k_pad_;
+        for (int64 i = 0; i < k_; ++i) {
+          dst[i] = QuantizeValue(src[r * k_ + i], inv_scale);
+        }
+        std::fill(dst + k_, dst + k_pad_, 0);
+      }
+#ifdef TF_CPU_ISA_AVX512
+      if (use_avx512_) {
+        QuantizedDenseRowsAvx512(qx_data, qw, scales.data(), b, k_pad_, n_,
+                                 relu_, begin, end, out);
+        return;
+      }
+#endif  // TF_CPU_ISA_AVX512
+      QuantizedDenseRows(qx_data, qw, scales.data(), b, k_pad_, n_, relu_,
+                         begin, end, out);
+    };
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, m,
+          k_pad_ * n_, work);
+  }
+
+  // Computes y in FP32, records the range of x, and measures the error and
+  // the time of INT8 against FP32, to choose one of them after the last
+  // calibration step.
+  void Calibrate(OpKernelContext* ctx, const Tensor& x, const Tensor& w,
+                 const Tensor& bias, Tensor* y) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    const uint64 start = Env::Default()->NowMicros();
+    ComputeFloat(ctx, x, w, bias, y);
+    const uint64 float_end = Env::Default()->NowMicros();
+
+    const float* src = x.flat<float>().data();
+    for (int64 i = 0; i < x.NumElements(); ++i) {
+      input_absmax_ = std::max(input_absmax_, std::abs(src[i]));
+    }
+    input_scale_ = input_absmax_ > 0.0f ? input_absmax_ / kInt8Max : 1.0f;
+
+    Tensor y_int8;
+    OP_REQUIRES_OK(ctx, ctx->allocate_temp(DT_FLOAT, y->shape(), &y_int8));
+    const uint64 int8_start = Env::Default()->NowMicros();
+    ComputeInt8(ctx, x, bias, &y_int8);
+    if (!ctx->status().ok()) return;
+    float_micros_ += float_end - start;
+    int8_micros_ += Env::Default()->NowMicros() - int8_start;
+
+    const float* expected = y->flat<float>().data();
+    const float* actual = y_int8.flat<float>().data();
+    for (int64 i = 0; i < y->NumElements(); ++i) {
+      const double error = actual[i] - expected[i];
+      error_sq_ += error * error;
+      expected_sq_ += static_cast<double>(expected[i]) * expected[i];
+      max_error_ = std::max(max_error_, std::abs(error));
+    }
+    if (++steps_ < calibration_steps_) {
+      return;
+    }
+
+    const double relative_error =
+        expected_sq_ > 0.0 ? std::sqrt(error_sq_ / expected_sq_)
+                           : (error_sq_ > 0.0 ? INFINITY : 0.0);
+    const bool use_int8 = relative_error <= max_relative_error_ &&
+                          int8_micros_ < float_micros_;
+    mode_ = use_int8 ? Mode::kInt8 : Mode::kFloat;
+    LOG(INFO) << "[QuantizedDense] " << name() << " runs in "
+              << (use_int8 ? "INT8" : "FP32") << ", in " << k_ << ", out "
+              << n_ << ", x range +-" << input_absmax_
+              << ". Calibrated with " << steps_
+              << " steps, relative error " << relative_error
+              << ", max absolute error " << max_error_ << ", FP32 "
+              << float_micros_ << " us, INT8 " << int8_micros_
+              << " us, speedup "
+              << (int8_micros_ > 0 ? 1.0 * float_micros_ / int8_micros_
+                                   : 1.0)
+              << "x.";
+  }
+
+  bool relu_ = false;
+  int64 calibration_steps_ = 0;
+  float max_relative_error_ = 0.0f;
+  bool use_avx512_ = false;
+
+  mutex mu_;
+  Mode mode_ GUARDED_BY(mu_) = Mode::kCalibrating;
+  // The weights quantized, of k_ x n_, and their scales per channel.
+  const char* weights_ GUARDED_BY(mu_) = nullptr;
+  int64 k_ GUARDED_BY(mu_) = 0;
+  int64 n_ GUARDED_BY(mu_) = 0;
+  int64 k_pad_ GUARDED_BY(mu_) = 0;
+  std::vector<int16> qweights_ GUARDED_BY(mu_);
+  std::vector<float> weight_scales_ GUARDED_BY(mu_);
+  // The calibration of x, per tensor, and its measures so far.
+  float input_absmax_ GUARDED_BY(mu_) = 0.0f;
+  float input_scale_ GUARDED_BY(mu_) = 1.0f;
+  int64 steps_ GUARDED_BY(mu_) = 0;
+  double error_sq_ GUARDED_BY(mu_) = 0.0;
+  double expected_sq_ GUARDED_BY(mu_) = 0.0;
+  double max_error_ GUARDED_BY(mu_) = 0.0;
+  uint64 float_micros_ GUARDED_BY(mu_) = 0;
+  uint64 int8_micros_ GUARDED_BY(mu_) = 0;
+};
+
+REGISTER_KERNEL_BUILDER(Name("QuantizedDense").Device(DEVICE_CPU),
+                        QuantizedDenseOp);
+
+} // namespace processor
+} // namespace tensorflow
@@ -0,0 +1,130 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <vector>
+#include "gtest/gtest.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace tensorflow {
+namespace processor {
+
+class QuantizedDenseOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(int calibration_steps, float max_relative_error) {
+    TF_ASSERT_OK(NodeDefBuilder("quantized_dense", "QuantizedDense")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("activation", "relu")
+                     .Attr("calibration_steps", calibration_steps)
+                     .Attr("max_relative_error", max_relative_error)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // A layer of m x k inputs and k x n weights, of values not on the grids
+  // of their scales, so that INT8 differs from FP32.
+  void MakeLayer(int64 m, int64 k, int64 n) {
+    x_.resize(m * k);
+    w_.resize(k * n);
+    bias_.resize(n);
+    for (int64 i = 0; i < m * k; ++i) {
+      x_[i] = std::sin(0.37 * i) * 1.7;
+    }
+    for (int64 i = 0; i < k * n; ++i) {
+      w_[i] = std::cos(0.53 * i) * 0.3;
+    }
+    for (int64 j = 0; j < n; ++j) {
+      bias_[j] = 0.1 * j - 0.2;
+    }
+    expected_ = Tensor(DT_FLOAT, TensorShape({m, n}));
+    auto expected = expected_.matrix<float>();
+    for (int64 r = 0; r < m; ++r) {
+      for (int64 j = 0; j < n; ++j) {
+        double sum = bias_[j];
+        for (int64 i = 0; i < k; ++i) {
+          sum += static_cast<double>(x_[r * k + i]) * w_[i * n + j];
+        }
+        expected(r, j) = sum > 0.0 ? sum : 0.0;
+      }
+    }
+    m_ = m;
+    k_ = k;
+    n_ = n;
+  }
+
+  Status Run() {
+    inputs_.clear();
+    AddInputFromArray<float>(TensorShape({m_, k_}), x_);
+    AddInputFromArray<float>(TensorShape({k_, n_}), w_);
+    AddInputFromArray<float>(TensorShape({n_}), bias_);
+    return RunOpKernel();
+  }
+
+  int64 m_ = 0;
+  int64 k_ = 0;
+  int64 n_ = 0;
+  std::vector<float> x_;
+  std::vector<float> w_;
+  std::vector<float> bias_;
+  Tensor expected_;
+};
+
+TEST_F(QuantizedDenseOpTest, CalibrateInFloat) {
+  MakeOp(/*calibration_steps=*/2, /*max_relative_error=*/1.0);
+  MakeLayer(3, 5, 2);
+  TF_ASSERT_OK(Run());
+  test::ExpectTensorNear<float>(expected_, *GetOutput(0), 1e-5);
+  TF_ASSERT_OK(Run());
+  test::ExpectTensorNear<float>(expected_, *GetOutput(0), 1e-5);
+}
+
+TEST_F(QuantizedDenseOpTest, CloseToFloatAfterCalibration) {
+  MakeOp(/*calibration_steps=*/1, /*max_relative_error=*/1.0);
+  // k is padded, and n has channels out of the blocks of 4.
+  MakeLayer(37, 70, 19);
+  TF_ASSERT_OK(Run());
+  for (int step = 0; step < 3; ++step) {
+    TF_ASSERT_OK(Run());
+    // INT8, or FP32 if INT8 was not faster.
+    test::ExpectTensorNear<float>(expected_, *GetOutput(0), 0.1);
+  }
+}
+
+TEST_F(QuantizedDenseOpTest, StayInFloatOverMaxRelativeError) {
+  MakeOp(/*calibration_steps=*/1, /*max_relative_error=*/0.0);
+  MakeLayer(8, 40, 6);
+  TF_ASSERT_OK(Run());
+  TF_ASSERT_OK(Run());
+  test::ExpectTensorNear<float>(expected_, *GetOutput(0), 1e-5);
+}
+
+TEST_F(QuantizedDenseOpTest, InvalidShapes) {
+  MakeOp(/*calibration_steps=*/1, /*max_relative_error=*/1.0);
+  AddInputFromArray<float>(TensorShape({2, 3}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});
+  AddInputFromArray<float>(TensorShape({2}), {1, 2});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+} // namespace processor
+} // namespace tensorflow
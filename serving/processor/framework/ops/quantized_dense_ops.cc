@@ -0,0 +1,57 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/common_shape_fns.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+namespace processor {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+// A dense layer of a tower, y = act(x * w + bias), in INT8 after a
+// post-training calibration. The first calibration_steps runs, the warmup
+// requests, compute in FP32 and record the range of x. The layer then
+// computes with x quantized per tensor and w per output channel, unless
+// the relative error measured against FP32 in the calibration exceeds
+// max_relative_error, or INT8 was not faster, and it stays in FP32.
+//
+// Stateful, so that the executors of a session share the calibration.
+REGISTER_OP("QuantizedDense")
+    .Input("x: float")
+    .Input("w: float")
+    .Input("bias: float")
+    .Output("y: float")
+    .Attr("activation: {'none', 'relu'} = 'relu'")
+    .Attr("calibration_steps: int >= 1 = 16")
+    .Attr("max_relative_error: float = 0.03")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle x, w, bias;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &x));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &w));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &bias));
+      DimensionHandle in, out;
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(x, 1), c->Dim(w, 0), &in));
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(w, 1), c->Dim(bias, 0), &out));
+      c->set_output(0, c->Matrix(c->Dim(x, 0), out));
+      return Status::OK();
+    });
+
+} // namespace processor
+} // namespace tensorflow
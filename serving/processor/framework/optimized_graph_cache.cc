@@ -0,0 +1,128 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "serving/processor/framework/optimized_graph_cache.h"
+
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
+
+namespace tensorflow {
+namespace processor {
+
+constexpr int OptimizedGraphCache::kFormatVersion;
+
+std::string OptimizedGraphCache::GetKey(const MetaGraphDef& mgdef,
+                                        const std::string& signature_name,
+                                        const GraphOptimizerOption& option) {
+  std::string content;
+  SerializeToStringDeterministic(mgdef, &content);
+  strings::StrAppend(&content, "\n", kFormatVersion, "\n", signature_name,
+                     "\n", option.native_tf_mode, option.shard_embedding,
+                     "\n", option.partition_id, "/",
+                     option.shard_instance_count, "\n",
+                     static_cast<int>(option.st), "\n", option.path,
+                     "\n", option.quantize_dense, "/",
+                     option.int8_calibration_steps, "/",
+                     option.int8_max_relative_error, "\n",
+                     option.xla_dense, "\n",
+                     option.embedding_server_count);
+  for (const auto& name : option.shard_embedding_names) {
+    strings::StrAppend(&content, "\n", name);
+  }
+  for (int64 size : option.size) {
+    strings::StrAppend(&content, "\n", size);
+  }
+  return strings::StrCat(strings::Hex(Fingerprint64(content),
+                                      strings::kZeroPad16));
+}
+
+std::string OptimizedGraphCache::GetFileName(const std::string& key) const {
+  return io::JoinPath(dir_, strings::StrCat("optimized_", key, ".pb"));
+}
+
+bool OptimizedGraphCache::Lookup(const std::string& key,
+                                 MetaGraphDef* mgdef) const {
+  if (dir_.empty()) {
+    return false;
+  }
+  const std::string file_name = GetFileName(key);
+  if (!Env::Default()->FileExists(file_name).ok()) {
+    return false;
+  }
+  MetaGraphDef cached;
+  Status s = ReadBinaryProto(Env::Default(), file_name, &cached);
+  if (!s.ok()) {
+    LOG(WARNING) << "[OptimizedGraphCache] Can not read " << file_name
+                 << ", the graph is optimized again. " << s.error_message();
+    return false;
+  }
+  mgdef->Swap(&cached);
+  return true;
+}
+
+Status OptimizedGraphCache::Insert(const std::string& key,
+                                   const MetaGraphDef& mgdef) const {
+  if (dir_.empty()) {
+    return Status::OK();
+  }
+  TF_RETURN_IF_ERROR(Env::Default()->RecursivelyCreateDir(dir_));
+  // The concurrent loads of the same graph, e.g. by the processors sharing
+  // the dir, each write a file of their own and rename it.
+  const std::string file_name = GetFileName(key);
+  const std::string tmp_file_name = strings::StrCat(
+      file_name, ".tmp", Env::Default()->NowMicros(), "_",
+      Env::Default()->GetCurrentThreadId());
+  TF_RETURN_IF_ERROR(WriteBinaryProto(Env::Default(), tmp_file_name, mgdef));
+  Status s = Env::Default()->RenameFile(tmp_file_name, file_name);
+  if (!s.ok()) {
+    Env::Default()->DeleteFile(tmp_file_name).IgnoreError();
+  }
+  return s;
+}
+
+Status OptimizeMetaGraphDef(const std::string& signature_name,
+                            const GraphOptimizerOption& option,
+                            const std::string& cache_dir,
+                            MetaGraphDef* mgdef) {
+  OptimizedGraphCache cache(cache_dir);
+  std::string key;
+  if (!cache_dir.empty()) {
+    key = OptimizedGraphCache::GetKey(*mgdef, signature_name, option);
+    if (cache.Lookup(key, mgdef)) {
+      LOG(INFO) << "[OptimizedGraphCache] Use the optimized graph " << key;
+      return Status::OK();
+    }
+  }
+
+  GraphOptimizerOption optimizer_option = option;
+  SavedModelOptimizer optimizer(signature_name, mgdef, optimizer_option);
+  TF_RETURN_IF_ERROR(optimizer.Optimize());
+
+  if (!cache_dir.empty()) {
+    // The model is served without the cache.
+    Status s = cache.Insert(key, *mgdef);
+    if (!s.ok()) {
+      LOG(WARNING) << "[OptimizedGraphCache] Can not cache the optimized "
+                   << "graph " << key << ". " << s.error_message();
+    }
+  }
+  return Status::OK();
+}
+
+} // namespace processor
+} // namespace tensorflow
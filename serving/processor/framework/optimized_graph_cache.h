@@ -0,0 +1,70 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef SERVING_PROCESSOR_FRAMEWORK_OPTIMIZED_GRAPH_CACHE_H_
+#define SERVING_PROCESSOR_FRAMEWORK_OPTIMIZED_GRAPH_CACHE_H_
+
+#include <string>
+
+#include "serving/processor/framework/graph_optimizer.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/protobuf/meta_graph.pb.h"
+
+namespace tensorflow {
+namespace processor {
+
+// The MetaGraphDefs optimized by SavedModelOptimizer, in files of dir keyed
+// by the content of the MetaGraphDef before the optimization, so that a
+// model whose graph has not changed, e.g. a new version of the same model
+// or a restarted processor, skips the graph conversion and all the passes.
+// An empty dir disables the cache.
+//
+// kFormatVersion is part of the keys, it has to be bumped whenever the
+// passes of SavedModelOptimizer change their outputs.
+class OptimizedGraphCache {
+ public:
+  explicit OptimizedGraphCache(const std::string& dir) : dir_(dir) {}
+
+  // The key of the optimization of mgdef for signature_name with option.
+  static std::string GetKey(const MetaGraphDef& mgdef,
+                            const std::string& signature_name,
+                            const GraphOptimizerOption& option);
+
+  // Replaces mgdef by the cached MetaGraphDef of key, false when there is
+  // none or it can not be read.
+  bool Lookup(const std::string& key, MetaGraphDef* mgdef) const;
+
+  // Writes the optimized mgdef as the MetaGraphDef of key.
+  Status Insert(const std::string& key, const MetaGraphDef& mgdef) const;
+
+  static constexpr int kFormatVersion = 1;
+
+ private:
+  std::string GetFileName(const std::string& key) const;
+
+  const std::string dir_;
+};
+
+// Optimizes mgdef by a SavedModelOptimizer, unless the cache of cache_dir
+// has its optimized MetaGraphDef.
+Status OptimizeMetaGraphDef(const std::string& signature_name,
+                            const GraphOptimizerOption& option,
+                            const std::string& cache_dir,
+                            MetaGraphDef* mgdef);
+
+} // namespace processor
+} // namespace tensorflow
+
+#endif // SERVING_PROCESSOR_FRAMEWORK_OPTIMIZED_GRAPH_CACHE_H_
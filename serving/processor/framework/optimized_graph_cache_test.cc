@@ -0,0 +1,94 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "serving/processor/framework/optimized_graph_cache.h"
+
+#include "gtest/gtest.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace processor {
+namespace {
+
+MetaGraphDef CreateMetaGraphDef(const std::string& node_name) {
+  MetaGraphDef mgdef;
+  NodeDef* node = mgdef.mutable_graph_def()->add_node();
+  node->set_name(node_name);
+  node->set_op("Placeholder");
+  return mgdef;
+}
+
+TEST(OptimizedGraphCacheTest, GetKey) {
+  GraphOptimizerOption option;
+  const std::string key = OptimizedGraphCache::GetKey(
+      CreateMetaGraphDef("a"), "serving_default", option);
+  EXPECT_EQ(16, key.size());
+  EXPECT_EQ(key, OptimizedGraphCache::GetKey(
+      CreateMetaGraphDef("a"), "serving_default", option));
+
+  EXPECT_NE(key, OptimizedGraphCache::GetKey(
+      CreateMetaGraphDef("b"), "serving_default", option));
+  EXPECT_NE(key, OptimizedGraphCache::GetKey(
+      CreateMetaGraphDef("a"), "other_signature", option));
+  GraphOptimizerOption native_option;
+  native_option.native_tf_mode = true;
+  EXPECT_NE(key, OptimizedGraphCache::GetKey(
+      CreateMetaGraphDef("a"), "serving_default", native_option));
+  GraphOptimizerOption int8_option;
+  int8_option.quantize_dense = true;
+  EXPECT_NE(key, OptimizedGraphCache::GetKey(
+      CreateMetaGraphDef("a"), "serving_default", int8_option));
+  GraphOptimizerOption shard_option;
+  shard_option.shard_embedding = true;
+  shard_option.shard_embedding_names = {"emb"};
+  shard_option.partition_id = 1;
+  shard_option.shard_instance_count = 2;
+  const std::string shard_key = OptimizedGraphCache::GetKey(
+      CreateMetaGraphDef("a"), "serving_default", shard_option);
+  EXPECT_NE(key, shard_key);
+  shard_option.partition_id = 0;
+  EXPECT_NE(shard_key, OptimizedGraphCache::GetKey(
+      CreateMetaGraphDef("a"), "serving_default", shard_option));
+}
+
+TEST(OptimizedGraphCacheTest, InsertAndLookup) {
+  OptimizedGraphCache cache(
+      io::JoinPath(testing::TmpDir(), "optimized_graph_cache_test"));
+  MetaGraphDef mgdef = CreateMetaGraphDef("a");
+  EXPECT_FALSE(cache.Lookup("0123456789abcdef", &mgdef));
+  EXPECT_EQ("a", mgdef.graph_def().node(0).name());
+
+  TF_ASSERT_OK(cache.Insert("0123456789abcdef", CreateMetaGraphDef("b")));
+  EXPECT_TRUE(cache.Lookup("0123456789abcdef", &mgdef));
+  EXPECT_EQ("b", mgdef.graph_def().node(0).name());
+  // Replaced by a later insert.
+  TF_ASSERT_OK(cache.Insert("0123456789abcdef", CreateMetaGraphDef("c")));
+  EXPECT_TRUE(cache.Lookup("0123456789abcdef", &mgdef));
+  EXPECT_EQ("c", mgdef.graph_def().node(0).name());
+}
+
+TEST(OptimizedGraphCacheTest, Disabled) {
+  OptimizedGraphCache cache("");
+  TF_ASSERT_OK(cache.Insert("0123456789abcdef", CreateMetaGraphDef("b")));
+  MetaGraphDef mgdef = CreateMetaGraphDef("a");
+  EXPECT_FALSE(cache.Lookup("0123456789abcdef", &mgdef));
+  EXPECT_EQ("a", mgdef.graph_def().node(0).name());
+}
+
+} // namespace
+} // namespace processor
+} // namespace tensorflow
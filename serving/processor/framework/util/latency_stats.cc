@@ -0,0 +1,192 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "serving/processor/framework/util/latency_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "tensorflow/core/lib/core/bits.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+
+namespace tensorflow {
+namespace processor {
+
+namespace {
+// The requests recorded before the outliers are told apart.
+constexpr int64 kMinOutlierSamples = 1000;
+}  // namespace
+
+constexpr int LatencyHistogram::kSubBucketBits;
+constexpr int LatencyHistogram::kSubBuckets;
+constexpr int LatencyHistogram::kNumBuckets;
+
+LatencyHistogram::LatencyHistogram() : count_(0), sum_(0), max_(0) {
+  for (auto& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+int LatencyHistogram::BucketIndex(int64 micros) {
+  if (micros < kSubBuckets) {
+    return std::max<int64>(micros, 0);
+  }
+  const int exponent = Log2Floor64(micros);
+  const int sub = (micros >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+  const int index = kSubBuckets * (exponent - kSubBucketBits + 1) + sub;
+  return std::min(index, kNumBuckets - 1);
+}
+
+int64 LatencyHistogram::BucketLimit(int index) {
+  if (index < kSubBuckets) {
+    return index + 1;
+  }
+  const int exponent = index / kSubBuckets + kSubBucketBits - 1;
+  const int sub = index % kSubBuckets;
+  return static_cast<int64>(kSubBuckets + sub + 1)
+         << (exponent - kSubBucketBits);
+}
+
+void LatencyHistogram::Record(int64 micros) {
+  buckets_[BucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(micros, std::memory_order_relaxed);
+  int64 max = max_.load(std::memory_order_relaxed);
+  while (micros > max &&
+         !max_.compare_exchange_weak(max, micros, std::memory_order_relaxed)) {
+  }
+}
+
+double LatencyHistogram::Mean() const {
+  const int64 count = Count();
+  return count > 0 ? static_cast<double>(sum_.load(std::memory_order_relaxed)) /
+                         count
+                   : 0;
+}
+
+int64 LatencyHistogram::Percentile(double p) const {
+  const int64 count = Count();
+  if (count == 0) {
+    return 0;
+  }
+  const int64 rank =
+      std::max<int64>(static_cast<int64>(std::ceil(p * count)), 1);
+  int64 seen = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      return std::min(BucketLimit(i), std::max<int64>(Max(), 1));
+    }
+  }
+  return Max();
+}
+
+LatencyStats* LatencyStats::Global() {
+  static LatencyStats* stats = new LatencyStats();
+  return stats;
+}
+
+LatencyStats::LatencyStats() : trace_interval_(0), num_requests_(0) {}
+
+const char* LatencyStats::StageName(LatencyStage stage) {
+  switch (stage) {
+    case LatencyStage::DECODE:
+      return "decode";
+    case LatencyStage::QUEUE:
+      return "queue";
+    case LatencyStage::BATCH_WAIT:
+      return "batch_wait";
+    case LatencyStage::GRAPH:
+      return "graph";
+    case LatencyStage::EMBEDDING:
+      return "embedding";
+    case LatencyStage::DENSE:
+      return "dense";
+    case LatencyStage::FEATURE_STORE:
+      return "feature_store";
+    case LatencyStage::ENCODE:
+      return "encode";
+    case LatencyStage::TOTAL:
+      return "total";
+    default:
+      return "unknown";
+  }
+}
+
+bool LatencyStats::ShouldTrace() {
+  const int64 interval = trace_interval_.load(std::memory_order_relaxed);
+  if (interval <= 0) {
+    return false;
+  }
+  return num_requests_.fetch_add(1, std::memory_order_relaxed) % interval ==
+         0;
+}
+
+bool LatencyStats::IsEmbeddingOp(StringPiece op) {
+  return str_util::StartsWith(op, "Kv") ||
+         str_util::StrContains(op, "Embedding") ||
+         str_util::StartsWith(op, "SparseSegment") ||
+         op == "Unique" || op == "ResourceGather";
+}
+
+void LatencyStats::RecordStepStats(const StepStats& step_stats) {
+  int64 embedding_us = 0;
+  int64 dense_us = 0;
+  for (const auto& dev_stats : step_stats.dev_stats()) {
+    for (const auto& node_stats : dev_stats.node_stats()) {
+      // The label is "<name> = <op>(<inputs>)".
+      StringPiece op(node_stats.timeline_label());
+      const size_t begin = op.find(" = ");
+      if (begin == StringPiece::npos) {
+        continue;
+      }
+      op.remove_prefix(begin + 3);
+      op = op.substr(0, op.find('('));
+      if (IsEmbeddingOp(op)) {
+        embedding_us += node_stats.all_end_rel_micros();
+      } else {
+        dense_us += node_stats.all_end_rel_micros();
+      }
+    }
+  }
+  Record(LatencyStage::EMBEDDING, embedding_us);
+  Record(LatencyStage::DENSE, dense_us);
+}
+
+bool LatencyStats::IsOutlier(LatencyStage stage, int64 micros) const {
+  const LatencyHistogram& histogram = Histogram(stage);
+  return histogram.Count() >= kMinOutlierSamples &&
+         micros > histogram.Percentile(0.99);
+}
+
+std::vector<LatencySummary> LatencyStats::Summaries() const {
+  std::vector<LatencySummary> summaries;
+  for (int i = 0; i < static_cast<int>(LatencyStage::NUM_STAGES); ++i) {
+    const LatencyHistogram& histogram = histograms_[i];
+    LatencySummary summary;
+    summary.stage = StageName(static_cast<LatencyStage>(i));
+    summary.count = histogram.Count();
+    summary.mean_us = histogram.Mean();
+    summary.p50_us = histogram.Percentile(0.5);
+    summary.p90_us = histogram.Percentile(0.9);
+    summary.p99_us = histogram.Percentile(0.99);
+    summary.max_us = histogram.Max();
+    summaries.emplace_back(std::move(summary));
+  }
+  return summaries;
+}
+
+}  // namespace processor
+}  // namespace tensorflow
@@ -0,0 +1,159 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef SERVING_PROCESSOR_FRAMEWORK_UTIL_LATENCY_STATS_H_
+#define SERVING_PROCESSOR_FRAMEWORK_UTIL_LATENCY_STATS_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/step_stats.pb.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace processor {
+
+// A histogram of latencies in microseconds which is updated without locks.
+// The buckets are 8 per power of 2, so a percentile is at most 12.5% above
+// the recorded latency it stands for.
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  void Record(int64 micros);
+
+  int64 Count() const { return count_.load(std::memory_order_relaxed); }
+  int64 Max() const { return max_.load(std::memory_order_relaxed); }
+  double Mean() const;
+  // The upper bound of the bucket of the p-th quantile, 0 <= p <= 1.
+  int64 Percentile(double p) const;
+
+  static int BucketIndex(int64 micros);
+  // The exclusive upper bound of the bucket 'index'.
+  static int64 BucketLimit(int index);
+
+  static constexpr int kSubBucketBits = 3;
+  static constexpr int kSubBuckets = 1 << kSubBucketBits;
+  static constexpr int kNumBuckets = kSubBuckets * 40;
+
+ private:
+  std::atomic<int64> buckets_[kNumBuckets];
+  std::atomic<int64> count_;
+  std::atomic<int64> sum_;
+  std::atomic<int64> max_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(LatencyHistogram);
+};
+
+// The stages of a request, from its decoding to its encoding.
+enum class LatencyStage {
+  // Parsing the request.
+  DECODE = 0,
+  // Waiting for a process thread, for batch_process and async_process.
+  QUEUE,
+  // Waiting in the request batcher for the other requests of a batch.
+  BATCH_WAIT,
+  // Running the graph.
+  GRAPH,
+  // The op time of the embedding and the dense ops of the graph, from the
+  // sampled traces only.
+  EMBEDDING,
+  DENSE,
+  // One read of the feature store.
+  FEATURE_STORE,
+  // Serializing the response.
+  ENCODE,
+  // From decoding to encoding.
+  TOTAL,
+  NUM_STAGES
+};
+
+struct LatencySummary {
+  std::string stage;
+  int64 count = 0;
+  double mean_us = 0;
+  int64 p50_us = 0;
+  int64 p90_us = 0;
+  int64 p99_us = 0;
+  int64 max_us = 0;
+};
+
+// The latency breakdown of the requests of the process, always on. One
+// request in trace_interval is run with a software trace, which gives the
+// embedding and dense op time, and the timeline of such a request is kept
+// only when its graph time is an outlier.
+class LatencyStats {
+ public:
+  static LatencyStats* Global();
+
+  LatencyStats();
+
+  static const char* StageName(LatencyStage stage);
+
+  void Record(LatencyStage stage, int64 micros) {
+    histograms_[static_cast<int>(stage)].Record(micros);
+  }
+  const LatencyHistogram& Histogram(LatencyStage stage) const {
+    return histograms_[static_cast<int>(stage)];
+  }
+
+  // Traces one request in 'interval', never when interval <= 0.
+  void SetTraceInterval(int64 interval) { trace_interval_ = interval; }
+  // Whether to trace the current request.
+  bool ShouldTrace();
+
+  // Records the embedding and dense op time of a traced request.
+  void RecordStepStats(const StepStats& step_stats);
+
+  // Whether 'micros' in 'stage' is above the 99th percentile, once enough
+  // requests are recorded to tell.
+  bool IsOutlier(LatencyStage stage, int64 micros) const;
+
+  std::vector<LatencySummary> Summaries() const;
+
+  // Whether an op of type 'op' belongs to the embedding part of a graph.
+  static bool IsEmbeddingOp(StringPiece op);
+
+ private:
+  LatencyHistogram histograms_[static_cast<int>(LatencyStage::NUM_STAGES)];
+  std::atomic<int64> trace_interval_;
+  std::atomic<int64> num_requests_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(LatencyStats);
+};
+
+// Records the time from its construction to its destruction.
+class ScopedLatency {
+ public:
+  explicit ScopedLatency(LatencyStage stage)
+      : stage_(stage), start_us_(Env::Default()->NowMicros()) {}
+  ~ScopedLatency() {
+    LatencyStats::Global()->Record(
+        stage_, Env::Default()->NowMicros() - start_us_);
+  }
+
+ private:
+  const LatencyStage stage_;
+  const int64 start_us_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ScopedLatency);
+};
+
+}  // namespace processor
+}  // namespace tensorflow
+
+#endif  // SERVING_PROCESSOR_FRAMEWORK_UTIL_LATENCY_STATS_H_
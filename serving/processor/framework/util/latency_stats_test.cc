@@ -0,0 +1,104 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "serving/processor/framework/util/latency_stats.h"
+
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace tensorflow {
+namespace processor {
+
+TEST(LatencyStatsTest, BucketsCoverTheirLatencies) {
+  for (int64 micros : {0, 1, 7, 8, 9, 15, 16, 17, 1000, 123456789}) {
+    const int index = LatencyHistogram::BucketIndex(micros);
+    EXPECT_LT(micros, LatencyHistogram::BucketLimit(index));
+    if (index > 0) {
+      EXPECT_GE(micros, LatencyHistogram::BucketLimit(index - 1));
+    }
+  }
+}
+
+TEST(LatencyStatsTest, Percentiles) {
+  LatencyHistogram histogram;
+  for (int64 micros = 1; micros <= 1000; ++micros) {
+    histogram.Record(micros);
+  }
+  EXPECT_EQ(1000, histogram.Count());
+  EXPECT_EQ(1000, histogram.Max());
+  EXPECT_DOUBLE_EQ(500.5, histogram.Mean());
+  // The percentiles are at most 12.5% above the latencies.
+  EXPECT_GE(histogram.Percentile(0.5), 500);
+  EXPECT_LE(histogram.Percentile(0.5), 563);
+  EXPECT_GE(histogram.Percentile(0.99), 990);
+  EXPECT_LE(histogram.Percentile(0.99), 1000);
+}
+
+TEST(LatencyStatsTest, ConcurrentRecords) {
+  LatencyHistogram histogram;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&histogram, t]() {
+      for (int i = 0; i < 10000; ++i) {
+        histogram.Record(t * 100 + i % 100);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(80000, histogram.Count());
+  EXPECT_EQ(799, histogram.Max());
+}
+
+TEST(LatencyStatsTest, Outliers) {
+  LatencyStats stats;
+  EXPECT_FALSE(stats.IsOutlier(LatencyStage::GRAPH, 1000000));
+  for (int i = 0; i < 1000; ++i) {
+    stats.Record(LatencyStage::GRAPH, 1000);
+  }
+  EXPECT_FALSE(stats.IsOutlier(LatencyStage::GRAPH, 1000));
+  EXPECT_TRUE(stats.IsOutlier(LatencyStage::GRAPH, 2000));
+}
+
+TEST(LatencyStatsTest, TraceInterval) {
+  LatencyStats stats;
+  EXPECT_FALSE(stats.ShouldTrace());
+  stats.SetTraceInterval(3);
+  int num_traced = 0;
+  for (int i = 0; i < 9; ++i) {
+    num_traced += stats.ShouldTrace();
+  }
+  EXPECT_EQ(3, num_traced);
+}
+
+TEST(LatencyStatsTest, EmbeddingAndDenseTime) {
+  LatencyStats stats;
+  StepStats step_stats;
+  auto dev_stats = step_stats.add_dev_stats();
+  auto node_stats = dev_stats->add_node_stats();
+  node_stats->set_timeline_label("lookup = KvResourceGather(ev, ids)");
+  node_stats->set_all_end_rel_micros(30);
+  node_stats = dev_stats->add_node_stats();
+  node_stats->set_timeline_label("dense = MatMul(a, b)");
+  node_stats->set_all_end_rel_micros(70);
+  stats.RecordStepStats(step_stats);
+  EXPECT_EQ(30, stats.Histogram(LatencyStage::EMBEDDING).Max());
+  EXPECT_EQ(70, stats.Histogram(LatencyStage::DENSE).Max());
+}
+
+}  // namespace processor
+}  // namespace tensorflow
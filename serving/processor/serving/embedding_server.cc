@@ -0,0 +1,95 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <iostream>
+#include <vector>
+
+#include "serving/processor/framework/graph_optimizer.h"
+#include "tensorflow/core/distributed_runtime/server_lib.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/protobuf/cluster.pb.h"
+#include "tensorflow/core/protobuf/tensorflow_server.pb.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+// This binary starts an embedding server of the sharded serving, see
+// ModelConfig::embedding_servers. The server holds the EV partitions the
+// processors place on it, restored from the checkpoint by the processors,
+// in the storage of the EVs, DRAM or SSD, and looks them up for the
+// RunGraph of each request.
+namespace tensorflow {
+namespace processor {
+namespace {
+
+Status FillServerDef(const string& embedding_servers, int task_index,
+                     const string& protocol, ServerDef* server_def) {
+  server_def->set_protocol(protocol);
+  server_def->set_job_name(GetEmbeddingServerJobName());
+  server_def->set_task_index(task_index);
+
+  JobDef* job = server_def->mutable_cluster()->add_job();
+  job->set_name(GetEmbeddingServerJobName());
+  const std::vector<string> host_ports =
+      str_util::Split(embedding_servers, ';');
+  for (size_t i = 0; i < host_ports.size(); ++i) {
+    (*job->mutable_tasks())[i] = host_ports[i];
+  }
+  if (task_index < 0 ||
+      static_cast<size_t>(task_index) >= host_ports.size()) {
+    return errors::InvalidArgument("Task index ", task_index,
+                                   " is invalid, there are ",
+                                   host_ports.size(), " embedding servers");
+  }
+  return Status::OK();
+}
+
+} // namespace
+} // namespace processor
+} // namespace tensorflow
+
+int main(int argc, char* argv[]) {
+  tensorflow::string embedding_servers;
+  int task_index = 0;
+  tensorflow::string protocol = "star_server";
+  std::vector<tensorflow::Flag> flag_list = {
+      tensorflow::Flag("embedding_servers", &embedding_servers,
+                       "the embedding servers, host1:port1;host2:port2, "
+                       "the embedding_servers of the model config"),
+      tensorflow::Flag("task_index", &task_index,
+                       "the index of this server in embedding_servers"),
+      tensorflow::Flag("protocol", &protocol,
+                       "the embedding_server_protocol of the model config"),
+  };
+  tensorflow::string usage = tensorflow::Flags::Usage(argv[0], flag_list);
+  const bool parse_result = tensorflow::Flags::Parse(&argc, argv, flag_list);
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  if (!parse_result || argc != 1 || embedding_servers.empty()) {
+    std::cerr << usage << std::endl;
+    return -1;
+  }
+  tensorflow::ServerDef server_def;
+  tensorflow::Status s = tensorflow::processor::FillServerDef(
+      embedding_servers, task_index, protocol, &server_def);
+  if (!s.ok()) {
+    std::cerr << "ERROR: " << s.error_message() << std::endl;
+    std::cerr << usage << std::endl;
+    return -1;
+  }
+  std::unique_ptr<tensorflow::ServerInterface> server;
+  TF_QCHECK_OK(tensorflow::NewServer(server_def, &server));
+  TF_QCHECK_OK(server->Start());
+  TF_QCHECK_OK(server->Join());
+}
@@ -0,0 +1,161 @@
+#include "serving/processor/serving/lookup_prefetcher.h"
+#include "serving/processor/framework/util/latency_stats.h"
+#include "serving/processor/storage/feature_store_mgr.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/graph/tensor_id.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace processor {
+
+namespace {
+
+// The node of the input 0 of node, through the Identity nodes, nullptr
+// when it is not the output 0 of a node of graph_def.
+const NodeDef* GetSourceNode(
+    const NodeDef& node,
+    const std::unordered_map<std::string, const NodeDef*>& nodes) {
+  const NodeDef* current = &node;
+  do {
+    if (current->input_size() == 0) {
+      return nullptr;
+    }
+    TensorId input = ParseTensorName(current->input(0));
+    if (input.index() != 0) {
+      return nullptr;
+    }
+    auto it = nodes.find(std::string(input.node()));
+    if (it == nodes.end()) {
+      return nullptr;
+    }
+    current = it->second;
+  } while (current->op() == "Identity");
+  return current;
+}
+
+} // namespace
+
+Status LookupPrefetcher::GetLookups(const GraphDef& graph_def,
+                                    std::vector<Lookup>* lookups) {
+  std::unordered_map<std::string, const NodeDef*> nodes;
+  for (const NodeDef& node : graph_def.node()) {
+    nodes[node.name()] = &node;
+  }
+  lookups->clear();
+  for (const NodeDef& node : graph_def.node()) {
+    if (node.op() != "KvLookup" || node.input_size() < 2) {
+      continue;
+    }
+    const NodeDef* keys = GetSourceNode(node, nodes);
+    if (keys == nullptr || keys->op() != "Placeholder") {
+      continue;
+    }
+    TensorId default_value_id = ParseTensorName(node.input(1));
+    auto default_value = nodes.find(std::string(default_value_id.node()));
+    if (default_value == nodes.end() ||
+        default_value->second->op() != "Const") {
+      continue;
+    }
+
+    Lookup lookup;
+    lookup.output_name = strings::StrCat(node.name(), ":0");
+    lookup.keys_name = keys->name();
+    TF_RETURN_IF_ERROR(
+        GetNodeAttr(node, "feature_name_to_id", &lookup.feature_id));
+    TF_RETURN_IF_ERROR(GetNodeAttr(node, "dim_len", &lookup.dim_len));
+    TF_RETURN_IF_ERROR(GetNodeAttr(node, "dtype", &lookup.dtype));
+    TF_RETURN_IF_ERROR(GetNodeAttr(*default_value->second, "value",
+                                   &lookup.default_value));
+    // The feature store copies a whole row of the default value.
+    if (lookup.default_value.dtype() != lookup.dtype ||
+        lookup.default_value.NumElements() < lookup.dim_len) {
+      continue;
+    }
+    lookups->emplace_back(std::move(lookup));
+  }
+  return Status::OK();
+}
+
+LookupPrefetcher::LookupPrefetcher(IFeatureStoreMgr* storage,
+                                   const std::vector<Lookup>& lookups)
+    : storage_(storage), lookups_(lookups) {
+  for (int i = 0; i < lookups_.size(); ++i) {
+    lookups_by_keys_[lookups_[i].keys_name].push_back(i);
+  }
+}
+
+Status LookupPrefetcher::Prefetch(
+    uint64 model_version,
+    std::vector<std::pair<std::string, Tensor>>* inputs) {
+  // The keys and the values of the lookups of the request.
+  std::vector<std::pair<const Lookup*, Tensor>> calls;
+  for (const auto& input : *inputs) {
+    TensorId id = ParseTensorName(input.first);
+    if (id.index() != 0 || input.second.dtype() != DT_INT64) {
+      continue;
+    }
+    auto it = lookups_by_keys_.find(std::string(id.node()));
+    if (it == lookups_by_keys_.end()) {
+      continue;
+    }
+    for (int i : it->second) {
+      calls.emplace_back(&lookups_[i], input.second);
+    }
+  }
+  if (calls.empty()) {
+    return Status::OK();
+  }
+
+  std::vector<Tensor> values(calls.size());
+  mutex mu;
+  Status status;
+  BlockingCounter pending(calls.size());
+  for (size_t i = 0; i < calls.size(); ++i) {
+    const Lookup& lookup = *calls[i].first;
+    const Tensor& keys = calls[i].second;
+    TensorShape shape = keys.shape();
+    shape.AddDim(lookup.dim_len);
+    values[i] = Tensor(lookup.dtype, shape);
+    const int64 N = keys.NumElements();
+    if (N == 0) {
+      pending.DecrementCount();
+      continue;
+    }
+    const int64 start_us = Env::Default()->NowMicros();
+    auto done = [&mu, &status, &pending, start_us](const Status& s) {
+      LatencyStats::Global()->Record(LatencyStage::FEATURE_STORE,
+          Env::Default()->NowMicros() - start_us);
+      {
+        mutex_lock lock(mu);
+        status.Update(s);
+      }
+      pending.DecrementCount();
+    };
+    Status s = storage_->GetValues(
+        model_version, lookup.feature_id,
+        (const char*)keys.data(), (char*)values[i].data(),
+        sizeof(int64), DataTypeSize(lookup.dtype) * lookup.dim_len, N,
+        (const char*)lookup.default_value.data(), done);
+    // The callback is not called when GetValues fails.
+    if (!s.ok()) {
+      {
+        mutex_lock lock(mu);
+        status.Update(s);
+      }
+      pending.DecrementCount();
+    }
+  }
+  pending.Wait();
+  TF_RETURN_IF_ERROR(status);
+
+  for (size_t i = 0; i < calls.size(); ++i) {
+    inputs->emplace_back(calls[i].first->output_name, values[i]);
+  }
+  return Status::OK();
+}
+
+} // processor
+} // tensorflow
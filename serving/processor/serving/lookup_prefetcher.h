@@ -0,0 +1,64 @@
+#ifndef SERVING_PROCESSOR_SERVING_LOOKUP_PREFETCHER_H
+#define SERVING_PROCESSOR_SERVING_LOOKUP_PREFETCHER_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace tensorflow {
+namespace processor {
+class IFeatureStoreMgr;
+
+// Reads the embeddings of a request from the remote feature store before
+// its graph runs, and feeds them as the outputs of the KvLookup nodes, which
+// are then pruned from the executed graph.
+//
+// The lookups of all the EmbeddingVariables of the request are issued at
+// once, rather than as the executor reaches each KvLookup node, so that
+// they overlap with each other on the read connections of the feature
+// store. Only the KvLookup nodes whose keys are fed by the request, through
+// Identity nodes, and whose default value is a constant are prefetched,
+// the others run in the graph.
+class LookupPrefetcher {
+ public:
+  // A KvLookup node of the graph which can be prefetched.
+  struct Lookup {
+    // The output of the KvLookup node, which is fed.
+    std::string output_name;
+    // The Placeholder of its keys.
+    std::string keys_name;
+    int64 feature_id;
+    int64 dim_len;
+    DataType dtype;
+    Tensor default_value;
+  };
+
+  // The KvLookup nodes of graph_def which can be prefetched.
+  static Status GetLookups(const GraphDef& graph_def,
+                           std::vector<Lookup>* lookups);
+
+  LookupPrefetcher(IFeatureStoreMgr* storage,
+                   const std::vector<Lookup>& lookups);
+
+  // Reads the values of the lookups whose keys are among inputs from the
+  // model_version of the feature store, waits for all of them and appends
+  // them to inputs.
+  Status Prefetch(uint64 model_version,
+                  std::vector<std::pair<std::string, Tensor>>* inputs);
+
+  size_t NumLookups() const { return lookups_.size(); }
+
+ private:
+  IFeatureStoreMgr* storage_;
+  const std::vector<Lookup> lookups_;
+  // The lookups of each keys Placeholder.
+  std::unordered_map<std::string, std::vector<int>> lookups_by_keys_;
+};
+
+} // processor
+} // tensorflow
+
+#endif // SERVING_PROCESSOR_SERVING_LOOKUP_PREFETCHER_H
@@ -0,0 +1,164 @@
+#include <atomic>
+#include "gtest/gtest.h"
+#include "serving/processor/serving/lookup_prefetcher.h"
+#include "serving/processor/storage/feature_store_mgr.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace processor {
+namespace {
+
+// Reads the row of a key k >= 0 as feature_id * 100 + k, the default value
+// for the others, in another thread.
+class FakeFeatureStoreMgr : public IFeatureStoreMgr {
+ public:
+  Status GetValues(uint64_t model_version, uint64_t feature2id,
+                   const char* const keys, char* const values,
+                   size_t bytes_per_key, size_t bytes_per_values,
+                   size_t N, const char* default_value,
+                   BatchGetCallback cb) override {
+    ++num_calls;
+    Env::Default()->SchedClosure([=]() {
+      const int64* k = reinterpret_cast<const int64*>(keys);
+      const size_t dim = bytes_per_values / sizeof(float);
+      float* v = reinterpret_cast<float*>(values);
+      for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < dim; ++j) {
+          v[i * dim + j] = k[i] >= 0
+              ? feature2id * 100 + k[i]
+              : reinterpret_cast<const float*>(default_value)[j];
+        }
+      }
+      cb(Status::OK());
+    });
+    return Status::OK();
+  }
+
+  Status SetValues(uint64_t model_version, uint64_t feature2id,
+                   const char* const keys, const char* const values,
+                   size_t bytes_per_key, size_t bytes_per_values,
+                   size_t N, BatchSetCallback cb) override {
+    return Status::OK();
+  }
+
+  Status Reset() override { return Status::OK(); }
+  Status GetStorageMeta(StorageMeta* meta) override { return Status::OK(); }
+  void GetStorageOptions(StorageMeta& meta, StorageOptions** cur_opt,
+                         StorageOptions** bak_opt) override {}
+  Status SetStorageActiveStatus(bool active) override {
+    return Status::OK();
+  }
+  Status GetModelVersion(int64_t* full_version,
+                         int64_t* latest_version) override {
+    return Status::OK();
+  }
+  Status SetModelVersion(int64_t full_version,
+                         int64_t latest_version) override {
+    return Status::OK();
+  }
+  Status GetStorageLock(int value, int timeout, bool* success) override {
+    return Status::OK();
+  }
+  Status ReleaseStorageLock(int value) override { return Status::OK(); }
+
+  std::atomic<int> num_calls{0};
+};
+
+NodeDef* AddNode(GraphDef* graph_def, const std::string& name,
+                 const std::string& op,
+                 const std::vector<std::string>& inputs) {
+  NodeDef* node = graph_def->add_node();
+  node->set_name(name);
+  node->set_op(op);
+  for (const auto& input : inputs) {
+    node->add_input(input);
+  }
+  return node;
+}
+
+void AddKvLookup(GraphDef* graph_def, const std::string& name,
+                 const std::string& keys, const std::string& default_value,
+                 int64 feature_id) {
+  NodeDef* node = AddNode(graph_def, name, "KvLookup",
+      {keys, default_value, "GlobalODL/StoragePointer",
+       "GlobalODL/ModelVersion"});
+  AddNodeAttr("feature_name", name, node);
+  AddNodeAttr("feature_name_to_id", feature_id, node);
+  AddNodeAttr("dim_len", 2, node);
+  AddNodeAttr("dtype", DT_FLOAT, node);
+  AddNodeAttr("Tkeys", DT_INT64, node);
+}
+
+GraphDef CreateGraphDef() {
+  GraphDef graph_def;
+  AddNode(&graph_def, "user_id", "Placeholder", {});
+  AddNode(&graph_def, "item_id", "Placeholder", {});
+  AddNode(&graph_def, "item_id/read", "Identity", {"item_id"});
+  AddNode(&graph_def, "hashed_id", "StringToHashBucketFast", {"user_id"});
+  NodeDef* zeros = AddNode(&graph_def, "zeros", "Const", {});
+  AddNodeAttr("value", test::AsTensor<float>({-1, -1}), zeros);
+  AddNodeAttr("dtype", DT_FLOAT, zeros);
+  AddNode(&graph_def, "computed_default", "Fill", {});
+
+  AddKvLookup(&graph_def, "user_lookup", "user_id", "zeros", 1);
+  AddKvLookup(&graph_def, "item_lookup", "item_id/read", "zeros", 2);
+  // Not prefetched: computed keys or default value.
+  AddKvLookup(&graph_def, "hashed_lookup", "hashed_id", "zeros", 3);
+  AddKvLookup(&graph_def, "other_lookup", "user_id", "computed_default", 4);
+  return graph_def;
+}
+
+TEST(LookupPrefetcherTest, GetLookups) {
+  std::vector<LookupPrefetcher::Lookup> lookups;
+  TF_ASSERT_OK(LookupPrefetcher::GetLookups(CreateGraphDef(), &lookups));
+  ASSERT_EQ(2, lookups.size());
+  EXPECT_EQ("user_lookup:0", lookups[0].output_name);
+  EXPECT_EQ("user_id", lookups[0].keys_name);
+  EXPECT_EQ(1, lookups[0].feature_id);
+  EXPECT_EQ(2, lookups[0].dim_len);
+  EXPECT_EQ(DT_FLOAT, lookups[0].dtype);
+  EXPECT_EQ("item_lookup:0", lookups[1].output_name);
+  EXPECT_EQ("item_id", lookups[1].keys_name);
+}
+
+TEST(LookupPrefetcherTest, Prefetch) {
+  std::vector<LookupPrefetcher::Lookup> lookups;
+  TF_ASSERT_OK(LookupPrefetcher::GetLookups(CreateGraphDef(), &lookups));
+  FakeFeatureStoreMgr storage;
+  LookupPrefetcher prefetcher(&storage, lookups);
+
+  std::vector<std::pair<std::string, Tensor>> inputs = {
+      {"user_id:0", test::AsTensor<int64>({5})},
+      {"item_id", test::AsTensor<int64>({1, -1, 3}, {3, 1})},
+      {"dense", test::AsTensor<float>({0.5})}};
+  TF_ASSERT_OK(prefetcher.Prefetch(0, &inputs));
+  EXPECT_EQ(2, storage.num_calls);
+  ASSERT_EQ(5, inputs.size());
+  EXPECT_EQ("user_lookup:0", inputs[3].first);
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({105, 105}, {1, 2}), inputs[3].second);
+  EXPECT_EQ("item_lookup:0", inputs[4].first);
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({201, 201, -1, -1, 203, 203}, {3, 1, 2}),
+      inputs[4].second);
+}
+
+TEST(LookupPrefetcherTest, NoKeysFed) {
+  std::vector<LookupPrefetcher::Lookup> lookups;
+  TF_ASSERT_OK(LookupPrefetcher::GetLookups(CreateGraphDef(), &lookups));
+  FakeFeatureStoreMgr storage;
+  LookupPrefetcher prefetcher(&storage, lookups);
+
+  std::vector<std::pair<std::string, Tensor>> inputs = {
+      {"dense", test::AsTensor<float>({0.5})}};
+  TF_ASSERT_OK(prefetcher.Prefetch(0, &inputs));
+  EXPECT_EQ(0, storage.num_calls);
+  EXPECT_EQ(1, inputs.size());
+}
+
+} // namespace
+} // processor
+} // tensorflow
@@ -1,6 +1,7 @@
 #include "serving/processor/serving/model_message.h"
 #include "serving/processor/serving/message_coding.h"
 #include "serving/processor/serving/util.h"
+#include "serving/processor/framework/util/latency_stats.h"
 
 namespace tensorflow {
 namespace processor {
@@ -12,13 +13,21 @@ ProtoBufParser::ProtoBufParser(int thread_num) {
 Status ProtoBufParser::ParseRequest(
     const eas::PredictRequest& request,
     const SignatureInfo* signature_info, Call& call) {
+  return ParseRequest(request, signature_info, call, nullptr);
+}
+
+Status ProtoBufParser::ParseRequest(
+    const eas::PredictRequest& request,
+    const SignatureInfo* signature_info, Call& call,
+    const std::shared_ptr<protobuf::Arena>& arena) {
   for (auto& input : request.inputs()) {
     if (signature_info->input_key_idx.find(input.first) ==
         signature_info->input_key_idx.end()) {
       LOG(FATAL) << "Request contain invalid input key : " << input.first;
     }
     int idx = signature_info->input_key_idx.at(input.first);
-    auto pb_to_tensor = util::Proto2Tensor(input.first, input.second);
+    auto pb_to_tensor =
+        util::Proto2Tensor(input.first, input.second, arena);
     if (!pb_to_tensor.status.ok()) {
       return pb_to_tensor.status;
     }
@@ -48,97 +57,63 @@ Status ProtoBufParser::ParseRequest(
 Status ProtoBufParser::ParseRequestFromBuf(
     const void* input_data, int input_size, Call& call,
     const SignatureInfo* signature_info) {
-  eas::PredictRequest request;
-  bool success = request.ParseFromArray(input_data, input_size);
+  ScopedLatency latency(LatencyStage::DECODE);
+  // The input tensors alias the values of the request parsed on the arena,
+  // the arena is released with the last of them.
+  protobuf::ArenaOptions options;
+  options.start_block_size = std::max(input_size, 0) + 1024;
+  std::shared_ptr<protobuf::Arena> arena(new protobuf::Arena(options));
+  auto request =
+      protobuf::Arena::CreateMessage<eas::PredictRequest>(arena.get());
+  bool success = request->ParseFromArray(input_data, input_size);
   if (!success) {
     LOG(ERROR) << "Parse request from array failed, input_data: " << input_data
                << ", input_size: " << input_size;
     return Status(errors::Code::INVALID_ARGUMENT, "Please check the input data.");
   }
 
-  return ParseRequest(request, signature_info, call);
+  return ParseRequest(*request, signature_info, call, arena);
 }
 
 Status ProtoBufParser::ParseResponseToBuf(
     const Call& call, void** output_data, int* output_size,
     const SignatureInfo* signature_info) {
-  eas::PredictResponse response = util::Tensor2Response(call.request,
-      call.response, signature_info);
-  *output_size = response.ByteSize();
-  *output_data = new char[*output_size];
-  bool success = response.SerializeToArray(*output_data, *output_size);
-  if (!success) {
-    LOG(ERROR) << "Parse reponse to array failed. " << response.DebugString();
-    return Status(errors::Code::INTERNAL, "Serialize response to array failed.");
-  }
-  return Status::OK();
+  ScopedLatency latency(LatencyStage::ENCODE);
+  return util::SerializeResponseToArray(call.request, call.response,
+      signature_info, output_data, output_size);
 }
 
 Status ProtoBufParser::ParseBatchRequestFromBuf(
-    const void* input_data[], int* input_size,
-    BatchCall& call, const SignatureInfo* signature_info) {
-  auto size = sizeof(input_data) / sizeof(void*);
-  call.call_num = size;
-  auto do_work = [&call, input_data, input_size,
-                  signature_info](size_t begin, size_t end) {
-    for (size_t i = begin; i < end; ++i) {
-      eas::PredictRequest request;
-      request.ParseFromArray(input_data[i], input_size[i]);
-      
-      for (auto& input : request.inputs()) {
-        if (signature_info->input_key_idx.find(input.first) ==
-            signature_info->input_key_idx.end()) {
-          LOG(FATAL) << "Request contain invalid input key : " << input.first;
-        }
-        int idx = signature_info->input_key_idx.at(input.first);
-        auto pb_to_tensor = util::Proto2Tensor(input.first, input.second);
-        if (!pb_to_tensor.status.ok()) {
-          return pb_to_tensor.status;
-        }
-        call.request[i].inputs.emplace_back(
-            signature_info->input_value_name[idx],
-            std::move(pb_to_tensor.tensor));
-      }
- 
-      if (i == 0) {
-        if (request.output_filter().size() > 0) {
-          call.request[0].output_tensor_names.reserve(request.output_filter().size());
-          for (auto key : request.output_filter()) {
-            if (signature_info->output_key_idx.find(key) ==
-                signature_info->output_key_idx.end()) {
-              LOG(FATAL) << "Request contain invalid output filter: " << key;
-            }
-            call.request[0].output_tensor_names.emplace_back(
-                signature_info->output_value_name[signature_info->output_key_idx.at(key)]);
-          }
-        } else {
-          call.request[0].output_tensor_names =
-              signature_info->output_value_name;
-        }
-      }
+    int input_num, const void* input_data[], int* input_size,
+    std::vector<Call>& calls, std::vector<Status>& statuses,
+    const SignatureInfo* signature_info) {
+  calls.resize(input_num);
+  statuses.resize(input_num);
+  auto do_work = [this, input_data, input_size, signature_info,
+                  &calls, &statuses](int64 begin, int64 end) {
+    for (int64 i = begin; i < end; ++i) {
+      statuses[i] = ParseRequestFromBuf(input_data[i], input_size[i],
+                                        calls[i], signature_info);
     }
   };
-  thread_pool_->ParallelFor(size, 10000, do_work);
-
-  return call.BatchRequest();
+  thread_pool_->ParallelFor(input_num, 10000, do_work);
+  return Status::OK();
 }
 
 Status ProtoBufParser::ParseBatchResponseToBuf(
-    BatchCall& call, void* output_data[],
-    int* output_size, const SignatureInfo* signature_info) {
-  //TF_RETURN_IF_ERROR(call.SplitResponse());
-  call.SplitResponse();
-  auto do_work = [&call, output_data, output_size,
-	              signature_info](size_t begin, size_t end) {
-    for (size_t i = begin; i < end; ++i) {
-      eas::PredictResponse response = util::Tensor2Response(call.request[i],
-          call.response[i], signature_info);
-      output_size[i] = response.ByteSize();
-      output_data[i] = new char[*output_size];
-      response.SerializeToArray(output_data[i], output_size[i]); 
+    const std::vector<Call>& calls, std::vector<Status>& statuses,
+    void* output_data[], int* output_size,
+    const SignatureInfo* signature_info) {
+  auto do_work = [this, output_data, output_size, signature_info,
+                  &calls, &statuses](int64 begin, int64 end) {
+    for (int64 i = begin; i < end; ++i) {
+      if (statuses[i].ok()) {
+        statuses[i] = ParseResponseToBuf(calls[i], &output_data[i],
+                                         &output_size[i], signature_info);
+      }
     }
   };
-  thread_pool_->ParallelFor(call.call_num, 10000, do_work);
+  thread_pool_->ParallelFor(calls.size(), 10000, do_work);
   return Status::OK();
 }
 
@@ -147,6 +122,16 @@ Status ProtoBufParser::ParseServingModelInfoToBuf(
     int* output_size) {
   eas::ServingModelInfo info;
   *info.mutable_model_path() = model_info.model_path;
+  for (const auto& summary : model_info.latency) {
+    auto latency = info.add_latency();
+    latency->set_stage(summary.stage);
+    latency->set_count(summary.count);
+    latency->set_mean_us(summary.mean_us);
+    latency->set_p50_us(summary.p50_us);
+    latency->set_p90_us(summary.p90_us);
+    latency->set_p99_us(summary.p99_us);
+    latency->set_max_us(summary.max_us);
+  }
   *output_size = info.ByteSize();
   *output_data = new char[*output_size];
   info.SerializeToArray(*output_data, *output_size);
@@ -10,7 +10,6 @@ namespace processor {
 class Request;
 class Response;
 class Call;
-class BatchCall;
 class ServingModelInfo;
 class SignatureInfo;
 
@@ -28,16 +27,21 @@ class IParser {
       const Call& call, void** output_data,
       int* output_size, const SignatureInfo* info) = 0;
 
+  // Parses the input_num requests into calls in parallel, statuses[i] is
+  // the status of the ith one.
   virtual Status ParseBatchRequestFromBuf(
-      const void* input_data[], int* input_size,
-      BatchCall& call, const SignatureInfo* info) {
+      int input_num, const void* input_data[], int* input_size,
+      std::vector<Call>& calls, std::vector<Status>& statuses,
+      const SignatureInfo* info) {
     // TO be implemented
     return Status::OK();
   }
 
+  // Serializes the responses of the calls whose statuses are ok in
+  // parallel, statuses[i] is updated with the status of the ith one.
   virtual Status ParseBatchResponseToBuf(
-      BatchCall& call, void* output_data[],
-      int* output_size, const SignatureInfo* info) {
+      const std::vector<Call>& calls, std::vector<Status>& statuses,
+      void* output_data[], int* output_size, const SignatureInfo* info) {
     // TO be implemented
     return Status::OK();
   }
@@ -66,18 +70,26 @@ class ProtoBufParser : public IParser {
       int* output_size, const SignatureInfo* info) override;
   
   Status ParseBatchRequestFromBuf(
-      const void* input_data[], int* input_size,
-      BatchCall& call, const SignatureInfo* info) override;
+      int input_num, const void* input_data[], int* input_size,
+      std::vector<Call>& calls, std::vector<Status>& statuses,
+      const SignatureInfo* info) override;
 
   Status ParseBatchResponseToBuf(
-      BatchCall& call, void* output_data[],
-      int* output_size, const SignatureInfo* info) override;
+      const std::vector<Call>& calls, std::vector<Status>& statuses,
+      void* output_data[], int* output_size,
+      const SignatureInfo* info) override;
 
   Status ParseServingModelInfoToBuf(
       ServingModelInfo& model_info, void* output_data[],
       int* output_size) override;
 
  private:
+  // The tensors of the inputs allocated on arena alias their values.
+  Status ParseRequest(
+      const eas::PredictRequest& request,
+      const SignatureInfo* signature_info, Call& call,
+      const std::shared_ptr<protobuf::Arena>& arena);
+
   std::unique_ptr<thread::ThreadPool> thread_pool_;
 };
 
@@ -106,15 +118,17 @@ class FlatBufferParser : public IParser {
   }
   
   Status ParseBatchRequestFromBuf(
-      const void* input_data[], int* input_size,
-      BatchCall& call, const SignatureInfo* info) override {
+      int input_num, const void* input_data[], int* input_size,
+      std::vector<Call>& calls, std::vector<Status>& statuses,
+      const SignatureInfo* info) override {
     // TO be implemented
     return Status::OK();
   }
 
   Status ParseBatchResponseToBuf(
-      BatchCall& call, void* output_data[],
-      int* output_size, const SignatureInfo* info) override {
+      const std::vector<Call>& calls, std::vector<Status>& statuses,
+      void* output_data[], int* output_size,
+      const SignatureInfo* info) override {
     // TO be implemented
     return Status::OK();
   }
@@ -117,6 +117,11 @@ Status ModelConfigFactory::Create(const char* model_config, ModelConfig** config
   (*config)->enable_device_placement_optimization =
       enable_device_placement_optimization;
 
+  if (!json_config["pipeline_max_in_flight"].isNull()) {
+    (*config)->pipeline_max_in_flight =
+      json_config["pipeline_max_in_flight"].asInt();
+  }
+
   bool enable_inline_execute = false;
   if (!json_config["enable_inline_execute"].isNull()) {
     enable_inline_execute = json_config["enable_inline_execute"].asBool();
@@ -144,6 +149,24 @@ Status ModelConfigFactory::Create(const char* model_config, ModelConfig** config
     }
   }
 
+  // Rows of the EVs restored with a frequency under embedding_tail_min_freq
+  // are folded into embedding_tail_buckets shared rows.
+  if (!json_config["embedding_tail_min_freq"].isNull() &&
+      !json_config["embedding_tail_buckets"].isNull()) {
+    if (setenv("TF_EV_TAIL_FOLD_MIN_FREQ",
+               json_config["embedding_tail_min_freq"].asString().c_str(),
+               1) != 0) {
+      LOG(WARNING) << "Set TF_EV_TAIL_FOLD_MIN_FREQ env error: "
+                   << json_config["embedding_tail_min_freq"];
+    }
+    if (setenv("TF_EV_TAIL_FOLD_BUCKETS",
+               json_config["embedding_tail_buckets"].asString().c_str(),
+               1) != 0) {
+      LOG(WARNING) << "Set TF_EV_TAIL_FOLD_BUCKETS env error: "
+                   << json_config["embedding_tail_buckets"];
+    }
+  }
+
   if (!json_config["inter_op_parallelism_threads"].isNull()) {
     (*config)->inter_threads =
       json_config["inter_op_parallelism_threads"].asInt();
@@ -199,6 +222,65 @@ Status ModelConfigFactory::Create(const char* model_config, ModelConfig** config
     (*config)->warmup_file_name = "";
   }
 
+  if (!json_config["warmup_record_file_name"].isNull()) {
+    (*config)->warmup_record_file_name =
+      json_config["warmup_record_file_name"].asString();
+  }
+
+  if (!json_config["warmup_record_interval"].isNull()) {
+    (*config)->warmup_record_interval =
+      json_config["warmup_record_interval"].asInt();
+  }
+
+  if (!json_config["warmup_record_max_requests"].isNull()) {
+    (*config)->warmup_record_max_requests =
+      json_config["warmup_record_max_requests"].asInt();
+  }
+
+  if (!json_config["warmup_budget_ms"].isNull()) {
+    (*config)->warmup_budget_ms =
+      json_config["warmup_budget_ms"].asInt();
+  }
+
+  if (!json_config["optimized_graph_cache_dir"].isNull()) {
+    (*config)->optimized_graph_cache_dir =
+      json_config["optimized_graph_cache_dir"].asString();
+  }
+
+  if (!json_config["enable_int8_dense"].isNull()) {
+    (*config)->enable_int8_dense =
+      json_config["enable_int8_dense"].asBool();
+  }
+
+  if (!json_config["int8_calibration_steps"].isNull()) {
+    (*config)->int8_calibration_steps =
+      json_config["int8_calibration_steps"].asInt();
+    if ((*config)->int8_calibration_steps < 1) {
+      return Status(error::Code::INVALID_ARGUMENT,
+          "[TensorFlow] int8_calibration_steps should be at least 1.");
+    }
+  }
+
+  if (!json_config["int8_max_relative_error"].isNull()) {
+    (*config)->int8_max_relative_error =
+      json_config["int8_max_relative_error"].asFloat();
+  }
+
+  if (!json_config["dense_compile"].isNull()) {
+    (*config)->dense_compile =
+      json_config["dense_compile"].asString();
+    if ((*config)->dense_compile != "xla" &&
+        (*config)->dense_compile != "tensorrt") {
+      return Status(error::Code::INVALID_ARGUMENT,
+          "[TensorFlow] dense_compile should be xla or tensorrt.");
+    }
+  }
+
+  if (!json_config["dense_compile_max_shapes"].isNull()) {
+    (*config)->dense_compile_max_shapes =
+      json_config["dense_compile_max_shapes"].asInt();
+  }
+
   if (!json_config["serialize_protocol"].isNull()) {
     (*config)->serialize_protocol =
       json_config["serialize_protocol"].asString();
@@ -403,6 +485,36 @@ Status ModelConfigFactory::Create(const char* model_config, ModelConfig** config
     (*config)->shard_embedding_names.push_back(embedding_names);
   }
 
+  if (!json_config["embedding_servers"].isNull()) {
+    if ((*config)->feature_store_type != "local") {
+      return Status(error::Code::INVALID_ARGUMENT,
+          "[TensorFlow] Embedding servers require feature_store_type "
+          "must be 'local' mode.");
+    }
+    if (json_config["embedding_worker_address"].isNull()) {
+      return Status(error::Code::INVALID_ARGUMENT,
+          "[TensorFlow] Embedding servers require args: "
+          "embedding_worker_address.");
+    }
+    (*config)->embedding_worker_address =
+      json_config["embedding_worker_address"].asString();
+
+    // "host1:port1;host2:port2"
+    std::string servers = json_config["embedding_servers"].asString();
+    auto idx = servers.find(";");
+    while (idx != std::string::npos) {
+      (*config)->embedding_servers.push_back(servers.substr(0, idx));
+      servers = servers.substr(idx+1);
+      idx = servers.find(";");
+    }
+    (*config)->embedding_servers.push_back(servers);
+  }
+
+  if (!json_config["embedding_server_protocol"].isNull()) {
+    (*config)->embedding_server_protocol =
+      json_config["embedding_server_protocol"].asString();
+  }
+
   // enable trace timeline
   if (!json_config["timeline_start_step"].isNull() &&
       !json_config["timeline_interval_step"].isNull() &&
@@ -457,6 +569,103 @@ Status ModelConfigFactory::Create(const char* model_config, ModelConfig** config
     }
   }
 
+  if (!json_config["delta_stream_brokers"].isNull()) {
+    (*config)->delta_stream_brokers =
+      json_config["delta_stream_brokers"].asString();
+  }
+
+  if (!json_config["delta_stream_topic"].isNull()) {
+    (*config)->delta_stream_topic =
+      json_config["delta_stream_topic"].asString();
+  }
+
+  if (!(*config)->delta_stream_brokers.empty() &&
+      (*config)->delta_stream_topic.empty()) {
+    return Status(error::Code::INVALID_ARGUMENT,
+        "[TensorFlow] delta_stream_topic shouldn't be empty string "
+        "when delta_stream_brokers is set.");
+  }
+
+  if (!json_config["delta_stream_group"].isNull()) {
+    (*config)->delta_stream_group =
+      json_config["delta_stream_group"].asString();
+  }
+
+  if (!json_config["delta_stream_batch_keys"].isNull()) {
+    (*config)->delta_stream_batch_keys =
+      json_config["delta_stream_batch_keys"].asInt();
+  }
+
+  if (!json_config["delta_stream_max_staleness_ms"].isNull()) {
+    (*config)->delta_stream_max_staleness_ms =
+      json_config["delta_stream_max_staleness_ms"].asInt();
+  }
+
+  if (!json_config["share_unchanged_embedding"].isNull()) {
+    (*config)->share_unchanged_embedding =
+      json_config["share_unchanged_embedding"].asBool();
+  }
+
+  if (!json_config["share_embedding_across_models"].isNull()) {
+    (*config)->share_embedding_across_models =
+      json_config["share_embedding_across_models"].asBool();
+  }
+
+  if (!json_config["batching_max_batch_size"].isNull()) {
+    (*config)->batching_max_batch_size =
+      json_config["batching_max_batch_size"].asInt();
+  }
+
+  if (!json_config["batching_max_queue_delay_us"].isNull()) {
+    (*config)->batching_max_queue_delay_us =
+      json_config["batching_max_queue_delay_us"].asInt();
+  }
+
+  if (!json_config["process_threads"].isNull()) {
+    (*config)->process_threads =
+      json_config["process_threads"].asInt();
+  }
+
+  if (!json_config["latency_trace_interval"].isNull()) {
+    (*config)->latency_trace_interval =
+      json_config["latency_trace_interval"].asInt();
+  }
+
+  if (!json_config["split_min_shard_rows"].isNull()) {
+    (*config)->split_min_shard_rows =
+      json_config["split_min_shard_rows"].asInt();
+  }
+
+  if (!json_config["split_max_shards"].isNull()) {
+    (*config)->split_max_shards =
+      json_config["split_max_shards"].asInt();
+  }
+
+  if (!json_config["feature_cache_capacity"].isNull()) {
+    (*config)->feature_cache_capacity =
+      json_config["feature_cache_capacity"].asInt();
+  }
+
+  if (!json_config["feature_cache_ttl_ms"].isNull()) {
+    (*config)->feature_cache_ttl_ms =
+      json_config["feature_cache_ttl_ms"].asInt();
+  }
+
+  if (!json_config["redis_mget_batch_size"].isNull()) {
+    (*config)->redis_mget_batch_size =
+      json_config["redis_mget_batch_size"].asInt();
+  }
+
+  if (!json_config["feature_store_async_get"].isNull()) {
+    (*config)->feature_store_async_get =
+      json_config["feature_store_async_get"].asBool();
+  }
+
+  if (!json_config["feature_store_prefetch"].isNull()) {
+    (*config)->feature_store_prefetch =
+      json_config["feature_store_prefetch"].asBool();
+  }
+
   return Status::OK();
 }
 
@@ -15,6 +15,34 @@ struct ModelConfig {
   std::string savedmodel_dir;
   std::string signature_name;
   std::string warmup_file_name;
+  // One request in warmup_record_interval is recorded into
+  // warmup_record_file_name, which keeps the last
+  // warmup_record_max_requests of them. A new model version, or the model
+  // of a restarted processor without warmup_file_name, replays them before
+  // it serves, in at most warmup_budget_ms when > 0. Recording needs the
+  // protobuf serialize_protocol.
+  std::string warmup_record_file_name;
+  int warmup_record_interval = 100;
+  int warmup_record_max_requests = 1000;
+  int warmup_budget_ms = 60000;
+  // The optimized graphs are cached in optimized_graph_cache_dir, keyed by
+  // the content of the graphs, so that a model whose graph has not changed
+  // loads without optimizing it again. Disabled when empty.
+  std::string optimized_graph_cache_dir;
+  // Post-training INT8 quantization of the dense layers of the towers,
+  // calibrated on the first int8_calibration_steps runs of each layer, the
+  // warmup requests. A layer stays in FP32 when its relative error exceeds
+  // int8_max_relative_error, or when INT8 is not faster.
+  bool enable_int8_dense = false;
+  int int8_calibration_steps = 16;
+  float int8_max_relative_error = 0.03;
+  // Compile the dense sub-graph, while the embedding lookups stay in TF:
+  // "xla" clusters it for XLA, "tensorrt" converts its segments into
+  // TensorRT engines. Both compile per input shape, the batch sizes of the
+  // warmup requests before serving, with at most dense_compile_max_shapes
+  // engines per segment for TensorRT. Disabled when empty.
+  std::string dense_compile;
+  int dense_compile_max_shapes = 16;
   std::string serialize_protocol;
   int init_timeout_minutes = 0;
 
@@ -48,6 +76,16 @@ struct ModelConfig {
   bool shard_embedding = false;
   std::vector<std::string> shard_embedding_names;
 
+  // Sharded serving, the EV partitions of the checkpoint are served by the
+  // embedding servers at embedding_servers, "host1:port1;host2:port2", the
+  // partition part_i by the server i % the number of servers. The
+  // processor, served at embedding_worker_address, looks up the servers of
+  // a request with one RunGraph of each over embedding_server_protocol.
+  // Disabled when empty.
+  std::vector<std::string> embedding_servers;
+  std::string embedding_worker_address;
+  std::string embedding_server_protocol = "star_server";
+
   // session num of session group,
   // default num is 1
   int session_num = 1;
@@ -69,6 +107,75 @@ struct ModelConfig {
   std::vector<int64> storage_size;
 
   bool enable_device_placement_optimization = false;
+  // With the device placement optimization, the requests of a session run
+  // in two pipelined stages, the CPU stage in front of the compute graph
+  // boundary and the GPU stage after it, at most pipeline_max_in_flight
+  // requests in each stage. Disabled when pipeline_max_in_flight <= 0.
+  int pipeline_max_in_flight = 0;
+
+  // Streaming delta model, the rows of the delta checkpoints published
+  // by the trainer to the Kafka topic delta_stream_topic are applied to
+  // the serving model. Disabled when delta_stream_brokers is empty.
+  std::string delta_stream_brokers;
+  std::string delta_stream_topic;
+  std::string delta_stream_group = "processor";
+  // The consumed rows are applied once delta_stream_batch_keys rows are
+  // buffered or the oldest buffered row waits delta_stream_max_staleness_ms.
+  int delta_stream_batch_keys = 4096;
+  int delta_stream_max_staleness_ms = 1000;
+
+  // A new model version of the same graph shares the EmbeddingVariables
+  // whose tensors are unchanged since the serving checkpoint, instead of
+  // restoring a copy of them.
+  bool share_unchanged_embedding = true;
+
+  // The models of the process, e.g. the variants of an A/B test initialized
+  // one after another, keep one copy of the EmbeddingVariables their
+  // checkpoints hold with the same name and tensors, and a copy each of
+  // their dense variables. The rows streamed or restored incrementally into
+  // a shared EmbeddingVariable are seen by all the models which share it.
+  bool share_embedding_across_models = false;
+
+  // Request batching, the concurrent requests of a session with the same
+  // inputs except the 0th dimension are merged into one run of at most
+  // batching_max_batch_size rows, a request waits at most
+  // batching_max_queue_delay_us for the others. Disabled when
+  // batching_max_batch_size <= 1.
+  int batching_max_batch_size = 0;
+  int batching_max_queue_delay_us = 1000;
+
+  // The threads which run the requests of batch_process and
+  // async_process. The requests of one batch_process run concurrently on
+  // them, so that request batching merges them.
+  int process_threads = 16;
+
+  // One request in latency_trace_interval is run with a software trace,
+  // which breaks its graph time down into embedding and dense time. The
+  // timeline of such a request is kept when its graph time is above the
+  // 99th percentile. Disabled when latency_trace_interval <= 0.
+  int latency_trace_interval = 1000;
+
+  // Request splitting, the candidates of a request are split into shards
+  // of at least split_min_shard_rows rows, which run concurrently on at most
+  // split_max_shards sessions of the session group. Fewer shards are used
+  // when the other requests keep the sessions busy. Disabled when
+  // split_min_shard_rows <= 0, split_max_shards <= 0 means session_num.
+  int split_min_shard_rows = 0;
+  int split_max_shards = 0;
+
+  // Feature store reads, the values of feature_cache_capacity hot ids are
+  // cached in process for feature_cache_ttl_ms, disabled when
+  // feature_cache_capacity <= 0. The missed ids are read by MGETs of
+  // redis_mget_batch_size keys which are pipelined, and the larger batches
+  // are split across the read connections. The reads run in the read
+  // threads overlapping the graph execution when feature_store_async_get.
+  // With feature_store_prefetch, the reads of all the embeddings of a
+  // request are issued at once before its graph runs.
+  int feature_cache_capacity = 0;
+  int feature_cache_ttl_ms = 60 * 1000;
+  int redis_mget_batch_size = 512;
+  bool feature_store_async_get = true;
+  bool feature_store_prefetch = false;
 };
 
 class ModelConfigFactory {
@@ -282,6 +282,132 @@ const std::string oss_config = " \
       ModelConfigFactory::Create(oss_config.c_str(), &config).code());
 }
 
+TEST_F(ModelConfigTest, ShouldSuccessWhenConfigDeltaStream) {
+const std::string oss_config = " \
+  { \
+    \"serialize_protocol\": \"protobuf\", \
+    \"inter_op_parallelism_threads\" : 4, \
+    \"intra_op_parallelism_threads\" : 2, \
+    \"init_timeout_minutes\" : 1, \
+    \"signature_name\": \"tensorflow_serving\", \
+    \"checkpoint_dir\" : \"oss://test_ckpt/1\", \
+    \"savedmodel_dir\" : \"oss://test_savedmodel/1\", \
+    \"feature_store_type\" : \"memory\", \
+    \"model_store_type\": \"oss\", \
+    \"oss_endpoint\": \"test.endpoint\", \
+    \"oss_access_id\" : \"test_id\", \
+    \"oss_access_key\" : \"test_key\", \
+    \"delta_stream_brokers\" : \"broker:9092\", \
+    \"delta_stream_topic\" : \"model_delta\", \
+    \"delta_stream_batch_keys\" : 1024, \
+    \"delta_stream_max_staleness_ms\" : 200 \
+  }";
+
+  ModelConfig* config = nullptr;
+  EXPECT_TRUE(ModelConfigFactory::Create(oss_config.c_str(), &config).ok());
+  EXPECT_EQ("broker:9092", config->delta_stream_brokers);
+  EXPECT_EQ("model_delta", config->delta_stream_topic);
+  EXPECT_EQ("processor", config->delta_stream_group);
+  EXPECT_EQ(1024, config->delta_stream_batch_keys);
+  EXPECT_EQ(200, config->delta_stream_max_staleness_ms);
+}
+
+TEST_F(ModelConfigTest, ShouldSuccessWhenDisableShareUnchangedEmbedding) {
+const std::string oss_config = " \
+  { \
+    \"serialize_protocol\": \"protobuf\", \
+    \"inter_op_parallelism_threads\" : 4, \
+    \"intra_op_parallelism_threads\" : 2, \
+    \"init_timeout_minutes\" : 1, \
+    \"signature_name\": \"tensorflow_serving\", \
+    \"checkpoint_dir\" : \"oss://test_ckpt/1\", \
+    \"savedmodel_dir\" : \"oss://test_savedmodel/1\", \
+    \"feature_store_type\" : \"memory\", \
+    \"model_store_type\": \"oss\", \
+    \"oss_endpoint\": \"test.endpoint\", \
+    \"oss_access_id\" : \"test_id\", \
+    \"oss_access_key\" : \"test_key\", \
+    \"share_unchanged_embedding\" : false \
+  }";
+
+  ModelConfig* config = nullptr;
+  EXPECT_TRUE(ModelConfigFactory::Create(oss_config.c_str(), &config).ok());
+  EXPECT_FALSE(config->share_unchanged_embedding);
+}
+
+TEST_F(ModelConfigTest, ShouldSuccessWhenEnableShareEmbeddingAcrossModels) {
+const std::string oss_config = " \
+  { \
+    \"serialize_protocol\": \"protobuf\", \
+    \"inter_op_parallelism_threads\" : 4, \
+    \"intra_op_parallelism_threads\" : 2, \
+    \"init_timeout_minutes\" : 1, \
+    \"signature_name\": \"tensorflow_serving\", \
+    \"checkpoint_dir\" : \"oss://test_ckpt/1\", \
+    \"savedmodel_dir\" : \"oss://test_savedmodel/1\", \
+    \"feature_store_type\" : \"memory\", \
+    \"model_store_type\": \"oss\", \
+    \"oss_endpoint\": \"test.endpoint\", \
+    \"oss_access_id\" : \"test_id\", \
+    \"oss_access_key\" : \"test_key\", \
+    \"share_embedding_across_models\" : true \
+  }";
+
+  ModelConfig* config = nullptr;
+  EXPECT_TRUE(ModelConfigFactory::Create(oss_config.c_str(), &config).ok());
+  EXPECT_TRUE(config->share_embedding_across_models);
+}
+
+TEST_F(ModelConfigTest, ShouldSuccessWhenConfigEmbeddingServers) {
+const std::string oss_config = " \
+  { \
+    \"serialize_protocol\": \"protobuf\", \
+    \"inter_op_parallelism_threads\" : 4, \
+    \"intra_op_parallelism_threads\" : 2, \
+    \"init_timeout_minutes\" : 1, \
+    \"signature_name\": \"tensorflow_serving\", \
+    \"checkpoint_dir\" : \"oss://test_ckpt/1\", \
+    \"savedmodel_dir\" : \"oss://test_savedmodel/1\", \
+    \"feature_store_type\" : \"local\", \
+    \"model_store_type\": \"oss\", \
+    \"oss_endpoint\": \"test.endpoint\", \
+    \"oss_access_id\" : \"test_id\", \
+    \"oss_access_key\" : \"test_key\", \
+    \"embedding_servers\" : \"server0:2222;server1:2222\", \
+    \"embedding_worker_address\" : \"processor:2222\" \
+  }";
+
+  ModelConfig* config = nullptr;
+  EXPECT_TRUE(ModelConfigFactory::Create(oss_config.c_str(), &config).ok());
+  ASSERT_EQ(2, config->embedding_servers.size());
+  EXPECT_EQ("server0:2222", config->embedding_servers[0]);
+  EXPECT_EQ("server1:2222", config->embedding_servers[1]);
+  EXPECT_EQ("processor:2222", config->embedding_worker_address);
+  EXPECT_EQ("star_server", config->embedding_server_protocol);
+}
+
+TEST_F(ModelConfigTest, ShouldFailureWhenConfigEmbeddingServersNotLocal) {
+const std::string oss_config = " \
+  { \
+    \"serialize_protocol\": \"protobuf\", \
+    \"inter_op_parallelism_threads\" : 4, \
+    \"intra_op_parallelism_threads\" : 2, \
+    \"init_timeout_minutes\" : 1, \
+    \"signature_name\": \"tensorflow_serving\", \
+    \"checkpoint_dir\" : \"oss://test_ckpt/1\", \
+    \"savedmodel_dir\" : \"oss://test_savedmodel/1\", \
+    \"feature_store_type\" : \"memory\", \
+    \"model_store_type\": \"oss\", \
+    \"oss_endpoint\": \"test.endpoint\", \
+    \"oss_access_id\" : \"test_id\", \
+    \"oss_access_key\" : \"test_key\", \
+    \"embedding_servers\" : \"server0:2222;server1:2222\", \
+    \"embedding_worker_address\" : \"processor:2222\" \
+  }";
+
+  ModelConfig* config = nullptr;
+  EXPECT_FALSE(ModelConfigFactory::Create(oss_config.c_str(), &config).ok());
+}
+
 } // processor
 } // tensorflow
-
@@ -5,18 +5,23 @@
 #include "serving/processor/serving/model_session.h"
 #include "serving/processor/serving/predict.pb.h"
 #include "serving/processor/serving/util.h"
+#include "serving/processor/serving/warmup_recorder.h"
 #include "serving/processor/storage/model_store.h"
 #include "serving/processor/storage/feature_store_mgr.h"
 #include "serving/processor/framework/graph_optimizer.h"
+#include "serving/processor/framework/optimized_graph_cache.h"
 #include "tensorflow/cc/saved_model/tag_constants.h"
 #include "tensorflow/cc/saved_model/reader.h"
 #include "tensorflow/cc/saved_model/loader.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/distributed_runtime/server_lib.h"
 #include "tensorflow/cc/saved_model/constants.h"
+#include "tensorflow/core/kernels/embedding_delta_stream.h"
 #include "tensorflow/cc/saved_model/signature_constants.h"
 #include "tensorflow/core/platform/protobuf_internal.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/util/tensor_bundle/naming.h"
 
 using tensorflow::kPredictMethodName;
@@ -28,6 +33,10 @@ constexpr int _60_Seconds = 60;
 constexpr int MAX_TRY_COUNT = 10;
 constexpr int WARMUP_COUNT = 5;
 
+int64 NowMillis() {
+  return Env::Default()->NowMicros() / 1000;
+}
+
 Tensor CreateTensor(const TensorInfo& tensor_info) {
   auto real_ts = tensor_info.tensor_shape();
   // set batch_size to 1 when the default value is -1
@@ -87,24 +96,6 @@ Status CreateWarmupParams(SignatureDef& sig_def, Call* call) {
   return Status::OK();
 }
 
-Status CreateWarmupParams(SignatureDef& sig_def,
-                          const std::string& warmup_file_name,
-                          Call* call, IParser* parser,
-                          const SignatureInfo& signature_info) {
-  // Parse warmup file
-  eas::PredictRequest request;
-  std::fstream input(warmup_file_name, std::ios::in | std::ios::binary);
-  bool success = request.ParseFromIstream(&input);
-  if (!success) {
-    LOG(ERROR) << "Read warmp file failed: " << warmup_file_name;
-    return Status(error::Code::INTERNAL,
-        "Read warmp file failed, please check warmp file path");
-  }
-  input.close();
-
-  return parser->ParseRequest(request, &signature_info, *call);
-}
-
 bool ShouldWarmup(SignatureDef& sig_def) {
   for (auto it : sig_def.inputs()) {
     if (it.second.dtype() == DT_STRING) return false;
@@ -112,6 +103,48 @@ bool ShouldWarmup(SignatureDef& sig_def) {
   return true;
 }
 
+// The calls to warm up with: the requests of the warmup file, else the
+// requests recorded from the live traffic, else one created from the
+// signature when it has no string inputs.
+Status CreateWarmupCalls(SignatureDef& sig_def,
+                         const std::string& warmup_file_name,
+                         const std::string& record_file_name,
+                         IParser* parser,
+                         const SignatureInfo& signature_info,
+                         std::vector<Call>* calls) {
+  std::string file_name = warmup_file_name;
+  if (file_name.empty() && !record_file_name.empty() &&
+      Env::Default()->FileExists(record_file_name).ok()) {
+    file_name = record_file_name;
+  }
+  if (file_name.empty()) {
+    if (ShouldWarmup(sig_def)) {
+      calls->resize(1);
+      return CreateWarmupParams(sig_def, &calls->front());
+    }
+    return Status::OK();
+  }
+
+  std::vector<std::string> requests;
+  Status s = WarmupRecorder::ReadRequests(file_name, &requests);
+  if (!s.ok()) {
+    LOG(ERROR) << "Read warmp file failed: " << file_name;
+    return Status(error::Code::INTERNAL,
+        "Read warmp file failed, please check warmp file path");
+  }
+  calls->resize(requests.size());
+  for (size_t i = 0; i < requests.size(); ++i) {
+    eas::PredictRequest request;
+    if (!request.ParseFromString(requests[i])) {
+      return Status(error::Code::INTERNAL,
+          "Parse warmup request failed, please check warmp file");
+    }
+    TF_RETURN_IF_ERROR(
+        parser->ParseRequest(request, &signature_info, (*calls)[i]));
+  }
+  return Status::OK();
+}
+
 void StringReplace(std::string& strBig, const std::string& strsrc,
                    const std::string& strdst) {
   std::string::size_type pos = 0;
@@ -224,6 +257,55 @@ std::string GetHashValue(const std::string& s) {
   return std::to_string(MurMurHash64(s));
 }
 
+// TensorRT converts the segments of the graph it supports, which leaves the
+// embedding lookups in TF, into engines built at runtime for each input
+// shape, during the warmup for the batch sizes replayed. XLA is enabled by
+// the SavedModelOptimizer instead, which marks the dense sub-graph.
+void SetDenseCompileOptions(ModelConfig* config, SessionOptions* options) {
+  if (config->dense_compile != "tensorrt") {
+    return;
+  }
+  auto* trt = options->config.mutable_graph_options()
+      ->mutable_rewrite_options()->add_custom_optimizers();
+  trt->set_name("TensorRTOptimizer");
+  auto& params = *trt->mutable_parameter_map();
+  params["is_dynamic_op"].set_b(true);
+  params["maximum_cached_engines"].set_i(config->dense_compile_max_shapes);
+  params["minimum_segment_size"].set_i(3);
+  params["precision_mode"].set_s("FP32");
+}
+
+// The processor joins the embedding servers as the task 0 of the serving
+// job, whose master runs the sessions, and the master partitions the graph
+// between the processor and the servers the embeddings are placed on.
+Status StartEmbeddingWorker(ModelConfig* config, SessionOptions* options,
+                            ServerInterface** worker) {
+  ServerDef server_def;
+  server_def.set_protocol(config->embedding_server_protocol);
+  server_def.set_job_name(GetServingJobName());
+  server_def.set_task_index(0);
+  *server_def.mutable_default_session_config() = options->config;
+
+  JobDef* worker_job = server_def.mutable_cluster()->add_job();
+  worker_job->set_name(GetServingJobName());
+  (*worker_job->mutable_tasks())[0] = config->embedding_worker_address;
+  JobDef* server_job = server_def.mutable_cluster()->add_job();
+  server_job->set_name(GetEmbeddingServerJobName());
+  for (size_t i = 0; i < config->embedding_servers.size(); ++i) {
+    (*server_job->mutable_tasks())[i] = config->embedding_servers[i];
+  }
+
+  std::unique_ptr<ServerInterface> server;
+  TF_RETURN_IF_ERROR(NewServer(server_def, &server));
+  TF_RETURN_IF_ERROR(server->Start());
+  options->target = server->target();
+  *worker = server.release();
+  LOG(INFO) << "[Model Instance] Serve with "
+            << config->embedding_servers.size()
+            << " embedding servers, target: " << options->target;
+  return Status::OK();
+}
+
 } // namespace
 
 LocalSessionInstance::LocalSessionInstance(
@@ -262,6 +344,8 @@ Status LocalSessionInstance::Init(ModelConfig* config,
         {kSavedModelTagServe}, &meta_graph_def_));
 
   warmup_file_name_ = config->warmup_file_name;
+  warmup_record_file_name_ = config->warmup_record_file_name;
+  warmup_budget_ms_ = config->warmup_budget_ms;
   parser_ = ParserFactory::GetInstance(config->serialize_protocol, 4);
 
   GraphOptimizerOption option;
@@ -277,10 +361,14 @@ Status LocalSessionInstance::Init(ModelConfig* config,
   option.st = config->storage_type;
   option.path = config->storage_path;
   option.size = config->storage_size;
+  option.quantize_dense = config->enable_int8_dense;
+  option.int8_calibration_steps = config->int8_calibration_steps;
+  option.int8_max_relative_error = config->int8_max_relative_error;
+  option.xla_dense = config->dense_compile == "xla";
+  option.embedding_server_count = config->embedding_servers.size();
 
-  optimizer_ = new SavedModelOptimizer(config->signature_name,
-      &meta_graph_def_, option);
-  TF_RETURN_IF_ERROR(optimizer_->Optimize());
+  TF_RETURN_IF_ERROR(OptimizeMetaGraphDef(config->signature_name, option,
+      config->optimized_graph_cache_dir, &meta_graph_def_));
 
   TF_RETURN_IF_ERROR(ReadModelSignature(config));
 
@@ -352,41 +440,28 @@ Status LocalSessionInstance::GetServingModelInfo(
 
 Status LocalSessionInstance::Warmup(
     ModelSession* warmup_session) {
-  if (warmup_file_name_.empty() &&
-      !ShouldWarmup(model_signature_.second)) {
-    return Status::OK();
-  }
-
-  LOG(INFO) << "Try to warmup model: " << warmup_file_name_;
-  Status s;
-  Call call;
-  if (warmup_file_name_.empty()) {
-    s = CreateWarmupParams(model_signature_.second, &call);
-  } else {
-    s = CreateWarmupParams(model_signature_.second,
-                           warmup_file_name_, &call,
-                           parser_, signature_info_);
-  }
+  std::vector<Call> calls;
+  Status s = CreateWarmupCalls(model_signature_.second,
+      warmup_file_name_, warmup_record_file_name_, parser_,
+      signature_info_, &calls);
   if (!s.ok()) {
     LOG(ERROR) << "Create warmup params failed, warmup will be canceled.";
     return s;
   }
+  if (calls.empty()) {
+    return Status::OK();
+  }
 
-  int left_try_count = WARMUP_COUNT;
-  while (left_try_count > 0) {
-    if (warmup_session) {
-      s = warmup_session->Warmup(
-          call.request, call.response);
-    } else {
-      s = session_mgr_->Warmup(
-          call.request, call.response);
-    }
-    if (!s.ok()) return s;
-
-    --left_try_count;
-    call.response.outputs.clear();
+  LOG(INFO) << "Try to warmup model with " << calls.size() << " requests.";
+  // A single request is repeated, the recorded requests run once.
+  const int passes = calls.size() == 1 ? WARMUP_COUNT : 1;
+  if (warmup_session) {
+    s = warmup_session->Warmup(calls, passes, warmup_budget_ms_);
+  } else {
+    s = session_mgr_->Warmup(calls, passes, warmup_budget_ms_);
   }
-  LOG(INFO) << "Warmup model successful: " << warmup_file_name_;
+  if (!s.ok()) return s;
+  LOG(INFO) << "Warmup model successful.";
 
   return Status::OK();
 }
@@ -445,6 +520,11 @@ Status LocalSessionInstance::DeltaModelUpdate(
   return Status::OK();
 }
 
+Status LocalSessionInstance::ApplyEmbeddingDelta(
+    const embedding::EmbeddingDeltaBatch& batch) {
+  return session_mgr_->ApplyEmbeddingDelta(batch);
+}
+
 RemoteSessionInstance::RemoteSessionInstance(
     SessionOptions* sess_options,
     RunOptions* run_options,
@@ -503,6 +583,8 @@ Status RemoteSessionInstance::Init(ModelConfig* model_config,
   backup_storage_ = new FeatureStoreMgr(&backup_model_config);
 
   warmup_file_name_ = model_config->warmup_file_name;
+  warmup_record_file_name_ = model_config->warmup_record_file_name;
+  warmup_budget_ms_ = model_config->warmup_budget_ms;
   parser_ = ParserFactory::GetInstance(model_config->serialize_protocol, 4);
 
   // set active flag
@@ -526,9 +608,12 @@ Status RemoteSessionInstance::Init(ModelConfig* model_config,
 
   GraphOptimizerOption option;
   option.native_tf_mode = false;
-  optimizer_ = new SavedModelOptimizer(model_config->signature_name,
-      &meta_graph_def_, option);
-  TF_RETURN_IF_ERROR(optimizer_->Optimize());
+  option.quantize_dense = model_config->enable_int8_dense;
+  option.int8_calibration_steps = model_config->int8_calibration_steps;
+  option.int8_max_relative_error = model_config->int8_max_relative_error;
+  option.xla_dense = model_config->dense_compile == "xla";
+  TF_RETURN_IF_ERROR(OptimizeMetaGraphDef(model_config->signature_name,
+      option, model_config->optimized_graph_cache_dir, &meta_graph_def_));
 
   session_mgr_ = new ModelSessionMgr(meta_graph_def_,
       session_options_, run_options_);
@@ -559,39 +644,28 @@ Status RemoteSessionInstance::GetServingModelInfo(
 
 Status RemoteSessionInstance::Warmup(
     ModelSession* warmup_session) {
-  if (warmup_file_name_.empty() &&
-      !ShouldWarmup(model_signature_.second)) {
-    return Status::OK();
-  }
-
-  Status s;
-  Call call;
-  if (warmup_file_name_.empty()) {
-    s = CreateWarmupParams(model_signature_.second, &call);
-  } else {
-    s = CreateWarmupParams(model_signature_.second,
-                           warmup_file_name_, &call,
-                           parser_, signature_info_);
-  }
+  std::vector<Call> calls;
+  Status s = CreateWarmupCalls(model_signature_.second,
+      warmup_file_name_, warmup_record_file_name_, parser_,
+      signature_info_, &calls);
   if (!s.ok()) {
     LOG(ERROR) << "Create warmup params failed, warmup will be canceled.";
     return s;
   }
+  if (calls.empty()) {
+    return Status::OK();
+  }
 
-  int left_try_count = WARMUP_COUNT;
-  while (left_try_count > 0) {
-    if (warmup_session) {
-      s = warmup_session->Warmup(
-          call.request, call.response, false);
-    } else {
-      s = session_mgr_->Warmup(
-          call.request, call.response, false);
-    }
-    if (!s.ok()) return s;
-
-    --left_try_count;
-    call.response.outputs.clear();
+  LOG(INFO) << "Try to warmup model with " << calls.size() << " requests.";
+  // A single request is repeated, the recorded requests run once.
+  const int passes = calls.size() == 1 ? WARMUP_COUNT : 1;
+  if (warmup_session) {
+    s = warmup_session->Warmup(calls, passes, warmup_budget_ms_, false);
+  } else {
+    s = session_mgr_->Warmup(calls, passes, warmup_budget_ms_, false);
   }
+  if (!s.ok()) return s;
+  LOG(INFO) << "Warmup model successful.";
 
   return Status::OK();
 }
@@ -662,11 +736,17 @@ LocalSessionInstanceMgr::LocalSessionInstanceMgr(ModelConfig* config)
         ->mutable_optimizer_options()
         ->set_device_placement_optimization(true);
   }
+  SetDenseCompileOptions(config, session_options_);
   run_options_ = new RunOptions();
 }
 
 LocalSessionInstanceMgr::~LocalSessionInstanceMgr() {
   is_stop_ = true;
+  if (delta_stream_thread_) {
+    delta_stream_thread_->join();
+    delete delta_stream_thread_;
+  }
+  delete delta_subscriber_;
 
   delete instance_;
   delete session_options_;
@@ -674,6 +754,10 @@ LocalSessionInstanceMgr::~LocalSessionInstanceMgr() {
 }
 
 Status LocalSessionInstanceMgr::Init() {
+  if (!model_config_->embedding_servers.empty()) {
+    TF_RETURN_IF_ERROR(StartEmbeddingWorker(model_config_,
+        session_options_, &embedding_worker_));
+  }
   instance_ = new LocalSessionInstance(session_options_, run_options_);
   TF_RETURN_IF_ERROR(instance_->Init(model_config_,
       model_store_));
@@ -683,9 +767,66 @@ Status LocalSessionInstanceMgr::Init() {
     thread_ = new std::thread(&ModelUpdater::WorkLoop, this);
   }
 
+  if (!model_config_->delta_stream_brokers.empty()) {
+    delta_subscriber_ = new embedding::EmbeddingDeltaSubscriber(
+        model_config_->delta_stream_brokers,
+        model_config_->delta_stream_topic,
+        model_config_->delta_stream_group);
+    TF_RETURN_IF_ERROR(delta_subscriber_->Init());
+    delta_stream_thread_ = new std::thread(
+        &LocalSessionInstanceMgr::DeltaStreamLoop, this);
+  }
+
   return Status::OK();
 }
 
+void LocalSessionInstanceMgr::DeltaStreamLoop() {
+  const int64 batch_keys = model_config_->delta_stream_batch_keys;
+  const int64 max_staleness_ms =
+      std::max(1, model_config_->delta_stream_max_staleness_ms);
+  std::vector<embedding::EmbeddingDeltaBatch> batches;
+  int64 buffered_keys = 0;
+  int64 oldest_ms = 0;
+  while (!is_stop_) {
+    embedding::EmbeddingDeltaBatch batch;
+    bool has_batch = false;
+    auto status = delta_subscriber_->Consume(
+        std::min<int64>(100, max_staleness_ms), &batch, &has_batch);
+    if (!status.ok()) {
+      LOG(WARNING) << "[Processor] Consume delta stream failed: "
+                   << status.error_message();
+    } else if (has_batch) {
+      if (batches.empty()) {
+        oldest_ms = NowMillis();
+      }
+      buffered_keys += batch.keys.size();
+      batches.emplace_back(std::move(batch));
+    }
+    if (batches.empty() ||
+        (buffered_keys < batch_keys &&
+         NowMillis() - oldest_ms < max_staleness_ms)) {
+      continue;
+    }
+
+    mutex_lock lock(update_mu_);
+    for (auto& b : batches) {
+      status = instance_->ApplyEmbeddingDelta(b);
+      if (!status.ok()) {
+        LOG(WARNING) << "[Processor] Apply delta stream of " << b.tensor_name
+                     << " failed: " << status.error_message();
+      } else {
+        VLOG(1) << "[Processor] Apply " << b.keys.size() << " rows of "
+                << b.tensor_name << ", delta_seq: " << b.delta_seq
+                << ", lag: "
+                << NowMillis() - b.timestamp_ms
+                << "ms";
+      }
+    }
+    batches.clear();
+    buffered_keys = 0;
+  }
+}
+
 Status LocalSessionInstanceMgr::Predict(Request& req, Response& resp) {
   return instance_->Predict(req, resp);
 }
@@ -713,12 +854,14 @@ const SignatureInfo* LocalSessionInstanceMgr::GetSignatureInfo() {
 
 Status LocalSessionInstanceMgr::FullModelUpdate(
     const Version& version, ModelConfig* model_config) {
+  mutex_lock lock(update_mu_);
   return instance_->FullModelUpdate(
       version, model_config);
 }
 
 Status LocalSessionInstanceMgr::DeltaModelUpdate(
     const Version& version, ModelConfig* model_config) {
+  mutex_lock lock(update_mu_);
   return instance_->DeltaModelUpdate(
       version, model_config);
 }
@@ -740,6 +883,7 @@ RemoteSessionInstanceMgr::RemoteSessionInstanceMgr(ModelConfig* config)
         ->mutable_optimizer_options()
         ->set_device_placement_optimization(true);
   }
+  SetDenseCompileOptions(config, session_options_);
   run_options_ = new RunOptions();
 
   std::unique_ptr<FeatureStoreMgr> tmp_storage(
@@ -2,6 +2,7 @@
 #define SERVING_PROCESSOR_SERVING_MODEL_INSTANCE_H
 
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/protobuf/meta_graph.pb.h"
 #include "serving/processor/framework/model_version.h"
 #include "serving/processor/serving/model_message.h"
@@ -16,8 +17,13 @@ class RunOptions;
 class Tensor;
 class TensorInfo;
 class Session;
+class ServerInterface;
+namespace embedding {
+class EmbeddingDeltaSubscriber;
+struct EmbeddingDeltaBatch;
+} // embedding
+
 namespace processor {
-class SavedModelOptimizer;
 class ModelStore;
 class ModelSession;
 class ModelSessionMgr;
@@ -45,6 +51,7 @@ class LocalSessionInstance {
                          ModelConfig* model_config);
   Status DeltaModelUpdate(const Version& version,
                           ModelConfig* model_config);
+  Status ApplyEmbeddingDelta(const embedding::EmbeddingDeltaBatch& batch);
  
  private:
   Status ReadModelSignature(ModelConfig* model_config);
@@ -62,12 +69,13 @@ class LocalSessionInstance {
   std::string signature_hash_value_;
 
   std::string warmup_file_name_;
+  std::string warmup_record_file_name_;
+  int64 warmup_budget_ms_ = 0;
   IParser* parser_ = nullptr;
 
   ModelSessionMgr* session_mgr_ = nullptr;
   SessionOptions* session_options_ = nullptr;
   RunOptions* run_options_ = nullptr;
-  SavedModelOptimizer* optimizer_ = nullptr;
   
   Version version_;
 };
@@ -113,12 +121,13 @@ class RemoteSessionInstance {
   std::string signature_hash_value_;
 
   std::string warmup_file_name_;
+  std::string warmup_record_file_name_;
+  int64 warmup_budget_ms_ = 0;
   IParser* parser_ = nullptr;
 
   ModelSessionMgr* session_mgr_ = nullptr;
   SessionOptions* session_options_ = nullptr;
   RunOptions* run_options_ = nullptr;
-  SavedModelOptimizer* optimizer_ = nullptr;
 
   IFeatureStoreMgr* serving_storage_ = nullptr;
   IFeatureStoreMgr* backup_storage_ = nullptr; 
@@ -186,11 +195,27 @@ class LocalSessionInstanceMgr : public ModelUpdater, public IModelInstanceMgr {
                           ModelConfig* model_config) override;
   Version GetVersion() override;
 
+ private:
+  // Applies the rows streamed by the trainer, see
+  // ModelConfig::delta_stream_brokers.
+  void DeltaStreamLoop();
+
  protected:
   LocalSessionInstance* instance_ = nullptr;
 
   SessionOptions* session_options_ = nullptr;
   RunOptions* run_options_ = nullptr;
+
+ private:
+  // Serializes the model updates and the streamed rows, the streamed rows
+  // are applied to the serving session of the latest full model.
+  mutex update_mu_;
+  embedding::EmbeddingDeltaSubscriber* delta_subscriber_ = nullptr;
+  std::thread* delta_stream_thread_ = nullptr;
+  // The server of the processor in the cluster of the embedding servers,
+  // see ModelConfig::embedding_servers. Not deleted, the servers of TF do
+  // not shut down cleanly, it lives until the process exits.
+  ServerInterface* embedding_worker_ = nullptr;
 };
 
 class RemoteSessionInstanceMgr : public ModelUpdater, public IModelInstanceMgr {
@@ -1,6 +1,7 @@
 #ifndef SERVING_PROCESSOR_SERVING_MODEL_MESSAGE_H
 #define SERVING_PROCESSOR_SERVING_MODEL_MESSAGE_H
 
+#include "serving/processor/framework/util/latency_stats.h"
 #include "tensorflow/core/lib/core/status.h"
 
 namespace tensorflow {
@@ -47,6 +48,8 @@ struct BatchCall {
 
 struct ServingModelInfo {
   std::string model_path;
+  // The latency breakdown of the requests served by the process.
+  std::vector<LatencySummary> latency;
 };
 
 } // processor
@@ -1,9 +1,14 @@
+#include <algorithm>
+
 #include "serving/processor/serving/model_impl.h"
 #include "serving/processor/serving/model_serving.h"
 #include "serving/processor/serving/model_config.h"
 #include "serving/processor/serving/model_message.h"
 #include "serving/processor/serving/message_coding.h"
+#include "serving/processor/serving/warmup_recorder.h"
+#include "serving/processor/framework/util/latency_stats.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 
 namespace tensorflow {
 namespace processor {
@@ -29,6 +34,19 @@ Status Model::Init(const char* model_config) {
 
   parser_ = ParserFactory::GetInstance(config->serialize_protocol,
       4);
+  thread_pool_.reset(new thread::ThreadPool(Env::Default(),
+      "model_process", std::max(config->process_threads, 1)));
+  LatencyStats::Global()->SetTraceInterval(config->latency_trace_interval);
+  if (!config->warmup_record_file_name.empty()) {
+    if (config->serialize_protocol == "protobuf") {
+      warmup_recorder_.reset(new WarmupRecorder(
+          config->warmup_record_file_name, config->warmup_record_interval,
+          config->warmup_record_max_requests));
+    } else {
+      LOG(WARNING) << "Warmup requests are only recorded with the protobuf "
+                   << "serialize_protocol.";
+    }
+  }
   impl_ = ModelImplFactory::Create(config);
 
   return impl_->Init();
@@ -36,6 +54,10 @@ Status Model::Init(const char* model_config) {
 
 Status Model::Predict(const void* input_data, int input_size,
     void** output_data, int* output_size) {
+  ScopedLatency latency(LatencyStage::TOTAL);
+  if (warmup_recorder_) {
+    warmup_recorder_->MaybeRecord(input_data, input_size);
+  }
   Call call;
   Status status = parser_->ParseRequestFromBuf(
       input_data, input_size, call,
@@ -54,19 +76,62 @@ Status Model::Predict(const void* input_data, int input_size,
   return status;
 }
 
-Status Model::BatchPredict(const void* input_data[], int* input_size,
-    void* output_data[], int* output_size) {
-  BatchCall call;
-  parser_->ParseBatchRequestFromBuf(input_data, input_size, call,
-                                    impl_->GetSignatureInfo());
-  auto status = Predict(call.batched_request, call.batched_response);
-  if (!status.ok()) {
-    return status;
+Status Model::BatchPredict(int input_num, const void* input_data[],
+    int* input_size, void* output_data[], int* output_size,
+    std::vector<Status>* statuses) {
+  const int64 start_us = Env::Default()->NowMicros();
+  if (warmup_recorder_) {
+    for (int i = 0; i < input_num; ++i) {
+      warmup_recorder_->MaybeRecord(input_data[i], input_size[i]);
+    }
+  }
+  std::vector<Call> calls;
+  TF_RETURN_IF_ERROR(parser_->ParseBatchRequestFromBuf(
+      input_num, input_data, input_size, calls, *statuses,
+      impl_->GetSignatureInfo()));
+
+  // The last request runs on the caller thread.
+  BlockingCounter counter(input_num);
+  const int64 schedule_us = Env::Default()->NowMicros();
+  for (int i = 0; i < input_num; ++i) {
+    auto run = [this, i, &calls, statuses, &counter, schedule_us]() {
+      LatencyStats::Global()->Record(LatencyStage::QUEUE,
+          Env::Default()->NowMicros() - schedule_us);
+      if ((*statuses)[i].ok()) {
+        (*statuses)[i] = Predict(calls[i].request, calls[i].response);
+      }
+      counter.DecrementCount();
+    };
+    if (i == input_num - 1) {
+      run();
+    } else {
+      thread_pool_->Schedule(run);
+    }
   }
+  counter.Wait();
 
-  parser_->ParseBatchResponseToBuf(call, output_data, output_size,
-                                   impl_->GetSignatureInfo());
-  return Status::OK();
+  Status status = parser_->ParseBatchResponseToBuf(calls, *statuses,
+      output_data, output_size, impl_->GetSignatureInfo());
+  const int64 total_us = Env::Default()->NowMicros() - start_us;
+  for (int i = 0; i < input_num; ++i) {
+    LatencyStats::Global()->Record(LatencyStage::TOTAL, total_us);
+  }
+  return status;
+}
+
+void Model::AsyncPredict(const void* input_data, int input_size,
+    DoneCallback done) {
+  const int64 schedule_us = Env::Default()->NowMicros();
+  thread_pool_->Schedule([this, input_data, input_size, done, schedule_us]() {
+    LatencyStats::Global()->Record(LatencyStage::QUEUE,
+        Env::Default()->NowMicros() - schedule_us);
+    void* output_data = nullptr;
+    int output_size = 0;
+    Status status = Predict(input_data, input_size,
+        &output_data, &output_size);
+    done(status, output_data, output_size);
+    delete[] static_cast<char*>(output_data);
+  });
 }
 
 Status Model::Predict(Request& req, Response& resp) {
@@ -80,6 +145,7 @@ Status Model::GetServingModelInfo(void* output_data[],
   if (!status.ok()) {
     return status;
   }
+  model_info.latency = LatencyStats::Global()->Summaries();
   parser_->ParseServingModelInfoToBuf(model_info, output_data, output_size);
   return Status::OK();
 }
@@ -1,7 +1,12 @@
 #ifndef SERVING_PROCESSOR_SERVING_MODEL_SERVING_H
 #define SERVING_PROCESSOR_SERVING_MODEL_SERVING_H
 
+#include <functional>
+#include <memory>
+#include <vector>
+
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 
 namespace tensorflow {
 class Tensor;
@@ -10,6 +15,7 @@ class ModelImpl;
 class Request;
 class Response;
 class IParser;
+class WarmupRecorder;
 class Model {
  public:
   Model(const std::string& model_entry);
@@ -23,8 +29,21 @@ class Model {
       void** output_data, int* output_size);
   Status Predict(Request& req, Response& resp);
   
-  Status BatchPredict(const void* input_data[], int* input_size,
-      void* output_data[], int* output_size);
+  // Decodes the input_num requests in parallel, runs them concurrently,
+  // so that request batching merges them into one session run, and
+  // encodes their responses in parallel. statuses[i] is the status of the
+  // ith request, output_data[i] is only set when it is ok.
+  Status BatchPredict(int input_num, const void* input_data[],
+      int* input_size, void* output_data[], int* output_size,
+      std::vector<Status>* statuses);
+
+  // Predicts on the process threads and calls done with the status and the
+  // response, which is freed after done returns. input_data must stay
+  // valid until then.
+  typedef std::function<void(const Status& status,
+      void* output_data, int output_size)> DoneCallback;
+  void AsyncPredict(const void* input_data, int input_size,
+      DoneCallback done);
 
   Status GetServingModelInfo(void* output_data[], int* output_size);
 
@@ -36,6 +55,11 @@ class Model {
   std::string model_entry_ = "";
   ModelImpl* impl_ = nullptr;
   IParser* parser_ = nullptr; // not owned
+  // Runs the requests of BatchPredict and AsyncPredict.
+  std::unique_ptr<thread::ThreadPool> thread_pool_;
+  // Records the requests to warm up the next model versions with, see
+  // ModelConfig::warmup_record_file_name.
+  std::unique_ptr<WarmupRecorder> warmup_recorder_;
 };
 
 } // processor
@@ -1,4 +1,5 @@
 #include <random>
+#include <unordered_set>
 #include "serving/processor/serving/model_session.h"
 #include "serving/processor/serving/model_message.h"
 #include "serving/processor/serving/tracer.h"
@@ -6,12 +7,16 @@
 #include "serving/processor/storage/model_store.h"
 #include "serving/processor/storage/feature_store_mgr.h"
 #include "serving/processor/framework/graph_optimizer.h"
+#include "serving/processor/framework/util/latency_stats.h"
 #include "tensorflow/cc/saved_model/loader.h"
 #include "tensorflow/cc/saved_model/tag_constants.h"
 #include "tensorflow/cc/saved_model/reader.h"
 #include "tensorflow/cc/saved_model/constants.h"
 #include "tensorflow/core/common_runtime/custom_thread_pool.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/kernels/embedding_delta_stream.h"
 #include "tensorflow/core/platform/protobuf_internal.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/util/tensor_bundle/naming.h"
@@ -137,12 +142,34 @@ static CustomThreadPoolImpl* GetModelUpdateIntraThreadPool(int num) {
   return tp;
 }
 
+// Records the graph time of a request run since 'start_us', and its embedding
+// and dense time when it was run with a software trace. The timeline of a
+// traced request whose graph time is an outlier is kept where the tracer
+// keeps its timelines.
+void RecordGraphLatency(int64 start_us, bool traced,
+                        RunMetadata& run_metadata) {
+  LatencyStats* stats = LatencyStats::Global();
+  const int64 graph_us = Env::Default()->NowMicros() - start_us;
+  stats->Record(LatencyStage::GRAPH, graph_us);
+  // A request merged into the batch of another one has no step stats.
+  if (!traced || run_metadata.step_stats().dev_stats_size() == 0) {
+    return;
+  }
+  stats->RecordStepStats(run_metadata.step_stats());
+  if (stats->IsOutlier(LatencyStage::GRAPH, graph_us) &&
+      Tracer::GetTracer()->HasTimelineLocation()) {
+    Tracer::GetTracer()->GenTimeline(run_metadata);
+  }
+}
+
 } // namespace
 
 ModelSessionMgr::ModelSessionMgr(const MetaGraphDef& meta_graph_def,
     SessionOptions* session_options, RunOptions* run_options) :
   meta_graph_def_(meta_graph_def), session_options_(session_options),
   run_options_(run_options) {
+  serving_readers_[0] = 0;
+  serving_readers_[1] = 0;
   clear_session_thread_ = new std::thread(&ModelSessionMgr::ClearLoop, this);
 }
 
@@ -353,6 +380,10 @@ Status ModelSession::InternalPredict(Request& req, Response& resp,
 
   req.inputs.emplace_back(sparse_storage_name_, sparse_storage_tensor_);
   req.inputs.emplace_back(model_version_name_, model_version_tensor_);
+  if (prefetcher_ != nullptr) {
+    TF_RETURN_IF_ERROR(prefetcher_->Prefetch(
+        model_version_tensor_.scalar<uint64>()(), &req.inputs));
+  }
   ++counter_;
   Status status;
   tensorflow::RunOptions run_options;
@@ -366,9 +397,13 @@ Status ModelSession::InternalPredict(Request& req, Response& resp,
         &run_metadata, sess_id);
     Tracer::GetTracer()->GenTimeline(run_metadata);
   } else {
-    status = session_group_->Run(run_options, req.inputs,
-		req.output_tensor_names, {}, &resp.outputs,
-		&run_metadata, sess_id);
+    const bool traced = LatencyStats::Global()->ShouldTrace();
+    if (traced) {
+      run_options.set_trace_level(tensorflow::RunOptions::SOFTWARE_TRACE);
+    }
+    const int64 start_us = Env::Default()->NowMicros();
+    status = RunSessionGroup(run_options, req, resp, &run_metadata, sess_id);
+    RecordGraphLatency(start_us, traced, run_metadata);
   }
   --counter_;
   return status;
@@ -406,39 +441,196 @@ Status ModelSession::InternalLocalPredict(Request& req,
         &run_metadata, sess_id);
     Tracer::GetTracer()->GenTimeline(run_metadata); 
   } else {
-    status = session_group_->Run(run_options, req.inputs,
-        req.output_tensor_names, {}, &resp.outputs,
-        &run_metadata, sess_id);
+    const bool traced = LatencyStats::Global()->ShouldTrace();
+    if (traced) {
+      run_options.set_trace_level(tensorflow::RunOptions::SOFTWARE_TRACE);
+    }
+    const int64 start_us = Env::Default()->NowMicros();
+    status = RunSessionGroup(run_options, req, resp, &run_metadata, sess_id);
+    RecordGraphLatency(start_us, traced, run_metadata);
   }
   --counter_;
   return status;
 }
 
-Status ModelSession::Warmup(Request& req, Response& resp, bool local) {
-  int N = session_group_->GetSessionNum();
-  for (int i = 0; i < N; ++i) {
-    Status s;
-    if (local) {
-      s = LocalPredict(req, resp, i);
-    } else {
-      s = Predict(req, resp, i);
+void ModelSession::EnableBatching(int max_batch_size,
+                                  int64 max_queue_delay_us) {
+  if (max_batch_size <= 1) {
+    return;
+  }
+  for (int i = 0; i < session_group_->GetSessionNum(); ++i) {
+    Session* sess = session_group_->GetSessionPtr(i)->get();
+    batchers_[sess].reset(
+        new RequestBatcher(sess, max_batch_size, max_queue_delay_us));
+    auto it = pipelines_.find(sess);
+    if (it != pipelines_.end()) {
+      batchers_[sess]->SetPipeline(it->second.get());
     }
-    if (!s.ok()) return s;
   }
+}
 
-  return Status::OK();
+void ModelSession::EnablePipelining(const GraphDef& graph_def,
+                                    int max_in_flight) {
+  if (max_in_flight <= 0) {
+    return;
+  }
+  std::vector<std::string> stage_tensor_names;
+  Status s = RequestPipeline::GetStageTensorNames(graph_def,
+                                                  &stage_tensor_names);
+  if (!s.ok() || stage_tensor_names.empty()) {
+    LOG(WARNING) << "[ModelSession] Disable request pipelining, "
+                 << "no compute graph boundary found. " << s.error_message();
+    return;
+  }
+  for (int i = 0; i < session_group_->GetSessionNum(); ++i) {
+    Session* sess = session_group_->GetSessionPtr(i)->get();
+    pipelines_[sess].reset(
+        new RequestPipeline(sess, stage_tensor_names, max_in_flight));
+    auto it = batchers_.find(sess);
+    if (it != batchers_.end()) {
+      it->second->SetPipeline(pipelines_[sess].get());
+    }
+  }
+}
+
+void ModelSession::EnableLookupPrefetch(const GraphDef& graph_def,
+                                        IFeatureStoreMgr* sparse_storage) {
+  if (!batchers_.empty() || splitter_ != nullptr) {
+    LOG(WARNING) << "[ModelSession] Disable lookup prefetch, "
+                 << "not supported with request batching or splitting.";
+    return;
+  }
+  std::vector<LookupPrefetcher::Lookup> lookups;
+  Status s = LookupPrefetcher::GetLookups(graph_def, &lookups);
+  if (!s.ok() || lookups.empty()) {
+    LOG(WARNING) << "[ModelSession] Disable lookup prefetch, "
+                 << "no lookup fed by the requests found. "
+                 << s.error_message();
+    return;
+  }
+  LOG(INFO) << "[ModelSession] Prefetch " << lookups.size()
+            << " lookups of the requests.";
+  prefetcher_.reset(new LookupPrefetcher(sparse_storage, lookups));
+}
+
+void ModelSession::EnableSplitting(int min_shard_rows, int max_shards) {
+  if (min_shard_rows <= 0 || session_group_->GetSessionNum() <= 1) {
+    return;
+  }
+  splitter_.reset(new RequestSplitter(session_group_->GetSessionNum(),
+                                      min_shard_rows, max_shards));
+}
+
+Status ModelSession::RunSessionGroup(const RunOptions& run_options,
+                                     Request& req, Response& resp,
+                                     RunMetadata* run_metadata,
+                                     int sess_id) {
+  int num_shards = 1;
+  if (splitter_ != nullptr && !splitting_failed_) {
+    num_shards = splitter_->NumShards(req, counter_);
+  }
+  if (num_shards > 1) {
+    // The shards run on consecutive sessions.
+    const int base_id = sess_id >= 0 ? sess_id : split_index_.fetch_add(1);
+    Status s = splitter_->Run(req, resp, num_shards,
+        [&](int shard,
+            const std::vector<std::pair<std::string, Tensor>>& inputs,
+            std::vector<Tensor>* outputs) {
+          RunMetadata shard_metadata;
+          if (run_metadata != nullptr) {
+            shard_metadata = *run_metadata;
+          }
+          return session_group_->Run(run_options, inputs,
+              req.output_tensor_names, {}, outputs, &shard_metadata,
+              base_id + shard);
+        });
+    if (!errors::IsUnimplemented(s)) {
+      return s;
+    }
+    LOG(WARNING) << "[ModelSession] Disable request splitting, "
+                 << s.error_message();
+    splitting_failed_ = true;
+    resp.outputs.clear();
+  }
+  if (batchers_.empty() && pipelines_.empty()) {
+    return session_group_->Run(run_options, req.inputs,
+        req.output_tensor_names, {}, &resp.outputs,
+        run_metadata, sess_id);
+  }
+  Session* sess = session_group_->GetSession(sess_id);
+  auto it = batchers_.find(sess);
+  if (it != batchers_.end()) {
+    return it->second->Run(run_options, req, resp, run_metadata);
+  }
+  auto pipeline = pipelines_.find(sess);
+  if (pipeline != pipelines_.end()) {
+    return pipeline->second->Run(run_options, req, resp, run_metadata);
+  }
+  return sess->Run(run_options, req.inputs, req.output_tensor_names, {},
+                   &resp.outputs, run_metadata);
+}
+
+Status ModelSession::Warmup(const std::vector<Call>& calls, int passes,
+                            int64 budget_ms, bool local) {
+  const int64 deadline_us = budget_ms > 0
+      ? Env::Default()->NowMicros() + budget_ms * 1000
+      : kint64max;
+  auto warmup_session = [this, &calls, passes, deadline_us,
+                         local](int sess_id) {
+    for (int pass = 0; pass < passes; ++pass) {
+      for (const auto& call : calls) {
+        if (Env::Default()->NowMicros() >= deadline_us) {
+          return Status::OK();
+        }
+        // Predict adds the inputs of the sparse storage to the request.
+        Request req = call.request;
+        Response resp;
+        TF_RETURN_IF_ERROR(local ? LocalPredict(req, resp, sess_id)
+                                 : Predict(req, resp, sess_id));
+      }
+    }
+    return Status::OK();
+  };
+
+  const int N = session_group_->GetSessionNum();
+  mutex mu;
+  Status status;
+  BlockingCounter counter(N);
+  for (int i = 0; i < N; ++i) {
+    Env::Default()->SchedClosure(
+        [&warmup_session, i, &mu, &status, &counter]() {
+      Status s = warmup_session(i);
+      {
+        mutex_lock lock(mu);
+        status.Update(s);
+      }
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  return status;
 }
 
 Status ModelSessionMgr::Predict(Request& req, Response& resp) {
-  return serving_model_session_->Predict(req, resp);
+  auto model_session = AcquireServingSession();
+  Status s = model_session->Predict(req, resp);
+  --model_session->counter_;
+  return s;
 }
 
 Status ModelSessionMgr::LocalPredict(Request& req, Response& resp) {
-  return serving_model_session_->LocalPredict(req, resp);
+  auto model_session = AcquireServingSession();
+  Status s = model_session->LocalPredict(req, resp);
+  --model_session->counter_;
+  return s;
 }
 
-Status ModelSessionMgr::Warmup(Request& req, Response& resp, bool local) {
-  return serving_model_session_->Warmup(req, resp, local);
+Status ModelSessionMgr::Warmup(const std::vector<Call>& calls, int passes,
+                               int64 budget_ms, bool local) {
+  auto model_session = AcquireServingSession();
+  Status s = model_session->Warmup(calls, passes, budget_ms, local);
+  --model_session->counter_;
+  return s;
 }
 
 Status ModelSessionMgr::CreateModelSession(
@@ -542,6 +734,18 @@ Status ModelSessionMgr::CreateModelSession(
   *new_model_session = new ModelSession(
       session_group, config->select_session_policy,
       version, sparse_storage, graph_hash_value);
+  (*new_model_session)->EnableBatching(config->batching_max_batch_size,
+      config->batching_max_queue_delay_us);
+  (*new_model_session)->EnableSplitting(config->split_min_shard_rows,
+      config->split_max_shards);
+  if (config->enable_device_placement_optimization) {
+    (*new_model_session)->EnablePipelining(meta_graph_def_.graph_def(),
+        config->pipeline_max_in_flight);
+  }
+  if (config->feature_store_prefetch) {
+    (*new_model_session)->EnableLookupPrefetch(meta_graph_def_.graph_def(),
+        sparse_storage);
+  }
 
   return Status::OK();
 }
@@ -578,6 +782,14 @@ Status ModelSessionMgr::CreateModelSession(
   auto new_model_session = new ModelSession(
       session_group, config->select_session_policy,
       version, graph_hash_value);
+  new_model_session->EnableBatching(config->batching_max_batch_size,
+      config->batching_max_queue_delay_us);
+  new_model_session->EnableSplitting(config->split_min_shard_rows,
+      config->split_max_shards);
+  if (config->enable_device_placement_optimization) {
+    new_model_session->EnablePipelining(meta_graph_def_.graph_def(),
+        config->pipeline_max_in_flight);
+  }
   ResetServingSession(new_model_session);
 
   return Status::OK();
@@ -616,12 +828,15 @@ Status ModelSessionMgr::CreateModelSession(
   std::vector<Session*> sessions;
   if (is_incr_ckpt) {
     // Use serving session to update delta model
-    sessions = serving_model_session_->GetLeaderSessions();
+    sessions = serving_model_session_.load()->GetLeaderSessions();
     restore_op_name =
         meta_graph_def_.incr_saver_def().restore_op_name();
   } else {
     TF_RETURN_IF_ERROR(CreateSessionGroup(&session_group, config));
     sessions = session_group->GetLeaderSessions();
+    ShareUnchangedEmbeddingVars(full_ckpt_name, graph_hash_value,
+                                config, sessions);
+    AdoptPublishedEmbeddingVars(full_ckpt_name, config, sessions);
   }
 
   thread::ThreadPoolOptions thread_opt = thread::ThreadPoolOptions();
@@ -642,8 +857,10 @@ Status ModelSessionMgr::CreateModelSession(
       bool init_create_handler = false;
       Session::CallableHandle* incr_restore_handler = nullptr;
       Session::CallableHandle* main_op_handler = nullptr;
-      incr_restore_handler = serving_model_session_->GetIncrRestoreHandler(session);
-      main_op_handler = serving_model_session_->GetMainOpHandler(session);
+      incr_restore_handler =
+          serving_model_session_.load()->GetIncrRestoreHandler(session);
+      main_op_handler =
+          serving_model_session_.load()->GetMainOpHandler(session);
       if (!incr_restore_handler || !main_op_handler) {
         init_create_handler = true;
       }
@@ -669,9 +886,9 @@ Status ModelSessionMgr::CreateModelSession(
       }
 
       if (init_create_handler) {
-        serving_model_session_->SetIncrRestoreHandler(
+        serving_model_session_.load()->SetIncrRestoreHandler(
             session, incr_restore_handler);
-        serving_model_session_->SetMainOpHandler(
+        serving_model_session_.load()->SetMainOpHandler(
             session, main_op_handler);
       }
     }
@@ -698,16 +915,96 @@ Status ModelSessionMgr::CreateModelSession(
   }
 
   if (!is_incr_ckpt) {
+    PublishEmbeddingVars(full_ckpt_name, config, sessions);
     *new_model_session = new ModelSession(
       session_group, config->select_session_policy,
       version, graph_hash_value);
+    (*new_model_session)->EnableBatching(config->batching_max_batch_size,
+        config->batching_max_queue_delay_us);
+    (*new_model_session)->EnableSplitting(config->split_min_shard_rows,
+        config->split_max_shards);
+    if (config->enable_device_placement_optimization) {
+      (*new_model_session)->EnablePipelining(meta_graph_def_.graph_def(),
+          config->pipeline_max_in_flight);
+    }
   } else {
-    serving_model_session_->UpdateVersion(version);
+    serving_model_session_.load()->UpdateVersion(version);
   }
 
   return Status::OK();
 }
 
+void ModelSessionMgr::ShareUnchangedEmbeddingVars(
+    const std::string& full_ckpt_name,
+    const std::string& graph_hash_value,
+    ModelConfig* config, const std::vector<Session*>& sessions) {
+  // Model updates are serialized, the serving session is not released
+  // before the new session replaces it.
+  auto prev_model_session = serving_model_session_.load();
+  if (!config->share_unchanged_embedding ||
+      prev_model_session == nullptr ||
+      prev_model_session->graph_hash_value_ != graph_hash_value) {
+    return;
+  }
+  const std::string prev_ckpt_name =
+      prev_model_session->GetVersion().full_ckpt_name;
+  if (prev_ckpt_name == full_ckpt_name) {
+    return;
+  }
+  auto prev_sessions = prev_model_session->GetLeaderSessions();
+  if (prev_sessions.size() != sessions.size()) {
+    return;
+  }
+  for (size_t i = 0; i < sessions.size(); ++i) {
+    int num_shared = 0;
+    Status s = util::ShareUnchangedEmbeddingVars(prev_ckpt_name,
+        full_ckpt_name, prev_sessions[i], sessions[i], &num_shared);
+    if (!s.ok()) {
+      // The EmbeddingVariables not shared are restored from full_ckpt_name.
+      LOG(WARNING) << "Failed to share the EmbeddingVariables of "
+                   << prev_ckpt_name << ": " << s.error_message();
+      return;
+    }
+  }
+}
+
+void ModelSessionMgr::AdoptPublishedEmbeddingVars(
+    const std::string& full_ckpt_name, ModelConfig* config,
+    const std::vector<Session*>& sessions) {
+  if (!config->share_embedding_across_models) {
+    return;
+  }
+  for (auto session : sessions) {
+    int num_shared = 0;
+    Status s = util::AdoptPublishedEmbeddingVars(full_ckpt_name, session,
+                                                 &num_shared);
+    if (!s.ok()) {
+      // The EmbeddingVariables not shared are restored from full_ckpt_name.
+      LOG(WARNING) << "Failed to share the EmbeddingVariables of the other "
+                   << "models: " << s.error_message();
+      return;
+    }
+  }
+}
+
+void ModelSessionMgr::PublishEmbeddingVars(
+    const std::string& full_ckpt_name, ModelConfig* config,
+    const std::vector<Session*>& sessions) {
+  if (!config->share_embedding_across_models) {
+    return;
+  }
+  for (auto session : sessions) {
+    int num_published = 0;
+    Status s = util::PublishEmbeddingVars(full_ckpt_name, session,
+                                          &num_published);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to publish the EmbeddingVariables of "
+                   << full_ckpt_name << ": " << s.error_message();
+      return;
+    }
+  }
+}
+
 Status ModelSessionMgr::CleanupModelSession() {
   mutex_lock lock(mu_);
   sessions_.erase(
@@ -724,12 +1021,34 @@ Status ModelSessionMgr::CleanupModelSession() {
   return Status::OK();
 }
 
+ModelSession* ModelSessionMgr::AcquireServingSession() {
+  auto& readers = serving_readers_[serving_epoch_.load() & 1];
+  ++readers;
+  auto model_session = serving_model_session_.load();
+  ++model_session->counter_;
+  --readers;
+  return model_session;
+}
+
+void ModelSessionMgr::WaitForServingReaders() {
+  // A reader may count itself in the epoch before the flip, the second
+  // flip waits for it.
+  for (int i = 0; i < 2; ++i) {
+    int64 epoch = serving_epoch_.fetch_add(1);
+    while (serving_readers_[epoch & 1].load() > 0) {
+      std::this_thread::yield();
+    }
+  }
+}
+
 void ModelSessionMgr::ResetServingSession(ModelSession* model_session) {
-  auto tmp = serving_model_session_;
-  serving_model_session_ = model_session;
+  auto tmp = serving_model_session_.exchange(model_session);
 
   if (tmp == nullptr) return;
 
+  // The readers got the previous session from now on hold its counter_.
+  WaitForServingReaders();
+
   if (tmp->counter_ > 0) {
     // TODO: free it in active object.
     mutex_lock lock(mu_);
@@ -739,10 +1058,46 @@ void ModelSessionMgr::ResetServingSession(ModelSession* model_session) {
   }
 }
 
+Status ModelSessionMgr::ApplyEmbeddingDelta(
+    const embedding::EmbeddingDeltaBatch& batch) {
+  auto model_session = AcquireServingSession();
+  // Leader sessions of a session group may share the devices.
+  std::unordered_set<ResourceMgr*> resource_mgrs;
+  for (auto session : model_session->GetLeaderSessions()) {
+    const DeviceMgr* device_mgr = nullptr;
+    Status s = session->LocalDeviceManager(&device_mgr);
+    if (!s.ok()) {
+      --model_session->counter_;
+      return s;
+    }
+    for (auto device : device_mgr->ListDevices()) {
+      resource_mgrs.insert(device->resource_manager());
+    }
+  }
+  bool applied = false;
+  Status status;
+  for (auto resource_mgr : resource_mgrs) {
+    Status s = embedding::ApplyEmbeddingDeltaBatch(resource_mgr, batch);
+    if (s.ok()) {
+      applied = true;
+    } else if (!errors::IsNotFound(s)) {
+      status = s;
+      break;
+    }
+  }
+  --model_session->counter_;
+  if (status.ok() && !applied) {
+    return errors::NotFound("No EmbeddingVariable ", batch.tensor_name,
+                            " in the serving model.");
+  }
+  return status;
+}
+
 Status ModelSessionMgr::GetServingModelInfo(
     tensorflow::processor::ServingModelInfo& model_info) {
-  model_info.model_path =
-      serving_model_session_->GetVersion().full_ckpt_name;
+  auto model_session = AcquireServingSession();
+  model_info.model_path = model_session->GetVersion().full_ckpt_name;
+  --model_session->counter_;
   return Status::OK();
 }
 
@@ -2,8 +2,12 @@
 #define SERVING_PROCESSOR_SERVING_MODEL_SESSION_H
 
 #include "serving/processor/framework/model_version.h"
+#include "serving/processor/serving/lookup_prefetcher.h"
 #include "serving/processor/serving/model_config.h"
 #include "serving/processor/serving/model_message.h"
+#include "serving/processor/serving/request_batcher.h"
+#include "serving/processor/serving/request_pipeline.h"
+#include "serving/processor/serving/request_splitter.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/protobuf/meta_graph.pb.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -18,6 +22,10 @@ class SessionGroup;
 class Session;
 class Tensor;
 
+namespace embedding {
+struct EmbeddingDeltaBatch;
+} // embedding
+
 namespace processor {
 class IFeatureStoreMgr;
 class Request;
@@ -41,7 +49,25 @@ struct ModelSession {
   Version GetVersion() {return version_;}
   void UpdateVersion(const Version& v) { version_ = v; }
   std::vector<Session*> GetLeaderSessions();
-  Status Warmup(Request& req, Response& resp, bool local=true);
+  // Runs the calls passes times on every session of the session group,
+  // the sessions in parallel, until budget_ms runs out when > 0.
+  Status Warmup(const std::vector<Call>& calls, int passes,
+                int64 budget_ms, bool local=true);
+  // Merges the concurrent requests of each session of the session group,
+  // see RequestBatcher. Disabled when max_batch_size <= 1.
+  void EnableBatching(int max_batch_size, int64 max_queue_delay_us);
+  // Splits the candidates of the large requests across the sessions of the
+  // session group, see RequestSplitter. Disabled when min_shard_rows <= 0.
+  void EnableSplitting(int min_shard_rows, int max_shards);
+  // Runs the requests of each session of the session group in two
+  // pipelined stages cut at the compute graph boundary of graph_def, see
+  // RequestPipeline. Disabled when max_in_flight <= 0.
+  void EnablePipelining(const GraphDef& graph_def, int max_in_flight);
+  // Reads the embeddings of each request from the remote sparse storage
+  // before its graph runs, see LookupPrefetcher. Not used with batching or
+  // splitting, which would have to merge or split the prefetched values.
+  void EnableLookupPrefetch(const GraphDef& graph_def,
+                            IFeatureStoreMgr* sparse_storage);
 
   Session::CallableHandle* GetIncrRestoreHandler(const Session* sess);
   Session::CallableHandle* GetMainOpHandler(const Session* sess);
@@ -76,10 +102,27 @@ struct ModelSession {
   std::unordered_map<const Session*, Session::CallableHandle*>
       main_op_handler_map;
 
+  // The pipelines of the sessions of session_group_, empty when
+  // pipelining is disabled.
+  std::unordered_map<Session*, std::unique_ptr<RequestPipeline>> pipelines_;
+  // The batchers of the sessions of session_group_, empty when batching
+  // is disabled.
+  std::unordered_map<Session*, std::unique_ptr<RequestBatcher>> batchers_;
+  // nullptr when splitting is disabled.
+  std::unique_ptr<RequestSplitter> splitter_;
+  // nullptr when the lookup prefetch is disabled.
+  std::unique_ptr<LookupPrefetcher> prefetcher_;
+  // Set when the outputs of the model can not be merged from the shards.
+  std::atomic<bool> splitting_failed_{false};
+  std::atomic<int> split_index_{0};
+
  private:
   int GetServingSessionId();
   Status InternalPredict(Request& req, Response& resp, int sess_id);
   Status InternalLocalPredict(Request& req, Response& resp, int sess_id);
+  Status RunSessionGroup(const RunOptions& run_options, Request& req,
+                         Response& resp, RunMetadata* run_metadata,
+                         int sess_id);
 };
 
 class ModelSessionMgr {
@@ -90,7 +133,8 @@ class ModelSessionMgr {
 
   Status Predict(Request& req, Response& resp);
   Status LocalPredict(Request& req, Response& resp);
-  Status Warmup(Request& req, Response& resp, bool local=true);
+  Status Warmup(const std::vector<Call>& calls, int passes,
+                int64 budget_ms, bool local=true);
 
   Status CreateModelSession(
       const Version& version,
@@ -129,6 +173,10 @@ class ModelSessionMgr {
 
   void ResetServingSession(ModelSession* model_session);
 
+  // Applies the streamed rows of a delta checkpoint to the
+  // EmbeddingVariables of the serving session.
+  Status ApplyEmbeddingDelta(const embedding::EmbeddingDeltaBatch& batch);
+
   Status GetServingModelInfo(
       tensorflow::processor::ServingModelInfo& model_info);
 
@@ -146,8 +194,40 @@ class ModelSessionMgr {
   
   void ClearLoop();
 
+  // Shares the unchanged EmbeddingVariables of the serving session with
+  // sessions, the leader sessions of the model version restoring
+  // full_ckpt_name, see util::ShareUnchangedEmbeddingVars.
+  void ShareUnchangedEmbeddingVars(const std::string& full_ckpt_name,
+                                   const std::string& graph_hash_value,
+                                   ModelConfig* config,
+                                   const std::vector<Session*>& sessions);
+
+  // Shares the EmbeddingVariables published by the other models of the
+  // process with sessions before full_ckpt_name is restored, and publishes
+  // the EmbeddingVariables of sessions once it is, see
+  // util::PublishEmbeddingVars.
+  void AdoptPublishedEmbeddingVars(const std::string& full_ckpt_name,
+                                   ModelConfig* config,
+                                   const std::vector<Session*>& sessions);
+  void PublishEmbeddingVars(const std::string& full_ckpt_name,
+                            ModelConfig* config,
+                            const std::vector<Session*>& sessions);
+
+  // Returns the serving session with its counter_ increased, the caller
+  // decreases the counter_ when done with the session.
+  ModelSession* AcquireServingSession();
+  // Waits for the readers which may have loaded the previous serving
+  // session but not increased its counter_ yet.
+  void WaitForServingReaders();
+
  protected:
-  ModelSession* serving_model_session_ = nullptr;
+  // Swapped by ResetServingSession without blocking the readers, see
+  // AcquireServingSession.
+  std::atomic<ModelSession*> serving_model_session_{nullptr};
+  // The readers of AcquireServingSession are counted in
+  // serving_readers_[serving_epoch_ & 1].
+  std::atomic<int64> serving_epoch_{0};
+  std::atomic<int64> serving_readers_[2];
 
   MetaGraphDef meta_graph_def_;
   SessionOptions* session_options_;
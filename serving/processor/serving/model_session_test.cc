@@ -198,7 +198,7 @@ class TestableModelSessionMgr : public ModelSessionMgr {
   }
 
   size_t GetModelSessionSize() {
-    if (serving_model_session_ != nullptr) {
+    if (serving_model_session_.load() != nullptr) {
       return sessions_.size() + 1;
     } else {
       return sessions_.size();
@@ -214,7 +214,7 @@ class TestableModelSessionMgr : public ModelSessionMgr {
   }
 
   void* GetServingSession() {
-    return serving_model_session_->GetLeaderSessions()[0];
+    return serving_model_session_.load()->GetLeaderSessions()[0];
   }
 
   Status RunRestoreOps(
@@ -47,41 +47,51 @@ int process(void* model_buf, const void* input_data, int input_size,
   return 200;
 }
 
-int batch_process(void* model_buf, const void* input_data[], int* input_size,
-                  void* output_data[], int* output_size) {
+int batch_process(void* model_buf, int input_num, const void* input_data[],
+                  int* input_size, void* output_data[], int* output_size) {
   auto model = static_cast<tensorflow::processor::Model*>(model_buf);
-  if (input_size == 0) {
-    auto model_str = model->DebugString();
-    *output_data = strndup(model_str.c_str(), model_str.length());
-    *output_size = model_str.length();
+  if (input_num <= 0) {
     return 200;
   }
 
-  auto status = model->BatchPredict(input_data, input_size,
-      output_data, output_size);
-  if (!status.ok()) {
+  std::vector<tensorflow::Status> statuses;
+  auto status = model->BatchPredict(input_num, input_data, input_size,
+      output_data, output_size, &statuses);
+  statuses.resize(input_num, status);
+  int state = 200;
+  for (int i = 0; i < input_num; ++i) {
+    if (status.ok() && statuses[i].ok()) {
+      continue;
+    }
     std::string errmsg = tensorflow::strings::StrCat(
         "[TensorFlow] Processor predict failed: ",
-        status.error_message());
-    *output_data = strndup(errmsg.c_str(), strlen(errmsg.c_str()));
-    *output_size = strlen(errmsg.c_str());
+        (status.ok() ? statuses[i] : status).error_message());
+    output_data[i] = strndup(errmsg.c_str(), strlen(errmsg.c_str()));
+    output_size[i] = strlen(errmsg.c_str());
     LOG(ERROR) << errmsg;
-    return 500;
+    state = 500;
   }
-  return 200;
+  return state;
 }
 
-// TODO: EAS has a higher priority to call async interface.
-//       Now we have no implementation of this async interface,
-//       this will block EAS to call sync interface.
-//
-//typedef void (*DoneCallback)(const char* output, int output_size,
-//    int64_t request_id, int finished, int error_code);
-//
-//void async_process(void* model_buf, const void* input_data,
-//    int input_size, int64_t request_id, DoneCallback done) {
-//  // TODO
-//}
+void async_process(void* model_buf, const void* input_data, int input_size,
+                   int64_t request_id, DoneCallback done) {
+  auto model = static_cast<tensorflow::processor::Model*>(model_buf);
+  model->AsyncPredict(input_data, input_size,
+      [request_id, done](const tensorflow::Status& status,
+                         void* output_data, int output_size) {
+    if (status.ok()) {
+      done(static_cast<const char*>(output_data), output_size,
+           request_id, 1, 200);
+      return;
+    }
+    std::string errmsg = tensorflow::strings::StrCat(
+        "[TensorFlow] Processor predict failed: ",
+        status.error_message());
+    LOG(ERROR) << errmsg;
+    done(errmsg.c_str(), errmsg.length(), request_id, 1, 500);
+  });
+}
 
 int get_serving_model_info(
     void* model_buf, void** output_data, int* output_size) {
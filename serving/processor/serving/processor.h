@@ -1,12 +1,26 @@
 #ifndef SERVING_PROCESSOR_SERVING_TF_PROCESSOR_H
 #define SERVING_PROCESSOR_SERVING_TF_PROCESSOR_H
 
+#include <stdint.h>
+
 extern "C" {
 void* initialize(const char* model_entry, const char* model_config, int* state);
 int process(void* model_buf, const void* input_data, int input_size,
             void** output_data, int* output_size);
-int batch_process(void* model_buf, const void* input_data[], int* input_size,
-                  void* output_data[], int* output_size);
+// Processes input_num requests, decoded and encoded in parallel and run
+// concurrently. output_data[i] is the response of the ith request, or its
+// error message when it failed, in which case 500 is returned.
+int batch_process(void* model_buf, int input_num, const void* input_data[],
+                  int* input_size, void* output_data[], int* output_size);
+
+// Called once with the response, or the error message when error_code is
+// not 200. output is freed when the callback returns.
+typedef void (*DoneCallback)(const char* output, int output_size,
+    int64_t request_id, int finished, int error_code);
+// Processes the request on the threads of the processor, input_data must
+// stay valid until done is called.
+void async_process(void* model_buf, const void* input_data, int input_size,
+                   int64_t request_id, DoneCallback done);
 int get_serving_model_info(void* model_buf, void** output_data, int* output_size);
 }
 #endif
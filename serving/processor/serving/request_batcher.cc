@@ -0,0 +1,232 @@
+#include "serving/processor/serving/request_batcher.h"
+#include "serving/processor/framework/util/latency_stats.h"
+#include "tensorflow/core/framework/tensor_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace processor {
+namespace {
+// Returns false when the inputs of req have no common 0th dimension.
+bool GetBatchSignature(const Request& req, std::string* signature,
+                       int64* rows) {
+  if (req.inputs.empty()) {
+    return false;
+  }
+  *rows = -1;
+  for (auto& input : req.inputs) {
+    const Tensor& t = input.second;
+    if (t.dims() < 1) {
+      return false;
+    }
+    if (*rows == -1) {
+      *rows = t.dim_size(0);
+    } else if (*rows != t.dim_size(0)) {
+      return false;
+    }
+    TensorShape row_shape = t.shape();
+    row_shape.RemoveDim(0);
+    strings::StrAppend(signature, input.first, ":", t.dtype(), ":",
+                       row_shape.DebugString(), ";");
+  }
+  for (auto& name : req.output_tensor_names) {
+    strings::StrAppend(signature, name, ";");
+  }
+  return *rows > 0;
+}
+} // namespace
+
+RequestBatcher::RequestBatcher(Session* session, int max_batch_size,
+                               int64 max_queue_delay_us)
+    : session_(session), max_batch_size_(max_batch_size),
+      max_queue_delay_us_(max_queue_delay_us) {}
+
+Status RequestBatcher::Run(const RunOptions& run_options, Request& req,
+                           Response& resp, RunMetadata* run_metadata) {
+  Task task;
+  task.request = &req;
+  task.response = &resp;
+  task.run_options = &run_options;
+  task.run_metadata = run_metadata;
+  if (!GetBatchSignature(req, &task.signature, &task.rows) ||
+      task.rows > max_batch_size_) {
+    return RunOne(&task);
+  }
+
+  {
+    mutex_lock lock(mu_);
+    task.enqueue_us = Env::Default()->NowMicros();
+    queue_.emplace_back(&task);
+    // Wakes the leader waiting for more rows.
+    cv_.notify_all();
+  }
+  while (true) {
+    std::vector<Task*> batch;
+    {
+      mutex_lock lock(mu_);
+      while (!task.done && (task.taken || has_leader_)) {
+        cv_.wait(lock);
+      }
+      if (task.done) {
+        break;
+      }
+      // The task is still queued, so the queue is not empty.
+      has_leader_ = true;
+      const int64 deadline_us =
+          queue_.front()->enqueue_us + max_queue_delay_us_;
+      while (CompatibleRows() < max_batch_size_) {
+        const int64 now_us = Env::Default()->NowMicros();
+        if (now_us >= deadline_us) {
+          break;
+        }
+        cv_.wait_for(lock, std::chrono::microseconds(deadline_us - now_us));
+      }
+      batch = TakeBatch();
+      has_leader_ = false;
+      const int64 now_us = Env::Default()->NowMicros();
+      for (auto t : batch) {
+        LatencyStats::Global()->Record(LatencyStage::BATCH_WAIT,
+                                       now_us - t->enqueue_us);
+      }
+      cv_.notify_all();
+    }
+
+    RunBatch(batch);
+
+    mutex_lock lock(mu_);
+    for (auto t : batch) {
+      t->done = true;
+    }
+    cv_.notify_all();
+  }
+  return task.status;
+}
+
+Status RequestBatcher::RunSession(
+    const RunOptions& run_options,
+    const std::vector<std::pair<std::string, Tensor>>& inputs,
+    const std::vector<std::string>& output_tensor_names,
+    std::vector<Tensor>* outputs, RunMetadata* run_metadata) {
+  if (pipeline_ != nullptr) {
+    return pipeline_->Run(run_options, inputs, output_tensor_names, outputs,
+                          run_metadata);
+  }
+  return session_->Run(run_options, inputs, output_tensor_names, {}, outputs,
+                       run_metadata);
+}
+
+Status RequestBatcher::RunOne(Task* task) {
+  return RunSession(*task->run_options, task->request->inputs,
+                    task->request->output_tensor_names,
+                    &task->response->outputs, task->run_metadata);
+}
+
+int64 RequestBatcher::CompatibleRows() {
+  const std::string& signature = queue_.front()->signature;
+  int64 rows = 0;
+  for (auto t : queue_) {
+    if (t->signature == signature) {
+      rows += t->rows;
+      if (rows >= max_batch_size_) {
+        break;
+      }
+    }
+  }
+  return rows;
+}
+
+std::vector<RequestBatcher::Task*> RequestBatcher::TakeBatch() {
+  const std::string signature = queue_.front()->signature;
+  std::vector<Task*> batch;
+  std::deque<Task*> rest;
+  int64 rows = 0;
+  for (auto t : queue_) {
+    if (t->signature == signature && rows + t->rows <= max_batch_size_) {
+      rows += t->rows;
+      t->taken = true;
+      batch.emplace_back(t);
+    } else {
+      rest.emplace_back(t);
+    }
+  }
+  queue_.swap(rest);
+  return batch;
+}
+
+void RequestBatcher::RunBatch(const std::vector<Task*>& batch) {
+  if (batch.size() == 1) {
+    batch[0]->status = RunOne(batch[0]);
+    return;
+  }
+
+  auto set_status = [&batch](const Status& s) {
+    for (auto t : batch) {
+      t->status = s;
+    }
+  };
+  const Request& first = *batch[0]->request;
+  std::vector<std::pair<std::string, Tensor>> inputs;
+  for (size_t i = 0; i < first.inputs.size(); ++i) {
+    std::vector<Tensor> parts;
+    parts.reserve(batch.size());
+    for (auto t : batch) {
+      parts.emplace_back(t->request->inputs[i].second);
+    }
+    Tensor merged;
+    Status s = tensor::Concat(parts, &merged);
+    if (!s.ok()) {
+      set_status(s);
+      return;
+    }
+    inputs.emplace_back(first.inputs[i].first, merged);
+  }
+
+  RunMetadata run_metadata;
+  if (batch[0]->run_metadata != nullptr) {
+    run_metadata = *batch[0]->run_metadata;
+  }
+  std::vector<Tensor> outputs;
+  Status s = RunSession(*batch[0]->run_options, inputs,
+                        first.output_tensor_names, &outputs, &run_metadata);
+  if (!s.ok()) {
+    set_status(s);
+    return;
+  }
+
+  std::vector<int64> rows;
+  int64 total_rows = 0;
+  for (auto t : batch) {
+    rows.emplace_back(t->rows);
+    total_rows += t->rows;
+  }
+  for (auto& output : outputs) {
+    if (output.dims() < 1 || output.dim_size(0) != total_rows) {
+      // The outputs are not rows of the inputs, e.g. a scalar.
+      LOG(WARNING) << "[RequestBatcher] Unable to split the output of shape "
+                   << output.shape().DebugString() << " of "
+                   << total_rows << " rows, run the requests one by one.";
+      for (auto t : batch) {
+        t->status = RunOne(t);
+      }
+      return;
+    }
+  }
+  for (auto t : batch) {
+    t->response->outputs.resize(outputs.size());
+  }
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    std::vector<Tensor> parts;
+    s = tensor::Split(outputs[i], rows, &parts);
+    if (!s.ok()) {
+      set_status(s);
+      return;
+    }
+    for (size_t j = 0; j < batch.size(); ++j) {
+      batch[j]->response->outputs[i] = parts[j];
+    }
+  }
+  set_status(Status::OK());
+}
+
+} // processor
+} // tensorflow
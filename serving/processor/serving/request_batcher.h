@@ -0,0 +1,79 @@
+#ifndef SERVING_PROCESSOR_SERVING_REQUEST_BATCHER_H
+#define SERVING_PROCESSOR_SERVING_REQUEST_BATCHER_H
+
+#include <deque>
+#include "serving/processor/serving/model_message.h"
+#include "serving/processor/serving/request_pipeline.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace processor {
+
+// Merges the concurrent requests of one session into one Session::Run.
+// The requests are compatible when they have the same input names, dtypes
+// and shapes except the 0th dimension, and the same output names. The
+// inputs of the compatible requests are concatenated along the 0th
+// dimension, and the outputs are split back by the rows of the requests.
+//
+// The thread of the first queued request waits until max_batch_size rows
+// are queued or the request waits max_queue_delay_us, then runs the batch
+// while the requests queued later elect the next thread, so several
+// batches of a session may run at the same time.
+class RequestBatcher {
+ public:
+  RequestBatcher(Session* session, int max_batch_size,
+                 int64 max_queue_delay_us);
+
+  // Runs req in a batch, falls back to running it alone when its inputs
+  // have no common 0th dimension or it has more than max_batch_size rows.
+  Status Run(const RunOptions& run_options, Request& req, Response& resp,
+             RunMetadata* run_metadata);
+
+  // Runs the batches through pipeline instead of the session, not owned.
+  void SetPipeline(RequestPipeline* pipeline) { pipeline_ = pipeline; }
+
+ private:
+  struct Task {
+    Request* request = nullptr;
+    Response* response = nullptr;
+    const RunOptions* run_options = nullptr;
+    RunMetadata* run_metadata = nullptr;
+    std::string signature;
+    int64 rows = 0;
+    int64 enqueue_us = 0;
+    // Taken in a batch by TakeBatch.
+    bool taken = false;
+    bool done = false;
+    Status status;
+  };
+
+  Status RunSession(const RunOptions& run_options,
+                    const std::vector<std::pair<std::string, Tensor>>& inputs,
+                    const std::vector<std::string>& output_tensor_names,
+                    std::vector<Tensor>* outputs, RunMetadata* run_metadata);
+  Status RunOne(Task* task);
+  void RunBatch(const std::vector<Task*>& batch);
+  // Takes the first queued task and the queued tasks compatible with it,
+  // at most max_batch_size_ rows.
+  std::vector<Task*> TakeBatch() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  int64 CompatibleRows() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  Session* session_;
+  RequestPipeline* pipeline_ = nullptr;
+  const int max_batch_size_;
+  const int64 max_queue_delay_us_;
+
+  mutex mu_;
+  condition_variable cv_;
+  std::deque<Task*> queue_ GUARDED_BY(mu_);
+  bool has_leader_ GUARDED_BY(mu_) = false;
+};
+
+} // processor
+} // tensorflow
+
+#endif // SERVING_PROCESSOR_SERVING_REQUEST_BATCHER_H
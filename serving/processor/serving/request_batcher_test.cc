@@ -0,0 +1,124 @@
+#include <thread>
+#include "gtest/gtest.h"
+#include "serving/processor/serving/request_batcher.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace processor {
+namespace {
+// Returns the inputs named by the output names.
+class EchoSession : public Session {
+ public:
+  Status Create(const GraphDef& graph) override {
+    return Status::OK();
+  }
+
+  Status Extend(const GraphDef& graph) override {
+    return Status::OK();
+  }
+
+  Status Run(const std::vector<std::pair<string, Tensor> >& inputs,
+             const std::vector<string>& output_tensor_names,
+             const std::vector<string>& target_node_names,
+             std::vector<Tensor>* outputs) override {
+    return Run(RunOptions(), inputs, output_tensor_names,
+               target_node_names, outputs, nullptr);
+  }
+
+  Status Run(const RunOptions& run_options,
+             const std::vector<std::pair<string, Tensor> >& inputs,
+             const std::vector<string>& output_tensor_names,
+             const std::vector<string>& target_node_names,
+             std::vector<Tensor>* outputs, RunMetadata* run_metadata) override {
+    ++num_runs;
+    outputs->clear();
+    for (auto& name : output_tensor_names) {
+      for (auto& input : inputs) {
+        if (input.first == name) {
+          outputs->emplace_back(input.second);
+        }
+      }
+    }
+    return Status::OK();
+  }
+
+  Status ListDevices(std::vector<DeviceAttributes>* response) override {
+    return Status::OK();
+  }
+
+  Status Close() override {
+    return Status::OK();
+  }
+
+  std::atomic<int> num_runs{0};
+};
+
+Request CreateRequest(int64 rows, float value) {
+  Request req;
+  Tensor t(DT_FLOAT, TensorShape({rows, 3}));
+  t.flat<float>().setConstant(value);
+  req.inputs.emplace_back("x", t);
+  req.output_tensor_names.emplace_back("x");
+  return req;
+}
+} // namespace
+
+class RequestBatcherTest : public ::testing::Test {
+};
+
+TEST_F(RequestBatcherTest, ShouldMergeConcurrentRequests) {
+  EchoSession session;
+  // The batch is full once the 4 requests of 2 rows are queued.
+  RequestBatcher batcher(&session, 8, 10 * 1000 * 1000);
+  std::vector<Request> requests;
+  std::vector<Response> responses(4);
+  std::vector<Status> status(4);
+  for (int i = 0; i < 4; ++i) {
+    requests.emplace_back(CreateRequest(2, i));
+  }
+  RunOptions run_options;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&, i]() {
+      status[i] = batcher.Run(run_options, requests[i], responses[i],
+                              nullptr);
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(1, session.num_runs);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(status[i].ok());
+    ASSERT_EQ(1, responses[i].outputs.size());
+    test::ExpectTensorEqual<float>(requests[i].inputs[0].second,
+                                   responses[i].outputs[0]);
+  }
+}
+
+TEST_F(RequestBatcherTest, ShouldRunAloneWhenNotBatchable) {
+  EchoSession session;
+  RequestBatcher batcher(&session, 8, 1000);
+  RunOptions run_options;
+
+  // More rows than max_batch_size.
+  Request large = CreateRequest(16, 1);
+  Response large_resp;
+  EXPECT_TRUE(batcher.Run(run_options, large, large_resp, nullptr).ok());
+  test::ExpectTensorEqual<float>(large.inputs[0].second,
+                                 large_resp.outputs[0]);
+
+  // Scalar input.
+  Request scalar;
+  scalar.inputs.emplace_back("x", test::AsScalar<float>(2));
+  scalar.output_tensor_names.emplace_back("x");
+  Response scalar_resp;
+  EXPECT_TRUE(batcher.Run(run_options, scalar, scalar_resp, nullptr).ok());
+  test::ExpectTensorEqual<float>(scalar.inputs[0].second,
+                                 scalar_resp.outputs[0]);
+  EXPECT_EQ(2, session.num_runs);
+}
+
+} // processor
+} // tensorflow
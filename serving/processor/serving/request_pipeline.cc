@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <set>
+#include <unordered_set>
+#include "serving/processor/serving/request_pipeline.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/graph_constructor.h"
+#include "tensorflow/core/graph/graph_util.h"
+#include "tensorflow/core/graph/tensor_id.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace processor {
+
+RequestPipeline::RequestPipeline(
+    Session* session, const std::vector<std::string>& stage_tensor_names,
+    int max_in_flight)
+    : session_(session),
+      stage_tensor_names_(stage_tensor_names),
+      max_in_flight_(std::max(max_in_flight, 1)) {
+  for (const auto& name : stage_tensor_names_) {
+    stage_tensor_ids_.insert(ParseTensorName(name).ToString());
+  }
+}
+
+void RequestPipeline::Enter(Stage stage) {
+  mutex_lock lock(mu_);
+  const int64 ticket = next_ticket_[stage]++;
+  while (ticket != serving_ticket_[stage] ||
+         in_flight_[stage] >= max_in_flight_) {
+    cv_.wait(lock);
+  }
+  ++serving_ticket_[stage];
+  ++in_flight_[stage];
+  // The next request may enter the stage too.
+  cv_.notify_all();
+}
+
+void RequestPipeline::Exit(Stage stage) {
+  mutex_lock lock(mu_);
+  --in_flight_[stage];
+  cv_.notify_all();
+}
+
+Status RequestPipeline::Run(const RunOptions& run_options, Request& req,
+                            Response& resp, RunMetadata* run_metadata) {
+  return Run(run_options, req.inputs, req.output_tensor_names,
+             &resp.outputs, run_metadata);
+}
+
+Status RequestPipeline::Run(
+    const RunOptions& run_options,
+    const std::vector<std::pair<std::string, Tensor>>& inputs,
+    const std::vector<std::string>& output_tensor_names,
+    std::vector<Tensor>* outputs, RunMetadata* run_metadata) {
+  std::vector<Tensor> stage_tensors;
+  RunMetadata stage_metadata;
+  Enter(kEmbedding);
+  Status s = session_->Run(run_options, inputs, stage_tensor_names_, {},
+                           &stage_tensors, &stage_metadata);
+  Exit(kEmbedding);
+  TF_RETURN_IF_ERROR(s);
+
+  // The inputs which are not cut off by the stage tensors are fed again.
+  std::vector<std::pair<std::string, Tensor>> dense_inputs;
+  dense_inputs.reserve(stage_tensors.size() + inputs.size());
+  for (size_t i = 0; i < stage_tensors.size(); ++i) {
+    dense_inputs.emplace_back(stage_tensor_names_[i], stage_tensors[i]);
+  }
+  for (const auto& input : inputs) {
+    if (stage_tensor_ids_.count(ParseTensorName(input.first).ToString()) ==
+        0) {
+      dense_inputs.emplace_back(input);
+    }
+  }
+
+  Enter(kDense);
+  s = session_->Run(run_options, dense_inputs, output_tensor_names, {},
+                    outputs, run_metadata);
+  Exit(kDense);
+  if (s.ok() && run_metadata != nullptr) {
+    run_metadata->mutable_step_stats()->MergeFrom(
+        stage_metadata.step_stats());
+  }
+  return s;
+}
+
+Status RequestPipeline::GetStageTensorNames(
+    const GraphDef& graph_def, std::vector<std::string>* names) {
+  Graph graph(OpRegistry::Global());
+  GraphConstructorOptions options;
+  TF_RETURN_IF_ERROR(ConvertGraphDefToGraph(options, graph_def, &graph));
+  std::unordered_set<Node*> boundary_nodes;
+  graph_util::GetComputeGraphBoundaryNodes(&graph, boundary_nodes);
+
+  std::set<std::string> unique_names;
+  for (Node* n : boundary_nodes) {
+    if (!n->IsOp()) {
+      continue;
+    }
+    for (const Edge* e : n->out_edges()) {
+      if (!e->IsControlEdge()) {
+        unique_names.insert(strings::StrCat(n->name(), ":", e->src_output()));
+      }
+    }
+  }
+  names->assign(unique_names.begin(), unique_names.end());
+  return Status::OK();
+}
+
+} // processor
+} // tensorflow
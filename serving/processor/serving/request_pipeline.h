@@ -0,0 +1,69 @@
+#ifndef SERVING_PROCESSOR_SERVING_REQUEST_PIPELINE_H
+#define SERVING_PROCESSOR_SERVING_REQUEST_PIPELINE_H
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "serving/processor/serving/model_message.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace processor {
+
+// Runs the requests of one session in two stages, so that the dense stage
+// of a request on the GPU overlaps with the input and embedding stage of
+// the next request on the CPU.
+//
+// With the device placement optimization, the nodes in front of the
+// compute graph boundary run on the CPU. The first stage fetches the
+// boundary tensors, the second stage feeds them and fetches the outputs of
+// the request. At most max_in_flight requests of a session run each stage
+// at the same time, the others wait for the stage in order.
+class RequestPipeline {
+ public:
+  RequestPipeline(Session* session,
+                  const std::vector<std::string>& stage_tensor_names,
+                  int max_in_flight);
+
+  Status Run(const RunOptions& run_options, Request& req, Response& resp,
+             RunMetadata* run_metadata);
+  // Like Session::Run without targets.
+  Status Run(const RunOptions& run_options,
+             const std::vector<std::pair<std::string, Tensor>>& inputs,
+             const std::vector<std::string>& output_tensor_names,
+             std::vector<Tensor>* outputs, RunMetadata* run_metadata);
+
+  // The tensors between the two stages of graph_def: the outputs of the
+  // compute graph boundary nodes, see
+  // graph_util::GetComputeGraphBoundaryNodes.
+  static Status GetStageTensorNames(const GraphDef& graph_def,
+                                    std::vector<std::string>* names);
+
+ private:
+  enum Stage { kEmbedding = 0, kDense = 1, kNumStages = 2 };
+
+  void Enter(Stage stage);
+  void Exit(Stage stage);
+
+  Session* session_;
+  const std::vector<std::string> stage_tensor_names_;
+  std::unordered_set<std::string> stage_tensor_ids_;
+  const int max_in_flight_;
+
+  mutex mu_;
+  condition_variable cv_;
+  // The requests running each stage, and the tickets which order the
+  // requests waiting for it.
+  int in_flight_[kNumStages] GUARDED_BY(mu_) = {0, 0};
+  int64 next_ticket_[kNumStages] GUARDED_BY(mu_) = {0, 0};
+  int64 serving_ticket_[kNumStages] GUARDED_BY(mu_) = {0, 0};
+};
+
+} // processor
+} // tensorflow
+
+#endif // SERVING_PROCESSOR_SERVING_REQUEST_PIPELINE_H
@@ -0,0 +1,136 @@
+#include <thread>
+#include "gtest/gtest.h"
+#include "serving/processor/serving/request_pipeline.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace processor {
+namespace {
+// Returns the fed tensors of the fetched names, and a scalar for the
+// fetched names which are not fed.
+class StageSession : public Session {
+ public:
+  Status Create(const GraphDef& graph) override {
+    return Status::OK();
+  }
+
+  Status Extend(const GraphDef& graph) override {
+    return Status::OK();
+  }
+
+  Status Run(const std::vector<std::pair<string, Tensor> >& inputs,
+             const std::vector<string>& output_tensor_names,
+             const std::vector<string>& target_node_names,
+             std::vector<Tensor>* outputs) override {
+    return Run(RunOptions(), inputs, output_tensor_names,
+               target_node_names, outputs, nullptr);
+  }
+
+  Status Run(const RunOptions& run_options,
+             const std::vector<std::pair<string, Tensor> >& inputs,
+             const std::vector<string>& output_tensor_names,
+             const std::vector<string>& target_node_names,
+             std::vector<Tensor>* outputs, RunMetadata* run_metadata) override {
+    std::vector<string> input_names;
+    for (auto& input : inputs) {
+      input_names.emplace_back(input.first);
+    }
+    {
+      mutex_lock lock(mu);
+      feeds.emplace_back(input_names);
+      fetches.emplace_back(output_tensor_names);
+    }
+    outputs->clear();
+    for (auto& name : output_tensor_names) {
+      Tensor output = test::AsScalar<float>(1);
+      for (auto& input : inputs) {
+        if (input.first == name) {
+          output = input.second;
+        }
+      }
+      outputs->emplace_back(output);
+    }
+    return Status::OK();
+  }
+
+  Status ListDevices(std::vector<DeviceAttributes>* response) override {
+    return Status::OK();
+  }
+
+  Status Close() override {
+    return Status::OK();
+  }
+
+  mutex mu;
+  std::vector<std::vector<string>> feeds;
+  std::vector<std::vector<string>> fetches;
+};
+} // namespace
+
+class RequestPipelineTest : public ::testing::Test {
+};
+
+TEST_F(RequestPipelineTest, ShouldCutTheGraphAtTheComputeBoundary) {
+  GraphDef graph_def;
+  ASSERT_TRUE(protobuf::TextFormat::ParseFromString(R"(
+      node { name: "x" op: "Placeholder" attr { key: "dtype" value { type: DT_FLOAT } } }
+      node { name: "y" op: "Square" input: "x" attr { key: "T" value { type: DT_FLOAT } } }
+      node { name: "v" op: "VarHandleOp"
+             attr { key: "dtype" value { type: DT_FLOAT } }
+             attr { key: "shape" value { shape { } } } }
+      node { name: "r" op: "ReadVariableOp" input: "v"
+             attr { key: "dtype" value { type: DT_FLOAT } } }
+      node { name: "m" op: "Mul" input: "y" input: "r"
+             attr { key: "T" value { type: DT_FLOAT } } }
+      )", &graph_def));
+
+  std::vector<std::string> names;
+  EXPECT_TRUE(RequestPipeline::GetStageTensorNames(graph_def, &names).ok());
+  EXPECT_EQ(std::vector<std::string>({"y:0"}), names);
+}
+
+TEST_F(RequestPipelineTest, ShouldFeedTheStageTensorsToTheDenseStage) {
+  StageSession session;
+  RequestPipeline pipeline(&session, {"y:0", "x:0"}, 1);
+  Request req;
+  req.inputs.emplace_back("x", test::AsScalar<float>(2));
+  req.inputs.emplace_back("z", test::AsScalar<float>(3));
+  req.output_tensor_names.emplace_back("z");
+  Response resp;
+  EXPECT_TRUE(pipeline.Run(RunOptions(), req, resp, nullptr).ok());
+
+  ASSERT_EQ(2, session.fetches.size());
+  EXPECT_EQ(std::vector<string>({"y:0", "x:0"}), session.fetches[0]);
+  // x is fed by the stage tensor x:0 only.
+  EXPECT_EQ(std::vector<string>({"y:0", "x:0", "z"}), session.feeds[1]);
+  ASSERT_EQ(1, resp.outputs.size());
+  test::ExpectTensorEqual<float>(test::AsScalar<float>(3), resp.outputs[0]);
+}
+
+TEST_F(RequestPipelineTest, ShouldRunConcurrentRequests) {
+  StageSession session;
+  RequestPipeline pipeline(&session, {"y:0"}, 2);
+  std::vector<std::thread> threads;
+  std::vector<Status> status(8);
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&, i]() {
+      Request req;
+      req.inputs.emplace_back("x", test::AsScalar<float>(i));
+      req.output_tensor_names.emplace_back("m");
+      Response resp;
+      status[i] = pipeline.Run(RunOptions(), req, resp, nullptr);
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (auto& s : status) {
+    EXPECT_TRUE(s.ok());
+  }
+  EXPECT_EQ(16, session.fetches.size());
+}
+
+} // processor
+} // tensorflow
@@ -0,0 +1,114 @@
+#include "serving/processor/serving/request_splitter.h"
+#include "tensorflow/core/framework/tensor_util.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace processor {
+
+RequestSplitter::RequestSplitter(int num_sessions, int min_shard_rows,
+                                 int max_shards)
+    : num_sessions_(num_sessions), min_shard_rows_(min_shard_rows),
+      max_shards_(max_shards > 0 ? max_shards : num_sessions) {
+  if (num_sessions_ > 1) {
+    // The calling thread runs the first shard.
+    thread_pool_.reset(new thread::ThreadPool(Env::Default(),
+        "request_splitter", num_sessions_ - 1));
+  }
+}
+
+int64 RequestSplitter::CandidateRows(const Request& req) {
+  int64 rows = 0;
+  for (auto& input : req.inputs) {
+    if (input.second.dims() >= 1) {
+      rows = std::max(rows, input.second.dim_size(0));
+    }
+  }
+  return rows;
+}
+
+int RequestSplitter::NumShards(const Request& req, int64 inflight) const {
+  if (thread_pool_ == nullptr || min_shard_rows_ <= 0) {
+    return 1;
+  }
+  int64 num_shards = std::min<int64>(
+      std::min(num_sessions_, max_shards_),
+      CandidateRows(req) / min_shard_rows_);
+  // The idle sessions are shared by the inflight requests.
+  if (inflight > 1) {
+    num_shards = std::min<int64>(num_shards,
+        std::max<int64>(1, num_sessions_ / inflight));
+  }
+  return std::max<int64>(1, num_shards);
+}
+
+Status RequestSplitter::Run(const Request& req, Response& resp,
+                            int num_shards, const ShardRunner& runner) {
+  const int64 rows = CandidateRows(req);
+  std::vector<std::vector<std::pair<std::string, Tensor>>> shard_inputs(
+      num_shards);
+  std::vector<int64> shard_rows(num_shards);
+  int64 start = 0;
+  for (int i = 0; i < num_shards; ++i) {
+    shard_rows[i] = rows / num_shards + (i < rows % num_shards ? 1 : 0);
+    const int64 limit = start + shard_rows[i];
+    for (auto& input : req.inputs) {
+      const Tensor& t = input.second;
+      if (t.dims() < 1 || t.dim_size(0) != rows) {
+        shard_inputs[i].emplace_back(input);
+        continue;
+      }
+      // Slice shares the buffer, but may be not aligned for Eigen.
+      Tensor slice = t.Slice(start, limit);
+      if (!slice.IsAligned()) {
+        slice = tensor::DeepCopy(slice);
+      }
+      shard_inputs[i].emplace_back(input.first, slice);
+    }
+    start = limit;
+  }
+
+  std::vector<std::vector<Tensor>> shard_outputs(num_shards);
+  std::vector<Status> status(num_shards);
+  BlockingCounter counter(num_shards - 1);
+  for (int i = 1; i < num_shards; ++i) {
+    thread_pool_->Schedule([&, i]() {
+      status[i] = runner(i, shard_inputs[i], &shard_outputs[i]);
+      counter.DecrementCount();
+    });
+  }
+  status[0] = runner(0, shard_inputs[0], &shard_outputs[0]);
+  counter.Wait();
+  for (auto& s : status) {
+    TF_RETURN_IF_ERROR(s);
+  }
+
+  const size_t num_outputs = shard_outputs[0].size();
+  for (int i = 0; i < num_shards; ++i) {
+    if (shard_outputs[i].size() != num_outputs) {
+      return errors::Internal("The shards of the request have ",
+                              shard_outputs[0].size(), " and ",
+                              shard_outputs[i].size(), " outputs.");
+    }
+    for (auto& output : shard_outputs[i]) {
+      if (output.dims() < 1 || output.dim_size(0) != shard_rows[i]) {
+        return errors::Unimplemented("Unable to merge the output of shape ",
+            output.shape().DebugString(), " of ", shard_rows[i],
+            " candidates.");
+      }
+    }
+  }
+  resp.outputs.resize(num_outputs);
+  for (size_t j = 0; j < num_outputs; ++j) {
+    std::vector<Tensor> parts;
+    parts.reserve(num_shards);
+    for (int i = 0; i < num_shards; ++i) {
+      parts.emplace_back(shard_outputs[i][j]);
+    }
+    TF_RETURN_IF_ERROR(tensor::Concat(parts, &resp.outputs[j]));
+  }
+  return Status::OK();
+}
+
+} // processor
+} // tensorflow
@@ -0,0 +1,52 @@
+#ifndef SERVING_PROCESSOR_SERVING_REQUEST_SPLITTER_H
+#define SERVING_PROCESSOR_SERVING_REQUEST_SPLITTER_H
+
+#include <functional>
+#include "serving/processor/serving/model_message.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+
+namespace tensorflow {
+namespace processor {
+
+// Splits the candidates of a large request into shards run concurrently
+// on different sessions of a session group. The candidate inputs are the
+// inputs with the largest 0th dimension, they are sliced along the 0th
+// dimension while the other inputs, e.g. the user features, are passed to
+// every shard. The outputs of the shards are concatenated in order.
+class RequestSplitter {
+ public:
+  // Runs the inputs of a shard, the shards run at the same time.
+  typedef std::function<Status(int shard,
+      const std::vector<std::pair<std::string, Tensor>>& inputs,
+      std::vector<Tensor>* outputs)> ShardRunner;
+
+  // A shard has at least min_shard_rows candidates, a request has at most
+  // max_shards shards and at most num_sessions shards.
+  RequestSplitter(int num_sessions, int min_shard_rows, int max_shards);
+
+  // Returns the number of shards of req, 1 when req should not be split.
+  // inflight is the number of requests running on the session group, the
+  // sessions are shared by the shards of the inflight requests.
+  int NumShards(const Request& req, int64 inflight) const;
+
+  // Runs req in num_shards shards. The outputs which are not rows of the
+  // candidates can not be merged, Unimplemented is returned for them and
+  // req should run as a whole.
+  Status Run(const Request& req, Response& resp, int num_shards,
+             const ShardRunner& runner);
+
+ private:
+  static int64 CandidateRows(const Request& req);
+
+  const int num_sessions_;
+  const int min_shard_rows_;
+  const int max_shards_;
+  std::unique_ptr<thread::ThreadPool> thread_pool_;
+};
+
+} // processor
+} // tensorflow
+
+#endif // SERVING_PROCESSOR_SERVING_REQUEST_SPLITTER_H
@@ -0,0 +1,73 @@
+#include "gtest/gtest.h"
+#include "serving/processor/serving/request_splitter.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+
+namespace tensorflow {
+namespace processor {
+namespace {
+Request CreateRequest(int64 rows) {
+  Request req;
+  Tensor items(DT_FLOAT, TensorShape({rows, 2}));
+  auto flat = items.flat<float>();
+  for (int64 i = 0; i < flat.size(); ++i) {
+    flat(i) = i;
+  }
+  req.inputs.emplace_back("items", items);
+  req.inputs.emplace_back("user", test::AsTensor<float>({7, 8}, {1, 2}));
+  req.output_tensor_names.emplace_back("items");
+  return req;
+}
+} // namespace
+
+class RequestSplitterTest : public ::testing::Test {
+};
+
+TEST_F(RequestSplitterTest, ShouldChooseShardsByRowsAndLoad) {
+  RequestSplitter splitter(4, 100, 0);
+  EXPECT_EQ(1, splitter.NumShards(CreateRequest(150), 1));
+  EXPECT_EQ(3, splitter.NumShards(CreateRequest(300), 1));
+  EXPECT_EQ(4, splitter.NumShards(CreateRequest(1000), 1));
+  // The sessions are shared by 2 inflight requests.
+  EXPECT_EQ(2, splitter.NumShards(CreateRequest(1000), 2));
+  EXPECT_EQ(1, splitter.NumShards(CreateRequest(1000), 8));
+
+  RequestSplitter limited(4, 100, 2);
+  EXPECT_EQ(2, limited.NumShards(CreateRequest(1000), 1));
+}
+
+TEST_F(RequestSplitterTest, ShouldMergeShardOutputsInOrder) {
+  RequestSplitter splitter(4, 1, 0);
+  Request req = CreateRequest(10);
+  Response resp;
+  std::vector<int64> shard_rows(3);
+  auto runner = [&shard_rows](int shard,
+      const std::vector<std::pair<std::string, Tensor>>& inputs,
+      std::vector<Tensor>* outputs) {
+    // The user features are passed to every shard.
+    test::ExpectTensorEqual<float>(test::AsTensor<float>({7, 8}, {1, 2}),
+                                   inputs[1].second);
+    shard_rows[shard] = inputs[0].second.dim_size(0);
+    outputs->emplace_back(inputs[0].second);
+    return Status::OK();
+  };
+  EXPECT_TRUE(splitter.Run(req, resp, 3, runner).ok());
+  EXPECT_EQ(std::vector<int64>({4, 3, 3}), shard_rows);
+  ASSERT_EQ(1, resp.outputs.size());
+  test::ExpectTensorEqual<float>(req.inputs[0].second, resp.outputs[0]);
+}
+
+TEST_F(RequestSplitterTest, ShouldFailWhenOutputsAreNotRows) {
+  RequestSplitter splitter(2, 1, 0);
+  Request req = CreateRequest(4);
+  Response resp;
+  auto runner = [](int shard,
+      const std::vector<std::pair<std::string, Tensor>>& inputs,
+      std::vector<Tensor>* outputs) {
+    outputs->emplace_back(test::AsScalar<float>(1));
+    return Status::OK();
+  };
+  EXPECT_TRUE(errors::IsUnimplemented(splitter.Run(req, resp, 2, runner)));
+}
+
+} // processor
+} // tensorflow
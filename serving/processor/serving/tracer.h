@@ -111,6 +111,9 @@ class Tracer {
     return false;
   }
 
+  // Whether a timeline location is configured for GenTimeline.
+  bool HasTimelineLocation() const { return !file_path_dir_.empty(); }
+
   void GenTimeline(tensorflow::RunMetadata& run_metadata) {
     static std::atomic<int> counter(0);
     int index = counter.fetch_add(1, std::memory_order_relaxed);
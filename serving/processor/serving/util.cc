@@ -1,4 +1,12 @@
+#include <map>
+#include <type_traits>
 #include "tensorflow/core/common_runtime/custom_thread_pool.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/framework/embedding/embedding_var.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 #include "serving/processor/serving/util.h"
 #include "serving/processor/framework/graph_optimizer.h"
 
@@ -205,6 +213,240 @@ Status RunRestoreCheckpoint(
 }
 
 
+namespace {
+// The crc32c and size of the tensors of a checkpoint.
+typedef std::map<std::string, std::pair<uint32, int64>> TensorDigests;
+
+Status ReadTensorDigests(const std::string& ckpt_name,
+                         TensorDigests* digests,
+                         std::vector<std::string>* ev_names) {
+  BundleReader reader(Env::Default(), ckpt_name);
+  TF_RETURN_IF_ERROR(reader.status());
+  for (reader.Seek(kHeaderEntryKey); reader.Valid(); reader.Next()) {
+    StringPiece key = reader.key();
+    if (key == kHeaderEntryKey) {
+      continue;
+    }
+    BundleEntryProto entry;
+    if (!entry.ParseFromArray(reader.value().data(), reader.value().size())) {
+      return errors::DataLoss("Invalid entry ", key, " of ", ckpt_name);
+    }
+    (*digests)[string(key)] = std::make_pair(entry.crc32c(), entry.size());
+    // The tensors of an EmbeddingVariable are named <name>-keys,
+    // <name>-values and so on.
+    if (str_util::EndsWith(key, "-keys")) {
+      ev_names->emplace_back(key.substr(0, key.size() - 5));
+    }
+  }
+  return Status::OK();
+}
+
+// Returns the digests of the tensors of the EmbeddingVariable name.
+std::vector<std::pair<std::string, std::pair<uint32, int64>>>
+EmbeddingVarDigests(const TensorDigests& digests, const std::string& name) {
+  const std::string prefix = name + "-";
+  std::vector<std::pair<std::string, std::pair<uint32, int64>>> ev_digests;
+  for (auto it = digests.lower_bound(prefix);
+       it != digests.end() && str_util::StartsWith(it->first, prefix); ++it) {
+    ev_digests.emplace_back(*it);
+  }
+  return ev_digests;
+}
+
+template <class K>
+bool ShareEmbeddingVar(ResourceMgr* prev_rm, ResourceMgr* rm,
+                       const std::string& name) {
+  EmbeddingVar<K, float>* ev = nullptr;
+  if (!prev_rm->Lookup(prev_rm->default_container(), name, &ev).ok()) {
+    return false;
+  }
+  if (ev->IsDiverged() || ev->IsUsePersistentStorage()) {
+    ev->Unref();
+    return false;
+  }
+  // rm takes the reference of the lookup.
+  if (!rm->Create(rm->default_container(), name, ev).ok()) {
+    return false;
+  }
+  ev->SetShared();
+  return true;
+}
+} // namespace
+
+Status ShareUnchangedEmbeddingVars(const std::string& prev_ckpt_name,
+                                   const std::string& ckpt_name,
+                                   Session* prev_session,
+                                   Session* session,
+                                   int* num_shared) {
+  *num_shared = 0;
+  TensorDigests prev_digests, digests;
+  std::vector<std::string> prev_ev_names, ev_names;
+  TF_RETURN_IF_ERROR(
+      ReadTensorDigests(prev_ckpt_name, &prev_digests, &prev_ev_names));
+  TF_RETURN_IF_ERROR(ReadTensorDigests(ckpt_name, &digests, &ev_names));
+
+  const DeviceMgr* prev_device_mgr = nullptr;
+  const DeviceMgr* device_mgr = nullptr;
+  TF_RETURN_IF_ERROR(prev_session->LocalDeviceManager(&prev_device_mgr));
+  TF_RETURN_IF_ERROR(session->LocalDeviceManager(&device_mgr));
+  for (auto& name : ev_names) {
+    if (EmbeddingVarDigests(digests, name) !=
+        EmbeddingVarDigests(prev_digests, name)) {
+      continue;
+    }
+    for (auto device : device_mgr->ListDevices()) {
+      Device* prev_device = nullptr;
+      if (!prev_device_mgr->LookupDevice(device->name(), &prev_device).ok()) {
+        continue;
+      }
+      ResourceMgr* prev_rm = prev_device->resource_manager();
+      ResourceMgr* rm = device->resource_manager();
+      if (ShareEmbeddingVar<int64>(prev_rm, rm, name) ||
+          ShareEmbeddingVar<int32>(prev_rm, rm, name)) {
+        ++*num_shared;
+      }
+    }
+  }
+  LOG(INFO) << "Share " << *num_shared << " unchanged EmbeddingVariables of "
+            << prev_ckpt_name << " with " << ckpt_name;
+  return Status::OK();
+}
+
+namespace {
+// The EmbeddingVariables published by the models of the process. A
+// published EmbeddingVariable is keyed by its device, its name and the
+// digests of its checkpoint tensors, and referenced until no session holds
+// it anymore.
+struct PublishedEmbeddingVar {
+  ResourceBase* ev;
+  bool int64_keys;
+};
+
+mutex published_mu(LINKER_INITIALIZED);
+
+std::map<std::string, PublishedEmbeddingVar>* PublishedEmbeddingVars() {
+  static auto* published =
+      new std::map<std::string, PublishedEmbeddingVar>();
+  return published;
+}
+
+std::string PublishedKey(const std::string& device_name,
+                         const std::string& name,
+                         const TensorDigests& digests) {
+  std::string key = strings::StrCat(device_name, "|", name);
+  for (const auto& digest : EmbeddingVarDigests(digests, name)) {
+    strings::StrAppend(&key, "|", digest.first, ":", digest.second.first,
+                       ":", digest.second.second);
+  }
+  return key;
+}
+
+// Releases the EmbeddingVariables held by the registry only.
+void ReleaseUnusedEmbeddingVars()
+    EXCLUSIVE_LOCKS_REQUIRED(published_mu) {
+  auto published = PublishedEmbeddingVars();
+  for (auto it = published->begin(); it != published->end();) {
+    if (it->second.ev->RefCountIsOne()) {
+      it->second.ev->Unref();
+      it = published->erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+template <class K>
+bool PublishEmbeddingVar(ResourceMgr* rm, const std::string& name,
+                         const std::string& key)
+    EXCLUSIVE_LOCKS_REQUIRED(published_mu) {
+  EmbeddingVar<K, float>* ev = nullptr;
+  if (!rm->Lookup(rm->default_container(), name, &ev).ok()) {
+    return false;
+  }
+  if (ev->IsDiverged() || ev->IsUsePersistentStorage() ||
+      PublishedEmbeddingVars()->count(key) > 0) {
+    ev->Unref();
+    return false;
+  }
+  // The registry takes the reference of the lookup.
+  (*PublishedEmbeddingVars())[key] = {ev, std::is_same<K, int64>::value};
+  return true;
+}
+
+template <class K>
+bool AdoptEmbeddingVar(ResourceMgr* rm, const std::string& name,
+                       ResourceBase* resource) {
+  auto ev = static_cast<EmbeddingVar<K, float>*>(resource);
+  if (ev->IsDiverged()) {
+    return false;
+  }
+  ev->Ref();
+  // rm takes the new reference, and drops it if name already exists.
+  if (!rm->Create(rm->default_container(), name, ev).ok()) {
+    return false;
+  }
+  ev->SetShared();
+  return true;
+}
+} // namespace
+
+Status PublishEmbeddingVars(const std::string& ckpt_name, Session* session,
+                            int* num_published) {
+  *num_published = 0;
+  TensorDigests digests;
+  std::vector<std::string> ev_names;
+  TF_RETURN_IF_ERROR(ReadTensorDigests(ckpt_name, &digests, &ev_names));
+  const DeviceMgr* device_mgr = nullptr;
+  TF_RETURN_IF_ERROR(session->LocalDeviceManager(&device_mgr));
+
+  mutex_lock lock(published_mu);
+  ReleaseUnusedEmbeddingVars();
+  for (auto& name : ev_names) {
+    for (auto device : device_mgr->ListDevices()) {
+      const std::string key = PublishedKey(device->name(), name, digests);
+      ResourceMgr* rm = device->resource_manager();
+      if (PublishEmbeddingVar<int64>(rm, name, key) ||
+          PublishEmbeddingVar<int32>(rm, name, key)) {
+        ++*num_published;
+      }
+    }
+  }
+  return Status::OK();
+}
+
+Status AdoptPublishedEmbeddingVars(const std::string& ckpt_name,
+                                   Session* session, int* num_shared) {
+  *num_shared = 0;
+  TensorDigests digests;
+  std::vector<std::string> ev_names;
+  TF_RETURN_IF_ERROR(ReadTensorDigests(ckpt_name, &digests, &ev_names));
+  const DeviceMgr* device_mgr = nullptr;
+  TF_RETURN_IF_ERROR(session->LocalDeviceManager(&device_mgr));
+
+  mutex_lock lock(published_mu);
+  ReleaseUnusedEmbeddingVars();
+  auto published = PublishedEmbeddingVars();
+  for (auto& name : ev_names) {
+    for (auto device : device_mgr->ListDevices()) {
+      auto it = published->find(PublishedKey(device->name(), name, digests));
+      if (it == published->end()) {
+        continue;
+      }
+      ResourceMgr* rm = device->resource_manager();
+      const bool shared =
+          it->second.int64_keys
+              ? AdoptEmbeddingVar<int64>(rm, name, it->second.ev)
+              : AdoptEmbeddingVar<int32>(rm, name, it->second.ev);
+      if (shared) {
+        ++*num_shared;
+      }
+    }
+  }
+  LOG(INFO) << "Share " << *num_shared << " EmbeddingVariables of the other "
+            << "models of the process with " << ckpt_name;
+  return Status::OK();
+}
+
 Status RunRestore(const RunOptions& run_options, const string& export_dir,
                   const StringPiece restore_op_name,
                   const StringPiece variable_filename_const_op_name,
@@ -789,191 +1031,280 @@ TensorWithStatus Proto2Tensor(const std::string& key,
   return ret;
 }
 
-eas::PredictResponse Tensor2Response(
-    const processor::Request& req,
-    const processor::Response& resp,
-    const SignatureInfo* signature_info) {
-  eas::PredictResponse response;
-  const auto& output_tensor_names = req.output_tensor_names;
-  const auto & outputs = resp.outputs;
+namespace {
+void Tensor2ArrayProto(const Tensor& tensor, eas::ArrayProto* output) {
+  int64 total_dim_size = 1;
+  for (int j = 0; j < tensor.dims(); ++j) {
+    int64 dim_size = tensor.dim_size(j);
+    output->mutable_array_shape()->add_dim(dim_size);
+    total_dim_size *= dim_size;
+  }
 
-  for (size_t i = 0; i < outputs.size(); ++i) {
-    eas::ArrayProto output;
-    int64 total_dim_size = 1;
-    for (int j = 0; j < outputs[i].dims(); ++j) {
-      int64 dim_size = outputs[i].dim_size(j);
-      output.mutable_array_shape()->add_dim(dim_size);
-      total_dim_size *= dim_size;
-    }
-
-    switch (outputs[i].dtype()) {
-      case DT_FLOAT: {
-        output.set_dtype(eas::DT_FLOAT);
-        auto flat = outputs[i].flat<float>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_float_val(flat(j));
-        }
-        break;
-      }
-      case DT_DOUBLE: {
-        output.set_dtype(eas::DT_DOUBLE);
-        auto flat = outputs[i].flat<double>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_double_val(flat(j));
-        }
-        break;
-      }
-      case DT_INT32: {
-        output.set_dtype(eas::DT_INT32);
-        auto flat = outputs[i].flat<int>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_int_val(flat(j));
-        }
-        break;
-      }
-      case DT_UINT8: {
-        output.set_dtype(eas::DT_UINT8);
-        auto flat = outputs[i].flat<uint8>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_int_val((int)flat(j));
-        }
-        break;
-      }
-      case DT_INT16: {
-        output.set_dtype(eas::DT_INT16);
-        auto flat = outputs[i].flat<int16>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_int_val((int)flat(j));
-        }
-        break;
-      }
-      case DT_INT8: {
-        output.set_dtype(eas::DT_INT8);
-        auto flat = outputs[i].flat<int8>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_int_val((int)flat(j));
-        }
-        break;
-      }
-      case DT_QINT8: {
-        output.set_dtype(eas::DT_QINT8);
-        auto flat = outputs[i].flat<qint8>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_int_val(flat(j).value);
-        }
-        break;
+  switch (tensor.dtype()) {
+    case DT_FLOAT: {
+      output->set_dtype(eas::DT_FLOAT);
+      auto flat = tensor.flat<float>();
+      output->mutable_float_val()->Resize(total_dim_size, 0);
+      memcpy(output->mutable_float_val()->mutable_data(), flat.data(),
+             total_dim_size * sizeof(float));
+      break;
+    }
+    case DT_DOUBLE: {
+      output->set_dtype(eas::DT_DOUBLE);
+      auto flat = tensor.flat<double>();
+      output->mutable_double_val()->Resize(total_dim_size, 0);
+      memcpy(output->mutable_double_val()->mutable_data(), flat.data(),
+             total_dim_size * sizeof(double));
+      break;
+    }
+    case DT_INT32: {
+      output->set_dtype(eas::DT_INT32);
+      auto flat = tensor.flat<int>();
+      for (int64 j = 0; j < total_dim_size; ++j) {
+        output->add_int_val(flat(j));
       }
-      case DT_QUINT8: {
-        output.set_dtype(eas::DT_QUINT8);
-        auto flat = outputs[i].flat<quint8>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_int_val(flat(j).value);
-        }
-        break;
+      break;
+    }
+    case DT_UINT8: {
+      output->set_dtype(eas::DT_UINT8);
+      auto flat = tensor.flat<uint8>();
+      for (int64 j = 0; j < total_dim_size; ++j) {
+        output->add_int_val((int)flat(j));
       }
-      case DT_QINT32: {
-        output.set_dtype(eas::DT_QINT32);
-        auto flat = outputs[i].flat<qint32>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_int_val(flat(j).value);
-        }
-        break;
+      break;
+    }
+    case DT_INT16: {
+      output->set_dtype(eas::DT_INT16);
+      auto flat = tensor.flat<int16>();
+      for (int64 j = 0; j < total_dim_size; ++j) {
+        output->add_int_val((int)flat(j));
       }
-      case DT_QINT16: {
-        output.set_dtype(eas::DT_QINT16);
-        auto flat = outputs[i].flat<qint16>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_int_val(flat(j).value);
-        }
-        break;
+      break;
+    }
+    case DT_INT8: {
+      output->set_dtype(eas::DT_INT8);
+      auto flat = tensor.flat<int8>();
+      for (int64 j = 0; j < total_dim_size; ++j) {
+        output->add_int_val((int)flat(j));
       }
-      case DT_QUINT16: {
-        output.set_dtype(eas::DT_QUINT16);
-        auto flat = outputs[i].flat<quint16>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_int_val(flat(j).value);
-        }
-        break;
+      break;
+    }
+    case DT_QINT8: {
+      output->set_dtype(eas::DT_QINT8);
+      auto flat = tensor.flat<qint8>();
+      for (int64 j = 0; j < total_dim_size; ++j) {
+        output->add_int_val(flat(j).value);
       }
-      case DT_UINT16: {
-        output.set_dtype(eas::DT_UINT16);
-        auto flat = outputs[i].flat<uint16>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_int_val((int)flat(j));
-        }
-        break;
+      break;
+    }
+    case DT_QUINT8: {
+      output->set_dtype(eas::DT_QUINT8);
+      auto flat = tensor.flat<quint8>();
+      for (int64 j = 0; j < total_dim_size; ++j) {
+        output->add_int_val(flat(j).value);
       }
-      case DT_INT64: {
-        output.set_dtype(eas::DT_INT64);
-        auto flat = outputs[i].flat<int64>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_int64_val(flat(j));
-        }
-        break;
+      break;
+    }
+    case DT_QINT32: {
+      output->set_dtype(eas::DT_QINT32);
+      auto flat = tensor.flat<qint32>();
+      for (int64 j = 0; j < total_dim_size; ++j) {
+        output->add_int_val(flat(j).value);
       }
-      case DT_BOOL: {
-        output.set_dtype(eas::DT_BOOL);
-        auto flat = outputs[i].flat<bool>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_bool_val(flat(j));
-        }
-        break;
+      break;
+    }
+    case DT_QINT16: {
+      output->set_dtype(eas::DT_QINT16);
+      auto flat = tensor.flat<qint16>();
+      for (int64 j = 0; j < total_dim_size; ++j) {
+        output->add_int_val(flat(j).value);
       }
-      case DT_STRING: {
-        output.set_dtype(eas::DT_STRING);
-        auto flat = outputs[i].flat<std::string>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_string_val(flat(j));
-        }
-        break;
+      break;
+    }
+    case DT_QUINT16: {
+      output->set_dtype(eas::DT_QUINT16);
+      auto flat = tensor.flat<quint16>();
+      for (int64 j = 0; j < total_dim_size; ++j) {
+        output->add_int_val(flat(j).value);
       }
-      case DT_COMPLEX64: {
-        output.set_dtype(eas::DT_COMPLEX64);
-        auto flat = outputs[i].flat<complex64>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_float_val(flat(j).real());
-          output.add_float_val(flat(j).imag());
-        }
-        break;
+      break;
+    }
+    case DT_UINT16: {
+      output->set_dtype(eas::DT_UINT16);
+      auto flat = tensor.flat<uint16>();
+      for (int64 j = 0; j < total_dim_size; ++j) {
+        output->add_int_val((int)flat(j));
       }
-      case DT_COMPLEX128: {
-        output.set_dtype(eas::DT_COMPLEX128);
-        auto flat = outputs[i].flat<complex128>();
-        for (int64 j = 0; j < total_dim_size; ++j) {
-          output.add_double_val(flat(j).real());
-          output.add_double_val(flat(j).imag());
-        }
-        break;
+      break;
+    }
+    case DT_INT64: {
+      output->set_dtype(eas::DT_INT64);
+      auto flat = tensor.flat<int64>();
+      output->mutable_int64_val()->Resize(total_dim_size, 0);
+      memcpy(output->mutable_int64_val()->mutable_data(), flat.data(),
+             total_dim_size * sizeof(int64));
+      break;
+    }
+    case DT_BOOL: {
+      output->set_dtype(eas::DT_BOOL);
+      auto flat = tensor.flat<bool>();
+      for (int64 j = 0; j < total_dim_size; ++j) {
+        output->add_bool_val(flat(j));
       }
-      case DT_HALF: {
-        output.set_dtype(eas::DT_HALF);
-        auto flat = outputs[i].flat<Eigen::half>();
-        for (int64 j = 0; j < total_dim_size; j++)
-          output.add_float_val((float)flat(j));
-        break;
+      break;
+    }
+    case DT_STRING: {
+      output->set_dtype(eas::DT_STRING);
+      auto flat = tensor.flat<std::string>();
+      for (int64 j = 0; j < total_dim_size; ++j) {
+        output->add_string_val(flat(j));
       }
-      case DT_BFLOAT16: {
-        output.set_dtype(eas::DT_BFLOAT16);
-        auto flat = outputs[i].flat<bfloat16>();
-        for (tensorflow::int64 j = 0; j < total_dim_size; j++) {
-          float value;
-          BFloat16ToFloat(&flat(j), &value, 1);
-          output.add_float_val(value);
-        }
-        break;
+      break;
+    }
+    case DT_COMPLEX64: {
+      output->set_dtype(eas::DT_COMPLEX64);
+      auto flat = tensor.flat<complex64>();
+      for (int64 j = 0; j < total_dim_size; ++j) {
+        output->add_float_val(flat(j).real());
+        output->add_float_val(flat(j).imag());
       }
-      case tensorflow::eas::DT_RESOURCE: {
-        LOG(ERROR) << "Output Tensor Not Support this DataType: DT_RESOURCE";
-        break;
+      break;
+    }
+    case DT_COMPLEX128: {
+      output->set_dtype(eas::DT_COMPLEX128);
+      auto flat = tensor.flat<complex128>();
+      for (int64 j = 0; j < total_dim_size; ++j) {
+        output->add_double_val(flat(j).real());
+        output->add_double_val(flat(j).imag());
       }
-      case tensorflow::eas::DT_VARIANT: {
-        LOG(ERROR) << "Output Tensor Not Support this DataType: DT_VARIANT";
-        break;
+      break;
+    }
+    case DT_HALF: {
+      output->set_dtype(eas::DT_HALF);
+      auto flat = tensor.flat<Eigen::half>();
+      for (int64 j = 0; j < total_dim_size; j++)
+        output->add_float_val((float)flat(j));
+      break;
+    }
+    case DT_BFLOAT16: {
+      output->set_dtype(eas::DT_BFLOAT16);
+      auto flat = tensor.flat<bfloat16>();
+      for (tensorflow::int64 j = 0; j < total_dim_size; j++) {
+        float value;
+        BFloat16ToFloat(&flat(j), &value, 1);
+        output->add_float_val(value);
       }
-      default:
-        LOG(ERROR) << "Output Tensor Not Support this DataType";
-        break;
+      break;
+    }
+    case tensorflow::eas::DT_RESOURCE: {
+      LOG(ERROR) << "Output Tensor Not Support this DataType: DT_RESOURCE";
+      break;
+    }
+    case tensorflow::eas::DT_VARIANT: {
+      LOG(ERROR) << "Output Tensor Not Support this DataType: DT_VARIANT";
+      break;
+    }
+    default:
+      LOG(ERROR) << "Output Tensor Not Support this DataType";
+      break;
+  }
+}
+} // namespace
+
+namespace {
+// Aliases the values of an ArrayProto allocated on arena, and keeps arena
+// alive until the tensors are released.
+class ArenaTensorBuffer : public TensorBuffer {
+ public:
+  ArenaTensorBuffer(const std::shared_ptr<protobuf::Arena>& arena,
+                    void* data, size_t len)
+      : TensorBuffer(data), arena_(arena), len_(len) {}
+
+  size_t size() const override { return len_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(
+      AllocationDescription* proto) const override {
+    proto->set_requested_bytes(len_);
+    proto->set_allocator_name("request_arena");
+  }
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  std::shared_ptr<protobuf::Arena> arena_;
+  size_t len_;
+};
+
+template <class T>
+bool AliasRepeatedField(const protobuf::RepeatedField<T>& values,
+                        DataType dtype, const TensorShape& shape,
+                        const std::shared_ptr<protobuf::Arena>& arena,
+                        Tensor* tensor) {
+  // Tensors are mapped as aligned by Eigen.
+  if (values.empty() || values.size() != shape.num_elements() ||
+      reinterpret_cast<intptr_t>(values.data()) %
+          std::max(1, EIGEN_MAX_ALIGN_BYTES) != 0) {
+    return false;
+  }
+  auto buf = new ArenaTensorBuffer(arena,
+      const_cast<T*>(values.data()), values.size() * sizeof(T));
+  *tensor = Tensor(dtype, shape, buf);
+  buf->Unref();
+  return true;
+}
+} // namespace
+
+TensorWithStatus Proto2Tensor(const std::string& key,
+                              const eas::ArrayProto& input,
+                              const std::shared_ptr<protobuf::Arena>& arena) {
+  if (arena == nullptr || input.GetArena() != arena.get()) {
+    return Proto2Tensor(key, input);
+  }
+  TensorShape tensor_shape;
+  for (int i = 0; i < input.array_shape().dim_size(); ++i) {
+    if (input.array_shape().dim(i) < 0) {
+      return Proto2Tensor(key, input);
     }
+    tensor_shape.AddDim(input.array_shape().dim(i));
+  }
+
+  TensorWithStatus ret;
+  bool aliased = false;
+  switch (input.dtype()) {
+    case tensorflow::eas::DT_FLOAT:
+      aliased = AliasRepeatedField(input.float_val(), DT_FLOAT,
+                                   tensor_shape, arena, &ret.tensor);
+      break;
+    case tensorflow::eas::DT_DOUBLE:
+      aliased = AliasRepeatedField(input.double_val(), DT_DOUBLE,
+                                   tensor_shape, arena, &ret.tensor);
+      break;
+    case tensorflow::eas::DT_INT32:
+      aliased = AliasRepeatedField(input.int_val(), DT_INT32,
+                                   tensor_shape, arena, &ret.tensor);
+      break;
+    case tensorflow::eas::DT_INT64:
+      aliased = AliasRepeatedField(input.int64_val(), DT_INT64,
+                                   tensor_shape, arena, &ret.tensor);
+      break;
+    default:
+      break;
+  }
+  if (!aliased) {
+    return Proto2Tensor(key, input);
+  }
+  ret.status = Status::OK();
+  return ret;
+}
+
+eas::PredictResponse Tensor2Response(
+    const processor::Request& req,
+    const processor::Response& resp,
+    const SignatureInfo* signature_info) {
+  eas::PredictResponse response;
+  const auto& output_tensor_names = req.output_tensor_names;
+  const auto & outputs = resp.outputs;
+
+  for (size_t i = 0; i < outputs.size(); ++i) {
     if (signature_info->output_value_name_idx.find(output_tensor_names[i]) ==
         signature_info->output_value_name_idx.end()) {
       LOG(ERROR) << "Response contain invalid output tensor name: "
@@ -981,11 +1312,101 @@ eas::PredictResponse Tensor2Response(
     }
     std::string key =
         signature_info->output_key[signature_info->output_value_name_idx.at(output_tensor_names[i])];
-    (*response.mutable_outputs())[key] = output;
+    Tensor2ArrayProto(outputs[i], &(*response.mutable_outputs())[key]);
   }
   return response;
 }
 
+Status SerializeResponseToArray(
+    const processor::Request& req,
+    const processor::Response& resp,
+    const SignatureInfo* signature_info,
+    void** output_data, int* output_size) {
+  using protobuf::internal::WireFormatLite;
+  using protobuf::io::CodedOutputStream;
+  const auto kLengthDelimited = WireFormatLite::WIRETYPE_LENGTH_DELIMITED;
+  // PredictResponse.outputs, the key and the value of a map entry, and
+  // ArrayProto.float_val and double_val.
+  const uint32 kOutputsTag = WireFormatLite::MakeTag(1, kLengthDelimited);
+  const uint32 kKeyTag = WireFormatLite::MakeTag(1, kLengthDelimited);
+  const uint32 kValueTag = WireFormatLite::MakeTag(2, kLengthDelimited);
+  const uint32 kFloatValTag = WireFormatLite::MakeTag(3, kLengthDelimited);
+  const uint32 kDoubleValTag = WireFormatLite::MakeTag(4, kLengthDelimited);
+
+  const auto& outputs = resp.outputs;
+  std::vector<const std::string*> keys(outputs.size());
+  // The ArrayProto of the outputs without the float_val or double_val,
+  // which are written from the raw bytes of the tensors.
+  std::vector<eas::ArrayProto> headers(outputs.size());
+  std::vector<size_t> value_sizes(outputs.size());
+  std::vector<size_t> entry_sizes(outputs.size());
+  size_t total_size = 0;
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    auto it = signature_info->output_value_name_idx.find(
+        req.output_tensor_names[i]);
+    if (it == signature_info->output_value_name_idx.end()) {
+      return errors::InvalidArgument(
+          "Response contain invalid output tensor name: ",
+          req.output_tensor_names[i]);
+    }
+    keys[i] = &signature_info->output_key[it->second];
+    const Tensor& tensor = outputs[i];
+    size_t value_size = 0;
+    if (tensor.dtype() == DT_FLOAT || tensor.dtype() == DT_DOUBLE) {
+      headers[i].set_dtype(tensor.dtype() == DT_FLOAT ?
+          eas::DT_FLOAT : eas::DT_DOUBLE);
+      for (int j = 0; j < tensor.dims(); ++j) {
+        headers[i].mutable_array_shape()->add_dim(tensor.dim_size(j));
+      }
+      if (tensor.TotalBytes() > 0) {
+        value_size = 1 +
+            CodedOutputStream::VarintSize64(tensor.TotalBytes()) +
+            tensor.TotalBytes();
+      }
+    } else {
+      Tensor2ArrayProto(tensor, &headers[i]);
+    }
+    value_size += headers[i].ByteSizeLong();
+    value_sizes[i] = value_size;
+    entry_sizes[i] = 1 + CodedOutputStream::VarintSize64(keys[i]->size()) +
+        keys[i]->size() + 1 + CodedOutputStream::VarintSize64(value_size) +
+        value_size;
+    total_size += 1 + CodedOutputStream::VarintSize64(entry_sizes[i]) +
+        entry_sizes[i];
+  }
+  if (total_size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+    return errors::InvalidArgument("Response of ", total_size,
+                                   " bytes is too large.");
+  }
+
+  char* data = new char[total_size];
+  uint8* target = reinterpret_cast<uint8*>(data);
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    const Tensor& tensor = outputs[i];
+    target = CodedOutputStream::WriteVarint32ToArray(kOutputsTag, target);
+    target = CodedOutputStream::WriteVarint64ToArray(entry_sizes[i], target);
+    target = CodedOutputStream::WriteVarint32ToArray(kKeyTag, target);
+    target = CodedOutputStream::WriteStringWithSizeToArray(*keys[i], target);
+    target = CodedOutputStream::WriteVarint32ToArray(kValueTag, target);
+    target = CodedOutputStream::WriteVarint64ToArray(value_sizes[i], target);
+    target = headers[i].SerializeWithCachedSizesToArray(target);
+    if ((tensor.dtype() == DT_FLOAT || tensor.dtype() == DT_DOUBLE) &&
+        tensor.TotalBytes() > 0) {
+      target = CodedOutputStream::WriteVarint32ToArray(
+          tensor.dtype() == DT_FLOAT ? kFloatValTag : kDoubleValTag, target);
+      target = CodedOutputStream::WriteVarint64ToArray(tensor.TotalBytes(),
+                                                       target);
+      // Packed fixed size values are little endian on the wire.
+      StringPiece bytes = tensor.tensor_data();
+      memcpy(target, bytes.data(), bytes.size());
+      target += bytes.size();
+    }
+  }
+  *output_data = data;
+  *output_size = total_size;
+  return Status::OK();
+}
+
 } // namespace util
 } // namespace processor
 } // namespace tensorflow
@@ -74,6 +74,29 @@ Status RunRestore(const RunOptions& run_options, const string& export_dir,
                   const StringPiece variable_filename_const_op_name,
                   const std::vector<AssetFileDef>& asset_file_defs,
                   Session* session);
+// Shares the EmbeddingVariables of prev_session whose tensors have the same
+// checksums in prev_ckpt_name and ckpt_name with session, before ckpt_name
+// is restored in session. The shared EmbeddingVariables skip their
+// initialization and restore in session, so the unchanged rows are kept
+// once in memory by both model versions.
+Status ShareUnchangedEmbeddingVars(const std::string& prev_ckpt_name,
+                                   const std::string& ckpt_name,
+                                   Session* prev_session,
+                                   Session* session,
+                                   int* num_shared);
+
+// Publishes the EmbeddingVariables of session, restored from ckpt_name, to
+// the other models of the process. Together with
+// AdoptPublishedEmbeddingVars, the models whose checkpoints hold the same
+// EmbeddingVariable, by name and tensor checksums, keep one copy of it
+// while each keeps its own dense variables. A published EmbeddingVariable
+// is released when no session holds it anymore.
+Status PublishEmbeddingVars(const std::string& ckpt_name, Session* session,
+                            int* num_published);
+// Shares the published EmbeddingVariables which ckpt_name holds with
+// session, before ckpt_name is restored in session.
+Status AdoptPublishedEmbeddingVars(const std::string& ckpt_name,
+                                   Session* session, int* num_shared);
  
 bool HasMainOp(const MetaGraphDef& meta_graph_def);
 
@@ -118,11 +141,27 @@ Status ValidateSavedTensors(const GraphDef& graph_def);
 TensorWithStatus Proto2Tensor(const std::string& key,
                               const eas::ArrayProto& input);
 
+// Like Proto2Tensor, but the float, double, int32 and int64 tensors alias
+// the values of input allocated on arena instead of copying them, and keep
+// arena alive. The values not aligned for Eigen are still copied.
+TensorWithStatus Proto2Tensor(const std::string& key,
+                              const eas::ArrayProto& input,
+                              const std::shared_ptr<protobuf::Arena>& arena);
+
 eas::PredictResponse Tensor2Response(
     const processor::Request& req,
     const processor::Response& resp,
     const SignatureInfo* info);
- 
+
+// Serializes the PredictResponse of resp to a new char[] of *output_size
+// bytes. The float and double outputs are written from the tensors
+// directly, without an ArrayProto holding a copy of their values.
+Status SerializeResponseToArray(
+    const processor::Request& req,
+    const processor::Response& resp,
+    const SignatureInfo* info,
+    void** output_data, int* output_size);
+
 } // namespace util
 } // namespace processor
 } // namespace tensorflow
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include "serving/processor/serving/warmup_recorder.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/lib/io/record_writer.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace processor {
+
+WarmupRecorder::WarmupRecorder(const std::string& file_name, int interval,
+                               int max_requests)
+    : file_name_(file_name),
+      interval_(std::max(interval, 1)),
+      max_requests_(std::max(max_requests, 1)),
+      num_requests_(0) {
+}
+
+WarmupRecorder::~WarmupRecorder() {
+  Status s = Flush();
+  if (!s.ok()) {
+    LOG(WARNING) << "Write warmup file failed: " << s.error_message();
+  }
+}
+
+void WarmupRecorder::MaybeRecord(const void* data, int size) {
+  if (num_requests_.fetch_add(1, std::memory_order_relaxed) % interval_ != 0) {
+    return;
+  }
+  bool flush = false;
+  {
+    mutex_lock lock(mu_);
+    requests_.emplace_back(static_cast<const char*>(data), size);
+    if (static_cast<int>(requests_.size()) > max_requests_) {
+      requests_.pop_front();
+    }
+    if (++num_unflushed_ >= max_requests_) {
+      num_unflushed_ = 0;
+      flush = true;
+    }
+  }
+  if (flush) {
+    Status s = Flush();
+    if (!s.ok()) {
+      LOG(WARNING) << "Write warmup file failed: " << s.error_message();
+    }
+  }
+}
+
+Status WarmupRecorder::Flush() {
+  mutex_lock flush_lock(flush_mu_);
+  std::vector<std::string> requests;
+  {
+    mutex_lock lock(mu_);
+    if (requests_.empty()) {
+      return Status::OK();
+    }
+    requests.assign(requests_.begin(), requests_.end());
+  }
+
+  // The file is replaced at once, a warmup never reads it half written.
+  const std::string tmp_file_name = file_name_ + ".tmp";
+  std::unique_ptr<WritableFile> file;
+  TF_RETURN_IF_ERROR(Env::Default()->NewWritableFile(tmp_file_name, &file));
+  {
+    io::RecordWriter writer(file.get());
+    for (const auto& request : requests) {
+      TF_RETURN_IF_ERROR(writer.WriteRecord(request));
+    }
+    TF_RETURN_IF_ERROR(writer.Close());
+  }
+  TF_RETURN_IF_ERROR(file->Close());
+  return Env::Default()->RenameFile(tmp_file_name, file_name_);
+}
+
+Status WarmupRecorder::ReadRequests(const std::string& file_name,
+                                    std::vector<std::string>* requests) {
+  requests->clear();
+  std::unique_ptr<RandomAccessFile> file;
+  TF_RETURN_IF_ERROR(Env::Default()->NewRandomAccessFile(file_name, &file));
+  io::RecordReader reader(file.get());
+  uint64 offset = 0;
+  string record;
+  Status s;
+  while ((s = reader.ReadRecord(&offset, &record)).ok()) {
+    requests->emplace_back(std::move(record));
+  }
+  if (errors::IsOutOfRange(s) && !requests->empty()) {
+    return Status::OK();
+  }
+
+  // Not a file of records, the file is one serialized request.
+  requests->clear();
+  std::string data;
+  TF_RETURN_IF_ERROR(ReadFileToString(Env::Default(), file_name, &data));
+  requests->emplace_back(std::move(data));
+  return Status::OK();
+}
+
+} // processor
+} // tensorflow
@@ -0,0 +1,53 @@
+#ifndef SERVING_PROCESSOR_SERVING_WARMUP_RECORDER_H
+#define SERVING_PROCESSOR_SERVING_WARMUP_RECORDER_H
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace processor {
+
+// Samples the live requests into a warmup file, which holds the last
+// max_requests requests recorded as TFRecords. The file is rewritten each
+// time max_requests new requests are recorded, and when the recorder is
+// destroyed, so that a new model version, or a restarted processor, warms
+// up with the recent working set instead of a synthetic request.
+class WarmupRecorder {
+ public:
+  // Records one request in interval, every request when interval <= 1.
+  WarmupRecorder(const std::string& file_name, int interval,
+                 int max_requests);
+  ~WarmupRecorder();
+
+  // Records the serialized request data of size bytes, if sampled.
+  void MaybeRecord(const void* data, int size);
+
+  // Writes the requests recorded so far to the file.
+  Status Flush();
+
+  // Reads the requests of a warmup file, either the TFRecords written by a
+  // WarmupRecorder or a single serialized request.
+  static Status ReadRequests(const std::string& file_name,
+                             std::vector<std::string>* requests);
+
+ private:
+  const std::string file_name_;
+  const int64 interval_;
+  const int max_requests_;
+  std::atomic<int64> num_requests_;
+
+  mutex mu_;
+  std::deque<std::string> requests_ GUARDED_BY(mu_);
+  int num_unflushed_ GUARDED_BY(mu_) = 0;
+  // Serializes the writes of the file.
+  mutex flush_mu_;
+};
+
+} // processor
+} // tensorflow
+
+#endif // SERVING_PROCESSOR_SERVING_WARMUP_RECORDER_H
@@ -0,0 +1,51 @@
+#include "gtest/gtest.h"
+#include "serving/processor/serving/warmup_recorder.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace processor {
+
+TEST(WarmupRecorderTest, ShouldKeepTheLastSampledRequests) {
+  const std::string file_name =
+      io::JoinPath(testing::TmpDir(), "warmup_recorder_last");
+  {
+    WarmupRecorder recorder(file_name, 2, 3);
+    for (int i = 0; i < 10; ++i) {
+      const std::string request = std::to_string(i);
+      recorder.MaybeRecord(request.data(), request.size());
+    }
+  }
+
+  std::vector<std::string> requests;
+  EXPECT_TRUE(WarmupRecorder::ReadRequests(file_name, &requests).ok());
+  EXPECT_EQ(std::vector<std::string>({"4", "6", "8"}), requests);
+}
+
+TEST(WarmupRecorderTest, ShouldFlushEveryMaxRequests) {
+  const std::string file_name =
+      io::JoinPath(testing::TmpDir(), "warmup_recorder_flush");
+  WarmupRecorder recorder(file_name, 1, 2);
+  recorder.MaybeRecord("a", 1);
+  EXPECT_FALSE(Env::Default()->FileExists(file_name).ok());
+  recorder.MaybeRecord("b", 1);
+
+  std::vector<std::string> requests;
+  EXPECT_TRUE(WarmupRecorder::ReadRequests(file_name, &requests).ok());
+  EXPECT_EQ(std::vector<std::string>({"a", "b"}), requests);
+}
+
+TEST(WarmupRecorderTest, ShouldReadASingleRequestFile) {
+  const std::string file_name =
+      io::JoinPath(testing::TmpDir(), "warmup_recorder_single");
+  EXPECT_TRUE(WriteStringToFile(Env::Default(), file_name,
+                                "serialized request").ok());
+
+  std::vector<std::string> requests;
+  EXPECT_TRUE(WarmupRecorder::ReadRequests(file_name, &requests).ok());
+  EXPECT_EQ(std::vector<std::string>({"serialized request"}), requests);
+}
+
+} // processor
+} // tensorflow
@@ -0,0 +1,105 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <string.h>
+#include <algorithm>
+#include <functional>
+
+#include "serving/processor/storage/feature_cache.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace processor {
+
+FeatureCache::FeatureCache(size_t capacity, int64 ttl_us, int num_shards)
+    : shard_capacity_(std::max<size_t>(1, capacity / num_shards)),
+      ttl_us_(ttl_us) {
+  shards_.resize(num_shards);
+  for (auto& shard : shards_) {
+    shard.reset(new Shard);
+  }
+}
+
+std::string FeatureCache::MakeKey(uint64_t model_version,
+                                  uint64_t feature2id,
+                                  const char* key,
+                                  size_t bytes_per_key) {
+  std::string cache_key;
+  cache_key.reserve(sizeof(model_version) + sizeof(feature2id) +
+                    bytes_per_key);
+  cache_key.append(reinterpret_cast<const char*>(&model_version),
+                   sizeof(model_version));
+  cache_key.append(reinterpret_cast<const char*>(&feature2id),
+                   sizeof(feature2id));
+  cache_key.append(key, bytes_per_key);
+  return cache_key;
+}
+
+FeatureCache::Shard* FeatureCache::GetShard(const std::string& key) {
+  return shards_[std::hash<std::string>()(key) % shards_.size()].get();
+}
+
+bool FeatureCache::Lookup(const std::string& key, char* value,
+                          size_t bytes_per_value) {
+  Shard* shard = GetShard(key);
+  mutex_lock lock(shard->mu);
+  auto it = shard->index.find(key);
+  if (it == shard->index.end()) {
+    return false;
+  }
+  const int64 now_us = Env::Default()->NowMicros();
+  if (it->second->expire_us <= now_us ||
+      it->second->value.size() != bytes_per_value) {
+    shard->lru.erase(it->second);
+    shard->index.erase(it);
+    return false;
+  }
+  shard->lru.splice(shard->lru.begin(), shard->lru, it->second);
+  memcpy(value, it->second->value.data(), bytes_per_value);
+  return true;
+}
+
+void FeatureCache::Insert(const std::string& key, const char* value,
+                          size_t bytes_per_value) {
+  const int64 expire_us = Env::Default()->NowMicros() + ttl_us_;
+  Shard* shard = GetShard(key);
+  mutex_lock lock(shard->mu);
+  auto it = shard->index.find(key);
+  if (it != shard->index.end()) {
+    it->second->value.assign(value, bytes_per_value);
+    it->second->expire_us = expire_us;
+    shard->lru.splice(shard->lru.begin(), shard->lru, it->second);
+    return;
+  }
+  shard->lru.push_front(Entry{key, std::string(value, bytes_per_value),
+                              expire_us});
+  shard->index[key] = shard->lru.begin();
+  while (shard->lru.size() > shard_capacity_) {
+    shard->index.erase(shard->lru.back().key);
+    shard->lru.pop_back();
+  }
+}
+
+size_t FeatureCache::Size() {
+  size_t size = 0;
+  for (auto& shard : shards_) {
+    mutex_lock lock(shard->mu);
+    size += shard->lru.size();
+  }
+  return size;
+}
+
+} // processor
+} // tensorflow
@@ -0,0 +1,78 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef SERVING_PROCESSOR_STORAGE_FEATURE_CACHE_H_
+#define SERVING_PROCESSOR_STORAGE_FEATURE_CACHE_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace processor {
+
+// In-process LRU cache of the feature values read from the feature store.
+// A value expires ttl_us after it is inserted, so the values updated in
+// the feature store are read again at most ttl_us later. The cache is
+// split into shards by the hash of the key, each shard has its own lock
+// and evicts its least recently used values beyond capacity / num_shards.
+class FeatureCache {
+ public:
+  FeatureCache(size_t capacity, int64 ttl_us, int num_shards = 16);
+
+  // Returns the key of the value of a feature id, model versions and
+  // features have different keys.
+  static std::string MakeKey(uint64_t model_version, uint64_t feature2id,
+                             const char* key, size_t bytes_per_key);
+
+  // Copies the cached value of key to value, returns false when key is
+  // not cached or expired.
+  bool Lookup(const std::string& key, char* value, size_t bytes_per_value);
+  void Insert(const std::string& key, const char* value,
+              size_t bytes_per_value);
+
+  size_t Size();
+
+ private:
+  struct Entry {
+    std::string key;
+    std::string value;
+    int64 expire_us;
+  };
+
+  struct Shard {
+    mutex mu;
+    // Most recently used first.
+    std::list<Entry> lru GUARDED_BY(mu);
+    std::unordered_map<std::string, std::list<Entry>::iterator> index
+        GUARDED_BY(mu);
+  };
+
+  Shard* GetShard(const std::string& key);
+
+  const size_t shard_capacity_;
+  const int64 ttl_us_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+} // processor
+} // tensorflow
+
+#endif  // SERVING_PROCESSOR_STORAGE_FEATURE_CACHE_H_
@@ -0,0 +1,71 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "gtest/gtest.h"
+#include "serving/processor/storage/feature_cache.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace processor {
+
+namespace {
+std::string Key(uint64_t model_version, int64 id) {
+  return FeatureCache::MakeKey(model_version, 1, (const char*)&id,
+                               sizeof(id));
+}
+} // namespace
+
+class FeatureCacheTest : public ::testing::Test {
+};
+
+TEST_F(FeatureCacheTest, ShouldReturnInsertedValues) {
+  FeatureCache cache(100, 60 * 1000 * 1000, 1);
+  float value[2] = {1.0, 2.0};
+  cache.Insert(Key(1, 10), (const char*)value, sizeof(value));
+
+  float result[2] = {0};
+  EXPECT_TRUE(cache.Lookup(Key(1, 10), (char*)result, sizeof(result)));
+  EXPECT_EQ(1.0, result[0]);
+  EXPECT_EQ(2.0, result[1]);
+  // Another id or model version.
+  EXPECT_FALSE(cache.Lookup(Key(1, 11), (char*)result, sizeof(result)));
+  EXPECT_FALSE(cache.Lookup(Key(2, 10), (char*)result, sizeof(result)));
+}
+
+TEST_F(FeatureCacheTest, ShouldEvictLeastRecentlyUsedValues) {
+  FeatureCache cache(2, 60 * 1000 * 1000, 1);
+  float value = 1.0;
+  cache.Insert(Key(1, 1), (const char*)&value, sizeof(value));
+  cache.Insert(Key(1, 2), (const char*)&value, sizeof(value));
+  EXPECT_TRUE(cache.Lookup(Key(1, 1), (char*)&value, sizeof(value)));
+  cache.Insert(Key(1, 3), (const char*)&value, sizeof(value));
+
+  EXPECT_EQ(2, cache.Size());
+  EXPECT_TRUE(cache.Lookup(Key(1, 1), (char*)&value, sizeof(value)));
+  EXPECT_FALSE(cache.Lookup(Key(1, 2), (char*)&value, sizeof(value)));
+  EXPECT_TRUE(cache.Lookup(Key(1, 3), (char*)&value, sizeof(value)));
+}
+
+TEST_F(FeatureCacheTest, ShouldExpireValues) {
+  FeatureCache cache(100, 1000, 1);
+  float value = 1.0;
+  cache.Insert(Key(1, 1), (const char*)&value, sizeof(value));
+  Env::Default()->SleepForMicroseconds(10 * 1000);
+  EXPECT_FALSE(cache.Lookup(Key(1, 1), (char*)&value, sizeof(value)));
+  EXPECT_EQ(0, cache.Size());
+}
+
+} // processor
+} // tensorflow
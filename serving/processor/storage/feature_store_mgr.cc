@@ -13,10 +13,16 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <string.h>
+#include <algorithm>
+#include <memory>
+
 #include "serving/processor/storage/feature_store_mgr.h"
 #include "serving/processor/serving/model_config.h"
 #include "absl/synchronization/mutex.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace tensorflow {
 namespace processor {
@@ -122,6 +128,9 @@ FeatureStore* CreateFeatureStore(ModelConfig* config) {
     }
     redis_config.passwd = config->redis_password;
     redis_config.db_idx = config->redis_db_idx;
+    if (config->redis_mget_batch_size > 0) {
+      redis_config.mget_batch_size = config->redis_mget_batch_size;
+    }
 
     return new LocalRedis(redis_config);
   } else {
@@ -144,6 +153,31 @@ FeatureStore* CreateFeatureStore(ModelConfig* config) {
 
 } // namespace
 
+// The keys of a GetValues read from the feature store, which may be split
+// into parts read by different connections.
+struct FeatureStoreMgr::GetValuesCall {
+  uint64_t model_version;
+  uint64_t feature2id;
+  size_t bytes_per_key;
+  size_t bytes_per_values;
+  const char* default_value;
+  // The keys to read and the buffer of their values, which are the
+  // buffers of GetValues unless some keys are found in the cache.
+  const char* keys;
+  char* values;
+  // The keys missed in the cache, their values and their index in the
+  // buffers of GetValues.
+  std::string miss_keys;
+  std::string miss_values;
+  std::vector<size_t> miss_index;
+  char* out_values;
+
+  BatchGetCallback cb;
+  std::atomic<int> pending_parts;
+  mutex mu;
+  Status status GUARDED_BY(mu);
+};
+
 AsyncFeatureStoreMgr::AsyncFeatureStoreMgr(ModelConfig* config, WorkFn fn) :
     stop_(false),
     thread_num_(config->read_thread_num),
@@ -321,7 +355,8 @@ FeatureStoreMgr::FeatureStoreMgr(ModelConfig* config)
     update_thread_num_(config->update_thread_num),
     active_thread_index_(0),
     active_update_thread_index_(0),
-    storage_type_(config->feature_store_type) {
+    storage_type_(config->feature_store_type),
+    split_batch_size_(std::max(0, config->redis_mget_batch_size)) {
   if (thread_num_ < 1 || thread_num_ > MANAGER_MAX_THREAD_NUM) {
     LOG(FATAL) << "Invalid IO thread num, required [1, 96], get "
                << thread_num_;
@@ -342,9 +377,21 @@ FeatureStoreMgr::FeatureStoreMgr(ModelConfig* config)
   for (int i = 0; i < update_thread_num_; ++i) {
     update_store_[i] = CreateFeatureStore(config);
   }
+
+  if (config->feature_cache_capacity > 0) {
+    cache_.reset(new FeatureCache(config->feature_cache_capacity,
+        static_cast<int64>(config->feature_cache_ttl_ms) * 1000));
+  }
+  if (config->feature_store_async_get) {
+    read_thread_pool_.reset(new thread::ThreadPool(Env::Default(),
+        "feature_store_read", thread_num_));
+  }
 }
 
 FeatureStoreMgr::~FeatureStoreMgr() {
+  // Waits for the scheduled reads.
+  read_thread_pool_.reset();
+
   for (auto store : store_) {
     delete store;
   }
@@ -354,6 +401,39 @@ FeatureStoreMgr::~FeatureStoreMgr() {
   }
 }
 
+Status FeatureStoreMgr::ReadValues(GetValuesCall* call, size_t start,
+                                   size_t count) {
+  const size_t bytes_per_key = call->bytes_per_key;
+  const size_t bytes_per_values = call->bytes_per_values;
+  uint64_t index = active_thread_index_++;
+  index %= thread_num_;
+  {
+    std::lock_guard<std::mutex> lock(mutex_[index]);
+    TF_RETURN_IF_ERROR(store_[index]->BatchGet(
+        call->model_version, call->feature2id,
+        call->keys + start * bytes_per_key,
+        call->values + start * bytes_per_values,
+        bytes_per_key, bytes_per_values, count,
+        call->default_value));
+  }
+  if (cache_ == nullptr) {
+    return Status::OK();
+  }
+  // The default values of the keys not in the store are cached as well,
+  // they expire like the others.
+  for (size_t i = start; i < start + count; ++i) {
+    const char* value = call->values + i * bytes_per_values;
+    cache_->Insert(FeatureCache::MakeKey(call->model_version,
+                                         call->feature2id,
+                                         call->keys + i * bytes_per_key,
+                                         bytes_per_key),
+                   value, bytes_per_values);
+    memcpy(call->out_values + call->miss_index[i] * bytes_per_values,
+           value, bytes_per_values);
+  }
+  return Status::OK();
+}
+
 Status FeatureStoreMgr::GetValues(
     uint64_t model_version,
     uint64_t feature2id,
@@ -364,19 +444,78 @@ Status FeatureStoreMgr::GetValues(
     size_t N,
     const char* default_value,
     BatchGetCallback cb) {
-  uint64_t index = active_thread_index_++;
-  index %= thread_num_;
-  {
-    std::lock_guard<std::mutex> lock(mutex_[index]);
-    Status s = store_[index]->BatchGet(
-        model_version, feature2id, keys, values, 
-        bytes_per_key, bytes_per_values, N,
-        default_value);
-    if (s.ok()) {
-      cb(s);
+  auto call = std::make_shared<GetValuesCall>();
+  call->model_version = model_version;
+  call->feature2id = feature2id;
+  call->bytes_per_key = bytes_per_key;
+  call->bytes_per_values = bytes_per_values;
+  call->default_value = default_value;
+  call->keys = keys;
+  call->values = values;
+  call->out_values = values;
+
+  size_t num_keys = N;
+  if (cache_ != nullptr) {
+    for (size_t i = 0; i < N; ++i) {
+      const char* key = keys + i * bytes_per_key;
+      if (!cache_->Lookup(
+              FeatureCache::MakeKey(model_version, feature2id, key,
+                                    bytes_per_key),
+              values + i * bytes_per_values, bytes_per_values)) {
+        call->miss_index.push_back(i);
+        call->miss_keys.append(key, bytes_per_key);
+      }
     }
-    return s;
+    num_keys = call->miss_index.size();
+    call->miss_values.resize(num_keys * bytes_per_values);
+    call->keys = call->miss_keys.data();
+    call->values = &call->miss_values[0];
+  }
+  if (num_keys == 0) {
+    cb(Status::OK());
+    return Status::OK();
   }
+
+  size_t num_parts = 1;
+  if (split_batch_size_ > 0) {
+    num_parts = std::min<size_t>(thread_num_,
+        (num_keys + split_batch_size_ - 1) / split_batch_size_);
+  }
+  const size_t part_size = (num_keys + num_parts - 1) / num_parts;
+  num_parts = (num_keys + part_size - 1) / part_size;
+
+  if (read_thread_pool_ == nullptr) {
+    for (size_t start = 0; start < num_keys; start += part_size) {
+      TF_RETURN_IF_ERROR(ReadValues(call.get(), start,
+          std::min(part_size, num_keys - start)));
+    }
+    cb(Status::OK());
+    return Status::OK();
+  }
+
+  // The parts are read by different connections at the same time, the
+  // last finished part calls cb.
+  call->cb = std::move(cb);
+  call->pending_parts = num_parts;
+  for (size_t start = 0; start < num_keys; start += part_size) {
+    const size_t count = std::min(part_size, num_keys - start);
+    read_thread_pool_->Schedule([this, call, start, count]() {
+      Status s = ReadValues(call.get(), start, count);
+      if (!s.ok()) {
+        mutex_lock lock(call->mu);
+        call->status.Update(s);
+      }
+      if (--call->pending_parts == 0) {
+        Status status;
+        {
+          mutex_lock lock(call->mu);
+          status = call->status;
+        }
+        call->cb(status);
+      }
+    });
+  }
+  return Status::OK();
 }
 
 Status FeatureStoreMgr::SetValues(
@@ -25,6 +25,8 @@ limitations under the License.
 #include "concurrentqueue.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "serving/processor/storage/feature_cache.h"
 #include "serving/processor/storage/redis_feature_store.h"
 
 namespace tensorflow {
@@ -137,6 +139,9 @@ class IFeatureStoreMgr {
                                 bool* success) = 0;
   virtual Status ReleaseStorageLock(int value) = 0;
 
+  // Reads the values of N keys, cb is called once the values are read
+  // when Status::OK is returned, cb may be called by another thread
+  // after GetValues returns.
   virtual Status GetValues(uint64_t model_version,
                            uint64_t feature2id,
                            const char* const keys,
@@ -200,6 +205,10 @@ class FeatureStoreMgr : public IFeatureStoreMgr {
   Status Reset() override;
 
  private:
+  struct GetValuesCall;
+  // Reads count keys of call from start by one read connection.
+  Status ReadValues(GetValuesCall* call, size_t start, size_t count);
+
   int thread_num_ = 0;
   int update_thread_num_ = 0;
   std::atomic<uint64_t> active_thread_index_;
@@ -209,6 +218,12 @@ class FeatureStoreMgr : public IFeatureStoreMgr {
   std::vector<FeatureStore*> store_; // one connection per store
   std::vector<FeatureStore*> update_store_;
   std::string storage_type_;
+  // A batch of more keys is split across the read connections.
+  size_t split_batch_size_ = 0;
+  std::unique_ptr<FeatureCache> cache_;
+  // Runs the reads of GetValues asynchronously, nullptr when the reads
+  // run in the calling thread.
+  std::unique_ptr<thread::ThreadPool> read_thread_pool_;
 };
 
 } // processor
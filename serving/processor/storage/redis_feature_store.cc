@@ -1,4 +1,5 @@
 #include <unistd.h>
+#include <algorithm>
 #include <vector>
 #include <string>
 
@@ -206,6 +207,7 @@ LocalRedis::LocalRedis(const Config& config)
   : ip_(config.ip),
     port_(config.port),
     db_idx_(config.db_idx),
+    mget_batch_size_(config.mget_batch_size),
     c_(nullptr) {
   assert((c_ = redisConnect(ip_.c_str(), port_)) != nullptr);
 
@@ -376,65 +378,82 @@ Status LocalRedis::BatchGet(uint64_t model_version,
                             size_t bytes_per_values,
                             size_t N,
                             const char* default_value) {
-  int64_t len = N;
+  if (N == 0) {
+    return Status::OK();
+  }
   size_t keys_byte_lens = bytes_per_key;
-  char ** argv = new char*[len + 1 ];
-  size_t * argvlen = new size_t[len + 1 ];
-
-  int j = 0;
-  argv[j] = new char[5];
-  memcpy(argv[j],"MGET",4);
-  argvlen[j] = 4;
-  ++j;
+  std::vector<std::string> redis_keys(N);
 
 #if DEBUG
-  for(int i = 0 ; i < len; i++) {
+  for(int i = 0 ; i < N; i++) {
     std::string key = std::to_string(*(int64*)(keys + i*keys_byte_lens));
-    std::string key2 = std::to_string(model_version) + "_" + \
-                       std::to_string(feature2id) + "_" + key;
-    size_t key_length = key2.size();
-    argvlen[j] = key_length;
-    argv[j] = new char[key_length];
-    memcpy((void*)argv[j], key2.c_str(), key_length);
-    j++;
+    redis_keys[i] = std::to_string(model_version) + "_" + \
+                    std::to_string(feature2id) + "_" + key;
   }
 #else
   int size_feature2id = sizeof(feature2id);
   int size_model_version = sizeof(model_version);
-  size_t key_length = keys_byte_lens + \
-                      size_model_version + \
-                      size_feature2id;
-  for(int i = 0 ; i < len; i++) {
-    argvlen[j] = key_length;
-    argv[j] = new char[key_length];
-    memcpy((void*)argv[j], &model_version, size_model_version);
-    memcpy((void*)(argv[j] + size_model_version), &feature2id, sizeof(feature2id));
-    memcpy((void*)(argv[j] + size_model_version + size_feature2id),
-           keys + i * keys_byte_lens, keys_byte_lens);
-    j++;
+  for(int i = 0 ; i < N; i++) {
+    std::string& key = redis_keys[i];
+    key.reserve(keys_byte_lens + size_model_version + size_feature2id);
+    key.append((const char*)&model_version, size_model_version);
+    key.append((const char*)&feature2id, size_feature2id);
+    key.append(keys + i * keys_byte_lens, keys_byte_lens);
   }
 #endif
 
-  redisReply *reply = (redisReply *)redisCommandArgv(c_,
-                          len + 1, const_cast<const char **>(argv), argvlen);
-
-  for(int i = 0; i < j; i++) {
-    delete [] argv[i];
-    argv[i] = NULL;
+  // Every mget_batch_size_ keys are sent in one MGET, the MGETs are
+  // pipelined so that the replies of the large batch are read in one
+  // round trip while redis is not blocked by a huge MGET.
+  const size_t batch_size =
+      mget_batch_size_ > 0 ? std::min<size_t>(mget_batch_size_, N) : N;
+  std::vector<const char*> argv(batch_size + 1);
+  std::vector<size_t> argvlen(batch_size + 1);
+  argv[0] = "MGET";
+  argvlen[0] = 4;
+  size_t num_commands = 0;
+  for (size_t start = 0; start < N; start += batch_size) {
+    const size_t count = std::min(batch_size, N - start);
+    for (size_t i = 0; i < count; ++i) {
+      argv[i + 1] = redis_keys[start + i].data();
+      argvlen[i + 1] = redis_keys[start + i].size();
+    }
+    if (redisAppendCommandArgv(c_, count + 1, argv.data(),
+                               argvlen.data()) != REDIS_OK) {
+      return Status(error::Code::INTERNAL,
+          "[Redis] run redisAppendCommandArgv-MGET failed." +
+          std::string(c_->errstr));
+    }
+    ++num_commands;
   }
-  delete []argv;
-  delete []argvlen;
 
-  if (REDIS_REPLY_ARRAY != reply->type) {
-    Status s(error::Code::INTERNAL,
-      "[Redis] run redisCommandArgv-MGET failed." + std::string(reply->str));
-    return s;
-  } else {
+  // All the replies are read to keep the connection in sync even if
+  // some MGET failed.
+  Status status;
+  for (size_t cmd = 0; cmd < num_commands; ++cmd) {
+    redisReply *reply = nullptr;
+    if (redisGetReply(c_, (void**)&reply) != REDIS_OK ||
+        reply == nullptr) {
+      return Status(error::Code::INTERNAL,
+          "[Redis] run redisGetReply-MGET failed." +
+          std::string(c_->errstr));
+    }
+    const size_t start = cmd * batch_size;
+    if (!status.ok()) {
+      freeReplyObject(reply);
+      continue;
+    }
+    if (REDIS_REPLY_ARRAY != reply->type) {
+      status = Status(error::Code::INTERNAL,
+          "[Redis] run redisCommandArgv-MGET failed." +
+          std::string(reply->str ? reply->str : ""));
+      freeReplyObject(reply);
+      continue;
+    }
     for (int i = 0; i < reply->elements; i++) {
+      char* value = values + (start + i) * bytes_per_values;
       if (REDIS_REPLY_NIL == reply->element[i]->type) {
-        memcpy((void*)values + i * bytes_per_values,
-               default_value,
-               bytes_per_values);
+        memcpy(value, default_value, bytes_per_values);
       } else if (REDIS_REPLY_STRING == reply->element[i]->type) {
 #if DEBUG
         std::string result(reply->element[i]->str);
@@ -444,22 +463,21 @@ Status LocalRedis::BatchGet(uint64_t model_version,
         for (int k =0; k < strs.size() -1; ++k) {
           v[k] = std::stof(strs[k]);
         }
-        memcpy(values + i * bytes_per_values,
-               v,
-               (strs.size()-1) * sizeof(float));
+        memcpy(value, v, (strs.size()-1) * sizeof(float));
 #else
-        memcpy(values + i * bytes_per_values,
-               reply->element[i]->str,
-               reply->element[i]->len);
+        memcpy(value, reply->element[i]->str,
+               std::min<size_t>(reply->element[i]->len, bytes_per_values));
 #endif
       } else {
-        Status s(error::Code::INTERNAL,
-          "[Redis] run redisCommandArgv-MGET failed." + std::string(reply->str));
-        return s;
+        status = Status(error::Code::INTERNAL,
+            "[Redis] run redisCommandArgv-MGET failed, unexpected reply "
+            "type " + std::to_string(reply->element[i]->type));
+        break;
       }
     }
+    freeReplyObject(reply);
   }
-  return Status::OK();
+  return status;
 }
 
 Status LocalRedis::BatchSet(uint64_t model_version,
@@ -22,6 +22,9 @@ class LocalRedis : public FeatureStore {
       int32_t port = 0;
       std::string passwd;
       size_t db_idx = 0;
+      // Keys per MGET of BatchGet, the MGETs are pipelined.
+      // 0 means all the keys in one MGET.
+      size_t mget_batch_size = 0;
     };
 
     LocalRedis(const Config& config);
@@ -79,6 +82,7 @@ class LocalRedis : public FeatureStore {
     std::string ip_;
     int32_t port_;
     size_t db_idx_;
+    size_t mget_batch_size_;
     redisContext *c_;
 };
 
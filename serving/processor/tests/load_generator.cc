@@ -0,0 +1,145 @@
+#include <unistd.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include "serving/processor/tests/load_generator.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace processor {
+
+int64 LoadReport::peak_rss_bytes() const {
+  int64 peak = -1;
+  for (auto& sample : samples) {
+    peak = std::max(peak, sample.rss_bytes);
+  }
+  return peak;
+}
+
+std::string LoadReport::DebugString() const {
+  std::string s = strings::StrCat(
+      "calls: ", num_calls, ", requests: ", num_requests,
+      ", failed calls: ", num_failed_calls,
+      ", elapsed: ", elapsed_secs, "s",
+      ", throughput: ", throughput(), " qps\n",
+      "latency (ms): p50 ", latency_us.Percentile(50) / 1000,
+      ", p99 ", latency_us.Percentile(99) / 1000,
+      ", p999 ", latency_us.Percentile(99.9) / 1000,
+      ", max ", latency_us.Percentile(100) / 1000,
+      ", avg ", latency_us.Average() / 1000, "\n",
+      "peak rss: ", peak_rss_bytes() >> 20, "MB\n");
+  std::string version;
+  for (auto& sample : samples) {
+    // The memory around the swaps of the model version.
+    if (sample.model_version != version) {
+      version = sample.model_version;
+      strings::StrAppend(&s, "  ", sample.elapsed_ms, "ms: version ",
+                         version.empty() ? "-" : version, "\n");
+    }
+    strings::StrAppend(&s, "  ", sample.elapsed_ms, "ms: rss ",
+                       sample.rss_bytes >> 20, "MB\n");
+  }
+  return s;
+}
+
+LoadGenerator::LoadGenerator(const LoadGeneratorOptions& options)
+    : options_(options) {
+}
+
+int64 LoadGenerator::ResidentBytes() {
+  // The second field of statm is the resident pages.
+  std::string statm;
+  if (!ReadFileToString(Env::Default(), "/proc/self/statm", &statm).ok()) {
+    return -1;
+  }
+  std::vector<std::string> fields = str_util::Split(statm, ' ');
+  int64 pages = 0;
+  if (fields.size() < 2 || !strings::safe_strto64(fields[1], &pages)) {
+    return -1;
+  }
+  return pages * sysconf(_SC_PAGESIZE);
+}
+
+void LoadGenerator::Run(const std::vector<std::string>& requests,
+                        const ProcessFn& process, const VersionFn& version,
+                        LoadReport* report) {
+  if (requests.empty() || options_.qps <= 0) {
+    return;
+  }
+  Env* env = Env::Default();
+  const int batch_size = std::max(options_.batch_size, 1);
+  const double calls_per_sec = options_.qps / batch_size;
+  const uint64 start = env->NowMicros();
+  const uint64 end = start + options_.duration_secs * 1000000;
+
+  mutex mu;
+  bool done = false;
+  condition_variable done_cv;
+  std::unique_ptr<Thread> sampler(env->StartThread(
+      ThreadOptions(), "load_sampler", [&]() {
+    while (true) {
+      LoadSample sample;
+      sample.elapsed_ms = (env->NowMicros() - start) / 1000;
+      sample.rss_bytes = ResidentBytes();
+      if (version) {
+        sample.model_version = version();
+      }
+      mutex_lock lock(mu);
+      report->samples.push_back(std::move(sample));
+      if (done) {
+        break;
+      }
+      done_cv.wait_for(lock, std::chrono::milliseconds(
+          std::max<int64>(options_.sample_interval_ms, 1)));
+    }
+  }));
+
+  {
+    thread::ThreadPool pool(env, "load_generator",
+                            std::max(options_.num_threads, 1));
+    std::mt19937_64 rng(options_.seed);
+    std::exponential_distribution<double> poisson(calls_per_sec);
+    double due = start;
+    size_t next = 0;
+    while (due < end) {
+      const uint64 now = env->NowMicros();
+      if (due > now) {
+        env->SleepForMicroseconds(static_cast<int64>(due - now));
+      }
+      auto batch = std::make_shared<std::vector<const std::string*>>();
+      for (int i = 0; i < batch_size; ++i) {
+        batch->push_back(&requests[next++ % requests.size()]);
+      }
+      const uint64 call_due = due;
+      pool.Schedule([&, batch, call_due]() {
+        const int state = process(*batch);
+        const uint64 latency = env->NowMicros() - call_due;
+        mutex_lock lock(mu);
+        ++report->num_calls;
+        report->num_requests += batch->size();
+        if (state != 200) {
+          ++report->num_failed_calls;
+        }
+        report->latency_us.Add(latency);
+      });
+      due += options_.poisson ? poisson(rng) * 1e6 : 1e6 / calls_per_sec;
+    }
+    // The pool waits for the pending calls when destroyed.
+  }
+  report->elapsed_secs = (env->NowMicros() - start) / 1e6;
+
+  {
+    mutex_lock lock(mu);
+    done = true;
+    done_cv.notify_all();
+  }
+  sampler.reset();
+}
+
+} // processor
+} // tensorflow
@@ -0,0 +1,87 @@
+#ifndef SERVING_PROCESSOR_TESTS_LOAD_GENERATOR_H
+#define SERVING_PROCESSOR_TESTS_LOAD_GENERATOR_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "tensorflow/core/lib/histogram/histogram.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace processor {
+
+struct LoadGeneratorOptions {
+  // The target of requests per second, each call of batch_size requests
+  // counting batch_size times.
+  double qps = 100.0;
+  int64 duration_secs = 60;
+  // Requests per call, more than one driving batch_process.
+  int batch_size = 1;
+  // Threads issuing the calls, the concurrency beyond which the calls
+  // queue, which counts in their latency.
+  int num_threads = 64;
+  // Exponential inter-arrival times if true, a constant rate otherwise.
+  bool poisson = true;
+  // Interval of the samples of the memory and of the model version.
+  int64 sample_interval_ms = 1000;
+  uint64 seed = 1;
+};
+
+// The memory of the process and the serving model at a time of the run.
+struct LoadSample {
+  int64 elapsed_ms;
+  int64 rss_bytes;
+  std::string model_version;
+};
+
+struct LoadReport {
+  int64 num_calls = 0;
+  int64 num_requests = 0;
+  int64 num_failed_calls = 0;
+  double elapsed_secs = 0;
+  // Latency of the calls in microseconds, from the time they were due to
+  // the time they returned, so that a slow processor delaying the later
+  // calls is not hidden.
+  histogram::Histogram latency_us;
+  std::vector<LoadSample> samples;
+
+  double throughput() const {
+    return elapsed_secs > 0 ? num_requests / elapsed_secs : 0;
+  }
+  int64 peak_rss_bytes() const;
+  std::string DebugString() const;
+};
+
+// An open-loop load generator: calls are issued at the target rate,
+// whether or not the previous calls returned, as the live traffic of a
+// processor does. It quantifies the latency and the throughput of a
+// configuration of batching, caching or session groups, and samples the
+// memory of the process, e.g. while the processor hot-swaps versions of
+// the model under load.
+class LoadGenerator {
+ public:
+  // Processes the requests of a call, returns its state, 200 on success.
+  typedef std::function<int(const std::vector<const std::string*>&)>
+      ProcessFn;
+  // Returns the version of the serving model.
+  typedef std::function<std::string()> VersionFn;
+
+  explicit LoadGenerator(const LoadGeneratorOptions& options);
+
+  // Sends the requests in turn to process, reports the run to report,
+  // which is expected empty. version may be null.
+  void Run(const std::vector<std::string>& requests,
+           const ProcessFn& process, const VersionFn& version,
+           LoadReport* report);
+
+  // The resident memory of the process, -1 if unknown.
+  static int64 ResidentBytes();
+
+ private:
+  const LoadGeneratorOptions options_;
+};
+
+} // processor
+} // tensorflow
+
+#endif // SERVING_PROCESSOR_TESTS_LOAD_GENERATOR_H
@@ -0,0 +1,60 @@
+#include <atomic>
+#include "gtest/gtest.h"
+#include "serving/processor/tests/load_generator.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace processor {
+namespace {
+
+TEST(LoadGeneratorTest, SendsAtTargetRate) {
+  LoadGeneratorOptions options;
+  options.qps = 400;
+  options.duration_secs = 1;
+  options.batch_size = 2;
+  options.num_threads = 4;
+  options.poisson = false;
+  options.sample_interval_ms = 100;
+  std::vector<std::string> requests = {"a", "b", "c"};
+  std::atomic<int> num_a(0);
+  std::atomic<int> num_versions(0);
+  LoadReport report;
+  LoadGenerator(options).Run(
+      requests,
+      [&num_a](const std::vector<const std::string*>& batch) {
+        EXPECT_EQ(2u, batch.size());
+        for (auto request : batch) {
+          num_a += *request == "a";
+        }
+        Env::Default()->SleepForMicroseconds(1000);
+        return *batch[0] == "c" ? 500 : 200;
+      },
+      [&num_versions]() {
+        return ++num_versions < 3 ? "1" : "2";
+      },
+      &report);
+
+  // 200 calls of 2 requests at a constant rate, every third one failed.
+  EXPECT_EQ(200, report.num_calls);
+  EXPECT_EQ(400, report.num_requests);
+  EXPECT_EQ(134, num_a);
+  EXPECT_EQ(67, report.num_failed_calls);
+  EXPECT_GE(report.elapsed_secs, 1);
+  EXPECT_GE(report.latency_us.Percentile(50), 1000);
+  EXPECT_GE(report.samples.size(), 10u);
+  EXPECT_EQ("1", report.samples.front().model_version);
+  EXPECT_EQ("2", report.samples.back().model_version);
+  EXPECT_GT(report.peak_rss_bytes(), 0);
+}
+
+TEST(LoadGeneratorTest, ResidentBytes) {
+  const int64 before = LoadGenerator::ResidentBytes();
+  EXPECT_GT(before, 0);
+  std::vector<char> buffer(64 << 20, 1);
+  EXPECT_GE(LoadGenerator::ResidentBytes(), before + (32 << 20));
+  EXPECT_EQ(1, buffer.back());
+}
+
+} // namespace
+} // processor
+} // tensorflow
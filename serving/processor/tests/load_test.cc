@@ -0,0 +1,198 @@
+#include <stdlib.h>
+#include <iostream>
+#include <random>
+#include "serving/processor/serving/predict.pb.h"
+#include "serving/processor/serving/processor.h"
+#include "serving/processor/serving/warmup_recorder.h"
+#include "serving/processor/tests/load_generator.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+// Drives the processor at a target QPS and reports the latency, the
+// throughput and the memory of the process, e.g.
+//
+//   bazel-bin/serving/processor/tests/load_test \
+//       --model_config=config.json --requests=warmup.tfrecords \
+//       --qps=2000 --batch_size=8 --duration_secs=600
+//
+// The requests are the recorded ones of a warmup file, see WarmupRecorder,
+// or synthetic ones of random float inputs, e.g. --inputs="x:1,1". A new
+// version of the model put in the checkpoint_dir or savedmodel_dir of the
+// config during the run is hot-swapped under load, and the report shows
+// the memory before and after the swap.
+
+namespace tensorflow {
+namespace processor {
+namespace {
+
+// Builds num_requests requests of random float inputs, given as
+// name:dim,dim;name:dim,...
+Status SyntheticRequests(const std::string& inputs,
+                         const std::string& signature_name,
+                         const std::string& output_filter, int num_requests,
+                         std::vector<std::string>* requests) {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> values(0, 1);
+  for (int r = 0; r < num_requests; ++r) {
+    eas::PredictRequest req;
+    req.set_signature_name(signature_name);
+    for (auto& output : str_util::Split(output_filter, ',',
+                                        str_util::SkipEmpty())) {
+      req.add_output_filter(output);
+    }
+    for (auto& input : str_util::Split(inputs, ';', str_util::SkipEmpty())) {
+      std::vector<std::string> name_and_shape = str_util::Split(input, ':');
+      if (name_and_shape.size() != 2) {
+        return errors::InvalidArgument("Invalid input: ", input);
+      }
+      eas::ArrayProto& array = (*req.mutable_inputs())[name_and_shape[0]];
+      array.set_dtype(eas::ArrayDataType::DT_FLOAT);
+      int64 num_values = 1;
+      for (auto& dim : str_util::Split(name_and_shape[1], ',')) {
+        int64 size = 0;
+        if (!strings::safe_strto64(dim, &size) || size < 0) {
+          return errors::InvalidArgument("Invalid shape of input: ", input);
+        }
+        array.mutable_array_shape()->add_dim(size);
+        num_values *= size;
+      }
+      for (int64 i = 0; i < num_values; ++i) {
+        array.add_float_val(values(rng));
+      }
+    }
+    requests->push_back(req.SerializeAsString());
+  }
+  return Status::OK();
+}
+
+} // namespace
+} // processor
+} // tensorflow
+
+int main(int argc, char** argv) {
+  using namespace tensorflow;
+  using namespace tensorflow::processor;
+
+  std::string model_entry;
+  std::string model_config;
+  std::string requests_file;
+  std::string inputs;
+  std::string signature_name = "serving_default";
+  std::string output_filter;
+  int32 num_synthetic_requests = 100;
+  LoadGeneratorOptions options;
+  float qps = options.qps;
+  int32 batch_size = options.batch_size;
+  int32 num_threads = options.num_threads;
+  int64 duration_secs = options.duration_secs;
+  int64 sample_interval_ms = options.sample_interval_ms;
+  bool poisson = options.poisson;
+  std::vector<Flag> flag_list = {
+      Flag("model_entry", &model_entry, "The model entry of initialize."),
+      Flag("model_config", &model_config,
+           "The file of the model config of initialize."),
+      Flag("requests", &requests_file,
+           "A warmup file of recorded requests, or a serialized request."),
+      Flag("inputs", &inputs,
+           "The float inputs of the synthetic requests, without --requests, "
+           "as name:dim,dim;name:dim,..."),
+      Flag("signature_name", &signature_name,
+           "The signature of the synthetic requests."),
+      Flag("output_filter", &output_filter,
+           "The comma separated outputs of the synthetic requests."),
+      Flag("num_synthetic_requests", &num_synthetic_requests,
+           "The number of distinct synthetic requests."),
+      Flag("qps", &qps, "The target of requests per second."),
+      Flag("batch_size", &batch_size,
+           "The requests per call, more than one calling batch_process."),
+      Flag("num_threads", &num_threads, "The threads issuing the calls."),
+      Flag("duration_secs", &duration_secs, "The duration of the run."),
+      Flag("sample_interval_ms", &sample_interval_ms,
+           "The interval of the samples of the memory and of the version."),
+      Flag("poisson", &poisson,
+           "Poisson arrivals if true, a constant rate otherwise."),
+  };
+  const std::string usage = Flags::Usage(argv[0], flag_list);
+  if (!Flags::Parse(&argc, argv, flag_list) || model_config.empty()) {
+    std::cerr << usage;
+    return 1;
+  }
+  port::InitMain(argv[0], &argc, &argv);
+  options.qps = qps;
+  options.batch_size = batch_size;
+  options.num_threads = num_threads;
+  options.duration_secs = duration_secs;
+  options.sample_interval_ms = sample_interval_ms;
+  options.poisson = poisson;
+
+  std::string config;
+  TF_CHECK_OK(ReadFileToString(Env::Default(), model_config, &config));
+  std::vector<std::string> requests;
+  if (!requests_file.empty()) {
+    TF_CHECK_OK(WarmupRecorder::ReadRequests(requests_file, &requests));
+  } else {
+    TF_CHECK_OK(SyntheticRequests(inputs, signature_name, output_filter,
+                                  num_synthetic_requests, &requests));
+  }
+  LOG(INFO) << "Sending " << requests.size() << " distinct requests at "
+            << options.qps << " qps for " << options.duration_secs << "s";
+
+  int state = 0;
+  void* model = initialize(model_entry.c_str(), config.c_str(), &state);
+  if (state == -1) {
+    LOG(ERROR) << "Initialize the processor failed.";
+    return 1;
+  }
+
+  auto run_batch = [model](const std::vector<const std::string*>& batch) {
+    const int n = batch.size();
+    std::vector<const void*> input_data(n);
+    std::vector<int> input_size(n);
+    for (int i = 0; i < n; ++i) {
+      input_data[i] = batch[i]->data();
+      input_size[i] = batch[i]->size();
+    }
+    std::vector<void*> output_data(n, nullptr);
+    std::vector<int> output_size(n, 0);
+    const int call_state = n == 1
+        ? process(model, input_data[0], input_size[0], &output_data[0],
+                  &output_size[0])
+        : batch_process(model, n, input_data.data(), input_size.data(),
+                        output_data.data(), output_size.data());
+    // The responses are allocated with new[], the error messages with
+    // malloc. Which of the outputs of a failed batch are error messages is
+    // unknown, they are leaked.
+    if (call_state == 200) {
+      for (void* output : output_data) {
+        delete[] static_cast<char*>(output);
+      }
+    } else if (n == 1) {
+      free(output_data[0]);
+    }
+    return call_state;
+  };
+  auto version = [model]() {
+    void* output = nullptr;
+    int output_size = 0;
+    std::string model_path;
+    if (get_serving_model_info(model, &output, &output_size) == 200) {
+      eas::ServingModelInfo info;
+      if (info.ParseFromArray(output, output_size)) {
+        model_path = info.model_path();
+      }
+      delete[] static_cast<char*>(output);
+    } else {
+      free(output);
+    }
+    return model_path;
+  };
+
+  LoadReport report;
+  LoadGenerator(options).Run(requests, run_batch, version, &report);
+  std::cout << report.DebugString();
+  return report.num_failed_calls == 0 ? 0 : 1;
+}
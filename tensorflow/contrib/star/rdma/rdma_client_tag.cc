@@ -0,0 +1,140 @@
+#ifdef TENSORFLOW_USE_VERBS
+
+#include <unistd.h>
+
+#include "tensorflow/contrib/star/rdma/rdma_client_tag.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace {
+
+// Default connection timeout is 120s.
+static const size_t kMaxConnectionTimeoutInMS = 120000;
+static const size_t kUSleepInMS = 100;
+static const size_t kUSleepInUs = 1000 * kUSleepInMS;
+
+int64 GetMaxConnectionTimeout() {
+  int64 max_connection_timeout = kMaxConnectionTimeoutInMS;
+  ReadInt64FromEnvVar("NETWORK_MAX_CONNECTION_TIMEOUT",
+      kMaxConnectionTimeoutInMS, &max_connection_timeout);
+
+  return max_connection_timeout;
+}
+
+std::string GenErrorMsg(bool is_init, bool is_broken, const std::string& addr) {
+  std::string msg = "Rdma channel: unknown error. connection is : " + addr;
+
+  if (!is_init) {
+    msg = "Rdma channel: connection is timeout. connection is : " + addr;
+  }
+
+  if (is_broken) {
+    msg = "Rdma channel: connection is broken. connection is : " + addr;
+  }
+
+  return msg;
+}
+
+} // namespace
+
+RdmaClientTag::RdmaClientTag(tensorflow::StarWorkerServiceMethod method,
+                             WorkerEnv* env, int resp_tesnsor_count,
+                             int req_tensor_count)
+  : StarClientTag(method, env, resp_tesnsor_count, req_tensor_count) {}
+
+void RdmaClientTag::RetryStartReq(int retry_count,
+                                  RdmaStarChannel* rdma_channel) {
+  usleep(kUSleepInUs);
+  bool is_init = rdma_channel->is_init();
+  bool is_broken = rdma_channel->is_channel_broken();
+
+  if (is_init && !is_broken) {
+    // Good case.
+    LOG(WARNING) << "Rdma conn success after retry.";
+    Put(rdma_channel);
+
+  } else if (--retry_count > 0 && !is_broken) {
+    // Bad case and need retry.
+    LOG(WARNING) << "Rdma conn timeout for: " << rdma_channel->get_addr()
+                 << ", left retry count: " << retry_count;
+    ScheduleProcess([this, retry_count, rdma_channel]() {
+        RetryStartReq(retry_count, rdma_channel);
+      });
+
+  } else {
+    // Bad case and retry count is exhausted.
+    LOG(ERROR) << "Rdma conn failed for: " << rdma_channel->get_addr()
+               << ", retry count is exhausted.";
+    Status s(error::INTERNAL,
+             GenErrorMsg(is_init, is_broken, rdma_channel->get_addr()));
+    ScheduleProcess([this, s]() {
+        HandleResponse(s);
+      });
+  }
+}
+
+void RdmaClientTag::StartReq(RdmaStarChannel* rdma_channel) {
+  bool is_init = rdma_channel->is_init();
+  bool is_broken = rdma_channel->is_channel_broken();
+
+  if (is_init && !is_broken) {
+    // Good case.
+    Put(rdma_channel);
+  } else if (!fail_fast_ && !is_broken) {
+    // Bad case and need retry.
+    int max_retry = GetMaxConnectionTimeout() / kUSleepInMS;
+    if (timeout_in_ms_ != 0) {
+      max_retry = timeout_in_ms_ / kUSleepInMS;
+    }
+
+    LOG(WARNING) << "Rdma conn timeout for: " << rdma_channel->get_addr()
+                 << ", now do retry with max retry count: " << max_retry;
+    ScheduleProcess([this, max_retry, rdma_channel]() {
+        RetryStartReq(max_retry, rdma_channel);
+      });
+
+  } else {
+    // Bad case and fail fast, a broken queue pair is not reconnected.
+    LOG(ERROR) << "Rdma conn failed for: " << rdma_channel->get_addr()
+               << ", now fail fast.";
+    tensorflow::Status s(error::INTERNAL,
+                         GenErrorMsg(is_init, is_broken, rdma_channel->get_addr()));
+    ScheduleProcess([this, s] {
+        HandleResponse(s);
+      });
+  }
+}
+
+void RdmaClientTag::Put(RdmaStarChannel* rdma_channel) {
+  // The request buffers live in the tag until the response is handled.
+  if (IsStarRunGraph()) {
+    rdma_channel->Put(ToFragmentsWithTensors(), []{});
+  } else {
+    rdma_channel->Put(ToFragments(), []{});
+  }
+}
+
+std::vector<RdmaStarChannel::Fragment> RdmaClientTag::ToFragments() {
+  return {{req_header_buf_.data_, req_header_buf_.len_},
+          {req_body_buf_.data_, req_body_buf_.len_}};
+}
+
+std::vector<RdmaStarChannel::Fragment> RdmaClientTag::ToFragmentsWithTensors() {
+  std::vector<RdmaStarChannel::Fragment> frags;
+  frags.push_back({req_header_buf_.data_, req_header_buf_.len_});
+  frags.push_back({req_body_buf_.data_, req_body_buf_.len_});
+
+  for (int i = 0; i < req_tensor_count_; ++i) {
+    frags.push_back({req_message_bufs_[i].data_, req_message_bufs_[i].len_});
+    if (req_tensor_bufs_[i].len_ > 0) {
+      frags.push_back({req_tensor_bufs_[i].data_, req_tensor_bufs_[i].len_});
+    }
+  }
+
+  return frags;
+}
+
+} // namespace tensorflow
+
+#endif // TENSORFLOW_USE_VERBS
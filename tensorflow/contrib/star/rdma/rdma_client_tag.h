@@ -0,0 +1,31 @@
+#ifndef TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_CLIENT_TAG_H_
+#define TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_CLIENT_TAG_H_
+
+#ifdef TENSORFLOW_USE_VERBS
+
+#include <vector>
+
+#include "tensorflow/contrib/star/rdma/rdma_star_channel.h"
+#include "tensorflow/contrib/star/star_client_tag.h"
+
+namespace tensorflow {
+
+class RdmaClientTag : public StarClientTag {
+ public:
+  RdmaClientTag(tensorflow::StarWorkerServiceMethod method,
+                WorkerEnv* env, int resp_tesnsor_count = 0,
+                int req_tensor_count = 0);
+  void StartReq(RdmaStarChannel* rdma_channel);
+
+ private:
+  void RetryStartReq(int retry_count, RdmaStarChannel* rdma_channel);
+  void Put(RdmaStarChannel* rdma_channel);
+  std::vector<RdmaStarChannel::Fragment> ToFragments();
+  std::vector<RdmaStarChannel::Fragment> ToFragmentsWithTensors();
+};
+
+} // namespace tensorflow
+
+#endif // TENSORFLOW_USE_VERBS
+
+#endif // TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_CLIENT_TAG_H_
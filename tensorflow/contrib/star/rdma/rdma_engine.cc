@@ -0,0 +1,271 @@
+#ifdef TENSORFLOW_USE_VERBS
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#include "tensorflow/contrib/star/rdma/rdma_client_tag.h"
+#include "tensorflow/contrib/star/rdma/rdma_engine.h"
+#include "tensorflow/contrib/star/rdma/rdma_server_tag.h"
+#include "tensorflow/contrib/star/rdma/rdma_star_channel.h"
+#include "tensorflow/contrib/star/rdma/rdma_tag_factory.h"
+#include "tensorflow/contrib/star/star_message.h"
+#include "tensorflow/contrib/star/star_worker_service.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace {
+
+// Default connection timeout is 120s.
+const int64 kMaxConnectionTimeoutInMS = 120000;
+const int64 kUSleepInMS = 100;
+
+int ConnectOnce(const std::string& server_ip) {
+  const auto& vec = str_util::Split(server_ip, ':');
+  if (vec.size() != 2) {
+    LOG(FATAL) << "Error ip:port or hostname:port info: " << server_ip;
+  }
+
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;     /* ipv4 or ipv6 */
+  hints.ai_socktype = SOCK_STREAM; /* stream socket */
+
+  addrinfo* addrs = nullptr;
+  int s = getaddrinfo(vec[0].c_str(), vec[1].c_str(), &hints, &addrs);
+  if (s != 0) {
+    LOG(ERROR) << "getaddrinfo failure, error:" << gai_strerror(s);
+    return -1;
+  }
+
+  int fd = -1;
+  for (addrinfo* a = addrs; a != nullptr; a = a->ai_next) {
+    fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (fd < 0) continue;
+    if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addrs);
+  return fd;
+}
+
+} // namespace
+
+RdmaEngine::RdmaEngine(RdmaStarContext* ctx,
+                       uint16_t local,
+                       const std::string& job_name,
+                       StarWorkerService* worker_service)
+  : ctx_(ctx), local_(local), job_name_(job_name) {
+  tag_factory_ = new RdmaTagFactory(worker_service);
+
+  listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK_GE(listen_fd_, 0) << "Failed to create the rdma bootstrap socket";
+  int opt = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(local_);
+  CHECK_EQ(0, bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr),
+                   sizeof(addr)))
+      << "Failed to bind the rdma bootstrap port " << local_;
+  CHECK_EQ(0, listen(listen_fd_, SOMAXCONN));
+
+  listen_thread_ = std::thread([this] { Listen(); });
+  LOG(INFO) << "Rdma engine of job " << job_name_ << " listens on port "
+            << local_;
+}
+
+RdmaEngine::~RdmaEngine() {
+  // Channels and their readers live as long as the process.
+  shutdown(listen_fd_, SHUT_RDWR);
+  close(listen_fd_);
+  listen_thread_.join();
+  delete tag_factory_;
+}
+
+void RdmaEngine::Listen() {
+  while (true) {
+    sockaddr_in peer;
+    socklen_t len = sizeof(peer);
+    int fd = accept(listen_fd_, reinterpret_cast<sockaddr*>(&peer), &len);
+    if (fd < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &peer.sin_addr, ip, sizeof(ip));
+    std::string addr = strings::StrCat(ip, ":", ntohs(peer.sin_port));
+    std::thread([this, fd, addr] { Accept(fd, addr); }).detach();
+  }
+}
+
+void RdmaEngine::Accept(int fd, const std::string& addr) {
+  auto chan = new RdmaStarChannel(ctx_, addr);
+  Status s = chan->Connect(fd);
+  close(fd);
+  if (!s.ok()) {
+    LOG(ERROR) << "Rdma server failed to connect " << addr << ": " << s;
+    chan->SetBroken();
+    return;
+  }
+  ServerRead(chan);
+}
+
+RdmaStarChannel* RdmaEngine::GetChannel(const std::string& server_ip) {
+  auto chan = new RdmaStarChannel(ctx_, server_ip);
+  std::thread([this, chan, server_ip] {
+      Connect(chan, server_ip);
+    }).detach();
+  return chan;
+}
+
+void RdmaEngine::Connect(RdmaStarChannel* chan,
+                         const std::string& server_ip) {
+  int64 timeout_in_ms = kMaxConnectionTimeoutInMS;
+  ReadInt64FromEnvVar("NETWORK_MAX_CONNECTION_TIMEOUT",
+      kMaxConnectionTimeoutInMS, &timeout_in_ms);
+
+  // The peer may not be listening yet.
+  int fd = -1;
+  for (int64 retry = timeout_in_ms / kUSleepInMS; retry > 0; --retry) {
+    fd = ConnectOnce(server_ip);
+    if (fd >= 0) break;
+    usleep(kUSleepInMS * 1000);
+  }
+  if (fd < 0) {
+    LOG(ERROR) << "Rdma client failed to reach " << server_ip;
+    chan->SetBroken();
+    return;
+  }
+
+  Status s = chan->Connect(fd);
+  close(fd);
+  if (!s.ok()) {
+    LOG(ERROR) << "Rdma client failed to connect " << server_ip << ": " << s;
+    chan->SetBroken();
+    return;
+  }
+  ClientRead(chan);
+}
+
+void RdmaEngine::ClientRead(RdmaStarChannel* chan) {
+  char header[StarClientTag::kHeaderSize];
+  while (chan->ReadExactly(header, StarClientTag::kHeaderSize)) {
+    auto tag = tag_factory_->CreateRdmaClientTag(header);
+    if (tag->status_ != 0) {
+      std::string msg(tag->err_msg_len_, '\0');
+      if (!chan->ReadExactly(&msg[0], tag->err_msg_len_)) break;
+      if (msg.empty()) {
+        msg = "Empty error msg.";
+      }
+      tensorflow::Status s(static_cast<tensorflow::error::Code>(tag->status_), msg);
+      tag->ScheduleProcess([tag, s] {
+          tag->HandleResponse(s);
+        });
+
+    } else if (tag->IsStarRunGraph()) {
+      // Handle zero copy run graph response.
+      auto resp_meta_size = tag->GetResponseBodySize();
+      if (resp_meta_size == 0) {
+        tag->ScheduleProcess([tag] {
+            tag->HandleResponse(tensorflow::Status());
+          });
+        continue;
+      }
+      auto resp_meta_buffer = tag->GetResponseBodyBuffer();
+      if (!chan->ReadExactly(resp_meta_buffer, resp_meta_size)) break;
+      tag->ParseStarRunGraphMeta(resp_meta_buffer, resp_meta_size);
+      if (!ReadResponseTensors(chan, tag)) break;
+
+    } else if (tag->IsRecvTensor()) {
+      // Handle recv_tensor/fuse_recv_tensor response
+      if (!ReadResponseTensors(chan, tag)) break;
+
+    } else {
+      // Handle other response, which has a pb payload.
+      auto resp_body_size = tag->GetResponseBodySize();
+      if (resp_body_size > 0 &&
+          !chan->ReadExactly(tag->GetResponseBodyBuffer(), resp_body_size)) {
+        break;
+      }
+      tag->ScheduleProcess([tag] {
+          tag->HandleResponse(tensorflow::Status());
+        });
+    }
+  }
+  LOG(ERROR) << "Rdma client channel to " << chan->get_addr()
+             << " is broken.";
+}
+
+bool RdmaEngine::ReadResponseTensors(RdmaStarChannel* chan,
+                                     RdmaClientTag* tag) {
+  char tensor_msg[StarMessage::kMessageTotalBytes];
+  for (int idx = 0; idx < tag->resp_tensor_count_; ++idx) {
+    if (!chan->ReadExactly(tensor_msg, StarMessage::kMessageTotalBytes)) {
+      return false;
+    }
+    tag->ParseTensorMessage(idx, tensor_msg, StarMessage::kMessageTotalBytes);
+    auto tensor_size = tag->GetResponseTensorSize(idx);
+    // Large tensors are read one-sided into the tensor buffer, no copy.
+    if (tensor_size > 0 &&
+        !chan->ReadExactly(tag->GetResponseTensorBuffer(idx), tensor_size)) {
+      return false;
+    }
+  }
+  tag->ScheduleProcess([tag] {
+      tag->HandleResponse(tensorflow::Status());
+    });
+  return true;
+}
+
+void RdmaEngine::ServerRead(RdmaStarChannel* chan) {
+  char header[StarServerTag::kHeaderSize];
+  char tensor_msg[StarMessage::kMessageTotalBytes];
+  while (chan->ReadExactly(header, StarServerTag::kHeaderSize)) {
+    auto tag = tag_factory_->CreateRdmaServerTag(header, chan);
+    auto req_body_size = tag->GetRequestBodySize();
+    if (req_body_size == 0) {
+      tag->RecvReqDone(tensorflow::Status());
+      continue;
+    }
+
+    auto req_body_buffer = tag->GetRequestBodyBuffer();
+    if (!chan->ReadExactly(req_body_buffer, req_body_size)) break;
+    if (!tag->IsStarRunGraph()) {
+      tag->RecvReqDone(tensorflow::Status());
+      continue;
+    }
+
+    InitStarServerTag(tag);
+    tag->ParseMetaData(req_body_buffer, req_body_size);
+    bool ok = true;
+    for (int idx = 0; ok && idx < tag->GetReqTensorCount(); ++idx) {
+      ok = chan->ReadExactly(tensor_msg, StarMessage::kMessageTotalBytes);
+      if (!ok) break;
+      tag->ParseMessage(idx, tensor_msg, StarMessage::kMessageTotalBytes);
+      auto tensor_size = tag->GetRequestTensorSize(idx);
+      if (tensor_size > 0) {
+        ok = chan->ReadExactly(tag->GetRequestTensorBuffer(idx), tensor_size);
+      }
+    }
+    if (!ok) break;
+    tag->RecvReqDone(tag->ParseTensor());
+  }
+  LOG(ERROR) << "Rdma server channel from " << chan->get_addr()
+             << " is broken.";
+}
+
+} // namespace tensorflow
+
+#endif // TENSORFLOW_USE_VERBS
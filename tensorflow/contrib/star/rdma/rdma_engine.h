@@ -0,0 +1,57 @@
+#ifndef TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_ENGINE_H_
+#define TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_ENGINE_H_
+
+#ifdef TENSORFLOW_USE_VERBS
+
+#include <string>
+#include <thread>
+
+#include "tensorflow/core/platform/macros.h"
+
+namespace tensorflow {
+
+class RdmaClientTag;
+class RdmaStarChannel;
+class RdmaStarContext;
+class RdmaTagFactory;
+class StarWorkerService;
+
+// Star engine over RDMA. It listens on the star port of the task for the
+// TCP bootstrap of the queue pairs, and runs one reader thread per channel
+// which parses the StarClientTag / StarServerTag messages as the seastar
+// connections do.
+class RdmaEngine {
+public:
+  RdmaEngine(RdmaStarContext* ctx,
+             uint16_t local,
+             const std::string& job_name,
+             StarWorkerService* worker_service);
+
+  virtual ~RdmaEngine();
+
+  RdmaStarChannel* GetChannel(const std::string& server_ip);
+
+private:
+  void Listen();
+  void Accept(int fd, const std::string& addr);
+  void Connect(RdmaStarChannel* chan, const std::string& server_ip);
+  void ClientRead(RdmaStarChannel* chan);
+  bool ReadResponseTensors(RdmaStarChannel* chan, RdmaClientTag* tag);
+  void ServerRead(RdmaStarChannel* chan);
+
+private:
+  RdmaStarContext* ctx_;
+  RdmaTagFactory* tag_factory_;
+  uint16_t local_;
+  std::string job_name_;
+  int listen_fd_ = -1;
+  std::thread listen_thread_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RdmaEngine);
+};
+
+} // namespace tensorflow
+
+#endif // TENSORFLOW_USE_VERBS
+
+#endif // TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_ENGINE_H_
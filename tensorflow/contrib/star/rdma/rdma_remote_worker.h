@@ -0,0 +1,21 @@
+#ifndef TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_REMOTE_WORKER_H_
+#define TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_REMOTE_WORKER_H_
+
+#ifdef TENSORFLOW_USE_VERBS
+
+namespace tensorflow {
+
+class RdmaStarChannel;
+class WorkerInterface;
+class WorkerCacheLogger;
+struct WorkerEnv;
+
+WorkerInterface* NewRdmaRemoteWorker(RdmaStarChannel* rdma_channel,
+                                     WorkerCacheLogger* logger,
+                                     WorkerEnv* env);
+
+} // namespace tensorflow
+
+#endif // TENSORFLOW_USE_VERBS
+
+#endif // TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_REMOTE_WORKER_H_
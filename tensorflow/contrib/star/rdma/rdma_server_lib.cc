@@ -0,0 +1,131 @@
+#ifdef TENSORFLOW_USE_VERBS
+
+#include <mutex>
+
+#include "tensorflow/contrib/star/rdma/rdma_engine.h"
+#include "tensorflow/contrib/star/rdma/rdma_server_lib.h"
+#include "tensorflow/contrib/star/rdma/rdma_star_channel.h"
+#include "tensorflow/contrib/star/rdma/rdma_worker_cache.h"
+#include "tensorflow/contrib/star/star_channel_spec.h"
+#include "tensorflow/contrib/star/star_worker_service.h"
+#include "tensorflow/contrib/verbs/rdma_mgr.h"
+#include "tensorflow/core/distributed_runtime/server_lib.h"
+#include "tensorflow/core/distributed_runtime/worker_env.h"
+#include "tensorflow/core/framework/ev_allocator.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace {
+
+// Opens the device once per process. The allocators register their regions
+// with its protection domain, so that large tensors are sent one-sided.
+RdmaStarContext* GetRdmaStarContext() {
+  static std::once_flag flag;
+  static RdmaStarContext* ctx = nullptr;
+  std::call_once(flag, []() {
+    ctx = new RdmaStarContext();
+    RdmaMemoryMgr::Singleton().pd_ = ctx->pd();
+    RdmaMgr::RegMemVisitors();
+    // The rows of the EmbeddingVariables are read one-sided by the workers,
+    // see KvResourceGatherRowAddresses.
+    AddEVChunkVisitor([](void* chunk, size_t chunk_size) {
+      RdmaMemoryMgr::Singleton().InsertMemoryRegion(chunk, chunk_size,
+                                                    "ev_allocator");
+    });
+    SetEVRemoteKeyFn([](const void* ptr, size_t len, uint32* remote_key) {
+      const char* data = static_cast<const char*>(ptr);
+      ibv_mr* mr = RdmaMemoryMgr::Singleton().FindMemoryRegion(
+          const_cast<char*>(data), len);
+      if (mr == nullptr ||
+          data + len > static_cast<const char*>(mr->addr) + mr->length) {
+        return false;
+      }
+      *remote_key = mr->rkey;
+      return true;
+    });
+  });
+  return ctx;
+}
+
+} // namespace
+
+RdmaStarServer::RdmaStarServer(const ServerDef& server_def, Env* env)
+  : StarServerBase(server_def, env) {}
+
+RdmaStarServer::~RdmaStarServer() {
+  TF_CHECK_OK(Stop());
+  TF_CHECK_OK(Join());
+
+  delete rdma_engine_;
+}
+
+Status RdmaStarServer::StarWorkerCacheFactory(
+    const WorkerCacheFactoryOptions& options,
+    WorkerCacheInterface** worker_cache) {
+  if (options.job_name == nullptr || options.job_name->empty()) {
+    Status s = errors::InvalidArgument(
+        "The master (current machine) is not included in the provided "
+        "cluster_def. ",
+        options.cluster_def->DebugString());
+    LOG(WARNING) << s;
+    return s;
+  }
+
+  StarChannelSpec channel_spec;
+  TF_RETURN_IF_ERROR(ParseChannelSpec(options, &channel_spec));
+
+  string name_prefix = strings::StrCat("/job:", *options.job_name, "/replica:0",
+                                       "/task:", options.task_index);
+  LOG(INFO) << "RdmaWorkerCacheFactory, name_prefix:" << name_prefix;
+  *worker_cache = NewRdmaWorkerCacheWithLocalWorker(
+      rdma_engine_, channel_spec, worker_impl_, name_prefix, &worker_env_);
+
+  return Status::OK();
+}
+
+void RdmaStarServer::CreateEngine(size_t server_number,
+                                  const string& job_name) {
+  rdma_engine_ = new RdmaEngine(GetRdmaStarContext(), star_bound_port_,
+                                job_name, worker_service_);
+}
+
+Status RdmaStarServer::Create(const ServerDef& server_def, Env* env,
+                              std::unique_ptr<ServerInterface>* out_server) {
+  // The allocator visitors must be in place before the server allocates.
+  GetRdmaStarContext();
+  std::unique_ptr<StarServerBase> ret(
+      new RdmaStarServer(server_def, env == nullptr ? Env::Default() : env));
+
+  TF_RETURN_IF_ERROR(ret->Init());
+  *out_server = std::move(ret);
+  return Status::OK();
+}
+
+namespace {
+class RdmaStarServerFactory : public ServerFactory {
+public:
+  bool AcceptsOptions(const ServerDef& server_def) override {
+    return server_def.protocol() == "star_rdma";
+  }
+
+  Status NewServer(const ServerDef& server_def,
+      std::unique_ptr<ServerInterface>* out_server) override {
+    return RdmaStarServer::Create(server_def, Env::Default(), out_server);
+  }
+};
+
+class RdmaStarServerRegistrar {
+public:
+  RdmaStarServerRegistrar() {
+    ServerFactory::Register("RDMA_STAR_SERVER", new RdmaStarServerFactory());
+  }
+};
+
+static RdmaStarServerRegistrar registrar;
+
+} // namespace
+
+} // namespace tensorflow
+
+#endif // TENSORFLOW_USE_VERBS
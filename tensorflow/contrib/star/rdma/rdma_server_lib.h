@@ -0,0 +1,37 @@
+#ifndef TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_SERVER_LIB_H_
+#define TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_SERVER_LIB_H_
+
+#ifdef TENSORFLOW_USE_VERBS
+
+#include "tensorflow/contrib/star/star_server_base_lib.h"
+#include "tensorflow/core/distributed_runtime/server_lib.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+
+class RdmaEngine;
+
+// Star server whose workers talk over RDMA instead of seastar TCP, selected
+// with protocol "star_rdma". Like "grpc++" it serves every job and does not
+// use the run graph mode of "star_server".
+class RdmaStarServer : public StarServerBase {
+ public:
+  RdmaStarServer(const ServerDef& server_def, Env* env);
+  virtual ~RdmaStarServer();
+  static Status Create(const ServerDef& server_def, Env* env,
+                       std::unique_ptr<ServerInterface>* out_server);
+
+ protected:
+  virtual Status StarWorkerCacheFactory(const WorkerCacheFactoryOptions& options,
+                                        WorkerCacheInterface** worker_cache);
+  virtual void CreateEngine(size_t server_number, const string& job_name);
+
+ private:
+  RdmaEngine* rdma_engine_ = nullptr;
+};
+
+} // namespace tensorflow
+
+#endif // TENSORFLOW_USE_VERBS
+
+#endif // TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_SERVER_LIB_H_
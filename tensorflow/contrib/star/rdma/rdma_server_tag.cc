@@ -0,0 +1,50 @@
+#ifdef TENSORFLOW_USE_VERBS
+
+#include "tensorflow/contrib/star/rdma/rdma_server_tag.h"
+#include "tensorflow/contrib/star/star_worker_service.h"
+
+namespace tensorflow {
+
+RdmaServerTag::RdmaServerTag(RdmaStarChannel* rdma_channel,
+                             StarWorkerService* worker_service)
+  : StarServerTag(worker_service), rdma_channel_(rdma_channel) {}
+
+void RdmaServerTag::StartResp() {
+  // Tensors are read one-sided from the response buffers, the tag is
+  // deleted once the client has read them.
+  if (IsRecvTensor() || IsStarRunGraph()) {
+    rdma_channel_->Put(ToFragmentsWithTensors(),
+                       [this]() { this->SendRespDone(); });
+  } else {
+    rdma_channel_->Put(ToFragments(), [this]() { this->SendRespDone(); });
+  }
+}
+
+std::vector<RdmaStarChannel::Fragment> RdmaServerTag::ToFragments() {
+  return {{resp_header_buf_.data_, resp_header_buf_.len_},
+          {resp_body_buf_.data_, resp_body_buf_.len_}};
+}
+
+std::vector<RdmaStarChannel::Fragment> RdmaServerTag::ToFragmentsWithTensors() {
+  std::vector<RdmaStarChannel::Fragment> frags;
+  frags.push_back({resp_header_buf_.data_, resp_header_buf_.len_});
+
+  if (IsStarRunGraph() || status_ != 0) {
+    frags.push_back({resp_body_buf_.data_, resp_body_buf_.len_});
+  }
+
+  // For fuse recv / zero copy run graph, if error happens 'resp_tensor_count_'
+  // is zero as when it is inited, so no tensor can be sent.
+  for (auto i = 0; i < resp_tensor_count_; ++i) {
+    frags.push_back({resp_message_bufs_[i].data_, resp_message_bufs_[i].len_});
+    if (resp_tensor_bufs_[i].len_ > 0) {
+      frags.push_back({resp_tensor_bufs_[i].data_, resp_tensor_bufs_[i].len_});
+    }
+  }
+
+  return frags;
+}
+
+} // namespace tensorflow
+
+#endif // TENSORFLOW_USE_VERBS
@@ -0,0 +1,33 @@
+#ifndef TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_SERVER_TAG_H_
+#define TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_SERVER_TAG_H_
+
+#ifdef TENSORFLOW_USE_VERBS
+
+#include <vector>
+
+#include "tensorflow/contrib/star/rdma/rdma_star_channel.h"
+#include "tensorflow/contrib/star/star_server_tag.h"
+
+namespace tensorflow {
+
+class RdmaServerTag : public StarServerTag {
+ public:
+  RdmaServerTag(RdmaStarChannel* rdma_channel,
+                StarWorkerService* star_worker_service);
+  virtual ~RdmaServerTag() {}
+  virtual void StartResp();
+
+ private:
+  std::vector<RdmaStarChannel::Fragment> ToFragments();
+  std::vector<RdmaStarChannel::Fragment> ToFragmentsWithTensors();
+
+ private:
+  friend class RdmaTagFactory;
+  RdmaStarChannel* rdma_channel_;
+};
+
+} // namespace tensorflow
+
+#endif // TENSORFLOW_USE_VERBS
+
+#endif // TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_SERVER_TAG_H_
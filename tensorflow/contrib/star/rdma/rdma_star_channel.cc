@@ -0,0 +1,723 @@
+#ifdef TENSORFLOW_USE_VERBS
+
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+#include "tensorflow/contrib/star/rdma/rdma_star_channel.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace {
+
+const size_t kTypeIndex = 0;
+const size_t kLenIndex = 4;
+const size_t kAddrIndex = 8;
+const size_t kRkeyIndex = 16;
+const size_t kCountIndex = 20;
+const size_t kIdIndex = 24;
+
+const int64 kDefaultSlotSize = 64 * 1024;
+const int64 kDefaultNumSlots = 64;
+const int64 kDefaultOneSidedThreshold = 64 * 1024;
+const size_t kBounceSize = 4 * 1024 * 1024;
+// The READs of ReadRemoteBlocks in flight on a queue pair.
+const int kMaxBlockReads = 16;
+// A kRead descriptor covers at most 1GB, larger fragments take several.
+const size_t kMaxReadLen = 1UL << 30;
+const int kMaxPollEntries = 64;
+
+void EncodeChunk(char* p, uint32_t type, uint32_t len, uint64_t addr,
+                 uint32_t rkey, uint32_t count, uint64_t id) {
+  memcpy(p + kTypeIndex, &type, 4);
+  memcpy(p + kLenIndex, &len, 4);
+  memcpy(p + kAddrIndex, &addr, 8);
+  memcpy(p + kRkeyIndex, &rkey, 4);
+  memcpy(p + kCountIndex, &count, 4);
+  memcpy(p + kIdIndex, &id, 8);
+}
+
+// The registered region that holds [data, data + len), or nullptr.
+ibv_mr* FindRegion(const char* data, size_t len) {
+  ibv_mr* mr = RdmaMemoryMgr::Singleton().FindMemoryRegion(
+      const_cast<char*>(data), len);
+  if (mr == nullptr ||
+      data + len > static_cast<const char*>(mr->addr) + mr->length) {
+    return nullptr;
+  }
+  return mr;
+}
+
+Status WriteAll(int fd, const void* data, size_t n) {
+  const char* p = static_cast<const char*>(data);
+  while (n > 0) {
+    ssize_t r = write(fd, p, n);
+    if (r <= 0) return errors::Unavailable("RDMA channel bootstrap write failed");
+    p += r;
+    n -= r;
+  }
+  return Status::OK();
+}
+
+Status ReadAll(int fd, void* data, size_t n) {
+  char* p = static_cast<char*>(data);
+  while (n > 0) {
+    ssize_t r = read(fd, p, n);
+    if (r <= 0) return errors::Unavailable("RDMA channel bootstrap read failed");
+    p += r;
+    n -= r;
+  }
+  return Status::OK();
+}
+
+} // namespace
+
+RdmaStarContext::RdmaStarContext()
+  : context_(open_device(set_device())),
+    params_(params_init(context_)) {
+  pd_ = ibv_alloc_pd(context_);
+  CHECK(pd_) << "Failed to allocate protection domain";
+  event_channel_ = ibv_create_comp_channel(context_);
+  CHECK(event_channel_) << "Failed to create completion channel";
+  cq_ = ibv_create_cq(context_, params_.queue_depth * 4, NULL,
+                      event_channel_, 0);
+  CHECK(cq_) << "Failed to create completion queue";
+  CHECK(!ibv_req_notify_cq(cq_, 0)) << "Failed to request CQ notification";
+  polling_thread_.reset(Env::Default()->StartThread(
+      ThreadOptions(), "RdmaStarCQThread", [this] { Poll(); }));
+}
+
+void RdmaStarContext::Poll() {
+  ibv_wc wc[kMaxPollEntries];
+  while (true) {
+    ibv_cq* cq;
+    void* cq_context;
+    CHECK(!ibv_get_cq_event(event_channel_, &cq, &cq_context));
+    CHECK(cq == cq_);
+    ibv_ack_cq_events(cq, 1);
+    CHECK(!ibv_req_notify_cq(cq_, 0));
+
+    int ne;
+    while ((ne = ibv_poll_cq(cq_, kMaxPollEntries, wc)) > 0) {
+      for (int i = 0; i < ne; ++i) {
+        reinterpret_cast<RdmaStarWork*>(wc[i].wr_id)->Complete(wc[i]);
+      }
+    }
+    CHECK_GE(ne, 0);
+  }
+}
+
+struct RdmaStarChannel::Slot {
+  char* data;
+  std::unique_ptr<RdmaStarWork> work;
+};
+
+struct RdmaStarChannel::PutState {
+  explicit PutState(std::function<void()> d)
+    : done(std::move(d)), pending(1) {}
+
+  void Unref() {
+    if (pending.fetch_sub(1) == 1) {
+      if (done) done();
+      delete this;
+    }
+  }
+
+  std::function<void()> done;
+  std::atomic<int> pending;
+};
+
+class RdmaStarChannel::SendWork : public RdmaStarWork {
+ public:
+  SendWork(RdmaStarChannel* channel, Slot* slot)
+    : channel_(channel), slot_(slot) {}
+
+  void Complete(const ibv_wc& wc) override {
+    if (wc.status != IBV_WC_SUCCESS) {
+      LOG(ERROR) << "RDMA send to " << channel_->get_addr() << " failed: "
+                 << ibv_wc_status_str(wc.status);
+      channel_->SetBroken();
+    }
+    channel_->ReleaseSendSlot(slot_);
+  }
+
+ private:
+  RdmaStarChannel* channel_;
+  Slot* slot_;
+};
+
+class RdmaStarChannel::RecvWork : public RdmaStarWork {
+ public:
+  RecvWork(RdmaStarChannel* channel, Slot* slot)
+    : channel_(channel), slot_(slot) {}
+
+  void Complete(const ibv_wc& wc) override {
+    if (wc.status != IBV_WC_SUCCESS) {
+      // Receives are flushed once the queue pair is in error.
+      if (wc.status != IBV_WC_WR_FLUSH_ERR) {
+        LOG(ERROR) << "RDMA recv from " << channel_->get_addr()
+                   << " failed: " << ibv_wc_status_str(wc.status);
+      }
+      channel_->SetBroken();
+      return;
+    }
+    channel_->OnRecv(slot_, wc.byte_len);
+  }
+
+ private:
+  RdmaStarChannel* channel_;
+  Slot* slot_;
+};
+
+class RdmaStarChannel::ReadWork : public RdmaStarWork {
+ public:
+  void Complete(const ibv_wc& wc) override {
+    ok_ = wc.status == IBV_WC_SUCCESS;
+    if (!ok_) {
+      LOG(ERROR) << "RDMA read failed: " << ibv_wc_status_str(wc.status);
+    }
+    done_.Notify();
+  }
+
+  bool Wait() {
+    done_.WaitForNotification();
+    return ok_;
+  }
+
+ private:
+  Notification done_;
+  bool ok_ = false;
+};
+
+RdmaStarChannel::RdmaStarChannel(RdmaStarContext* ctx,
+                                 const std::string& addr)
+  : ctx_(ctx), addr_(addr), init_(false), broken_(false) {
+  int64 slot_size, num_slots, threshold;
+  ReadInt64FromEnvVar("STAR_RDMA_SLOT_SIZE", kDefaultSlotSize, &slot_size);
+  ReadInt64FromEnvVar("STAR_RDMA_NUM_SLOTS", kDefaultNumSlots, &num_slots);
+  ReadInt64FromEnvVar("STAR_RDMA_ONE_SIDED_THRESHOLD",
+                      kDefaultOneSidedThreshold, &threshold);
+  slot_size_ = std::max<int64>(slot_size, kChunkSize * 8);
+  num_slots_ = std::max<int64>(num_slots, 2);
+  one_sided_threshold_ = threshold;
+
+  // Send slots first, then receive slots, in one region.
+  size_t total = slot_size_ * num_slots_ * 2;
+  buffer_ = new char[total];
+  mr_ = ibv_reg_mr(ctx_->pd(), buffer_, total, IBV_ACCESS_LOCAL_WRITE);
+  CHECK(mr_) << "Failed to register RDMA channel buffer";
+  bounce_ = new char[kBounceSize];
+  bounce_mr_ = ibv_reg_mr(ctx_->pd(), bounce_, kBounceSize,
+                          IBV_ACCESS_LOCAL_WRITE);
+  CHECK(bounce_mr_) << "Failed to register RDMA bounce buffer";
+
+  {
+    ibv_qp_init_attr attr;
+    memset(&attr, 0, sizeof(ibv_qp_init_attr));
+    attr.send_cq = ctx_->cq();
+    attr.recv_cq = ctx_->cq();
+    // The reader has one RDMA READ in flight besides the sends, and
+    // ReadRemoteBlocks kMaxBlockReads.
+    attr.cap.max_send_wr = num_slots_ + 1 + kMaxBlockReads;
+    attr.cap.max_recv_wr = num_slots_;
+    attr.cap.max_send_sge = 1;
+    attr.cap.max_recv_sge = 1;
+    attr.qp_type = IBV_QPT_RC;
+    qp_ = ibv_create_qp(ctx_->pd(), &attr);
+    CHECK(qp_) << "Failed to create queue pair";
+  }
+
+  {
+    ibv_qp_attr attr;
+    memset(&attr, 0, sizeof(ibv_qp_attr));
+    attr.qp_state = IBV_QPS_INIT;
+    attr.pkey_index = ctx_->params().pkey_index;
+    attr.port_num = ctx_->params().port_num;
+    attr.qp_access_flags = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ;
+    int mask =
+        IBV_QP_STATE | IBV_QP_PKEY_INDEX | IBV_QP_PORT | IBV_QP_ACCESS_FLAGS;
+    CHECK(!ibv_modify_qp(qp_, &attr, mask)) << "Failed to set QP to INIT";
+  }
+
+  {
+    ibv_port_attr attr;
+    CHECK(!ibv_query_port(ctx_->context(), ctx_->params().port_num, &attr))
+        << "Query port";
+    self_.lid = attr.lid;
+    self_.qpn = qp_->qp_num;
+    self_.psn = static_cast<uint32_t>(random::New64()) & 0xffffff;
+    union ibv_gid gid;
+    CHECK(!ibv_query_gid(ctx_->context(), ctx_->params().port_num,
+                         ctx_->params().sgid_index, &gid))
+        << "Query gid";
+    self_.snp = gid.global.subnet_prefix;
+    self_.iid = gid.global.interface_id;
+  }
+
+  for (int i = 0; i < num_slots_; ++i) {
+    Slot* slot = new Slot;
+    slot->data = buffer_ + i * slot_size_;
+    slot->work.reset(new SendWork(this, slot));
+    send_slots_.emplace_back(slot);
+    free_send_slots_.push_back(slot);
+  }
+  for (int i = 0; i < num_slots_; ++i) {
+    Slot* slot = new Slot;
+    slot->data = buffer_ + (num_slots_ + i) * slot_size_;
+    slot->work.reset(new RecvWork(this, slot));
+    recv_slots_.emplace_back(slot);
+    PostRecv(slot);
+  }
+
+  ack_thread_.reset(Env::Default()->StartThread(
+      ThreadOptions(), "RdmaStarAckThread", [this] { SendAcks(); }));
+}
+
+RdmaStarChannel::~RdmaStarChannel() {
+  {
+    mutex_lock l(ack_mu_);
+    stop_ = true;
+    ack_cv_.notify_all();
+  }
+  ack_thread_.reset();
+  CHECK(!ibv_destroy_qp(qp_)) << "Failed to destroy QP";
+  CHECK(!ibv_dereg_mr(mr_)) << "Failed to deregister memory region";
+  CHECK(!ibv_dereg_mr(bounce_mr_)) << "Failed to deregister memory region";
+  if (block_mr_ != nullptr) {
+    CHECK(!ibv_dereg_mr(block_mr_)) << "Failed to deregister memory region";
+  }
+  delete [] buffer_;
+  delete [] bounce_;
+  delete [] block_buffer_;
+}
+
+Status RdmaStarChannel::Connect(int fd) {
+  Address remote;
+  TF_RETURN_IF_ERROR(WriteAll(fd, &self_, sizeof(self_)));
+  TF_RETURN_IF_ERROR(ReadAll(fd, &remote, sizeof(remote)));
+
+  const RdmaParams& params = ctx_->params();
+  ibv_qp_attr attr;
+  memset(&attr, 0, sizeof(ibv_qp_attr));
+  attr.qp_state = IBV_QPS_RTR;
+  attr.path_mtu = params.mtu;
+  attr.dest_qp_num = remote.qpn;
+  attr.rq_psn = remote.psn;
+  attr.max_dest_rd_atomic = 1;
+  attr.min_rnr_timer = 12;
+  attr.ah_attr.is_global = 1;
+  attr.ah_attr.grh.dgid.global.subnet_prefix = remote.snp;
+  attr.ah_attr.grh.dgid.global.interface_id = remote.iid;
+  attr.ah_attr.grh.flow_label = 0;
+  attr.ah_attr.grh.hop_limit = 255;
+  attr.ah_attr.dlid = remote.lid;
+  attr.ah_attr.sl = params.sl;
+  attr.ah_attr.src_path_bits = 0;
+  attr.ah_attr.port_num = params.port_num;
+  attr.ah_attr.grh.sgid_index = params.sgid_index;
+  attr.ah_attr.grh.traffic_class = params.traffic_class;
+  if (ibv_modify_qp(qp_, &attr,
+                    IBV_QP_STATE | IBV_QP_AV | IBV_QP_PATH_MTU |
+                        IBV_QP_DEST_QPN | IBV_QP_RQ_PSN |
+                        IBV_QP_MAX_DEST_RD_ATOMIC | IBV_QP_MIN_RNR_TIMER)) {
+    return errors::Internal("Failed to set QP to RTR for ", addr_);
+  }
+
+  memset(&attr, 0, sizeof(ibv_qp_attr));
+  attr.qp_state = IBV_QPS_RTS;
+  attr.sq_psn = self_.psn;
+  attr.timeout = params.timeout;
+  attr.retry_cnt = params.retry_cnt;
+  // A sender waits for the reader of the peer to repost its slots.
+  attr.rnr_retry = 7; /* infinite */
+  attr.max_rd_atomic = 1;
+  if (ibv_modify_qp(qp_, &attr,
+                    IBV_QP_STATE | IBV_QP_TIMEOUT | IBV_QP_RETRY_CNT |
+                        IBV_QP_RNR_RETRY | IBV_QP_SQ_PSN |
+                        IBV_QP_MAX_QP_RD_ATOMIC)) {
+    return errors::Internal("Failed to set QP to RTS for ", addr_);
+  }
+
+  // Both queue pairs are ready to receive once this returns.
+  char ready = 1;
+  TF_RETURN_IF_ERROR(WriteAll(fd, &ready, 1));
+  TF_RETURN_IF_ERROR(ReadAll(fd, &ready, 1));
+  init_ = true;
+  return Status::OK();
+}
+
+void RdmaStarChannel::SetBroken() {
+  if (broken_.exchange(true)) return;
+  {
+    mutex_lock l(recv_mu_);
+    recv_cv_.notify_all();
+  }
+  {
+    mutex_lock l(slot_mu_);
+    slot_cv_.notify_all();
+  }
+  // Fragments read by the peer are not referenced anymore.
+  std::unordered_map<uint64_t, PutState*> reads;
+  {
+    mutex_lock l(put_mu_);
+    reads.swap(reads_);
+  }
+  for (auto& it : reads) {
+    it.second->Unref();
+  }
+}
+
+RdmaStarChannel::Slot* RdmaStarChannel::AcquireSendSlot() {
+  mutex_lock l(slot_mu_);
+  while (free_send_slots_.empty() && !broken_) {
+    slot_cv_.wait(l);
+  }
+  if (broken_) return nullptr;
+  Slot* slot = free_send_slots_.back();
+  free_send_slots_.pop_back();
+  return slot;
+}
+
+void RdmaStarChannel::ReleaseSendSlot(Slot* slot) {
+  mutex_lock l(slot_mu_);
+  free_send_slots_.push_back(slot);
+  slot_cv_.notify_one();
+}
+
+void RdmaStarChannel::PostSend(Slot* slot, size_t len) {
+  ibv_sge sge;
+  sge.addr = reinterpret_cast<uint64_t>(slot->data);
+  sge.length = len;
+  sge.lkey = mr_->lkey;
+
+  ibv_send_wr wr;
+  memset(&wr, 0, sizeof(wr));
+  wr.wr_id = reinterpret_cast<uint64_t>(slot->work.get());
+  wr.sg_list = &sge;
+  wr.num_sge = 1;
+  wr.opcode = IBV_WR_SEND;
+  wr.send_flags = IBV_SEND_SIGNALED;
+
+  ibv_send_wr* bad_wr;
+  if (ibv_post_send(qp_, &wr, &bad_wr)) {
+    LOG(ERROR) << "Failed to post RDMA send to " << addr_;
+    SetBroken();
+    ReleaseSendSlot(slot);
+  }
+}
+
+void RdmaStarChannel::PostRecv(Slot* slot) {
+  ibv_sge sge;
+  sge.addr = reinterpret_cast<uint64_t>(slot->data);
+  sge.length = slot_size_;
+  sge.lkey = mr_->lkey;
+
+  ibv_recv_wr wr;
+  memset(&wr, 0, sizeof(wr));
+  wr.wr_id = reinterpret_cast<uint64_t>(slot->work.get());
+  wr.sg_list = &sge;
+  wr.num_sge = 1;
+
+  ibv_recv_wr* bad_wr;
+  if (ibv_post_recv(qp_, &wr, &bad_wr)) {
+    LOG(ERROR) << "Failed to post RDMA recv from " << addr_;
+    SetBroken();
+  }
+}
+
+void RdmaStarChannel::FlushData(Slot** slot, size_t* used) {
+  if (*slot == nullptr) return;
+  if (*used == kChunkSize) {
+    ReleaseSendSlot(*slot);
+  } else {
+    EncodeChunk((*slot)->data, kData, *used - kChunkSize, 0, 0, 0, 0);
+    PostSend(*slot, *used);
+  }
+  *slot = nullptr;
+  *used = 0;
+}
+
+void RdmaStarChannel::PostReadDescriptors(const Fragment& frag, ibv_mr* mr,
+                                          PutState* put) {
+  for (size_t pos = 0; pos < frag.len; pos += kMaxReadLen) {
+    Slot* slot = AcquireSendSlot();
+    if (slot == nullptr) return;
+    uint64_t id;
+    {
+      mutex_lock l(put_mu_);
+      id = next_read_id_++;
+      reads_[id] = put;
+      put->pending.fetch_add(1);
+    }
+    size_t len = std::min(frag.len - pos, kMaxReadLen);
+    EncodeChunk(slot->data, kRead, len,
+                reinterpret_cast<uint64_t>(frag.data + pos), mr->rkey, 0, id);
+    PostSend(slot, kChunkSize);
+  }
+}
+
+void RdmaStarChannel::Put(const std::vector<Fragment>& frags,
+                          std::function<void()> done) {
+  PutState* put = new PutState(std::move(done));
+  {
+    mutex_lock l(send_mu_);
+    Slot* slot = nullptr;
+    size_t used = 0;
+    for (const Fragment& frag : frags) {
+      if (broken_) break;
+      if (frag.len >= one_sided_threshold_) {
+        ibv_mr* mr = FindRegion(frag.data, frag.len);
+        if (mr != nullptr) {
+          FlushData(&slot, &used);
+          PostReadDescriptors(frag, mr, put);
+          continue;
+        }
+      }
+      size_t pos = 0;
+      while (pos < frag.len) {
+        if (slot == nullptr) {
+          slot = AcquireSendSlot();
+          if (slot == nullptr) break;
+          used = kChunkSize;
+        }
+        size_t n = std::min(frag.len - pos, slot_size_ - used);
+        memcpy(slot->data + used, frag.data + pos, n);
+        used += n;
+        pos += n;
+        if (used == slot_size_) {
+          FlushData(&slot, &used);
+        }
+      }
+    }
+    FlushData(&slot, &used);
+  }
+  put->Unref();
+}
+
+void RdmaStarChannel::OnRecv(Slot* slot, size_t len) {
+  uint32_t type, chunk_len, rkey, count;
+  uint64_t addr, id;
+  memcpy(&type, slot->data + kTypeIndex, 4);
+  memcpy(&chunk_len, slot->data + kLenIndex, 4);
+  memcpy(&addr, slot->data + kAddrIndex, 8);
+  memcpy(&rkey, slot->data + kRkeyIndex, 4);
+  memcpy(&count, slot->data + kCountIndex, 4);
+  memcpy(&id, slot->data + kIdIndex, 8);
+
+  if (type == kReadDone) {
+    for (uint32_t i = 0; i < count; ++i) {
+      memcpy(&id, slot->data + kChunkSize + i * 8, 8);
+      PutState* put = nullptr;
+      {
+        mutex_lock l(put_mu_);
+        auto it = reads_.find(id);
+        if (it != reads_.end()) {
+          put = it->second;
+          reads_.erase(it);
+        }
+      }
+      if (put != nullptr) put->Unref();
+    }
+    PostRecv(slot);
+    return;
+  }
+
+  Inbound in;
+  in.len = chunk_len;
+  if (type == kData) {
+    in.slot = slot;
+    in.data = slot->data + kChunkSize;
+  } else {
+    in.addr = addr;
+    in.rkey = rkey;
+    in.id = id;
+    PostRecv(slot);
+  }
+  mutex_lock l(recv_mu_);
+  inbound_.push_back(in);
+  recv_cv_.notify_one();
+}
+
+bool RdmaStarChannel::ReadRemote(const Inbound& in, char* dst, size_t n) {
+  uint64_t remote = in.addr + in.pos;
+  ibv_mr* mr = FindRegion(dst, n);
+  size_t pos = 0;
+  while (pos < n) {
+    // Unregistered destinations are read through the bounce buffer.
+    size_t len = mr != nullptr ? n : std::min(n - pos, kBounceSize);
+    char* local = mr != nullptr ? dst : bounce_;
+
+    ibv_sge sge;
+    sge.addr = reinterpret_cast<uint64_t>(local);
+    sge.length = len;
+    sge.lkey = mr != nullptr ? mr->lkey : bounce_mr_->lkey;
+
+    ReadWork work;
+    ibv_send_wr wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = reinterpret_cast<uint64_t>(&work);
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.opcode = IBV_WR_RDMA_READ;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.wr.rdma.remote_addr = remote + pos;
+    wr.wr.rdma.rkey = in.rkey;
+
+    ibv_send_wr* bad_wr;
+    if (ibv_post_send(qp_, &wr, &bad_wr)) {
+      LOG(ERROR) << "Failed to post RDMA read from " << addr_;
+      SetBroken();
+      return false;
+    }
+    if (!work.Wait()) {
+      SetBroken();
+      return false;
+    }
+    if (mr == nullptr) {
+      memcpy(dst + pos, bounce_, len);
+    }
+    pos += len;
+  }
+  return true;
+}
+
+bool RdmaStarChannel::ReadRemoteBlocks(
+    const std::vector<RemoteBlock>& blocks) {
+  mutex_lock l(block_mu_);
+  if (block_buffer_ == nullptr) {
+    block_buffer_ = new char[kBounceSize];
+    block_mr_ = ibv_reg_mr(ctx_->pd(), block_buffer_, kBounceSize,
+                           IBV_ACCESS_LOCAL_WRITE);
+    CHECK(block_mr_) << "Failed to register RDMA block buffer";
+  }
+  size_t next = 0;
+  while (next < blocks.size()) {
+    // Posts the READs of the next blocks that fit in the buffer at once.
+    ReadWork works[kMaxBlockReads];
+    ibv_sge sges[kMaxBlockReads];
+    ibv_send_wr wrs[kMaxBlockReads];
+    size_t offsets[kMaxBlockReads];
+    const size_t begin = next;
+    size_t used = 0;
+    int n = 0;
+    while (next < blocks.size() && n < kMaxBlockReads &&
+           used + blocks[next].len <= kBounceSize) {
+      const RemoteBlock& block = blocks[next];
+      offsets[n] = used;
+      sges[n].addr = reinterpret_cast<uint64_t>(block_buffer_ + used);
+      sges[n].length = block.len;
+      sges[n].lkey = block_mr_->lkey;
+      memset(&wrs[n], 0, sizeof(ibv_send_wr));
+      wrs[n].wr_id = reinterpret_cast<uint64_t>(&works[n]);
+      wrs[n].sg_list = &sges[n];
+      wrs[n].num_sge = 1;
+      wrs[n].opcode = IBV_WR_RDMA_READ;
+      wrs[n].send_flags = IBV_SEND_SIGNALED;
+      wrs[n].wr.rdma.remote_addr = block.addr;
+      wrs[n].wr.rdma.rkey = block.rkey;
+      if (n > 0) {
+        wrs[n - 1].next = &wrs[n];
+      }
+      used += block.len;
+      ++next;
+      ++n;
+    }
+    if (n == 0) {
+      LOG(ERROR) << "RDMA block of " << blocks[next].len
+                 << " bytes exceeds " << kBounceSize;
+      return false;
+    }
+
+    ibv_send_wr* bad_wr;
+    if (ibv_post_send(qp_, &wrs[0], &bad_wr)) {
+      LOG(ERROR) << "Failed to post RDMA reads from " << addr_;
+      SetBroken();
+      // Waits for the READs posted before the failed one.
+      for (int i = 0; &wrs[i] != bad_wr; ++i) {
+        works[i].Wait();
+      }
+      return false;
+    }
+    bool ok = true;
+    for (int i = 0; i < n; ++i) {
+      ok = works[i].Wait() && ok;
+    }
+    if (!ok) {
+      SetBroken();
+      return false;
+    }
+    for (int i = 0; i < n; ++i) {
+      memcpy(blocks[begin + i].dst, block_buffer_ + offsets[i],
+             blocks[begin + i].len);
+    }
+  }
+  return true;
+}
+
+bool RdmaStarChannel::ReadExactly(char* dst, size_t n) {
+  while (n > 0) {
+    if (!has_current_) {
+      mutex_lock l(recv_mu_);
+      while (inbound_.empty() && !broken_) {
+        recv_cv_.wait(l);
+      }
+      if (inbound_.empty()) return false;
+      current_ = inbound_.front();
+      inbound_.pop_front();
+      has_current_ = true;
+    }
+
+    size_t c = std::min(n, current_.len - current_.pos);
+    if (current_.data != nullptr) {
+      memcpy(dst, current_.data + current_.pos, c);
+    } else if (!ReadRemote(current_, dst, c)) {
+      return false;
+    }
+    current_.pos += c;
+    dst += c;
+    n -= c;
+
+    if (current_.pos == current_.len) {
+      has_current_ = false;
+      if (current_.slot != nullptr) {
+        PostRecv(current_.slot);
+      } else {
+        mutex_lock l(ack_mu_);
+        acks_.push_back(current_.id);
+        ack_cv_.notify_one();
+      }
+    }
+  }
+  return true;
+}
+
+void RdmaStarChannel::SendAcks() {
+  const size_t max_count = (slot_size_ - kChunkSize) / 8;
+  while (true) {
+    std::vector<uint64_t> acks;
+    {
+      mutex_lock l(ack_mu_);
+      while (acks_.empty() && !stop_) {
+        ack_cv_.wait(l);
+      }
+      if (stop_) return;
+      acks.swap(acks_);
+    }
+    for (size_t i = 0; i < acks.size(); i += max_count) {
+      Slot* slot = AcquireSendSlot();
+      if (slot == nullptr) break;
+      uint32_t count = std::min(acks.size() - i, max_count);
+      memcpy(slot->data + kChunkSize, &acks[i], count * 8);
+      EncodeChunk(slot->data, kReadDone, count * 8, 0, 0, count, 0);
+      PostSend(slot, kChunkSize + count * 8);
+    }
+  }
+}
+
+} // namespace tensorflow
+
+#endif // TENSORFLOW_USE_VERBS
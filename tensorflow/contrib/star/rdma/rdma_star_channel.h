@@ -0,0 +1,208 @@
+#ifndef TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_STAR_CHANNEL_H_
+#define TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_STAR_CHANNEL_H_
+
+#ifdef TENSORFLOW_USE_VERBS
+
+#include <infiniband/verbs.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/contrib/verbs/rdma.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+
+class RdmaStarChannel;
+
+// A work request in flight, wr_id of the ibv work request points to it.
+class RdmaStarWork {
+ public:
+  virtual ~RdmaStarWork() {}
+  virtual void Complete(const ibv_wc& wc) = 0;
+};
+
+// The device, protection domain and completion queue shared by all the
+// channels of a process, and the thread that polls the completion queue.
+// It lives as long as the process.
+class RdmaStarContext {
+ public:
+  RdmaStarContext();
+
+  ibv_context* context() const { return context_; }
+  ibv_pd* pd() const { return pd_; }
+  ibv_cq* cq() const { return cq_; }
+  const RdmaParams& params() const { return params_; }
+
+ private:
+  void Poll();
+
+  ibv_context* context_;
+  RdmaParams params_;
+  ibv_pd* pd_;
+  ibv_comp_channel* event_channel_;
+  ibv_cq* cq_;
+  std::unique_ptr<Thread> polling_thread_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RdmaStarContext);
+};
+
+// An ordered and reliable byte stream over a RC queue pair, used by the star
+// RDMA engine in place of a seastar channel. Every SEND carries a 32B chunk:
+//
+// | type:4B | len:4B |
+// |     addr:8B      |
+// | rkey:4B |count:4B|
+// |      id:8B       |
+//
+// kData is followed by 'len' bytes of the stream. kRead describes 'len'
+// bytes of the stream that the receiver pulls with a one-sided RDMA READ
+// from 'addr' of the sender, directly into the buffer it reads into. It is
+// used for large fragments that lie in registered memory, the fragment is
+// released once the receiver answers with kReadDone, which carries 'count'
+// ids.
+class RdmaStarChannel {
+ public:
+  struct Fragment {
+    const char* data;
+    size_t len;
+  };
+
+  // Local queue pair address, exchanged over TCP when connecting.
+  struct Address {
+    uint32_t lid;
+    uint32_t qpn;
+    uint32_t psn;
+    uint64_t snp;
+    uint64_t iid;
+  };
+
+  // A block of registered memory of the peer to read one-sided, e.g. the
+  // row of an EmbeddingVariable, see KvResourceGatherRowAddresses.
+  struct RemoteBlock {
+    uint64_t addr;
+    uint32_t rkey;
+    size_t len;
+    char* dst;
+  };
+
+  static const size_t kChunkSize = 32;
+
+  RdmaStarChannel(RdmaStarContext* ctx, const std::string& addr);
+  ~RdmaStarChannel();
+
+  // Exchanges the queue pair addresses over the connected socket 'fd' and
+  // brings the queue pair to RTS.
+  Status Connect(int fd);
+
+  // Sends the fragments in order and contiguously in the stream. 'done' is
+  // called once the fragments are no longer referenced.
+  void Put(const std::vector<Fragment>& frags, std::function<void()> done);
+
+  // Reads the next n bytes of the stream into dst. Returns false once the
+  // channel is broken. Only one thread reads a channel.
+  bool ReadExactly(char* dst, size_t n);
+
+  // Reads the blocks into their dst with one-sided RDMA READs, without the
+  // CPU of the peer. Returns false once the channel is broken. Called by
+  // any thread, besides the reader.
+  bool ReadRemoteBlocks(const std::vector<RemoteBlock>& blocks);
+
+  bool is_init() const { return init_; }
+  bool is_channel_broken() const { return broken_; }
+  const std::string& get_addr() const { return addr_; }
+  void SetBroken();
+
+ private:
+  enum ChunkType { kData = 0, kRead = 1, kReadDone = 2 };
+
+  struct Slot;
+  struct PutState;
+  class SendWork;
+  class RecvWork;
+  class ReadWork;
+
+  // A received chunk of the stream, consumed by the reader.
+  struct Inbound {
+    Slot* slot = nullptr;  // Reposted once consumed, kData only.
+    const char* data = nullptr;
+    uint64_t addr = 0;
+    uint32_t rkey = 0;
+    uint64_t id = 0;
+    size_t len = 0;
+    size_t pos = 0;
+  };
+
+  Slot* AcquireSendSlot();
+  void ReleaseSendSlot(Slot* slot);
+  void PostSend(Slot* slot, size_t len);
+  void PostRecv(Slot* slot);
+  void FlushData(Slot** slot, size_t* used);
+  void PostReadDescriptors(const Fragment& frag, ibv_mr* mr, PutState* put);
+  bool ReadRemote(const Inbound& in, char* dst, size_t n);
+  void OnRecv(Slot* slot, size_t len);
+  void SendAcks();
+
+  RdmaStarContext* ctx_;
+  const std::string addr_;
+  ibv_qp* qp_ = nullptr;
+  Address self_;
+  std::atomic<bool> init_;
+  std::atomic<bool> broken_;
+  size_t one_sided_threshold_;
+  size_t slot_size_;
+  int num_slots_;
+
+  char* buffer_ = nullptr;
+  ibv_mr* mr_ = nullptr;
+  std::vector<std::unique_ptr<Slot>> send_slots_;
+  std::vector<std::unique_ptr<Slot>> recv_slots_;
+  // Landing buffer of RDMA READs into unregistered memory.
+  char* bounce_ = nullptr;
+  ibv_mr* bounce_mr_ = nullptr;
+
+  // Landing buffer of ReadRemoteBlocks, allocated by its first call.
+  mutex block_mu_;
+  char* block_buffer_ GUARDED_BY(block_mu_) = nullptr;
+  ibv_mr* block_mr_ GUARDED_BY(block_mu_) = nullptr;
+
+  // Serializes the fragments of concurrent Put's in the stream.
+  mutex send_mu_;
+  mutex slot_mu_;
+  condition_variable slot_cv_;
+  std::vector<Slot*> free_send_slots_ GUARDED_BY(slot_mu_);
+
+  mutex put_mu_;
+  uint64_t next_read_id_ GUARDED_BY(put_mu_) = 0;
+  std::unordered_map<uint64_t, PutState*> reads_ GUARDED_BY(put_mu_);
+
+  mutex recv_mu_;
+  condition_variable recv_cv_;
+  std::deque<Inbound> inbound_ GUARDED_BY(recv_mu_);
+  // Owned by the reader.
+  Inbound current_;
+  bool has_current_ = false;
+
+  // kReadDone is sent by its own thread, so that the reader never waits
+  // for the peer and the peer always drains its receive queue.
+  mutex ack_mu_;
+  condition_variable ack_cv_;
+  std::vector<uint64_t> acks_ GUARDED_BY(ack_mu_);
+  bool stop_ GUARDED_BY(ack_mu_) = false;
+  std::unique_ptr<Thread> ack_thread_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RdmaStarChannel);
+};
+
+} // namespace tensorflow
+
+#endif // TENSORFLOW_USE_VERBS
+
+#endif // TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_STAR_CHANNEL_H_
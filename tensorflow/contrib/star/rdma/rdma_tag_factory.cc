@@ -0,0 +1,68 @@
+#ifdef TENSORFLOW_USE_VERBS
+
+#include "tensorflow/contrib/star/rdma/rdma_client_tag.h"
+#include "tensorflow/contrib/star/rdma/rdma_server_tag.h"
+#include "tensorflow/contrib/star/rdma/rdma_tag_factory.h"
+#include "tensorflow/contrib/star/star_message.h"
+#include "tensorflow/contrib/star/star_tensor_coding.h"
+#include "tensorflow/contrib/star/star_worker_service.h"
+
+namespace tensorflow {
+
+RdmaTagFactory::RdmaTagFactory(StarWorkerService* worker_service) :
+  worker_service_(worker_service) {}
+
+RdmaClientTag* RdmaTagFactory::CreateRdmaClientTag(const char* header) {
+  // Ignore the BBBB and method segment.
+  RdmaClientTag* tag = NULL;
+  memcpy(&tag, header + StarClientTag::kTagIndex, 8);
+  memcpy(&tag->status_, header + StarClientTag::kStatusIndex, 4);
+
+  if (tag->status_ != 0) {
+    memcpy(&tag->err_msg_len_, header + StarClientTag::kPayloadLenIndex, 8);
+    return tag;
+  }
+
+  if (tag->IsStarRunGraph()) {
+    int32 meta_len = 0;
+    memcpy(&meta_len, header + StarClientTag::kUserDataIndex, 4);
+
+    tag->resp_body_buf_.len_ = meta_len;
+    tag->resp_body_buf_.data_ = new char[tag->resp_body_buf_.len_];
+
+  } else if (!tag->IsRecvTensor()) {
+    memcpy(&tag->resp_body_buf_.len_,
+           header + StarClientTag::kPayloadLenIndex, 8);
+    tag->resp_body_buf_.data_ = new char[tag->resp_body_buf_.len_];
+  }
+
+  return tag;
+}
+
+RdmaServerTag* RdmaTagFactory::CreateRdmaServerTag(
+    const char* header, RdmaStarChannel* rdma_channel) {
+  RdmaServerTag* tag = new RdmaServerTag(rdma_channel, worker_service_);
+  // Ignore the AAAA segment.
+  memcpy(&tag->method_, header + StarClientTag::kMethodIndex, 4);
+  memcpy(&tag->client_tag_id_, header + StarClientTag::kTagIndex, 8);
+  // Ignore the status segment.
+
+  if (tag->IsStarRunGraph()) {
+    int32 meta_len = 0;
+    memcpy(&meta_len, header + StarClientTag::kUserDataIndex, 4);
+
+    tag->req_body_buf_.len_ = meta_len;
+    tag->req_body_buf_.data_ = new char[tag->req_body_buf_.len_];
+
+  } else {
+    memcpy(&(tag->req_body_buf_.len_),
+           header + StarClientTag::kPayloadLenIndex, 8);
+    tag->req_body_buf_.data_ = new char[tag->req_body_buf_.len_];
+  }
+
+  return tag;
+}
+
+} // namespace tensorflow
+
+#endif // TENSORFLOW_USE_VERBS
@@ -0,0 +1,34 @@
+#ifndef TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_TAG_FACTORY_H_
+#define TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_TAG_FACTORY_H_
+
+#ifdef TENSORFLOW_USE_VERBS
+
+#include "tensorflow/contrib/star/star_worker_service_method.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace tensorflow {
+
+class RdmaClientTag;
+class RdmaServerTag;
+class RdmaStarChannel;
+class StarWorkerService;
+
+class RdmaTagFactory {
+public:
+  explicit RdmaTagFactory(StarWorkerService* worker_service);
+  virtual ~RdmaTagFactory() {}
+
+  RdmaClientTag* CreateRdmaClientTag(const char* header);
+
+  RdmaServerTag* CreateRdmaServerTag(const char* header,
+                                     RdmaStarChannel* rdma_channel);
+
+private:
+  StarWorkerService* worker_service_;
+};
+
+} // namespace tensorflow
+
+#endif // TENSORFLOW_USE_VERBS
+
+#endif // TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_TAG_FACTORY_H_
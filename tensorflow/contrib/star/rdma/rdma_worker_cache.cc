@@ -0,0 +1,132 @@
+#ifdef TENSORFLOW_USE_VERBS
+
+#include <map>
+#include <unordered_map>
+
+#include "tensorflow/contrib/star/rdma/rdma_engine.h"
+#include "tensorflow/contrib/star/rdma/rdma_remote_worker.h"
+#include "tensorflow/contrib/star/rdma/rdma_worker_cache.h"
+#include "tensorflow/contrib/star/star_channel_spec.h"
+#include "tensorflow/core/distributed_runtime/worker_cache_logger.h"
+#include "tensorflow/core/distributed_runtime/worker_cache_partial.h"
+#include "tensorflow/core/distributed_runtime/worker_interface.h"
+#include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/device_name_utils.h"
+
+namespace tensorflow {
+namespace {
+
+class RdmaWorkerCache : public WorkerCachePartial {
+public:
+  explicit RdmaWorkerCache(RdmaEngine* engine,
+                           const StarChannelSpec& channel_spec,
+                           WorkerInterface* local_worker,
+                           const string& local_target,
+                           WorkerEnv* env)
+    : local_target_(local_target),
+      local_worker_(local_worker),
+      engine_(engine),
+      env_(env) {
+    for (const auto& job : channel_spec.host_ports_jobs()) {
+      for (const auto& id_host_port : job.host_ports) {
+        workers_[job.job_id][id_host_port.first] = id_host_port.second;
+      }
+    }
+  }
+
+  virtual ~RdmaWorkerCache() {}
+
+  void ListWorkers(std::vector<string>* workers) const override {
+    for (const auto& job : workers_) {
+      ListWorkersInJob(job.first, workers);
+    }
+  }
+
+  void ListWorkersInJob(const string& job_name,
+      std::vector<string>* workers) const override {
+    auto it = workers_.find(job_name);
+    if (it == workers_.end()) return;
+    for (const auto& id_host_port : it->second) {
+      workers->emplace_back(strings::StrCat(
+          "/job:", job_name, "/replica:0/task:", id_host_port.first));
+    }
+  }
+
+  WorkerInterface* GetOrCreateWorker(
+      const string& target) override {
+    if (target == local_target_) {
+      return local_worker_;
+    } else {
+      RdmaStarChannel* chan = FindWorkerChannel(target);
+      if (!chan) return nullptr;
+      return NewRdmaRemoteWorker(chan, &logger_, env_);
+    }
+  }
+
+  void ReleaseWorker(const string& target, WorkerInterface* worker) {
+    if (target == local_target_) {
+      CHECK_EQ(worker, local_worker_)
+        << "Releasing a worker that was not returned by this WorkerCache";
+    } else {
+      WorkerCacheInterface::ReleaseWorker(target, worker);
+    }
+  }
+
+  Status GetEagerClientCache(
+      std::unique_ptr<eager::EagerClientCache>* eager_client_cache) override {
+    return tensorflow::errors::Unimplemented("Rdma not support eager client.");
+  }
+
+  void SetLogging(bool v) override { logger_.SetLogging(v); }
+  void ClearLogs() override { logger_.ClearLogs(); }
+  bool RetrieveLogs(int64 step_id, StepStats* ss) override {
+    return logger_.RetrieveLogs(step_id, ss);
+  }
+
+private:
+  RdmaStarChannel* FindWorkerChannel(const string& target) {
+    DeviceNameUtils::ParsedName parsed;
+    if (!DeviceNameUtils::ParseFullName(target, &parsed) ||
+        !parsed.has_job || !parsed.has_task) {
+      LOG(WARNING) << "Invalid target:" << target;
+      return nullptr;
+    }
+    auto job = workers_.find(parsed.job);
+    if (job == workers_.end()) return nullptr;
+    auto task = job->second.find(parsed.task);
+    if (task == job->second.end()) return nullptr;
+
+    mutex_lock l(mu_);
+    RdmaStarChannel* chan = gtl::FindPtrOrNull(channels_, task->second);
+    if (chan == nullptr) {
+      chan = engine_->GetChannel(task->second);
+      channels_.insert({task->second, chan});
+    }
+    return chan;
+  }
+
+  const string local_target_;
+  WorkerInterface* const local_worker_;
+  WorkerCacheLogger logger_;
+  RdmaEngine* engine_;
+  WorkerEnv* env_;
+  std::map<string, std::map<int, string>> workers_;
+  mutex mu_;
+  std::unordered_map<string, RdmaStarChannel*> channels_ GUARDED_BY(mu_);
+};
+
+} // namespace
+
+WorkerCacheInterface* NewRdmaWorkerCacheWithLocalWorker(
+    RdmaEngine* engine, const StarChannelSpec& channel_spec,
+    WorkerInterface* local_worker, const string& local_target,
+    WorkerEnv* env) {
+  return new RdmaWorkerCache(engine, channel_spec, local_worker,
+                             local_target, env);
+}
+
+} // namespace tensorflow
+
+#endif // TENSORFLOW_USE_VERBS
@@ -0,0 +1,26 @@
+#ifndef TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_WORKER_CACHE_H_
+#define TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_WORKER_CACHE_H_
+
+#ifdef TENSORFLOW_USE_VERBS
+
+#include "tensorflow/core/distributed_runtime/worker_cache.h"
+
+namespace tensorflow {
+
+class RdmaEngine;
+class StarChannelSpec;
+class WorkerInterface;
+struct WorkerEnv;
+
+// Channels to the tasks of 'channel_spec' are created by 'engine' on first
+// use and kept for the lifetime of the cache.
+WorkerCacheInterface* NewRdmaWorkerCacheWithLocalWorker(
+    RdmaEngine* engine, const StarChannelSpec& channel_spec,
+    WorkerInterface* local_worker, const string& local_target,
+    WorkerEnv* env);
+
+} // namespace tensorflow
+
+#endif // TENSORFLOW_USE_VERBS
+
+#endif // TENSORFLOW_CONTRIB_STAR_RDMA_RDMA_WORKER_CACHE_H_
@@ -0,0 +1,305 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Microbenchmarks of the transports between the workers and a PS: the round
+// trip of small messages, the throughput of large tensors, many workers
+// sending to one PS, and responses of many tensors with and without tensor
+// fuse.
+//
+// The transport is the protocol of RPC_BENCH_PROTOCOL, "grpc" by default, or
+// "grpc++", "star_server", "star_server_lite", "star_rdma", "grpc+verbs" and
+// "grpc+gdr" when the test is built with their support.
+//
+// By default a PS and RPC_BENCH_WORKERS workers run in process on local
+// ports. To run across hosts, set on every host
+//   RPC_BENCH_CLUSTER=ps=host0:port;worker=host1:port,host2:port,...
+//   RPC_BENCH_TASK=<job>:<index>
+// and TF_SEASTAR_ENDPOINT_MAP_PATH for the star protocols. The tasks other
+// than worker:0 serve until they are killed, worker:0 runs the benchmarks:
+//   bazel run //tensorflow/contrib/star:rpc_bench_test -- --benchmarks=all
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/distributed_runtime/server_lib.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/protobuf/cluster.pb.h"
+#include "tensorflow/core/protobuf/tensorflow_server.pb.h"
+#include "tensorflow/core/public/session.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace {
+
+const char* const kPsJob = "ps";
+const char* const kWorkerJob = "worker";
+
+bool IsStarProtocol(const string& protocol) {
+  return protocol == "grpc++" || protocol == "star_server" ||
+         protocol == "star_server_lite" || protocol == "star_rdma";
+}
+
+string DeviceName(const string& job, int task) {
+  return strings::StrCat("/job:", job, "/replica:0/task:", task,
+                         "/device:CPU:0");
+}
+
+// Parses "ps=host:port;worker=host:port,host:port".
+void ParseClusterDef(const string& spec, ClusterDef* cluster_def) {
+  for (const string& job : str_util::Split(spec, ';', str_util::SkipEmpty())) {
+    std::vector<string> name_tasks = str_util::Split(job, '=');
+    CHECK_EQ(name_tasks.size(), 2) << "Malformed RPC_BENCH_CLUSTER: " << spec;
+    JobDef* job_def = cluster_def->add_job();
+    job_def->set_name(name_tasks[0]);
+    std::vector<string> tasks = str_util::Split(name_tasks[1], ',');
+    for (int i = 0; i < tasks.size(); ++i) {
+      (*job_def->mutable_tasks())[i] = tasks[i];
+    }
+  }
+}
+
+// The star protocols listen on a second port of every task, read from the
+// endpoint map file.
+void WriteEndpointMap(const ClusterDef& cluster_def) {
+  string contents;
+  for (const JobDef& job : cluster_def.job()) {
+    for (const auto& task : job.tasks()) {
+      strings::StrAppend(&contents, task.second, "=localhost:",
+                         testing::PickUnusedPortOrDie(), "\n");
+    }
+  }
+  const string dir = io::JoinPath(testing::TmpDir(), "rpc_bench");
+  TF_CHECK_OK(Env::Default()->RecursivelyCreateDir(dir));
+  TF_CHECK_OK(WriteStringToFile(Env::Default(),
+                                io::JoinPath(dir, ".endpoint_map"), contents));
+  setenv("TF_SEASTAR_ENDPOINT_MAP_PATH", dir.c_str(), 1);
+}
+
+struct Cluster {
+  string protocol;
+  int num_workers = 0;
+  string target;
+  std::vector<std::unique_ptr<ServerInterface>> servers;
+
+  Cluster() {
+    TF_CHECK_OK(ReadStringFromEnvVar("RPC_BENCH_PROTOCOL", "grpc", &protocol));
+    string spec, task;
+    TF_CHECK_OK(ReadStringFromEnvVar("RPC_BENCH_CLUSTER", "", &spec));
+    TF_CHECK_OK(ReadStringFromEnvVar("RPC_BENCH_TASK", "worker:0", &task));
+
+    ClusterDef cluster_def;
+    if (spec.empty()) {
+      int64 workers;
+      TF_CHECK_OK(ReadInt64FromEnvVar("RPC_BENCH_WORKERS", 8, &workers));
+      CHECK_GE(workers, 1);
+      JobDef* ps = cluster_def.add_job();
+      ps->set_name(kPsJob);
+      (*ps->mutable_tasks())[0] =
+          strings::StrCat("localhost:", testing::PickUnusedPortOrDie());
+      JobDef* worker = cluster_def.add_job();
+      worker->set_name(kWorkerJob);
+      for (int i = 0; i < workers; ++i) {
+        (*worker->mutable_tasks())[i] =
+            strings::StrCat("localhost:", testing::PickUnusedPortOrDie());
+      }
+      if (IsStarProtocol(protocol)) {
+        WriteEndpointMap(cluster_def);
+      }
+    } else {
+      ParseClusterDef(spec, &cluster_def);
+    }
+
+    for (const JobDef& job : cluster_def.job()) {
+      if (job.name() == kWorkerJob) {
+        num_workers = job.tasks_size();
+        target = strings::StrCat("grpc://", job.tasks().at(0));
+      }
+      for (const auto& t : job.tasks()) {
+        if (spec.empty() ||
+            task == strings::StrCat(job.name(), ":", t.first)) {
+          StartServer(cluster_def, job.name(), t.first);
+        }
+      }
+    }
+    CHECK_GE(num_workers, 1) << "The cluster has no worker job";
+
+    if (!spec.empty() && task != strings::StrCat(kWorkerJob, ":0")) {
+      LOG(INFO) << "Serving " << task << " of the benchmarks over "
+                << protocol;
+      TF_CHECK_OK(servers.back()->Join());
+    }
+  }
+
+  void StartServer(const ClusterDef& cluster_def, const string& job,
+                   int task_index) {
+    ServerDef server_def;
+    server_def.set_protocol(protocol);
+    server_def.set_job_name(job);
+    server_def.set_task_index(task_index);
+    *server_def.mutable_cluster() = cluster_def;
+    (*server_def.mutable_default_session_config()->mutable_device_count())
+        ["CPU"] = 1;
+    std::unique_ptr<ServerInterface> server;
+    TF_CHECK_OK(NewServer(server_def, &server));
+    TF_CHECK_OK(server->Start());
+    servers.push_back(std::move(server));
+  }
+};
+
+Cluster* GetCluster() {
+  static Cluster* cluster = new Cluster;
+  return cluster;
+}
+
+std::unique_ptr<Session> NewBenchSession(bool tensor_fuse) {
+  SessionOptions options;
+  options.target = GetCluster()->target;
+  // Every run moves the tensors again, the optimizers must not fold or
+  // place them away.
+  options.config.mutable_graph_options()
+      ->mutable_optimizer_options()
+      ->set_opt_level(OptimizerOptions::L0);
+  options.config.mutable_graph_options()
+      ->mutable_rewrite_options()
+      ->set_disable_meta_optimizer(true);
+  options.config.set_isolate_session_state(true);
+  options.config.set_tensor_fuse(tensor_fuse);
+  return std::unique_ptr<Session>(NewSession(options));
+}
+
+// A variable of `bytes` bytes on `device`, initialized by the "init" target.
+Output BenchVariable(const Scope& scope, const string& device, int64 bytes,
+                     std::vector<Operation>* inits) {
+  Scope s = scope.WithDevice(device);
+  const int64 elements = std::max<int64>(bytes / sizeof(float), 1);
+  Output var = ops::Variable(s, {elements}, DT_FLOAT);
+  inits->push_back(
+      ops::Assign(s, var, ops::Fill(s, {elements}, 1.0f)).operation);
+  return var;
+}
+
+// Times iters runs of the "target" node of scope, after initializing its
+// variables and a few warmup runs.
+void RunGraph(int iters, const Scope& scope,
+              const std::vector<Operation>& inits, bool tensor_fuse) {
+  ops::NoOp(scope.WithOpName("init").WithControlDependencies(inits));
+  GraphDef def;
+  TF_CHECK_OK(scope.ToGraphDef(&def));
+
+  std::unique_ptr<Session> session = NewBenchSession(tensor_fuse);
+  TF_CHECK_OK(session->Create(def));
+  TF_CHECK_OK(session->Run({}, {}, {"init"}, nullptr));
+  for (int i = 0; i < 3; ++i) {
+    TF_CHECK_OK(session->Run({}, {}, {"target"}, nullptr));
+  }
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    TF_CHECK_OK(session->Run({}, {}, {"target"}, nullptr));
+  }
+  testing::StopTiming();
+  TF_CHECK_OK(session->Close());
+}
+
+// Moves a tensor of `bytes` bytes from the PS to worker 0 per run.
+void PsToWorker(int iters, int64 bytes) {
+  Scope scope = Scope::NewRootScope();
+  std::vector<Operation> inits;
+  Output var = BenchVariable(scope, DeviceName(kPsJob, 0), bytes, &inits);
+  ops::Identity(
+      scope.WithOpName("target").WithDevice(DeviceName(kWorkerJob, 0)), var);
+  RunGraph(iters, scope, inits, false);
+}
+
+void BM_SmallMessageLatency(int iters, int bytes) {
+  testing::StopTiming();
+  testing::SetLabel(GetCluster()->protocol);
+  PsToWorker(iters, bytes);
+}
+BENCHMARK(BM_SmallMessageLatency)->Arg(4)->Arg(64)->Arg(1024)->Arg(16384);
+
+void BM_LargeTensorThroughput(int iters, int megabytes) {
+  testing::StopTiming();
+  const int64 bytes = static_cast<int64>(megabytes) << 20;
+  testing::SetLabel(GetCluster()->protocol);
+  testing::BytesProcessed(iters * bytes);
+  PsToWorker(iters, bytes);
+}
+BENCHMARK(BM_LargeTensorThroughput)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
+// Every worker sends a tensor of `bytes` bytes to an AddN on the PS per run.
+void BM_FanIn(int iters, int workers, int bytes) {
+  testing::StopTiming();
+  Cluster* cluster = GetCluster();
+  workers = std::min(workers, cluster->num_workers);
+  testing::SetLabel(
+      strings::StrCat(cluster->protocol, "; ", workers, " workers"));
+  testing::BytesProcessed(static_cast<int64>(iters) * workers * bytes);
+
+  Scope scope = Scope::NewRootScope();
+  std::vector<Operation> inits;
+  std::vector<Output> sends;
+  for (int i = 0; i < workers; ++i) {
+    sends.push_back(
+        BenchVariable(scope, DeviceName(kWorkerJob, i), bytes, &inits));
+  }
+  ops::AddN(scope.WithOpName("target").WithDevice(DeviceName(kPsJob, 0)),
+            sends);
+  RunGraph(iters, scope, inits, false);
+}
+BENCHMARK(BM_FanIn)
+    ->ArgPair(2, 1024)
+    ->ArgPair(8, 1024)
+    ->ArgPair(2, 1 << 20)
+    ->ArgPair(8, 1 << 20);
+
+// Worker 0 receives `tensors` tensors of 1KB from the PS per run, fused into
+// one response or not.
+void BM_FusedResponse(int iters, int tensors, int fuse) {
+  testing::StopTiming();
+  testing::SetLabel(strings::StrCat(GetCluster()->protocol, "; ", tensors,
+                                    " tensors", fuse ? "; fused" : ""));
+  testing::BytesProcessed(static_cast<int64>(iters) * tensors * 1024);
+
+  Scope scope = Scope::NewRootScope();
+  Scope worker = scope.WithDevice(DeviceName(kWorkerJob, 0));
+  std::vector<Operation> inits;
+  std::vector<Operation> recvs;
+  for (int i = 0; i < tensors; ++i) {
+    Output var = BenchVariable(scope, DeviceName(kPsJob, 0), 1024, &inits);
+    recvs.push_back(ops::Identity(worker, var).operation);
+  }
+  ops::NoOp(worker.WithOpName("target").WithControlDependencies(recvs));
+  RunGraph(iters, scope, inits, fuse);
+}
+BENCHMARK(BM_FusedResponse)
+    ->ArgPair(16, 0)
+    ->ArgPair(16, 1)
+    ->ArgPair(128, 0)
+    ->ArgPair(128, 1);
+
+}  // namespace
+}  // namespace tensorflow
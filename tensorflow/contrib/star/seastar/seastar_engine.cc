@@ -8,6 +8,7 @@
 #include "tensorflow/contrib/star/seastar/seastar_engine.h"
 #include "tensorflow/contrib/star/seastar/seastar_server.h"
 #include "tensorflow/contrib/star/seastar/seastar_tag_factory.h"
+#include "tensorflow/core/framework/embedding/cpu_plan.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/logging.h"
@@ -105,7 +106,13 @@ namespace {
       LOG(WARNING) << "Please setup NETWORK_PS_CORE_NUMBER or"
                    << " NETWORK_WORKER_CORE_NUMBER";
     }
-    return std::min(total_connections, (size_t)max_core_number);
+    size_t core_number = std::min(total_connections, (size_t)max_core_number);
+    // One reactor shard per core of the plan.
+    const auto& reactor_cpus = embedding::GetCpuPlan().reactor;
+    if (!reactor_cpus.empty()) {
+      core_number = std::min(core_number, reactor_cpus.size());
+    }
+    return core_number;
   }
 
   // force to avoid cleanup static variables and global variables in seastar
@@ -114,8 +121,12 @@ namespace {
     _exit(status);
   }
 
-  // By default, ps & worker disable pin core.
+  // By default, ps & worker disable pin core, unless TF_CPU_PLAN gives the
+  // reactor its cores.
   bool DisablePinCores(const std::string& job_name) {
+    if (!embedding::GetCpuPlan().reactor.empty()) {
+      return false;
+    }
     auto env_name = IsWorker(job_name) ?
                     "WORKER_DISABLE_PIN_CORES" :
                     "PS_DISABLE_PIN_CORES";
@@ -211,6 +222,13 @@ seastar::channel* SeastarEngine::GetChannel(const std::string& server_ip) {
 }
 
 void SeastarEngine::GetCpuset(char** av) {
+  const auto& reactor_cpus = embedding::GetCpuPlan().reactor;
+  if (_cpuset.empty() && !reactor_cpus.empty()) {
+    _cpuset = "--cpuset=";
+    for (size_t i = 0; i < _core_number; ++i) {
+      _cpuset += (i == 0 ? "" : ",") + std::to_string(reactor_cpus[i]);
+    }
+  }
   if (_cpuset.empty()) {
     CpusetAllocator cpuset_alloc;
     _cpuset = cpuset_alloc.GetCpuset(_core_number);
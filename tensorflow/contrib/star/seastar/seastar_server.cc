@@ -120,8 +120,7 @@ seastar::future<> SeastarServer::Connection::ReapeatReadTensors(
           delete count;
           delete idx;
           if (!(*error)) {
-            tag->ParseTensor();
-            tag->RecvReqDone(tensorflow::Status());
+            tag->RecvReqDone(tag->ParseTensor());
           }
           delete error;
           return true;
@@ -105,10 +105,8 @@ void InitStarClientTag(protobuf::Message* request,
           Allocator* alloc = GPUProcessState::singleton()->GetGpuHostAllocator(0);
           Tensor cpu_copy(alloc, sm.data_type_, sm.tensor_shape_);
 
-          tag->resp_tensor_bufs_[idx].data_ =
-              reinterpret_cast<char*>(DMAHelper::base(&cpu_copy));
-          tag->resp_tensor_bufs_[idx].len_ =  sm.tensor_bytes_;
-          tag->resp_tensor_bufs_[idx].owned_ = false;
+          StarMessage::InitTensorBuf(sm, cpu_copy, &tag->resp_tensor_bufs_[idx],
+                                     &tag->resp_coded_tensors_[idx]);
 
           response->SetTensor(cpu_copy);
 #else
@@ -119,10 +117,8 @@ void InitStarClientTag(protobuf::Message* request,
           // LOG(INFO) << "parse msg for no fuse, can memcpy and on cpu"
           //          << ",request:" << request->DebugString();
           Tensor val(response->GetAlloc(), sm.data_type_, sm.tensor_shape_);
-          tag->resp_tensor_bufs_[idx].data_ =
-              reinterpret_cast<char*>(DMAHelper::base(&val));
-          tag->resp_tensor_bufs_[idx].len_ =  sm.tensor_bytes_;
-          tag->resp_tensor_bufs_[idx].owned_ = false;
+          StarMessage::InitTensorBuf(sm, val, &tag->resp_tensor_bufs_[idx],
+                                     &tag->resp_coded_tensors_[idx]);
 
           response->SetTensor(val);
         }
@@ -141,10 +137,11 @@ void InitStarClientTag(protobuf::Message* request,
   StatusCallback wrapper_done
     = std::bind([response, tag](StatusCallback done,
                                 const Status& s) {
-                  if (!s.ok()) {
-                    LOG(ERROR) << "wrapper_done, status not ok. status code=" << s.code()
-                               << ", err msg=" << s.error_message().c_str();
-                    done(s);
+                  Status status = s.ok() ? tag->DecodeResponseTensors() : s;
+                  if (!status.ok()) {
+                    LOG(ERROR) << "wrapper_done, status not ok. status code=" << status.code()
+                               << ", err msg=" << status.error_message().c_str();
+                    done(status);
                     delete tag;
                     return;
                   }
@@ -246,9 +243,8 @@ void InitStarClientTag(protobuf::Message* request,
           Allocator* alloc = GPUProcessState::singleton()->GetGpuHostAllocator(0);
           Tensor cpu_copy(alloc, sm.data_type_, sm.tensor_shape_);
 
-          tag->resp_tensor_bufs_[idx].data_ = reinterpret_cast<char*>(DMAHelper::base(&cpu_copy));
-          tag->resp_tensor_bufs_[idx].len_ =  sm.tensor_bytes_;
-          tag->resp_tensor_bufs_[idx].owned_ = false;
+          StarMessage::InitTensorBuf(sm, cpu_copy, &tag->resp_tensor_bufs_[idx],
+                                     &tag->resp_coded_tensors_[idx]);
 
           response->SetTensorByIndex(idx, cpu_copy);
 #else
@@ -257,9 +253,8 @@ void InitStarClientTag(protobuf::Message* request,
 
         } else {
           Tensor val(response->GetAlloc(), sm.data_type_, sm.tensor_shape_);
-          tag->resp_tensor_bufs_[idx].data_ = reinterpret_cast<char*>(DMAHelper::base(&val));
-          tag->resp_tensor_bufs_[idx].len_ =  sm.tensor_bytes_;
-          tag->resp_tensor_bufs_[idx].owned_ = false;
+          StarMessage::InitTensorBuf(sm, val, &tag->resp_tensor_bufs_[idx],
+                                     &tag->resp_coded_tensors_[idx]);
 
           response->SetTensorByIndex(idx, val);
         }
@@ -275,10 +270,11 @@ void InitStarClientTag(protobuf::Message* request,
   StatusCallback wrapper_done
     = std::bind([response, tag](StatusCallback done,
                                 const Status& s) {
-                  if (!s.ok()) {
-                    LOG(ERROR) << "wrapper_done, status not ok. status code=" << s.code()
-                               << ", err msg=" << s.error_message().c_str();
-                    done(s);
+                  Status status = s.ok() ? tag->DecodeResponseTensors() : s;
+                  if (!status.ok()) {
+                    LOG(ERROR) << "wrapper_done, status not ok. status code=" << status.code()
+                               << ", err msg=" << status.error_message().c_str();
+                    done(status);
                     delete tag;
                     return;
                   }
@@ -414,9 +410,8 @@ void InitStarClientTag(StarRunGraphRequest* request,
     if (can_memcpy) {
       // TODO(jiankeng.pt): Implement GPU device here.
       Tensor val(cpu_allocator(), sm.data_type_, sm.tensor_shape_);
-      tag->resp_tensor_bufs_[idx].data_ = reinterpret_cast<char*>(DMAHelper::base(&val));
-      tag->resp_tensor_bufs_[idx].len_ =  sm.tensor_bytes_;
-      tag->resp_tensor_bufs_[idx].owned_ = false;
+      StarMessage::InitTensorBuf(sm, val, &tag->resp_tensor_bufs_[idx],
+                                 &tag->resp_coded_tensors_[idx]);
 
       response->fetch_tensors_[idx] = val;
     } else {
@@ -432,6 +427,14 @@ void InitStarClientTag(StarRunGraphRequest* request,
     = std::bind([response, tag] (StatusCallback done,
                                  const Status& s) {
     if (s.ok()) {
+      Status decode_status = tag->DecodeResponseTensors();
+      if (!decode_status.ok()) {
+        LOG(ERROR) << "Failed to decode tensors, err msg: "
+                   << decode_status.error_message().c_str();
+        done(decode_status);
+        delete tag;
+        return;
+      }
       uint64_t count = tag->resp_tensor_count_;
 
       for (uint64_t i = 0; i < count; ++i) {
@@ -482,6 +485,7 @@ StarClientTag::StarClientTag(tensorflow::StarWorkerServiceMethod method,
     req_message_bufs_(req_tensor_count),
     req_tensor_bufs_(req_tensor_count),
     resp_tensor_bufs_(resp_tensor_count),
+    resp_coded_tensors_(resp_tensor_count),
     parse_meta_data_(nullptr), parse_message_(nullptr), done_(nullptr),
     env_(env), call_opts_(nullptr),
     fail_fast_(false), timeout_in_ms_(0),
@@ -529,6 +533,14 @@ bool StarClientTag::IsRecvTensor() {
          method_ == StarWorkerServiceMethod::kFuseRecvTensor;
 }
 
+Status StarClientTag::DecodeResponseTensors() {
+  for (int i = 0; i < resp_tensor_count_; ++i) {
+    TF_RETURN_IF_ERROR(StarMessage::DecodeTensor(resp_tensor_bufs_[i],
+                                                 &resp_coded_tensors_[i]));
+  }
+  return Status::OK();
+}
+
 Status StarClientTag::ParseTensorMessage(
     int idx, const char* tensor_msg, size_t len) {
   return parse_message_(idx, tensor_msg, len);
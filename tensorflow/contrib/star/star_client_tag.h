@@ -3,6 +3,7 @@
 
 #include <functional>
 
+#include "tensorflow/contrib/star/star_message.h"
 #include "tensorflow/contrib/star/star_tensor_coding.h"
 #include "tensorflow/contrib/star/star_worker_service_method.h"
 #include "tensorflow/core/distributed_runtime/call_options.h"
@@ -67,6 +68,8 @@ class StarClientTag {
   bool IsStarRunGraph();
   Status ParseTensorMessage(int idx, const char* tensor_msg, size_t len);
   Status ParseStarRunGraphMeta(const char* meta, size_t len);
+  // Decodes the coded tensors once the response is received.
+  Status DecodeResponseTensors();
 
   Status ParseResponse();
   void RepeatedlyParseTensors(char* p);
@@ -96,6 +99,7 @@ class StarClientTag {
   std::vector<StarBuf> req_tensor_bufs_;
 
   std::vector<StarBuf> resp_tensor_bufs_;
+  std::vector<StarCodedTensor> resp_coded_tensors_;
 
   ParseMetaDataCallback parse_meta_data_;
   ParseMessageCallback parse_message_;
@@ -137,6 +141,8 @@ class StarClientTag {
   friend class SeastarEngine;
   friend class SeastarClient;
   friend class SeastarServer;
+  friend class RdmaTagFactory;
+  friend class RdmaEngine;
 };
 
 } // namespace tensorflow
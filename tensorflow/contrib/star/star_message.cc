@@ -1,8 +1,164 @@
 #include "tensorflow/contrib/star/star_message.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/bfloat16.h"
+#include "tensorflow/core/framework/numeric_types.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/util/env_var.h"
 
 
 namespace tensorflow {
 
+namespace {
+
+struct StarCodingOptions {
+  bool id_coding = false;
+  uint8_t value_codec = kStarCodecNone;
+  int64 min_bytes = 4096;
+};
+
+const StarCodingOptions& GetCodingOptions() {
+  static StarCodingOptions* options = [] {
+    StarCodingOptions* o = new StarCodingOptions;
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_STAR_SPARSE_ID_CODING", false,
+                                   &o->id_coding));
+    string codec;
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_STAR_SPARSE_VALUE_CODEC", "none",
+                                     &codec));
+    if (codec == "fp16") {
+      o->value_codec = kStarCodecFp16;
+    } else if (codec == "bf16") {
+      o->value_codec = kStarCodecBf16;
+    } else if (codec != "none") {
+      LOG(WARNING) << "Invalid TF_STAR_SPARSE_VALUE_CODEC: " << codec
+                   << ", use none.";
+    }
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_STAR_CODING_MIN_BYTES", 4096,
+                                    &o->min_bytes));
+    return o;
+  }();
+  return *options;
+}
+
+uint8_t ChooseCodec(const Tensor& in) {
+  const StarCodingOptions& options = GetCodingOptions();
+  if (static_cast<int64>(in.TotalBytes()) < options.min_bytes) {
+    return kStarCodecNone;
+  }
+  if (options.id_coding && in.dims() == 1 &&
+      (in.dtype() == DT_INT64 || in.dtype() == DT_INT32)) {
+    return kStarCodecVarintDelta;
+  }
+  if (in.dims() == 2 && in.dtype() == DT_FLOAT) {
+    return options.value_codec;
+  }
+  return kStarCodecNone;
+}
+
+inline uint64 ZigZag(uint64 delta) {
+  return (delta << 1) ^ static_cast<uint64>(static_cast<int64>(delta) >> 63);
+}
+
+inline uint64 UnZigZag(uint64 v) {
+  return (v >> 1) ^ (~(v & 1) + 1);
+}
+
+// Returns the coded bytes, or 0 if they are not less than limit.
+template <typename T>
+size_t EncodeIds(const Tensor& in, char* out, size_t limit) {
+  auto ids = in.flat<T>();
+  char* p = out;
+  uint64 prev = 0;
+  for (int64 i = 0; i < ids.size(); ++i) {
+    if (p - out + core::kMaxVarint64Bytes > limit) {
+      return 0;
+    }
+    uint64 id = static_cast<uint64>(static_cast<int64>(ids(i)));
+    p = core::EncodeVarint64(p, ZigZag(id - prev));
+    prev = id;
+  }
+  return p - out;
+}
+
+template <typename T>
+Status DecodeIds(const StarBuf& buf, Tensor* out) {
+  auto ids = out->flat<T>();
+  const char* p = buf.data_;
+  const char* limit = buf.data_ + buf.len_;
+  uint64 prev = 0;
+  for (int64 i = 0; i < ids.size(); ++i) {
+    uint64 v = 0;
+    p = core::GetVarint64Ptr(p, limit, &v);
+    if (p == nullptr) {
+      return errors::DataLoss("Truncated varint ids of ", ids.size(),
+                              " ids in ", buf.len_, " bytes.");
+    }
+    prev += UnZigZag(v);
+    ids(i) = static_cast<T>(static_cast<int64>(prev));
+  }
+  if (p != limit) {
+    return errors::DataLoss("Unexpected ", limit - p,
+                            " bytes after the varint ids.");
+  }
+  return Status::OK();
+}
+
+template <typename H>
+void EncodeHalfValues(const Tensor& in, char* out) {
+  auto values = in.flat<float>();
+  H* h = reinterpret_cast<H*>(out);
+  for (int64 i = 0; i < values.size(); ++i) {
+    h[i] = static_cast<H>(values(i));
+  }
+}
+
+template <typename H>
+Status DecodeHalfValues(const StarBuf& buf, Tensor* out) {
+  auto values = out->flat<float>();
+  if (buf.len_ != values.size() * sizeof(H)) {
+    return errors::DataLoss("Expect ", values.size() * sizeof(H),
+                            " bytes of half values, got ", buf.len_);
+  }
+  const H* h = reinterpret_cast<const H*>(buf.data_);
+  for (int64 i = 0; i < values.size(); ++i) {
+    values(i) = static_cast<float>(h[i]);
+  }
+  return Status::OK();
+}
+
+// Returns false if in is not coded.
+bool EncodeTensor(uint8_t codec, const Tensor& in, StarBuf* tensor_buf) {
+  size_t limit = in.TotalBytes();
+  char* data = new char[limit];
+  size_t len = 0;
+  switch (codec) {
+    case kStarCodecVarintDelta:
+      len = (in.dtype() == DT_INT64) ? EncodeIds<int64>(in, data, limit)
+                                     : EncodeIds<int32>(in, data, limit);
+      break;
+    case kStarCodecFp16:
+      EncodeHalfValues<Eigen::half>(in, data);
+      len = in.NumElements() * sizeof(Eigen::half);
+      break;
+    case kStarCodecBf16:
+      EncodeHalfValues<bfloat16>(in, data);
+      len = in.NumElements() * sizeof(bfloat16);
+      break;
+    default:
+      break;
+  }
+  if (len == 0 || len >= limit) {
+    delete [] data;
+    return false;
+  }
+  tensor_buf->len_ = len;
+  tensor_buf->data_ = data;
+  tensor_buf->owned_ = true;
+  return true;
+}
+
+}  // namespace
+
 void StarMessage::DeserializeMessage(StarMessage* sm, const char* message) {
   // data_type, tensor_bytes, tensor_shape, is_dead
   memcpy(&sm->is_dead_, &message[kIsDeadStartIndex], sizeof(sm->is_dead_));
@@ -12,6 +168,7 @@ void StarMessage::DeserializeMessage(StarMessage* sm, const char* message) {
          sizeof(sm->tensor_shape_));
   memcpy(&sm->tensor_bytes_, &message[kTensorBytesStartIndex],
          sizeof(sm->tensor_bytes_));
+  memcpy(&sm->codec_, &message[kCodecStartIndex], sizeof(sm->codec_));
 }
 
 void StarMessage::SerializeMessage(const StarMessage& sm, char* message) {
@@ -24,6 +181,7 @@ void StarMessage::SerializeMessage(const StarMessage& sm, char* message) {
          sizeof(sm.tensor_shape_));
   memcpy(&message[kTensorBytesStartIndex], &sm.tensor_bytes_,
            sizeof(sm.tensor_bytes_));
+  memcpy(&message[kCodecStartIndex], &sm.codec_, sizeof(sm.codec_));
 }
 
 uint64_t StarMessage::SerializeTensorMessage(
@@ -34,15 +192,22 @@ uint64_t StarMessage::SerializeTensorMessage(
   sm.tensor_shape_ = in.shape();
   sm.data_type_ = in.dtype();
   sm.is_dead_ = is_dead;
+  sm.codec_ = kStarCodecNone;
 
   bool can_memcpy = DataTypeCanUseMemcpy(sm.data_type_);
 
   if (can_memcpy) {
-    sm.tensor_bytes_ = in.TotalBytes();
+    uint8_t codec = ChooseCodec(in);
+    if (codec != kStarCodecNone && EncodeTensor(codec, in, tensor_buf)) {
+      sm.codec_ = codec;
+      sm.tensor_bytes_ = tensor_buf->len_;
+    } else {
+      sm.tensor_bytes_ = in.TotalBytes();
 
-    tensor_buf->len_ = sm.tensor_bytes_;
-    tensor_buf->data_ = const_cast<char*>(in.tensor_data().data());
-    tensor_buf->owned_ = false;
+      tensor_buf->len_ = sm.tensor_bytes_;
+      tensor_buf->data_ = const_cast<char*>(in.tensor_data().data());
+      tensor_buf->owned_ = false;
+    }
   } else {
     sm.tensor_bytes_ = inp.ByteSize();
 
@@ -58,4 +223,45 @@ uint64_t StarMessage::SerializeTensorMessage(
   return StarMessage::kMessageTotalBytes + sm.tensor_bytes_;
 }
 
+void StarMessage::InitTensorBuf(const StarMessage& sm, const Tensor& val,
+                                StarBuf* tensor_buf, StarCodedTensor* coded) {
+  tensor_buf->len_ = sm.tensor_bytes_;
+  coded->codec_ = sm.codec_;
+  if (sm.codec_ == kStarCodecNone) {
+    tensor_buf->data_ =
+        static_cast<char*>(const_cast<void*>(DMAHelper::base(&val)));
+    tensor_buf->owned_ = false;
+  } else {
+    coded->tensor_ = val;
+    tensor_buf->data_ = new char[tensor_buf->len_];
+    tensor_buf->owned_ = true;
+  }
+}
+
+Status StarMessage::DecodeTensor(const StarBuf& tensor_buf,
+                                 StarCodedTensor* coded) {
+  Status s;
+  Tensor* out = &coded->tensor_;
+  switch (coded->codec_) {
+    case kStarCodecNone:
+      return Status::OK();
+    case kStarCodecVarintDelta:
+      s = (out->dtype() == DT_INT64) ? DecodeIds<int64>(tensor_buf, out)
+                                     : DecodeIds<int32>(tensor_buf, out);
+      break;
+    case kStarCodecFp16:
+      s = DecodeHalfValues<Eigen::half>(tensor_buf, out);
+      break;
+    case kStarCodecBf16:
+      s = DecodeHalfValues<bfloat16>(tensor_buf, out);
+      break;
+    default:
+      s = errors::Internal("Unknown star tensor codec ",
+                           static_cast<int>(coded->codec_));
+  }
+  coded->codec_ = kStarCodecNone;
+  coded->tensor_ = Tensor();
+  return s;
+}
+
 } // namespace tensorflow
@@ -11,17 +11,42 @@
 namespace tensorflow {
 static const int _8KB = 8 * 1024;
 
+// Wire coding of the tensor buffers, so that the sparse gradients, e.g.
+// the ids and the values of the IndexedSlices of EVs, are smaller:
+//  * With TF_STAR_SPARSE_ID_CODING the 1-D int32 and int64 tensors are
+//    zigzag varints of the deltas between the adjacent ids, which are
+//    short for sorted ids.
+//  * TF_STAR_SPARSE_VALUE_CODEC is none, fp16 or bf16 for the 2-D float
+//    tensors. It is lossy, so set it on the workers only, which send the
+//    gradients to the PS.
+//  * Only the tensors of at least TF_STAR_CODING_MIN_BYTES bytes are
+//    coded, and only if they get smaller.
+enum StarTensorCodec : uint8_t {
+  kStarCodecNone = 0,
+  kStarCodecVarintDelta = 1,
+  kStarCodecFp16 = 2,
+  kStarCodecBf16 = 3
+};
+
+// A coded tensor received into an owned buffer, decoded into tensor
+// once all the bytes arrive.
+struct StarCodedTensor {
+  uint8_t codec_ = kStarCodecNone;
+  Tensor tensor_;
+};
+
 // message for recv tensor response
 struct StarMessage {
   bool is_dead_;
   DataType data_type_;
   TensorShape tensor_shape_;
   uint64_t tensor_bytes_;
+  uint8_t codec_;
 
   // |is_dead|...
   // |    1B |...
-  // ...|data_type|tensor_shape|tensor_bytes|tensor_buffer
-  // ...|   XB    |    XB      |    8B      |...
+  // ...|data_type|tensor_shape|tensor_bytes|codec|tensor_buffer
+  // ...|   XB    |    XB      |    8B      | 1B  |...
 
   static const size_t kIsDeadStartIndex = 0;
   static const size_t kDataTypeStartIndex =
@@ -30,8 +55,10 @@ struct StarMessage {
       kDataTypeStartIndex + sizeof(data_type_);
   static const size_t kTensorBytesStartIndex =
       kTensorShapeStartIndex + sizeof(TensorShape);
-  static const size_t kTensorBufferStartIndex =
+  static const size_t kCodecStartIndex =
       kTensorBytesStartIndex + sizeof(tensor_bytes_);
+  static const size_t kTensorBufferStartIndex =
+      kCodecStartIndex + sizeof(codec_);
   static const size_t kMessageTotalBytes = kTensorBufferStartIndex;
   static const size_t kStarMessageBufferSize = kMessageTotalBytes;
   static void SerializeMessage(const StarMessage& rm, char* data);
@@ -40,6 +67,14 @@ struct StarMessage {
       const Tensor& in, const TensorProto& inp,
       bool is_dead, StarBuf* message_buf,
       StarBuf* tensor_buf);
+
+  // Points tensor_buf to the buffer of val which receives the tensor of
+  // sm. A coded tensor is received into a new buffer instead and kept in
+  // coded to be decoded.
+  static void InitTensorBuf(const StarMessage& sm, const Tensor& val,
+                            StarBuf* tensor_buf, StarCodedTensor* coded);
+  static Status DecodeTensor(const StarBuf& tensor_buf,
+                             StarCodedTensor* coded);
 };
 
 } // namespace tensorflow
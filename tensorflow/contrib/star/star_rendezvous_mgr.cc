@@ -1,4 +1,9 @@
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 #include "tensorflow/contrib/star/star_rendezvous_mgr.h"
+#include "tensorflow/contrib/star/star_stats.h"
 #include "tensorflow/contrib/star/star_tensor_coding.h"
 #include "tensorflow/contrib/star/star_worker_interface.h"
 #include "tensorflow/core/common_runtime/device.h"
@@ -10,14 +15,38 @@
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/env_var.h"
 
 
 namespace tensorflow {
 namespace {
 
+struct StarCoalesceOptions {
+  int64 window_us = 0;
+  int64 max_count = 64;
+};
+
+// Recvs from the same peer that are issued while another recv to it is in
+// flight are queued, and sent as one FuseRecvTensor once the in flight recv
+// completes, 'window_us' passes or 'max_count' recvs are queued. A recv to
+// an idle peer is sent at once, so coalescing only adds latency when the
+// peer is busy anyway.
+const StarCoalesceOptions& GetCoalesceOptions() {
+  static StarCoalesceOptions* options = [] {
+    StarCoalesceOptions* o = new StarCoalesceOptions;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_STAR_RECV_COALESCE_WINDOW_US", 0,
+                                    &o->window_us));
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_STAR_RECV_COALESCE_MAX_COUNT", 64,
+                                    &o->max_count));
+    return o;
+  }();
+  return *options;
+}
+
 class StarRemoteRendezvous : public BaseRemoteRendezvous {
  public:
   StarRemoteRendezvous(const WorkerEnv* env, int64 step_id)
@@ -34,8 +63,37 @@ class StarRemoteRendezvous : public BaseRemoteRendezvous {
       FuseDoneCallback done) override;
 
  private:
+  struct PendingRecv {
+    Rendezvous::ParsedKey parsed;
+    Rendezvous::Args recv_args;
+    DoneCallback done;
+  };
+
+  // The recvs to a peer that may be fused: same devices, allocator
+  // attributes, device context and cancellation manager.
+  struct PeerQueue {
+    int inflight = 0;
+    bool timer_armed = false;
+    std::vector<PendingRecv> pending;
+  };
+
   ~StarRemoteRendezvous() override {}
 
+  void StartRecv(const Rendezvous::ParsedKey& parsed,
+                 const Rendezvous::Args& recv_args, DoneCallback done);
+  void StartFuseRecv(const std::vector<Rendezvous::ParsedKey>& parsed_keys,
+                     const Rendezvous::Args& recv_args, FuseDoneCallback done);
+
+  void CoalesceRecv(const Rendezvous::ParsedKey& parsed,
+                    const Rendezvous::Args& recv_args, DoneCallback done);
+  // Sends the pending recvs of 'key', if any. Called on completion of a
+  // recv to the peer and when the window expires.
+  void FlushPeer(const string& key, bool completed, bool timer);
+  void SendBatch(const string& key, std::vector<PendingRecv> batch);
+
+  mutex coalesce_mu_;
+  std::unordered_map<string, PeerQueue> peers_ GUARDED_BY(coalesce_mu_);
+
   TF_DISALLOW_COPY_AND_ASSIGN(StarRemoteRendezvous);
 };
 
@@ -194,6 +252,16 @@ void StarRemoteRendezvous::RecvFromRemoteAsync(
     const Rendezvous::ParsedKey& parsed, const Rendezvous::Args& recv_args,
     DoneCallback done) {
   CHECK(is_initialized());
+  if (GetCoalesceOptions().window_us > 0) {
+    CoalesceRecv(parsed, recv_args, std::move(done));
+  } else {
+    StartRecv(parsed, recv_args, std::move(done));
+  }
+}
+
+void StarRemoteRendezvous::StartRecv(
+    const Rendezvous::ParsedKey& parsed, const Rendezvous::Args& recv_args,
+    DoneCallback done) {
   Status s;
 
   // Prepare a RecvTensor call that can handle being aborted.
@@ -243,12 +311,19 @@ void StarRemoteRendezvous::RecvFromRemoteAsync(
   }
 
   // Start "call".
-  call->Start([this, call]() {
+  const uint64 start_micros = env_->env->NowMicros();
+  call->Start([this, call, start_micros,
+               tensor = string(parsed.edge_name)]() {
     // Removes "call" from active_. Prevent StartAbort().
     DeregisterCall(call);
     // If StartAbort was called prior to DeregisterCall, then the
     // current status should be bad.
     Status s = call->status();
+    if (s.ok()) {
+      star_stats::RecordRecv(call->src_worker_, tensor,
+                             env_->env->NowMicros() - start_micros,
+                             call->tensor().TotalBytes());
+    }
     call->done()(s, Args(), call->recv_args(), call->tensor(), call->is_dead());
     session()->worker_cache->ReleaseWorker(call->src_worker_, call->wi_);
     call->wi_ = nullptr;
@@ -422,6 +497,12 @@ void StarRemoteRendezvous::FuseRecvFromRemoteAsync(
     const std::vector<Rendezvous::ParsedKey>& parsed_keys,
     const Rendezvous::Args& recv_args, FuseDoneCallback done) {
   CHECK(is_initialized());
+  StartFuseRecv(parsed_keys, recv_args, std::move(done));
+}
+
+void StarRemoteRendezvous::StartFuseRecv(
+    const std::vector<Rendezvous::ParsedKey>& parsed_keys,
+    const Rendezvous::Args& recv_args, FuseDoneCallback done) {
   int fuse_count = parsed_keys.size();
   Status s;
 
@@ -478,12 +559,27 @@ void StarRemoteRendezvous::FuseRecvFromRemoteAsync(
   }
 
   // Start "call".
-  call->Start([this, call]() {
+  std::vector<string> tensor_names;
+  tensor_names.reserve(fuse_count);
+  for (const auto& parsed : parsed_keys) {
+    tensor_names.emplace_back(parsed.edge_name);
+  }
+  const uint64 start_micros = env_->env->NowMicros();
+  call->Start([this, call, start_micros,
+               tensor_names = std::move(tensor_names)]() {
     // Removes "call" from active_. Prevent StartAbort().
     DeregisterCall(call);
     // If StartAbort was called prior to DeregisterCall, then the
     // current status should be bad.
     Status s = call->status();
+    if (s.ok()) {
+      const uint64 micros = env_->env->NowMicros() - start_micros;
+      const std::vector<Tensor>& tensors = call->tensors();
+      for (size_t i = 0; i < tensors.size() && i < tensor_names.size(); ++i) {
+        star_stats::RecordRecv(call->src_worker_, tensor_names[i], micros,
+                               tensors[i].TotalBytes());
+      }
+    }
     call->fuse_done()(s, std::vector<Args>(call->fuse_count_), call->recv_args(),
                       call->tensors(), call->is_deads());
     session()->worker_cache->ReleaseWorker(call->src_worker_, call->wi_);
@@ -493,6 +589,100 @@ void StarRemoteRendezvous::FuseRecvFromRemoteAsync(
   });
 }
 
+void StarRemoteRendezvous::CoalesceRecv(
+    const Rendezvous::ParsedKey& parsed, const Rendezvous::Args& recv_args,
+    DoneCallback done) {
+  const StarCoalesceOptions& options = GetCoalesceOptions();
+  string key = strings::StrCat(
+      parsed.src_device, ";", parsed.dst_device, ";",
+      recv_args.alloc_attrs.value, ";",
+      reinterpret_cast<uintptr_t>(recv_args.device_context), ";",
+      reinterpret_cast<uintptr_t>(recv_args.cancellation_manager));
+  std::vector<PendingRecv> batch;
+  bool arm_timer = false;
+  {
+    mutex_lock l(coalesce_mu_);
+    PeerQueue& peer = peers_[key];
+    if (peer.inflight == 0 && peer.pending.empty()) {
+      batch.push_back({parsed, recv_args, std::move(done)});
+      ++peer.inflight;
+    } else {
+      peer.pending.push_back({parsed, recv_args, std::move(done)});
+      if (static_cast<int64>(peer.pending.size()) >= options.max_count) {
+        batch.swap(peer.pending);
+        ++peer.inflight;
+      } else if (!peer.timer_armed) {
+        peer.timer_armed = true;
+        arm_timer = true;
+      }
+    }
+  }
+  if (arm_timer) {
+    Ref();
+    env_->env->SchedClosureAfter(options.window_us, [this, key]() {
+      FlushPeer(key, false, true);
+      Unref();
+    });
+  }
+  if (!batch.empty()) {
+    SendBatch(key, std::move(batch));
+  }
+}
+
+void StarRemoteRendezvous::FlushPeer(const string& key, bool completed,
+                                     bool timer) {
+  std::vector<PendingRecv> batch;
+  {
+    mutex_lock l(coalesce_mu_);
+    PeerQueue& peer = peers_[key];
+    if (completed) --peer.inflight;
+    if (timer) peer.timer_armed = false;
+    if (peer.pending.empty()) return;
+    batch.swap(peer.pending);
+    ++peer.inflight;
+  }
+  SendBatch(key, std::move(batch));
+}
+
+void StarRemoteRendezvous::SendBatch(const string& key,
+                                     std::vector<PendingRecv> batch) {
+  Ref();
+  if (batch.size() == 1) {
+    PendingRecv& recv = batch[0];
+    DoneCallback done = std::move(recv.done);
+    StartRecv(recv.parsed, recv.recv_args,
+              [this, key, done](const Status& s, const Args& send_args,
+                                const Args& recv_args, const Tensor& val,
+                                bool is_dead) {
+                done(s, send_args, recv_args, val, is_dead);
+                FlushPeer(key, true, false);
+                Unref();
+              });
+    return;
+  }
+
+  std::vector<Rendezvous::ParsedKey> parsed_keys;
+  parsed_keys.reserve(batch.size());
+  for (const PendingRecv& recv : batch) {
+    parsed_keys.push_back(recv.parsed);
+  }
+  Rendezvous::Args recv_args = batch[0].recv_args;
+  auto dones = std::make_shared<std::vector<PendingRecv>>(std::move(batch));
+  StartFuseRecv(
+      parsed_keys, recv_args,
+      [this, key, dones](const Status& s, const std::vector<Args>& send_args,
+                         const Args& recv_args,
+                         const std::vector<Tensor>& vals,
+                         const std::vector<bool>& is_deads) {
+        for (size_t i = 0; i < dones->size(); ++i) {
+          PendingRecv& recv = (*dones)[i];
+          recv.done(s, send_args[i], recv.recv_args, vals[i], is_deads[i]);
+        }
+        FlushPeer(key, true, false);
+        Unref();
+      });
+}
+
 } // namespace
 
 StarRendezvousMgr::StarRendezvousMgr(const WorkerEnv* env)
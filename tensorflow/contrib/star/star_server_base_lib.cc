@@ -1,6 +1,7 @@
 #include <fstream>
 #include <map>
 #include <stdexcept>
+#include <unordered_set>
 
 #include "grpc++/grpc++.h"
 #include "grpc++/security/credentials.h"
@@ -9,6 +10,7 @@
 #include "tensorflow/contrib/star/star_channel_spec.h"
 #include "tensorflow/contrib/star/star_rendezvous_mgr.h"
 #include "tensorflow/contrib/star/star_server_base_lib.h"
+#include "tensorflow/contrib/star/star_stats.h"
 #include "tensorflow/contrib/star/star_worker_service.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
@@ -22,8 +24,10 @@
 #include "tensorflow/core/distributed_runtime/server_lib.h"
 #include "tensorflow/core/distributed_runtime/worker_env.h"
 #include "tensorflow/core/distributed_runtime/worker_resource.h"
+#include "tensorflow/core/framework/embedding/cpu_plan.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/grappler/costs/op_level_cost_estimator.h"
+#include "tensorflow/core/kernels/embedding_delta_stream.h"
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
@@ -35,6 +39,32 @@
 
 namespace tensorflow {
 namespace {
+
+// Pins the inter op pool and the intra op pools of the local devices to the
+// compute cpus of TF_CPU_PLAN, disjoint from the reactor cpus.
+void PinComputePools(const WorkerEnv& env) {
+#if defined(__linux__)
+  const std::vector<unsigned>& cpus = embedding::GetCpuPlan().compute;
+  if (cpus.empty()) {
+    return;
+  }
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  for (unsigned c : cpus) {
+    CPU_SET(c, &cpuset);
+  }
+  env.compute_pool->SetThreadPoolAffinity(cpuset);
+  std::unordered_set<thread::ThreadPool*> pinned;
+  for (Device* d : env.local_devices) {
+    auto threads = d->tensorflow_cpu_worker_threads();
+    if (threads != nullptr && pinned.insert(threads->workers).second) {
+      threads->workers->SetThreadPoolAffinity(cpuset);
+    }
+  }
+  LOG(INFO) << "[Distributed] Compute pools pinned to " << cpus.size()
+            << " cpus of TF_CPU_PLAN.";
+#endif
+}
 const char* kEndpointMapFile = ".endpoint_map";
 } // namespace
 
@@ -260,6 +290,18 @@ Status StarServerBase::Init() {
   worker_service_ = CreateWorkerService(worker_impl_);
 
   worker_env_.compute_pool = ComputePool(sess_opts);
+  PinComputePools(worker_env_);
+  star_stats::MaybeStartMetricsServer();
+  if (server_def_.job_name() == "ps") {
+    // A standby parameter server follows the rows of its primary.
+    for (Device* device : worker_env_.local_devices) {
+      if (device->device_type() == DEVICE_CPU) {
+        embedding::EmbeddingReplicaApplier::MaybeStart(
+            device->resource_manager());
+        break;
+      }
+    }
+  }
   star_bound_port_ = star_port_mgr_->GetLocalStarPort();
   size_t server_number = ParseServers(worker_cache_factory_options);
 
@@ -1,9 +1,11 @@
 #include "tensorflow/contrib/star/star_message.h"
 #include "tensorflow/contrib/star/star_server_tag.h"
+#include "tensorflow/contrib/star/star_stats.h"
 #include "tensorflow/contrib/star/star_tensor_coding.h"
 #include "tensorflow/contrib/star/star_worker_service.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/framework/rendezvous.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 
 
@@ -76,12 +78,15 @@ void InitStarServerTag(protobuf::Message* request,
 
     if (s.ok()) {
       tag->InitResponseTensorBufs(1);
+      uint64 serialize_start = Env::Default()->NowMicros();
       uint64_t payload_len
         = StarMessage::SerializeTensorMessage(response->GetTensor(),
                                               response->GetTensorProto(),
                                               response->GetIsDead(),
                                               &tag->resp_message_bufs_[0],
                                               &tag->resp_tensor_bufs_[0]);
+      star_stats::RecordSerialize(
+          Env::Default()->NowMicros() - serialize_start);
       memcpy(tag->resp_header_buf_.data_ + StarServerTag::kPayloadLenIndex,
              &payload_len, 8);
 
@@ -124,6 +129,7 @@ void InitStarServerTag(protobuf::Message* request,
     if (s.ok()) {
       tag->InitResponseTensorBufs(response->GetFuseCount());
       uint64_t payload_len = 0;
+      uint64 serialize_start = Env::Default()->NowMicros();
       for (int idx = 0; idx < tag->resp_tensor_count_; ++idx) {
         payload_len
           += StarMessage::SerializeTensorMessage(response->GetTensorByIndex(idx),
@@ -132,6 +138,8 @@ void InitStarServerTag(protobuf::Message* request,
                                                  &tag->resp_message_bufs_[idx],
                                                  &tag->resp_tensor_bufs_[idx]);
       }
+      star_stats::RecordSerialize(
+          Env::Default()->NowMicros() - serialize_start);
       memcpy(tag->resp_header_buf_.data_ + StarServerTag::kPayloadLenIndex,
              &payload_len, 8);
     } else {
@@ -171,9 +179,8 @@ void InitStarServerTag(StarServerTag* tag) {
     if (can_memcpy) {
       //TODO: Implement GPU device here
       Tensor val(cpu_allocator(), sm.data_type_, sm.tensor_shape_);
-      tag->req_tensor_bufs_[idx].data_ = reinterpret_cast<char*>(DMAHelper::base(&val));
-      tag->req_tensor_bufs_[idx].len_ =  sm.tensor_bytes_;
-      tag->req_tensor_bufs_[idx].owned_ = false;
+      StarMessage::InitTensorBuf(sm, val, &tag->req_tensor_bufs_[idx],
+                                 &tag->req_coded_tensors_[idx]);
       tag->star_graph_request_.feed_tensors_[idx] = val;
     } else {
       tag->req_tensor_bufs_[idx].len_ = sm.tensor_bytes_;
@@ -187,6 +194,8 @@ void InitStarServerTag(StarServerTag* tag) {
     = std::bind([tag] () {
     uint64_t count = tag->req_tensor_count_;
     for (uint64_t i = 0; i < count; ++i) {
+      TF_RETURN_IF_ERROR(StarMessage::DecodeTensor(tag->req_tensor_bufs_[i],
+                                                   &tag->req_coded_tensors_[i]));
       bool can_memcpy = DataTypeCanUseMemcpy(tag->star_graph_request_.data_type_[i]);
       if (can_memcpy) {
         //TODO: Implement GPU device here
@@ -270,6 +279,7 @@ void StarServerTag::FillRespBody() {
   InitResponseTensorBufs(fetch_count);
 
   uint64_t payload_len = meta_len;
+  uint64 serialize_start = Env::Default()->NowMicros();
   for (uint64_t i = 0; i < fetch_count; ++i) {
     TensorProto tensor_proto;
     if (!DataTypeCanUseMemcpy(star_graph_response_.fetch_tensors_[i].dtype())) {
@@ -282,6 +292,7 @@ void StarServerTag::FillRespBody() {
                                              &resp_message_bufs_[i],
                                              &resp_tensor_bufs_[i]);
   }
+  star_stats::RecordSerialize(Env::Default()->NowMicros() - serialize_start);
 
   memcpy(resp_header_buf_.data_ + StarServerTag::kPayloadLenIndex,
          &payload_len, 8);
@@ -312,6 +323,7 @@ bool StarServerTag::IsStarRunGraph() {
 void StarServerTag::InitRequestTensorBufs(int count) {
   req_tensor_count_ = count;
   req_tensor_bufs_.resize(count);
+  req_coded_tensors_.resize(count);
 }
 
 uint64_t StarServerTag::GetRequestTensorSize(int idx) {
@@ -376,6 +388,7 @@ bool StarServerTag::IsRecvTensor() {
 
 // Called by star engine, call the handler.
 void StarServerTag::RecvReqDone(Status s) {
+  recv_req_done_micros_ = Env::Default()->NowMicros();
   if (!s.ok()) {
     this->send_resp_(s);
     // TODO(handle clear)
@@ -396,6 +409,8 @@ void StarServerTag::SendRespDone() {
 // and send response
 void StarServerTag::ProcessDone(Status s) {
   //LOG(INFO) << "enter starServerTag::ProcessDone";
+  star_stats::RecordServerProcess(
+      method_, Env::Default()->NowMicros() - recv_req_done_micros_);
   send_resp_(s);
 }
 
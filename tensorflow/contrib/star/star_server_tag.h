@@ -4,6 +4,7 @@
 #include <sys/time.h>
 #include <functional>
 
+#include "tensorflow/contrib/star/star_message.h"
 #include "tensorflow/contrib/star/star_tensor_coding.h"
 #include "tensorflow/contrib/star/star_worker_service_method.h"
 #include "tensorflow/core/lib/core/status.h"
@@ -102,6 +103,7 @@ class StarServerTag {
   std::vector<StarBuf> resp_tensor_bufs_;
 
   std::vector<StarBuf> req_tensor_bufs_;
+  std::vector<StarCodedTensor> req_coded_tensors_;
 
   StarRunGraphRequest star_graph_request_;
   StarRunGraphResponse star_graph_response_;
@@ -115,6 +117,8 @@ class StarServerTag {
   StarWorkerService* star_worker_service_;
 
   timeval start_time_ts_;
+  // When the request is received, for the server metrics.
+  uint64 recv_req_done_micros_ = 0;
  private:
   friend void InitStarServerTag(protobuf::Message* request,
                                 protobuf::Message* response,
@@ -134,6 +138,8 @@ class StarServerTag {
   friend class SeastarEngine;
   friend class SeastarClient;
   friend class SeastarServer;
+  friend class RdmaTagFactory;
+  friend class RdmaEngine;
 };
 
 } // namespace tensorflow
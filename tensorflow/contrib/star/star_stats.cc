@@ -0,0 +1,255 @@
+#include "tensorflow/contrib/star/star_stats.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cctype>
+#include <cerrno>
+#include <cfloat>
+#include <cstring>
+#include <memory>
+
+#include "tensorflow/core/lib/monitoring/collection_registry.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/sampler.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace star_stats {
+namespace {
+
+// 16us to ~17min.
+std::unique_ptr<monitoring::Buckets> LatencyBuckets() {
+  return monitoring::Buckets::Exponential(16, 2, 27);
+}
+
+auto* recv_usecs = monitoring::Sampler<1>::New(
+    {"/tensorflow/star/client/recv_usecs",
+     "Latency of the recvs from a remote worker in microseconds.", "peer"},
+    LatencyBuckets());
+
+auto* recv_bytes = monitoring::Counter<1>::New(
+    "/tensorflow/star/client/recv_bytes",
+    "Bytes received from remote workers per tensor.", "tensor");
+
+auto* server_queue_usecs = monitoring::Sampler<1>::New(
+    {"/tensorflow/star/server/queue_usecs",
+     "Time a request waits for its handler in microseconds.", "method"},
+    LatencyBuckets());
+
+auto* server_process_usecs = monitoring::Sampler<1>::New(
+    {"/tensorflow/star/server/process_usecs",
+     "Time from the arrival of a request to its response in microseconds.",
+     "method"},
+    LatencyBuckets());
+
+auto* serialize_usecs = monitoring::Sampler<0>::New(
+    {"/tensorflow/star/server/serialize_usecs",
+     "Time serializing the tensors of a response in microseconds."},
+    monitoring::Buckets::Exponential(1, 2, 24));
+
+const char* MethodName(StarWorkerServiceMethod method) {
+  switch (method) {
+    case kGetStatus: return "GetStatus";
+    case kGetTopologyStatus: return "GetTopologyStatus";
+    case kCreateWorkerSession: return "CreateWorkerSession";
+    case kDeleteWorkerSession: return "DeleteWorkerSession";
+    case kRegisterGraph: return "RegisterGraph";
+    case kDeregisterGraph: return "DeregisterGraph";
+    case kRunGraph: return "RunGraph";
+    case kStarRunGraph: return "StarRunGraph";
+    case kCleanupGraph: return "CleanupGraph";
+    case kCleanupAll: return "CleanupAll";
+    case kRecvTensor: return "RecvTensor";
+    case kFuseRecvTensor: return "FuseRecvTensor";
+    case kLogging: return "Logging";
+    case kTracing: return "Tracing";
+    case kRecvBuf: return "RecvBuf";
+    case kCompleteGroup: return "CompleteGroup";
+    case kCompleteInstance: return "CompleteInstance";
+    case kGetStepSequence: return "GetStepSequence";
+    default: return "Invalid";
+  }
+}
+
+// "/tensorflow/star/client/recv_usecs" -> "tensorflow_star_client_recv_usecs"
+string PrometheusName(const string& name) {
+  string out;
+  for (char c : name) {
+    if (isalnum(c)) {
+      out.push_back(c);
+    } else if (!out.empty()) {
+      out.push_back('_');
+    }
+  }
+  return out;
+}
+
+string PrometheusLabels(const monitoring::Point& point,
+                        const string& extra = "") {
+  string out;
+  for (const auto& label : point.labels) {
+    string value;
+    for (char c : label.value) {
+      if (c == '\\' || c == '"') {
+        value.push_back('\\');
+        value.push_back(c);
+      } else if (c == '\n') {
+        value += "\\n";
+      } else {
+        value.push_back(c);
+      }
+    }
+    strings::StrAppend(&out, out.empty() ? "" : ",", label.name, "=\"",
+                       value, "\"");
+  }
+  if (!extra.empty()) {
+    strings::StrAppend(&out, out.empty() ? "" : ",", extra);
+  }
+  return out.empty() ? out : strings::StrCat("{", out, "}");
+}
+
+void ServeMetrics(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    LOG(ERROR) << "Star metrics server: socket failed, " << strerror(errno);
+    return;
+  }
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      listen(fd, 16) != 0) {
+    LOG(ERROR) << "Star metrics server: can't listen on port " << port
+               << ", " << strerror(errno);
+    close(fd);
+    return;
+  }
+  LOG(INFO) << "Star metrics server listens on port " << port;
+  while (true) {
+    int conn = accept(fd, nullptr, nullptr);
+    if (conn < 0) {
+      if (errno == EINTR) continue;
+      LOG(ERROR) << "Star metrics server: accept failed, " << strerror(errno);
+      break;
+    }
+    // Any request gets the metrics.
+    char request[1024];
+    if (read(conn, request, sizeof(request)) >= 0) {
+      string body = ExportPrometheusText();
+      string response = strings::StrCat(
+          "HTTP/1.0 200 OK\r\n"
+          "Content-Type: text/plain; version=0.0.4\r\n"
+          "Content-Length: ", body.size(), "\r\n\r\n", body);
+      size_t sent = 0;
+      while (sent < response.size()) {
+        ssize_t n = write(conn, response.data() + sent,
+                          response.size() - sent);
+        if (n <= 0) break;
+        sent += n;
+      }
+    }
+    close(conn);
+  }
+  close(fd);
+}
+
+}  // namespace
+
+void RecordRecv(const string& peer, StringPiece tensor, uint64 micros,
+                int64 bytes) {
+  recv_usecs->GetCell(peer)->Add(micros);
+  recv_bytes->GetCell(string(tensor))->IncrementBy(bytes);
+}
+
+void RecordServerQueue(StarWorkerServiceMethod method, uint64 micros) {
+  server_queue_usecs->GetCell(MethodName(method))->Add(micros);
+}
+
+void RecordServerProcess(StarWorkerServiceMethod method, uint64 micros) {
+  server_process_usecs->GetCell(MethodName(method))->Add(micros);
+}
+
+void RecordSerialize(uint64 micros) {
+  serialize_usecs->GetCell()->Add(micros);
+}
+
+string ExportPrometheusText() {
+  monitoring::CollectionRegistry::CollectMetricsOptions options;
+  std::unique_ptr<monitoring::CollectedMetrics> metrics =
+      monitoring::CollectionRegistry::Default()->CollectMetrics(options);
+  string out;
+  for (const auto& it : metrics->point_set_map) {
+    const string name = PrometheusName(it.first);
+    const auto desc = metrics->metric_descriptor_map.find(it.first);
+    if (desc == metrics->metric_descriptor_map.end()) continue;
+    const monitoring::MetricDescriptor& d = *desc->second;
+    if (d.value_type == monitoring::ValueType::kString) continue;
+    const bool histogram = d.value_type == monitoring::ValueType::kHistogram;
+    const char* type =
+        histogram ? "histogram"
+                  : (d.metric_kind == monitoring::MetricKind::kCumulative
+                         ? "counter" : "gauge");
+    strings::StrAppend(&out, "# HELP ", name, " ", d.description, "\n");
+    strings::StrAppend(&out, "# TYPE ", name, " ", type, "\n");
+    for (const auto& point : it.second->points) {
+      switch (point->value_type) {
+        case monitoring::ValueType::kInt64:
+          strings::StrAppend(&out, name, PrometheusLabels(*point), " ",
+                             point->int64_value, "\n");
+          break;
+        case monitoring::ValueType::kBool:
+          strings::StrAppend(&out, name, PrometheusLabels(*point), " ",
+                             point->bool_value ? 1 : 0, "\n");
+          break;
+        case monitoring::ValueType::kHistogram: {
+          const HistogramProto& h = point->histogram_value;
+          double cumulative = 0;
+          for (int i = 0; i < h.bucket_size(); ++i) {
+            cumulative += h.bucket(i);
+            const double limit = h.bucket_limit(i);
+            string le = limit >= DBL_MAX
+                            ? "le=\"+Inf\""
+                            : strings::StrCat("le=\"", limit, "\"");
+            strings::StrAppend(&out, name, "_bucket",
+                               PrometheusLabels(*point, le), " ",
+                               cumulative, "\n");
+          }
+          strings::StrAppend(&out, name, "_sum", PrometheusLabels(*point),
+                             " ", h.sum(), "\n");
+          strings::StrAppend(&out, name, "_count", PrometheusLabels(*point),
+                             " ", h.num(), "\n");
+          break;
+        }
+        default:
+          break;
+      }
+    }
+  }
+  return out;
+}
+
+void MaybeStartMetricsServer() {
+  static bool started = [] {
+    int64 port = 0;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_STAR_METRICS_PORT", 0, &port));
+    if (port <= 0) {
+      return false;
+    }
+    // Lives as long as the process.
+    Env::Default()->StartThread(ThreadOptions(), "star_metrics_server",
+                                [port]() { ServeMetrics(port); });
+    return true;
+  }();
+  (void)started;
+}
+
+}  // namespace star_stats
+}  // namespace tensorflow
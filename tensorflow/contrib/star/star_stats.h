@@ -0,0 +1,40 @@
+#ifndef TENSORFLOW_CONTRIB_STAR_STAR_STATS_H_
+#define TENSORFLOW_CONTRIB_STAR_STAR_STATS_H_
+
+#include <string>
+
+#include "tensorflow/contrib/star/star_worker_service_method.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace star_stats {
+
+// Metrics of the star runtime, in the monitoring CollectionRegistry:
+//
+//  * /tensorflow/star/client/recv_usecs{peer}: latency of the recvs from a
+//    remote worker, from the request to the tensor.
+//  * /tensorflow/star/client/recv_bytes{tensor}: bytes received per tensor.
+//  * /tensorflow/star/server/queue_usecs{method}: time a request waits
+//    between its arrival and its handler.
+//  * /tensorflow/star/server/process_usecs{method}: time from the arrival
+//    of a request to its response.
+//  * /tensorflow/star/server/serialize_usecs: time serializing the tensors
+//    of a response.
+void RecordRecv(const string& peer, StringPiece tensor, uint64 micros,
+                int64 bytes);
+void RecordServerQueue(StarWorkerServiceMethod method, uint64 micros);
+void RecordServerProcess(StarWorkerServiceMethod method, uint64 micros);
+void RecordSerialize(uint64 micros);
+
+// Returns all the metrics of the process in the Prometheus text format.
+string ExportPrometheusText();
+
+// Serves ExportPrometheusText over HTTP on TF_STAR_METRICS_PORT, once per
+// process. Nothing if it is not set.
+void MaybeStartMetricsServer();
+
+}  // namespace star_stats
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CONTRIB_STAR_STAR_STATS_H_
@@ -1,5 +1,6 @@
 #include "tensorflow/contrib/star/star_worker_service.h"
 #include "tensorflow/contrib/star/star_server_tag.h"
+#include "tensorflow/contrib/star/star_stats.h"
 #include "tensorflow/contrib/star/star_tensor_coding.h"
 #include "tensorflow/contrib/verbs/verbs_util.h"
 #include "tensorflow/core/distributed_runtime/call_options.h"
@@ -58,7 +59,7 @@ HandleRequestFunction StarWorkerService::GetHandler(StarWorkerServiceMethod meth
 }
 
 void StarWorkerService::RunGraphHandler(StarServerTag* tag) {
-  Schedule([this, tag]() {
+  Schedule(tag, [this, tag]() {
       StarCall<RunGraphRequest, RunGraphResponse>
         *call = new StarCall<RunGraphRequest, RunGraphResponse>();
       InitStarServerTag(&call->req_, &call->resp_, tag);
@@ -81,7 +82,7 @@ void StarWorkerService::RunGraphHandler(StarServerTag* tag) {
 }
 
 void StarWorkerService::StarRunGraphHandler(StarServerTag* tag) {
-  Schedule([this, tag]() {
+  Schedule(tag, [this, tag]() {
     worker_->StarRunGraphAsync(&(tag->star_graph_request_),
                                &(tag->star_graph_response_),
                                [this, tag](const Status& s) {
@@ -93,7 +94,7 @@ void StarWorkerService::StarRunGraphHandler(StarServerTag* tag) {
 }
 
 void StarWorkerService::GetStatusHandler(StarServerTag* tag) {
-  Schedule([this, tag]() {
+  Schedule(tag, [this, tag]() {
       StarCall<GetStatusRequest, GetStatusResponse>
         *call = new StarCall<GetStatusRequest, GetStatusResponse>();
       InitStarServerTag(&call->req_, &call->resp_, tag);
@@ -106,7 +107,7 @@ void StarWorkerService::GetStatusHandler(StarServerTag* tag) {
 }
 
 void StarWorkerService::CreateWorkerSessionHandler(StarServerTag* tag) {
-  Schedule([this, tag]() {
+  Schedule(tag, [this, tag]() {
       StarCall<CreateWorkerSessionRequest, CreateWorkerSessionResponse>
         *call = new StarCall<CreateWorkerSessionRequest, CreateWorkerSessionResponse>();
       InitStarServerTag(&call->req_, &call->resp_, tag);
@@ -118,7 +119,7 @@ void StarWorkerService::CreateWorkerSessionHandler(StarServerTag* tag) {
 }
 
 void StarWorkerService::DeleteWorkerSessionHandler(StarServerTag* tag) {
-  Schedule([this, tag]() {
+  Schedule(tag, [this, tag]() {
       StarCall<DeleteWorkerSessionRequest, DeleteWorkerSessionResponse>
 	*call = new StarCall<DeleteWorkerSessionRequest,
 			     DeleteWorkerSessionResponse>();
@@ -131,7 +132,7 @@ void StarWorkerService::DeleteWorkerSessionHandler(StarServerTag* tag) {
 }
 
 void StarWorkerService::CleanupAllHandler(StarServerTag* tag) {
-  Schedule([this, tag]() {
+  Schedule(tag, [this, tag]() {
       StarCall<CleanupAllRequest, CleanupAllResponse>
         *call = new StarCall<CleanupAllRequest, CleanupAllResponse>();
       InitStarServerTag(&call->req_, &call->resp_, tag);
@@ -143,7 +144,7 @@ void StarWorkerService::CleanupAllHandler(StarServerTag* tag) {
 }
 
 void StarWorkerService::RegisterGraphHandler(StarServerTag* tag) {
-  Schedule([this, tag]() {
+  Schedule(tag, [this, tag]() {
       StarCall<RegisterGraphRequest, RegisterGraphResponse>
         *call = new StarCall<RegisterGraphRequest, RegisterGraphResponse>();
       InitStarServerTag(&call->req_, &call->resp_, tag);
@@ -155,7 +156,7 @@ void StarWorkerService::RegisterGraphHandler(StarServerTag* tag) {
 }
 
 void StarWorkerService::DeregisterGraphHandler(StarServerTag* tag) {
-  Schedule([this, tag]() {
+  Schedule(tag, [this, tag]() {
       StarCall<DeregisterGraphRequest, DeregisterGraphResponse>
         *call = new StarCall<DeregisterGraphRequest, DeregisterGraphResponse>();
       InitStarServerTag(&call->req_, &call->resp_, tag);
@@ -167,7 +168,7 @@ void StarWorkerService::DeregisterGraphHandler(StarServerTag* tag) {
 }
 
 void StarWorkerService::CleanupGraphHandler(StarServerTag* tag) {
-  Schedule([this, tag]() {
+  Schedule(tag, [this, tag]() {
       StarCall<CleanupGraphRequest, CleanupGraphResponse>
         *call = new StarCall<CleanupGraphRequest, CleanupGraphResponse>();
       InitStarServerTag(&call->req_, &call->resp_, tag);
@@ -179,7 +180,7 @@ void StarWorkerService::CleanupGraphHandler(StarServerTag* tag) {
 }
 
 void StarWorkerService::LoggingHandler(StarServerTag* tag) {
-  Schedule([this, tag]() {
+  Schedule(tag, [this, tag]() {
       StarCall<LoggingRequest, LoggingResponse>
         *call = new StarCall<LoggingRequest, LoggingResponse>();
       InitStarServerTag(&call->req_, &call->resp_, tag);
@@ -191,7 +192,7 @@ void StarWorkerService::LoggingHandler(StarServerTag* tag) {
 }
 
 void StarWorkerService::TracingHandler(StarServerTag* tag) {
-  Schedule([this, tag]() {
+  Schedule(tag, [this, tag]() {
       StarCall<TracingRequest, TracingResponse>
         *call = new StarCall<TracingRequest, TracingResponse>();
       InitStarServerTag(&call->req_, &call->resp_, tag);
@@ -224,7 +225,7 @@ void StarWorkerService::GetStepSequenceHandler(StarServerTag* tag) {
 
 void StarWorkerService::RecvTensorHandlerRaw(StarServerTag *tag) {
   // LOG(INFO) << "StarWorkerService::RecvTensorHandlerRaw";
-  Schedule([this, tag]() {
+  Schedule(tag, [this, tag]() {
       CallOptions* call_opts = new CallOptions;
 
       StarCall<RecvTensorRequest, StarTensorResponse> *call =
@@ -243,7 +244,7 @@ void StarWorkerService::RecvTensorHandlerRaw(StarServerTag *tag) {
 
 void StarWorkerService::FuseRecvTensorHandlerRaw(StarServerTag *tag) {
   // LOG(INFO) << "StarWorkerService::FuseRecvTensorHandlerRaw";
-  Schedule([this, tag]() {
+  Schedule(tag, [this, tag]() {
       CallOptions* call_opts = new CallOptions;
 
       StarCall<FuseRecvTensorRequest, StarFuseTensorResponse> *call =
@@ -264,6 +265,15 @@ void StarWorkerService::Schedule(std::function<void()> f) {
   worker_->env()->compute_pool->Schedule(std::move(f));
 }
 
+void StarWorkerService::Schedule(StarServerTag* tag,
+                                 std::function<void()> f) {
+  Schedule([tag, f]() {
+    star_stats::RecordServerQueue(
+        tag->method_, Env::Default()->NowMicros() - tag->recv_req_done_micros_);
+    f();
+  });
+}
+
 StarWorker* StarWorkerService::GetWorker() const {
   return worker_;
 }
@@ -79,6 +79,8 @@ public:
 
 private:
   virtual void Schedule(std::function<void()> f);
+  // Schedules the handler of 'tag' and records how long it waited.
+  void Schedule(StarServerTag* tag, std::function<void()> f);
 
 private:
   std::map<StarWorkerServiceMethod, HandleRequestFunction> handler_map_;
@@ -1421,8 +1421,10 @@ ibv_mr* RdmaMemoryMgr::FindMemoryRegion(void* addr, size_t length) {
 void RdmaMemoryMgr::InsertMemoryRegion(void* addr, size_t length,
                                        const std::string& allocator_name) {
   if (length == 0) return;
+  // Remote read lets the star RDMA transport pull tensors one-sided.
   ibv_mr* mr = ibv_reg_mr(pd_, addr, length,
-                          IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE);
+                          IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE |
+                              IBV_ACCESS_REMOTE_READ);
   RDMA_LOG(1) << "Insert memory region 0x" << std::hex << mr->rkey << ". ["
               << addr << "-" << (void*)((uint64_t)addr + length - 1) << "]"
               << " SIZE: 0x" << length << " (" << allocator_name << ").";
@@ -365,6 +365,12 @@ class RdmaTensorResponse {
 };
 
 class RdmaMessageBuffer;
+// Device and port setup from the RDMA_* environment variables, shared with
+// the other transports over ibverbs.
+ibv_device* set_device();
+ibv_context* open_device(ibv_device* ibv_dev);
+RdmaParams params_init(ibv_context* context);
+
 // Class that represents the Rdma Adapter.
 // Responsible for creation of the completion queue, and handling
 // of work completions.
@@ -63,6 +63,9 @@ const char* GetCollectiveName(const CollectiveParams* cp, bool nccl) {
       return "HierarchicalTreeBroadcast";
 
     case REDUCTION_COLLECTIVE:
+      if (cp->instance.impl_details.communication_hint == "hierarchical") {
+        return "HierarchicalRingReduce";
+      }
       return nccl ? "NcclReduce" : "RingReduce";
 
     case GATHER_COLLECTIVE:
@@ -0,0 +1,54 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#include "tensorflow/core/common_runtime/deadline_scheduler.h"
+
+#include <unordered_map>
+
+namespace tensorflow {
+
+DeadlineScheduler* DeadlineScheduler::Global(thread::ThreadPool* pool) {
+  static mutex* mu = new mutex;
+  static auto* schedulers =
+      new std::unordered_map<thread::ThreadPool*, DeadlineScheduler*>;
+  mutex_lock l(*mu);
+  DeadlineScheduler*& scheduler = (*schedulers)[pool];
+  if (scheduler == nullptr) {
+    scheduler = new DeadlineScheduler(pool);
+  }
+  return scheduler;
+}
+
+void DeadlineScheduler::Schedule(std::function<void()> fn,
+                                 int64 deadline_micros) {
+  {
+    mutex_lock l(mu_);
+    tasks_.push({deadline_micros, next_seq_++, std::move(fn)});
+  }
+  pool_->Schedule([this]() { RunEarliest(); });
+}
+
+void DeadlineScheduler::RunEarliest() {
+  std::function<void()> fn;
+  {
+    mutex_lock l(mu_);
+    // There are as many trampolines as tasks, so the queue can't be empty.
+    fn = std::move(const_cast<Task&>(tasks_.top()).fn);
+    tasks_.pop();
+  }
+  fn();
+}
+
+}  // namespace tensorflow
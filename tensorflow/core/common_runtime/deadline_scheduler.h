@@ -0,0 +1,76 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_DEADLINE_SCHEDULER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_DEADLINE_SCHEDULER_H_
+
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Runs the closures of the steps which have a deadline on a thread pool in
+// the earliest deadline first order, so that under overload the steps which
+// can still meet their deadlines go first instead of all the steps being
+// late. Every Schedule() schedules one trampoline on the pool, which runs
+// the pending closure of earliest deadline when it gets a thread.
+class DeadlineScheduler {
+ public:
+  explicit DeadlineScheduler(thread::ThreadPool* pool) : pool_(pool) {}
+
+  // The scheduler of a pool which lives as long as the process, shared by
+  // all the sessions using it, e.g. the global inter op pool of the sessions
+  // of a DirectSessionGroup.
+  static DeadlineScheduler* Global(thread::ThreadPool* pool);
+
+  // Schedules fn for a step which must complete by deadline_micros, in
+  // Env::NowMicros() time.
+  void Schedule(std::function<void()> fn, int64 deadline_micros);
+
+ private:
+  struct Task {
+    int64 deadline_micros;
+    uint64 seq;
+    std::function<void()> fn;
+  };
+  // Orders the priority queue by deadline, then in the scheduling order.
+  struct Later {
+    bool operator()(const Task& a, const Task& b) const {
+      if (a.deadline_micros != b.deadline_micros) {
+        return a.deadline_micros > b.deadline_micros;
+      }
+      return a.seq > b.seq;
+    }
+  };
+
+  void RunEarliest();
+
+  thread::ThreadPool* pool_;
+  mutex mu_;
+  uint64 next_seq_ GUARDED_BY(mu_) = 0;
+  std::priority_queue<Task, std::vector<Task>, Later> tasks_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(DeadlineScheduler);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_DEADLINE_SCHEDULER_H_
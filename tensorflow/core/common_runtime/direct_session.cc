@@ -16,13 +16,17 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/direct_session.h"
 #include "tensorflow/core/common_runtime/custom_thread_pool.h"
 
+#include <algorithm>
 #include <atomic>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "absl/container/flat_hash_set.h"
+#include "absl/time/time.h"
 #include "tensorflow/core/common_runtime/collective_executor_mgr.h"
 #include "tensorflow/core/common_runtime/collective_param_resolver_local.h"
 #include "tensorflow/core/common_runtime/constant_folding.h"
@@ -44,6 +48,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/direct_session_group.h"
 #include "tensorflow/core/common_runtime/scoped_allocator_mgr.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
+#include "tensorflow/core/framework/embedding/lock_contention.h"
 #include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/framework/graph.pb_text.h"
 #include "tensorflow/core/framework/graph.pb.h"
@@ -68,6 +73,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/core/threadpool_options.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
+#include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/gtl/stl_util.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/random/random.h"
@@ -78,6 +84,7 @@ limitations under the License.
 #include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/profiler/lib/profiler_session.h"
@@ -185,6 +192,26 @@ string GetRendezvousKey(const string& tensor_name,
                          frame_iter.frame_id, ":", frame_iter.iter_id);
 }
 
+// Returns the NUMA node which has all the cpus, kNUMANoAffinity if the
+// cpus span several nodes.
+int NUMANodeOfCpus(const std::vector<unsigned>& cpus) {
+  if (!port::NUMAEnabled()) {
+    return port::kNUMANoAffinity;
+  }
+  for (int node = 0; node < port::NUMANumNodes(); ++node) {
+    std::vector<unsigned> node_cpus;
+    port::NUMANodeCPUs(node, &node_cpus);
+    std::unordered_set<unsigned> node_cpu_set(node_cpus.begin(),
+                                              node_cpus.end());
+    if (std::all_of(cpus.begin(), cpus.end(), [&node_cpu_set](unsigned c) {
+          return node_cpu_set.count(c) > 0;
+        })) {
+      return node;
+    }
+  }
+  return port::kNUMANoAffinity;
+}
+
 // TODO: Any better allocate policy?
 void AllocateVisibleCpusForSession(
     const std::vector<unsigned>& visible_cpus, int session_num,
@@ -287,6 +314,45 @@ void ParseStreamPriority(const std::string& priority_str,
   }
 }
 
+// "1024" sets the memory limit of every session,
+// "1024,1024,2048;2048,1024,1024" sets the limit of every session on
+// every device as STREAM_PRIORITY does, in MB.
+void ParseSessionGpuMemoryLimit(const std::string& memory_limit_str,
+                                std::vector<std::vector<int64>>& memory_limit,
+                                int device_count, int stream_num_per_device) {
+  if (memory_limit_str.empty()) return;
+
+  std::vector<std::string> strs = str_util::Split(memory_limit_str, ";");
+  if (strs.size() == 1 && strs[0].find(",") == std::string::npos) {
+    strs.assign(device_count, strs[0]);
+  }
+  if (device_count != strs.size()) {
+    LOG(FATAL) << "User set gpu memory limit num " << strs.size()
+               << " must be equal to device count " << device_count;
+  }
+  for (auto& s : strs) {
+    std::vector<std::string> tmp = str_util::Split(s, ",");
+    if (tmp.size() == 1) {
+      tmp.assign(stream_num_per_device, tmp[0]);
+    }
+    std::vector<int64> each_limit;
+    for (auto& t : tmp) {
+      int64 limit_mb = 0;
+      if (!strings::safe_strto64(t, &limit_mb) || limit_mb <= 0) {
+        LOG(FATAL) << "Invalid gpu memory limit: " << t;
+      }
+      each_limit.emplace_back(limit_mb);
+    }
+    if (stream_num_per_device != each_limit.size()) {
+      LOG(FATAL) << "User set gpu memory limit num per device: "
+                 << each_limit.size()
+                 << " must be equal to stream num per device: "
+                 << stream_num_per_device;
+    }
+    memory_limit.emplace_back(each_limit);
+  }
+}
+
 }  // namespace
 
 class DirectSessionFactory : public SessionFactory {
@@ -470,6 +536,23 @@ class DirectSessionFactory : public SessionFactory {
                             stream_num_per_device);
       }
 
+      // Memory quota of every session in MB, a single value or
+      // "1024,1024,2048;2048,1024,1024" as STREAM_PRIORITY. By default the
+      // available memory of a device is split evenly between the sessions.
+      std::string memory_limit_str;
+      std::vector<std::vector<int64>> memory_limit;
+      s = ReadStringFromEnvVar("SESSION_GROUP_GPU_MEMORY_LIMIT_MB", "",
+                               &memory_limit_str);
+      if (!s.ok()) {
+        LOG(FATAL) << "Read SESSION_GROUP_GPU_MEMORY_LIMIT_MB failed: "
+                   << s.error_message();
+      }
+      if (!memory_limit_str.empty()) {
+        ParseSessionGpuMemoryLimit(memory_limit_str, memory_limit,
+                                   user_set_gpu_ids.size(),
+                                   stream_num_per_device);
+      }
+
       sorted_gpu_ids = user_set_gpu_ids;
       std::sort(sorted_gpu_ids.begin(), sorted_gpu_ids.end());
       ConfigProto* config = const_cast<ConfigProto*>(&options.config);
@@ -480,7 +563,14 @@ class DirectSessionFactory : public SessionFactory {
             gpu_options->mutable_experimental()->add_virtual_devices();
         if (id == sorted_gpu_ids[curr_idx]) {
           for (int i = 0; i < stream_num_per_device; ++i) {
-            virtual_devices->add_memory_limit_mb(-1);
+            if (memory_limit.size() > curr_idx) {
+              LOG(INFO) << "Device " << id << ", stream " << i
+                        << " memory limit is set to "
+                        << memory_limit[curr_idx][i] << "MB";
+              virtual_devices->add_memory_limit_mb(memory_limit[curr_idx][i]);
+            } else {
+              virtual_devices->add_memory_limit_mb(-1);
+            }
             if (priority.size() > curr_idx) {
               LOG(INFO) << "Device " << id << ", stream " << i
                         << " priority is set to " << priority[curr_idx][i];
@@ -897,8 +987,36 @@ DirectSession::DirectSession(const SessionOptions& options,
     ++devices_added;
   }
 
-  // thread pool set affinity
-  if (visible_cpus.size() > 0 &&
+  // Thread per core mode of session group, the default inter op pool of the
+  // session gets one thread per visible cpu, every thread is pinned to its
+  // own cpu and to the NUMA node of the cpus. The threads steal the ops from
+  // each other's queues, and the cheap ops are inlined by the cost model
+  // executor.
+  bool thread_per_core = false;
+  s = ReadBoolFromEnvVar("SESSION_GROUP_THREAD_PER_CORE", false,
+                         &thread_per_core);
+  if (!s.ok()) {
+    LOG(FATAL) << s.error_message();
+  }
+  if (visible_cpus.size() > 0 && thread_per_core) {
+    ThreadOptions thread_options;
+    thread_options.cpus = visible_cpus;
+    thread_options.numa_node = NUMANodeOfCpus(visible_cpus);
+    auto pool = new thread::ThreadPool(
+        options_.env, thread_options, "SessionCompute", visible_cpus.size(),
+        !options_.config.experimental().disable_thread_spinning(),
+        /*allocator=*/nullptr);
+    if (thread_pools_[0].second) {
+      delete thread_pools_[0].first;
+    }
+    thread_pools_[0] = std::make_pair(pool, true);
+    if (!run_in_caller_thread_) {
+      run_cost_model_executor_ = true;
+    }
+    LOG(INFO) << "Current DirectSession " << this << " runs "
+              << visible_cpus.size() << " threads pinned per core, numa node: "
+              << thread_options.numa_node;
+  } else if (visible_cpus.size() > 0 &&
       options_.config.use_per_session_threads()) {
     if (thread_pools_.size() != 1) {
       LOG(FATAL) << "Thread pool num is not 1 with 'use_per_session_threads' option.";
@@ -918,6 +1036,9 @@ DirectSession::DirectSession(const SessionOptions& options,
   tensorflow::ReadBoolFromEnvVar("MERGE_COMPUTE_COPY_STREAM",
                                  /*default_val=*/false,
                                  &merge_compute_and_copy_stream_);
+  tensorflow::ReadBoolFromEnvVar("TF_DEADLINE_SCHEDULING",
+                                 /*default_val=*/false,
+                                 &use_deadline_scheduling_);
 }
 
 DirectSession::~DirectSession() {
@@ -1068,6 +1189,25 @@ Status DirectSession::RunInternal(
       },
       profiler::TraceMeLevel::kInfo);
 
+  // The run must complete by the earlier of its timeout and its deadline, a
+  // run which is already late is dropped before using any thread.
+  const int64 timeout_in_ms = run_options.timeout_in_ms() > 0
+                                  ? run_options.timeout_in_ms()
+                                  : operation_timeout_in_ms_;
+  int64 deadline_micros = run_options.experimental().deadline_micros();
+  if (timeout_in_ms > 0) {
+    const int64 timeout_micros = start_time_usecs + timeout_in_ms * 1000;
+    if (deadline_micros <= 0 || timeout_micros < deadline_micros) {
+      deadline_micros = timeout_micros;
+    }
+  }
+  if (deadline_micros > 0 &&
+      deadline_micros <= static_cast<int64>(start_time_usecs)) {
+    return errors::DeadlineExceeded("Run call missed its deadline by ",
+                                    start_time_usecs - deadline_micros,
+                                    " us before it started");
+  }
+
   std::unique_ptr<DebuggerStateInterface> debugger_state;
   if (!run_options.debug_options().debug_tensor_watch_opts().empty()) {
     TF_RETURN_IF_ERROR(
@@ -1076,7 +1216,24 @@ Status DirectSession::RunInternal(
                             executor_step_count, &debugger_state));
   }
 
-  run_state.rendez = new IntraProcessRendezvous(device_mgr_);
+  // Takes the objects kept by the previous step, unless another step of
+  // executors_and_keys is using them.
+  StepCache* step_cache = nullptr;
+  if (!executors_and_keys->step_cache.in_use.exchange(true)) {
+    step_cache = &executors_and_keys->step_cache;
+  }
+  auto release_step_cache = gtl::MakeCleanup([step_cache] {
+    if (step_cache != nullptr) {
+      step_cache->in_use.store(false);
+    }
+  });
+
+  if (step_cache != nullptr && step_cache->rendez != nullptr) {
+    run_state.rendez = step_cache->rendez;
+    step_cache->rendez = nullptr;
+  } else {
+    run_state.rendez = new IntraProcessRendezvous(device_mgr_);
+  }
 #ifndef __ANDROID__
   // Set up for collectives if ExecutorsAndKeys declares a key.
   if (executors_and_keys->collective_graph_key !=
@@ -1136,8 +1293,13 @@ Status DirectSession::RunInternal(
   args.collective_executor =
       (run_state.collective_executor ? run_state.collective_executor->get()
                                      : nullptr);
-  CancellationManager step_cancellation_manager;
-  args.cancellation_manager = &step_cancellation_manager;
+  std::unique_ptr<CancellationManager> step_cancellation_manager;
+  if (step_cache != nullptr && step_cache->cancellation_manager) {
+    step_cancellation_manager = std::move(step_cache->cancellation_manager);
+  } else {
+    step_cancellation_manager.reset(new CancellationManager);
+  }
+  args.cancellation_manager = step_cancellation_manager.get();
   args.session_state = &session_state_;
   args.session_handle = session_handle_;
   args.tensor_store = &run_state.tensor_store;
@@ -1152,12 +1314,26 @@ Status DirectSession::RunInternal(
     args.executor_policy = ExecutorPolicy::USE_NORMAL_EXECUTOR;
   }
 
-  args.ref_send_inputs_mu_ptr = std::make_unique<mutex>();
+  if (deadline_micros > 0) {
+    args.deadline = absl::FromUnixMicros(deadline_micros);
+  }
+
+  mutex ref_send_inputs_mu;
+  args.ref_send_inputs_mu_ptr = &ref_send_inputs_mu;
   args.ref_send_inputs_ptr = &ref_send_inputs;
   args.merge_compute_and_copy_stream = merge_compute_and_copy_stream_;
 
   const bool do_trace = (run_options.trace_level() > RunOptions::NO_TRACE);
 
+  // The contention of the embedding locks during the step, if profiled.
+  embedding::LockContention* lock_contention =
+      do_trace ? embedding::LockContention::Global() : nullptr;
+  std::vector<embedding::LockContention::Snapshot> lock_contention_before;
+  const int64 lock_contention_start_micros = options_.env->NowMicros();
+  if (lock_contention != nullptr) {
+    lock_contention_before = lock_contention->Snapshots();
+  }
+
   bool update_cost_model = false;
   if (options_.config.graph_options().build_cost_model() > 0) {
     const int64 build_cost_model_every =
@@ -1195,9 +1371,11 @@ Status DirectSession::RunInternal(
   // `Session::Close()` will cancel the step.
   const CancellationToken cancellation_token =
       cancellation_manager_->get_cancellation_token();
+  CancellationManager* step_cancellation_manager_ptr =
+      step_cancellation_manager.get();
   const bool already_cancelled = !cancellation_manager_->RegisterCallback(
-      cancellation_token, [&step_cancellation_manager]() {
-        step_cancellation_manager.StartCancel();
+      cancellation_token, [step_cancellation_manager_ptr]() {
+        step_cancellation_manager_ptr->StartCancel();
       });
   if (already_cancelled) {
     // NOTE(mrry): If we don't explicitly notify
@@ -1211,6 +1389,8 @@ Status DirectSession::RunInternal(
   // Use std::unique_ptr to ensure garbage collection
   std::unique_ptr<thread::ThreadPool> threadpool_wrapper;
   thread::ThreadPool* pool = nullptr;
+  // The index of pool in thread_pools_, or -1.
+  int pool_index = -1;
 
   if (run_in_caller_thread_) {
     pool = nullptr;
@@ -1227,6 +1407,7 @@ Status DirectSession::RunInternal(
     pool = threadpool_wrapper.get();
   } else if (run_options.inter_op_thread_pool() >= 0) {
     pool = thread_pools_[run_options.inter_op_thread_pool()].first;
+    pool_index = run_options.inter_op_thread_pool();
   }
 
   if (pool == nullptr) {
@@ -1234,6 +1415,7 @@ Status DirectSession::RunInternal(
     // specified.
     if (executors_and_keys->items.size() > 1) {
       pool = thread_pools_[0].first;
+      pool_index = 0;
     } else {
       VLOG(1) << "Executing Session::Run() synchronously!";
     }
@@ -1262,6 +1444,19 @@ Status DirectSession::RunInternal(
     default_cost_runner = [handler_ptr](Executor::Args::Closure c, int64 cost) {
       handler_ptr->ScheduleInterOpClosure(std::move(c));
     };
+  } else if (use_deadline_scheduling_ && deadline_micros > 0 &&
+             pool_index >= 0) {
+    // The ops of the runs sharing the pool go in the earliest deadline first
+    // order, the costs don't matter to the order.
+    DeadlineScheduler* scheduler = GetDeadlineScheduler(pool_index);
+    default_runner = [scheduler,
+                      deadline_micros](Executor::Args::Closure c) {
+      scheduler->Schedule(std::move(c), deadline_micros);
+    };
+    default_cost_runner = [scheduler, deadline_micros](
+                              Executor::Args::Closure c, int64 cost) {
+      scheduler->Schedule(std::move(c), deadline_micros);
+    };
   } else {
     default_runner = [this, pool](Executor::Args::Closure c) {
       pool->Schedule(std::move(c));
@@ -1297,10 +1492,16 @@ Status DirectSession::RunInternal(
     item.executor->RunAsync(args, barrier->Get());
   }
 
-  WaitForNotification(&run_state, &step_cancellation_manager,
-                      run_options.timeout_in_ms() > 0
-                          ? run_options.timeout_in_ms()
-                          : operation_timeout_in_ms_);
+  // A run which misses its deadline is cancelled, at least 1ms is waited as
+  // 0 would mean no timeout.
+  int64 wait_in_ms = 0;
+  if (deadline_micros > 0) {
+    wait_in_ms = std::max<int64>(
+        1, (deadline_micros - static_cast<int64>(options_.env->NowMicros()) +
+            999) / 1000);
+  }
+  WaitForNotification(&run_state, step_cancellation_manager.get(),
+                      wait_in_ms);
 
   if (!cancellation_manager_->DeregisterCallback(cancellation_token)) {
     // The step has been cancelled: make sure we don't attempt to receive the
@@ -1318,6 +1519,16 @@ Status DirectSession::RunInternal(
     TF_RETURN_IF_ERROR(run_state.status);
   }
 
+  if (step_cache != nullptr) {
+    if (executors_and_keys->items.size() == 1) {
+      run_state.rendez->Ref();
+      step_cache->rendez = run_state.rendez;
+    }
+    if (!step_cancellation_manager->IsCancelled()) {
+      step_cache->cancellation_manager = std::move(step_cancellation_manager);
+    }
+  }
+
   // Save the output tensors of this run we choose to keep.
   if (!run_state.tensor_store.empty()) {
     TF_RETURN_IF_ERROR(run_state.tensor_store.SaveTensors(
@@ -1329,6 +1540,11 @@ Status DirectSession::RunInternal(
   if (run_state.collector) {
     run_state.collector->Finalize();
   }
+  if (lock_contention != nullptr) {
+    lock_contention->AddStepStats(lock_contention_before,
+                                  lock_contention_start_micros,
+                                  run_metadata->mutable_step_stats());
+  }
 
   // Build and return the cost model as instructed.
   if (update_cost_model) {
@@ -1910,6 +2126,20 @@ Status DirectSession::CreateExecutors(
       options, &graphs, &func_info->flib_def, run_state_args, &ek->input_types,
       &ek->output_types, &ek->collective_graph_key));
 
+  // Only the fetches in host memory are copied into the provided tensors.
+  ek->fetch_into_provided.assign(callable_options.fetch_size(), false);
+  if (callable_options.fetch_into_provided_tensors()) {
+    for (int i = 0; i < callable_options.fetch_size(); ++i) {
+      const auto& fetch_devices = callable_options.fetch_devices();
+      auto it = fetch_devices.find(callable_options.fetch(i));
+      DeviceNameUtils::ParsedName parsed;
+      ek->fetch_into_provided[i] =
+          it == fetch_devices.end() ||
+          (DeviceNameUtils::ParseFullName(it->second, &parsed) &&
+           parsed.type == DEVICE_CPU);
+    }
+  }
+
   if (run_state_args->is_partial_run) {
     ek->graph = std::move(run_state_args->graph);
     std::unordered_set<StringPiece, StringPieceHasher> names;
@@ -2446,6 +2676,19 @@ void DirectSession::WaitForNotification(RunState* run_state,
   }
 }
 
+DeadlineScheduler* DirectSession::GetDeadlineScheduler(int i) {
+  thread::ThreadPool* pool = thread_pools_[i].first;
+  if (!thread_pools_[i].second) {
+    return DeadlineScheduler::Global(pool);
+  }
+  mutex_lock l(deadline_schedulers_mu_);
+  std::unique_ptr<DeadlineScheduler>& scheduler = deadline_schedulers_[pool];
+  if (scheduler == nullptr) {
+    scheduler.reset(new DeadlineScheduler(pool));
+  }
+  return scheduler.get();
+}
+
 ::tensorflow::Status DirectSession::WaitForNotification(
     Notification* notification, int64 timeout_in_ms) {
   if (timeout_in_ms > 0) {
@@ -2514,7 +2757,19 @@ class DirectSession::RunCallableCallFrame : public CallFrameInterface {
     if (index > fetch_tensors_->size()) {
       return errors::Internal("RetVal index out of bounds: ", index);
     }
-    (*fetch_tensors_)[index] = val;
+    Tensor* provided = &(*fetch_tensors_)[index];
+    if (executors_and_keys_->fetch_into_provided[index] &&
+        provided->IsInitialized() && provided->dtype() == val.dtype() &&
+        provided->shape() == val.shape() &&
+        DataTypeCanUseMemcpy(val.dtype()) &&
+        !provided->SharesBufferWith(val)) {
+      // The caller owns the buffer of the tensor, the value is copied into it.
+      StringPiece src = val.tensor_data();
+      std::memcpy(const_cast<char*>(provided->tensor_data().data()),
+                  src.data(), src.size());
+      return Status::OK();
+    }
+    *provided = val;
     return Status::OK();
   }
 
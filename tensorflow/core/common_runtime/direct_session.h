@@ -24,6 +24,7 @@ limitations under the License.
 #include <vector>
 
 #include "tensorflow/core/common_runtime/costmodel_manager.h"
+#include "tensorflow/core/common_runtime/deadline_scheduler.h"
 #include "tensorflow/core/common_runtime/debugger_state_interface.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
 #include "tensorflow/core/common_runtime/device_set.h"
@@ -148,6 +149,23 @@ class DirectSession : public Session {
     std::unique_ptr<Executor> executor;
   };
 
+  // The objects of a step kept for the next steps of the same
+  // ExecutorsAndKeys, so that the repeated steps of a callable don't
+  // allocate them again. They are taken by one step at a time, concurrent
+  // steps create their own.
+  struct StepCache {
+    std::atomic<bool> in_use{false};
+    // Kept after the steps of a single partition that succeeded, which leave
+    // no tensor in the rendezvous.
+    IntraProcessRendezvous* rendez = nullptr;
+    // Kept until a step is cancelled.
+    std::unique_ptr<CancellationManager> cancellation_manager;
+
+    ~StepCache() {
+      if (rendez != nullptr) rendez->Unref();
+    }
+  };
+
   // An ExecutorsAndKeys is created for a given set of feeds/fetches.
   // 'step_count' is the number of times this graph is executed.
   // 'graph' is the entire graph being executed. 'name_to_node'
@@ -173,6 +191,12 @@ class DirectSession : public Session {
 
     CallableOptions callable_options;
 
+    // Whether the fetches are copied into the tensors given to RunCallable,
+    // see CallableOptions.fetch_into_provided_tensors.
+    std::vector<bool> fetch_into_provided;
+
+    StepCache step_cache;
+
     int64 collective_graph_key = BuildGraphOptions::kNoCollectiveGraphKey;
   };
 
@@ -310,6 +334,9 @@ class DirectSession : public Session {
   void WaitForNotification(RunState* run_state, CancellationManager* cm,
                            int64 timeout_in_ms);
 
+  // Returns the earliest deadline first scheduler of thread_pools_[i].
+  DeadlineScheduler* GetDeadlineScheduler(int i);
+
   ::tensorflow::Status CheckNotClosed() {
     mutex_lock l(closed_lock_);
     if (closed_) return errors::Cancelled("Session has been closed.");
@@ -455,6 +482,16 @@ class DirectSession : public Session {
   // by set environment 'MERGE_COMPUTE_COPY_STREAM'
   bool merge_compute_and_copy_stream_ = false;
 
+  // Whether the runs with a deadline schedule their ops in the earliest
+  // deadline first order, set by environment 'TF_DEADLINE_SCHEDULING'.
+  bool use_deadline_scheduling_ = false;
+  // The schedulers of the owned thread_pools_, the pools which are not owned
+  // use the global ones. They outlive the pools, deleted by the destructor
+  // body, whose threads run the pending trampolines.
+  mutex deadline_schedulers_mu_;
+  std::unordered_map<thread::ThreadPool*, std::unique_ptr<DeadlineScheduler>>
+      deadline_schedulers_ GUARDED_BY(deadline_schedulers_mu_);
+
   TF_DISALLOW_COPY_AND_ASSIGN(DirectSession);
 
   // EXPERIMENTAL: debugger (tfdbg) related
@@ -196,6 +196,37 @@ TEST_F(DirectSessionMinusAXTest, RunSimpleNetwork_Callable) {
   }
 }
 
+TEST_F(DirectSessionMinusAXTest, RunCallableIntoProvidedTensors) {
+  Initialize({3, 2, -1, 0});
+  auto session = CreateSession();
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def_));
+
+  CallableOptions options = MakeCallableOptions({}, {y_ + ":0"}, {});
+  options.set_fetch_into_provided_tensors(true);
+  Session::CallableHandle handle;
+  TF_ASSERT_OK(session->MakeCallable(options, &handle));
+
+  // The first call fills the outputs, the next ones copy into their buffers.
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session->RunCallable(handle, {}, &outputs, nullptr));
+  ASSERT_EQ(1, outputs.size());
+  const char* buffer = outputs[0].tensor_data().data();
+  for (int i = 0; i < 3; ++i) {
+    outputs[0].matrix<float>()(0, 0) = 0;
+    TF_ASSERT_OK(session->RunCallable(handle, {}, &outputs, nullptr));
+    EXPECT_EQ(buffer, outputs[0].tensor_data().data());
+    EXPECT_FLOAT_EQ(5.0, outputs[0].matrix<float>()(0, 0));
+  }
+
+  // A tensor of another shape is replaced.
+  outputs[0] = Tensor(DT_FLOAT, TensorShape({1}));
+  TF_ASSERT_OK(session->RunCallable(handle, {}, &outputs, nullptr));
+  EXPECT_EQ(TensorShape({2, 1}), outputs[0].shape());
+  EXPECT_FLOAT_EQ(5.0, outputs[0].matrix<float>()(0, 0));
+  TF_ASSERT_OK(session->ReleaseCallable(handle));
+}
+
 TEST_F(DirectSessionMinusAXTest, RunSimpleNetwork_OptimizeForStaticGraph) {
   Initialize({3, 2, -1, 0});
   SessionOptions options(DefaultSessionOptions());
@@ -1706,6 +1737,27 @@ TEST(DirectSessionTest, TimeoutSession) {
     ASSERT_EQ(error::DEADLINE_EXCEEDED, s2.code());
     TF_ASSERT_OK(session->Close());
   }
+
+  {
+    // Creates a session with no operation_timeout_in_ms.
+    auto session = CreateSession();
+    ASSERT_TRUE(session != nullptr);
+    TF_ASSERT_OK(session->Create(graph));
+    RunOptions run_options;
+    // Verifies that a run past its deadline is dropped.
+    run_options.mutable_experimental()->set_deadline_micros(
+        Env::Default()->NowMicros() - 1);
+    Status s3 = session->Run(run_options, {}, {}, {"fifo_queue_Dequeue"},
+                             nullptr, nullptr);
+    ASSERT_EQ(error::DEADLINE_EXCEEDED, s3.code());
+    // Verifies that a run which misses its deadline is cancelled.
+    run_options.mutable_experimental()->set_deadline_micros(
+        Env::Default()->NowMicros() + 20000);
+    Status s4 = session->Run(run_options, {}, {}, {"fifo_queue_Dequeue"},
+                             nullptr, nullptr);
+    ASSERT_EQ(error::DEADLINE_EXCEEDED, s4.code());
+    TF_ASSERT_OK(session->Close());
+  }
 }
 
 // Accesses the cancellation manager for the step after the step has been
@@ -31,12 +31,14 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/graph_view.h"
 #include "tensorflow/core/common_runtime/immutable_executor_state.h"
 #include "tensorflow/core/common_runtime/kernel_stat.h"
+#include "tensorflow/core/common_runtime/op_perf_counters.h"
 #include "tensorflow/core/common_runtime/pending_counts.h"
 #include "tensorflow/core/common_runtime/propagator_state.h"
 #include "tensorflow/core/common_runtime/renamed_device.h"
 #include "tensorflow/core/common_runtime/simple_propagator_state.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
 #include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/memory_attribution.h"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/collective.h"
 #include "tensorflow/core/framework/control_flow.h"
@@ -286,7 +288,8 @@ class ExecutorState {
 
   // Process a ready node in current thread.
   void Process(TaggedNode node, int64_t scheduled_nsec);
-  void BatchProcess(std::vector<TaggedNode> nodes, int nodes_count, int64_t scheduled_nsec);
+  void BatchProcess(const TaggedNode* nodes, int nodes_count,
+                    int64_t scheduled_nsec);
 
   Status ProcessSync(const NodeItem& item, OpKernelContext::Params* params,
                      EntryVector* outputs, NodeExecStatsInterface* stats);
@@ -370,6 +373,10 @@ class ExecutorState {
   ScopedStepContainer* step_container_;
   StepStatsCollectorInterface* const stats_collector_;
   const tracing::EventCollector* const event_collector_;
+  // Not null if the hardware counters of the CPU ops are sampled.
+  OpPerfCounters* const op_perf_counters_;
+  // Not null if the memory is attributed to the ops allocating it.
+  MemoryAttribution* const memory_attribution_;
   Context context_;
 
   // QUESTION: Make it a checkpoint::TensorSliceReaderCacheWrapper
@@ -459,9 +466,8 @@ class CostExecutorState : public ExecutorState<PropagatorStateType> {
   void CostProcess(TaggedNode node, int64_t scheduled_nsec) {
     this->Process(node, scheduled_nsec);
   }
-  void CostBatchProcess(std::vector<TaggedNode> nodes,
-                        int nodes_count, int64_t scheduled_nsec) {
-    this->BatchProcess(nodes, nodes_count, scheduled_nsec);
+  void CostBatchProcess(const TaggedNodeSeq& nodes, int64_t scheduled_nsec) {
+    this->BatchProcess(nodes.data(), nodes.size(), scheduled_nsec);
   }
 };
 
@@ -492,18 +498,19 @@ class ExecutorStateFactory {
   }
 };
 
-// Sort node according cost from which ExecutorState
+// Sort node according the static schedule order of the cost model, which
+// puts the nodes of the critical path first.
 template <class PropagatorStateType>
 struct SortTaggedNode {
   typedef typename PropagatorStateType::TaggedNode TaggedNode;
 
-  SortTaggedNode(const std::vector<int64>* immutable_accumulative_cost) :
-      immutable_accumulative_cost_(immutable_accumulative_cost) {}
+  explicit SortTaggedNode(const int32* schedule_rank) :
+      schedule_rank_(schedule_rank) {}
   bool operator()(const TaggedNode& n1, const TaggedNode& n2) {
-    return (*immutable_accumulative_cost_)[n1.get_node_item().node->id()] >
-        (*immutable_accumulative_cost_)[n2.get_node_item().node->id()];
+    return schedule_rank_[n1.get_node_item().node->id()] <
+        schedule_rank_[n2.get_node_item().node->id()];
   }
-  const std::vector<int64>* immutable_accumulative_cost_;
+  const int32* schedule_rank_;
 };
 
 template <class PropagatorStateType>
@@ -536,6 +543,11 @@ ExecutorState<PropagatorStateType>::ExecutorState(
       stats_collector_(args.stats_collector),
       event_collector_(
           tracing::GetEventCollector(tracing::EventCategory::kCompute)),
+      op_perf_counters_(
+          immutable_state.params().device->device_type() == DEVICE_CPU
+              ? OpPerfCounters::Global()
+              : nullptr),
+      memory_attribution_(MemoryAttribution::Global()),
       context_(ContextKind::kThread),
       slice_reader_cache_(new checkpoint::TensorSliceReaderCacheWrapper),
       call_frame_(args.call_frame),
@@ -549,7 +561,7 @@ ExecutorState<PropagatorStateType>::ExecutorState(
       executor_policy_(args.executor_policy),
       propagator_(immutable_state, step_id_, vlog_),
       num_outstanding_ops_(0),
-      ref_send_inputs_mu_ptr_(args.ref_send_inputs_mu_ptr.get()),
+      ref_send_inputs_mu_ptr_(args.ref_send_inputs_mu_ptr),
       ref_send_inputs_ptr_(args.ref_send_inputs_ptr),
       merge_compute_and_copy_stream_(args.merge_compute_and_copy_stream) {
   // TODO: FIXME Consider function lib executor later
@@ -709,6 +721,12 @@ Status ExecutorState<PropagatorStateType>::ProcessSync(
 
   const bool is_expensive = kernel_stats_->IsExpensive(item);
 
+  OpPerfCounters::Sample perf_sample;
+  if (TF_PREDICT_FALSE(op_perf_counters_ != nullptr)) {
+    op_perf_counters_->Start(&perf_sample);
+  }
+  MemoryAttribution::ScopedOp memory_owner(memory_attribution_, op_kernel);
+
   if (TF_PREDICT_FALSE(MightTrace(item, event_collector_))) {
     const string& op_name = op_kernel->name();
     int64 id = step_id_;
@@ -743,6 +761,10 @@ Status ExecutorState<PropagatorStateType>::ProcessSync(
     device->Compute(op_kernel, &ctx);
   }
 
+  if (TF_PREDICT_FALSE(op_perf_counters_ != nullptr)) {
+    op_perf_counters_->Stop(item.node, &perf_sample);
+  }
+
   kernel_stats_->StopCollectOp(&item,
       const_cast<ExecutorInternal::KernelStatsInfo*>(&kernel_stat_buffer));
 
@@ -813,6 +835,8 @@ void ExecutorState<PropagatorStateType>::ProcessAsync(
           },
           profiler::GetTFTraceMeLevel(async_kernel->IsExpensive()));
 
+    MemoryAttribution::ScopedOp memory_owner(memory_attribution_,
+                                             async_kernel);
     immutable_state_.params().device->ComputeAsync(async_kernel, &state->ctx,
                                                    std::move(done));
   }
@@ -839,13 +863,11 @@ void ExecutorState<PropagatorStateType>::ProcessConstTensor(
 template <class PropagatorStateType>
 void ExecutorState<PropagatorStateType>::Process(
     TaggedNode tagged_node, int64_t scheduled_nsec) {
-  std::vector<TaggedNode> nodes;
-  nodes.push_back(tagged_node);
-  BatchProcess(nodes, 1, scheduled_nsec);
+  BatchProcess(&tagged_node, 1, scheduled_nsec);
 }
 
 template <class PropagatorStateType>
-void ExecutorState<PropagatorStateType>::BatchProcess(std::vector<TaggedNode> nodes,
+void ExecutorState<PropagatorStateType>::BatchProcess(const TaggedNode* nodes,
                                                       int nodes_count,
                                                       int64_t scheduled_nsec) {
   WithContext wc(context_);
@@ -971,8 +993,17 @@ void ExecutorState<PropagatorStateType>::BatchProcess(std::vector<TaggedNode> no
       // Prepares inputs.
       bool is_input_dead = false;
       std::vector<bool> is_input_dead_details;
-      s = PrepareInputs(item, first_input, &inputs, &input_alloc_attrs,
-                        &is_input_dead, &is_input_dead_details);
+      // A step which missed its deadline stops at its next op, instead of
+      // taking the threads from the steps which can still meet theirs.
+      if (TF_PREDICT_FALSE(deadline_.has_value()) &&
+          absl::Now() > *deadline_) {
+        s = errors::DeadlineExceeded("Step ", step_id_,
+                                     " missed its deadline before running ",
+                                     item.kernel->name());
+      } else {
+        s = PrepareInputs(item, first_input, &inputs, &input_alloc_attrs,
+                          &is_input_dead, &is_input_dead_details);
+      }
       if (!s.ok()) {
         // Clear inputs.
         const int num_inputs = item.num_inputs;
@@ -1640,11 +1671,13 @@ void CostExecutorState<PropagatorStateType>::CostScheduleReady(
           this->cost_model_->GetNodeCost(&(tagged_node.get_node_item())));
     }
   } else {
-    // sort ready nodes
+    // sort ready nodes in the static schedule order
     // key path priority schedule
-    std::sort(ready->begin(), ready->end(),
-        SortTaggedNode<PropagatorStateType>(
-            this->kernel_stats_->GetAccumulativeCostArray()));
+    if (ready->size() > 1) {
+      std::sort(ready->begin(), ready->end(),
+          SortTaggedNode<PropagatorStateType>(
+              this->kernel_stats_->GetScheduleRankArray()));
+    }
 
     // TODO: FIXME 50us or 100 ops
     // Use cost model here
@@ -1652,9 +1685,7 @@ void CostExecutorState<PropagatorStateType>::CostScheduleReady(
     static int max_ops_count = 100;
     int64 batch_ops_cost = 0;
     bool new_batch = false;
-    std::vector<TaggedNode> new_batch_ops;
-    new_batch_ops.resize(max_ops_count);
-    int n_new_batch_ops = 0;
+    TaggedNodeSeq new_batch_ops;
     for (auto& tagged_node : *ready) {
       const NodeItem& item = *tagged_node.node_item;
       if (tagged_node.get_is_dead() || !this->kernel_stats_->IsExpensive(item)) {
@@ -1662,18 +1693,17 @@ void CostExecutorState<PropagatorStateType>::CostScheduleReady(
         if (!new_batch) {
           inline_ready->push_back(tagged_node);
         } else {
-          new_batch_ops[n_new_batch_ops] = tagged_node;
-          n_new_batch_ops++;
+          new_batch_ops.push_back(tagged_node);
         }
         batch_ops_cost += this->cost_model_->GetNodeCost(&item);
-        if (batch_ops_cost > quota || n_new_batch_ops == max_ops_count) {
+        if (batch_ops_cost > quota || new_batch_ops.size() == max_ops_count) {
           new_batch = true;
-          if (n_new_batch_ops > 0) {
+          if (!new_batch_ops.empty()) {
             CostRunTask(
                 std::bind(&CostExecutorState<PropagatorStateType>::CostBatchProcess,
-                          this, new_batch_ops, n_new_batch_ops, scheduled_nsec),
+                          this, std::move(new_batch_ops), scheduled_nsec),
                 batch_ops_cost);
-            n_new_batch_ops = 0;
+            new_batch_ops.clear();
           }
           batch_ops_cost = 0;
         }
@@ -1703,10 +1733,10 @@ void CostExecutorState<PropagatorStateType>::CostScheduleReady(
         }
       }
     }
-    if (n_new_batch_ops > 0) {
+    if (!new_batch_ops.empty()) {
       CostRunTask(
           std::bind(&CostExecutorState<PropagatorStateType>::CostBatchProcess,
-                    this, new_batch_ops, n_new_batch_ops, scheduled_nsec),
+                    this, std::move(new_batch_ops), scheduled_nsec),
           batch_ops_cost);
     }
   }
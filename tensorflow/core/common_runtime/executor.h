@@ -124,7 +124,7 @@ class Executor {
 
     // store refs to cpu tensors that will be sent to gpu,
     // and release them when the session run finishes.
-    std::unique_ptr<mutex> ref_send_inputs_mu_ptr;
+    mutex* ref_send_inputs_mu_ptr = nullptr;
     std::vector<std::unique_ptr<TensorReference>>* ref_send_inputs_ptr = nullptr;
     bool merge_compute_and_copy_stream = false;
   };
@@ -207,7 +207,9 @@ class ExecutorBarrier {
   // Returns a closure that Executors must call when they are done
   // computing, passing the status of their execution as an argument.
   StatusCallback Get() {
-    return std::bind(&ExecutorBarrier::WhenDone, this, std::placeholders::_1);
+    // A lambda rather than std::bind, small enough for the inline storage of
+    // the std::function.
+    return [this](const Status& s) { WhenDone(s); };
   }
 
  private:
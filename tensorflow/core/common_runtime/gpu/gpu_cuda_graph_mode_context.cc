@@ -15,6 +15,7 @@ limitations under the License.
 #if GOOGLE_CUDA
 #include "tensorflow/core/common_runtime/gpu/gpu_cuda_graph_mode_context.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <mutex>  // NOLINT
@@ -29,6 +30,26 @@ limitations under the License.
 
 namespace tensorflow {
 
+namespace {
+Status SetIndexValue(Tensor* t, int64 i, int64 value) {
+  if (t->dtype() == DT_INT64) {
+    t->flat<int64>()(i) = value;
+  } else if (t->dtype() == DT_INT32) {
+    t->flat<int32>()(i) = static_cast<int32>(value);
+  } else {
+    return errors::InvalidArgument("indices and dense shape of sparse inputs "
+                                   "should be int32 or int64, got ",
+                                   DataTypeString(t->dtype()));
+  }
+  return Status::OK();
+}
+
+int64 DenseShapeBatchSize(const Tensor& dense_shape) {
+  return dense_shape.dtype() == DT_INT32 ? dense_shape.flat<int32>()(0)
+                                         : dense_shape.flat<int64>()(0);
+}
+}  // namespace
+
 CudaGraphModeContext::CudaGraphModeContext() {}
 CudaGraphModeContext::~CudaGraphModeContext() {
   if (!ctx_cleaned_) {
@@ -92,8 +113,38 @@ Status CudaGraphModeContext::InitDevices(const DeviceMgr* device_mgr,
   return Status::OK();
 }
 
+Status CudaGraphModeContext::InitSparseInputs(
+    const protobuf::RepeatedPtrField<CudaGraphSparseInput>& sparse_inputs) {
+  padded_inputs_.clear();
+  for (int i = 0; i < sparse_inputs.size(); ++i) {
+    const CudaGraphSparseInput& input = sparse_inputs.Get(i);
+    if (input.values().empty() || input.max_ids_num() <= 0) {
+      return errors::InvalidArgument(
+          "sparse input ", i, " needs values and a positive max_ids_num");
+    }
+    const std::pair<const std::string*, PaddedInputType> names[] = {
+        {&input.values(), kValues},
+        {&input.indices(), kIndices},
+        {&input.weights(), kWeights},
+        {&input.dense_shape(), kDenseShape}};
+    for (auto& name : names) {
+      if (name.first->empty()) continue;
+      PaddedInput padded = {name.second, i, input.max_ids_num()};
+      if (!padded_inputs_.emplace(*name.first, padded).second) {
+        return errors::InvalidArgument("input ", *name.first,
+                                       " belongs to several sparse inputs");
+      }
+    }
+  }
+  return Status::OK();
+}
+
 Status CudaGraphModeContext::InitInputTensors(const GraphDef& graph_def,
                                               const int batch_size) {
+  batch_size_ = batch_size;
+  // The padded ids of sparse inputs are assigned to an extra row of the
+  // captured batch, which is sliced off the outputs.
+  capture_batch_size_ = padded_inputs_.empty() ? batch_size : batch_size + 1;
   for (auto& node : graph_def.node()) {
     if (node.op() == "Placeholder") {
       PartialTensorShape shape = node.attr().at("shape").shape();
@@ -117,8 +168,20 @@ Status CudaGraphModeContext::InitInputTensors(const GraphDef& graph_def,
   for (auto& it : inputs_from_def_) {
     auto dtype = it.second.second;
     TensorShape new_shape;
-    if (it.second.first.dim_size(0) < 0) {
-      it.second.first.set_dim(0, batch_size);
+    auto padded = padded_inputs_.find(it.first);
+    if (padded != padded_inputs_.end()) {
+      if (it.second.first.dims() < 1 ||
+          (padded->second.type == kDenseShape &&
+           it.second.first.dim_size(0) < 0)) {
+        return errors::Internal("sparse input ", it.first,
+                                " needs a known rank in CUDA Graph");
+      }
+      if (padded->second.type != kDenseShape) {
+        it.second.first.set_dim(0, padded->second.max_ids_num);
+      }
+    } else if (it.second.first.dim_size(0) < 0) {
+      it.second.first.set_dim(0, capture_batch_size_);
+      batch_inputs_.insert(it.first);
     }
     if (!it.second.first.AsTensorShape(&new_shape)) {
       return errors::Internal("part shape convert to tensor shape failed.");
@@ -134,6 +197,41 @@ Status CudaGraphModeContext::InitInputTensors(const GraphDef& graph_def,
                               " does not own an allocator");
     }
   }
+  return InitPaddingTensors();
+}
+
+Status CudaGraphModeContext::InitPaddingTensors() {
+  padding_tensors_.clear();
+  for (auto& it : padded_inputs_) {
+    auto idx_itr = inputs_from_def_idx_.find(it.first);
+    if (idx_itr == inputs_from_def_idx_.end()) {
+      return errors::Internal("can not find sparse input: ", it.first);
+    }
+    Tensor& input = input_tensors_[idx_itr->second];
+    Tensor padding(host_allocator_, input.dtype(), input.shape());
+    std::memset(padding.data(), 0, padding.TotalBytes());
+    if (it.second.type == kIndices) {
+      const int64 stride =
+          std::max<int64>(1, input.NumElements() / it.second.max_ids_num);
+      for (int64 i = 0; i < input.NumElements(); i += stride) {
+        TF_RETURN_IF_ERROR(
+            SetIndexValue(&padding, i, capture_batch_size_ - 1));
+      }
+    } else if (it.second.type == kDenseShape) {
+      for (int64 i = 0; i < input.NumElements(); ++i) {
+        TF_RETURN_IF_ERROR(SetIndexValue(
+            &padding, i, i == 0 ? capture_batch_size_ : it.second.max_ids_num));
+      }
+    }
+    // The captured graph starts with padded ids only, the dense shape of
+    // the captured sparse input is never fed.
+    TF_CHECK_CUDA_CALL(cudaMemcpy(input.data(), padding.data(),
+                                  padding.TotalBytes(), cudaMemcpyDefault),
+                       "copy padding of sparse input failed");
+    if (it.second.type != kDenseShape) {
+      padding_tensors_[it.first] = padding;
+    }
+  }
   return Status::OK();
 }
 
@@ -232,8 +330,8 @@ Status CudaGraphModeContext::CaptureCudaGraph(Session* sess) {
     cublas_workspace_ = workspace;
     // TODO: provide set blas workspace
     // tf_stream_->SetBlasWorkspace(workspace, num_bytes);
-    tf_stream_->parent()->AsBlas()->SetWorkspace(tf_stream_, workspace,
-                                                 num_bytes);
+    cublas_workspace_size_ = num_bytes;
+    ResetBlasWorkspace();
     VLOG(2) << "cuda graph capture : set workspace for cublas";
 
     // start capturing cuda graph on stream
@@ -271,6 +369,33 @@ Status CudaGraphModeContext::CaptureCudaGraph(Session* sess) {
   return Status::OK();
 }
 
+void CudaGraphModeContext::ResetBlasWorkspace() {
+  if (cublas_workspace_) {
+    tf_stream_->parent()->AsBlas()->SetWorkspace(tf_stream_, cublas_workspace_,
+                                                 cublas_workspace_size_);
+  }
+}
+
+Status CudaGraphModeContext::GetFedBatchSize(
+    const std::vector<std::pair<string, Tensor> >& inputs,
+    int* fed_batch_size) {
+  for (auto& input : inputs) {
+    const Tensor& t = input.second;
+    if (batch_inputs_.count(input.first) > 0 && t.dims() > 0) {
+      *fed_batch_size = t.dim_size(0);
+      return Status::OK();
+    }
+    auto padded = padded_inputs_.find(input.first);
+    if (padded != padded_inputs_.end() &&
+        padded->second.type == kDenseShape && t.NumElements() > 0 &&
+        !IsTensorOnDevice(&t)) {
+      *fed_batch_size = DenseShapeBatchSize(t);
+      return Status::OK();
+    }
+  }
+  return errors::NotFound("no input gives the batch size");
+}
+
 bool CudaGraphModeContext::IsTensorOnDevice(const Tensor* t) {
   if (t->TotalBytes() == 0) return false;
   cudaPointerAttributes attributes;
@@ -298,6 +423,26 @@ Status CudaGraphModeContext::SyncData(const Tensor* from, Tensor* to,
   return Status::OK();
 }
 
+Status CudaGraphModeContext::SyncPaddedData(const std::string& name,
+                                            const Tensor* from, Tensor* to,
+                                            cudaStream_t stream) {
+  auto padding_itr = padding_tensors_.find(name);
+  if (padding_itr == padding_tensors_.end()) {
+    // Only the batch size is read from the dense shape.
+    return Status::OK();
+  }
+  TF_RETURN_IF_ERROR(SyncData(from, to, from->TotalBytes(), stream));
+  const size_t offset = from->TotalBytes();
+  if (offset < to->TotalBytes()) {
+    TF_CHECK_CUDA_CALL(
+        cudaMemcpyAsync(static_cast<char*>(to->data()) + offset,
+                        static_cast<char*>(padding_itr->second.data()) + offset,
+                        to->TotalBytes() - offset, cudaMemcpyDefault, stream),
+        "async copy padding failed");
+  }
+  return Status::OK();
+}
+
 Status CudaGraphModeContext::CheckShape(const PartialTensorShape& fromShape,
                                         const TensorShape& toShape) {
   if (fromShape.dims() != toShape.dims()) {
@@ -315,8 +460,24 @@ Status CudaGraphModeContext::CheckShape(const PartialTensorShape& fromShape,
 }
 
 Status CudaGraphModeContext::CheckInputsInfo(
-    const std::vector<std::pair<string, Tensor> >& inputs) {
+    const std::vector<std::pair<string, Tensor> >& inputs,
+    int* fed_batch_size) {
   std::vector<bool> visited(inputs_from_def_idx_.size(), false);
+  std::map<int, int64> ids_nums;
+  *fed_batch_size = -1;
+  auto update_batch_size = [this, fed_batch_size](const std::string& name,
+                                                  int64 batch_size) -> Status {
+    if (batch_size < 0 || batch_size > batch_size_) {
+      return errors::Internal("batch size ", batch_size, " of ", name,
+                              " is out of captured batch size ", batch_size_);
+    }
+    if (*fed_batch_size >= 0 && *fed_batch_size != batch_size) {
+      return errors::Internal("batch size of ", name,
+                              " not consist with other inputs");
+    }
+    *fed_batch_size = batch_size;
+    return Status::OK();
+  };
   for (auto& input : inputs) {
     const Tensor& input_tensor = input.second;
     auto input_info_itr = inputs_from_def_.find(input.first);
@@ -333,14 +494,46 @@ Status CudaGraphModeContext::CheckInputsInfo(
       return errors::Internal("data type mismatch for ", input.first);
     }
     const PartialTensorShape& capture_shape = input_info_itr->second.first;
-    TF_RETURN_IF_ERROR(CheckShape(capture_shape, input_tensor.shape()));
-    int capture_dim_0 = capture_shape.dim_size(0);
-    int input_dim_0 = input_tensor.shape().dim_size(0);
-    if (input_dim_0 < 0) {
-      return errors::Internal("input dim 0 size < 0");
+    const TensorShape& input_shape = input_tensor.shape();
+    auto padded = padded_inputs_.find(input.first);
+    const bool is_batch = batch_inputs_.count(input.first) > 0;
+    if (padded != padded_inputs_.end() &&
+        padded->second.type == kDenseShape) {
+      TF_RETURN_IF_ERROR(CheckShape(capture_shape, input_shape));
+      if (input_tensor.NumElements() == 0 || IsTensorOnDevice(&input_tensor)) {
+        return errors::Internal("dense shape ", input.first,
+                                " should be fed in host memory");
+      }
+      TF_RETURN_IF_ERROR(
+          update_batch_size(input.first, DenseShapeBatchSize(input_tensor)));
+      continue;
+    }
+    // The first dim of batch and padded inputs may be less than captured.
+    PartialTensorShape expected_shape = capture_shape;
+    if ((is_batch || padded != padded_inputs_.end()) &&
+        input_shape.dims() == capture_shape.dims()) {
+      expected_shape.set_dim(0, input_shape.dim_size(0));
+    }
+    TF_RETURN_IF_ERROR(CheckShape(expected_shape, input_shape));
+    if (input_shape.dims() == 0) {
+      continue;
     }
-    if (capture_dim_0 > 0 && input_dim_0 != capture_dim_0) {
-      return errors::Internal("capture dim 0 not consist with input");
+    int64 capture_dim_0 = capture_shape.dim_size(0);
+    int64 input_dim_0 = input_shape.dim_size(0);
+    if (input_dim_0 > capture_dim_0) {
+      return errors::Internal("input dim 0 of ", input.first, " is ",
+                              input_dim_0, " larger than captured ",
+                              capture_dim_0);
+    }
+    if (is_batch) {
+      TF_RETURN_IF_ERROR(update_batch_size(input.first, input_dim_0));
+    } else if (padded != padded_inputs_.end()) {
+      auto ids_num =
+          ids_nums.emplace(padded->second.sparse_input, input_dim_0).first;
+      if (ids_num->second != input_dim_0) {
+        return errors::Internal("ids num of ", input.first,
+                                " not consist with its sparse input");
+      }
     }
   }
   for (size_t i = 0; i < visited.size(); ++i) {
@@ -348,6 +541,9 @@ Status CudaGraphModeContext::CheckInputsInfo(
       return errors::Internal("lack inputs num:", i);
     }
   }
+  if (*fed_batch_size < 0) {
+    *fed_batch_size = capture_batch_size_;
+  }
   return Status::OK();
 }
 
@@ -396,7 +592,8 @@ Status CudaGraphModeContext::RunCudaGraph(
     std::vector<Tensor>* outputs) {
   TF_CHECK_CUDA_CALL(cudaStreamSynchronize(stream_),
                      "synchronize capturing stream before run failed");
-  TF_RETURN_IF_ERROR(CheckInputsInfo(inputs));
+  int fed_batch_size = 0;
+  TF_RETURN_IF_ERROR(CheckInputsInfo(inputs, &fed_batch_size));
   // copy and validate data from inputs to cuda graph's inputs
   for (auto& input : inputs) {
     Tensor t = input.second;
@@ -407,7 +604,13 @@ Status CudaGraphModeContext::RunCudaGraph(
       assert(it->second < input_tensors_.size());
       Tensor dst = input_tensors_[it->second];
       auto num_bytes = dst.TotalBytes();
-      TF_RETURN_IF_ERROR(SyncData(&t, &dst, t.TotalBytes(), compute_stream_));
+      if (padded_inputs_.count(input.first) > 0) {
+        TF_RETURN_IF_ERROR(
+            SyncPaddedData(input.first, &t, &dst, compute_stream_));
+      } else {
+        TF_RETURN_IF_ERROR(
+            SyncData(&t, &dst, t.TotalBytes(), compute_stream_));
+      }
     }
   }
   TF_CHECK_CUDA_CALL(cudaStreamSynchronize(compute_stream_),
@@ -423,6 +626,11 @@ Status CudaGraphModeContext::RunCudaGraph(
     }
     assert(it->second < output_tensors_.size());
     Tensor cuda_output = output_tensors_[it->second];
+    // The rows of the padded batch are sliced off the batch outputs.
+    if (fed_batch_size < capture_batch_size_ && cuda_output.dims() > 0 &&
+        cuda_output.dim_size(0) == capture_batch_size_) {
+      cuda_output = cuda_output.Slice(0, fed_batch_size);
+    }
     outputs->emplace_back(cuda_output);
   }
   TF_CHECK_CUDA_CALL(cudaStreamSynchronize(compute_stream_),
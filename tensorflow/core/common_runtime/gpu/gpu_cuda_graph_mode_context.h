@@ -27,6 +27,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/gpu/gpu_cuda_graph_bfc_allocator.h"
 #include "tensorflow/core/common_runtime/gpu/gpu_device.h"
 #include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/protobuf/config.pb.h"
 #include "tensorflow/core/public/session.h"
 
 #define TF_CHECK_CUDA_CALL(x, error_msg)                                       \
@@ -60,6 +61,8 @@ class CudaGraphModeContext {
   Status Run();
   Status InitDevices(const DeviceMgr* device_mgr, Session* sess);
   Status InitCallableOptions();
+  Status InitSparseInputs(
+      const protobuf::RepeatedPtrField<CudaGraphSparseInput>& sparse_inputs);
   Status InitInputTensors(const GraphDef& graph_def, const int batch_size);
   Status InitOutputTensors(const GraphDef& graph_def,
                            const std::vector<std::string>& output_names);
@@ -72,6 +75,12 @@ class CudaGraphModeContext {
   Status RunTFGraph(const std::vector<std::pair<string, Tensor>>& inputs,
                     const std::vector<std::string>& output_node_names,
                     std::vector<Tensor>* outputs, Session* sess);
+  // Batch size of the inputs, from the first batch input or dense shape.
+  Status GetFedBatchSize(const std::vector<std::pair<string, Tensor>>& inputs,
+                         int* fed_batch_size);
+  // Sets the cuBLAS workspace of the capture back to the stream, after
+  // another context captured with its own.
+  void ResetBlasWorkspace();
 
   CudaGraphGPUBFCAllocator* device_allocator() { return device_allocator_; }
   Allocator* host_allocator() { return host_allocator_; }
@@ -83,6 +92,7 @@ class CudaGraphModeContext {
   bool enable_fallback() { return enable_fallback_; }
   void disable_fallback() { enable_fallback_ = false; }
   bool has_invalid_graph() { return has_invalid_graph_; }
+  int batch_size() { return batch_size_; }
 
  private:
   bool IsTensorOnDevice(const Tensor* t);
@@ -90,10 +100,23 @@ class CudaGraphModeContext {
                   cudaStream_t stream);
   Status CheckShape(const PartialTensorShape& fromShape,
                     const TensorShape& toShape);
-  Status CheckInputsInfo(const std::vector<std::pair<string, Tensor>>& inputs);
+  Status CheckInputsInfo(const std::vector<std::pair<string, Tensor>>& inputs,
+                         int* fed_batch_size);
   Status InitCallableInputs(
       const std::vector<std::pair<string, Tensor>>& inputs,
       std::vector<Tensor>& callable_inputs);
+  Status InitPaddingTensors();
+  Status SyncPaddedData(const std::string& name, const Tensor* from, Tensor* to,
+                        cudaStream_t stream);
+
+  // Role of an input of a SparseTensor in the padded buffers.
+  enum PaddedInputType { kValues, kIndices, kWeights, kDenseShape };
+  struct PaddedInput {
+    PaddedInputType type;
+    // Index of the SparseTensor in the sparse inputs.
+    int sparse_input;
+    int max_ids_num;
+  };
 
   cudaGraph_t cuda_graph_;
   cudaGraphExec_t cuda_graph_exec_;
@@ -104,6 +127,15 @@ class CudaGraphModeContext {
       inputs_from_def_;
   std::map<std::string, int> inputs_from_def_idx_;
   std::map<std::string, int> outputs_idx_;
+  // Inputs whose first dim is the batch size, they are captured with
+  // capture_batch_size_ rows and fed with batch_size_ rows at most.
+  std::unordered_set<std::string> batch_inputs_;
+  std::map<std::string, PaddedInput> padded_inputs_;
+  // Pinned ids, indices and weights copied after the fed ones into the
+  // padded buffers.
+  std::map<std::string, Tensor> padding_tensors_;
+  int batch_size_ = 0;
+  int capture_batch_size_ = 0;
 
   std::vector<std::string> input_node_names_;
   std::map<std::string, std::string> input_node_devices_;
@@ -127,6 +159,7 @@ class CudaGraphModeContext {
   bool enable_fallback_ = true;
   bool has_invalid_graph_ = false;
   void* cublas_workspace_ = nullptr;
+  int cublas_workspace_size_ = 0;
 };
 }  // namespace tensorflow
 #endif  // TENSORFLOW_CORE_FRAMEWORK_GPU_CUDA_GRAPH_MODE_CONTEXT_H_
@@ -16,6 +16,8 @@ limitations under the License.
 #if GOOGLE_CUDA
 #include "tensorflow/core/common_runtime/gpu/gpu_cuda_graph_mode_session.h"
 
+#include <algorithm>
+
 namespace tensorflow {
 
 typedef std::vector<std::pair<string, Tensor>> NamedTensorList;
@@ -77,6 +79,14 @@ CudaGraphModeSession::CudaGraphModeSession(const SessionOptions& options,
     : device_mgr_(device_mgr), factory_(factory) {
   batch_size_ = options.config.cuda_graph_mode_options().batch_size();
   allow_fallback_ = options.config.cuda_graph_mode_options().allow_fallback();
+  sparse_inputs_ = options.config.cuda_graph_mode_options().sparse_inputs();
+  if (options.config.cuda_graph_mode_options().power_of_two_batch_buckets()) {
+    for (int bucket = 1; bucket < batch_size_; bucket *= 2) {
+      buckets_.push_back(bucket);
+    }
+  }
+  bucket_memory_budget_ =
+      options.config.cuda_graph_mode_options().bucket_memory_budget();
   output_names_ = std::vector<std::string>(
       options.config.cuda_graph_mode_options().output_names().begin(),
       options.config.cuda_graph_mode_options().output_names().end());
@@ -87,15 +97,36 @@ CudaGraphModeSession::CudaGraphModeSession(const SessionOptions& options,
   assert(session_);
 }
 
+void CudaGraphModeSession::ReleaseContext(CudaGraphModeContext* ctx) {
+  if (ctx->sess_feed_and_fetch()) {
+    session_->ReleaseCallable(ctx->sess_feed_and_fetch());
+    ctx->reset_sess_feed_and_fetch();
+  }
+  ctx->Clean();
+}
+
 void CudaGraphModeSession::Clean() {
-  if (ctx_.sess_feed_and_fetch()) {
-    session_->ReleaseCallable(ctx_.sess_feed_and_fetch());
-    ctx_.reset_sess_feed_and_fetch();
+  {
+    mutex_lock l(capture_mu_);
+    for (auto& it : bucket_graphs_) {
+      ReleaseContext(it.second.ctx.get());
+    }
+    bucket_graphs_.clear();
+    bucket_bytes_ = 0;
+  }
+  {
+    mutex_lock l(cache_mu_);
+    lru_.clear();
   }
-  ctx_.Clean();
+  ReleaseContext(&ctx_);
   session_cleaned_ = true;
 }
 
+CudaGraphCacheStats CudaGraphModeSession::GetCacheStats() {
+  mutex_lock l(cache_mu_);
+  return cache_stats_;
+}
+
 Status CudaGraphModeSession::Close() {
   session_->Close();
   {
@@ -104,6 +135,14 @@ Status CudaGraphModeSession::Close() {
     closed_ = true;
   }
   if (factory_ != nullptr) factory_->Deregister(this);
+  if (!buckets_.empty()) {
+    CudaGraphCacheStats stats = GetCacheStats();
+    LOG(INFO) << "CUDA Graph mode cache hits: " << stats.hits
+              << ", misses: " << stats.misses
+              << ", evictions: " << stats.evictions
+              << ", padded rows: " << stats.padded_rows << " of "
+              << stats.fed_rows + stats.padded_rows;
+  }
   if (!session_cleaned_) {
     Clean();
   }
@@ -121,6 +160,7 @@ CudaGraphModeSession::~CudaGraphModeSession() {
 
 Status CudaGraphModeSession::Create(const GraphDef& graph) {
   TF_RETURN_IF_ERROR(ctx_.InitDevices(device_mgr_.get(), session_.get()));
+  TF_RETURN_IF_ERROR(ctx_.InitSparseInputs(sparse_inputs_));
   TF_RETURN_IF_ERROR(ctx_.InitInputTensors(graph, batch_size_));
   TF_RETURN_IF_ERROR(ctx_.InitOutputTensors(graph, output_names_));
   TF_RETURN_IF_ERROR(ctx_.BuildGraph(graph, session_.get()));
@@ -133,9 +173,100 @@ Status CudaGraphModeSession::Create(const GraphDef& graph) {
   if (!allow_fallback_) {
     ctx_.disable_fallback();
   }
+  if (!buckets_.empty()) {
+    io_graph_def_.Clear();
+    for (auto& node : graph.node()) {
+      if (node.op() == "Placeholder" ||
+          std::find(output_names_.begin(), output_names_.end(), node.name()) !=
+              output_names_.end()) {
+        *io_graph_def_.add_node() = node;
+      }
+    }
+  }
+  return Status::OK();
+}
+
+int CudaGraphModeSession::BucketOf(int batch_size) {
+  if (batch_size > batch_size_) {
+    return -1;
+  }
+  auto it = std::lower_bound(buckets_.begin(), buckets_.end(), batch_size);
+  return it == buckets_.end() ? batch_size_ : *it;
+}
+
+Status CudaGraphModeSession::InitContext(CudaGraphModeContext* ctx,
+                                         int batch_size) {
+  TF_RETURN_IF_ERROR(ctx->InitDevices(device_mgr_.get(), session_.get()));
+  TF_RETURN_IF_ERROR(ctx->InitSparseInputs(sparse_inputs_));
+  TF_RETURN_IF_ERROR(ctx->InitInputTensors(io_graph_def_, batch_size));
+  TF_RETURN_IF_ERROR(ctx->InitOutputTensors(io_graph_def_, output_names_));
+  TF_RETURN_IF_ERROR(ctx->InitCallableOptions());
+  TF_RETURN_IF_ERROR(ctx->MakeCallable(session_.get()));
+  TF_RETURN_IF_ERROR(ctx->CaptureCudaGraph(session_.get()));
+  if (!allow_fallback_) {
+    ctx->disable_fallback();
+  }
   return Status::OK();
 }
 
+Status CudaGraphModeSession::CaptureBucket(int bucket) {
+  mutex_lock l(capture_mu_);
+  if (bucket_graphs_.count(bucket) > 0) {
+    return Status::OK();
+  }
+  auto stats = ctx_.device_allocator()->GetStats();
+  const int64 bytes_in_use = stats ? stats->bytes_in_use : 0;
+  std::unique_ptr<CudaGraphModeContext> ctx(new CudaGraphModeContext());
+  Status s = InitContext(ctx.get(), bucket);
+  // Captures of the buckets set their own cuBLAS workspaces, which are
+  // freed with them.
+  ctx_.ResetBlasWorkspace();
+  if (!s.ok()) {
+    ReleaseContext(ctx.get());
+    return s;
+  }
+  stats = ctx_.device_allocator()->GetStats();
+  const int64 bytes =
+      stats ? std::max<int64>(0, stats->bytes_in_use - bytes_in_use) : 0;
+  VLOG(1) << "CUDA Graph mode captured batch size " << bucket << " with "
+          << bytes << " bytes";
+  bucket_graphs_[bucket] = {std::move(ctx), bytes};
+  bucket_bytes_ += bytes;
+
+  mutex_lock cache_lock(cache_mu_);
+  lru_.push_front(bucket);
+  while (bucket_memory_budget_ > 0 && bucket_bytes_ > bucket_memory_budget_ &&
+         lru_.size() > 1) {
+    auto victim = bucket_graphs_.find(lru_.back());
+    lru_.pop_back();
+    ReleaseContext(victim->second.ctx.get());
+    bucket_bytes_ -= victim->second.bytes;
+    bucket_graphs_.erase(victim);
+    ++cache_stats_.evictions;
+  }
+  return Status::OK();
+}
+
+void CudaGraphModeSession::RecordRun(int bucket, bool hit, int fed_batch_size,
+                                     int batch_size) {
+  mutex_lock l(cache_mu_);
+  if (hit) {
+    ++cache_stats_.hits;
+  } else {
+    ++cache_stats_.misses;
+  }
+  if (bucket > 0) {
+    cache_stats_.fed_rows += fed_batch_size;
+    cache_stats_.padded_rows += batch_size - fed_batch_size;
+  }
+  if (bucket > 0 && bucket != batch_size_) {
+    auto it = std::find(lru_.begin(), lru_.end(), bucket);
+    if (it != lru_.end()) {
+      lru_.splice(lru_.begin(), lru_, it);
+    }
+  }
+}
+
 Status CudaGraphModeSession::Run(const ::tensorflow::RunOptions& run_options,
                              const NamedTensorList& inputs,
                              const std::vector<string>& output_names,
@@ -155,7 +286,37 @@ Status CudaGraphModeSession::Run(const NamedTensorList& inputs,
     VLOG(2) << "Run TF graph instead of graph mode";
     return ctx_.RunTFGraph(inputs, output_names, outputs, session_.get());
   }
-  Status s = ctx_.RunCudaGraph(inputs, output_names, outputs);
+  int fed_batch_size = batch_size_;
+  int bucket = batch_size_;
+  if (ctx_.GetFedBatchSize(inputs, &fed_batch_size).ok()) {
+    bucket = BucketOf(fed_batch_size);
+  }
+  bool hit = bucket > 0;
+  if (bucket > 0 && bucket != batch_size_) {
+    {
+      tf_shared_lock l(capture_mu_);
+      hit = bucket_graphs_.count(bucket) > 0;
+    }
+    if (!hit) {
+      Status s = CaptureBucket(bucket);
+      if (!s.ok()) {
+        VLOG(2) << "CUDA Graph mode capture of batch size " << bucket
+                << " failed: " << s.ToString();
+      }
+    }
+  }
+
+  tf_shared_lock l(capture_mu_);
+  CudaGraphModeContext* ctx = &ctx_;
+  auto it = bucket_graphs_.find(bucket);
+  if (it != bucket_graphs_.end()) {
+    ctx = it->second.ctx.get();
+  } else if (bucket != batch_size_) {
+    // Not captured, or released by another run, padded to batch_size_.
+    bucket = bucket > 0 ? batch_size_ : bucket;
+  }
+  RecordRun(bucket, hit, fed_batch_size, ctx->batch_size());
+  Status s = ctx->RunCudaGraph(inputs, output_names, outputs);
   if (!s.ok()) {
     // fallback to normal run
     if (ctx_.enable_fallback()) {
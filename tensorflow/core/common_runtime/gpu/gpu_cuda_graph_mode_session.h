@@ -20,6 +20,9 @@ limitations under the License.
 #include <cuda_runtime.h>
 #include <atomic>
 #include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <stack>
 #include <unordered_set>
@@ -37,6 +40,17 @@ namespace tensorflow {
 
 class CudaGraphModeSessionFactory;
 
+struct CudaGraphCacheStats {
+  // Runs of a captured graph.
+  int64 hits = 0;
+  // Runs which captured a graph first, or found no graph of their batch size.
+  int64 misses = 0;
+  int64 evictions = 0;
+  // Rows fed to the captured graphs and rows padded to their batch sizes.
+  int64 fed_rows = 0;
+  int64 padded_rows = 0;
+};
+
 class CudaGraphModeSession : public Session {
  public:
   typedef std::vector<std::pair<string, Tensor>> NamedTensorList;
@@ -78,10 +92,40 @@ class CudaGraphModeSession : public Session {
   }
 
   DirectSession* session() { return session_.get(); }
-  void DisableFallBack() { ctx_.disable_fallback(); }
+  void DisableFallBack() {
+    allow_fallback_ = false;
+    ctx_.disable_fallback();
+  }
+  CudaGraphCacheStats GetCacheStats();
 
  private:
+  struct BucketGraph {
+    std::unique_ptr<CudaGraphModeContext> ctx;
+    int64 bytes;
+  };
+
+  // The captured batch size of a run, -1 when no graph can take it.
+  int BucketOf(int batch_size);
+  Status InitContext(CudaGraphModeContext* ctx, int batch_size);
+  void ReleaseContext(CudaGraphModeContext* ctx);
+  Status CaptureBucket(int bucket);
+  void RecordRun(int bucket, bool hit, int fed_batch_size, int batch_size);
+
+  // Context of the graph captured with batch_size_, never released.
   CudaGraphModeContext ctx_;
+  // Placeholders and outputs of the graph, to capture the buckets.
+  GraphDef io_graph_def_;
+  // Batch sizes below batch_size_ captured on first use, in ascending order.
+  std::vector<int> buckets_;
+  int64 bucket_memory_budget_ = 0;
+  // Shared by the runs, exclusive while a bucket is captured or released.
+  mutex capture_mu_;
+  std::map<int, BucketGraph> bucket_graphs_ GUARDED_BY(capture_mu_);
+  int64 bucket_bytes_ GUARDED_BY(capture_mu_) = 0;
+  mutex cache_mu_;
+  // Captured buckets from the most recently used one.
+  std::list<int> lru_ GUARDED_BY(cache_mu_);
+  CudaGraphCacheStats cache_stats_ GUARDED_BY(cache_mu_);
   std::unique_ptr<DirectSession> session_;
   const std::unique_ptr<const DeviceMgr> device_mgr_;
   bool session_cleaned_ = false;
@@ -90,6 +134,7 @@ class CudaGraphModeSession : public Session {
   int batch_size_;
   bool allow_fallback_;
   std::vector<std::string> output_names_;
+  protobuf::RepeatedPtrField<CudaGraphSparseInput> sparse_inputs_;
   CudaGraphModeSessionFactory* const factory_;  // not owned
 };
 }  // namespace tensorflow
@@ -228,6 +228,58 @@ versions {
   return graph_def;
 }
 
+// y = tf.math.unsorted_segment_sum(x, ids, 4)
+GraphDef CreateGraphForSparseSegmentSum() {
+  GraphDef graph_def;
+  const char* text_proto = R"EOF(
+node {
+  name: "x"
+  op: "Placeholder"
+  device: "/device:GPU:0"
+  attr { key: "dtype" value { type: DT_FLOAT } }
+  attr { key: "shape" value { shape { dim { size: -1 } } } }
+}
+node {
+  name: "ids"
+  op: "Placeholder"
+  device: "/device:GPU:0"
+  attr { key: "dtype" value { type: DT_INT64 } }
+  attr { key: "shape" value { shape { dim { size: -1 } } } }
+}
+node {
+  name: "dense_shape"
+  op: "Placeholder"
+  device: "/device:CPU:0"
+  attr { key: "dtype" value { type: DT_INT64 } }
+  attr { key: "shape" value { shape { dim { size: 1 } } } }
+}
+node {
+  name: "num_segments"
+  op: "Const"
+  device: "/device:GPU:0"
+  attr { key: "dtype" value { type: DT_INT32 } }
+  attr { key: "value" value { tensor { dtype: DT_INT32 tensor_shape { } int_val: 4 } } }
+}
+node {
+  name: "y"
+  op: "UnsortedSegmentSum"
+  input: "x"
+  input: "ids"
+  input: "num_segments"
+  device: "/device:GPU:0"
+  attr { key: "T" value { type: DT_FLOAT } }
+  attr { key: "Tindices" value { type: DT_INT64 } }
+  attr { key: "Tnumsegments" value { type: DT_INT32 } }
+}
+versions {
+  producer: 26
+}
+  )EOF";
+
+  QCHECK(protobuf::TextFormat::ParseFromString(text_proto, &graph_def));
+  return graph_def;
+}
+
 GraphDef CreateGraphForYEqualsXSquaredUnknownRank() {
   GraphDef graph_def;
   const char* text_proto = R"EOF(
@@ -1723,6 +1775,113 @@ TEST_F(CudaGraphModeSessionTest, TestSimple) {
   unsetenv("CUDA_VISIBLE_DEVICES");
 }
 
+TEST_F(CudaGraphModeSessionTest, TestPaddedBatch) {
+  setenv("CUDA_VISIBLE_DEVICES", "0", 1);
+  std::unique_ptr<Session> cuda_graph_mode_session;
+  SessionOptions options;
+  options.config.mutable_cuda_graph_mode_options()->set_batch_size(3);
+  options.config.mutable_cuda_graph_mode_options()->set_allow_fallback(false);
+  options.config.mutable_cuda_graph_mode_options()->add_output_names("y");
+  init(options, cuda_graph_mode_session);
+  TF_CHECK_OK(cuda_graph_mode_session->Create(CreateGraphForYEqualsXSquared()));
+  Tensor input(DT_FLOAT, TensorShape({2}));
+  std::vector<Tensor> outputs;
+  float* data = input.flat<float>().data();
+  data[0] = 1.0f;
+  data[1] = 2.2f;
+  std::vector<std::pair<std::string, Tensor>> inputs_map;
+  inputs_map.push_back(std::make_pair("x", input));
+  TF_CHECK_OK(cuda_graph_mode_session->Run(inputs_map, {"y"}, {}, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  ASSERT_EQ(2, outputs[0].NumElements());
+  auto result = copyFromGPU(outputs[0]);
+  data = result.flat<float>().data();
+  EXPECT_FLOAT_EQ(1.0, data[0]);
+  EXPECT_FLOAT_EQ(4.84, data[1]);
+  unsetenv("CUDA_VISIBLE_DEVICES");
+}
+
+TEST_F(CudaGraphModeSessionTest, TestBatchBuckets) {
+  setenv("CUDA_VISIBLE_DEVICES", "0", 1);
+  std::unique_ptr<Session> cuda_graph_mode_session;
+  SessionOptions options;
+  options.config.mutable_cuda_graph_mode_options()->set_batch_size(8);
+  options.config.mutable_cuda_graph_mode_options()->set_allow_fallback(false);
+  options.config.mutable_cuda_graph_mode_options()->add_output_names("y");
+  options.config.mutable_cuda_graph_mode_options()
+      ->set_power_of_two_batch_buckets(true);
+  init(options, cuda_graph_mode_session);
+  TF_CHECK_OK(cuda_graph_mode_session->Create(CreateGraphForYEqualsXSquared()));
+  for (int batch_size : {3, 3, 1, 8}) {
+    Tensor input(DT_FLOAT, TensorShape({batch_size}));
+    for (int i = 0; i < batch_size; ++i) {
+      input.flat<float>()(i) = i + 0.5f;
+    }
+    std::vector<Tensor> outputs;
+    std::vector<std::pair<std::string, Tensor>> inputs_map;
+    inputs_map.push_back(std::make_pair("x", input));
+    TF_CHECK_OK(cuda_graph_mode_session->Run(inputs_map, {"y"}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    ASSERT_EQ(batch_size, outputs[0].NumElements());
+    auto result = copyFromGPU(outputs[0]);
+    for (int i = 0; i < batch_size; ++i) {
+      EXPECT_FLOAT_EQ((i + 0.5f) * (i + 0.5f), result.flat<float>()(i));
+    }
+  }
+  CudaGraphCacheStats stats =
+      reinterpret_cast<CudaGraphModeSession*>(cuda_graph_mode_session.get())
+          ->GetCacheStats();
+  EXPECT_EQ(2, stats.hits);
+  EXPECT_EQ(2, stats.misses);
+  EXPECT_EQ(15, stats.fed_rows);
+  EXPECT_EQ(2, stats.padded_rows);
+  unsetenv("CUDA_VISIBLE_DEVICES");
+}
+
+TEST_F(CudaGraphModeSessionTest, TestSparseInput) {
+  setenv("CUDA_VISIBLE_DEVICES", "0", 1);
+  std::unique_ptr<Session> cuda_graph_mode_session;
+  SessionOptions options;
+  options.config.mutable_cuda_graph_mode_options()->set_batch_size(3);
+  options.config.mutable_cuda_graph_mode_options()->set_allow_fallback(false);
+  options.config.mutable_cuda_graph_mode_options()->add_output_names("y");
+  auto* sparse_input =
+      options.config.mutable_cuda_graph_mode_options()->add_sparse_inputs();
+  sparse_input->set_values("x");
+  sparse_input->set_indices("ids");
+  sparse_input->set_dense_shape("dense_shape");
+  sparse_input->set_max_ids_num(5);
+  init(options, cuda_graph_mode_session);
+  TF_CHECK_OK(
+      cuda_graph_mode_session->Create(CreateGraphForSparseSegmentSum()));
+  for (int num_ids = 1; num_ids <= 5; ++num_ids) {
+    Tensor x(DT_FLOAT, TensorShape({num_ids}));
+    Tensor ids(DT_INT64, TensorShape({num_ids}));
+    Tensor dense_shape(DT_INT64, TensorShape({1}));
+    for (int i = 0; i < num_ids; ++i) {
+      x.flat<float>()(i) = i + 1.0f;
+      ids.flat<int64>()(i) = i % 2;
+    }
+    dense_shape.flat<int64>()(0) = 2;
+    std::vector<Tensor> outputs;
+    std::vector<std::pair<std::string, Tensor>> inputs_map;
+    inputs_map.push_back(std::make_pair("x", x));
+    inputs_map.push_back(std::make_pair("ids", ids));
+    inputs_map.push_back(std::make_pair("dense_shape", dense_shape));
+    TF_CHECK_OK(cuda_graph_mode_session->Run(inputs_map, {"y"}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    ASSERT_EQ(2, outputs[0].NumElements());
+    auto result = copyFromGPU(outputs[0]);
+    float expected[2] = {0.0f, 0.0f};
+    for (int i = 0; i < num_ids; ++i) {
+      expected[i % 2] += i + 1.0f;
+    }
+    EXPECT_FLOAT_EQ(expected[0], result.flat<float>()(0));
+    EXPECT_FLOAT_EQ(expected[1], result.flat<float>()(1));
+  }
+  unsetenv("CUDA_VISIBLE_DEVICES");
+}
+
 TEST_F(CudaGraphModeSessionTest, TestGPUInput) {
   setenv("CUDA_VISIBLE_DEVICES", "0", 1);
   std::unique_ptr<Session> cuda_graph_mode_session;
@@ -18,10 +18,48 @@ limitations under the License.
 #include <vector>
 
 #include "tensorflow/core/common_runtime/optimization_registry.h"
+#include "tensorflow/core/framework/embedding/config.pb.h"
 #include "tensorflow/core/public/session_options.h"
 
 namespace tensorflow {
 
+namespace {
+bool IsEmbeddingVarLookup(const Node* node) {
+  return node->type_string() == "KvResourceGather" ||
+         node->type_string() == "KvResourceGatherV1" ||
+         node->type_string() == "GroupEmbeddingVarLookup";
+}
+
+// Only the lookups of EVs stored in HBM alone run on the stream without
+// copying ids to host, so that they can be captured.
+bool IsCapturableEmbeddingVarLookup(const Node* node) {
+  for (const Edge* edge : node->in_edges()) {
+    if (edge->IsControlEdge() ||
+        node->input_type(edge->dst_input()) != DT_RESOURCE) {
+      continue;
+    }
+    bool found_initializer = false;
+    for (const Edge* out_edge : edge->src()->out_edges()) {
+      const Node* init = out_edge->dst();
+      if (init->type_string() != "InitializeKvVariableOp" &&
+          init->type_string() != "InitializeKvVariableV2Op") {
+        continue;
+      }
+      int64 storage_type = 0;
+      if (!GetNodeAttr(init->attrs(), "storage_type", &storage_type).ok() ||
+          storage_type != embedding::HBM) {
+        return false;
+      }
+      found_initializer = true;
+    }
+    if (!found_initializer) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
 class ValidateCudaGraphModePass : public GraphOptimizationPass {
  public:
   Status Run(const GraphOptimizationPassOptions& options) override {
@@ -52,6 +90,13 @@ class ValidateCudaGraphModePass : public GraphOptimizationPass {
           break;
         }
       }
+      // validate embedding lookup
+      if (IsEmbeddingVarLookup(node) && !IsCapturableEmbeddingVarLookup(node)) {
+        LOG(WARNING) << "Op node: " << node->name()
+                     << " looks up an EmbeddingVariable not stored in HBM";
+        has_invalid_graph = true;
+        break;
+      }
       // validate dynamic shape
       if (HasNodeAttr(node->def(), "shape")) {
         auto shape_proto = node->def().attr().at("shape").shape();
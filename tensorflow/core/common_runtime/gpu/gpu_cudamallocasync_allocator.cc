@@ -45,9 +45,14 @@ std::atomic<int> GpuCudaMallocAsyncAllocator::number_instantiated_(0);
 
 GpuCudaMallocAsyncAllocator::GpuCudaMallocAsyncAllocator(
     PlatformGpuId platform_device_id, size_t pool_size, bool reserve_memory,
-    bool compute_stats)
-    : name_(absl::StrCat("gpu_async_", platform_device_id.value())) {
+    bool compute_stats, bool enforce_pool_size)
+    : name_(absl::StrCat("gpu_async_", platform_device_id.value())),
+      pool_size_(pool_size),
+      enforce_pool_size_(enforce_pool_size) {
   ++number_instantiated_;
+  // The sizes of the allocations are known by the stats only.
+  CHECK(compute_stats || !enforce_pool_size)
+      << "enforce_pool_size of GpuCudaMallocAsyncAllocator needs compute_stats";
 #if TF_CUDA_MALLOC_ASYNC_SUPPORTED
   stream_exec_ = DeviceIdUtil::ExecutorForPlatformGpuId(GPUMachineManager(),
                                                            platform_device_id)
@@ -220,11 +225,25 @@ void* GpuCudaMallocAsyncAllocator::AllocateRaw(size_t alignment,
         << "The instantiation of GpuCudaMallocAsyncAllocator failed."
         << " See previous errors.";
   }
+  if (enforce_pool_size_) {
+    mutex_lock lock(lock_);
+    if (quota_in_use_ + num_bytes > pool_size_) {
+      LOG(WARNING) << Name() << " failed to allocate " << num_bytes
+                   << " bytes: " << quota_in_use_ << " of the quota of "
+                   << pool_size_ << " bytes are in use.";
+      return nullptr;
+    }
+    quota_in_use_ += num_bytes;
+  }
   se::cuda::ScopedActivateExecutorContext scoped_activation{stream_exec_};
   void* ptr = nullptr;
   if (auto result =
       cuMemAllocFromPoolAsync(reinterpret_cast<CUdeviceptr*>(&ptr),
                               num_bytes, pool_, cuda_stream_)) {
+    if (enforce_pool_size_) {
+      mutex_lock lock(lock_);
+      quota_in_use_ -= num_bytes;
+    }
     size_t free, total;
     cuMemGetInfo(&free, &total);
     LOG(ERROR) << Name() << " cuMemAllocAsync failed to allocate " << num_bytes
@@ -329,6 +348,9 @@ void GpuCudaMallocAsyncAllocator::DeallocateRaw(void* ptr) {
     DCHECK(size_map_.contains(ptr));
     size_t size = size_map_[ptr];
     stats_->bytes_in_use -= size;
+    if (enforce_pool_size_) {
+      quota_in_use_ -= size;
+    }
     size_map_.erase(ptr);
   }
 
@@ -63,12 +63,18 @@ namespace tensorflow {
 // Here, the pool_size isn't the absolute max as for [Gpu]BFCAllocator.
 // The pool can grow above that up to the total GPU memory.  But the
 // driver can return the excess memory to other processes.
+//
+// The allocators of the virtual devices of a GPU share the default pool of
+// the GPU. Use `enforce_pool_size=true` to make pool_size the quota of this
+// allocator, the allocations above it fail as in [Gpu]BFCAllocator, so that
+// a virtual device can't take the memory of the others.
 class GpuCudaMallocAsyncAllocator : public Allocator {
  public:
   explicit GpuCudaMallocAsyncAllocator(PlatformGpuId platform_device_id,
                                        size_t pool_size,
                                        bool reserve_memory = false,
-                                       bool compute_stats = true);
+                                       bool compute_stats = true,
+                                       bool enforce_pool_size = false);
   ~GpuCudaMallocAsyncAllocator() override;
   string Name() override { return name_; }
   void* AllocateRaw(size_t alignment, size_t num_bytes) override;
@@ -117,6 +123,10 @@ class GpuCudaMallocAsyncAllocator : public Allocator {
 
   string name_;
 
+  // The quota of the allocator when enforce_pool_size_ is true.
+  const size_t pool_size_;
+  const bool enforce_pool_size_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(GpuCudaMallocAsyncAllocator);
 
   // Stats.
@@ -124,6 +134,9 @@ class GpuCudaMallocAsyncAllocator : public Allocator {
   mutable mutex lock_;
   std::unique_ptr<AllocatorStats> stats_ TF_PT_GUARDED_BY(lock_);
   absl::flat_hash_map<const void*, size_t> size_map_ TF_GUARDED_BY(lock_);
+  // The bytes of the allocations in flight and in use, checked against the
+  // quota before cuMemAllocFromPoolAsync.
+  size_t quota_in_use_ TF_GUARDED_BY(lock_) = 0;
 };
 
 }  // namespace tensorflow
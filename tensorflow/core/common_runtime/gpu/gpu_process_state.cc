@@ -34,6 +34,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/gpu_tensorpool_allocator.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/log_memory.h"
+#include "tensorflow/core/framework/memory_attribution.h"
 #include "tensorflow/core/framework/tracking_allocator.h"
 #include "tensorflow/core/lib/gtl/stl_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
@@ -64,6 +65,14 @@ bool useCudaMallocAsyncAllocator() {
       std::strcmp(debug_allocator_str, "cuda_malloc_async") == 0;
 }
 
+// The virtual devices of the sessions of a SessionGroup have their own
+// memory quotas, see DirectSessionFactory::NewSessionGroup.
+bool useSessionGroupGpuMemoryLimit() {
+  const char* memory_limit_str =
+      std::getenv("SESSION_GROUP_GPU_MEMORY_LIMIT_MB");
+  return memory_limit_str != nullptr && std::strlen(memory_limit_str) > 0;
+}
+
 bool useTensorPoolAllocator() {
   const char* debug_allocator_str = std::getenv("TF_GPU_ALLOCATOR");
   return debug_allocator_str != nullptr &&
@@ -203,8 +212,12 @@ Allocator* GPUProcessState::GetGPUAllocator(const GPUOptions& options,
       // TODO: useful for doing memory debugging with tools like
       // compute-sanitizer.
       // TODO: **WARNING** probably will not work in a multi-gpu scenario
-      gpu_allocator =
-          new GpuCudaMallocAsyncAllocator(platform_gpu_id, total_bytes);
+      // The virtual devices of a GPU share the pool of the GPU, the quotas
+      // of the sessions are enforced by the allocators.
+      gpu_allocator = new GpuCudaMallocAsyncAllocator(
+          platform_gpu_id, total_bytes, /*reserve_memory=*/false,
+          /*compute_stats=*/true,
+          /*enforce_pool_size=*/useSessionGroupGpuMemoryLimit());
     } else if (options.cuda_graph_mode_compatible() || 
                options.cuda_graph_enable_jit()) {
       LOG(INFO) << "Using CUDA Graph compatible GPUBFCAllocator for GPU: " 
@@ -214,6 +227,11 @@ Allocator* GPUProcessState::GetGPUAllocator(const GPUOptions& options,
                             strings::StrCat("GPU_", tf_gpu_id.value(), "_bfc"));
     }
 
+    if (MemoryAttribution::Global() != nullptr) {
+      gpu_allocator = MemoryAttribution::Global()->NewDeviceAllocator(
+          gpu_allocator, true /*owns_allocator*/);
+    }
+
     Allocator* recording_allocator = nullptr;
     if (process_state_->ProcessState::FLAGS_brain_gpu_record_mem_types) {
       ProcessState::MemDesc md;
@@ -1,5 +1,6 @@
 #include "tensorflow/core/common_runtime/gpu_tensorpool_allocator.h"
 #include "tensorflow/core/common_runtime/gpu_memory_planner.h"
+#include "tensorflow/core/framework/embedding/hbm_cache_budget.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/util/env_var.h"
 #include <algorithm>
@@ -86,6 +87,8 @@ void GPUMemoryPlanner::StartCollect() {
   if (is_stats_.load()) {
     BestFit();
     ResetStats();
+    // The HBM caches of EmbeddingVariables get what the plan leaves.
+    embedding::HbmCacheBudget::Global()->SetDenseBytes(PlannedBytes());
   }
 
   auto current = counter_.fetch_add(1);
@@ -109,6 +112,14 @@ void GPUMemoryPlanner::BestFit() {
   }
 }
 
+size_t GPUMemoryPlanner::PlannedBytes() {
+  size_t total_mem = BestLifetimePolicy()->TotalMem();
+  for (auto bin : small_bins_) {
+    total_mem += bin->TotalMem();
+  }
+  return total_mem;
+}
+
 void GPUMemoryPlanner::ResetStats() {
   for (auto policy : lifetime_stats_polices_) {
     policy->ResetStats();
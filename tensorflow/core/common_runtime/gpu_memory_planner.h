@@ -191,6 +191,7 @@ class GPUMemoryPlanner : public GPUMemoryPlannerBase {
   void Cleanup();
   void ResetStats();
   void BestFit();
+  size_t PlannedBytes();
 
   GPULifetimeBin* GetSmallBin(size_t size);
 
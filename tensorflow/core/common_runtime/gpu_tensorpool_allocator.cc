@@ -1,6 +1,7 @@
 #include "tensorflow/core/common_runtime/gpu_memory_planner.h"
 #include "tensorflow/core/common_runtime/gpu_tensorpool_allocator.h"
 #include "tensorflow/core/framework/allocator_registry.h"
+#include "tensorflow/core/framework/embedding/hbm_cache_budget.h"
 #include "tensorflow/core/platform/mem.h"
 #include <sys/time.h>
 #include <iostream>
@@ -28,6 +29,7 @@ GPUTensorPoolAllocator::GPUTensorPoolAllocator(
     small_mem_end_(nullptr) {
   mem_planner_->SetAllocator(this);
   alloc_stats_.bytes_limit = static_cast<int64>(total_memory);
+  embedding::HbmCacheBudget::Global()->SetDeviceBytes(total_memory);
 }
 
 GPUTensorPoolAllocator::~GPUTensorPoolAllocator() {
@@ -166,6 +168,8 @@ void GPUTensorPoolAllocator::Init() {
     } else {
       small_mem_end_ = nullptr;
     }
+    embedding::HbmCacheBudget::Global()->SetDenseBytes(
+        big_bytes_ + small_bytes_);
 
     for (auto b : small_bins) {
       SmallBin* bin = nullptr;
@@ -625,6 +625,21 @@ bool FindGradientOps(Graph* g, std::unordered_set<const Node*>& visited) {
       visited.insert(gradient);
       found = true;
     }
+    // The ids and counts of the EmbeddingVariables are merged along with
+    // their gradients, so they are duplicated too.
+    if (n->IsKvSparseApply()) {
+      const OpDef& op_def = n->op_def();
+      for (int i = 0; i < op_def.input_arg_size(); ++i) {
+        const string& name = op_def.input_arg(i).name();
+        if (name == "grad" || name == "indices" ||
+            name == "indices_counts" || name == "counts") {
+          Node* input = nullptr;
+          TF_CHECK_OK(n->input_node(i, &input));
+          visited.insert(input);
+          found = true;
+        }
+      }
+    }
   }
   return found;
 }
@@ -0,0 +1,335 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_ring_reducer.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/profiler/lib/traceme.h"
+
+namespace tensorflow {
+
+namespace {
+// Key to be used for BufRendezvous by HierarchicalRingReducer.
+string HierarchicalReduceBufKey(const string& exec_key, int subdiv, int step,
+                                int src_rank, int dst_rank) {
+  return strings::StrCat(exec_key, ":", subdiv, ":", step, ":", src_rank, ":",
+                         dst_rank);
+}
+
+// The steps of the transfers in a task subdiv.
+constexpr int kReduceStep = 0;
+constexpr int kBroadcastStep = 1;
+}  // namespace
+
+// Waits for the sends and recvs dispatched with the callbacks of Callback().
+class HierarchicalRingReducer::PendingOps {
+ public:
+  StatusCallback Callback() {
+    mutex_lock l(mu_);
+    ++pending_;
+    return [this](const Status& s) {
+      mutex_lock l(mu_);
+      status_.Update(s);
+      if (--pending_ == 0) done_.notify_all();
+    };
+  }
+
+  Status Wait() {
+    mutex_lock l(mu_);
+    while (pending_ > 0) done_.wait(l);
+    return status_;
+  }
+
+ private:
+  mutex mu_;
+  condition_variable done_;
+  int pending_ GUARDED_BY(mu_) = 0;
+  Status status_ GUARDED_BY(mu_);
+};
+
+HierarchicalRingReducer::HierarchicalRingReducer()
+    : col_ctx_(nullptr), col_params_(nullptr) {}
+
+Status HierarchicalRingReducer::InitializeCollectiveParams(
+    CollectiveParams* col_params) {
+  CHECK_EQ(col_params->instance.type, REDUCTION_COLLECTIVE);
+  CHECK_EQ(col_params->instance.impl_details.collective_name,
+           "HierarchicalRingReduce");
+  const string& device_name =
+      col_params->instance.device_names[col_params->default_rank];
+  // Precondition: device_names must be sorted so that all devices in
+  // the same task are adjacent.
+  std::vector<int> task_begin;
+  for (int di = 0; di < col_params->group.group_size; ++di) {
+    if (di == 0 || col_params->instance.task_names[di] !=
+                       col_params->instance.task_names[di - 1]) {
+      task_begin.push_back(di);
+    }
+  }
+  const int num_tasks = task_begin.size();
+  CHECK_EQ(col_params->group.num_tasks, num_tasks);
+  task_begin.push_back(col_params->group.group_size);
+
+  auto& impl = col_params->instance.impl_details;
+  impl.subdiv_permutations.clear();
+  impl.subdiv_permutations.resize(num_tasks + 1);
+  impl.subdiv_source_rank.assign(num_tasks + 1, 0);
+  col_params->subdiv_rank.assign(num_tasks + 1, -1);
+  for (int ti = 0; ti < num_tasks; ++ti) {
+    // The leader of task ti is its first device.
+    impl.subdiv_permutations[0].push_back(task_begin[ti]);
+    if (col_params->instance.device_names[task_begin[ti]] == device_name) {
+      col_params->subdiv_rank[0] = ti;
+    }
+    for (int di = task_begin[ti]; di < task_begin[ti + 1]; ++di) {
+      impl.subdiv_permutations[ti + 1].push_back(di);
+      if (col_params->instance.device_names[di] == device_name) {
+        col_params->subdiv_rank[ti + 1] = di - task_begin[ti];
+      }
+    }
+  }
+
+  VLOG(2) << collective_util::SubdivPermDebugString(*col_params);
+  return Status::OK();
+}
+
+Status HierarchicalRingReducer::InitializeCollectiveContext(
+    CollectiveContext* col_ctx) {
+  CHECK(col_ctx->dev_mgr);
+  col_ctx_ = col_ctx;
+  col_params_ = &col_ctx->col_params;
+  return collective_util::InitializeDeviceAndLocality(
+      col_ctx->dev_mgr, col_ctx->device_name, &col_ctx->device,
+      &col_ctx->device_locality);
+}
+
+void HierarchicalRingReducer::Run(StatusCallback done) {
+  CHECK(col_ctx_);
+  CHECK(col_params_);
+  int task_subdiv = -1;
+  for (int si = 1; si < col_params_->subdiv_rank.size(); ++si) {
+    if (col_params_->subdiv_rank[si] >= 0) task_subdiv = si;
+  }
+  CHECK_GT(task_subdiv, 0);
+  const bool is_leader = col_params_->subdiv_rank[0] >= 0;
+
+  Status s = CopyInputToOutput();
+  if (s.ok()) s = ReduceInTask(task_subdiv);
+  if (s.ok() && is_leader) s = ReduceAmongLeaders();
+  if (s.ok() && is_leader) s = ApplyFinalOp();
+  if (s.ok()) s = BroadcastInTask(task_subdiv);
+  VLOG(2) << "device=" << col_ctx_->device_name << " return status " << s;
+  ca_.reset();
+  done(s);
+}
+
+Status HierarchicalRingReducer::CopyInputToOutput() {
+  if (col_ctx_->input == col_ctx_->output ||
+      DMAHelper::base(col_ctx_->input) == DMAHelper::base(col_ctx_->output)) {
+    return Status::OK();
+  }
+  profiler::TraceMe activity("MemCpyAsync", profiler::TraceMeLevel::kInfo);
+  Notification note;
+  Status status;
+  CollectiveRemoteAccessLocal::MemCpyAsync(
+      col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->op_device_context(), col_ctx_->device,
+      col_ctx_->device, col_ctx_->op_ctx->input_alloc_attr(0),
+      col_ctx_->op_ctx->output_alloc_attr(0), col_ctx_->input,
+      col_ctx_->output, 0 /*dev_to_dev_stream_index*/,
+      [&note, &status](const Status& s) {
+        status.Update(s);
+        note.Notify();
+      });
+  note.WaitForNotification();
+  return status;
+}
+
+Status HierarchicalRingReducer::ReduceInTask(int subdiv) {
+  profiler::TraceMe activity("ReduceInTask", profiler::TraceMeLevel::kInfo);
+  const int my_rank = col_params_->subdiv_rank[subdiv];
+  const int num_devices =
+      col_params_->instance.impl_details.subdiv_permutations[subdiv].size();
+  if (num_devices == 1) return Status::OK();
+  if (my_rank != 0) {
+    PendingOps ops;
+    DispatchSend(subdiv, kReduceStep, 0, col_ctx_->output, ops.Callback());
+    return ops.Wait();
+  }
+  // Receive all the values at once, then merge them as they are in place.
+  Allocator* allocator = col_ctx_->device->GetAllocator(
+      col_ctx_->op_ctx->output_alloc_attr(0));
+  std::vector<Tensor> values;
+  values.reserve(num_devices - 1);
+  PendingOps ops;
+  for (int r = 1; r < num_devices; ++r) {
+    values.emplace_back(allocator, col_ctx_->output->dtype(),
+                        col_ctx_->output->shape());
+    DispatchRecv(subdiv, kReduceStep, r, &values.back(), ops.Callback());
+  }
+  TF_RETURN_IF_ERROR(ops.Wait());
+  for (Tensor& value : values) {
+    TF_RETURN_IF_ERROR(collective_util::ComputeBinOp(
+        col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+        col_params_->merge_op.get(), col_ctx_->output, &value));
+  }
+  return Status::OK();
+}
+
+// A ring all-reduce over the leaders, the output split in one chunk per
+// leader. In the reduce-scatter pass, at step s the leader of rank r sends
+// chunk r-s to r+1 and merges chunk r-s-1 from r-1 into its own, so after
+// n-1 steps it holds the complete chunk r+1. In the all-gather pass it
+// sends chunk r+1-s and receives chunk r-s in place.
+Status HierarchicalRingReducer::ReduceAmongLeaders() {
+  const int num_leaders = col_params_->group.num_tasks;
+  const int my_rank = col_params_->subdiv_rank[0];
+  const int next = (my_rank + 1) % num_leaders;
+  const int prev = (my_rank + num_leaders - 1) % num_leaders;
+  ca_.reset(MakeCollectiveAdapter(
+      col_ctx_->output, num_leaders,
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0))));
+  if (num_leaders == 1) return Status::OK();
+
+  auto chunk_index = [num_leaders](int i) {
+    return ((i % num_leaders) + num_leaders) % num_leaders;
+  };
+  for (int step = 0; step < 2 * (num_leaders - 1); ++step) {
+    const bool reduce = step < num_leaders - 1;
+    const int s = reduce ? step : step - (num_leaders - 1);
+    const int send_index = chunk_index(reduce ? my_rank - s : my_rank + 1 - s);
+    const int recv_index = chunk_index(reduce ? my_rank - s - 1 : my_rank - s);
+    profiler::TraceMe activity(
+        [&] { return strings::StrCat("ReduceAmongLeaders:", step); },
+        profiler::TraceMeLevel::kInfo);
+    Tensor send_chunk = ca_->ChunkAlias(send_index);
+    Tensor recv_chunk = ca_->ChunkAlias(recv_index);
+    Tensor tmp_chunk;
+    PendingOps ops;
+    // Tail chunks may be empty, the same ones on every leader.
+    if (ca_->ChunkBytes(send_index) > 0) {
+      DispatchSend(0, step, next, &send_chunk, ops.Callback());
+    }
+    if (ca_->ChunkBytes(recv_index) > 0) {
+      if (reduce) {
+        tmp_chunk = ca_->TempChunk(recv_index);
+        DispatchRecv(0, step, prev, &tmp_chunk, ops.Callback());
+      } else {
+        DispatchRecv(0, step, prev, &recv_chunk, ops.Callback());
+      }
+    }
+    TF_RETURN_IF_ERROR(ops.Wait());
+    if (reduce && ca_->ChunkBytes(recv_index) > 0) {
+      TF_RETURN_IF_ERROR(collective_util::ComputeBinOp(
+          col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+          col_params_->merge_op.get(), &recv_chunk, &tmp_chunk));
+    }
+  }
+  return Status::OK();
+}
+
+Status HierarchicalRingReducer::ApplyFinalOp() {
+  if (!col_params_->final_op) return Status::OK();
+  Tensor group_size = ca_->Scalar(col_params_->group.group_size);
+  if (col_params_->group.device_type != "CPU") {
+    Tensor group_size_val = group_size;
+    group_size = ca_->Scalar(
+        col_ctx_->device->GetAllocator(col_ctx_->op_ctx->input_alloc_attr(0)),
+        AllocationAttributes());
+    Notification note;
+    Status status;
+    col_ctx_->op_ctx->op_device_context()->CopyCPUTensorToDevice(
+        &group_size_val, col_ctx_->device, &group_size,
+        [&note, &status](const Status& s) {
+          status.Update(s);
+          note.Notify();
+        });
+    note.WaitForNotification();
+    TF_RETURN_IF_ERROR(status);
+  }
+  return collective_util::ComputeBinOp(
+      col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+      col_params_->final_op.get(), col_ctx_->output, &group_size);
+}
+
+Status HierarchicalRingReducer::BroadcastInTask(int subdiv) {
+  profiler::TraceMe activity("BroadcastInTask", profiler::TraceMeLevel::kInfo);
+  const int my_rank = col_params_->subdiv_rank[subdiv];
+  const int num_devices =
+      col_params_->instance.impl_details.subdiv_permutations[subdiv].size();
+  PendingOps ops;
+  if (my_rank == 0) {
+    for (int r = 1; r < num_devices; ++r) {
+      DispatchSend(subdiv, kBroadcastStep, r, col_ctx_->output,
+                   ops.Callback());
+    }
+  } else {
+    DispatchRecv(subdiv, kBroadcastStep, 0, col_ctx_->output, ops.Callback());
+  }
+  return ops.Wait();
+}
+
+void HierarchicalRingReducer::DispatchSend(int subdiv, int step, int dst_rank,
+                                           const Tensor* tensor,
+                                           const StatusCallback& done) {
+  const int my_rank = col_params_->subdiv_rank[subdiv];
+  string send_buf_key = HierarchicalReduceBufKey(col_ctx_->exec_key, subdiv,
+                                                 step, my_rank, dst_rank);
+  int dst_idx =
+      col_params_->instance.impl_details.subdiv_permutations[subdiv][dst_rank];
+  VLOG(3) << "DispatchSend " << send_buf_key << " from_device "
+          << col_ctx_->device_name << " to_device "
+          << col_params_->instance.device_names[dst_idx];
+  col_ctx_->col_exec->PostToPeer(col_params_->instance.device_names[dst_idx],
+                                 col_params_->instance.task_names[dst_idx],
+                                 send_buf_key, col_ctx_->device,
+                                 col_ctx_->op_ctx->op_device_context(),
+                                 col_ctx_->op_ctx->output_alloc_attr(0),
+                                 tensor, col_ctx_->device_locality, done);
+}
+
+void HierarchicalRingReducer::DispatchRecv(int subdiv, int step, int src_rank,
+                                           Tensor* tensor,
+                                           const StatusCallback& done) {
+  const int my_rank = col_params_->subdiv_rank[subdiv];
+  string recv_buf_key = HierarchicalReduceBufKey(col_ctx_->exec_key, subdiv,
+                                                 step, src_rank, my_rank);
+  int src_idx =
+      col_params_->instance.impl_details.subdiv_permutations[subdiv][src_rank];
+  VLOG(3) << "DispatchRecv " << recv_buf_key << " from_device "
+          << col_params_->instance.device_names[src_idx] << " to_device "
+          << col_ctx_->device_name;
+  col_ctx_->col_exec->RecvFromPeer(
+      col_params_->instance.device_names[src_idx],
+      col_params_->instance.task_names[src_idx],
+      col_params_->task.is_local[src_idx], recv_buf_key, col_ctx_->device,
+      col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->output_alloc_attr(0), tensor,
+      col_ctx_->device_locality, 0 /*stream_index*/, done);
+}
+
+REGISTER_COLLECTIVE(HierarchicalRingReduce, HierarchicalRingReducer);
+
+}  // namespace tensorflow
@@ -0,0 +1,89 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_RING_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_RING_REDUCER_H_
+
+#include <memory>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/framework/collective.h"
+
+namespace tensorflow {
+
+// Hierarchical implementation of collective reduce, selected by the
+// communication_hint "hierarchical". The devices of a task first reduce
+// their values to the first device of the task, over the local links
+// (e.g. NVLink). These leaders then run a ring all-reduce among themselves,
+// so each task sends one message per ring step over the network, instead
+// of one per device. At last the leaders broadcast the result to the other
+// devices of their task.
+class HierarchicalRingReducer : public CollectiveImplementationInterface {
+ public:
+  HierarchicalRingReducer();
+  ~HierarchicalRingReducer() override = default;
+
+  // Establishes n+1 subdivs for n tasks. The first subdiv comprises the
+  // first device of every task, the leaders. Subdiv i+1 comprises the
+  // devices of task i, led by its rank 0.
+  Status InitializeCollectiveParams(CollectiveParams* col_params) override;
+
+  // Initializes members of CollectiveContext not yet initialized, i.e. device
+  // and device_locality.  Also saves the CollectiveContext in this object.
+  Status InitializeCollectiveContext(CollectiveContext* col_ctx) override;
+
+  // No-op for hierarchical ring reducer.
+  Status InitializeCollectiveGroupRuntimeDetails(
+      CollGroupRuntimeDetails*) override {
+    return Status::OK();
+  }
+
+  // Executes the reduction. Must be called in a blockable thread.
+  void Run(StatusCallback done) override;
+
+ private:
+  class PendingOps;
+
+  // Copies the input to the output, unless they share their buffer.
+  Status CopyInputToOutput();
+
+  // Reduces the output of the devices of the task of this device into the
+  // output of the leader of the task.
+  Status ReduceInTask(int subdiv);
+
+  // Runs a ring all-reduce of the outputs of the leaders.
+  Status ReduceAmongLeaders();
+
+  // Applies final_op to the output of the leader.
+  Status ApplyFinalOp();
+
+  // Broadcasts the output of the leader of the task to its devices.
+  Status BroadcastInTask(int subdiv);
+
+  // Sends `tensor` to the device at `dst_rank` in `subdiv`, the `step`th
+  // transfer of the subdiv.
+  void DispatchSend(int subdiv, int step, int dst_rank, const Tensor* tensor,
+                    const StatusCallback& done);
+
+  // Receives into `tensor` from the device at `src_rank` in `subdiv`.
+  void DispatchRecv(int subdiv, int step, int src_rank, Tensor* tensor,
+                    const StatusCallback& done);
+
+  CollectiveContext* col_ctx_;          // Not owned
+  const CollectiveParams* col_params_;  // Not owned
+  std::unique_ptr<CollectiveAdapter> ca_;
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_RING_REDUCER_H_
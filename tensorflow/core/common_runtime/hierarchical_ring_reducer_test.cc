@@ -0,0 +1,80 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_ring_reducer.h"
+
+#include <vector>
+
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns the params of a reduce over 'dev_per_task' devices per task, as
+// seen from the device of 'default_rank'.
+CollectiveParams MakeParams(const std::vector<int>& dev_per_task,
+                            int default_rank) {
+  CollectiveParams cp;
+  cp.instance.type = REDUCTION_COLLECTIVE;
+  cp.instance.impl_details.collective_name = "HierarchicalRingReduce";
+  cp.group.num_tasks = dev_per_task.size();
+  for (int ti = 0; ti < dev_per_task.size(); ++ti) {
+    const string task = strings::StrCat("/job:worker/replica:0/task:", ti);
+    for (int di = 0; di < dev_per_task[ti]; ++di) {
+      cp.instance.task_names.push_back(task);
+      cp.instance.device_names.push_back(
+          strings::StrCat(task, "/device:GPU:", di));
+    }
+  }
+  cp.group.group_size = cp.instance.device_names.size();
+  cp.default_rank = default_rank;
+  return cp;
+}
+
+TEST(HierarchicalRingReducerTest, LeaderSubdivs) {
+  HierarchicalRingReducer reducer;
+  CollectiveParams cp = MakeParams({2, 3, 1}, 2);
+  TF_ASSERT_OK(reducer.InitializeCollectiveParams(&cp));
+  const auto& perms = cp.instance.impl_details.subdiv_permutations;
+  ASSERT_EQ(4, perms.size());
+  EXPECT_EQ(std::vector<int>({0, 2, 5}), perms[0]);
+  EXPECT_EQ(std::vector<int>({0, 1}), perms[1]);
+  EXPECT_EQ(std::vector<int>({2, 3, 4}), perms[2]);
+  EXPECT_EQ(std::vector<int>({5}), perms[3]);
+  // Device 2 leads task 1.
+  EXPECT_EQ(std::vector<int>({1, -1, 0, -1}), cp.subdiv_rank);
+}
+
+TEST(HierarchicalRingReducerTest, NonLeaderSubdivs) {
+  HierarchicalRingReducer reducer;
+  CollectiveParams cp = MakeParams({2, 3, 1}, 4);
+  TF_ASSERT_OK(reducer.InitializeCollectiveParams(&cp));
+  EXPECT_EQ(std::vector<int>({-1, -1, 2, -1}), cp.subdiv_rank);
+}
+
+TEST(HierarchicalRingReducerTest, SingleTask) {
+  HierarchicalRingReducer reducer;
+  CollectiveParams cp = MakeParams({4}, 0);
+  TF_ASSERT_OK(reducer.InitializeCollectiveParams(&cp));
+  const auto& perms = cp.instance.impl_details.subdiv_permutations;
+  ASSERT_EQ(2, perms.size());
+  EXPECT_EQ(std::vector<int>({0}), perms[0]);
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3}), perms[1]);
+  EXPECT_EQ(std::vector<int>({0, 0}), cp.subdiv_rank);
+}
+
+}  // namespace
+}  // namespace tensorflow
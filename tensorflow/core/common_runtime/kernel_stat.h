@@ -16,8 +16,10 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_COMMON_RUNTIME_KERNEL_STAT_H_
 #define TENSORFLOW_CORE_COMMON_RUNTIME_KERNEL_STAT_H_
 
+#include <algorithm>
 #include <atomic>
 #include <memory>
+#include <numeric>
 #include <queue>
 #include <vector>
 
@@ -167,6 +169,25 @@ class KernelStats {
     }
   }
 
+  // The static schedule order of the nodes, the nodes with longer paths to
+  // the sink go first and the ties are broken by node id, so the ready
+  // nodes of every step are dispatched in the same order.
+  void CalculateScheduleRank() {
+    std::vector<int32> order(nodes_count_);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](int32 a, int32 b) {
+      if (immutable_accumulative_cost_[a] != immutable_accumulative_cost_[b]) {
+        return immutable_accumulative_cost_[a] >
+            immutable_accumulative_cost_[b];
+      }
+      return a < b;
+    });
+    schedule_rank_.resize(nodes_count_);
+    for (int32 rank = 0; rank < nodes_count_; ++rank) {
+      schedule_rank_[order[rank]] = rank;
+    }
+  }
+
   void StopCollection() {
     collect_op_cost_ = false;
 
@@ -178,8 +199,9 @@ class KernelStats {
       }
     }
 
-    // 2.calculate accumulative op cost
+    // 2.calculate accumulative op cost and the static schedule order
     CalculateAccumulativeCost();
+    CalculateScheduleRank();
 
     // 3. calculate other metrics here
 
@@ -282,6 +304,10 @@ class KernelStats {
     return &immutable_accumulative_cost_;
   }
 
+  const int32* GetScheduleRankArray() const {
+    return schedule_rank_.data();
+  }
+
   const int64 GetNodeCount() {
     return nodes_count_;
   }
@@ -325,6 +351,8 @@ class KernelStats {
   //   --> D(3) ------------
   // the max total execute time of A is MAX(1+1+1+0, 1+3+0) = 4
   std::vector<int64> immutable_accumulative_cost_;
+  // Position of every node in the static schedule order.
+  std::vector<int32> schedule_rank_;
 
   // number of tasks scheduled by the operator to the thread pool
   std::unique_ptr<std::atomic<int32_t>[]> task_count_;
@@ -1,5 +1,10 @@
 #include "tensorflow/core/common_runtime/tensorpool_allocator.h"
 #include "tensorflow/core/common_runtime/memory_planner.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/util/env_var.h"
 #include <algorithm>
@@ -13,11 +18,13 @@ namespace {
 constexpr int64 DEFAULT_START_STATISTIC_STEP = 100;
 constexpr int64 DEFAULT_STABLE_STATISTIC_STEP = 10;
 constexpr int64 DEFAULT_MAX_STATISTIC_STEP = 100;
+const char* const kMemoryPlanHeader = "TensorPoolMemoryPlan";
 }
 
 MemoryPlanner::MemoryPlanner() :
     is_stats_(false),
-    allocator_(nullptr),
+    plan_ready_(false),
+    best_policy_(nullptr),
     thread_pool_(nullptr),
     counter_(0),
     start_step_(DEFAULT_START_STATISTIC_STEP),
@@ -27,6 +34,7 @@ MemoryPlanner::MemoryPlanner() :
     current_stat_step_(0) {
   InitPolicy();
   InitStepInfo();
+  LoadPlan();
 }
 
 MemoryPlanner::~MemoryPlanner() {
@@ -63,10 +71,62 @@ void MemoryPlanner::InitStepInfo() {
     LOG(FATAL) << "Read MAX_STATISTIC_STEP envrionment error. "
                 << s.error_message();
   }
+  s = ReadStringFromEnvVar("MEMORY_OPTIMIZATION_PLAN_PATH", "",
+      &plan_path_);
+  if (!s.ok()) {
+    LOG(FATAL) << "Read MEMORY_OPTIMIZATION_PLAN_PATH envrionment error. "
+                << s.error_message();
+  }
+}
+
+// A saved plan skips the statistic steps, the allocators are initialized
+// from it as soon as they're set. A plan which doesn't fit the allocations
+// of the model anymore only misses the bins, so it's not validated.
+void MemoryPlanner::LoadPlan() {
+  if (plan_path_.empty() || !Env::Default()->FileExists(plan_path_).ok()) {
+    return;
+  }
+  string plan;
+  Status s = ReadFileToString(Env::Default(), plan_path_, &plan);
+  if (s.ok()) {
+    s = errors::InvalidArgument("No lifetime policy matches the plan");
+    for (auto policy : lifetime_stats_polices_) {
+      s = policy->RestorePlan(plan);
+      if (s.ok()) {
+        best_policy_ = policy;
+        break;
+      }
+      policy->Cleanup();
+    }
+  }
+  if (!s.ok()) {
+    LOG(WARNING) << "Load memory plan from " << plan_path_
+                 << " failed, collect a new plan. " << s.error_message();
+    return;
+  }
+  LOG(INFO) << "Load memory plan from " << plan_path_;
+  plan_ready_ = true;
+}
+
+void MemoryPlanner::SavePlan(LifetimePolicy* policy) {
+  if (plan_path_.empty()) {
+    return;
+  }
+  string plan;
+  policy->SavePlan(&plan);
+  Status s = WriteStringToFile(Env::Default(), plan_path_, plan);
+  if (!s.ok()) {
+    LOG(WARNING) << "Save memory plan to " << plan_path_
+                 << " failed. " << s.error_message();
+  }
 }
 
 // lifetime policy
 LifetimePolicy* MemoryPlanner::BestLifetimePolicy() {
+  // Called by the allocators while mu_ is held once the plan is ready.
+  if (plan_ready_.load()) {
+    return best_policy_;
+  }
   LifetimePolicy* best_policy = nullptr;
   auto total_mem = std::numeric_limits<size_t>::max();
   for (auto policy : lifetime_stats_polices_) {
@@ -82,11 +142,17 @@ LifetimePolicy* MemoryPlanner::BestLifetimePolicy() {
 }
 
 void MemoryPlanner::Reset() {
+  mutex_lock l(mu_);
   counter_ = 0;
+  plan_ready_ = false;
+  best_policy_ = nullptr;
   Cleanup();
 }
 
 void MemoryPlanner::StartCollect() {
+  if (plan_ready_.load()) {
+    return;
+  }
   auto current = counter_.fetch_add(1);
   if (current == start_step_) {
     is_stats_ = true;
@@ -123,10 +189,23 @@ void MemoryPlanner::StopCollect() {
 }
 
 void MemoryPlanner::CollectDone() {
-  if (allocator_ != nullptr) {
-    allocator_->Init();
+  mutex_lock l(mu_);
+  auto best_policy = BestLifetimePolicy();
+  SavePlan(best_policy);
+  // Only the blocks of the best policy are kept, they're read by the
+  // allocators set later.
+  for (auto policy : lifetime_stats_polices_) {
+    if (policy == best_policy) {
+      policy->ReleaseStats();
+    } else {
+      policy->Cleanup();
+    }
+  }
+  best_policy_ = best_policy;
+  plan_ready_ = true;
+  for (auto allocator : allocators_) {
+    allocator->Init();
   }
-  Cleanup();
 }
 
 void MemoryPlanner::Cleanup() {
@@ -136,7 +215,18 @@ void MemoryPlanner::Cleanup() {
 }
 
 void MemoryPlanner::SetAllocator(TensorPoolAllocator* allocator) {
-  allocator_ = allocator;
+  mutex_lock l(mu_);
+  allocators_.emplace_back(allocator);
+  if (plan_ready_.load()) {
+    allocator->Init();
+  }
+}
+
+void MemoryPlanner::RemoveAllocator(TensorPoolAllocator* allocator) {
+  mutex_lock l(mu_);
+  allocators_.erase(
+      std::remove(allocators_.begin(), allocators_.end(), allocator),
+      allocators_.end());
 }
 
 void MemoryPlanner::SetThreadPool(thread::ThreadPool* thread_pool) {
@@ -341,10 +431,108 @@ void LifetimeBin::Cleanup() {
   stats_.clear();
 }
 
+void LifetimePolicy::ReleaseStats() {
+  for (auto bin : bins_) {
+    bin->ReleaseStats();
+  }
+  {
+    std::lock_guard<spin_lock> l(large_bin_lock_);
+    for (auto bin : large_bins_) {
+      bin.second->ReleaseStats();
+    }
+  }
+}
+
+void LifetimePolicy::SavePlan(string* plan) const {
+  strings::StrAppend(plan, kMemoryPlanHeader, " ", interval_, "\n");
+  auto save_bin = [plan](const LifetimeBin* bin) {
+    auto& vblocks = bin->VBlocks();
+    if (bin->BlockSize() == 0 && vblocks.empty()) {
+      return;
+    }
+    strings::StrAppend(plan, bin->BinIndex(), " ", bin->Alignment(), " ",
+                       bin->BlockSize());
+    for (auto vblock : vblocks) {
+      strings::StrAppend(plan, " ", vblock->BinIndex());
+    }
+    strings::StrAppend(plan, "\n");
+  };
+  for (auto bin : bins_) {
+    save_bin(bin);
+  }
+  std::lock_guard<spin_lock> l(large_bin_lock_);
+  for (auto& large_bin : large_bins_) {
+    save_bin(large_bin.second);
+  }
+}
+
+Status LifetimePolicy::RestorePlan(const string& plan) {
+  std::vector<string> lines = str_util::Split(plan, '\n',
+                                              str_util::SkipEmpty());
+  if (lines.empty() ||
+      lines[0] != strings::StrCat(kMemoryPlanHeader, " ", interval_)) {
+    return errors::InvalidArgument("Invalid memory plan header");
+  }
+  std::vector<std::pair<LifetimeBin*, std::vector<uint64>>> vblocks;
+  for (size_t i = 1; i < lines.size(); ++i) {
+    std::vector<string> fields = str_util::Split(lines[i], ' ');
+    std::vector<uint64> values(fields.size());
+    for (size_t j = 0; j < fields.size(); ++j) {
+      if (!strings::safe_strtou64(fields[j], &values[j])) {
+        return errors::InvalidArgument("Invalid memory plan line: ",
+                                       lines[i]);
+      }
+    }
+    if (values.size() < 3) {
+      return errors::InvalidArgument("Invalid memory plan line: ", lines[i]);
+    }
+    auto bin = GetBin(values[0]);
+    bin->RestoreBlocks(values[2], values[1]);
+    vblocks.emplace_back(bin,
+        std::vector<uint64>(values.begin() + 3, values.end()));
+  }
+  for (auto& bin_vblocks : vblocks) {
+    for (auto internal_index : bin_vblocks.second) {
+      if (!bin_vblocks.first->RestoreVBlock(GetBin(internal_index))) {
+        return errors::InvalidArgument("Memory plan bin ", internal_index,
+                                       " of virtual blocks has no blocks");
+      }
+    }
+  }
+  return Status::OK();
+}
+
 size_t LifetimePolicy::Interval() {
   return interval_;
 }
 
+void LifetimeBin::ReleaseStats() {
+  for (auto block : blocks_) {
+    block->ReleaseStats();
+  }
+  std::lock_guard<spin_lock> l(stats_lock_);
+  for (auto s : stats_) {
+    delete s;
+  }
+  stats_.clear();
+}
+
+void LifetimeBin::RestoreBlocks(size_t num_blocks, size_t alignment) {
+  for (size_t i = 0; i < num_blocks; ++i) {
+    blocks_.emplace_back(new AllocBlock(chunk_size_, bin_index_));
+  }
+  max_alignment_ = std::max<int64_t>(max_alignment_, alignment);
+}
+
+bool LifetimeBin::RestoreVBlock(LifetimeBin* internal_bin) {
+  if (internal_bin->blocks_.empty()) {
+    return false;
+  }
+  virtual_blocks_.emplace_back(
+      new VirtualAllocBlock(internal_bin->blocks_[0], chunk_size_));
+  return true;
+}
+
 bool LifetimeBin::BestFit(LifetimePolicy* policy) {
   std::lock_guard<spin_lock> l(stats_lock_);
   if (stats_.empty()) {
@@ -418,6 +606,10 @@ AllocBlock::AllocBlock(size_t size, size_t bin_index)
 }
 
 AllocBlock::~AllocBlock() {
+  ReleaseStats();
+}
+
+void AllocBlock::ReleaseStats() {
   for (auto stats : stats_) {
     delete stats;
   }
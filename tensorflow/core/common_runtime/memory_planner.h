@@ -2,8 +2,10 @@
 #define TENSORFLOW_COMMON_RUNTIME_MEMORYPLANNER_H_
 
 #include "tensorflow/core/lib/core/spin_lock.h"
+#include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
 #include <atomic>
 #include <map>
@@ -57,6 +59,7 @@ class AllocBlock {
 
   void Insert(AllocStats* alloc_stats);
   bool CanInsert(AllocStats* alloc_stats);
+  void ReleaseStats();
   size_t BinIndex() const { return bin_index_; }
 
  private: 
@@ -92,6 +95,12 @@ class LifetimeBin {
   void Dump() const;
   bool BestFit(LifetimePolicy* policy);
   void Cleanup();
+  // Drops the collected lifetimes but keeps the blocks of the plan.
+  void ReleaseStats();
+  // Rebuilds the blocks of a saved plan, the virtual blocks are restored
+  // once all bins have their blocks.
+  void RestoreBlocks(size_t num_blocks, size_t alignment);
+  bool RestoreVBlock(LifetimeBin* internal_bin);
 
   AllocBlock* FindBlock(AllocStats* stats);
 
@@ -102,6 +111,9 @@ class LifetimeBin {
   std::vector<VirtualAllocBlock*>& VBlocks() {
     return virtual_blocks_;
   }
+  const std::vector<VirtualAllocBlock*>& VBlocks() const {
+    return virtual_blocks_;
+  }
 
  private:
   mutable spin_lock stats_lock_;
@@ -125,6 +137,13 @@ class LifetimePolicy {
 
   void Dump() const;
   void Cleanup();
+  void ReleaseStats();
+
+  // Text format of the plan, one line per bin which has blocks:
+  //   <bin_index> <alignment> <num_blocks> [<vblock_bin_index> ...]
+  // after a header of the interval of the policy.
+  void SavePlan(string* plan) const;
+  Status RestorePlan(const string& plan);
 
   AllocBlock* FindBlock(AllocStats* stats, size_t bin_index);
 
@@ -153,7 +172,10 @@ class LifetimePolicy {
 class TensorPoolAllocator;
 class MemoryPlannerBase {
  public:
+  // All the allocators of a process share the plan of the planner, every
+  // allocator is initialized from the same plan once it's ready.
   virtual void SetAllocator(TensorPoolAllocator* allocator) = 0;
+  virtual void RemoveAllocator(TensorPoolAllocator* allocator) = 0;
   virtual void SetThreadPool(thread::ThreadPool* thread_pool) = 0;
   virtual void StartCollect() = 0;
   virtual void StopCollect() = 0;
@@ -166,6 +188,7 @@ class MemoryPlannerBase {
 
 class NullableMemoryPlanner : public MemoryPlannerBase {
   void SetAllocator(TensorPoolAllocator* allocator) override {}
+  void RemoveAllocator(TensorPoolAllocator* allocator) override {}
   void SetThreadPool(thread::ThreadPool* thread_pool) override {}
   void StartCollect() override {}
   void StopCollect() override {}
@@ -185,6 +208,7 @@ class MemoryPlanner : public MemoryPlannerBase {
   virtual ~MemoryPlanner();
 
   void SetAllocator(TensorPoolAllocator* allocator) override;
+  void RemoveAllocator(TensorPoolAllocator* allocator) override;
   void SetThreadPool(thread::ThreadPool* thread_pool) override;
 
   void StartCollect() override;
@@ -199,6 +223,8 @@ class MemoryPlanner : public MemoryPlannerBase {
   void Schedule(std::function<void()> f);
   void InitPolicy();
   void InitStepInfo();
+  void LoadPlan();
+  void SavePlan(LifetimePolicy* policy);
   void CollectDone();
   void Cleanup();
 
@@ -207,7 +233,13 @@ class MemoryPlanner : public MemoryPlannerBase {
   std::atomic_bool is_stats_;
   std::vector<LifetimePolicy*> lifetime_stats_polices_;
 
-  TensorPoolAllocator* allocator_;
+  // The plan is read-only once it's ready, it's either learned by the
+  // first steps or loaded from plan_path_.
+  mutex mu_;
+  std::atomic_bool plan_ready_;
+  LifetimePolicy* best_policy_;
+  std::vector<TensorPoolAllocator*> allocators_ GUARDED_BY(mu_);
+  string plan_path_;
   thread::ThreadPool* thread_pool_;
 
   // step information
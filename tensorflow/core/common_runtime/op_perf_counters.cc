@@ -0,0 +1,280 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#include "tensorflow/core/common_runtime/op_perf_counters.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Bounds the memory of the timeline, the later executions are only
+// aggregated.
+constexpr size_t kMaxTimelineBytes = 64 << 20;
+constexpr int64 kWriteIntervalMicros = 10 * 1000 * 1000;
+constexpr int kCacheLineBytes = 64;
+
+// The perf_event group of the counters of a thread, opened on its first
+// sample. A counter which the CPU or the kernel doesn't support is skipped.
+class ThreadCounters {
+ public:
+  ~ThreadCounters() {
+#if defined(__linux__)
+    for (int i = 0; i < PerfCounterValues::kNumCounters; i++) {
+      if (fds_[i] >= 0) {
+        close(fds_[i]);
+      }
+    }
+#endif
+  }
+
+  bool Read(PerfCounterValues* out) {
+#if defined(__linux__)
+    if (!opened_) {
+      Open();
+    }
+    if (num_counters_ == 0) {
+      return false;
+    }
+    uint64 buf[1 + PerfCounterValues::kNumCounters];
+    if (read(fds_[leader_], buf, sizeof(buf)) <
+        static_cast<ssize_t>((1 + num_counters_) * sizeof(uint64))) {
+      return false;
+    }
+    for (int i = 0; i < PerfCounterValues::kNumCounters; i++) {
+      out->values[i] = slots_[i] >= 0 ? buf[1 + slots_[i]] : 0;
+    }
+    return true;
+#else
+    return false;
+#endif
+  }
+
+ private:
+#if defined(__linux__)
+  void Open() {
+    opened_ = true;
+    const uint64 kDTLBReadMisses =
+        PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const struct {
+      uint32 type;
+      uint64 config;
+    } kEvents[PerfCounterValues::kNumCounters] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HW_CACHE, kDTLBReadMisses},
+    };
+    for (int i = 0; i < PerfCounterValues::kNumCounters; i++) {
+      struct perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = kEvents[i].type;
+      attr.config = kEvents[i].config;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+      const int group = leader_ >= 0 ? fds_[leader_] : -1;
+      fds_[i] = syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+      if (fds_[i] < 0) {
+        continue;
+      }
+      if (leader_ < 0) {
+        leader_ = i;
+      }
+      slots_[i] = num_counters_++;
+    }
+    if (num_counters_ == 0) {
+      LOG_FIRST_N(WARNING, 1) << "perf_event_open failed, the hardware "
+                              << "counters of the ops are not sampled: "
+                              << strerror(errno);
+    }
+  }
+
+  bool opened_ = false;
+  int leader_ = -1;
+  int num_counters_ = 0;
+  int fds_[PerfCounterValues::kNumCounters] = {-1, -1, -1, -1};
+  int slots_[PerfCounterValues::kNumCounters] = {-1, -1, -1, -1};
+#endif
+};
+
+thread_local ThreadCounters thread_counters;
+thread_local int64 thread_executions = 0;
+
+}  // namespace
+
+OpPerfCounters* OpPerfCounters::Global() {
+  static OpPerfCounters* counters = []() -> OpPerfCounters* {
+    string dir;
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_OP_PERF_COUNTERS_DIR", "", &dir));
+    if (dir.empty()) {
+      return nullptr;
+    }
+    int64 sample_every = 1;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_OP_PERF_COUNTERS_SAMPLE_EVERY", 1,
+                                    &sample_every));
+    return new OpPerfCounters(dir, std::max<int64>(sample_every, 1));
+  }();
+  return counters;
+}
+
+OpPerfCounters::OpPerfCounters(const string& dir, int64 sample_every)
+    : dir_(dir), sample_every_(sample_every) {
+  Status s = Env::Default()->RecursivelyCreateDir(dir_);
+  if (!s.ok()) {
+    LOG(WARNING) << "Failed to create " << dir_ << ": " << s;
+  }
+  writer_.reset(Env::Default()->StartThread(
+      ThreadOptions(), "op_perf_counters", [this]() {
+        while (true) {
+          Env::Default()->SleepForMicroseconds(kWriteIntervalMicros);
+          Status s = Write();
+          if (!s.ok()) {
+            LOG(WARNING) << "Failed to write the op perf counters: " << s;
+          }
+        }
+      }));
+}
+
+void OpPerfCounters::Start(Sample* sample) {
+  sample->sampled = false;
+  if (thread_executions++ % sample_every_ != 0) {
+    return;
+  }
+  if (!thread_counters.Read(&sample->start)) {
+    return;
+  }
+  sample->sampled = true;
+  sample->start_nanos = Env::Default()->NowNanos();
+}
+
+void OpPerfCounters::Stop(const Node* node, Sample* sample) {
+  if (!sample->sampled) {
+    return;
+  }
+  PerfCounterValues end;
+  if (!thread_counters.Read(&end)) {
+    return;
+  }
+  const uint64 nanos = Env::Default()->NowNanos() - sample->start_nanos;
+  for (int i = 0; i < PerfCounterValues::kNumCounters; i++) {
+    end.values[i] -= sample->start.values[i];
+  }
+  const string key = Key(node);
+  const uint64 cycles = end.values[PerfCounterValues::kCycles];
+  const string event = strings::StrCat(
+      "\n{\"name\":\"", key, "\",\"ph\":\"X\",\"pid\":0,\"tid\":",
+      Env::Default()->GetCurrentThreadId(), ",\"ts\":",
+      sample->start_nanos / 1000, ",\"dur\":", nanos / 1000,
+      ",\"args\":{\"ipc\":",
+      cycles > 0 ? static_cast<double>(
+                       end.values[PerfCounterValues::kInstructions]) / cycles
+                 : 0.0,
+      ",\"llc_misses\":", end.values[PerfCounterValues::kLLCMisses],
+      ",\"dtlb_misses\":", end.values[PerfCounterValues::kDTLBMisses], "}}");
+  mutex_lock l(mu_);
+  Aggregate& aggregate = aggregates_[key];
+  aggregate.count++;
+  aggregate.nanos += nanos;
+  for (int i = 0; i < PerfCounterValues::kNumCounters; i++) {
+    aggregate.counters.values[i] += end.values[i];
+  }
+  if (timeline_.size() + event.size() < kMaxTimelineBytes) {
+    if (!timeline_.empty()) {
+      timeline_.push_back(',');
+    }
+    timeline_.append(event);
+  }
+}
+
+string OpPerfCounters::Key(const Node* node) {
+  // The ops of an EmbeddingVariable take its handle as first input.
+  const string& type = node->type_string();
+  if (type.compare(0, 2, "Kv") == 0 && node->num_inputs() > 0 &&
+      node->input_type(0) == DT_RESOURCE) {
+    const Node* handle = nullptr;
+    if (node->input_node(0, &handle).ok()) {
+      return strings::StrCat(type, "/", handle->name());
+    }
+  }
+  return type;
+}
+
+string OpPerfCounters::Summary() const {
+  std::vector<std::pair<string, Aggregate>> aggregates;
+  {
+    mutex_lock l(mu_);
+    aggregates.assign(aggregates_.begin(), aggregates_.end());
+  }
+  std::sort(aggregates.begin(), aggregates.end(),
+            [](const std::pair<string, Aggregate>& a,
+               const std::pair<string, Aggregate>& b) {
+              return a.second.nanos > b.second.nanos;
+            });
+  string summary = strings::Printf(
+      "%-60s %10s %12s %6s %12s %12s %8s %8s\n", "op", "samples", "avg_us",
+      "ipc", "llc_miss", "dtlb_miss", "llc_mpki", "est_GB/s");
+  for (const auto& it : aggregates) {
+    const Aggregate& a = it.second;
+    const double count = std::max<int64>(a.count, 1);
+    const double cycles = a.counters.values[PerfCounterValues::kCycles];
+    const double instructions =
+        a.counters.values[PerfCounterValues::kInstructions];
+    const double llc_misses = a.counters.values[PerfCounterValues::kLLCMisses];
+    const double dtlb_misses =
+        a.counters.values[PerfCounterValues::kDTLBMisses];
+    strings::Appendf(
+        &summary, "%-60s %10lld %12.2f %6.2f %12.0f %12.0f %8.2f %8.2f\n",
+        it.first.c_str(), static_cast<long long>(a.count),
+        a.nanos / count / 1000.0, cycles > 0 ? instructions / cycles : 0.0,
+        llc_misses / count, dtlb_misses / count,
+        instructions > 0 ? llc_misses * 1000.0 / instructions : 0.0,
+        a.nanos > 0 ? llc_misses * kCacheLineBytes / a.nanos : 0.0);
+  }
+  return summary;
+}
+
+Status OpPerfCounters::Write() const {
+  TF_RETURN_IF_ERROR(WriteStringToFile(
+      Env::Default(), io::JoinPath(dir_, "op_perf_counters.txt"), Summary()));
+  string timeline = "{\"traceEvents\":[";
+  {
+    mutex_lock l(mu_);
+    timeline.append(timeline_);
+  }
+  timeline.append("\n]}\n");
+  return WriteStringToFile(
+      Env::Default(), io::JoinPath(dir_, "op_perf_counters_timeline.json"),
+      timeline);
+}
+
+}  // namespace tensorflow
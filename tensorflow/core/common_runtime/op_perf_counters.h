@@ -0,0 +1,96 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_OP_PERF_COUNTERS_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_OP_PERF_COUNTERS_H_
+
+#include <map>
+#include <memory>
+
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// The hardware counters of the calling thread, as counted by perf_event.
+struct PerfCounterValues {
+  enum { kCycles, kInstructions, kLLCMisses, kDTLBMisses, kNumCounters };
+  uint64 values[kNumCounters] = {0};
+};
+
+// Samples the hardware counters of the synchronous CPU op executions and
+// aggregates them by op type, and by EmbeddingVariable for the Kv ops, so
+// that the memory bound ops can be told from the compute bound ones.
+//
+// Enabled by the environment variable TF_OP_PERF_COUNTERS_DIR, where a
+// summary, op_perf_counters.txt, and a timeline of the sampled executions
+// in the Chrome trace format, op_perf_counters_timeline.json, are written
+// every 10s. TF_OP_PERF_COUNTERS_SAMPLE_EVERY samples one execution in N
+// per thread, 1 by default. The memory bandwidth is estimated from the last
+// level cache misses, of a cache line each.
+class OpPerfCounters {
+ public:
+  // An execution being sampled.
+  struct Sample {
+    bool sampled = false;
+    uint64 start_nanos;
+    PerfCounterValues start;
+  };
+
+  // Returns null unless enabled.
+  static OpPerfCounters* Global();
+
+  // Starts sampling an execution on the calling thread, unless it is not
+  // sampled or the counters are not available.
+  void Start(Sample* sample);
+  // Records the execution of node if it was sampled.
+  void Stop(const Node* node, Sample* sample);
+
+  // Writes the summary and the timeline to the directory.
+  Status Write() const;
+
+  // Returns the summary, the op types by decreasing total time.
+  string Summary() const;
+
+ private:
+  struct Aggregate {
+    int64 count = 0;
+    uint64 nanos = 0;
+    PerfCounterValues counters;
+  };
+
+  OpPerfCounters(const string& dir, int64 sample_every);
+
+  static string Key(const Node* node);
+
+  const string dir_;
+  const int64 sample_every_;
+  std::unique_ptr<Thread> writer_;
+
+  mutable mutex mu_;
+  std::map<string, Aggregate> aggregates_ GUARDED_BY(mu_);
+  // The Chrome trace events of the sampled executions.
+  string timeline_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(OpPerfCounters);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_OP_PERF_COUNTERS_H_
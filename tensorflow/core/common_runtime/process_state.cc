@@ -22,6 +22,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/pool_allocator.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/log_memory.h"
+#include "tensorflow/core/framework/memory_attribution.h"
 #include "tensorflow/core/framework/tracking_allocator.h"
 #include "tensorflow/core/lib/gtl/stl_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
@@ -114,6 +115,10 @@ Allocator* ProcessState::GetCPUAllocator(int numa_node) {
       // at the cost of performance.
       allocator = new TrackingAllocator(allocator, true);
     }
+    if (MemoryAttribution::Global() != nullptr) {
+      allocator = MemoryAttribution::Global()->NewDeviceAllocator(
+          allocator, false /*owns_allocator*/);
+    }
     cpu_allocators_.push_back(allocator);
     if (!sub_allocator) {
       DCHECK(cpu_alloc_visitors_.empty() && cpu_free_visitors_.empty());
@@ -112,7 +112,7 @@ void NodeExecStatsWrapper::Done(const string& device) {
 
 void NodeExecStatsWrapper::RecordExecutorStarted() {
   int64 now_nanos = Env::Default()->NowNanos();
-  stats_->set_all_start_micros(now_nanos / EnvTime::kMicrosToNanos);
+  stats_->set_all_start_micros(now_nanos / kMicrosToNanos);
   stats_->set_all_start_nanos(now_nanos);
 }
 
@@ -120,7 +120,7 @@ void NodeExecStatsWrapper::RecordComputeStarted() {
   int64 now_nanos = Env::Default()->NowNanos();
   DCHECK_NE(stats_->all_start_micros(), 0);
   DCHECK_NE(stats_->all_start_nanos(), 0);
-  stats_->set_op_start_rel_micros(now_nanos / EnvTime::kMicrosToNanos -
+  stats_->set_op_start_rel_micros(now_nanos / kMicrosToNanos -
                                   stats_->all_start_micros());
   stats_->set_op_start_rel_nanos(now_nanos - stats_->all_start_nanos());
 }
@@ -129,7 +129,7 @@ void NodeExecStatsWrapper::RecordComputeEnded() {
   int64 now_nanos = Env::Default()->NowNanos();
   DCHECK_NE(stats_->all_start_micros(), 0);
   DCHECK_NE(stats_->all_start_nanos(), 0);
-  stats_->set_op_end_rel_micros(now_nanos / EnvTime::kMicrosToNanos -
+  stats_->set_op_end_rel_micros(now_nanos / kMicrosToNanos -
                                 stats_->all_start_micros());
   stats_->set_op_end_rel_nanos(now_nanos - stats_->all_start_nanos());
 }
@@ -138,13 +138,13 @@ void NodeExecStatsWrapper::RecordExecutorEnded() {
   int64 now_nanos = Env::Default()->NowNanos();
   DCHECK_NE(stats_->all_start_micros(), 0);
   DCHECK_NE(stats_->all_start_nanos(), 0);
-  stats_->set_all_end_rel_micros(now_nanos / EnvTime::kMicrosToNanos -
+  stats_->set_all_end_rel_micros(now_nanos / kMicrosToNanos -
                                  stats_->all_start_micros());
   stats_->set_all_end_rel_nanos(now_nanos - stats_->all_start_nanos());
 }
 
 void NodeExecStatsWrapper::SetScheduled(int64 nanos) {
-  stats_->set_scheduled_micros(nanos / EnvTime::kMicrosToNanos);
+  stats_->set_scheduled_micros(nanos / kMicrosToNanos);
   stats_->set_scheduled_nanos(nanos);
 }
 
@@ -576,4 +576,25 @@ void StepStatsCollector::FinalizeInternal() {
     }
   }
 }
+void RecordWaitInStepStats(OpKernelContext* ctx, const string& label,
+                           int64 start_nanos, int64 wait_nanos) {
+  StepStatsCollector* collector =
+      dynamic_cast<StepStatsCollector*>(ctx->stats_collector());
+  if (collector == nullptr || wait_nanos <= 0) {
+    return;
+  }
+  const int64 kMicrosToNanos = EnvTime::kMicrosToNanos;
+  NodeExecStats* stats = new NodeExecStats();
+  stats->set_node_name(strings::StrCat(ctx->op_kernel().name(), "/", label));
+  stats->set_all_start_micros(start_nanos / kMicrosToNanos);
+  stats->set_all_start_nanos(start_nanos);
+  stats->set_op_end_rel_micros(wait_nanos / kMicrosToNanos);
+  stats->set_op_end_rel_nanos(wait_nanos);
+  stats->set_all_end_rel_micros(wait_nanos / kMicrosToNanos);
+  stats->set_all_end_rel_nanos(wait_nanos);
+  stats->set_timeline_label(
+      strings::StrCat(stats->node_name(), " = ", label, "()"));
+  collector->Save(ctx->device()->name(), stats);
+}
+
 }  // namespace tensorflow
@@ -213,6 +213,12 @@ class StepStatsCollector : public StepStatsCollectorInterface {
   uint64 collected_nodes_ GUARDED_BY(mu_) = 0;
 };
 
+// Records that the op run by `ctx` was blocked for `wait_nanos` from
+// `start_nanos` as the node `<op name>/<label>` of the step stats, if the
+// step collects them, so that the wait shows apart from the op in timelines.
+void RecordWaitInStepStats(OpKernelContext* ctx, const string& label,
+                           int64 start_nanos, int64 wait_nanos);
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STEP_STATS_COLLECTOR_H_
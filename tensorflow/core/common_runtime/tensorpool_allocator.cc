@@ -2,6 +2,7 @@
 #include "tensorflow/core/common_runtime/tensorpool_allocator.h"
 #include "tensorflow/core/framework/allocator_registry.h"
 #include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/util/env_var.h"
 #include <sys/time.h>
 
 #define likely(x) __builtin_expect(!!(x), 1)
@@ -105,10 +106,22 @@ TensorPoolAllocator::TensorPoolAllocator() :
     large_bin_index_(0),
     null_bin_counter_(0),
     hit_counter_(0),
-    missed_counter_(0) {
+    missed_counter_(0),
+    static_arena_(false),
+    arena_(nullptr) {
+  Status s = ReadBoolFromEnvVar("TENSORPOOL_STATIC_ARENA", false,
+      &static_arena_);
+  if (!s.ok()) {
+    LOG(FATAL) << "Read TENSORPOOL_STATIC_ARENA envrionment error. "
+               << s.error_message();
+  }
   mem_planner_->SetAllocator(this);
 }
 
+TensorPoolAllocator::~TensorPoolAllocator() {
+  mem_planner_->RemoveAllocator(this);
+}
+
 void TensorPoolAllocator::Init() {
   bool tmp = false;
   if (initing_.compare_exchange_strong(tmp, true)) {
@@ -120,15 +133,53 @@ void TensorPoolAllocator::Init() {
     alignment_offset_ = lifetime_policy->AlignmentOffset();
 
     auto policy_large_bins = lifetime_policy->GetLargeBins();
+    auto policy_bins = lifetime_policy->GetBins();
+
+    // In static arena mode the blocks of the plan, which are the colors of
+    // the lifetimes of every bin, are laid out in one region by offsets.
+    size_t arena_offset = 0;
+    auto arena_chunk = [this, &arena_offset](LifetimeBin* bin_info) {
+      if (arena_ == nullptr) {
+        return static_cast<char*>(nullptr);
+      }
+      arena_offset = RoundedBytes(arena_offset, bin_info->Alignment());
+      auto p = static_cast<char*>(arena_) + arena_offset;
+      arena_offset += RoundedBytes(bin_info->ChunkSize(),
+          bin_info->Alignment()) * bin_info->BlockSize();
+      return p;
+    };
+    if (static_arena_) {
+      size_t arena_alignment = Allocator::kAllocatorAlignment;
+      auto plan_bin = [&arena_offset, &arena_alignment](
+          LifetimeBin* bin_info) {
+        arena_alignment = std::max(arena_alignment, bin_info->Alignment());
+        arena_offset = RoundedBytes(arena_offset, bin_info->Alignment()) +
+            RoundedBytes(bin_info->ChunkSize(), bin_info->Alignment()) *
+            bin_info->BlockSize();
+      };
+      for (auto rit = policy_large_bins.rbegin();
+          rit != policy_large_bins.rend(); ++rit) {
+        plan_bin(rit->second);
+      }
+      for (auto it = policy_bins.rbegin(); it != policy_bins.rend(); ++it) {
+        plan_bin(*it);
+      }
+      if (arena_offset > 0) {
+        arena_ = sub_allocator_->Alloc(arena_alignment, arena_offset);
+        LOG(INFO) << "TensorPoolAllocator static arena size:"
+                  << arena_offset;
+      }
+      arena_offset = 0;
+    }
+
     for (auto rit = policy_large_bins.rbegin();
         rit != policy_large_bins.rend(); ++rit) {
       auto bin_info = rit->second;
       auto bin = new Bin(bin_info->BlockSize(), bin_info->ChunkSize(),
           bin_info->Alignment(), bin_info->VBlocks(), 
-          sub_allocator_.get(), this);
+          sub_allocator_.get(), this, arena_chunk(bin_info));
       large_lifetime_bins_.emplace(rit->first, bin);
     }
-    auto policy_bins = lifetime_policy->GetBins();
     large_bin_index_ = policy_bins.size();
     lifetime_bins_.resize(large_bin_index_);
 
@@ -139,7 +190,7 @@ void TensorPoolAllocator::Init() {
       if ((*it)->BlockSize() > 0 || (*it)->VBlocks().size() > 0) {
         bin = new Bin((*it)->BlockSize(), (*it)->ChunkSize(),
             (*it)->Alignment(), (*it)->VBlocks(), 
-            sub_allocator_.get(), this);
+            sub_allocator_.get(), this, arena_chunk(*it));
       }
       lifetime_bins_[(*it)->BinIndex()] = bin;
     }
@@ -199,8 +250,8 @@ TensorPoolAllocator::Bin* TensorPoolAllocator::GetBin(
 TensorPoolAllocator::Bin::Bin(size_t len,
     size_t chunk_size, size_t alignment,
     std::vector<VirtualAllocBlock*>& vblocks,
-    SubAllocator* sub_allocator, TensorPoolAllocator* tp) :
-  buffer_(len, chunk_size, alignment, sub_allocator),
+    SubAllocator* sub_allocator, TensorPoolAllocator* tp, char* arena) :
+  buffer_(len, chunk_size, alignment, sub_allocator, arena),
   virtual_buffer_(vblocks, tp), sub_allocator_(sub_allocator) {
 }
 
@@ -235,19 +286,32 @@ void TensorPoolAllocator::Bin::DeallocateRaw(void* p) {
 }
 
 TensorPoolAllocator::Buffer::Buffer(size_t len, size_t chunk_size,
-    size_t alignment, SubAllocator* sub_allocator) {
-  auto rounded_bytes = RoundedBytes(chunk_size, alignment);
-  auto buffer_size = rounded_bytes * len;
+    size_t alignment, SubAllocator* sub_allocator, char* arena) :
+  len_(len), rounded_bytes_(RoundedBytes(chunk_size, alignment)),
+  cursor_(0) {
+  auto buffer_size = rounded_bytes_ * len;
+  if (arena != nullptr) {
+    begin_ = arena;
+    end_ = arena + buffer_size;
+    in_use_.reset(new std::atomic_bool[len]);
+    for (auto i = 0; i < len; ++i) {
+      in_use_[i] = false;
+    }
+    return;
+  }
   auto p = static_cast<char*>(sub_allocator->Alloc(alignment, buffer_size));
   begin_ = p;
   end_ = p + buffer_size;
 
   for (auto i = 0; i < len; ++i) {
-    buffer_.emplace(p + rounded_bytes *i);
+    buffer_.emplace(p + rounded_bytes_ *i);
   }
 }
 
 void* TensorPoolAllocator::Buffer::Allocate() {
+  if (in_use_ != nullptr) {
+    return ArenaAllocate();
+  }
   std::lock_guard<spin_lock> l(lock_);
   if (unlikely(buffer_.empty())) {
     return nullptr;
@@ -261,10 +325,34 @@ void TensorPoolAllocator::Buffer::Deallocate(void* p) {
   if (unlikely(p < begin_ || p > end_)) {
     LOG(WARNING) << "probabaly memory corruption!!";
   }
+  if (in_use_ != nullptr) {
+    ArenaDeallocate(p);
+    return;
+  }
   std::lock_guard<spin_lock> l(lock_);
   buffer_.emplace(p);
 }
 
+// The chunks are taken in order by every step, so the cursor mostly finds
+// the next chunk free, it probes the others when the next one is in use.
+void* TensorPoolAllocator::Buffer::ArenaAllocate() {
+  for (size_t n = 0; n < len_; ++n) {
+    auto i = cursor_.fetch_add(1, std::memory_order_relaxed) % len_;
+    bool expected = false;
+    if (in_use_[i].compare_exchange_strong(expected, true,
+          std::memory_order_acquire)) {
+      return static_cast<char*>(begin_) + rounded_bytes_ * i;
+    }
+  }
+  return nullptr;
+}
+
+void TensorPoolAllocator::Buffer::ArenaDeallocate(void* p) {
+  auto i = (static_cast<char*>(p) - static_cast<char*>(begin_)) /
+      rounded_bytes_;
+  in_use_[i].store(false, std::memory_order_release);
+}
+
 TensorPoolAllocator::VirtualBuffer::VirtualBuffer(
     std::vector<VirtualAllocBlock*>& vblocks,
     TensorPoolAllocator* tp) {
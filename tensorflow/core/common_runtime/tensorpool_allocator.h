@@ -43,7 +43,7 @@ class VirtualAllocBlock;
 class TensorPoolAllocator : public Allocator {
  public:
   TensorPoolAllocator();
-  ~TensorPoolAllocator() override {}
+  ~TensorPoolAllocator() override;
 
   TensorPoolAllocator(const TensorPoolAllocator&) = delete;
   TensorPoolAllocator& operator=(const TensorPoolAllocator&) = delete;
@@ -75,24 +75,38 @@ class TensorPoolAllocator : public Allocator {
 
   class Buffer {
    public:
-    Buffer(size_t len, size_t chunk_size,
-        size_t alignment, SubAllocator* sub_allocator);
+    // The chunks are carved from arena when it isn't nullptr, a chunk of
+    // the static arena is picked by a bump cursor over the chunks instead
+    // of the locked free list.
+    Buffer(size_t len, size_t chunk_size, size_t alignment,
+        SubAllocator* sub_allocator, char* arena);
 
     void* Allocate();
     void Deallocate(void* p);
 
+   private:
+    void* ArenaAllocate();
+    void ArenaDeallocate(void* p);
+
    private:
     mutable spin_lock lock_;
     std::stack<void*> buffer_;
     void* begin_;
     void* end_;
+
+    // static arena
+    size_t len_;
+    size_t rounded_bytes_;
+    std::unique_ptr<std::atomic_bool[]> in_use_;
+    std::atomic<size_t> cursor_;
   };
 
   class Bin {
    public:
     Bin(size_t len, size_t chunk_size, size_t alignment,
         std::vector<VirtualAllocBlock*>& vblocks,
-        SubAllocator* sub_allocator, TensorPoolAllocator* tp);
+        SubAllocator* sub_allocator, TensorPoolAllocator* tp,
+        char* arena);
     virtual ~Bin(){}
 
     Bin(const Bin&) = delete;
@@ -129,6 +143,10 @@ class TensorPoolAllocator : public Allocator {
 
   size_t alignment_;
   size_t alignment_offset_;
+
+  // All the planned chunks live in one region in static arena mode.
+  bool static_arena_;
+  void* arena_;
  
   // Statistic
   std::atomic<int64_t> null_bin_counter_;
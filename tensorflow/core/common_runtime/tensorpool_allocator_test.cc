@@ -12,6 +12,7 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
+#include <set>
 #include <thread>
 #include "tensorflow/core/common_runtime/memory_planner.h"
 #include "tensorflow/core/common_runtime/tensorpool_allocator.h"
@@ -249,6 +250,57 @@ TEST(TensorPoolAllocatorTest, MemoryPlannerMemoryConsumption) {
   sleep(1);
 }
 
+TEST(TensorPoolAllocatorTest, StaticArenaAllocation) {
+  thread::ThreadPool* threads = new thread::ThreadPool(Env::Default(), "test", 2);
+  MemoryPlannerFactory::GetMemoryPlanner()->Reset();
+  MemoryPlannerFactory::GetMemoryPlanner()->SetThreadPool(threads);
+  setenv("TENSORPOOL_STATIC_ARENA", "true", 1);
+  TensorPoolAllocator allocator;
+  unsetenv("TENSORPOOL_STATIC_ARENA");
+  for (int i = 0; i < 2000; ++i) {
+    ScopedMemoryCollector c;
+    std::vector<int> sizes = {128*1024, 64*1024, 64*1024, 2*1024*1024};
+    std::vector<void*> vec;
+    for (auto size : sizes) {
+      void* p = allocator.AllocateRaw(64, size);
+      EXPECT_TRUE(p != nullptr);
+      memset(p, 0, size);
+      vec.emplace_back(p);
+    }
+    std::set<void*> distinct(vec.begin(), vec.end());
+    EXPECT_EQ(distinct.size(), vec.size());
+    for (auto p : vec) {
+      allocator.DeallocateRaw(p);
+    }
+  }
+  sleep(1);
+}
+
+TEST(TensorPoolAllocatorTest, MemoryPlanSaveAndRestore) {
+  LifetimePolicy policy(_4KB, _4KB_OFFSET, _32KB);
+  std::vector<size_t> sizes = {64 * 1024, 128 * 1024, 64 * 1024, 40 * 1024 * 1024};
+  for (int i = 0; i < sizes.size(); ++i) {
+    policy.TrackAllocate(64, sizes[i]);
+    Header header;
+    header.begin = i;
+    header.total_size = sizes[i];
+    policy.TrackDeallocate(&header);
+  }
+  policy.BestFit();
+  string plan;
+  policy.SavePlan(&plan);
+
+  LifetimePolicy restored(_4KB, _4KB_OFFSET, _32KB);
+  TF_EXPECT_OK(restored.RestorePlan(plan));
+  string restored_plan;
+  restored.SavePlan(&restored_plan);
+  EXPECT_EQ(plan, restored_plan);
+  EXPECT_EQ(policy.TotalMem(), restored.TotalMem());
+
+  LifetimePolicy other(_8KB, _8KB_OFFSET, _32KB);
+  EXPECT_FALSE(other.RestorePlan(plan).ok());
+}
+
 TEST(TensorPoolAllocatorTest, HugeMemoryAllocation) {
   thread::ThreadPool* threads = new thread::ThreadPool(Env::Default(), "test", 2);
   MemoryPlannerFactory::GetMemoryPlanner()->Reset();
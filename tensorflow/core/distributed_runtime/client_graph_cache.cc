@@ -0,0 +1,319 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/client_graph_cache.h"
+
+#include <unordered_set>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Hashes the options of opts the client graph depends on, but the fetches
+// unless with_fetches.
+uint64 HashOptions(const BuildGraphOptions& opts, bool with_fetches) {
+  CallableOptions callable_options = opts.callable_options;
+  if (!with_fetches) {
+    callable_options.clear_fetch();
+  }
+  // Only the debug options of the run options rewrite the client graph.
+  DebugOptions debug_options = callable_options.run_options().debug_options();
+  callable_options.clear_run_options();
+  callable_options.mutable_run_options()->mutable_debug_options()->Swap(
+      &debug_options);
+
+  uint64 h = DeterministicProtoHash64(callable_options);
+  h = Hash64Combine(h, opts.use_function_convention);
+  h = Hash64Combine(h, opts.collective_graph_key);
+  return Hash64Combine(h, static_cast<uint64>(opts.collective_order));
+}
+
+std::unique_ptr<ClientGraph> CopyClientGraph(const ClientGraph& client_graph,
+                                             const Graph& graph,
+                                             DataTypeVector fetch_types) {
+  std::unique_ptr<ClientGraph> copy(new ClientGraph(
+      std::unique_ptr<FunctionLibraryDefinition>(
+          new FunctionLibraryDefinition(*client_graph.flib_def)),
+      client_graph.feed_types, std::move(fetch_types),
+      client_graph.collective_graph_key));
+  // Copied, as GraphExecutionState::BuildGraph does, to make the node ids
+  // dense.
+  CopyGraph(graph, &copy->graph);
+  return copy;
+}
+
+// Prunes client_graph, built for a superset of the fetches of opts with the
+// same feeds and targets, to the fetches of opts whose types are in
+// fetch_types.
+Status PruneClientGraph(
+    const ClientGraph& client_graph,
+    const std::unordered_map<string, DataType>& fetch_types,
+    const BuildGraphOptions& opts, std::unique_ptr<ClientGraph>* out) {
+  const CallableOptions& callable_options = opts.callable_options;
+  if (opts.collective_graph_key == BuildGraphOptions::kNoCollectiveGraphKey &&
+      client_graph.collective_graph_key !=
+          BuildGraphOptions::kNoCollectiveGraphKey) {
+    // The key is derived from the collectives, which pruning may remove.
+    return errors::Unimplemented("Pruning a graph of collectives");
+  }
+  const std::unordered_set<string> fetches(callable_options.fetch().begin(),
+                                           callable_options.fetch().end());
+  const std::unordered_set<string> targets(callable_options.target().begin(),
+                                           callable_options.target().end());
+  if (fetches.size() != static_cast<size_t>(callable_options.fetch_size())) {
+    return errors::InvalidArgument("Duplicate fetches");
+  }
+
+  Graph graph(client_graph.flib_def.get());
+  CopyGraph(client_graph.graph, &graph);
+  // The fetches are the _Send nodes terminated by the client, named by the
+  // tensor_name of the rewrite, see subgraph::SendFetchRewrite.
+  std::unordered_set<const Node*> roots;
+  size_t num_fetches = 0;
+  for (Node* node : graph.op_nodes()) {
+    if (targets.count(node->name()) > 0) {
+      roots.insert(node);
+    } else if (node->type_string() == "_Send") {
+      bool client_terminated = false;
+      string tensor_name;
+      if (GetNodeAttr(node->attrs(), "client_terminated", &client_terminated)
+              .ok() &&
+          client_terminated &&
+          GetNodeAttr(node->attrs(), "tensor_name", &tensor_name).ok() &&
+          fetches.count(tensor_name) > 0) {
+        roots.insert(node);
+        ++num_fetches;
+      }
+    }
+  }
+  if (num_fetches != fetches.size()) {
+    return errors::NotFound("Some fetches are not in the cached graph");
+  }
+  PruneForReverseReachability(&graph, std::move(roots));
+  FixupSourceAndSinkEdges(&graph);
+
+  DataTypeVector types;
+  types.reserve(callable_options.fetch_size());
+  for (const string& fetch : callable_options.fetch()) {
+    types.push_back(fetch_types.at(fetch));
+  }
+  *out = CopyClientGraph(client_graph, graph, std::move(types));
+  return Status::OK();
+}
+
+}  // namespace
+
+ClientGraphCache::ClientGraphCache(int64 capacity) : capacity_(capacity) {}
+
+ClientGraphCache* ClientGraphCache::Global() {
+  static ClientGraphCache* cache = []() -> ClientGraphCache* {
+    int64 capacity = 0;
+    TF_CHECK_OK(
+        ReadInt64FromEnvVar("TF_CLIENT_GRAPH_CACHE_CAPACITY", 0, &capacity));
+    if (capacity <= 0) {
+      return nullptr;
+    }
+    LOG(INFO) << "Caching up to " << capacity << " client graphs.";
+    return new ClientGraphCache(capacity);
+  }();
+  return cache;
+}
+
+uint64 ClientGraphCache::Fingerprint(const GraphDef& graph_def,
+                                     const DeviceSet& devices,
+                                     const ConfigProto& config) {
+  uint64 h = DeterministicProtoHash64(graph_def);
+  for (const Device* device : devices.devices()) {
+    h = Hash64(device->name().data(), device->name().size(), h);
+    h = Hash64Combine(h, device->attributes().incarnation());
+  }
+  return DeterministicProtoHash64(config, h);
+}
+
+uint64 ClientGraphCache::Extend(uint64 graph_fingerprint,
+                                const GraphDef& extension_def) {
+  return DeterministicProtoHash64(extension_def, graph_fingerprint);
+}
+
+Status ClientGraphCache::BuildGraph(uint64 graph_fingerprint,
+                                    const BuildGraphOptions& opts,
+                                    GraphExecutionState* execution_state,
+                                    std::unique_ptr<ClientGraph>* out) {
+  const uint64 key = Hash64Combine(graph_fingerprint, HashOptions(opts, true));
+  const uint64 signature =
+      Hash64Combine(graph_fingerprint, HashOptions(opts, false));
+
+  std::shared_ptr<const ClientGraph> cached;
+  std::shared_ptr<const ClientGraph> superset;
+  std::unordered_map<string, DataType> superset_fetch_types;
+  {
+    mutex_lock l(mu_);
+    Entry* entry = Lookup(key);
+    if (entry != nullptr) {
+      cached = entry->client_graph;
+      ++num_hits_;
+    } else if ((entry = LookupSuperset(signature, opts)) != nullptr) {
+      superset = entry->client_graph;
+      superset_fetch_types = entry->fetch_types;
+    }
+  }
+  if (cached) {
+    VLOG(1) << "Reusing the cached client graph " << key;
+    *out = CopyClientGraph(*cached, cached->graph, cached->fetch_types);
+    return Status::OK();
+  }
+
+  if (superset) {
+    Status s = PruneClientGraph(*superset, superset_fetch_types, opts, out);
+    if (s.ok()) {
+      VLOG(1) << "Pruned the client graph " << key << " from a cached one";
+      {
+        mutex_lock l(mu_);
+        ++num_pruned_hits_;
+      }
+      Insert(key, signature, opts, **out);
+      return Status::OK();
+    }
+    VLOG(1) << "Building the client graph " << key << ": " << s;
+  }
+
+  TF_RETURN_IF_ERROR(execution_state->BuildGraph(opts, out));
+  Insert(key, signature, opts, **out);
+  return Status::OK();
+}
+
+bool ClientGraphCache::LookupPartitions(
+    uint64 graph_fingerprint, const BuildGraphOptions& opts,
+    std::unordered_map<string, GraphDef>* out) {
+  const uint64 key = Hash64Combine(graph_fingerprint, HashOptions(opts, true));
+  std::shared_ptr<const Partitions> partitions;
+  {
+    mutex_lock l(mu_);
+    Entry* entry = Lookup(key);
+    if (entry == nullptr || !entry->partitions) {
+      return false;
+    }
+    partitions = entry->partitions;
+  }
+  VLOG(1) << "Reusing the cached partitions of the client graph " << key;
+  *out = *partitions;
+  return true;
+}
+
+void ClientGraphCache::InsertPartitions(
+    uint64 graph_fingerprint, const BuildGraphOptions& opts,
+    const std::unordered_map<string, GraphDef>& partitions) {
+  const uint64 key = Hash64Combine(graph_fingerprint, HashOptions(opts, true));
+  std::shared_ptr<const Partitions> copy =
+      std::make_shared<const Partitions>(partitions);
+  mutex_lock l(mu_);
+  Entry* entry = Lookup(key);
+  if (entry != nullptr) {
+    entry->partitions = std::move(copy);
+  }
+}
+
+int64 ClientGraphCache::num_hits() {
+  mutex_lock l(mu_);
+  return num_hits_;
+}
+
+int64 ClientGraphCache::num_pruned_hits() {
+  mutex_lock l(mu_);
+  return num_pruned_hits_;
+}
+
+ClientGraphCache::Entry* ClientGraphCache::Lookup(uint64 key) {
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    return nullptr;
+  }
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return &entries_.front();
+}
+
+ClientGraphCache::Entry* ClientGraphCache::LookupSuperset(
+    uint64 signature, const BuildGraphOptions& opts) {
+  if (opts.use_function_convention) {
+    // The _Retval nodes are indexed by the position of their fetch.
+    return nullptr;
+  }
+  auto best = entries_.end();
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    if (it->signature != signature || it->use_function_convention) {
+      continue;
+    }
+    bool includes_fetches = true;
+    for (const string& fetch : opts.callable_options.fetch()) {
+      if (it->fetch_types.count(fetch) == 0) {
+        includes_fetches = false;
+        break;
+      }
+    }
+    if (includes_fetches &&
+        (best == entries_.end() || it->client_graph->graph.num_nodes() <
+                                       best->client_graph->graph.num_nodes())) {
+      best = it;
+    }
+  }
+  if (best == entries_.end()) {
+    return nullptr;
+  }
+  entries_.splice(entries_.begin(), entries_, best);
+  return &entries_.front();
+}
+
+void ClientGraphCache::Insert(uint64 key, uint64 signature,
+                              const BuildGraphOptions& opts,
+                              const ClientGraph& client_graph) {
+  Entry entry;
+  entry.key = key;
+  entry.signature = signature;
+  entry.use_function_convention = opts.use_function_convention;
+  const CallableOptions& callable_options = opts.callable_options;
+  for (int i = 0; i < callable_options.fetch_size(); ++i) {
+    entry.fetch_types[callable_options.fetch(i)] =
+        client_graph.fetch_types[i];
+  }
+  entry.client_graph =
+      CopyClientGraph(client_graph, client_graph.graph,
+                      client_graph.fetch_types);
+
+  mutex_lock l(mu_);
+  if (index_.count(key) > 0) {
+    // Built concurrently by another session.
+    return;
+  }
+  entries_.push_front(std::move(entry));
+  index_[key] = entries_.begin();
+  while (entries_.size() > static_cast<size_t>(capacity_)) {
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,124 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_CLIENT_GRAPH_CACHE_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_CLIENT_GRAPH_CACHE_H_
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include "tensorflow/core/common_runtime/build_graph_options.h"
+#include "tensorflow/core/common_runtime/device_set.h"
+#include "tensorflow/core/common_runtime/graph_execution_state.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+
+namespace tensorflow {
+
+// Caches the optimized client graphs and their partitions across the master
+// sessions of a process, so that a session created again for the same graph,
+// e.g. by a MonitoredSession recovering from a failure or by a new callable,
+// does not prune, optimize and partition the whole graph again.
+//
+// The entries are keyed by the fingerprint of the graph of the session, of
+// its devices and of its config, plus the feeds, fetches and targets of the
+// BuildGraphOptions. A client graph whose fetches are a subset of the
+// fetches of a cached entry with the same feeds and targets is pruned from
+// the entry, instead of being built from the whole graph.
+//
+// Enabled by the environment variable TF_CLIENT_GRAPH_CACHE_CAPACITY, the
+// number of entries kept, the least recently used first evicted.
+class ClientGraphCache {
+ public:
+  explicit ClientGraphCache(int64 capacity);
+
+  // Returns null unless enabled.
+  static ClientGraphCache* Global();
+
+  // Returns the fingerprint of graph_def placed on devices under config.
+  static uint64 Fingerprint(const GraphDef& graph_def, const DeviceSet& devices,
+                            const ConfigProto& config);
+
+  // Returns the fingerprint of graph_fingerprint extended by extension_def.
+  static uint64 Extend(uint64 graph_fingerprint,
+                       const GraphDef& extension_def);
+
+  // Builds the client graph of opts as execution_state->BuildGraph, reusing
+  // a cached one if any. execution_state is the state of the graph of
+  // graph_fingerprint.
+  Status BuildGraph(uint64 graph_fingerprint, const BuildGraphOptions& opts,
+                    GraphExecutionState* execution_state,
+                    std::unique_ptr<ClientGraph>* out);
+
+  // Copies the cached partitions of the client graph of opts to out, returns
+  // false if they are not cached.
+  bool LookupPartitions(uint64 graph_fingerprint, const BuildGraphOptions& opts,
+                        std::unordered_map<string, GraphDef>* out);
+
+  // Caches the partitions of the client graph of opts, built by BuildGraph.
+  void InsertPartitions(uint64 graph_fingerprint, const BuildGraphOptions& opts,
+                        const std::unordered_map<string, GraphDef>& partitions);
+
+  // The number of client graphs copied from an entry of the same options,
+  // and pruned from an entry of more fetches.
+  int64 num_hits();
+  int64 num_pruned_hits();
+
+ private:
+  typedef std::unordered_map<string, GraphDef> Partitions;
+
+  struct Entry {
+    uint64 key;
+    // The hash of the feeds, targets and other options but the fetches.
+    uint64 signature;
+    bool use_function_convention;
+    // The types of the fetches.
+    std::unordered_map<string, DataType> fetch_types;
+    std::shared_ptr<const ClientGraph> client_graph;
+    std::shared_ptr<const Partitions> partitions;
+  };
+  typedef std::list<Entry> EntryList;
+
+  // Returns the entry of key, moved to the front, or null.
+  Entry* Lookup(uint64 key) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Returns the entry with the signature and the fewest nodes whose fetches
+  // include those of opts, or null.
+  Entry* LookupSuperset(uint64 signature, const BuildGraphOptions& opts)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Caches a copy of client_graph as the entry of key.
+  void Insert(uint64 key, uint64 signature, const BuildGraphOptions& opts,
+              const ClientGraph& client_graph) LOCKS_EXCLUDED(mu_);
+
+  const int64 capacity_;
+
+  mutex mu_;
+  // Most recently used first.
+  EntryList entries_ GUARDED_BY(mu_);
+  std::unordered_map<uint64, EntryList::iterator> index_ GUARDED_BY(mu_);
+  int64 num_hits_ GUARDED_BY(mu_) = 0;
+  int64 num_pruned_hits_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ClientGraphCache);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_CLIENT_GRAPH_CACHE_H_
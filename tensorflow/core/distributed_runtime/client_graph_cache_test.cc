@@ -0,0 +1,150 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/client_graph_cache.h"
+
+#include <set>
+
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+class ClientGraphCacheTest : public ::testing::Test {
+ protected:
+  ClientGraphCacheTest() : cache_(4) {
+    (*options_.config.mutable_device_count())["CPU"] = 1;
+    options_.config.mutable_graph_options()
+        ->mutable_rewrite_options()
+        ->set_disable_meta_optimizer(true);
+    TF_CHECK_OK(DeviceFactory::AddDevices(
+        options_, "/job:localhost/replica:0/task:0", &devices_));
+    for (const auto& device : devices_) {
+      device_set_.AddDevice(device.get());
+    }
+    device_set_.set_client_device(devices_[0].get());
+
+    // x -> a = Neg(x), x -> b = Square(x)
+    GraphDef graph_def;
+    TF_CHECK_OK(NodeDefBuilder("x", "Placeholder")
+                    .Attr("dtype", DT_FLOAT)
+                    .Finalize(graph_def.add_node()));
+    TF_CHECK_OK(NodeDefBuilder("a", "Neg")
+                    .Input("x", 0, DT_FLOAT)
+                    .Finalize(graph_def.add_node()));
+    TF_CHECK_OK(NodeDefBuilder("b", "Square")
+                    .Input("x", 0, DT_FLOAT)
+                    .Finalize(graph_def.add_node()));
+    fingerprint_ =
+        ClientGraphCache::Fingerprint(graph_def, device_set_, options_.config);
+
+    GraphExecutionStateOptions execution_options;
+    execution_options.device_set = &device_set_;
+    execution_options.session_options = &options_;
+    TF_CHECK_OK(GraphExecutionState::MakeForBaseGraph(
+        std::move(graph_def), execution_options, &execution_state_));
+  }
+
+  static BuildGraphOptions Options(const std::vector<string>& fetches) {
+    BuildGraphOptions opts;
+    opts.callable_options.add_feed("x:0");
+    for (const string& fetch : fetches) {
+      opts.callable_options.add_fetch(fetch);
+    }
+    return opts;
+  }
+
+  static std::set<string> NodeNames(const ClientGraph& client_graph) {
+    std::set<string> names;
+    for (const Node* node : client_graph.graph.nodes()) {
+      names.insert(node->name());
+    }
+    return names;
+  }
+
+  SessionOptions options_;
+  std::vector<std::unique_ptr<Device>> devices_;
+  DeviceSet device_set_;
+  std::unique_ptr<GraphExecutionState> execution_state_;
+  uint64 fingerprint_;
+  ClientGraphCache cache_;
+};
+
+TEST_F(ClientGraphCacheTest, ReusesTheSameOptions) {
+  std::unique_ptr<ClientGraph> built;
+  TF_ASSERT_OK(cache_.BuildGraph(fingerprint_, Options({"a:0", "b:0"}),
+                                 execution_state_.get(), &built));
+  EXPECT_EQ(0, cache_.num_hits());
+
+  std::unique_ptr<ClientGraph> cached;
+  TF_ASSERT_OK(cache_.BuildGraph(fingerprint_, Options({"a:0", "b:0"}),
+                                 execution_state_.get(), &cached));
+  EXPECT_EQ(1, cache_.num_hits());
+  EXPECT_EQ(NodeNames(*built), NodeNames(*cached));
+  EXPECT_EQ(built->fetch_types, cached->fetch_types);
+
+  // Another graph misses.
+  TF_ASSERT_OK(cache_.BuildGraph(fingerprint_ + 1, Options({"a:0", "b:0"}),
+                                 execution_state_.get(), &cached));
+  EXPECT_EQ(1, cache_.num_hits());
+}
+
+TEST_F(ClientGraphCacheTest, PrunesFewerFetches) {
+  std::unique_ptr<ClientGraph> client_graph;
+  TF_ASSERT_OK(cache_.BuildGraph(fingerprint_, Options({"b:0", "a:0"}),
+                                 execution_state_.get(), &client_graph));
+
+  std::unique_ptr<ClientGraph> pruned;
+  TF_ASSERT_OK(cache_.BuildGraph(fingerprint_, Options({"a:0"}),
+                                 execution_state_.get(), &pruned));
+  EXPECT_EQ(1, cache_.num_pruned_hits());
+  std::unique_ptr<ClientGraph> built;
+  TF_ASSERT_OK(execution_state_->BuildGraph(Options({"a:0"}), &built));
+  EXPECT_EQ(NodeNames(*built), NodeNames(*pruned));
+  EXPECT_EQ(0, NodeNames(*pruned).count("b"));
+  EXPECT_EQ(DataTypeVector({DT_FLOAT}), pruned->fetch_types);
+
+  // The pruned graph is cached as well.
+  TF_ASSERT_OK(cache_.BuildGraph(fingerprint_, Options({"a:0"}),
+                                 execution_state_.get(), &pruned));
+  EXPECT_EQ(1, cache_.num_hits());
+  EXPECT_EQ(1, cache_.num_pruned_hits());
+}
+
+TEST_F(ClientGraphCacheTest, CachesPartitions) {
+  std::unordered_map<string, GraphDef> partitions;
+  EXPECT_FALSE(
+      cache_.LookupPartitions(fingerprint_, Options({"a:0"}), &partitions));
+
+  std::unique_ptr<ClientGraph> client_graph;
+  TF_ASSERT_OK(cache_.BuildGraph(fingerprint_, Options({"a:0"}),
+                                 execution_state_.get(), &client_graph));
+  partitions["/job:localhost/replica:0/task:0"].add_node()->set_name("a");
+  cache_.InsertPartitions(fingerprint_, Options({"a:0"}), partitions);
+
+  std::unordered_map<string, GraphDef> cached;
+  ASSERT_TRUE(cache_.LookupPartitions(fingerprint_, Options({"a:0"}), &cached));
+  ASSERT_EQ(1, cached.size());
+  EXPECT_EQ("a", cached["/job:localhost/replica:0/task:0"].node(0).name());
+  EXPECT_FALSE(
+      cache_.LookupPartitions(fingerprint_, Options({"b:0"}), &cached));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -25,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/profile_handler.h"
 #include "tensorflow/core/common_runtime/stats_publisher_interface.h"
 #include "tensorflow/core/debug/debug_graph_utils.h"
+#include "tensorflow/core/distributed_runtime/client_graph_cache.h"
 #include "tensorflow/core/distributed_runtime/request_id.h"
 #include "tensorflow/core/distributed_runtime/scheduler.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
@@ -120,6 +121,12 @@ class MasterSession::ReffedClientGraph : public core::RefCounted {
 
   int64 collective_graph_key() { return collective_graph_key_; }
 
+  // Caches the partitions in the ClientGraphCache under the fingerprint of
+  // the graph of the session.
+  void set_graph_fingerprint(uint64 graph_fingerprint) {
+    graph_fingerprint_ = graph_fingerprint;
+  }
+
   std::unique_ptr<ProfileHandler> GetProfileHandler(uint64 step,
                                                     int64 execution_count,
                                                     const RunOptions& ropts) {
@@ -254,6 +261,8 @@ class MasterSession::ReffedClientGraph : public core::RefCounted {
   const bool should_deregister_;
   const int64 collective_graph_key_;
   std::atomic<int64> execution_count_ = {0};
+  // Not 0 if the partitions are cached in the ClientGraphCache.
+  uint64 graph_fingerprint_ = 0;
 
   // Graph partitioned into per-location subgraphs.
   struct Part {
@@ -354,7 +363,16 @@ Status MasterSession::ReffedClientGraph::RegisterPartitions(
       mu_.unlock();
       std::unordered_map<string, GraphDef> graph_defs;
       popts.flib_def = client_graph->flib_def.get();
-      Status s = DoBuildPartitions(popts, client_graph.get(), &graph_defs);
+      ClientGraphCache* cache =
+          graph_fingerprint_ != 0 ? ClientGraphCache::Global() : nullptr;
+      Status s;
+      if (cache == nullptr ||
+          !cache->LookupPartitions(graph_fingerprint_, bg_opts_, &graph_defs)) {
+        s = DoBuildPartitions(popts, client_graph.get(), &graph_defs);
+        if (s.ok() && cache != nullptr) {
+          cache->InsertPartitions(graph_fingerprint_, bg_opts_, graph_defs);
+        }
+      }
       if (s.ok()) {
         // NOTE(mrry): The pointers in `graph_defs_for_publishing` do not remain
         // valid after the call to DoRegisterPartitions begins, so
@@ -1497,6 +1515,10 @@ Status MasterSession::Create(GraphDef&& graph_def,
   execution_options.session_options = &session_opts_;
   {
     mutex_lock l(mu_);
+    if (ClientGraphCache::Global() != nullptr) {
+      graph_fingerprint_ = ClientGraphCache::Fingerprint(
+          graph_def, *devices_, session_opts_.config);
+    }
     TF_RETURN_IF_ERROR(GraphExecutionState::MakeForBaseGraph(
         std::move(graph_def), execution_options, &execution_state_));
   }
@@ -1705,6 +1727,10 @@ Status MasterSession::Extend(const ExtendSessionRequest* req,
     CHECK(extended_execution_state);
     // The old execution state will be released outside the lock.
     execution_state_.swap(extended_execution_state);
+    if (graph_fingerprint_ != 0) {
+      graph_fingerprint_ =
+          ClientGraphCache::Extend(graph_fingerprint_, req->graph_def());
+    }
     ++graph_version_;
     resp->set_new_graph_version(graph_version_);
   }
@@ -1735,7 +1761,7 @@ Status MasterSession::StartStep(const BuildGraphOptions& opts, bool is_partial,
               << BuildGraphOptionsString(opts) << " is_partial = " << is_partial
               << "\n";
       std::unique_ptr<ClientGraph> client_graph;
-      TF_RETURN_IF_ERROR(execution_state_->BuildGraph(opts, &client_graph));
+      TF_RETURN_IF_ERROR(BuildGraph(opts, &client_graph));
       WorkerCacheInterface* worker_cache = get_worker_cache();
       /*auto entry = new ReffedClientGraph(
           handle_, opts, std::move(client_graph), session_opts_,
@@ -1753,6 +1779,7 @@ Status MasterSession::StartStep(const BuildGraphOptions& opts, bool is_partial,
             handle_, opts, std::move(client_graph), session_opts_,
             stats_publisher_factory_, execution_state_.get(), is_partial,
             worker_cache, env_, !should_delete_worker_sessions_);
+        entry->set_graph_fingerprint(graph_fingerprint_);
       }
       iter = m->insert({hash, entry}).first;
       VLOG(1) << "Preparing to execute new graph";
@@ -1764,6 +1791,16 @@ Status MasterSession::StartStep(const BuildGraphOptions& opts, bool is_partial,
   return Status::OK();
 }
 
+Status MasterSession::BuildGraph(const BuildGraphOptions& opts,
+                                 std::unique_ptr<ClientGraph>* out) {
+  ClientGraphCache* cache = ClientGraphCache::Global();
+  if (cache == nullptr) {
+    return execution_state_->BuildGraph(opts, out);
+  }
+  return cache->BuildGraph(graph_fingerprint_, opts, execution_state_.get(),
+                           out);
+}
+
 void MasterSession::ClearRunsTable(std::vector<ReffedClientGraph*>* to_unref,
                                    RCGMap* rcg_map) {
   VLOG(1) << "Discarding all reffed graphs";
@@ -1911,6 +1948,19 @@ Status MasterSession::BuildAndRegisterPartitions(ReffedClientGraph* rcg) {
       return dtype;
     }
   };
+  // TF_DENSE_GRADIENT_COMPRESSION quantizes the dense gradients applied to
+  // the variables of another task, e.g. pushed by a worker to a ps.
+  bool compress_dense_gradients = false;
+  TF_CHECK_OK(ReadBoolFromEnvVar("TF_DENSE_GRADIENT_COMPRESSION", false,
+                                 &compress_dense_gradients));
+  if (compress_dense_gradients) {
+    popts.should_compress = [](const Edge* e) {
+      const string& dst_op = e->dst()->type_string();
+      return (str_util::StartsWith(dst_op, "Apply") ||
+              str_util::StartsWith(dst_op, "ResourceApply")) &&
+             str_util::StrContains(e->src()->name(), "gradients");
+    };
+  }
   if (session_opts_.config.graph_options().enable_recv_scheduling()) {
     popts.scheduling_for_recvs = true;
     popts.need_to_record_start_times = true;
@@ -2212,12 +2262,13 @@ Status MasterSession::MakeCallable(const MakeCallableRequest& req,
       return errors::FailedPrecondition("Session is closed.");
     }
     std::unique_ptr<ClientGraph> client_graph;
-    TF_RETURN_IF_ERROR(execution_state_->BuildGraph(opts, &client_graph));
+    TF_RETURN_IF_ERROR(BuildGraph(opts, &client_graph));
     callable = new ReffedClientGraph(handle_, opts, std::move(client_graph),
                                      session_opts_, stats_publisher_factory_,
                                      execution_state_.get(), false /* is_partial */,
                                      get_worker_cache(), env_,
                                      !should_delete_worker_sessions_);
+    callable->set_graph_fingerprint(graph_fingerprint_);
   }
 
   Status s = BuildAndRegisterPartitions(callable);
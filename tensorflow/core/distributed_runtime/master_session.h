@@ -141,8 +141,16 @@ class MasterSession : public core::RefCounted {
 
   uint64 NewStepId(int64 graph_key);
 
+  // Builds the client graph of opts from execution_state_, or from the
+  // ClientGraphCache if enabled.
+  Status BuildGraph(const BuildGraphOptions& opts,
+                    std::unique_ptr<ClientGraph>* out);
+
   mutex mu_;
   std::unique_ptr<GraphExecutionState> execution_state_ GUARDED_BY(mu_);
+  // The fingerprint of the graph of execution_state_ in the
+  // ClientGraphCache, 0 if the cache is disabled.
+  uint64 graph_fingerprint_ GUARDED_BY(mu_) = 0;
   int64 graph_version_;
 
   // We keep a map from a signature of a run request to the
@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/distributed_runtime/rpc/grpc_session.h"
 
 #include <unordered_map>
+#include "tensorflow/core/common_runtime/direct_session_group.h"
 
 #include "tensorflow/core/common_runtime/session_factory.h"
 #include "tensorflow/core/distributed_runtime/call_options.h"
@@ -484,11 +485,23 @@ class GrpcSessionFactory : public SessionFactory {
     return Status::OK();
   }
 
+  // The sessions of the group share the resources of the workers, which
+  // hold them for every session on the master, unless isolated.
   Status NewSessionGroup(const SessionOptions& options,
                          SessionGroup** out_session_group,
                          const SessionGroupMetadata& metadata) {
-    return errors::Internal(
-        "NewSessionGroup method not implemented in GrpcSessionFactory.");
+    if (metadata.session_count < 1) {
+      return errors::InvalidArgument(
+          "Must specify session_num of NewSessionGroup");
+    }
+    std::unique_ptr<SessionGroup> session_group(new DirectSessionGroup());
+    for (int i = 0; i < metadata.session_count; ++i) {
+      std::unique_ptr<GrpcSession> session;
+      TF_RETURN_IF_ERROR(GrpcSession::Create(options, &session));
+      TF_RETURN_IF_ERROR(session_group->CreateSession(session.release()));
+    }
+    *out_session_group = session_group.release();
+    return Status::OK();
   }
 
   // Invokes the session specific static method to reset containers.
@@ -127,6 +127,16 @@ Allocator* ev_allocator() {
   return ev_alloc;
 }
 
+Allocator* numa_ev_allocator(int numa_node) {
+  if (numa_node == port::kNUMANoAffinity) {
+    return ev_allocator();
+  }
+  if (DisableEVAllocatorFromEnvironment()) {
+    return cpu_allocator(numa_node);
+  }
+  return AllocatorFactoryRegistry::singleton()->GetNUMAEVAllocator(numa_node);
+}
+
 Allocator* gpu_ev_allocator() {
   static Allocator* ev_alloc =
       AllocatorFactoryRegistry::singleton()->GetGPUEVAllocator();  
@@ -138,6 +148,17 @@ Allocator* gpu_ev_allocator() {
   return ev_alloc;
 }
 
+Allocator* pinned_ev_allocator() {
+  static Allocator* ev_alloc =
+      AllocatorFactoryRegistry::singleton()->GetPinnedEVAllocator();
+
+  if (ev_alloc && cpu_allocator_collect_full_stats &&
+      !ev_alloc->TracksAllocationSizes()) {
+    ev_alloc = new TrackingAllocator(ev_alloc, true);
+  }
+  return ev_alloc;
+}
+
 SubAllocator::SubAllocator(const std::vector<Visitor>& alloc_visitors,
                            const std::vector<Visitor>& free_visitors)
     : alloc_visitors_(alloc_visitors), free_visitors_(free_visitors) {}
@@ -354,8 +354,15 @@ Allocator* pmem_allocator();
 
 Allocator* ev_allocator();
 
+// Like ev_allocator(), but the memory is local to numa_node. Falls back to
+// ev_allocator() if numa_node == port::kNUMANoAffinity.
+Allocator* numa_ev_allocator(int numa_node);
+
 Allocator* gpu_ev_allocator();
 
+// EV allocator of pinned host memory which the GPUs read over UVA.
+Allocator* pinned_ev_allocator();
+
 // If use experimental libpmem based PMEM allocator, please call this function
 Allocator* experimental_pmem_allocator(const std::string& pmem_path, size_t allocator_size);
 
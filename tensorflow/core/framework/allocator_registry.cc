@@ -162,6 +162,35 @@ Allocator* AllocatorFactoryRegistry::GetEVAllocator() {
   }
 }
 
+Allocator* AllocatorFactoryRegistry::GetNUMAEVAllocator(int numa_node) {
+  mutex_lock l(mu_);
+  first_alloc_made_ = true;
+  FactoryEntry* best_entry = nullptr;
+  for (auto& entry : factories_) {
+    if (best_entry == nullptr) {
+      best_entry = &entry;
+    } else if (entry.name == "EVAllocator") {
+      best_entry = &entry;
+      break;
+    }
+  }
+
+  if (best_entry) {
+    CHECK_GE(numa_node, 0);
+    if (static_cast<int>(best_entry->numa_ev_allocators.size()) <= numa_node) {
+      best_entry->numa_ev_allocators.resize(numa_node + 1);
+    }
+    auto& allocator = best_entry->numa_ev_allocators[numa_node];
+    if (!allocator) {
+      allocator.reset(best_entry->factory->CreateNUMAEVAllocator(numa_node));
+    }
+    return allocator.get();
+  } else {
+    LOG(FATAL) << "No registered EV AllocatorFactory";
+    return nullptr;
+  }
+}
+
 Allocator* AllocatorFactoryRegistry::GetGPUEVAllocator() {
   mutex_lock l(mu_);
   first_alloc_made_ = true;
@@ -186,6 +215,31 @@ Allocator* AllocatorFactoryRegistry::GetGPUEVAllocator() {
   }
 }
 
+Allocator* AllocatorFactoryRegistry::GetPinnedEVAllocator() {
+  mutex_lock l(mu_);
+  first_alloc_made_ = true;
+  FactoryEntry* best_entry = nullptr;
+  for (auto& entry : factories_) {
+    if (best_entry == nullptr) {
+      best_entry = &entry;
+    } else if (entry.name == "PinnedEVAllocator") {
+      best_entry = &entry;
+      break;
+    }
+  }
+
+  if (best_entry) {
+    if (!best_entry->allocator) {
+      best_entry->allocator.reset(
+          best_entry->factory->CreatePinnedEVAllocator());
+    }
+    return best_entry->allocator.get();
+  } else {
+    LOG(FATAL) << "No registered Pinned EV AllocatorFactory";
+    return nullptr;
+  }
+}
+
 SubAllocator* AllocatorFactoryRegistry::GetSubAllocator(int numa_node) {
   mutex_lock l(mu_);
   first_alloc_made_ = true;
@@ -44,9 +44,17 @@ class AllocatorFactory {
   //Create EV Allocator.
   virtual Allocator* CreateEVAllocator() {return CreateAllocator();};
 
+  // Create EV Allocator whose chunks are local to numa_node.
+  virtual Allocator* CreateNUMAEVAllocator(int numa_node) {
+    return CreateEVAllocator();
+  }
+
   // Create GPU EV Allocator.
   virtual Allocator* CreateGPUEVAllocator() { return CreateAllocator(); }
 
+  // Create EV Allocator of pinned host memory mapped to the GPUs.
+  virtual Allocator* CreatePinnedEVAllocator() { return CreateAllocator(); }
+
   // Create a SubAllocator. If NumaEnabled() is true, then returned SubAllocator
   // will allocate memory local to numa_node.  If numa_node == kNUMANoAffinity
   // then allocated memory is not specific to any NUMA node.
@@ -89,8 +97,13 @@ class AllocatorFactoryRegistry {
 
   Allocator* GetEVAllocator();
 
+  // Returns the EV Allocator of numa_node, one instance per node.
+  Allocator* GetNUMAEVAllocator(int numa_node);
+
   Allocator* GetGPUEVAllocator();
 
+  Allocator* GetPinnedEVAllocator();
+
   // Returns 'best fit' SubAllocator.  First look for the highest priority
   // factory that is NUMA-enabled.  If none is registered, fall back to the
   // highest priority non-NUMA-enabled factory.  If NUMA-enabled, return a
@@ -117,6 +130,8 @@ class AllocatorFactoryRegistry {
     int priority;
     std::unique_ptr<AllocatorFactory> factory;
     std::unique_ptr<Allocator> allocator;
+    // Index i corresponds to numa_node i.
+    std::vector<std::unique_ptr<Allocator>> numa_ev_allocators;
     // Index 0 corresponds to kNUMANoAffinity, other indices are (numa_node +
     // 1).
     std::vector<std::unique_ptr<SubAllocator>> sub_allocators;
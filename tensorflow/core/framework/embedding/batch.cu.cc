@@ -218,5 +218,130 @@ __global__ void SparseApplyAdamWGPU(V** var, V** m, V** v,
 TF_CALL_float(REGISTER_KERNELS_ALL_INDEX)
 TF_CALL_double(REGISTER_KERNELS_ALL_INDEX)
 #undef REGISTER_KERNELS_ALL_INDEX
+
+namespace {
+template<class V>
+struct FusedApplyMathType {
+  typedef float type;
+};
+
+template<>
+struct FusedApplyMathType<double> {
+  typedef double type;
+};
+
+template<class V>
+__device__ V* ShflPtr(V* ptr, int src_lane) {
+  return reinterpret_cast<V*>(__shfl_sync(0xffffffff,
+      reinterpret_cast<unsigned long long>(ptr), src_lane));
+}
+
+// Updates row of the limit rows with the warp of the calling thread.
+template<class V, class M>
+__device__ void FusedAdamRow(V** var, V** m, V** v,
+    const V* g, M alpha, M beta1, M beta2, M epsilon,
+    M weight_decay, int embedding_dim, long long int row) {
+  const int lane = threadIdx.x & 31;
+  V* addr = nullptr;
+  if (lane == 0) {
+    addr = var[row];
+  } else if (lane == 1) {
+    addr = m[row];
+  } else if (lane == 2) {
+    addr = v[row];
+  }
+  V* var_row = ShflPtr(addr, 0);
+  V* m_row = ShflPtr(addr, 1);
+  V* v_row = ShflPtr(addr, 2);
+  const V* g_row = g + row * embedding_dim;
+
+  for (int i = lane; i < embedding_dim; i += 32) {
+    const M g_i = static_cast<M>(g_row[i]);
+    const M m_i = static_cast<M>(m_row[i]) * beta1 + g_i * (1 - beta1);
+    const M v_i = static_cast<M>(v_row[i]) * beta2 +
+        g_i * g_i * (1 - beta2);
+    M var_i = static_cast<M>(var_row[i]);
+    var_i -= (m_i * alpha) / (sqrt(v_i) + epsilon) + weight_decay * var_i;
+    m_row[i] = static_cast<V>(m_i);
+    v_row[i] = static_cast<V>(v_i);
+    var_row[i] = static_cast<V>(var_i);
+  }
+}
+}  // namespace
+
+template<class V>
+__global__ void FusedSparseApplyAdamGPU(V** var, V** m, V** v,
+    const V* g, V alpha, V beta1, V beta2, V epsilon,
+    V weight_decay, int embedding_dim, long long int limit) {
+  typedef typename FusedApplyMathType<V>::type M;
+  // All the lanes of a warp share the row, so warps exit as a whole.
+  long long int row =
+      (static_cast<long long int>(blockIdx.x) * blockDim.x + threadIdx.x) / 32;
+  if (row >= limit) {
+    return;
+  }
+  FusedAdamRow<V, M>(var, m, v, g, static_cast<M>(alpha),
+      static_cast<M>(beta1), static_cast<M>(beta2),
+      static_cast<M>(epsilon), static_cast<M>(weight_decay),
+      embedding_dim, row);
+}
+
+#define REGISTER_KERNELS_ALL_INDEX(T)                \
+  template __global__ void FusedSparseApplyAdamGPU<T>( \
+    T**, T**, T**, const T*, T, \
+    T, T, T, T, int, long long int);
+TF_CALL_float(REGISTER_KERNELS_ALL_INDEX)
+TF_CALL_double(REGISTER_KERNELS_ALL_INDEX)
+TF_CALL_half(REGISTER_KERNELS_ALL_INDEX)
+TF_CALL_bfloat16(REGISTER_KERNELS_ALL_INDEX)
+#undef REGISTER_KERNELS_ALL_INDEX
+
+template<class V>
+__global__ void FusedSparseApplyAdamAsyncGPU(V** var, V** m, V** v,
+    const V* g, V lr, V beta1, V beta2, V epsilon,
+    const V* beta1_power_ptr, const V* beta2_power_ptr,
+    int embedding_dim, long long int limit) {
+  typedef typename FusedApplyMathType<V>::type M;
+  long long int row =
+      (static_cast<long long int>(blockIdx.x) * blockDim.x + threadIdx.x) / 32;
+  if (row >= limit) {
+    return;
+  }
+  const M beta1_power = static_cast<M>(*beta1_power_ptr);
+  const M beta2_power = static_cast<M>(*beta2_power_ptr);
+  const M alpha = static_cast<M>(lr) * sqrt(1 - beta2_power) /
+      (1 - beta1_power);
+  FusedAdamRow<V, M>(var, m, v, g, alpha,
+      static_cast<M>(beta1), static_cast<M>(beta2),
+      static_cast<M>(epsilon), static_cast<M>(0),
+      embedding_dim, row);
+}
+
+#define REGISTER_KERNELS_ALL_INDEX(T)                \
+  template __global__ void FusedSparseApplyAdamAsyncGPU<T>( \
+    T**, T**, T**, const T*, T, \
+    T, T, T, const T*, const T*, int, long long int);
+TF_CALL_float(REGISTER_KERNELS_ALL_INDEX)
+TF_CALL_double(REGISTER_KERNELS_ALL_INDEX)
+TF_CALL_half(REGISTER_KERNELS_ALL_INDEX)
+TF_CALL_bfloat16(REGISTER_KERNELS_ALL_INDEX)
+#undef REGISTER_KERNELS_ALL_INDEX
+
+template<class V>
+__global__ void UpdateBetaPowersGPU(V* beta1_power_ptr,
+    V* beta2_power_ptr, V beta1, V beta2) {
+  if (blockIdx.x == 0 && threadIdx.x == 0) {
+    *beta1_power_ptr *= beta1;
+    *beta2_power_ptr *= beta2;
+  }
+}
+
+#define REGISTER_KERNELS_ALL_INDEX(T)                \
+  template __global__ void UpdateBetaPowersGPU<T>(T*, T*, T, T);
+TF_CALL_float(REGISTER_KERNELS_ALL_INDEX)
+TF_CALL_double(REGISTER_KERNELS_ALL_INDEX)
+TF_CALL_half(REGISTER_KERNELS_ALL_INDEX)
+TF_CALL_bfloat16(REGISTER_KERNELS_ALL_INDEX)
+#undef REGISTER_KERNELS_ALL_INDEX
 }  // namespace tensorflow
 #endif  // GOOGLE_CUDA
@@ -59,6 +59,28 @@ template<class V>
 __global__ void SparseApplyAdamWGPU(V** var, V** m, V** v,
     const V* g, V alpha, V beta1, V beta2, V epsilon,
     V weight_decay, int embedding_dim, long long int limit);
+
+// Fused Adam family, in which one warp updates a row end to end: its lanes
+// load the var, m and v addresses of the row once and share them, then
+// update the row in a single pass. The math is done in float for half and
+// bfloat16 storage. Adam is AdamW with a zero weight_decay. blockDim.x must
+// be a multiple of 32.
+template<class V>
+__global__ void FusedSparseApplyAdamGPU(V** var, V** m, V** v,
+    const V* g, V alpha, V beta1, V beta2, V epsilon,
+    V weight_decay, int embedding_dim, long long int limit);
+
+// Reads alpha from the beta powers, which are left untouched; advance them
+// afterwards with UpdateBetaPowersGPU.
+template<class V>
+__global__ void FusedSparseApplyAdamAsyncGPU(V** var, V** m, V** v,
+    const V* g, V lr, V beta1, V beta2, V epsilon,
+    const V* beta1_power_ptr, const V* beta2_power_ptr,
+    int embedding_dim, long long int limit);
+
+template<class V>
+__global__ void UpdateBetaPowersGPU(V* beta1_power_ptr,
+    V* beta2_power_ptr, V beta1, V beta2);
 }  // namespace tensorflow
 
 #endif  // GOOGLE_CUDA
@@ -0,0 +1,169 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_BLOCKED_COUNTING_BLOOM_FILTER_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_BLOCKED_COUNTING_BLOOM_FILTER_H_
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "tensorflow/core/framework/embedding/count_min_sketch.h"
+#include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// Counting bloom filter whose counters of a key all fall in one block of
+// 64 uint8 counters, i.e. one cache line, so that a lookup or an increment
+// of a key misses the cache at most once, whatever the number of probes.
+// The block of a key is chosen by one hash, the counters in the block by
+// 6-bit fields of a second hash.
+//
+// The counters saturate at 255. If decay_interval > 0, all the counters are
+// halved every decay_interval additions, so that the frequencies of an
+// online training follow shifts of the traffic.
+//
+// Concurrent Add of keys of the same block may lose an increment, as the
+// block is updated by a vector read-modify-write without locking, like the
+// unsynchronized reads of the other filters. This only delays the admission
+// of a key by a few occurrences.
+template <typename K>
+class BlockedCountingBloomFilter {
+ public:
+  static const int64 kBlockSize = 64;
+  static const int64 kMaxProbes = 8;
+  static const uint8 kMaxCount = 255;
+
+  BlockedCountingBloomFilter(int64 num_counter, int64 num_probes,
+                             int64 decay_interval = 0)
+      : num_blocks_(std::max(num_counter / kBlockSize,
+                             static_cast<int64>(1))),
+        num_probes_(std::min(std::max(num_probes, static_cast<int64>(1)),
+                             static_cast<int64>(kMaxProbes))),
+        decay_interval_(decay_interval),
+        num_adds_(0) {
+    seeds_ = GenerateSketchSeeds(2);
+    counters_ = static_cast<uint8*>(
+        port::AlignedMalloc(num_blocks_ * kBlockSize, kBlockSize));
+    memset(counters_, 0, num_blocks_ * kBlockSize);
+  }
+
+  ~BlockedCountingBloomFilter() {
+    port::AlignedFree(counters_);
+  }
+
+  int64 Get(K key) const {
+    uint64 probes;
+    const uint8* block = Block(key, &probes);
+    uint8 min_count = kMaxCount;
+    for (int64 i = 0; i < num_probes_; i++) {
+      min_count = std::min(min_count, block[Probe(probes, i)]);
+    }
+    return min_count;
+  }
+
+  // Adds count to the counters of key, saturating at kMaxCount.
+  void Add(K key, int64 count) {
+    if (count <= 0) {
+      return;
+    }
+    uint64 probes;
+    uint8* block = Block(key, &probes);
+    alignas(kBlockSize) uint8 increment[kBlockSize] = {0};
+    const uint8 c = static_cast<uint8>(
+        std::min(count, static_cast<int64>(kMaxCount)));
+    for (int64 i = 0; i < num_probes_; i++) {
+      increment[Probe(probes, i)] = c;
+    }
+#if defined(__AVX2__)
+    for (int64 i = 0; i < kBlockSize; i += 32) {
+      __m256i* dst = reinterpret_cast<__m256i*>(block + i);
+      __m256i inc = _mm256_load_si256(
+          reinterpret_cast<const __m256i*>(increment + i));
+      _mm256_store_si256(dst, _mm256_adds_epu8(_mm256_load_si256(dst), inc));
+    }
+#elif defined(__SSE2__)
+    for (int64 i = 0; i < kBlockSize; i += 16) {
+      __m128i* dst = reinterpret_cast<__m128i*>(block + i);
+      __m128i inc = _mm_load_si128(
+          reinterpret_cast<const __m128i*>(increment + i));
+      _mm_store_si128(dst, _mm_adds_epu8(_mm_load_si128(dst), inc));
+    }
+#else
+    for (int64 i = 0; i < kBlockSize; i++) {
+      block[i] = static_cast<uint8>(
+          std::min(block[i] + increment[i], static_cast<int>(kMaxCount)));
+    }
+#endif  // __AVX2__
+    if (decay_interval_ > 0 &&
+        (num_adds_.fetch_add(1, std::memory_order_relaxed) + 1) %
+            decay_interval_ == 0) {
+      Decay();
+    }
+  }
+
+  // Sets the counters of key to count, e.g. when restoring a checkpoint.
+  void Set(K key, int64 count) {
+    uint64 probes;
+    uint8* block = Block(key, &probes);
+    const uint8 c = static_cast<uint8>(
+        std::min(std::max(count, static_cast<int64>(0)),
+                 static_cast<int64>(kMaxCount)));
+    for (int64 i = 0; i < num_probes_; i++) {
+      block[Probe(probes, i)] = c;
+    }
+  }
+
+  // Halves all the counters.
+  void Decay() {
+    for (int64 i = 0; i < num_blocks_ * kBlockSize; i++) {
+      counters_[i] >>= 1;
+    }
+  }
+
+  int64 num_counter() const {
+    return num_blocks_ * kBlockSize;
+  }
+
+ private:
+  uint8* Block(K key, uint64* probes) const {
+    *probes = SketchHash64(key, seeds_[1]);
+    return counters_ + (SketchHash64(key, seeds_[0]) % num_blocks_) *
+                           kBlockSize;
+  }
+
+  static int64 Probe(uint64 probes, int64 i) {
+    return (probes >> (6 * i)) & (kBlockSize - 1);
+  }
+
+  int64 num_blocks_;
+  int64 num_probes_;
+  int64 decay_interval_;
+  std::atomic<int64> num_adds_;
+  std::vector<int64> seeds_;
+  uint8* counters_;
+};
+
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_BLOCKED_COUNTING_BLOOM_FILTER_H_
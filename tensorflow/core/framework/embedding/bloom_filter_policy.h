@@ -16,24 +16,25 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_BLOOM_FILTER_POLICY_H_
 #define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_BLOOM_FILTER_POLICY_H_
 
+#include "tensorflow/core/framework/embedding/blocked_counting_bloom_filter.h"
+#include "tensorflow/core/framework/embedding/count_min_sketch.h"
 #include "tensorflow/core/framework/embedding/embedding_config.h"
 #include "tensorflow/core/framework/embedding/filter_policy.h"
 #include "tensorflow/core/framework/embedding/intra_thread_copy_id_allocator.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
-namespace {
-const static std::vector<int64> default_seeds = {
- 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41,
- 43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97
-};
-}
-
 template<typename K, typename V, typename EV>
 class BloomFilterPolicy : public FilterPolicy<K, V, EV> {
  public:
-  BloomFilterPolicy(const EmbeddingConfig& config, EV* ev)
-      : config_(config), ev_(ev) {
+  BloomFilterPolicy(const EmbeddingConfig& config, EV* ev,
+                    bool blocked = false)
+      : config_(config), ev_(ev), bloom_counter_(nullptr) {
+    if (blocked) {
+      CreateBlockedFilter();
+      return;
+    }
     switch (config_.counter_type){
       case DT_UINT64:
         VLOG(2) << "The type of bloom counter is uint64";
@@ -71,6 +72,17 @@ class BloomFilterPolicy : public FilterPolicy<K, V, EV> {
     return Status::OK();
   }
 
+  void LookupWithValuePtr(K key, ValuePtr<V>* value_ptr, V* val,
+      const V* default_value_ptr,
+      const V* default_value_no_permission) override {
+    if (value_ptr != nullptr) {
+      V* mem_val = ev_->LookupOrCreateEmb(value_ptr, default_value_ptr);
+      memcpy(val, mem_val, sizeof(V) * ev_->ValueLen());
+    } else {
+      memcpy(val, default_value_no_permission, sizeof(V) * ev_->ValueLen());
+    }
+  }
+
 #if GOOGLE_CUDA
   void BatchLookup(const EmbeddingVarContext<GPUDevice>& ctx,
                    const K* keys, V* output,
@@ -215,7 +227,30 @@ class BloomFilterPolicy : public FilterPolicy<K, V, EV> {
   }
 
  private:
+  // Counters of uint8 in cache line sized blocks, see
+  // BlockedCountingBloomFilter. The decay of the counters for online
+  // training is set by TF_EV_BLOOM_FILTER_DECAY_ADDS.
+  void CreateBlockedFilter() {
+    int64 decay_interval = 0;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_BLOOM_FILTER_DECAY_ADDS",
+        0, &decay_interval));
+    int64 num_counter = config_.num_counter;
+    if (num_counter <= 0) {
+      TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_BLOOM_FILTER_NUM_COUNTER",
+          1 << 24, &num_counter));
+    }
+    int64 num_probes = config_.kHashFunc > 0 ? config_.kHashFunc : 4;
+    blocked_filter_.reset(new embedding::BlockedCountingBloomFilter<K>(
+        num_counter, num_probes, decay_interval));
+    VLOG(2) << "Blocked bloom filter of "
+            << blocked_filter_->num_counter() << " uint8 counters, "
+            << "decay every " << decay_interval << " additions";
+  }
+
   int64 GetBloomFreq(K key) {
+    if (blocked_filter_) {
+      return blocked_filter_->Get(key);
+    }
     std::vector<int64> hash_val;
     for (int64 i = 0; i < config_.kHashFunc; i++) {
       hash_val.emplace_back(
@@ -241,26 +276,8 @@ class BloomFilterPolicy : public FilterPolicy<K, V, EV> {
     return min_freq;
   }
 
-#define mix(h) ({                                 \
-                   (h) ^= (h) >> 23;              \
-                   (h) *= 0x2127599bf4325c37ULL;  \
-                   (h) ^= (h) >> 47;              \
-                })
-
   uint64_t FastHash64(K key, uint64_t seed) {
-    const uint64_t    m = 0x880355f21e6d1965ULL;
-
-    uint64_t h = seed ^ (8 * m);
-    uint64_t v;
-    v = key;
-    h ^= mix(v);
-    h *= m;
-
-    v = 0;
-    h ^= mix(v);
-    h *= m;
-
-    return mix(h);
+    return embedding::SketchHash64(key, seed);
   }
 
   template<typename VBloom>
@@ -280,6 +297,10 @@ class BloomFilterPolicy : public FilterPolicy<K, V, EV> {
   }
 
   void SetBloomFreq(K key, int64 freq) {
+    if (blocked_filter_) {
+      blocked_filter_->Set(key, freq);
+      return;
+    }
     std::vector<int64> hash_val;
     for (int64 i = 0; i < config_.kHashFunc; i++) {
       hash_val.emplace_back(
@@ -364,6 +385,10 @@ class BloomFilterPolicy : public FilterPolicy<K, V, EV> {
   }
 
   void AddFreq(K key) {
+    if (blocked_filter_) {
+      blocked_filter_->Add(key, 1);
+      return;
+    }
     std::vector<int64> hash_val;
     for (int64 i = 0; i < config_.kHashFunc; i++) {
       hash_val.emplace_back(
@@ -396,6 +421,10 @@ class BloomFilterPolicy : public FilterPolicy<K, V, EV> {
   }
 
   void AddFreq(K key, int64 count) {
+    if (blocked_filter_) {
+      blocked_filter_->Add(key, count);
+      return;
+    }
     std::vector<int64> hash_val;
     for (int64 i = 0; i < config_.kHashFunc; i++) {
       hash_val.emplace_back(
@@ -428,38 +457,14 @@ class BloomFilterPolicy : public FilterPolicy<K, V, EV> {
   }
 
   void GenerateSeed(int64 kHashFunc) {
-    if (kHashFunc < default_seeds.size()) {
-      for (int64 i = 0; i < kHashFunc; i++) {
-        seeds_.emplace_back(default_seeds[i]);
-      }
-    } else {
-      for (int64 i = 0; i < default_seeds.size(); i++) {
-        seeds_.emplace_back(default_seeds[i]);
-      }
-      int64 last_seed = 98;
-      for (int64 i = default_seeds.size(); i < kHashFunc; i++) {
-        for (int64 j = last_seed; ; j++) {
-          if (j % 2 == 0)
-            continue;
-          bool is_prime = true;
-          for (int64 k = 0; k <= std::sqrt(j) + 1; k++) {
-            if (j % k == 0)
-              is_prime = false;
-          }
-          if (is_prime) {
-            seeds_.emplace_back(j);
-            last_seed = j;
-            break;
-          }
-        }
-      }
-    }
+    seeds_ = embedding::GenerateSketchSeeds(kHashFunc);
   }
 
  private:
-  void* bloom_counter_;
   EmbeddingConfig config_;
   EV* ev_;
+  void* bloom_counter_;
+  std::unique_ptr<embedding::BlockedCountingBloomFilter<K>> blocked_filter_;
   std::vector<int64> seeds_;
 };
 } // tensorflow
@@ -1,14 +1,21 @@
 #ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_CACHE_H_
 #define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_CACHE_H_
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <unordered_map>
 #include <set>
 #include <list>
 #include <limits>
+#include <atomic>
+#include <vector>
+#include "tensorflow/core/framework/embedding/count_min_sketch.h"
+#include "tensorflow/core/framework/embedding/lock_contention.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 
@@ -54,29 +61,42 @@ class BatchCache {
      num_hit = 0;
      num_miss = 0;
   }
+  // Hits and misses since the last reset_status, readable while the cache
+  // is updated.
+  int64 hit_count() const {
+    return num_hit.load(std::memory_order_relaxed);
+  }
+  int64 miss_count() const {
+    return num_miss.load(std::memory_order_relaxed);
+  }
   std::string DebugString() {
     float hit_rate = 0.0;
-    if (num_hit > 0 || num_miss > 0) {
-      hit_rate = num_hit * 100.0 / (num_hit + num_miss);
+    const int64 hits = hit_count();
+    const int64 misses = miss_count();
+    if (hits > 0 || misses > 0) {
+      hit_rate = hits * 100.0 / (hits + misses);
     }
     return strings::StrCat("HitRate = " , hit_rate,
-                          " %, visit_count = ", num_hit + num_miss,
-                           ", hit_count = ", num_hit);
+                          " %, visit_count = ", hits + misses,
+                           ", hit_count = ", hits);
   }
-  virtual mutex_lock maybe_lock_cache(
-      mutex& mu, mutex& temp_mu,bool use_locking) {
+  // Locks mu, recording its contention on site unless null, if
+  // use_locking, temp_mu otherwise.
+  virtual profiled_mutex_lock maybe_lock_cache(
+      mutex& mu, mutex& temp_mu,bool use_locking,
+      LockContention::Site* site = nullptr) {
     if (use_locking) {
-      mutex_lock l(mu);
+      profiled_mutex_lock l(mu, site);
       return l;
     } else {
-      mutex_lock l(temp_mu);
+      profiled_mutex_lock l(temp_mu, nullptr);
       return l;
     }
   }
 
  protected:
-  int64 num_hit;
-  int64 num_miss;
+  std::atomic<int64> num_hit{0};
+  std::atomic<int64> num_miss{0};
 };
 
 template<class K>
@@ -143,12 +163,12 @@ class LRUCache : public BatchCache<K> {
   }
 
   size_t size() {
-    mutex_lock l(mu_);
+    profiled_mutex_lock l(mu_, LOCK_CONTENTION_SITE("lru_cache"));
     return mp.size();
   }
 
   size_t get_evic_ids(K* evic_ids, size_t k_size) {
-    mutex_lock l(mu_);
+    profiled_mutex_lock l(mu_, LOCK_CONTENTION_SITE("lru_cache"));
     size_t true_size = 0;
     LRUNode *evic_node = tail->pre;
     LRUNode *rm_node = evic_node;
@@ -168,7 +188,7 @@ class LRUCache : public BatchCache<K> {
   size_t get_cached_ids(K* cached_ids, size_t k_size,
                         int64* cached_versions,
                         int64* cached_freqs) override {
-    mutex_lock l(mu_);
+    profiled_mutex_lock l(mu_, LOCK_CONTENTION_SITE("lru_cache"));
     LRUNode* it = head->next;
     size_t i;
     for (i = 0; i < k_size && it != tail; i++, it = it->next) {
@@ -180,7 +200,8 @@ class LRUCache : public BatchCache<K> {
   void update(const K* batch_ids, size_t batch_size,
               bool use_locking=true) {
     mutex temp_mu;
-    auto lock = BatchCache<K>::maybe_lock_cache(mu_, temp_mu, use_locking);
+    auto lock = BatchCache<K>::maybe_lock_cache(mu_, temp_mu, use_locking,
+        LOCK_CONTENTION_SITE("lru_cache"));
     for (size_t i = 0; i < batch_size; ++i) {
       K id = batch_ids[i];
       typename std::map<K, LRUNode *>::iterator it = mp.find(id);
@@ -214,7 +235,7 @@ class LRUCache : public BatchCache<K> {
   }
 
   void add_to_prefetch_list(const K* batch_ids, const size_t batch_size) {
-    mutex_lock l(mu_);
+    profiled_mutex_lock l(mu_, LOCK_CONTENTION_SITE("lru_cache"));
     for (size_t i = 0; i < batch_size; ++i) {
       K id = batch_ids[i];
       auto it_prefetch = prefetch_id_table.find(id);
@@ -235,7 +256,7 @@ class LRUCache : public BatchCache<K> {
   }
 
   void add_to_cache(const K* batch_ids, const size_t batch_size) {
-    mutex_lock l(mu_);
+    profiled_mutex_lock l(mu_, LOCK_CONTENTION_SITE("lru_cache"));
     std::vector<K> ids_to_cache(batch_size);
     int64 nums_to_cache = 0;
     for (size_t i = 0; i < batch_size; ++i) {
@@ -281,14 +302,14 @@ class LFUCache : public BatchCache<K> {
   }
 
   size_t size() {
-    mutex_lock l(mu_);
+    profiled_mutex_lock l(mu_, LOCK_CONTENTION_SITE("lfu_cache"));
     return key_table.size();
   }
 
   size_t get_cached_ids(K* cached_ids, size_t k_size,
                         int64* cached_versions,
                         int64* cached_freqs) override {
-    mutex_lock l(mu_);
+    profiled_mutex_lock l(mu_, LOCK_CONTENTION_SITE("lfu_cache"));
     size_t i = 0;
     size_t curr_freq = max_freq;
     auto it = freq_table[max_freq - 1].first->begin();
@@ -311,7 +332,7 @@ class LFUCache : public BatchCache<K> {
   }
 
   size_t get_evic_ids(K *evic_ids, size_t k_size) {
-    mutex_lock l(mu_);
+    profiled_mutex_lock l(mu_, LOCK_CONTENTION_SITE("lfu_cache"));
     size_t true_size = 0;
     size_t st_freq = min_freq;
     for (size_t i = 0; i < k_size && key_table.size() > 0; ++i) {
@@ -342,7 +363,8 @@ class LFUCache : public BatchCache<K> {
   void update(const K *batch_ids, size_t batch_size,
               bool use_locking=true) {
     mutex temp_mu;
-    auto lock = BatchCache<K>::maybe_lock_cache(mu_, temp_mu, use_locking);
+    auto lock = BatchCache<K>::maybe_lock_cache(mu_, temp_mu, use_locking,
+        LOCK_CONTENTION_SITE("lfu_cache"));
     for (size_t i = 0; i < batch_size; ++i) {
       K id = batch_ids[i];
       auto it = key_table.find(id);
@@ -380,7 +402,8 @@ class LFUCache : public BatchCache<K> {
               const int64* batch_freqs,
               bool use_locking = true) override {
     mutex temp_mu;
-    auto lock = BatchCache<K>::maybe_lock_cache(mu_, temp_mu, use_locking);
+    auto lock = BatchCache<K>::maybe_lock_cache(mu_, temp_mu, use_locking,
+        LOCK_CONTENTION_SITE("lfu_cache"));
     for (size_t i = 0; i < batch_size; ++i) {
       K id = batch_ids[i];
       auto it = key_table.find(id);
@@ -433,7 +456,7 @@ class LFUCache : public BatchCache<K> {
   }
 
   void add_to_prefetch_list(const K* batch_ids, const size_t batch_size) {
-    mutex_lock l(mu_);
+    profiled_mutex_lock l(mu_, LOCK_CONTENTION_SITE("lfu_cache"));
     for (size_t i = 0; i < batch_size; ++i) {
       K id = batch_ids[i];
       auto it_prefetch = prefetch_id_table.find(id);
@@ -464,7 +487,7 @@ class LFUCache : public BatchCache<K> {
   }
 
   void add_to_cache(const K* batch_ids, const size_t batch_size) {
-    mutex_lock l(mu_);
+    profiled_mutex_lock l(mu_, LOCK_CONTENTION_SITE("lfu_cache"));
     std::vector<K> ids_to_cache(batch_size);
     std::vector<int64> freqs_to_cache(batch_size);
     int64 nums_to_cache = 0;
@@ -538,6 +561,619 @@ class LFUCache : public BatchCache<K> {
   mutex mu_;
 };
 
+// Approximates LRU with one CLOCK per shard. Keys are hashed to shards, a
+// batch is split by shard first so that every shard is locked once per
+// batch. Hits only take the shard lock shared and set the reference bit
+// atomically, so that concurrent batches of hot ids do not serialize;
+// misses are admitted under the exclusive lock in one go per shard.
+template <class K>
+class ShardedClockCache : public BatchCache<K> {
+ public:
+  explicit ShardedClockCache(int num_shards = kDefaultNumShards)
+      : shards_(num_shards), evict_shard_(0) {
+    BatchCache<K>::num_hit = 0;
+    BatchCache<K>::num_miss = 0;
+  }
+
+  ~ShardedClockCache() override {
+    for (auto& shard : shards_) {
+      for (auto& it : shard.index) {
+        delete it.second;
+      }
+    }
+    for (auto& it : prefetch_id_table) {
+      delete it.second;
+    }
+  }
+
+  size_t size() override {
+    size_t total = 0;
+    for (auto& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      total += shard.index.size();
+    }
+    return total;
+  }
+
+  size_t get_evic_ids(K* evic_ids, size_t k_size) override {
+    size_t true_size = 0;
+    const size_t num_shards = shards_.size();
+    // Every round sweeps each shard at most once around its clock. The
+    // first round only evicts ids that were not referenced since the last
+    // sweep, the reference bits it clears make the next round succeed.
+    for (int round = 0; true_size < k_size; ++round) {
+      size_t evicted = 0;
+      size_t start = evict_shard_.fetch_add(1) % num_shards;
+      for (size_t i = 0; i < num_shards && true_size < k_size; ++i) {
+        Shard& shard = shards_[(start + i) % num_shards];
+        mutex_lock l(shard.mu);
+        size_t n = shard.Evict(evic_ids + true_size, k_size - true_size);
+        true_size += n;
+        evicted += n;
+      }
+      if (evicted == 0 && round > 0) {
+        break;
+      }
+    }
+    return true_size;
+  }
+
+  size_t get_cached_ids(K* cached_ids, size_t k_size,
+                        int64* cached_versions,
+                        int64* cached_freqs) override {
+    size_t i = 0;
+    for (auto& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      for (auto& it : shard.index) {
+        if (i >= k_size) {
+          return i;
+        }
+        cached_ids[i++] = it.first;
+      }
+    }
+    return i;
+  }
+
+  void update(const K* batch_ids, size_t batch_size,
+              bool use_locking = true) override {
+    std::vector<std::vector<K>> shard_ids(shards_.size());
+    for (size_t i = 0; i < batch_size; ++i) {
+      shard_ids[ShardOf(batch_ids[i])].emplace_back(batch_ids[i]);
+    }
+    int64 hits = 0;
+    int64 misses = 0;
+    std::vector<K> missed_ids;
+    for (size_t s = 0; s < shards_.size(); ++s) {
+      if (shard_ids[s].empty()) {
+        continue;
+      }
+      Shard& shard = shards_[s];
+      missed_ids.clear();
+      {
+        tf_shared_lock l(shard.mu);
+        for (K id : shard_ids[s]) {
+          auto it = shard.index.find(id);
+          if (it != shard.index.end()) {
+            it->second->referenced.store(true, std::memory_order_relaxed);
+            ++hits;
+          } else {
+            missed_ids.emplace_back(id);
+          }
+        }
+      }
+      if (!missed_ids.empty()) {
+        mutex_lock l(shard.mu);
+        for (K id : missed_ids) {
+          auto it = shard.index.find(id);
+          if (it != shard.index.end()) {
+            it->second->referenced.store(true, std::memory_order_relaxed);
+          } else {
+            shard.Insert(id);
+          }
+          ++misses;
+        }
+      }
+    }
+    mutex_lock l(stats_mu_);
+    BatchCache<K>::num_hit += hits;
+    BatchCache<K>::num_miss += misses;
+  }
+
+  void update(const K* batch_ids, size_t batch_size,
+              const int64* batch_versions,
+              const int64* batch_freqs,
+              bool use_locking = true) override {
+    update(batch_ids, batch_size, use_locking);
+  }
+
+  void add_to_prefetch_list(const K* batch_ids,
+                            const size_t batch_size) override {
+    mutex_lock l(prefetch_mu_);
+    for (size_t i = 0; i < batch_size; ++i) {
+      K id = batch_ids[i];
+      auto it_prefetch = prefetch_id_table.find(id);
+      if (it_prefetch == prefetch_id_table.end()) {
+        Shard& shard = shards_[ShardOf(id)];
+        {
+          mutex_lock shard_lock(shard.mu);
+          shard.Erase(id);
+        }
+        prefetch_id_table[id] = new PrefetchNode<K>(id);
+      } else {
+        it_prefetch->second->Ref();
+      }
+    }
+  }
+
+  void add_to_cache(const K* batch_ids, const size_t batch_size) override {
+    std::vector<K> ids_to_cache;
+    {
+      mutex_lock l(prefetch_mu_);
+      for (size_t i = 0; i < batch_size; ++i) {
+        K id = batch_ids[i];
+        auto it_prefetch = prefetch_id_table.find(id);
+        if (it_prefetch == prefetch_id_table.end()) {
+          LOG(FATAL)<<"The id should be prefetched before being used.";
+        }
+        it_prefetch->second->UnRef();
+        if (it_prefetch->second->ref_count() == 0) {
+          delete it_prefetch->second;
+          prefetch_id_table.erase(id);
+          ids_to_cache.emplace_back(id);
+        }
+      }
+    }
+    update(ids_to_cache.data(), ids_to_cache.size(), false);
+  }
+
+ private:
+  static const int kDefaultNumShards = 64;
+
+  struct ClockNode {
+    K id;
+    std::atomic<bool> referenced;
+    ClockNode* pre;
+    ClockNode* next;
+    explicit ClockNode(K id)
+        : id(id), referenced(false), pre(nullptr), next(nullptr) {}
+  };
+
+  // Nodes form a ring, new ones are inserted right behind the hand so
+  // that they are the last to be visited.
+  struct Shard {
+    mutex mu;
+    std::unordered_map<K, ClockNode*> index;
+    ClockNode* hand = nullptr;
+
+    void Insert(K id) {
+      ClockNode* node = new ClockNode(id);
+      if (hand == nullptr) {
+        node->pre = node->next = node;
+        hand = node;
+      } else {
+        node->next = hand;
+        node->pre = hand->pre;
+        hand->pre->next = node;
+        hand->pre = node;
+      }
+      index[id] = node;
+    }
+
+    void Remove(ClockNode* node) {
+      if (node->next == node) {
+        hand = nullptr;
+      } else {
+        node->pre->next = node->next;
+        node->next->pre = node->pre;
+        if (hand == node) {
+          hand = node->next;
+        }
+      }
+      index.erase(node->id);
+      delete node;
+    }
+
+    void Erase(K id) {
+      auto it = index.find(id);
+      if (it != index.end()) {
+        Remove(it->second);
+      }
+    }
+
+    // Sweeps the clock once, evicting unreferenced nodes and clearing the
+    // reference bit of the others.
+    size_t Evict(K* evic_ids, size_t k_size) {
+      size_t true_size = 0;
+      size_t steps = index.size();
+      for (; steps > 0 && true_size < k_size; --steps) {
+        ClockNode* node = hand;
+        if (node->referenced.load(std::memory_order_relaxed)) {
+          node->referenced.store(false, std::memory_order_relaxed);
+          hand = node->next;
+        } else {
+          evic_ids[true_size++] = node->id;
+          Remove(node);
+        }
+      }
+      return true_size;
+    }
+  };
+
+  size_t ShardOf(K id) const {
+    return ((static_cast<uint64>(id) * 0x9E3779B97F4A7C15ULL) >> 32) %
+        shards_.size();
+  }
+
+  std::vector<Shard> shards_;
+  std::atomic<size_t> evict_shard_;
+  std::unordered_map<K, PrefetchNode<K>*> prefetch_id_table;
+  mutex prefetch_mu_;
+  mutex stats_mu_;
+};
+
+// W-TinyLFU: new ids enter an LRU window and ids seen again live in a
+// segmented LRU of probation and protected ids. When the window is over
+// its share, its LRU id is only kept if the count-min sketch estimates it
+// more frequent than the LRU id of the main segments, so that one-hit
+// wonders do not push frequent ids out of the tier.
+template <class K>
+class TinyLFUCache : public BatchCache<K> {
+ public:
+  TinyLFUCache() : sketch_(kMinSketchWidth) {
+    BatchCache<K>::num_hit = 0;
+    BatchCache<K>::num_miss = 0;
+  }
+
+  size_t size() override {
+    mutex_lock l(mu_);
+    return key_table.size();
+  }
+
+  size_t get_evic_ids(K* evic_ids, size_t k_size) override {
+    mutex_lock l(mu_);
+    size_t true_size = 0;
+    while (true_size < k_size && !key_table.empty()) {
+      evic_ids[true_size++] = EvictOne();
+    }
+    return true_size;
+  }
+
+  size_t get_cached_ids(K* cached_ids, size_t k_size,
+                        int64* cached_versions,
+                        int64* cached_freqs) override {
+    mutex_lock l(mu_);
+    size_t i = 0;
+    for (auto* segment : {&protected_, &probation_, &window_}) {
+      for (auto it = segment->begin();
+           i < k_size && it != segment->end(); ++it) {
+        cached_ids[i] = *it;
+        if (cached_freqs != nullptr) {
+          cached_freqs[i] = sketch_.Estimate(*it);
+        }
+        i++;
+      }
+    }
+    return i;
+  }
+
+  void update(const K* batch_ids, size_t batch_size,
+              bool use_locking = true) override {
+    mutex temp_mu;
+    auto lock = BatchCache<K>::maybe_lock_cache(mu_, temp_mu, use_locking);
+    for (size_t i = 0; i < batch_size; ++i) {
+      Access(batch_ids[i], 1);
+    }
+  }
+
+  void update(const K* batch_ids, size_t batch_size,
+              const int64* batch_versions,
+              const int64* batch_freqs,
+              bool use_locking = true) override {
+    mutex temp_mu;
+    auto lock = BatchCache<K>::maybe_lock_cache(mu_, temp_mu, use_locking);
+    for (size_t i = 0; i < batch_size; ++i) {
+      Access(batch_ids[i], batch_freqs == nullptr ? 1 : batch_freqs[i]);
+    }
+  }
+
+  void add_to_prefetch_list(const K* batch_ids,
+                            const size_t batch_size) override {
+    mutex_lock l(mu_);
+    for (size_t i = 0; i < batch_size; ++i) {
+      K id = batch_ids[i];
+      auto it_prefetch = prefetch_id_table.find(id);
+      if (it_prefetch == prefetch_id_table.end()) {
+        auto it_cache = key_table.find(id);
+        if (it_cache != key_table.end()) {
+          SegmentOf(it_cache->second.segment)->erase(it_cache->second.it);
+          key_table.erase(it_cache);
+        }
+        prefetch_id_table[id] = new PrefetchNode<K>(id);
+      } else {
+        it_prefetch->second->Ref();
+      }
+    }
+  }
+
+  void add_to_cache(const K* batch_ids, const size_t batch_size) override {
+    mutex_lock l(mu_);
+    std::vector<K> ids_to_cache(batch_size);
+    int64 nums_to_cache = 0;
+    for (size_t i = 0; i < batch_size; ++i) {
+      K id = batch_ids[i];
+      auto it_prefetch = prefetch_id_table.find(id);
+      if (it_prefetch == prefetch_id_table.end()) {
+        LOG(FATAL)<<"The id should be prefetched before being used.";
+      }
+      it_prefetch->second->UnRef();
+      if (it_prefetch->second->ref_count() == 0) {
+        delete it_prefetch->second;
+        prefetch_id_table.erase(id);
+        ids_to_cache[nums_to_cache] = id;
+        nums_to_cache++;
+      }
+    }
+    update(ids_to_cache.data(), nums_to_cache, false);
+  }
+
+ private:
+  static const int64 kMinSketchWidth = 1024;
+  static const int64 kMaxSketchAdds = 16;
+
+  enum Segment { kWindow, kProbation, kProtected };
+
+  struct Entry {
+    Segment segment;
+    typename std::list<K>::iterator it;
+  };
+
+  std::list<K>* SegmentOf(Segment segment) {
+    switch (segment) {
+      case kWindow:
+        return &window_;
+      case kProbation:
+        return &probation_;
+      default:
+        return &protected_;
+    }
+  }
+
+  void MoveToFront(Entry* entry, Segment segment, K id) {
+    SegmentOf(entry->segment)->erase(entry->it);
+    SegmentOf(segment)->emplace_front(id);
+    entry->segment = segment;
+    entry->it = SegmentOf(segment)->begin();
+  }
+
+  void Access(K id, int64 count) {
+    // The sketch should hold a few counters per cached id, otherwise its
+    // estimates saturate; widening it drops the history.
+    if (key_table.size() * 4 > sketch_.width()) {
+      sketch_.Resize(sketch_.width() * 2);
+    }
+    for (int64 i = 0; i < std::min(count, kMaxSketchAdds); i++) {
+      sketch_.Add(id);
+    }
+    auto it = key_table.find(id);
+    if (it == key_table.end()) {
+      window_.emplace_front(id);
+      key_table[id] = Entry{kWindow, window_.begin()};
+      BatchCache<K>::num_miss++;
+      return;
+    }
+    // Ids seen again leave the window and probation for protected, which
+    // takes at most 80% of the main segments.
+    MoveToFront(&it->second, kProtected, id);
+    size_t main_size = probation_.size() + protected_.size();
+    while (protected_.size() * 5 > main_size * 4) {
+      K demoted = protected_.back();
+      MoveToFront(&key_table[demoted], kProbation, demoted);
+    }
+    BatchCache<K>::num_hit++;
+  }
+
+  K EvictOne() {
+    std::list<K>* victims = probation_.empty() ? &protected_ : &probation_;
+    if (victims->empty()) {
+      victims = &window_;
+    } else if (!window_.empty()) {
+      // While the window is over its 1% share its LRU id is only kept if
+      // it is estimated more frequent than the LRU id of the main segments.
+      size_t window_capacity = std::max(key_table.size() / 100,
+                                        static_cast<size_t>(1));
+      if (window_.size() > window_capacity &&
+          sketch_.Estimate(window_.back()) <=
+          sketch_.Estimate(victims->back())) {
+        victims = &window_;
+      }
+    }
+    K id = victims->back();
+    victims->pop_back();
+    key_table.erase(id);
+    return id;
+  }
+
+  std::list<K> window_;
+  std::list<K> probation_;
+  std::list<K> protected_;
+  std::unordered_map<K, Entry> key_table;
+  std::unordered_map<K, PrefetchNode<K>*> prefetch_id_table;
+  CountMinSketch<K> sketch_;
+  mutex mu_;
+};
+
+// Unified frequency-and-recency policy. One compact record per id holds its
+// frequency, the batch of its last access and its prefetch pins, instead of
+// the frequency lists of LFUCache plus a PrefetchLFUNode per prefetched id.
+// The frequency of an id is halved for every TF_MULTI_TIER_EV_CACHE_HALF_LIFE
+// batches since its last access, so ids which were hot long ago are demoted
+// before ids of moderate but recent use. Victims are the least scored of a
+// sample of unpinned ids scanned from a rotating bucket, which keeps an
+// eviction of k ids O(k) whatever the size of the cache.
+template <class K>
+class FreqRecencyCache : public BatchCache<K> {
+ public:
+  FreqRecencyCache() : tick_(0), num_pinned_(0), cursor_(0) {
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_MULTI_TIER_EV_CACHE_HALF_LIFE",
+                                    1000, &half_life_));
+    half_life_ = std::max(half_life_, static_cast<int64>(1));
+    BatchCache<K>::num_hit = 0;
+    BatchCache<K>::num_miss = 0;
+  }
+
+  size_t size() override {
+    mutex_lock l(mu_);
+    return key_table.size() - num_pinned_;
+  }
+
+  size_t get_evic_ids(K* evic_ids, size_t k_size) override {
+    mutex_lock l(mu_);
+    k_size = std::min(k_size, key_table.size() - num_pinned_);
+    if (k_size == 0) {
+      return 0;
+    }
+    size_t sample_size = std::max(k_size * kSampleFactor,
+                                  static_cast<size_t>(kMinSampleSize));
+    std::vector<std::pair<uint64, K>> candidates;
+    size_t num_buckets = key_table.bucket_count();
+    for (size_t i = 0;
+         i < num_buckets && candidates.size() < sample_size; ++i) {
+      cursor_ = (cursor_ + 1) % num_buckets;
+      for (auto it = key_table.begin(cursor_);
+           it != key_table.end(cursor_); ++it) {
+        if (it->second.pins == 0) {
+          candidates.emplace_back(Score(it->second), it->first);
+        }
+      }
+    }
+    std::nth_element(candidates.begin(), candidates.begin() + k_size - 1,
+                     candidates.end());
+    for (size_t i = 0; i < k_size; ++i) {
+      evic_ids[i] = candidates[i].second;
+      key_table.erase(candidates[i].second);
+    }
+    return k_size;
+  }
+
+  size_t get_cached_ids(K* cached_ids, size_t k_size,
+                        int64* cached_versions,
+                        int64* cached_freqs) override {
+    mutex_lock l(mu_);
+    std::vector<std::pair<uint64, K>> ids;
+    ids.reserve(key_table.size() - num_pinned_);
+    for (auto& it : key_table) {
+      if (it.second.pins == 0) {
+        ids.emplace_back(Score(it.second), it.first);
+      }
+    }
+    k_size = std::min(k_size, ids.size());
+    std::partial_sort(ids.begin(), ids.begin() + k_size, ids.end(),
+                      std::greater<std::pair<uint64, K>>());
+    for (size_t i = 0; i < k_size; ++i) {
+      cached_ids[i] = ids[i].second;
+      if (cached_freqs != nullptr) {
+        cached_freqs[i] = key_table[ids[i].second].freq;
+      }
+    }
+    return k_size;
+  }
+
+  void update(const K* batch_ids, size_t batch_size,
+              bool use_locking = true) override {
+    mutex temp_mu;
+    auto lock = BatchCache<K>::maybe_lock_cache(mu_, temp_mu, use_locking);
+    tick_++;
+    for (size_t i = 0; i < batch_size; ++i) {
+      Access(batch_ids[i], 1);
+    }
+  }
+
+  void update(const K* batch_ids, size_t batch_size,
+              const int64* batch_versions,
+              const int64* batch_freqs,
+              bool use_locking = true) override {
+    mutex temp_mu;
+    auto lock = BatchCache<K>::maybe_lock_cache(mu_, temp_mu, use_locking);
+    tick_++;
+    for (size_t i = 0; i < batch_size; ++i) {
+      Access(batch_ids[i], batch_freqs == nullptr ? 1 : batch_freqs[i]);
+    }
+  }
+
+  // Pinned ids are not evicted until add_to_cache releases their pins.
+  void add_to_prefetch_list(const K* batch_ids,
+                            const size_t batch_size) override {
+    mutex_lock l(mu_);
+    for (size_t i = 0; i < batch_size; ++i) {
+      auto it = key_table.find(batch_ids[i]);
+      if (it == key_table.end()) {
+        key_table[batch_ids[i]] = Record{1, static_cast<uint32>(tick_), 1};
+        num_pinned_++;
+      } else if (it->second.pins++ == 0) {
+        num_pinned_++;
+      } else {
+        Increment(&it->second, 1);
+      }
+    }
+  }
+
+  void add_to_cache(const K* batch_ids, const size_t batch_size) override {
+    mutex_lock l(mu_);
+    for (size_t i = 0; i < batch_size; ++i) {
+      auto it = key_table.find(batch_ids[i]);
+      if (it == key_table.end() || it->second.pins == 0) {
+        LOG(FATAL)<<"The id should be prefetched before being used.";
+      }
+      if (--it->second.pins == 0) {
+        it->second.last_access = static_cast<uint32>(tick_);
+        num_pinned_--;
+      }
+    }
+  }
+
+ private:
+  static const size_t kSampleFactor = 8;
+  static const size_t kMinSampleSize = 64;
+
+  struct Record {
+    uint32 freq;
+    uint32 last_access;
+    uint32 pins;
+  };
+
+  void Increment(Record* record, int64 count) {
+    record->freq = static_cast<uint32>(std::min(
+        static_cast<int64>(record->freq) + count,
+        static_cast<int64>(std::numeric_limits<uint32>::max())));
+  }
+
+  void Access(K id, int64 count) {
+    auto it = key_table.find(id);
+    if (it == key_table.end()) {
+      key_table[id] = Record{0, static_cast<uint32>(tick_), 0};
+      Increment(&key_table[id], count);
+      BatchCache<K>::num_miss++;
+      return;
+    }
+    Increment(&it->second, count);
+    it->second.last_access = static_cast<uint32>(tick_);
+    BatchCache<K>::num_hit++;
+  }
+
+  uint64 Score(const Record& record) const {
+    uint32 age = static_cast<uint32>(tick_) - record.last_access;
+    int64 halvings = age / half_life_;
+    return halvings >= 32 ? 0 : record.freq >> halvings;
+  }
+
+  int64 half_life_;
+  int64 tick_;
+  size_t num_pinned_;
+  size_t cursor_;
+  std::unordered_map<K, Record> key_table;
+  mutex mu_;
+};
+
 } // embedding
 } // tensorflow
 
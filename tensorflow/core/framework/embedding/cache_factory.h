@@ -33,6 +33,18 @@ class CacheFactory {
         LOG(INFO) << " Use Storage::LFU in multi-tier EmbeddingVariable "
                 << name;
         return new LFUCache<K>();
+      case CacheStrategy::SHARDED_CLOCK:
+        LOG(INFO) << " Use Storage::SHARDED_CLOCK in multi-tier EmbeddingVariable "
+                << name;
+        return new ShardedClockCache<K>();
+      case CacheStrategy::W_TINY_LFU:
+        LOG(INFO) << " Use Storage::W_TINY_LFU in multi-tier EmbeddingVariable "
+                << name;
+        return new TinyLFUCache<K>();
+      case CacheStrategy::FREQ_RECENCY:
+        LOG(INFO) << " Use Storage::FREQ_RECENCY in multi-tier EmbeddingVariable "
+                << name;
+        return new FreqRecencyCache<K>();
       default:
         LOG(INFO) << " Invalid Cache strategy, \
                        use LFU in multi-tier EmbeddingVariable "
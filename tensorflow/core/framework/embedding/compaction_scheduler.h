@@ -0,0 +1,210 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_COMPACTION_SCHEDULER_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_COMPACTION_SCHEDULER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace embedding {
+
+struct CompactionMetrics {
+  int64 bytes_written = 0;
+  int64 bytes_rewritten = 0;
+  int64 files_compacted = 0;
+  int64 read_stalls = 0;
+  int64 throttled_micros = 0;
+
+  // (bytes written by commits + bytes rewritten by compaction) /
+  // bytes written by commits.
+  double WriteAmplification() const {
+    if (bytes_written == 0) {
+      return 1.0;
+    }
+    return 1.0 + static_cast<double>(bytes_rewritten) / bytes_written;
+  }
+
+  std::string DebugString() const {
+    return strings::StrCat("bytes_written: ", bytes_written,
+                           ", bytes_rewritten: ", bytes_rewritten,
+                           ", write_amplification: ", WriteAmplification(),
+                           ", files_compacted: ", files_compacted,
+                           ", read_stalls: ", read_stalls,
+                           ", throttled_micros: ", throttled_micros);
+  }
+};
+
+// Paces the compaction of SSDHashKV against the foreground lookups:
+//  * TF_SSDHASH_COMPACTION_BANDWIDTH_MB caps the bytes compaction reads
+//    and rewrites per second, 0 means unlimited.
+//  * With TF_SSDHASH_COMPACTION_LOW_PRIORITY compaction pauses while
+//    foreground lookups are reading, for at most kMaxYieldMicros per
+//    check.
+//  * TF_SSDHASH_COMPACTION_MAX_FILES caps the files compacted per round,
+//    0 means all the candidates.
+class CompactionScheduler {
+ public:
+  CompactionScheduler() {
+    int64 bandwidth_mb = 0;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_SSDHASH_COMPACTION_BANDWIDTH_MB",
+                                    0, &bandwidth_mb));
+    bytes_per_sec_ = bandwidth_mb << 20;
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_SSDHASH_COMPACTION_LOW_PRIORITY",
+                                   false, &low_priority_));
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_SSDHASH_COMPACTION_MAX_FILES",
+                                    0, &max_files_per_round_));
+  }
+
+  struct Candidate {
+    int64 version;
+    int64 count;
+    int64 invalid_count;
+  };
+
+  // Orders the candidates by the cost-benefit score of LFS cleaning,
+  // garbage * age / (1 + live): files with more garbage cost less to
+  // rewrite, and the live records of old files are unlikely to be updated
+  // soon. Returns the versions of the files to compact in this round.
+  std::vector<int64> PickVictims(std::vector<Candidate>& candidates,
+                                 int64 latest_version) const {
+    auto score = [latest_version](const Candidate& c) {
+      double garbage = (c.count == 0) ?
+          0.0 : static_cast<double>(c.invalid_count) / c.count;
+      double age = latest_version - c.version + 1;
+      return garbage * age / (2.0 - garbage);
+    };
+    std::sort(candidates.begin(), candidates.end(),
+              [&score](const Candidate& a, const Candidate& b) {
+                return score(a) > score(b);
+              });
+    size_t num_victims = candidates.size();
+    if (max_files_per_round_ > 0) {
+      num_victims = std::min(num_victims,
+                             static_cast<size_t>(max_files_per_round_));
+    }
+    std::vector<int64> victims;
+    for (size_t i = 0; i < num_victims; i++) {
+      victims.emplace_back(candidates[i].version);
+    }
+    return victims;
+  }
+
+  // Called by compaction before it reads and rewrites bytes.
+  void Throttle(int64 bytes) {
+    WaitForForegroundReads();
+    if (bytes_per_sec_ <= 0) {
+      return;
+    }
+    pending_bytes_ += bytes;
+    if (pending_bytes_ < kThrottleGranularity) {
+      return;
+    }
+    uint64 now = Env::Default()->NowMicros();
+    next_micros_ = std::max(next_micros_, now) +
+        pending_bytes_ * 1000000 / bytes_per_sec_;
+    pending_bytes_ = 0;
+    if (next_micros_ > now + kMaxBurstMicros) {
+      int64 wait_micros = next_micros_ - now - kMaxBurstMicros;
+      Env::Default()->SleepForMicroseconds(wait_micros);
+      throttled_micros_ += wait_micros;
+    }
+  }
+
+  void StartCompaction() {
+    is_compacting_ = true;
+  }
+
+  void FinishCompaction(int64 num_files) {
+    is_compacting_ = false;
+    files_compacted_ += num_files;
+  }
+
+  void StartForegroundRead() {
+    num_foreground_reads_++;
+    if (is_compacting_) {
+      read_stalls_++;
+    }
+  }
+
+  void FinishForegroundRead() {
+    num_foreground_reads_--;
+  }
+
+  void RecordWrite(int64 bytes) {
+    bytes_written_ += bytes;
+  }
+
+  void RecordRewrite(int64 bytes) {
+    bytes_rewritten_ += bytes;
+  }
+
+  CompactionMetrics GetMetrics() const {
+    CompactionMetrics metrics;
+    metrics.bytes_written = bytes_written_;
+    metrics.bytes_rewritten = bytes_rewritten_;
+    metrics.files_compacted = files_compacted_;
+    metrics.read_stalls = read_stalls_;
+    metrics.throttled_micros = throttled_micros_;
+    return metrics;
+  }
+
+ private:
+  void WaitForForegroundReads() {
+    if (!low_priority_) {
+      return;
+    }
+    int64 waited = 0;
+    while (num_foreground_reads_ > 0 && waited < kMaxYieldMicros) {
+      Env::Default()->SleepForMicroseconds(kYieldMicros);
+      waited += kYieldMicros;
+    }
+    throttled_micros_ += waited;
+  }
+
+  static const int64 kThrottleGranularity = 1 << 20;
+  static const int64 kMaxBurstMicros = 10000;
+  static const int64 kYieldMicros = 50;
+  static const int64 kMaxYieldMicros = 5000;
+
+  int64 bytes_per_sec_ = 0;
+  bool low_priority_ = false;
+  int64 max_files_per_round_ = 0;
+
+  // Only touched by the compacting thread.
+  int64 pending_bytes_ = 0;
+  uint64 next_micros_ = 0;
+
+  std::atomic<bool> is_compacting_{false};
+  std::atomic<int64> num_foreground_reads_{0};
+  std::atomic<int64> bytes_written_{0};
+  std::atomic<int64> bytes_rewritten_{0};
+  std::atomic<int64> files_compacted_{0};
+  std::atomic<int64> read_stalls_{0};
+  std::atomic<int64> throttled_micros_{0};
+};
+
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_COMPACTION_SCHEDULER_H_
@@ -0,0 +1,137 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_COUNT_MIN_SKETCH_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_COUNT_MIN_SKETCH_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// The hash function of the counting bloom filter, fasthash64 of one key.
+inline uint64 SketchHash64(uint64 key, uint64 seed) {
+  auto mix = [](uint64 h) {
+    h ^= h >> 23;
+    h *= 0x2127599bf4325c37ULL;
+    h ^= h >> 47;
+    return h;
+  };
+  const uint64 m = 0x880355f21e6d1965ULL;
+  uint64 h = seed ^ (8 * m);
+  h ^= mix(key);
+  h *= m;
+  h ^= mix(0);
+  h *= m;
+  return mix(h);
+}
+
+// Returns num_hash_func distinct prime seeds for SketchHash64.
+inline std::vector<int64> GenerateSketchSeeds(int64 num_hash_func) {
+  static const std::vector<int64> default_seeds = {
+    2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41,
+    43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97
+  };
+  std::vector<int64> seeds;
+  for (int64 i = 0; i < num_hash_func && i < default_seeds.size(); i++) {
+    seeds.emplace_back(default_seeds[i]);
+  }
+  for (int64 j = 101; seeds.size() < num_hash_func; j += 2) {
+    bool is_prime = true;
+    for (int64 k = 3; k * k <= j; k += 2) {
+      if (j % k == 0) {
+        is_prime = false;
+        break;
+      }
+    }
+    if (is_prime) {
+      seeds.emplace_back(j);
+    }
+  }
+  return seeds;
+}
+
+// Count-min sketch with 4-bit saturating counters which are halved every
+// sample of 10 * width additions, so that the estimated frequencies follow
+// shifts of the traffic. Not thread-safe.
+template <typename K>
+class CountMinSketch {
+ public:
+  explicit CountMinSketch(int64 width, int64 depth = 4)
+      : depth_(depth), seeds_(GenerateSketchSeeds(depth)) {
+    Resize(width);
+  }
+
+  void Add(K key) {
+    for (int64 i = 0; i < depth_; i++) {
+      uint8& counter = counters_[Index(key, i)];
+      if (counter < kMaxCount) {
+        counter++;
+      }
+    }
+    if (++num_added_ >= sample_size_) {
+      Age();
+    }
+  }
+
+  int64 Estimate(K key) const {
+    uint8 min_count = kMaxCount;
+    for (int64 i = 0; i < depth_; i++) {
+      min_count = std::min(min_count, counters_[Index(key, i)]);
+    }
+    return min_count;
+  }
+
+  // Clears all the counters.
+  void Resize(int64 width) {
+    width_ = std::max(width, static_cast<int64>(16));
+    counters_.assign(width_ * depth_, 0);
+    sample_size_ = 10 * width_;
+    num_added_ = 0;
+  }
+
+  int64 width() const {
+    return width_;
+  }
+
+ private:
+  static const uint8 kMaxCount = 15;
+
+  int64 Index(K key, int64 i) const {
+    return i * width_ + SketchHash64(key, seeds_[i]) % width_;
+  }
+
+  void Age() {
+    for (auto& counter : counters_) {
+      counter >>= 1;
+    }
+    num_added_ /= 2;
+  }
+
+  int64 width_;
+  int64 depth_;
+  int64 sample_size_;
+  int64 num_added_;
+  std::vector<int64> seeds_;
+  std::vector<uint8> counters_;
+};
+
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_COUNT_MIN_SKETCH_H_
@@ -50,6 +50,28 @@ class LocklessHashMap : public KVInterface<K, V> {
     }
   }
 
+  Status BatchLookup(const K* keys, size_t size,
+                     ValuePtr<V>** value_ptrs) override {
+    // Prefetch the home bucket of keys PREFETCH_DISTANCE_ ahead of the
+    // probe, so that several cache misses are in flight at the same time.
+    for (size_t i = 0; i < size && i < PREFETCH_DISTANCE_; i++) {
+      hash_map_.prefetch_wait_free(keys[i]);
+    }
+    for (size_t i = 0; i < size; i++) {
+      if (i + PREFETCH_DISTANCE_ < size) {
+        hash_map_.prefetch_wait_free(keys[i + PREFETCH_DISTANCE_]);
+      }
+      K key = keys[i];
+      auto iter = hash_map_.find_wait_free(key);
+      if (iter.first == LocklessHashMap<K, V>::EMPTY_KEY_) {
+        value_ptrs[i] = nullptr;
+      } else {
+        value_ptrs[i] = iter.second;
+      }
+    }
+    return Status::OK();
+  }
+
   Status Contains(K key) override {
     auto iter = hash_map_.find_wait_free(key);
     if (iter.first == LocklessHashMap<K, V>::EMPTY_KEY_) {
@@ -78,6 +100,11 @@ class LocklessHashMap : public KVInterface<K, V> {
     return hash_map_.size_lockless();
   }
 
+  // Not lockless, only for the KV not being accessed, e.g. on restoring.
+  void Reserve(int64 num_keys) override {
+    hash_map_.resize(num_keys);
+  }
+
   // Remove KV
   Status Remove(K key) override {
     if (hash_map_.erase_lockless(key)) {
@@ -124,6 +151,7 @@ class LocklessHashMap : public KVInterface<K, V> {
   typedef google::dense_hash_map_lockless<K, ValuePtr<V>*> LockLessHashMap;
   static const int EMPTY_KEY_;
   static const int DELETED_KEY_;
+  static constexpr size_t PREFETCH_DISTANCE_ = 8;
   LockLessHashMap hash_map_;
 };
 template <class K, class V>
@@ -0,0 +1,147 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_CPU_PLAN_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_CPU_PLAN_H_
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// Disjoint cpu sets of the threads of a process, configured by TF_CPU_PLAN:
+//
+//   TF_CPU_PLAN="reactor:0-3;background:4,5;compute:6-31"
+//
+//  * reactor: the network threads, the Seastar reactor shards of the star
+//    servers.
+//  * compute: the inter and intra op pools, where EmbeddingVariable
+//    lookups and applies run. Defaults to the schedulable cpus left by the
+//    other sets.
+//  * background: the EmbeddingVariable eviction and compaction threads.
+//
+// An empty set leaves its threads unpinned.
+struct CpuPlan {
+  std::vector<unsigned> reactor;
+  std::vector<unsigned> compute;
+  std::vector<unsigned> background;
+
+  bool empty() const {
+    return reactor.empty() && compute.empty() && background.empty();
+  }
+};
+
+// Parses a cpu list such as "0-3,8".
+inline bool ParseCpuList(StringPiece spec, std::vector<unsigned>* cpus) {
+  for (const string& range : str_util::Split(spec, ',', str_util::SkipEmpty())) {
+    std::vector<string> bounds = str_util::Split(range, '-');
+    uint32 first = 0, last = 0;
+    if (bounds.size() > 2 || !strings::safe_strtou32(bounds[0], &first)) {
+      return false;
+    }
+    last = first;
+    if (bounds.size() == 2 && !strings::safe_strtou32(bounds[1], &last)) {
+      return false;
+    }
+    if (last < first) return false;
+    for (uint32 c = first; c <= last; ++c) {
+      cpus->push_back(c);
+    }
+  }
+  return true;
+}
+
+// Returns false if 'spec' is malformed or its sets overlap.
+inline bool ParseCpuPlan(const string& spec, CpuPlan* plan) {
+  *plan = CpuPlan();
+  std::set<unsigned> used;
+  for (const string& entry : str_util::Split(spec, ';', str_util::SkipEmpty())) {
+    std::vector<string> kv = str_util::Split(entry, ':');
+    if (kv.size() != 2) return false;
+    std::vector<unsigned>* cpus = nullptr;
+    if (kv[0] == "reactor") {
+      cpus = &plan->reactor;
+    } else if (kv[0] == "compute") {
+      cpus = &plan->compute;
+    } else if (kv[0] == "background") {
+      cpus = &plan->background;
+    } else {
+      return false;
+    }
+    if (!cpus->empty() || !ParseCpuList(kv[1], cpus)) return false;
+    for (unsigned c : *cpus) {
+      if (!used.insert(c).second) return false;
+    }
+  }
+  if (plan->compute.empty() && !used.empty()) {
+    for (int c = 0; c < port::NumSchedulableCPUs(); ++c) {
+      if (used.count(c) == 0) plan->compute.push_back(c);
+    }
+  }
+  return true;
+}
+
+// The plan of the process, an empty one without TF_CPU_PLAN.
+inline const CpuPlan& GetCpuPlan() {
+  static CpuPlan* plan = [] {
+    CpuPlan* p = new CpuPlan;
+    string spec;
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_CPU_PLAN", "", &spec));
+    if (!spec.empty() && !ParseCpuPlan(spec, p)) {
+      LOG(ERROR) << "Invalid TF_CPU_PLAN: " << spec << ", threads are not"
+                 << " pinned.";
+      *p = CpuPlan();
+    }
+    return p;
+  }();
+  return *plan;
+}
+
+// Pins the calling thread to 'cpus', nothing if it is empty.
+inline void PinCurrentThread(const std::vector<unsigned>& cpus) {
+#if defined(__linux__)
+  if (cpus.empty()) return;
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  for (unsigned c : cpus) {
+    CPU_SET(c, &cpuset);
+  }
+  if (sched_setaffinity(0, sizeof(cpu_set_t), &cpuset) != 0) {
+    LOG(WARNING) << "Failed to pin thread to the TF_CPU_PLAN cpus.";
+  }
+#endif
+}
+
+// Called first by the eviction and compaction threads.
+inline void PinBackgroundThread() {
+  PinCurrentThread(GetCpuPlan().background);
+}
+
+}  // namespace embedding
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_CPU_PLAN_H_
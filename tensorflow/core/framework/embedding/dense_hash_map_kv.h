@@ -58,6 +58,28 @@ class DenseHashMap : public KVInterface<K, V> {
     }
   }
 
+  Status BatchLookup(const K* keys, size_t size,
+                     ValuePtr<V>** value_ptrs) override {
+    // dense_hash_map doesn't expose its buckets, so only the partition
+    // (lock and table header) of keys ahead of the probe is prefetched.
+    for (size_t i = 0; i < size; i++) {
+      if (i + PREFETCH_DISTANCE_ < size) {
+        int64 next_id =
+            std::abs(keys[i + PREFETCH_DISTANCE_]) % partition_num_;
+        __builtin_prefetch(&hash_map_[next_id], 0, 1);
+      }
+      int64 l_id = std::abs(keys[i]) % partition_num_;
+      spin_rd_lock l(hash_map_[l_id].mu);
+      auto iter = hash_map_[l_id].hash_map.find(keys[i]);
+      if (iter == hash_map_[l_id].hash_map.end()) {
+        value_ptrs[i] = nullptr;
+      } else {
+        value_ptrs[i] = iter->second;
+      }
+    }
+    return Status::OK();
+  }
+
   Status Contains(K key) override {
     int64 l_id = std::abs(key)%partition_num_;
     spin_rd_lock l(hash_map_[l_id].mu);
@@ -96,6 +118,13 @@ class DenseHashMap : public KVInterface<K, V> {
     return ret;
   }
 
+  void Reserve(int64 num_keys) override {
+    for (int i = 0; i< partition_num_; i++) {
+      spin_wr_lock l(hash_map_[i].mu);
+      hash_map_[i].hash_map.resize(num_keys / partition_num_ + 1);
+    }
+  }
+
   // Remove KV
   Status Remove(K key) override {
     int64 l_id = std::abs(key)%partition_num_;
@@ -124,12 +153,27 @@ class DenseHashMap : public KVInterface<K, V> {
     return Status::OK();
   }
 
+  int64 NumSnapshotSlices() const override {
+    return partition_num_;
+  }
+
+  Status GetSnapshotSlice(int64 slice, std::vector<K>* key_list,
+      std::vector<ValuePtr<V>* >* value_ptr_list) override {
+    spin_rd_lock l(hash_map_[slice].mu);
+    for (const auto it : hash_map_[slice].hash_map) {
+      key_list->push_back(it.first);
+      value_ptr_list->push_back(it.second);
+    }
+    return Status::OK();
+  }
+
   std::string DebugString() const override {
     return "";
   }
 
  private:
   const int partition_num_ = 1000;
+  static constexpr size_t PREFETCH_DISTANCE_ = 8;
   struct dense_hash_map {
     mutable easy_spinrwlock_t mu = EASY_SPINRWLOCK_INITIALIZER;
     google::dense_hash_map<K, ValuePtr<V>* > hash_map;
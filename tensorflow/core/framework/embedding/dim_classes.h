@@ -0,0 +1,106 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_DIM_CLASSES_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_DIM_CLASSES_H_
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// The dimension classes of the mixed_dim layout:
+//  * TF_EV_DIM_CLASSES is the ascending dims of the rows smaller than
+//    value_len, e.g. "4,16".
+//  * TF_EV_DIM_PROMOTION_FREQS is the frequencies promoting the rows out of
+//    each class, e.g. "10,100": rows with freq < 10 keep 4 dims, rows with
+//    10 <= freq < 100 keep 16 dims and the others keep value_len dims.
+// Missing dims of the rows read as 0. The dims of a class are at most 255,
+// they are kept in one byte of the row header.
+class DimClasses {
+ public:
+  DimClasses() {}
+
+  explicit DimClasses(int64 value_len) {
+    std::string dims_str, freqs_str;
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_EV_DIM_CLASSES", "", &dims_str));
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_EV_DIM_PROMOTION_FREQS", "",
+                                     &freqs_str));
+    std::vector<int64> dims = ParseList(dims_str);
+    std::vector<int64> freqs = ParseList(freqs_str);
+    if (dims.size() != freqs.size()) {
+      LOG(WARNING) << "TF_EV_DIM_CLASSES and TF_EV_DIM_PROMOTION_FREQS"
+                   << " should have the same length, all the rows keep"
+                   << " value_len dims.";
+      return;
+    }
+    for (size_t i = 0; i < dims.size(); i++) {
+      if (dims[i] <= 0 || dims[i] >= value_len || dims[i] > kMaxDims ||
+          (!dims_.empty() &&
+           (dims[i] <= dims_.back() || freqs[i] <= freqs_.back()))) {
+        LOG(WARNING) << "Invalid dim class " << dims[i] << " with freq "
+                     << freqs[i] << " of value_len " << value_len
+                     << ", ignore it.";
+        continue;
+      }
+      dims_.emplace_back(dims[i]);
+      freqs_.emplace_back(freqs[i]);
+    }
+  }
+
+  bool empty() const {
+    return dims_.empty();
+  }
+
+  // Returns 0 for the rows keeping all value_len dims.
+  int64 Dims(int64 freq) const {
+    auto it = std::upper_bound(freqs_.begin(), freqs_.end(), freq);
+    if (it == freqs_.end()) {
+      return 0;
+    }
+    return dims_[it - freqs_.begin()];
+  }
+
+ private:
+  static const int64 kMaxDims = 255;
+
+  static std::vector<int64> ParseList(const std::string& str) {
+    std::vector<int64> values;
+    for (auto& s : str_util::Split(str, ',', str_util::SkipEmpty())) {
+      int64 value;
+      if (strings::safe_strto64(s, &value)) {
+        values.emplace_back(value);
+      } else {
+        LOG(WARNING) << "Invalid integer " << s << " in " << str;
+      }
+    }
+    return values;
+  }
+
+  std::vector<int64> dims_;
+  std::vector<int64> freqs_;
+};
+
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_DIM_CLASSES_H_
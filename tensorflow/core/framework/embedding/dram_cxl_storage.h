@@ -0,0 +1,301 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_DRAM_CXL_STORAGE_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_DRAM_CXL_STORAGE_H_
+
+#include "tensorflow/core/framework/embedding/multi_tier_storage.h"
+#include "tensorflow/core/framework/embedding/single_tier_storage.h"
+#include "tensorflow/core/framework/embedding/cpu_hash_map_kv.h"
+#include "tensorflow/core/platform/numa.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+template <class V>
+class ValuePtr;
+
+template <class K, class V>
+class EmbeddingVar;
+
+namespace embedding {
+
+// Two tiers of byte-addressable memory: near DRAM, and far memory exposed
+// as a CPU-less NUMA node, e.g. CXL-attached memory. The far tier allocates
+// its rows from the EV allocator of node TF_EV_CXL_NUMA_NODE (by default
+// the last node) and they are read and updated in place, so there is no
+// copy back on lookups. Updates promote the rows whose frequency reaches
+// TF_EV_CXL_PROMOTE_FREQ (default 8) to DRAM, and the eviction of the cache
+// demotes them again.
+template<typename K, typename V>
+class DramCxlStorage : public MultiTierStorage<K, V> {
+ public:
+  DramCxlStorage(const StorageConfig& sc, Allocator* dram_alloc,
+      LayoutCreator<V>* lc, const std::string& name)
+      : MultiTierStorage<K, V>(sc, name) {
+    int64 cxl_node;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_CXL_NUMA_NODE",
+                                    port::NUMANumNodes() - 1, &cxl_node));
+    if (port::NUMANumNodes() == 1) {
+      LOG(WARNING) << "No far memory NUMA node, the CXL tier of " << name
+                   << " allocates from DRAM.";
+      cxl_node = port::kNUMANoAffinity;
+    }
+    dram_ = new DramStorage<K, V>(sc, dram_alloc, lc,
+        new LocklessHashMap<K, V>());
+    cxl_ = new DramStorage<K, V>(sc, numa_ev_allocator(cxl_node), lc,
+        new LocklessHashMap<K, V>());
+    value_ptr_size_ =
+        const_cast<EmbeddingConfig&>(sc.embedding_config).total_num(
+            Storage<K, V>::GetAllocLen());
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_CXL_PROMOTE_FREQ", 8,
+                                    &promote_freq_));
+  }
+
+  ~DramCxlStorage() override {
+    MultiTierStorage<K, V>::DeleteFromEvictionManager();
+    delete dram_;
+    delete cxl_;
+  }
+
+  TF_DISALLOW_COPY_AND_ASSIGN(DramCxlStorage);
+
+  Status Get(K key, ValuePtr<V>** value_ptr) override {
+    Status s = dram_->Get(key, value_ptr);
+    if (s.ok()) {
+      return s;
+    }
+    return cxl_->Get(key, value_ptr);
+  }
+
+  // Prefetches the headers of the rows of the batch while the rest of the
+  // batch is looked up, hiding part of the latency of the far tier.
+  void BatchGet(const K* key, ValuePtr<V>** value_ptr_list,
+                int64 num_of_keys) override {
+    for (int64 i = 0; i < num_of_keys; i++) {
+      if (!Get(key[i], &value_ptr_list[i]).ok()) {
+        value_ptr_list[i] = nullptr;
+        continue;
+      }
+      __builtin_prefetch(value_ptr_list[i]->GetPtr(), 0, 1);
+    }
+  }
+
+  void Insert(K key, ValuePtr<V>* value_ptr) override {
+    LOG(FATAL)<<"Unsupport Insert(K, ValuePtr<V>*) in DramCxlStorage.";
+  }
+
+  void Insert(K key, ValuePtr<V>** value_ptr,
+              size_t alloc_len) override {
+    dram_->Insert(key, value_ptr, alloc_len);
+  }
+
+  Status GetOrCreate(K key, ValuePtr<V>** value_ptr,
+      size_t size, CopyBackFlag &need_copyback) override {
+    LOG(FATAL)<<"GetOrCreate(K key, ValuePtr<V>** value_ptr, "
+              <<"size_t size, CopyBackFlag &need_copyback) "
+              <<"in DramCxlStorage can not be called.";
+  }
+
+  bool IsUseHbm() override {
+    return false;
+  }
+
+  bool IsSingleHbm() override {
+    return false;
+  }
+
+  bool IsUsePersistentStorage() override {
+    return false;
+  }
+
+  Status GetOrCreate(K key, ValuePtr<V>** value_ptr,
+      size_t size) override {
+    Status s = dram_->Get(key, value_ptr);
+    if (s.ok()) {
+      return s;
+    }
+    s = cxl_->Get(key, value_ptr);
+    if (s.ok() && (*value_ptr)->GetFreq() < promote_freq_) {
+      return s;
+    }
+
+    ValuePtr<V>* new_value_ptr = dram_->CreateValuePtr(size);
+    if (s.ok()) {
+      memcpy(new_value_ptr->GetPtr(), (*value_ptr)->GetPtr(),
+             sizeof(FixedLengthHeader) + sizeof(V) * size);
+    }
+    *value_ptr = new_value_ptr;
+
+    s = dram_->TryInsert(key, *value_ptr);
+    if (s.ok()) {
+      return s;
+    }
+    // Insert Failed, key already exist
+    dram_->DestroyValuePtr(*value_ptr);
+    return dram_->Get(key, value_ptr);
+  }
+
+  Status Remove(K key) override {
+    dram_->Remove(key);
+    cxl_->Remove(key);
+    return Status::OK();
+  }
+
+  int64 Size() const override {
+    return dram_->Size() + cxl_->Size();
+  }
+
+  int64 Size(int level) const override {
+    if (level == 0) {
+      return dram_->Size();
+    } else if (level == 1) {
+      return cxl_->Size();
+    } else {
+      return -1;
+    }
+  }
+
+  int LookupTier(K key) const override {
+    Status s = dram_->Contains(key);
+    if (s.ok())
+      return 0;
+    s = cxl_->Contains(key);
+    if (s.ok())
+      return 1;
+    return -1;
+  }
+
+  Status GetSnapshot(std::vector<K>* key_list,
+      std::vector<ValuePtr<V>* >* value_ptr_list) override {
+    {
+      mutex_lock l(*(dram_->get_mutex()));
+      TF_CHECK_OK(dram_->GetSnapshot(key_list, value_ptr_list));
+    }
+    {
+      mutex_lock l(*(cxl_->get_mutex()));
+      TF_CHECK_OK(cxl_->GetSnapshot(key_list, value_ptr_list));
+    }
+    return Status::OK();
+  }
+
+  Status Shrink(const ShrinkArgs& shrink_args) override {
+    dram_->Shrink(shrink_args);
+    cxl_->Shrink(shrink_args);
+    return Status::OK();
+  }
+
+  void iterator_mutex_lock() override {
+    return;
+  }
+
+  void iterator_mutex_unlock() override {
+    return;
+  }
+
+  // A row promoted to DRAM leaves a stale copy in the far tier until it is
+  // demoted again, so the rows of the far tier also in DRAM are skipped.
+  int64 GetSnapshot(std::vector<K>* key_list,
+      std::vector<V* >* value_list,
+      std::vector<int64>* version_list,
+      std::vector<int64>* freq_list,
+      const EmbeddingConfig& emb_config,
+      FilterPolicy<K, V, EmbeddingVar<K, V>>* filter,
+      embedding::Iterator** it) override {
+    {
+      mutex_lock l(*(dram_->get_mutex()));
+      std::vector<ValuePtr<V>*> value_ptr_list;
+      std::vector<K> key_list_tmp;
+      TF_CHECK_OK(dram_->GetSnapshot(&key_list_tmp, &value_ptr_list));
+      MultiTierStorage<K, V>::SetListsForCheckpoint(
+          key_list_tmp, value_ptr_list, emb_config,
+          key_list, value_list, version_list, freq_list);
+    }
+    {
+      mutex_lock l(*(cxl_->get_mutex()));
+      std::vector<ValuePtr<V>*> value_ptr_list;
+      std::vector<K> key_list_tmp;
+      TF_CHECK_OK(cxl_->GetSnapshot(&key_list_tmp, &value_ptr_list));
+      std::vector<ValuePtr<V>*> cxl_value_ptrs;
+      std::vector<K> cxl_keys;
+      for (int64 i = 0; i < key_list_tmp.size(); i++) {
+        if (!dram_->Contains(key_list_tmp[i]).ok()) {
+          cxl_keys.emplace_back(key_list_tmp[i]);
+          cxl_value_ptrs.emplace_back(value_ptr_list[i]);
+        }
+      }
+      MultiTierStorage<K, V>::SetListsForCheckpoint(
+          cxl_keys, cxl_value_ptrs, emb_config,
+          key_list, value_list, version_list, freq_list);
+    }
+    return key_list->size();
+  }
+
+  Status Eviction(K* evict_ids, int64 evict_size) override {
+    ValuePtr<V>* value_ptr;
+    for (int64 i = 0; i < evict_size; ++i) {
+      if (dram_->Get(evict_ids[i], &value_ptr).ok()) {
+        TF_CHECK_OK(Demote(evict_ids[i], value_ptr));
+        TF_CHECK_OK(dram_->Remove(evict_ids[i]));
+        dram_->DestroyValuePtr(value_ptr);
+      }
+    }
+    return Status::OK();
+  }
+
+  Status EvictionWithDelayedDestroy(K* evict_ids, int64 evict_size) override {
+    mutex_lock l(*(dram_->get_mutex()));
+    mutex_lock l1(*(cxl_->get_mutex()));
+    ValuePtr<V>* value_ptr = nullptr;
+    for (int64 i = 0; i < evict_size; ++i) {
+      if (dram_->Get(evict_ids[i], &value_ptr).ok()) {
+        TF_CHECK_OK(Demote(evict_ids[i], value_ptr));
+        TF_CHECK_OK(dram_->Remove(evict_ids[i]));
+        MultiTierStorage<K, V>::RetireValuePtr(value_ptr, dram_->alloc_);
+      }
+    }
+    return Status::OK();
+  }
+
+ protected:
+  void SetTotalDims(int64 total_dims) override {
+    value_ptr_size_ = total_dims;
+  }
+
+ private:
+  // Copies the row of key from DRAM to the far tier, overwriting the stale
+  // copy left there by a previous promotion.
+  Status Demote(K key, const ValuePtr<V>* value_ptr) {
+    ValuePtr<V>* cxl_value_ptr = nullptr;
+    if (!cxl_->Get(key, &cxl_value_ptr).ok()) {
+      cxl_value_ptr = cxl_->CreateValuePtr(value_ptr_size_);
+      Status s = cxl_->TryInsert(key, cxl_value_ptr);
+      if (!s.ok()) {
+        cxl_->DestroyValuePtr(cxl_value_ptr);
+        TF_RETURN_IF_ERROR(cxl_->Get(key, &cxl_value_ptr));
+      }
+    }
+    memcpy(cxl_value_ptr->GetPtr(), value_ptr->GetPtr(),
+           sizeof(FixedLengthHeader) + sizeof(V) * value_ptr_size_);
+    return Status::OK();
+  }
+
+  DramStorage<K, V>* dram_;
+  DramStorage<K, V>* cxl_;
+  int64 value_ptr_size_;
+  int64 promote_freq_;
+};
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_DRAM_CXL_STORAGE_H_
@@ -53,16 +53,44 @@ class DramLevelDBStore : public MultiTierStorage<K, V> {
     }
     s = leveldb_->Get(key, value_ptr);
     if (s.ok()) {
-      s = dram_->TryInsert(key, *value_ptr);
-      if (s.ok()) {
-        return s;
-      }
-      leveldb_->DestroyValuePtr(*value_ptr);
-      return dram_->Get(key, value_ptr);
+      return PromoteToDram(key, value_ptr);
     }
     return s;
   }
 
+  // The keys missing in DRAM are read from LevelDB in one batch.
+  void BatchGet(const K* key, ValuePtr<V>** value_ptr_list,
+                int64 num_of_keys) override {
+    dram_->BatchGet(key, value_ptr_list, num_of_keys);
+    std::vector<K> leveldb_keys;
+    std::vector<int64> cursors;
+    for (int64 i = 0; i < num_of_keys; i++) {
+      if (value_ptr_list[i] == nullptr) {
+        leveldb_keys.emplace_back(key[i]);
+        cursors.emplace_back(i);
+      }
+    }
+    if (leveldb_keys.empty()) {
+      return;
+    }
+    std::vector<ValuePtr<V>*> leveldb_value_ptrs(leveldb_keys.size());
+    leveldb_->BatchLookup(leveldb_keys.data(), leveldb_value_ptrs.data(),
+                          leveldb_keys.size());
+    for (int64 i = 0; i < leveldb_keys.size(); i++) {
+      if (leveldb_value_ptrs[i] != nullptr) {
+        TF_CHECK_OK(PromoteToDram(leveldb_keys[i], &leveldb_value_ptrs[i]));
+        value_ptr_list[cursors[i]] = leveldb_value_ptrs[i];
+      }
+    }
+  }
+
+  // Called by every worker thread on its shard of the batch, so the
+  // LevelDB reads of a batch run in parallel.
+  void BatchPromote(const K* keys, int64 num_of_keys) override {
+    std::vector<ValuePtr<V>*> value_ptrs(num_of_keys);
+    BatchGet(keys, value_ptrs.data(), num_of_keys);
+  }
+
   void Insert(K key, ValuePtr<V>* value_ptr) override {
     LOG(FATAL)<<"Unsupport Insert(K, ValuePtr<V>*) in DramLevelDBStore.";
   }
@@ -87,12 +115,7 @@ class DramLevelDBStore : public MultiTierStorage<K, V> {
     }
     s = leveldb_->Get(key, value_ptr);
     if (s.ok()) {
-      s = dram_->TryInsert(key, *value_ptr);
-      if (s.ok()) {
-        return s;
-      }
-      leveldb_->DestroyValuePtr(*value_ptr);
-      return dram_->Get(key, value_ptr);
+      return PromoteToDram(key, value_ptr);
     }
     dram_->Insert(key, value_ptr, size);
     return Status::OK();
@@ -195,13 +218,11 @@ class DramLevelDBStore : public MultiTierStorage<K, V> {
   }
 
   Status Eviction(K* evict_ids, int64 evict_size) override {
-    ValuePtr<V>* value_ptr;
-    for (int64 i = 0; i < evict_size; ++i) {
-      if (dram_->Get(evict_ids[i], &value_ptr).ok()) {
-        TF_CHECK_OK(leveldb_->Commit(evict_ids[i], value_ptr));
-        TF_CHECK_OK(dram_->Remove(evict_ids[i]));
-        dram_->DestroyValuePtr(value_ptr);
-      }
+    std::vector<K> keys;
+    std::vector<ValuePtr<V>*> value_ptrs;
+    TF_CHECK_OK(EvictToLevelDB(evict_ids, evict_size, &keys, &value_ptrs));
+    for (auto value_ptr : value_ptrs) {
+      dram_->DestroyValuePtr(value_ptr);
     }
     return Status::OK();
   }
@@ -209,14 +230,11 @@ class DramLevelDBStore : public MultiTierStorage<K, V> {
   Status EvictionWithDelayedDestroy(K* evict_ids, int64 evict_size) override {
     mutex_lock l(*(dram_->get_mutex()));
     mutex_lock l1(*(leveldb_->get_mutex()));
-    MultiTierStorage<K, V>::ReleaseInvalidValuePtr(dram_->alloc_);
-    ValuePtr<V>* value_ptr = nullptr;
-    for (int64 i = 0; i < evict_size; ++i) {
-      if (dram_->Get(evict_ids[i], &value_ptr).ok()) {
-        TF_CHECK_OK(leveldb_->Commit(evict_ids[i], value_ptr));
-        TF_CHECK_OK(dram_->Remove(evict_ids[i]));
-        MultiTierStorage<K, V>::KeepInvalidValuePtr(value_ptr);
-      }
+    std::vector<K> keys;
+    std::vector<ValuePtr<V>*> value_ptrs;
+    TF_CHECK_OK(EvictToLevelDB(evict_ids, evict_size, &keys, &value_ptrs));
+    for (auto value_ptr : value_ptrs) {
+      MultiTierStorage<K, V>::RetireValuePtr(value_ptr, dram_->alloc_);
     }
     return Status::OK();
   }
@@ -227,6 +245,36 @@ class DramLevelDBStore : public MultiTierStorage<K, V> {
   }
 
  private:
+  // Writes the evicted keys which are in DRAM to LevelDB in one WriteBatch
+  // and removes them from DRAM. Their value_ptrs are left to the caller.
+  Status EvictToLevelDB(K* evict_ids, int64 evict_size,
+                        std::vector<K>* keys,
+                        std::vector<ValuePtr<V>*>* value_ptrs) {
+    ValuePtr<V>* value_ptr = nullptr;
+    for (int64 i = 0; i < evict_size; ++i) {
+      if (dram_->Get(evict_ids[i], &value_ptr).ok()) {
+        keys->emplace_back(evict_ids[i]);
+        value_ptrs->emplace_back(value_ptr);
+      }
+    }
+    TF_RETURN_IF_ERROR(leveldb_->BatchWrite(keys->data(), value_ptrs->data(),
+                                            keys->size()));
+    for (auto key : *keys) {
+      TF_RETURN_IF_ERROR(dram_->Remove(key));
+    }
+    return Status::OK();
+  }
+
+  // *value_ptr is read from LevelDB and replaced by the DRAM one.
+  Status PromoteToDram(K key, ValuePtr<V>** value_ptr) {
+    Status s = dram_->TryInsert(key, *value_ptr);
+    if (s.ok()) {
+      return s;
+    }
+    leveldb_->DestroyValuePtr(*value_ptr);
+    return dram_->Get(key, value_ptr);
+  }
+
   DramStorage<K, V>* dram_;
   LevelDBStore<K, V>* leveldb_;
 };
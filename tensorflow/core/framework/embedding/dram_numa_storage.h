@@ -0,0 +1,362 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_DRAM_NUMA_STORAGE_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_DRAM_NUMA_STORAGE_H_
+
+#include "tensorflow/core/framework/embedding/cpu_hash_map_kv.h"
+#include "tensorflow/core/framework/embedding/single_tier_storage.h"
+#include "tensorflow/core/framework/embedding/storage_config.h"
+#include "tensorflow/core/framework/embedding/storage.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/numa.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+template <class V>
+class ValuePtr;
+
+template <class K, class V>
+class EmbeddingVar;
+
+namespace embedding {
+
+class NumaThreadPoolCreator {
+ public:
+  // Returns one thread pool per NUMA node, the threads of pool i are
+  // pinned to node i.
+  static std::vector<thread::ThreadPool*>* Create() {
+    static std::vector<thread::ThreadPool*> numa_thread_pools = []() {
+      int64 num_threads = 4;
+      TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_NUMA_THREADS_PER_NODE", 4,
+            &num_threads));
+      std::vector<thread::ThreadPool*> pools;
+      for (int i = 0; i < port::NUMANumNodes(); i++) {
+        ThreadOptions thread_options;
+        thread_options.numa_node = i;
+        pools.emplace_back(new thread::ThreadPool(Env::Default(),
+            thread_options, strings::StrCat("EV_Numa_Node_", i),
+            num_threads, /*low_latency_hint=*/false));
+      }
+      return pools;
+    }();
+    return &numa_thread_pools;
+  }
+};
+
+// DRAM storage partitioned by NUMA node. Keys are sharded by hash to one
+// DramStorage per node, and every shard allocates its ValuePtrs from the
+// EV allocator of its node. Large batch lookups are split by node and run
+// on the thread pool pinned to the owning node, so the hash map probes and
+// embedding reads stay on local memory.
+template<typename K, typename V>
+class DramNumaStorage : public Storage<K, V> {
+ public:
+  DramNumaStorage(const StorageConfig& sc, LayoutCreator<V>* lc)
+      : Storage<K, V>(sc) {
+    num_nodes_ = port::NUMANumNodes();
+    for (int i = 0; i < num_nodes_; i++) {
+      int numa_node = (num_nodes_ > 1) ? i : port::kNUMANoAffinity;
+      dram_.emplace_back(new DramStorage<K, V>(sc,
+          numa_ev_allocator(numa_node), lc, new LocklessHashMap<K, V>()));
+    }
+    if (num_nodes_ > 1) {
+      thread_pools_ = NumaThreadPoolCreator::Create();
+    }
+  }
+
+  ~DramNumaStorage() override {
+    for (auto dram : dram_) {
+      delete dram;
+    }
+  }
+
+  TF_DISALLOW_COPY_AND_ASSIGN(DramNumaStorage);
+
+  Status Get(K key, ValuePtr<V>** value_ptr) override {
+    return dram_[Node(key)]->Get(key, value_ptr);
+  }
+
+  void BatchGet(const K* key, ValuePtr<V>** value_ptr_list,
+                int64 num_of_keys) override {
+    if (num_nodes_ == 1) {
+      dram_[0]->BatchGet(key, value_ptr_list, num_of_keys);
+      return;
+    }
+    if (num_of_keys < kNumaBatchThreshold) {
+      Storage<K, V>::BatchGet(key, value_ptr_list, num_of_keys);
+      return;
+    }
+    std::vector<std::vector<int64>> ids_per_node(num_nodes_);
+    for (int64 i = 0; i < num_of_keys; i++) {
+      ids_per_node[Node(key[i])].emplace_back(i);
+    }
+    BlockingCounter counter(num_nodes_);
+    for (int node = 0; node < num_nodes_; node++) {
+      (*thread_pools_)[node]->Schedule(
+          [this, node, key, value_ptr_list, &ids_per_node, &counter]() {
+        const std::vector<int64>& ids = ids_per_node[node];
+        std::vector<K> node_keys(ids.size());
+        std::vector<ValuePtr<V>*> node_value_ptrs(ids.size());
+        for (int64 i = 0; i < ids.size(); i++) {
+          node_keys[i] = key[ids[i]];
+        }
+        dram_[node]->BatchGet(node_keys.data(), node_value_ptrs.data(),
+                              ids.size());
+        for (int64 i = 0; i < ids.size(); i++) {
+          value_ptr_list[ids[i]] = node_value_ptrs[i];
+        }
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+
+  Status Contains(K key) override {
+    return dram_[Node(key)]->Contains(key);
+  }
+
+  void Insert(K key, ValuePtr<V>** value_ptr,
+              size_t alloc_len) override {
+    dram_[Node(key)]->Insert(key, value_ptr, alloc_len);
+  }
+
+  void Insert(K key, ValuePtr<V>* value_ptr) override {
+    LOG(FATAL)<<"Unsupport Insert(K, ValuePtr<V>*) in DramNumaStorage.";
+  }
+
+  void InsertToDram(K key, ValuePtr<V>** value_ptr,
+              int64 alloc_len) override {
+    LOG(FATAL)<<"InsertToDram in DramNumaStorage shouldn't be called";
+  }
+
+  Status GetOrCreate(K key, ValuePtr<V>** value_ptr,
+      size_t size) override {
+    return dram_[Node(key)]->GetOrCreate(key, value_ptr, size);
+  }
+
+  Status GetOrCreate(K key, ValuePtr<V>** value_ptr,
+      size_t size, CopyBackFlag &need_copyback) override {
+    need_copyback = NOT_COPYBACK;
+    return GetOrCreate(key, value_ptr, size);
+  }
+
+  Status Remove(K key) override {
+    return dram_[Node(key)]->Remove(key);
+  }
+
+  int64 Size() const override {
+    int64 total_size = 0;
+    for (auto dram : dram_) {
+      total_size += dram->Size();
+    }
+    return total_size;
+  }
+
+  int64 Size(int level) const override {
+    if (level > 0) {
+      LOG(FATAL) << "Unsupport level>0 in DramNumaStorage.";
+    }
+    return Size();
+  }
+
+  int64 CacheSize() const override {
+    LOG(FATAL) << "Unsupport cachesize in DramNumaStorage.";
+    return 0;
+  }
+
+  int LookupTier(K key) const override {
+    Status s = dram_[Node(key)]->Contains(key);
+    return (s.ok()) ? 0 : -1;
+  }
+
+  void CopyEmbeddingsFromCPUToGPU(
+      int total, const K* keys,
+      const std::list<int64>& copyback_cursor,
+      V** memcpy_address, size_t value_len,
+      ValuePtr<V> **gpu_value_ptrs,
+      V* memcpy_buffer_gpu,
+      se::Stream* compute_stream,
+      EventMgr* event_mgr,
+      const DeviceBase::CpuWorkerThreads* worker_threads) override {
+    LOG(FATAL) << "Unsupport CopyEmbeddingsFromCPUToGPU in DramNumaStorage.";
+  };
+
+  BatchCache<K>* Cache() override {
+    LOG(FATAL) << "Unsupport Cache in DramNumaStorage.";
+    return nullptr;
+  }
+
+  void InitCache(embedding::CacheStrategy cache_strategy) override {
+    LOG(FATAL) << "Unsupport InitCache in DramNumaStorage.";
+  }
+
+  Status BatchCommit(const std::vector<K>& keys,
+      const std::vector<ValuePtr<V>*>& value_ptrs) override {
+    LOG(FATAL) << "Unsupport BatchCommit in DramNumaStorage.";
+    return Status::OK();
+  }
+
+  Status Eviction(K* evict_ids, int64 evict_size) override {
+    LOG(FATAL) << "Unsupport Eviction in DramNumaStorage.";
+    return Status::OK();
+  }
+
+  void CreateEmbeddingMemoryPool(
+      Allocator* alloc,
+      int64 value_len,
+      int64 block_size) override {
+    return;
+  }
+
+  void AllocateMemoryForNewFeatures(
+      const std::vector<ValuePtr<V>*>& value_ptr_list) override {
+    return;
+  }
+
+  void AllocateMemoryForNewFeatures(
+      ValuePtr<V>** value_ptr_list,
+      int64 num_of_value_ptrs) override {
+    return;
+  }
+
+  Status GetSnapshot(std::vector<K>* key_list,
+      std::vector<ValuePtr<V>*>* value_ptr_list) override {
+    for (auto dram : dram_) {
+      TF_CHECK_OK(dram->GetSnapshot(key_list, value_ptr_list));
+    }
+    return Status::OK();
+  }
+
+  int64 GetSnapshot(std::vector<K>* key_list,
+      std::vector<V* >* value_list,
+      std::vector<int64>* version_list,
+      std::vector<int64>* freq_list,
+      const EmbeddingConfig& emb_config,
+      FilterPolicy<K, V, EmbeddingVar<K, V>>* filter,
+      embedding::Iterator** it) override {
+    for (auto dram : dram_) {
+      dram->GetSnapshot(key_list, value_list, version_list,
+                        freq_list, emb_config, filter, it);
+    }
+    return key_list->size();
+  }
+
+  int64 GetSnapshotWithoutFetchPersistentEmb(
+      std::vector<K>* key_list,
+      std::vector<V* >* value_list,
+      std::vector<int64>* version_list,
+      std::vector<int64>* freq_list,
+      const EmbeddingConfig& emb_config,
+      SsdRecordDescriptor<K>* ssd_rec_desc) override {
+    LOG(FATAL)<<"The Storage dosen't use presisten memory"
+              <<" or this storage hasn't suppported "
+              <<" GetSnapshotWithoutFetchPersistentEmb yet";
+    return -1;
+  }
+
+  embedding::Iterator* GetIterator() override {
+    LOG(FATAL)<<"GetIterator isn't support by DramNumaStorage.";
+    return nullptr;
+  }
+
+  void RestoreSsdHashmap(
+      K* key_list, int64* key_file_id_list,
+      int64* key_offset_list, int64 num_of_keys,
+      int64* file_list, int64* invalid_record_count_list,
+      int64* record_count_list, int64 num_of_files,
+      const std::string& ssd_emb_file_name) override {
+    LOG(FATAL)<<"The Storage dosen't have ssd storage.";
+  }
+
+  void ImportToHbm(
+      K* ids, int64 size, int64 value_len, int64 emb_index) override {
+    LOG(FATAL)<<"This Storage dosen't have a HBM storage.";
+  }
+
+  Status Shrink(const ShrinkArgs& shrink_args) override {
+    for (auto dram : dram_) {
+      dram->Shrink(shrink_args);
+    }
+    return Status::OK();
+  }
+
+  void SetAllocLen(int64 value_len, int slot_num) override {
+    while (Storage<K, V>::flag_.test_and_set(std::memory_order_acquire));
+    // The start address of every slot should be aligned to 16 bytes,
+    // otherwise a coredump will happen in the ApplyOp.
+    Storage<K, V>::alloc_len_ = Storage<K, V>::ComputeAllocLen(value_len);
+
+    int64 temp = Storage<K, V>::alloc_len_ * slot_num;
+    if (temp > Storage<K, V>::total_dims_) {
+      Storage<K, V>::total_dims_ = temp;
+    }
+    Storage<K, V>::flag_.clear(std::memory_order_release);
+    for (auto dram : dram_) {
+      dram->SetAllocLen(value_len, slot_num);
+    }
+  }
+
+  bool IsMultiLevel() override {
+    return false;
+  }
+
+  bool IsUseHbm() override {
+    return false;
+  }
+
+  bool IsSingleHbm() override {
+    return false;
+  }
+
+  bool IsUsePersistentStorage() override {
+    return false;
+  }
+
+  void iterator_mutex_lock() override {
+    return;
+  }
+
+  void iterator_mutex_unlock() override {
+    return;
+  }
+
+  void Schedule(std::function<void()> fn) override {
+    LOG(FATAL) << "Unsupport Schedule in DramNumaStorage.";
+  }
+
+ private:
+  // Below this many keys the dispatch to the node thread pools costs more
+  // than the remote memory accesses it saves.
+  static const int64 kNumaBatchThreshold = 1024;
+
+  int Node(K key) const {
+    if (num_nodes_ == 1) {
+      return 0;
+    }
+    // Mix the key, so nodes don't pick up a fixed residue of the keys
+    // the hash maps index by.
+    uint64 h = static_cast<uint64>(key) * 0x9E3779B97F4A7C15ULL;
+    return (h >> 32) % num_nodes_;
+  }
+
+  int num_nodes_;
+  std::vector<DramStorage<K, V>*> dram_;
+  std::vector<thread::ThreadPool*>* thread_pools_ = nullptr;
+};
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_DRAM_NUMA_STORAGE_H_
@@ -15,9 +15,18 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_DRAM_PMEM_STORAGE_H_
 #define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_DRAM_PMEM_STORAGE_H_
 
+#ifdef TENSORFLOW_USE_PMEM
+#include "libpmem.h"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <unordered_set>
+
 #include "tensorflow/core/framework/embedding/multi_tier_storage.h"
 #include "tensorflow/core/framework/embedding/single_tier_storage.h"
 #include "tensorflow/core/framework/embedding/cpu_hash_map_kv.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 template <class V>
@@ -28,6 +37,28 @@ class EmbeddingVar;
 
 namespace embedding {
 
+// Flushes [addr, addr + len) from the CPU caches to the persistence domain
+// of the PMEM.
+inline void PersistPmem(const void* addr, size_t len) {
+#ifdef TENSORFLOW_USE_PMEM
+  pmem_persist(addr, len);
+#elif defined(__SSE2__)
+  const uintptr_t kCacheLine = 64;
+  uintptr_t end = reinterpret_cast<uintptr_t>(addr) + len;
+  for (uintptr_t p = reinterpret_cast<uintptr_t>(addr) & ~(kCacheLine - 1);
+       p < end; p += kCacheLine) {
+    _mm_clflush(reinterpret_cast<const void*>(p));
+  }
+  _mm_sfence();
+#endif  // TENSORFLOW_USE_PMEM
+}
+
+// With TF_PMEM_DIRECT_ACCESS, the rows in PMEM are accessed in place through
+// the DAX mapping of the experimental PMEM allocator instead of being copied
+// back to DRAM. Lookups never promote them, and updates only promote the
+// rows whose frequency reaches TF_PMEM_PROMOTE_FREQ (default 8), so that
+// read-mostly features stay in PMEM. The rows updated in place are
+// persisted in one batch at the next cache update, i.e. once per step.
 template<typename K, typename V>
 class DramPmemStorage : public MultiTierStorage<K, V> {
  public:
@@ -40,10 +71,15 @@ class DramPmemStorage : public MultiTierStorage<K, V> {
     value_ptr_size_ =
         const_cast<EmbeddingConfig&>(sc.embedding_config).total_num(
             Storage<K, V>::GetAllocLen());
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_PMEM_DIRECT_ACCESS", false,
+                                   &direct_access_));
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_PMEM_PROMOTE_FREQ", 8,
+                                    &promote_freq_));
   }
 
   ~DramPmemStorage() override {
     MultiTierStorage<K, V>::DeleteFromEvictionManager();
+    PersistDirtyRows();
     delete dram_;
     delete pmem_;
   }
@@ -57,6 +93,9 @@ class DramPmemStorage : public MultiTierStorage<K, V> {
     }
     s = pmem_->Get(key, value_ptr);
     if (s.ok()) {
+      if (direct_access_) {
+        return s;
+      }
       ValuePtr<V>* new_value_ptr = dram_->CreateValuePtr(value_ptr_size_);
       memcpy(new_value_ptr->GetPtr(), (*value_ptr)->GetPtr(),
              sizeof(FixedLengthHeader) + sizeof(V) * value_ptr_size_);
@@ -108,6 +147,11 @@ class DramPmemStorage : public MultiTierStorage<K, V> {
       return s;
     }
     s = pmem_->Get(key, value_ptr);
+    if (s.ok() && direct_access_ &&
+        (*value_ptr)->GetFreq() < promote_freq_) {
+      MarkDirty(*value_ptr);
+      return s;
+    }
 
     ValuePtr<V>* new_value_ptr = dram_->CreateValuePtr(size);
     if (s.ok()) {
@@ -212,11 +256,22 @@ class DramPmemStorage : public MultiTierStorage<K, V> {
     return key_list->size();
   }
 
+  void UpdateCache(const Tensor& indices,
+                   const Tensor& indices_counts) override {
+    MultiTierStorage<K, V>::UpdateCache(indices, indices_counts);
+    SchedulePersist();
+  }
+
+  void UpdateCache(const Tensor& indices) override {
+    MultiTierStorage<K, V>::UpdateCache(indices);
+    SchedulePersist();
+  }
+
   Status Eviction(K* evict_ids, int64 evict_size) override {
     ValuePtr<V>* value_ptr;
     for (int64 i = 0; i < evict_size; ++i) {
       if (dram_->Get(evict_ids[i], &value_ptr).ok()) {
-        TF_CHECK_OK(pmem_->Commit(evict_ids[i], value_ptr));
+        TF_CHECK_OK(Demote(evict_ids[i], value_ptr));
         TF_CHECK_OK(dram_->Remove(evict_ids[i]));
         dram_->DestroyValuePtr(value_ptr);
       }
@@ -227,25 +282,74 @@ class DramPmemStorage : public MultiTierStorage<K, V> {
   Status EvictionWithDelayedDestroy(K* evict_ids, int64 evict_size) override {
     mutex_lock l(*(dram_->get_mutex()));
     mutex_lock l1(*(pmem_->get_mutex()));
-    MultiTierStorage<K, V>::ReleaseInvalidValuePtr(dram_->alloc_);
     ValuePtr<V>* value_ptr = nullptr;
     for (int64 i = 0; i < evict_size; ++i) {
       if (dram_->Get(evict_ids[i], &value_ptr).ok()) {
-        TF_CHECK_OK(pmem_->Commit(evict_ids[i], value_ptr));
+        TF_CHECK_OK(Demote(evict_ids[i], value_ptr));
         TF_CHECK_OK(dram_->Remove(evict_ids[i]));
-        MultiTierStorage<K, V>::KeepInvalidValuePtr(value_ptr);
+        MultiTierStorage<K, V>::RetireValuePtr(value_ptr, dram_->alloc_);
       }
     }
     return Status::OK();
   }
 
  protected:
-  void SetTotalDims(int64 total_dims) override {}
+  void SetTotalDims(int64 total_dims) override {
+    value_ptr_size_ = total_dims;
+  }
 
  private:
+  int64 RowBytes() const {
+    return sizeof(FixedLengthHeader) + sizeof(V) * value_ptr_size_;
+  }
+
+  // Copies the row of key from DRAM to PMEM, overwriting the stale copy
+  // left in PMEM by a previous promotion, and persists it.
+  Status Demote(K key, const ValuePtr<V>* value_ptr) {
+    ValuePtr<V>* pmem_value_ptr = nullptr;
+    if (!pmem_->Get(key, &pmem_value_ptr).ok()) {
+      pmem_value_ptr = pmem_->CreateValuePtr(value_ptr_size_);
+      Status s = pmem_->TryInsert(key, pmem_value_ptr);
+      if (!s.ok()) {
+        pmem_->DestroyValuePtr(pmem_value_ptr);
+        TF_RETURN_IF_ERROR(pmem_->Get(key, &pmem_value_ptr));
+      }
+    }
+    memcpy(pmem_value_ptr->GetPtr(), value_ptr->GetPtr(), RowBytes());
+    PersistPmem(pmem_value_ptr->GetPtr(), RowBytes());
+    return Status::OK();
+  }
+
+  void MarkDirty(ValuePtr<V>* value_ptr) {
+    mutex_lock l(dirty_mu_);
+    dirty_rows_.insert(value_ptr);
+  }
+
+  void SchedulePersist() {
+    if (direct_access_) {
+      MultiTierStorage<K, V>::Schedule([this]() { PersistDirtyRows(); });
+    }
+  }
+
+  // Persists the rows updated in place in PMEM since the last call.
+  void PersistDirtyRows() {
+    std::unordered_set<ValuePtr<V>*> dirty_rows;
+    {
+      mutex_lock l(dirty_mu_);
+      dirty_rows.swap(dirty_rows_);
+    }
+    for (auto value_ptr : dirty_rows) {
+      PersistPmem(value_ptr->GetPtr(), RowBytes());
+    }
+  }
+
   DramStorage<K, V>* dram_;
   PmemLibpmemStorage<K, V>* pmem_;
   int64 value_ptr_size_;
+  bool direct_access_;
+  int64 promote_freq_;
+  mutex dirty_mu_;
+  std::unordered_set<ValuePtr<V>*> dirty_rows_ GUARDED_BY(dirty_mu_);
 };
 } // embedding
 } // tensorflow
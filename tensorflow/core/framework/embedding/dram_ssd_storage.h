@@ -53,17 +53,42 @@ class DramSsdHashStorage : public MultiTierStorage<K, V> {
     }
     s = ssd_hash_->Get(key, value_ptr);
     if(s.ok()) {
-      s = dram_->TryInsert(key, *value_ptr);
-      if (s.ok()) {
-        return s;
-      }
-      //Insert Failed, the key is already in Dram;
-      ssd_hash_->DestroyValuePtr(*value_ptr);
-      return dram_->Get(key, value_ptr);
+      return PromoteToDram(key, value_ptr);
     }
     return s;
   }
 
+  // The keys missing in DRAM are read from SSD in one batch.
+  void BatchGet(const K* key, ValuePtr<V>** value_ptr_list,
+                int64 num_of_keys) override {
+    dram_->BatchGet(key, value_ptr_list, num_of_keys);
+    std::vector<K> ssd_keys;
+    std::vector<int64> cursors;
+    for (int64 i = 0; i < num_of_keys; i++) {
+      if (value_ptr_list[i] == nullptr) {
+        ssd_keys.emplace_back(key[i]);
+        cursors.emplace_back(i);
+      }
+    }
+    if (ssd_keys.empty()) {
+      return;
+    }
+    std::vector<ValuePtr<V>*> ssd_value_ptrs(ssd_keys.size());
+    ssd_hash_->BatchGet(ssd_keys.data(), ssd_value_ptrs.data(),
+                        ssd_keys.size());
+    for (int64 i = 0; i < ssd_keys.size(); i++) {
+      if (ssd_value_ptrs[i] != nullptr) {
+        TF_CHECK_OK(PromoteToDram(ssd_keys[i], &ssd_value_ptrs[i]));
+        value_ptr_list[cursors[i]] = ssd_value_ptrs[i];
+      }
+    }
+  }
+
+  void BatchPromote(const K* keys, int64 num_of_keys) override {
+    std::vector<ValuePtr<V>*> value_ptrs(num_of_keys);
+    BatchGet(keys, value_ptrs.data(), num_of_keys);
+  }
+
   void Insert(K key, ValuePtr<V>* value_ptr) override {
     LOG(FATAL)<<"Unsupport Insert(K, ValuePtr<V>*) in DramSsdHashStorage.";
   }
@@ -88,13 +113,7 @@ class DramSsdHashStorage : public MultiTierStorage<K, V> {
     }
     s = ssd_hash_->Get(key, value_ptr);
     if(s.ok()) {
-      s = dram_->TryInsert(key, *value_ptr);
-      if (s.ok()) {
-        return s;
-      }
-      //Insert Failed, the key is already in Dram;
-      ssd_hash_->DestroyValuePtr(*value_ptr);
-      return dram_->Get(key, value_ptr);
+      return PromoteToDram(key, value_ptr);
     }
     dram_->Insert(key, value_ptr, size);
     return Status::OK();
@@ -246,13 +265,12 @@ class DramSsdHashStorage : public MultiTierStorage<K, V> {
   Status EvictionWithDelayedDestroy(K* evict_ids, int64 evict_size) override {
     mutex_lock l(*(dram_->get_mutex()));
     mutex_lock l1(*(ssd_hash_->get_mutex()));
-    MultiTierStorage<K, V>::ReleaseInvalidValuePtr(dram_->alloc_);
     ValuePtr<V>* value_ptr = nullptr;
     for (int64 i = 0; i < evict_size; ++i) {
       if (dram_->Get(evict_ids[i], &value_ptr).ok()) {
         TF_CHECK_OK(ssd_hash_->Commit(evict_ids[i], value_ptr));
         TF_CHECK_OK(dram_->Remove(evict_ids[i]));
-        MultiTierStorage<K, V>::KeepInvalidValuePtr(value_ptr);
+        MultiTierStorage<K, V>::RetireValuePtr(value_ptr, dram_->alloc_);
       }
     }
     return Status::OK();
@@ -260,10 +278,22 @@ class DramSsdHashStorage : public MultiTierStorage<K, V> {
 
  protected:
   void SetTotalDims(int64 total_dims) override {
+    ssd_hash_->SetEmbeddingDims(Storage<K, V>::alloc_len_);
     ssd_hash_->SetTotalDims(total_dims);
   }
 
  private:
+  // *value_ptr is read from SSD and replaced by the DRAM one.
+  Status PromoteToDram(K key, ValuePtr<V>** value_ptr) {
+    Status s = dram_->TryInsert(key, *value_ptr);
+    if (s.ok()) {
+      return s;
+    }
+    //Insert Failed, the key is already in Dram;
+    ssd_hash_->DestroyValuePtr(*value_ptr);
+    return dram_->Get(key, value_ptr);
+  }
+
   DramStorage<K, V>* dram_ = nullptr;
   SsdHashStorage<K, V>* ssd_hash_ = nullptr;
 };
@@ -17,17 +17,30 @@ limitations under the License.
 #include <cstdlib>
 #include <fstream>
 #include <fcntl.h>
+#include <algorithm>
 #include <iomanip>
+#include <linux/aio_abi.h>
+#include <linux/fs.h>
 #include <map>
 #include <malloc.h>
 #include <string>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <vector>
 
 #include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 namespace embedding {
+// Reads val_len bytes at offset of the file into val.
+struct EmbFileReadRequest {
+  char* val;
+  size_t val_len;
+  size_t offset;
+};
+
 class EmbFile {
  public:
   EmbFile(const std::string& path, size_t ver, int64 buffer_size)
@@ -35,6 +48,7 @@ class EmbFile {
      file_size_(buffer_size),
      count_(0),
      invalid_count_(0),
+     is_hard_linked_(false),
      is_deleted_(false) {
     std::stringstream ss;
     ss << std::setw(4) << std::setfill('0') << ver << ".emb";
@@ -47,6 +61,13 @@ class EmbFile {
   virtual void Read(char* val, const size_t val_len,
       const size_t offset) = 0;
 
+  // Reads the records of a batch of lookups at once.
+  virtual void BatchRead(EmbFileReadRequest* requests, int64 num) {
+    for (int64 i = 0; i < num; i++) {
+      Read(requests[i].val, requests[i].val_len, requests[i].offset);
+    }
+  }
+
   virtual void DeleteFile() {
     is_deleted_ = true;
     if (fs_.is_open()) {
@@ -64,6 +85,24 @@ class EmbFile {
     invalid_count_ = invalid_count;
   }
 
+  // Like LoadExistFile, but shares the blocks of the file of the checkpoint
+  // instead of copying them: a reflink where the file system supports it
+  // (FICLONE on XFS or btrfs), otherwise a hard link, otherwise a copy.
+  void LinkExistFile(const std::string& old_file_path,
+                     size_t count, size_t invalid_count) {
+    if (!CloneFile(old_file_path)) {
+      if (std::remove(filepath_.c_str()) == 0 &&
+          link(old_file_path.c_str(), filepath_.c_str()) == 0) {
+        is_hard_linked_ = true;
+      } else {
+        Env::Default()->CopyFile(old_file_path, filepath_);
+      }
+    }
+    Reopen();
+    count_ = count;
+    invalid_count_ = invalid_count;
+  }
+
   void Flush() {
     if (fs_.is_open()) {
       fs_.flush();
@@ -85,6 +124,9 @@ class EmbFile {
   }
 
   void Write(const char* val, const size_t val_len) {
+    if (is_hard_linked_) {
+      BreakHardLink();
+    }
     if (fs_.is_open()) {
       fs_.write(val, val_len);
       posix_fadvise(fd_, 0, file_size_, POSIX_FADV_DONTNEED);
@@ -121,6 +163,10 @@ class EmbFile {
     return version_;
   }
 
+  const std::string& FilePath() const {
+    return filepath_;
+  }
+
   bool IsDeleted() const {
     return is_deleted_;
   }
@@ -145,11 +191,38 @@ class EmbFile {
   }
 
  private:
+  // Clones the blocks of old_file_path into the file, which is still empty.
+  bool CloneFile(const std::string& old_file_path) {
+    int src = open(old_file_path.c_str(), O_RDONLY);
+    if (src < 0) {
+      return false;
+    }
+    int dst = open(filepath_.c_str(), O_WRONLY | O_TRUNC);
+    bool cloned = dst >= 0 && ioctl(dst, FICLONE, src) == 0;
+    if (dst >= 0) {
+      close(dst);
+    }
+    close(src);
+    return cloned;
+  }
+
+  // Gives the file its own copy before appending to it, so that the file of
+  // the checkpoint it is linked to stays unchanged.
+  void BreakHardLink() {
+    std::string tmp_path = filepath_ + ".tmp";
+    Env::Default()->CopyFile(filepath_, tmp_path);
+    std::rename(tmp_path.c_str(), filepath_.c_str());
+    is_hard_linked_ = false;
+    Reopen();
+  }
+
+
   size_t version_;
   size_t count_;
   size_t invalid_count_;
   char* file_addr_for_read_;
   std::fstream fs_;
+  bool is_hard_linked_;
 
  protected:
   int64 file_size_;
@@ -190,6 +263,19 @@ class MmapMadviseEmbFile : public EmbFile {
   void Read(char* val, const size_t val_len,
             const size_t offset) override {
     memcpy(val, file_addr_ + offset, val_len);
+    Madvise();
+  }
+
+  void BatchRead(EmbFileReadRequest* requests, int64 num) override {
+    for (int64 i = 0; i < num; i++) {
+      memcpy(requests[i].val, file_addr_ + requests[i].offset,
+             requests[i].val_len);
+    }
+    Madvise();
+  }
+
+ private:
+  void Madvise() {
     int err = madvise(file_addr_, EmbFile::file_size_, MADV_DONTNEED);
     if (err < 0) {
       LOG(FATAL)<<"Failed to madvise the page, file_addr_: "
@@ -198,7 +284,6 @@ class MmapMadviseEmbFile : public EmbFile {
     }
   }
 
- private:
   char* file_addr_;
 };
 
@@ -225,6 +310,16 @@ class MmapEmbFile : public EmbFile {
     memcpy(val, file_addr_tmp + offset, val_len);
     munmap((void*)file_addr_tmp, EmbFile::file_size_);
   }
+
+  void BatchRead(EmbFileReadRequest* requests, int64 num) override {
+    char* file_addr_tmp =
+          (char*)mmap(nullptr, EmbFile::file_size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    for (int64 i = 0; i < num; i++) {
+      memcpy(requests[i].val, file_addr_tmp + requests[i].offset,
+             requests[i].val_len);
+    }
+    munmap((void*)file_addr_tmp, EmbFile::file_size_);
+  }
 };
 
 class DirectIoEmbFile : public EmbFile {
@@ -268,6 +363,131 @@ class DirectIoEmbFile : public EmbFile {
     memcpy(val, read_buffer + (offset % page_size), val_len);
     free(read_buffer);
   }
+
+  // The pages of the batch are coalesced into ranges of contiguous pages,
+  // which are read with kernel AIO, kMaxAioEvents ranges per submission.
+  void BatchRead(EmbFileReadRequest* requests, int64 num) override {
+    if (num == 0) {
+      return;
+    }
+    size_t page_size = getpagesize();
+    std::vector<EmbFileReadRequest*> sorted(num);
+    for (int64 i = 0; i < num; i++) {
+      sorted[i] = requests + i;
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](EmbFileReadRequest* a, EmbFileReadRequest* b) {
+                return a->offset < b->offset;
+              });
+    // range_begin[j] is the index in sorted of the first request of
+    // range j, ranges are [page_begin[j], page_end[j]) in pages.
+    std::vector<int64> range_begin;
+    std::vector<size_t> page_begin;
+    std::vector<size_t> page_end;
+    for (int64 i = 0; i < num; i++) {
+      size_t first_page = sorted[i]->offset / page_size;
+      size_t last_page =
+          (sorted[i]->offset + sorted[i]->val_len - 1) / page_size + 1;
+      if (!page_end.empty() && first_page <= page_end.back()) {
+        page_end.back() = std::max(page_end.back(), last_page);
+      } else {
+        range_begin.emplace_back(i);
+        page_begin.emplace_back(first_page);
+        page_end.emplace_back(last_page);
+      }
+    }
+    int64 num_ranges = page_begin.size();
+    std::vector<size_t> buffer_offsets(num_ranges);
+    size_t total_pages = 0;
+    for (int64 j = 0; j < num_ranges; j++) {
+      buffer_offsets[j] = total_pages * page_size;
+      total_pages += page_end[j] - page_begin[j];
+    }
+    char* read_buffer = (char*)memalign(page_size, page_size * total_pages);
+
+    std::vector<struct iocb> iocbs(num_ranges);
+    for (int64 j = 0; j < num_ranges; j++) {
+      memset(&iocbs[j], 0, sizeof(struct iocb));
+      iocbs[j].aio_fildes = EmbFile::fd_;
+      iocbs[j].aio_lio_opcode = IOCB_CMD_PREAD;
+      iocbs[j].aio_buf = (uint64)(read_buffer + buffer_offsets[j]);
+      iocbs[j].aio_nbytes = (page_end[j] - page_begin[j]) * page_size;
+      iocbs[j].aio_offset = page_begin[j] * page_size;
+    }
+    if (!AioRead(iocbs.data(), num_ranges)) {
+      for (int64 j = 0; j < num_ranges; j++) {
+        int status = pread(EmbFile::fd_, (void*)iocbs[j].aio_buf,
+                           iocbs[j].aio_nbytes, iocbs[j].aio_offset);
+        if (status < 0) {
+          LOG(FATAL)<<"Failed to pread, read size: "
+                    <<iocbs[j].aio_nbytes
+                    <<", offset: "<<iocbs[j].aio_offset;
+        }
+      }
+    }
+
+    for (int64 j = 0; j < num_ranges; j++) {
+      int64 end = (j + 1 < num_ranges) ? range_begin[j + 1] : num;
+      size_t range_offset = page_begin[j] * page_size;
+      for (int64 i = range_begin[j]; i < end; i++) {
+        memcpy(sorted[i]->val,
+               read_buffer + buffer_offsets[j] +
+                   (sorted[i]->offset - range_offset),
+               sorted[i]->val_len);
+      }
+    }
+    free(read_buffer);
+  }
+
+ private:
+  static const int64 kMaxAioEvents = 128;
+
+  // Returns false if kernel AIO isn't available, e.g. fs.aio-max-nr is
+  // exhausted, the caller falls back to pread then.
+  bool AioRead(struct iocb* iocbs, int64 num) {
+    aio_context_t ctx = 0;
+    if (syscall(SYS_io_setup, kMaxAioEvents, &ctx) < 0) {
+      return false;
+    }
+    std::vector<struct iocb*> iocb_ptrs(kMaxAioEvents);
+    std::vector<struct io_event> events(kMaxAioEvents);
+    for (int64 start = 0; start < num; start += kMaxAioEvents) {
+      int64 n = std::min(num - start, kMaxAioEvents);
+      for (int64 i = 0; i < n; i++) {
+        iocb_ptrs[i] = iocbs + start + i;
+      }
+      int64 submitted = 0;
+      while (submitted < n) {
+        long ret = syscall(SYS_io_submit, ctx, n - submitted,
+                           iocb_ptrs.data() + submitted);
+        if (ret < 0) {
+          LOG(FATAL)<<"Failed to io_submit, errno: "<<errno;
+        }
+        submitted += ret;
+      }
+      int64 completed = 0;
+      while (completed < n) {
+        long ret = syscall(SYS_io_getevents, ctx, 1, n - completed,
+                           events.data(), nullptr);
+        if (ret < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          LOG(FATAL)<<"Failed to io_getevents, errno: "<<errno;
+        }
+        for (long i = 0; i < ret; i++) {
+          if ((int64)events[i].res < 0) {
+            struct iocb* cb = (struct iocb*)events[i].obj;
+            LOG(FATAL)<<"Failed to read with AIO, read size: "
+                      <<cb->aio_nbytes<<", offset: "<<cb->aio_offset;
+          }
+        }
+        completed += ret;
+      }
+    }
+    syscall(SYS_io_destroy, ctx);
+    return true;
+  }
 };
 
 } // embedding
@@ -24,6 +24,9 @@ struct EmbeddingConfig {
   bool record_freq;
   bool record_version;
   bool is_inference;
+  // Whether the rows are 8-bit optimizer states, see
+  // EmbeddingVar::StateRow.
+  bool int8_state;
 
   EmbeddingConfig(int64 emb_index = 0,
                   int64 primary_emb_index = 0,
@@ -58,7 +61,8 @@ struct EmbeddingConfig {
       normal_fix_flag(0),
       record_freq(record_freq),
       record_version(record_version),
-      is_inference(is_inference) {
+      is_inference(is_inference),
+      int8_state(false) {
     if (max_element_size != 0 && false_positive_probability != -1.0){
       kHashFunc = calc_num_hash_func(false_positive_probability);
       num_counter = calc_num_counter(max_element_size,
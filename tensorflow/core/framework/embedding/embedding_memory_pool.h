@@ -15,13 +15,24 @@ limitations under the License.
 
 #ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EMBEDDING_MEMORY_POOL_H_
 #define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EMBEDDING_MEMORY_POOL_H_
+#include <algorithm>
 #include <deque>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace tensorflow {
 template <class V>
 class ValuePtr;
 
 namespace embedding {
+// A pool of fixed length embeddings, carved from blocks of block_size
+// bytes. It is thread safe: each thread allocates from and frees to one of
+// kNumMagazines magazines, picked by its thread id, which refill from and
+// spill to the central free list in batches, so threads rarely share a
+// lock.
 template<typename V>
 class EmbeddingMemoryPool {
  public:
@@ -31,7 +42,10 @@ class EmbeddingMemoryPool {
       int64 block_size): alloc_(alloc),
                          value_len_(value_len),
                          block_size_(block_size) {
-    embs_per_block_ = block_size_ / (sizeof(V) * value_len_);
+    embs_per_block_ = std::max<int64>(
+        block_size_ / (sizeof(V) * value_len_), 1);
+    batch_size_ = std::min<int64>(embs_per_block_, kMaxBatchSize);
+    mutex_lock l(free_mu_);
     CreateBlock();
   }
 
@@ -42,37 +56,93 @@ class EmbeddingMemoryPool {
   }
 
   V* Allocate() {
-    if (free_ptr_queue_.size() == 0) {
-      CreateBlock();
+    Magazine* magazine = LocalMagazine();
+    mutex_lock l(magazine->mu);
+    if (magazine->free_ptrs.empty()) {
+      Refill(magazine);
     }
-    V* ptr = free_ptr_queue_.front();
-    free_ptr_queue_.pop_front();
+    V* ptr = magazine->free_ptrs.back();
+    magazine->free_ptrs.pop_back();
     return ptr;
   }
 
-  void Deallocate(std::vector<ValuePtr<V>*> value_ptrs) {
-    int64 prev_size = value_ptrs_queue_.size();
-    for (auto it : value_ptrs) {
-      value_ptrs_queue_.emplace_back(it);
-    }
-    if (value_ptrs_queue_.size() > embs_per_block_) {
-      int64 n = value_ptrs_queue_.size() - embs_per_block_;
-      n = std::min(prev_size, n);
-      for (int64 i = 0; i < n; i++) {
-        ValuePtr<V>* val = value_ptrs_queue_.front();
-        free_ptr_queue_.emplace_back(val->GetValue(0, 0));
-        delete val;
-        value_ptrs_queue_.pop_front();
+  // The ValuePtrs may still be read by other threads, so they are deleted
+  // and their embeddings reused only after another embs_per_block_ of them
+  // have been released.
+  void Deallocate(const std::vector<ValuePtr<V>*>& value_ptrs) {
+    std::vector<ValuePtr<V>*> reclaimed;
+    {
+      mutex_lock l(value_ptrs_mu_);
+      int64 prev_size = value_ptrs_queue_.size();
+      value_ptrs_queue_.insert(value_ptrs_queue_.end(),
+                               value_ptrs.begin(), value_ptrs.end());
+      if (value_ptrs_queue_.size() > embs_per_block_) {
+        int64 n = value_ptrs_queue_.size() - embs_per_block_;
+        n = std::min(prev_size, n);
+        reclaimed.assign(value_ptrs_queue_.begin(),
+                         value_ptrs_queue_.begin() + n);
+        value_ptrs_queue_.erase(value_ptrs_queue_.begin(),
+                                value_ptrs_queue_.begin() + n);
       }
     }
+    if (reclaimed.empty()) {
+      return;
+    }
+    Magazine* magazine = LocalMagazine();
+    mutex_lock l(magazine->mu);
+    for (auto val : reclaimed) {
+      magazine->free_ptrs.emplace_back(val->GetValue(0, 0));
+      delete val;
+    }
+    Spill(magazine);
   }
 
   void Deallocate(V* ptr) {
-    free_ptr_queue_.emplace_back(ptr);
+    Magazine* magazine = LocalMagazine();
+    mutex_lock l(magazine->mu);
+    magazine->free_ptrs.emplace_back(ptr);
+    Spill(magazine);
   }
 
  private:
-  void CreateBlock() {
+  static constexpr int kNumMagazines = 16;
+  static constexpr int kMaxBatchSize = 64;
+
+  struct Magazine {
+    mutex mu;
+    std::vector<V*> free_ptrs;
+  };
+
+  Magazine* LocalMagazine() {
+    uint64 thread_id = Env::Default()->GetCurrentThreadId();
+    return &magazines_[thread_id % kNumMagazines];
+  }
+
+  void Refill(Magazine* magazine) {
+    mutex_lock l(free_mu_);
+    if (free_ptr_queue_.size() < batch_size_) {
+      CreateBlock();
+    }
+    auto end = free_ptr_queue_.begin() + batch_size_;
+    magazine->free_ptrs.insert(magazine->free_ptrs.end(),
+                               free_ptr_queue_.begin(), end);
+    free_ptr_queue_.erase(free_ptr_queue_.begin(), end);
+  }
+
+  // Returns all but batch_size_ of the free embeddings of a magazine to the
+  // central free list, once it holds twice as many.
+  void Spill(Magazine* magazine) {
+    auto& free_ptrs = magazine->free_ptrs;
+    if (free_ptrs.size() < 2 * batch_size_) {
+      return;
+    }
+    mutex_lock l(free_mu_);
+    free_ptr_queue_.insert(free_ptr_queue_.end(),
+                           free_ptrs.begin() + batch_size_, free_ptrs.end());
+    free_ptrs.resize(batch_size_);
+  }
+
+  void CreateBlock() EXCLUSIVE_LOCKS_REQUIRED(free_mu_) {
     V* dev_addr =
         (V*)alloc_->AllocateRaw(
             Allocator::kAllocatorAlignment,
@@ -83,13 +153,17 @@ class EmbeddingMemoryPool {
     }
   }
 
-  int64 block_size_;
+  Allocator* alloc_;
   int64 value_len_;
+  int64 block_size_;
   int64 embs_per_block_;
-  Allocator* alloc_;
-  std::deque<V*> free_ptr_queue_;
-  std::deque<ValuePtr<V>*> value_ptrs_queue_;
-  std::vector<V*> block_list_;
+  int64 batch_size_;
+  Magazine magazines_[kNumMagazines];
+  mutex free_mu_;
+  std::deque<V*> free_ptr_queue_ GUARDED_BY(free_mu_);
+  std::vector<V*> block_list_ GUARDED_BY(free_mu_);
+  mutex value_ptrs_mu_;
+  std::deque<ValuePtr<V>*> value_ptrs_queue_ GUARDED_BY(value_ptrs_mu_);
 };
 } //embedding
 } //tensorflow
@@ -67,7 +67,7 @@ void EmbeddingVar<K, V>::SetDefaultValueOfNewFeatures(
           storage_->GetOffset(emb_config_.emb_index);
       default_value_address[i] =
           default_value_ +
-          (keys[i] % emb_config_.default_value_dim) % value_len_;
+          (keys[*it] % emb_config_.default_value_dim) * value_len_;
     }
     DeviceMemoryBase gpu_dst_ptr(dev_value_address, total * 2 * sizeof(V*));
     compute_stream->ThenMemcpy(&gpu_dst_ptr, value_address,
@@ -17,21 +17,37 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EMBEDDING_VAR_H_
 #define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EMBEDDING_VAR_H_
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+
 #include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/memory_attribution.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/env_var.h"
 
 #include "tensorflow/core/framework/embedding/cache.h"
+#include "tensorflow/core/framework/embedding/dim_classes.h"
 #include "tensorflow/core/framework/embedding/embedding_var_context.h"
+#include "tensorflow/core/framework/embedding/embedding_var_stats.h"
 #include "tensorflow/core/framework/embedding/value_ptr.h"
 #include "tensorflow/core/framework/embedding/filter_factory.h"
+#include "tensorflow/core/framework/embedding/float_math_row.h"
+#include "tensorflow/core/framework/embedding/lock_contention.h"
+#include "tensorflow/core/framework/embedding/freq_sampler.h"
 #include "tensorflow/core/framework/embedding/gpu_hash_map_kv.h"
+#include "tensorflow/core/framework/embedding/id_trace_recorder.h"
+#include "tensorflow/core/framework/embedding/mmap_kv.h"
+#include "tensorflow/core/framework/embedding/serving_row_cache.h"
 #include "tensorflow/core/framework/embedding/embedding_config.h"
 #include "tensorflow/core/framework/embedding/storage.h"
 #include "tensorflow/core/framework/embedding/storage_factory.h"
@@ -65,25 +81,10 @@ class EmbeddingVar : public ResourceBase {
       alloc_(alloc),
       default_value_alloc_(alloc),
       emb_config_(emb_cfg) {
-    if (IsMultiLevel() || emb_config_.record_freq) {
-      add_freq_fn_ = [](ValuePtr<V>* value_ptr, int64 freq, int64 filter_freq) {
-        value_ptr->AddFreq(freq);
-      };
-    } else if (emb_config_.is_counter_filter()) {
-      add_freq_fn_ = [](ValuePtr<V>* value_ptr, int64 freq, int64 filter_freq) {
-        if (value_ptr->GetFreq() < filter_freq)
-          value_ptr->AddFreq(freq);
-      };
-    } else {
-      add_freq_fn_ = [](ValuePtr<V>* value_ptr, int64 freq, int64 filter_freq) {};
-    }
-    if (emb_config_.steps_to_live != 0 || emb_config_.record_version) {
-      update_version_fn_ = [](ValuePtr<V>* value_ptr, int64 gs) {
-        value_ptr->SetStep(gs);
-      };
-    } else {
-      update_version_fn_ = [](ValuePtr<V>* value_ptr, int64 gs) {};
-    }
+    value_ptr_class_ = GetValuePtrClass(storage_);
+    DispatchValuePtrAccess([this](auto access) {
+      InitValuePtrFns<decltype(access)>();
+    });
   }
 
   Status Init(const Tensor& default_tensor, int64 default_value_dim) {
@@ -95,16 +96,38 @@ class EmbeddingVar : public ResourceBase {
     storage_type_ = storage_->GetStorageType();
     filter_ = FilterFactory::CreateFilter<K, V, EmbeddingVar<K, V>>(
         emb_config_, this, storage_);
+    id_trace_recorder_ = embedding::IdTraceRecorder::Create(name_);
     emb_config_.default_value_dim = default_value_dim;
     value_len_ =
         default_tensor.NumElements() / emb_config_.default_value_dim;
 
     if (LayoutType::NORMAL_CONTIGUOUS == storage_->GetLayoutType() ||
         LayoutType::NORMAL_CONTIGUOUS_GPU == storage_->GetLayoutType() ||
-        LayoutType::COMPACT == storage_->GetLayoutType()) {
+        LayoutType::COMPACT == storage_->GetLayoutType() ||
+        storage_->IsQuantizedLayout() ||
+        storage_->IsMixedDimLayout()) {
       storage_->SetAllocLen(value_len_, emb_config_.slot_num + 1);
     }
 
+    if (storage_->IsMixedDimLayout()) {
+      is_mixed_dim_ = true;
+      dim_classes_ = embedding::DimClasses(value_len_);
+    }
+
+    if (emb_config_.int8_state) {
+      // The 8-bit rows are shorter than value_len_, only the loose layouts
+      // allocate the rows of an EmbeddingVar with its own length.
+      if ((LayoutType::LIGHT != storage_->GetLayoutType() &&
+           LayoutType::NORMAL != storage_->GetLayoutType()) ||
+          storage_->IsMultiLevel() || storage_->IsUseHbm() ||
+          storage_->IsSingleHbm()) {
+        return errors::InvalidArgument(
+            "8-bit optimizer states need the light or normal layout and a"
+            " single tier storage on CPU, EV: ", name_);
+      }
+      state_len_ = embedding::Int8StateLen<V>(value_len_);
+    }
+
     if (storage_->IsUseHbm()) {
 #if GOOGLE_CUDA
       default_value_ = TypedAllocator::Allocate<V>(alloc_,
@@ -131,7 +154,10 @@ class EmbeddingVar : public ResourceBase {
           default_tensor.TotalBytes(), cudaMemcpyDeviceToDevice);
 #endif  // GOOGLE_CUDA
     } else {
-      alloc_ = ev_allocator();
+      // Charged with the rows of the storage, which may free the rows
+      // allocated by the EmbeddingVar.
+      alloc_ = MemoryAttribution::Wrap(ev_allocator(),
+          strings::StrCat(storage_->memory_owner(), "/dram"));
       default_value_ = TypedAllocator::Allocate<V>(default_value_alloc_,
           default_tensor.NumElements(), AllocationAttributes());
 
@@ -145,6 +171,17 @@ class EmbeddingVar : public ResourceBase {
         default_value_no_permission_[i] = static_cast<V>(
             emb_config_.default_value_no_permission);
       }
+      if (emb_config_.is_primary() && !storage_->IsMultiLevel()) {
+        InitTailFolding();
+      }
+    }
+
+    if (emb_config_.is_inference && emb_config_.is_primary() &&
+        !storage_->IsUseHbm()) {
+      serving_row_cache_.reset(embedding::ServingRowCache<K, V>::Create(
+          value_len_, [this](const K* keys, V* rows, int64 num_of_keys) {
+            LookupRows(keys, rows, num_of_keys);
+          }));
     }
 
     return Status::OK();
@@ -152,12 +189,40 @@ class EmbeddingVar : public ResourceBase {
 
   void SetInitialized() {
     is_initialized_ = true;
+    if (serving_row_cache_ != nullptr) {
+      serving_row_cache_->Invalidate();
+    }
   }
 
   bool IsInitialized() const {
     return is_initialized_;
   }
 
+  // A serving EmbeddingVar whose rows are the same in the next full
+  // checkpoint is shared with the session of the next model version, which
+  // skips its initialization and restore.
+  void SetShared() {
+    is_shared_ = true;
+  }
+
+  bool IsShared() const {
+    return is_shared_;
+  }
+
+  // Set once the rows are modified after the restore of the full
+  // checkpoint, by the incremental checkpoints or ApplyDelta. Such
+  // EmbeddingVars are not shared with the next model version.
+  void SetDiverged() {
+    is_diverged_ = true;
+    if (serving_row_cache_ != nullptr) {
+      serving_row_cache_->Invalidate();
+    }
+  }
+
+  bool IsDiverged() const {
+    return is_diverged_;
+  }
+
   Status LookupKey(K key, ValuePtr<V>** value_ptr) {
     return storage_->Get(key, value_ptr);
   }
@@ -220,6 +285,28 @@ class EmbeddingVar : public ResourceBase {
     return value_ptr->GetStep();
   }
 
+  // The address of the FixedLengthHeader of the row of key, to be read
+  // remotely with its version, and in row_bytes the bytes from the header
+  // to the end of the row. nullptr when key has no row, or when the rows
+  // aren't single blocks of DRAM.
+  const void* RowAddress(K key, int64* row_bytes) {
+    if (storage_->GetLayoutType() != LayoutType::NORMAL_CONTIGUOUS ||
+        IsMultiLevel() || IsUseHbm() || IsSingleHbm() ||
+        mmap_kv_ != nullptr || IsQuantized()) {
+      return nullptr;
+    }
+    ValuePtr<V>* value_ptr = nullptr;
+    if (!LookupKey(key, &value_ptr).ok()) {
+      return nullptr;
+    }
+    const int64 offset = storage_->GetOffset(emb_config_.emb_index);
+    if (value_ptr->GetValue(emb_config_.emb_index, offset) == nullptr) {
+      return nullptr;
+    }
+    *row_bytes = sizeof(FixedLengthHeader) + (offset + value_len_) * sizeof(V);
+    return value_ptr->GetPtr();
+  }
+
   int64 GetFreq(K key) {
     return filter_->GetFreq(key);
   }
@@ -231,29 +318,129 @@ class EmbeddingVar : public ResourceBase {
                            default_value_no_permission_);
   }
 
+  void BatchLookupKey(const K* keys,
+                      ValuePtr<V>** value_ptr_list,
+                      int64 num_of_keys) {
+    storage_->BatchGet(keys, value_ptr_list, num_of_keys);
+  }
+
   void GetEmbeddings(const EmbeddingVarContext<CPUDevice>& context,
                      const K* keys, V* output,
                      int64 num_of_keys) {
+    embedding::EmbeddingVarStats::LookupTimer timer(&stats_, num_of_keys);
+    MaybeRecordIds(keys, num_of_keys);
+    if (mmap_kv_ != nullptr) {
+      GetEmbeddingsFromMmapKV(context, keys, output, num_of_keys);
+      return;
+    }
     auto do_work = [this, keys, output] (int64 start, int64 limit) {
-      for (int64 i = start; i < limit; ++i) {
-        V* default_v =
-            default_value_ +
-                (keys[i] % emb_config_.default_value_dim) * value_len_;
-        filter_->Lookup(keys[i],
-            output + i * value_len_, default_v,
-            default_value_no_permission_);
+      if (serving_row_cache_ != nullptr) {
+        LookupRowsThroughCache(keys + start, output + start * value_len_,
+                               limit - start);
+      } else {
+        LookupRows(keys + start, output + start * value_len_,
+                   limit - start);
       }
     };
     auto worker_threads = context.worker_threads;
     Shard(worker_threads->num_threads,
           worker_threads->workers, num_of_keys,
           value_len_ * sizeof(V), do_work);
+    MaybeRefreshServingRowCache();
+  }
+
+  // Serves the rows of GetEmbeddings from the MmapKV file of path instead
+  // of storage_, the missing keys read the default values of the keys
+  // missing in storage_.
+  Status ServeFromMmapKV(const std::string& path) {
+    std::unique_ptr<embedding::MmapKV<K, V>> mmap_kv(
+        new embedding::MmapKV<K, V>());
+    TF_RETURN_IF_ERROR(mmap_kv->Open(path, value_len_));
+    mmap_kv_ = std::move(mmap_kv);
+    return Status::OK();
+  }
+
+  bool IsServedFromMmapKV() const {
+    return mmap_kv_ != nullptr;
+  }
+
+  // Overwrites the rows of keys with values, the missing keys are created
+  // and admitted by the filter. Used to apply the streamed rows of the
+  // delta checkpoints, and the rows moved from another partition with their
+  // versions and freqs, when they are given.
+  Status ApplyDelta(const K* keys, const V* values, int64 num_of_keys,
+                    const int64* versions = nullptr,
+                    const int64* freqs = nullptr) {
+    if (mmap_kv_ != nullptr || IsSingleHbm() || IsQuantized() ||
+        is_mixed_dim_) {
+      return errors::Unimplemented(
+          "ApplyDelta only supports the rows of value_len values in"
+          " storage_.");
+    }
+    for (int64 i = 0; i < num_of_keys; i++) {
+      ValuePtr<V>* value_ptr = nullptr;
+      TF_RETURN_IF_ERROR(LookupOrCreateKey(keys[i], &value_ptr));
+      if (freqs != nullptr) {
+        value_ptr->SetFreq(freqs[i]);
+      }
+      if (value_ptr->GetFreq() < emb_config_.filter_freq) {
+        value_ptr->SetFreq(emb_config_.filter_freq);
+      }
+      if (versions != nullptr) {
+        value_ptr->SetStep(versions[i]);
+      }
+      const V* row = values + i * value_len_;
+      if (emb_config_.int8_state) {
+        auto state_row = StateRow(value_ptr, keys[i]);
+        memcpy(state_row.flat().data(), row, sizeof(V) * value_len_);
+        state_row.Commit();
+      } else {
+        memcpy(LookupOrCreateEmb(value_ptr, row), row,
+               sizeof(V) * value_len_);
+      }
+    }
+    SetDiverged();
+    return Status::OK();
+  }
+
+  // Removes the rows of keys, with all their slots, once they are moved to
+  // another partition. The ValuePtrs may still be used by concurrent
+  // lookups, they are released by the next call, as the shrink policies do.
+  Status RemoveKeys(const K* keys, int64 num_of_keys) {
+    if (!emb_config_.is_primary()) {
+      return errors::InvalidArgument(
+          "The rows are removed through the primary EmbeddingVar, not ",
+          name_);
+    }
+    if (mmap_kv_ != nullptr || IsMultiLevel() || IsSingleHbm() ||
+        is_mixed_dim_) {
+      return errors::Unimplemented(
+          "RemoveKeys only supports the single tier storage_ on DRAM.");
+    }
+    mutex_lock l(retired_value_ptrs_mu_);
+    for (auto value_ptr : retired_value_ptrs_) {
+      value_ptr->Destroy(alloc_);
+      delete value_ptr;
+    }
+    retired_value_ptrs_.clear();
+    for (int64 i = 0; i < num_of_keys; i++) {
+      ValuePtr<V>* value_ptr = nullptr;
+      if (!storage_->Get(keys[i], &value_ptr).ok()) {
+        continue;
+      }
+      TF_RETURN_IF_ERROR(storage_->Remove(keys[i]));
+      retired_value_ptrs_.emplace_back(value_ptr);
+    }
+    SetDiverged();
+    return Status::OK();
   }
 
 //Used for CPU Adaptive Embedding
   void GetEmbeddings(const EmbeddingVarContext<CPUDevice>& context,
                      const K* keys, V* output,
                      int64 num_of_keys, V* default_value) {
+    embedding::EmbeddingVarStats::LookupTimer timer(&stats_, num_of_keys);
+    MaybeRecordIds(keys, num_of_keys);
     auto do_work = [this, keys, output, default_value]
         (int64 start, int64 limit) {
       for (int64 i = start; i < limit; ++i) {
@@ -276,7 +463,10 @@ class EmbeddingVar : public ResourceBase {
                       ValuePtr<V>** value_ptrs,
                       int64 num_of_keys) {
     const K* keys = (K*)keys_tensor.data();
+    embedding::EmbeddingVarStats::LookupTimer timer(&stats_, num_of_keys);
+    MaybeRecordIds(keys, num_of_keys);
     auto do_work = [this, keys, value_ptrs] (int64 start, int64 limit) {
+      storage_->BatchPromote(keys + start, limit - start);
       for (int64 i = start; i < limit; ++i) {
         bool is_filter = false;
         filter_->LookupOrCreateKey(keys[i], &value_ptrs[i], &is_filter, 1);
@@ -288,6 +478,7 @@ class EmbeddingVar : public ResourceBase {
           num_of_keys, value_len_ * sizeof(V), do_work);
 
     storage_->AddToCachePrefetchList(keys_tensor);
+    MaybeShrinkIncrementally();
   }
 
   void GatherEmbeddings(const EmbeddingVarContext<CPUDevice>& context,
@@ -296,27 +487,44 @@ class EmbeddingVar : public ResourceBase {
                         V* output,
                         int64 num_of_keys) {
     const K* keys = (K*)keys_tensor.data();
-    auto do_work = [this, keys, value_ptrs, output]
-        (int64 start, int64 limit) {
-      for (int64 i = start; i < limit; ++i) {
-        bool is_admit = filter_->is_admit(keys[i], value_ptrs[i]);
-        add_freq_fn_(value_ptrs[i], 1, emb_config_.filter_freq);
-        V* value = nullptr;
-        if (is_admit) {
-          V* default_v =
-              default_value_ +
-                  (keys[i] % emb_config_.default_value_dim) * value_len_;
-          value = LookupOrCreateEmb(value_ptrs[i], default_v);
-        } else {
-          value = default_value_no_permission_;
+    DispatchValuePtrAccess([&](auto access) {
+      typedef decltype(access) Access;
+      auto do_work = [this, keys, value_ptrs, output]
+          (int64 start, int64 limit) {
+        int64 num_rejected = 0;
+        for (int64 i = start; i < limit; ++i) {
+          bool is_admit = filter_->is_admit(keys[i], value_ptrs[i]);
+          add_freq_fn_(value_ptrs[i], 1, emb_config_.filter_freq);
+          num_rejected += !is_admit;
+          V* value = nullptr;
+          if (is_admit && IsDemotedRow(value_ptrs[i])) {
+            ReadDemotedRow(value_ptrs[i], output + i * value_len_);
+            continue;
+          }
+          if (is_admit) {
+            V* default_v =
+                default_value_ +
+                    (keys[i] % emb_config_.default_value_dim) * value_len_;
+            bool is_created = false;
+            value = LookupOrCreateEmb<Access>(value_ptrs[i], default_v,
+                                              alloc_, &is_created);
+            if (is_created) {
+              // The new row may have been written around the cache, its
+              // default value is still in it.
+              value = default_v;
+            }
+          } else {
+            value = default_value_no_permission_;
+          }
+          memcpy(output + i * value_len_, value, sizeof(V) * value_len_);
         }
-        memcpy(output + i * value_len_, value, sizeof(V) * value_len_);
-      }
-    };
-    auto worker_threads = context.worker_threads;
-    Shard(worker_threads->num_threads,
-          worker_threads->workers, num_of_keys,
-          value_len_ * sizeof(V), do_work);
+        stats_.RecordRejections(num_rejected);
+      };
+      auto worker_threads = context.worker_threads;
+      Shard(worker_threads->num_threads,
+            worker_threads->workers, num_of_keys,
+            value_len_ * sizeof(V), do_work);
+    });
 
     storage_->AddToCache(keys_tensor);
   }
@@ -326,6 +534,7 @@ class EmbeddingVar : public ResourceBase {
                      const K* keys,
                      V* output,
                      int64 num_of_keys) {
+    embedding::EmbeddingVarStats::LookupTimer timer(&stats_, num_of_keys);
     if (IsSingleHbm()) {
       storage_->BatchLookup(context.gpu_device, keys, 
 		            output, num_of_keys, default_value_);
@@ -341,6 +550,7 @@ class EmbeddingVar : public ResourceBase {
                       ValuePtr<V>** value_ptrs,
                       int64 num_of_keys) {
     const K* keys = (K*)keys_tensor.data();
+    embedding::EmbeddingVarStats::LookupTimer timer(&stats_, num_of_keys);
     filter_->BatchLookupOrCreateKey(context, keys, value_ptrs, num_of_keys);
     storage_->AddToCachePrefetchList(keys_tensor);
   }
@@ -365,9 +575,11 @@ class EmbeddingVar : public ResourceBase {
     const K* keys = (K*)keys_tensor.data();
     auto do_work = [this, keys, value_ptrs, output, &embedding_ptr]
         (int64 start, int64 limit) {
+      int64 num_rejected = 0;
       for (int64 i = start; i < limit; ++i) {
         bool is_admit = filter_->is_admit(keys[i], value_ptrs[i]);
         add_freq_fn_(value_ptrs[i], 1, emb_config_.filter_freq);
+        num_rejected += !is_admit;
         if (is_admit) {
           V* default_v =
               default_value_ +
@@ -377,6 +589,7 @@ class EmbeddingVar : public ResourceBase {
           embedding_ptr[i] = default_value_no_permission_;
         }
       }
+      stats_.RecordRejections(num_rejected);
     };
     auto worker_threads = context.worker_threads;
     Shard(worker_threads->num_threads,
@@ -397,34 +610,40 @@ class EmbeddingVar : public ResourceBase {
       V** var_ptr,
       ValuePtr<V>** value_ptrs,
       const K* indices,
-      int64 num_of_keys,
-      IntraThreadCopyIdAllocator* thread_copy_id_alloc) {
-    int num_worker_threads = ctx.worker_threads->num_threads;
-    std::vector<std::list<int64>> init_cursor_list(
-        num_worker_threads + 1);
-    uint64 main_thread_id = Env::Default()->GetCurrentThreadId();
-
-    auto do_work_get_ptrs = [this, value_ptrs, &init_cursor_list,
-        &thread_copy_id_alloc, main_thread_id, var_ptr] (int64 start, int64 limit) {
-      int copy_id =
-          thread_copy_id_alloc->GetCopyIdOfThread(main_thread_id);
-      for (int i = start; i < limit; i++) {
-        bool is_need_set_default_value = false;
-        var_ptr[i] = LookupOrCreateEmb(
-            value_ptrs[i], is_need_set_default_value);
-        if (is_need_set_default_value) {
-          init_cursor_list[copy_id].emplace_back(i);
+      int64 num_of_keys) {
+    MaybeRecordIds(indices, num_of_keys);
+    // The keys are partitioned by hash, each partition is created by one
+    // thread, so the duplicates of a key never race on its ValuePtr, and
+    // collects the cursors of its new features in a list of its own.
+    const int num_partitions = ctx.worker_threads->num_threads + 1;
+    std::vector<std::vector<int64>> partitions(num_partitions);
+    for (int64 i = 0; i < num_of_keys; i++) {
+      partitions[static_cast<uint64>(indices[i]) % num_partitions]
+          .emplace_back(i);
+    }
+    std::vector<std::list<int64>> init_cursor_list(num_partitions);
+
+    auto do_work_get_ptrs = [this, value_ptrs, var_ptr, &partitions,
+        &init_cursor_list] (int64 start, int64 limit) {
+      for (int64 p = start; p < limit; p++) {
+        for (int64 i : partitions[p]) {
+          bool is_need_set_default_value = false;
+          var_ptr[i] = LookupOrCreateEmb(
+              value_ptrs[i], is_need_set_default_value);
+          if (is_need_set_default_value) {
+            init_cursor_list[p].emplace_back(i);
+          }
         }
       }
     };
-    const int64 unit_cost = 1000;
+    const int64 unit_cost = 1000 * (num_of_keys / num_partitions + 1);
     auto worker_threads = ctx.worker_threads;
     Shard(worker_threads->num_threads,
           worker_threads->workers,
-          num_of_keys, unit_cost, do_work_get_ptrs);
+          num_partitions, unit_cost, do_work_get_ptrs);
 
     // Merge copies of init_cursor_list
-    for (int i = 1; i < (worker_threads->num_threads + 1); i++) {
+    for (int i = 1; i < num_partitions; i++) {
       if (init_cursor_list[i].size() > 0) {
         init_cursor_list[0].splice(init_cursor_list[0].end(),
                                    init_cursor_list[i]);
@@ -498,23 +717,71 @@ class EmbeddingVar : public ResourceBase {
 #endif  // GOOGLE_CUDA
 
   V* LookupOrCreateEmb(ValuePtr<V>* value_ptr, const V* default_v) {
-    return value_ptr->GetOrAllocate(alloc_, value_len_, default_v,
-        emb_config_.emb_index, storage_->GetOffset(
-          emb_config_.emb_index));
+    return LookupOrCreateEmb(value_ptr, default_v, alloc_);
   }
 
+  // Sets 'is_created' if the embedding did not exist and was created from
+  // 'default_v'.
   V* LookupOrCreateEmb(ValuePtr<V>* value_ptr, const V* default_v,
-                       Allocator* alloc) {
-    return value_ptr->GetOrAllocate(alloc, value_len_, default_v,
-        emb_config_.emb_index, storage_->GetOffset(
-            emb_config_.emb_index));
+                       Allocator* alloc, bool* is_created = nullptr) {
+    V* value = nullptr;
+    DispatchValuePtrAccess([&](auto access) {
+      value = LookupOrCreateEmb<decltype(access)>(value_ptr, default_v, alloc,
+                                                  is_created);
+    });
+    return value;
+  }
+
+  // LookupOrCreateEmb for the ValuePtrs of Access, see
+  // DispatchValuePtrAccess. The 8-bit optimizer states are read as a
+  // dequantized copy, like the quantized layouts, valid until the next call
+  // on the same thread; the optimizers update them through StateRow.
+  template <class Access>
+  V* LookupOrCreateEmb(ValuePtr<V>* value_ptr, const V* default_v,
+                       Allocator* alloc, bool* is_created) {
+    V* value = LookupOrCreateRow<Access>(value_ptr, default_v, alloc,
+                                         is_created);
+    if (emb_config_.int8_state) {
+      static thread_local std::vector<V> dequantized;
+      dequantized.resize(value_len_);
+      embedding::DequantizeRow(embedding::RowQuantization::DYNAMIC_INT8,
+                               reinterpret_cast<const char*>(value),
+                               value_len_, embedding::kStateBlockSize,
+                               dequantized.data());
+      return dequantized.data();
+    }
+    return value;
+  }
+
+  // The row of an optimizer state at value_ptr, created from the default
+  // value of index, e.g. a moment of Adam. The 8-bit states are updated
+  // on a dequantized copy, see embedding::OptimizerStateRow.
+  embedding::OptimizerStateRow<V> StateRow(ValuePtr<V>* value_ptr,
+                                           int64 index) {
+    V* default_v =
+        default_value_ + (index % emb_config_.default_value_dim) * value_len_;
+    if (IsLazySlot(value_ptr)) {
+      return embedding::OptimizerStateRow<V>(StandInSlot(default_v),
+                                             value_len_, false);
+    }
+    V* value = nullptr;
+    DispatchValuePtrAccess([&](auto access) {
+      value = LookupOrCreateRow<decltype(access)>(value_ptr, default_v,
+                                                  alloc_, nullptr);
+    });
+    return embedding::OptimizerStateRow<V>(value, value_len_,
+                                           emb_config_.int8_state);
   }
 
   V* LookupOrCreateEmb(ValuePtr<V>* value_ptr, bool &need_initialize) {
-    return value_ptr->GetOrAllocate(alloc_, value_len_, nullptr,
+    V* value = value_ptr->GetOrAllocate(alloc_, value_len_, nullptr,
         emb_config_.emb_index,
         storage_->GetOffset(emb_config_.emb_index),
         need_initialize);
+    if (need_initialize) {
+      stats_.RecordCreation();
+    }
+    return value;
   }
 
   V* LookupPrimaryEmb(ValuePtr<V>* value_ptr) {
@@ -523,22 +790,162 @@ class EmbeddingVar : public ResourceBase {
     return primary_val;
   }
 
+  // The row of the slots of the cold keys is a stand-in copy of the
+  // default value, see IsLazySlot.
   typename TTypes<V>::Flat flat(ValuePtr<V>* value_ptr, int64 index) {
     V* default_v =
         default_value_ + (index % emb_config_.default_value_dim) * value_len_;
-    V* val = LookupOrCreateEmb(value_ptr, default_v);
+    V* val = IsLazySlot(value_ptr) ? StandInSlot(default_v)
+                                   : LookupOrCreateEmb(value_ptr, default_v);
     Eigen::array<Eigen::DenseIndex, 1> dims({value_len_});
     return typename TTypes<V>::Flat(val, dims);
   }
 
+  // The rows of the quantized layouts are dequantized into out, or
+  // accumulated into it, without a dequantized copy of them. value_ptr is
+  // nullptr for missing keys, which read the default value.
+  void DequantizeEmbedding(ValuePtr<V>* value_ptr, const V* default_v,
+                           V* out) {
+    auto quantized_ptr = static_cast<QuantizedValuePtr<V>*>(value_ptr);
+    if (quantized_ptr != nullptr && quantized_ptr->IsInitialized()) {
+      quantized_ptr->Dequantize(out, value_len_);
+    } else {
+      memcpy(out, default_v, sizeof(V) * value_len_);
+    }
+  }
+
+  void AccumulateEmbedding(K key, ValuePtr<V>* value_ptr, float weight,
+                           V* out) {
+    auto quantized_ptr = static_cast<QuantizedValuePtr<V>*>(value_ptr);
+    if (quantized_ptr != nullptr && quantized_ptr->IsInitialized()) {
+      quantized_ptr->Accumulate(weight, out, value_len_);
+    } else {
+      V* default_v = default_value_ +
+          (key % emb_config_.default_value_dim) * value_len_;
+      for (int64 i = 0; i < value_len_; i++) {
+        out[i] += static_cast<V>(weight * static_cast<float>(default_v[i]));
+      }
+    }
+  }
+
+  bool IsQuantized() {
+    return storage_->IsQuantizedLayout();
+  }
+
+  bool IsMixedDim() const {
+    return is_mixed_dim_;
+  }
+
+  // The values stored for key, the rest of value_len_ read as 0.
+  int64 RowDims(K key) {
+    ValuePtr<V>* value_ptr = nullptr;
+    if (is_mixed_dim_ && LookupKey(key, &value_ptr).ok() &&
+        IsDemotedRow(value_ptr)) {
+      return static_cast<MixedDimValuePtr<V>*>(value_ptr)->RowDims();
+    }
+    return value_len_;
+  }
+
   int64 ValueLen() const {
     return value_len_;
   }
 
   int64 Size() const {
+    if (mmap_kv_ != nullptr) {
+      return mmap_kv_->Size();
+    }
     return storage_->Size();
   }
 
+  bool IsTailFolding() const {
+    return tail_fold_min_freq_ > 0;
+  }
+
+  // Drops the rows of the tail keys of a restored buffer, the keys seen
+  // less than tail_fold_min_freq_ times and those of the filtered lists,
+  // and moves the other rows of the partition to the front of the buffer.
+  // The rows of the tail keys are averaged into the rows of the tail table
+  // their keys hash to. Returns the number of rows left, to import.
+  int64 FoldTailRows(RestoreBuffer& restore_buff, int64 key_num,
+                     int bucket_num, int64 partition_id,
+                     int64 partition_num, bool is_filter) {
+    K* keys = (K*)restore_buff.key_buffer;
+    V* values = (V*)restore_buff.value_buffer;
+    int64* versions = (int64*)restore_buff.version_buffer;
+    int64* freqs = (int64*)restore_buff.freq_buffer;
+    if (!is_filter && std::none_of(freqs, freqs + key_num,
+                                   [](int64 freq) { return freq > 0; })) {
+      // Without the freqs of the keys, e.g. not recorded in training.
+      return key_num;
+    }
+    mutex_lock l(tail_mu_);
+    int64 num_kept = 0;
+    for (int64 i = 0; i < key_num; ++i) {
+      if (keys[i] % bucket_num % partition_num != partition_id) {
+        continue;
+      }
+      if (is_filter || freqs[i] < tail_fold_min_freq_) {
+        if (!is_filter && !tail_rows_.empty()) {
+          const int64 bucket = TailBucket(keys[i]);
+          const double count = ++tail_counts_[bucket];
+          V* row = tail_rows_.data() + bucket * value_len_;
+          const V* value = values + i * value_len_;
+          for (int64 j = 0; j < value_len_; ++j) {
+            const double mean = static_cast<double>(row[j]);
+            row[j] = static_cast<V>(
+                mean + (static_cast<double>(value[j]) - mean) / count);
+          }
+        }
+        ++num_tail_keys_;
+        continue;
+      }
+      if (num_kept != i) {
+        keys[num_kept] = keys[i];
+        memcpy(values + num_kept * value_len_, values + i * value_len_,
+               sizeof(V) * value_len_);
+        versions[num_kept] = versions[i];
+        freqs[num_kept] = freqs[i];
+      }
+      ++num_kept;
+    }
+    num_kept_keys_ += num_kept;
+    return num_kept;
+  }
+
+  // The row of the tail table of a key not restored, nullptr without it.
+  const V* TailRow(K key) const {
+    if (tail_rows_.empty()) {
+      return nullptr;
+    }
+    return tail_rows_.data() + TailBucket(key) * value_len_;
+  }
+
+  // Logs the footprint of the keys restored since the last report.
+  void ReportTailFolding() {
+    if (!IsTailFolding()) {
+      return;
+    }
+    mutex_lock l(tail_mu_);
+    const int64 row_bytes = sizeof(K) + value_len_ * sizeof(V);
+    const int64 num_total = num_kept_keys_ + num_tail_keys_;
+    const double total_mb = num_total * row_bytes / 1048576.0;
+    const double kept_mb =
+        (num_kept_keys_ * row_bytes + tail_rows_.size() * sizeof(V)) /
+        1048576.0;
+    LOG(INFO) << "[EV tail folding] " << name_ << ": kept "
+              << num_kept_keys_ << " of " << num_total
+              << " keys, folded the others into "
+              << tail_rows_.size() / std::max<int64>(value_len_, 1)
+              << " rows, " << total_mb << " MB -> " << kept_mb << " MB ("
+              << (kept_mb > 0 ? total_mb / kept_mb : 0) << "x)";
+    num_kept_keys_ = 0;
+    num_tail_keys_ = 0;
+  }
+
+  void Reserve(int64 num_keys) {
+    storage_->Reserve(num_keys);
+  }
+
   int64 CacheSize() const {
     return storage_->CacheSize();
   }
@@ -551,6 +958,15 @@ class EmbeddingVar : public ResourceBase {
     return emb_config_.steps_to_live;
   }
 
+  bool IsInference() const {
+    return emb_config_.is_inference;
+  }
+
+  // Whether GetVersion is the global step of the last update.
+  bool IsRecordVersion() const {
+    return emb_config_.steps_to_live != 0 || emb_config_.record_version;
+  }
+
   bool IsMultiLevel() {
     return storage_->IsMultiLevel();
   }
@@ -628,6 +1044,12 @@ class EmbeddingVar : public ResourceBase {
         value_len_, emb_config_.emb_index);
   }
 
+  // Promotes the rows of the keys of a coming step to the first tier.
+  void Prefetch(const Tensor& keys_tensor) {
+    storage_->Prefetch(keys_tensor,
+                       emb_config_.total_num(storage_->GetAllocLen()));
+  }
+
   void RestoreSsdHashmap(
       K* key_list, int64* key_file_id_list,
       int64* key_offset_list, int64 num_of_keys,
@@ -702,9 +1124,14 @@ class EmbeddingVar : public ResourceBase {
     // TODO Multi-tiered Embedding should use iterator in 'GetSnapshot' caller
     embedding::Iterator* _it = nullptr;
     it = (it == nullptr) ? &_it : it;
-    return storage_->GetSnapshot(
+    const int64 start = value_list->size();
+    int64 num_of_keys = storage_->GetSnapshot(
         key_list, value_list, version_list,
         freq_list, emb_config_, filter_, it);
+    if (emb_config_.int8_state) {
+      DequantizeStates(value_list, start);
+    }
+    return num_of_keys;
   }
 
   int64 GetSnapshotWithoutFetchPersistentEmb(
@@ -727,10 +1154,67 @@ class EmbeddingVar : public ResourceBase {
     return storage_;
   }
 
+  // Appends the lookup counters, the keys and bytes of every tier, the hit
+  // ratio of the first tier and the bytes evicted from it for multi-tier
+  // storages, and the fragmentation of alloc_ if it reports its reserved
+  // and used bytes, e.g. the EV allocator with TF_EV_ALLOCATOR_COLLECT_STATS.
+  void GetStats(std::vector<std::string>* names,
+                std::vector<double>* values) {
+    stats_.Append(names, values);
+    auto append = [names, values](const std::string& name, double value) {
+      names->emplace_back(name);
+      values->emplace_back(value);
+    };
+    append("num_keys", storage_->Size());
+    if (serving_row_cache_ != nullptr) {
+      append("row_cache_rows", serving_row_cache_->NumRows());
+    }
+    const int num_tiers = storage_type_ >= embedding::DRAM_PMEM_SSDHASH ? 3 :
+        (storage_type_ >= embedding::DRAM_PMEM ? 2 : 1);
+    const int64 row_bytes =
+        emb_config_.total_num(storage_->GetAllocLen()) * sizeof(V);
+    for (int i = 0; i < num_tiers; i++) {
+      const int64 num_keys = storage_->Size(i);
+      if (num_keys < 0) {
+        continue;
+      }
+      append(strings::StrCat("tier", i, "_keys"), num_keys);
+      append(strings::StrCat("tier", i, "_bytes"), num_keys * row_bytes);
+    }
+    if (IsMultiLevel() && storage_->Cache() != nullptr) {
+      auto cache = storage_->Cache();
+      const int64 hits = cache->hit_count();
+      const int64 misses = cache->miss_count();
+      append("first_tier_hit_ratio",
+             hits + misses == 0 ? 0.0
+                                : static_cast<double>(hits) / (hits + misses));
+      append("evicted_bytes", storage_->EvictedBytes());
+    }
+    auto alloc_stats = alloc_->GetStats();
+    if (alloc_stats && alloc_stats->bytes_reserved > 0 &&
+        alloc_stats->bytes_in_use > 0) {
+      append("allocator_bytes_reserved", alloc_stats->bytes_reserved);
+      append("allocator_bytes_in_use", alloc_stats->bytes_in_use);
+      append("allocator_fragmentation",
+             1.0 - static_cast<double>(alloc_stats->bytes_in_use) /
+                       alloc_stats->bytes_reserved);
+    }
+    // The locks are shared by the EmbeddingVars of the process.
+    if (auto lock_contention = embedding::LockContention::Global()) {
+      lock_contention->Append(names, values);
+    }
+  }
+
   Status Shrink(embedding::ShrinkArgs& shrink_args) {
     if (emb_config_.is_primary()) {
       shrink_args.value_len = value_len_;
-      return storage_->Shrink(shrink_args);
+      // The rows are expired by the lookups of the training steps instead.
+      Status s = incremental_shrink_keys_ > 0 ?
+          Status::OK() : storage_->Shrink(shrink_args);
+      if (s.ok() && is_mixed_dim_) {
+        ResizeMixedDimRows();
+      }
+      return s;
     } else {
       return Status::OK();
     }
@@ -823,7 +1307,8 @@ class EmbeddingVar : public ResourceBase {
 
   void LookupOrCreateKey(const K* key, int32* item_idxs, size_t n,
       const Eigen::GpuDevice& device, int64 update_version = -1) {
-    storage_->BatchLookupOrCreateKeys(key, item_idxs, n, device);
+    storage_->BatchLookupOrCreateKeys(key, item_idxs, n, device,
+        update_version);
   }
 
   void Lookup(const K* key, V* val, V* default_v,
@@ -868,9 +1353,399 @@ class EmbeddingVar : public ResourceBase {
     if (filter_) {
       delete filter_;
     }
+    for (auto row : retired_rows_) {
+      alloc_->DeallocateRaw(row);
+    }
+    for (auto value_ptr : retired_value_ptrs_) {
+      value_ptr->Destroy(alloc_);
+      delete value_ptr;
+    }
   }
 
  private:
+  // The classes of the ValuePtrs accessed without virtual calls: those of
+  // the layouts of the single-tier DRAM storages, which create all their
+  // ValuePtrs from their layout.
+  enum class ValuePtrClass {
+    kAny,
+    kLight,
+    kNormal,
+    kNormalContiguous,
+    kCompact,
+  };
+
+  static ValuePtrClass GetValuePtrClass(embedding::Storage<K, V>* storage) {
+    switch (storage->GetStorageType()) {
+      case embedding::StorageType::DRAM:
+      case embedding::StorageType::DRAM_SWISS:
+      case embedding::StorageType::DRAM_NUMA:
+        break;
+      default:
+        return ValuePtrClass::kAny;
+    }
+    switch (storage->GetLayoutType()) {
+      case LayoutType::LIGHT:
+        return ValuePtrClass::kLight;
+      case LayoutType::NORMAL:
+        return ValuePtrClass::kNormal;
+      case LayoutType::NORMAL_CONTIGUOUS:
+        return ValuePtrClass::kNormalContiguous;
+      case LayoutType::COMPACT:
+        return ValuePtrClass::kCompact;
+      default:
+        return ValuePtrClass::kAny;
+    }
+  }
+
+  // Calls f with the ValuePtrAccess of the class of the ValuePtrs, once per
+  // op, so that the loops of f over the rows make no virtual calls.
+  template <class F>
+  void DispatchValuePtrAccess(F f) const {
+    switch (value_ptr_class_) {
+      case ValuePtrClass::kLight:
+        f(ValuePtrAccess<V, LightValuePtr<V>>());
+        break;
+      case ValuePtrClass::kNormal:
+        f(ValuePtrAccess<V, NormalValuePtr<V>>());
+        break;
+      case ValuePtrClass::kNormalContiguous:
+        f(ValuePtrAccess<V, NormalContiguousValuePtr<V>>());
+        break;
+      case ValuePtrClass::kCompact:
+        f(ValuePtrAccess<V, CompactValuePtr<V>>());
+        break;
+      default:
+        f(ValuePtrAccess<V, ValuePtr<V>>());
+        break;
+    }
+  }
+
+  // Builds add_freq_fn_ and update_version_fn_ on the ValuePtrs of the
+  // layout of the storage.
+  template <class Access>
+  void InitValuePtrFns() {
+    int64 freq_error_percent = 0;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_FREQ_ERROR_PERCENT", 0,
+                                    &freq_error_percent));
+    embedding::FreqSampler freq_sampler(freq_error_percent);
+    // Only the entries of the normal layout count their frequencies and
+    // allocate their slots apart, see IsLazySlot.
+    if (LayoutType::NORMAL == storage_->GetLayoutType()) {
+      TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_LAZY_SLOT_FREQ", 0,
+                                      &lazy_slot_freq_));
+    }
+    if (freq_sampler.enabled() &&
+        (IsMultiLevel() || emb_config_.record_freq)) {
+      add_freq_fn_ = [freq_sampler](ValuePtr<V>* value_ptr, int64 freq,
+                                    int64 filter_freq) {
+        const int64 count =
+            freq_sampler.Sample(Access::GetFreq(value_ptr), freq);
+        if (count > 0)
+          Access::AddFreq(value_ptr, count);
+      };
+    } else if (IsMultiLevel() || emb_config_.record_freq) {
+      add_freq_fn_ = [](ValuePtr<V>* value_ptr, int64 freq, int64 filter_freq) {
+        Access::AddFreq(value_ptr, freq);
+      };
+    } else if (emb_config_.is_counter_filter() || lazy_slot_freq_ > 0) {
+      // The frequencies are counted until the keys are admitted and their
+      // slots are created.
+      const int64 lazy_slot_freq = lazy_slot_freq_;
+      add_freq_fn_ = [freq_sampler, lazy_slot_freq](ValuePtr<V>* value_ptr,
+                                                    int64 freq,
+                                                    int64 filter_freq) {
+        const int64 current = Access::GetFreq(value_ptr);
+        if (current < std::max(filter_freq, lazy_slot_freq)) {
+          const int64 count = freq_sampler.Sample(current, freq);
+          if (count > 0)
+            Access::AddFreq(value_ptr, count);
+        }
+      };
+    } else {
+      add_freq_fn_ = [](ValuePtr<V>* value_ptr, int64 freq, int64 filter_freq) {};
+    }
+    // The version of an entry is only written when it is more than
+    // version_slack steps behind, so the lookups of a key in one step do
+    // not write it again. Eviction by steps_to_live is then early by at
+    // most version_slack steps.
+    int64 version_slack = 0;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_VERSION_SLACK_STEPS", 0,
+                                    &version_slack));
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_INCREMENTAL_SHRINK_KEYS", 0,
+                                    &incremental_shrink_keys_));
+    // The light and compact layouts record no version.
+    const bool has_version =
+        storage_->GetLayoutType() != LayoutType::LIGHT &&
+        storage_->GetLayoutType() != LayoutType::COMPACT;
+    if (!has_version) {
+      update_version_fn_ = [](ValuePtr<V>* value_ptr, int64 gs) {};
+    } else if (incremental_shrink_keys_ > 0 &&
+               emb_config_.steps_to_live != 0) {
+      // The incremental shrink runs in the lookups, which have no global
+      // step, so it uses the latest one of the applies.
+      update_version_fn_ = [this, version_slack](ValuePtr<V>* value_ptr,
+                                                 int64 gs) {
+        SetStepIfBehind<Access>(value_ptr, gs, version_slack);
+        if (gs > latest_global_step_.load(std::memory_order_relaxed)) {
+          latest_global_step_.store(gs, std::memory_order_relaxed);
+        }
+      };
+    } else if (emb_config_.steps_to_live != 0 || emb_config_.record_version) {
+      update_version_fn_ = [version_slack](ValuePtr<V>* value_ptr, int64 gs) {
+        SetStepIfBehind<Access>(value_ptr, gs, version_slack);
+      };
+    } else {
+      update_version_fn_ = [](ValuePtr<V>* value_ptr, int64 gs) {};
+    }
+  }
+
+  template <class Access>
+  static void SetStepIfBehind(ValuePtr<V>* value_ptr, int64 gs,
+                              int64 slack) {
+    const int64 step = Access::GetStep(value_ptr);
+    if (gs < step || gs - step > slack) {
+      Access::SetStep(value_ptr, gs);
+    }
+  }
+
+  // The row of value_ptr, the 8-bit state of the row for int8_state.
+  template <class Access>
+  V* LookupOrCreateRow(ValuePtr<V>* value_ptr, const V* default_v,
+                       Allocator* alloc, bool* is_created) {
+    PromoteDemotedRow(value_ptr);
+    const int64 offset = storage_->GetOffset(emb_config_.emb_index);
+    V* value = Access::GetValue(value_ptr, emb_config_.emb_index, offset);
+    const bool created = value == nullptr;
+    if (created) {
+      stats_.RecordCreation();
+    }
+    if (is_created != nullptr) {
+      *is_created = created;
+    }
+    if (!emb_config_.int8_state) {
+      return Access::GetOrAllocate(value_ptr, alloc, value_len_, default_v,
+                                   emb_config_.emb_index, offset);
+    }
+    if (!created) {
+      return value;
+    }
+    static thread_local std::vector<V> state;
+    state.resize(state_len_);
+    embedding::QuantizeRow(embedding::RowQuantization::DYNAMIC_INT8,
+                           default_v, value_len_, embedding::kStateBlockSize,
+                           reinterpret_cast<char*>(state.data()));
+    return Access::GetOrAllocate(value_ptr, alloc, state_len_, state.data(),
+                                 emb_config_.emb_index, offset);
+  }
+
+  // Whether the slot row of value_ptr is not created yet, because the
+  // frequency of its key is below TF_EV_LAZY_SLOT_FREQ. The optimizers then
+  // update a stand-in copy of the default value, which is dropped, so the
+  // keys updated a few times before they are evicted never allocate their
+  // slots.
+  bool IsLazySlot(ValuePtr<V>* value_ptr) {
+    if (lazy_slot_freq_ == 0 || emb_config_.is_primary()) {
+      return false;
+    }
+    bool is_lazy = false;
+    DispatchValuePtrAccess([&](auto access) {
+      typedef decltype(access) Access;
+      is_lazy = Access::GetValue(value_ptr, emb_config_.emb_index,
+                    storage_->GetOffset(emb_config_.emb_index)) == nullptr &&
+                Access::GetFreq(value_ptr) < lazy_slot_freq_;
+    });
+    return is_lazy;
+  }
+
+  // A copy of default_v per thread and slot, valid until the next call for
+  // the slot on the same thread.
+  V* StandInSlot(const V* default_v) {
+    static thread_local std::vector<std::vector<V>> stand_ins;
+    if (stand_ins.size() <= emb_config_.emb_index) {
+      stand_ins.resize(emb_config_.emb_index + 1);
+    }
+    std::vector<V>& stand_in = stand_ins[emb_config_.emb_index];
+    stand_in.assign(default_v, default_v + value_len_);
+    return stand_in.data();
+  }
+
+  // Replaces the 8-bit states of value_list from start by dequantized
+  // copies, which are valid until the next snapshot.
+  void DequantizeStates(std::vector<V*>* value_list, int64 start) {
+    state_snapshot_.resize((value_list->size() - start) * value_len_);
+    for (int64 i = start; i < value_list->size(); ++i) {
+      V* state = (*value_list)[i];
+      if (state == nullptr || state == reinterpret_cast<V*>(-1)) {
+        continue;
+      }
+      V* row = state_snapshot_.data() + (i - start) * value_len_;
+      embedding::DequantizeRow(embedding::RowQuantization::DYNAMIC_INT8,
+                               reinterpret_cast<const char*>(state),
+                               value_len_, embedding::kStateBlockSize, row);
+      (*value_list)[i] = row;
+    }
+  }
+
+  void MaybeShrinkIncrementally() {
+    if (incremental_shrink_keys_ > 0 && emb_config_.is_primary()) {
+      embedding::ShrinkArgs shrink_args(
+          latest_global_step_.load(std::memory_order_relaxed), value_len_);
+      TF_CHECK_OK(storage_->IncrementalShrink(shrink_args,
+                                              incremental_shrink_keys_));
+    }
+  }
+
+  void LookupRows(const K* keys, V* output, int64 num_of_keys) {
+    std::vector<ValuePtr<V>*> value_ptr_list(num_of_keys, nullptr);
+    BatchLookupKey(keys, value_ptr_list.data(), num_of_keys);
+    bool is_quantized = IsQuantized();
+    for (int64 i = 0; i < num_of_keys; ++i) {
+      V* default_v =
+          default_value_ +
+              (keys[i] % emb_config_.default_value_dim) * value_len_;
+      if (value_ptr_list[i] == nullptr && !tail_rows_.empty()) {
+        memcpy(output + i * value_len_, TailRow(keys[i]),
+               sizeof(V) * value_len_);
+      } else if (is_quantized) {
+        DequantizeEmbedding(value_ptr_list[i], default_v,
+                            output + i * value_len_);
+      } else if (IsDemotedRow(value_ptr_list[i])) {
+        ReadDemotedRow(value_ptr_list[i], output + i * value_len_);
+      } else {
+        filter_->LookupWithValuePtr(keys[i], value_ptr_list[i],
+            output + i * value_len_, default_v,
+            default_value_no_permission_);
+      }
+    }
+  }
+
+  // Serves the cached rows and looks up the others.
+  void LookupRowsThroughCache(const K* keys, V* output, int64 num_of_keys) {
+    std::unique_ptr<bool[]> hits(new bool[num_of_keys]);
+    const int64 num_hits = serving_row_cache_->Lookup(
+        keys, num_of_keys, output, hits.get());
+    stats_.RecordRowCacheHits(num_hits);
+    if (num_hits == num_of_keys) {
+      return;
+    }
+    std::vector<K> missed_keys;
+    missed_keys.reserve(num_of_keys - num_hits);
+    for (int64 i = 0; i < num_of_keys; ++i) {
+      if (!hits[i]) {
+        missed_keys.emplace_back(keys[i]);
+      }
+    }
+    std::vector<V> missed_rows(missed_keys.size() * value_len_);
+    LookupRows(missed_keys.data(), missed_rows.data(), missed_keys.size());
+    const V* row = missed_rows.data();
+    for (int64 i = 0; i < num_of_keys; ++i) {
+      if (!hits[i]) {
+        memcpy(output + i * value_len_, row, sizeof(V) * value_len_);
+        row += value_len_;
+      }
+    }
+  }
+
+  // Refreshes the serving row cache in the background when it is due. The
+  // EmbeddingVar is kept alive until the refresh ends.
+  void MaybeRefreshServingRowCache() {
+    if (serving_row_cache_ == nullptr || !serving_row_cache_->StartRefresh()) {
+      return;
+    }
+    Ref();
+    Env::Default()->SchedClosure([this]() {
+      serving_row_cache_->Refresh();
+      VLOG(1) << "Serving row cache of " << name_ << " refreshed with "
+              << serving_row_cache_->NumRows() << " rows";
+      Unref();
+    });
+  }
+
+  void MaybeRecordIds(const K* keys, int64 num_of_keys) {
+    if (id_trace_recorder_ != nullptr) {
+      id_trace_recorder_->Record(keys, num_of_keys);
+    }
+  }
+
+  void GetEmbeddingsFromMmapKV(const EmbeddingVarContext<CPUDevice>& context,
+                               const K* keys, V* output,
+                               int64 num_of_keys) {
+    auto do_work = [this, keys, output] (int64 start, int64 limit) {
+      for (int64 i = start; i < limit; ++i) {
+        const V* row = mmap_kv_->FindRow(keys[i]);
+        if (row == nullptr && emb_config_.filter_freq != 0) {
+          row = default_value_no_permission_;
+        } else if (row == nullptr) {
+          row = default_value_ +
+              (keys[i] % emb_config_.default_value_dim) * value_len_;
+        }
+        memcpy(output + i * value_len_, row, value_len_ * sizeof(V));
+      }
+    };
+    auto worker_threads = context.worker_threads;
+    Shard(worker_threads->num_threads,
+          worker_threads->workers, num_of_keys,
+          value_len_ * sizeof(V), do_work);
+  }
+
+  // Rows of the mixed_dim layout are demoted to the dims of their freq by
+  // Shrink, which runs before the EVs are saved, and promoted to value_len_
+  // again when they are written. Lookups read demoted rows without
+  // promoting them.
+  bool IsDemotedRow(ValuePtr<V>* value_ptr) const {
+    return is_mixed_dim_ && value_ptr != nullptr &&
+        static_cast<MixedDimValuePtr<V>*>(value_ptr)->RowDims() != 0;
+  }
+
+  void ReadDemotedRow(ValuePtr<V>* value_ptr, V* out) const {
+    static_cast<MixedDimValuePtr<V>*>(value_ptr)->ReadPrimary(
+        out, value_len_);
+  }
+
+  void PromoteDemotedRow(ValuePtr<V>* value_ptr) {
+    if (IsDemotedRow(value_ptr)) {
+      RetireRow(static_cast<MixedDimValuePtr<V>*>(value_ptr)->Resize(alloc_,
+          0, value_len_, emb_config_.total_num(storage_->GetAllocLen())));
+    }
+  }
+
+  void ResizeMixedDimRows() {
+    std::vector<K> key_list;
+    std::vector<ValuePtr<V>*> value_ptr_list;
+    TF_CHECK_OK(storage_->GetSnapshot(&key_list, &value_ptr_list));
+    int64 total_dims = emb_config_.total_num(storage_->GetAllocLen());
+    int64 num_demoted = 0;
+    for (auto value_ptr : value_ptr_list) {
+      // Rows without the primary embedding have nothing to keep.
+      if (value_ptr->GetValue(emb_config_.primary_emb_index,
+              storage_->GetOffset(emb_config_.primary_emb_index)) == nullptr) {
+        continue;
+      }
+      auto mixed_dim_ptr = static_cast<MixedDimValuePtr<V>*>(value_ptr);
+      int64 dims = dim_classes_.Dims(mixed_dim_ptr->GetFreq());
+      RetireRow(mixed_dim_ptr->Resize(alloc_, dims, value_len_, total_dims));
+      if (dims != 0) {
+        num_demoted++;
+      }
+    }
+    VLOG(1) << "EV: " << name_ << ", " << num_demoted << " of "
+            << value_ptr_list.size() << " rows are demoted.";
+  }
+
+  // Resized rows may still be read by concurrent lookups, the oldest ones
+  // are released when there are more than kMaxRetiredRows of them.
+  void RetireRow(void* row) {
+    if (row == nullptr) {
+      return;
+    }
+    mutex_lock l(retired_rows_mu_);
+    if (retired_rows_.size() >= kMaxRetiredRows) {
+      alloc_->DeallocateRaw(retired_rows_.front());
+      retired_rows_.pop_front();
+    }
+    retired_rows_.emplace_back(row);
+  }
+
   void LookupThroughFilter(
       const EmbeddingVarContext<CPUDevice>& context,
       const Tensor& indices, V* output,
@@ -921,8 +1796,31 @@ class EmbeddingVar : public ResourceBase {
     return mem_addr;
   }
 
+  // Tail folding of the serving EVs, the restored keys seen less than
+  // TF_EV_TAIL_FOLD_MIN_FREQ times are not imported, and their lookups read
+  // the TF_EV_TAIL_FOLD_BUCKETS rows of the tail table by the hash of the
+  // keys, or the default values of missing keys without buckets.
+  void InitTailFolding() {
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_TAIL_FOLD_MIN_FREQ", 0,
+                                    &tail_fold_min_freq_));
+    int64 num_buckets = 0;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_TAIL_FOLD_BUCKETS", 0,
+                                    &num_buckets));
+    if (tail_fold_min_freq_ > 0 && num_buckets > 0) {
+      tail_rows_.assign(num_buckets * value_len_, static_cast<V>(0));
+      tail_counts_.assign(num_buckets, 0);
+    }
+  }
+
+  int64 TailBucket(K key) const {
+    return Hash64(reinterpret_cast<const char*>(&key), sizeof(K)) %
+           tail_counts_.size();
+  }
+
   std::string name_;
   bool is_initialized_ = false;
+  bool is_shared_ = false;
+  std::atomic<bool> is_diverged_{false};
 
   mutex mu_;
 
@@ -939,6 +1837,37 @@ class EmbeddingVar : public ResourceBase {
   FilterPolicy<K, V, EmbeddingVar<K, V>>* filter_;
   std::function<void(ValuePtr<V>*, int64, int64)> add_freq_fn_;
   std::function<void(ValuePtr<V>*, int64)> update_version_fn_;
+  bool is_mixed_dim_ = false;
+  ValuePtrClass value_ptr_class_ = ValuePtrClass::kAny;
+  // The number of V of the 8-bit states, and their dequantized snapshot.
+  int64 state_len_ = 0;
+  std::vector<V> state_snapshot_;
+  int64 lazy_slot_freq_ = 0;
+  embedding::DimClasses dim_classes_;
+  static const int64 kMaxRetiredRows = 64 * 1024;
+  mutex retired_rows_mu_;
+  std::deque<void*> retired_rows_;
+  mutex retired_value_ptrs_mu_;
+  std::vector<ValuePtr<V>*> retired_value_ptrs_;
+  std::unique_ptr<embedding::MmapKV<K, V>> mmap_kv_;
+  // The keys checked for expiry by the shrink of a lookup, 0 shrinks all
+  // the keys before the saves instead.
+  int64 incremental_shrink_keys_ = 0;
+  std::atomic<int64> latest_global_step_{0};
+  // Records the looked up ids if TF_EV_ID_TRACE_DIR is set.
+  std::unique_ptr<embedding::IdTraceRecorder> id_trace_recorder_;
+  // The hottest rows of serving EmbeddingVars, if TF_SERVING_ROW_CACHE_MB
+  // is set.
+  std::unique_ptr<embedding::ServingRowCache<K, V>> serving_row_cache_;
+  embedding::EmbeddingVarStats stats_;
+  // The tail table, see InitTailFolding. Its rows are written by the
+  // restores only, before the lookups.
+  int64 tail_fold_min_freq_ = 0;
+  mutex tail_mu_;
+  std::vector<V> tail_rows_;
+  std::vector<int64> tail_counts_;
+  int64 num_kept_keys_ = 0;
+  int64 num_tail_keys_ = 0;
 
   TF_DISALLOW_COPY_AND_ASSIGN(EmbeddingVar);
 };
@@ -15,6 +15,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EMBEDDING_VAR_CONTEXT_H_
 #define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EMBEDDING_VAR_CONTEXT_H_
 
+#include "tensorflow/core/framework/embedding/epoch_reclaimer.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 
@@ -38,6 +39,9 @@ struct EmbeddingVarContext<CPUDevice> {
       : worker_threads(op_ctx->device()->tensorflow_cpu_worker_threads()) {}
 
   const DeviceBase::CpuWorkerThreads* worker_threads;
+  // Keeps the ValuePtrs the lookup reads from being reclaimed by a
+  // concurrent eviction.
+  embedding::EpochGuard epoch_guard;
 };
 
 #if GOOGLE_CUDA
@@ -56,6 +60,7 @@ struct EmbeddingVarContext<GPUDevice> {
   EventMgr* event_mgr = nullptr;
   Allocator* gpu_allocator= nullptr;
   const GPUDevice& gpu_device;
+  embedding::EpochGuard epoch_guard;
 };
 #endif  // GOOGLE_CUDA
 } //namespace tensorflow
@@ -0,0 +1,115 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EMBEDDING_VAR_STATS_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EMBEDDING_VAR_STATS_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// Counters of the lookups of an EmbeddingVar, read by the EVGetStats op.
+// They are updated with relaxed atomics once per lookup call, or once per
+// created row, so that they can stay enabled in production.
+class EmbeddingVarStats {
+ public:
+  // Times a lookup call of num_of_keys keys.
+  class LookupTimer {
+   public:
+    LookupTimer(EmbeddingVarStats* stats, int64 num_of_keys)
+        : stats_(stats),
+          num_of_keys_(num_of_keys),
+          start_(Env::Default()->NowMicros()) {}
+
+    ~LookupTimer() {
+      stats_->RecordLookup(num_of_keys_,
+                           Env::Default()->NowMicros() - start_);
+    }
+
+   private:
+    EmbeddingVarStats* stats_;
+    int64 num_of_keys_;
+    uint64 start_;
+  };
+
+  void RecordLookup(int64 num_of_keys, int64 micros) {
+    lookups_.fetch_add(num_of_keys, std::memory_order_relaxed);
+    lookup_calls_.fetch_add(1, std::memory_order_relaxed);
+    lookup_micros_.fetch_add(micros, std::memory_order_relaxed);
+  }
+
+  void RecordCreation() {
+    creations_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void RecordRejections(int64 num_of_keys) {
+    if (num_of_keys > 0) {
+      rejections_.fetch_add(num_of_keys, std::memory_order_relaxed);
+    }
+  }
+
+  void RecordRowCacheHits(int64 num_of_keys) {
+    row_cache_hits_.fetch_add(num_of_keys, std::memory_order_relaxed);
+  }
+
+  // Appends the counters and their ratios to names and values.
+  void Append(std::vector<std::string>* names,
+              std::vector<double>* values) const {
+    const int64 lookups = lookups_.load(std::memory_order_relaxed);
+    const int64 calls = lookup_calls_.load(std::memory_order_relaxed);
+    const int64 micros = lookup_micros_.load(std::memory_order_relaxed);
+    const int64 creations = creations_.load(std::memory_order_relaxed);
+    const int64 rejections = rejections_.load(std::memory_order_relaxed);
+    const int64 row_cache_hits =
+        row_cache_hits_.load(std::memory_order_relaxed);
+    auto ratio = [](int64 a, int64 b) {
+      return b == 0 ? 0.0 : static_cast<double>(a) / b;
+    };
+    auto append = [names, values](const std::string& name, double value) {
+      names->emplace_back(name);
+      values->emplace_back(value);
+    };
+    append("lookups", lookups);
+    append("lookup_calls", calls);
+    append("lookup_micros", micros);
+    append("lookup_usecs_per_call", ratio(micros, calls));
+    append("creations", creations);
+    append("creation_ratio", ratio(creations, lookups));
+    append("filter_rejections", rejections);
+    append("filter_rejection_ratio", ratio(rejections, lookups));
+    append("row_cache_hits", row_cache_hits);
+    append("row_cache_hit_ratio", ratio(row_cache_hits, lookups));
+  }
+
+ private:
+  std::atomic<int64> lookups_{0};
+  std::atomic<int64> lookup_calls_{0};
+  std::atomic<int64> lookup_micros_{0};
+  std::atomic<int64> creations_{0};
+  std::atomic<int64> rejections_{0};
+  // The lookups served by the serving row cache.
+  std::atomic<int64> row_cache_hits_{0};
+};
+
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EMBEDDING_VAR_STATS_H_
@@ -0,0 +1,124 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+=======================================================================*/
+
+#include "tensorflow/core/framework/embedding/epoch_reclaimer.h"
+
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace embedding {
+
+constexpr int EpochReclaimer::kNumSlots;
+constexpr int EpochReclaimer::kNumEpochs;
+constexpr int64 EpochReclaimer::kRetiresPerAdvance;
+constexpr int64 EpochReclaimer::kMaxPending;
+constexpr uint64 EpochReclaimer::kActive;
+
+EpochReclaimer* EpochReclaimer::Global() {
+  static EpochReclaimer* reclaimer = new EpochReclaimer();
+  return reclaimer;
+}
+
+EpochReclaimer::EpochReclaimer() {}
+
+EpochReclaimer::~EpochReclaimer() {
+  mutex_lock l(mu_);
+  for (auto& deleters : limbo_) {
+    for (auto& deleter : deleters) {
+      deleter();
+    }
+  }
+}
+
+int EpochReclaimer::Enter() {
+  const uint64 state = (epoch_.load() << 1) | kActive;
+  const uint64 start =
+      static_cast<uint32>(Env::Default()->GetCurrentThreadId());
+  for (int i = 0; i < kNumSlots; ++i) {
+    const int slot = (start + i) % kNumSlots;
+    uint64 expected = 0;
+    if (slots_[slot].state.compare_exchange_strong(expected, state)) {
+      return slot;
+    }
+  }
+  num_unslotted_.fetch_add(1);
+  return -1;
+}
+
+void EpochReclaimer::Exit(int slot) {
+  if (slot < 0) {
+    num_unslotted_.fetch_sub(1);
+  } else {
+    slots_[slot].state.store(0);
+  }
+}
+
+bool EpochReclaimer::CanAdvance(uint64 epoch) {
+  if (num_unslotted_.load() > 0) {
+    return false;
+  }
+  for (auto& slot : slots_) {
+    const uint64 state = slot.state.load();
+    if ((state & kActive) && (state >> 1) != epoch) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void EpochReclaimer::Retire(std::function<void()> deleter) {
+  bool advance = false;
+  {
+    mutex_lock l(mu_);
+    limbo_[epoch_.load() % kNumEpochs].emplace_back(std::move(deleter));
+    ++num_pending_;
+    if (++retires_since_advance_ >= kRetiresPerAdvance ||
+        num_pending_ > kMaxPending) {
+      retires_since_advance_ = 0;
+      advance = true;
+    }
+  }
+  if (advance) {
+    TryReclaim();
+  }
+}
+
+void EpochReclaimer::TryReclaim() {
+  std::vector<std::function<void()>> reclaimed;
+  {
+    mutex_lock l(mu_);
+    const uint64 epoch = epoch_.load();
+    if (!CanAdvance(epoch)) {
+      return;
+    }
+    // Every active guard entered in 'epoch', after the ValuePtrs retired in
+    // 'epoch - 1' were removed, so their deleters are safe to run. Their
+    // bucket is the one 'epoch + 2' will reuse.
+    epoch_.store(epoch + 1);
+    reclaimed.swap(limbo_[(epoch + 2) % kNumEpochs]);
+    num_pending_ -= reclaimed.size();
+  }
+  for (auto& deleter : reclaimed) {
+    deleter();
+  }
+}
+
+int64 EpochReclaimer::NumPending() {
+  mutex_lock l(mu_);
+  return num_pending_;
+}
+
+}  // namespace embedding
+}  // namespace tensorflow
@@ -0,0 +1,112 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+=======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EPOCH_RECLAIMER_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EPOCH_RECLAIMER_H_
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// Epoch based reclamation of the ValuePtrs removed from the storages of
+// EmbeddingVars, which concurrent lookups may still hold.
+//
+// The code that reads ValuePtrs runs inside an EpochGuard. A ValuePtr
+// removed from its storage is Retire()d with its deleter, which runs once
+// every guard that was active at the time of the removal has exited. The
+// global epoch advances when all active guards have entered in it, and the
+// deleters retired two epochs ago run then, so the garbage stays bounded as
+// long as the lookups finish.
+class EpochReclaimer {
+ public:
+  // The reclaimer shared by all storages.
+  static EpochReclaimer* Global();
+
+  EpochReclaimer();
+  ~EpochReclaimer();
+
+  // Runs 'deleter' once no guard entered before this call is active.
+  void Retire(std::function<void()> deleter);
+
+  // Advances the epoch if possible and runs the deleters it makes safe.
+  void TryReclaim();
+
+  // The number of retired deleters which have not run yet.
+  int64 NumPending();
+
+ private:
+  friend class EpochGuard;
+
+  static constexpr int kNumSlots = 256;
+  static constexpr int kNumEpochs = 3;
+  // Retire tries to advance the epoch every kRetiresPerAdvance deleters,
+  // and on each of them while more than kMaxPending have not run.
+  static constexpr int64 kRetiresPerAdvance = 1024;
+  static constexpr int64 kMaxPending = 64 * 1024;
+  static constexpr uint64 kActive = 1;
+
+  struct alignas(64) Slot {
+    // 0 while free, otherwise the epoch the guard holding the slot entered
+    // in, shifted left by one, ORed with kActive.
+    std::atomic<uint64> state{0};
+  };
+
+  // Marks the calling thread as active in the current epoch, returns the
+  // slot it took or -1 if all slots are taken.
+  int Enter();
+  void Exit(int slot);
+
+  // Whether every active guard entered in 'epoch'.
+  bool CanAdvance(uint64 epoch);
+
+  std::atomic<uint64> epoch_{0};
+  Slot slots_[kNumSlots];
+  // The number of guards without a slot, which hold the epoch back.
+  std::atomic<int64> num_unslotted_{0};
+
+  mutex mu_;
+  std::vector<std::function<void()>> limbo_[kNumEpochs] GUARDED_BY(mu_);
+  int64 num_pending_ GUARDED_BY(mu_) = 0;
+  int64 retires_since_advance_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(EpochReclaimer);
+};
+
+// Keeps the ValuePtrs read while it lives, by any thread, from being
+// reclaimed. Guards may nest.
+class EpochGuard {
+ public:
+  explicit EpochGuard(EpochReclaimer* reclaimer = EpochReclaimer::Global())
+      : reclaimer_(reclaimer), slot_(reclaimer->Enter()) {}
+  ~EpochGuard() { reclaimer_->Exit(slot_); }
+
+ private:
+  EpochReclaimer* reclaimer_;
+  int slot_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(EpochGuard);
+};
+
+}  // namespace embedding
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EPOCH_RECLAIMER_H_
@@ -16,8 +16,18 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EVICTION_MANAGER_H_
 #define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EVICTION_MANAGER_H_
 
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+
+#include "tensorflow/core/framework/embedding/cpu_plan.h"
+#include "tensorflow/core/framework/embedding/lock_contention.h"
 #include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/sampler.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace tensorflow {
 
@@ -25,16 +35,41 @@ namespace embedding {
 template<typename K, typename V>
 class MultiTierStorage;
 
+inline monitoring::Counter<1>* EvictedBytesCounter() {
+  static auto* counter = monitoring::Counter<1>::New(
+      "/tensorflow/core/embedding/eviction/evicted_bytes",
+      "Bytes evicted from the first tier of a multi-tier EmbeddingVariable.",
+      "storage");
+  return counter;
+}
+
+inline monitoring::Sampler<1>* EvictionLagSampler() {
+  static auto* sampler = monitoring::Sampler<1>::New(
+      {"/tensorflow/core/embedding/eviction/lag_usecs",
+       "Microseconds from a multi-tier EmbeddingVariable being queued for "
+       "eviction to the start of its eviction.",
+       "storage"},
+      monitoring::Buckets::Exponential(10, 2, 24));
+  return sampler;
+}
+
 template<typename K, typename V>
 struct StorageItem {
-  volatile bool is_occupied;
-  volatile bool is_deleted;
-
-  StorageItem(bool is_occupied,
-              volatile bool is_deleted) : is_occupied(is_occupied),
-                                          is_deleted(is_deleted) {}
+  // Queued for an eviction thread.
+  bool is_pending = false;
+  // Evicted by an eviction thread.
+  bool is_running = false;
+  bool is_deleted = false;
+  // When the storage was queued, for the eviction lag.
+  uint64 pending_micros = 0;
 };
 
+// Evicts the first tier of the multi-tier storages down to its capacity.
+// A storage signals the manager once its first tier passes the capacity,
+// and an eviction thread evicts it in batches until it is below the
+// capacity or TF_MULTI_TIER_EV_EVICTION_BUDGET_US is spent, then requeues
+// it behind the other signaled storages. The idle threads wait for a signal,
+// and check every storage once a second for the ones which missed theirs.
 template<typename K, typename V>
 class EvictionManager {
  public:
@@ -42,12 +77,17 @@ class EvictionManager {
     num_of_threads_ = 1;
     TF_CHECK_OK(ReadInt64FromEnvVar("TF_MULTI_TIER_EV_EVICTION_THREADS", 1,
           &num_of_threads_));
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_MULTI_TIER_EV_EVICTION_BUDGET_US",
+          1000, &budget_us_));
     thread_pool_.reset(
         new thread::ThreadPool(Env::Default(), ThreadOptions(),
           "EVICTION_MANAGER", 3, /*low_latency_hint=*/false));
   }
-  
+
   ~EvictionManager() {
+    mutex_lock l(mu_);
+    shutdown_ = true;
+    cv_.notify_all();
   }
 
   TF_DISALLOW_COPY_AND_ASSIGN(EvictionManager);
@@ -57,76 +97,133 @@ class EvictionManager {
   }
 
   void AddStorage(MultiTierStorage<K,V>* storage) {
-    mutex_lock l(mu_);
-    auto ret = storage_table_.emplace(std::make_pair(storage,
-                           new StorageItem<K, V>(false, false)));
-    if (ret.second && num_of_active_threads_ < num_of_threads_)
-      StartThread();
+    profiled_mutex_lock l(mu_, LOCK_CONTENTION_SITE("eviction_manager"));
+    auto ret = storage_table_.emplace(
+        storage, std::unique_ptr<StorageItem<K, V>>(new StorageItem<K, V>()));
+    if (ret.second && num_of_active_threads_ < num_of_threads_) {
+      ++num_of_active_threads_;
+      thread_pool_->Schedule([this]() {
+        EvictionLoop();
+      });
+    }
   }
 
+  // Waits for the running eviction of the storage, if any. No eviction of
+  // the storage starts after it returns.
   void DeleteStorage(MultiTierStorage<K,V>* storage) {
-    auto storage_item = storage_table_[storage];
-    bool delete_flag = false;
-    while (!delete_flag) {
-      volatile bool* occupy_flag = &storage_item->is_occupied;
-      delete_flag = __sync_bool_compare_and_swap(occupy_flag, false, true);
-      if (delete_flag) {
-        storage_item->is_deleted = true;
-      }
-      *occupy_flag = false;
+    mutex_lock l(mu_);
+    auto it = storage_table_.find(storage);
+    if (it == storage_table_.end()) {
+      return;
     }
+    it->second->is_deleted = true;
+    while (it->second->is_running) {
+      done_cv_.wait(l);
+    }
+    storage_table_.erase(it);
   }
 
- private:
-  void StartThread() {
-    while(this->flag_.test_and_set(std::memory_order_acquire));
-    if (num_of_active_threads_ < num_of_threads_) {
-      __sync_fetch_and_add(&num_of_active_threads_, 1);
-      thread_pool_->Schedule([this]() {
-        EvictionLoop();
-      });
+  // Queues the storage for eviction, called once its first tier passes
+  // the capacity.
+  void Signal(MultiTierStorage<K,V>* storage) {
+    profiled_mutex_lock l(mu_, LOCK_CONTENTION_SITE("eviction_manager"));
+    auto it = storage_table_.find(storage);
+    if (it != storage_table_.end() && Enqueue(storage, it->second.get())) {
+      cv_.notify_one();
     }
-    this->flag_.clear(std::memory_order_release);
   }
 
-  bool CheckStorages() {
-    mutex_lock l(mu_);
-    for (auto it = storage_table_.begin(); it != storage_table_.end();) {
-      if (!(it->second)->is_deleted) 
-        return true;
-      else 
-        it = storage_table_.erase(it);
+ private:
+  bool Enqueue(MultiTierStorage<K,V>* storage, StorageItem<K, V>* item)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (item->is_deleted || item->is_pending || item->is_running) {
+      return false;
     }
-    return false;
+    item->is_pending = true;
+    item->pending_micros = Env::Default()->NowMicros();
+    pending_.push_back(storage);
+    return true;
   }
 
-  void EvictionLoop() {
-    while (CheckStorages()) {
-      mutex_lock l(mu_);
-      for (auto it : storage_table_) {
-        auto storage = it.first;
-        auto storage_item = it.second;
-        volatile bool* occupy_flag = &storage_item->is_occupied;
-        if (__sync_bool_compare_and_swap(occupy_flag, false, true)) {
-          if (storage_item->is_deleted) {
-            *occupy_flag = false;
-            continue; 
+  // Returns the next storage to evict, nullptr once the thread should exit.
+  MultiTierStorage<K,V>* Next() {
+    mutex_lock l(mu_);
+    while (!shutdown_ && !storage_table_.empty()) {
+      while (!pending_.empty()) {
+        auto storage = pending_.front();
+        pending_.pop_front();
+        auto it = storage_table_.find(storage);
+        if (it == storage_table_.end() || !it->second->is_pending) {
+          continue;
+        }
+        auto item = it->second.get();
+        item->is_pending = false;
+        if (item->is_deleted) {
+          continue;
+        }
+        item->is_running = true;
+        EvictionLagSampler()->GetCell(storage->GetName())->Add(
+            Env::Default()->NowMicros() - item->pending_micros);
+        return storage;
+      }
+      if (cv_.wait_for(l, std::chrono::seconds(1)) ==
+          std::cv_status::timeout) {
+        for (auto& it : storage_table_) {
+          if (it.first->NeedsEviction()) {
+            Enqueue(it.first, it.second.get());
           }
-          storage->BatchEviction();
-          *occupy_flag = false;
         }
-        Env::Default()->SleepForMicroseconds(1);
       }
     }
-    __sync_fetch_and_sub(&num_of_active_threads_, 1);
+    --num_of_active_threads_;
+    return nullptr;
+  }
+
+  void Evict(MultiTierStorage<K,V>* storage) {
+    const uint64 start = Env::Default()->NowMicros();
+    int64 evicted_bytes = 0;
+    while (storage->NeedsEviction() &&
+           Env::Default()->NowMicros() - start < budget_us_) {
+      const int64 bytes = storage->BatchEviction();
+      if (bytes == 0) {
+        break;
+      }
+      evicted_bytes += bytes;
+    }
+    EvictedBytesCounter()->GetCell(storage->GetName())->IncrementBy(
+        evicted_bytes);
+    storage->RecordEvictedBytes(evicted_bytes);
+
+    profiled_mutex_lock l(mu_, LOCK_CONTENTION_SITE("eviction_manager"));
+    auto item = storage_table_[storage].get();
+    item->is_running = false;
+    // A storage which evicts nothing waits for its next signal instead.
+    if (evicted_bytes > 0 && storage->NeedsEviction()) {
+      Enqueue(storage, item);
+    }
+    done_cv_.notify_all();
+  }
+
+  void EvictionLoop() {
+    PinBackgroundThread();
+    while (auto storage = Next()) {
+      Evict(storage);
+    }
   }
 
   int64 num_of_threads_;
-  int64 num_of_active_threads_;
-  std::atomic_flag flag_ = ATOMIC_FLAG_INIT;
-  std::unique_ptr<thread::ThreadPool> thread_pool_;
-  std::map<MultiTierStorage<K,V>*, StorageItem<K, V>*> storage_table_;
+  int64 budget_us_;
   mutex mu_;
+  condition_variable cv_;
+  condition_variable done_cv_;
+  int64 num_of_active_threads_ GUARDED_BY(mu_) = 0;
+  bool shutdown_ GUARDED_BY(mu_) = false;
+  std::map<MultiTierStorage<K,V>*, std::unique_ptr<StorageItem<K, V>>>
+      storage_table_ GUARDED_BY(mu_);
+  std::deque<MultiTierStorage<K,V>*> pending_ GUARDED_BY(mu_);
+  // Declared last to join the eviction threads before the members they use
+  // are destroyed.
+  std::unique_ptr<thread::ThreadPool> thread_pool_;
 };
 
 class EvictionManagerCreator {
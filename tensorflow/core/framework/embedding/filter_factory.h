@@ -21,6 +21,7 @@ limitations under the License.
 #include "tensorflow/core/framework/embedding/embedding_config.h"
 #include "tensorflow/core/framework/embedding/filter_policy.h"
 #include "tensorflow/core/framework/embedding/nullable_filter_policy.h"
+#include "tensorflow/core/util/env_var.h"
 
 
 namespace tensorflow {
@@ -36,9 +37,17 @@ class FilterFactory {
       const EmbeddingConfig& config, EV* ev,
       embedding::Storage<K, V>* storage) {
     if (config.filter_freq > 0) {
-      if (config.kHashFunc != 0) {
+      bool blocked = BlockedBloomFilterEnabled();
+      if (blocked && config.filter_freq >
+          embedding::BlockedCountingBloomFilter<K>::kMaxCount) {
+        LOG(WARNING) << "filter_freq " << config.filter_freq
+                     << " exceeds the uint8 counters of the blocked bloom"
+                     << " filter, which is disabled.";
+        blocked = false;
+      }
+      if (config.kHashFunc != 0 || blocked) {
         return new BloomFilterPolicy<K, V, EV>(
-            config, ev);
+            config, ev, blocked);
       } else {
         return new CounterFilterPolicy<K, V, EV>(
             config, ev);
@@ -48,6 +57,21 @@ class FilterFactory {
           config, ev, storage);
     }
   }
+
+ private:
+  // With TF_EV_BLOCKED_BLOOM_FILTER, the frequencies of the keys not yet
+  // admitted are counted in a BlockedCountingBloomFilter, instead of the
+  // bloom filter of kHashFunc scattered counters, or a ValuePtr per key
+  // for the counter filter.
+  static bool BlockedBloomFilterEnabled() {
+    static bool blocked = [] {
+      bool blocked = false;
+      TF_CHECK_OK(ReadBoolFromEnvVar("TF_EV_BLOCKED_BLOOM_FILTER",
+          false, &blocked));
+      return blocked;
+    }();
+    return blocked;
+  }
 };
 
 } // tensorflow
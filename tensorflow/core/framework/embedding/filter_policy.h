@@ -44,6 +44,12 @@ class FilterPolicy {
   virtual Status Lookup(K key, V* val, const V* default_value_ptr,
     const V* default_value_no_permission) = 0;
 
+  // Same as Lookup, for a value_ptr which is already looked up from
+  // storage; value_ptr is nullptr if the key doesn't exist.
+  virtual void LookupWithValuePtr(K key, ValuePtr<V>* value_ptr, V* val,
+      const V* default_value_ptr,
+      const V* default_value_no_permission) = 0;
+
 #if GOOGLE_CUDA
   virtual void BatchLookup(const EmbeddingVarContext<GPUDevice>& context,
                            const K* keys, V* output,
@@ -0,0 +1,226 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_FLOAT_MATH_ROW_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_FLOAT_MATH_ROW_H_
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <cstring>
+
+#include "tensorflow/core/framework/embedding/row_quantization.h"
+#include "tensorflow/core/framework/numeric_types.h"
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace embedding {
+
+inline void BFloat16ToFloat(const bfloat16* in, int64 len, float* out) {
+  int64 i = 0;
+#if defined(__AVX512F__)
+  for (; i + 16 <= len; i += 16) {
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+    __m512i f = _mm512_slli_epi32(_mm512_cvtepu16_epi32(b), 16);
+    _mm512_storeu_ps(out + i, _mm512_castsi512_ps(f));
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  for (; i + 8 <= len; i += 8) {
+    uint16x8_t b = vld1q_u16(reinterpret_cast<const uint16_t*>(in + i));
+    uint32x4_t lo = vshll_n_u16(vget_low_u16(b), 16);
+    uint32x4_t hi = vshll_high_n_u16(b, 16);
+    vst1q_f32(out + i, vreinterpretq_f32_u32(lo));
+    vst1q_f32(out + i + 4, vreinterpretq_f32_u32(hi));
+  }
+#endif  // __AVX512F__, __aarch64__ && __ARM_NEON
+  for (; i < len; i++) {
+    out[i] = static_cast<float>(in[i]);
+  }
+}
+
+// Rounds to the nearest even like the bfloat16 constructor.
+inline void FloatToBFloat16(const float* in, int64 len, bfloat16* out) {
+  int64 i = 0;
+#if defined(__AVX512BF16__)
+  for (; i + 16 <= len; i += 16) {
+    __m256bh b = _mm512_cvtneps_pbh(_mm512_loadu_ps(in + i));
+    memcpy(out + i, &b, sizeof(b));
+  }
+#elif defined(__AVX512F__)
+  const __m512i one = _mm512_set1_epi32(1);
+  const __m512i bias = _mm512_set1_epi32(0x7fff);
+  const __m512i nan = _mm512_set1_epi32(0x7fc0);
+  for (; i + 16 <= len; i += 16) {
+    __m512 f = _mm512_loadu_ps(in + i);
+    __m512i u = _mm512_castps_si512(f);
+    __m512i lsb = _mm512_and_si512(_mm512_srli_epi32(u, 16), one);
+    __m512i r = _mm512_srli_epi32(
+        _mm512_add_epi32(u, _mm512_add_epi32(bias, lsb)), 16);
+    __mmask16 is_nan = _mm512_cmp_ps_mask(f, f, _CMP_UNORD_Q);
+    r = _mm512_mask_mov_epi32(r, is_nan, nan);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                        _mm512_cvtepi32_epi16(r));
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  const uint32x4_t one = vdupq_n_u32(1);
+  const uint32x4_t bias = vdupq_n_u32(0x7fff);
+  const uint32x4_t nan = vdupq_n_u32(0x7fc0);
+  for (; i + 4 <= len; i += 4) {
+    float32x4_t f = vld1q_f32(in + i);
+    uint32x4_t u = vreinterpretq_u32_f32(f);
+    uint32x4_t lsb = vandq_u32(vshrq_n_u32(u, 16), one);
+    uint32x4_t r = vshrq_n_u32(vaddq_u32(u, vaddq_u32(bias, lsb)), 16);
+    uint32x4_t is_num = vceqq_f32(f, f);
+    r = vbslq_u32(is_num, r, nan);
+    vst1_u16(reinterpret_cast<uint16_t*>(out + i), vmovn_u32(r));
+  }
+#endif  // __AVX512F__, __aarch64__ && __ARM_NEON
+  for (; i < len; i++) {
+    out[i] = static_cast<bfloat16>(in[i]);
+  }
+}
+
+// A row of an EmbeddingVar, or of a gradient, seen as a float row by the
+// optimizers: rows of float and double are used in place, while bfloat16
+// rows are converted to a float copy, written back by Commit(), so that the
+// updates don't round at every step.
+template <typename V>
+class FloatMathRow {
+ public:
+  typedef V MathType;
+
+  FloatMathRow(V* data, int64 dim) : data_(data), dim_(dim) {}
+
+  typename TTypes<V>::Flat flat() {
+    return typename TTypes<V>::Flat(data_, dim_);
+  }
+
+  void Commit() {}
+
+ private:
+  V* data_;
+  int64 dim_;
+};
+
+template <>
+class FloatMathRow<bfloat16> {
+ public:
+  typedef float MathType;
+
+  FloatMathRow(bfloat16* data, int64 dim)
+      : data_(data), dim_(dim), buffer_(dim) {
+    BFloat16ToFloat(data_, dim_, buffer_.data());
+  }
+
+  TTypes<float>::Flat flat() {
+    return TTypes<float>::Flat(buffer_.data(), dim_);
+  }
+
+  void Commit() {
+    FloatToBFloat16(buffer_.data(), dim_, data_);
+  }
+
+ private:
+  bfloat16* data_;
+  int64 dim_;
+  gtl::InlinedVector<float, 128> buffer_;
+};
+
+// The read only counterpart of FloatMathRow.
+template <typename V>
+class ConstFloatMathRow {
+ public:
+  ConstFloatMathRow(const V* data, int64 dim) : data_(data), dim_(dim) {}
+
+  typename TTypes<V>::ConstFlat flat() const {
+    return typename TTypes<V>::ConstFlat(data_, dim_);
+  }
+
+ private:
+  const V* data_;
+  int64 dim_;
+};
+
+template <>
+class ConstFloatMathRow<bfloat16> {
+ public:
+  ConstFloatMathRow(const bfloat16* data, int64 dim)
+      : dim_(dim), buffer_(dim) {
+    BFloat16ToFloat(data, dim_, buffer_.data());
+  }
+
+  TTypes<float>::ConstFlat flat() const {
+    return TTypes<float>::ConstFlat(buffer_.data(), dim_);
+  }
+
+ private:
+  int64 dim_;
+  gtl::InlinedVector<float, 128> buffer_;
+};
+
+// The 8-bit optimizer states are DYNAMIC_INT8 rows of blocks of
+// kStateBlockSize values, stored in the rows of V of their EmbeddingVars.
+constexpr int64 kStateBlockSize = 256;
+
+// The number of V of the 8-bit state of a row of dim values.
+template <typename V>
+int64 Int8StateLen(int64 dim) {
+  return (QuantizedRowBytes(RowQuantization::DYNAMIC_INT8, dim,
+                            kStateBlockSize) + sizeof(V) - 1) / sizeof(V);
+}
+
+// A row of an optimizer state of an EmbeddingVar, e.g. a moment of Adam:
+// full-precision rows are used in place, while 8-bit rows are dequantized
+// to a copy, quantized back by Commit().
+template <typename V>
+class OptimizerStateRow {
+ public:
+  OptimizerStateRow(V* data, int64 dim, bool is_int8)
+      : data_(data), dim_(dim), is_int8_(is_int8) {
+    if (is_int8_) {
+      buffer_.resize(dim_);
+      DequantizeRow(RowQuantization::DYNAMIC_INT8,
+                    reinterpret_cast<const char*>(data_), dim_,
+                    kStateBlockSize, buffer_.data());
+    }
+  }
+
+  typename TTypes<V>::Flat flat() {
+    return typename TTypes<V>::Flat(is_int8_ ? buffer_.data() : data_, dim_);
+  }
+
+  void Commit() {
+    if (is_int8_) {
+      QuantizeRow(RowQuantization::DYNAMIC_INT8, buffer_.data(), dim_,
+                  kStateBlockSize, reinterpret_cast<char*>(data_));
+    }
+  }
+
+ private:
+  V* data_;
+  int64 dim_;
+  bool is_int8_;
+  gtl::InlinedVector<V, 128> buffer_;
+};
+
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_FLOAT_MATH_ROW_H_
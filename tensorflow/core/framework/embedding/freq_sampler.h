@@ -0,0 +1,66 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_FREQ_SAMPLER_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_FREQ_SAMPLER_H_
+
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// Samples the increments of the frequencies of the keys, so that the
+// lookups of the hottest keys rarely write the headers of their entries,
+// whose cache lines otherwise bounce between the cores.
+//
+// A frequency f is incremented by a step s = error_percent^2 * f / 10^4
+// with a probability of count / s, so the counts stay unbiased. The
+// relative standard error of a count is then at most error_percent / 100,
+// and the counts below (100 / error_percent)^2 are exact, e.g. below 100
+// for an error of 10%. An error_percent of 0 counts every increment.
+class FreqSampler {
+ public:
+  explicit FreqSampler(int64 error_percent)
+      : scale_(static_cast<double>(error_percent) * error_percent / 1e4) {}
+
+  bool enabled() const { return scale_ > 0; }
+
+  // The increment of the frequency freq by count, 0 when it is skipped.
+  int64 Sample(int64 freq, int64 count) const {
+    const int64 step = static_cast<int64>(scale_ * freq);
+    if (step <= count) {
+      return count;
+    }
+    return static_cast<int64>(NextRandom() % step) < count ? step : 0;
+  }
+
+ private:
+  // A xorshift generator per thread, the lookups do not share its state.
+  static uint64 NextRandom() {
+    static thread_local uint64 state = random::New64() | 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+
+  const double scale_;
+};
+
+}  // namespace embedding
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_FREQ_SAMPLER_H_
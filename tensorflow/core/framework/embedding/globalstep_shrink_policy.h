@@ -44,6 +44,15 @@ class GlobalStepShrinkPolicy : public ShrinkPolicy<K, V> {
         key_list, value_list);
   }
 
+  void IncrementalShrink(const ShrinkArgs& shrink_args,
+                         int64 max_keys) override {
+    std::vector<K> key_list;
+    std::vector<ValuePtr<V>*> value_list;
+    ShrinkPolicy<K, V>::NextKeys(kv_, max_keys, &key_list, &value_list);
+    FilterToDelete(shrink_args.global_step,
+        key_list, value_list);
+  }
+
  private:
   void FilterToDelete(int64 global_step,
                       const std::vector<K>& key_list,
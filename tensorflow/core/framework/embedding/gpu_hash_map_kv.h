@@ -17,6 +17,8 @@ limitations under the License.
 
 #if GOOGLE_CUDA
 
+#include <algorithm>
+
 #include "tensorflow/core/framework/embedding/gpu_hash_table.h"
 #include "tensorflow/core/framework/embedding/kv_interface.h"
 #include "tensorflow/core/util/env_var.h"
@@ -25,6 +27,11 @@ namespace tensorflow {
 
 namespace embedding {
 
+// With TF_EV_GPU_OPEN_ADDRESSING the keys are indexed by GPUOpenIndex,
+// which erases and rehashes them in place. Its keys are evicted on
+// device when the EV is shrunk: the ones not updated in steps_to_live
+// steps and, with TF_EV_GPU_EVICT_MIN_FREQ = N > 0, the ones looked up
+// less than N times since the previous eviction.
 template <typename K, typename V>
 class GPUHashMapKV : public KVInterface<K, V> {
  public:
@@ -32,7 +39,12 @@ class GPUHashMapKV : public KVInterface<K, V> {
       : config_(config), alloc_(alloc), static_hash_table_(nullptr) {
     TF_CHECK_OK(ReadBoolFromEnvVar(kInferenceMode, false, &is_inference_));
     if (!is_inference_) {
-      hash_table_ = new GPUHashTable<K, V>(-1, alloc);
+      bool open_addressing = false;
+      TF_CHECK_OK(ReadBoolFromEnvVar("TF_EV_GPU_OPEN_ADDRESSING", false,
+                                     &open_addressing));
+      TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_GPU_EVICT_MIN_FREQ", 0,
+                                      &evict_min_freq_));
+      hash_table_ = new GPUHashTable<K, V>(-1, alloc, 50000, open_addressing);
     }
   }
 
@@ -66,9 +78,16 @@ class GPUHashMapKV : public KVInterface<K, V> {
   void SetValueLen(int64 value_len) { value_len_ = value_len; }
 
   Status BatchLookupOrCreateKeys(const K* keys, size_t n, int32* item_idxs,
-                                 const Eigen::GpuDevice& device) {
+                                 const Eigen::GpuDevice& device,
+                                 int64 update_version) override {
     if (n > 0) {
       mutex_lock lock(lock_);
+      if (hash_table_->open_index != nullptr) {
+        // The keys created without a version take the latest one, so that
+        // they are not evicted right away.
+        latest_version_ = std::max(latest_version_, update_version);
+        hash_table_->open_index->version = latest_version_;
+      }
       int remaining_size =
           n + *(hash_table_->start_idx) -
           hash_table_->mem_bank_num * hash_table_->initial_bank_size;
@@ -88,7 +107,7 @@ class GPUHashMapKV : public KVInterface<K, V> {
     if (n > 0) {
       int32* item_idxs =
           TypedAllocator::Allocate<int32>(alloc_, n, AllocationAttributes());
-      BatchLookupOrCreateKeys(keys, n, item_idxs, device);
+      BatchLookupOrCreateKeys(keys, n, item_idxs, device, -1);
       functor::KvLookupCreateEmb<Eigen::GpuDevice, K, V>()(
           keys, val, default_v, value_len_, item_idxs, n, config_.emb_index,
           default_v_num, hash_table_->d_bank_ptrs,
@@ -180,7 +199,7 @@ class GPUHashMapKV : public KVInterface<K, V> {
         cudaMemcpyAsync(key_gpu, key_import.data(),
                         key_import.size() * sizeof(K), cudaMemcpyHostToDevice,
                         stream);
-        BatchLookupOrCreateKeys(key_gpu, n, item_idxs, *device);
+        BatchLookupOrCreateKeys(key_gpu, n, item_idxs, *device, -1);
         V* value_gpu = TypedAllocator::Allocate<V>(alloc_, value_import.size(),
                                                    AllocationAttributes());
         cudaMemcpyAsync(value_gpu, value_import.data(),
@@ -218,7 +237,7 @@ class GPUHashMapKV : public KVInterface<K, V> {
     return Status::OK();
   }
 
-  Status Remove(K key) override { return Status::OK(); }
+  Status Remove(K key) override { return BatchRemove(&key, 1); }
 
   Status BatchLookup(const K* keys, size_t size,
                      ValuePtr<V>** value_ptrs) override {
@@ -231,9 +250,43 @@ class GPUHashMapKV : public KVInterface<K, V> {
   }
 
   Status BatchRemove(const K* keys, size_t size) override {
+    if (!IsOpenAddressing() || hash_table_->mem_bank_num == 0 || size == 0) {
+      return Status::OK();
+    }
+    mutex_lock lock(lock_);
+    K* keys_gpu =
+        TypedAllocator::Allocate<K>(alloc_, size, AllocationAttributes());
+    cudaMemcpy(keys_gpu, keys, size * sizeof(K), cudaMemcpyHostToDevice);
+    hash_table_->open_index->Erase(
+        keys_gpu, size, hash_table_->d_existence_flag_ptrs,
+        config_.block_num * (1 + config_.slot_num),
+        hash_table_->initial_bank_size, NULL);
+    TypedAllocator::Deallocate(alloc_, keys_gpu, size);
     return Status::OK();
   }
 
+  bool IsOpenAddressing() const {
+    return !is_inference_ && hash_table_->open_index != nullptr;
+  }
+
+  // Returns the number of evicted keys.
+  int64 Evict(int64 global_step) {
+    if (!IsOpenAddressing() || hash_table_->mem_bank_num == 0) return 0;
+    int64 min_version = 0;
+    if (config_.steps_to_live > 0) {
+      min_version = global_step - config_.steps_to_live;
+    }
+    if (min_version <= 0 && evict_min_freq_ <= 0) return 0;
+    mutex_lock lock(lock_);
+    int64 num_evicted = hash_table_->open_index->Evict(
+        min_version, evict_min_freq_, hash_table_->d_existence_flag_ptrs,
+        config_.block_num * (1 + config_.slot_num),
+        hash_table_->initial_bank_size, NULL);
+    VLOG(1) << "Evict " << num_evicted << " keys of EmbeddingVar "
+            << config_.name << " from the GPU open addressing index.";
+    return num_evicted;
+  }
+
   Status BatchCommit(const std::vector<K>& keys,
                      const std::vector<ValuePtr<V>*>& value_ptrs) override {
     return Status::OK();
@@ -296,6 +349,10 @@ class GPUHashMapKV : public KVInterface<K, V> {
       hint -= hash_table_->initial_bank_size;
       ++hash_table_->mem_bank_num;
     }
+    if (hash_table_->open_index != nullptr) {
+      hash_table_->open_index->ReserveFreeIdxs(
+          hash_table_->mem_bank_num * hash_table_->initial_bank_size, NULL);
+    }
 
     auto num_elements = hash_table_->mem_bank_num *
                         (config_.block_num * (1 + config_.slot_num));
@@ -331,6 +388,8 @@ class GPUHashMapKV : public KVInterface<K, V> {
   GPUHashTable<K, V>* hash_table_;
   Allocator* alloc_;
   int64 value_len_;
+  int64 evict_min_freq_ = 0;
+  int64 latest_version_ = 0;
   mutex lock_;
 };
 
@@ -106,13 +106,383 @@ class DynamicHashTable {
   ~DynamicHashTable() {}
 };
 
+namespace {
+constexpr int64 kOpenEmptyKey = -1;
+constexpr int64 kOpenTombstoneKey = -2;
+constexpr float kOpenMaxLoadFactor = 0.7;
+constexpr size_t kOpenMinMigrateSlots = 4096;
+constexpr int kOpenBlockSize = 256;
+
+template <typename T>
+__device__ __forceinline__ T open_load(const T* addr) {
+  return *reinterpret_cast<const volatile T*>(addr);
+}
+
+__device__ __forceinline__ int32 open_key_cas(int32* addr, int32 compare,
+                                              int32 val) {
+  return atomicCAS(addr, compare, val);
+}
+
+__device__ __forceinline__ int64 open_key_cas(int64* addr, int64 compare,
+                                              int64 val) {
+  return static_cast<int64>(atomicCAS(
+      reinterpret_cast<unsigned long long*>(addr),
+      static_cast<unsigned long long>(compare),
+      static_cast<unsigned long long>(val)));
+}
+
+template <typename Key>
+__device__ __forceinline__ size_t open_home_slot(Key key, size_t capacity) {
+  return cuco::detail::MurmurHash3_32<Key>{}(key) % capacity;
+}
+
+template <typename Key>
+__device__ __forceinline__ bool open_is_live(Key key) {
+  return key != kOpenEmptyKey && key != kOpenTombstoneKey;
+}
+
+// Returns the slot of key in t, or -1.
+template <typename Key>
+__device__ int64 open_find(const typename GPUOpenIndex<Key>::Table& t,
+                           Key key) {
+  if (t.capacity == 0) return -1;
+  size_t pos = open_home_slot(key, t.capacity);
+  for (size_t i = 0; i < t.capacity; ++i) {
+    Key k = open_load(t.keys + pos);
+    if (k == key) return pos;
+    if (k == kOpenEmptyKey) return -1;
+    pos = (pos + 1 == t.capacity) ? 0 : pos + 1;
+  }
+  return -1;
+}
+
+// Claims an empty slot of t for key, or returns the slot inserted by
+// another thread. *inserted tells whether this thread claimed it.
+template <typename Key>
+__device__ int64 open_claim(const typename GPUOpenIndex<Key>::Table& t,
+                            Key key, bool* inserted) {
+  size_t pos = open_home_slot(key, t.capacity);
+  *inserted = false;
+  while (true) {
+    Key k = open_load(t.keys + pos);
+    if (k == key) return pos;
+    if (k == kOpenEmptyKey) {
+      Key prev = open_key_cas(t.keys + pos, static_cast<Key>(kOpenEmptyKey),
+                              key);
+      if (prev == kOpenEmptyKey) {
+        *inserted = true;
+        return pos;
+      }
+      if (prev == key) return pos;
+    }
+    pos = (pos + 1 == t.capacity) ? 0 : pos + 1;
+  }
+}
+
+// The value of a slot is published after its key, so the threads which
+// find a slot claimed in the same kernel wait for it.
+__device__ __forceinline__ int32 open_wait_value(const int32* values,
+                                                 int64 slot) {
+  int32 value;
+  while ((value = open_load(values + slot)) < 0) {
+  }
+  return value;
+}
+
+__device__ __forceinline__ void open_publish_value(int32* values, int64 slot,
+                                                   int32 value) {
+  __threadfence();
+  atomicExch(values + slot, value);
+}
+
+// Only called by the insert kernels, never along with open_push_free.
+__device__ __forceinline__ int32 open_pop_free(const int32* free_idxs,
+                                               int32* num_free) {
+  int32 n = open_load(num_free);
+  while (n > 0) {
+    int32 prev = atomicCAS(num_free, n, n - 1);
+    if (prev == n) return free_idxs[n - 1];
+    n = prev;
+  }
+  return -1;
+}
+
+__device__ __forceinline__ void open_push_free(int32* free_idxs,
+                                               int32* num_free, int32 idx) {
+  free_idxs[atomicAdd(num_free, 1)] = idx;
+}
+
+__device__ __forceinline__ void open_clear_flags(bool** d_flags, int32 idx,
+                                                 int32 slot_num,
+                                                 int32 bank_size) {
+  auto bank_idx = idx / bank_size;
+  auto offset_in_bank = idx % bank_size;
+  for (int32 i = 0; i < slot_num; ++i) {
+    d_flags[bank_idx * slot_num + i][offset_in_bank] = false;
+  }
+}
+
+template <typename Key>
+__global__ void kv_open_migrate_kernel(
+    typename GPUOpenIndex<Key>::Table table,
+    typename GPUOpenIndex<Key>::Table old_table, size_t begin, size_t end,
+    typename GPUOpenIndex<Key>::Counters* counters) {
+  for (size_t pos = begin + blockIdx.x * blockDim.x + threadIdx.x; pos < end;
+       pos += gridDim.x * blockDim.x) {
+    Key key = old_table.keys[pos];
+    if (!open_is_live(key)) continue;
+    bool inserted;
+    int64 slot = open_claim(table, key, &inserted);
+    if (inserted) {
+      atomicAdd(&counters->num_used, 1);
+    }
+    table.versions[slot] = old_table.versions[pos];
+    table.freqs[slot] = old_table.freqs[pos];
+    open_publish_value(table.values, slot, old_table.values[pos]);
+    old_table.keys[pos] = kOpenTombstoneKey;
+  }
+}
+
+template <typename Key>
+__device__ void open_erase_slot(const typename GPUOpenIndex<Key>::Table& t,
+                                int64 slot, int32* free_idxs,
+                                typename GPUOpenIndex<Key>::Counters* counters,
+                                bool** d_flags, int32 slot_num,
+                                int32 bank_size) {
+  Key key = open_load(t.keys + slot);
+  if (!open_is_live(key) ||
+      open_key_cas(t.keys + slot, key, static_cast<Key>(kOpenTombstoneKey)) !=
+          key) {
+    return;
+  }
+  int32 idx = t.values[slot];
+  open_clear_flags(d_flags, idx, slot_num, bank_size);
+  open_push_free(free_idxs, &counters->num_free, idx);
+  atomicSub(&counters->num_live, 1);
+}
+
+template <typename Key>
+__global__ void kv_open_erase_kernel(
+    const Key* key_first, int32 num_items,
+    typename GPUOpenIndex<Key>::Table table,
+    typename GPUOpenIndex<Key>::Table old_table, int32* free_idxs,
+    typename GPUOpenIndex<Key>::Counters* counters, bool** d_flags,
+    int32 slot_num, int32 bank_size) {
+  for (int32 i = blockIdx.x * blockDim.x + threadIdx.x; i < num_items;
+       i += gridDim.x * blockDim.x) {
+    Key key = key_first[i];
+    int64 slot = open_find(table, key);
+    if (slot >= 0) {
+      open_erase_slot<Key>(table, slot, free_idxs, counters, d_flags,
+                           slot_num, bank_size);
+    }
+    slot = open_find(old_table, key);
+    if (slot >= 0) {
+      open_erase_slot<Key>(old_table, slot, free_idxs, counters, d_flags,
+                           slot_num, bank_size);
+    }
+  }
+}
+
+template <typename Key>
+__global__ void kv_open_evict_kernel(
+    typename GPUOpenIndex<Key>::Table t, int64 min_version, int32 min_freq,
+    int32* free_idxs, typename GPUOpenIndex<Key>::Counters* counters,
+    bool** d_flags, int32 slot_num, int32 bank_size, int32* num_evicted) {
+  for (size_t pos = blockIdx.x * blockDim.x + threadIdx.x; pos < t.capacity;
+       pos += gridDim.x * blockDim.x) {
+    if (!open_is_live(t.keys[pos])) continue;
+    if (t.versions[pos] < min_version || t.freqs[pos] < min_freq) {
+      open_erase_slot<Key>(t, pos, free_idxs, counters, d_flags, slot_num,
+                           bank_size);
+      atomicAdd(num_evicted, 1);
+    } else if (min_freq > 0) {
+      // Halved so that the counts follow the recent accesses.
+      t.freqs[pos] >>= 1;
+    }
+  }
+}
+
+inline int open_grid_size(size_t n) {
+  return std::max(static_cast<size_t>(1),
+                  std::min((n + kOpenBlockSize - 1) / kOpenBlockSize,
+                           static_cast<size_t>(65535)));
+}
+}  // namespace
+
+template <typename K>
+GPUOpenIndex<K>::GPUOpenIndex(size_t initial_capacity, Allocator* alloc)
+    : alloc_(alloc) {
+  cudaMallocManaged(&counters, sizeof(Counters));
+  counters->num_used = 0;
+  counters->num_live = 0;
+  counters->num_free = 0;
+  table = AllocateTable(initial_capacity / kOpenMaxLoadFactor, 0);
+  CUCO_CUDA_TRY(cudaStreamSynchronize(0));
+}
+
+template <typename K>
+GPUOpenIndex<K>::~GPUOpenIndex() {
+  DeallocateTable(&table);
+  DeallocateTable(&old_table);
+  if (free_idxs != nullptr) {
+    TypedAllocator::Deallocate(alloc_, free_idxs, free_capacity);
+  }
+  cudaFree(counters);
+}
+
+template <typename K>
+int32 GPUOpenIndex<K>::Size() {
+  return counters->num_live;
+}
+
+template <typename K>
+typename GPUOpenIndex<K>::Table GPUOpenIndex<K>::AllocateTable(
+    size_t capacity, cudaStream_t stream) {
+  Table t;
+  t.capacity = capacity;
+  t.keys = TypedAllocator::Allocate<K>(alloc_, capacity,
+                                       AllocationAttributes());
+  t.values = TypedAllocator::Allocate<int32>(alloc_, capacity,
+                                             AllocationAttributes());
+  t.versions = TypedAllocator::Allocate<int64>(alloc_, capacity,
+                                               AllocationAttributes());
+  t.freqs = TypedAllocator::Allocate<int32>(alloc_, capacity,
+                                            AllocationAttributes());
+  // All ones are the empty keys and the unpublished values.
+  CUCO_CUDA_TRY(cudaMemsetAsync(t.keys, 0xff, capacity * sizeof(K), stream));
+  CUCO_CUDA_TRY(
+      cudaMemsetAsync(t.values, 0xff, capacity * sizeof(int32), stream));
+  CUCO_CUDA_TRY(
+      cudaMemsetAsync(t.versions, 0, capacity * sizeof(int64), stream));
+  CUCO_CUDA_TRY(cudaMemsetAsync(t.freqs, 0, capacity * sizeof(int32), stream));
+  return t;
+}
+
+template <typename K>
+void GPUOpenIndex<K>::DeallocateTable(Table* t) {
+  if (t->capacity == 0) return;
+  TypedAllocator::Deallocate(alloc_, t->keys, t->capacity);
+  TypedAllocator::Deallocate(alloc_, t->values, t->capacity);
+  TypedAllocator::Deallocate(alloc_, t->versions, t->capacity);
+  TypedAllocator::Deallocate(alloc_, t->freqs, t->capacity);
+  *t = Table();
+}
+
+template <typename K>
+void GPUOpenIndex<K>::Migrate(size_t num_slots, cudaStream_t stream) {
+  size_t end = std::min(old_table.capacity, migrate_pos + num_slots);
+  if (end > migrate_pos) {
+    TF_CHECK_OK(GpuLaunchKernel(kv_open_migrate_kernel<K>,
+                                open_grid_size(end - migrate_pos),
+                                kOpenBlockSize, 0, stream, table, old_table,
+                                migrate_pos, end, counters));
+    migrate_pos = end;
+  }
+  if (migrate_pos == old_table.capacity) {
+    CUCO_CUDA_TRY(cudaStreamSynchronize(stream));
+    DeallocateTable(&old_table);
+    migrate_pos = 0;
+    num_pending = 0;
+  }
+}
+
+template <typename K>
+void GPUOpenIndex<K>::Reserve(size_t n, cudaStream_t stream) {
+  CUCO_CUDA_TRY(cudaStreamSynchronize(stream));
+  while (counters->num_used + num_pending + n >
+         kOpenMaxLoadFactor * table.capacity) {
+    if (old_table.capacity > 0) {
+      Migrate(old_table.capacity, stream);
+      continue;
+    }
+    // Grows the table only if the live keys need it, otherwise the rehash
+    // just drops the tombstones.
+    size_t capacity = table.capacity;
+    while ((counters->num_live + n) * 2 > capacity) {
+      capacity *= 2;
+    }
+    VLOG(1) << "Rehash the GPU open addressing index of "
+            << counters->num_live << " keys from " << table.capacity
+            << " slots to " << capacity << " slots.";
+    old_table = table;
+    migrate_pos = 0;
+    num_pending = counters->num_live;
+    table = AllocateTable(capacity, stream);
+    counters->num_used = 0;
+  }
+  if (old_table.capacity > 0) {
+    // Fast enough to finish before the new table is loaded.
+    Migrate(std::max(kOpenMinMigrateSlots, 4 * n), stream);
+  }
+}
+
+template <typename K>
+void GPUOpenIndex<K>::ReserveFreeIdxs(size_t num_items, cudaStream_t stream) {
+  if (num_items <= free_capacity) return;
+  int32* new_free_idxs = TypedAllocator::Allocate<int32>(
+      alloc_, num_items, AllocationAttributes());
+  if (free_idxs != nullptr) {
+    CUCO_CUDA_TRY(cudaMemcpyAsync(new_free_idxs, free_idxs,
+                                  free_capacity * sizeof(int32),
+                                  cudaMemcpyDeviceToDevice, stream));
+    CUCO_CUDA_TRY(cudaStreamSynchronize(stream));
+    TypedAllocator::Deallocate(alloc_, free_idxs, free_capacity);
+  }
+  free_idxs = new_free_idxs;
+  free_capacity = num_items;
+}
+
+template <typename K>
+void GPUOpenIndex<K>::Erase(const K* keys, int32 num_items, bool** d_flags,
+                            int32 slot_num, int32 bank_size,
+                            cudaStream_t stream) {
+  if (num_items <= 0) return;
+  TF_CHECK_OK(GpuLaunchKernel(kv_open_erase_kernel<K>,
+                              open_grid_size(num_items), kOpenBlockSize, 0,
+                              stream, keys, num_items, table, old_table,
+                              free_idxs, counters, d_flags, slot_num,
+                              bank_size));
+  CUCO_CUDA_TRY(cudaStreamSynchronize(stream));
+}
+
+template <typename K>
+int32 GPUOpenIndex<K>::Evict(int64 min_version, int32 min_freq,
+                             bool** d_flags, int32 slot_num, int32 bank_size,
+                             cudaStream_t stream) {
+  int32* num_evicted;
+  cudaMallocManaged(&num_evicted, sizeof(int32));
+  *num_evicted = 0;
+  for (auto* t : {&table, &old_table}) {
+    if (t->capacity == 0) continue;
+    TF_CHECK_OK(GpuLaunchKernel(kv_open_evict_kernel<K>,
+                                open_grid_size(t->capacity), kOpenBlockSize, 0,
+                                stream, *t, min_version, min_freq, free_idxs,
+                                counters, d_flags, slot_num, bank_size,
+                                num_evicted));
+  }
+  CUCO_CUDA_TRY(cudaStreamSynchronize(stream));
+  int32 ret = *num_evicted;
+  cudaFree(num_evicted);
+  return ret;
+}
+
+template class GPUOpenIndex<int32>;
+template class GPUOpenIndex<int64>;
+
 template <typename K, typename V>
 GPUHashTable<K, V>::GPUHashTable(K empty_key_sentinel, Allocator* alloc,
-                                 size_t initial_capacity)
+                                 size_t initial_capacity,
+                                 bool open_addressing)
     : initial_bank_size(initial_capacity) {
-  hash_table =
-      new DynamicHashTable<K, int32>(initial_capacity, empty_key_sentinel, -1,
-                                     gpu_hash_map_tf_allocator<uint8_t>(alloc));
+  if (open_addressing) {
+    hash_table = nullptr;
+    open_index = new GPUOpenIndex<K>(initial_capacity, alloc);
+  } else {
+    hash_table = new DynamicHashTable<K, int32>(
+        initial_capacity, empty_key_sentinel, -1,
+        gpu_hash_map_tf_allocator<uint8_t>(alloc));
+  }
   cudaMallocManaged(
       &start_idx, sizeof(cuda::atomic<std::size_t, cuda::thread_scope_device>));
   *start_idx = 0;
@@ -121,11 +491,15 @@ GPUHashTable<K, V>::GPUHashTable(K empty_key_sentinel, Allocator* alloc,
 template <typename K, typename V>
 GPUHashTable<K, V>::~GPUHashTable() {
   delete hash_table;
+  delete open_index;
   cudaFree(start_idx);
 }
 
 template <typename K, typename V>
 int32 GPUHashTable<K, V>::Size() {
+  if (open_index != nullptr) {
+    return open_index->Size();
+  }
   return hash_table->map_.get_size();
 }
 
@@ -297,6 +671,45 @@ __global__ void kv_lookup_dynamic_key_kernel(
   }
 }
 
+template <typename Key, typename V>
+__global__ void kv_open_lookup_key_kernel(
+    const Key* key_first, V** value_srcs, V* value_first, const V* default_v,
+    int32 default_v_num, int32 num_items, int32 dimension,
+    typename GPUOpenIndex<Key>::Table table,
+    typename GPUOpenIndex<Key>::Table old_table, int32 slot_idx,
+    int32 slot_num, int32 bank_size) {
+  __shared__ int32 item_pos;
+  auto item_idx = blockIdx.x;
+  auto key = key_first[item_idx];
+  if (threadIdx.x == 0) {
+    item_pos = -1;
+    int64 slot = open_find(table, key);
+    if (slot >= 0) {
+      item_pos = open_wait_value(table.values, slot);
+    } else {
+      slot = open_find(old_table, key);
+      if (slot >= 0) {
+        item_pos = open_wait_value(old_table.values, slot);
+      }
+    }
+  }
+  __syncthreads();
+  if (item_pos < 0) {
+    for (auto id = threadIdx.x; id < dimension; id += blockDim.x) {
+      value_first[item_idx * dimension + id] =
+          default_v[key % default_v_num * dimension + id];
+    }
+  } else {
+    auto bank_idx = item_pos / bank_size;
+    auto offset_in_bank = item_pos % bank_size;
+    auto slot_offset = bank_idx * slot_num + slot_idx;
+    for (auto id = threadIdx.x; id < dimension; id += blockDim.x) {
+      value_first[item_idx * dimension + id] =
+          value_srcs[slot_offset][offset_in_bank * dimension + id];
+    }
+  }
+}
+
 template <typename Key, typename V>
 struct KvLookupKey<GPUHashTable<Key, V>, Key, V> {
   void operator()(const Key* keys, V* vals, int32 num_items, int32 dimension,
@@ -310,6 +723,15 @@ struct KvLookupKey<GPUHashTable<Key, V>, Key, V> {
         Key, int32, cuda::thread_scope_device,
         gpu_hash_map_tf_allocator<uint8_t>>::view_type;
 
+    if (hash_table->open_index != nullptr) {
+      auto* index = hash_table->open_index;
+      TF_CHECK_OK(GpuLaunchKernel(
+          kv_open_lookup_key_kernel<Key, V>, num_items, 256, 0, stream, keys,
+          hash_table->d_bank_ptrs, vals, default_v, default_v_num, num_items,
+          dimension, index->table, index->old_table, slot_idx, slot_num,
+          hash_table->initial_bank_size));
+      return;
+    }
     auto& map = hash_table->hash_table->map_;
 
     auto const grid_size = (TILE_SIZE * num_items + STRIDE * BLOCK_SIZE - 1) /
@@ -441,11 +863,59 @@ __global__ void kv_lookup_and_insert_key_kernel(
   }
 }
 
+template <typename Key>
+__global__ void kv_open_lookup_and_insert_key_kernel(
+    const Key* key_first, int32* value_first, int32 num_items,
+    typename GPUOpenIndex<Key>::Table table,
+    typename GPUOpenIndex<Key>::Table old_table, int32* free_idxs,
+    typename GPUOpenIndex<Key>::Counters* counters, atomicT* start_idx,
+    int64 version) {
+  for (int32 i = blockIdx.x * blockDim.x + threadIdx.x; i < num_items;
+       i += gridDim.x * blockDim.x) {
+    Key key = key_first[i];
+    auto t = table;
+    int64 slot = open_find(table, key);
+    if (slot < 0) {
+      slot = open_find(old_table, key);
+      if (slot >= 0) {
+        t = old_table;
+      }
+    }
+    if (slot < 0) {
+      bool inserted;
+      slot = open_claim(table, key, &inserted);
+      if (inserted) {
+        atomicAdd(&counters->num_used, 1);
+        atomicAdd(&counters->num_live, 1);
+        int32 item_pos = open_pop_free(free_idxs, &counters->num_free);
+        if (item_pos < 0) {
+          item_pos = start_idx->fetch_add(1);
+        }
+        open_publish_value(table.values, slot, item_pos);
+      }
+    }
+    t.versions[slot] = version;
+    atomicAdd(t.freqs + slot, 1);
+    value_first[i] = open_wait_value(t.values, slot);
+  }
+}
+
 template <typename Key, typename V>
 struct KvLookupInsertKey<GPUDevice, Key, V> {
   void operator()(const Key* key_first, int32* value_first, int32 num_items,
                   GPUHashTable<Key, V>* hash_table, atomicT* start_idx,
                   cudaStream_t stream) {
+    if (hash_table->open_index != nullptr) {
+      auto* index = hash_table->open_index;
+      index->Reserve(num_items, stream);
+      TF_CHECK_OK(GpuLaunchKernel(
+          kv_open_lookup_and_insert_key_kernel<Key>,
+          std::min((num_items + 255) / 256, 65535), 256, 0, stream, key_first,
+          value_first, num_items, index->table, index->old_table,
+          index->free_idxs, index->counters, start_idx, index->version));
+      CUCO_CUDA_TRY(cudaStreamSynchronize(stream));
+      return;
+    }
     using mutableViewT = typename cuco::dynamic_map<
         Key, int32, cuda::thread_scope_device,
         gpu_hash_map_tf_allocator<uint8_t>>::mutable_view_type;
@@ -609,6 +1079,31 @@ __global__ void kv_get_key_snapshot_kernel(
   }
 }
 
+template <typename Key>
+__global__ void kv_open_get_key_snapshot_kernel(
+    Key* key, int32* item_idxs, int32 slot_idx, int32 primary_slot_idx,
+    bool** d_flags, int32 slot_num, int32 bank_size,
+    typename GPUOpenIndex<Key>::Table t, int32 ev_size, int32* num_keys) {
+  for (size_t pos = blockIdx.x * blockDim.x + threadIdx.x; pos < t.capacity;
+       pos += gridDim.x * blockDim.x) {
+    Key k = t.keys[pos];
+    if (!open_is_live(k)) continue;
+    int32 item_pos = t.values[pos];
+    auto bank_idx = item_pos / bank_size;
+    auto offset_in_bank = item_pos % bank_size;
+    auto slot_offset = bank_idx * slot_num + slot_idx;
+    auto pri_slot_offset = bank_idx * slot_num + primary_slot_idx;
+    if (d_flags[slot_offset][offset_in_bank] &&
+        d_flags[pri_slot_offset][offset_in_bank]) {
+      int32 n = atomicAdd(num_keys, 1);
+      if (n < ev_size) {
+        key[n] = k;
+        item_idxs[n] = item_pos;
+      }
+    }
+  }
+}
+
 template <typename Key, typename V>
 struct KvKeyGetSnapshot<GPUDevice, Key, V> {
   void operator()(Key* key_first, int32* value_first, int32 slot_idx,
@@ -616,6 +1111,27 @@ struct KvKeyGetSnapshot<GPUDevice, Key, V> {
                   int32 slot_num, int32 bank_size,
                   GPUHashTable<Key, V>* hash_table, int32 ev_size,
                   cudaStream_t stream) {
+    if (hash_table->open_index != nullptr) {
+      auto* index = hash_table->open_index;
+      // The keys not filled keep the empty key sentinel.
+      CUCO_CUDA_TRY(
+          cudaMemsetAsync(key_first, 0xff, ev_size * sizeof(Key), stream));
+      int32* num_keys;
+      cudaMallocManaged(&num_keys, sizeof(int32));
+      *num_keys = 0;
+      for (auto* t : {&index->table, &index->old_table}) {
+        if (t->capacity == 0) continue;
+        TF_CHECK_OK(GpuLaunchKernel(
+            kv_open_get_key_snapshot_kernel<Key>,
+            std::min((t->capacity + 255) / 256, static_cast<size_t>(65535)),
+            256, 0, stream, key_first, value_first, slot_idx,
+            primary_slot_idx, d_flags, slot_num, bank_size, *t, ev_size,
+            num_keys));
+      }
+      CUCO_CUDA_TRY(cudaStreamSynchronize(stream));
+      cudaFree(num_keys);
+      return;
+    }
     using ViewT = typename cuco::dynamic_map<
         Key, int32, cuda::thread_scope_device,
         gpu_hash_map_tf_allocator<uint8_t>>::view_type;
@@ -50,17 +50,93 @@ class GPUStaticHashTable {
   int capacity_;
 };
 
+// The open addressing index of GPUHashTable, which replaces its cuco
+// dynamic_map with TF_EV_GPU_OPEN_ADDRESSING:
+//  * Keys are inserted and erased in place by the kernels, erased keys
+//    leave tombstones which are skipped by the probes.
+//  * A loaded table is rehashed into a new one a few slots per batch, the
+//    lookups probe both tables meanwhile, so the table never stops to
+//    rebuild. The tombstones are dropped by the rehash.
+//  * The item indices of the erased keys are reused by the inserted ones.
+// Keys -1 and -2 are reserved for the empty slots and the tombstones.
+template <typename K>
+class GPUOpenIndex {
+ public:
+  struct Table {
+    K* keys = nullptr;
+    int32* values = nullptr;
+    // The latest version and the access count of the keys.
+    int64* versions = nullptr;
+    int32* freqs = nullptr;
+    size_t capacity = 0;
+  };
+
+  struct Counters {
+    // Used slots of the current table, including the tombstones.
+    int32 num_used;
+    int32 num_live;
+    int32 num_free;
+  };
+
+  GPUOpenIndex(size_t initial_capacity, Allocator* alloc);
+
+  ~GPUOpenIndex();
+
+  int32 Size();
+
+  // Makes room for n more keys in the current table, called before they
+  // are inserted.
+  void Reserve(size_t n, cudaStream_t stream);
+
+  // Makes room for num_items erased item indices.
+  void ReserveFreeIdxs(size_t num_items, cudaStream_t stream);
+
+  // Erases the keys on device, the existence flags of their items are
+  // cleared so that they are initialized again once reused.
+  void Erase(const K* keys, int32 num_items, bool** d_flags, int32 slot_num,
+             int32 bank_size, cudaStream_t stream);
+
+  // Erases the keys whose version is less than min_version or whose
+  // access count is less than min_freq, then halves the access counts of
+  // the others. Returns the number of erased keys.
+  int32 Evict(int64 min_version, int32 min_freq, bool** d_flags,
+              int32 slot_num, int32 bank_size, cudaStream_t stream);
+
+  Table table;
+  // The table being rehashed into table, its slots before migrate_pos
+  // have been rehashed.
+  Table old_table;
+  size_t migrate_pos = 0;
+  // Upper bound of the keys in old_table not rehashed yet.
+  size_t num_pending = 0;
+  int32* free_idxs = nullptr;
+  size_t free_capacity = 0;
+  Counters* counters;
+  // Stamped on the keys looked up.
+  int64 version = 0;
+
+ private:
+  Table AllocateTable(size_t capacity, cudaStream_t stream);
+  void DeallocateTable(Table* t);
+  void Migrate(size_t num_slots, cudaStream_t stream);
+
+  Allocator* alloc_;
+};
+
 template <typename K, typename V>
 class GPUHashTable {
  public:
   GPUHashTable(K empty_key_sentinel, Allocator* alloc,
-               size_t initial_capacity = 50000);
+               size_t initial_capacity = 50000,
+               bool open_addressing = false);
 
   ~GPUHashTable();
 
   int32 Size();
 
   DynamicHashTable<K, int32, gpu_hash_map_tf_allocator<uint8_t>>* hash_table;
+  // Used instead of hash_table if not null.
+  GPUOpenIndex<K>* open_index = nullptr;
 
   const int32 initial_bank_size;
   cuda::atomic<std::size_t, cuda::thread_scope_device>* start_idx;
@@ -0,0 +1,106 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+=======================================================================*/
+
+#include "tensorflow/core/framework/embedding/hbm_cache_budget.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace embedding {
+
+HbmCacheBudget* HbmCacheBudget::Global() {
+  static HbmCacheBudget* budget = new HbmCacheBudget();
+  return budget;
+}
+
+HbmCacheBudget::HbmCacheBudget() {
+  int64 reserved_mb = 0;
+  TF_CHECK_OK(ReadInt64FromEnvVar("TF_HBM_CACHE_RESERVED_MB", 512,
+                                  &reserved_mb));
+  reserved_bytes_ = reserved_mb << 20;
+}
+
+void HbmCacheBudget::SetDeviceBytes(int64 bytes) {
+  mutex_lock l(mu_);
+  device_bytes_ = bytes;
+  RebalanceLocked();
+}
+
+void HbmCacheBudget::SetDenseBytes(int64 bytes) {
+  mutex_lock l(mu_);
+  if (bytes == dense_bytes_) {
+    return;
+  }
+  dense_bytes_ = bytes;
+  RebalanceLocked();
+}
+
+void HbmCacheBudget::Register(const void* cache, int64 requested_bytes,
+                              ResizeCallback resize) {
+  mutex_lock l(mu_);
+  Cache& c = caches_[cache];
+  c.requested_bytes = requested_bytes;
+  c.bytes = -1;
+  c.resize = std::move(resize);
+  RebalanceLocked();
+}
+
+void HbmCacheBudget::Unregister(const void* cache) {
+  mutex_lock l(mu_);
+  caches_.erase(cache);
+  RebalanceLocked();
+}
+
+int64 HbmCacheBudget::CacheBytes(const void* cache) {
+  mutex_lock l(mu_);
+  auto it = caches_.find(cache);
+  return it == caches_.end() ? -1 : it->second.bytes;
+}
+
+void HbmCacheBudget::RebalanceLocked() {
+  int64 total_requested = 0;
+  for (const auto& it : caches_) {
+    total_requested += it.second.requested_bytes;
+  }
+  int64 available = total_requested;
+  if (device_bytes_ >= 0 && dense_bytes_ >= 0) {
+    available = std::max<int64>(
+        device_bytes_ - dense_bytes_ - reserved_bytes_, 0);
+  }
+  const double ratio =
+      total_requested > available
+          ? static_cast<double>(available) / total_requested
+          : 1.0;
+  for (auto& it : caches_) {
+    Cache& c = it.second;
+    const int64 bytes = static_cast<int64>(c.requested_bytes * ratio);
+    if (bytes != c.bytes) {
+      c.bytes = bytes;
+      c.resize(bytes);
+    }
+  }
+  if (ratio < 1.0) {
+    LOG(INFO) << "HBM caches of EmbeddingVariables limited to " << available
+              << " of the " << total_requested << " bytes configured, "
+              << dense_bytes_ << " bytes planned for the dense ops of "
+              << device_bytes_;
+  }
+}
+
+}  // namespace embedding
+}  // namespace tensorflow
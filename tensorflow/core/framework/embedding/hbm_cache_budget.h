@@ -0,0 +1,83 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+=======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_HBM_CACHE_BUDGET_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_HBM_CACHE_BUDGET_H_
+
+#include <functional>
+#include <map>
+
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// Shares the GPU memory between the dense ops and the HBM caches of the
+// multi-tier EmbeddingVars, which allocate from the same device.
+//
+// The GPU memory planner reports the memory of the device and the peak
+// memory it plans for the dense ops. What is left, less
+// TF_HBM_CACHE_RESERVED_MB for the allocations outside of the plan, is
+// split among the caches in proportion to the sizes they are configured
+// with, and no cache gets more than its configured size. The caches are
+// resized whenever the plan changes, e.g. when it shrinks as swapping or
+// recomputation frees activations. Until a plan is reported, or without
+// one, the caches keep their configured sizes.
+class HbmCacheBudget {
+ public:
+  typedef std::function<void(int64 bytes)> ResizeCallback;
+
+  // The budget shared by all storages of the process.
+  static HbmCacheBudget* Global();
+
+  HbmCacheBudget();
+
+  void SetDeviceBytes(int64 bytes);
+  void SetDenseBytes(int64 bytes);
+
+  // Registers the cache 'cache' configured with 'requested_bytes'. 'resize'
+  // is called with the bytes of its share, under the lock of the budget,
+  // now and whenever the share changes, until the cache is unregistered.
+  void Register(const void* cache, int64 requested_bytes,
+                ResizeCallback resize);
+  void Unregister(const void* cache);
+
+  // The current share of 'cache', or -1 if it is not registered.
+  int64 CacheBytes(const void* cache);
+
+ private:
+  struct Cache {
+    int64 requested_bytes;
+    int64 bytes;
+    ResizeCallback resize;
+  };
+
+  void RebalanceLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  mutex mu_;
+  int64 device_bytes_ GUARDED_BY(mu_) = -1;
+  int64 dense_bytes_ GUARDED_BY(mu_) = -1;
+  int64 reserved_bytes_;
+  std::map<const void*, Cache> caches_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(HbmCacheBudget);
+};
+
+}  // namespace embedding
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_HBM_CACHE_BUDGET_H_
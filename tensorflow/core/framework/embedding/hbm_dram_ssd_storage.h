@@ -4,6 +4,7 @@
 #if GOOGLE_CUDA
 #define EIGEN_USE_GPU
 #include "tensorflow/core/framework/embedding/lockless_hash_map_cpu.h"
+#include "tensorflow/core/framework/embedding/hbm_cache_budget.h"
 #include "tensorflow/core/framework/embedding/multi_tier_storage.h"
 #include "tensorflow/core/framework/embedding/single_tier_storage.h"
 #include "tensorflow/core/common_runtime/gpu/gpu_event_mgr.h"
@@ -31,9 +32,13 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
     dram_ = new DramStorage<K, V>(sc, cpu_alloc_, lc,
         new LocklessHashMapCPU<K, V>(gpu_alloc_));
     ssd_ = new SsdHashStorage<K, V>(sc, cpu_alloc_, lc);
+    HbmCacheBudget::Global()->Register(this, sc.size[0], [this](int64 bytes) {
+      MultiTierStorage<K, V>::SetCacheBytes(bytes);
+    });
   }
 
   ~HbmDramSsdStorage() override {
+    HbmCacheBudget::Global()->Unregister(this);
     MultiTierStorage<K, V>::DeleteFromEvictionManager();
     delete hbm_;
     delete dram_;
@@ -147,19 +152,13 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
       return s;
     }
     ValuePtr<V>* gpu_value_ptr = hbm_->CreateValuePtr(size);
-    {
-      mutex_lock l(memory_pool_mu_);
-      gpu_value_ptr->SetPtr(embedding_mem_pool_->Allocate());
-      *value_ptr = gpu_value_ptr;
-    }
+    gpu_value_ptr->SetPtr(embedding_mem_pool_->Allocate());
+    *value_ptr = gpu_value_ptr;
 
     s = hbm_->TryInsert(key, *value_ptr);
     // Insert Failed
     if (!s.ok()) {
-      {
-        mutex_lock l(memory_pool_mu_);
-        embedding_mem_pool_->Deallocate((*value_ptr)->GetValue(0, 0));
-      }
+      embedding_mem_pool_->Deallocate((*value_ptr)->GetValue(0, 0));
       delete *value_ptr;
       return hbm_->Get(key, value_ptr);
     } else {
@@ -190,7 +189,13 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
 
   void InitCache(embedding::CacheStrategy cache_strategy) override {
     MultiTierStorage<K, V>::InitCache(cache_strategy);
-    dram_cache_ = new LRUCache<K>();
+    // The unified policy ranks the DRAM tier like the HBM tier, the other
+    // strategies keep the DRAM tier in LRU order.
+    if (cache_strategy == embedding::CacheStrategy::FREQ_RECENCY) {
+      dram_cache_ = new FreqRecencyCache<K>();
+    } else {
+      dram_cache_ = new LRUCache<K>();
+    }
   }
 
   void ImportToHbm(
@@ -207,20 +212,15 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
             size * sizeof(V*));
     ValuePtr<V>** gpu_value_ptrs = new ValuePtr<V>*[size];
     ValuePtr<V>** cpu_value_ptrs = new ValuePtr<V>*[size];
-    {
-      //Mutex with other Import Ops
-      mutex_lock l(memory_pool_mu_);
-      for (int64 i = 0; i < size; i++) {
-        dram_->Get(ids[i], &cpu_value_ptrs[i]);
-        gpu_value_ptrs[i] = hbm_->CreateValuePtr(value_len);
-        V* val_ptr = embedding_mem_pool_->Allocate();
-        gpu_value_ptrs[i]->SetPtr(val_ptr);
-        memcpy((char *)gpu_value_ptrs[i]->GetPtr(),
-               (char *)cpu_value_ptrs[i]->GetPtr(),
-               sizeof(FixedLengthHeader));
-      }
+    for (int64 i = 0; i < size; i++) {
+      dram_->Get(ids[i], &cpu_value_ptrs[i]);
+      gpu_value_ptrs[i] = hbm_->CreateValuePtr(value_len);
+      V* val_ptr = embedding_mem_pool_->Allocate();
+      gpu_value_ptrs[i]->SetPtr(val_ptr);
+      memcpy((char *)gpu_value_ptrs[i]->GetPtr(),
+             (char *)cpu_value_ptrs[i]->GetPtr(),
+             sizeof(FixedLengthHeader));
     }
-    //Split from above for loop for minize the cost of mutex lock
     //TODO: Speed up with intra parallelism
     std::vector<ValuePtr<V>*> invalid_value_ptrs;
     for (int64 i = 0; i < size; i++) {
@@ -240,10 +240,7 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
         size * value_len * sizeof(V), cudaMemcpyHostToDevice);
     cudaMemcpy(dev_value_address, value_address,
         size * sizeof(V*), cudaMemcpyHostToDevice);
-    {
-      mutex_lock l(memory_pool_mu_);
-      embedding_mem_pool_->Deallocate(invalid_value_ptrs);
-    }
+    embedding_mem_pool_->Deallocate(invalid_value_ptrs);
     int block_dim = 128;
       void* args[] = {
           (void*)&dev_value_address,
@@ -279,24 +276,20 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
     int64* memory_index = new int64[total];
     int64 i = 0;
     auto it = copyback_cursor.cbegin();
-    {
-      //Mutex with eviction thread
-      mutex_lock l(memory_pool_mu_);
-      for ( ; it != copyback_cursor.cend(); ++it, ++i) {
-        int64 j = *it & 0x0fffffffffffffff;
-        memory_index[i] = *it;
-        ValuePtr<V>* gpu_value_ptr =
-            hbm_->CreateValuePtr(value_len);
-        V* val_ptr = embedding_mem_pool_->Allocate();
-        bool flag = gpu_value_ptr->SetPtr(val_ptr);
-        if (!flag) {
-          embedding_mem_pool_->Deallocate(val_ptr);
-        }
-        memcpy((char *)gpu_value_ptr->GetPtr(),
-               (char *)memcpy_address[j] - sizeof(FixedLengthHeader),
-               sizeof(FixedLengthHeader));
-        gpu_value_ptrs[i] = gpu_value_ptr;
+    for ( ; it != copyback_cursor.cend(); ++it, ++i) {
+      int64 j = *it & 0x0fffffffffffffff;
+      memory_index[i] = *it;
+      ValuePtr<V>* gpu_value_ptr =
+          hbm_->CreateValuePtr(value_len);
+      V* val_ptr = embedding_mem_pool_->Allocate();
+      bool flag = gpu_value_ptr->SetPtr(val_ptr);
+      if (!flag) {
+        embedding_mem_pool_->Deallocate(val_ptr);
       }
+      memcpy((char *)gpu_value_ptr->GetPtr(),
+             (char *)memcpy_address[j] - sizeof(FixedLengthHeader),
+             sizeof(FixedLengthHeader));
+      gpu_value_ptrs[i] = gpu_value_ptr;
     }
 
     auto do_work = [memory_index, memcpy_address,
@@ -422,8 +415,6 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
   }
 
   Status DramToSsdBatchCommit(std::shared_ptr<std::vector<K>> keys) {
-    MultiTierStorage<K, V>::ReleaseValuePtrs(dram_value_ptr_out_of_date_,
-                                             dram_->alloc_);
     mutex_lock l(*(ssd_->get_mutex()));
     mutex_lock l1(*(dram_->get_mutex()));
 
@@ -440,18 +431,18 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
         if (dram_->Get(dram_evic_ids[i], &value_ptr).ok()) {
           TF_CHECK_OK(ssd_->Commit(dram_evic_ids[i], value_ptr));
           TF_CHECK_OK(dram_->Remove(dram_evic_ids[i]));
-          dram_value_ptr_out_of_date_.emplace_back(value_ptr);
+          MultiTierStorage<K, V>::RetireValuePtr(value_ptr, dram_->alloc_);
         }
       }
     }
     return Status::OK();
   }
 
-  void BatchEviction() override {
+  int64 BatchEviction() override {
     constexpr int EvictionSize = 10000;
     K evic_ids[EvictionSize];
     if (!MultiTierStorage<K, V>::ready_eviction_) {
-      return;
+      return 0;
     }
     mutex_lock l(*(hbm_->get_mutex()));
     mutex_lock l1(*(dram_->get_mutex()));
@@ -474,11 +465,7 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
         }
       }
       dram_->BatchCommit(*keys, value_ptrs);
-      {
-        //Mutex with main thread
-        mutex_lock l_mem(memory_pool_mu_);
-        embedding_mem_pool_->Deallocate(value_ptrs);
-      }
+      embedding_mem_pool_->Deallocate(value_ptrs);
       for (auto it : *keys) {
         TF_CHECK_OK(hbm_->Remove(it));
       }
@@ -487,7 +474,9 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
           DramToSsdBatchCommit(keys);
         }
       );
+      return keys->size() * Storage<K, V>::total_dims_ * sizeof(V);
     }
+    return 0;
   }
 
   void CreateEmbeddingMemoryPool(
@@ -500,8 +489,6 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
 
   void AllocateMemoryForNewFeatures(
       const std::vector<ValuePtr<V>*>& value_ptr_list) override {
-    //Mutex with eviction thread
-    mutex_lock l(memory_pool_mu_);
     for (auto it : value_ptr_list) {
       V* val_ptr = embedding_mem_pool_->Allocate();
       bool flag = it->SetPtr(val_ptr);
@@ -514,8 +501,6 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
   void AllocateMemoryForNewFeatures(
      ValuePtr<V>** value_ptr_list,
      int64 num_of_value_ptrs) override {
-    //Mutex with other ImportOps
-    mutex_lock l(memory_pool_mu_);
     for (int64 i = 0; i < num_of_value_ptrs; i++) {
       V* val_ptr = embedding_mem_pool_->Allocate();
       bool flag = value_ptr_list[i]->SetPtr(val_ptr);
@@ -528,6 +513,7 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
  protected:
   void SetTotalDims(int64 total_dims) override {
     dram_->SetTotalDims(total_dims);
+    ssd_->SetEmbeddingDims(Storage<K, V>::alloc_len_);
     ssd_->SetTotalDims(total_dims);
   }
 
@@ -636,8 +622,6 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
     {
       int64 i = 0;
       auto it = copyback_cursors.cbegin();
-      //Mutex with eviction thread
-      mutex_lock l(memory_pool_mu_);
       for ( ; it != copyback_cursors.cend(); ++it, ++i) {
         int64 j = *it;
         memory_index[i] = j;
@@ -666,11 +650,8 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
         Status s = hbm_->TryInsert(
             copyback_keys[i], gpu_value_ptrs[i]);
         if (!s.ok()) {
-          {
-            mutex_lock l(memory_pool_mu_);
-            embedding_mem_pool_->Deallocate(
-                gpu_value_ptrs[i]->GetValue(0, 0));
-          }
+          embedding_mem_pool_->Deallocate(
+              gpu_value_ptrs[i]->GetValue(0, 0));
           delete gpu_value_ptrs[i];
           hbm_->Get(copyback_keys[i], &value_ptr_list[memory_index[i]]);
         }
@@ -699,8 +680,6 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
       {
         int64 i = 0;
         auto it = not_found_cursors.cbegin();
-        //Mutex with eviction thread
-        mutex_lock l(memory_pool_mu_);
         for ( ; it != not_found_cursors.cend(); ++it, ++i) {
           int64 j = *it;
           cursor_index[i] = j;
@@ -723,11 +702,8 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
           Status s = hbm_->TryInsert(
               insert_pairs[i].first, insert_pairs[i].second);
           if (!s.ok()) {
-            {
-              mutex_lock l(memory_pool_mu_);
-              embedding_mem_pool_->Deallocate(
-                  insert_pairs[i].second->GetValue(0, 0));
-            }
+            embedding_mem_pool_->Deallocate(
+                insert_pairs[i].second->GetValue(0, 0));
             delete insert_pairs[i].second;
             hbm_->Get(insert_pairs[i].first, &value_ptr_list[cursor_index[i]]);
           }
@@ -761,8 +737,6 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
   Allocator* cpu_alloc_;
   BatchCache<K>* dram_cache_;
   int64 dram_capacity_;
-  std::deque<ValuePtr<V>*> dram_value_ptr_out_of_date_;
-  mutex memory_pool_mu_; //ensure thread safety of embedding_mem_pool_
   const int copyback_flag_offset_bits_ = 60;
 };
 } // embedding
@@ -17,7 +17,10 @@ limitations under the License.
 
 #if GOOGLE_CUDA
 #define EIGEN_USE_GPU
+#include <unordered_set>
+
 #include "tensorflow/core/framework/embedding/lockless_hash_map_cpu.h"
+#include "tensorflow/core/framework/embedding/hbm_cache_budget.h"
 #include "tensorflow/core/framework/embedding/multi_tier_storage.h"
 #include "tensorflow/core/framework/embedding/single_tier_storage.h"
 #include "tensorflow/core/framework/embedding/hbm_storage_iterator.h"
@@ -42,12 +45,33 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
       : gpu_alloc_(gpu_alloc),
         MultiTierStorage<K, V>(sc, name) {
     hbm_ = new HbmStorageWithCpuKv<K, V>(sc, gpu_alloc, lc);
+    // With TF_HBM_DRAM_ZERO_COPY the DRAM tier is allocated in pinned host
+    // memory, and the misses of HBM no more than
+    // TF_HBM_DRAM_ZERO_COPY_MAX_MISSES are read by the GPU in place.
+    bool zero_copy = false;
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_HBM_DRAM_ZERO_COPY", false,
+                                   &zero_copy));
+    if (zero_copy) {
+      cpu_alloc = pinned_ev_allocator();
+      TF_CHECK_OK(ReadInt64FromEnvVar("TF_HBM_DRAM_ZERO_COPY_MAX_MISSES",
+          kDefaultZeroCopyMaxMisses,
+          &(MultiTierStorage<K, V>::zero_copy_max_misses_)));
+    }
     dram_ = new DramStorage<K, V>(sc, cpu_alloc, lc,
-        new LocklessHashMapCPU<K, V>(gpu_alloc));
+        new LocklessHashMapCPU<K, V>(gpu_alloc, cpu_alloc));
+    HbmCacheBudget::Global()->Register(this, sc.size[0], [this](int64 bytes) {
+      MultiTierStorage<K, V>::SetCacheBytes(bytes);
+    });
   }
 
   ~HbmDramStorage() override {
+    HbmCacheBudget::Global()->Unregister(this);
     MultiTierStorage<K, V>::DeleteFromEvictionManager();
+    // Waits for the pending prefetches.
+    prefetch_thread_pool_.reset();
+    if (prefetch_stream_ != nullptr) {
+      cudaStreamDestroy(prefetch_stream_);
+    }
     delete hbm_;
     delete dram_;
   }
@@ -127,21 +151,15 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
       return s;
     }
     ValuePtr<V>* gpu_value_ptr = hbm_->CreateValuePtr(size);
-    {
-      mutex_lock l(memory_pool_mu_);
-      gpu_value_ptr->SetPtr(embedding_mem_pool_->Allocate());
-      *value_ptr = gpu_value_ptr;
-    }
+    gpu_value_ptr->SetPtr(embedding_mem_pool_->Allocate());
+    *value_ptr = gpu_value_ptr;
 
     s = hbm_->TryInsert(key, *value_ptr);
     if (s.ok()) {
       return s;
     }
     // Insert Failed, key already exist
-    {
-      mutex_lock l(memory_pool_mu_);
-      embedding_mem_pool_->Deallocate((*value_ptr)->GetValue(0, 0));
-    }
+    embedding_mem_pool_->Deallocate((*value_ptr)->GetValue(0, 0));
     delete *value_ptr;
     return hbm_->Get(key, value_ptr);
   }
@@ -177,20 +195,15 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
             size * sizeof(V*));
     ValuePtr<V>** gpu_value_ptrs = new ValuePtr<V>*[size];
     ValuePtr<V>** cpu_value_ptrs = new ValuePtr<V>*[size];
-    {
-      //Mutex with other Import Ops
-      mutex_lock l(memory_pool_mu_);
-      for (int64 i = 0; i < size; i++) {
-        dram_->Get(ids[i], &cpu_value_ptrs[i]);
-        gpu_value_ptrs[i] = hbm_->CreateValuePtr(value_len);
-        V* val_ptr = embedding_mem_pool_->Allocate();
-        gpu_value_ptrs[i]->SetPtr(val_ptr);
-        memcpy((char *)gpu_value_ptrs[i]->GetPtr(),
-               (char *)cpu_value_ptrs[i]->GetPtr(),
-               sizeof(FixedLengthHeader));
-      }
+    for (int64 i = 0; i < size; i++) {
+      dram_->Get(ids[i], &cpu_value_ptrs[i]);
+      gpu_value_ptrs[i] = hbm_->CreateValuePtr(value_len);
+      V* val_ptr = embedding_mem_pool_->Allocate();
+      gpu_value_ptrs[i]->SetPtr(val_ptr);
+      memcpy((char *)gpu_value_ptrs[i]->GetPtr(),
+             (char *)cpu_value_ptrs[i]->GetPtr(),
+             sizeof(FixedLengthHeader));
     }
-    //Split from above for loop for minize the cost of mutex lock
     //TODO: Speed up with intra parallelism
     std::vector<ValuePtr<V>*> invalid_value_ptrs;
     for (int64 i = 0; i < size; i++) {
@@ -210,10 +223,7 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
         size * value_len * sizeof(V), cudaMemcpyHostToDevice);
     cudaMemcpy(dev_value_address, value_address,
         size * sizeof(V*), cudaMemcpyHostToDevice);
-    {
-      mutex_lock l(memory_pool_mu_);
-      embedding_mem_pool_->Deallocate(invalid_value_ptrs);
-    }
+    embedding_mem_pool_->Deallocate(invalid_value_ptrs);
     int block_dim = 128;
       void* args[] = {
           (void*)&dev_value_address,
@@ -244,30 +254,31 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
       se::Stream* compute_stream,
       EventMgr* event_mgr,
       const DeviceBase::CpuWorkerThreads* worker_threads) override {
-    auto memcpy_buffer_cpu = TypedAllocator::Allocate<V>(cpu_allocator(),
-        total * value_len, AllocationAttributes());
     int64* memory_index = new int64[total];
     int64 i = 0;
     auto it = copyback_cursor.cbegin();
-    {
-      //Mutex with eviction thread
-      mutex_lock l(memory_pool_mu_);
-      for ( ; it != copyback_cursor.cend(); ++it, ++i) {
-        int64 j = *it;
-        memory_index[i] = j;
-        ValuePtr<V>* gpu_value_ptr = hbm_->CreateValuePtr(value_len);
-        V* val_ptr = embedding_mem_pool_->Allocate();
-        bool flag = gpu_value_ptr->SetPtr(val_ptr);
-        if (!flag) {
-          embedding_mem_pool_->Deallocate(val_ptr);
-        }
-        memcpy((char *)gpu_value_ptr->GetPtr(),
-               (char *)memcpy_address[j] - sizeof(FixedLengthHeader),
-               sizeof(FixedLengthHeader));
-        gpu_value_ptrs[i] = gpu_value_ptr;
+    for ( ; it != copyback_cursor.cend(); ++it, ++i) {
+      int64 j = *it;
+      memory_index[i] = j;
+      ValuePtr<V>* gpu_value_ptr = hbm_->CreateValuePtr(value_len);
+      V* val_ptr = embedding_mem_pool_->Allocate();
+      bool flag = gpu_value_ptr->SetPtr(val_ptr);
+      if (!flag) {
+        embedding_mem_pool_->Deallocate(val_ptr);
       }
+      memcpy((char *)gpu_value_ptr->GetPtr(),
+             (char *)memcpy_address[j] - sizeof(FixedLengthHeader),
+             sizeof(FixedLengthHeader));
+      gpu_value_ptrs[i] = gpu_value_ptr;
+    }
+    if (total <= MultiTierStorage<K, V>::zero_copy_max_misses_) {
+      GatherEmbeddingsFromPinnedDram(total, memory_index, memcpy_address,
+          value_len, memcpy_buffer_gpu, compute_stream, event_mgr);
+      delete[] memory_index;
+      return;
     }
-    //Split from above for loop for minize the cost of mutex lock
+    auto memcpy_buffer_cpu = TypedAllocator::Allocate<V>(cpu_allocator(),
+        total * value_len, AllocationAttributes());
     auto do_work = [memory_index, memcpy_address,
                     memcpy_buffer_cpu, gpu_value_ptrs,
                     value_len, this] (int64 start, int64 limit) {
@@ -289,6 +300,64 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
     delete[] memory_index;
   }
 
+  // Gathers the rows in pinned memory to memcpy_buffer_gpu by a kernel
+  // reading them over UVA, bypassing the host buffer.
+  void GatherEmbeddingsFromPinnedDram(
+      int total, const int64* memory_index, V** memcpy_address,
+      int value_len, V* memcpy_buffer_gpu,
+      se::Stream* compute_stream, EventMgr* event_mgr) {
+    V** value_address = (V**)cpu_allocator()->AllocateRaw(
+        Allocator::kAllocatorAlignment, sizeof(V*) * total);
+    V** dev_value_address = (V**)gpu_alloc_->AllocateRaw(
+        Allocator::kAllocatorAlignment, sizeof(V*) * total);
+    for (int i = 0; i < total; i++) {
+      value_address[i] = memcpy_address[memory_index[i]];
+    }
+    DeviceMemoryBase gpu_addr_dst_ptr(dev_value_address, total * sizeof(V*));
+    compute_stream->ThenMemcpy(
+        &gpu_addr_dst_ptr, value_address, total * sizeof(V*));
+    const cudaStream_t* stream = CHECK_NOTNULL(
+        reinterpret_cast<const cudaStream_t*>(
+            compute_stream->implementation()->GpuStreamMemberHack()));
+    int block_dim = 128;
+    void* args[] = {
+        (void*)&dev_value_address,
+        (void*)&memcpy_buffer_gpu,
+        (void*)&value_len,
+        (void*)&total};
+    cudaLaunchKernel(
+        (void *)BatchCopy<V>,
+        (total * value_len + block_dim - 1) / block_dim,
+        block_dim, args, 0, *stream);
+    SyncWithEventMgr(compute_stream, event_mgr);
+    gpu_alloc_->DeallocateRaw(dev_value_address);
+    cpu_allocator()->DeallocateRaw(value_address);
+  }
+
+  // The ids are kept in the prefetch list of the cache while they are
+  // promoted, so that they are not evicted in the meantime, and enter the
+  // cache as the most recently used ones afterwards.
+  void Prefetch(const Tensor& indices, int64 value_len) override {
+    if (MultiTierStorage<K, V>::cache_ == nullptr) {
+      return;
+    }
+    {
+      mutex_lock l(prefetch_mu_);
+      if (prefetch_thread_pool_ == nullptr) {
+        prefetch_thread_pool_.reset(new thread::ThreadPool(
+            Env::Default(), ThreadOptions(), "HBM_DRAM_Prefetch", 1,
+            /*low_latency_hint=*/false));
+        cudaStreamCreateWithFlags(&prefetch_stream_, cudaStreamNonBlocking);
+      }
+    }
+    MultiTierStorage<K, V>::cache_->add_to_prefetch_list(indices);
+    prefetch_thread_pool_->Schedule([this, indices, value_len]() {
+      PrefetchToHbm((const K*)indices.data(), indices.NumElements(),
+                    value_len);
+      MultiTierStorage<K, V>::cache_->add_to_cache(indices);
+    });
+  }
+
   Status Remove(K key) override {
     hbm_->Remove(key);
     dram_->Remove(key);
@@ -403,8 +472,6 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
 
   void AllocateMemoryForNewFeatures(
       const std::vector<ValuePtr<V>*>& value_ptr_list) override {
-    //Mutex with eviction thread
-    mutex_lock l(memory_pool_mu_);
     for (auto it : value_ptr_list) {
       V* val_ptr = embedding_mem_pool_->Allocate();
       bool flag = it->SetPtr(val_ptr);
@@ -417,8 +484,6 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
   void AllocateMemoryForNewFeatures(
      ValuePtr<V>** value_ptr_list,
      int64 num_of_value_ptrs) override {
-    //Mutex with other ImportOps
-    mutex_lock l(memory_pool_mu_);
     for (int64 i = 0; i < num_of_value_ptrs; i++) {
       V* val_ptr = embedding_mem_pool_->Allocate();
       bool flag = value_ptr_list[i]->SetPtr(val_ptr);
@@ -428,11 +493,11 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
     }
   }
 
-  void BatchEviction() override {
+  int64 BatchEviction() override {
     constexpr int EvictionSize = 10000;
     K evic_ids[EvictionSize];
     if (!MultiTierStorage<K, V>::ready_eviction_) {
-      return;
+      return 0;
     }
     mutex_lock l(*(hbm_->get_mutex()));
     mutex_lock l1(*(dram_->get_mutex()));
@@ -455,15 +520,13 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
         }
       }
       dram_->BatchCommit(keys, value_ptrs);
-      {
-        //Mutex with main thread
-        mutex_lock l_mem(memory_pool_mu_);
-        embedding_mem_pool_->Deallocate(value_ptrs);
-      }
+      embedding_mem_pool_->Deallocate(value_ptrs);
       for (auto it : keys) {
         TF_CHECK_OK(hbm_->Remove(it));
       }
+      return keys.size() * Storage<K, V>::total_dims_ * sizeof(V);
     }
+    return 0;
   }
 
  protected:
@@ -553,8 +616,6 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
     {
       int64 i = 0;
       auto it = copyback_cursors.cbegin();
-      //Mutex with eviction thread
-      mutex_lock l(memory_pool_mu_);
       for ( ; it != copyback_cursors.cend(); ++it, ++i) {
         int64 j = *it;
         memory_index[i] = j;
@@ -583,11 +644,8 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
         Status s = hbm_->TryInsert(
             copyback_keys[i], gpu_value_ptrs[i]);
         if (!s.ok()) {
-          {
-            mutex_lock l(memory_pool_mu_);
-            embedding_mem_pool_->Deallocate(
-                gpu_value_ptrs[i]->GetValue(0, 0));
-          }
+          embedding_mem_pool_->Deallocate(
+              gpu_value_ptrs[i]->GetValue(0, 0));
           delete gpu_value_ptrs[i];
           hbm_->Get(copyback_keys[i], &value_ptr_list[memory_index[i]]);
         }
@@ -611,8 +669,6 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
       {
         int64 i = 0;
         auto it = not_found_cursors.cbegin();
-        //Mutex with eviction thread
-        mutex_lock l(memory_pool_mu_);
         for ( ; it != not_found_cursors.cend(); ++it, ++i) {
           int64 j = *it;
           cursor_index[i] = j;
@@ -635,11 +691,8 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
           Status s = hbm_->TryInsert(
               insert_pairs[i].first, insert_pairs[i].second);
           if (!s.ok()) {
-            {
-              mutex_lock l(memory_pool_mu_);
-              embedding_mem_pool_->Deallocate(
-                  insert_pairs[i].second->GetValue(0, 0));
-            }
+            embedding_mem_pool_->Deallocate(
+                insert_pairs[i].second->GetValue(0, 0));
             delete insert_pairs[i].second;
             hbm_->Get(insert_pairs[i].first, &value_ptr_list[cursor_index[i]]);
           }
@@ -651,6 +704,103 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
     }
   }
 
+  // Copies the unique ids only in DRAM to HBM on prefetch_stream_, and
+  // inserts them into HBM after their embeddings are copied. The ids
+  // promoted or committed again by the lookups in the meantime are skipped.
+  void PrefetchToHbm(const K* keys, int64 size, int64 value_len) {
+    if (embedding_mem_pool_ == nullptr) {
+      return;
+    }
+    std::vector<K> ids;
+    std::vector<ValuePtr<V>*> cpu_value_ptrs;
+    std::unordered_set<K> unique_ids;
+    for (int64 i = 0; i < size; i++) {
+      if (!unique_ids.insert(keys[i]).second) {
+        continue;
+      }
+      ValuePtr<V>* value_ptr = nullptr;
+      if (hbm_->Get(keys[i], &value_ptr).ok()) {
+        continue;
+      }
+      if (dram_->Get(keys[i], &value_ptr).ok()) {
+        ids.emplace_back(keys[i]);
+        cpu_value_ptrs.emplace_back(value_ptr);
+      }
+    }
+    int64 total = ids.size();
+    if (total == 0) {
+      return;
+    }
+
+    std::vector<ValuePtr<V>*> gpu_value_ptrs(total);
+    for (int64 i = 0; i < total; i++) {
+      gpu_value_ptrs[i] = hbm_->CreateValuePtr(value_len);
+      V* val_ptr = embedding_mem_pool_->Allocate();
+      bool flag = gpu_value_ptrs[i]->SetPtr(val_ptr);
+      if (!flag) {
+        embedding_mem_pool_->Deallocate(val_ptr);
+      }
+      memcpy((char *)gpu_value_ptrs[i]->GetPtr(),
+             (char *)cpu_value_ptrs[i]->GetPtr(),
+             sizeof(FixedLengthHeader));
+    }
+    V* memcpy_buffer_cpu = (V*)cpu_allocator()->AllocateRaw(
+        Allocator::kAllocatorAlignment, total * value_len * sizeof(V));
+    V** value_address = (V**)cpu_allocator()->AllocateRaw(
+        Allocator::kAllocatorAlignment, total * sizeof(V*));
+    V* memcpy_buffer_gpu = (V*)gpu_alloc_->AllocateRaw(
+        Allocator::kAllocatorAlignment, total * value_len * sizeof(V));
+    V** dev_value_address = (V**)gpu_alloc_->AllocateRaw(
+        Allocator::kAllocatorAlignment, total * sizeof(V*));
+    for (int64 i = 0; i < total; i++) {
+      memcpy(memcpy_buffer_cpu + i * value_len,
+             cpu_value_ptrs[i]->GetValue(0, 0), value_len * sizeof(V));
+      gpu_value_ptrs[i]->SetInitialized(0);
+      value_address[i] = gpu_value_ptrs[i]->GetValue(0, 0);
+    }
+    cudaMemcpyAsync(memcpy_buffer_gpu, memcpy_buffer_cpu,
+                    total * value_len * sizeof(V),
+                    cudaMemcpyHostToDevice, prefetch_stream_);
+    cudaMemcpyAsync(dev_value_address, value_address, total * sizeof(V*),
+                    cudaMemcpyHostToDevice, prefetch_stream_);
+    int block_dim = 128;
+    int limit = total;
+    int len = value_len;
+    void* args[] = {
+        (void*)&dev_value_address,
+        (void*)&memcpy_buffer_gpu,
+        (void*)&len,
+        (void*)&limit};
+    cudaLaunchKernel(
+        (void *)BatchUnpack<V>,
+        (total * value_len + block_dim - 1) / block_dim,
+        block_dim, args, 0, prefetch_stream_);
+    cudaStreamSynchronize(prefetch_stream_);
+
+    std::vector<V*> invalid_embeddings;
+    for (int64 i = 0; i < total; i++) {
+      ValuePtr<V>* value_ptr = nullptr;
+      bool is_stale = !dram_->Get(ids[i], &value_ptr).ok() ||
+                      value_ptr != cpu_value_ptrs[i];
+      if (is_stale || !hbm_->TryInsert(ids[i], gpu_value_ptrs[i]).ok()) {
+        invalid_embeddings.emplace_back(gpu_value_ptrs[i]->GetValue(0, 0));
+        delete gpu_value_ptrs[i];
+      }
+    }
+    if (!invalid_embeddings.empty()) {
+      for (auto val_ptr : invalid_embeddings) {
+        embedding_mem_pool_->Deallocate(val_ptr);
+      }
+    }
+    VLOG(1) << "Prefetched " << total - invalid_embeddings.size()
+            << " of " << size << " ids from DRAM to HBM.";
+
+    gpu_alloc_->DeallocateRaw(dev_value_address);
+    gpu_alloc_->DeallocateRaw(memcpy_buffer_gpu);
+    cpu_allocator()->DeallocateRaw(value_address);
+    cpu_allocator()->DeallocateRaw(memcpy_buffer_cpu);
+  }
+
   void AddCopyBackFlagToValuePtr(
       ValuePtr<V>** value_ptr, CopyBackFlag copyback_flag) {
     int64 tmp = ((int64)copyback_flag) << copyback_flag_offset_bits_;
@@ -669,7 +819,10 @@ class HbmDramStorage : public MultiTierStorage<K, V> {
   DramStorage<K, V>* dram_ = nullptr;
   EmbeddingMemoryPool<V>* embedding_mem_pool_ = nullptr;
   Allocator* gpu_alloc_;
-  mutex memory_pool_mu_; //ensure thread safety of embedding_mem_pool_
+  static const int64 kDefaultZeroCopyMaxMisses = 4096;
+  mutex prefetch_mu_;
+  std::unique_ptr<thread::ThreadPool> prefetch_thread_pool_;
+  cudaStream_t prefetch_stream_ = nullptr;
   const int copyback_flag_offset_bits_ = 60;
 };
 } // embedding
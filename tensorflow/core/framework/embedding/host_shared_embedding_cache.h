@@ -0,0 +1,317 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_HOST_SHARED_EMBEDDING_CACHE_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_HOST_SHARED_EMBEDDING_CACHE_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// The layout of the POSIX shared memory of a HostSharedEmbeddingCache:
+//  * HostSharedCacheHeader, padded to kHostSharedCacheSlotAlignment bytes.
+//  * num_slots slots of slot_bytes, in buckets of kHostSharedCacheWays
+//    slots. A slot is its seqlock sequence, odd while the slot is written,
+//    its key, version and refresh time in micros, 0 for an empty slot, and
+//    the value_len values of its row.
+struct HostSharedCacheHeader {
+  std::atomic<uint64> magic;
+  int64 num_slots;
+  int64 value_len;
+  int64 slot_bytes;
+  int32 key_bytes;
+  int32 value_bytes;
+};
+
+const uint64 kHostSharedCacheMagic = 0x31434853564543ULL;
+const int64 kHostSharedCacheSlotAlignment = 64;
+const int64 kHostSharedCacheWays = 4;
+const int64 kHostSharedCacheSlotHeaderBytes = 32;
+
+// A read cache of the rows of a remote EmbeddingVar shared by the worker
+// processes of a host: one designated writer process publishes the rows it
+// fetches from the PS, with their versions, and the others read them
+// without any lock, so a hot row is fetched once per host instead of once
+// per worker. The readers ignore the rows not refreshed by the writer
+// within the last max_staleness_us.
+//
+// The writer creates the shared memory, replacing the one of a previous
+// run, and unlinks it when destroyed. The readers attach to it lazily, and
+// again when it is replaced.
+template <class K, class V>
+class HostSharedEmbeddingCache {
+ public:
+  HostSharedEmbeddingCache(const std::string& name, int64 value_len,
+                           int64 num_slots, bool is_writer,
+                           int64 max_staleness_us)
+      : name_(name), value_len_(value_len),
+        num_buckets_(std::max<int64>(
+            (num_slots + kHostSharedCacheWays - 1) / kHostSharedCacheWays,
+            1)),
+        slot_bytes_(SlotBytes(value_len)), is_writer_(is_writer),
+        max_staleness_us_(max_staleness_us) {
+    if (is_writer_) {
+      Create();
+    }
+  }
+
+  ~HostSharedEmbeddingCache() {
+    Detach();
+    if (is_writer_ && created_) {
+      shm_unlink(name_.c_str());
+    }
+  }
+
+  // The name of the shared memory of the cache of a variable.
+  static std::string SharedMemoryName(const std::string& name_space,
+                                      const std::string& variable) {
+    return strings::StrCat("/", name_space, "_ev_",
+                           strings::Hex(Hash64(variable)));
+  }
+
+  bool is_writer() const { return is_writer_; }
+
+  // Attaches a reader to the shared memory, if not yet or if the writer
+  // replaced it, at most once per kAttachInterval calls.
+  void MaybeAttach() {
+    if (is_writer_ || (++attach_calls_ % kAttachInterval != 1)) {
+      return;
+    }
+    mutex_lock l(mu_);
+    int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (data_ != nullptr && st.st_ino == inode_)) {
+      close(fd);
+      return;
+    }
+    if (st.st_size < static_cast<int64>(sizeof(HostSharedCacheHeader))) {
+      close(fd);
+      return;
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+      return;
+    }
+    const HostSharedCacheHeader* header =
+        static_cast<const HostSharedCacheHeader*>(data);
+    if (header->magic.load(std::memory_order_acquire) !=
+            kHostSharedCacheMagic ||
+        header->value_len != value_len_ ||
+        header->slot_bytes != slot_bytes_ ||
+        header->key_bytes != sizeof(K) || header->value_bytes != sizeof(V) ||
+        st.st_size < Bytes(header->num_slots / kHostSharedCacheWays)) {
+      LOG(WARNING) << "Ignore the host shared embedding cache " << name_
+                   << ", it doesn't match the variable.";
+      munmap(data, st.st_size);
+      return;
+    }
+    DetachLocked();
+    data_ = static_cast<char*>(data);
+    bytes_ = st.st_size;
+    inode_ = st.st_ino;
+    num_buckets_ = header->num_slots / kHostSharedCacheWays;
+    VLOG(1) << "Attached to the host shared embedding cache " << name_;
+  }
+
+  // Copies the row of key to value and returns true if the writer refreshed
+  // it within max_staleness_us.
+  bool Lookup(K key, V* value, int64* version) const {
+    tf_shared_lock l(mu_);
+    if (data_ == nullptr) {
+      return false;
+    }
+    const int64 now = Env::Default()->NowMicros();
+    char* bucket = Bucket(key);
+    for (int64 way = 0; way < kHostSharedCacheWays; way++) {
+      char* slot = bucket + way * slot_bytes_;
+      const uint64 seq = Seq(slot)->load(std::memory_order_acquire);
+      if ((seq & 1) != 0 || SlotKey(slot) != static_cast<int64>(key)) {
+        continue;
+      }
+      const int64 slot_version = SlotField(slot, 2);
+      const int64 refresh_us = SlotField(slot, 3);
+      memcpy(value, SlotRow(slot), value_len_ * sizeof(V));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (Seq(slot)->load(std::memory_order_relaxed) != seq ||
+          refresh_us == 0 || now - refresh_us >= max_staleness_us_) {
+        return false;
+      }
+      *version = slot_version;
+      return true;
+    }
+    return false;
+  }
+
+  // Publishes the row of key, fetched from the PS at version. Replaces the
+  // slot least recently refreshed of its bucket. Only for the writer.
+  void Insert(K key, const V* value, int64 version) {
+    mutex_lock l(mu_);
+    if (!is_writer_ || data_ == nullptr) {
+      return;
+    }
+    char* bucket = Bucket(key);
+    char* victim = nullptr;
+    int64 oldest = kint64max;
+    for (int64 way = 0; way < kHostSharedCacheWays; way++) {
+      char* slot = bucket + way * slot_bytes_;
+      const int64 refresh_us = SlotField(slot, 3);
+      if (refresh_us != 0 && SlotKey(slot) == static_cast<int64>(key)) {
+        victim = slot;
+        break;
+      }
+      if (refresh_us < oldest) {
+        oldest = refresh_us;
+        victim = slot;
+      }
+    }
+    std::atomic<uint64>* seq = Seq(victim);
+    const uint64 s = seq->load(std::memory_order_relaxed);
+    seq->store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    SlotField(victim, 1) = static_cast<int64>(key);
+    SlotField(victim, 2) = version;
+    SlotField(victim, 3) = Env::Default()->NowMicros();
+    memcpy(SlotRow(victim), value, value_len_ * sizeof(V));
+    seq->store(s + 2, std::memory_order_release);
+  }
+
+ private:
+  static const int64 kAttachInterval = 1024;
+
+  static int64 SlotBytes(int64 value_len) {
+    const int64 bytes = kHostSharedCacheSlotHeaderBytes + value_len * sizeof(V);
+    return (bytes + kHostSharedCacheSlotAlignment - 1) /
+           kHostSharedCacheSlotAlignment * kHostSharedCacheSlotAlignment;
+  }
+
+  int64 Bytes(int64 num_buckets) const {
+    return kHostSharedCacheSlotAlignment +
+           num_buckets * kHostSharedCacheWays * slot_bytes_;
+  }
+
+  void Create() {
+    mutex_lock l(mu_);
+    shm_unlink(name_.c_str());
+    int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+      LOG(WARNING) << "Failed to create the host shared embedding cache "
+                   << name_ << ": " << strerror(errno);
+      return;
+    }
+    created_ = true;
+    const int64 bytes = Bytes(num_buckets_);
+    void* data = MAP_FAILED;
+    if (ftruncate(fd, bytes) == 0) {
+      data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+      LOG(WARNING) << "Failed to map the host shared embedding cache "
+                   << name_ << ": " << strerror(errno);
+      return;
+    }
+    data_ = static_cast<char*>(data);
+    bytes_ = bytes;
+    HostSharedCacheHeader* header =
+        reinterpret_cast<HostSharedCacheHeader*>(data_);
+    header->num_slots = num_buckets_ * kHostSharedCacheWays;
+    header->value_len = value_len_;
+    header->slot_bytes = slot_bytes_;
+    header->key_bytes = sizeof(K);
+    header->value_bytes = sizeof(V);
+    // The readers attach once the header is complete.
+    header->magic.store(kHostSharedCacheMagic, std::memory_order_release);
+    VLOG(1) << "Created the host shared embedding cache " << name_ << " of "
+            << bytes << " bytes";
+  }
+
+  void Detach() {
+    mutex_lock l(mu_);
+    DetachLocked();
+  }
+
+  void DetachLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (data_ != nullptr) {
+      munmap(data_, bytes_);
+      data_ = nullptr;
+    }
+  }
+
+  char* Bucket(K key) const SHARED_LOCKS_REQUIRED(mu_) {
+    const uint64 h = Hash64Combine(static_cast<uint64>(key),
+                                   0x9E3779B97F4A7C15ULL);
+    return data_ + kHostSharedCacheSlotAlignment +
+           (h % num_buckets_) * kHostSharedCacheWays * slot_bytes_;
+  }
+
+  static std::atomic<uint64>* Seq(char* slot) {
+    return reinterpret_cast<std::atomic<uint64>*>(slot);
+  }
+
+  static int64& SlotField(char* slot, int field) {
+    return reinterpret_cast<int64*>(slot)[field];
+  }
+
+  static int64 SlotKey(char* slot) {
+    return SlotField(slot, 1);
+  }
+
+  static V* SlotRow(char* slot) {
+    return reinterpret_cast<V*>(slot + kHostSharedCacheSlotHeaderBytes);
+  }
+
+  const std::string name_;
+  const int64 value_len_;
+  int64 num_buckets_;
+  const int64 slot_bytes_;
+  const bool is_writer_;
+  const int64 max_staleness_us_;
+  std::atomic<int64> attach_calls_{0};
+  bool created_ = false;
+
+  // Guards the mapping, not the rows.
+  mutable mutex mu_;
+  char* data_ GUARDED_BY(mu_) = nullptr;
+  int64 bytes_ GUARDED_BY(mu_) = 0;
+  ino_t inode_ GUARDED_BY(mu_) = 0;
+};
+
+template <class K, class V>
+const int64 HostSharedEmbeddingCache<K, V>::kAttachInterval;
+
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_HOST_SHARED_EMBEDDING_CACHE_H_
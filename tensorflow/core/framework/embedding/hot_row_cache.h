@@ -0,0 +1,164 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_HOT_ROW_CACHE_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_HOT_ROW_CACHE_H_
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// Worker side replica of the hottest rows of an EmbeddingVar on a PS.
+//  * Refresh keeps at most max_rows rows whose PS frequencies, read with
+//    ValuePtr::GetFreq, are at least min_freq.
+//  * Lookup serves the rows for max_staleness steps after the refresh,
+//    after that the cache is stale and all the keys miss until the next
+//    refresh.
+//  * The gradients of the served rows are summed per key by Accumulate and
+//    flushed once per max_staleness steps, so that a hot key is pushed to
+//    the PS once per window instead of once per step.
+template <class K, class V>
+class HotRowCache : public ResourceBase {
+ public:
+  explicit HotRowCache(int64 value_len) : value_len_(value_len) {}
+
+  string DebugString() const override {
+    tf_shared_lock l(mu_);
+    return strings::StrCat("HotRowCache rows: ", index_.size(),
+                           ", value_len: ", value_len_,
+                           ", refresh_step: ", refresh_step_);
+  }
+
+  int64 ValueLen() const {
+    return value_len_;
+  }
+
+  bool IsStale(int64 step, int64 max_staleness) const {
+    tf_shared_lock l(mu_);
+    return IsStaleLocked(step, max_staleness);
+  }
+
+  void Refresh(const K* keys, const V* values, const int64* freqs, int64 n,
+               int64 max_rows, int64 min_freq, int64 step) {
+    std::vector<int64> order;
+    order.reserve(n);
+    for (int64 i = 0; i < n; i++) {
+      if (freqs[i] >= min_freq) {
+        order.emplace_back(i);
+      }
+    }
+    if (max_rows > 0 && static_cast<int64>(order.size()) > max_rows) {
+      std::nth_element(order.begin(), order.begin() + max_rows, order.end(),
+                       [freqs](int64 a, int64 b) {
+                         return freqs[a] > freqs[b];
+                       });
+      order.resize(max_rows);
+    }
+    mutex_lock l(mu_);
+    index_.clear();
+    rows_.resize(order.size() * value_len_);
+    for (size_t i = 0; i < order.size(); i++) {
+      index_[keys[order[i]]] = i;
+      memcpy(rows_.data() + i * value_len_,
+             values + order[i] * value_len_, value_len_ * sizeof(V));
+    }
+    refresh_step_ = step;
+  }
+
+  // Returns false when the cache is stale, then all the keys miss. The
+  // values of the missed keys are zeros.
+  bool Lookup(const K* keys, int64 n, int64 step, int64 max_staleness,
+               V* values, bool* hits) const {
+    tf_shared_lock l(mu_);
+    bool is_stale = IsStaleLocked(step, max_staleness);
+    for (int64 i = 0; i < n; i++) {
+      V* value = values + i * value_len_;
+      auto it = is_stale ? index_.end() : index_.find(keys[i]);
+      if (it == index_.end()) {
+        hits[i] = false;
+        memset(value, 0, value_len_ * sizeof(V));
+      } else {
+        hits[i] = true;
+        memcpy(value, rows_.data() + it->second * value_len_,
+               value_len_ * sizeof(V));
+      }
+    }
+    return !is_stale;
+  }
+
+  // Sums grads into the accumulators and moves them to flush_keys and
+  // flush_grads when the window of max_staleness steps is over.
+  void Accumulate(const K* keys, const V* grads, int64 n, int64 step,
+                  int64 max_staleness, std::vector<K>* flush_keys,
+                  std::vector<V>* flush_grads) {
+    mutex_lock l(mu_);
+    if (accum_index_.empty()) {
+      accum_step_ = step;
+    }
+    for (int64 i = 0; i < n; i++) {
+      auto it = accum_index_.find(keys[i]);
+      int64 offset;
+      if (it == accum_index_.end()) {
+        offset = accum_index_.size();
+        accum_index_[keys[i]] = offset;
+        accum_.resize((offset + 1) * value_len_, static_cast<V>(0));
+      } else {
+        offset = it->second;
+      }
+      V* accum = accum_.data() + offset * value_len_;
+      const V* grad = grads + i * value_len_;
+      for (int64 j = 0; j < value_len_; j++) {
+        accum[j] += grad[j];
+      }
+    }
+    if (accum_index_.empty() || step - accum_step_ < max_staleness) {
+      return;
+    }
+    flush_keys->resize(accum_index_.size());
+    for (auto& it : accum_index_) {
+      (*flush_keys)[it.second] = it.first;
+    }
+    flush_grads->swap(accum_);
+    accum_.clear();
+    accum_index_.clear();
+  }
+
+ private:
+  bool IsStaleLocked(int64 step, int64 max_staleness) const {
+    return refresh_step_ < 0 || step - refresh_step_ >= max_staleness;
+  }
+
+  const int64 value_len_;
+  mutable mutex mu_;
+  std::unordered_map<K, int64> index_ GUARDED_BY(mu_);
+  std::vector<V> rows_ GUARDED_BY(mu_);
+  int64 refresh_step_ GUARDED_BY(mu_) = -1;
+  std::unordered_map<K, int64> accum_index_ GUARDED_BY(mu_);
+  std::vector<V> accum_ GUARDED_BY(mu_);
+  int64 accum_step_ GUARDED_BY(mu_) = 0;
+};
+
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_HOT_ROW_CACHE_H_
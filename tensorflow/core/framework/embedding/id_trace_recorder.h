@@ -0,0 +1,305 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_ID_TRACE_RECORDER_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_ID_TRACE_RECORDER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// Records the ids looked up by an EmbeddingVar, one record per lookup
+// call, to replay the access stream offline, e.g. by the tier advisor.
+// Enabled by TF_EV_ID_TRACE_DIR, which receives one file per EmbeddingVar.
+//
+// Ids are sampled by a hash of the id with TF_EV_ID_TRACE_SAMPLE_RATE
+// (default 1.0), so a sampled id keeps all its accesses: the hit ratios of
+// a cache of capacity c over the sampled trace approximate those of a cache
+// of capacity c / rate over the full one.
+//
+// A record is the number of ids as a varint, then the sorted ids as the
+// zigzag varint of the first one and the varint deltas of the others.
+// Records are appended to one of kNumBuffers buffers picked by thread,
+// which are handed to a flushing thread once they exceed
+// TF_EV_ID_TRACE_BUFFER_KB (default 1024). Records are dropped while the
+// flushing thread is kMaxPendingBuffers buffers behind, so that a slow disk
+// never stalls the lookups. The records of different threads may thus be
+// reordered by up to a buffer.
+class IdTraceRecorder {
+ public:
+  static const int kNumBuffers = 16;
+  static const int kMaxPendingBuffers = 64;
+
+  // Returns nullptr if the recording is disabled or its file can't be
+  // created.
+  static std::unique_ptr<IdTraceRecorder> Create(const std::string& name) {
+    std::string dir;
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_EV_ID_TRACE_DIR", "", &dir));
+    if (dir.empty()) {
+      return nullptr;
+    }
+    std::string rate_str;
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_EV_ID_TRACE_SAMPLE_RATE", "1.0",
+                                     &rate_str));
+    float rate = 1.0;
+    if (!strings::safe_strtof(rate_str.c_str(), &rate) || rate <= 0) {
+      LOG(WARNING) << "Invalid TF_EV_ID_TRACE_SAMPLE_RATE " << rate_str
+                   << ", the ids of " << name << " aren't recorded.";
+      return nullptr;
+    }
+    int64 buffer_kb = 1024;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_ID_TRACE_BUFFER_KB", 1024,
+                                    &buffer_kb));
+
+    std::string basename = name.empty() ? "EmbeddingVar" : name;
+    std::replace(basename.begin(), basename.end(), '/', '_');
+    std::string filename = io::JoinPath(dir, basename);
+    Env* env = Env::Default();
+    if (!env->RecursivelyCreateDir(dir).ok() ||
+        !env->CreateUniqueFileName(&filename, ".idtrace")) {
+      LOG(WARNING) << "Failed to create the id trace of " << name
+                   << " in " << dir;
+      return nullptr;
+    }
+    std::unique_ptr<WritableFile> file;
+    Status s = env->NewWritableFile(filename, &file);
+    if (s.ok()) {
+      s = file->Append(Magic());
+    }
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to create the id trace of " << name << ": "
+                   << s.ToString();
+      return nullptr;
+    }
+    LOG(INFO) << "Record the ids of " << name << " in " << filename
+              << " with sample rate " << rate;
+    buffer_kb = std::max(buffer_kb, static_cast<int64>(1));
+    return std::unique_ptr<IdTraceRecorder>(
+        new IdTraceRecorder(std::move(file), rate, buffer_kb << 10));
+  }
+
+  ~IdTraceRecorder() {
+    {
+      mutex_lock l(mu_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    flush_thread_.reset();
+    for (auto& buffer : buffers_) {
+      WriteToFile(buffer.data);
+    }
+    Status s = file_->Close();
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to close the id trace: " << s.ToString();
+    }
+    if (num_dropped_ > 0) {
+      LOG(WARNING) << num_dropped_ << " records of the id trace were dropped.";
+    }
+  }
+
+  template <class K>
+  void Record(const K* keys, int64 num_of_keys) {
+    static thread_local std::vector<int64> sampled;
+    static thread_local std::string record;
+    sampled.clear();
+    for (int64 i = 0; i < num_of_keys; i++) {
+      if (IsSampled(keys[i])) {
+        sampled.emplace_back(static_cast<int64>(keys[i]));
+      }
+    }
+    if (sampled.empty()) {
+      return;
+    }
+    std::sort(sampled.begin(), sampled.end());
+    record.clear();
+    core::PutVarint64(&record, sampled.size());
+    core::PutVarint64(&record, ZigZag(sampled[0]));
+    for (size_t i = 1; i < sampled.size(); i++) {
+      core::PutVarint64(&record, sampled[i] - sampled[i - 1]);
+    }
+
+    Buffer& buffer = buffers_[ThreadBufferIndex()];
+    std::string full;
+    {
+      mutex_lock l(buffer.mu);
+      buffer.data.append(record);
+      if (buffer.data.size() < buffer_bytes_) {
+        return;
+      }
+      full.reserve(buffer_bytes_ + record.size());
+      full.swap(buffer.data);
+    }
+    {
+      mutex_lock l(mu_);
+      if (pending_.size() >= kMaxPendingBuffers) {
+        num_dropped_++;
+        return;
+      }
+      pending_.emplace_back(std::move(full));
+    }
+    cv_.notify_one();
+  }
+
+  int64 NumDropped() const {
+    return num_dropped_;
+  }
+
+  // Reads a trace written by IdTraceRecorder, one batch of ids per record.
+  static Status ReadTrace(const std::string& filename,
+                          std::vector<std::vector<int64>>* batches) {
+    std::string content;
+    TF_RETURN_IF_ERROR(ReadFileToString(Env::Default(), filename, &content));
+    StringPiece input(content);
+    if (!IsTrace(input)) {
+      return errors::InvalidArgument(filename, " isn't an id trace.");
+    }
+    input.remove_prefix(Magic().size());
+    batches->clear();
+    while (!input.empty()) {
+      uint64 size = 0;
+      uint64 value = 0;
+      if (!core::GetVarint64(&input, &size) || size == 0 ||
+          !core::GetVarint64(&input, &value)) {
+        return errors::DataLoss("Corrupted record in ", filename);
+      }
+      std::vector<int64> batch;
+      batch.reserve(size);
+      batch.emplace_back(UnZigZag(value));
+      for (uint64 i = 1; i < size; i++) {
+        if (!core::GetVarint64(&input, &value)) {
+          return errors::DataLoss("Corrupted record in ", filename);
+        }
+        batch.emplace_back(batch.back() + static_cast<int64>(value));
+      }
+      batches->emplace_back(std::move(batch));
+    }
+    return Status::OK();
+  }
+
+  static bool IsTrace(StringPiece content) {
+    return str_util::StartsWith(content, Magic());
+  }
+
+  static StringPiece Magic() {
+    return "EVIDTRC1";
+  }
+
+ private:
+  struct Buffer {
+    mutex mu;
+    std::string data;
+  };
+
+  IdTraceRecorder(std::unique_ptr<WritableFile> file, float rate,
+                  int64 buffer_bytes)
+      : file_(std::move(file)),
+        buffer_bytes_(buffer_bytes) {
+    sample_all_ = rate >= 1.0;
+    sample_threshold_ =
+        sample_all_ ? 0 : static_cast<uint64>(std::ldexp(rate, 64));
+    flush_thread_.reset(Env::Default()->StartThread(
+        ThreadOptions(), "EVIdTraceFlush", [this]() { FlushLoop(); }));
+  }
+
+  template <class K>
+  bool IsSampled(K key) const {
+    return sample_all_ ||
+        static_cast<uint64>(key) * 0x9E3779B97F4A7C15ULL < sample_threshold_;
+  }
+
+  static uint64 ZigZag(int64 v) {
+    return (static_cast<uint64>(v) << 1) ^ static_cast<uint64>(v >> 63);
+  }
+
+  static int64 UnZigZag(uint64 v) {
+    return static_cast<int64>(v >> 1) ^ -static_cast<int64>(v & 1);
+  }
+
+  static int ThreadBufferIndex() {
+    static std::atomic<int> next_index(0);
+    static thread_local int index =
+        next_index.fetch_add(1, std::memory_order_relaxed) % kNumBuffers;
+    return index;
+  }
+
+  void FlushLoop() {
+    while (true) {
+      std::deque<std::string> pending;
+      {
+        mutex_lock l(mu_);
+        while (pending_.empty() && !stop_) {
+          cv_.wait(l);
+        }
+        if (pending_.empty()) {
+          return;
+        }
+        pending.swap(pending_);
+      }
+      for (auto& data : pending) {
+        WriteToFile(data);
+      }
+      Status s = file_->Flush();
+      if (!s.ok()) {
+        LOG(WARNING) << "Failed to flush the id trace: " << s.ToString();
+      }
+    }
+  }
+
+  void WriteToFile(const std::string& data) {
+    if (data.empty()) {
+      return;
+    }
+    Status s = file_->Append(data);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to write the id trace: " << s.ToString();
+    }
+  }
+
+  std::unique_ptr<WritableFile> file_;
+  size_t buffer_bytes_;
+  bool sample_all_;
+  uint64 sample_threshold_;
+  Buffer buffers_[kNumBuffers];
+
+  mutex mu_;
+  condition_variable cv_;
+  std::deque<std::string> pending_ GUARDED_BY(mu_);
+  bool stop_ GUARDED_BY(mu_) = false;
+  std::atomic<int64> num_dropped_{0};
+  // Declared last so that the flushing thread is started after, and joined
+  // before, the other members are destroyed.
+  std::unique_ptr<Thread> flush_thread_;
+};
+
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_ID_TRACE_RECORDER_H_
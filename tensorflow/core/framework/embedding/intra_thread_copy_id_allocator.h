@@ -15,9 +15,11 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_INTRA_THREAD_COPY_ID_ALLOCATOR_H_
 #define TENSORFLOW_CORE_FRAMEWORK_INTRA_THREAD_COPY_ID_ALLOCATOR_H_
 
+#include "tensorflow/core/framework/embedding/lock_contention.h"
 #include "tensorflow/core/lib/core/spin_rw_lock.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/types.h"
+#include <atomic>
 #include <iostream>
 #include <map>
 #include <memory>
@@ -26,7 +28,8 @@ namespace tensorflow{
 // Allocate a copy id for each thread
 class IntraThreadCopyIdAllocator {
  public:
-  IntraThreadCopyIdAllocator(int num_threads): num_worker_threads_(num_threads) {
+  IntraThreadCopyIdAllocator(int num_threads)
+      : num_worker_threads_(num_threads), allocator_id_(NextAllocatorId()) {
     is_occupy_flag_.reset(new bool[num_worker_threads_]);
     memset(is_occupy_flag_.get(), 0, sizeof(bool) * num_worker_threads_);
   }
@@ -35,34 +38,66 @@ class IntraThreadCopyIdAllocator {
     uint64 thread_id = Env::Default()->GetCurrentThreadId();
     if (thread_id == main_thread_id) {
       return num_worker_threads_;
-    } else {
-      int copy_id = -1;
-      {
-        spin_rd_lock l(mu_);
-        auto iter = hash_map_.find(thread_id);
-        if (iter != hash_map_.end()) {
-          copy_id = iter->second;
-          return copy_id;
-        }
-      }
-      if (copy_id == -1) {
-        // bind a new thread to a local cursor_list
-        copy_id = thread_id % num_worker_threads_;
-        while (!__sync_bool_compare_and_swap(
-            &(is_occupy_flag_[copy_id]), false, true)) {
-          copy_id = (copy_id + 1) % num_worker_threads_;
-        }
-        {
-          spin_wr_lock l(mu_);
-          hash_map_.insert(std::pair<uint64, int64>(thread_id, copy_id));
-        }
-        return copy_id;
-      }
     }
+    // The copy id a thread got is kept in a thread local slot tagged with
+    // the id of the allocator, so that only the first call of a thread on
+    // an allocator, or one after a collision, goes to the shared map.
+    CachedCopyId& cached =
+        ThreadLocalCopyIds()[allocator_id_ % kNumCachedCopyIds];
+    if (cached.allocator_id == allocator_id_) {
+      return cached.copy_id;
+    }
+    int64 copy_id = GetCopyIdFromMap(thread_id);
+    cached.allocator_id = allocator_id_;
+    cached.copy_id = copy_id;
+    return copy_id;
   }
 
  private:
+  static constexpr int kNumCachedCopyIds = 8;
+
+  struct CachedCopyId {
+    uint64 allocator_id = 0;
+    int64 copy_id = -1;
+  };
+
+  static uint64 NextAllocatorId() {
+    static std::atomic<uint64> next_allocator_id(1);
+    return next_allocator_id.fetch_add(1);
+  }
+
+  static CachedCopyId* ThreadLocalCopyIds() {
+    static thread_local CachedCopyId copy_ids[kNumCachedCopyIds];
+    return copy_ids;
+  }
+
+  int64 GetCopyIdFromMap(uint64 thread_id) {
+    {
+      embedding::profiled_spin_rd_lock l(
+          mu_, LOCK_CONTENTION_SITE("intra_thread_copy_id_allocator"));
+      auto iter = hash_map_.find(thread_id);
+      if (iter != hash_map_.end()) {
+        return iter->second;
+      }
+    }
+    // bind a new thread to a local cursor_list
+    int64 copy_id = thread_id % num_worker_threads_;
+    while (!__sync_bool_compare_and_swap(
+        &(is_occupy_flag_[copy_id]), false, true)) {
+      copy_id = (copy_id + 1) % num_worker_threads_;
+    }
+    {
+      embedding::profiled_spin_wr_lock l(
+          mu_, LOCK_CONTENTION_SITE("intra_thread_copy_id_allocator"));
+      hash_map_.insert(std::pair<uint64, int64>(thread_id, copy_id));
+    }
+    return copy_id;
+  }
+
   int num_worker_threads_;
+  // Unique over the process, so the slots cached for a destroyed allocator
+  // never match a new one.
+  const uint64 allocator_id_;
   std::unique_ptr<bool[]> is_occupy_flag_;
   std::map<uint64, int64> hash_map_;
   mutable easy_spinrwlock_t mu_ = EASY_SPINRWLOCK_INITIALIZER;
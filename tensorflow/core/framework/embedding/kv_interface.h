@@ -56,6 +56,7 @@ class KVInterface {
   virtual Status Insert(K key, const ValuePtr<V>* value_ptr) = 0;
   virtual Status Remove(K key) = 0;
 
+  // KV Batch Lookup, value_ptrs[i] is set to nullptr if keys[i] is missing
   virtual Status BatchLookup(const K* keys, size_t size,
                              ValuePtr<V>** value_ptrs) {
     return Status(error::Code::UNIMPLEMENTED,
@@ -85,6 +86,9 @@ class KVInterface {
   // KV Size
   virtual int64 Size() const = 0;
 
+  // Pre-sizes the KV for num_keys keys, before they are inserted.
+  virtual void Reserve(int64 num_keys) {}
+
   virtual void SetTotalDims(int total_dims) {}
 
   virtual void FreeValuePtr(ValuePtr<V>* value_ptr) {}
@@ -96,6 +100,16 @@ class KVInterface {
   virtual Status GetSnapshot(std::vector<K>* key_list,
       std::vector<ValuePtr<V>*>* value_ptr_list) = 0;
 
+  // The number of slices GetSnapshotSlice splits the KV into.
+  virtual int64 NumSnapshotSlices() const { return 1; }
+
+  // Appends the keys and values of the 'slice'th slice of the KV, so that
+  // a scan of the KV can be spread over calls.
+  virtual Status GetSnapshotSlice(int64 slice, std::vector<K>* key_list,
+      std::vector<ValuePtr<V>*>* value_ptr_list) {
+    return GetSnapshot(key_list, value_ptr_list);
+  }
+
   virtual std::string DebugString() const = 0;
 
   virtual Iterator* GetIterator() { return nullptr; }
@@ -106,7 +120,8 @@ class KVInterface {
     return Status::OK();
   }
   virtual Status BatchLookupOrCreateKeys(const K* keys, size_t n,
-      int32* item_idxs, const Eigen::GpuDevice& device) {
+      int32* item_idxs, const Eigen::GpuDevice& device,
+      int64 update_version) {
     return Status::OK();
   }
 
@@ -48,6 +48,15 @@ class L2WeightShrinkPolicy : public ShrinkPolicy<K, V> {
                    key_list, value_list);
   }
 
+  void IncrementalShrink(const ShrinkArgs& shrink_args,
+                         int64 max_keys) override {
+    std::vector<K> key_list;
+    std::vector<ValuePtr<V>*> value_list;
+    ShrinkPolicy<K, V>::NextKeys(kv_, max_keys, &key_list, &value_list);
+    FilterToDelete(shrink_args.value_len,
+                   key_list, value_list);
+  }
+
  private:
   void FilterToDelete(int64 value_len,
                       const std::vector<K>& key_list,
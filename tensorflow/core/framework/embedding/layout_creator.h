@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/core/framework/embedding/config.pb.h"
 #include "tensorflow/core/framework/embedding/storage_config.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 template <class V>
@@ -71,6 +72,33 @@ class CompactLayoutCreator : public LayoutCreator<V> {
   }
 };
 
+// TF_EV_QUANTIZATION_BLOCK_SIZE values share one scale of INT8 rows, 0
+// means one scale per row.
+template<typename V>
+class QuantizedLayoutCreator : public LayoutCreator<V> {
+ public:
+  explicit QuantizedLayoutCreator(RowQuantization type) : type_(type) {
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_QUANTIZATION_BLOCK_SIZE", 0,
+                                    &block_size_));
+  }
+
+  ValuePtr<V>* Create(Allocator* alloc, size_t size) override {
+    return new QuantizedValuePtr<V>(alloc, size, type_, block_size_);
+  }
+
+ private:
+  RowQuantization type_;
+  int64 block_size_ = 0;
+};
+
+template<typename V>
+class MixedDimLayoutCreator : public LayoutCreator<V> {
+ public:
+  ValuePtr<V>* Create(Allocator* alloc, size_t size) override {
+    return new MixedDimValuePtr<V>(alloc, size);
+  }
+};
+
 class LayoutCreatorFactory {
  public:
   template<typename V>
@@ -92,6 +120,17 @@ class LayoutCreatorFactory {
       case LayoutType::COMPACT:
         static CompactLayoutCreator<V> compact_creator;
         return &compact_creator;
+      case LayoutType::QUANTIZED_INT8:
+        static QuantizedLayoutCreator<V>
+                   quantized_int8_creator(RowQuantization::INT8);
+        return &quantized_int8_creator;
+      case LayoutType::QUANTIZED_FP16:
+        static QuantizedLayoutCreator<V>
+                   quantized_fp16_creator(RowQuantization::FP16);
+        return &quantized_fp16_creator;
+      case LayoutType::MIXED_DIM:
+        static MixedDimLayoutCreator<V> mixed_dim_creator;
+        return &mixed_dim_creator;
       default:
         static NormalLayoutCreator<V> default_creator;
         return &default_creator;
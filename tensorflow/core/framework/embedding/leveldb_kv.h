@@ -22,10 +22,13 @@ limitations under the License.
 #include "tensorflow/core/framework/embedding/value_ptr.h"
 #include "tensorflow/core/lib/core/status.h"
 
+#include "leveldb/cache.h"
 #include "leveldb/db.h"
 #include "leveldb/comparator.h"
+#include "leveldb/filter_policy.h"
 #include "leveldb/write_batch.h"
 
+#include <algorithm>
 #include <sstream>
 
 using leveldb::DB;
@@ -115,10 +118,20 @@ class DBIterator : public Iterator {
 template <class K, class V>
 class LevelDBKV : public KVInterface<K, V> {
  public:
-  LevelDBKV(std::string path) {
+  LevelDBKV(std::string path, int64 block_cache_size = 0,
+            int64 bloom_bits_per_key = 0)
+      : block_cache_(nullptr), filter_policy_(nullptr) {
     path_ = io::JoinPath(path,
         "level_db_" + std::to_string(Env::Default()->NowMicros()));;
     options_.create_if_missing = true;
+    if (block_cache_size > 0) {
+      block_cache_ = leveldb::NewLRUCache(block_cache_size);
+      options_.block_cache = block_cache_;
+    }
+    if (bloom_bits_per_key > 0) {
+      filter_policy_ = leveldb::NewBloomFilterPolicy(bloom_bits_per_key);
+      options_.filter_policy = filter_policy_;
+    }
     leveldb::Status s = leveldb::DB::Open(options_, path_, &db_);
     CHECK(s.ok());
     counter_ =  new SizeCounter<K>(8);
@@ -134,6 +147,8 @@ class LevelDBKV : public KVInterface<K, V> {
 
   ~LevelDBKV() override {
     delete db_;
+    delete block_cache_;
+    delete filter_policy_;
   }
 
   Status Lookup(K key, ValuePtr<V>** value_ptr) override {
@@ -152,6 +167,32 @@ class LevelDBKV : public KVInterface<K, V> {
     }
   }
 
+  // Reads the keys in the order of the DB, so that the keys of a block are
+  // read while it is cached. value_ptrs[i] is set to nullptr if keys[i] is
+  // not found.
+  void BatchLookup(const K* keys, ValuePtr<V>** value_ptrs,
+                   int64 num_of_keys) {
+    std::vector<int64> order(num_of_keys);
+    for (int64 i = 0; i < num_of_keys; i++) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [keys] (int64 a, int64 b) {
+      return memcmp(&keys[a], &keys[b], sizeof(K)) < 0;
+    });
+    leveldb::ReadOptions options;
+    std::string val_str;
+    for (int64 i : order) {
+      leveldb::Slice db_key((char*)(&keys[i]), sizeof(void*));
+      if (db_->Get(options, db_key, &val_str).ok()) {
+        value_ptrs[i] = new_value_ptr_fn_(total_dims_);
+        memcpy((int64 *)(value_ptrs[i]->GetPtr()),
+               &val_str[0], val_str.length());
+      } else {
+        value_ptrs[i] = nullptr;
+      }
+    }
+  }
+
   Status Contains(K key) override {
     std::string val_str;
     leveldb::Slice db_key((char*)(&key), sizeof(void*));
@@ -177,15 +218,29 @@ class LevelDBKV : public KVInterface<K, V> {
 
   Status BatchCommit(const std::vector<K>& keys,
       const std::vector<ValuePtr<V>*>& value_ptrs) override {
-    WriteBatch batch;
+    Status s = BatchWrite(keys.data(), value_ptrs.data(), keys.size());
     for (int i = 0; i < keys.size(); i++) {
-      std::string value_res((char*)value_ptrs[i]->GetPtr(),
-          sizeof(FixedLengthHeader) + total_dims_ * sizeof(V));
-      leveldb::Slice db_key((char*)(&keys[i]), sizeof(void*));
-      batch.Put(db_key, value_res);
       delete value_ptrs[i];
     }
-    db_->Write(WriteOptions(),&batch);
+    return s;
+  }
+
+  // Writes the values of the keys in one WriteBatch, i.e. with one write
+  // to the log. The value_ptrs stay owned by the caller.
+  Status BatchWrite(const K* keys, ValuePtr<V>* const* value_ptrs,
+                    int64 num_of_keys) {
+    WriteBatch batch;
+    for (int64 i = 0; i < num_of_keys; i++) {
+      leveldb::Slice db_key((char*)(&keys[i]), sizeof(void*));
+      leveldb::Slice value((char*)value_ptrs[i]->GetPtr(),
+          sizeof(FixedLengthHeader) + total_dims_ * sizeof(V));
+      batch.Put(db_key, value);
+    }
+    leveldb::Status s = db_->Write(WriteOptions(), &batch);
+    if (!s.ok()) {
+      return errors::Internal("Failed to write ", num_of_keys,
+                              " keys to LevelDB: ", s.ToString());
+    }
     return Status::OK();
   }
 
@@ -242,6 +297,8 @@ class LevelDBKV : public KVInterface<K, V> {
   DB* db_;
   SizeCounter<K>* counter_;
   Options options_;
+  leveldb::Cache* block_cache_;
+  const leveldb::FilterPolicy* filter_policy_;
   std::string path_;
   std::function<ValuePtr<V>*(size_t)> new_value_ptr_fn_;
   int total_dims_;
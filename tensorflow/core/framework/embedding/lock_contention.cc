@@ -0,0 +1,181 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#include "tensorflow/core/framework/embedding/lock_contention.h"
+
+#include <algorithm>
+#include <set>
+
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace embedding {
+
+namespace {
+
+// The lock of the site named <lock>@<file>:<line>.
+std::string LockName(const std::string& site) {
+  return site.substr(0, site.find('@'));
+}
+
+}  // namespace
+
+LockContention* LockContention::Global() {
+  static LockContention* profiler = []() -> LockContention* {
+    bool enabled = false;
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_LOCK_CONTENTION_PROFILING", false,
+                                   &enabled));
+    if (!enabled) {
+      return nullptr;
+    }
+    LOG(INFO) << "Profiling the contention of the embedding locks.";
+    return new LockContention();
+  }();
+  return profiler;
+}
+
+LockContention::Site* LockContention::GetGlobalSite(const char* lock,
+                                                    const char* file,
+                                                    int line) {
+  LockContention* profiler = Global();
+  return profiler == nullptr ? nullptr : profiler->GetSite(lock, file, line);
+}
+
+LockContention::Site* LockContention::GetSite(const char* lock,
+                                              const char* file, int line) {
+  const std::string name =
+      strings::StrCat(lock, "@", io::Basename(file), ":", line);
+  mutex_lock l(mu_);
+  std::unique_ptr<Site>& site = sites_[name];
+  if (site == nullptr) {
+    site.reset(new Site(name));
+  }
+  return site.get();
+}
+
+std::vector<LockContention::Snapshot> LockContention::Snapshots() const {
+  std::vector<Snapshot> snapshots;
+  {
+    mutex_lock l(mu_);
+    snapshots.reserve(sites_.size());
+    for (const auto& it : sites_) {
+      const Site& site = *it.second;
+      snapshots.push_back(
+          {site.name, site.acquisitions.load(std::memory_order_relaxed),
+           site.contentions.load(std::memory_order_relaxed),
+           site.wait_micros.load(std::memory_order_relaxed),
+           site.hold_micros.load(std::memory_order_relaxed)});
+    }
+  }
+  std::stable_sort(snapshots.begin(), snapshots.end(),
+                   [](const Snapshot& a, const Snapshot& b) {
+                     return a.wait_micros > b.wait_micros;
+                   });
+  return snapshots;
+}
+
+void LockContention::Append(std::vector<std::string>* names,
+                            std::vector<double>* values) const {
+  auto append = [names, values](const std::string& name, double value) {
+    names->emplace_back(name);
+    values->emplace_back(value);
+  };
+  mutex_lock l(mu_);
+  // The locks some site waited for, whose holders are all of their sites.
+  std::set<std::string> contended_locks;
+  for (const auto& it : sites_) {
+    if (it.second->contentions.load(std::memory_order_relaxed) > 0) {
+      contended_locks.insert(LockName(it.first));
+    }
+  }
+  for (const auto& it : sites_) {
+    if (contended_locks.count(LockName(it.first)) == 0) {
+      continue;
+    }
+    const Site& site = *it.second;
+    const std::string prefix = strings::StrCat("lock/", site.name, "/");
+    append(prefix + "acquisitions",
+           site.acquisitions.load(std::memory_order_relaxed));
+    append(prefix + "contentions",
+           site.contentions.load(std::memory_order_relaxed));
+    append(prefix + "wait_micros",
+           site.wait_micros.load(std::memory_order_relaxed));
+    append(prefix + "hold_micros",
+           site.hold_micros.load(std::memory_order_relaxed));
+    for (int b = 0; b < kNumBuckets; ++b) {
+      const int64 waits = site.wait_buckets[b].load(std::memory_order_relaxed);
+      if (waits > 0) {
+        append(strings::StrCat(prefix, "wait_bucket_", b), waits);
+      }
+      const int64 holds = site.hold_buckets[b].load(std::memory_order_relaxed);
+      if (holds > 0) {
+        append(strings::StrCat(prefix, "hold_bucket_", b), holds);
+      }
+    }
+  }
+}
+
+std::string LockContention::Summary() const {
+  std::string summary;
+  for (const Snapshot& s : Snapshots()) {
+    if (s.contentions == 0) {
+      continue;
+    }
+    strings::StrAppend(&summary, s.name, ": waited ", s.wait_micros,
+                       "us in ", s.contentions, " of ", s.acquisitions,
+                       " acquisitions, held ", s.hold_micros, "us\n");
+  }
+  return summary;
+}
+
+void LockContention::AddStepStats(const std::vector<Snapshot>& before,
+                                  int64 start_micros,
+                                  StepStats* step_stats) const {
+  std::map<std::string, const Snapshot*> previous;
+  for (const Snapshot& s : before) {
+    previous[s.name] = &s;
+  }
+  DeviceStepStats* device_stats = nullptr;
+  for (Snapshot s : Snapshots()) {
+    auto it = previous.find(s.name);
+    if (it != previous.end()) {
+      s.acquisitions -= it->second->acquisitions;
+      s.contentions -= it->second->contentions;
+      s.wait_micros -= it->second->wait_micros;
+      s.hold_micros -= it->second->hold_micros;
+    }
+    if (s.contentions == 0) {
+      continue;
+    }
+    if (device_stats == nullptr) {
+      device_stats = step_stats->add_dev_stats();
+      device_stats->set_device("/lock_contention");
+    }
+    NodeExecStats* node_stats = device_stats->add_node_stats();
+    node_stats->set_node_name(s.name);
+    node_stats->set_all_start_micros(start_micros);
+    node_stats->set_op_end_rel_micros(s.wait_micros);
+    node_stats->set_all_end_rel_micros(s.wait_micros);
+    node_stats->set_timeline_label(strings::StrCat(
+        s.name, " = waited ", s.wait_micros, "us in ", s.contentions, " of ",
+        s.acquisitions, " acquisitions, held ", s.hold_micros, "us"));
+  }
+}
+
+}  // namespace embedding
+}  // namespace tensorflow
@@ -0,0 +1,265 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_LOCK_CONTENTION_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_LOCK_CONTENTION_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/step_stats.pb.h"
+#include "tensorflow/core/lib/core/spin_rw_lock.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// Profiles the contention of the locks of the embedding subsystem, e.g.
+// the locks of the caches, of the EvictionManager and of the
+// IntraThreadCopyIdAllocator. Each call site locking one of them records
+// how often it acquired the lock, how often it had to wait for it, how long
+// it waited and how long it held it, the waits and holds in histograms of
+// power of two microseconds. The holders of a contended lock are the sites
+// with the longest holds of the same lock.
+//
+// Enabled by the environment variable TF_LOCK_CONTENTION_PROFILING. The
+// sites are exported by the EVGetStats op, as lock/<site>/<counter>, and
+// as the DeviceStepStats of the device /lock_contention of the RunMetadata
+// of a traced step.
+class LockContention {
+ public:
+  enum : int { kNumBuckets = 16 };
+
+  // The contention of a call site, named <lock>@<file>:<line>.
+  class Site {
+   public:
+    explicit Site(const std::string& name) : name(name) {}
+
+    // Records an acquisition which waited wait_nanos if contended.
+    void RecordAcquisition(bool contended, uint64 wait_nanos) {
+      acquisitions.fetch_add(1, std::memory_order_relaxed);
+      if (contended) {
+        contentions.fetch_add(1, std::memory_order_relaxed);
+        const int64 micros = wait_nanos / 1000;
+        wait_micros.fetch_add(micros, std::memory_order_relaxed);
+        wait_buckets[Bucket(micros)].fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    void RecordHold(uint64 hold_nanos) {
+      const int64 micros = hold_nanos / 1000;
+      hold_micros.fetch_add(micros, std::memory_order_relaxed);
+      hold_buckets[Bucket(micros)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The bucket of micros: 0 for less than 1us, b for [2^(b-1), 2^b)us,
+    // the last one for longer.
+    static int Bucket(int64 micros) {
+      int bucket = 0;
+      while (micros > 0 && bucket < kNumBuckets - 1) {
+        micros >>= 1;
+        ++bucket;
+      }
+      return bucket;
+    }
+
+    const std::string name;
+    std::atomic<int64> acquisitions{0};
+    std::atomic<int64> contentions{0};
+    std::atomic<int64> wait_micros{0};
+    std::atomic<int64> hold_micros{0};
+    std::atomic<int64> wait_buckets[kNumBuckets] = {};
+    std::atomic<int64> hold_buckets[kNumBuckets] = {};
+  };
+
+  // A snapshot of the counters of a site.
+  struct Snapshot {
+    std::string name;
+    int64 acquisitions;
+    int64 contentions;
+    int64 wait_micros;
+    int64 hold_micros;
+  };
+
+  LockContention() {}
+
+  // Returns null unless enabled.
+  static LockContention* Global();
+
+  // Returns the site of the lock at file:line of the global profiler, or
+  // null unless enabled. Use LOCK_CONTENTION_SITE to look it up once.
+  static Site* GetGlobalSite(const char* lock, const char* file, int line);
+
+  // Returns the site of the lock at file:line, created on its first call
+  // and never deleted.
+  Site* GetSite(const char* lock, const char* file, int line);
+
+  // The sites by decreasing wait.
+  std::vector<Snapshot> Snapshots() const;
+
+  // Appends the counters of the sites of the locks some site waited for to
+  // names and values.
+  void Append(std::vector<std::string>* names,
+              std::vector<double>* values) const;
+
+  // Formats the sites which waited, by decreasing wait.
+  std::string Summary() const;
+
+  // Adds the sites which waited since the snapshots before, taken at
+  // start_micros, to step_stats as the nodes of the device
+  // /lock_contention, each lasting the time it waited.
+  void AddStepStats(const std::vector<Snapshot>& before, int64 start_micros,
+                    StepStats* step_stats) const;
+
+ private:
+  mutable mutex mu_;
+  std::map<std::string, std::unique_ptr<Site>> sites_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(LockContention);
+};
+
+// The site of the calling line for the lock, or null unless the profiling
+// is enabled. Looked up once per line, lock must be a string literal.
+#define LOCK_CONTENTION_SITE(lock)                                    \
+  ([]() -> ::tensorflow::embedding::LockContention::Site* {           \
+    static ::tensorflow::embedding::LockContention::Site* site =      \
+        ::tensorflow::embedding::LockContention::GetGlobalSite(       \
+            lock, __FILE__, __LINE__);                                \
+    return site;                                                      \
+  }())
+
+namespace lock_contention_internal {
+
+// Acquires a lock with try_lock and lock, recording the acquisition on
+// site unless null. Returns the time it was acquired at.
+template <typename TryLock, typename Lock>
+uint64 Acquire(LockContention::Site* site, TryLock try_lock, Lock lock) {
+  if (site == nullptr) {
+    lock();
+    return 0;
+  }
+  if (try_lock()) {
+    site->RecordAcquisition(false, 0);
+    return Env::Default()->NowNanos();
+  }
+  const uint64 start = Env::Default()->NowNanos();
+  lock();
+  const uint64 acquired = Env::Default()->NowNanos();
+  site->RecordAcquisition(true, acquired - start);
+  return acquired;
+}
+
+inline void Release(LockContention::Site* site, uint64 acquired) {
+  if (site != nullptr) {
+    site->RecordHold(Env::Default()->NowNanos() - acquired);
+  }
+}
+
+}  // namespace lock_contention_internal
+
+// Like mutex_lock, for a tensorflow::mutex or a std::mutex, recording the
+// contention of the lock on site unless null.
+template <typename Mutex>
+class SCOPED_LOCKABLE profiled_lock {
+ public:
+  profiled_lock(Mutex& mu, LockContention::Site* site)
+      EXCLUSIVE_LOCK_FUNCTION(mu)
+      : mu_(&mu), site_(site) {
+    acquired_ = lock_contention_internal::Acquire(
+        site_, [this]() { return mu_->try_lock(); },
+        [this]() { mu_->lock(); });
+  }
+
+  profiled_lock(profiled_lock&& l) noexcept EXCLUSIVE_LOCK_FUNCTION(l.mu_)
+      : mu_(l.mu_), site_(l.site_), acquired_(l.acquired_) {
+    l.mu_ = nullptr;
+  }
+
+  ~profiled_lock() UNLOCK_FUNCTION() {
+    if (mu_ != nullptr) {
+      lock_contention_internal::Release(site_, acquired_);
+      mu_->unlock();
+    }
+  }
+
+ private:
+  Mutex* mu_;
+  LockContention::Site* site_;
+  uint64 acquired_;
+};
+
+typedef profiled_lock<mutex> profiled_mutex_lock;
+
+// Like spin_rd_lock, recording the contention of the lock on site unless
+// null.
+class profiled_spin_rd_lock {
+ public:
+  profiled_spin_rd_lock(easy_spinrwlock_t& lock, LockContention::Site* site)
+      : lock_(&lock), site_(site) {
+    acquired_ = lock_contention_internal::Acquire(
+        site_,
+        [this]() { return easy_spinrwlock_try_rdlock(lock_) == EASY_OK; },
+        [this]() { easy_spinrwlock_rdlock(lock_); });
+  }
+
+  ~profiled_spin_rd_lock() {
+    lock_contention_internal::Release(site_, acquired_);
+    easy_spinrwlock_unlock(lock_);
+  }
+
+ private:
+  easy_spinrwlock_t* lock_;
+  LockContention::Site* site_;
+  uint64 acquired_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(profiled_spin_rd_lock);
+};
+
+// Like spin_wr_lock, recording the contention of the lock on site unless
+// null.
+class profiled_spin_wr_lock {
+ public:
+  profiled_spin_wr_lock(easy_spinrwlock_t& lock, LockContention::Site* site)
+      : lock_(&lock), site_(site) {
+    acquired_ = lock_contention_internal::Acquire(
+        site_,
+        [this]() { return easy_spinrwlock_try_wrlock(lock_) == EASY_OK; },
+        [this]() { easy_spinrwlock_wrlock(lock_); });
+  }
+
+  ~profiled_spin_wr_lock() {
+    lock_contention_internal::Release(site_, acquired_);
+    easy_spinrwlock_unlock(lock_);
+  }
+
+ private:
+  easy_spinrwlock_t* lock_;
+  LockContention::Site* site_;
+  uint64 acquired_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(profiled_spin_wr_lock);
+};
+
+}  // namespace embedding
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_LOCK_CONTENTION_H_
@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "sparsehash/dense_hash_map_lockless"
 #include "tensorflow/core/framework/embedding/batch.h"
+#include "tensorflow/core/framework/embedding/epoch_reclaimer.h"
 #include "tensorflow/core/framework/embedding/kv_interface.h"
 #include "tensorflow/core/framework/embedding/value_ptr.h"
 #include "tensorflow/core/lib/core/status.h"
@@ -34,7 +35,10 @@ namespace embedding {
 template <class K, class V>
 class LocklessHashMapCPU : public KVInterface<K, V> {
  public:
-  LocklessHashMapCPU(Allocator* gpu_alloc): gpu_alloc_(gpu_alloc) {
+  // The rows committed from GPU are allocated by cpu_alloc.
+  LocklessHashMapCPU(Allocator* gpu_alloc,
+                     Allocator* cpu_alloc = ev_allocator())
+      : gpu_alloc_(gpu_alloc), cpu_alloc_(cpu_alloc) {
     hash_map_.max_load_factor(0.8);
     hash_map_.set_empty_key_and_value(EMPTY_KEY_, nullptr);
     hash_map_.set_counternum(16);
@@ -99,19 +103,17 @@ class LocklessHashMapCPU : public KVInterface<K, V> {
     total_dims_ = total_dims;
   }
 
-  void AppendToValuePtrQueue(ValuePtr<V>* old_value_ptr) {
-    //A parameter that can be adjusted in the future
-    if (value_ptr_out_of_date_.size() > CAP_INVALID_VALUEPTR) {
-      ValuePtr<V>* value_ptr = value_ptr_out_of_date_.front();
-      delete value_ptr;
-      value_ptr_out_of_date_.pop_front();
-    }
-    value_ptr_out_of_date_.emplace_back(old_value_ptr);
+  // Deletes a ValuePtr replaced by a commit once the lookups which may have
+  // read it are done.
+  void RetireValuePtr(ValuePtr<V>* old_value_ptr) {
+    EpochReclaimer::Global()->Retire([old_value_ptr]() {
+      delete old_value_ptr;
+    });
   }
 
   Status Commit(K key, const ValuePtr<V>* value_ptr) override {
     ValuePtr<V>* cpu_value_ptr =
-      new NormalContiguousValuePtr<V>(ev_allocator(), total_dims_);
+      new NormalContiguousValuePtr<V>(cpu_alloc_, total_dims_);
     cudaMemcpy((char *)cpu_value_ptr->GetPtr() + sizeof(FixedLengthHeader),
                *(char **)((char*)value_ptr->GetPtr() + sizeof(FixedLengthHeader)),
                total_dims_ * sizeof(V),
@@ -122,8 +124,9 @@ class LocklessHashMapCPU : public KVInterface<K, V> {
         std::pair<K, ValuePtr<V>*>(key,
             const_cast<ValuePtr<V>*>(cpu_value_ptr))));
     if ((*(iter.first)).second != cpu_value_ptr) {
-      AppendToValuePtrQueue((*(iter.first)).second);
+      ValuePtr<V>* old_value_ptr = (*(iter.first)).second;
       (*(iter.first)).second = cpu_value_ptr;
+      RetireValuePtr(old_value_ptr);
     }
     return Status::OK();
   }
@@ -174,7 +177,7 @@ class LocklessHashMapCPU : public KVInterface<K, V> {
     // Copy data to ValuePtrs in memory;Insert it into hashmap
     for(int i = 0; i < batch_size; ++i) {
       ValuePtr<V>* cpu_value_ptr =
-        new NormalContiguousValuePtr<V>(ev_allocator(), total_dims_);
+        new NormalContiguousValuePtr<V>(cpu_alloc_, total_dims_);
       memcpy((char *)cpu_value_ptr->GetPtr() + sizeof(FixedLengthHeader),
           &batch_data_place[i * total_dims_], total_dims_ * sizeof(V));
       memcpy((char *)cpu_value_ptr->GetPtr(),
@@ -183,8 +186,9 @@ class LocklessHashMapCPU : public KVInterface<K, V> {
         std::pair<K, ValuePtr<V>*>(keys[i],
             const_cast<ValuePtr<V>*>(cpu_value_ptr))));
       if ((*(iter.first)).second != cpu_value_ptr) {
-        AppendToValuePtrQueue((*(iter.first)).second);
+        ValuePtr<V>* old_value_ptr = (*(iter.first)).second;
         (*(iter.first)).second = cpu_value_ptr;
+        RetireValuePtr(old_value_ptr);
       }
     }
 
@@ -229,11 +233,10 @@ class LocklessHashMapCPU : public KVInterface<K, V> {
     LockLessHashMap;
   static const int EMPTY_KEY_ = -1;
   static const int DELETED_KEY_ = -2;
-  static constexpr int CAP_INVALID_VALUEPTR = 200000;
   LockLessHashMap hash_map_;
-  std::deque<ValuePtr<V>*> value_ptr_out_of_date_;
   int total_dims_;
   Allocator* gpu_alloc_;
+  Allocator* cpu_alloc_;
   cudaEvent_t is_finish_;
 };
 }  // namespace embedding
@@ -0,0 +1,249 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_MMAP_KV_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_MMAP_KV_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/embedding/kv_interface.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// The layout of the files served by MmapKV, all the sections are aligned
+// to kMmapKVAlignment bytes:
+//  * MmapKVHeader.
+//  * num_keys keys in the Eytzinger order of the sorted keys, the key at
+//    position i is the node i + 1 of an implicit binary search tree whose
+//    node j has the children 2j and 2j + 1.
+//  * num_keys rows of value_len values in the order of the keys.
+struct MmapKVHeader {
+  uint64 magic;
+  int64 num_keys;
+  int64 value_len;
+  int32 key_bytes;
+  int32 value_bytes;
+  int64 keys_offset;
+  int64 values_offset;
+};
+
+const uint64 kMmapKVMagic = 0x31564b70616d6d45ULL;
+const int64 kMmapKVAlignment = 64;
+
+inline int64 MmapKVAlign(int64 offset) {
+  return (offset + kMmapKVAlignment - 1) / kMmapKVAlignment *
+         kMmapKVAlignment;
+}
+
+// Writes the rows of keys to path in the layout of MmapKV, rows[i] is the
+// value_len values of keys[i]. The keys should be unique.
+template <class K, class V>
+Status WriteMmapKVFile(Env* env, const std::string& path,
+                       const std::vector<K>& keys,
+                       const std::vector<const V*>& rows,
+                       int64 value_len) {
+  const int64 n = keys.size();
+  std::vector<int64> sorted(n);
+  std::iota(sorted.begin(), sorted.end(), 0);
+  std::sort(sorted.begin(), sorted.end(),
+            [&keys](int64 a, int64 b) { return keys[a] < keys[b]; });
+  // In order traversal of the implicit tree assigns the sorted keys.
+  std::vector<int64> order(n);
+  int64 next = 0;
+  std::vector<int64> stack;
+  for (int64 node = 1; node <= n || !stack.empty();) {
+    if (node <= n) {
+      stack.emplace_back(node);
+      node = 2 * node;
+    } else {
+      node = stack.back();
+      stack.pop_back();
+      order[node - 1] = sorted[next++];
+      node = 2 * node + 1;
+    }
+  }
+
+  MmapKVHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kMmapKVMagic;
+  header.num_keys = n;
+  header.value_len = value_len;
+  header.key_bytes = sizeof(K);
+  header.value_bytes = sizeof(V);
+  header.keys_offset = MmapKVAlign(sizeof(MmapKVHeader));
+  header.values_offset = MmapKVAlign(header.keys_offset + n * sizeof(K));
+
+  std::unique_ptr<WritableFile> file;
+  TF_RETURN_IF_ERROR(env->NewWritableFile(path, &file));
+  std::string buf(reinterpret_cast<const char*>(&header), sizeof(header));
+  buf.resize(header.keys_offset, '\0');
+  for (int64 i = 0; i < n; i++) {
+    buf.append(reinterpret_cast<const char*>(&keys[order[i]]), sizeof(K));
+  }
+  buf.resize(header.values_offset, '\0');
+  TF_RETURN_IF_ERROR(file->Append(buf));
+  const size_t bytes_limit = 8 << 20;
+  const size_t row_bytes = value_len * sizeof(V);
+  buf.clear();
+  for (int64 i = 0; i < n; i++) {
+    buf.append(reinterpret_cast<const char*>(rows[order[i]]), row_bytes);
+    if (buf.size() >= bytes_limit) {
+      TF_RETURN_IF_ERROR(file->Append(buf));
+      buf.clear();
+    }
+  }
+  TF_RETURN_IF_ERROR(file->Append(buf));
+  return file->Close();
+}
+
+// Read only KV serving the rows of a file written by WriteMmapKVFile from
+// its mapped pages, the pages are shared by the processes mapping the same
+// file. The rows are read with FindRow instead of ValuePtrs, the methods
+// modifying the KV return errors.
+template <class K, class V>
+class MmapKV : public KVInterface<K, V> {
+ public:
+  MmapKV() {}
+
+  ~MmapKV() override {
+    if (addr_ != nullptr) {
+      munmap(addr_, file_size_);
+    }
+  }
+
+  Status Open(const std::string& path, int64 value_len) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return errors::NotFound("Failed to open ", path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        st.st_size < static_cast<int64>(sizeof(MmapKVHeader))) {
+      close(fd);
+      return errors::DataLoss("Invalid MmapKV file ", path);
+    }
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+      return errors::Internal("Failed to mmap ", path);
+    }
+    const MmapKVHeader* header = static_cast<const MmapKVHeader*>(addr);
+    if (header->magic != kMmapKVMagic ||
+        header->key_bytes != sizeof(K) ||
+        header->value_bytes != sizeof(V) ||
+        header->value_len != value_len ||
+        header->values_offset +
+            header->num_keys * value_len * static_cast<int64>(sizeof(V)) >
+                st.st_size) {
+      munmap(addr, st.st_size);
+      return errors::DataLoss("MmapKV file ", path, " mismatches the"
+                              " EmbeddingVariable of value_len ", value_len);
+    }
+    // The rows are looked up at random.
+    madvise(addr, st.st_size, MADV_RANDOM);
+    addr_ = addr;
+    file_size_ = st.st_size;
+    num_keys_ = header->num_keys;
+    value_len_ = value_len;
+    keys_ = reinterpret_cast<const K*>(
+        static_cast<const char*>(addr) + header->keys_offset);
+    values_ = reinterpret_cast<const V*>(
+        static_cast<const char*>(addr) + header->values_offset);
+    return Status::OK();
+  }
+
+  // Returns the mapped row of key, nullptr if key is missing.
+  const V* FindRow(K key) const {
+    int64 node = 1;
+    while (node <= num_keys_) {
+      // The nodes 4 levels lower share one or two cache lines.
+      __builtin_prefetch(keys_ + 16 * node - 1);
+      node = 2 * node + (keys_[node - 1] < key);
+    }
+    // Drops the right turns after the last left turn, the node of the
+    // left turn is the lower bound of key.
+    node >>= __builtin_ffsll(~node);
+    if (node == 0 || keys_[node - 1] != key) {
+      return nullptr;
+    }
+    return values_ + (node - 1) * value_len_;
+  }
+
+  Status Lookup(K key, ValuePtr<V>** value_ptr) override {
+    return errors::Unimplemented("MmapKV has no ValuePtr, use FindRow.");
+  }
+
+  Status Contains(K key) override {
+    if (FindRow(key) == nullptr) {
+      return errors::NotFound("Unable to find Key: ", key, " in MmapKV.");
+    }
+    return Status::OK();
+  }
+
+  Status Insert(K key, const ValuePtr<V>* value_ptr) override {
+    return errors::Unimplemented("MmapKV is read only.");
+  }
+
+  Status Remove(K key) override {
+    return errors::Unimplemented("MmapKV is read only.");
+  }
+
+  Status BatchCommit(const std::vector<K>& keys,
+      const std::vector<ValuePtr<V>*>& value_ptrs) override {
+    return errors::Unimplemented("MmapKV is read only.");
+  }
+
+  Status GetSnapshot(std::vector<K>* key_list,
+      std::vector<ValuePtr<V>*>* value_ptr_list) override {
+    return errors::Unimplemented("MmapKV has no ValuePtr.");
+  }
+
+  int64 Size() const override {
+    return num_keys_;
+  }
+
+  std::string DebugString() const override {
+    return strings::StrCat("MmapKV keys: ", num_keys_,
+                           ", value_len: ", value_len_,
+                           ", file_size: ", file_size_);
+  }
+
+ private:
+  void* addr_ = nullptr;
+  int64 file_size_ = 0;
+  int64 num_keys_ = 0;
+  int64 value_len_ = 0;
+  const K* keys_ = nullptr;
+  const V* values_ = nullptr;
+};
+
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_MMAP_KV_H_
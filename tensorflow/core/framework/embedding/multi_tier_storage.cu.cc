@@ -51,6 +51,11 @@ void MultiTierStorage<K, V>::CopyEmbeddingsFromDramToHbm(
     int value_len) {
   if (copyback_cursor.size() > 0) {
     int total = copyback_cursor.size();
+    if (total <= zero_copy_max_misses_) {
+      CopyEmbeddingsFromPinnedDramToHbm(ctx, value_ptr_list, memory_index,
+                                        gpu_value_ptrs, value_len);
+      return;
+    }
     //Alocate memcpy buffer on CPU and GPU.
     Allocator* gpu_alloc = ctx.gpu_allocator;
     V* memcpy_buffer_gpu = (V*)gpu_alloc->AllocateRaw(
@@ -117,10 +122,57 @@ void MultiTierStorage<K, V>::CopyEmbeddingsFromDramToHbm(
     cpu_allocator()->DeallocateRaw(memcpy_buffer_cpu);
   }
 }
+
+template <class K, class V>
+void MultiTierStorage<K, V>::CopyEmbeddingsFromPinnedDramToHbm(
+    const EmbeddingVarContext<GPUDevice>& ctx,
+    ValuePtr<V>** value_ptr_list,
+    const std::vector<int64>& memory_index,
+    const std::vector<ValuePtr<V>*>& gpu_value_ptrs,
+    int value_len) {
+  int total = gpu_value_ptrs.size();
+  Allocator* gpu_alloc = ctx.gpu_allocator;
+  //The first half is the addresses of embeddings in pinned memory,
+  //the second half is the addresses of embeddings on GPU.
+  V** value_address = (V**)cpu_allocator()->AllocateRaw(
+      Allocator::kAllocatorAlignment, sizeof(V*) * total * 2);
+  V** dev_value_address = (V**)gpu_alloc->AllocateRaw(
+      Allocator::kAllocatorAlignment, sizeof(V*) * total * 2);
+  for (int i = 0; i < total; i++) {
+    int64 j = memory_index[i];
+    value_address[i] = value_ptr_list[j]->GetValue(0, 0);
+    gpu_value_ptrs[i]->SetInitialized(0);
+    value_address[total + i] = gpu_value_ptrs[i]->GetValue(0, 0);
+    value_ptr_list[j] = gpu_value_ptrs[i];
+  }
+  auto compute_stream = ctx.compute_stream;
+  DeviceMemoryBase gpu_addr_dst_ptr(
+      dev_value_address, total * 2 * sizeof(V*));
+  compute_stream->ThenMemcpy(
+      &gpu_addr_dst_ptr, value_address, total * 2 * sizeof(V*));
+
+  //Gather the embeddings from pinned memory to GPU
+  int block_dim = 128;
+  TF_CHECK_OK(GpuLaunchKernel(
+      CopyEmbedding<V>, (total * value_len + block_dim - 1) / block_dim,
+      block_dim, 0, ctx.gpu_device.stream(),
+      dev_value_address, dev_value_address + total,
+      value_len, total));
+  SyncWithEventMgr(compute_stream, ctx.event_mgr);
+
+  gpu_alloc->DeallocateRaw(dev_value_address);
+  cpu_allocator()->DeallocateRaw(value_address);
+}
+
 #define REGISTER_KERNELS(ktype, vtype)                                        \
   template void MultiTierStorage<ktype, vtype>::CopyEmbeddingsFromDramToHbm(       \
       const EmbeddingVarContext<GPUDevice>&, const ktype*, ValuePtr<vtype>**,\
       std::list<int64>&, const std::vector<int64>&,\
+      const std::vector<ValuePtr<vtype>*>&, int);\
+  template void MultiTierStorage<ktype, vtype>::                              \
+      CopyEmbeddingsFromPinnedDramToHbm(                                      \
+      const EmbeddingVarContext<GPUDevice>&, ValuePtr<vtype>**,               \
+      const std::vector<int64>&,                                              \
       const std::vector<ValuePtr<vtype>*>&, int);
 #define REGISTER_KERNELS_ALL(type) \
   REGISTER_KERNELS(int32, type);   \
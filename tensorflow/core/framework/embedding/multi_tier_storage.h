@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/framework/embedding/config.pb.h"
 #include "tensorflow/core/framework/embedding/cpu_hash_map_kv.h"
 #include "tensorflow/core/framework/embedding/embedding_var_context.h"
+#include "tensorflow/core/framework/embedding/epoch_reclaimer.h"
 #include "tensorflow/core/framework/embedding/eviction_manager.h"
 #include "tensorflow/core/framework/embedding/globalstep_shrink_policy.h"
 #include "tensorflow/core/framework/embedding/kv_interface.h"
@@ -29,6 +30,7 @@ limitations under the License.
 
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 template<typename V>
@@ -64,17 +66,40 @@ class MultiTierStorage : public Storage<K, V> {
       Storage<K, V>::total_dims_ = temp;
       SetTotalDims(Storage<K, V>::total_dims_);
 
-      cache_capacity_ = Storage<K, V>::storage_config_.size[0]
+      cache_capacity_ = CacheBytes()
                         / (Storage<K, V>::total_dims_ * sizeof(V));
       ready_eviction_ = true;
     }
     Storage<K, V>::flag_.clear(std::memory_order_release);
   }
 
+  // Resizes the first tier to 'bytes', it is evicted down to the new
+  // capacity in the background.
+  void SetCacheBytes(int64 bytes) {
+    while (Storage<K, V>::flag_.test_and_set(std::memory_order_acquire));
+    cache_bytes_ = bytes;
+    if (Storage<K, V>::total_dims_ > 0) {
+      cache_capacity_ = cache_bytes_
+                        / (Storage<K, V>::total_dims_ * sizeof(V));
+    }
+    Storage<K, V>::flag_.clear(std::memory_order_release);
+    if (cache_ != nullptr) {
+      MaybeSignalEviction();
+    }
+  }
+
   int64 CacheSize() const override {
     return cache_capacity_;
   }
 
+  int64 EvictedBytes() const override {
+    return evicted_bytes_.load(std::memory_order_relaxed);
+  }
+
+  void RecordEvictedBytes(int64 bytes) {
+    evicted_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
   BatchCache<K>* Cache() override {
     return cache_;
   }
@@ -89,6 +114,8 @@ class MultiTierStorage : public Storage<K, V> {
     eviction_manager_ = EvictionManagerCreator::Create<K, V>();
     eviction_manager_->AddStorage(this);
     cache_thread_pool_ = CacheThreadPoolCreator::Create();
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_MULTI_TIER_EV_CACHE_STATS_INTERVAL",
+                                    0, &cache_stats_interval_));
   }
 
   Status BatchCommit(const std::vector<K>& keys,
@@ -229,11 +256,12 @@ class MultiTierStorage : public Storage<K, V> {
     return Status::OK();
   }
 
-  virtual void BatchEviction() {
+  // Evicts a batch of rows of the first tier, returns the evicted bytes.
+  virtual int64 BatchEviction() {
     constexpr int EvictionSize = 10000;
     K evic_ids[EvictionSize];
     if (!ready_eviction_)
-      return;
+      return 0;
     int cache_count = cache_->size();
     if (cache_count > cache_capacity_) {
       // eviction
@@ -241,19 +269,34 @@ class MultiTierStorage : public Storage<K, V> {
       k_size = std::min(k_size, EvictionSize);
       size_t true_size = cache_->get_evic_ids(evic_ids, k_size);
       EvictionWithDelayedDestroy(evic_ids, true_size);
+      return true_size * Storage<K, V>::total_dims_ * sizeof(V);
     }
+    return 0;
+  }
+
+  // Whether the first tier is over its capacity.
+  bool NeedsEviction() {
+    return ready_eviction_ && cache_->size() > cache_capacity_;
+  }
+
+  const std::string& GetName() const {
+    return name_;
   }
 
   void UpdateCache(const Tensor& indices,
                    const Tensor& indices_counts) override {
     Schedule([this, indices, indices_counts]() {
       cache_->update(indices, indices_counts);
+      MaybeReportCacheStats();
+      MaybeSignalEviction();
     });
   }
 
   void UpdateCache(const Tensor& indices) override {
     Schedule([this, indices]() {
       cache_->update(indices);
+      MaybeReportCacheStats();
+      MaybeSignalEviction();
     });
   }
 
@@ -266,37 +309,29 @@ class MultiTierStorage : public Storage<K, V> {
   void AddToCache(const Tensor& indices) override {
     Schedule([this, indices]() {
       cache_->add_to_cache(indices);
+      MaybeSignalEviction();
     });
   }
 
  protected:
   virtual void SetTotalDims(int64 total_dims) = 0;
 
-  void DeleteFromEvictionManager() {
-    eviction_manager_->DeleteStorage(this);
-  }
-
-  void ReleaseValuePtrs(std::deque<ValuePtr<V>*>& value_ptrs,
-                        Allocator* allocator) {
-    constexpr int CAP_INVALID_VALUEPTR = 64 * 1024;
-    if (value_ptrs.size() > CAP_INVALID_VALUEPTR) {
-      int64 num_of_deleted_value_ptrs =
-          value_ptrs.size() - CAP_INVALID_VALUEPTR;
-      for (int i = 0; i < num_of_deleted_value_ptrs; i++) {
-        ValuePtr<V>* value_ptr = value_ptrs.front();
-        value_ptr->Destroy(allocator);
-        delete value_ptr;
-        value_ptrs.pop_front();
-      }
-    }
+  int64 CacheBytes() const {
+    return cache_bytes_ >= 0 ? cache_bytes_
+                             : Storage<K, V>::storage_config_.size[0];
   }
 
-  void ReleaseInvalidValuePtr(Allocator* allocator) {
-    ReleaseValuePtrs(value_ptr_out_of_date_, allocator);
+  void DeleteFromEvictionManager() {
+    eviction_manager_->DeleteStorage(this);
   }
 
-  void KeepInvalidValuePtr(ValuePtr<V>* value_ptr) {
-    value_ptr_out_of_date_.emplace_back(value_ptr);
+  // Destroys 'value_ptr', just removed from a tier, once no lookup that
+  // may have read it before the removal is running.
+  void RetireValuePtr(ValuePtr<V>* value_ptr, Allocator* allocator) {
+    EpochReclaimer::Global()->Retire([value_ptr, allocator]() {
+      value_ptr->Destroy(allocator);
+      delete value_ptr;
+    });
   }
 
 #if GOOGLE_CUDA
@@ -307,12 +342,38 @@ class MultiTierStorage : public Storage<K, V> {
                                    const std::vector<int64>& memory_index,
                                    const std::vector<ValuePtr<V>*>& gpu_value_ptrs,
                                    int value_len);
+
+  // Reads the embeddings of the DRAM tier in place over UVA, the memory
+  // of the DRAM tier must be allocated by pinned_ev_allocator().
+  void CopyEmbeddingsFromPinnedDramToHbm(
+      const EmbeddingVarContext<GPUDevice>& context,
+      ValuePtr<V>** value_ptr_list,
+      const std::vector<int64>& memory_index,
+      const std::vector<ValuePtr<V>*>& gpu_value_ptrs,
+      int value_len);
 #endif //GOOGL_CUDA
  private:
   virtual Status EvictionWithDelayedDestroy(K* evict_ids, int64 evict_size) {}
 
+  void MaybeSignalEviction() {
+    if (NeedsEviction()) {
+      eviction_manager_->Signal(this);
+    }
+  }
+
+  // Logs the hit rate of the tier tracked by the cache every
+  // TF_MULTI_TIER_EV_CACHE_STATS_INTERVAL updates, 0 disables it.
+  void MaybeReportCacheStats() {
+    if (cache_stats_interval_ <= 0) {
+      return;
+    }
+    if (++num_cache_updates_ % cache_stats_interval_ == 0) {
+      LOG(INFO) << name_ << " first tier cache: " << cache_->DebugString();
+      cache_->reset_status();
+    }
+  }
+
  protected:
-  std::deque<ValuePtr<V>*> value_ptr_out_of_date_;
   BatchCache<K>* cache_ = nullptr;
 
   EvictionManager<K, V>* eviction_manager_;
@@ -321,7 +382,17 @@ class MultiTierStorage : public Storage<K, V> {
   condition_variable shutdown_cv_;
   volatile bool shutdown_ = false;
 
+  // The rows of the DRAM tier are in pinned host memory, and at most
+  // zero_copy_max_misses_ of them are gathered by a GPU kernel over UVA
+  // instead of being staged through a host buffer. 0 disables it.
+  int64 zero_copy_max_misses_ = 0;
+
   int64 cache_capacity_ = -1;
+  // The bytes of the first tier, storage_config_.size[0] unless resized.
+  int64 cache_bytes_ = -1;
+  int64 cache_stats_interval_ = 0;
+  std::atomic<int64> num_cache_updates_{0};
+  std::atomic<int64> evicted_bytes_{0};
   volatile bool ready_eviction_ = false;
 
   std::string name_;
@@ -48,6 +48,17 @@ class NullableFilterPolicy : public FilterPolicy<K, V, EV> {
     return Status::OK();
   }
 
+  void LookupWithValuePtr(K key, ValuePtr<V>* value_ptr, V* val,
+      const V* default_value_ptr,
+      const V* default_value_no_permission) override {
+    if (value_ptr != nullptr) {
+      V* mem_val = ev_->LookupOrCreateEmb(value_ptr, default_value_ptr);
+      memcpy(val, mem_val, sizeof(V) * ev_->ValueLen());
+    } else {
+      memcpy(val, default_value_ptr, sizeof(V) * ev_->ValueLen());
+    }
+  }
+
 #if GOOGLE_CUDA
   void BatchLookup(const EmbeddingVarContext<GPUDevice>& ctx,
                    const K* keys, V* output,
@@ -0,0 +1,64 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_ROW_COPY_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_ROW_COPY_H_
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <cstdint>
+#include <cstring>
+
+namespace tensorflow {
+namespace embedding {
+
+// Rows shorter than this are copied with memcpy, as the streaming stores of
+// partial cache lines cost more than they save.
+constexpr size_t kStreamingCopyMinBytes = 256;
+
+// Writes the default value of a new row. Long rows are written with
+// non-temporal stores, which skip the read for ownership of the new row and
+// keep a burst of new features from evicting the hot rows from the cache.
+// Readers which need the value right away should read it from 'src'.
+inline void CopyDefaultValue(void* dst, const void* src, size_t bytes) {
+#if defined(__SSE2__)
+  if (bytes >= kStreamingCopyMinBytes) {
+    char* d = static_cast<char*>(dst);
+    const char* s = static_cast<const char*>(src);
+    size_t head = (16 - (reinterpret_cast<uintptr_t>(d) & 15)) & 15;
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    bytes -= head;
+    for (; bytes >= 16; bytes -= 16, d += 16, s += 16) {
+      _mm_stream_si128(reinterpret_cast<__m128i*>(d),
+                       _mm_loadu_si128(reinterpret_cast<const __m128i*>(s)));
+    }
+    memcpy(d, s, bytes);
+    // The streaming stores are weakly ordered, make them visible before
+    // the row is marked as initialized.
+    _mm_sfence();
+    return;
+  }
+#endif  // __SSE2__
+  memcpy(dst, src, bytes);
+}
+
+}  // namespace embedding
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_ROW_COPY_H_
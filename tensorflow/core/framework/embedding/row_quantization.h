@@ -0,0 +1,254 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_ROW_QUANTIZATION_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_ROW_QUANTIZATION_H_
+
+#if defined(__AVX2__) || defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+#include "tensorflow/core/framework/numeric_types.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// Quantized rows of dim values:
+//  * INT8 is one float scale, max(|v|) / 127, per block of block_size
+//    values followed by the int8 values. block_size <= 0 means one block.
+//  * FP16 is the half values.
+//  * DYNAMIC_INT8 is one float max(|v|) per block followed by an int8 code
+//    per value, a sign bit and 7 bits of the log2 of |v| / max in steps of
+//    1/8, see internal::DynamicInt8Code. It keeps a relative error of at
+//    most 6.25% over the 16 octaves below the max of a block and never
+//    flushes a nonzero value to 0, like the optimizer states need.
+enum class RowQuantization {
+  INT8 = 0,
+  FP16 = 1,
+  DYNAMIC_INT8 = 2
+};
+
+inline int64 NumQuantizationBlocks(int64 dim, int64 block_size) {
+  if (block_size <= 0 || block_size >= dim) {
+    return (dim == 0) ? 0 : 1;
+  }
+  return (dim + block_size - 1) / block_size;
+}
+
+inline size_t QuantizedRowBytes(RowQuantization type, int64 dim,
+                                int64 block_size) {
+  if (type == RowQuantization::FP16) {
+    return dim * sizeof(Eigen::half);
+  }
+  return NumQuantizationBlocks(dim, block_size) * sizeof(float) +
+         dim * sizeof(int8);
+}
+
+namespace internal {
+
+inline int64 BlockLen(int64 dim, int64 block_size) {
+  return (block_size <= 0 || block_size >= dim) ? dim : block_size;
+}
+
+// The bits of 1.0f above its 3 top mantissa bits.
+constexpr int32 kDynamicInt8One = 0x3f800000 >> 20;
+
+// The code m in [1, 127] of a nonzero ratio r = |v| / max is the exponent
+// and the 3 top mantissa bits of r, rounded, offset so that r = 1 is 127.
+// Smaller ratios than the 127 codes reach get the code 1.
+inline uint8 DynamicInt8Code(float v, float inv_max) {
+  if (v == 0) {
+    return 0;
+  }
+  float r = std::abs(v) * inv_max;
+  uint32 bits;
+  memcpy(&bits, &r, sizeof(bits));
+  int32 m = static_cast<int32>((bits + (1u << 19)) >> 20) -
+            kDynamicInt8One + 127;
+  m = std::min(std::max(m, 1), 127);
+  return static_cast<uint8>(v < 0 ? (m | 0x80) : m);
+}
+
+// The ratios of the codes without their sign bit, 0 for the code 0.
+inline const float* DynamicInt8Ratios() {
+  static const float* ratios = [] {
+    float* r = new float[128];
+    r[0] = 0;
+    for (int32 m = 1; m < 128; m++) {
+      uint32 bits = static_cast<uint32>(m - 127 + kDynamicInt8One) << 20;
+      memcpy(&r[m], &bits, sizeof(bits));
+    }
+    return r;
+  }();
+  return ratios;
+}
+
+template <typename V, bool accumulate>
+inline void DynamicInt8ToFloat(const uint8* in, float scale, int64 len,
+                               V* out) {
+  const float* ratios = DynamicInt8Ratios();
+  for (int64 i = 0; i < len; i++) {
+    float f = ratios[in[i] & 0x7f] * scale;
+    V v = static_cast<V>((in[i] & 0x80) ? -f : f);
+    out[i] = accumulate ? static_cast<V>(out[i] + v) : v;
+  }
+}
+
+// out[i] = in[i] * scale + (accumulate ? out[i] : 0), with scale folding
+// the block scale and the weight of the row.
+template <typename V, bool accumulate>
+inline void Int8ToFloat(const int8* in, float scale, int64 len, V* out) {
+  int64 i = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+  if (std::is_same<V, float>::value) {
+    float* f_out = reinterpret_cast<float*>(out);
+    __m256 s = _mm256_set1_ps(scale);
+    for (; i + 8 <= len; i += 8) {
+      __m128i q = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i));
+      __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(q));
+      if (accumulate) {
+        _mm256_storeu_ps(f_out + i,
+            _mm256_fmadd_ps(f, s, _mm256_loadu_ps(f_out + i)));
+      } else {
+        _mm256_storeu_ps(f_out + i, _mm256_mul_ps(f, s));
+      }
+    }
+  }
+#endif  // __AVX2__ && __FMA__
+  for (; i < len; i++) {
+    V v = static_cast<V>(in[i] * scale);
+    out[i] = accumulate ? static_cast<V>(out[i] + v) : v;
+  }
+}
+
+template <typename V, bool accumulate>
+inline void HalfToFloat(const Eigen::half* in, float scale, int64 len,
+                        V* out) {
+  int64 i = 0;
+#if defined(__F16C__) && defined(__FMA__)
+  if (std::is_same<V, float>::value) {
+    float* f_out = reinterpret_cast<float*>(out);
+    __m256 s = _mm256_set1_ps(scale);
+    for (; i + 8 <= len; i += 8) {
+      __m256 f = _mm256_cvtph_ps(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+      if (accumulate) {
+        _mm256_storeu_ps(f_out + i,
+            _mm256_fmadd_ps(f, s, _mm256_loadu_ps(f_out + i)));
+      } else {
+        _mm256_storeu_ps(f_out + i, _mm256_mul_ps(f, s));
+      }
+    }
+  }
+#endif  // __F16C__ && __FMA__
+  for (; i < len; i++) {
+    V v = static_cast<V>(static_cast<float>(in[i]) * scale);
+    out[i] = accumulate ? static_cast<V>(out[i] + v) : v;
+  }
+}
+
+template <typename V, bool accumulate>
+void DequantizeRowImpl(RowQuantization type, const char* in, int64 dim,
+                       int64 block_size, float weight, V* out) {
+  if (type == RowQuantization::FP16) {
+    HalfToFloat<V, accumulate>(reinterpret_cast<const Eigen::half*>(in),
+                               weight, dim, out);
+    return;
+  }
+  const float* scales = reinterpret_cast<const float*>(in);
+  int64 num_blocks = NumQuantizationBlocks(dim, block_size);
+  const int8* q = reinterpret_cast<const int8*>(scales + num_blocks);
+  int64 block_len = BlockLen(dim, block_size);
+  for (int64 b = 0; b < num_blocks; b++) {
+    int64 start = b * block_len;
+    if (type == RowQuantization::DYNAMIC_INT8) {
+      DynamicInt8ToFloat<V, accumulate>(
+          reinterpret_cast<const uint8*>(q) + start, scales[b] * weight,
+          std::min(block_len, dim - start), out + start);
+    } else {
+      Int8ToFloat<V, accumulate>(q + start, scales[b] * weight,
+                                 std::min(block_len, dim - start),
+                                 out + start);
+    }
+  }
+}
+
+}  // namespace internal
+
+// Writes QuantizedRowBytes(type, dim, block_size) bytes to out.
+template <typename V>
+void QuantizeRow(RowQuantization type, const V* in, int64 dim,
+                 int64 block_size, char* out) {
+  if (type == RowQuantization::FP16) {
+    Eigen::half* h = reinterpret_cast<Eigen::half*>(out);
+    for (int64 i = 0; i < dim; i++) {
+      h[i] = static_cast<Eigen::half>(static_cast<float>(in[i]));
+    }
+    return;
+  }
+  int64 num_blocks = NumQuantizationBlocks(dim, block_size);
+  int64 block_len = internal::BlockLen(dim, block_size);
+  int8* q = reinterpret_cast<int8*>(out + num_blocks * sizeof(float));
+  for (int64 b = 0; b < num_blocks; b++) {
+    int64 start = b * block_len;
+    int64 end = std::min(start + block_len, dim);
+    float max_abs = 0.0;
+    for (int64 i = start; i < end; i++) {
+      max_abs = std::max(max_abs, std::abs(static_cast<float>(in[i])));
+    }
+    if (type == RowQuantization::DYNAMIC_INT8) {
+      float inv_max = (max_abs == 0.0) ? 0.0 : 1 / max_abs;
+      memcpy(out + b * sizeof(float), &max_abs, sizeof(float));
+      for (int64 i = start; i < end; i++) {
+        q[i] = static_cast<int8>(internal::DynamicInt8Code(
+            static_cast<float>(in[i]), inv_max));
+      }
+      continue;
+    }
+    float scale = max_abs / 127;
+    float inv_scale = (scale == 0.0) ? 0.0 : 1 / scale;
+    memcpy(out + b * sizeof(float), &scale, sizeof(float));
+    for (int64 i = start; i < end; i++) {
+      q[i] = static_cast<int8>(
+          std::nearbyint(static_cast<float>(in[i]) * inv_scale));
+    }
+  }
+}
+
+template <typename V>
+void DequantizeRow(RowQuantization type, const char* in, int64 dim,
+                   int64 block_size, V* out) {
+  internal::DequantizeRowImpl<V, false>(type, in, dim, block_size, 1.0,
+                                        out);
+}
+
+// out[i] += weight * row[i], the row is dequantized in registers.
+template <typename V>
+void AccumulateQuantizedRow(RowQuantization type, const char* in, int64 dim,
+                            int64 block_size, float weight, V* out) {
+  internal::DequantizeRowImpl<V, true>(type, in, dim, block_size, weight,
+                                       out);
+}
+
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_ROW_QUANTIZATION_H_
@@ -0,0 +1,295 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_SERVING_ROW_CACHE_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_SERVING_ROW_CACHE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/embedding/epoch_reclaimer.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace embedding {
+
+inline std::atomic<int64>* NumServingRowCaches() {
+  static std::atomic<int64> num_caches(0);
+  return &num_caches;
+}
+
+// The final rows of the hottest keys of a serving EmbeddingVar, for its
+// lookups to skip the hash map, and the SSD of the DRAM_SSDHASH storages.
+//
+// Unlike the caches of the multi-tier storages, the cached rows never
+// change: a refresh builds a new snapshot of the keys sampled most often
+// since the last one, publishes it with one atomic store and retires the
+// old one to the EpochReclaimer, so lookups take no lock. Invalidate drops
+// the snapshot when the rows of the EmbeddingVar change, e.g. by an
+// incremental checkpoint, and the next refresh is then due at once.
+//
+// TF_SERVING_ROW_CACHE_MB, 0 by default, which disables the caches, is
+// split evenly among the caches of the process, and a refresh runs at most
+// every TF_SERVING_ROW_CACHE_REFRESH_SECS, 30 by default.
+template <class K, class V>
+class ServingRowCache {
+ public:
+  // Reads the current rows of keys, which are missing in the cache.
+  typedef std::function<void(const K* keys, V* rows, int64 num_of_keys)>
+      ReadRowsFn;
+
+  // nullptr when the caches are disabled.
+  static ServingRowCache* Create(int64 value_len, ReadRowsFn read_rows) {
+    int64 budget_mb = 0;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_SERVING_ROW_CACHE_MB", 0,
+                                    &budget_mb));
+    if (budget_mb <= 0) {
+      return nullptr;
+    }
+    int64 refresh_secs = 30;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_SERVING_ROW_CACHE_REFRESH_SECS", 30,
+                                    &refresh_secs));
+    return new ServingRowCache(value_len, budget_mb << 20,
+                               refresh_secs * 1000000,
+                               std::move(read_rows));
+  }
+
+  ~ServingRowCache() {
+    NumServingRowCaches()->fetch_sub(1);
+    delete snapshot_.load();
+  }
+
+  // Copies the cached rows of keys to rows and sets hits, returns the
+  // number of hits. One in kSampleStride keys is counted for the next
+  // refresh, unless another lookup is counting.
+  int64 Lookup(const K* keys, int64 num_of_keys, V* rows, bool* hits) {
+    Sample(keys, num_of_keys);
+    EpochGuard guard;
+    const Snapshot* snapshot = snapshot_.load(std::memory_order_acquire);
+    if (snapshot == nullptr) {
+      std::fill(hits, hits + num_of_keys, false);
+      return 0;
+    }
+    int64 num_hits = 0;
+    for (int64 i = 0; i < num_of_keys; ++i) {
+      const V* row = snapshot->Find(keys[i]);
+      hits[i] = row != nullptr;
+      if (row != nullptr) {
+        memcpy(rows + i * value_len_, row, sizeof(V) * value_len_);
+        ++num_hits;
+      }
+    }
+    return num_hits;
+  }
+
+  // Whether a refresh is due and none is running, in which case the caller
+  // has to run Refresh.
+  bool StartRefresh() {
+    if (Env::Default()->NowMicros() <
+        next_refresh_us_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    return !refreshing_.exchange(true);
+  }
+
+  void Refresh() {
+    const int64 generation = generation_.load();
+    std::unique_ptr<Snapshot> snapshot(new Snapshot(HottestKeys(),
+                                                    value_len_));
+    read_rows_(snapshot->keys.data(), snapshot->rows.data(),
+               snapshot->keys.size());
+    {
+      mutex_lock l(publish_mu_);
+      // Rows read while an incremental checkpoint was applied may be
+      // outdated, they are read again.
+      if (generation == generation_.load()) {
+        Retire(snapshot_.exchange(snapshot.release()));
+        next_refresh_us_ = Env::Default()->NowMicros() + refresh_micros_;
+      }
+    }
+    refreshing_ = false;
+    EpochReclaimer::Global()->TryReclaim();
+  }
+
+  void Invalidate() {
+    mutex_lock l(publish_mu_);
+    ++generation_;
+    Retire(snapshot_.exchange(nullptr));
+    next_refresh_us_ = 0;
+  }
+
+  int64 NumRows() {
+    EpochGuard guard;
+    const Snapshot* snapshot = snapshot_.load(std::memory_order_acquire);
+    return snapshot == nullptr ? 0 : snapshot->keys.size();
+  }
+
+  // The rows this cache may hold, under its share of the budget.
+  int64 MaxRows() const {
+    const int64 row_bytes =
+        sizeof(V) * value_len_ + sizeof(K) + 2 * sizeof(int32);
+    return budget_bytes_ /
+           std::max<int64>(NumServingRowCaches()->load(), 1) / row_bytes;
+  }
+
+  static constexpr int64 kSampleStride = 8;
+
+ private:
+  // An open addressing table of keys to their rows, which never changes.
+  struct Snapshot {
+    Snapshot(std::vector<K> hot_keys, int64 value_len)
+        : keys(std::move(hot_keys)),
+          rows(keys.size() * value_len),
+          value_len(value_len) {
+      size_t capacity = 2;
+      while (capacity < 2 * keys.size()) {
+        capacity <<= 1;
+      }
+      mask = capacity - 1;
+      slots.assign(capacity, -1);
+      for (int32 i = 0; i < keys.size(); ++i) {
+        size_t slot = Hash(keys[i]) & mask;
+        while (slots[slot] >= 0) {
+          slot = (slot + 1) & mask;
+        }
+        slots[slot] = i;
+      }
+    }
+
+    static size_t Hash(K key) {
+      return static_cast<uint64>(key) * 0x9E3779B97F4A7C15ULL >> 17;
+    }
+
+    const V* Find(K key) const {
+      for (size_t slot = Hash(key) & mask; slots[slot] >= 0;
+           slot = (slot + 1) & mask) {
+        if (keys[slots[slot]] == key) {
+          return &rows[slots[slot] * value_len];
+        }
+      }
+      return nullptr;
+    }
+
+    std::vector<K> keys;
+    std::vector<V> rows;
+    std::vector<int32> slots;
+    size_t mask;
+    int64 value_len;
+  };
+
+  ServingRowCache(int64 value_len, int64 budget_bytes, int64 refresh_micros,
+                  ReadRowsFn read_rows)
+      : value_len_(value_len),
+        budget_bytes_(budget_bytes),
+        refresh_micros_(refresh_micros),
+        read_rows_(std::move(read_rows)) {
+    NumServingRowCaches()->fetch_add(1);
+    next_refresh_us_ = Env::Default()->NowMicros() + refresh_micros_;
+  }
+
+  static void Retire(Snapshot* snapshot) {
+    if (snapshot != nullptr) {
+      EpochReclaimer::Global()->Retire([snapshot]() { delete snapshot; });
+    }
+  }
+
+  void Sample(const K* keys, int64 num_of_keys) {
+    mutex_lock l(sample_mu_, std::try_to_lock);
+    if (!l) {
+      return;
+    }
+    for (int64 i = num_sampled_calls_++ % kSampleStride; i < num_of_keys;
+         i += kSampleStride) {
+      ++counts_[keys[i]];
+    }
+    // The counts of the keys that are not among the hottest only age.
+    if (counts_.size() > 4 * std::max<int64>(MaxRows(), 1024)) {
+      DecayLocked();
+    }
+  }
+
+  void DecayLocked() EXCLUSIVE_LOCKS_REQUIRED(sample_mu_) {
+    for (auto it = counts_.begin(); it != counts_.end();) {
+      it->second >>= 1;
+      if (it->second == 0) {
+        it = counts_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // The most sampled keys, at most MaxRows. The counts are halved, so that
+  // the next refresh follows the keys which become hot.
+  std::vector<K> HottestKeys() {
+    std::vector<std::pair<int64, K>> candidates;
+    {
+      mutex_lock l(sample_mu_);
+      candidates.reserve(counts_.size());
+      for (const auto& it : counts_) {
+        candidates.emplace_back(it.second, it.first);
+      }
+      DecayLocked();
+    }
+    const size_t max_rows = MaxRows();
+    if (candidates.size() > max_rows) {
+      std::nth_element(candidates.begin(), candidates.begin() + max_rows,
+                       candidates.end(),
+                       [](const std::pair<int64, K>& a,
+                          const std::pair<int64, K>& b) {
+                         return a.first > b.first;
+                       });
+      candidates.resize(max_rows);
+    }
+    std::vector<K> keys;
+    keys.reserve(candidates.size());
+    for (const auto& candidate : candidates) {
+      keys.emplace_back(candidate.second);
+    }
+    return keys;
+  }
+
+  const int64 value_len_;
+  const int64 budget_bytes_;
+  const int64 refresh_micros_;
+  const ReadRowsFn read_rows_;
+
+  std::atomic<Snapshot*> snapshot_{nullptr};
+  mutex publish_mu_;
+  std::atomic<int64> generation_{0};
+  std::atomic<uint64> next_refresh_us_{0};
+  std::atomic<bool> refreshing_{false};
+
+  mutex sample_mu_;
+  std::unordered_map<K, int64> counts_ GUARDED_BY(sample_mu_);
+  int64 num_sampled_calls_ GUARDED_BY(sample_mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ServingRowCache);
+};
+
+template <class K, class V>
+constexpr int64 ServingRowCache<K, V>::kSampleStride;
+
+}  // namespace embedding
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_SERVING_ROW_CACHE_H_
@@ -47,6 +47,11 @@ class ShrinkPolicy {
 
   virtual void Shrink(const ShrinkArgs& shrink_args) = 0;
 
+  // Filters the next 'max_keys' keys of a scan of the KV spread over calls,
+  // instead of all of them.
+  virtual void IncrementalShrink(const ShrinkArgs& shrink_args,
+                                 int64 max_keys) {}
+
  protected:
   void EmplacePointer(ValuePtr<V>* value_ptr) {
     to_delete_.emplace_back(value_ptr);
@@ -59,10 +64,65 @@ class ShrinkPolicy {
     }
     to_delete_.clear();
   }
+
+  // Appends the next 'max_keys' keys of the scan of 'kv', from the cursor
+  // kept across calls, and at most one pass over 'kv' per call.
+  void NextKeys(KVInterface<K, V>* kv, int64 max_keys,
+                std::vector<K>* key_list,
+                std::vector<ValuePtr<V>*>* value_list) {
+    ++num_calls_;
+    const int64 num_slices = kv->NumSnapshotSlices();
+    int64 num_loaded_slices = 0;
+    while (static_cast<int64>(key_list->size()) < max_keys) {
+      if (slice_pos_ == slice_keys_.size()) {
+        if (num_loaded_slices == num_slices) {
+          break;
+        }
+        slice_keys_.clear();
+        slice_values_.clear();
+        slice_pos_ = 0;
+        if (slice_cursor_ == num_slices) {
+          slice_cursor_ = 0;
+          RetirePass();
+        }
+        kv->GetSnapshotSlice(slice_cursor_++, &slice_keys_, &slice_values_);
+        ++num_loaded_slices;
+        continue;
+      }
+      key_list->emplace_back(slice_keys_[slice_pos_]);
+      value_list->emplace_back(slice_values_[slice_pos_]);
+      ++slice_pos_;
+    }
+  }
+
  protected:
   std::vector<ValuePtr<V>*> to_delete_;
  private:
+  // Releases the value ptrs removed before the previous pass of the scan, so
+  // that the lookups of the steps since their removal are done with them.
+  void RetirePass() {
+    constexpr int64 kMinCallsPerRetire = 100;
+    if (num_calls_ - last_retire_call_ < kMinCallsPerRetire) {
+      return;
+    }
+    last_retire_call_ = num_calls_;
+    for (auto it : retired_) {
+      it->Destroy(alloc_);
+      delete it;
+    }
+    retired_.clear();
+    retired_.swap(to_delete_);
+  }
+
   Allocator* alloc_;
+  // The keys and values of the slice being scanned by NextKeys.
+  std::vector<K> slice_keys_;
+  std::vector<ValuePtr<V>*> slice_values_;
+  size_t slice_pos_ = 0;
+  int64 slice_cursor_ = 0;
+  int64 num_calls_ = 0;
+  int64 last_retire_call_ = 0;
+  std::vector<ValuePtr<V>*> retired_;
 };
 
 template<typename K, typename V>
@@ -105,6 +105,14 @@ class SingleTierStorage : public Storage<K, V> {
     return kv_->Lookup(key, value_ptr);
   }
 
+  void BatchGet(const K* key, ValuePtr<V>** value_ptr_list,
+                int64 num_of_keys) override {
+    Status s = kv_->BatchLookup(key, num_of_keys, value_ptr_list);
+    if (s.code() == error::UNIMPLEMENTED) {
+      Storage<K, V>::BatchGet(key, value_ptr_list, num_of_keys);
+    }
+  }
+
   Status Contains(K key) override {
     return kv_->Contains(key);
   }
@@ -163,6 +171,10 @@ class SingleTierStorage : public Storage<K, V> {
   int64 Size() const override {
     return kv_->Size();
   }
+
+  void Reserve(int64 num_keys) override {
+    kv_->Reserve(num_keys);
+  }
   
   int64 Size(int level) const override {
     if (level > 0) {
@@ -324,6 +336,16 @@ class SingleTierStorage : public Storage<K, V> {
     return Status::OK();
   }
 
+  Status IncrementalShrink(const ShrinkArgs& shrink_args,
+                           int64 max_keys) override {
+    if (!Storage<K, V>::mu_.try_lock()) {
+      return Status::OK();
+    }
+    shrink_policy_->IncrementalShrink(shrink_args, max_keys);
+    Storage<K, V>::mu_.unlock();
+    return Status::OK();
+  }
+
   void SetAllocLen(int64 value_len, int slot_num) override {
     while (Storage<K, V>::flag_.test_and_set(std::memory_order_acquire));
     // The start address of every slot should be aligned to 16 bytes,
@@ -451,8 +473,9 @@ class HbmStorage : public SingleTierStorage<K, V> {
   }
 
   void BatchLookupOrCreateKeys(const K* key, int32* item_idxs, size_t n,
-      const Eigen::GpuDevice& device) override {
-    SingleTierStorage<K, V>::kv_->BatchLookupOrCreateKeys(key, n, item_idxs, device);
+      const Eigen::GpuDevice& device, int64 update_version) override {
+    SingleTierStorage<K, V>::kv_->BatchLookupOrCreateKeys(key, n, item_idxs,
+        device, update_version);
   }
 
   void BatchLookup(const Eigen::GpuDevice& device, const K* keys, V* val,
@@ -486,6 +509,16 @@ class HbmStorage : public SingleTierStorage<K, V> {
     return SingleTierStorage<K, V>::kv_->HashTable();
   }
 
+  Status Shrink(const ShrinkArgs& shrink_args) override {
+    GPUHashMapKV<K, V>* gpu_kv =
+        dynamic_cast<GPUHashMapKV<K, V>*>(SingleTierStorage<K, V>::kv_);
+    if (gpu_kv->IsOpenAddressing()) {
+      gpu_kv->Evict(shrink_args.global_step);
+      return Status::OK();
+    }
+    return SingleTierStorage<K, V>::Shrink(shrink_args);
+  }
+
  protected:
   void SetTotalDims(int64 total_dims) override {}
 };
@@ -555,6 +588,10 @@ class PmemLibpmemStorage : public SingleTierStorage<K, V> {
     return SingleTierStorage<K, V>::kv_->Commit(keys, value_ptr);
   }
 
+  Status TryInsert(K key, ValuePtr<V>* value_ptr) {
+    return SingleTierStorage<K, V>::kv_->Insert(key, value_ptr);
+  }
+
   TF_DISALLOW_COPY_AND_ASSIGN(PmemLibpmemStorage);
  
  protected:
@@ -567,7 +604,9 @@ class LevelDBStore : public SingleTierStorage<K, V> {
  public:
   LevelDBStore(const StorageConfig& sc, Allocator* alloc,
       LayoutCreator<V>* lc) : SingleTierStorage<K, V>(
-          sc, alloc, new LevelDBKV<K, V>(sc.path), lc) {
+          sc, alloc, new LevelDBKV<K, V>(sc.path,
+              sc.leveldb_block_cache_size, sc.leveldb_bloom_bits_per_key),
+          lc) {
   }
   ~LevelDBStore() override {}
 
@@ -577,10 +616,18 @@ class LevelDBStore : public SingleTierStorage<K, V> {
     return SingleTierStorage<K, V>::kv_->Commit(keys, value_ptr);
   }
 
+  Status BatchWrite(const K* keys, ValuePtr<V>* const* value_ptrs,
+                    int64 num_of_keys) {
+    return leveldb_kv()->BatchWrite(keys, value_ptrs, num_of_keys);
+  }
+
+  void BatchLookup(const K* keys, ValuePtr<V>** value_ptrs,
+                   int64 num_of_keys) {
+    leveldb_kv()->BatchLookup(keys, value_ptrs, num_of_keys);
+  }
+
   embedding::Iterator* GetIterator() override {
-    LevelDBKV<K, V>* leveldb_kv =
-        reinterpret_cast<LevelDBKV<K, V>*>(SingleTierStorage<K, V>::kv_);
-    return leveldb_kv->GetIterator();
+    return leveldb_kv()->GetIterator();
   }
  public:
   friend class DramLevelDBStore<K, V>;
@@ -589,6 +636,11 @@ class LevelDBStore : public SingleTierStorage<K, V> {
   void SetTotalDims(int64 total_dims) override {
     SingleTierStorage<K, V>::kv_->SetTotalDims(total_dims);
   }
+
+ private:
+  LevelDBKV<K, V>* leveldb_kv() {
+    return reinterpret_cast<LevelDBKV<K, V>*>(SingleTierStorage<K, V>::kv_);
+  }
 };
 
 template<typename K, typename V>
@@ -641,6 +693,12 @@ class SsdHashStorage : public SingleTierStorage<K, V> {
         reinterpret_cast<SSDHashKV<K, V>*>(SingleTierStorage<K, V>::kv_);
     ssd_kv->SetSsdRecordDescriptor(ssd_rec_desc);
   }
+
+  void SetEmbeddingDims(int64 emb_dims) {
+    SSDHashKV<K, V>* ssd_kv =
+        reinterpret_cast<SSDHashKV<K, V>*>(SingleTierStorage<K, V>::kv_);
+    ssd_kv->SetEmbeddingDims(emb_dims);
+  }
  public:
   friend class DramSsdHashStorage<K, V>;
 #if GOOGLE_CUDA
@@ -649,6 +707,9 @@ class SsdHashStorage : public SingleTierStorage<K, V> {
 
  protected:
   void SetTotalDims(int64 total_dims) override {
+    if (Storage<K, V>::alloc_len_ > 0) {
+      SetEmbeddingDims(Storage<K, V>::alloc_len_);
+    }
     SingleTierStorage<K, V>::kv_->SetTotalDims(total_dims);
   }
 };
@@ -16,18 +16,24 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_SSD_HASH_KV_H_
 #define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_SSD_HASH_KV_H_
 
+#include <functional>
 #include <map>
 #include <vector>
 #include <cstdlib>
 
 #include "sparsehash/dense_hash_map_lockless"
 #include "sparsehash/dense_hash_set_lockless"
+#include "tensorflow/core/framework/embedding/compaction_scheduler.h"
+#include "tensorflow/core/framework/embedding/cpu_plan.h"
 #include "tensorflow/core/framework/embedding/emb_file_creator.h"
 #include "tensorflow/core/framework/embedding/kv_interface.h"
+#include "tensorflow/core/framework/embedding/ssd_record_codec.h"
 #include "tensorflow/core/framework/embedding/value_ptr.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
@@ -47,6 +53,8 @@ struct SsdRecordDescriptor {
   std::vector<int64> key_offset_list;
    //files in ssd storage
   std::vector<int64> file_list;
+  //paths of the files in ssd storage
+  std::vector<std::string> file_path_list;
   //number of invalid records in the file
   std::vector<int64> invalid_record_count_list;
   //number of records in the file
@@ -54,54 +62,67 @@ struct SsdRecordDescriptor {
 };
 
 namespace embedding {
+// The position of a record in the files of SSDHashKV, packed in the 8 bytes
+// stored inline as the values of its index, instead of a heap allocated
+// position per key:
+//   bits 0-31   the offset of the record in its file, which is also its
+//               offset in the write buffer until the buffer is flushed,
+//   bits 32-62  the version of the file,
+//   bit 63      whether the record is flushed to the file.
+// Positions are updated with compare and swap, kEmptyEmbPosition is the
+// value of the empty buckets.
+constexpr uint64 kEmptyEmbPosition = ~0ULL;
+
 class EmbPosition {
  public:
-  EmbPosition(int o, size_t v, int bo, bool f)
-      : offset_(o), version_(v), buffer_offset_(bo), flushed_(f),
-        invalid_(false) {}
-
-  EmbPosition()
-      : offset_(-1),
-        version_(-1),
-        buffer_offset_(-1),
-        flushed_(false),
-        invalid_(false) {}
-
-  void Print() {
-    LOG(INFO) << "EmbPosition: "
-              << "offset = " << offset_
-              << ", version = " << version_
-              << ", buffer_offset = " << buffer_offset_
-              << ", flushed = " << flushed_;
+  static uint64 Pack(size_t offset, size_t version, bool flushed) {
+    DCHECK_LE(offset, kuint32max);
+    CHECK_LT(version, (1ULL << 31) - 1) << "Too many files in SSDHashKV.";
+    return static_cast<uint64>(offset) | (static_cast<uint64>(version) << 32) |
+           (flushed ? kFlushedBit : 0);
   }
- public:
-  int offset_;
-  int buffer_offset_;
-  size_t version_;
-  bool flushed_;
-  bool invalid_;
+
+  static size_t Offset(uint64 pos) { return pos & kuint32max; }
+  static size_t Version(uint64 pos) { return (pos & ~kFlushedBit) >> 32; }
+  static bool Flushed(uint64 pos) { return (pos & kFlushedBit) != 0; }
+  static uint64 SetFlushed(uint64 pos) { return pos | kFlushedBit; }
+
+  static string DebugString(uint64 pos) {
+    return strings::StrCat("EmbPosition: offset = ", Offset(pos),
+                           ", version = ", Version(pos),
+                           ", flushed = ", Flushed(pos));
+  }
+
+ private:
+  enum : uint64 { kFlushedBit = 1ULL << 63 };
 };
 
 template <class K>
 class SSDIterator : public Iterator {
  public:
-  SSDIterator(google::dense_hash_map_lockless<K, EmbPosition*>* hash_map,
+  SSDIterator(google::dense_hash_map_lockless<K, uint64>* hash_map,
               const std::vector<EmbFile*>& emb_files, int64 value_len,
-              char* write_buffer)
+              char* write_buffer, int64 record_len = -1,
+              std::function<void(const char*, char*)> decode_fn = nullptr)
       : emb_files_(emb_files),
         curr_file_(0),
         curr_vec_(0),
         value_len_(value_len),
-        write_buffer_(write_buffer) {
+        write_buffer_(write_buffer),
+        decode_fn_(decode_fn) {
+    if (decode_fn_) {
+      record_buf_.resize(record_len);
+      value_buf_.resize(value_len);
+    }
     for (auto it : *hash_map) {
-      EmbPosition* posi = it.second;
-      auto iter = file_map_.find(posi->version_);
+      const size_t version = EmbPosition::Version(it.second);
+      auto iter = file_map_.find(version);
       if (iter == file_map_.end()) {
-        std::vector<std::pair<K, EmbPosition*>> tmp;
-        file_map_[posi->version_] = tmp;
-        file_id_vec_.emplace_back(posi->version_);
+        std::vector<std::pair<K, uint64>> tmp;
+        file_map_[version] = tmp;
+        file_id_vec_.emplace_back(version);
       }
-      file_map_[posi->version_].emplace_back(it);
+      file_map_[version].emplace_back(it);
     }
   }
 
@@ -139,44 +160,40 @@ class SSDIterator : public Iterator {
 
   virtual void Value(char* val, int64 dim, int64 value_offset) {
     int64 f_id = file_id_vec_[curr_file_];
-    EmbPosition* posi = (file_map_[f_id])[curr_vec_].second;
-    if (posi->flushed_) {
-      emb_files_[posi->version_]->
+    const uint64 posi = (file_map_[f_id])[curr_vec_].second;
+    const size_t offset = EmbPosition::Offset(posi);
+    if (decode_fn_) {
+      // Encoded records are decoded as a whole.
+      if (EmbPosition::Flushed(posi)) {
+        emb_files_[EmbPosition::Version(posi)]->ReadWithMemcpy(
+            record_buf_.data(), record_buf_.size(), offset);
+      } else {
+        memcpy(record_buf_.data(), write_buffer_ + offset,
+               record_buf_.size());
+      }
+      decode_fn_(record_buf_.data(), value_buf_.data());
+      memcpy(val, value_buf_.data() + value_offset +
+          sizeof(FixedLengthHeader), dim);
+    } else if (EmbPosition::Flushed(posi)) {
+      emb_files_[EmbPosition::Version(posi)]->
           ReadWithMemcpy(val, dim,
-              posi->offset_ + value_offset + sizeof(FixedLengthHeader));
+              offset + value_offset + sizeof(FixedLengthHeader));
     } else {
-      memcpy(val, write_buffer_ + posi->buffer_offset_ +
+      memcpy(val, write_buffer_ + offset +
           value_offset + sizeof(FixedLengthHeader), dim);
     }
   }
 
   virtual void Freq(char* val, int64 dim) {
     int64 f_id = file_id_vec_[curr_file_];
-    EmbPosition* posi = (file_map_[f_id])[curr_vec_].second;
-    if (posi->flushed_) {
-      emb_files_[posi->version_]->
-          ReadWithMemcpy(val, sizeof(FixedLengthHeader),
-              posi->offset_);
-    } else {
-      memcpy(val, write_buffer_ + posi->buffer_offset_,
-             sizeof(FixedLengthHeader));
-    }
+    ReadHeader((file_map_[f_id])[curr_vec_].second, val);
     *((int64*)val) =
         reinterpret_cast<FixedLengthHeader*>(val)->GetFreqCounter();
   }
 
   virtual void Version(char* val, int64 dim) {
     int64 f_id = file_id_vec_[curr_file_];
-    EmbPosition* posi = (file_map_[f_id])[curr_vec_].second;
-
-    if (posi->flushed_) {
-      emb_files_[posi->version_]->
-          ReadWithMemcpy(val, sizeof(FixedLengthHeader),
-              posi->offset_);
-    } else {
-      memcpy(val, write_buffer_ + posi->buffer_offset_,
-             sizeof(FixedLengthHeader));
-    }
+    ReadHeader((file_map_[f_id])[curr_vec_].second, val);
     *((int64*)val) = 
         reinterpret_cast<FixedLengthHeader*>(val)->GetGlobalStep();
   }
@@ -192,16 +209,30 @@ class SSDIterator : public Iterator {
 
   virtual int64 Offset() {
     int64 f_id = file_id_vec_[curr_file_];
-    EmbPosition* posi = (file_map_[f_id])[curr_vec_].second;
-    return posi->offset_;
+    return EmbPosition::Offset((file_map_[f_id])[curr_vec_].second);
   }
 
  private:
+  void ReadHeader(uint64 posi, char* val) {
+    if (EmbPosition::Flushed(posi)) {
+      emb_files_[EmbPosition::Version(posi)]->
+          ReadWithMemcpy(val, sizeof(FixedLengthHeader),
+              EmbPosition::Offset(posi));
+    } else {
+      memcpy(val, write_buffer_ + EmbPosition::Offset(posi),
+             sizeof(FixedLengthHeader));
+    }
+  }
+
+
   int64 value_len_;
   int64 curr_file_;
   int64 curr_vec_;
   char* write_buffer_;
-  std::map<int64, std::vector<std::pair<K, EmbPosition*>>> file_map_;
+  std::function<void(const char*, char*)> decode_fn_;
+  std::vector<char> record_buf_;
+  std::vector<char> value_buf_;
+  std::map<int64, std::vector<std::pair<K, uint64>>> file_map_;
   std::vector<int64> file_id_vec_;
   std::vector<EmbFile*> emb_files_;
 };
@@ -211,10 +242,22 @@ class SSDHashKV : public KVInterface<K, V> {
  public:
   explicit SSDHashKV(const std::string& path, Allocator* alloc)
   : alloc_(alloc) {
-    path_ = io::JoinPath(
-        path, "ssd_kv_" + std::to_string(Env::Default()->NowMicros()) + "_");
+    std::string file_name =
+        "ssd_kv_" + std::to_string(Env::Default()->NowMicros()) + "_";
+    path_ = io::JoinPath(path, file_name);
+    // The files are striped over the storage path and the directories of
+    // TF_SSDHASH_STRIPE_PATHS, usually on other SSDs, by their version.
+    file_prefixes_.emplace_back(path_);
+    std::string stripe_paths;
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_SSDHASH_STRIPE_PATHS", "",
+          &stripe_paths));
+    for (const string& dir : str_util::Split(stripe_paths, ',',
+                                             str_util::SkipEmpty())) {
+      TF_CHECK_OK(Env::Default()->RecursivelyCreateDir(dir));
+      file_prefixes_.emplace_back(io::JoinPath(dir, file_name));
+    }
     hash_map_.max_load_factor(0.8);
-    hash_map_.set_empty_key_and_value(EMPTY_KEY, nullptr);
+    hash_map_.set_empty_key_and_value(EMPTY_KEY, kEmptyEmbPosition);
     hash_map_.set_counternum(16);
     hash_map_.set_deleted_key(DELETED_KEY);
     evict_file_set_.max_load_factor(0.8);
@@ -228,12 +271,15 @@ class SSDHashKV : public KVInterface<K, V> {
     is_async_compaction_ = true;
     TF_CHECK_OK(ReadBoolFromEnvVar("TF_SSDHASH_ASYNC_COMPACTION", true,
           &is_async_compaction_));
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_SSDHASH_RESTORE_LINK", false,
+          &is_link_restore_));
 
     std::string io_scheme = "mmap_and_madvise";
     TF_CHECK_OK(ReadStringFromEnvVar(
         "TF_SSDHASH_IO_SCHEME", "mmap_and_madvise", &io_scheme));
     emb_file_creator_ =  EmbFileCreatorFactory::Create(io_scheme);
-    EmbFile* ef = emb_file_creator_->Create(path_, current_version_, BUFFER_SIZE);
+    EmbFile* ef = emb_file_creator_->Create(
+        FilePrefix(current_version_), current_version_, BUFFER_SIZE);
     emb_files_.emplace_back(ef);
 
     if (!is_async_compaction_) {
@@ -264,16 +310,37 @@ class SSDHashKV : public KVInterface<K, V> {
   void SetTotalDims(int total_dims) override {
     total_dims_ = total_dims;
     val_len_ = sizeof(FixedLengthHeader) + total_dims_ * sizeof(V);
-    max_app_count_ = BUFFER_SIZE / val_len_;
+    codec_.SetDims(emb_dims_, total_dims_);
+    is_identity_codec_ = codec_.IsIdentity();
+    record_len_ = is_identity_codec_ ? val_len_ : codec_.RecordLen();
+    if (!is_identity_codec_) {
+      LOG(INFO) << "SSDHashKV encodes records of " << val_len_
+                << " bytes into " << record_len_ << " bytes.";
+    }
+    max_app_count_ = BUFFER_SIZE / record_len_;
     write_buffer_ = new char[BUFFER_SIZE];
-    unsigned int max_key_count = 1 + int(BUFFER_SIZE / val_len_);
+    unsigned int max_key_count = 1 + int(BUFFER_SIZE / record_len_);
     key_buffer_ = new K[max_key_count];
     done_ = true;
   }
 
+  // The leading emb_dims elements of the records are the primary
+  // embedding, the others are the optimizer slots. Must be called before
+  // SetTotalDims.
+  void SetEmbeddingDims(int64 emb_dims) {
+    emb_dims_ = emb_dims;
+  }
+
   Iterator* GetIterator() override {
+    if (is_identity_codec_) {
+      return new SSDIterator<K>(&hash_map_, emb_files_, val_len_,
+          write_buffer_);
+    }
     return new SSDIterator<K>(&hash_map_, emb_files_, val_len_,
-        write_buffer_);
+        write_buffer_, record_len_,
+        [this](const char* record, char* val) {
+          codec_.Decode(record, val);
+        });
   }
 
   void SetSsdRecordDescriptor(SsdRecordDescriptor<K>* ssd_rec_desc) {
@@ -291,6 +358,7 @@ class SSDHashKV : public KVInterface<K, V> {
       if (file->IsDeleted())
         continue;
       ssd_rec_desc->file_list.emplace_back(file->Version());
+      ssd_rec_desc->file_path_list.emplace_back(file->FilePath());
       ssd_rec_desc->invalid_record_count_list.emplace_back(
           file->InvalidCount());
       ssd_rec_desc->record_count_list.emplace_back(
@@ -300,13 +368,13 @@ class SSDHashKV : public KVInterface<K, V> {
     if (buffer_cur_ > 0) {
       if (!is_async_compaction_) {
         emb_files_[current_version_]->Write(write_buffer_,
-            buffer_cur_ * val_len_);
+            buffer_cur_ * record_len_);
         emb_files_[current_version_]->Flush();
         ++current_version_;
         CreateFile(current_version_);
       } else {
         emb_files_[evict_version_]->Write(write_buffer_,
-            buffer_cur_ * val_len_);
+            buffer_cur_ * record_len_);
         emb_files_[evict_version_]->Flush();
         evict_version_ = ++current_version_;
         CreateFile(evict_version_);
@@ -321,10 +389,10 @@ class SSDHashKV : public KVInterface<K, V> {
     if (buffer_cur_ > 0) {
       if (!is_async_compaction_) {
         emb_files_[current_version_]->Write(write_buffer_,
-            buffer_cur_ * val_len_);
+            buffer_cur_ * record_len_);
       } else {
         emb_files_[evict_version_]->Write(write_buffer_,
-            buffer_cur_ * val_len_);
+            buffer_cur_ * record_len_);
         mutex_lock l(shutdown_mu_);
         shutdown_ = true;
         // Need last compaction or not???
@@ -339,7 +407,6 @@ class SSDHashKV : public KVInterface<K, V> {
       }
       delete it;
     }
-    DeallocateEmbPositions();
     delete[] write_buffer_;
     delete[] key_buffer_;
   }
@@ -350,8 +417,21 @@ class SSDHashKV : public KVInterface<K, V> {
       if (iter.first == EMPTY_KEY) {
         return errors::NotFound("Unable to find Key: ",
             key_buffer_[i], " in SSDHashKV.");
-      } else {
-        iter.second->flushed_ = true;
+      }
+      // Finds the bucket of the key to update its position in place.
+      uint64* posi = &((*(hash_map_.insert_lockless(std::move(
+          std::pair<K, uint64>(key_buffer_[i], kEmptyEmbPosition)))
+          .first)).second);
+      uint64 old_posi = *posi;
+      if (old_posi == kEmptyEmbPosition) {
+        // Removed since.
+        hash_map_.erase_lockless(key_buffer_[i]);
+        continue;
+      }
+      while (!EmbPosition::Flushed(old_posi) &&
+             !__sync_bool_compare_and_swap(posi, old_posi,
+                                           EmbPosition::SetFlushed(old_posi))) {
+        old_posi = *posi;
       }
     }
     return Status::OK();
@@ -363,20 +443,78 @@ class SSDHashKV : public KVInterface<K, V> {
       return errors::NotFound("Unable to find Key: ", key, " in SSDHashKV.");
     } else {
       ValuePtr<V>* val = new_value_ptr_fn_(total_dims_);
-      EmbPosition* posi = iter.second;
-      if (posi->flushed_) {
-        emb_files_[posi->version_]->Read((char*)(val->GetPtr()),
-            val_len_, posi->offset_);
+      const uint64 posi = iter.second;
+      std::vector<char> record;
+      char* record_ptr = (char*)(val->GetPtr());
+      if (!is_identity_codec_) {
+        record.resize(record_len_);
+        record_ptr = record.data();
+      }
+      if (EmbPosition::Flushed(posi)) {
+        compaction_scheduler_.StartForegroundRead();
+        emb_files_[EmbPosition::Version(posi)]->Read(record_ptr,
+            record_len_, EmbPosition::Offset(posi));
+        compaction_scheduler_.FinishForegroundRead();
       } else {
-        memcpy((char*)val->GetPtr(),
-            write_buffer_ + posi->buffer_offset_, val_len_);
+        memcpy(record_ptr,
+            write_buffer_ + EmbPosition::Offset(posi), record_len_);
+      }
+      if (!is_identity_codec_) {
+        codec_.Decode(record_ptr, (char*)(val->GetPtr()));
       }
       *value_ptr = val;
-      posi->invalid_ = true;
       return Status::OK();
     }
   }
 
+  // The records of the keys in one file are read with one
+  // EmbFile::BatchRead instead of one Read per key.
+  Status BatchLookup(const K* keys, size_t size,
+                     ValuePtr<V>** value_ptrs) override {
+    std::map<size_t, std::vector<EmbFileReadRequest>> requests;
+    // Encoded records are read into records and decoded after the reads.
+    std::vector<char> records;
+    if (!is_identity_codec_) {
+      records.resize(size * record_len_);
+    }
+    for (size_t i = 0; i < size; i++) {
+      K key = keys[i];
+      auto iter = hash_map_.find_wait_free(key);
+      if (iter.first == EMPTY_KEY) {
+        value_ptrs[i] = nullptr;
+        continue;
+      }
+      ValuePtr<V>* val = new_value_ptr_fn_(total_dims_);
+      const uint64 posi = iter.second;
+      char* record_ptr = is_identity_codec_ ?
+          (char*)(val->GetPtr()) : records.data() + i * record_len_;
+      if (EmbPosition::Flushed(posi)) {
+        requests[EmbPosition::Version(posi)].emplace_back(EmbFileReadRequest{
+            record_ptr, record_len_, EmbPosition::Offset(posi)});
+      } else {
+        memcpy(record_ptr,
+            write_buffer_ + EmbPosition::Offset(posi), record_len_);
+      }
+      value_ptrs[i] = val;
+    }
+    if (!requests.empty()) {
+      compaction_scheduler_.StartForegroundRead();
+      for (auto& it : requests) {
+        emb_files_[it.first]->BatchRead(it.second.data(), it.second.size());
+      }
+      compaction_scheduler_.FinishForegroundRead();
+    }
+    if (!is_identity_codec_) {
+      for (size_t i = 0; i < size; i++) {
+        if (value_ptrs[i] != nullptr) {
+          codec_.Decode(records.data() + i * record_len_,
+                        (char*)(value_ptrs[i]->GetPtr()));
+        }
+      }
+    }
+    return Status::OK();
+  }
+
   Status Contains(K key) override {
     auto iter = hash_map_.find_wait_free(key);
     if (iter.first == EMPTY_KEY) {
@@ -399,6 +537,7 @@ class SSDHashKV : public KVInterface<K, V> {
                      const std::vector<ValuePtr<V>*>& value_ptrs) override {
     compaction_fn_();
     __sync_fetch_and_add(&total_app_count_, keys.size());
+    compaction_scheduler_.RecordWrite(keys.size() * record_len_);
     for (int i = 0; i < keys.size(); i++) {
       check_buffer_fn_();
       save_kv_fn_(keys[i], value_ptrs[i], false);
@@ -410,6 +549,7 @@ class SSDHashKV : public KVInterface<K, V> {
   Status Commit(K key, const ValuePtr<V>* value_ptr) override {
     compaction_fn_();
     __sync_fetch_and_add(&total_app_count_, 1);
+    compaction_scheduler_.RecordWrite(record_len_);
     check_buffer_fn_();
     save_kv_fn_(key, value_ptr, false);
     return Status::OK();
@@ -451,17 +591,25 @@ class SSDHashKV : public KVInterface<K, V> {
   void Import(K* key_list, int64* key_file_id_list,
               int64* key_offset_list, int64 num_of_keys,
               std::map<int64, int64>& file_id_map) {
-    for (int i = 0; i < num_of_keys; i++) {
-      int64 old_file_id = key_file_id_list[i];
-      int64 new_file_id = file_id_map[old_file_id];
-      EmbPosition* ep =
-          new EmbPosition(key_offset_list[i],
-                          new_file_id,
-                          0, true);
-      hash_map_.insert_lockless(std::move(
-          std::pair<K, EmbPosition*>(
-              key_list[i], const_cast<EmbPosition*>(ep))));
+    auto do_work = [this, key_list, key_file_id_list, key_offset_list,
+                    &file_id_map] (int64 start, int64 limit) {
+      for (int64 i = start; i < limit; i++) {
+        int64 new_file_id = file_id_map.find(key_file_id_list[i])->second;
+        hash_map_.insert_lockless(std::move(std::pair<K, uint64>(
+            key_list[i],
+            EmbPosition::Pack(key_offset_list[i], new_file_id, true))));
+      }
+    };
+    int64 num_threads = 1;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_SSDHASH_RESTORE_THREADS", 1,
+          &num_threads));
+    if (num_threads <= 1) {
+      do_work(0, num_of_keys);
+      return;
     }
+    thread::ThreadPool restore_pool(Env::Default(), ThreadOptions(),
+        "SSDHashKV_Restore", num_threads, /*low_latency_hint=*/false);
+    restore_pool.ParallelFor(num_of_keys, 1000 /*cost_per_unit*/, do_work);
   }
 
   void CopyEmbFilesFromCkpt(
@@ -476,12 +624,18 @@ class SSDHashKV : public KVInterface<K, V> {
       std::stringstream ss;
       ss << old_file_prefix << "/" << file_list[i] << ".emb";
       std::string old_file_path = ss.str();
-      EmbFile* f =
-          emb_file_creator_->Create(path_, current_version_, BUFFER_SIZE);
+      EmbFile* f = emb_file_creator_->Create(
+          FilePrefix(current_version_), current_version_, BUFFER_SIZE);
       ++current_version_;
-      f->LoadExistFile(old_file_path,
-                       record_count_list[i],
-                       invalid_record_count_list[i]);
+      if (is_link_restore_) {
+        f->LinkExistFile(old_file_path,
+                         record_count_list[i],
+                         invalid_record_count_list[i]);
+      } else {
+        f->LoadExistFile(old_file_path,
+                         record_count_list[i],
+                         invalid_record_count_list[i]);
+      }
       emb_files_.emplace_back(f);
       total_app_count_ += record_count_list[i];
     }
@@ -490,6 +644,10 @@ class SSDHashKV : public KVInterface<K, V> {
 
   int64 Size() const override { return hash_map_.size_lockless(); }
 
+  CompactionMetrics GetCompactionMetrics() const {
+    return compaction_scheduler_.GetMetrics();
+  }
+
   void FreeValuePtr(ValuePtr<V>* value_ptr) override {
     delete value_ptr;
   }
@@ -500,13 +658,17 @@ class SSDHashKV : public KVInterface<K, V> {
     emb_files_[version]->Flush();
   }
 
+  const std::string& FilePrefix(size_t version) const {
+    return file_prefixes_[version % file_prefixes_.size()];
+  }
+
   void CreateFile(size_t version) {
     emb_files_.emplace_back(
-        emb_file_creator_->Create(path_, version, BUFFER_SIZE));
+        emb_file_creator_->Create(FilePrefix(version), version, BUFFER_SIZE));
   }
 
   Status FlushAndUpdate(char* value_buffer, K* id_buffer,
-                        EmbPosition** pos_buffer, int64& n_ids,
+                        uint64* pos_buffer, int64& n_ids,
                         std::vector<int64>& invalid_files) {
     {
       mutex_lock l(mu_);
@@ -514,20 +676,19 @@ class SSDHashKV : public KVInterface<K, V> {
       CreateFile(compaction_version_);
     }
 
-    emb_files_[compaction_version_]->Write(value_buffer, n_ids * val_len_);
+    emb_files_[compaction_version_]->Write(value_buffer, n_ids * record_len_);
     emb_files_[compaction_version_]->AddCount(n_ids);
     emb_files_[compaction_version_]->Flush();
 
     for (int64 i = 0; i < n_ids; i++) {
       auto iter = hash_map_.insert_lockless(std::move(
-        std::pair<K, EmbPosition*>(id_buffer[i], nullptr)));
+        std::pair<K, uint64>(id_buffer[i], kEmptyEmbPosition)));
       if ((*(iter.first)).first == EMPTY_KEY) {
         return errors::NotFound("Unable to find Key: ",
             id_buffer[i], " in SSDHashKV.");
       } else {
-        size_t offset = i * val_len_;
-        EmbPosition* ep = new EmbPosition(offset, compaction_version_,
-            offset, true);
+        const uint64 ep =
+            EmbPosition::Pack(i * record_len_, compaction_version_, true);
         bool flag = __sync_bool_compare_and_swap(
             &((*(iter.first)).second), pos_buffer[i], ep);
         if (!flag) {
@@ -535,9 +696,6 @@ class SSDHashKV : public KVInterface<K, V> {
           if (emb_files_[compaction_version_]->IsNeedToBeCompacted()) {
             evict_file_set_.insert_lockless(compaction_version_);
           }
-          delete ep;
-        } else {
-          pos_out_of_date_compact_.emplace_back(pos_buffer[i]);
         }
       }
     }
@@ -551,8 +709,8 @@ class SSDHashKV : public KVInterface<K, V> {
   }
 
   void CheckBuffer() {
-    size_t curr_buffer_offset = buffer_cur_ * val_len_;
-    if (curr_buffer_offset + val_len_ > BUFFER_SIZE) {
+    size_t curr_buffer_offset = buffer_cur_ * record_len_;
+    if (curr_buffer_offset + record_len_ > BUFFER_SIZE) {
       WriteFile(current_version_, curr_buffer_offset);
       if (emb_files_[current_version_]->Count() >= max_app_count_) {
         ++current_version_;
@@ -565,8 +723,8 @@ class SSDHashKV : public KVInterface<K, V> {
   }
 
   void CheckBufferAsync() {
-    size_t curr_buffer_offset = buffer_cur_ * val_len_;
-    if (curr_buffer_offset + val_len_ > BUFFER_SIZE) {
+    size_t curr_buffer_offset = buffer_cur_ * record_len_;
+    if (curr_buffer_offset + record_len_ > BUFFER_SIZE) {
       WriteFile(evict_version_, curr_buffer_offset);
       TF_CHECK_OK(UpdateFlushStatus());
       mutex_lock l(mu_);
@@ -579,46 +737,39 @@ class SSDHashKV : public KVInterface<K, V> {
 
   void AppendToWriteBuffer(size_t curr_buffer_offset, K key,
                             const ValuePtr<V>* value_ptr) {
-    current_offset_ += val_len_;
-    memcpy(write_buffer_ + curr_buffer_offset,
-        (char*)value_ptr->GetPtr(), val_len_);
+    current_offset_ += record_len_;
+    if (is_identity_codec_) {
+      memcpy(write_buffer_ + curr_buffer_offset,
+          (char*)value_ptr->GetPtr(), val_len_);
+    } else {
+      codec_.Encode((char*)value_ptr->GetPtr(),
+                    write_buffer_ + curr_buffer_offset);
+    }
     key_buffer_[buffer_cur_] = key;
     ++buffer_cur_;
   }
 
-  void AppendToPositionRecordQueue(EmbPosition* old_posi) {
-    //A parameter that can be adjusted in the future
-    if (pos_out_of_date_.size() > CAP_INVALID_POS) {
-      EmbPosition* posi = pos_out_of_date_.front();
-      delete posi;
-      pos_out_of_date_.pop_front();
-    }
-    pos_out_of_date_.emplace_back(old_posi);
-  }
-
-  bool UpdatePosition(EmbPosition** pos, EmbPosition* old_posi,
-      EmbPosition* new_posi) {
-    bool flag = __sync_bool_compare_and_swap(pos, old_posi, new_posi);
-    if (flag) {
-      AppendToPositionRecordQueue(old_posi);
-    }
-    return flag;
+  bool UpdatePosition(uint64* pos, uint64 old_posi, uint64 new_posi) {
+    return __sync_bool_compare_and_swap(pos, old_posi, new_posi);
   }
 
   void SaveKV(K key, const ValuePtr<V>* value_ptr,
       bool is_compaction = false) {
-    size_t curr_buffer_offset = buffer_cur_ * val_len_;
-    EmbPosition* ep = new EmbPosition(current_offset_, current_version_,
-                                      curr_buffer_offset, false);
+    size_t curr_buffer_offset = buffer_cur_ * record_len_;
+    // The write buffer is flushed at the start of a file, so the records
+    // have the same offset in both.
+    DCHECK_EQ(static_cast<size_t>(current_offset_), curr_buffer_offset);
+    const uint64 ep = EmbPosition::Pack(current_offset_, current_version_,
+                                        false);
     AppendToWriteBuffer(curr_buffer_offset, key, value_ptr);
 
     auto iter = hash_map_.insert_lockless(std::move(
-        std::pair<K, EmbPosition*>(key, const_cast<EmbPosition*>(ep))));
-    emb_files_[ep->version_]->AddCount(1);
+        std::pair<K, uint64>(key, ep)));
+    emb_files_[current_version_]->AddCount(1);
 
     if ((*(iter.first)).second != ep) {
-      EmbPosition* old_posi = (*(iter.first)).second;
-      int64 version = old_posi->version_;
+      const uint64 old_posi = (*(iter.first)).second;
+      int64 version = EmbPosition::Version(old_posi);
       if (!is_compaction) {
         emb_files_[version]->AddInvalidCount(1);
         //A parameter that can be adjusted in the future
@@ -633,25 +784,26 @@ class SSDHashKV : public KVInterface<K, V> {
 
   void SaveKVAsync(K key, const ValuePtr<V>* value_ptr,
       bool is_compaction = false) {
-    size_t curr_buffer_offset = buffer_cur_ * val_len_;
-    EmbPosition* ep = new EmbPosition(current_offset_, evict_version_,
-                                      curr_buffer_offset, false);
+    size_t curr_buffer_offset = buffer_cur_ * record_len_;
+    DCHECK_EQ(static_cast<size_t>(current_offset_), curr_buffer_offset);
+    const uint64 ep = EmbPosition::Pack(current_offset_, evict_version_,
+                                        false);
 
     AppendToWriteBuffer(curr_buffer_offset, key, value_ptr);
     auto iter = hash_map_.insert_lockless(std::move(
-        std::pair<K, EmbPosition*>(key, const_cast<EmbPosition*>(ep))));
-    emb_files_[ep->version_]->AddCount(1);
+        std::pair<K, uint64>(key, ep)));
+    emb_files_[evict_version_]->AddCount(1);
 
     if ((*(iter.first)).second != ep) {
       bool flag = false;
-      EmbPosition* old_posi = nullptr;
+      uint64 old_posi = kEmptyEmbPosition;
       do {
         old_posi = (*(iter.first)).second;
         flag = UpdatePosition(&((*(iter.first)).second), old_posi, ep);
       } while (!flag);
 
       if (!is_compaction) {
-        int version = old_posi->version_;
+        int version = EmbPosition::Version(old_posi);
         emb_files_[version]->AddInvalidCountAtomic(1);
         //A parameter that can be adjusted in the future
         if (version != evict_version_ &&
@@ -669,26 +821,29 @@ class SSDHashKV : public KVInterface<K, V> {
     evict_file_map_.clear();
   }
 
-  void DeleteInvalidRecord() {
-    for (auto it: pos_out_of_date_compact_) {
-      delete it;
-    }
-    pos_out_of_date_compact_.clear();
-  }
-
   void LookupValidItems() {
     for (auto it : hash_map_) {
-      EmbPosition* posi = it.second;
-      auto iter = evict_file_map_.find(posi->version_);
+      auto iter = evict_file_map_.find(EmbPosition::Version(it.second));
       if (iter != evict_file_map_.end()) {
         (*iter).second.emplace_back(it);
       }
     }
   }
 
-  void InitializeEvictMap() {
+  // Returns the files of evict_file_set_ to compact in this round.
+  std::vector<int64> PickVictimFiles() {
+    std::vector<CompactionScheduler::Candidate> candidates;
     for (auto it : evict_file_set_) {
-      std::vector<std::pair<K, EmbPosition*>> tmp;
+      EmbFile* file = emb_files_[it];
+      candidates.emplace_back(CompactionScheduler::Candidate{
+          it, (int64)file->Count(), (int64)file->InvalidCount()});
+    }
+    return compaction_scheduler_.PickVictims(candidates, current_version_);
+  }
+
+  void InitializeEvictMap() {
+    for (auto it : PickVictimFiles()) {
+      std::vector<std::pair<K, uint64>> tmp;
       evict_file_map_[it] = tmp;
       evict_file_set_.erase_lockless(it);
     }
@@ -696,8 +851,8 @@ class SSDHashKV : public KVInterface<K, V> {
   }
 
   void InitializeEvictMapWithoutErase() {
-    for (auto it : evict_file_set_) {
-      std::vector<std::pair<K, EmbPosition*>> tmp;
+    for (auto it : PickVictimFiles()) {
+      std::vector<std::pair<K, uint64>> tmp;
       evict_file_map_[it] = tmp;
     }
     LookupValidItems();
@@ -705,14 +860,24 @@ class SSDHashKV : public KVInterface<K, V> {
 
   void MoveToNewFile() {
     ValuePtr<V>* val = new_value_ptr_fn_(total_dims_);
+    std::vector<char> record;
+    char* record_ptr = (char*)(val->GetPtr());
+    if (!is_identity_codec_) {
+      record.resize(record_len_);
+      record_ptr = record.data();
+    }
     for (auto it : evict_file_map_) {
       EmbFile* file = emb_files_[it.first];
       total_app_count_ -= file->InvalidCount();
       file->MapForRead();
       for (auto it_vec : it.second) {
-        EmbPosition* posi = it_vec.second;
-        file->ReadWithMemcpy((char*)(val->GetPtr()), val_len_,
-            posi->offset_);
+        compaction_scheduler_.Throttle(2 * record_len_);
+        file->ReadWithMemcpy(record_ptr, record_len_,
+                             EmbPosition::Offset(it_vec.second));
+        if (!is_identity_codec_) {
+          codec_.Decode(record_ptr, (char*)(val->GetPtr()));
+        }
+        compaction_scheduler_.RecordRewrite(record_len_);
         CheckBuffer();
         SaveKV(it_vec.first, val, true);
       }
@@ -725,19 +890,21 @@ class SSDHashKV : public KVInterface<K, V> {
     char* compact_buffer = new char[BUFFER_SIZE];
     int64 n_ids = 0;
     std::vector<int64> invalid_files;
-    unsigned int max_key_count = 1 + int(BUFFER_SIZE / val_len_);
+    unsigned int max_key_count = 1 + int(BUFFER_SIZE / record_len_);
     K* id_buffer = new K[max_key_count];
-    EmbPosition** pos_buffer = new EmbPosition*[max_key_count];
+    uint64* pos_buffer = new uint64[max_key_count];
     for (auto it : evict_file_map_) {
       EmbFile* file = emb_files_[it.first];
       __sync_fetch_and_sub(&total_app_count_, file->InvalidCount());
       file->MapForRead();
       for (auto it_vec : it.second) {
-        EmbPosition* posi = it_vec.second;
         id_buffer[n_ids] = it_vec.first;
-        pos_buffer[n_ids] = posi;
-        file->ReadWithMemcpy(compact_buffer + val_len_ * n_ids, val_len_,
-            posi->offset_);
+        pos_buffer[n_ids] = it_vec.second;
+        // The encoded records are moved as they are.
+        compaction_scheduler_.Throttle(2 * record_len_);
+        file->ReadWithMemcpy(compact_buffer + record_len_ * n_ids,
+            record_len_, EmbPosition::Offset(it_vec.second));
+        compaction_scheduler_.RecordRewrite(record_len_);
         n_ids++;
         if (n_ids == max_app_count_) {
           Status st = FlushAndUpdate(compact_buffer, id_buffer,
@@ -770,7 +937,9 @@ class SSDHashKV : public KVInterface<K, V> {
       // Initialize evict_file_map
       InitializeEvictMap();
       // read embeddings and write to new file
+      compaction_scheduler_.StartCompaction();
       MoveToNewFile();
+      FinishCompaction();
     }
   }
 
@@ -779,17 +948,28 @@ class SSDHashKV : public KVInterface<K, V> {
     //These parameter that can be adjusted in the future
     if (hash_size * 3 / 2 < total_app_count_ ||
         total_app_count_ - hash_size > CAP_INVALID_ID) {
-      DeleteInvalidRecord();
       // delete the evict_files
       DeleteInvalidFiles();
       // Initialize evict_file_map
       InitializeEvictMapWithoutErase();
       // read embeddings and write to new file
+      compaction_scheduler_.StartCompaction();
       MoveToNewFileAsync();
+      FinishCompaction();
+    }
+  }
+
+  void FinishCompaction() {
+    compaction_scheduler_.FinishCompaction(evict_file_map_.size());
+    if (!evict_file_map_.empty()) {
+      LOG(INFO) << "SSDHashKV compacted " << evict_file_map_.size()
+                << " files, "
+                << compaction_scheduler_.GetMetrics().DebugString();
     }
   }
 
   void CompactionThread() {
+    PinBackgroundThread();
     if (val_len_ == -1) {
       while (!done_) {
       }
@@ -817,26 +997,18 @@ class SSDHashKV : public KVInterface<K, V> {
                            ", map info min_load_factor: ",
                            hash_map_.min_load_factor(),
                            ", evict_version: ", evict_version_,
-                           ", compaction_version: ", compaction_version_);
+                           ", compaction_version: ", compaction_version_,
+                           ", ",
+                           compaction_scheduler_.GetMetrics().DebugString());
   }
- private:
-  void DeallocateEmbPositions() {
-    std::pair<const K, EmbPosition*> *hash_map_dump;
-    int64 bucket_count;
-    auto it = hash_map_.GetSnapshot();
-    hash_map_dump = it.first;
-    bucket_count = it.second;
-    for (int64 j = 0; j < bucket_count; j++) {
-      if (hash_map_dump[j].first != SSDHashKV<K, V>::EMPTY_KEY
-           && hash_map_dump[j].first != SSDHashKV<K, V>::DELETED_KEY) {
-        delete hash_map_dump[j].second;
-      }
-    }
-    free(hash_map_dump);
-  }
-
  private:
   size_t val_len_ = -1;
+  // Length of the records in write_buffer_ and emb_files_, val_len_ unless
+  // codec_ encodes them.
+  size_t record_len_ = -1;
+  SsdRecordCodec<V> codec_;
+  bool is_identity_codec_ = true;
+  int64 emb_dims_ = -1;
   volatile size_t current_version_ = 0;
   volatile size_t evict_version_ = 0;
   volatile size_t compaction_version_ = 0;
@@ -848,13 +1020,15 @@ class SSDHashKV : public KVInterface<K, V> {
   char* write_buffer_ = nullptr;
   K* key_buffer_ = nullptr;
   bool is_async_compaction_;
+  bool is_link_restore_ = false;
   Allocator* alloc_ = nullptr;
 
   int total_dims_;
   std::string path_;
+  std::vector<std::string> file_prefixes_;
   std::function<ValuePtr<V>*(size_t)> new_value_ptr_fn_;
 
-  typedef google::dense_hash_map_lockless<K, EmbPosition*> LockLessHashMap;
+  typedef google::dense_hash_map_lockless<K, uint64> LockLessHashMap;
   LockLessHashMap hash_map_;
   mutex mu_;
   mutex shutdown_mu_;
@@ -862,16 +1036,13 @@ class SSDHashKV : public KVInterface<K, V> {
 
   static const int EMPTY_KEY;
   static const int DELETED_KEY;
-  static const int CAP_INVALID_POS;
   static const int CAP_INVALID_ID;
   static const size_t BUFFER_SIZE;
 
   std::vector<EmbFile*> emb_files_;
-  std::deque<EmbPosition*> pos_out_of_date_;
-  std::deque<EmbPosition*> pos_out_of_date_compact_;
   typedef google::dense_hash_set_lockless<K> LocklessHashSet;
   LocklessHashSet evict_file_set_;
-  std::map<int64, std::vector<std::pair<K, EmbPosition*>>> evict_file_map_;
+  std::map<int64, std::vector<std::pair<K, uint64>>> evict_file_map_;
 
   Thread* compaction_thread_ = nullptr;
   volatile bool shutdown_ = false;
@@ -882,14 +1053,13 @@ class SSDHashKV : public KVInterface<K, V> {
   std::function<void()> check_buffer_fn_;
   std::function<void(K, const ValuePtr<V>*, bool)> save_kv_fn_;
   EmbFileCreator* emb_file_creator_ = nullptr;
+  CompactionScheduler compaction_scheduler_;
 };
 template <class K, class V>
 const int SSDHashKV<K, V>::EMPTY_KEY = -1;
 template <class K, class V>
 const int SSDHashKV<K, V>::DELETED_KEY = -2;
 template <class K, class V>
-const int SSDHashKV<K, V>::CAP_INVALID_POS = 200000;
-template <class K, class V>
 const int SSDHashKV<K, V>::CAP_INVALID_ID = 10000000;
 template <class K, class V>
 const size_t SSDHashKV<K, V>::BUFFER_SIZE = 1 << 27;
@@ -0,0 +1,208 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_SSD_RECORD_CODEC_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_SSD_RECORD_CODEC_H_
+
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <string>
+
+#include "tensorflow/core/framework/embedding/row_quantization.h"
+#include "tensorflow/core/framework/embedding/value_ptr.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace embedding {
+
+enum class SsdCodec {
+  NONE = 0,
+  FP16 = 1,
+  // One float scale per row followed by the int8 values.
+  INT8 = 2,
+  // Only for slots, they are not stored.
+  DROP = 3
+};
+
+// Encodes the records of SSDHashKV, a FixedLengthHeader followed by the
+// primary embedding and the slots, into the records of EmbFile:
+//  * TF_SSDHASH_CODEC is none, fp16 or int8 for the primary embedding.
+//  * TF_SSDHASH_SLOT_CODEC is none, fp16, int8 or drop for the slots.
+//  * With TF_SSDHASH_SLOT_TTL_STEPS = N > 0, the slots of the records N
+//    steps older than the latest committed one are dropped when decoded.
+// Dropped slots are marked uninitialized in the header, so they are
+// initialized again with their default values when they are used.
+// The header is kept as is, so that the iterators read its step and freq
+// without decoding.
+template <class V>
+class SsdRecordCodec {
+ public:
+  SsdRecordCodec() {
+    std::string codec = "none";
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_SSDHASH_CODEC", "none", &codec));
+    emb_codec_ = ParseCodec(codec);
+    if (emb_codec_ == SsdCodec::DROP) {
+      LOG(WARNING) << "Primary embeddings of SSDHASH can't be dropped,"
+                   << " use the none codec.";
+      emb_codec_ = SsdCodec::NONE;
+    }
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_SSDHASH_SLOT_CODEC", "none",
+                                     &codec));
+    slot_codec_ = ParseCodec(codec);
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_SSDHASH_SLOT_TTL_STEPS", 0,
+                                    &slot_ttl_steps_));
+  }
+
+  // emb_dims elements of the primary embedding lead total_dims elements
+  // of a record.
+  void SetDims(int64 emb_dims, int64 total_dims) {
+    emb_dims_ = (emb_dims <= 0 || emb_dims > total_dims)
+        ? total_dims : emb_dims;
+    slot_dims_ = total_dims - emb_dims_;
+  }
+
+  bool IsIdentity() const {
+    return emb_codec_ == SsdCodec::NONE &&
+           (slot_codec_ == SsdCodec::NONE || slot_dims_ == 0) &&
+           slot_ttl_steps_ <= 0;
+  }
+
+  // Records are padded to 8 bytes, so the rows in them stay aligned.
+  size_t RecordLen() const {
+    size_t len = sizeof(FixedLengthHeader) +
+        EncodedLen(emb_codec_, emb_dims_) +
+        EncodedLen(slot_codec_, slot_dims_);
+    return (len + 7) / 8 * 8;
+  }
+
+  size_t ValueLen() const {
+    return sizeof(FixedLengthHeader) + (emb_dims_ + slot_dims_) * sizeof(V);
+  }
+
+  void Encode(const char* val, char* record) {
+    memcpy(record, val, sizeof(FixedLengthHeader));
+    int64 step =
+        reinterpret_cast<FixedLengthHeader*>(record)->GetGlobalStep();
+    int64 latest = latest_step_.load(std::memory_order_relaxed);
+    while (step != kNoStep && step > latest &&
+           !latest_step_.compare_exchange_weak(latest, step)) {}
+    const V* emb =
+        reinterpret_cast<const V*>(val + sizeof(FixedLengthHeader));
+    char* out = record + sizeof(FixedLengthHeader);
+    EncodeRow(emb_codec_, emb, emb_dims_, out);
+    EncodeRow(slot_codec_, emb + emb_dims_, slot_dims_,
+              out + EncodedLen(emb_codec_, emb_dims_));
+  }
+
+  void Decode(const char* record, char* val) {
+    memcpy(val, record, sizeof(FixedLengthHeader));
+    FixedLengthHeader* header = reinterpret_cast<FixedLengthHeader*>(val);
+    V* emb = reinterpret_cast<V*>(val + sizeof(FixedLengthHeader));
+    const char* in = record + sizeof(FixedLengthHeader);
+    DecodeRow(emb_codec_, in, emb_dims_, emb);
+    if (slot_dims_ == 0) {
+      return;
+    }
+    int64 step = header->GetGlobalStep();
+    bool expired = slot_ttl_steps_ > 0 && step != kNoStep &&
+        latest_step_.load(std::memory_order_relaxed) - step >
+            slot_ttl_steps_;
+    if (slot_codec_ == SsdCodec::DROP || expired) {
+      memset(emb + emb_dims_, 0, slot_dims_ * sizeof(V));
+      // Bits 49 ~ 55 mark the slots 1 ~ 7 initialized.
+      header->global_step &= ~(static_cast<int64>(0xfe) << 48);
+    } else {
+      DecodeRow(slot_codec_, in + EncodedLen(emb_codec_, emb_dims_),
+                slot_dims_, emb + emb_dims_);
+    }
+  }
+
+  static size_t EncodedLen(SsdCodec codec, int64 dims) {
+    switch (codec) {
+      case SsdCodec::FP16:
+        return QuantizedRowBytes(RowQuantization::FP16, dims, 0);
+      case SsdCodec::INT8:
+        return QuantizedRowBytes(RowQuantization::INT8, dims, 0);
+      case SsdCodec::DROP:
+        return 0;
+      default:
+        return dims * sizeof(V);
+    }
+  }
+
+ private:
+  static SsdCodec ParseCodec(const std::string& codec) {
+    std::map<std::string, SsdCodec> codec_map{
+      {"none", SsdCodec::NONE},
+      {"fp16", SsdCodec::FP16},
+      {"int8", SsdCodec::INT8},
+      {"drop", SsdCodec::DROP}
+    };
+    auto it = codec_map.find(codec);
+    if (it == codec_map.end()) {
+      LOG(WARNING) << "Invalid codec of SSDHASH: " << codec
+                   << ", use the none codec.";
+      return SsdCodec::NONE;
+    }
+    return it->second;
+  }
+
+  static void EncodeRow(SsdCodec codec, const V* in, int64 dims,
+                        char* out) {
+    switch (codec) {
+      case SsdCodec::FP16:
+        QuantizeRow(RowQuantization::FP16, in, dims, 0, out);
+        break;
+      case SsdCodec::INT8:
+        QuantizeRow(RowQuantization::INT8, in, dims, 0, out);
+        break;
+      case SsdCodec::DROP:
+        break;
+      default:
+        memcpy(out, in, dims * sizeof(V));
+    }
+  }
+
+  static void DecodeRow(SsdCodec codec, const char* in, int64 dims, V* out) {
+    switch (codec) {
+      case SsdCodec::FP16:
+        DequantizeRow(RowQuantization::FP16, in, dims, 0, out);
+        break;
+      case SsdCodec::INT8:
+        DequantizeRow(RowQuantization::INT8, in, dims, 0, out);
+        break;
+      case SsdCodec::DROP:
+        break;
+      default:
+        memcpy(out, in, dims * sizeof(V));
+    }
+  }
+
+  // The global step of the records never updated, see FixedLengthHeader.
+  static const int64 kNoStep = 0x0000ffffffffffff;
+
+  SsdCodec emb_codec_ = SsdCodec::NONE;
+  SsdCodec slot_codec_ = SsdCodec::NONE;
+  int64 slot_ttl_steps_ = 0;
+  int64 emb_dims_ = 0;
+  int64 slot_dims_ = 0;
+  std::atomic<int64> latest_step_{0};
+};
+
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_SSD_RECORD_CODEC_H_
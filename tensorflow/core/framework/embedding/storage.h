@@ -63,6 +63,18 @@ class Storage {
   TF_DISALLOW_COPY_AND_ASSIGN(Storage);
 
   virtual Status Get(K key, ValuePtr<V>** value_ptr) = 0;
+  // value_ptr_list[i] is set to nullptr if key[i] is not found.
+  virtual void BatchGet(const K* key, ValuePtr<V>** value_ptr_list,
+                        int64 num_of_keys) {
+    for (int64 i = 0; i < num_of_keys; i++) {
+      if (!Get(key[i], &value_ptr_list[i]).ok()) {
+        value_ptr_list[i] = nullptr;
+      }
+    }
+  }
+  // Moves the keys of a batch which are only in the lower tiers to the
+  // first tier with batched reads, so that GetOrCreate of them hits it.
+  virtual void BatchPromote(const K* keys, int64 num_of_keys) {}
 #if GOOGLE_CUDA
   virtual void BatchGet(const EmbeddingVarContext<GPUDevice>& ctx,
                         const K* key,
@@ -93,6 +105,8 @@ class Storage {
   virtual Status Remove(K key) = 0;
   virtual int64 Size() const = 0;
   virtual int64 Size(int level) const = 0;
+  // Pre-sizes the storage for num_keys keys on restoring.
+  virtual void Reserve(int64 num_keys) {}
   virtual Status GetSnapshot(std::vector<K>* key_list,
       std::vector<ValuePtr<V>*>* value_ptr_list) = 0;
   virtual int64 GetSnapshot(std::vector<K>* key_list,
@@ -117,6 +131,12 @@ class Storage {
       int64* record_count_list, int64 num_of_files,
       const std::string& ssd_emb_file_name) = 0;
   virtual Status Shrink(const ShrinkArgs& shrink_args) = 0;
+  // Shrinks the next 'max_keys' keys of a scan spread over calls, skipped
+  // while another shrink runs.
+  virtual Status IncrementalShrink(const ShrinkArgs& shrink_args,
+                                   int64 max_keys) {
+    return Status::OK();
+  }
 
   virtual Status BatchCommit(const std::vector<K>& keys,
       const std::vector<ValuePtr<V>*>& value_ptrs) = 0;
@@ -136,7 +156,7 @@ class Storage {
   virtual void BatchLookupOrCreate(const K* key, V* val, V* default_v,
       int32 default_v_num, size_t n, const Eigen::GpuDevice& device) {}
   virtual void BatchLookupOrCreateKeys(const K* key, int32* item_idxs, size_t n,
-      const Eigen::GpuDevice& device) {}
+      const Eigen::GpuDevice& device, int64 update_version) {}
   virtual void BatchLookup(const Eigen::GpuDevice& device, const K* keys, V* val,
                            size_t n, const V* default_v) {}
   virtual void ImportToHbm(const std::vector<K>& keys,
@@ -149,6 +169,10 @@ class Storage {
   virtual void InitCache(embedding::CacheStrategy cache_strategy) = 0;
   virtual int64 CacheSize() const = 0;
   virtual BatchCache<K>* Cache() = 0;
+  // Bytes evicted from the first tier so far.
+  virtual int64 EvictedBytes() const {
+    return 0;
+  }
   virtual bool IsMultiLevel() = 0;
   virtual bool IsUseHbm() = 0;
   virtual bool IsSingleHbm() = 0;
@@ -172,7 +196,8 @@ class Storage {
   inline int64 GetOffset(int64 index) { return alloc_len_ * index; }
   inline int64 GetTotalDims() { return total_dims_; }
   inline int64 ComputeAllocLen(int64 value_len) {
-    if (LayoutType::COMPACT == storage_config_.layout_type) {
+    if (LayoutType::COMPACT == storage_config_.layout_type ||
+        IsQuantizedLayout()) {
       return value_len;
     } else {
       return (value_len * sizeof(V) % 16 == 0)
@@ -181,7 +206,20 @@ class Storage {
     }
   }
   inline LayoutType GetLayoutType() { return storage_config_.layout_type; }
+  inline bool IsQuantizedLayout() {
+    return LayoutType::QUANTIZED_INT8 == storage_config_.layout_type ||
+           LayoutType::QUANTIZED_FP16 == storage_config_.layout_type;
+  }
+  inline bool IsMixedDimLayout() {
+    return LayoutType::MIXED_DIM == storage_config_.layout_type;
+  }
   inline embedding::StorageType GetStorageType() { return storage_config_.type; }
+  // The prefix of the owners of the memory of the storage in the memory
+  // attribution, ev/<name of its primary EmbeddingVariable>.
+  inline const std::string& memory_owner() const { return memory_owner_; }
+  inline void set_memory_owner(const std::string& owner) {
+    memory_owner_ = owner;
+  }
   inline std::string GetStoragePath() { return storage_config_.path; }
   inline embedding::CacheStrategy
       CacheStrategy() { return storage_config_.cache_strategy; }
@@ -211,10 +249,15 @@ class Storage {
 
   virtual void AddToCache(const Tensor& indices) {}
 
+  // Promotes the rows of indices to the first tier in the background,
+  // ahead of the step looking them up. value_len is the length of the rows.
+  virtual void Prefetch(const Tensor& indices, int64 value_len) {}
+
  protected:
   int64 alloc_len_ = 0;
   int64 total_dims_ = 0;
   StorageConfig storage_config_;
+  std::string memory_owner_;
 
   mutex mu_;
   std::atomic_flag flag_ = ATOMIC_FLAG_INIT;
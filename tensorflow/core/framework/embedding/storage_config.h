@@ -18,6 +18,7 @@ limitations under the License.
 #include "tensorflow/core/framework/embedding/cache.h"
 #include "tensorflow/core/framework/embedding/embedding_config.h"
 #include "tensorflow/core/framework/embedding/value_ptr.h"
+#include "tensorflow/core/util/env_var.h"
 namespace tensorflow {
 namespace embedding {
 struct StorageConfig {
@@ -26,6 +27,7 @@ struct StorageConfig {
                     layout_type(LayoutType::NORMAL),
                     cache_strategy(CacheStrategy::LFU) {
     size = {1<<30,1<<30,1<<30,1<<30};
+    InitLevelDBOptions();
   }
 
   StorageConfig(StorageType t,
@@ -48,19 +50,42 @@ struct StorageConfig {
       layout_type = LayoutType::NORMAL_CONTIGUOUS_GPU;
     } else if ("compact" == layout){
       layout_type = LayoutType::COMPACT;
+    } else if ("quantized_int8" == layout){
+      layout_type = LayoutType::QUANTIZED_INT8;
+    } else if ("quantized_fp16" == layout){
+      layout_type = LayoutType::QUANTIZED_FP16;
+    } else if ("mixed_dim" == layout){
+      layout_type = LayoutType::MIXED_DIM;
     } else {
       LOG(WARNING) << "Unknown layout: "
         << layout << ", use LayoutType::NORMAL by default.";
       layout_type = LayoutType::NORMAL;
     }
     size = s;
+    InitLevelDBOptions();
   }
+
+  // TF_EV_LEVELDB_BLOCK_CACHE_MB sets the block cache of the LevelDB tier,
+  // 0 keeps the 8MB of LevelDB. TF_EV_LEVELDB_BLOOM_BITS_PER_KEY sets the
+  // bloom filters of its tables, so that a lookup of a key which is not in
+  // a table skips reading its blocks, 0 disables them.
+  void InitLevelDBOptions() {
+    int64 block_cache_mb = 0;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_LEVELDB_BLOCK_CACHE_MB",
+                                    0, &block_cache_mb));
+    leveldb_block_cache_size = block_cache_mb << 20;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_LEVELDB_BLOOM_BITS_PER_KEY",
+                                    10, &leveldb_bloom_bits_per_key));
+  }
+
   StorageType type;
   LayoutType layout_type;
   std::string path;
   std::vector<int64> size;
   CacheStrategy cache_strategy;
   EmbeddingConfig embedding_config;
+  int64 leveldb_block_cache_size;
+  int64 leveldb_bloom_bits_per_key;
 };
 } // namespace embedding
 } // namespace tensorflow
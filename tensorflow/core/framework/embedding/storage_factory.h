@@ -17,7 +17,9 @@ limitations under the License.
 
 #include "tensorflow/core/framework/embedding/config.pb.h"
 #include "tensorflow/core/framework/embedding/layout_creator.h"
+#include "tensorflow/core/framework/embedding/dram_cxl_storage.h"
 #include "tensorflow/core/framework/embedding/dram_leveldb_storage.h"
+#include "tensorflow/core/framework/embedding/dram_numa_storage.h"
 #include "tensorflow/core/framework/embedding/dram_pmem_storage.h"
 #include "tensorflow/core/framework/embedding/dram_ssd_storage.h"
 #include "tensorflow/core/framework/embedding/hbm_dram_storage.h"
@@ -26,7 +28,10 @@ limitations under the License.
 #include "tensorflow/core/framework/embedding/single_tier_storage.h"
 #include "tensorflow/core/framework/embedding/storage_config.h"
 #include "tensorflow/core/framework/embedding/storage.h"
+#include "tensorflow/core/framework/embedding/swiss_hash_map_kv.h"
+#include "tensorflow/core/framework/memory_attribution.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 
 namespace tensorflow {
 namespace embedding {
@@ -35,30 +40,58 @@ class StorageFactory {
   template<typename K, typename V>
   static Storage<K, V>* Create(const StorageConfig& sc,
       Allocator* gpu_allocator, const string& name) {
+    Storage<K, V>* storage = CreateStorage<K, V>(sc, gpu_allocator, name);
+    storage->set_memory_owner(strings::StrCat("ev/", name));
+    return storage;
+  }
+
+ private:
+  template<typename K, typename V>
+  static Storage<K, V>* CreateStorage(const StorageConfig& sc,
+      Allocator* gpu_allocator, const string& name) {
     auto layout_creator = LayoutCreatorFactory::Create<V>(sc);
+    // The memory of the tiers is attributed to the EmbeddingVariable.
+    Allocator* dram_allocator = MemoryAttribution::Wrap(ev_allocator(),
+        strings::StrCat("ev/", name, "/dram"));
+    const string pmem_owner = strings::StrCat("ev/", name, "/pmem");
+#if GOOGLE_CUDA
+    gpu_allocator = MemoryAttribution::Wrap(gpu_allocator,
+        strings::StrCat("ev/", name, "/hbm"));
+#endif  // GOOGLE_CUDA
 
     switch (sc.type) {
       case StorageType::DRAM:
-        return new DramStorage<K, V>(sc, ev_allocator(),
+        return new DramStorage<K, V>(sc, dram_allocator,
             layout_creator, new LocklessHashMap<K, V>());
+      case StorageType::DRAM_SWISS:
+        return new DramStorage<K, V>(sc, dram_allocator,
+            layout_creator, new SwissHashMap<K, V>());
+      case StorageType::DRAM_NUMA:
+        return new DramNumaStorage<K, V>(sc, layout_creator);
       case StorageType::PMEM_MEMKIND:
-        return new PmemMemkindStorage<K, V>(sc, pmem_allocator(),
+        return new PmemMemkindStorage<K, V>(sc,
+            MemoryAttribution::Wrap(pmem_allocator(), pmem_owner),
             layout_creator);
       case StorageType::PMEM_LIBPMEM:
         return new PmemLibpmemStorage<K, V>(sc,
-            experimental_pmem_allocator(sc.path, sc.size[0]),
+            MemoryAttribution::Wrap(
+                experimental_pmem_allocator(sc.path, sc.size[0]), pmem_owner),
             layout_creator);
       case StorageType::DRAM_PMEM:
-        return new DramPmemStorage<K, V>(sc, ev_allocator(),
-            experimental_pmem_allocator(sc.path, sc.size[0]),
+        return new DramPmemStorage<K, V>(sc, dram_allocator,
+            MemoryAttribution::Wrap(
+                experimental_pmem_allocator(sc.path, sc.size[0]), pmem_owner),
+            layout_creator, name);
+      case StorageType::DRAM_CXL:
+        return new DramCxlStorage<K, V>(sc, dram_allocator,
             layout_creator, name);
       case StorageType::LEVELDB:
       case StorageType::DRAM_LEVELDB:
-        return new DramLevelDBStore<K, V>(sc, ev_allocator(),
+        return new DramLevelDBStore<K, V>(sc, dram_allocator,
             layout_creator, name);
       case StorageType::SSDHASH:
       case StorageType::DRAM_SSDHASH:
-        return new DramSsdHashStorage<K, V>(sc, ev_allocator(),
+        return new DramSsdHashStorage<K, V>(sc, dram_allocator,
             layout_creator, name);
       case StorageType::HBM:
 #if GOOGLE_CUDA
@@ -68,15 +101,15 @@ class StorageFactory {
       case StorageType::HBM_DRAM:
 #if GOOGLE_CUDA
         return new HbmDramStorage<K, V>(sc, gpu_allocator,
-        ev_allocator(), layout_creator, name);
+        dram_allocator, layout_creator, name);
 #endif  // GOOGLE_CUDA
       case StorageType::HBM_DRAM_SSDHASH:
 #if GOOGLE_CUDA
         return new HbmDramSsdStorage<K, V>(sc, gpu_allocator,
-            ev_allocator(), layout_creator, name);
+            dram_allocator, layout_creator, name);
 #endif  // GOOGLE_CUDA
       default:
-        return new DramStorage<K, V>(sc, ev_allocator(),
+        return new DramStorage<K, V>(sc, dram_allocator,
             layout_creator, new LocklessHashMap<K, V>());
     }
   }
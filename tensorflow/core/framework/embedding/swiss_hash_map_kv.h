@@ -0,0 +1,407 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+=======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_SWISS_HASH_MAP_KV_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_SWISS_HASH_MAP_KV_H_
+
+#include <atomic>
+#include <vector>
+
+#include "tensorflow/core/framework/embedding/kv_interface.h"
+#include "tensorflow/core/lib/core/spin_rw_lock.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/mem.h"
+
+namespace tensorflow {
+template <class V>
+class ValuePtr;
+
+namespace embedding {
+
+// Open-addressing hash map in the style of Swiss tables. Every bucket
+// group is exactly one cache line and keeps a control word of 1-byte
+// tags followed by the keys and ValuePtrs of the group, so a probe
+// touches a single line in the common case. Tags are matched eight at a
+// time with SWAR (SIMD within a register) arithmetic.
+//
+// Lookups are wait free. Inserts and Removes are serialized per stripe
+// of the key hash, and slots are claimed by CAS on the control word.
+// A resize holds every stripe, rehashes into a new table and publishes
+// it; retired tables are freed when the map is destroyed.
+template <class K, class V>
+class SwissHashMap : public KVInterface<K, V> {
+ public:
+  SwissHashMap() : size_(0), used_(0) {
+    for (int i = 0; i < kStripeNum; i++) {
+      easy_spinrwlock_t lock = EASY_SPINRWLOCK_INITIALIZER;
+      stripe_mu_[i] = lock;
+    }
+    Table* t = NewTable(kInitGroupNum);
+    table_.store(t, std::memory_order_release);
+    tables_.emplace_back(t);
+  }
+
+  ~SwissHashMap() override {
+    for (auto t : tables_) {
+      port::AlignedFree(t->groups);
+      delete t;
+    }
+  }
+
+  Status Lookup(K key, ValuePtr<V>** value_ptr) override {
+    ValuePtr<V>* ptr = Find(table_.load(std::memory_order_acquire),
+                            key, Hash(key));
+    if (ptr == nullptr) {
+      return errors::NotFound(
+          "Unable to find Key: ", key, " in SwissHashMap.");
+    }
+    *value_ptr = ptr;
+    return Status::OK();
+  }
+
+  Status BatchLookup(const K* keys, size_t size,
+                     ValuePtr<V>** value_ptrs) override {
+    Table* t = table_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < size && i < PREFETCH_DISTANCE_; i++) {
+      __builtin_prefetch(HomeGroup(t, Hash(keys[i])), 0, 1);
+    }
+    for (size_t i = 0; i < size; i++) {
+      if (i + PREFETCH_DISTANCE_ < size) {
+        __builtin_prefetch(
+            HomeGroup(t, Hash(keys[i + PREFETCH_DISTANCE_])), 0, 1);
+      }
+      value_ptrs[i] = Find(t, keys[i], Hash(keys[i]));
+    }
+    return Status::OK();
+  }
+
+  Status Contains(K key) override {
+    if (Find(table_.load(std::memory_order_acquire),
+             key, Hash(key)) == nullptr) {
+      return errors::NotFound(
+          "Unable to find Key: ", key, " in SwissHashMap.");
+    }
+    return Status::OK();
+  }
+
+  Status Insert(K key, const ValuePtr<V>* value_ptr) override {
+    uint64 h = Hash(key);
+    while (true) {
+      Table* t = nullptr;
+      {
+        spin_wr_lock l(stripe_mu_[h % kStripeNum]);
+        t = table_.load(std::memory_order_acquire);
+        if (Find(t, key, h) != nullptr) {
+          return errors::AlreadyExists(
+              "already exists Key: ", key, " in SwissHashMap.");
+        }
+        if (used_.load(std::memory_order_relaxed) <
+                MaxUsedSlots(t->num_groups) &&
+            TryInsert(t, key, h, const_cast<ValuePtr<V>*>(value_ptr))) {
+          size_.fetch_add(1, std::memory_order_relaxed);
+          return Status::OK();
+        }
+      }
+      // The table is too crowded, grow (or clean tombstones) and retry.
+      Resize(t);
+    }
+  }
+
+  Status Remove(K key) override {
+    uint64 h = Hash(key);
+    spin_wr_lock l(stripe_mu_[h % kStripeNum]);
+    Table* t = table_.load(std::memory_order_acquire);
+    Group* g = nullptr;
+    int slot = FindSlot(t, key, h, &g);
+    if (slot < 0) {
+      return errors::NotFound(
+          "Unable to find Key: ", key, " in SwissHashMap.");
+    }
+    SetTag(g, slot, kDeleted);
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    return Status::OK();
+  }
+
+  Status BatchCommit(const std::vector<K>& keys,
+      const std::vector<ValuePtr<V>*>& value_ptrs) override {
+    return Status::OK();
+  }
+
+  int64 Size() const override {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+  Status GetSnapshot(std::vector<K>* key_list,
+      std::vector<ValuePtr<V>*>* value_ptr_list) override {
+    Table* t = table_.load(std::memory_order_acquire);
+    for (int64 i = 0; i < t->num_groups; i++) {
+      Group* g = &t->groups[i];
+      uint64 ctrl = g->ctrl.load(std::memory_order_acquire);
+      for (int j = 0; j < Group::kSlotNum; j++) {
+        if (IsFull(GetTag(ctrl, j))) {
+          key_list->emplace_back(g->keys[j]);
+          value_ptr_list->emplace_back(g->values[j]);
+        }
+      }
+    }
+    return Status::OK();
+  }
+
+  std::string DebugString() const override {
+    Table* t = table_.load(std::memory_order_acquire);
+    LOG(INFO) << "map info size:" << Size()
+              << "map info group_count:" << t->num_groups
+              << "map info slot_count:" << t->num_groups * Group::kSlotNum
+              << "map info used_slots:" << used_.load();
+    return "";
+  }
+
+ private:
+  // Control tags: full slots store the low 7 bits of the hash.
+  static const uint8 kEmpty = 0x80;
+  static const uint8 kBusy = 0xFD;
+  static const uint8 kDeleted = 0xFE;
+  static const uint8 kSentinel = 0xFF;
+
+  static const uint64 kLsbs = 0x0101010101010101ULL;
+  static const uint64 kMsbs = 0x8080808080808080ULL;
+
+  static const int64 kInitGroupNum = 1024;
+  static const int kStripeNum = 64;
+  static constexpr size_t PREFETCH_DISTANCE_ = 8;
+
+  struct alignas(64) Group {
+    static const int kSlotNum =
+        (64 - sizeof(uint64)) / (sizeof(K) + sizeof(ValuePtr<V>*));
+    std::atomic<uint64> ctrl;
+    K keys[kSlotNum];
+    ValuePtr<V>* values[kSlotNum];
+  };
+  static_assert(sizeof(Group) == 64, "Group must fill one cache line.");
+
+  struct Table {
+    Group* groups;
+    int64 num_groups;
+  };
+
+  static uint64 Hash(K key) {
+    // Finalizer of MurmurHash3, keys of EV are often sequential.
+    uint64 h = static_cast<uint64>(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  static uint8 H2(uint64 h) { return h & 0x7F; }
+
+  static bool IsFull(uint8 tag) { return tag < kEmpty; }
+
+  static uint8 GetTag(uint64 ctrl, int slot) {
+    return (ctrl >> (8 * slot)) & 0xFF;
+  }
+
+  // Returns a mask with the high bit set in every lane equal to b.
+  // Lanes above a true match may be false positives, callers verify keys.
+  static uint64 MatchByte(uint64 ctrl, uint8 b) {
+    uint64 x = ctrl ^ (kLsbs * b);
+    return (x - kLsbs) & ~x & kMsbs;
+  }
+
+  static uint64 EmptyCtrl() {
+    uint64 ctrl = 0;
+    for (int i = 0; i < 8; i++) {
+      uint8 tag = i < Group::kSlotNum ? kEmpty : kSentinel;
+      ctrl |= static_cast<uint64>(tag) << (8 * i);
+    }
+    return ctrl;
+  }
+
+  static int64 MaxUsedSlots(int64 num_groups) {
+    return num_groups * Group::kSlotNum / 8 * 7;
+  }
+
+  static Table* NewTable(int64 num_groups) {
+    Table* t = new Table;
+    t->num_groups = num_groups;
+    t->groups = static_cast<Group*>(
+        port::AlignedMalloc(sizeof(Group) * num_groups, 64));
+    uint64 empty_ctrl = EmptyCtrl();
+    for (int64 i = 0; i < num_groups; i++) {
+      new (&t->groups[i].ctrl) std::atomic<uint64>(empty_ctrl);
+    }
+    return t;
+  }
+
+  static Group* HomeGroup(Table* t, uint64 h) {
+    return &t->groups[(h >> 7) & (t->num_groups - 1)];
+  }
+
+  static void SetTag(Group* g, int slot, uint8 tag) {
+    uint64 mask = ~(static_cast<uint64>(0xFF) << (8 * slot));
+    uint64 ctrl = g->ctrl.load(std::memory_order_relaxed);
+    uint64 desired;
+    do {
+      desired = (ctrl & mask) | (static_cast<uint64>(tag) << (8 * slot));
+    } while (!g->ctrl.compare_exchange_weak(ctrl, desired,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+  }
+
+  // Returns the slot of key in *group, or -1 if not found.
+  static int FindSlot(Table* t, K key, uint64 h, Group** group) {
+    const int64 mask = t->num_groups - 1;
+    int64 pos = (h >> 7) & mask;
+    const uint8 tag = H2(h);
+    for (int64 probe = 1; probe <= t->num_groups; probe++) {
+      Group* g = &t->groups[pos];
+      uint64 ctrl = g->ctrl.load(std::memory_order_acquire);
+      for (uint64 m = MatchByte(ctrl, tag); m != 0; m &= m - 1) {
+        int slot = __builtin_ctzll(m) >> 3;
+        if (slot < Group::kSlotNum && g->keys[slot] == key &&
+            GetTag(ctrl, slot) == tag) {
+          *group = g;
+          return slot;
+        }
+      }
+      if (MatchByte(ctrl, kEmpty) != 0) {
+        return -1;
+      }
+      pos = (pos + probe) & mask;
+    }
+    return -1;
+  }
+
+  static ValuePtr<V>* Find(Table* t, K key, uint64 h) {
+    Group* g = nullptr;
+    while (true) {
+      int slot = FindSlot(t, key, h, &g);
+      if (slot < 0) {
+        return nullptr;
+      }
+      uint64 ctrl = g->ctrl.load(std::memory_order_acquire);
+      ValuePtr<V>* value_ptr = g->values[slot];
+      // The slot may be removed and reused by another key concurrently,
+      // validate it after reading the value.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (g->ctrl.load(std::memory_order_relaxed) == ctrl &&
+          g->keys[slot] == key) {
+        return value_ptr;
+      }
+    }
+  }
+
+  bool TryInsert(Table* t, K key, uint64 h, ValuePtr<V>* value_ptr) {
+    const int64 mask = t->num_groups - 1;
+    int64 pos = (h >> 7) & mask;
+    for (int64 probe = 1; probe <= t->num_groups; probe++) {
+      Group* g = &t->groups[pos];
+      uint64 ctrl = g->ctrl.load(std::memory_order_acquire);
+      for (int slot = 0; slot < Group::kSlotNum; slot++) {
+        uint8 cur = GetTag(ctrl, slot);
+        if (cur != kEmpty && cur != kDeleted) {
+          continue;
+        }
+        uint64 lane = static_cast<uint64>(0xFF) << (8 * slot);
+        uint64 busy = (ctrl & ~lane) |
+                      (static_cast<uint64>(kBusy) << (8 * slot));
+        if (g->ctrl.compare_exchange_strong(ctrl, busy,
+                                            std::memory_order_acquire)) {
+          g->keys[slot] = key;
+          g->values[slot] = value_ptr;
+          SetTag(g, slot, H2(h));
+          if (cur == kEmpty) {
+            used_.fetch_add(1, std::memory_order_relaxed);
+          }
+          return true;
+        }
+        // ctrl was reloaded by the failed CAS, rescan this group.
+        slot = -1;
+      }
+      pos = (pos + probe) & mask;
+    }
+    return false;
+  }
+
+  static void MoveTo(Table* t, K key, ValuePtr<V>* value_ptr) {
+    uint64 h = Hash(key);
+    const int64 mask = t->num_groups - 1;
+    int64 pos = (h >> 7) & mask;
+    for (int64 probe = 1; ; probe++) {
+      Group* g = &t->groups[pos];
+      uint64 ctrl = g->ctrl.load(std::memory_order_relaxed);
+      for (int slot = 0; slot < Group::kSlotNum; slot++) {
+        if (GetTag(ctrl, slot) == kEmpty) {
+          g->keys[slot] = key;
+          g->values[slot] = value_ptr;
+          SetTag(g, slot, H2(h));
+          return;
+        }
+      }
+      pos = (pos + probe) & mask;
+    }
+  }
+
+  void Resize(Table* full_table) {
+    for (int i = 0; i < kStripeNum; i++) {
+      easy_spinrwlock_wrlock(&stripe_mu_[i]);
+    }
+    Table* old_table = table_.load(std::memory_order_acquire);
+    // Another writer may have resized the table already.
+    if (old_table == full_table) {
+      Rehash(old_table);
+    }
+    for (int i = 0; i < kStripeNum; i++) {
+      easy_spinrwlock_unlock(&stripe_mu_[i]);
+    }
+  }
+
+  void Rehash(Table* old_table) {
+    int64 num_groups = old_table->num_groups;
+    while (size_.load(std::memory_order_relaxed) * 2 >
+           num_groups * Group::kSlotNum) {
+      num_groups *= 2;
+    }
+    Table* new_table = NewTable(num_groups);
+    for (int64 i = 0; i < old_table->num_groups; i++) {
+      Group* g = &old_table->groups[i];
+      uint64 ctrl = g->ctrl.load(std::memory_order_relaxed);
+      for (int j = 0; j < Group::kSlotNum; j++) {
+        if (IsFull(GetTag(ctrl, j))) {
+          MoveTo(new_table, g->keys[j], g->values[j]);
+        }
+      }
+    }
+    used_.store(size_.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+    tables_.emplace_back(new_table);
+    table_.store(new_table, std::memory_order_release);
+  }
+
+  std::atomic<Table*> table_;
+  // All tables ever published, readers may still hold a retired one.
+  std::vector<Table*> tables_;
+  std::atomic<int64> size_;
+  // Full and deleted slots of the current table.
+  std::atomic<int64> used_;
+  easy_spinrwlock_t stripe_mu_[kStripeNum];
+};
+
+}  // namespace embedding
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_SWISS_HASH_MAP_KV_H_
@@ -2,10 +2,14 @@
 #define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_VALUE_PTR_H_
 
 #include <pthread.h>
+#include <algorithm>
 #include <bitset>
 #include <atomic>
 #include <memory>
+#include <vector>
 
+#include "tensorflow/core/framework/embedding/row_copy.h"
+#include "tensorflow/core/framework/embedding/row_quantization.h"
 #include "tensorflow/core/framework/typed_allocator.h"
 #if GOOGLE_CUDA
 #include <cuda_runtime.h>
@@ -20,6 +24,9 @@ enum class LayoutType {
   NORMAL_CONTIGUOUS,
   NORMAL_CONTIGUOUS_GPU,
   COMPACT,
+  QUANTIZED_INT8,
+  QUANTIZED_FP16,
+  MIXED_DIM,
 };
 
 namespace {
@@ -279,7 +286,8 @@ class LooseValuePtr : public ValuePtr<V> {
       int64 alloc_value_len = value_len;
       V* tensor_val = (V*)allocator->AllocateRaw(
           Allocator::kAllocatorAlignment, sizeof(V) * alloc_value_len);
-      memcpy(tensor_val, default_v, sizeof(V) * value_len);
+      embedding::CopyDefaultValue(tensor_val, default_v,
+                                  sizeof(V) * value_len);
       ((V**)((int64*)ptr_ + meta->GetHeaderSize()))[emb_index]  = tensor_val;
 
       metadata.set(emb_index);
@@ -411,7 +419,8 @@ class NormalContiguousValuePtr : public LooseValuePtr<V> {
       }
       V* tensor_val =
         ((V*)this->ptr_ + sizeof(FixedLengthHeader) / sizeof(V) + offset);
-      memcpy(tensor_val, default_v, sizeof(V) * value_len);
+      embedding::CopyDefaultValue(tensor_val, default_v,
+                                  sizeof(V) * value_len);
       int8* m = (int8*)((char*)this->ptr_ + 6);
       *m |= (1 <<  emb_index);
       this->flag_.clear(std::memory_order_release);
@@ -602,7 +611,8 @@ class CompactValuePtr : public ValuePtr<V> {
       }
       V* tensor_val =
         ((V*)this->ptr_ + sizeof(int64) / sizeof(V) + offset);
-      memcpy(tensor_val, default_v, sizeof(V) * value_len);
+      embedding::CopyDefaultValue(tensor_val, default_v,
+                                  sizeof(V) * value_len);
       int8* m = (int8*)((char*)this->ptr_ + 6);
       *m |= (1 <<  emb_index);
       this->flag_.clear(std::memory_order_release);
@@ -642,6 +652,254 @@ class CompactValuePtr : public ValuePtr<V> {
   std::atomic_flag flag_ = ATOMIC_FLAG_INIT;
 };
 
+template <class V>
+class QuantizedValuePtr : public ValuePtr<V> {
+/*_____________________________________________________________________________
+  |  block   | quantization |         |  init   |         |    quantized     |
+  |   size   |     type     |         |  flag   |         | primary embedding|
+  |  int32   |    uint8     |  uint8  |  uint8  |  uint8  |  by alloctor, see|
+  | (4 bytes)|   (1 byte)   | (1 byte)| (1 byte)| (1 byte)|  RowQuantization |
+  -----------------------------------------------------------------------------
+ */
+ public:
+  QuantizedValuePtr(Allocator* allocator, size_t size,
+                    embedding::RowQuantization type, int64 block_size) {
+    ptr_ = allocator->AllocateRaw(Allocator::kAllocatorAlignment,
+        sizeof(int64) +
+            embedding::QuantizedRowBytes(type, size, block_size));
+    memset(ptr_, 0, sizeof(int64));
+    *((int32*)ptr_) = block_size;
+    *((uint8*)ptr_ + kQuantizationIndex) = (uint8)type;
+  }
+
+  ~QuantizedValuePtr() {}
+
+  // Quantizes default_v the first time. Quantized layouts are only meant
+  // for inference, the ops reading V* rows get a dequantized copy which is
+  // valid until the next call on the same thread, updates of it are lost.
+  virtual V* GetOrAllocate(Allocator* allocator, int64 value_len,
+      const V* default_v, int emb_index, int offset) override {
+    if (!IsInitialized()) {
+      while(flag_.test_and_set(std::memory_order_acquire));
+      if (!IsInitialized()) {
+        embedding::QuantizeRow(Quantization(), default_v, value_len,
+                               BlockSize(), Row());
+        *((uint8*)ptr_ + kInitFlagIndex) = 1;
+      }
+      flag_.clear(std::memory_order_release);
+    }
+    static thread_local std::vector<V> dequantized;
+    dequantized.resize(value_len);
+    Dequantize(dequantized.data(), value_len);
+    return dequantized.data();
+  }
+
+  virtual V* GetOrAllocate(Allocator* allocator, int64 value_len,
+      const V* default_v, int emb_index, int offset, bool &need_initialize) {
+    return nullptr;
+  }
+
+  virtual V* GetValue(int emb_index, int offset) {
+    LOG(FATAL) << "Unsupport GetValue in QuantizedValuePtr,"
+               << " quantized layouts are inference only.";
+    return nullptr;
+  }
+
+  virtual void Destroy(Allocator* allocator) {
+    allocator->DeallocateRaw(ptr_);
+  }
+
+  virtual void* GetPtr() const {
+    return ptr_;
+  }
+
+  bool IsInitialized() const {
+    return *((uint8*)ptr_ + kInitFlagIndex) != 0;
+  }
+
+  void Dequantize(V* out, int64 value_len) const {
+    embedding::DequantizeRow(Quantization(), Row(), value_len,
+                             BlockSize(), out);
+  }
+
+  // out += weight * row, without a dequantized copy of the row.
+  void Accumulate(float weight, V* out, int64 value_len) const {
+    embedding::AccumulateQuantizedRow(Quantization(), Row(), value_len,
+                                      BlockSize(), weight, out);
+  }
+
+ private:
+  static const int kQuantizationIndex = 4;
+  static const int kInitFlagIndex = 6;
+
+  embedding::RowQuantization Quantization() const {
+    return (embedding::RowQuantization)(
+        *((uint8*)ptr_ + kQuantizationIndex));
+  }
+
+  int64 BlockSize() const {
+    return *((int32*)ptr_);
+  }
+
+  char* Row() const {
+    return (char*)ptr_ + sizeof(int64);
+  }
+
+  void* ptr_;
+  std::atomic_flag flag_ = ATOMIC_FLAG_INIT;
+};
+
+template <class V>
+class MixedDimValuePtr : public NormalContiguousValuePtr<V> {
+/*____________________________________________________________________
+  |   global step   |  slotflag  |  row dims | freq counter | embeddings |
+  |    (6 bytes)    |  (1 byte)  |  (1 byte) |   (8 bytes)  |            |
+  ---------------------------------------------------------------------
+  Rows with row dims 0 are the same as NormalContiguousValuePtr. The other
+  rows are demoted, they hold only the leading row dims values of the
+  primary embedding and the rest of them read as 0.
+ */
+ public:
+  MixedDimValuePtr(Allocator* allocator, size_t size)
+      : NormalContiguousValuePtr<V>(allocator, size) {}
+
+  ~MixedDimValuePtr() {}
+
+  virtual V* GetOrAllocate(Allocator* allocator, int64 value_len,
+      const V* default_v, int emb_index, int offset) override {
+    if (RowDims() != 0) {
+      LOG(FATAL) << "Demoted rows of the mixed_dim layout must be promoted"
+                 << " before they are written.";
+    }
+    return NormalContiguousValuePtr<V>::GetOrAllocate(allocator, value_len,
+        default_v, emb_index, offset);
+  }
+
+  int64 RowDims() const {
+    return RowDims(this->ptr_);
+  }
+
+  // Copies the primary embedding, a demoted row is padded with 0.
+  void ReadPrimary(V* out, int64 value_len) const {
+    // The row may be resized concurrently, read it through one pointer.
+    void* ptr = this->ptr_;
+    int64 dims = RowDims(ptr);
+    if (dims == 0 || dims > value_len) {
+      dims = value_len;
+    }
+    memcpy(out, Values(ptr), sizeof(V) * dims);
+    memset(out + dims, 0, sizeof(V) * (value_len - dims));
+  }
+
+  // Moves the row to a buffer holding dims values of the primary
+  // embedding, or all the total_dims values when dims is 0. Demotions drop
+  // the slots, they are initialized again when written. Returns the old
+  // buffer, which concurrent readers may still use, or nullptr when the
+  // row already has dims.
+  void* Resize(Allocator* allocator, int64 dims, int64 value_len,
+               int64 total_dims) {
+    while(this->flag_.test_and_set(std::memory_order_acquire));
+    void* old_ptr = this->ptr_;
+    int64 old_dims = RowDims(old_ptr);
+    if (old_dims == dims) {
+      this->flag_.clear(std::memory_order_release);
+      return nullptr;
+    }
+    int64 new_len = (dims == 0) ? total_dims : dims;
+    void* new_ptr = allocator->AllocateRaw(Allocator::kAllocatorAlignment,
+        sizeof(FixedLengthHeader) + sizeof(V) * new_len);
+    memcpy(new_ptr, old_ptr, sizeof(FixedLengthHeader));
+    memset(Values(new_ptr), 0, sizeof(V) * new_len);
+    int64 copy_dims = std::min((old_dims == 0) ? value_len : old_dims,
+                               (dims == 0) ? value_len : dims);
+    memcpy(Values(new_ptr), Values(old_ptr), sizeof(V) * copy_dims);
+    FixedLengthHeader* header = (FixedLengthHeader*)new_ptr;
+    if (dims != 0) {
+      // Bits 49 ~ 55 mark the slots 1 ~ 7 initialized.
+      header->global_step &= ~(static_cast<int64>(0xfe) << 48);
+    }
+    *((uint8*)new_ptr + kRowDimsIndex) = (uint8)dims;
+    this->ptr_ = new_ptr;
+    this->flag_.clear(std::memory_order_release);
+    return old_ptr;
+  }
+
+ private:
+  static const int kRowDimsIndex = 7;
+
+  static int64 RowDims(void* ptr) {
+    return *((uint8*)ptr + kRowDimsIndex);
+  }
+
+  static V* Values(void* ptr) {
+    return (V*)((char*)ptr + sizeof(FixedLengthHeader));
+  }
+};
+
+// Accesses the ValuePtrs known to be of class Impl without virtual calls,
+// so that the loops of an op over the rows of a layout inline them. The
+// ValuePtrs must be exactly of class Impl, not of a subclass of it.
+template <class V, class Impl>
+struct ValuePtrAccess {
+  static V* GetValue(ValuePtr<V>* value_ptr, int emb_index, int offset) {
+    return static_cast<Impl*>(value_ptr)->Impl::GetValue(emb_index, offset);
+  }
+
+  static V* GetOrAllocate(ValuePtr<V>* value_ptr, Allocator* allocator,
+                          int64 value_len, const V* default_v,
+                          int emb_index, int offset) {
+    return static_cast<Impl*>(value_ptr)->Impl::GetOrAllocate(
+        allocator, value_len, default_v, emb_index, offset);
+  }
+
+  static int64 GetStep(ValuePtr<V>* value_ptr) {
+    return static_cast<Impl*>(value_ptr)->Impl::GetStep();
+  }
+
+  static void SetStep(ValuePtr<V>* value_ptr, int64 gs) {
+    static_cast<Impl*>(value_ptr)->Impl::SetStep(gs);
+  }
+
+  static int64 GetFreq(ValuePtr<V>* value_ptr) {
+    return static_cast<Impl*>(value_ptr)->Impl::GetFreq();
+  }
+
+  static void AddFreq(ValuePtr<V>* value_ptr, int64 count) {
+    static_cast<Impl*>(value_ptr)->Impl::AddFreq(count);
+  }
+};
+
+// The ValuePtrs of any class, through their virtual methods.
+template <class V>
+struct ValuePtrAccess<V, ValuePtr<V>> {
+  static V* GetValue(ValuePtr<V>* value_ptr, int emb_index, int offset) {
+    return value_ptr->GetValue(emb_index, offset);
+  }
+
+  static V* GetOrAllocate(ValuePtr<V>* value_ptr, Allocator* allocator,
+                          int64 value_len, const V* default_v,
+                          int emb_index, int offset) {
+    return value_ptr->GetOrAllocate(allocator, value_len, default_v,
+                                    emb_index, offset);
+  }
+
+  static int64 GetStep(ValuePtr<V>* value_ptr) {
+    return value_ptr->GetStep();
+  }
+
+  static void SetStep(ValuePtr<V>* value_ptr, int64 gs) {
+    value_ptr->SetStep(gs);
+  }
+
+  static int64 GetFreq(ValuePtr<V>* value_ptr) {
+    return value_ptr->GetFreq();
+  }
+
+  static void AddFreq(ValuePtr<V>* value_ptr, int64 count) {
+    value_ptr->AddFreq(count);
+  }
+};
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_VALUE_PTR_H_
@@ -0,0 +1,299 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_WORKER_EMBEDDING_CACHE_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_WORKER_EMBEDDING_CACHE_H_
+
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/embedding/host_shared_embedding_cache.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// Worker side cache of the rows of a remote EmbeddingVar.
+//  * Every Lookup is one step of the cache. The rows fetched within the
+//    last max_staleness steps hit.
+//  * The other rows miss with the version of their cached copy, the PS
+//    only sends their rows back when its versions, see
+//    EmbeddingVar::GetVersion, differ. The unchanged rows are fresh again
+//    from then on.
+//  * At most capacity rows are kept, the expired rows are dropped first
+//    when the cache is full.
+//  * With a HostSharedEmbeddingCache, the rows missed by the readers are
+//    first read from it, and the writer publishes the rows it fetches.
+//  * With a snapshot path, the rows are written to it every snapshot_steps
+//    steps, and a restarted worker loads them back. The loaded rows are
+//    expired, so their first lookup only fetches them from the PS when
+//    their versions changed since the snapshot.
+template <class K, class V>
+class WorkerEmbeddingCache : public ResourceBase {
+ public:
+  // The version of the rows not in the cache.
+  static const int64 kNoVersion = -1;
+
+  explicit WorkerEmbeddingCache(int64 value_len) : value_len_(value_len) {}
+
+  string DebugString() const override {
+    tf_shared_lock l(mu_);
+    return strings::StrCat("WorkerEmbeddingCache rows: ", index_.size(),
+                           ", value_len: ", value_len_, ", step: ", step_);
+  }
+
+  int64 ValueLen() const {
+    return value_len_;
+  }
+
+  int64 Size() const {
+    tf_shared_lock l(mu_);
+    return index_.size();
+  }
+
+  void SetHostCache(std::unique_ptr<HostSharedEmbeddingCache<K, V>> cache) {
+    mutex_lock l(mu_);
+    host_cache_ = std::move(cache);
+  }
+
+  // Loads the rows of the snapshot at path, if any, and writes a snapshot
+  // there every snapshot_steps steps from then on.
+  Status SetSnapshot(Env* env, const string& path, int64 snapshot_steps) {
+    mutex_lock l(snapshot_mu_);
+    snapshot_env_ = env;
+    snapshot_path_ = path;
+    snapshot_steps_ = snapshot_steps;
+    if (!env->FileExists(path).ok()) {
+      return Status::OK();
+    }
+    string data;
+    TF_RETURN_IF_ERROR(ReadFileToString(env, path, &data));
+    const size_t row_bytes = 2 * sizeof(uint64) + value_len_ * sizeof(V);
+    if (data.size() < 2 * sizeof(uint64) ||
+        static_cast<int64>(core::DecodeFixed64(data.data())) != value_len_ ||
+        data.size() != 2 * sizeof(uint64) +
+            core::DecodeFixed64(data.data() + sizeof(uint64)) * row_bytes) {
+      return errors::DataLoss("Invalid worker embedding cache snapshot ",
+                              path);
+    }
+    const int64 num_rows = core::DecodeFixed64(data.data() + sizeof(uint64));
+    const char* row = data.data() + 2 * sizeof(uint64);
+    mutex_lock ll(mu_);
+    for (int64 i = 0; i < num_rows; i++, row += row_bytes) {
+      K key = static_cast<K>(core::DecodeFixed64(row));
+      int64 version = core::DecodeFixed64(row + sizeof(uint64));
+      Insert(key, reinterpret_cast<const V*>(row + 2 * sizeof(uint64)),
+             version, /*capacity=*/0, /*max_staleness=*/0);
+      index_[key].fetch_step = kLoadedStep;
+    }
+    last_snapshot_step_ = step_;
+    return Status::OK();
+  }
+
+  // Writes a snapshot of the rows when snapshot_steps steps passed since
+  // the last one. The rows are copied under the lock and written after.
+  Status MaybeSnapshot() {
+    mutex_lock l(snapshot_mu_);
+    if (snapshot_path_.empty()) {
+      return Status::OK();
+    }
+    string data;
+    {
+      mutex_lock ll(mu_);
+      if (step_ - last_snapshot_step_ < snapshot_steps_) {
+        return Status::OK();
+      }
+      last_snapshot_step_ = step_;
+      core::PutFixed64(&data, value_len_);
+      core::PutFixed64(&data, index_.size());
+      for (const auto& it : index_) {
+        core::PutFixed64(&data, static_cast<uint64>(it.first));
+        core::PutFixed64(&data, static_cast<uint64>(it.second.version));
+        data.append(reinterpret_cast<const char*>(
+                        rows_.data() + it.second.offset * value_len_),
+                    value_len_ * sizeof(V));
+      }
+    }
+    const string tmp_path = strings::StrCat(snapshot_path_, ".tmp");
+    TF_RETURN_IF_ERROR(WriteStringToFile(snapshot_env_, tmp_path, data));
+    return snapshot_env_->RenameFile(tmp_path, snapshot_path_);
+  }
+
+  // Writes the cached rows of keys to values, the rows of the keys not in
+  // the cache are zeros. The missed keys and the versions of their cached
+  // rows are appended to miss_keys and miss_versions in the order of keys.
+  void Lookup(const K* keys, int64 n, int64 max_staleness, V* values,
+              bool* hits, std::vector<K>* miss_keys,
+              std::vector<int64>* miss_versions) {
+    mutex_lock l(mu_);
+    step_++;
+    const bool read_host = host_cache_ != nullptr &&
+                           !host_cache_->is_writer();
+    if (read_host) {
+      host_cache_->MaybeAttach();
+    }
+    for (int64 i = 0; i < n; i++) {
+      V* value = values + i * value_len_;
+      auto it = index_.find(keys[i]);
+      int64 host_version;
+      if (read_host &&
+          (it == index_.end() ||
+           step_ - it->second.fetch_step >= max_staleness) &&
+          host_cache_->Lookup(keys[i], value, &host_version)) {
+        if (it != index_.end()) {
+          it->second.fetch_step = step_;
+          it->second.version = host_version;
+          memcpy(rows_.data() + it->second.offset * value_len_, value,
+                 value_len_ * sizeof(V));
+        }
+        hits[i] = true;
+        continue;
+      }
+      if (it == index_.end()) {
+        memset(value, 0, value_len_ * sizeof(V));
+        hits[i] = false;
+        miss_keys->emplace_back(keys[i]);
+        miss_versions->emplace_back(kNoVersion);
+        continue;
+      }
+      memcpy(value, rows_.data() + it->second.offset * value_len_,
+             value_len_ * sizeof(V));
+      hits[i] = step_ - it->second.fetch_step < max_staleness;
+      if (!hits[i]) {
+        miss_keys->emplace_back(keys[i]);
+        miss_versions->emplace_back(it->second.version);
+      }
+    }
+  }
+
+  // Fills the rows of the missed keys of values, the rows modified on the
+  // PS are taken from modified_values in order, the others are the cached
+  // rows already in values. Both are fresh from this step on.
+  void Merge(int64 n, const bool* hits, const K* miss_keys,
+             const bool* modified, const V* modified_values,
+             const int64* versions, int64 capacity, int64 max_staleness,
+             V* values) {
+    mutex_lock l(mu_);
+    const bool publish = host_cache_ != nullptr && host_cache_->is_writer();
+    int64 miss = 0;
+    int64 num_modified = 0;
+    for (int64 i = 0; i < n; i++) {
+      if (hits[i]) {
+        continue;
+      }
+      K key = miss_keys[miss];
+      if (!modified[miss]) {
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+          it->second.fetch_step = step_;
+        }
+        if (publish) {
+          host_cache_->Insert(key, values + i * value_len_, versions[miss]);
+        }
+        miss++;
+        continue;
+      }
+      const V* row = modified_values + num_modified * value_len_;
+      memcpy(values + i * value_len_, row, value_len_ * sizeof(V));
+      Insert(key, row, versions[miss], capacity, max_staleness);
+      if (publish) {
+        host_cache_->Insert(key, row, versions[miss]);
+      }
+      num_modified++;
+      miss++;
+    }
+  }
+
+ private:
+  struct Entry {
+    int64 offset;
+    int64 fetch_step;
+    int64 version;
+  };
+
+  void Insert(K key, const V* row, int64 version, int64 capacity,
+              int64 max_staleness) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      if (capacity > 0 && static_cast<int64>(index_.size()) >= capacity) {
+        DropExpired(max_staleness);
+        if (static_cast<int64>(index_.size()) >= capacity) {
+          return;
+        }
+      }
+      int64 offset;
+      if (free_offsets_.empty()) {
+        offset = rows_.size() / value_len_;
+        rows_.resize(rows_.size() + value_len_);
+      } else {
+        offset = free_offsets_.back();
+        free_offsets_.pop_back();
+      }
+      it = index_.emplace(key, Entry{offset, 0, 0}).first;
+    }
+    it->second.fetch_step = step_;
+    it->second.version = version;
+    memcpy(rows_.data() + it->second.offset * value_len_, row,
+           value_len_ * sizeof(V));
+  }
+
+  // The fetch step of the rows loaded from a snapshot, expired for any
+  // max_staleness.
+  static constexpr int64 kLoadedStep = std::numeric_limits<int64>::min() / 2;
+
+  void DropExpired(int64 max_staleness) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    for (auto it = index_.begin(); it != index_.end();) {
+      if (step_ - it->second.fetch_step >= max_staleness) {
+        free_offsets_.emplace_back(it->second.offset);
+        it = index_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  const int64 value_len_;
+  mutable mutex mu_;
+  std::unordered_map<K, Entry> index_ GUARDED_BY(mu_);
+  std::vector<V> rows_ GUARDED_BY(mu_);
+  std::vector<int64> free_offsets_ GUARDED_BY(mu_);
+  int64 step_ GUARDED_BY(mu_) = 0;
+  std::unique_ptr<HostSharedEmbeddingCache<K, V>> host_cache_ GUARDED_BY(mu_);
+  int64 last_snapshot_step_ GUARDED_BY(mu_) = 0;
+  // Serializes the snapshots, acquired before mu_.
+  mutex snapshot_mu_;
+  Env* snapshot_env_ GUARDED_BY(snapshot_mu_) = nullptr;
+  string snapshot_path_ GUARDED_BY(snapshot_mu_);
+  int64 snapshot_steps_ GUARDED_BY(snapshot_mu_) = 0;
+};
+
+template <class K, class V>
+const int64 WorkerEmbeddingCache<K, V>::kNoVersion;
+
+template <class K, class V>
+constexpr int64 WorkerEmbeddingCache<K, V>::kLoadedStep;
+
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_WORKER_EMBEDDING_CACHE_H_
@@ -13,7 +13,10 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <sys/mman.h>
+
 #include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/framework/ev_allocator.h"
 
 namespace tensorflow {
@@ -37,18 +40,218 @@ static constexpr size_t kPageShift = 12;
 static constexpr size_t kPageSize = (1 << kPageShift);    // 4KB page by default
 static constexpr size_t kPageCount = kChunkSize / kPageSize;
 
+static constexpr size_t kHugePageSize = (1 << 21);     // 2MB
+static constexpr size_t kGiantPageSize = (1 << 30);    // 1GB
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+// Pages backing the chunks of EVAllocator, set by TF_EV_ALLOCATOR_HUGE_PAGE
+// to one of "thp", "2M" or "1G". Chunks fall back to the next smaller kind
+// if the huge pages can't be reserved.
+enum ChunkPageType {
+  NORMAL_PAGE = 0,
+  TRANSPARENT_HUGE_PAGE = 1,
+  HUGETLB_2M = 2,
+  HUGETLB_1G = 3,
+  NUM_CHUNK_PAGE_TYPES = 4
+};
+
+static const char* kChunkPageTypeNames[NUM_CHUNK_PAGE_TYPES] = {
+  "4K", "THP", "hugetlb 2M", "hugetlb 1G"};
+
+static ChunkPageType RequestedChunkPageType() {
+  static ChunkPageType page_type = []() {
+    string huge_page;
+    Status s = ReadStringFromEnvVar("TF_EV_ALLOCATOR_HUGE_PAGE", "",
+                                    &huge_page);
+    if (!s.ok()) {
+      LOG(ERROR) << "Read TF_EV_ALLOCATOR_HUGE_PAGE env error: "
+                 << s.error_message();
+    }
+    if (huge_page.empty()) {
+      return NORMAL_PAGE;
+    } else if (huge_page == "thp") {
+      return TRANSPARENT_HUGE_PAGE;
+    } else if (huge_page == "2M") {
+      return HUGETLB_2M;
+    } else if (huge_page == "1G") {
+      return HUGETLB_1G;
+    }
+    LOG(WARNING) << "Unknown TF_EV_ALLOCATOR_HUGE_PAGE: " << huge_page
+                 << ", EVAllocator uses normal pages.";
+    return NORMAL_PAGE;
+  }();
+  return page_type;
+}
+
+// Number of chunks of every page type, for ev_allocator_collect_stats.
+static std::atomic<int64> chunk_count[NUM_CHUNK_PAGE_TYPES];
+
+// Log the page types of the chunks every kChunkStatsLogInterval chunks.
+static constexpr int64 kChunkStatsLogInterval = 1024;
+
+static int64 ChunkBytesReserved() {
+  int64 total_chunks = 0;
+  for (int i = 0; i < NUM_CHUNK_PAGE_TYPES; ++i) {
+    total_chunks += chunk_count[i].load(std::memory_order_relaxed);
+  }
+  return total_chunks * kChunkSize;
+}
+
+static void RecordChunk(ChunkPageType page_type) {
+  int64 count = ++chunk_count[page_type];
+  if (ev_allocator_collect_stats && count % kChunkStatsLogInterval == 0) {
+    string msg;
+    for (int i = 0; i < NUM_CHUNK_PAGE_TYPES; ++i) {
+      strings::StrAppend(&msg, " ", kChunkPageTypeNames[i], ": ",
+                         chunk_count[i].load(std::memory_order_relaxed));
+    }
+    LOG(INFO) << "EVAllocator chunks of " << kChunkSize
+              << " bytes by page type:" << msg;
+  }
+}
+
+// Chunks are counted for all EV allocators of the process.
+static void FillChunkStats(AllocatorStats* stats) {
+  stats->bytes_reserved = ChunkBytesReserved();
+  // Chunks are never returned before the allocator is destroyed.
+  stats->peak_bytes_reserved = stats->bytes_reserved;
+}
+
+static void LogHugePageFallback(ChunkPageType page_type) {
+  static std::atomic<bool> logged(false);
+  if (!logged.exchange(true)) {
+    LOG(WARNING) << "Can't reserve " << kChunkPageTypeNames[page_type]
+                 << " pages for EVAllocator chunks, falling back to"
+                 << " smaller pages. Check /proc/sys/vm/nr_hugepages.";
+  }
+}
+
+// The chunks and the chunk visitors of all the EV allocators.
+struct EVChunkRegistry {
+  mutex mu;
+  std::vector<std::pair<void*, size_t>> chunks GUARDED_BY(mu);
+  std::vector<EVChunkVisitor> visitors GUARDED_BY(mu);
+  EVRemoteKeyFn remote_key_fn GUARDED_BY(mu);
+
+  static EVChunkRegistry* Global() {
+    static EVChunkRegistry* registry = new EVChunkRegistry;
+    return registry;
+  }
+};
+
+static void VisitNewChunk(void* chunk, size_t chunk_size) {
+  EVChunkRegistry* registry = EVChunkRegistry::Global();
+  mutex_lock l(registry->mu);
+  registry->chunks.emplace_back(chunk, chunk_size);
+  for (const auto& visitor : registry->visitors) {
+    visitor(chunk, chunk_size);
+  }
+}
+
+// Hands out chunks from 1GB huge pages. Chunks carved from a giant page
+// are never unmapped, EVAllocator keeps its chunks for its lifetime.
+class GiantPageRegion {
+ public:
+  static void* Allocate(size_t chunk_size) {
+    static GiantPageRegion region;
+    mutex_lock l(region.mu_);
+    if (region.current_ == nullptr ||
+        region.current_ + chunk_size > region.end_) {
+#ifdef MAP_HUGETLB
+      void* p = mmap(nullptr, kGiantPageSize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+                     (30 << MAP_HUGE_SHIFT), -1, 0);
+      if (p == MAP_FAILED) {
+        return nullptr;
+      }
+      region.current_ = static_cast<char*>(p);
+      region.end_ = region.current_ + kGiantPageSize;
+#else
+      return nullptr;
+#endif  // MAP_HUGETLB
+    }
+    void* ret = region.current_;
+    region.current_ += chunk_size;
+    return ret;
+  }
+
+ private:
+  mutex mu_;
+  char* current_ GUARDED_BY(mu_) = nullptr;
+  char* end_ GUARDED_BY(mu_) = nullptr;
+};
+
+static void* AllocateHugeTLB2M(size_t chunk_size) {
+#ifdef MAP_HUGETLB
+  void* p = mmap(nullptr, chunk_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+                 (21 << MAP_HUGE_SHIFT), -1, 0);
+  return (p == MAP_FAILED) ? nullptr : p;
+#else
+  return nullptr;
+#endif  // MAP_HUGETLB
+}
+
+static void* AllocateTransparentHugePage(size_t chunk_size) {
+  void* p = port::AlignedMalloc(chunk_size, kHugePageSize);
+#ifdef MADV_HUGEPAGE
+  if (p != nullptr) {
+    madvise(p, chunk_size, MADV_HUGEPAGE);
+  }
+#endif  // MADV_HUGEPAGE
+  return p;
+}
+
 class CPUChunk : public Chunk<CPUChunk> {
 public:
   CPUChunk(size_t chunk_size, size_t slot_size)
      : Chunk<CPUChunk>(chunk_size, slot_size) {} 
 
   ~CPUChunk() {
-    port::AlignedFree(start_);
+    switch (page_type_) {
+      case HUGETLB_1G:
+        break;
+      case HUGETLB_2M:
+        munmap(start_, chunk_size_);
+        break;
+      default:
+        port::AlignedFree(start_);
+    }
   }
  
   void GetMemBlock() override {
-    start_ = (char *)port::AlignedMalloc(chunk_size_, kPageSize);
+    ChunkPageType requested = RequestedChunkPageType();
+    start_ = nullptr;
+    if (requested == HUGETLB_1G) {
+      start_ = (char *)GiantPageRegion::Allocate(chunk_size_);
+      page_type_ = HUGETLB_1G;
+    }
+    if (start_ == nullptr && requested >= HUGETLB_2M) {
+      start_ = (char *)AllocateHugeTLB2M(chunk_size_);
+      page_type_ = HUGETLB_2M;
+    }
+    if (start_ == nullptr && requested >= TRANSPARENT_HUGE_PAGE) {
+      if (requested > TRANSPARENT_HUGE_PAGE) {
+        LogHugePageFallback(requested);
+      }
+      start_ = (char *)AllocateTransparentHugePage(chunk_size_);
+      page_type_ = TRANSPARENT_HUGE_PAGE;
+    }
+    if (start_ == nullptr) {
+      start_ = (char *)port::AlignedMalloc(chunk_size_, kPageSize);
+      page_type_ = NORMAL_PAGE;
+    }
+    if (start_ != nullptr) {
+      RecordChunk(page_type_);
+      VisitNewChunk(start_, chunk_size_);
+    }
   }
+
+ private:
+  ChunkPageType page_type_ = NORMAL_PAGE;
 };
 
 template<>
@@ -61,11 +264,25 @@ void PageMap<CPUChunk>::Init() {
 
 class CPUEVAllocator : public EVAllocator<CPUChunk> {
 public:
-  CPUEVAllocator() = default;
+  CPUEVAllocator() {
+    Status s = ReadBoolFromEnvVar("TF_EV_ALLOCATOR_COLLECT_STATS", false,
+                                  &ev_allocator_collect_stats);
+    if (!s.ok()) {
+      LOG(ERROR) << "Read TF_EV_ALLOCATOR_COLLECT_STATS env error: "
+                 << s.error_message();
+    }
+  }
   ~CPUEVAllocator() override = default;
 
   string Name() override { return "ev_allocator"; }
 
+  absl::optional<AllocatorStats> GetStats() override {
+    mutex_lock l(mu_);
+    AllocatorStats stats = stats_;
+    FillChunkStats(&stats);
+    return stats;
+  }
+
   void* AllocateRaw(size_t alignment, size_t num_bytes) override {
     num_bytes = AlignedSize(num_bytes);
 
@@ -151,6 +368,98 @@ public:
   }  
 };
 
+// NUMA node of the NUMACPUEVAllocator the current thread is allocating
+// from, new chunks are bound to it.
+thread_local int numa_chunk_node = port::kNUMANoAffinity;
+
+class NUMACPUChunk : public Chunk<NUMACPUChunk> {
+public:
+  NUMACPUChunk(size_t chunk_size, size_t slot_size)
+     : Chunk<NUMACPUChunk>(chunk_size, slot_size),
+       numa_node_(numa_chunk_node) {}
+
+  ~NUMACPUChunk() {
+    port::NUMAFree(start_, chunk_size_);
+  }
+
+  // Huge pages of hugetlbfs can't be bound to a node by NUMAMalloc, any
+  // requested huge page type is served with transparent huge pages.
+  void GetMemBlock() override {
+    if (RequestedChunkPageType() == NORMAL_PAGE) {
+      start_ = (char *)port::NUMAMalloc(numa_node_, chunk_size_, kPageSize);
+      page_type_ = NORMAL_PAGE;
+    } else {
+      start_ = (char *)port::NUMAMalloc(numa_node_, chunk_size_,
+                                        kHugePageSize);
+#ifdef MADV_HUGEPAGE
+      if (start_ != nullptr) {
+        madvise(start_, chunk_size_, MADV_HUGEPAGE);
+      }
+#endif  // MADV_HUGEPAGE
+      page_type_ = TRANSPARENT_HUGE_PAGE;
+    }
+    if (start_ != nullptr) {
+      RecordChunk(page_type_);
+      VisitNewChunk(start_, chunk_size_);
+    }
+  }
+
+ private:
+  int numa_node_;
+  ChunkPageType page_type_ = NORMAL_PAGE;
+};
+
+template<>
+void PageMap<NUMACPUChunk>::Init() {
+  page_shift_ = kPageShift;
+  npages_ = kPageCount;
+
+  InitInternal();
+}
+
+class NUMACPUEVAllocator : public EVAllocator<NUMACPUChunk> {
+public:
+  explicit NUMACPUEVAllocator(int numa_node) : numa_node_(numa_node) {}
+  ~NUMACPUEVAllocator() override = default;
+
+  string Name() override {
+    return strings::StrCat("ev_allocator_numa_", numa_node_);
+  }
+
+  absl::optional<AllocatorStats> GetStats() override {
+    mutex_lock l(mu_);
+    AllocatorStats stats = stats_;
+    FillChunkStats(&stats);
+    return stats;
+  }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    ScopedChunkNode s(numa_node_);
+    return EVAllocator<NUMACPUChunk>::AllocateRaw(alignment, num_bytes);
+  }
+
+  size_t BatchAllocateRaw(size_t num, size_t alignment,
+      size_t num_bytes, void** ret) override {
+    ScopedChunkNode s(numa_node_);
+    return EVAllocator<NUMACPUChunk>::BatchAllocateRaw(
+        num, alignment, num_bytes, ret);
+  }
+
+ private:
+  class ScopedChunkNode {
+   public:
+    explicit ScopedChunkNode(int numa_node) : prev_(numa_chunk_node) {
+      numa_chunk_node = numa_node;
+    }
+    ~ScopedChunkNode() { numa_chunk_node = prev_; }
+
+   private:
+    int prev_;
+  };
+
+  int numa_node_;
+};
+
 class EVAllocatorFactory : public AllocatorFactory {
  public:
   Allocator* CreateAllocator() override { return CreateEVAllocator(); }
@@ -159,6 +468,10 @@ class EVAllocatorFactory : public AllocatorFactory {
     return new CPUEVAllocator;
   }
 
+  Allocator* CreateNUMAEVAllocator(int numa_node) override {
+    return new NUMACPUEVAllocator(numa_node);
+  }
+
   SubAllocator* CreateSubAllocator(int numa_node) override {
     return new EVSubAllocator(new CPUEVAllocator);
   }
@@ -185,5 +498,30 @@ class EVAllocatorFactory : public AllocatorFactory {
 REGISTER_MEM_ALLOCATOR("EVAllocator", 20, EVAllocatorFactory);
   
 } // end of anonymous namespace
+
+void AddEVChunkVisitor(const EVChunkVisitor& visitor) {
+  EVChunkRegistry* registry = EVChunkRegistry::Global();
+  mutex_lock l(registry->mu);
+  for (const auto& chunk : registry->chunks) {
+    visitor(chunk.first, chunk.second);
+  }
+  registry->visitors.push_back(visitor);
+}
+
+void SetEVRemoteKeyFn(const EVRemoteKeyFn& fn) {
+  EVChunkRegistry* registry = EVChunkRegistry::Global();
+  mutex_lock l(registry->mu);
+  registry->remote_key_fn = fn;
+}
+
+bool EVRemoteKey(const void* ptr, size_t len, uint32* remote_key) {
+  EVRemoteKeyFn fn;
+  {
+    EVChunkRegistry* registry = EVChunkRegistry::Global();
+    mutex_lock l(registry->mu);
+    fn = registry->remote_key_fn;
+  }
+  return fn && fn(ptr, len, remote_key);
+}
   
 } // end of namespace tensorflow
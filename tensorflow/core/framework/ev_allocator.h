@@ -16,6 +16,7 @@ limitations under the License.
 #define _TENSORFLOW_CORE_FRAMEWORK_EV_ALLOCATOR_H_
 
 #include <atomic>
+#include <functional>
 #include <list>
 #include <vector>
 #include <readerwriterqueue.h>
@@ -56,6 +57,21 @@ static const int kThreadLocalBinMaxPtrNum = 16;
 static const int kThreadLocalBinExchangeMaxPtrNum = \
   kThreadLocalBinMaxPtrNum >> 1;
 
+// Visits the chunks of the EVAllocators of the process: the chunks already
+// allocated when it is added, then every new chunk. Lets a transport, e.g.
+// the star RDMA server, register the rows of the EmbeddingVariables for
+// remote reads.
+typedef std::function<void(void* chunk, size_t chunk_size)> EVChunkVisitor;
+void AddEVChunkVisitor(const EVChunkVisitor& visitor);
+
+// The key under which a transport registered the chunk holding
+// [ptr, ptr + len) for remote reads, false when it's not registered. Set
+// by the transport that registers the chunks.
+typedef std::function<bool(const void* ptr, size_t len, uint32* remote_key)>
+    EVRemoteKeyFn;
+void SetEVRemoteKeyFn(const EVRemoteKeyFn& fn);
+bool EVRemoteKey(const void* ptr, size_t len, uint32* remote_key);
+
 namespace {
 constexpr size_t kChunkSize = ( 1 << 22);  // 4MB chunk size
 
@@ -88,6 +88,77 @@ private:
 
 REGISTER_MEM_ALLOCATOR("GPUEVAllocator", 20, GPUEVAllocatorFactory);
 
+// Chunks of page-locked host memory mapped into the address space of the
+// devices, so kernels read the rows in them directly over UVA.
+class PinnedChunk : public Chunk<PinnedChunk> {
+public:
+  PinnedChunk(size_t chunk_size, size_t slot_size)
+    : Chunk<PinnedChunk>(chunk_size, slot_size) {}
+
+  ~PinnedChunk() {
+    cudaFreeHost(start_);
+  }
+
+  void GetMemBlock() override {
+    if (cudaHostAlloc((void**)&start_, chunk_size_,
+                      cudaHostAllocMapped | cudaHostAllocPortable) !=
+        cudaSuccess) {
+      LOG(ERROR) << "Failed to allocate " << chunk_size_
+                 << " bytes of pinned host memory.";
+      start_ = nullptr;
+    }
+  }
+};
+
+template<>
+void PageMap<PinnedChunk>::Init() {
+  page_shift_ = kPageShift;
+  npages_ = kPageCount;
+
+  InitInternal();
+}
+
+class PinnedEVAllocator : public EVAllocator<PinnedChunk> {
+public:
+  PinnedEVAllocator() = default;
+  ~PinnedEVAllocator() override = default;
+
+  string Name() override { return "pinned_ev_allocator"; }
+};
+
+class PinnedEVAllocatorFactory : public AllocatorFactory {
+public:
+  Allocator* CreateAllocator() override { return CreatePinnedEVAllocator(); }
+
+  Allocator* CreatePinnedEVAllocator() override {
+    return new PinnedEVAllocator;
+  }
+
+  SubAllocator* CreateSubAllocator(int numa_node) override {
+    return new PinnedEVSubAllocator(new PinnedEVAllocator);
+  }
+
+private:
+  class PinnedEVSubAllocator : public SubAllocator {
+  public:
+    explicit PinnedEVSubAllocator(PinnedEVAllocator* pinned_ev_allocator)
+      : SubAllocator({}, {}), pinned_ev_allocator_(pinned_ev_allocator) {}
+
+    void* Alloc(size_t alignment, size_t num_bytes) override {
+      return pinned_ev_allocator_->AllocateRaw(alignment, num_bytes);
+    }
+
+    void Free(void *ptr, size_t num_bytes) override {
+      pinned_ev_allocator_->DeallocateRaw(ptr);
+    }
+
+  private:
+    PinnedEVAllocator* pinned_ev_allocator_;
+  };
+};
+
+REGISTER_MEM_ALLOCATOR("PinnedEVAllocator", 20, PinnedEVAllocatorFactory);
+
 } // end of anonymous namespace
   
 } // end of namespace tensorflow
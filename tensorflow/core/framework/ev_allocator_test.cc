@@ -1,4 +1,5 @@
 #include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/ev_allocator.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/threadpool_interface.h"
 #include "tensorflow/core/platform/env.h"
@@ -427,5 +428,48 @@ TEST(EVAllocator, TestMultiThreadAllocateDeallocateLongRun) {
   }
 }
 
+TEST(EVAllocator, TestChunkBytesReserved) {
+  auto allocator = ev_allocator();
+  void* ptr = allocator->AllocateRaw(8, 40);
+  memset(ptr, 0, 40);
+  auto stats = allocator->GetStats();
+  EXPECT_TRUE(stats);
+  EXPECT_GT(stats->bytes_reserved, 0);
+  EXPECT_EQ(stats->bytes_reserved % (4 << 20), 0);
+  allocator->DeallocateRaw(ptr);
+}
+
+TEST(EVAllocator, TestChunkVisitor) {
+  auto allocator = ev_allocator();
+  char* ptr = static_cast<char*>(allocator->AllocateRaw(8, 40));
+  // The visitor stays registered, the chunks it records outlive the test.
+  static mutex mu;
+  static auto* chunks = new std::vector<std::pair<char*, size_t>>;
+  AddEVChunkVisitor([](void* chunk, size_t chunk_size) {
+    mutex_lock l(mu);
+    chunks->emplace_back(static_cast<char*>(chunk), chunk_size);
+  });
+  // The chunk of ptr, allocated before the visitor, is visited too.
+  bool visited = false;
+  {
+    mutex_lock l(mu);
+    for (const auto& chunk : *chunks) {
+      visited |= ptr >= chunk.first && ptr + 40 <= chunk.first + chunk.second;
+    }
+  }
+  EXPECT_TRUE(visited);
+
+  uint32 remote_key = 0;
+  EXPECT_FALSE(EVRemoteKey(ptr, 40, &remote_key));
+  SetEVRemoteKeyFn([](const void* p, size_t len, uint32* remote_key) {
+    *remote_key = 7;
+    return true;
+  });
+  EXPECT_TRUE(EVRemoteKey(ptr, 40, &remote_key));
+  EXPECT_EQ(7, remote_key);
+  SetEVRemoteKeyFn(nullptr);
+  allocator->DeallocateRaw(ptr);
+}
+
 }
 } // namespace tensorflow
@@ -28,6 +28,11 @@ namespace {
 static constexpr float kMaxLoadFactor = 0.5;
 static constexpr tensorflow::int64 kPartitionBlockSize = 65536;
 static constexpr int kPreAllocIds = 256;
+// Smaller table splits are rehashed at once.
+static constexpr tensorflow::int64 kMinMigrationSize = 16384;
+// The entries moved per insert, enough to move all of them before the new
+// table, twice as large, fills up.
+static constexpr tensorflow::int64 kMigrationBatch = 8;
 static const int64_t kPreseverdEmptyKey =
     tensorflow::random::New64Configuable();
 }
@@ -105,6 +110,82 @@ void HashTable::IdsAllocator::Clear() {
   counter_ = 0;
 }
 
+HashTable::Table::Table() {
+  InitMap(&current_);
+}
+
+void HashTable::Table::InitMap(Map* map) {
+  map->max_load_factor(kMaxLoadFactor);
+  map->set_empty_key(kPreseverdEmptyKey);
+  map->set_deleted_key(kPreseverdEmptyKey + 1);
+}
+
+bool HashTable::Table::Find(int64 key, int64* id) const {
+  auto iter = current_.find(key);
+  if (iter != current_.end()) {
+    *id = iter->second;
+    return true;
+  }
+  if (old_ != nullptr) {
+    iter = old_->find(key);
+    if (iter != old_->end()) {
+      *id = iter->second;
+      return true;
+    }
+  }
+  return false;
+}
+
+void HashTable::Table::Insert(int64 key, int64 id) {
+  if (old_ == nullptr && current_.size() >= kMinMigrationSize &&
+      current_.size() + 1 >
+          current_.bucket_count() * current_.max_load_factor()) {
+    old_.reset(new Map);
+    InitMap(old_.get());
+    old_->swap(current_);
+    current_.resize(old_->size() * 2);
+    cursor_ = old_->begin();
+  }
+  current_[key] = id;
+  if (old_ != nullptr) {
+    Migrate(kMigrationBatch);
+  }
+}
+
+bool HashTable::Table::Erase(int64 key) {
+  bool erased = current_.erase(key) > 0;
+  if (old_ != nullptr) {
+    erased = old_->erase(key) > 0 || erased;
+  }
+  return erased;
+}
+
+void HashTable::Table::Clear() {
+  old_.reset();
+  current_.clear();
+}
+
+void HashTable::Table::Migrate(int64 count) {
+  if (old_ == nullptr) {
+    return;
+  }
+  for (; count > 0 && cursor_ != old_->end(); ++cursor_, --count) {
+    // The entry may have been erased after the cursor reached it. The
+    // entries inserted since the migration started are newer.
+    if (cursor_->first != kPreseverdEmptyKey + 1) {
+      current_.insert(*cursor_);
+    }
+  }
+  if (cursor_ == old_->end()) {
+    old_.reset();
+  }
+}
+
+HashTable::Table::Map& HashTable::Table::FinishMigration() {
+  Migrate(std::numeric_limits<int64>::max());
+  return current_;
+}
+
 HashTable::HashTable(int num_worker_threads, bool concurrent_read,
     int slice_size, int id_block_size)
   : slice_size_(slice_size), id_block_size_(id_block_size),
@@ -118,12 +199,7 @@ HashTable::HashTable(int num_worker_threads, bool concurrent_read,
         kPreseverdEmptyKey << " and " << kPreseverdEmptyKey + 1;
     return '\0';
   }();
-  for (int64 i = 0; i < num_tables_; ++i) {
-    tables_.emplace_back();
-    tables_.back().max_load_factor(kMaxLoadFactor);
-    tables_.back().set_empty_key(kPreseverdEmptyKey);
-    tables_.back().set_deleted_key(kPreseverdEmptyKey + 1);
-  }
+  tables_.resize(num_tables_);
 }
 
 void HashTable::AddTensible(
@@ -312,9 +388,10 @@ void HashTable::GetIdsSimpleForConcurrentRead(
       while(next_idx != -1) {
         cur_idx = next_idx;
         next_idx = ids[next_idx];
-        auto iter = tables_[table_idx].find(keys[cur_idx]);
-        if (iter != tables_[table_idx].end() && iter->second != kNotAdmitted) {
-          ids[cur_idx] = iter->second;
+        int64 id;
+        if (tables_[table_idx].Find(keys[cur_idx], &id) &&
+            id != kNotAdmitted) {
+          ids[cur_idx] = id;
           sizex = std::max(sizex, ids[cur_idx]);
         } else {
           // do admit
@@ -341,13 +418,14 @@ void HashTable::GetIdsSimpleForConcurrentRead(
     while (new_id_list != -1) {
       cur_idx = new_id_list;
       new_id_list = ids[new_id_list];
-      auto iter = tables_[table_idx].find(keys[cur_idx]);
-      if (iter != tables_[table_idx].end() && iter->second != kNotAdmitted) {
-        ids[cur_idx] = iter->second;
+      int64 id;
+      if (tables_[table_idx].Find(keys[cur_idx], &id) &&
+          id != kNotAdmitted) {
+        ids[cur_idx] = id;
       } else {
         CHECK(ids_container_[table_idx].GetNext(&ids[cur_idx])) <<
             "new_id_size: " << new_id_size;
-        tables_[table_idx][keys[cur_idx]] = ids[cur_idx];
+        tables_[table_idx].Insert(keys[cur_idx], ids[cur_idx]);
       }
       sizex = std::max(sizex, ids[cur_idx]);
     }
@@ -372,10 +450,11 @@ void HashTable::GetIdsSimpleForExclusiveAccess(
       while(next_idx != -1) {
         cur_idx = next_idx;
         next_idx = ids[next_idx];
-        auto iter = tables_[table_idx].find(keys[cur_idx]);
+        int64 id;
         // item found
-        if (iter != tables_[table_idx].end() && iter->second != kNotAdmitted) {
-          ids[cur_idx] = iter->second;
+        if (tables_[table_idx].Find(keys[cur_idx], &id) &&
+            id != kNotAdmitted) {
+          ids[cur_idx] = id;
           sizex = std::max(sizex, ids[cur_idx]);
           continue;
         }
@@ -392,10 +471,12 @@ void HashTable::GetIdsSimpleForExclusiveAccess(
           ids_allocator_.GetIds(kPreAllocIds, &ids_container_[table_idx]);
           CHECK(ids_container_[table_idx].GetNext(&ids[cur_idx]));
         }
-        tables_[table_idx][keys[cur_idx]] = ids[cur_idx];
+        tables_[table_idx].Insert(keys[cur_idx], ids[cur_idx]);
         sizex = std::max(sizex, ids[cur_idx]);
       }
     }
+    // Lookups of known keys help to move the entries too.
+    tables_[table_idx].Migrate(kMigrationBatch);
   }
 
   sizex = (sizex / slice_size_ + 1) * slice_size_;
@@ -476,7 +557,7 @@ void HashTable::DeleteKeysSimple(
     mutex_lock lock(update_mu_);
     for (int64 i = 0; i < size; ++i) {
       int64 table_idx =  KeyToTableIdx(keys + i);
-      if (tables_[table_idx].erase(keys[i]) && ids[i] != kNotAdmitted) {
+      if (tables_[table_idx].Erase(keys[i]) && ids[i] != kNotAdmitted) {
         ids_allocator_.FreeId(ids[i]);
       }
     }
@@ -506,7 +587,7 @@ void HashTable::Clear(const std::function<void(Status)>& done) {
         tensor->Clear();
       }
       for (int64 i = 0; i < num_tables_; ++i) {
-        tables_[i].clear();
+        tables_[i].Clear();
       }
       ids_allocator_.Clear();
       for (int64 i = 0; i < num_tables_; ++i) {
@@ -524,7 +605,8 @@ std::vector<std::pair<int64, int64>> HashTable::Snapshot() {
   int64 size = size_;
   std::vector<std::pair<int64, int64>> ret;
   for (int64 i = 0; i < num_tables_; ++i) {
-    for (auto iter = tables_[i].begin(); iter != tables_[i].end(); ++iter) {
+    auto& table = tables_[i].FinishMigration();
+    for (auto iter = table.begin(); iter != table.end(); ++iter) {
       if (iter->second < size) {
         ret.emplace_back(iter->first, iter->second);
       }
@@ -540,7 +622,8 @@ void HashTable::Snapshot(std::vector<int64>* keys,
   keys->reserve(size);
   ids->reserve(size);
   for (int64 i = 0; i < num_tables_; ++i) {
-    for (auto iter = tables_[i].begin(); iter != tables_[i].end(); ++iter) {
+    auto& table = tables_[i].FinishMigration();
+    for (auto iter = table.begin(); iter != table.end(); ++iter) {
       if (iter->second < size) {
         keys->push_back(iter->first);
         ids->push_back(iter->second);
@@ -553,14 +636,14 @@ int64 HashTable::GetIdsWithoutResize(int64* keys, int64* ids, int64 size) {
   mutex_lock lock(update_mu_);
   for (int64 i = 0; i < size; i++) {
     int64 table_idx = KeyToTableIdx(keys + i);
-    auto iter = tables_[table_idx].find(keys[i]);
-    if (iter != tables_[table_idx].end() && iter->second != kNotAdmitted) {
-      ids[i] = iter->second;
+    int64 id;
+    if (tables_[table_idx].Find(keys[i], &id) && id != kNotAdmitted) {
+      ids[i] = id;
     } else {
       int64 new_id;
       ids_allocator_.GetId(&new_id);
       size_++;
-      tables_[table_idx][keys[i]] = new_id;
+      tables_[table_idx].Insert(keys[i], new_id);
       ids[i] = new_id;
     }
   }
@@ -608,7 +691,8 @@ Status CoalescedHashTable::ChildSnapshot(
   string child_name = ChildName(name);
   int64 index = index_map_[child_name];
   for (int64 i = 0; i < num_tables_; ++i) {
-    for (auto iter = tables_[i].begin(); iter != tables_[i].end(); ++iter) {
+    auto& table = tables_[i].FinishMigration();
+    for (auto iter = table.begin(); iter != table.end(); ++iter) {
       if (iter->second < size && Match(iter->first, index)) {
         output->emplace_back(Decode(iter->first), iter->second);
       }
@@ -659,10 +743,11 @@ void CoalescedHashTable::ClearMatchedKeys(
   mutex_lock lock(update_mu_);
   std::vector<int64> ids;
   for (int64 i = 0; i < num_tables_; ++i) {
-    for (auto iter = tables_[i].begin(); iter != tables_[i].end(); ) {
+    auto& table = tables_[i].FinishMigration();
+    for (auto iter = table.begin(); iter != table.end(); ) {
       if (match(iter->first)) {
         ids.push_back(iter->second);
-        iter = tables_[i].erase(iter);
+        iter = table.erase(iter);
         if (ids.back() != kNotAdmitted) {
           ids_allocator_.FreeId(ids.back());
         }
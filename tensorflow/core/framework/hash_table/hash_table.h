@@ -117,7 +117,35 @@ class HashTable {
         return x;
       }
   };
-  std::vector<google::dense_hash_map<int64, int64, IdHash>> tables_;
+
+  // A table split which grows incrementally. Once it is full, its entries
+  // are moved into a table twice as large, a few at a time by the threads
+  // holding its write lock, instead of rehashing the whole split at once
+  // while its readers wait. Both tables are looked up until all the entries
+  // are moved.
+  class Table {
+   public:
+    typedef google::dense_hash_map<int64, int64, IdHash> Map;
+
+    Table();
+    bool Find(int64 key, int64* id) const;
+    void Insert(int64 key, int64 id);
+    bool Erase(int64 key);
+    void Clear();
+    // Moves up to count entries into the new table.
+    void Migrate(int64 count);
+    bool Migrating() const { return old_ != nullptr; }
+    // Moves the remaining entries and returns the only table left.
+    Map& FinishMigration();
+
+   private:
+    void InitMap(Map* map);
+
+    Map current_;
+    std::unique_ptr<Map> old_;
+    Map::const_iterator cursor_;
+  };
+  std::vector<Table> tables_;
 
   class IdsContainer {
    public:
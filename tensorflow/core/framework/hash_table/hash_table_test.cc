@@ -13,7 +13,9 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/core/framework/hash_table/hash_table.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
@@ -96,6 +98,35 @@ TEST(HashTable, Simple) {
   }
 }
 
+TEST(HashTable, IncrementalGrowth) {
+  HashTable ht(2, true);
+  const int64 kNumKeys = 200000;
+  std::vector<int64> keys(kNumKeys);
+  std::vector<int64> ids(kNumKeys);
+  for (int64 i = 0; i < kNumKeys; i++) {
+    keys[i] = i * 7 + 3;
+  }
+  // Inserts the keys in batches, so that the splits grow while their
+  // entries are being moved.
+  for (int64 i = 0; i < kNumKeys; i += 1000) {
+    ht.GetIdsWithoutResize(keys.data() + i, ids.data() + i, 1000);
+  }
+  std::vector<int64> found_ids(kNumKeys);
+  ht.GetIdsWithoutResize(keys.data(), found_ids.data(), kNumKeys);
+  EXPECT_EQ(ids, found_ids);
+
+  std::vector<int64> snapshot_keys, snapshot_ids;
+  ht.Snapshot(&snapshot_keys, &snapshot_ids);
+  ASSERT_EQ(kNumKeys, snapshot_keys.size());
+  std::unordered_map<int64, int64> snapshot;
+  for (size_t i = 0; i < snapshot_keys.size(); i++) {
+    snapshot[snapshot_keys[i]] = snapshot_ids[i];
+  }
+  for (int64 i = 0; i < kNumKeys; i++) {
+    EXPECT_EQ(ids[i], snapshot[keys[i]]);
+  }
+}
+
 }  // namespace tensorflow
 
 
@@ -0,0 +1,374 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#include "tensorflow/core/framework/memory_attribution.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/summary.pb.h"
+#include "tensorflow/core/lib/core/bits.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+#include "tensorflow/core/util/event.pb.h"
+#include "tensorflow/core/util/events_writer.h"
+
+namespace tensorflow {
+
+namespace {
+
+constexpr int kNumBins = 48;
+constexpr int kNumShards = 64;
+constexpr int kLoggedOwners = 10;
+constexpr char kOpPrefix[] = "op/";
+
+// The op executing on the thread, whose allocations are charged to it.
+thread_local MemoryAttribution::Owner* thread_op = nullptr;
+thread_local std::unordered_map<const OpKernel*, MemoryAttribution::Owner*>
+    thread_op_owners;
+
+// Charges the allocations of an allocator to an owner. The device allocators
+// record every allocation, to charge its free to its bin and op. The others,
+// e.g. the EV allocator, only record the allocations of which they can't get
+// the size from the wrapped allocator.
+class AttributingAllocator : public AllocatorWrapper {
+ public:
+  AttributingAllocator(Allocator* allocator, MemoryAttribution::Owner* owner,
+                       std::vector<MemoryAttribution::Owner*> bins,
+                       bool owns_allocator)
+      : AllocatorWrapper(allocator),
+        owner_(owner),
+        bins_(std::move(bins)),
+        owns_allocator_(owns_allocator) {}
+
+  ~AttributingAllocator() override {
+    if (owns_allocator_) {
+      delete wrapped();
+    }
+  }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    return AllocateRaw(alignment, num_bytes, AllocationAttributes());
+  }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes,
+                    const AllocationAttributes& allocation_attr) override {
+    void* ptr = wrapped()->AllocateRaw(alignment, num_bytes, allocation_attr);
+    if (ptr != nullptr) {
+      Charge(ptr, num_bytes);
+    }
+    return ptr;
+  }
+
+  size_t BatchAllocateRaw(size_t num, size_t alignment, size_t num_bytes,
+                          void** ret) override {
+    const size_t allocated =
+        wrapped()->BatchAllocateRaw(num, alignment, num_bytes, ret);
+    for (size_t i = 0; i < allocated; ++i) {
+      Charge(ret[i], num_bytes);
+    }
+    return allocated;
+  }
+
+  void DeallocateRaw(void* ptr) override {
+    if (ptr != nullptr) {
+      Release(ptr);
+    }
+    wrapped()->DeallocateRaw(ptr);
+  }
+
+  void DeallocateRawAsync(void* ptr) override {
+    if (ptr != nullptr) {
+      Release(ptr);
+    }
+    wrapped()->DeallocateRawAsync(ptr);
+  }
+
+  absl::optional<AllocatorStats> GetStats() override {
+    return wrapped()->GetStats();
+  }
+
+  void ClearStats() override { wrapped()->ClearStats(); }
+
+  void SetSafeFrontier(uint64 count) override {
+    wrapped()->SetSafeFrontier(count);
+  }
+
+  void SetStream(void* stream) override { wrapped()->SetStream(stream); }
+
+ private:
+  struct Allocation {
+    int64 bytes;
+    MemoryAttribution::Owner* op;
+  };
+
+  struct Shard {
+    mutex mu;
+    std::unordered_map<const void*, Allocation> allocations GUARDED_BY(mu);
+  };
+
+  bool is_device() const { return !bins_.empty(); }
+
+  Shard* ShardOf(const void* ptr) {
+    const uint64 hash =
+        (reinterpret_cast<uintptr_t>(ptr) >> 4) * 0x9E3779B97F4A7C15ull;
+    return &shards_[hash >> 58];
+  }
+
+  void Charge(void* ptr, size_t num_bytes) {
+    if (!is_device()) {
+      const size_t bytes = wrapped()->AllocatedSizeSlow(ptr);
+      if (bytes > 0) {
+        owner_->Allocated(bytes);
+        return;
+      }
+    }
+    Allocation allocation = {static_cast<int64>(num_bytes), thread_op};
+    {
+      Shard* shard = ShardOf(ptr);
+      mutex_lock l(shard->mu);
+      shard->allocations[ptr] = allocation;
+    }
+    owner_->Allocated(allocation.bytes);
+    if (is_device()) {
+      bins_[Bin(allocation.bytes)]->Allocated(allocation.bytes);
+    }
+    if (allocation.op != nullptr) {
+      allocation.op->Allocated(allocation.bytes);
+    }
+  }
+
+  void Release(void* ptr) {
+    if (!is_device()) {
+      const size_t bytes = wrapped()->AllocatedSizeSlow(ptr);
+      if (bytes > 0) {
+        owner_->Freed(bytes);
+        return;
+      }
+    }
+    Allocation allocation;
+    {
+      Shard* shard = ShardOf(ptr);
+      mutex_lock l(shard->mu);
+      auto it = shard->allocations.find(ptr);
+      // Allocated before the attribution started.
+      if (it == shard->allocations.end()) {
+        return;
+      }
+      allocation = it->second;
+      shard->allocations.erase(it);
+    }
+    owner_->Freed(allocation.bytes);
+    if (is_device()) {
+      bins_[Bin(allocation.bytes)]->Freed(allocation.bytes);
+    }
+    if (allocation.op != nullptr) {
+      allocation.op->Freed(allocation.bytes);
+    }
+  }
+
+  static int Bin(int64 bytes) {
+    return std::min(Log2Ceiling64(std::max<int64>(bytes, 1)), kNumBins - 1);
+  }
+
+  MemoryAttribution::Owner* const owner_;
+  const std::vector<MemoryAttribution::Owner*> bins_;
+  const bool owns_allocator_;
+  Shard shards_[kNumShards];
+};
+
+}  // namespace
+
+void MemoryAttribution::Owner::Allocated(int64 bytes) {
+  num_allocs.fetch_add(1, std::memory_order_relaxed);
+  const int64 in_use =
+      bytes_in_use.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  int64 peak = peak_bytes_in_use.load(std::memory_order_relaxed);
+  while (in_use > peak &&
+         !peak_bytes_in_use.compare_exchange_weak(
+             peak, in_use, std::memory_order_relaxed)) {
+  }
+}
+
+void MemoryAttribution::Owner::Freed(int64 bytes) {
+  bytes_in_use.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+MemoryAttribution::ScopedOp::ScopedOp(MemoryAttribution* attribution,
+                                      const OpKernel* op)
+    : active_(attribution != nullptr), previous_(thread_op) {
+  if (active_) {
+    thread_op = attribution->OpOwner(op);
+  }
+}
+
+MemoryAttribution::ScopedOp::~ScopedOp() {
+  if (active_) {
+    thread_op = previous_;
+  }
+}
+
+MemoryAttribution* MemoryAttribution::Global() {
+  static MemoryAttribution* attribution = []() -> MemoryAttribution* {
+    string dir;
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_MEMORY_ATTRIBUTION_DIR", "", &dir));
+    if (dir.empty()) {
+      return nullptr;
+    }
+    int64 interval_secs = 60;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_MEMORY_ATTRIBUTION_INTERVAL_SECS", 60,
+                                    &interval_secs));
+    return new MemoryAttribution(dir, std::max<int64>(interval_secs, 1));
+  }();
+  return attribution;
+}
+
+MemoryAttribution::MemoryAttribution(const string& dir, int64 interval_secs)
+    : dir_(dir) {
+  Status s = Env::Default()->RecursivelyCreateDir(dir_);
+  if (!s.ok()) {
+    LOG(WARNING) << "Failed to create " << dir_ << ": " << s;
+  }
+  writer_.reset(Env::Default()->StartThread(
+      ThreadOptions(), "memory_attribution", [this, interval_secs]() {
+        while (true) {
+          Env::Default()->SleepForMicroseconds(interval_secs * 1000 * 1000);
+          Status s = Write();
+          if (!s.ok()) {
+            LOG(WARNING) << "Failed to write the memory attribution: " << s;
+          }
+        }
+      }));
+}
+
+MemoryAttribution::~MemoryAttribution() {}
+
+Allocator* MemoryAttribution::Wrap(Allocator* allocator, const string& owner) {
+  MemoryAttribution* attribution = Global();
+  if (attribution == nullptr || allocator == nullptr) {
+    return allocator;
+  }
+  Owner* o = attribution->GetOwner(owner);
+  mutex_lock l(attribution->mu_);
+  Allocator*& wrapper = attribution->wrappers_[std::make_pair(allocator, owner)];
+  if (wrapper == nullptr) {
+    wrapper = new AttributingAllocator(allocator, o, {}, false);
+  }
+  return wrapper;
+}
+
+Allocator* MemoryAttribution::NewDeviceAllocator(Allocator* allocator,
+                                                 bool owns_allocator) {
+  const string owner = strings::StrCat("allocator/", allocator->Name());
+  std::vector<Owner*> bins;
+  for (int i = 0; i < kNumBins; ++i) {
+    bins.push_back(GetOwner(strings::StrCat(
+        owner, "/bin_", strings::HumanReadableNumBytes(1ll << i))));
+  }
+  return new AttributingAllocator(allocator, GetOwner(owner), std::move(bins),
+                                  owns_allocator);
+}
+
+MemoryAttribution::Owner* MemoryAttribution::GetOwner(const string& name) {
+  mutex_lock l(mu_);
+  std::unique_ptr<Owner>& owner = owners_[name];
+  if (owner == nullptr) {
+    owner.reset(new Owner(name));
+  }
+  return owner.get();
+}
+
+MemoryAttribution::Owner* MemoryAttribution::OpOwner(const OpKernel* op) {
+  Owner*& owner = thread_op_owners[op];
+  // The address of a deleted kernel may be reused by another one.
+  if (owner == nullptr ||
+      owner->name.compare(sizeof(kOpPrefix) - 1, string::npos, op->name()) !=
+          0) {
+    owner = GetOwner(strings::StrCat(kOpPrefix, op->name()));
+  }
+  return owner;
+}
+
+std::vector<MemoryAttribution::Row> MemoryAttribution::Rows() const {
+  std::vector<Row> rows;
+  {
+    mutex_lock l(mu_);
+    for (const auto& it : owners_) {
+      const Owner& owner = *it.second;
+      Row row = {owner.name,
+                 owner.bytes_in_use.load(std::memory_order_relaxed),
+                 owner.peak_bytes_in_use.load(std::memory_order_relaxed),
+                 owner.num_allocs.load(std::memory_order_relaxed)};
+      if (row.num_allocs > 0) {
+        rows.push_back(std::move(row));
+      }
+    }
+  }
+  std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+    return a.bytes_in_use > b.bytes_in_use;
+  });
+  return rows;
+}
+
+string MemoryAttribution::Summary() const {
+  return Format(Rows(), -1);
+}
+
+string MemoryAttribution::Format(const std::vector<Row>& rows,
+                                 int max_rows) {
+  string summary = strings::Printf("%-80s %14s %14s %14s\n", "owner",
+                                   "in_use_MB", "peak_MB", "allocs");
+  for (int i = 0; i < rows.size() && (max_rows < 0 || i < max_rows); ++i) {
+    const Row& row = rows[i];
+    strings::Appendf(&summary, "%-80s %14.2f %14.2f %14lld\n",
+                     row.name.c_str(), row.bytes_in_use / 1048576.0,
+                     row.peak_bytes_in_use / 1048576.0,
+                     static_cast<long long>(row.num_allocs));
+  }
+  return summary;
+}
+
+Status MemoryAttribution::Write() {
+  const std::vector<Row> rows = Rows();
+  LOG(INFO) << "Memory attribution, the largest owners:\n"
+            << Format(rows, kLoggedOwners);
+  TF_RETURN_IF_ERROR(WriteStringToFile(
+      Env::Default(), io::JoinPath(dir_, "memory_attribution.txt"),
+      Format(rows, -1)));
+
+  Event event;
+  event.set_wall_time(Env::Default()->NowMicros() / 1e6);
+  for (const Row& row : rows) {
+    auto* value = event.mutable_summary()->add_value();
+    value->set_tag(strings::StrCat("memory/", row.name));
+    value->set_simple_value(row.bytes_in_use);
+  }
+  mutex_lock l(write_mu_);
+  if (events_writer_ == nullptr) {
+    events_writer_.reset(
+        new EventsWriter(io::JoinPath(dir_, "memory_attribution")));
+  }
+  event.set_step(num_snapshots_++);
+  events_writer_->WriteEvent(event);
+  return events_writer_->Flush();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,145 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_MEMORY_ATTRIBUTION_H_
+#define TENSORFLOW_CORE_FRAMEWORK_MEMORY_ATTRIBUTION_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+class EventsWriter;
+class OpKernel;
+
+// Attributes the memory in use to its owners, to tell which of the
+// EmbeddingVariables, the ops or the bins of the allocators hold the memory
+// of a PS or a GPU. The owners are named
+//   ev/<EmbeddingVariable>/<tier>  the rows of an EmbeddingVariable and of
+//                                  its slots in a tier, dram, pmem or hbm,
+//   op/<op name>                   the tensors allocated by an op on a
+//                                  device, e.g. its activations or the slots
+//                                  of a dense optimizer,
+//   allocator/<name>               the memory of a device allocator, e.g.
+//                                  tensorpool_cpu or GPU_0_bfc,
+//   allocator/<name>/bin_<size>    the allocations of the device allocator
+//                                  of at most size bytes, and above half.
+// The memory is charged by wrappers of the allocators, like the
+// TrackingAllocator.
+//
+// Enabled by the environment variable TF_MEMORY_ATTRIBUTION_DIR. Every
+// TF_MEMORY_ATTRIBUTION_INTERVAL_SECS (60 by default), a snapshot of the
+// owners is written to memory_attribution.txt and, as the scalars
+// memory/<owner> of their bytes in use, to an events file of the directory,
+// and the largest owners are logged.
+class MemoryAttribution {
+ public:
+  // The memory charged to an owner, in bytes.
+  struct Owner {
+    explicit Owner(const string& name) : name(name) {}
+
+    void Allocated(int64 bytes);
+    void Freed(int64 bytes);
+
+    const string name;
+    std::atomic<int64> bytes_in_use{0};
+    std::atomic<int64> peak_bytes_in_use{0};
+    std::atomic<int64> num_allocs{0};
+  };
+
+  // Charges the memory allocated by the calling thread through the wrappers
+  // of the device allocators to the op while in scope.
+  class ScopedOp {
+   public:
+    // No-op if attribution is null.
+    ScopedOp(MemoryAttribution* attribution, const OpKernel* op);
+    ~ScopedOp();
+
+   private:
+    bool active_;
+    Owner* previous_;
+  };
+
+  ~MemoryAttribution();
+
+  // Returns null unless enabled.
+  static MemoryAttribution* Global();
+
+  // Returns the wrapper of allocator charging its memory to owner, which is
+  // shared by the calls with the same allocator and owner and never
+  // deleted. Returns allocator itself if the attribution is disabled.
+  static Allocator* Wrap(Allocator* allocator, const string& owner);
+
+  // Returns a wrapper of the device allocator charging its memory to
+  // allocator/<its name>, to its bins and to the ops allocating it. The
+  // caller owns the wrapper, which deletes allocator if owns_allocator.
+  Allocator* NewDeviceAllocator(Allocator* allocator, bool owns_allocator);
+
+  // Returns the owner of the name, created on its first call and never
+  // deleted.
+  Owner* GetOwner(const string& name);
+
+  // Returns the owners by decreasing bytes in use.
+  string Summary() const;
+
+  // Writes a snapshot of the owners to the directory.
+  Status Write();
+
+ private:
+  // A snapshot of an owner.
+  struct Row {
+    string name;
+    int64 bytes_in_use;
+    int64 peak_bytes_in_use;
+    int64 num_allocs;
+  };
+
+  MemoryAttribution(const string& dir, int64 interval_secs);
+
+  // The owners which allocated, by decreasing bytes in use.
+  std::vector<Row> Rows() const;
+  // Formats the first max_rows rows, all of them if max_rows < 0.
+  static string Format(const std::vector<Row>& rows, int max_rows);
+
+  // The owner of the op, cached per thread.
+  Owner* OpOwner(const OpKernel* op);
+
+  const string dir_;
+  std::unique_ptr<Thread> writer_;
+
+  mutable mutex mu_;
+  std::map<string, std::unique_ptr<Owner>> owners_ GUARDED_BY(mu_);
+  std::map<std::pair<Allocator*, string>, Allocator*> wrappers_
+      GUARDED_BY(mu_);
+
+  mutex write_mu_;
+  std::unique_ptr<EventsWriter> events_writer_ GUARDED_BY(write_mu_);
+  int64 num_snapshots_ GUARDED_BY(write_mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(MemoryAttribution);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_MEMORY_ATTRIBUTION_H_
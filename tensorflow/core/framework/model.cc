@@ -807,6 +807,15 @@ std::map<string, std::shared_ptr<Parameter>> Model::CollectEssentialParallelism(
   return essential_parameters;
 }
 
+int64 Model::TotalProcessingTimeNanos() {
+  tf_shared_lock l(mu_);
+  int64 total = 0;
+  for (const auto& pair : lookup_table_) {
+    total += pair.second->processing_time();
+  }
+  return total;
+}
+
 void Model::OptimizeGradientDescent(int64 cpu_budget, int64 ram_budget) {
   std::shared_ptr<Node> snapshot;
   {
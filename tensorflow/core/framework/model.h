@@ -605,6 +605,10 @@ class Model {
   // Removes the given node.
   void RemoveNode(const string& name) LOCKS_EXCLUDED(mu_);
 
+  // Returns the time the nodes of the model have spent processing elements,
+  // summed over all nodes and threads, in nanoseconds.
+  int64 TotalProcessingTimeNanos() LOCKS_EXCLUDED(mu_);
+
  private:
   // Collects tunable parameters in the tree rooted in the given node, returning
   // a mapping from a (unique) node name to a tunable parameter.
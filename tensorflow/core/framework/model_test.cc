@@ -727,6 +727,21 @@ TEST(UnknownGradientTest, Model) {
               (new_output_time - output_time) / kParameterStep,
               kComparisonPrecision);
 }
+
+TEST(TotalProcessingTimeNanosTest, Model) {
+  Model model([](std::shared_ptr<Node>) {});
+  model.AddNode(
+      [](Node::Args args) { return model::MakeKnownRatioNode(args, 1); },
+      "root", "");
+  model.AddNode([](Node::Args args) { return model::MakeSourceNode(args); },
+                "source", "root");
+  EXPECT_EQ(model.TotalProcessingTimeNanos(), 0);
+  model.AddProcessingTime("root", 100);
+  model.AddProcessingTime("source", 300);
+  EXPECT_EQ(model.TotalProcessingTimeNanos(), 400);
+  model.RemoveNode("source");
+  EXPECT_EQ(model.TotalProcessingTimeNanos(), 100);
+}
 }  // namespace
 }  // namespace model
 }  // namespace data
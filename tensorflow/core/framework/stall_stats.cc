@@ -0,0 +1,56 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/stall_stats.h"
+
+namespace tensorflow {
+
+StallCounters::Values StallCounters::values() const {
+  Values values;
+  values.producer_wait_nanos =
+      producer_wait_nanos_.load(std::memory_order_relaxed);
+  values.num_producer_waits =
+      num_producer_waits_.load(std::memory_order_relaxed);
+  values.consumer_wait_nanos =
+      consumer_wait_nanos_.load(std::memory_order_relaxed);
+  values.num_consumer_waits =
+      num_consumer_waits_.load(std::memory_order_relaxed);
+  return values;
+}
+
+StallStats* StallStats::Global() {
+  static StallStats* stats = new StallStats();
+  return stats;
+}
+
+StallCounters* StallStats::Get(const string& stage) {
+  mutex_lock l(mu_);
+  std::unique_ptr<StallCounters>& counters = counters_[stage];
+  if (!counters) {
+    counters.reset(new StallCounters());
+  }
+  return counters.get();
+}
+
+std::map<string, StallCounters::Values> StallStats::Snapshot() {
+  std::map<string, StallCounters::Values> snapshot;
+  mutex_lock l(mu_);
+  for (const auto& pair : counters_) {
+    snapshot.emplace(pair.first, pair.second->values());
+  }
+  return snapshot;
+}
+
+}  // namespace tensorflow
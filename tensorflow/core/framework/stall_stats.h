@@ -0,0 +1,96 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_STALL_STATS_H_
+#define TENSORFLOW_CORE_FRAMEWORK_STALL_STATS_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// The time the producers and the consumers of one input pipeline stage, e.g.
+// a TensorBuffer or a prefetch dataset, spent blocked on each other. A stage
+// whose consumers wait is slower than the ones downstream of it, a stage
+// whose producers wait is faster than the ones downstream of it.
+class StallCounters {
+ public:
+  struct Values {
+    int64 producer_wait_nanos = 0;
+    int64 num_producer_waits = 0;
+    int64 consumer_wait_nanos = 0;
+    int64 num_consumer_waits = 0;
+  };
+
+  StallCounters() {}
+
+  void RecordProducerWait(int64 nanos) {
+    producer_wait_nanos_.fetch_add(nanos, std::memory_order_relaxed);
+    num_producer_waits_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void RecordConsumerWait(int64 nanos) {
+    consumer_wait_nanos_.fetch_add(nanos, std::memory_order_relaxed);
+    num_consumer_waits_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  Values values() const;
+
+ private:
+  std::atomic<int64> producer_wait_nanos_{0};
+  std::atomic<int64> num_producer_waits_{0};
+  std::atomic<int64> consumer_wait_nanos_{0};
+  std::atomic<int64> num_consumer_waits_{0};
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StallCounters);
+};
+
+// The time a call of a stage was blocked, from `start_nanos`. Both are zero
+// when it did not block.
+struct StallTime {
+  int64 start_nanos = 0;
+  int64 wait_nanos = 0;
+};
+
+// The stall counters of the input pipeline stages of the process, by stage
+// name. The counters of a stage are never removed, so that the stages keep
+// theirs across sessions and recreated resources.
+class StallStats {
+ public:
+  static StallStats* Global();
+
+  StallStats() {}
+
+  // Returns the counters of `stage`, created on the first call.
+  StallCounters* Get(const string& stage);
+
+  // Returns the current values of the counters of all stages.
+  std::map<string, StallCounters::Values> Snapshot();
+
+ private:
+  mutex mu_;
+  std::map<string, std::unique_ptr<StallCounters>> counters_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StallStats);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_STALL_STATS_H_
@@ -13,14 +13,19 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
+#include <unordered_set>
+
 #include "tensorflow/core/common_runtime/graph_optimizer.h"
 
 #include "tensorflow/core/common_runtime/constant_folding.h"
 #include "tensorflow/core/common_runtime/function.h"
 #include "tensorflow/core/common_runtime/optimization_registry.h"
+#include "tensorflow/core/framework/attr_value_util.h"
 #include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/graph/optimizer_cse.h"
+#include "tensorflow/core/util/device_name_utils.h"
 #include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
@@ -31,6 +36,62 @@ void VLogGraphDebugString(Graph* g) {
   VLOG(1) << "Grpah: " << graph_def.DebugString();
 }
 
+bool IsOnGPU(const Node* node) {
+  DeviceNameUtils::ParsedName parsed;
+  return DeviceNameUtils::ParseFullName(node->requested_device(), &parsed) &&
+         parsed.has_type && parsed.type == DEVICE_GPU;
+}
+
+// Adds a node of `op`, whose inputs are the ones of the op of `node`,
+// with the inputs, the control inputs, the attrs and the device of `node`,
+// and the additional attrs `attrs`.
+Status CopyNodeAs(Node* node, const string& name, const string& op,
+                  const std::vector<std::pair<string, AttrValue>>& attrs,
+                  Graph* g, Node** copy) {
+  std::vector<const Edge*> in_edges(node->num_inputs());
+  std::vector<Node*> control_inputs;
+  for (const Edge* e : node->in_edges()) {
+    if (e->IsControlEdge()) {
+      control_inputs.push_back(e->src());
+    } else {
+      in_edges[e->dst_input()] = e;
+    }
+  }
+  NodeBuilder node_builder(name, op);
+  const OpDef& op_def = node->op_def();
+  int input_index = 0;
+  for (int i = 0; i < op_def.input_arg_size(); ++i) {
+    const OpDef::ArgDef& arg = op_def.input_arg(i);
+    if (!arg.type_list_attr().empty()) {
+      return errors::Unimplemented("type list inputs of ", node->name());
+    }
+    if (arg.number_attr().empty()) {
+      const Edge* e = in_edges[input_index++];
+      node_builder.Input(e->src(), e->src_output());
+    } else {
+      int num;
+      TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(), arg.number_attr(), &num));
+      std::vector<NodeBuilder::NodeOut> inputs;
+      for (int j = 0; j < num; ++j) {
+        const Edge* e = in_edges[input_index++];
+        inputs.emplace_back(e->src(), e->src_output());
+      }
+      node_builder.Input(inputs);
+    }
+  }
+  node_builder.ControlInputs(control_inputs);
+  for (const auto& node_attr : node->attrs()) {
+    node_builder.Attr(node_attr.first, node_attr.second);
+  }
+  for (const auto& attr : attrs) {
+    node_builder.Attr(attr.first, attr.second);
+  }
+  node_builder.Device(node->requested_device());
+  TF_RETURN_IF_ERROR(node_builder.Finalize(g, copy));
+  (*copy)->set_assigned_device_name_index(node->assigned_device_name_index());
+  return Status::OK();
+}
+
 // Embedding ForwardBackward Joint Optimization, should before smart-stage
 class EmbeddingForwardBackwardJointOptimizationPass : public GraphOptimizationPass {
  public:
@@ -108,6 +169,32 @@ class EmbeddingForwardBackwardJointOptimizationPass : public GraphOptimizationPa
         }
       }
     }
+
+    std::vector<Node*> group_lookup_nodes;
+    for (Node* node : g->op_nodes()) {
+      if (node->type_string() == "GroupEmbeddingVarLookup") {
+        group_lookup_nodes.push_back(node);
+      }
+    }
+    for (Node* node : group_lookup_nodes) {
+      Status s = RewriteGroupEmbeddingLookup(node, g);
+      if (!s.ok()) {
+        VLOG(1) << "skip rewriting " << node->name() << ": " << s.ToString();
+      }
+    }
+
+    std::vector<Node*> group_gather_nodes;
+    for (Node* node : g->op_nodes()) {
+      if (node->type_string() == "KvResourceGroupGather") {
+        group_gather_nodes.push_back(node);
+      }
+    }
+    for (Node* node : group_gather_nodes) {
+      Status s = RewriteGroupGather(node, g);
+      if (!s.ok()) {
+        VLOG(1) << "skip rewriting " << node->name() << ": " << s.ToString();
+      }
+    }
     return Status::OK();
   }
 
@@ -213,10 +300,568 @@ class EmbeddingForwardBackwardJointOptimizationPass : public GraphOptimizationPa
     g->RemoveNode(node);
     return Status::OK();
   }
+
+ private:
+  struct GroupApply {
+    Node* apply_node;
+    const Edge* indices_edge;
+    // The UnsortedSegmentSum input of the apply op which only sums the
+    // gradients of keys that are unique already, nullptr if absent.
+    const Edge* segment_sum_edge;
+  };
+
+  static int InputIndex(const Node* node, const string& arg_name) {
+    const OpDef& op_def = node->op_def();
+    for (int i = 0; i < op_def.input_arg_size(); ++i) {
+      if (op_def.input_arg(i).name() == arg_name) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  // Finds the KvSparseApply op which consumes the keys of `keys_edge`,
+  // either directly or deduplicated by a Unique op first.
+  Status FindGroupApplyNode(const Edge* keys_edge, GroupApply* apply) {
+    Node* dst = keys_edge->dst();
+    if (dst->IsKvSparseApply() &&
+        keys_edge->dst_input() == InputIndex(dst, "indices")) {
+      apply->apply_node = dst;
+      apply->indices_edge = keys_edge;
+      apply->segment_sum_edge = nullptr;
+      return Status::OK();
+    }
+    if (!dst->IsUnique()) {
+      return errors::NotFound("not found apply node");
+    }
+    Node* unique = dst;
+    const Edge* indices_edge = nullptr;
+    for (const Edge* e : unique->out_edges()) {
+      if (e->src_output() == 0 && e->dst()->IsKvSparseApply() &&
+          e->dst_input() == InputIndex(e->dst(), "indices")) {
+        if (indices_edge != nullptr) {
+          return errors::Unknown("more than one apply node");
+        }
+        indices_edge = e;
+      }
+    }
+    if (indices_edge == nullptr) {
+      return errors::NotFound("not found apply node");
+    }
+    apply->apply_node = indices_edge->dst();
+    apply->indices_edge = indices_edge;
+    apply->segment_sum_edge = nullptr;
+    const Edge* grad_edge = nullptr;
+    TF_RETURN_IF_ERROR(apply->apply_node->input_edge(
+        InputIndex(apply->apply_node, "grad"), &grad_edge));
+    Node* segment_sum = grad_edge->src();
+    const Edge* segment_ids_edge = nullptr;
+    if (segment_sum->type_string() == "UnsortedSegmentSum" &&
+        segment_sum->input_edge(1, &segment_ids_edge).ok() &&
+        segment_ids_edge->src() == unique &&
+        segment_ids_edge->src_output() == 1) {
+      apply->segment_sum_edge = grad_edge;
+    }
+    return Status::OK();
+  }
+
+  // Rewrites GroupEmbeddingVarLookup into _OPT_GroupEmbeddingVarLookup,
+  // whose pointer outputs are fed to the _OPT_ variants of the apply ops.
+  // The unique keys of the lookup are unique already, so the Unique and
+  // UnsortedSegmentSum which deduplicate the gradients are identities and
+  // bypassed, and left to dead node removal.
+  Status RewriteGroupEmbeddingLookup(Node* node, Graph* g) {
+    int num_lookups;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(), "num_lookups",
+                                   &num_lookups));
+    DataType tkeys;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(), "Tkeys", &tkeys));
+    bool is_use_default_value_tensor;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(),
+        "is_use_default_value_tensor", &is_use_default_value_tensor));
+    bool is_inference;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(), "is_inference",
+                                   &is_inference));
+    if (tkeys != DT_INT64 || is_use_default_value_tensor || is_inference) {
+      return errors::Unimplemented("unsupported attrs");
+    }
+    if (IsOnGPU(node)) {
+      return errors::Unimplemented("only CPU is supported");
+    }
+
+    for (int i = 0; i < num_lookups; ++i) {
+      const Edge* e = nullptr;
+      TF_RETURN_IF_ERROR(node->input_edge(i, &e));
+      if (IsOnGPU(e->src())) {
+        return errors::Unimplemented("only CPU is supported");
+      }
+    }
+
+    // Every EV of the lookup must be updated by an apply op, otherwise
+    // creating its keys in the forward pass changes the semantic.
+    std::vector<GroupApply> applies(num_lookups);
+    for (int i = 0; i < num_lookups; ++i) {
+      const Edge* keys_edge = nullptr;
+      for (const Edge* e : node->out_edges()) {
+        if (e->src_output() == num_lookups + i) {
+          if (keys_edge != nullptr) {
+            return errors::Unknown("unique_keys has more than one consumer");
+          }
+          keys_edge = e;
+        }
+      }
+      if (keys_edge == nullptr) {
+        return errors::NotFound("unique_keys is not consumed");
+      }
+      TF_RETURN_IF_ERROR(FindGroupApplyNode(keys_edge, &applies[i]));
+      Node* apply_node = applies[i].apply_node;
+      const OpRegistrationData* op_reg_data = nullptr;
+      TF_RETURN_IF_ERROR(OpRegistry::Global()->LookUp(
+          "_OPT_" + apply_node->type_string(), &op_reg_data));
+      if (IsOnGPU(apply_node)) {
+        return errors::Unimplemented("only CPU is supported");
+      }
+    }
+
+    Node* opt_node = nullptr;
+    TF_RETURN_IF_ERROR(CopyNodeAs(node, node->name() + "/fb_opt",
+                                  "_OPT_GroupEmbeddingVarLookup", {}, g,
+                                  &opt_node));
+
+    for (int i = 0; i < num_lookups; ++i) {
+      GroupApply& apply = applies[i];
+      Node* apply_node = apply.apply_node;
+      int indices_input = apply.indices_edge->dst_input();
+      g->RemoveEdge(apply.indices_edge);
+      g->AddEdge(opt_node, num_lookups * 4 + i, apply_node, indices_input);
+      if (apply.segment_sum_edge != nullptr) {
+        const Edge* data_edge = nullptr;
+        TF_RETURN_IF_ERROR(
+            apply.segment_sum_edge->src()->input_edge(0, &data_edge));
+        int grad_input = apply.segment_sum_edge->dst_input();
+        g->RemoveEdge(apply.segment_sum_edge);
+        g->AddEdge(data_edge->src(), data_edge->src_output(),
+                   apply_node, grad_input);
+      }
+    }
+
+    std::vector<const Edge*> out_edges(node->out_edges().begin(),
+                                       node->out_edges().end());
+    for (const Edge* e : out_edges) {
+      if (e->IsControlEdge()) {
+        g->AddControlEdge(opt_node, e->dst());
+      } else {
+        g->AddEdge(opt_node, e->src_output(), e->dst(), e->dst_input());
+      }
+    }
+    g->RemoveNode(node);
+
+    for (GroupApply& apply : applies) {
+      TF_RETURN_IF_ERROR(ModifyApplyNode(apply.apply_node, g));
+    }
+    VLogGraphDebugString(g);
+    return Status::OK();
+  }
+
+  // Finds the apply ops reached from the keys of `keys_edge`, directly or
+  // through Reshape and Unique ops, which must all update the tables whose
+  // handles are `handles`.
+  Status FindTableApplyNodes(const Edge* keys_edge,
+                             const std::unordered_set<const Node*>& handles,
+                             std::vector<Node*>* apply_nodes) {
+    Node* dst = keys_edge->dst();
+    if (dst->IsKvSparseApply()) {
+      const Edge* var_edge = nullptr;
+      if (keys_edge->dst_input() != InputIndex(dst, "indices") ||
+          !dst->input_edge(0, &var_edge).ok() ||
+          handles.count(var_edge->src()) == 0) {
+        return errors::NotFound("not an apply op of the tables");
+      }
+      apply_nodes->push_back(dst);
+      return Status::OK();
+    }
+    if ((dst->type_string() != "Reshape" && !dst->IsUnique()) ||
+        keys_edge->dst_input() != 0) {
+      return errors::NotFound("keys consumed by ", dst->name());
+    }
+    bool found = false;
+    for (const Edge* e : dst->out_edges()) {
+      // The segment ids of Unique are the same for the pointers.
+      if (e->IsControlEdge() || e->src_output() != 0 ||
+          e->dst()->IsMetadata()) {
+        continue;
+      }
+      TF_RETURN_IF_ERROR(FindTableApplyNodes(e, handles, apply_nodes));
+      found = true;
+    }
+    if (!found) {
+      return errors::NotFound("not found apply node");
+    }
+    return Status::OK();
+  }
+
+  // Feeds the pointers output of KvResourceGroupGather, instead of its keys,
+  // to the _OPT_ variants of the apply ops of its tables, so that they do
+  // not probe the storage again. The keys map one to one to the pointers, so
+  // the Unique ops between them deduplicate the pointers the same way.
+  Status RewriteGroupGather(Node* node, Graph* g) {
+    int num_tables;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(), "num_tables",
+                                   &num_tables));
+    DataType tkeys;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(), "Tkeys", &tkeys));
+    if (tkeys != DT_INT64) {
+      return errors::Unimplemented("unsupported attrs");
+    }
+    if (IsOnGPU(node)) {
+      return errors::Unimplemented("only CPU is supported");
+    }
+    std::unordered_set<const Node*> handles;
+    for (int i = 0; i < num_tables; ++i) {
+      const Edge* e = nullptr;
+      TF_RETURN_IF_ERROR(node->input_edge(i, &e));
+      handles.insert(e->src());
+    }
+    const Edge* indices_edge = nullptr;
+    TF_RETURN_IF_ERROR(node->input_edge(num_tables, &indices_edge));
+
+    std::vector<const Edge*> keys_edges;
+    std::vector<Node*> apply_nodes;
+    for (const Edge* e : indices_edge->src()->out_edges()) {
+      if (e->IsControlEdge() || e == indices_edge ||
+          e->src_output() != indices_edge->src_output()) {
+        continue;
+      }
+      std::vector<Node*> edge_apply_nodes;
+      if (!FindTableApplyNodes(e, handles, &edge_apply_nodes).ok()) {
+        continue;
+      }
+      for (Node* apply_node : edge_apply_nodes) {
+        const OpRegistrationData* op_reg_data = nullptr;
+        TF_RETURN_IF_ERROR(OpRegistry::Global()->LookUp(
+            "_OPT_" + apply_node->type_string(), &op_reg_data));
+        if (IsOnGPU(apply_node)) {
+          return errors::Unimplemented("only CPU is supported");
+        }
+      }
+      keys_edges.push_back(e);
+      apply_nodes.insert(apply_nodes.end(), edge_apply_nodes.begin(),
+                         edge_apply_nodes.end());
+    }
+    if (keys_edges.empty()) {
+      return errors::NotFound("not found apply node");
+    }
+
+    for (const Edge* e : keys_edges) {
+      Node* dst = e->dst();
+      int dst_input = e->dst_input();
+      g->RemoveEdge(e);
+      g->AddEdge(node, num_tables, dst, dst_input);
+    }
+    std::unordered_set<Node*> modified;
+    for (Node* apply_node : apply_nodes) {
+      if (modified.insert(apply_node).second) {
+        TF_RETURN_IF_ERROR(ModifyApplyNode(apply_node, g));
+      }
+    }
+    VLogGraphDebugString(g);
+    return Status::OK();
+  }
 };
 
 REGISTER_OPTIMIZATION(OptimizationPassRegistry::PRE_PLACEMENT, 23,
                       EmbeddingForwardBackwardJointOptimizationPass);
 
+// Fuses a GroupEmbeddingVarLookup whose outputs are all concatenated along
+// the columns by a ConcatV2, e.g. into the input of the DNN, into a
+// _GroupEmbeddingVarLookupConcat whose combiners write the rows of every
+// lookup to its columns of the concat, which saves copying them. The Shape
+// and ShapeN ops of the outputs, e.g. of the gradient of the concat, take
+// the output_shapes of the fused op instead.
+//
+// The gradient of the concat is sliced for the lookups by Slice ops, or by
+// a SplitV, which the GroupEmbeddingVariableLookupGrad of the lookup is
+// rewritten not to need: as _GroupEmbeddingVariableLookupConcatGrad it
+// reads the gradient of every lookup from its columns of the gradient of
+// the concat. Otherwise the slices are left as they are, which is correct
+// as well.
+//
+// Enabled by TF_GROUP_EMBEDDING_CONCAT_FUSION, on CPU. It runs after the
+// pass above, whose _OPT_GroupEmbeddingVarLookup it does not fuse.
+class GroupEmbeddingConcatFusionPass : public GraphOptimizationPass {
+ public:
+  Status Run(const GraphOptimizationPassOptions& options) override {
+    bool enabled = false;
+    TF_RETURN_IF_ERROR(ReadBoolFromEnvVar("TF_GROUP_EMBEDDING_CONCAT_FUSION",
+                                          /*default_val=*/false, &enabled));
+    if (!enabled || options.graph == nullptr) {
+      return Status::OK();
+    }
+    Graph* g = options.graph->get();
+    if (g == nullptr) {
+      return Status::OK();
+    }
+    std::vector<Node*> lookup_nodes;
+    for (Node* node : g->op_nodes()) {
+      if (node->type_string() == "GroupEmbeddingVarLookup") {
+        lookup_nodes.push_back(node);
+      }
+    }
+    for (Node* node : lookup_nodes) {
+      Status s = FuseConcat(node, g);
+      if (!s.ok()) {
+        VLOG(1) << "skip fusing the concat of " << node->name() << ": "
+                << s.ToString();
+      }
+    }
+    return Status::OK();
+  }
+
+ private:
+  Status FuseConcat(Node* node, Graph* g) {
+    int num_lookups;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(), "num_lookups",
+                                   &num_lookups));
+    bool is_sequence;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node->attrs(), "is_sequence",
+                                   &is_sequence));
+    if (is_sequence) {
+      return errors::Unimplemented("sequence outputs are not concatenated");
+    }
+    if (IsOnGPU(node)) {
+      return errors::Unimplemented("only CPU is supported");
+    }
+
+    // The position of every output in the concat, and the Shape and ShapeN
+    // ops of the outputs.
+    Node* concat = nullptr;
+    std::vector<int> positions(num_lookups, -1);
+    std::unordered_set<Node*> shape_nodes;
+    Node* grad_node = nullptr;
+    for (const Edge* e : node->out_edges()) {
+      if (e->IsControlEdge()) {
+        continue;
+      }
+      Node* dst = e->dst();
+      if (e->src_output() >= num_lookups) {
+        if (e->src_output() == num_lookups &&
+            dst->type_string() == "GroupEmbeddingVariableLookupGrad" &&
+            e->dst_input() == 2 * num_lookups) {
+          grad_node = dst;
+        }
+        continue;
+      }
+      if (dst->type_string() == "ConcatV2") {
+        if (concat != nullptr && concat != dst) {
+          return errors::Unimplemented("more than one concat of the outputs");
+        }
+        concat = dst;
+        positions[e->src_output()] = e->dst_input();
+      } else if (dst->type_string() == "Shape" ||
+                 dst->type_string() == "ShapeN") {
+        DataType out_type;
+        TF_RETURN_IF_ERROR(GetNodeAttr(dst->attrs(), "out_type", &out_type));
+        if (out_type != DT_INT32) {
+          return errors::Unimplemented("int64 shapes of the outputs");
+        }
+        shape_nodes.insert(dst);
+      } else {
+        return errors::Unimplemented("an output is consumed by ",
+                                     dst->name());
+      }
+    }
+    if (concat == nullptr) {
+      return errors::NotFound("no concat of the outputs");
+    }
+    int num_concat;
+    TF_RETURN_IF_ERROR(GetNodeAttr(concat->attrs(), "N", &num_concat));
+    if (num_concat != num_lookups ||
+        std::count(positions.begin(), positions.end(), -1) > 0) {
+      return errors::Unimplemented("the concat is not of the outputs only");
+    }
+    int64 axis;
+    TF_RETURN_IF_ERROR(ConstantScalar(concat, num_lookups, &axis));
+    if (axis != 1 && axis != -1) {
+      return errors::Unimplemented("the concat is not along the columns");
+    }
+    for (Node* shape_node : shape_nodes) {
+      for (const Edge* e : shape_node->in_edges()) {
+        if (!e->IsControlEdge() &&
+            (e->src() != node || e->src_output() >= num_lookups)) {
+          return errors::Unimplemented(shape_node->name(),
+                                       " is not of the outputs only");
+        }
+      }
+    }
+
+    Node* fused_node = nullptr;
+    AttrValue positions_attr;
+    SetAttrValue(positions, &positions_attr);
+    TF_RETURN_IF_ERROR(CopyNodeAs(node, node->name() + "/concat_fusion",
+                                  "_GroupEmbeddingVarLookupConcat",
+                                  {{"concat_positions", positions_attr}}, g,
+                                  &fused_node));
+    const int output_shapes_base = 1 + 3 * num_lookups;
+    for (Node* shape_node : shape_nodes) {
+      std::vector<int> lookups(shape_node->num_inputs());
+      for (const Edge* e : shape_node->in_edges()) {
+        if (!e->IsControlEdge()) {
+          lookups[e->dst_input()] = e->src_output();
+        }
+      }
+      RedirectOutputs(shape_node, g, [&](int output) {
+        return std::make_pair(fused_node, output_shapes_base + lookups[output]);
+      });
+      g->RemoveNode(shape_node);
+    }
+    for (const Edge* e : concat->in_edges()) {
+      if (e->IsControlEdge()) {
+        g->AddControlEdge(e->src(), fused_node);
+      }
+    }
+    RedirectOutputs(concat, g, [&](int output) {
+      return std::make_pair(fused_node, 0);
+    });
+    g->RemoveNode(concat);
+    RedirectOutputs(node, g, [&](int output) {
+      return std::make_pair(fused_node, output - num_lookups + 1);
+    });
+    g->RemoveNode(node);
+
+    if (grad_node != nullptr) {
+      Status s = FuseConcatGrad(grad_node, positions, g);
+      if (!s.ok()) {
+        VLOG(1) << "skip fusing the concat gradient of " << grad_node->name()
+                << ": " << s.ToString();
+      }
+    }
+    VLogGraphDebugString(g);
+    return Status::OK();
+  }
+
+  // Rewrites the GroupEmbeddingVariableLookupGrad of the gradients of the
+  // outputs at `positions` of a concat, sliced from the gradient of the
+  // concat, into a _GroupEmbeddingVariableLookupConcatGrad of it.
+  Status FuseConcatGrad(Node* grad_node, const std::vector<int>& positions,
+                        Graph* g) {
+    const int num_lookups = positions.size();
+    const Edge* concat_grad_edge = nullptr;
+    for (int i = 0; i < num_lookups; ++i) {
+      const Edge* e = nullptr;
+      TF_RETURN_IF_ERROR(grad_node->input_edge(i, &e));
+      Node* slice = e->src();
+      const Edge* offset_edge = nullptr;
+      if (slice->type_string() == "Slice") {
+        // The offset of the slice is an output of the ConcatOffset of the
+        // gradient of the concat.
+        TF_RETURN_IF_ERROR(slice->input_edge(1, &offset_edge));
+        if (offset_edge->src()->type_string() != "ConcatOffset" ||
+            offset_edge->src_output() != positions[i]) {
+          return errors::Unimplemented(slice->name(),
+                                       " is not the slice of lookup ", i);
+        }
+      } else if (slice->type_string() == "SplitV") {
+        if (e->src_output() != positions[i]) {
+          return errors::Unimplemented(slice->name(),
+                                       " is not the split of lookup ", i);
+        }
+      } else {
+        return errors::Unimplemented("the gradient of lookup ", i,
+                                     " is not sliced");
+      }
+      const Edge* data_edge = nullptr;
+      TF_RETURN_IF_ERROR(slice->input_edge(0, &data_edge));
+      if (concat_grad_edge != nullptr &&
+          (data_edge->src() != concat_grad_edge->src() ||
+           data_edge->src_output() != concat_grad_edge->src_output())) {
+        return errors::Unimplemented("the gradients are not of one concat");
+      }
+      concat_grad_edge = data_edge;
+    }
+
+    NodeBuilder node_builder(grad_node->name() + "/concat_fusion",
+                             "_GroupEmbeddingVariableLookupConcatGrad");
+    node_builder.Input(concat_grad_edge->src(),
+                       concat_grad_edge->src_output());
+    std::vector<const Edge*> in_edges(grad_node->num_inputs());
+    for (const Edge* e : grad_node->in_edges()) {
+      if (e->IsControlEdge()) {
+        node_builder.ControlInput(e->src());
+      } else {
+        in_edges[e->dst_input()] = e;
+      }
+    }
+    // The resources, unique_keys, sp_indices and batch_nums.
+    for (int arg = 1; arg < 5; ++arg) {
+      std::vector<NodeBuilder::NodeOut> inputs;
+      for (int i = 0; i < num_lookups; ++i) {
+        const Edge* e = in_edges[arg * num_lookups + i];
+        inputs.emplace_back(e->src(), e->src_output());
+      }
+      node_builder.Input(inputs);
+    }
+    for (const auto& node_attr : grad_node->attrs()) {
+      node_builder.Attr(node_attr.first, node_attr.second);
+    }
+    node_builder.Attr("concat_positions", positions);
+    node_builder.Device(grad_node->requested_device());
+    Node* fused_node = nullptr;
+    TF_RETURN_IF_ERROR(node_builder.Finalize(g, &fused_node));
+    fused_node->set_assigned_device_name_index(
+        grad_node->assigned_device_name_index());
+    RedirectOutputs(grad_node, g, [&](int output) {
+      return std::make_pair(fused_node, output);
+    });
+    g->RemoveNode(grad_node);
+    return Status::OK();
+  }
+
+  // Moves the out edges of `node` to the outputs given by `output_of`, and
+  // its out control edges to the node of output 0.
+  template <typename OutputOf>
+  static void RedirectOutputs(Node* node, Graph* g, OutputOf output_of) {
+    std::vector<const Edge*> out_edges(node->out_edges().begin(),
+                                       node->out_edges().end());
+    for (const Edge* e : out_edges) {
+      if (e->IsControlEdge()) {
+        g->AddControlEdge(output_of(0).first, e->dst());
+      } else {
+        std::pair<Node*, int> output = output_of(e->src_output());
+        g->AddEdge(output.first, output.second, e->dst(), e->dst_input());
+      }
+      g->RemoveEdge(e);
+    }
+  }
+
+  // Reads the scalar Const of input `index` of `node`.
+  static Status ConstantScalar(const Node* node, int index, int64* value) {
+    const Edge* e = nullptr;
+    TF_RETURN_IF_ERROR(node->input_edge(index, &e));
+    if (!e->src()->IsConstant()) {
+      return errors::Unimplemented("input ", index, " of ", node->name(),
+                                   " is not a Const");
+    }
+    const TensorProto* proto = nullptr;
+    TF_RETURN_IF_ERROR(GetNodeAttr(e->src()->attrs(), "value", &proto));
+    Tensor tensor;
+    if (!tensor.FromProto(*proto) || tensor.NumElements() != 1) {
+      return errors::InvalidArgument("input ", index, " of ", node->name(),
+                                     " is not a scalar");
+    }
+    if (tensor.dtype() == DT_INT32) {
+      *value = tensor.flat<int32>()(0);
+    } else if (tensor.dtype() == DT_INT64) {
+      *value = tensor.flat<int64>()(0);
+    } else {
+      return errors::InvalidArgument("input ", index, " of ", node->name(),
+                                     " is not an integer");
+    }
+    return Status::OK();
+  }
+};
+
+REGISTER_OPTIMIZATION(OptimizationPassRegistry::PRE_PLACEMENT, 23,
+                      GroupEmbeddingConcatFusionPass);
+
 }  // namespace
 }  // namespace tensorflow
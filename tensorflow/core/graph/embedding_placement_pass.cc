@@ -0,0 +1,274 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/graph/embedding_placement_pass.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/optimization_registry.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/util/device_name_utils.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace {
+
+struct PartitionProfile {
+  double num_keys = 0;
+  double lookups = 0;
+};
+
+// An EmbeddingVariable partition, its slots and the ops colocated with them,
+// which have to be placed together.
+struct PartitionGroup {
+  Node* primary = nullptr;
+  std::vector<Node*> members;
+  DeviceNameUtils::ParsedName device;
+  int num_slots = 0;
+  double memory = 0;
+  double traffic = 0;
+  double cost = 0;
+};
+
+Status ReadProfile(const string& path,
+                   std::map<string, PartitionProfile>* profile) {
+  string content;
+  TF_RETURN_IF_ERROR(ReadFileToString(Env::Default(), path, &content));
+  for (const string& line : str_util::Split(content, '\n')) {
+    std::vector<string> fields =
+        str_util::Split(line, ' ', str_util::SkipEmpty());
+    if (fields.empty() || fields[0][0] == '#') {
+      continue;
+    }
+    PartitionProfile p;
+    if (fields.size() != 3 || !strings::safe_strtod(fields[1], &p.num_keys) ||
+        !strings::safe_strtod(fields[2], &p.lookups)) {
+      return errors::InvalidArgument("Invalid line in placement profile ",
+                                     path, ": ", line);
+    }
+    (*profile)[fields[0]] = p;
+  }
+  return Status::OK();
+}
+
+// Returns the name of the node `node` is colocated with, or its own name.
+string ColocationRoot(const Node* node) {
+  std::vector<string> classes;
+  if (GetNodeAttr(node->attrs(), kColocationAttrName, &classes).ok()) {
+    for (const string& c : classes) {
+      StringPiece name(c);
+      if (str_util::ConsumePrefix(&name, kColocationGroupPrefix)) {
+        return string(name);
+      }
+    }
+  }
+  return node->name();
+}
+
+// Collects the EmbeddingVariable partitions requested on a task of a job.
+Status CollectPartitionGroups(Graph* g,
+                              std::map<string, PartitionGroup>* groups) {
+  std::map<string, std::vector<Node*>> colocated;
+  for (Node* node : g->op_nodes()) {
+    colocated[ColocationRoot(node)].push_back(node);
+  }
+  for (Node* node : g->op_nodes()) {
+    if (node->type_string() != "KvVarHandleOp" ||
+        ColocationRoot(node) != node->name()) {
+      continue;
+    }
+    DeviceNameUtils::ParsedName device;
+    if (!DeviceNameUtils::ParseFullName(node->requested_device(), &device) ||
+        !device.has_job || !device.has_task) {
+      continue;
+    }
+    PartitionGroup& group = (*groups)[node->name()];
+    group.primary = node;
+    group.device = device;
+    group.members = colocated[node->name()];
+    for (Node* member : group.members) {
+      if (member != node && member->type_string() == "KvVarHandleOp") {
+        ++group.num_slots;
+      }
+    }
+    // Ops which read the handles on the same device, without colocation
+    // constraints, e.g. initializers, move along.
+    std::vector<Node*> handles = group.members;
+    for (Node* handle : handles) {
+      if (handle->type_string() != "KvVarHandleOp") {
+        continue;
+      }
+      for (const Edge* e : handle->out_edges()) {
+        Node* dst = e->dst();
+        if (!e->IsControlEdge() && dst->IsOp() &&
+            dst->requested_device() == node->requested_device() &&
+            ColocationRoot(dst) == dst->name() &&
+            std::find(group.members.begin(), group.members.end(), dst) ==
+                group.members.end()) {
+          group.members.push_back(dst);
+        }
+      }
+    }
+  }
+  return Status::OK();
+}
+
+int64 EmbeddingDim(const Node* node) {
+  PartialTensorShape shape;
+  if (!GetNodeAttr(node->attrs(), "shape", &shape).ok() || shape.dims() < 1) {
+    return 1;
+  }
+  return std::max<int64>(shape.dim_size(shape.dims() - 1), 1);
+}
+
+// Assigns the groups of one job to its tasks with the longest processing
+// time first heuristic, keeping a group on its task on ties.
+int BalanceJob(std::vector<PartitionGroup*>* groups,
+               const std::map<string, PartitionProfile>& profile) {
+  double total_keys = 0;
+  double total_lookups = 0;
+  int num_profiled = 0;
+  std::vector<int> tasks;
+  for (PartitionGroup* group : *groups) {
+    auto it = profile.find(group->primary->name());
+    if (it != profile.end()) {
+      total_keys += it->second.num_keys;
+      total_lookups += it->second.lookups;
+      ++num_profiled;
+    }
+    tasks.push_back(group->device.task);
+  }
+  std::sort(tasks.begin(), tasks.end());
+  tasks.erase(std::unique(tasks.begin(), tasks.end()), tasks.end());
+  if (num_profiled == 0 || tasks.size() < 2) {
+    return 0;
+  }
+
+  PartitionProfile mean;
+  mean.num_keys = total_keys / num_profiled;
+  mean.lookups = total_lookups / num_profiled;
+  double total_memory = 0;
+  double total_traffic = 0;
+  for (PartitionGroup* group : *groups) {
+    auto it = profile.find(group->primary->name());
+    const PartitionProfile& p = it != profile.end() ? it->second : mean;
+    // Lookups and updates touch the rows of the slots as well.
+    const double row_size =
+        EmbeddingDim(group->primary) * (1.0 + group->num_slots);
+    group->memory = p.num_keys * row_size;
+    group->traffic = p.lookups * row_size;
+    total_memory += group->memory;
+    total_traffic += group->traffic;
+  }
+  for (PartitionGroup* group : *groups) {
+    group->cost = (total_memory > 0 ? group->memory / total_memory : 0) +
+                  (total_traffic > 0 ? group->traffic / total_traffic : 0);
+  }
+
+  std::stable_sort(groups->begin(), groups->end(),
+                   [](const PartitionGroup* a, const PartitionGroup* b) {
+                     return a->cost > b->cost;
+                   });
+  std::map<int, double> loads;
+  for (int task : tasks) {
+    loads[task] = 0;
+  }
+  int num_moved = 0;
+  for (PartitionGroup* group : *groups) {
+    int best = group->device.task;
+    for (const auto& load : loads) {
+      if (load.second < loads[best]) {
+        best = load.first;
+      }
+    }
+    loads[best] += group->cost;
+    if (best != group->device.task) {
+      group->device.task = best;
+      ++num_moved;
+    }
+  }
+  for (const auto& load : loads) {
+    VLOG(1) << "Embedding load of task " << load.first << ": " << load.second;
+  }
+  return num_moved;
+}
+
+}  // namespace
+
+Status BalanceEmbeddingVariablePlacement(Graph* g,
+                                         const string& profile_path) {
+  std::map<string, PartitionProfile> profile;
+  TF_RETURN_IF_ERROR(ReadProfile(profile_path, &profile));
+  std::map<string, PartitionGroup> groups;
+  TF_RETURN_IF_ERROR(CollectPartitionGroups(g, &groups));
+
+  std::map<string, std::vector<PartitionGroup*>> jobs;
+  for (auto& pair : groups) {
+    jobs[pair.second.device.job].push_back(&pair.second);
+  }
+  for (auto& job : jobs) {
+    const int num_moved = BalanceJob(&job.second, profile);
+    LOG(INFO) << "Moved " << num_moved << " of " << job.second.size()
+              << " EmbeddingVariable partitions between the tasks of job "
+              << job.first << " to balance their load.";
+  }
+
+  for (auto& pair : groups) {
+    PartitionGroup& group = pair.second;
+    for (Node* member : group.members) {
+      DeviceNameUtils::ParsedName device;
+      if (!DeviceNameUtils::ParseFullName(member->requested_device(),
+                                          &device) ||
+          !device.has_task || device.task == group.device.task) {
+        continue;
+      }
+      device.task = group.device.task;
+      member->set_requested_device(
+          DeviceNameUtils::ParsedNameToString(device));
+    }
+  }
+  return Status::OK();
+}
+
+namespace {
+
+// Balances the EmbeddingVariable partitions between the parameter servers
+// by the profile that TF_EV_PLACEMENT_PROFILE names, if any.
+class EmbeddingVariablePlacementPass : public GraphOptimizationPass {
+ public:
+  Status Run(const GraphOptimizationPassOptions& options) override {
+    string profile_path;
+    TF_RETURN_IF_ERROR(ReadStringFromEnvVar("TF_EV_PLACEMENT_PROFILE", "",
+                                            &profile_path));
+    if (profile_path.empty() || options.graph == nullptr ||
+        options.graph->get() == nullptr) {
+      return Status::OK();
+    }
+    return BalanceEmbeddingVariablePlacement(options.graph->get(),
+                                             profile_path);
+  }
+};
+
+REGISTER_OPTIMIZATION(OptimizationPassRegistry::PRE_PLACEMENT, 22,
+                      EmbeddingVariablePlacementPass);
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,41 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPH_EMBEDDING_PLACEMENT_PASS_H_
+#define TENSORFLOW_CORE_GRAPH_EMBEDDING_PLACEMENT_PASS_H_
+
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace tensorflow {
+
+// Moves the partitions of EmbeddingVariables, with their slots and the ops
+// colocated with them, between the tasks of the job they are requested on,
+// so that the tasks get about the same share of the embedding memory and of
+// the embedding traffic.
+//
+// The profile at `profile_path` holds a line `<name> <num_keys> <lookups>`
+// per partition, named after its KvVarHandleOp, e.g. as written by
+// `kv_variable_ops.export_placement_profile` from the `num_keys` and
+// `lookups` statistics of a previous run. The cost of a partition also
+// scales with its dimension and its number of slots, which come from the
+// graph. Partitions missing from the profile are given the mean load of the
+// profiled ones.
+Status BalanceEmbeddingVariablePlacement(Graph* g,
+                                         const string& profile_path);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPH_EMBEDDING_PLACEMENT_PASS_H_
@@ -0,0 +1,133 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/graph/embedding_placement_pass.h"
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+const char* kTask0 = "/job:ps/replica:0/task:0/device:CPU:0";
+const char* kTask1 = "/job:ps/replica:0/task:1/device:CPU:0";
+
+class EmbeddingPlacementPassTest : public ::testing::Test {
+ protected:
+  EmbeddingPlacementPassTest() : graph_(OpRegistry::Global()) {}
+
+  Node* AddEmbeddingVariable(const string& name, const string& device,
+                             const string& primary = "") {
+    NodeBuilder builder(name, "KvVarHandleOp");
+    builder.Attr("dtype", DT_FLOAT)
+        .Attr("shape", TensorShape({4}))
+        .Attr("Tkeys", DT_INT64)
+        .Device(device);
+    if (!primary.empty()) {
+      builder.Attr(kColocationAttrName,
+                   std::vector<string>{kColocationGroupPrefix + primary});
+    }
+    Node* node;
+    TF_CHECK_OK(builder.Finalize(&graph_, &node));
+    return node;
+  }
+
+  Node* AddIdentity(const string& name, Node* input) {
+    Node* node;
+    TF_CHECK_OK(NodeBuilder(name, "Identity")
+                    .Input(input)
+                    .Device(input->requested_device())
+                    .Finalize(&graph_, &node));
+    return node;
+  }
+
+  string WriteProfile(const string& name, const string& content) {
+    const string path = io::JoinPath(testing::TmpDir(), name);
+    TF_CHECK_OK(WriteStringToFile(Env::Default(), path, content));
+    return path;
+  }
+
+  Graph graph_;
+};
+
+TEST_F(EmbeddingPlacementPassTest, BalancesPartitions) {
+  Node* ev0 = AddEmbeddingVariable("ev/part_0", kTask0);
+  Node* ev1 = AddEmbeddingVariable("ev/part_1", kTask1);
+  Node* ev2 = AddEmbeddingVariable("ev/part_2", kTask0);
+  Node* ev3 = AddEmbeddingVariable("ev/part_3", kTask1);
+  Node* slot = AddEmbeddingVariable("ev/part_2/Adagrad", kTask0, "ev/part_2");
+  Node* read0 = AddIdentity("read_0", ev0);
+  Node* read2 = AddIdentity("read_2", ev2);
+  const string path = WriteProfile("balances_partitions",
+                                   "# name num_keys lookups\n"
+                                   "ev/part_0 100 100\n"
+                                   "ev/part_1 1 1\n"
+                                   "\n"
+                                   "ev/part_2 100 100\n"
+                                   "ev/part_3 1 1\n");
+  TF_ASSERT_OK(BalanceEmbeddingVariablePlacement(&graph_, path));
+
+  // part_2 costs twice as much as part_0 for its slot, so the two large
+  // partitions end up on different tasks, and the small ones stay.
+  EXPECT_EQ(kTask1, ev0->requested_device());
+  EXPECT_EQ(kTask1, read0->requested_device());
+  EXPECT_EQ(kTask1, ev1->requested_device());
+  EXPECT_EQ(kTask0, ev2->requested_device());
+  EXPECT_EQ(kTask0, slot->requested_device());
+  EXPECT_EQ(kTask0, read2->requested_device());
+  EXPECT_EQ(kTask1, ev3->requested_device());
+}
+
+TEST_F(EmbeddingPlacementPassTest, MovesSlotsWithPrimary) {
+  Node* ev0 = AddEmbeddingVariable("ev/part_0", kTask0);
+  Node* ev1 = AddEmbeddingVariable("ev/part_1", kTask0);
+  Node* slot = AddEmbeddingVariable("ev/part_1/Adagrad", kTask0, "ev/part_1");
+  AddEmbeddingVariable("ev/part_2", kTask1);
+  const string path = WriteProfile("moves_slots_with_primary",
+                                   "ev/part_0 100 100\n"
+                                   "ev/part_1 50 50\n"
+                                   "ev/part_2 1 1\n");
+  TF_ASSERT_OK(BalanceEmbeddingVariablePlacement(&graph_, path));
+
+  EXPECT_EQ(kTask0, ev0->requested_device());
+  EXPECT_EQ(kTask1, ev1->requested_device());
+  EXPECT_EQ(kTask1, slot->requested_device());
+}
+
+TEST_F(EmbeddingPlacementPassTest, KeepsUnprofiledJobs) {
+  Node* ev0 = AddEmbeddingVariable("ev/part_0", kTask0);
+  Node* ev1 = AddEmbeddingVariable("ev/part_1", kTask0);
+  AddEmbeddingVariable("ev/part_2", kTask1);
+  const string path = WriteProfile("keeps_unprofiled_jobs", "other 100 100\n");
+  TF_ASSERT_OK(BalanceEmbeddingVariablePlacement(&graph_, path));
+
+  EXPECT_EQ(kTask0, ev0->requested_device());
+  EXPECT_EQ(kTask0, ev1->requested_device());
+}
+
+TEST_F(EmbeddingPlacementPassTest, InvalidProfile) {
+  AddEmbeddingVariable("ev/part_0", kTask0);
+  const string path = WriteProfile("invalid_profile", "ev/part_0 many\n");
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      BalanceEmbeddingVariablePlacement(&graph_, path)));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -1824,6 +1824,86 @@ void AggregateForSparseApply(Graph* dest, Node* n,
   dest->AddEdge(unsorted_segment_sum, 0, n, grad_input);
   dest->AddEdge(unique, 0, n, indices_input);
 }
+
+// The input of n named 'name', -1 if it has none. The inputs of the sparse
+// applies of the EmbeddingVariables are single tensors.
+int InputIndex(const Node* n, const string& name) {
+  const OpDef& op_def = n->op_def();
+  for (int i = 0; i < op_def.input_arg_size(); ++i) {
+    if (op_def.input_arg(i).name() == name) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Merges the sparse gradients of all the micro batches of an apply of an
+// EmbeddingVariable in one hash-keyed _KvSparseGradientAccumulate, instead
+// of concat --> unique --> unsorted_segment_sum, so that the apply looks up
+// each id once per mini batch, with the summed counts of its ids. Returns
+// false when the apply is left to AggregateForSparseApply.
+bool AggregateForKvSparseApply(Graph* dest, Node* n,
+    map_node_list& duplicated_nodes) {
+  DataType indices_type;
+  if (!GetNodeAttr(n->attrs(), "Tindices", &indices_type).ok() ||
+      (indices_type != DT_INT32 && indices_type != DT_INT64)) {
+    return false;
+  }
+  const int grad_input = InputIndex(n, "grad");
+  const int indices_input = InputIndex(n, "indices");
+  int counts_input = InputIndex(n, "indices_counts");
+  if (counts_input < 0) {
+    counts_input = InputIndex(n, "counts");
+  }
+  if (grad_input < 0 || indices_input < 0) {
+    return false;
+  }
+
+  std::vector<int> inputs = {grad_input, indices_input};
+  if (counts_input >= 0) {
+    inputs.push_back(counts_input);
+  }
+  std::vector<const Edge*> edges;
+  std::vector<std::vector<NodeBuilder::NodeOut>> micro_batch_inputs;
+  for (int input : inputs) {
+    const Edge* e = nullptr;
+    TF_CHECK_OK(n->input_edge(input, &e));
+    std::vector<NodeBuilder::NodeOut> src_list;
+    src_list.emplace_back(e->src(), e->src_output());
+    for (Node* dup : duplicated_nodes[e->src()]) {
+      src_list.emplace_back(dup, e->src_output());
+    }
+    if (!micro_batch_inputs.empty() &&
+        src_list.size() != micro_batch_inputs[0].size()) {
+      return false;
+    }
+    edges.push_back(e);
+    micro_batch_inputs.push_back(std::move(src_list));
+  }
+  if (counts_input < 0) {
+    micro_batch_inputs.emplace_back();
+  }
+
+  Node* accumulate;
+  TF_CHECK_OK(NodeBuilder(dest->NewName(n->name() + "/aggr_kv_accumulate"),
+        "_KvSparseGradientAccumulate")
+      .Device(n->assigned_device_name())
+      .Input(micro_batch_inputs[0])
+      .Input(micro_batch_inputs[1])
+      .Input(micro_batch_inputs[2])
+      .Finalize(dest, &accumulate));
+  accumulate->set_assigned_device_name(n->assigned_device_name());
+
+  for (const Edge* e : edges) {
+    dest->RemoveEdge(e);
+  }
+  dest->AddEdge(accumulate, 1, n, grad_input);
+  dest->AddEdge(accumulate, 0, n, indices_input);
+  if (counts_input >= 0) {
+    dest->AddEdge(accumulate, 2, n, counts_input);
+  }
+  return true;
+}
 } // namespace
 
 void ExtendGraph(Graph* dest, std::unordered_set<const Node*> excluded,
@@ -1850,6 +1930,10 @@ void ExtendGraph(Graph* dest, std::unordered_set<const Node*> excluded,
 
   // Add aggregate nodes for Apply***
   for (Node* n : dest->op_nodes()) {
+    if (n->IsKvSparseApply() &&
+        AggregateForKvSparseApply(dest, n, duplicated_nodes)) {
+      continue;
+    }
     if (n->IsApplyAdagradOps() || n->IsApplyFtrlOps()) {
       AggregateForApply(dest, n, duplicated_nodes, 3);
     }
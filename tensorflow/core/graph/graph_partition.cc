@@ -132,6 +132,22 @@ bool NeedSameDeviceSendRecv(const Edge* edge, const GraphInfo& info) {
   return false;
 }
 
+// Return true iff the tensor of 'edge' is sent compressed by
+// _CompressGradient and _DecompressGradient.
+bool ShouldCompress(const PartitionOptions& opts, const GraphInfo& info,
+                    const Edge* edge) {
+  if (!opts.should_compress || edge->IsControlEdge() ||
+      EdgeType(edge) != DT_FLOAT) {
+    return false;
+  }
+  const Node* src = edge->src();
+  const Node* dst = edge->dst();
+  return src->assigned_device_name() != dst->assigned_device_name() &&
+         info.device_types[src->id()] == DEVICE_CPU &&
+         info.device_types[dst->id()] == DEVICE_CPU &&
+         opts.should_compress(edge);
+}
+
 // Return true iff (dst, dst_input) is specified on host memory.
 bool IsDstInputOnHost(const Edge* edge, const GraphInfo& info) {
   const Node* dst = edge->dst();
@@ -226,9 +242,22 @@ NodeDef* AddSend(const PartitionOptions& opts, const GraphInfo& g_info,
     host_memory = (src_it->second == HOST_MEMORY);
   }
 
-  // Add a cast node that casts dtype to cast_dtype.
-  // NOTE(yuanbyu): Only cast for cross-device send/recv.
-  if (dtype != cast_dtype && !NeedSameDeviceSendRecv(edge, g_info)) {
+  if (ShouldCompress(opts, g_info, edge)) {
+    // Add a node that quantizes the tensor, instead of a cast.
+    NodeDefBuilder compress_builder(opts.new_name(src->name()),
+                                    "_CompressGradient", NodeDebugInfo(*src));
+    compress_builder.Device(src->assigned_device_name()).Input(send_from);
+    if (opts.scheduling_for_recvs) {
+      compress_builder.Attr("_start_time", start_time);
+    }
+    NodeDef* compress = gdef->add_node();
+    *status = compress_builder.Finalize(compress, /*consume=*/true);
+    if (!status->ok()) return nullptr;
+
+    send_from.Reset(compress->name(), 0, DT_UINT8);
+  } else if (dtype != cast_dtype && !NeedSameDeviceSendRecv(edge, g_info)) {
+    // Add a cast node that casts dtype to cast_dtype.
+    // NOTE(yuanbyu): Only cast for cross-device send/recv.
     const string cast_op = (host_memory) ? "_HostCast" : "Cast";
     NodeDefBuilder cast_builder(opts.new_name(src->name()), cast_op,
                                 NodeDebugInfo(*src));
@@ -276,8 +305,11 @@ NodeDef* AddRecv(const PartitionOptions& opts, const GraphInfo& g_info,
   const int dst_port = edge->dst_input();
   DataType cast_dtype = dtype;
 
-  // NOTE(yuanbyu): Only cast for cross-device send/recv.
-  if (opts.should_cast && !NeedSameDeviceSendRecv(edge, g_info)) {
+  const bool compress = ShouldCompress(opts, g_info, edge);
+  if (compress) {
+    cast_dtype = DT_UINT8;
+  } else if (opts.should_cast && !NeedSameDeviceSendRecv(edge, g_info)) {
+    // NOTE(yuanbyu): Only cast for cross-device send/recv.
     cast_dtype = opts.should_cast(edge);
   }
 
@@ -324,8 +356,19 @@ NodeDef* AddRecv(const PartitionOptions& opts, const GraphInfo& g_info,
   if (!status->ok()) return nullptr;
   *real_recv = recv;
 
-  // Add the cast node (from cast_dtype to dtype) or an Identity node.
-  if (dtype != cast_dtype) {
+  // Add the decompress node, the cast node (from cast_dtype to dtype) or an
+  // Identity node.
+  if (compress) {
+    NodeDefBuilder decompress_builder(opts.new_name(src->name()),
+                                      "_DecompressGradient",
+                                      NodeDebugInfo(*src));
+    decompress_builder.Device(dst->assigned_device_name())
+        .Input(recv->name(), 0, DT_UINT8);
+    NodeDef* decompress = gdef->add_node();
+    *status = decompress_builder.Finalize(decompress, /*consume=*/true);
+    if (!status->ok()) return nullptr;
+    return decompress;
+  } else if (dtype != cast_dtype) {
     const string cast_op = (host_memory) ? "_HostCast" : "Cast";
     NodeDefBuilder cast_builder(opts.new_name(src->name()), cast_op,
                                 NodeDebugInfo(*src));
@@ -1992,9 +2035,11 @@ Status PartitionWithTensorFuse(const PartitionOptions& opts, Graph* g,
                                   send_start_time, &status);
           if (!status.ok()) return status;
 
+          // A compressed tensor is decompressed after its own recv.
           if (has_ref_input ||
               src_graph == dst_graph ||
-              control_flow_edge != nullptr) {
+              control_flow_edge != nullptr ||
+              ShouldCompress(opts, g_info, edge)) {
             NodeDef* real_recv = nullptr;
             NodeDef* recv =
               AddRecv(opts, g_info, dst_graph, edge, &real_recv, &status);
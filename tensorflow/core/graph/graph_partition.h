@@ -68,6 +68,13 @@ struct PartitionOptions {
   typedef std::function<DataType(const Edge*)> ShouldCastFunc;
   ShouldCastFunc should_cast = nullptr;
 
+  // A function that returns true if the float tensor of a cross-task edge
+  // should be quantized to 8 bits before sent over the wire, with the
+  // quantization error fed back into the next step. Only for edges between
+  // cpu devices, and should_cast is ignored for them.
+  typedef std::function<bool(const Edge*)> ShouldCompressFunc;
+  ShouldCompressFunc should_compress = nullptr;
+
   // Schedule the execution of the recvs based on their start times
   // computed by some scheduling algorithm. The recvs are divided into
   // epochs based on their start times. A recv is enabled only when
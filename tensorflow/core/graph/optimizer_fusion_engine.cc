@@ -19,6 +19,8 @@ limitations under the License.
 #include "tensorflow/core/graph/optimizer_fusion_engine_impl.h"
 #include "tensorflow/core/graph/template_base.h"
 #include "tensorflow/core/graph/template_logicsum_base.h"
+#include "tensorflow/core/graph/template_pattern.h"
+#include "tensorflow/core/graph/template_recsys_patterns.h"
 #include "tensorflow/core/graph/template_select_then_scalar.h"
 #include "tensorflow/core/graph/template_select_then_scalar_in_grad.h"
 #include "tensorflow/core/graph/template_select_else_scalar.h"
@@ -26,9 +28,34 @@ limitations under the License.
 #include "tensorflow/core/graph/template_select_pruning_else_const.h"
 #include "tensorflow/core/graph/template_select_pruning_then_const.h"
 #include "tensorflow/core/graph/template_sparse_inner_flatten.h"
+#include "tensorflow/core/graph/template_sparse_valid_cutoff_hash.h"
+#include "tensorflow/core/graph/template_unique_segment_sum.h"
 namespace tensorflow {
 
+std::string FusionReport::DebugString() const {
+  std::string s;
+  for (const auto& it : templates) {
+    const Entry& e = it.second;
+    strings::StrAppend(&s, it.first, ": candidates ", e.candidates,
+                       ", matched ", e.matched);
+    for (const auto& reason : e.rejected) {
+      strings::StrAppend(&s, ", rejected ", reason.second, " (",
+                         reason.first, ")");
+    }
+    strings::StrAppend(&s, "\n");
+  }
+  return s;
+}
+
 bool OptimizeFusion(Graph* g) {
+  if (VLOG_IS_ON(1)) {
+    FusionReport report;
+    return OptimizeFusion(g, &report);
+  }
+  return OptimizeFusion(g, nullptr);
+}
+
+bool OptimizeFusion(Graph* g, FusionReport* report) {
 
   bool changed = false;
   std::vector<std::unique_ptr<TemplateBase>> templates;
@@ -40,11 +67,27 @@ bool OptimizeFusion(Graph* g) {
   templates.emplace_back(new TemplateSelectElseScalar());
   templates.emplace_back(new TemplateSelectElseScalarInGrad());
   templates.emplace_back(new TemplateSelectThenScalarInGrad());
+  templates.emplace_back(new TemplateUniqueSegmentSum());
+  templates.emplace_back(new TemplateSparseValidCutoffHash());
+  for (const auto& pattern : RecsysFusionPatterns()) {
+    templates.emplace_back(new TemplatePattern(pattern));
+  }
 
   for (auto& t : templates) {
     std::unique_ptr<OptimizerFusionImpl> opt(
 		    new OptimizerFusionImpl(g, t.get()));
     changed |= opt->Optimize();
+    if (report != nullptr) {
+      FusionReport::Entry& entry = report->templates[t->name()];
+      entry.candidates += opt->num_candidates();
+      entry.matched += opt->num_matched();
+      for (const auto& reason : opt->rejected()) {
+        entry.rejected[reason.first] += reason.second;
+      }
+    }
+  }
+  if (report != nullptr) {
+    VLOG(1) << "Fusion report:\n" << report->DebugString();
   }
 
   return changed;
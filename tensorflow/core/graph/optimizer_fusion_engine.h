@@ -19,12 +19,30 @@ limitations under the License.
 #define TENSORFLOW_GRAPH_OPTIMIZER_FUSION_ENGINE_H_
 
 #include <sys/types.h>
+#include <map>
+#include <string>
 #include "tensorflow/core/graph/graph.h"
 
 namespace tensorflow {
 
+// Per template: the nodes that matched its first node, the subgraphs that
+// were fused, and the reasons full matches were rejected for.
+struct FusionReport {
+  struct Entry {
+    int candidates = 0;
+    int matched = 0;
+    std::map<std::string, int> rejected;
+  };
+  std::map<std::string, Entry> templates;
+
+  std::string DebugString() const;
+};
+
 // Returns true if and only if 'g' is mutated.
 extern bool OptimizeFusion(Graph* g);
+
+// Same as above, and fills 'report' when it isn't null.
+extern bool OptimizeFusion(Graph* g, FusionReport* report);
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_GRAPH_OPTIMIZER_FUSION_ENGINE_H_
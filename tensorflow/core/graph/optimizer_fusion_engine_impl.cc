@@ -18,7 +18,7 @@ inline void sortInEdges(const EdgeSet& in,
 }
 
 OptimizerFusionImpl::OptimizerFusionImpl(Graph* g, TemplateBase* t)
-    : g_(g), t_(t), num_matched_(0) {
+    : g_(g), t_(t), num_candidates_(0), num_matched_(0) {
   for (auto node : t_->temp_nodes_) {
     temp_node_map_.emplace(node.key, node);
   }
@@ -314,6 +314,7 @@ bool OptimizerFusionImpl::Optimize() {
   // TODO(minmin) check Template consistency before really optimizing
   for (Node* node : g_->nodes()) {
     if (node->type_string() == temp_node_map_[t_->first_key_].op) {
+      ++num_candidates_;
       matched_node_map_.clear();
       t_->node_to_temp_key_.clear();
       fused_op_deps_inputs_.clear();
@@ -414,14 +415,14 @@ bool OptimizerFusionImpl::Optimize() {
         continue;
       }
 
-      ++num_matched_;
-      VLOG(2) << "Matched: " << num_matched_;
+      VLOG(2) << "Matched: " << num_matched_ + 1;
       for (auto iter = matched_node_map_.begin();
            iter != matched_node_map_.end(); ++iter) {
         VLOG(2) << "  " << iter->second.node->name();
       }
 
-      std::string fused_op_name = strings::StrCat("fused_op_", num_matched_);
+      std::string fused_op_name =
+          strings::StrCat("fused_op_", num_matched_ + 1);
       if (fused_op_outputs_dynamic_.size() > 0) {
         // append dynamic out edges
         fused_op_outputs_.reserve(fused_op_outputs_.size() + 
@@ -432,6 +433,7 @@ bool OptimizerFusionImpl::Optimize() {
       }
 
       bool subgraph_replaced = false;
+      t_->reject_reason_.clear();
       if (t_->num_deps_inputs_ > 0) {
         subgraph_replaced = t_->add_subgraph(matched_node_map_,
           fused_op_name, g_, fused_op_inputs_, fused_op_deps_inputs_, 
@@ -442,6 +444,12 @@ bool OptimizerFusionImpl::Optimize() {
       }
 
       VLOG(2) << "subgraph_replace:" << subgraph_replaced;
+      if (!subgraph_replaced && !t_->reject_reason_.empty()) {
+        VLOG(2) << "Rejected " << t_->name() << " at " << node->name()
+                << ": " << t_->reject_reason_;
+        ++rejected_[t_->reject_reason_];
+        continue;
+      }
 
       if (!subgraph_replaced && t_->fused_op_ != "") {
         NodeDef* fused_def = new NodeDef();
@@ -457,6 +465,7 @@ bool OptimizerFusionImpl::Optimize() {
         Node* fused_op = g_->AddNode(*fused_def, &status);
         if (status != Status::OK()) {
           VLOG(2) << status.error_message();
+          ++rejected_["invalid fused node"];
           continue;
         }
         for (int i = 0; i < t_->num_inputs_; ++i) {
@@ -471,6 +480,7 @@ bool OptimizerFusionImpl::Optimize() {
           }
         }
       }
+      ++num_matched_;
       changed = true;
     }
   }
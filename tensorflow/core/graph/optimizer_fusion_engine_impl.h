@@ -14,6 +14,12 @@ class OptimizerFusionImpl {
   explicit OptimizerFusionImpl(Graph* g, TemplateBase* t);
   bool Optimize();
 
+  // The nodes that matched the first template node, the matches that were
+  // replaced, and the reasons for the matches that weren't.
+  int num_candidates() const { return num_candidates_; }
+  int num_matched() const { return num_matched_; }
+  const std::map<std::string, int>& rejected() const { return rejected_; }
+
 private:
   bool VisitMatchedNodes();
   bool CheckOutputs(const Node* node,
@@ -30,7 +36,9 @@ private:
   std::vector<const Edge*> fused_op_deps_inputs_;
   std::vector<std::vector<const Edge*>> fused_op_outputs_;
   std::map<std::string, MatchedNode> matched_node_map_;
+  int num_candidates_;
   int num_matched_;
+  std::map<std::string, int> rejected_;
   // for dynamic outputs of templates
   bool use_dynamic_output_keys_;
   bool use_dynamic_input_keys_;
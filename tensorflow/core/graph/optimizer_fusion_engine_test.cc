@@ -124,6 +124,7 @@ class OptimizerFusionTest : public ::testing::Test {
 
 REGISTER_OP("Input").Output("o: float").SetIsStateful();
 REGISTER_OP("InputInt64").Output("o: int64").SetIsStateful();
+REGISTER_OP("InputString").Output("o: string").SetIsStateful();
 REGISTER_OP("Output").Output("o: float");
 
 TEST_F(OptimizerFusionTest, test_input_is_control_dependency_edge) {
@@ -635,6 +636,205 @@ TEST_F(OptimizerFusionTest, SparseInnerFlattenFuse) {
       "A(Const);B(Const);C(Const);D(Const);E(Const);F(Const);G(InputInt64);H(StridedSlice);I(StridedSlice);J(Const);K(Prod);L(Pack);M(ConcatV2);N(Const);O(SparseReshape);P(InputInt64);R(Identity);S(Identity)|A->H:1;B->H:2;C->H:3;D->I:1;E->I:2;F->I:3;G->H;G->I;G->O:1;H->M;I->K;J->K:1;K->L;L->M:1;M->O:2;N->M:2;O->R;O->S;P->O");
 }
 
+TEST_F(OptimizerFusionTest, UniqueSegmentSumFuse) {
+  InitGraph(
+      "node { name: 'A' op: 'InputInt64' }"
+      "node { name: 'B' op: 'Input' }"
+      "node { name: 'U' op: 'Unique'"
+      " attr { key: 'T' value { type: DT_INT64 } }"
+      " attr { key: 'out_idx' value { type: DT_INT32 } }"
+      " input: ['A'] }"
+      "node { name: 'S' op: 'Shape'"
+      " attr { key: 'T' value { type: DT_INT64 } }"
+      " attr { key: 'out_type' value { type: DT_INT32 } }"
+      " input: ['U'] }"
+      "node { name: 'C' op: 'Const'"
+      " attr { key: 'dtype' value { type: DT_INT32 } } }"
+      "node { name: 'D' op: 'Const'"
+      " attr { key: 'dtype' value { type: DT_INT32 } } }"
+      "node { name: 'E' op: 'Const'"
+      " attr { key: 'dtype' value { type: DT_INT32 } } }"
+      "node { name: 'F' op: 'StridedSlice'"
+      " attr { key: 'T' value { type: DT_INT32 } }"
+      " attr { key: 'Index' value { type: DT_INT32 } }"
+      " attr { key: 'begin_mask' value { i: 0 } }"
+      " attr { key: 'ellipsis_mask' value { i: 0 } }"
+      " attr { key: 'end_mask' value { i: 0 } }"
+      " attr { key: 'new_axis_mask' value { i: 0 } }"
+      " attr { key: 'shrink_axis_mask' value { i: 1 } }"
+      " input: ['S', 'C', 'D', 'E'] }"
+      "node { name: 'G' op: 'UnsortedSegmentSum'"
+      " attr { key: 'T' value { type: DT_FLOAT } }"
+      " attr { key: 'Tindices' value { type: DT_INT32 } }"
+      " attr { key: 'Tnumsegments' value { type: DT_INT32 } }"
+      " input: ['B', 'U:1', 'F'] }"
+      "node { name: 'H' op: 'Identity'"
+      " attr { key: 'T' value { type: DT_FLOAT } }"
+      " input: ['G'] }"
+      "node { name: 'I' op: 'Identity'"
+      " attr { key: 'T' value { type: DT_INT64 } }"
+      " input: ['U'] }");
+  EXPECT_EQ(
+      DoFusion(),
+      "A(InputInt64);B(Input);C(Const);D(Const);E(Const);F(StridedSlice);G(UnsortedSegmentSum);H(Identity);I(Identity);S(Shape);U(Unique);fused_op_1_unique_segment_sum(UniqueSegmentSum)|A->fused_op_1_unique_segment_sum:1;B->fused_op_1_unique_segment_sum;C->F:1;D->F:2;E->F:3;F->G:2;S->F;U->S;U:1->G:1;fused_op_1_unique_segment_sum->H;fused_op_1_unique_segment_sum:1->I");
+}
+
+TEST_F(OptimizerFusionTest, UniqueSegmentSumNotFuseIdxConsumed) {
+  // idx of Unique is required by J, it can not be removed.
+  InitGraph(
+      "node { name: 'A' op: 'InputInt64' }"
+      "node { name: 'B' op: 'Input' }"
+      "node { name: 'U' op: 'Unique'"
+      " attr { key: 'T' value { type: DT_INT64 } }"
+      " attr { key: 'out_idx' value { type: DT_INT32 } }"
+      " input: ['A'] }"
+      "node { name: 'S' op: 'Shape'"
+      " attr { key: 'T' value { type: DT_INT64 } }"
+      " attr { key: 'out_type' value { type: DT_INT32 } }"
+      " input: ['U'] }"
+      "node { name: 'C' op: 'Const'"
+      " attr { key: 'dtype' value { type: DT_INT32 } } }"
+      "node { name: 'D' op: 'Const'"
+      " attr { key: 'dtype' value { type: DT_INT32 } } }"
+      "node { name: 'E' op: 'Const'"
+      " attr { key: 'dtype' value { type: DT_INT32 } } }"
+      "node { name: 'F' op: 'StridedSlice'"
+      " attr { key: 'T' value { type: DT_INT32 } }"
+      " attr { key: 'Index' value { type: DT_INT32 } }"
+      " attr { key: 'begin_mask' value { i: 0 } }"
+      " attr { key: 'ellipsis_mask' value { i: 0 } }"
+      " attr { key: 'end_mask' value { i: 0 } }"
+      " attr { key: 'new_axis_mask' value { i: 0 } }"
+      " attr { key: 'shrink_axis_mask' value { i: 1 } }"
+      " input: ['S', 'C', 'D', 'E'] }"
+      "node { name: 'G' op: 'UnsortedSegmentSum'"
+      " attr { key: 'T' value { type: DT_FLOAT } }"
+      " attr { key: 'Tindices' value { type: DT_INT32 } }"
+      " attr { key: 'Tnumsegments' value { type: DT_INT32 } }"
+      " input: ['B', 'U:1', 'F'] }"
+      "node { name: 'H' op: 'Identity'"
+      " attr { key: 'T' value { type: DT_FLOAT } }"
+      " input: ['G'] }"
+      "node { name: 'I' op: 'Identity'"
+      " attr { key: 'T' value { type: DT_INT64 } }"
+      " input: ['U'] }"
+      "node { name: 'J' op: 'Identity'"
+      " attr { key: 'T' value { type: DT_INT32 } }"
+      " input: ['U:1'] }");
+  EXPECT_EQ(DoFusion(), OriginalGraph());
+}
+
+TEST_F(OptimizerFusionTest, SparseValidCutoffHashFuse) {
+  InitGraph(
+      "node { name: 'A' op: 'InputInt64' }"
+      "node { name: 'B' op: 'InputString' }"
+      "node { name: 'C' op: 'InputInt64' }"
+      "node { name: 'H' op: 'StringToHashBucketFast'"
+      " attr { key: 'num_buckets' value { i: 100 } }"
+      " input: ['B'] }"
+      "node { name: 'V' op: 'SparseValidCutoff'"
+      " attr { key: 'T' value { type: DT_INT64 } }"
+      " attr { key: 'axis' value { i: 1 } }"
+      " attr { key: 'length' value { i: 5 } }"
+      " attr { key: 'side' value { s: 'left' } }"
+      " input: ['A', 'H', 'C'] }"
+      "node { name: 'X' op: 'Identity'"
+      " attr { key: 'T' value { type: DT_INT64 } }"
+      " input: ['V'] }"
+      "node { name: 'Y' op: 'Identity'"
+      " attr { key: 'T' value { type: DT_INT64 } }"
+      " input: ['V:1'] }"
+      "node { name: 'Z' op: 'Identity'"
+      " attr { key: 'T' value { type: DT_INT64 } }"
+      " input: ['V:2'] }");
+  EXPECT_EQ(
+      DoFusion(),
+      "A(InputInt64);B(InputString);C(InputInt64);H(StringToHashBucketFast);V(SparseValidCutoff);X(Identity);Y(Identity);Z(Identity);fused_op_1_sparse_valid_cutoff_hash(SparseValidCutoffToHashBucketFast)|A->fused_op_1_sparse_valid_cutoff_hash;B->fused_op_1_sparse_valid_cutoff_hash:1;C->fused_op_1_sparse_valid_cutoff_hash:2;H->V:1;fused_op_1_sparse_valid_cutoff_hash->X;fused_op_1_sparse_valid_cutoff_hash:1->Y;fused_op_1_sparse_valid_cutoff_hash:2->Z");
+}
+
+TEST_F(OptimizerFusionTest, SparseValidCutoffHashNotFuseHashConsumed) {
+  // The hashed values are required by W, they can not be removed.
+  InitGraph(
+      "node { name: 'A' op: 'InputInt64' }"
+      "node { name: 'B' op: 'InputString' }"
+      "node { name: 'C' op: 'InputInt64' }"
+      "node { name: 'H' op: 'StringToHashBucketFast'"
+      " attr { key: 'num_buckets' value { i: 100 } }"
+      " input: ['B'] }"
+      "node { name: 'V' op: 'SparseValidCutoff'"
+      " attr { key: 'T' value { type: DT_INT64 } }"
+      " attr { key: 'axis' value { i: 1 } }"
+      " attr { key: 'length' value { i: 5 } }"
+      " attr { key: 'side' value { s: 'left' } }"
+      " input: ['A', 'H', 'C'] }"
+      "node { name: 'X' op: 'Identity'"
+      " attr { key: 'T' value { type: DT_INT64 } }"
+      " input: ['V'] }"
+      "node { name: 'Y' op: 'Identity'"
+      " attr { key: 'T' value { type: DT_INT64 } }"
+      " input: ['V:1'] }"
+      "node { name: 'Z' op: 'Identity'"
+      " attr { key: 'T' value { type: DT_INT64 } }"
+      " input: ['V:2'] }"
+      "node { name: 'W' op: 'Identity'"
+      " attr { key: 'T' value { type: DT_INT64 } }"
+      " input: ['H'] }");
+  EXPECT_EQ(DoFusion(), OriginalGraph());
+}
+
+static const char* kL2NormalizeGraph =
+    "node { name: 'A' op: 'Input' }"
+    "node { name: 'S' op: 'Square'"
+    " attr { key: 'T' value { type: DT_FLOAT } }"
+    " input: ['A'] }"
+    "node { name: 'X' op: 'Const'"
+    " attr { key: 'dtype' value { type: DT_INT32 } }"
+    " attr { key: 'value' value { tensor { dtype: DT_INT32"
+    " tensor_shape {} int_val: %d } } } }"
+    "node { name: 'R' op: 'Sum'"
+    " attr { key: 'T' value { type: DT_FLOAT } }"
+    " attr { key: 'Tidx' value { type: DT_INT32 } }"
+    " attr { key: 'keep_dims' value { b: true } }"
+    " input: ['S', 'X'] }"
+    "node { name: 'E' op: 'Const'"
+    " attr { key: 'dtype' value { type: DT_FLOAT } }"
+    " attr { key: 'value' value { tensor { dtype: DT_FLOAT"
+    " tensor_shape {} float_val: 1e-12 } } } }"
+    "node { name: 'M' op: 'Maximum'"
+    " attr { key: 'T' value { type: DT_FLOAT } }"
+    " input: ['R', 'E'] }"
+    "node { name: 'Q' op: 'Rsqrt'"
+    " attr { key: 'T' value { type: DT_FLOAT } }"
+    " input: ['M'] }"
+    "node { name: 'N' op: 'Mul'"
+    " attr { key: 'T' value { type: DT_FLOAT } }"
+    " input: ['A', 'Q'] }"
+    "node { name: 'Z' op: 'Identity'"
+    " attr { key: 'T' value { type: DT_FLOAT } }"
+    " input: ['N'] }";
+
+TEST_F(OptimizerFusionTest, L2NormalizePatternFuse) {
+  InitGraph(strings::Printf(kL2NormalizeGraph, -1));
+  FusionReport report;
+  EXPECT_TRUE(OptimizeFusion(&graph_, &report));
+  EXPECT_EQ(CanonicalGraphString(&graph_),
+      "A(Input);Z(Identity);fused_op_1_l2_normalize(FusedL2Normalize)|"
+      "A->fused_op_1_l2_normalize;fused_op_1_l2_normalize->Z");
+  EXPECT_EQ(report.templates["l2_normalize"].candidates, 1);
+  EXPECT_EQ(report.templates["l2_normalize"].matched, 1);
+  EXPECT_TRUE(report.templates["l2_normalize"].rejected.empty());
+}
+
+TEST_F(OptimizerFusionTest, L2NormalizePatternNotFuseAxis) {
+  // FusedL2Normalize only normalizes the last dimension.
+  InitGraph(strings::Printf(kL2NormalizeGraph, 0));
+  FusionReport report;
+  EXPECT_FALSE(OptimizeFusion(&graph_, &report));
+  EXPECT_EQ(CanonicalGraphString(&graph_), OriginalGraph());
+  EXPECT_EQ(report.templates["l2_normalize"].matched, 0);
+  EXPECT_EQ(report.templates["l2_normalize"].rejected["axis scalar value"], 1);
+}
+
 #ifndef GOOGLE_CUDA
 TEST_F(OptimizerFusionTest, MSBatchMatMulFuse2Heads) {
   InitGraph(
@@ -27,6 +27,10 @@ limitations under the License.
 
 namespace tensorflow {
 
+namespace {
+const char* const kAsyncEmbeddingStageAttr = "_async_embedding_stage";
+}  // namespace
+
 class SmartStagePass : public GraphOptimizationPass {
  public:
   Status Run(const GraphOptimizationPassOptions& options) override {
@@ -66,6 +70,12 @@ class SmartStagePass : public GraphOptimizationPass {
     if (stage_node != nullptr && unstage_node != nullptr) {
       VLOG(1)
         << "SmartStage: Start searching from a user-specified position.";
+      const std::string& shared_name =
+          stage_node->def().attr().at("shared_name").s();
+      auto it = options.stage_depths().find(shared_name);
+      if (it != options.stage_depths().end()) {
+        SetStageDepth(g, shared_name, it->second);
+      }
       Status s =
           SmartStageFromStageUnStageNode(g, stage_node, unstage_node);
       return s;
@@ -86,6 +96,35 @@ class SmartStagePass : public GraphOptimizationPass {
     return Status::OK();
   }
 
+  // Returns the capacity of the buffer of the stage subgraph generated with
+  // options.
+  static int64 StageDepth(const SmartStageOptions& options) {
+    std::string name_prefix = "prefetch";
+    if (!options.name().empty())
+      name_prefix = options.name();
+    auto it = options.stage_depths().find(name_prefix);
+    if (it != options.stage_depths().end())
+      return it->second;
+    return options.capacity();
+  }
+
+  // Sets the capacity of the buffer of a user-specified stage subgraph on
+  // all the ops sharing the buffer.
+  void SetStageDepth(const std::unique_ptr<Graph>& g,
+                     const std::string& shared_name, int64 depth) {
+    for (Node* n : g->op_nodes()) {
+      if (!str_util::StartsWith(n->type_string(), "TensorBuffer"))
+        continue;
+      auto it = n->def().attr().find("shared_name");
+      if (it == n->def().attr().end() || it->second.s() != shared_name)
+        continue;
+      n->ClearAttr("shared_capacity");
+      n->AddAttr("shared_capacity", depth);
+    }
+    VLOG(1) << "SmartStage: Stage depth of " << shared_name << " is "
+            << depth;
+  }
+
   void GetTargetNodesName(std::unordered_set<std::string>& target_nodes) {
     std::string tn;
     ReadStringFromEnvVar("TARGET_NODES_NAME", "", &tn);
@@ -102,6 +141,10 @@ class SmartStagePass : public GraphOptimizationPass {
     unsigned int stage_counter = 0;
     unsigned int unstage_counter = 0;
     for (Node* n : g->op_nodes()) {
+      // The embedding stage of Async Embedding is a separate pipeline
+      // segment after the embedding lookups, it is left as it is.
+      if (n->def().attr().contains(kAsyncEmbeddingStageAttr))
+        continue;
       if (n->IsStage()) {
         stage_node = n;
         stage_counter++;
@@ -282,6 +325,10 @@ class SmartStagePass : public GraphOptimizationPass {
               .Attr("timeout_millis",
                     stage_node->def().attr().at("timeout_millis"));
 
+      if (stage_node->def().attr().contains("use_pinned_memory"))
+        builder.Attr("use_pinned_memory",
+                     stage_node->def().attr().at("use_pinned_memory"));
+
       if (stage_node->def().attr().contains("_stream_id"))
         builder.Attr("_stream_id", stage_node->def().attr().at("_stream_id"));
 
@@ -294,9 +341,11 @@ class SmartStagePass : public GraphOptimizationPass {
 
       auto builder = NodeDefBuilder(stage_node_name, "TensorBufferPut")
                          .Input(src_list)
-                         .Attr("shared_capacity", options.capacity())
+                         .Attr("shared_capacity", StageDepth(options))
                          .Attr("shared_name", name_prefix)
-                         .Attr("timeout_millis", options.timeout_millis());
+                         .Attr("timeout_millis", options.timeout_millis())
+                         .Attr("use_pinned_memory",
+                               options.use_pinned_memory());
 
       if (options.stage_subgraph_stream_id() > 0)
         builder.Attr("_stream_id", options.stage_subgraph_stream_id());
@@ -341,7 +390,7 @@ class SmartStagePass : public GraphOptimizationPass {
 
       TF_RETURN_IF_ERROR(NodeDefBuilder(unstage_node_name, "TensorBufferTake")
                              .Attr("dtypes", DataTypeSlice(type_vec))
-                             .Attr("shared_capacity", options.capacity())
+                             .Attr("shared_capacity", StageDepth(options))
                              .Attr("shared_name", name_prefix)
                              .Attr("shared_threads", num_clients)
                              .Finalize(&unstage_node_def));
@@ -367,7 +416,7 @@ class SmartStagePass : public GraphOptimizationPass {
     cancel_node_name = name_prefix + "/TensorBufferCancel";
     TF_RETURN_IF_ERROR(NodeDefBuilder(cancel_node_name, "TensorBufferCancel")
                            .Attr("shared_name", name_prefix)
-                           .Attr("shared_capacity", options.capacity())
+                           .Attr("shared_capacity", StageDepth(options))
                            .Finalize(&cancel_node_def));
     g->AddNode(cancel_node_def, &s);
     TF_RETURN_IF_ERROR(s);
@@ -378,7 +427,7 @@ class SmartStagePass : public GraphOptimizationPass {
     TF_RETURN_IF_ERROR(NodeDefBuilder(resume_node_name, "TensorBufferCancel")
                            .Attr("is_cancelled", false)
                            .Attr("shared_name", name_prefix)
-                           .Attr("shared_capacity", options.capacity())
+                           .Attr("shared_capacity", StageDepth(options))
                            .Finalize(&resume_node_def));
     g->AddNode(resume_node_def, &s);
     TF_RETURN_IF_ERROR(s);
@@ -388,7 +437,7 @@ class SmartStagePass : public GraphOptimizationPass {
     close_node_name = name_prefix + "/TensorBufferClose";
     TF_RETURN_IF_ERROR(NodeDefBuilder(close_node_name, "TensorBufferClose")
                            .Attr("shared_name", name_prefix)
-                           .Attr("shared_capacity", options.capacity())
+                           .Attr("shared_capacity", StageDepth(options))
                            .Finalize(&close_node_def));
     g->AddNode(close_node_def, &s);
 
@@ -416,11 +465,81 @@ class SmartStagePass : public GraphOptimizationPass {
         options.graph_key(), name_prefix + "_prefetch_runner", runner_options);
   }
 
+  struct PrefetchSource {
+    Node* handle;
+    int handle_output;
+    Node* ids;
+    int ids_output;
+    const Node* lookup;
+  };
+
+  // Gets the staged ids looked up from EmbeddingVariables, with the handles
+  // of the EmbeddingVariables.
+  Status GetPrefetchSources(const std::vector<const Edge*>& stage_edges,
+                            std::vector<PrefetchSource>& sources) {
+    std::unordered_set<std::string> visited;
+    for (const Edge* e : stage_edges) {
+      const Node* dst = e->dst();
+      if (e->IsControlEdge() || e->dst_input() != 1 ||
+          (dst->type_string() != "KvResourceGather" &&
+           dst->type_string() != "KvResourceGatherV1")) {
+        continue;
+      }
+      const Edge* handle_edge = nullptr;
+      TF_RETURN_IF_ERROR(dst->input_edge(0, &handle_edge));
+      std::string key = handle_edge->src()->name() + ":" +
+          std::to_string(handle_edge->src_output()) + ";" +
+          e->src()->name() + ":" + std::to_string(e->src_output());
+      if (!visited.insert(key).second)
+        continue;
+      sources.push_back({handle_edge->src(), handle_edge->src_output(),
+                         e->src(), e->src_output(), dst});
+    }
+    return Status::OK();
+  }
+
+  // Adds a KvResourcePrefetch node for each source, which runs before the
+  // Stage node, so the embeddings of a staged sample are promoted to the
+  // first tier while the previous samples are computed.
+  Status AddPrefetchNodesToGraph(std::unique_ptr<Graph>& g,
+                                 const std::vector<PrefetchSource>& sources,
+                                 const std::string& stage_node_name,
+                                 Node* stage_node) {
+    for (const PrefetchSource& source : sources) {
+      NodeDef prefetch_node_def;
+      TF_RETURN_IF_ERROR(
+          NodeDefBuilder(g->NewName(stage_node_name + "/KvResourcePrefetch"),
+                         "KvResourcePrefetch")
+              .Device(source.lookup->requested_device())
+              .Input(source.handle->name(), source.handle_output,
+                     DT_RESOURCE)
+              .Input(source.ids->name(), source.ids_output,
+                     source.ids->output_type(source.ids_output))
+              .Attr("Tkeys", source.lookup->def().attr().at("Tkeys"))
+              .Attr("dtype", source.lookup->def().attr().at("dtype"))
+              .Finalize(&prefetch_node_def));
+      Status s;
+      Node* prefetch_node = g->AddNode(prefetch_node_def, &s);
+      TF_RETURN_IF_ERROR(s);
+      g->AddEdge(source.handle, source.handle_output, prefetch_node, 0);
+      g->AddEdge(source.ids, source.ids_output, prefetch_node, 1);
+      g->AddControlEdge(prefetch_node, stage_node);
+    }
+    VLOG(1) << "SmartStage: Prefetch the embeddings of " << sources.size()
+            << " lookups.";
+    return Status::OK();
+  }
+
   Status AddStageNodeToGraph(std::unique_ptr<Graph>& g,
                              Node* stage_node,
                              Node* unstage_node,
                              std::vector<const Edge*>& stage_edges,
                              const SmartStageOptions& options) {
+    std::vector<PrefetchSource> prefetch_sources;
+    if (options.prefetch_embedding()) {
+      TF_RETURN_IF_ERROR(GetPrefetchSources(stage_edges, prefetch_sources));
+    }
+
     int index = 0;
     std::map<std::string, int64> edge_map;
     std::vector<DataType> type_vec;
@@ -462,6 +581,10 @@ class SmartStagePass : public GraphOptimizationPass {
       g->AddEdge(e->src(), e->src_output(), new_stage_node, it->second);
     }
 
+    TF_RETURN_IF_ERROR(AddPrefetchNodesToGraph(g, prefetch_sources,
+                                               stage_node_name,
+                                               new_stage_node));
+
     for (auto it = edge_to_unstage.begin(); it != edge_to_unstage.end(); ++it) {
       const Edge* e = it->first;
       TF_RETURN_IF_ERROR(
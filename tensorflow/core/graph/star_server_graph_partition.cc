@@ -22,6 +22,7 @@
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/util/device_name_utils.h"
+#include "tensorflow/core/util/env_var.h"
 
 using namespace std;
 
@@ -2103,10 +2104,179 @@ Status GraphPartitionerBase::SplitGraphInternal(
   return Status::OK();
 }
 
+namespace {
+// The CPU of the task of device, the worker caches live on it.
+std::string CpuDeviceOfTask(const std::string& device) {
+  DeviceNameUtils::ParsedName p;
+  if (!DeviceNameUtils::ParseFullName(device, &p)) {
+    return device;
+  }
+  p.type = "CPU";
+  p.has_type = true;
+  p.id = 0;
+  p.has_id = true;
+  return DeviceNameUtils::ParsedNameToString(p);
+}
+} // namespace
+
+Status TrainGraphPartitioner::AddEVWorkerCaches() {
+  int64 max_staleness_steps = 0;
+  int64 capacity = 0;
+  RETURN_IF_NOT_OK(ReadInt64FromEnvVar("TF_STAR_EV_WORKER_CACHE_STEPS", 0,
+                                       &max_staleness_steps));
+  RETURN_IF_NOT_OK(ReadInt64FromEnvVar("TF_STAR_EV_WORKER_CACHE_CAPACITY", 0,
+                                       &capacity));
+  if (max_staleness_steps <= 0) {
+    return Status::OK();
+  }
+
+  std::vector<Node*> gathers;
+  for (Node* node : graph_->op_nodes()) {
+    if (node->type_string() != "KvResourceGather" ||
+        is_main_loc_func_(opts_.node_to_loc(node))) {
+      continue;
+    }
+    bool is_use_default_value_tensor = false;
+    bool is_inference = false;
+    RETURN_IF_NOT_OK(GetNodeAttr(node->attrs(), "is_use_default_value_tensor",
+                                 &is_use_default_value_tensor));
+    RETURN_IF_NOT_OK(GetNodeAttr(node->attrs(), "is_inference",
+                                 &is_inference));
+    if (is_use_default_value_tensor || is_inference) {
+      continue;
+    }
+    const Edge* handle_edge = nullptr;
+    const Edge* indices_edge = nullptr;
+    RETURN_IF_NOT_OK(node->input_edge(0, &handle_edge));
+    RETURN_IF_NOT_OK(node->input_edge(1, &indices_edge));
+    // NOTE: The gathers in loops read the handles through Enter, they are
+    // left as is.
+    if (!handle_edge->src()->IsKvVarHandle() ||
+        !is_main_loc_func_(opts_.node_to_loc(indices_edge->src()))) {
+      continue;
+    }
+    bool in_control_flow = false;
+    for (const Edge* in_edge : node->in_edges()) {
+      if (in_edge->src()->IsControlFlow()) {
+        in_control_flow = true;
+      }
+    }
+    if (!in_control_flow) {
+      gathers.push_back(node);
+    }
+  }
+
+  for (Node* gather : gathers) {
+    const Edge* handle_edge = nullptr;
+    const Edge* indices_edge = nullptr;
+    RETURN_IF_NOT_OK(gather->input_edge(0, &handle_edge));
+    RETURN_IF_NOT_OK(gather->input_edge(1, &indices_edge));
+    PartialTensorShape shape;
+    RETURN_IF_NOT_OK(GetNodeAttr(handle_edge->src()->attrs(), "shape",
+                                 &shape));
+    if (shape.dims() < 1 || shape.dim_size(shape.dims() - 1) <= 0) {
+      continue;
+    }
+    int64 value_dim = shape.dim_size(shape.dims() - 1);
+    DataType dtype, tkeys;
+    RETURN_IF_NOT_OK(GetNodeAttr(gather->attrs(), "dtype", &dtype));
+    RETURN_IF_NOT_OK(GetNodeAttr(gather->attrs(), "Tkeys", &tkeys));
+    const std::string worker_device =
+        CpuDeviceOfTask(indices_edge->src()->assigned_device_name());
+    const std::string& ps_device = gather->assigned_device_name();
+
+    Node* cache = nullptr;
+    RETURN_IF_NOT_OK(
+        NodeBuilder(graph_->NewName(gather->name() + "/WorkerCache"),
+                    "EVWorkerCacheHandleOp")
+            .Attr("shared_name", gather->name())
+            .Attr("Tkeys", tkeys)
+            .Attr("dtype", dtype)
+            .Device(worker_device)
+            .Finalize(graph_, &cache));
+    cache->set_assigned_device_name(worker_device);
+
+    Node* lookup = nullptr;
+    RETURN_IF_NOT_OK(
+        NodeBuilder(graph_->NewName(gather->name() + "/WorkerCacheLookup"),
+                    "EVWorkerCacheLookup")
+            .Input(cache)
+            .Input(indices_edge->src(), indices_edge->src_output())
+            .Attr("value_dim", value_dim)
+            .Attr("max_staleness_steps", max_staleness_steps)
+            .Attr("Tkeys", tkeys)
+            .Attr("dtype", dtype)
+            .Device(worker_device)
+            .Finalize(graph_, &lookup));
+    lookup->set_assigned_device_name(worker_device);
+
+    Node* gather_if_modified = nullptr;
+    RETURN_IF_NOT_OK(
+        NodeBuilder(graph_->NewName(gather->name() + "/IfModified"),
+                    "KvResourceGatherIfModified")
+            .Input(handle_edge->src(), handle_edge->src_output())
+            .Input(lookup, 2)
+            .Input(lookup, 3)
+            .Attr("Tkeys", tkeys)
+            .Attr("dtype", dtype)
+            .Device(ps_device)
+            .Finalize(graph_, &gather_if_modified));
+    gather_if_modified->set_assigned_device_name(ps_device);
+
+    Node* merge = nullptr;
+    RETURN_IF_NOT_OK(
+        NodeBuilder(graph_->NewName(gather->name() + "/WorkerCacheMerge"),
+                    "EVWorkerCacheMerge")
+            .Input(cache)
+            .Input(lookup, 0)
+            .Input(lookup, 1)
+            .Input(lookup, 2)
+            .Input(gather_if_modified, 0)
+            .Input(gather_if_modified, 1)
+            .Input(gather_if_modified, 2)
+            .Attr("capacity", capacity)
+            .Attr("max_staleness_steps", max_staleness_steps)
+            .Attr("Tkeys", tkeys)
+            .Attr("dtype", dtype)
+            .Device(worker_device)
+            .Finalize(graph_, &merge));
+    merge->set_assigned_device_name(worker_device);
+
+    std::vector<const Edge*> in_edges(gather->in_edges().begin(),
+                                      gather->in_edges().end());
+    for (const Edge* in_edge : in_edges) {
+      if (in_edge->IsControlEdge()) {
+        graph_->AddControlEdge(in_edge->src(), gather_if_modified);
+      }
+    }
+    std::vector<const Edge*> out_edges(gather->out_edges().begin(),
+                                       gather->out_edges().end());
+    for (const Edge* out_edge : out_edges) {
+      Node* dst = out_edge->dst();
+      if (out_edge->IsControlEdge()) {
+        graph_->AddControlEdge(merge, dst);
+        continue;
+      }
+      // The identities colocated with the EV would send the rows back to
+      // the PS, they follow the cache instead.
+      if (dst->IsIdentity() && opts_.node_to_loc(dst) ==
+                                   opts_.node_to_loc(gather)) {
+        dst->set_assigned_device_name(worker_device);
+      }
+      graph_->AddEdge(merge, 0, dst, out_edge->dst_input());
+    }
+    VLOG(1) << "Rewrite " << gather->name() << " to the worker cache "
+            << merge->name() << " on " << worker_device;
+    graph_->RemoveNode(gather);
+  }
+  return Status::OK();
+}
+
 Status TrainGraphPartitioner::SplitGraphV2(
     SubGraph *worker_sub_graph,
     std::vector<SubGraph> *ps_sub_graphs)
 {
+  RETURN_IF_NOT_OK(AddEVWorkerCaches());
 
   RETURN_IF_NOT_OK(SplitGraphInternalV2(
       ps_sub_graphs, worker_sub_graph, /*needResetSwitchOp*/true));
@@ -2119,6 +2289,7 @@ Status TrainGraphPartitioner::SplitGraph(
     std::vector<SubGraph> *ps_sub_graphs,
     bool merge_ps_graph)
 {
+  RETURN_IF_NOT_OK(AddEVWorkerCaches());
 
   RETURN_IF_NOT_OK(SplitGraphInternal(ps_sub_graphs, worker_sub_graph, true));
     
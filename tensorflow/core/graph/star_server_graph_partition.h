@@ -416,6 +416,14 @@ class TrainGraphPartitioner : public GraphPartitionerBase {
                           NodeDef *src_node_def,
                           std::string *feed_key) override;
 
+ private:
+  // With TF_STAR_EV_WORKER_CACHE_STEPS = K > 0, the KvResourceGathers of
+  // the PS EVs read by the worker are served by the worker side caches,
+  // the rows fetched within the last K steps hit, the others are only sent
+  // back by the PS when their versions changed. At most
+  // TF_STAR_EV_WORKER_CACHE_CAPACITY rows are cached per gather, 0 means
+  // unbounded.
+  Status AddEVWorkerCaches();
 };
 
 class InferGraphPartitioner : public GraphPartitionerBase {
@@ -8,6 +8,7 @@
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/graph/graph_constructor.h"
 #include "tensorflow/core/graph/graph_def_builder.h"
+#include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/graph/star_server_graph_partition.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/util/device_name_utils.h"
@@ -530,5 +531,66 @@ TEST_F(DistGraphPartitionTest, testCompleteWorkerCrossPS) {
   ASSERT_TRUE(flag);
 }
 
+TEST_F(DistGraphPartitionTest, testEVWorkerCache) {
+  string ps_device = "/job:ps/replica:0/task:1/cpu:0";
+  string worker_device = "/job:worker/replica:0/task:0/cpu:0";
+  setenv("TF_STAR_EV_WORKER_CACHE_STEPS", "2", 1);
+
+  Node* ev = nullptr;
+  TF_ASSERT_OK(NodeBuilder("ev", "KvVarHandleOp")
+                   .Attr("dtype", DT_FLOAT)
+                   .Attr("shape", TensorShape({8}))
+                   .Attr("Tkeys", DT_INT64)
+                   .Device(ps_device)
+                   .Finalize(in_.graph(), &ev));
+  Node* ids = nullptr;
+  TF_ASSERT_OK(NodeBuilder("ids", "Placeholder")
+                   .Attr("dtype", DT_INT64)
+                   .Device(worker_device)
+                   .Finalize(in_.graph(), &ids));
+  Node* default_value = nullptr;
+  TF_ASSERT_OK(NodeBuilder("default_value", "Placeholder")
+                   .Attr("dtype", DT_FLOAT)
+                   .Device(ps_device)
+                   .Finalize(in_.graph(), &default_value));
+  Node* gather = nullptr;
+  TF_ASSERT_OK(NodeBuilder("gather", "KvResourceGather")
+                   .Input(ev)
+                   .Input(ids)
+                   .Input(default_value)
+                   .Attr("dtype", DT_FLOAT)
+                   .Attr("Tkeys", DT_INT64)
+                   .Device(ps_device)
+                   .Finalize(in_.graph(), &gather));
+  auto c = ConstructOp(in_.WithOpName("C"), "FakeIdentity", worker_device,
+                       {Output(gather)});
+
+  shared_ptr<Graph> g = ConstructGraph();
+  SubGraph worker_sub_graph;
+  vector<SubGraph> ps_sub_graphs;
+
+  TrainGraphPartitioner gp(popts_, g.get(), true, true);
+  Status s = gp.SplitGraph(&worker_sub_graph, &ps_sub_graphs);
+  unsetenv("TF_STAR_EV_WORKER_CACHE_STEPS");
+  TF_ASSERT_OK(s);
+
+  std::map<string, Node*> nodes;
+  for (Node* node : g->op_nodes()) {
+    nodes[node->type_string()] = node;
+  }
+  ASSERT_EQ(0, nodes.count("KvResourceGather"));
+  ASSERT_EQ(1, nodes.count("EVWorkerCacheLookup"));
+  ASSERT_EQ(1, nodes.count("KvResourceGatherIfModified"));
+  ASSERT_EQ(1, nodes.count("EVWorkerCacheMerge"));
+  ASSERT_EQ(worker_device,
+            nodes["EVWorkerCacheLookup"]->assigned_device_name());
+  ASSERT_EQ(ps_device,
+            nodes["KvResourceGatherIfModified"]->assigned_device_name());
+  const Edge* in_edge = nullptr;
+  TF_ASSERT_OK(nodes["FakeIdentity"]->input_edge(0, &in_edge));
+  ASSERT_EQ(nodes["EVWorkerCacheMerge"], in_edge->src());
+  ASSERT_EQ((size_t)1, ps_sub_graphs.size());
+}
+
 }  // namespace tensorflow
 
@@ -215,6 +215,8 @@ class TemplateBase {
   std::map<std::string, int> nodes_dynamic_oedges_;
   // store mapping from the name of an added node to its key in template
   std::map<std::string, std::string> node_to_temp_key_;
+  // why add_subgraph() declined the last match, for the fusion report
+  std::string reject_reason_;
 
   virtual const string name() {
     return "TemplateBase";
@@ -0,0 +1,310 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// A declarative template for the fusion engine. A FusionPattern describes
+// the subgraph with TempNode's as any other template does, and adds what the
+// hand-written add_subgraph() implementations do in C++: the constraints a
+// match must satisfy, and how the attributes of the fused op are taken from
+// the matched nodes. TemplatePattern then replaces every accepted match with
+// a single node of the fused op and removes the matched nodes.
+
+#ifndef TENSORFLOW_CORE_GRAPH_TEMPLATE_PATTERN_H_
+#define TENSORFLOW_CORE_GRAPH_TEMPLATE_PATTERN_H_
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/template_base.h"
+#include "tensorflow/core/util/device_name_utils.h"
+
+namespace tensorflow {
+
+// The matched nodes by template key, and the input edges of the fused op.
+struct PatternMatch {
+  const std::map<std::string, MatchedNode>* nodes;
+  const std::vector<const Edge*>* inputs;
+
+  const Node* node(const std::string& key) const {
+    auto it = nodes->find(key);
+    return it == nodes->end() ? nullptr : it->second.node;
+  }
+};
+
+// A condition on a match. 'description' names the condition in the
+// rejection report.
+struct PatternConstraint {
+  std::string description;
+  std::function<bool(const PatternMatch&)> check;
+};
+
+// An attribute of the fused op. 'value' computes it from the match and
+// returns false when it can't.
+struct PatternAttr {
+  std::string name;
+  std::function<bool(const PatternMatch&, AttrValue*)> value;
+};
+
+struct FusionPattern {
+  std::string name;
+  std::vector<TempNode> nodes;
+  std::string first_key;
+  int num_inputs = 0;
+  int num_outputs = 0;
+  std::string fused_op;
+  // The fused node takes the device of this node.
+  std::string device_key;
+  std::vector<PatternConstraint> constraints;
+  std::vector<PatternAttr> attrs;
+};
+
+// Constraint and attribute builders for FusionPattern.
+namespace pattern {
+
+inline bool ReadScalar(const Node* node, double* value) {
+  if (node == nullptr || node->type_string() != "Const") return false;
+  const TensorProto* proto = nullptr;
+  if (!GetNodeAttr(node->attrs(), "value", &proto).ok()) return false;
+  Tensor t;
+  if (!t.FromProto(*proto) || t.NumElements() != 1) return false;
+  switch (t.dtype()) {
+    case DT_FLOAT: *value = t.flat<float>()(0); return true;
+    case DT_DOUBLE: *value = t.flat<double>()(0); return true;
+    case DT_INT32: *value = t.flat<int32>()(0); return true;
+    case DT_INT64: *value = t.flat<int64>()(0); return true;
+    default: return false;
+  }
+}
+
+// The type attribute 'attr' of node 'key' is one of 'types'.
+inline PatternConstraint TypeIn(const std::string& key,
+                                const std::string& attr,
+                                const DataTypeVector& types) {
+  return {strings::StrCat(key, ".", attr, " type"),
+          [key, attr, types](const PatternMatch& m) {
+            DataType dtype;
+            if (!GetNodeAttr(m.node(key)->attrs(), attr, &dtype).ok()) {
+              return false;
+            }
+            for (DataType t : types) {
+              if (t == dtype) return true;
+            }
+            return false;
+          }};
+}
+
+// The boolean attribute 'attr' of node 'key' equals 'expected'.
+inline PatternConstraint BoolAttrIs(const std::string& key,
+                                    const std::string& attr, bool expected) {
+  return {strings::StrCat(key, ".", attr, " == ", expected),
+          [key, attr, expected](const PatternMatch& m) {
+            bool value;
+            return GetNodeAttr(m.node(key)->attrs(), attr, &value).ok() &&
+                   value == expected;
+          }};
+}
+
+// Node 'key' is a scalar Const with one of 'values'.
+inline PatternConstraint ScalarIn(const std::string& key,
+                                  const std::vector<double>& values) {
+  return {strings::StrCat(key, " scalar value"),
+          [key, values](const PatternMatch& m) {
+            double value;
+            if (!ReadScalar(m.node(key), &value)) return false;
+            for (double v : values) {
+              if (v == value) return true;
+            }
+            return false;
+          }};
+}
+
+// The input 'index' of the fused op is produced by an op of type 'op'.
+inline PatternConstraint InputIsOp(int index, const std::string& op) {
+  return {strings::StrCat("input ", index, " is ", op),
+          [index, op](const PatternMatch& m) {
+            const Edge* e = (*m.inputs)[index];
+            return e != nullptr && e->src()->type_string() == op;
+          }};
+}
+
+// Node 'key' is placed on a device of type 'device_type', or is unplaced.
+inline PatternConstraint OnDevice(const std::string& key,
+                                  const std::string& device_type) {
+  return {strings::StrCat(key, " on ", device_type),
+          [key, device_type](const PatternMatch& m) {
+            const Node* n = m.node(key);
+            const string& device = n->assigned_device_name().empty() ?
+                n->requested_device() : n->assigned_device_name();
+            if (device.empty()) return true;
+            DeviceNameUtils::ParsedName parsed;
+            if (!DeviceNameUtils::ParseFullName(device, &parsed)) {
+              return false;
+            }
+            return !parsed.has_type || parsed.type == device_type;
+          }};
+}
+
+// Copies the attribute 'attr' of node 'key' as the fused attribute 'name'.
+inline PatternAttr CopyAttr(const std::string& name, const std::string& key,
+                            const std::string& attr) {
+  return {name, [key, attr](const PatternMatch& m, AttrValue* value) {
+            const AttrValue* v = m.node(key)->attrs().Find(attr);
+            if (v == nullptr) return false;
+            *value = *v;
+            return true;
+          }};
+}
+
+// The value of the scalar Const 'key' as an int attribute.
+inline PatternAttr IntFromScalar(const std::string& name,
+                                 const std::string& key) {
+  return {name, [key](const PatternMatch& m, AttrValue* value) {
+            double v;
+            if (!ReadScalar(m.node(key), &v)) return false;
+            value->set_i(static_cast<int64>(v));
+            return true;
+          }};
+}
+
+// The value of the scalar Const 'key' as a float attribute.
+inline PatternAttr FloatFromScalar(const std::string& name,
+                                   const std::string& key) {
+  return {name, [key](const PatternMatch& m, AttrValue* value) {
+            double v;
+            if (!ReadScalar(m.node(key), &v)) return false;
+            value->set_f(static_cast<float>(v));
+            return true;
+          }};
+}
+
+}  // namespace pattern
+
+class TemplatePattern : public TemplateBase {
+ public:
+  explicit TemplatePattern(const FusionPattern& pattern)
+      : pattern_(pattern) {
+    temp_nodes_ = pattern_.nodes;
+    first_key_ = pattern_.first_key;
+    num_inputs_ = pattern_.num_inputs;
+    num_outputs_ = pattern_.num_outputs;
+  }
+
+  const string name() override {
+    return pattern_.name;
+  }
+
+  bool add_subgraph(std::map<std::string, MatchedNode>& nodes,
+                    std::string name_prefix, Graph* g,
+                    std::vector<const Edge*>& inputs,
+                    std::vector<std::vector<const Edge*>>& outputs) override {
+    PatternMatch match = {&nodes, &inputs};
+    for (const auto& constraint : pattern_.constraints) {
+      if (!constraint.check(match)) {
+        reject_reason_ = constraint.description;
+        return false;
+      }
+    }
+
+    const Node* device_node = match.node(pattern_.device_key.empty() ?
+        first_key_ : pattern_.device_key);
+    NodeDef fused_def;
+    fused_def.set_op(pattern_.fused_op);
+    fused_def.set_name(name_prefix + "_" + name());
+    fused_def.set_device(device_node->def().device());
+    for (int i = 0; i < num_inputs_; ++i) {
+      add_input(fused_def, inputs[i]);
+    }
+    for (const auto& attr : pattern_.attrs) {
+      AttrValue value;
+      if (!attr.value(match, &value)) {
+        reject_reason_ = strings::StrCat("attr ", attr.name);
+        return false;
+      }
+      fused_def.mutable_attr()->insert({attr.name, value});
+    }
+
+    Status status;
+    Node* fused_node = g->AddNode(fused_def, &status);
+    if (status != Status::OK()) {
+      VLOG(1) << status.error_message();
+      reject_reason_ = "invalid fused node";
+      return false;
+    }
+    fused_node->set_assigned_device_name(
+        device_node->assigned_device_name());
+
+    // A graph input may feed several nodes of the pattern, these edges go
+    // away with the nodes.
+    for (int i = 0; i < num_inputs_; ++i) {
+      add_iedge(g, fused_node, i, inputs[i], /*remove=*/false);
+    }
+    for (int i = 0; i < num_outputs_; ++i) {
+      add_oedges(g, fused_node, i, outputs[i]);
+    }
+    RemoveMatchedNodes(nodes, g);
+    return true;
+  }
+
+  bool CheckDynamicInputs(
+      const Node* node, const TempNode* temp_node, int dy_mode,
+      std::vector<const Edge*>& fused_op_inputs,
+      std::map<const std::string, TempNode>& temp_node_map,
+      std::map<std::string, MatchedNode>& matched_node_map) override {
+    return false;
+  }
+
+  bool CheckDynamicOutputs(
+      const Node* node, const TempNode* temp_node, int dy_mode,
+      std::vector<std::vector<const Edge*>>& fused_op_outputs,
+      std::map<const std::string, TempNode>& temp_node_map,
+      std::map<std::string, MatchedNode>& matched_node_map) override {
+    return false;
+  }
+
+ private:
+  // Consts may have consumers outside of the pattern, they are kept while
+  // they do.
+  void RemoveMatchedNodes(std::map<std::string, MatchedNode>& nodes,
+                          Graph* g) {
+    std::vector<Node*> consts;
+    for (auto& it : nodes) {
+      Node* n = g->FindNodeId(it.second.node->id());
+      if (n == nullptr) continue;
+      if (n->type_string() == "Const") {
+        consts.push_back(n);
+      } else {
+        g->RemoveNode(n);
+      }
+    }
+    for (Node* n : consts) {
+      bool used = false;
+      for (const Edge* e : n->out_edges()) {
+        if (!e->IsControlEdge() || !e->dst()->IsSink()) used = true;
+      }
+      if (!used) g->RemoveNode(n);
+    }
+  }
+
+  FusionPattern pattern_;
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPH_TEMPLATE_PATTERN_H_
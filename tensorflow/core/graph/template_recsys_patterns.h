@@ -0,0 +1,175 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// FusionPatterns of common recommendation model blocks that have a fused
+// kernel.
+
+#ifndef TENSORFLOW_CORE_GRAPH_TEMPLATE_RECSYS_PATTERNS_H_
+#define TENSORFLOW_CORE_GRAPH_TEMPLATE_RECSYS_PATTERNS_H_
+
+#include <vector>
+
+#include "tensorflow/core/graph/template_pattern.h"
+
+namespace tensorflow {
+
+// Dice activation of DIN in inference, with frozen moving mean and
+// reciprocal of the moving variance:
+//   p = sigmoid((x - mean) * rvar)
+//   y = alpha * ((1 - p) * x) + p * x
+// 'add_op' is the op of the final sum, Add or AddV2.
+inline FusionPattern DicePattern(const std::string& add_op) {
+  FusionPattern p;
+  p.name = strings::StrCat("dice_", add_op);
+  p.nodes = {
+    {.key = "sub_1", .op = "Sub", .inputs = {"0", "1"},
+     .outputs = {{"mul_1"}}},
+    {.key = "mul_1", .op = "Mul", .inputs = {"sub_1", "2"},
+     .outputs = {{"sigmoid"}}},
+    {.key = "sigmoid", .op = "Sigmoid", .inputs = {"mul_1"},
+     .outputs = {{"sub_2", "mul_4"}}},
+    {.key = "one", .op = "Const", .inputs = {}, .outputs = {{"sub_2"}}},
+    {.key = "sub_2", .op = "Sub", .inputs = {"one", "sigmoid"},
+     .outputs = {{"mul_2"}}},
+    {.key = "mul_2", .op = "Mul", .inputs = {"sub_2", "0"},
+     .outputs = {{"mul_3"}}},
+    {.key = "mul_3", .op = "Mul", .inputs = {"3", "mul_2"},
+     .outputs = {{"add"}}},
+    {.key = "mul_4", .op = "Mul", .inputs = {"sigmoid", "0"},
+     .outputs = {{"add"}}},
+    {.key = "add", .op = add_op, .inputs = {"mul_3", "mul_4"},
+     .outputs = {{"0"}}},
+  };
+  p.first_key = "sub_1";
+  p.num_inputs = 4;
+  p.num_outputs = 1;
+  p.fused_op = "Dice";
+  p.device_key = "add";
+  p.constraints = {
+    pattern::TypeIn("add", "T", {DT_FLOAT}),
+    pattern::OnDevice("add", DEVICE_CPU),
+    pattern::ScalarIn("one", {1.0}),
+    // Dice takes mean and rvar as frozen 1-D constants.
+    pattern::InputIsOp(1, "Const"),
+    pattern::InputIsOp(2, "Const"),
+  };
+  p.attrs = {pattern::CopyAttr("T", "add", "T")};
+  return p;
+}
+
+// tf.nn.l2_normalize over the last dimension:
+//   y = x * rsqrt(maximum(reduce_sum(square(x), -1, keepdims=True), eps))
+inline FusionPattern L2NormalizePattern() {
+  FusionPattern p;
+  p.name = "l2_normalize";
+  p.nodes = {
+    {.key = "square", .op = "Square", .inputs = {"0"},
+     .outputs = {{"sum"}}},
+    {.key = "axis", .op = "Const", .inputs = {}, .outputs = {{"sum"}}},
+    {.key = "sum", .op = "Sum", .inputs = {"square", "axis"},
+     .outputs = {{"maximum"}}},
+    {.key = "epsilon", .op = "Const", .inputs = {},
+     .outputs = {{"maximum"}}},
+    {.key = "maximum", .op = "Maximum", .inputs = {"sum", "epsilon"},
+     .outputs = {{"rsqrt"}}},
+    {.key = "rsqrt", .op = "Rsqrt", .inputs = {"maximum"},
+     .outputs = {{"mul"}}},
+    {.key = "mul", .op = "Mul", .inputs = {"0", "rsqrt"},
+     .outputs = {{"0"}}},
+  };
+  p.first_key = "square";
+  p.num_inputs = 1;
+  p.num_outputs = 1;
+  p.fused_op = "FusedL2Normalize";
+  p.device_key = "mul";
+  p.constraints = {
+    pattern::TypeIn("mul", "T", {DT_FLOAT}),
+    pattern::OnDevice("mul", DEVICE_CPU),
+    pattern::BoolAttrIs("sum", "keep_dims", true),
+    // FusedL2Normalize always normalizes over the last dimension.
+    pattern::ScalarIn("axis", {-1}),
+  };
+  p.attrs = {
+    pattern::CopyAttr("T", "mul", "T"),
+    pattern::IntFromScalar("axis", "axis"),
+    pattern::FloatFromScalar("epsilon", "epsilon"),
+  };
+  return p;
+}
+
+// Target attention of DIN and DIEN, mapped to TargetAttention:
+//   paddings = ones_like(scores) * padding
+//   scores = where(expand_dims(mask, 1), scores, paddings)
+//   output = matmul(softmax(scores), facts)
+// 'matmul_op' is BatchMatMul or BatchMatMulV2.
+inline FusionPattern TargetAttentionPattern(const std::string& matmul_op) {
+  FusionPattern p;
+  p.name = strings::StrCat("target_attention_", matmul_op);
+  p.nodes = {
+    {.key = "expand_dim", .op = "Const", .inputs = {},
+     .outputs = {{"expand"}}},
+    {.key = "expand", .op = "ExpandDims", .inputs = {"2", "expand_dim"},
+     .outputs = {{"select"}}},
+    {.key = "shape", .op = "Shape", .inputs = {"0"}, .outputs = {{"fill"}}},
+    {.key = "one", .op = "Const", .inputs = {}, .outputs = {{"fill"}}},
+    {.key = "fill", .op = "Fill", .inputs = {"shape", "one"},
+     .outputs = {{"paddings"}}},
+    {.key = "padding", .op = "Const", .inputs = {},
+     .outputs = {{"paddings"}}},
+    {.key = "paddings", .op = "Mul", .inputs = {"fill", "padding"},
+     .outputs = {{"select"}}},
+    {.key = "select", .op = "Select", .inputs = {"expand", "0", "paddings"},
+     .outputs = {{"softmax"}}},
+    {.key = "softmax", .op = "Softmax", .inputs = {"select"},
+     .outputs = {{"matmul"}}},
+    {.key = "matmul", .op = matmul_op, .inputs = {"softmax", "1"},
+     .outputs = {{"0"}}},
+  };
+  p.first_key = "softmax";
+  p.num_inputs = 3;
+  p.num_outputs = 1;
+  p.fused_op = "TargetAttention";
+  p.device_key = "matmul";
+  p.constraints = {
+    pattern::TypeIn("matmul", "T", {DT_FLOAT}),
+    pattern::OnDevice("matmul", DEVICE_CPU),
+    pattern::BoolAttrIs("matmul", "adj_x", false),
+    pattern::BoolAttrIs("matmul", "adj_y", false),
+    pattern::ScalarIn("expand_dim", {1}),
+    pattern::ScalarIn("one", {1}),
+  };
+  p.attrs = {
+    pattern::CopyAttr("T", "matmul", "T"),
+    pattern::FloatFromScalar("padding", "padding"),
+  };
+  return p;
+}
+
+inline std::vector<FusionPattern> RecsysFusionPatterns() {
+  std::vector<FusionPattern> patterns;
+  // The Dice kernel is only built with AVX512.
+#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
+  patterns.push_back(DicePattern("Add"));
+  patterns.push_back(DicePattern("AddV2"));
+#endif
+  patterns.push_back(L2NormalizePattern());
+  patterns.push_back(TargetAttentionPattern("BatchMatMul"));
+  patterns.push_back(TargetAttentionPattern("BatchMatMulV2"));
+  return patterns;
+}
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPH_TEMPLATE_RECSYS_PATTERNS_H_
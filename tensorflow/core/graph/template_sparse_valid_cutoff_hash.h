@@ -0,0 +1,138 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPH_TEMPLATE_SPARSE_VALID_CUTOFF_HASH_H_
+#define TENSORFLOW_CORE_GRAPH_TEMPLATE_SPARSE_VALID_CUTOFF_HASH_H_
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/graph/template_base.h"
+#include "tensorflow/core/util/device_name_utils.h"
+
+namespace tensorflow {
+
+// Hashes the values of a string SparseTensor after the cutoff, the pattern
+// built by a cutoff_categorical_column of a hash bucket column:
+//   ids = StringToHashBucketFast(values)
+//   SparseValidCutoff(indices, ids, dense_shape)
+// is replaced by SparseValidCutoffToHashBucketFast(indices, values,
+// dense_shape), which hashes only the values kept by the cutoff.
+class TemplateSparseValidCutoffHash : public TemplateBase {
+ public:
+  TemplateSparseValidCutoffHash() {
+    const TempNode n0 = {
+      .key = "hash",
+      .op = "StringToHashBucketFast",
+      .inputs = {"1"},
+      .outputs = {{"cutoff"}}
+    };
+    temp_nodes_.emplace_back(n0);
+
+    const TempNode n1 = {
+      .key = "cutoff",
+      .op = "SparseValidCutoff",
+      .inputs = {"0", "hash", "2"},
+      .outputs = {{"0"}, {"1"}, {"2"}}
+    };
+    temp_nodes_.emplace_back(n1);
+
+    first_key_ = "hash";
+    num_inputs_ = 3;
+    num_outputs_ = 3;
+  }
+
+  const string name() {
+    return "sparse_valid_cutoff_hash";
+  }
+
+  bool add_subgraph(std::map<std::string, MatchedNode>& nodes,
+      std::string name_prefix, Graph* g,
+      std::vector<const Edge*>& inputs,
+      std::vector<std::vector<const Edge*>>& outputs) override {
+    const Node* hash = nodes["hash"].node;
+    const Node* cutoff = nodes["cutoff"].node;
+    // SparseValidCutoffToHashBucketFast has only a CPU kernel.
+    if (!IsOnCPU(hash) || !IsOnCPU(cutoff)) {
+      return false;
+    }
+    int64 num_buckets;
+    int64 axis;
+    int64 length;
+    string side;
+    if (!GetNodeAttr(hash->attrs(), "num_buckets", &num_buckets).ok() ||
+        !GetNodeAttr(cutoff->attrs(), "axis", &axis).ok() ||
+        !GetNodeAttr(cutoff->attrs(), "length", &length).ok() ||
+        !GetNodeAttr(cutoff->attrs(), "side", &side).ok()) {
+      return false;
+    }
+
+    NodeDef fused_def;
+    fused_def.set_op("SparseValidCutoffToHashBucketFast");
+    fused_def.set_name(name_prefix + "_" + name());
+    fused_def.set_device(cutoff->def().device());
+    for (int i = 0; i < num_inputs_; ++i) {
+      add_input(fused_def, inputs[i]);
+    }
+    AddNodeAttr("num_buckets", num_buckets, &fused_def);
+    AddNodeAttr("axis", axis, &fused_def);
+    AddNodeAttr("length", length, &fused_def);
+    AddNodeAttr("side", side, &fused_def);
+
+    Status status;
+    Node* fused_node = g->AddNode(fused_def, &status);
+    if (status != Status::OK()) {
+      VLOG(1) << status.error_message();
+      return false;
+    }
+    fused_node->set_assigned_device_name(cutoff->assigned_device_name());
+
+    for (int i = 0; i < num_inputs_; ++i) {
+      add_iedge(g, fused_node, i, inputs[i]);
+    }
+    for (int i = 0; i < num_outputs_; ++i) {
+      add_oedges(g, fused_node, i, outputs[i]);
+    }
+    return true;
+  }
+
+  bool CheckDynamicInputs(
+      const Node* node, const TempNode* temp_node, int dy_mode,
+      std::vector<const Edge*>& fused_op_inputs,
+      std::map<const std::string, TempNode>& temp_node_map,
+      std::map<std::string, MatchedNode>& matched_node_map) override {
+    return false;
+  }
+
+  bool CheckDynamicOutputs(
+      const Node* node, const TempNode* temp_node, int dy_mode,
+      std::vector<std::vector<const Edge*>>& fused_op_outputs,
+      std::map<const std::string, TempNode>& temp_node_map,
+      std::map<std::string, MatchedNode>& matched_node_map) override {
+    return false;
+  }
+
+ private:
+  static bool IsOnCPU(const Node* node) {
+    const string& device = node->assigned_device_name().empty() ?
+        node->requested_device() : node->assigned_device_name();
+    DeviceNameUtils::ParsedName parsed;
+    if (device.empty() || !DeviceNameUtils::ParseFullName(device, &parsed)) {
+      return device.empty();
+    }
+    return !parsed.has_type || parsed.type == DEVICE_CPU;
+  }
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_GRAPH_TEMPLATE_SPARSE_VALID_CUTOFF_HASH_H_
@@ -0,0 +1,183 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPH_TEMPLATE_UNIQUE_SEGMENT_SUM_H_
+#define TENSORFLOW_CORE_GRAPH_TEMPLATE_UNIQUE_SEGMENT_SUM_H_
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/template_base.h"
+#include "tensorflow/core/util/device_name_utils.h"
+
+namespace tensorflow {
+
+// Sums the gradient rows of the same ids of a sparse gradient, the pattern
+// built by _deduplicate_indexed_slices of the optimizers:
+//   y, idx = Unique(ids)
+//   output = UnsortedSegmentSum(data, idx, StridedSlice(Shape(y)))
+// is replaced by output, y = UniqueSegmentSum(data, ids).
+class TemplateUniqueSegmentSum : public TemplateBase {
+ public:
+  TemplateUniqueSegmentSum() {
+    const TempNode n0 = {
+      .key = "unique",
+      .op = "Unique",
+      .inputs = {"1"},
+      .outputs = {{"shape", "1"}, {"segment_sum"}}
+    };
+    temp_nodes_.emplace_back(n0);
+
+    const TempNode n1 = {
+      .key = "shape",
+      .op = "Shape",
+      .inputs = {"unique"},
+      .outputs = {{"strided_slice"}}
+    };
+    temp_nodes_.emplace_back(n1);
+
+    const TempNode n2 = {
+      .key = "const_begin",
+      .op = "Const",
+      .inputs = {},
+      .outputs = {{"strided_slice"}}
+    };
+    temp_nodes_.emplace_back(n2);
+
+    const TempNode n3 = {
+      .key = "const_end",
+      .op = "Const",
+      .inputs = {},
+      .outputs = {{"strided_slice"}}
+    };
+    temp_nodes_.emplace_back(n3);
+
+    const TempNode n4 = {
+      .key = "const_strides",
+      .op = "Const",
+      .inputs = {},
+      .outputs = {{"strided_slice"}}
+    };
+    temp_nodes_.emplace_back(n4);
+
+    const TempNode n5 = {
+      .key = "strided_slice",
+      .op = "StridedSlice",
+      .inputs = {"shape", "const_begin", "const_end", "const_strides"},
+      .outputs = {{"segment_sum"}}
+    };
+    temp_nodes_.emplace_back(n5);
+
+    const TempNode n6 = {
+      .key = "segment_sum",
+      .op = "UnsortedSegmentSum",
+      .inputs = {"0", "unique", "strided_slice"},
+      .outputs = {{"0"}}
+    };
+    temp_nodes_.emplace_back(n6);
+
+    first_key_ = "unique";
+    num_inputs_ = 2;
+    num_outputs_ = 2;
+  }
+
+  const string name() {
+    return "unique_segment_sum";
+  }
+
+  bool add_subgraph(std::map<std::string, MatchedNode>& nodes,
+      std::string name_prefix, Graph* g,
+      std::vector<const Edge*>& inputs,
+      std::vector<std::vector<const Edge*>>& outputs) override {
+    const Node* unique = nodes["unique"].node;
+    const Node* shape = nodes["shape"].node;
+    const Node* segment_sum = nodes["segment_sum"].node;
+    // UniqueSegmentSum has only CPU kernels of real numbers.
+    if (!IsOnCPU(unique) || !IsOnCPU(segment_sum)) {
+      reject_reason_ = "not on CPU";
+      return false;
+    }
+    DataType data_type;
+    DataType ids_type;
+    if (!GetNodeAttr(segment_sum->attrs(), "T", &data_type).ok() ||
+        !GetNodeAttr(unique->attrs(), "T", &ids_type).ok() ||
+        !RealNumberTypes().Contains(data_type) ||
+        (ids_type != DT_INT32 && ids_type != DT_INT64)) {
+      reject_reason_ = "unsupported type";
+      return false;
+    }
+
+    NodeDef fused_def;
+    fused_def.set_op("UniqueSegmentSum");
+    fused_def.set_name(name_prefix + "_" + name());
+    fused_def.set_device(segment_sum->def().device());
+    add_input(fused_def, inputs[0]);
+    add_input(fused_def, inputs[1]);
+    AddNodeAttr("T", data_type, &fused_def);
+    AddNodeAttr("Tindices", ids_type, &fused_def);
+
+    Status status;
+    Node* fused_node = g->AddNode(fused_def, &status);
+    if (status != Status::OK()) {
+      VLOG(1) << status.error_message();
+      return false;
+    }
+    fused_node->set_assigned_device_name(
+        segment_sum->assigned_device_name());
+
+    add_iedge(g, fused_node, 0, inputs[0]);
+    add_iedge(g, fused_node, 1, inputs[1]);
+    add_oedges(g, fused_node, 0, outputs[0]);
+    // The unique ids feed Shape of the pattern besides the outputs, Shape
+    // is removed with the pattern.
+    std::vector<const Edge*> unique_oedges;
+    for (auto* oedge : outputs[1]) {
+      if (oedge->dst() != shape) {
+        unique_oedges.push_back(oedge);
+      }
+    }
+    add_oedges(g, fused_node, 1, unique_oedges);
+    return true;
+  }
+
+  bool CheckDynamicInputs(
+      const Node* node, const TempNode* temp_node, int dy_mode,
+      std::vector<const Edge*>& fused_op_inputs,
+      std::map<const std::string, TempNode>& temp_node_map,
+      std::map<std::string, MatchedNode>& matched_node_map) override {
+    return false;
+  }
+
+  bool CheckDynamicOutputs(
+      const Node* node, const TempNode* temp_node, int dy_mode,
+      std::vector<std::vector<const Edge*>>& fused_op_outputs,
+      std::map<const std::string, TempNode>& temp_node_map,
+      std::map<std::string, MatchedNode>& matched_node_map) override {
+    return false;
+  }
+
+ private:
+  static bool IsOnCPU(const Node* node) {
+    const string& device = node->assigned_device_name().empty() ?
+        node->requested_device() : node->assigned_device_name();
+    DeviceNameUtils::ParsedName parsed;
+    if (device.empty() || !DeviceNameUtils::ParseFullName(device, &parsed)) {
+      return device.empty();
+    }
+    return !parsed.has_type || parsed.type == DEVICE_CPU;
+  }
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_GRAPH_TEMPLATE_UNIQUE_SEGMENT_SUM_H_
@@ -0,0 +1,271 @@
+#include "tensorflow/core/grappler/optimizers/cross_layer_fusion.h"
+
+#include <set>
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils/graph_view.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace crosslayerfusion {
+
+typedef utils::MutableNodeView NodeView;
+
+struct CrossLayerPattern {
+  int mul_xw_id = -1;
+  int sum_id = -1;
+  int mul_x0_id = -1;
+  int add_b_id = -1;
+  int add_xl_id = -1;
+  // Input ports of mul_x0, add_b and mul_xw that x0, b and w come from.
+  int x0_port = -1;
+  int b_port = -1;
+  int w_port = -1;
+};
+
+// Whether the node is a float op of the given type, on CPU, without
+// control dependencies.
+bool IsFusable(const NodeView* node_view, bool (*func)(const NodeDef& node)) {
+  const NodeDef* node = node_view->node();
+  return func(*node) && NodeIsOnCpu(node) &&
+         GetDataTypeFromAttr(*node, "T") == DT_FLOAT &&
+         node_view->NumRegularFanins() == 2 &&
+         node_view->NumControllingFanins() == 0 &&
+         node_view->NumControlledFanouts() == 0;
+}
+
+// Whether the node only feeds one input of one other node.
+bool HasSingleFanout(const NodeView* node_view) {
+  return node_view->NumRegularFanouts() == 1 &&
+         node_view->GetRegularFanout(0).size() == 1;
+}
+
+bool SameTensor(const utils::MutableFanoutView& a,
+                const utils::MutableFanoutView& b) {
+  return a.node_index() == b.node_index() && a.index() == b.index();
+}
+
+// Whether the node is a constant axis of the last dimension of a matrix.
+bool IsLastAxisOfMatrix(const NodeView* node_view) {
+  const NodeDef* node = node_view->node();
+  if (!IsConstant(*node) || !HasNodeAttr(*node, "value")) return false;
+  Tensor axis;
+  if (!axis.FromProto(node->attr().at("value").tensor()) ||
+      axis.NumElements() != 1) {
+    return false;
+  }
+  int64 value;
+  if (axis.dtype() == DT_INT32) {
+    value = axis.flat<int32>()(0);
+  } else if (axis.dtype() == DT_INT64) {
+    value = axis.flat<int64>()(0);
+  } else {
+    return false;
+  }
+  return value == 1 || value == -1;
+}
+
+// Matches Sum(Mul(xl, w), axis=1, keep_dims=true) for the given xl.
+bool MatchCrossProduct(const utils::MutableGraphView& graph_view, int sum_id,
+                       const utils::MutableFanoutView& xl,
+                       CrossLayerPattern* pattern) {
+  const NodeView* sum = graph_view.GetNode(sum_id);
+  const NodeDef* sum_node = sum->node();
+  if (!IsSum(*sum_node) || !HasSingleFanout(sum) ||
+      sum->NumRegularFanins() != 2 || sum->NumControllingFanins() > 0 ||
+      sum->NumControlledFanouts() > 0 ||
+      !HasNodeAttr(*sum_node, "keep_dims") ||
+      !sum_node->attr().at("keep_dims").b() ||
+      !IsLastAxisOfMatrix(sum->GetRegularFanin(1).node_view())) {
+    return false;
+  }
+  const auto& mul_xw = sum->GetRegularFanin(0);
+  if (mul_xw.index() != 0 || !IsFusable(mul_xw.node_view(), IsMul) ||
+      !HasSingleFanout(mul_xw.node_view())) {
+    return false;
+  }
+  for (int port = 0; port < 2; port++) {
+    if (SameTensor(mul_xw.node_view()->GetRegularFanin(port), xl)) {
+      pattern->sum_id = sum_id;
+      pattern->mul_xw_id = mul_xw.node_index();
+      pattern->w_port = 1 - port;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Matches Add(Add(Mul(x0, xw), b), xl) from its last Add.
+bool FindCrossLayerPattern(const utils::MutableGraphView& graph_view,
+                           int node_index, CrossLayerPattern* matched) {
+  const NodeView* add_xl = graph_view.GetNode(node_index);
+  if (!IsFusable(add_xl, IsAdd)) return false;
+  for (int add_b_port = 0; add_b_port < 2; add_b_port++) {
+    const auto& add_b = add_xl->GetRegularFanin(add_b_port);
+    const auto& xl = add_xl->GetRegularFanin(1 - add_b_port);
+    if (add_b.index() != 0 || !IsFusable(add_b.node_view(), IsAdd) ||
+        !HasSingleFanout(add_b.node_view())) {
+      continue;
+    }
+    for (int mul_x0_port = 0; mul_x0_port < 2; mul_x0_port++) {
+      const auto& mul_x0 = add_b.node_view()->GetRegularFanin(mul_x0_port);
+      if (mul_x0.index() != 0 || !IsFusable(mul_x0.node_view(), IsMul) ||
+          !HasSingleFanout(mul_x0.node_view())) {
+        continue;
+      }
+      for (int sum_port = 0; sum_port < 2; sum_port++) {
+        const auto& sum = mul_x0.node_view()->GetRegularFanin(sum_port);
+        CrossLayerPattern pattern;
+        if (sum.index() == 0 &&
+            MatchCrossProduct(graph_view, sum.node_index(), xl, &pattern)) {
+          pattern.mul_x0_id = mul_x0.node_index();
+          pattern.add_b_id = add_b.node_index();
+          pattern.add_xl_id = node_index;
+          pattern.x0_port = 1 - sum_port;
+          pattern.b_port = 1 - mul_x0_port;
+          *matched = pattern;
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+bool DimsCompatible(int64 a, int64 b) { return a < 0 || b < 0 || a == b; }
+
+// Whether the inputs are shaped as FusedCrossLayer requires: x0 and xl
+// matrices of the same shape, w and b vectors of their width. Unknown
+// dimensions are assumed to match.
+bool HasCrossLayerShapes(const GraphProperties& properties,
+                         const GraphDef& graph,
+                         const CrossLayerPattern& pattern) {
+  auto input_shape = [&](int node_id, int port, TensorShapeProto* shape) {
+    const string& name = graph.node(node_id).name();
+    if (!properties.HasInputProperties(name)) return false;
+    const auto& props = properties.GetInputProperties(name);
+    if (port >= props.size() || props[port].shape().unknown_rank()) {
+      return false;
+    }
+    *shape = props[port].shape();
+    return true;
+  };
+  TensorShapeProto x0, xl, w, b;
+  if (!input_shape(pattern.mul_x0_id, pattern.x0_port, &x0) ||
+      !input_shape(pattern.mul_xw_id, 1 - pattern.w_port, &xl) ||
+      !input_shape(pattern.mul_xw_id, pattern.w_port, &w) ||
+      !input_shape(pattern.add_b_id, pattern.b_port, &b)) {
+    return false;
+  }
+  if (x0.dim_size() != 2 || xl.dim_size() != 2 || w.dim_size() != 1 ||
+      b.dim_size() != 1) {
+    return false;
+  }
+  const int64 dim = xl.dim(1).size();
+  return DimsCompatible(x0.dim(0).size(), xl.dim(0).size()) &&
+         DimsCompatible(x0.dim(1).size(), dim) &&
+         DimsCompatible(w.dim(0).size(), dim) &&
+         DimsCompatible(b.dim(0).size(), dim);
+}
+}  // namespace crosslayerfusion
+
+Status CrossLayerFusion::Optimize(Cluster* cluster, const GrapplerItem& item,
+                                  GraphDef* output) {
+  *output = item.graph;
+  Status status;
+  utils::MutableGraphView graph_view(output, &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(graph_view.SortTopologically(/*ignore_cycles=*/false, {}));
+  const int num_nodes = item.graph.node_size();
+  const GraphDef* graph = graph_view.graph();
+  const std::set<string> nodes_to_preserve = item.NodesToPreserve();
+
+  std::vector<crosslayerfusion::CrossLayerPattern> patterns;
+  for (int i = 0; i < num_nodes; ++i) {
+    crosslayerfusion::CrossLayerPattern pattern;
+    if (!crosslayerfusion::FindCrossLayerPattern(graph_view, i, &pattern)) {
+      continue;
+    }
+    bool preserved = false;
+    for (int id : {pattern.mul_xw_id, pattern.sum_id, pattern.mul_x0_id,
+                   pattern.add_b_id}) {
+      preserved |= nodes_to_preserve.count(graph->node(id).name()) > 0;
+    }
+    if (!preserved) {
+      patterns.push_back(pattern);
+    }
+  }
+  if (patterns.empty()) {
+    return Status::OK();
+  }
+
+  GraphProperties properties(item);
+  TF_RETURN_IF_ERROR(properties.InferStatically(
+      /*assume_valid_feeds=*/false,
+      /*aggressive_shape_inference=*/false,
+      /*include_input_tensor_values=*/false,
+      /*include_output_tensor_values=*/false));
+
+  // Nodes of a pattern already fused, which a later match can't reuse.
+  std::vector<bool> fused(num_nodes);
+  std::vector<bool> nodes_to_delete(num_nodes);
+  utils::Mutation* mutation = graph_view.GetMutationBuilder();
+  for (const auto& pattern : patterns) {
+    const std::vector<int> ids = {pattern.mul_xw_id, pattern.sum_id,
+                                  pattern.mul_x0_id, pattern.add_b_id,
+                                  pattern.add_xl_id};
+    bool overlaps = false;
+    for (int id : ids) {
+      overlaps |= fused[id];
+    }
+    if (overlaps ||
+        !crosslayerfusion::HasCrossLayerShapes(properties, *graph, pattern)) {
+      continue;
+    }
+    for (int id : ids) {
+      fused[id] = true;
+    }
+    const NodeDef& add_xl = graph->node(pattern.add_xl_id);
+    const NodeDef& mul_xw = graph->node(pattern.mul_xw_id);
+    VLOG(2) << "Fusing cross layer " << add_xl.name();
+
+    // The fused node replaces the last Add.
+    NodeDef cross;
+    cross.set_name(add_xl.name());
+    cross.set_op("FusedCrossLayer");
+    cross.set_device(add_xl.device());
+    cross.add_input(graph->node(pattern.mul_x0_id).input(pattern.x0_port));
+    cross.add_input(mul_xw.input(1 - pattern.w_port));
+    cross.add_input(mul_xw.input(pattern.w_port));
+    cross.add_input(graph->node(pattern.add_b_id).input(pattern.b_port));
+    (*cross.mutable_attr())["T"] = add_xl.attr().at("T");
+    mutation->AddNode(std::move(cross), &status);
+    TF_RETURN_IF_ERROR(status);
+
+    for (int id : {pattern.mul_xw_id, pattern.sum_id, pattern.mul_x0_id,
+                   pattern.add_b_id}) {
+      nodes_to_delete[id] = true;
+    }
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    if (nodes_to_delete[i]) {
+      mutation->RemoveNode(graph_view.GetNode(i));
+    }
+  }
+  TF_RETURN_IF_ERROR(mutation->Apply());
+  *output = *graph_view.graph();
+
+  return Status::OK();
+}
+
+void CrossLayerFusion::Feedback(Cluster* cluster, const GrapplerItem& item,
+                                const GraphDef& optimize_output,
+                                double result) {
+  // Nothing to do for CrossLayerFusion.
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,38 @@
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_CROSS_LAYER_FUSION_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_CROSS_LAYER_FUSION_H_
+
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Fuses the cross layers of DCN into FusedCrossLayer ops for inference:
+//
+//   xw = Sum(Mul(xl, w), axis=1, keep_dims=true)
+//   y = Add(Add(Mul(x0, xw), b), xl)
+//
+// with x0 and xl matrices and w and b vectors. The Mul, Sum and Add nodes
+// in between must only feed the next node of the pattern.
+class CrossLayerFusion : public GraphOptimizer {
+ public:
+  CrossLayerFusion() = default;
+  explicit CrossLayerFusion(RewriterConfig::Toggle opt_level) {}
+  ~CrossLayerFusion() override {}
+
+  string name() const override { return "cross_layer_fusion"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* output) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimize_output, double result) override;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_CROSS_LAYER_FUSION_H_
@@ -0,0 +1,105 @@
+#include "tensorflow/core/grappler/optimizers/cross_layer_fusion.h"
+
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace tensorflow {
+namespace grappler {
+
+class CrossLayerFusionTest : public GrapplerTest {
+ protected:
+  // The cross layer of the DCN model zoo:
+  //   xw = reduce_sum(xl * w, axis=1, keepdims=True)
+  //   y = x0 * xw + b + xl
+  static std::vector<NodeDef> CrossLayer(const string& name, const string& x0,
+                                         const string& xl) {
+    using test::function::NDef;
+    return {
+        NDef(name + "/mul_xw", "Mul", {xl, "w"}, {{"T", DT_FLOAT}}),
+        NDef(name + "/sum", "Sum", {name + "/mul_xw", "axis"},
+             {{"T", DT_FLOAT}, {"Tidx", DT_INT32}, {"keep_dims", true}}),
+        NDef(name + "/mul_x0", "Mul", {x0, name + "/sum"}, {{"T", DT_FLOAT}}),
+        NDef(name + "/add_b", "AddV2", {name + "/mul_x0", "b"},
+             {{"T", DT_FLOAT}}),
+        NDef(name, "AddV2", {name + "/add_b", xl}, {{"T", DT_FLOAT}}),
+    };
+  }
+
+  static GrapplerItem MakeItem(const std::vector<NodeDef>& layers) {
+    using test::function::NDef;
+    GrapplerItem item;
+    item.fetch = {"out"};
+    std::vector<NodeDef> nodes = {
+        NDef("x", "Placeholder", {},
+             {{"dtype", DT_FLOAT}, {"shape", TensorShape({4, 3})}}),
+        NDef("w", "Const", {},
+             {{"dtype", DT_FLOAT},
+              {"value", test::AsTensor<float>({1.0, 2.0, 3.0})}}),
+        NDef("b", "Const", {},
+             {{"dtype", DT_FLOAT},
+              {"value", test::AsTensor<float>({0.5, 0.5, 0.5})}}),
+        NDef("axis", "Const", {},
+             {{"dtype", DT_INT32}, {"value", test::AsScalar<int32>(1)}}),
+    };
+    nodes.insert(nodes.end(), layers.begin(), layers.end());
+    item.graph = test::function::GDef(nodes);
+    return item;
+  }
+};
+
+TEST_F(CrossLayerFusionTest, FuseCrossLayers) {
+  using test::function::NDef;
+  std::vector<NodeDef> layers = CrossLayer("cross0", "x", "x");
+  for (const NodeDef& node : CrossLayer("cross1", "x", "cross0")) {
+    layers.push_back(node);
+  }
+  layers.push_back(NDef("out", "Identity", {"cross1"}, {{"T", DT_FLOAT}}));
+  GrapplerItem item = MakeItem(layers);
+
+  CrossLayerFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_EQ(node.name().find("/"), string::npos) << node.name();
+    if (node.name() == "cross1") {
+      found++;
+      EXPECT_EQ(node.op(), "FusedCrossLayer");
+      ASSERT_EQ(node.input_size(), 4);
+      EXPECT_EQ(node.input(0), "x");
+      EXPECT_EQ(node.input(1), "cross0");
+      EXPECT_EQ(node.input(2), "w");
+      EXPECT_EQ(node.input(3), "b");
+    } else if (node.name() == "cross0") {
+      found++;
+      EXPECT_EQ(node.op(), "FusedCrossLayer");
+    }
+  }
+  EXPECT_EQ(found, 2);
+}
+
+TEST_F(CrossLayerFusionTest, KeepSharedProduct) {
+  using test::function::NDef;
+  std::vector<NodeDef> layers = CrossLayer("cross", "x", "x");
+  // The product is also fetched, so the layer is not fused.
+  layers.push_back(NDef("out", "Identity", {"cross/sum"}, {{"T", DT_FLOAT}}));
+  layers.push_back(NDef("out2", "Identity", {"cross"}, {{"T", DT_FLOAT}}));
+  GrapplerItem item = MakeItem(layers);
+
+  CrossLayerFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "cross") {
+      EXPECT_EQ(node.op(), "AddV2");
+    }
+  }
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -40,8 +40,11 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/pin_to_host_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/remapper.h"
 #include "tensorflow/core/grappler/optimizers/concat_cast_fusing.h"
+#include "tensorflow/core/grappler/optimizers/cross_layer_fusion.h"
 #include "tensorflow/core/grappler/optimizers/multi_stream_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/dice_fusion.h"
+#include "tensorflow/core/grappler/optimizers/mlp_fusion.h"
+#include "tensorflow/core/grappler/optimizers/multi_expert_fusion.h"
 #include "tensorflow/core/grappler/optimizers/scoped_allocator_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/shape_optimizer.h"
 #include "tensorflow/core/grappler/utils/canonicalizer.h"
@@ -188,6 +191,35 @@ bool DiceFusionEnabled() {
   return is_enabled && is_inference;
 }
 
+// A helper function to decide whether to enable the MLP fusion optimizer.
+bool MLPFusionEnabled() {
+  bool is_enabled = true;
+  bool is_inference = false;
+  TF_CHECK_OK(ReadBoolFromEnvVar("TF_MLP_FUSION", true, &is_enabled));
+  TF_CHECK_OK(ReadBoolFromEnvVar("INFERENCE_MODE", false, &is_inference));
+  return is_enabled && is_inference;
+}
+
+// A helper function to decide whether to enable the cross layer fusion
+// optimizer.
+bool CrossLayerFusionEnabled() {
+  bool is_enabled = true;
+  bool is_inference = false;
+  TF_CHECK_OK(ReadBoolFromEnvVar("TF_CROSS_LAYER_FUSION", true, &is_enabled));
+  TF_CHECK_OK(ReadBoolFromEnvVar("INFERENCE_MODE", false, &is_inference));
+  return is_enabled && is_inference;
+}
+
+// A helper function to decide whether to enable the multi-expert fusion
+// optimizer.
+bool MultiExpertFusionEnabled() {
+  bool is_enabled = true;
+  bool is_inference = false;
+  TF_CHECK_OK(ReadBoolFromEnvVar("TF_MULTI_EXPERT_FUSION", true, &is_enabled));
+  TF_CHECK_OK(ReadBoolFromEnvVar("INFERENCE_MODE", false, &is_inference));
+  return is_enabled && is_inference;
+}
+
 }  // namespace
 
 #define MK_OPT(NAME, VALUE) \
@@ -224,6 +256,9 @@ std::unique_ptr<GraphOptimizer> MetaOptimizer::MakeNewOptimizer(
   MK_OPT("pin_to_host",
          new PinToHostOptimizer(cfg_.pin_to_host_optimization()));
   MK_OPT("dice_fusion", new DiceFusion());
+  MK_OPT("mlp_fusion", new MLPFusion());
+  MK_OPT("cross_layer_fusion", new CrossLayerFusion());
+  MK_OPT("multi_expert_fusion", new MultiExpertFusion());
   MK_OPT("concat_cast_fusing", new ConcatCastFusing());
   MK_OPT("use_multi_stream",
          new MultiStreamOptimizer(cfg_.multi_stream_opts()));
@@ -325,6 +360,16 @@ Status MetaOptimizer::InitializeOptimizers(
   if (DiceFusionEnabled()) {
     optimizers->push_back(MakeUnique<DiceFusion>());
   }
+  // Before mlp_fusion, which would fuse the layers of each expert alone.
+  if (MultiExpertFusionEnabled()) {
+    optimizers->push_back(MakeUnique<MultiExpertFusion>());
+  }
+  if (MLPFusionEnabled()) {
+    optimizers->push_back(MakeUnique<MLPFusion>());
+  }
+  if (CrossLayerFusionEnabled()) {
+    optimizers->push_back(MakeUnique<CrossLayerFusion>());
+  }
   optimizers->push_back(MakeUnique<ConcatCastFusing>());
   return InitializeCustomGraphOptimizers(std::set<string>(), optimizers);
 }
@@ -0,0 +1,152 @@
+#include "tensorflow/core/grappler/optimizers/mlp_fusion.h"
+
+#include <set>
+
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils/graph_view.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace mlpfusion {
+
+// Returns the activation of a dense layer that FusedMLP can run, or an
+// empty string.
+string GetLayerActivation(const utils::MutableGraphView& graph_view,
+                          int node_index) {
+  const auto* node_view = graph_view.GetNode(node_index);
+  const NodeDef* node = node_view->node();
+  if (node->op() != "_FusedMatMul" || node_view->NumRegularFanins() != 3 ||
+      node_view->NumControllingFanins() > 0 ||
+      node_view->NumControlledFanouts() > 0) {
+    return "";
+  }
+  if (GetDataTypeFromAttr(*node, "T") != DT_FLOAT ||
+      (HasNodeAttr(*node, "transpose_a") &&
+       node->attr().at("transpose_a").b()) ||
+      (HasNodeAttr(*node, "transpose_b") &&
+       node->attr().at("transpose_b").b())) {
+    return "";
+  }
+  for (int i = 1; i < 3; i++) {
+    if (!IsConstant(*node_view->GetRegularFanin(i).node_view()->node())) {
+      return "";
+    }
+  }
+  if (!HasNodeAttr(*node, "fused_ops")) {
+    return "";
+  }
+  const auto& fused_ops = node->attr().at("fused_ops").list().s();
+  if (fused_ops.size() == 1 && fused_ops[0] == "BiasAdd") {
+    return "Identity";
+  }
+  if (fused_ops.size() == 2 && fused_ops[0] == "BiasAdd" &&
+      fused_ops[1] == "Relu") {
+    return "Relu";
+  }
+  return "";
+}
+
+// Returns the layer fed only by the layer node_index, or -1.
+int GetNextLayer(const utils::MutableGraphView& graph_view, int node_index) {
+  const auto* node_view = graph_view.GetNode(node_index);
+  if (node_view->NumRegularFanouts() != 1 ||
+      node_view->GetRegularFanout(0).size() != 1) {
+    return -1;
+  }
+  const auto& fanout = node_view->GetRegularFanout(0)[0];
+  if (fanout.index() != 0 ||
+      fanout.node_view()->GetOp() != node_view->GetOp() ||
+      fanout.node_view()->GetDevice() != node_view->GetDevice() ||
+      GetLayerActivation(graph_view, fanout.node_index()).empty()) {
+    return -1;
+  }
+  return fanout.node_index();
+}
+}  // namespace mlpfusion
+
+Status MLPFusion::Optimize(Cluster* cluster, const GrapplerItem& item,
+                           GraphDef* output) {
+  *output = item.graph;
+  Status status;
+  utils::MutableGraphView graph_view(output, &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(graph_view.SortTopologically(/*ignore_cycles=*/false, {}));
+  const int num_nodes = item.graph.node_size();
+  // Layers in a chain found from a former node.
+  std::vector<bool> fused(num_nodes);
+  std::vector<bool> nodes_to_delete(num_nodes);
+  std::vector<NodeDef> mlps;
+  const GraphDef* graph = graph_view.graph();
+  const std::set<string> nodes_to_preserve = item.NodesToPreserve();
+
+  for (int i = 0; i < num_nodes; ++i) {
+    if (fused[i]) continue;
+    string activation = mlpfusion::GetLayerActivation(graph_view, i);
+    if (activation.empty()) continue;
+
+    std::vector<int> layers = {i};
+    std::vector<string> activations = {activation};
+    while (nodes_to_preserve.count(graph->node(layers.back()).name()) == 0) {
+      int next = mlpfusion::GetNextLayer(graph_view, layers.back());
+      if (next < 0) break;
+      layers.push_back(next);
+      activations.push_back(mlpfusion::GetLayerActivation(graph_view, next));
+    }
+    if (layers.size() < 2) continue;
+
+    const NodeDef& first = graph->node(layers.front());
+    const NodeDef& last = graph->node(layers.back());
+    VLOG(2) << "Fusing " << layers.size() << " dense layers from "
+            << first.name() << " to " << last.name();
+
+    // The fused node replaces the last layer.
+    NodeDef mlp;
+    mlp.set_name(last.name());
+    mlp.set_op("FusedMLP");
+    mlp.set_device(last.device());
+    mlp.add_input(first.input(0));
+    for (int layer : layers) {
+      mlp.add_input(graph->node(layer).input(1));
+    }
+    for (int layer : layers) {
+      mlp.add_input(graph->node(layer).input(2));
+    }
+    auto* attr = mlp.mutable_attr();
+    (*attr)["T"] = last.attr().at("T");
+    SetAttrValue(static_cast<int>(layers.size()), &(*attr)["num_layers"]);
+    SetAttrValue(activations, &(*attr)["activations"]);
+
+    for (int layer : layers) {
+      fused[layer] = true;
+    }
+    for (size_t j = 0; j + 1 < layers.size(); j++) {
+      nodes_to_delete[layers[j]] = true;
+    }
+    mlps.emplace_back(std::move(mlp));
+  }
+
+  utils::Mutation* mutation = graph_view.GetMutationBuilder();
+  for (NodeDef& mlp : mlps) {
+    mutation->AddNode(std::move(mlp), &status);
+    TF_RETURN_IF_ERROR(status);
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    if (nodes_to_delete[i]) {
+      mutation->RemoveNode(graph_view.GetNode(i));
+    }
+  }
+  TF_RETURN_IF_ERROR(mutation->Apply());
+  *output = *graph_view.graph();
+
+  return Status::OK();
+}
+
+void MLPFusion::Feedback(Cluster* cluster, const GrapplerItem& item,
+                         const GraphDef& optimize_output, double result) {
+  // Nothing to do for MLPFusion.
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
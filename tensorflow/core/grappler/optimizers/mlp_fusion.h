@@ -0,0 +1,38 @@
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_MLP_FUSION_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_MLP_FUSION_H_
+
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Fuses chains of dense layers into a FusedMLP op for inference:
+//
+//   x -> _FusedMatMul(w_1, b_1) -> ... -> _FusedMatMul(w_n, b_n) -> y
+//
+// with n >= 2, as rewritten by the remapper from MatMul, BiasAdd and an
+// optional Relu. The weights and biases must be constants, since FusedMLP
+// packs them once, and each layer but the last must only feed the next.
+class MLPFusion : public GraphOptimizer {
+ public:
+  MLPFusion() = default;
+  explicit MLPFusion(RewriterConfig::Toggle opt_level) {}
+  ~MLPFusion() override {}
+
+  string name() const override { return "mlp_fusion"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* output) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimize_output, double result) override;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_MLP_FUSION_H_
@@ -0,0 +1,111 @@
+#include "tensorflow/core/grappler/optimizers/mlp_fusion.h"
+
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace tensorflow {
+namespace grappler {
+
+class MLPFusionTest : public GrapplerTest {};
+
+TEST_F(MLPFusionTest, FuseDenseLayers) {
+  using test::function::NDef;
+
+  MLPFusion optimizer;
+
+  const Tensor w = test::AsTensor<float>({1.0, 2.0, 3.0, 4.0}, {2, 2});
+  const Tensor b = test::AsTensor<float>({0.5, -0.5});
+  auto relu = [](const string& name, const string& x, const string& w,
+                 const string& b) {
+    return NDef(name, "_FusedMatMul", {x, w, b},
+                {{"T", DT_FLOAT},
+                 {"num_args", 1},
+                 {"fused_ops", gtl::ArraySlice<string>({"BiasAdd", "Relu"})}});
+  };
+
+  GrapplerItem item;
+  item.fetch = {"out", "side"};
+  item.graph = test::function::GDef({
+      NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+      NDef("w1", "Const", {}, {{"dtype", DT_FLOAT}, {"value", w}}),
+      NDef("b1", "Const", {}, {{"dtype", DT_FLOAT}, {"value", b}}),
+      NDef("w2", "Const", {}, {{"dtype", DT_FLOAT}, {"value", w}}),
+      NDef("b2", "Const", {}, {{"dtype", DT_FLOAT}, {"value", b}}),
+      NDef("w3", "Const", {}, {{"dtype", DT_FLOAT}, {"value", w}}),
+      NDef("b3", "Const", {}, {{"dtype", DT_FLOAT}, {"value", b}}),
+      relu("dense1", "x", "w1", "b1"),
+      relu("dense2", "dense1", "w2", "b2"),
+      NDef("dense3", "_FusedMatMul", {"dense2", "w3", "b3"},
+           {{"T", DT_FLOAT},
+            {"num_args", 1},
+            {"fused_ops", gtl::ArraySlice<string>({"BiasAdd"})}}),
+      NDef("out", "Identity", {"dense3"}, {{"T", DT_FLOAT}}),
+      // Fed by a variable, so not fused.
+      NDef("v", "VariableV2", {}, {{"dtype", DT_FLOAT}}),
+      relu("side", "dense3", "v", "b1"),
+  });
+
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE(node.name(), "dense1");
+    EXPECT_NE(node.name(), "dense2");
+    if (node.name() == "dense3") {
+      found++;
+      EXPECT_EQ(node.op(), "FusedMLP");
+      ASSERT_EQ(node.input_size(), 7);
+      EXPECT_EQ(node.input(0), "x");
+      EXPECT_EQ(node.input(1), "w1");
+      EXPECT_EQ(node.input(3), "w3");
+      EXPECT_EQ(node.input(4), "b1");
+      EXPECT_EQ(node.input(6), "b3");
+      EXPECT_EQ(node.attr().at("num_layers").i(), 3);
+      const auto& activations = node.attr().at("activations").list();
+      ASSERT_EQ(activations.s_size(), 3);
+      EXPECT_EQ(activations.s(0), "Relu");
+      EXPECT_EQ(activations.s(2), "Identity");
+    } else if (node.name() == "side") {
+      found++;
+      EXPECT_EQ(node.op(), "_FusedMatMul");
+    }
+  }
+  EXPECT_EQ(found, 2);
+}
+
+TEST_F(MLPFusionTest, KeepSharedLayers) {
+  using test::function::NDef;
+
+  MLPFusion optimizer;
+
+  const Tensor w = test::AsTensor<float>({1.0, 2.0, 3.0, 4.0}, {2, 2});
+  const Tensor b = test::AsTensor<float>({0.5, -0.5});
+
+  GrapplerItem item;
+  item.fetch = {"dense1", "dense2"};
+  item.graph = test::function::GDef({
+      NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+      NDef("w", "Const", {}, {{"dtype", DT_FLOAT}, {"value", w}}),
+      NDef("b", "Const", {}, {{"dtype", DT_FLOAT}, {"value", b}}),
+      NDef("dense1", "_FusedMatMul", {"x", "w", "b"},
+           {{"T", DT_FLOAT},
+            {"num_args", 1},
+            {"fused_ops", gtl::ArraySlice<string>({"BiasAdd", "Relu"})}}),
+      NDef("dense2", "_FusedMatMul", {"dense1", "w", "b"},
+           {{"T", DT_FLOAT},
+            {"num_args", 1},
+            {"fused_ops", gtl::ArraySlice<string>({"BiasAdd", "Relu"})}}),
+  });
+
+  // dense1 is fetched, so its output must be kept.
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
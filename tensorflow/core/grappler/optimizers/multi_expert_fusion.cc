@@ -0,0 +1,436 @@
+#include "tensorflow/core/grappler/optimizers/multi_expert_fusion.h"
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <set>
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils/graph_view.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace multiexpertfusion {
+
+typedef utils::MutableNodeView NodeView;
+
+// The experts stacked by a Pack, layers[k][e] the k-th layer of the expert
+// e from the shared input.
+struct ExpertPattern {
+  int pack_id = -1;
+  std::vector<std::vector<int>> layers;
+  std::vector<string> activations;
+};
+
+struct GatePattern {
+  int sum_id = -1;
+  int mul_id = -1;
+  int expand_dims_id = -1;
+  int softmax_id = -1;
+  // Input port of mul that the experts come from.
+  int experts_port = -1;
+};
+
+bool HasNoControlEdges(const NodeView* node_view) {
+  return node_view->NumControllingFanins() == 0 &&
+         node_view->NumControlledFanouts() == 0;
+}
+
+bool IsFloatOnCpu(const NodeView* node_view) {
+  const NodeDef* node = node_view->node();
+  return NodeIsOnCpu(node) && GetDataTypeFromAttr(*node, "T") == DT_FLOAT;
+}
+
+// Whether the node only feeds one input of one other node.
+bool HasSingleFanout(const NodeView* node_view) {
+  return node_view->NumRegularFanouts() == 1 &&
+         node_view->GetRegularFanout(0).size() == 1;
+}
+
+bool SameTensor(const utils::MutableFanoutView& a,
+                const utils::MutableFanoutView& b) {
+  return a.node_index() == b.node_index() && a.index() == b.index();
+}
+
+bool GetConstTensor(const NodeDef& node, Tensor* tensor) {
+  return IsConstant(node) && HasNodeAttr(node, "value") &&
+         tensor->FromProto(node.attr().at("value").tensor());
+}
+
+// Whether the node is a constant scalar of one of the values.
+bool IsConstantIn(const NodeView* node_view,
+                  std::initializer_list<int> values) {
+  Tensor tensor;
+  if (!GetConstTensor(*node_view->node(), &tensor) ||
+      tensor.NumElements() != 1) {
+    return false;
+  }
+  int64 value;
+  if (tensor.dtype() == DT_INT32) {
+    value = tensor.flat<int32>()(0);
+  } else if (tensor.dtype() == DT_INT64) {
+    value = tensor.flat<int64>()(0);
+  } else {
+    return false;
+  }
+  return std::find(values.begin(), values.end(), value) != values.end();
+}
+
+TensorShape ConstShape(const NodeView* node_view) {
+  const NodeDef* node = node_view->node();
+  return TensorShape(node->attr().at("value").tensor().tensor_shape());
+}
+
+// Returns the activation attr of MultiExpertDense for a dense layer of an
+// expert, or an empty string.
+string GetLayerActivation(const NodeView* node_view) {
+  const NodeDef* node = node_view->node();
+  if (node->op() != "_FusedMatMul" || node_view->NumRegularFanins() != 3 ||
+      !HasNoControlEdges(node_view) || !IsFloatOnCpu(node_view)) {
+    return "";
+  }
+  if ((HasNodeAttr(*node, "transpose_a") &&
+       node->attr().at("transpose_a").b()) ||
+      (HasNodeAttr(*node, "transpose_b") &&
+       node->attr().at("transpose_b").b())) {
+    return "";
+  }
+  for (int i = 1; i < 3; i++) {
+    const NodeDef* input = node_view->GetRegularFanin(i).node_view()->node();
+    if (!IsConstant(*input) || !HasNodeAttr(*input, "value")) {
+      return "";
+    }
+  }
+  if (!HasNodeAttr(*node, "fused_ops")) {
+    return "";
+  }
+  const auto& fused_ops = node->attr().at("fused_ops").list().s();
+  if (fused_ops.size() == 1 && fused_ops[0] == "BiasAdd") {
+    return "none";
+  }
+  if (fused_ops.size() == 2 && fused_ops[0] == "BiasAdd" &&
+      fused_ops[1] == "Relu") {
+    return "relu";
+  }
+  return "";
+}
+
+// Matches the experts stacked by the Pack node_index, walking their layers
+// back in lockstep until they read the same input.
+bool FindExpertPattern(const utils::MutableGraphView& graph_view,
+                       int node_index,
+                       const std::set<string>& nodes_to_preserve,
+                       ExpertPattern* matched) {
+  const NodeView* pack = graph_view.GetNode(node_index);
+  const NodeDef* pack_node = pack->node();
+  if (!IsPack(*pack_node) || !IsFloatOnCpu(pack) ||
+      !HasNoControlEdges(pack) || pack->NumRegularFanins() < 2 ||
+      !HasNodeAttr(*pack_node, "axis")) {
+    return false;
+  }
+  const int64 axis = pack_node->attr().at("axis").i();
+  if (axis != 1 && axis != -2) {
+    return false;
+  }
+  const int num_experts = pack->NumRegularFanins();
+  std::vector<const NodeView*> current(num_experts);
+  for (int e = 0; e < num_experts; ++e) {
+    const auto& fanin = pack->GetRegularFanin(e);
+    if (fanin.index() != 0) return false;
+    current[e] = fanin.node_view();
+  }
+
+  ExpertPattern pattern;
+  pattern.pack_id = node_index;
+  while (true) {
+    std::vector<int> layer(num_experts);
+    string activation;
+    for (int e = 0; e < num_experts; ++e) {
+      const NodeView* node_view = current[e];
+      const string layer_activation = GetLayerActivation(node_view);
+      if (layer_activation.empty() || !HasSingleFanout(node_view) ||
+          nodes_to_preserve.count(node_view->GetName()) > 0 ||
+          (e > 0 && layer_activation != activation)) {
+        return false;
+      }
+      activation = layer_activation;
+      layer[e] = node_view->node_index();
+      // The experts of a layer must have the same shapes to be stacked.
+      for (int i = 1; i < 3 && e > 0; i++) {
+        if (ConstShape(node_view->GetRegularFanin(i).node_view()) !=
+            ConstShape(current[0]->GetRegularFanin(i).node_view())) {
+          return false;
+        }
+      }
+    }
+    pattern.layers.push_back(layer);
+    pattern.activations.push_back(activation);
+
+    const auto& input = current[0]->GetRegularFanin(0);
+    bool shared_input = true;
+    for (int e = 1; e < num_experts; ++e) {
+      shared_input &= SameTensor(current[e]->GetRegularFanin(0), input);
+    }
+    if (shared_input) break;
+    for (int e = 0; e < num_experts; ++e) {
+      const auto& fanin = current[e]->GetRegularFanin(0);
+      if (fanin.index() != 0) return false;
+      current[e] = fanin.node_view();
+    }
+  }
+  std::reverse(pattern.layers.begin(), pattern.layers.end());
+  std::reverse(pattern.activations.begin(), pattern.activations.end());
+  *matched = std::move(pattern);
+  return true;
+}
+
+// Matches Sum(Mul(experts, ExpandDims(Softmax(logits), -1)), axis=1) from
+// its Sum.
+bool FindGatePattern(const utils::MutableGraphView& graph_view,
+                     int node_index, GatePattern* matched) {
+  const NodeView* sum = graph_view.GetNode(node_index);
+  const NodeDef* sum_node = sum->node();
+  if (!IsSum(*sum_node) || !IsFloatOnCpu(sum) || !HasNoControlEdges(sum) ||
+      sum->NumRegularFanins() != 2 ||
+      (HasNodeAttr(*sum_node, "keep_dims") &&
+       sum_node->attr().at("keep_dims").b()) ||
+      !IsConstantIn(sum->GetRegularFanin(1).node_view(), {1, -2})) {
+    return false;
+  }
+  const auto& mul = sum->GetRegularFanin(0);
+  const NodeView* mul_view = mul.node_view();
+  if (mul.index() != 0 || !IsMul(*mul_view->node()) ||
+      !IsFloatOnCpu(mul_view) || !HasNoControlEdges(mul_view) ||
+      !HasSingleFanout(mul_view) || mul_view->NumRegularFanins() != 2) {
+    return false;
+  }
+  for (int port = 0; port < 2; port++) {
+    const auto& expand_dims = mul_view->GetRegularFanin(port);
+    const NodeView* expand_view = expand_dims.node_view();
+    if (expand_dims.index() != 0 ||
+        expand_view->node()->op() != "ExpandDims" ||
+        !HasNoControlEdges(expand_view) || !HasSingleFanout(expand_view) ||
+        !IsConstantIn(expand_view->GetRegularFanin(1).node_view(), {2, -1})) {
+      continue;
+    }
+    const auto& softmax = expand_view->GetRegularFanin(0);
+    const NodeView* softmax_view = softmax.node_view();
+    if (softmax.index() != 0 || !IsSoftmax(*softmax_view->node()) ||
+        !IsFloatOnCpu(softmax_view) || !HasNoControlEdges(softmax_view) ||
+        !HasSingleFanout(softmax_view)) {
+      continue;
+    }
+    matched->sum_id = node_index;
+    matched->mul_id = mul.node_index();
+    matched->expand_dims_id = expand_dims.node_index();
+    matched->softmax_id = softmax.node_index();
+    matched->experts_port = 1 - port;
+    return true;
+  }
+  return false;
+}
+
+bool DimsCompatible(int64 a, int64 b) { return a < 0 || b < 0 || a == b; }
+
+// Whether the gate weights experts of [batch, experts, dim] by logits of
+// [batch, experts]. Unknown dimensions are assumed to match.
+bool HasGateShapes(const GraphProperties& properties, const GraphDef& graph,
+                   const GatePattern& pattern) {
+  auto input_shape = [&](int node_id, int port, TensorShapeProto* shape) {
+    const string& name = graph.node(node_id).name();
+    if (!properties.HasInputProperties(name)) return false;
+    const auto& props = properties.GetInputProperties(name);
+    if (port >= props.size() || props[port].shape().unknown_rank()) {
+      return false;
+    }
+    *shape = props[port].shape();
+    return true;
+  };
+  TensorShapeProto experts, logits;
+  if (!input_shape(pattern.mul_id, pattern.experts_port, &experts) ||
+      !input_shape(pattern.softmax_id, 0, &logits)) {
+    return false;
+  }
+  return experts.dim_size() == 3 && logits.dim_size() == 2 &&
+         DimsCompatible(experts.dim(0).size(), logits.dim(0).size()) &&
+         DimsCompatible(experts.dim(1).size(), logits.dim(1).size());
+}
+
+// Stacks the constant input port of the layers of the experts on a new
+// first dimension.
+Status StackConstants(const utils::MutableGraphView& graph_view,
+                      const std::vector<int>& layer, int port,
+                      Tensor* stacked) {
+  std::vector<Tensor> values(layer.size());
+  for (size_t e = 0; e < layer.size(); ++e) {
+    const NodeDef* value_node =
+        graph_view.GetNode(layer[e])->GetRegularFanin(port).node_view()->node();
+    if (!GetConstTensor(*value_node, &values[e]) ||
+        values[e].dtype() != DT_FLOAT) {
+      return errors::InvalidArgument("Not a float constant: ",
+                                     value_node->name());
+    }
+  }
+  TensorShape shape = values[0].shape();
+  shape.InsertDim(0, layer.size());
+  *stacked = Tensor(DT_FLOAT, shape);
+  float* data = stacked->flat<float>().data();
+  for (const Tensor& value : values) {
+    std::memcpy(data, value.flat<float>().data(),
+                value.NumElements() * sizeof(float));
+    data += value.NumElements();
+  }
+  return Status::OK();
+}
+
+NodeDef MakeConstNode(const string& name, const string& device,
+                      const Tensor& value) {
+  NodeDef node;
+  node.set_name(name);
+  node.set_op("Const");
+  node.set_device(device);
+  (*node.mutable_attr())["dtype"].set_type(value.dtype());
+  value.AsProtoTensorContent(
+      (*node.mutable_attr())["value"].mutable_tensor());
+  return node;
+}
+}  // namespace multiexpertfusion
+
+Status MultiExpertFusion::Optimize(Cluster* cluster, const GrapplerItem& item,
+                                   GraphDef* output) {
+  *output = item.graph;
+  Status status;
+  utils::MutableGraphView graph_view(output, &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(graph_view.SortTopologically(/*ignore_cycles=*/false, {}));
+  const int num_nodes = item.graph.node_size();
+  const GraphDef* graph = graph_view.graph();
+  const std::set<string> nodes_to_preserve = item.NodesToPreserve();
+
+  std::vector<multiexpertfusion::ExpertPattern> experts;
+  std::vector<multiexpertfusion::GatePattern> gates;
+  for (int i = 0; i < num_nodes; ++i) {
+    multiexpertfusion::ExpertPattern expert;
+    if (multiexpertfusion::FindExpertPattern(graph_view, i, nodes_to_preserve,
+                                             &expert)) {
+      experts.push_back(std::move(expert));
+      continue;
+    }
+    multiexpertfusion::GatePattern gate;
+    if (multiexpertfusion::FindGatePattern(graph_view, i, &gate)) {
+      bool preserved = false;
+      for (int id : {gate.mul_id, gate.expand_dims_id, gate.softmax_id}) {
+        preserved |= nodes_to_preserve.count(graph->node(id).name()) > 0;
+      }
+      if (!preserved) {
+        gates.push_back(gate);
+      }
+    }
+  }
+  if (experts.empty() && gates.empty()) {
+    return Status::OK();
+  }
+
+  std::vector<bool> nodes_to_delete(num_nodes);
+  std::vector<NodeDef> new_nodes;
+  for (const auto& expert : experts) {
+    const NodeDef& pack = graph->node(expert.pack_id);
+    VLOG(2) << "Fusing " << expert.layers[0].size() << " experts of "
+            << expert.layers.size() << " layers into " << pack.name();
+    string input = graph->node(expert.layers[0][0]).input(0);
+    for (size_t k = 0; k < expert.layers.size(); ++k) {
+      const std::vector<int>& layer = expert.layers[k];
+      Tensor w, b;
+      TF_RETURN_IF_ERROR(
+          multiexpertfusion::StackConstants(graph_view, layer, 1, &w));
+      TF_RETURN_IF_ERROR(
+          multiexpertfusion::StackConstants(graph_view, layer, 2, &b));
+      // The last layer replaces the Pack.
+      const string name =
+          k + 1 == expert.layers.size()
+              ? pack.name()
+              : strings::StrCat(pack.name(), "/MultiExpertDense_", k);
+      const string device = graph->node(layer[0]).device();
+      new_nodes.push_back(multiexpertfusion::MakeConstNode(
+          strings::StrCat(pack.name(), "/MultiExpertDense_", k, "/w"), device,
+          w));
+      new_nodes.push_back(multiexpertfusion::MakeConstNode(
+          strings::StrCat(pack.name(), "/MultiExpertDense_", k, "/b"), device,
+          b));
+
+      NodeDef dense;
+      dense.set_name(name);
+      dense.set_op("MultiExpertDense");
+      dense.set_device(device);
+      dense.add_input(input);
+      dense.add_input(new_nodes[new_nodes.size() - 2].name());
+      dense.add_input(new_nodes.back().name());
+      (*dense.mutable_attr())["T"] = pack.attr().at("T");
+      (*dense.mutable_attr())["activation"].set_s(expert.activations[k]);
+      new_nodes.push_back(std::move(dense));
+      input = name;
+      for (int id : layer) {
+        nodes_to_delete[id] = true;
+      }
+    }
+  }
+
+  if (!gates.empty()) {
+    GraphProperties properties(item);
+    TF_RETURN_IF_ERROR(properties.InferStatically(
+        /*assume_valid_feeds=*/false,
+        /*aggressive_shape_inference=*/false,
+        /*include_input_tensor_values=*/false,
+        /*include_output_tensor_values=*/false));
+    for (const auto& gate : gates) {
+      if (!multiexpertfusion::HasGateShapes(properties, *graph, gate)) {
+        continue;
+      }
+      const NodeDef& sum = graph->node(gate.sum_id);
+      const NodeDef& mul = graph->node(gate.mul_id);
+      VLOG(2) << "Fusing gate " << sum.name();
+
+      // The fused node replaces the Sum.
+      NodeDef fused;
+      fused.set_name(sum.name());
+      fused.set_op("MultiExpertGate");
+      fused.set_device(sum.device());
+      fused.add_input(mul.input(gate.experts_port));
+      fused.add_input(graph->node(gate.softmax_id).input(0));
+      (*fused.mutable_attr())["T"] = sum.attr().at("T");
+      new_nodes.push_back(std::move(fused));
+      for (int id : {gate.mul_id, gate.expand_dims_id, gate.softmax_id}) {
+        nodes_to_delete[id] = true;
+      }
+    }
+  }
+
+  utils::Mutation* mutation = graph_view.GetMutationBuilder();
+  for (NodeDef& node : new_nodes) {
+    mutation->AddNode(std::move(node), &status);
+    TF_RETURN_IF_ERROR(status);
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    if (nodes_to_delete[i]) {
+      mutation->RemoveNode(graph_view.GetNode(i));
+    }
+  }
+  TF_RETURN_IF_ERROR(mutation->Apply());
+  *output = *graph_view.graph();
+
+  return Status::OK();
+}
+
+void MultiExpertFusion::Feedback(Cluster* cluster, const GrapplerItem& item,
+                                 const GraphDef& optimize_output,
+                                 double result) {
+  // Nothing to do for MultiExpertFusion.
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,50 @@
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_MULTI_EXPERT_FUSION_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_MULTI_EXPERT_FUSION_H_
+
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Fuses the experts and the gates of MMoE and PLE for inference.
+//
+// The experts stacked on axis 1, each a chain of dense layers of the same
+// shapes from a shared input x,
+//
+//   Pack([_FusedMatMul(... _FusedMatMul(x, w_e_1, b_e_1) ..., w_e_n, b_e_n)
+//         for e in experts], axis=1)
+//
+// become n MultiExpertDense nodes, whose weights and biases are the ones of
+// the experts stacked into constants. The layers must be _FusedMatMul with
+// a BiasAdd and an optional Relu, as rewritten by the remapper, of constant
+// weights and biases, each feeding only the next layer.
+//
+// The gates weighting the stacked experts,
+//
+//   Sum(Mul(experts, ExpandDims(Softmax(logits), -1)), axis=1)
+//
+// become MultiExpertGate nodes. The Mul, ExpandDims and Softmax nodes must
+// only feed the next node of the pattern.
+class MultiExpertFusion : public GraphOptimizer {
+ public:
+  MultiExpertFusion() = default;
+  explicit MultiExpertFusion(RewriterConfig::Toggle opt_level) {}
+  ~MultiExpertFusion() override {}
+
+  string name() const override { return "multi_expert_fusion"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* output) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimize_output, double result) override;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_MULTI_EXPERT_FUSION_H_
@@ -0,0 +1,147 @@
+#include "tensorflow/core/grappler/optimizers/multi_expert_fusion.h"
+
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace grappler {
+
+class MultiExpertFusionTest : public GrapplerTest {
+ protected:
+  static NodeDef Dense(const string& name, const string& x, const string& w,
+                       const string& b, bool relu) {
+    using test::function::NDef;
+    return NDef(name, "_FusedMatMul", {x, w, b},
+                {{"T", DT_FLOAT},
+                 {"num_args", 1},
+                 {"fused_ops", relu ? gtl::ArraySlice<string>({"BiasAdd",
+                                                               "Relu"})
+                                    : gtl::ArraySlice<string>({"BiasAdd"})}});
+  }
+
+  // Two experts of two layers from x, stacked, and the gate of a task, as
+  // in the MMoE model zoo after the remapper.
+  static GrapplerItem MakeItem() {
+    using test::function::NDef;
+    std::vector<NodeDef> nodes = {
+        NDef("x", "Placeholder", {},
+             {{"dtype", DT_FLOAT}, {"shape", TensorShape({4, 3})}}),
+        NDef("logits", "Placeholder", {},
+             {{"dtype", DT_FLOAT}, {"shape", TensorShape({4, 2})}}),
+        NDef("axis", "Const", {},
+             {{"dtype", DT_INT32}, {"value", test::AsScalar<int32>(1)}}),
+        NDef("last_axis", "Const", {},
+             {{"dtype", DT_INT32}, {"value", test::AsScalar<int32>(-1)}}),
+    };
+    for (int e = 0; e < 2; ++e) {
+      const string expert = strings::StrCat("expert", e);
+      const float scale = e + 1;
+      nodes.push_back(NDef(
+          expert + "/w0", "Const", {},
+          {{"dtype", DT_FLOAT},
+           {"value", test::AsTensor<float>({scale, 0, 0, scale, 1, 1},
+                                           {3, 2})}}));
+      nodes.push_back(NDef(
+          expert + "/b0", "Const", {},
+          {{"dtype", DT_FLOAT}, {"value", test::AsTensor<float>({0, scale})}}));
+      nodes.push_back(NDef(
+          expert + "/w1", "Const", {},
+          {{"dtype", DT_FLOAT},
+           {"value", test::AsTensor<float>({1, scale, scale, 1}, {2, 2})}}));
+      nodes.push_back(NDef(
+          expert + "/b1", "Const", {},
+          {{"dtype", DT_FLOAT}, {"value", test::AsTensor<float>({scale, 0})}}));
+      nodes.push_back(Dense(expert + "/dense0", "x", expert + "/w0",
+                            expert + "/b0", true));
+      nodes.push_back(Dense(expert + "/dense1", expert + "/dense0",
+                            expert + "/w1", expert + "/b1", false));
+    }
+    nodes.push_back(NDef("experts", "Pack",
+                         {"expert0/dense1", "expert1/dense1"},
+                         {{"T", DT_FLOAT}, {"N", 2}, {"axis", 1}}));
+    nodes.push_back(
+        NDef("gate/softmax", "Softmax", {"logits"}, {{"T", DT_FLOAT}}));
+    nodes.push_back(NDef("gate/expand_dims", "ExpandDims",
+                         {"gate/softmax", "last_axis"},
+                         {{"T", DT_FLOAT}, {"Tdim", DT_INT32}}));
+    nodes.push_back(NDef("gate/mul", "Mul", {"experts", "gate/expand_dims"},
+                         {{"T", DT_FLOAT}}));
+    nodes.push_back(NDef("gate", "Sum", {"gate/mul", "axis"},
+                         {{"T", DT_FLOAT},
+                          {"Tidx", DT_INT32},
+                          {"keep_dims", false}}));
+    nodes.push_back(NDef("out", "Identity", {"gate"}, {{"T", DT_FLOAT}}));
+
+    GrapplerItem item;
+    item.fetch = {"out"};
+    item.graph = test::function::GDef(nodes);
+    return item;
+  }
+};
+
+TEST_F(MultiExpertFusionTest, FuseExpertsAndGate) {
+  GrapplerItem item = MakeItem();
+  MultiExpertFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_EQ(node.op() == "_FusedMatMul" || node.op() == "Softmax" ||
+                  node.op() == "Mul" || node.op() == "ExpandDims",
+              false)
+        << node.name();
+    if (node.name() == "experts/MultiExpertDense_0") {
+      found++;
+      EXPECT_EQ(node.op(), "MultiExpertDense");
+      ASSERT_EQ(node.input_size(), 3);
+      EXPECT_EQ(node.input(0), "x");
+      EXPECT_EQ(node.attr().at("activation").s(), "relu");
+    } else if (node.name() == "experts") {
+      found++;
+      EXPECT_EQ(node.op(), "MultiExpertDense");
+      ASSERT_EQ(node.input_size(), 3);
+      EXPECT_EQ(node.input(0), "experts/MultiExpertDense_0");
+      EXPECT_EQ(node.attr().at("activation").s(), "none");
+    } else if (node.name() == "experts/MultiExpertDense_0/w") {
+      found++;
+      Tensor w;
+      ASSERT_TRUE(w.FromProto(node.attr().at("value").tensor()));
+      test::ExpectTensorEqual<float>(
+          test::AsTensor<float>({1, 0, 0, 1, 1, 1, 2, 0, 0, 2, 1, 1},
+                                {2, 3, 2}),
+          w);
+    } else if (node.name() == "gate") {
+      found++;
+      EXPECT_EQ(node.op(), "MultiExpertGate");
+      ASSERT_EQ(node.input_size(), 2);
+      EXPECT_EQ(node.input(0), "experts");
+      EXPECT_EQ(node.input(1), "logits");
+    }
+  }
+  EXPECT_EQ(found, 4);
+}
+
+TEST_F(MultiExpertFusionTest, KeepFetchedSoftmax) {
+  GrapplerItem item = MakeItem();
+  item.fetch.push_back("gate/softmax");
+
+  MultiExpertFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "gate") {
+      EXPECT_EQ(node.op(), "Sum");
+    } else if (node.name() == "experts") {
+      EXPECT_EQ(node.op(), "MultiExpertDense");
+    }
+  }
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -12,6 +12,7 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
+#include <algorithm>
 #include <queue>
 #include "tensorflow/core/grappler/optimizers/multi_stream_optimizer.h"
 
@@ -47,6 +48,30 @@ std::vector<StringPiece> SplitString(const string& str,
   
   return result;
 }
+
+// A kernel launch costs as much as moving this number of bytes.
+const int64 kKernelLaunchCost = 4096;
+
+// Predicted time of a node as the bytes of its outputs per example, the
+// unknown dims such as the batch size are taken as 1.
+int64 PredictNodeCost(const NodeDef& node, const GraphProperties& properties,
+                      bool has_properties) {
+  int64 cost = kKernelLaunchCost;
+  if (!has_properties || !properties.HasOutputProperties(node.name())) {
+    return cost;
+  }
+  for (const auto& output : properties.GetOutputProperties(node.name())) {
+    if (output.shape().unknown_rank()) {
+      continue;
+    }
+    int64 num_elements = 1;
+    for (const auto& dim : output.shape().dim()) {
+      num_elements *= std::max<int64>(1, dim.size());
+    }
+    cost += num_elements * DataTypeSize(output.dtype());
+  }
+  return cost;
+}
 }
 
 MultiStreamOptimizer::MultiStreamOptimizer(
@@ -123,27 +148,60 @@ Status MultiStreamOptimizer::SplitEmbeddingGraph(
     }
   }
 
-  // Assign stream_id to each subgraph
-  int stream_id = 0;
-  std::unordered_map<std::string, int> name_to_streamid;
-  for (auto prefix : embedding_gather_name_prefix) {
-    name_to_streamid[prefix] = stream_id % opt_.multi_stream_num();
-    stream_id++;
+  if (opt_.multi_stream_num() <= 0) {
+    return Status::OK();
   }
 
-  // Split out all embedding lookup graphs
+  // Predict the cost of each subgraph
+  GraphProperties properties(item);
+  const bool has_properties = properties.InferStatically(false).ok();
+  std::vector<std::pair<NodeDef*, std::string>> subgraph_nodes;
+  std::unordered_map<std::string, int64> prefix_cost;
   for (const NodeDef& node : optimized_graph->node()) {
     for (auto prefix : embedding_gather_name_prefix) {
       if (node.name().find(prefix) != std::string::npos) {
-        tensorflow::AttrValue stream_id_attr;
-        stream_id_attr.set_i(name_to_streamid[prefix]);
-        (const_cast<NodeDef*>(&node))->mutable_attr()->insert(
-            AttrValueMap::value_type("_stream_id", stream_id_attr));
+        subgraph_nodes.emplace_back(const_cast<NodeDef*>(&node), prefix);
+        prefix_cost[prefix] +=
+            PredictNodeCost(node, properties, has_properties);
         break;
       }
     }
   }
 
+  // Assign stream_id to each subgraph, from the most costly one to the
+  // stream of the least predicted cost, so that the streams finish together.
+  std::vector<std::pair<int64, std::string>> subgraphs;
+  for (auto& it : prefix_cost) {
+    subgraphs.emplace_back(it.second, it.first);
+  }
+  std::sort(subgraphs.begin(), subgraphs.end(),
+            [](const std::pair<int64, std::string>& a,
+               const std::pair<int64, std::string>& b) {
+              return a.first != b.first ? a.first > b.first
+                                        : a.second < b.second;
+            });
+  std::vector<int64> stream_cost(opt_.multi_stream_num(), 0);
+  std::unordered_map<std::string, int> name_to_streamid;
+  for (auto& subgraph : subgraphs) {
+    const int stream_id =
+        std::min_element(stream_cost.begin(), stream_cost.end()) -
+        stream_cost.begin();
+    stream_cost[stream_id] += subgraph.first;
+    name_to_streamid[subgraph.second] = stream_id;
+  }
+  for (int i = 0; i < stream_cost.size(); ++i) {
+    VLOG(1) << "MultiStreamOptimizer: predicted cost of stream " << i
+            << " is " << stream_cost[i];
+  }
+
+  // Split out all embedding lookup graphs
+  for (auto& it : subgraph_nodes) {
+    tensorflow::AttrValue stream_id_attr;
+    stream_id_attr.set_i(name_to_streamid[it.second]);
+    it.first->mutable_attr()->insert(
+        AttrValueMap::value_type("_stream_id", stream_id_attr));
+  }
+
   return Status::OK();
 }
 
@@ -0,0 +1,268 @@
+#define EIGEN_USE_THREADS
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/ann_index/hnsw_index.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+// The index behind an AnnIndexHandleOp. Searches share the lock, updates
+// hold it exclusively; a build makes the new index before it takes the lock,
+// so the searches go on with the old one meanwhile.
+class AnnIndex : public ResourceBase {
+ public:
+  string DebugString() const override {
+    tf_shared_lock l(mu_);
+    return strings::StrCat("AnnIndex of ", index_ ? index_->size() : 0,
+                           " items");
+  }
+
+  mutex* mu() const { return &mu_; }
+  ann::HnswIndex* index() const { return index_.get(); }
+  void set_index(std::unique_ptr<ann::HnswIndex> index) {
+    index_ = std::move(index);
+  }
+
+ private:
+  mutable mutex mu_;
+  std::unique_ptr<ann::HnswIndex> index_;
+};
+
+namespace {
+
+Status ValidateIdsAndEmbeddings(const Tensor& ids, const Tensor& embeddings) {
+  if (!TensorShapeUtils::IsVector(ids.shape()) ||
+      !TensorShapeUtils::IsMatrix(embeddings.shape()) ||
+      ids.dim_size(0) != embeddings.dim_size(0)) {
+    return errors::InvalidArgument(
+        "ids must be a vector and embeddings a matrix of as many rows, got ",
+        ids.shape().DebugString(), " and ", embeddings.shape().DebugString());
+  }
+  return Status::OK();
+}
+
+Status Upsert(ann::HnswIndex* index, const Tensor& ids,
+              const Tensor& embeddings, int64* num_changed) {
+  if (embeddings.dim_size(1) != index->dim()) {
+    return errors::InvalidArgument("The AnnIndex is of ", index->dim(),
+                                   "-d embeddings, got ",
+                                   embeddings.shape().DebugString());
+  }
+  auto ids_flat = ids.flat<int64>();
+  auto rows = embeddings.matrix<float>();
+  *num_changed = 0;
+  for (int64 i = 0; i < ids_flat.size(); ++i) {
+    bool changed = false;
+    TF_RETURN_IF_ERROR(index->Upsert(ids_flat(i), &rows(i, 0), &changed));
+    *num_changed += changed;
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+REGISTER_KERNEL_BUILDER(Name("AnnIndexHandleOp").Device(DEVICE_CPU),
+                        ResourceHandleOp<AnnIndex>);
+
+class AnnIndexBuildOp : public OpKernel {
+ public:
+  explicit AnnIndexBuildOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    string metric;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("metric", &metric));
+    metric_ = metric == "l2" ? ann::Metric::L2 : ann::Metric::INNER_PRODUCT;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("m", &m_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("ef_construction", &ef_construction_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("ef_search", &ef_search_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& ids = ctx->input(1);
+    const Tensor& embeddings = ctx->input(2);
+    OP_REQUIRES_OK(ctx, ValidateIdsAndEmbeddings(ids, embeddings));
+
+    std::unique_ptr<ann::HnswIndex> index(new ann::HnswIndex(
+        embeddings.dim_size(1), metric_, m_, ef_construction_, ef_search_));
+    int64 num_changed;
+    OP_REQUIRES_OK(ctx, Upsert(index.get(), ids, embeddings, &num_changed));
+
+    LOG(INFO) << "AnnIndex " << name() << " built of " << index->size()
+              << " items";
+
+    // A new resource is created with the index, so that no search finds it
+    // without one.
+    AnnIndex* resource = nullptr;
+    OP_REQUIRES_OK(ctx, LookupOrCreateResource<AnnIndex>(
+                            ctx, HandleFromInput(ctx, 0), &resource,
+                            [&index](AnnIndex** ptr) {
+                              *ptr = new AnnIndex();
+                              (*ptr)->set_index(std::move(index));
+                              return Status::OK();
+                            }));
+    core::ScopedUnref unref(resource);
+    if (index) {
+      mutex_lock l(*resource->mu());
+      resource->set_index(std::move(index));
+    }
+  }
+
+ private:
+  ann::Metric metric_;
+  int m_;
+  int ef_construction_;
+  int ef_search_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("AnnIndexBuild").Device(DEVICE_CPU),
+                        AnnIndexBuildOp);
+
+namespace {
+
+// Looks up the index of the input 0, which has to be built already.
+Status LookupIndex(OpKernelContext* ctx, AnnIndex** resource) {
+  Status s = LookupResource(ctx, HandleFromInput(ctx, 0), resource);
+  if (!s.ok()) {
+    return errors::FailedPrecondition(
+        "The AnnIndex has to be built by AnnIndexBuild first: ",
+        s.error_message());
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+class AnnIndexUpsertOp : public OpKernel {
+ public:
+  explicit AnnIndexUpsertOp(OpKernelConstruction* ctx) : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& ids = ctx->input(1);
+    const Tensor& embeddings = ctx->input(2);
+    OP_REQUIRES_OK(ctx, ValidateIdsAndEmbeddings(ids, embeddings));
+    AnnIndex* resource = nullptr;
+    OP_REQUIRES_OK(ctx, LookupIndex(ctx, &resource));
+    core::ScopedUnref unref(resource);
+    int64 num_changed;
+    {
+      mutex_lock l(*resource->mu());
+      OP_REQUIRES_OK(ctx, Upsert(resource->index(), ids, embeddings,
+                                 &num_changed));
+    }
+    VLOG(1) << "AnnIndex " << name() << " upserted " << num_changed
+            << " of " << ids.NumElements() << " items";
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("AnnIndexUpsert").Device(DEVICE_CPU),
+                        AnnIndexUpsertOp);
+
+class AnnIndexRemoveOp : public OpKernel {
+ public:
+  explicit AnnIndexRemoveOp(OpKernelConstruction* ctx) : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& ids = ctx->input(1);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsVector(ids.shape()),
+                errors::InvalidArgument("ids must be a vector, got ",
+                                        ids.shape().DebugString()));
+    AnnIndex* resource = nullptr;
+    OP_REQUIRES_OK(ctx, LookupIndex(ctx, &resource));
+    core::ScopedUnref unref(resource);
+    auto ids_flat = ids.flat<int64>();
+    mutex_lock l(*resource->mu());
+    for (int64 i = 0; i < ids_flat.size(); ++i) {
+      resource->index()->Remove(ids_flat(i));
+    }
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("AnnIndexRemove").Device(DEVICE_CPU),
+                        AnnIndexRemoveOp);
+
+class AnnIndexSearchOp : public OpKernel {
+ public:
+  explicit AnnIndexSearchOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("k", &k_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& queries = ctx->input(1);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsMatrix(queries.shape()),
+                errors::InvalidArgument("queries must be a matrix, got ",
+                                        queries.shape().DebugString()));
+    AnnIndex* resource = nullptr;
+    OP_REQUIRES_OK(ctx, LookupIndex(ctx, &resource));
+    core::ScopedUnref unref(resource);
+
+    const int64 batch_size = queries.dim_size(0);
+    Tensor* ids = nullptr;
+    Tensor* scores = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, TensorShape({batch_size, k_}),
+                                             &ids));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(
+                            1, TensorShape({batch_size, k_}), &scores));
+    auto ids_matrix = ids->matrix<int64>();
+    auto scores_matrix = scores->matrix<float>();
+    auto queries_matrix = queries.matrix<float>();
+
+    tf_shared_lock l(*resource->mu());
+    const ann::HnswIndex* index = resource->index();
+    OP_REQUIRES(ctx, queries.dim_size(1) == index->dim(),
+                errors::InvalidArgument("The AnnIndex is of ", index->dim(),
+                                        "-d embeddings, got queries of ",
+                                        queries.shape().DebugString()));
+    auto search = [&](int64 begin, int64 end) {
+      std::vector<ann::HnswIndex::Result> results;
+      for (int64 b = begin; b < end; ++b) {
+        index->Search(&queries_matrix(b, 0), k_, &results);
+        for (int i = 0; i < k_; ++i) {
+          if (i < results.size()) {
+            ids_matrix(b, i) = results[i].first;
+            scores_matrix(b, i) = results[i].second;
+          } else {
+            ids_matrix(b, i) = -1;
+            scores_matrix(b, i) = -std::numeric_limits<float>::infinity();
+          }
+        }
+      }
+    };
+    // A query visits about ef_search * 2m items of the index.
+    const int64 cost = 64 * 32 * index->dim();
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, batch_size,
+          cost, search);
+  }
+
+ private:
+  int k_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("AnnIndexSearch").Device(DEVICE_CPU),
+                        AnnIndexSearchOp);
+
+class AnnIndexSizeOp : public OpKernel {
+ public:
+  explicit AnnIndexSizeOp(OpKernelConstruction* ctx) : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    AnnIndex* resource = nullptr;
+    OP_REQUIRES_OK(ctx, LookupIndex(ctx, &resource));
+    core::ScopedUnref unref(resource);
+    Tensor* size = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, TensorShape({}), &size));
+    tf_shared_lock l(*resource->mu());
+    size->scalar<int64>()() = resource->index()->size();
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("AnnIndexSize").Device(DEVICE_CPU),
+                        AnnIndexSizeOp);
+
+}  // namespace tensorflow
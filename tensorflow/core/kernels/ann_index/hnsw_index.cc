@@ -0,0 +1,250 @@
+#include "tensorflow/core/kernels/ann_index/hnsw_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <queue>
+#include <unordered_set>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace tensorflow {
+namespace ann {
+
+namespace {
+// Bounds the levels, which are 1 + log_m(items) on average.
+constexpr int kMaxLevel = 16;
+}  // namespace
+
+HnswIndex::HnswIndex(int64 dim, Metric metric, int m, int ef_construction,
+                     int ef_search)
+    : dim_(dim),
+      metric_(metric),
+      m_(m),
+      ef_construction_(ef_construction),
+      ef_search_(ef_search),
+      level_mult_(1.0 / std::log(static_cast<double>(m))),
+      // A fixed seed, so that the same items give the same graph.
+      rng_(20160330) {}
+
+float HnswIndex::Score(const float* a, const float* b) const {
+  // The Eigen maps are vectorized with the instruction set the kernels are
+  // built with.
+  Eigen::Map<const Eigen::VectorXf> va(a, dim_);
+  Eigen::Map<const Eigen::VectorXf> vb(b, dim_);
+  if (metric_ == Metric::INNER_PRODUCT) {
+    return va.dot(vb);
+  }
+  return -(va - vb).squaredNorm();
+}
+
+int HnswIndex::RandomLevel() {
+  std::uniform_real_distribution<double> uniform(
+      std::numeric_limits<double>::min(), 1.0);
+  const int level = static_cast<int>(-std::log(uniform(rng_)) * level_mult_);
+  return std::min(level, kMaxLevel);
+}
+
+Status HnswIndex::Upsert(int64 id, const float* vector, bool* changed) {
+  auto it = nodes_.find(id);
+  if (it != nodes_.end()) {
+    const Node node = it->second;
+    float* stored = &vectors_[node * dim_];
+    const bool same =
+        std::memcmp(stored, vector, dim_ * sizeof(float)) == 0;
+    if (same && !removed_[node]) {
+      *changed = false;
+      return Status::OK();
+    }
+    if (removed_[node]) {
+      removed_[node] = false;
+      ++size_;
+    }
+    if (!same) {
+      std::memcpy(stored, vector, dim_ * sizeof(float));
+      Connect(node);
+    }
+    *changed = true;
+    return Status::OK();
+  }
+  if (ids_.size() >= static_cast<size_t>(std::numeric_limits<Node>::max())) {
+    return errors::ResourceExhausted("An AnnIndex holds at most ",
+                                     std::numeric_limits<Node>::max(),
+                                     " items");
+  }
+  const Node node = ids_.size();
+  nodes_.emplace(id, node);
+  ids_.push_back(id);
+  removed_.push_back(false);
+  vectors_.insert(vectors_.end(), vector, vector + dim_);
+  links_.emplace_back(RandomLevel() + 1);
+  ++size_;
+  Connect(node);
+  *changed = true;
+  return Status::OK();
+}
+
+bool HnswIndex::Remove(int64 id) {
+  auto it = nodes_.find(id);
+  if (it == nodes_.end() || removed_[it->second]) {
+    return false;
+  }
+  removed_[it->second] = true;
+  --size_;
+  return true;
+}
+
+HnswIndex::Candidate HnswIndex::Greedy(const float* query, Candidate entry,
+                                       int level) const {
+  bool moved = true;
+  while (moved) {
+    moved = false;
+    for (Node neighbor : links_[entry.node][level]) {
+      const float score = Score(query, Vector(neighbor));
+      if (score > entry.score) {
+        entry = {score, neighbor};
+        moved = true;
+      }
+    }
+  }
+  return entry;
+}
+
+void HnswIndex::SearchLevel(const float* query, Candidate entry, int ef,
+                            int level, std::vector<Candidate>* found) const {
+  auto worse = [](const Candidate& a, const Candidate& b) {
+    return a.score < b.score;
+  };
+  auto better = [](const Candidate& a, const Candidate& b) {
+    return a.score > b.score;
+  };
+  // The best unexpanded candidate, and the worst of the 'ef' best found, on
+  // top.
+  std::priority_queue<Candidate, std::vector<Candidate>, decltype(worse)>
+      candidates(worse);
+  std::priority_queue<Candidate, std::vector<Candidate>, decltype(better)>
+      best(better);
+  std::unordered_set<Node> visited;
+  visited.reserve(ef * MaxLinks(level));
+  visited.insert(entry.node);
+  candidates.push(entry);
+  best.push(entry);
+  while (!candidates.empty()) {
+    const Candidate current = candidates.top();
+    if (current.score < best.top().score && best.size() >= ef) {
+      break;
+    }
+    candidates.pop();
+    for (Node neighbor : links_[current.node][level]) {
+      if (!visited.insert(neighbor).second) {
+        continue;
+      }
+      const float score = Score(query, Vector(neighbor));
+      if (best.size() < ef || score > best.top().score) {
+        candidates.push({score, neighbor});
+        best.push({score, neighbor});
+        if (best.size() > ef) {
+          best.pop();
+        }
+      }
+    }
+  }
+  found->resize(best.size());
+  for (auto it = found->rbegin(); it != found->rend(); ++it) {
+    *it = best.top();
+    best.pop();
+  }
+}
+
+void HnswIndex::AddLink(Node from, Node to, int level) {
+  std::vector<Node>& links = links_[from][level];
+  if (std::find(links.begin(), links.end(), to) != links.end()) {
+    return;
+  }
+  links.push_back(to);
+  const int max_links = MaxLinks(level);
+  if (links.size() <= max_links) {
+    return;
+  }
+  // Keeps the nearest neighbors of 'from'.
+  std::vector<Candidate> neighbors;
+  neighbors.reserve(links.size());
+  for (Node neighbor : links) {
+    neighbors.push_back({Score(Vector(from), Vector(neighbor)), neighbor});
+  }
+  std::partial_sort(neighbors.begin(), neighbors.begin() + max_links,
+                    neighbors.end(),
+                    [](const Candidate& a, const Candidate& b) {
+                      return a.score > b.score;
+                    });
+  links.resize(max_links);
+  for (int i = 0; i < max_links; ++i) {
+    links[i] = neighbors[i].node;
+  }
+}
+
+void HnswIndex::Connect(Node node) {
+  const int level = links_[node].size() - 1;
+  if (entry_ < 0) {
+    entry_ = node;
+    max_level_ = level;
+    return;
+  }
+  const float* vector = Vector(node);
+  Candidate entry = {Score(vector, Vector(entry_)), entry_};
+  for (int l = max_level_; l > level; --l) {
+    entry = Greedy(vector, entry, l);
+  }
+  std::vector<Candidate> found;
+  for (int l = std::min(level, max_level_); l >= 0; --l) {
+    SearchLevel(vector, entry, ef_construction_, l, &found);
+    found.erase(std::remove_if(found.begin(), found.end(),
+                               [node](const Candidate& c) {
+                                 return c.node == node;
+                               }),
+                found.end());
+    if (found.empty()) {
+      continue;
+    }
+    std::vector<Node>& links = links_[node][l];
+    links.clear();
+    for (int i = 0; i < found.size() && i < MaxLinks(l); ++i) {
+      links.push_back(found[i].node);
+    }
+    for (Node neighbor : links) {
+      AddLink(neighbor, node, l);
+    }
+    entry = found[0];
+  }
+  if (level > max_level_) {
+    entry_ = node;
+    max_level_ = level;
+  }
+}
+
+void HnswIndex::Search(const float* query, int k,
+                       std::vector<Result>* results) const {
+  results->clear();
+  if (entry_ < 0) {
+    return;
+  }
+  Candidate entry = {Score(query, Vector(entry_)), entry_};
+  for (int l = max_level_; l > 0; --l) {
+    entry = Greedy(query, entry, l);
+  }
+  std::vector<Candidate> found;
+  SearchLevel(query, entry, std::max(ef_search_, k), 0, &found);
+  for (const Candidate& c : found) {
+    if (results->size() == k) {
+      break;
+    }
+    if (!removed_[c.node]) {
+      results->emplace_back(ids_[c.node], c.score);
+    }
+  }
+}
+
+}  // namespace ann
+}  // namespace tensorflow
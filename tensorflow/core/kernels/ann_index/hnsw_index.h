@@ -0,0 +1,102 @@
+#ifndef TENSORFLOW_CORE_KERNELS_ANN_INDEX_HNSW_INDEX_H_
+#define TENSORFLOW_CORE_KERNELS_ANN_INDEX_HNSW_INDEX_H_
+
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace ann {
+
+enum class Metric {
+  // Higher inner products are nearer.
+  INNER_PRODUCT,
+  // Scored by the negated squared euclidean distance.
+  L2,
+};
+
+// A hierarchical navigable small world graph (Malkov and Yashunin, 2016) of
+// float vectors, each of which is an item with an int64 id.
+//
+// Every item is linked to its nearest items on level 0 and on each of the
+// levels up to a random level of its own, the upper ones being sparser. A
+// search descends greedily from the entry point through the upper levels
+// and then keeps the 'ef' best items found on level 0.
+//
+// Not thread safe: searches may run concurrently, but not with updates.
+class HnswIndex {
+ public:
+  typedef std::pair<int64, float> Result;
+
+  HnswIndex(int64 dim, Metric metric, int m, int ef_construction,
+            int ef_search);
+
+  int64 dim() const { return dim_; }
+  // The number of items, removed ones excluded.
+  int64 size() const { return size_; }
+
+  // Inserts the item 'id' or updates its vector, which is 'dim' floats.
+  // '*changed' is false if the item is already there with the same vector.
+  Status Upsert(int64 id, const float* vector, bool* changed);
+  // Hides the item 'id' from the searches. It stays in the graph, through
+  // which other items are reached, until it is upserted again.
+  bool Remove(int64 id);
+
+  // The 'k' items best for 'query', best first.
+  void Search(const float* query, int k, std::vector<Result>* results) const;
+
+  float Score(const float* a, const float* b) const;
+
+ private:
+  typedef int32 Node;
+
+  struct Candidate {
+    float score;
+    Node node;
+  };
+
+  const float* Vector(Node node) const { return &vectors_[node * dim_]; }
+  int MaxLinks(int level) const { return level == 0 ? 2 * m_ : m_; }
+  int RandomLevel();
+
+  // Moves from 'entry' to the item best for 'query' on 'level' while the
+  // links lead to better items.
+  Candidate Greedy(const float* query, Candidate entry, int level) const;
+  // The 'ef' best items for 'query' reachable on 'level' from 'entry',
+  // best first.
+  void SearchLevel(const float* query, Candidate entry, int ef, int level,
+                   std::vector<Candidate>* found) const;
+  // Links 'node' to its nearest items on its levels.
+  void Connect(Node node);
+  void AddLink(Node from, Node to, int level);
+
+  const int64 dim_;
+  const Metric metric_;
+  const int m_;
+  const int ef_construction_;
+  const int ef_search_;
+  const double level_mult_;
+  std::mt19937 rng_;
+
+  std::vector<float> vectors_;
+  std::vector<int64> ids_;
+  std::vector<bool> removed_;
+  // links_[node][level] are the neighbors of 'node' on 'level'.
+  std::vector<std::vector<std::vector<Node>>> links_;
+  std::unordered_map<int64, Node> nodes_;
+  Node entry_ = -1;
+  int max_level_ = -1;
+  int64 size_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(HnswIndex);
+};
+
+}  // namespace ann
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_ANN_INDEX_HNSW_INDEX_H_
@@ -0,0 +1,130 @@
+#include "tensorflow/core/kernels/ann_index/hnsw_index.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace ann {
+namespace {
+
+std::vector<float> RandomVectors(int64 num, int64 dim, int seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> normal;
+  std::vector<float> vectors(num * dim);
+  for (float& v : vectors) {
+    v = normal(rng);
+  }
+  return vectors;
+}
+
+// The ids of the 'k' items best for 'query' by a scan of all of them.
+std::vector<int64> ExactSearch(const HnswIndex& index,
+                               const std::vector<float>& vectors,
+                               const float* query, int k) {
+  const int64 dim = index.dim();
+  std::vector<std::pair<float, int64>> scored;
+  for (int64 i = 0; i * dim < vectors.size(); ++i) {
+    scored.emplace_back(-index.Score(query, &vectors[i * dim]), i);
+  }
+  std::partial_sort(scored.begin(), scored.begin() + k, scored.end());
+  std::vector<int64> ids;
+  for (int i = 0; i < k; ++i) {
+    ids.push_back(scored[i].second);
+  }
+  return ids;
+}
+
+double Recall(Metric metric) {
+  const int64 kDim = 16;
+  const int64 kNum = 2000;
+  const int kQueries = 50;
+  const int kTopK = 10;
+  HnswIndex index(kDim, metric, 16, 100, 64);
+  std::vector<float> vectors = RandomVectors(kNum, kDim, 1);
+  for (int64 i = 0; i < kNum; ++i) {
+    bool changed;
+    TF_CHECK_OK(index.Upsert(i, &vectors[i * kDim], &changed));
+  }
+  EXPECT_EQ(kNum, index.size());
+
+  std::vector<float> queries = RandomVectors(kQueries, kDim, 2);
+  int found = 0;
+  std::vector<HnswIndex::Result> results;
+  for (int q = 0; q < kQueries; ++q) {
+    const float* query = &queries[q * kDim];
+    index.Search(query, kTopK, &results);
+    EXPECT_EQ(kTopK, results.size());
+    for (int i = 1; i < results.size(); ++i) {
+      EXPECT_GE(results[i - 1].second, results[i].second);
+    }
+    std::vector<int64> exact = ExactSearch(index, vectors, query, kTopK);
+    for (const auto& result : results) {
+      found += std::count(exact.begin(), exact.end(), result.first);
+    }
+  }
+  return static_cast<double>(found) / (kQueries * kTopK);
+}
+
+TEST(HnswIndexTest, RecallInnerProduct) {
+  EXPECT_GT(Recall(Metric::INNER_PRODUCT), 0.9);
+}
+
+TEST(HnswIndexTest, RecallL2) { EXPECT_GT(Recall(Metric::L2), 0.9); }
+
+TEST(HnswIndexTest, FewerItemsThanK) {
+  HnswIndex index(2, Metric::INNER_PRODUCT, 4, 10, 10);
+  std::vector<HnswIndex::Result> results;
+  index.Search(std::vector<float>{1, 0}.data(), 3, &results);
+  EXPECT_TRUE(results.empty());
+
+  bool changed;
+  TF_ASSERT_OK(index.Upsert(7, std::vector<float>{1, 0}.data(), &changed));
+  TF_ASSERT_OK(index.Upsert(8, std::vector<float>{0, 1}.data(), &changed));
+  index.Search(std::vector<float>{1, 0}.data(), 3, &results);
+  ASSERT_EQ(2, results.size());
+  EXPECT_EQ(7, results[0].first);
+  EXPECT_FLOAT_EQ(1, results[0].second);
+  EXPECT_EQ(8, results[1].first);
+}
+
+TEST(HnswIndexTest, UpsertAndRemove) {
+  HnswIndex index(2, Metric::L2, 4, 10, 10);
+  bool changed;
+  TF_ASSERT_OK(index.Upsert(1, std::vector<float>{0, 0}.data(), &changed));
+  TF_ASSERT_OK(index.Upsert(2, std::vector<float>{5, 5}.data(), &changed));
+  TF_ASSERT_OK(index.Upsert(3, std::vector<float>{9, 9}.data(), &changed));
+  TF_ASSERT_OK(index.Upsert(2, std::vector<float>{5, 5}.data(), &changed));
+  EXPECT_FALSE(changed);
+
+  std::vector<HnswIndex::Result> results;
+  const std::vector<float> query = {1, 1};
+  index.Search(query.data(), 1, &results);
+  EXPECT_EQ(1, results[0].first);
+
+  // Moves the item 3 next to the query.
+  TF_ASSERT_OK(index.Upsert(3, std::vector<float>{1, 1}.data(), &changed));
+  EXPECT_TRUE(changed);
+  index.Search(query.data(), 1, &results);
+  EXPECT_EQ(3, results[0].first);
+  EXPECT_FLOAT_EQ(0, results[0].second);
+
+  EXPECT_TRUE(index.Remove(3));
+  EXPECT_FALSE(index.Remove(3));
+  EXPECT_EQ(2, index.size());
+  index.Search(query.data(), 3, &results);
+  ASSERT_EQ(2, results.size());
+  EXPECT_EQ(1, results[0].first);
+  EXPECT_EQ(2, results[1].first);
+
+  // Upserting a removed item brings it back.
+  TF_ASSERT_OK(index.Upsert(3, std::vector<float>{1, 1}.data(), &changed));
+  EXPECT_TRUE(changed);
+  EXPECT_EQ(3, index.size());
+}
+
+}  // namespace
+}  // namespace ann
+}  // namespace tensorflow
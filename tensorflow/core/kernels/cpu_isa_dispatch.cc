@@ -0,0 +1,125 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#include "tensorflow/core/kernels/cpu_isa_dispatch.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <cpuid.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+
+namespace {
+
+const char* const kCpuIsaNames[] = {"generic", "avx2", "avx512", "amx",
+                                    "sve"};
+const int kNumCpuIsas = sizeof(kCpuIsaNames) / sizeof(kCpuIsaNames[0]);
+
+#if defined(__x86_64__) && defined(__linux__)
+// AMX needs the tiles enabled in XCR0 by the OS, and the permission to use
+// their state requested for the process.
+bool AmxUsable() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) ||
+      !(edx & (1u << 24)) || !(edx & (1u << 22))) {
+    return false;
+  }
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & (1u << 27))) {
+    return false;
+  }
+  unsigned int xcr0_lo, xcr0_hi;
+  __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+  if ((xcr0_lo & (3u << 17)) != (3u << 17)) {
+    return false;
+  }
+  const int kArchReqXcompPerm = 0x1023;
+  const int kXFeatureXTileData = 18;
+  return syscall(SYS_arch_prctl, kArchReqXcompPerm, kXFeatureXTileData) == 0;
+}
+#endif
+
+// Returns a bit per CpuIsa supported.
+int DetectCpuIsas() {
+  int isas = 1 << static_cast<int>(CpuIsa::kGeneric);
+#if defined(__x86_64__)
+  if (port::TestCPUFeature(port::CPUFeature::AVX2) &&
+      port::TestCPUFeature(port::CPUFeature::FMA)) {
+    isas |= 1 << static_cast<int>(CpuIsa::kAvx2);
+    if (port::TestCPUFeature(port::CPUFeature::AVX512F) &&
+        port::TestCPUFeature(port::CPUFeature::AVX512BW) &&
+        port::TestCPUFeature(port::CPUFeature::AVX512DQ) &&
+        port::TestCPUFeature(port::CPUFeature::AVX512VL)) {
+      isas |= 1 << static_cast<int>(CpuIsa::kAvx512);
+#if defined(__linux__)
+      if (AmxUsable()) {
+        isas |= 1 << static_cast<int>(CpuIsa::kAmx);
+      }
+#endif
+    }
+  }
+#elif defined(__aarch64__) && defined(__linux__) && defined(HWCAP_SVE)
+  if (getauxval(AT_HWCAP) & HWCAP_SVE) {
+    isas |= 1 << static_cast<int>(CpuIsa::kSve);
+  }
+#endif
+
+  string max_isa;
+  TF_CHECK_OK(ReadStringFromEnvVar("TF_CPU_ISA_MAX", "", &max_isa));
+  if (!max_isa.empty()) {
+    int max = 0;
+    while (max < kNumCpuIsas &&
+           str_util::Lowercase(max_isa) != kCpuIsaNames[max]) {
+      max++;
+    }
+    if (max == kNumCpuIsas) {
+      LOG(WARNING) << "Unknown TF_CPU_ISA_MAX " << max_isa << ", ignored.";
+    } else {
+      isas &= (2 << max) - 1;
+    }
+  }
+  return isas;
+}
+
+int CpuIsas() {
+  static const int isas = DetectCpuIsas();
+  return isas;
+}
+
+}  // namespace
+
+bool CpuIsaSupported(CpuIsa isa) {
+  return CpuIsas() & (1 << static_cast<int>(isa));
+}
+
+const char* CpuIsaName() {
+  int best = 0;
+  for (int i = 0; i < kNumCpuIsas; i++) {
+    if (CpuIsas() & (1 << i)) {
+      best = i;
+    }
+  }
+  return kCpuIsaNames[best];
+}
+
+}  // namespace tensorflow
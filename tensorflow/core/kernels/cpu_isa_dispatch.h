@@ -0,0 +1,56 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_CPU_ISA_DISPATCH_H_
+#define TENSORFLOW_CORE_KERNELS_CPU_ISA_DISPATCH_H_
+
+namespace tensorflow {
+
+// The instruction sets of the CPU the kernels may dispatch to at runtime,
+// besides the one the binary is built for.
+enum class CpuIsa {
+  kGeneric = 0,
+  kAvx2 = 1,
+  kAvx512 = 2,  // AVX512F, BW, DQ and VL.
+  kAmx = 3,     // AMX-TILE and AMX-BF16, with the XTILEDATA permission.
+  kSve = 4,
+};
+
+// Whether the CPU and the OS support isa. The instruction sets above
+// TF_CPU_ISA_MAX ("generic", "avx2", "avx512", "amx" or "sve") are reported
+// as unsupported, e.g. to compare the variants of a kernel. Detected once.
+bool CpuIsaSupported(CpuIsa isa);
+
+// The best instruction set supported, for logging.
+const char* CpuIsaName();
+
+}  // namespace tensorflow
+
+// The kernels compile their AVX512 variants between TF_CPU_ISA_AVX512_BEGIN
+// and TF_CPU_ISA_END at namespace scope whatever -march the binary is built
+// with, and call them when CpuIsaSupported(CpuIsa::kAvx512). The lambdas of
+// the variants are compiled for AVX512 too, but not the functions defined
+// outside, which must be TF_ATTRIBUTE_ALWAYS_INLINE to inline the lambdas.
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ > 6) && \
+    defined(__x86_64__)
+#include <immintrin.h>
+#define TF_CPU_ISA_AVX512 1
+#define TF_CPU_ISA_AVX512_BEGIN \
+  _Pragma("GCC push_options")   \
+  _Pragma("GCC target(\"avx512f,avx512bw,avx512dq,avx512vl,avx2,fma\")")
+#define TF_CPU_ISA_END _Pragma("GCC pop_options")
+#endif
+
+#endif  // TENSORFLOW_CORE_KERNELS_CPU_ISA_DISPATCH_H_
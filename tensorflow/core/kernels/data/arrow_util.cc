@@ -26,6 +26,7 @@ limitations under the License.
 #include "arrow/util/thread_pool.h"
 #include "tensorflow/core/framework/allocation_description.pb.h"
 #include "tensorflow/core/kernels/data/eigen.h"
+#include "tensorflow/core/platform/fingerprint.h"
 
 namespace tensorflow {
 namespace data {
@@ -100,12 +101,14 @@ class ArrowPrimitiveTensorBuffer : public TensorBuffer {
  public:
   ArrowPrimitiveTensorBuffer() = delete;
 
-  explicit ArrowPrimitiveTensorBuffer(
-      const std::shared_ptr<arrow::Buffer>& arrow_buffer)
-      : TensorBuffer(const_cast<uint8_t*>(arrow_buffer->data())),
-        arrow_buffer_(arrow_buffer) {}
+  ArrowPrimitiveTensorBuffer(
+      const std::shared_ptr<arrow::Buffer>& arrow_buffer, const uint8_t* data,
+      size_t size)
+      : TensorBuffer(const_cast<uint8_t*>(data)),
+        arrow_buffer_(arrow_buffer),
+        size_(size) {}
 
-  size_t size() const override { return arrow_buffer_->size(); }
+  size_t size() const override { return size_; }
 
   TensorBuffer* root_buffer() override { return this; }
 
@@ -118,33 +121,47 @@ class ArrowPrimitiveTensorBuffer : public TensorBuffer {
 
  private:
   std::shared_ptr<::arrow::Buffer> arrow_buffer_;
+  const size_t size_;
 };
 #endif
 
+// Makes a tensor of the length elements of arrow_buffer from offset, the
+// tensor shares arrow_buffer when the elements are aligned.
 ::arrow::Status MakeTensorFromArrowBuffer(
     DataType dtype, const std::shared_ptr<::arrow::Buffer>& arrow_buffer,
-    Tensor* tensor) {
-  const TensorShape shape = {arrow_buffer->size() / DataTypeSize(dtype)};
+    int64 offset, int64 length, Tensor* tensor) {
+  const TensorShape shape = {length};
+  if (TF_PREDICT_FALSE(length == 0)) {
+    *tensor = Tensor(dtype, shape);
+    return ::arrow::Status::OK();
+  }
+  const int64 type_size = DataTypeSize(dtype);
+  if (TF_PREDICT_FALSE((offset + length) * type_size > arrow_buffer->size())) {
+    return ::arrow::Status::Invalid("Arrow buffer of ", arrow_buffer->size(),
+                                    " bytes has less than ", offset + length,
+                                    " elements");
+  }
+  const uint8_t* data = arrow_buffer->data() + offset * type_size;
+  const size_t size = length * type_size;
 
 #if DEEPREC_ARROW_ZEROCOPY
   // NOTE: Alignment is 64 in Arrow 4.x, same to EIGEN_MAX_ALIGN_BYTES. See:
   // https://github.com/apache/arrow/blob/apache-arrow-4.0.1/cpp/src/arrow/memory_pool.cc#L97
-  if (TF_PREDICT_FALSE(!CHECK_EIGEN_ALIGN(arrow_buffer->data()))) {
+  // The elements from a non-zero offset may be not aligned.
+  if (TF_PREDICT_FALSE(!CHECK_EIGEN_ALIGN(data))) {
     *tensor = Tensor(dtype, shape);
-    std::memcpy(const_cast<char*>(tensor->tensor_data().data()),
-                arrow_buffer->data(), arrow_buffer->size());
+    std::memcpy(const_cast<char*>(tensor->tensor_data().data()), data, size);
     return ::arrow::Status::OK();
   }
 
   ArrowPrimitiveTensorBuffer* tensor_buffer =
-      new ArrowPrimitiveTensorBuffer(arrow_buffer);
+      new ArrowPrimitiveTensorBuffer(arrow_buffer, data, size);
   core::ScopedUnref unref(tensor_buffer);
   *tensor = Tensor(dtype, shape, tensor_buffer);
   return ::arrow::Status::OK();
 #else
   *tensor = Tensor(dtype, shape);
-  std::memcpy(const_cast<char*>(tensor->tensor_data().data()),
-              arrow_buffer->data(), arrow_buffer->size());
+  std::memcpy(const_cast<char*>(tensor->tensor_data().data()), data, size);
   return ::arrow::Status::OK();
 #endif
 }
@@ -169,6 +186,24 @@ class ArrowPrimitiveTensorBuffer : public TensorBuffer {
   return ::arrow::Status::OK();
 }
 
+inline int64 HashBucket(::arrow::util::string_view s, int64 num_buckets) {
+  return Fingerprint64(StringPiece(s.data(), s.size())) % num_buckets;
+}
+
+::arrow::Status MakeHashedTensorFromArrowArray(
+    const ::arrow::BinaryArray& array, int64 num_buckets, Tensor* tensor) {
+  if (array.null_count() != 0) {
+    return ::arrow::Status::Invalid("Null elements not supported");
+  }
+
+  *tensor = Tensor(DT_INT64, TensorShape({array.length()}));
+  auto tensor_vec = tensor->vec<int64>();
+  for (int64 i = 0; i < array.length(); ++i) {
+    tensor_vec(i) = HashBucket(array.GetView(i), num_buckets);
+  }
+  return ::arrow::Status::OK();
+}
+
 // Primitive Arrow arrays have validity and value buffers.
 #define RAGGED_TENSOR_BUILDER_PRIMITIVE_VISIT(ARRAY_CLASS)                    \
   ::arrow::Status Visit(const ARRAY_CLASS& array) override {                  \
@@ -176,8 +211,9 @@ class ArrowPrimitiveTensorBuffer : public TensorBuffer {
       return ::arrow::Status::Invalid("Inconsistent ragged rank");            \
     }                                                                         \
     Tensor tensor;                                                            \
-    auto st =                                                                 \
-        MakeTensorFromArrowBuffer(dtype_, array.data()->buffers[1], &tensor); \
+    auto st = MakeTensorFromArrowBuffer(dtype_, array.data()->buffers[1],     \
+                                        array.offset(), array.length(),       \
+                                        &tensor);                             \
     if (!st.ok()) {                                                           \
       return st;                                                              \
     }                                                                         \
@@ -185,18 +221,21 @@ class ArrowPrimitiveTensorBuffer : public TensorBuffer {
     return ::arrow::Status::OK();                                             \
   }
 
-#define RAGGED_TENSOR_BUILDER_STRING_VISIT(ARRAY_CLASS)            \
-  ::arrow::Status Visit(const ARRAY_CLASS& array) override {       \
-    if (TF_PREDICT_FALSE(ragged_rank_ != 0)) {                     \
-      return ::arrow::Status::Invalid("Inconsistent ragged rank"); \
-    }                                                              \
-    Tensor tensor;                                                 \
-    auto st = MakeStringTensorFromArrowArray(array, &tensor);      \
-    if (!st.ok()) {                                                \
-      return st;                                                   \
-    }                                                              \
-    ragged_tensor_.push_front(std::move(tensor));                  \
-    return ::arrow::Status::OK();                                  \
+#define RAGGED_TENSOR_BUILDER_STRING_VISIT(ARRAY_CLASS)             \
+  ::arrow::Status Visit(const ARRAY_CLASS& array) override {        \
+    if (TF_PREDICT_FALSE(ragged_rank_ != 0)) {                      \
+      return ::arrow::Status::Invalid("Inconsistent ragged rank");  \
+    }                                                               \
+    Tensor tensor;                                                  \
+    auto st = num_buckets_ > 0                                      \
+                  ? MakeHashedTensorFromArrowArray(                 \
+                        array, num_buckets_, &tensor)               \
+                  : MakeStringTensorFromArrowArray(array, &tensor); \
+    if (!st.ok()) {                                                 \
+      return st;                                                    \
+    }                                                               \
+    ragged_tensor_.push_front(std::move(tensor));                   \
+    return ::arrow::Status::OK();                                   \
   }
 
 class RaggedTensorBuilder : public ::arrow::ArrayVisitor {
@@ -204,6 +243,14 @@ class RaggedTensorBuilder : public ::arrow::ArrayVisitor {
   RaggedTensorBuilder(DataType dtype, int32 ragged_rank)
       : dtype_(dtype), ragged_rank_(ragged_rank) {}
 
+  // Hashes the strings into num_buckets buckets.
+  RaggedTensorBuilder(int32 ragged_rank, int64 num_buckets,
+                      DictionaryHashCache* cache)
+      : dtype_(DT_INT64),
+        ragged_rank_(ragged_rank),
+        num_buckets_(num_buckets),
+        cache_(cache) {}
+
   ::arrow::Status Build(const std::shared_ptr<::arrow::Array>& array,
                         std::vector<Tensor>* output_tensors) {
     auto st = array->Accept(this);
@@ -218,13 +265,24 @@ class RaggedTensorBuilder : public ::arrow::ArrayVisitor {
   ::arrow::Status Visit(const ::arrow::ListArray& array) override {
     --ragged_rank_;
     Tensor tensor;
-    auto st =
-        MakeTensorFromArrowBuffer(DT_INT32, array.value_offsets(), &tensor);
+    auto st = MakeTensorFromArrowBuffer(DT_INT32, array.value_offsets(),
+                                        array.offset(), array.length() + 1,
+                                        &tensor);
     if (!st.ok()) {
       return st;
     }
+    // The row splits of a sliced list array are rebased to 0.
+    const int32 first_offset = array.value_offset(0);
+    if (TF_PREDICT_FALSE(first_offset != 0)) {
+      Tensor rebased(DT_INT32, tensor.shape());
+      rebased.vec<int32>() = tensor.vec<int32>() - first_offset;
+      tensor = rebased;
+    }
     ragged_tensor_.push_front(std::move(tensor));
-    return array.values()->Accept(this);
+    // Only the values in the list array, the values array may be longer.
+    return array.values()
+        ->Slice(first_offset, array.value_offset(array.length()) - first_offset)
+        ->Accept(this);
   }
 
   RAGGED_TENSOR_BUILDER_PRIMITIVE_VISIT(::arrow::Int8Array);
@@ -240,9 +298,65 @@ class RaggedTensorBuilder : public ::arrow::ArrayVisitor {
   RAGGED_TENSOR_BUILDER_STRING_VISIT(::arrow::BinaryArray);
   RAGGED_TENSOR_BUILDER_STRING_VISIT(::arrow::StringArray);
 
+  ::arrow::Status Visit(const ::arrow::DictionaryArray& array) override {
+    if (TF_PREDICT_FALSE(ragged_rank_ != 0)) {
+      return ::arrow::Status::Invalid("Inconsistent ragged rank");
+    }
+    if (TF_PREDICT_FALSE(num_buckets_ <= 0)) {
+      return ::arrow::Status::Invalid("Dictionary arrays must be hashed");
+    }
+    if (TF_PREDICT_FALSE(array.null_count() != 0)) {
+      return ::arrow::Status::Invalid("Null elements not supported");
+    }
+    const auto& dictionary = array.dictionary();
+    if (TF_PREDICT_FALSE(dictionary->type_id() != ::arrow::Type::STRING &&
+                         dictionary->type_id() != ::arrow::Type::BINARY)) {
+      return ::arrow::Status::Invalid("Dictionary of ",
+                                      dictionary->type()->ToString(),
+                                      " can not be hashed");
+    }
+    // The dictionary of the next batch of a column chunk is the same, or
+    // starts with the entries of the previous one.
+    const int64 cached = cache_->buckets.size();
+    int64 reused = 0;
+    if (cache_->dictionary == dictionary ||
+        (cache_->dictionary && dictionary->length() >= cached &&
+         dictionary->RangeEquals(0, cached, 0, *cache_->dictionary))) {
+      reused = cached;
+    }
+    const auto& entries =
+        static_cast<const ::arrow::BinaryArray&>(*dictionary);
+    cache_->buckets.resize(dictionary->length());
+    for (int64 i = reused; i < dictionary->length(); ++i) {
+      cache_->buckets[i] = HashBucket(entries.GetView(i), num_buckets_);
+    }
+    cache_->dictionary = dictionary;
+
+    Tensor tensor(DT_INT64, TensorShape({array.length()}));
+    auto tensor_vec = tensor.vec<int64>();
+    const int64* buckets = cache_->buckets.data();
+    if (array.indices()->type_id() == ::arrow::Type::INT32) {
+      const int32* indices =
+          static_cast<const ::arrow::Int32Array&>(*array.indices())
+              .raw_values();
+      for (int64 i = 0; i < array.length(); ++i) {
+        tensor_vec(i) = buckets[indices[i]];
+      }
+    } else {
+      for (int64 i = 0; i < array.length(); ++i) {
+        tensor_vec(i) = buckets[array.GetValueIndex(i)];
+      }
+    }
+    ragged_tensor_.push_front(std::move(tensor));
+    return ::arrow::Status::OK();
+  }
+
  private:
   const DataType dtype_;
   int32 ragged_rank_;
+  // Strings are hashed when num_buckets_ > 0.
+  const int64 num_buckets_ = 0;
+  DictionaryHashCache* cache_ = nullptr;
   std::deque<Tensor> ragged_tensor_;
 };
 
@@ -299,6 +413,23 @@ Status MakeTensorsFromArrowArray(
   return Status::OK();
 }
 
+Status MakeHashedTensorsFromArrowArray(
+    int32 ragged_rank, int64 num_buckets,
+    const std::shared_ptr<::arrow::Array>& arrow_array,
+    DictionaryHashCache* cache, std::vector<Tensor>* output_tensors) {
+  if (TF_PREDICT_FALSE(arrow_array->null_count() != 0)) {
+    return errors::Internal("Arrow array with null values not supported");
+  }
+
+  if (TF_PREDICT_FALSE(arrow_array->data()->offset != 0)) {
+    return errors::Internal("Arrow array has zero non-offset not supported");
+  }
+
+  RaggedTensorBuilder builder(ragged_rank, num_buckets, cache);
+  TF_RETURN_IF_ARROW_ERROR(builder.Build(arrow_array, output_tensors));
+  return Status::OK();
+}
+
 int UpdateArrowCpuThreadPoolCapacityFromEnv() {
   static int arrow_threads = SetArrowCpuThreadPoolCapacityFromEnv();
   return arrow_threads;
@@ -333,13 +464,19 @@ int GetArrowFileBufferSizeFromEnv() {
 
 ::arrow::Status OpenParquetReader(
     std::unique_ptr<::parquet::arrow::FileReader>* reader,
-    const std::shared_ptr<::arrow::io::RandomAccessFile>& file) {
+    const std::shared_ptr<::arrow::io::RandomAccessFile>& file,
+    const std::vector<int>& dictionary_columns) {
   auto config = ::parquet::ReaderProperties();
   config.enable_buffered_stream();
   config.set_buffer_size(GetArrowFileBufferSizeFromEnv());
+  auto arrow_config = ::parquet::default_arrow_reader_properties();
+  for (int column : dictionary_columns) {
+    arrow_config.set_read_dictionary(column, true);
+  }
   ARROW_RETURN_NOT_OK(::parquet::arrow::FileReader::Make(
       ::arrow::default_memory_pool(),
-      ::parquet::ParquetFileReader::Open(file, config), reader));
+      ::parquet::ParquetFileReader::Open(file, config), arrow_config,
+      reader));
   // If ARROW_NUM_THREADS > 0, specified number of threads will be used.
   // If ARROW_NUM_THREADS = 0, no threads will be used.
   // If ARROW_NUM_THREADS < 0, all threads will be used.
@@ -57,9 +57,12 @@ int GetArrowFileBufferSizeFromEnv();
     std::shared_ptr<::arrow::io::RandomAccessFile>* file,
     const std::string& filename);
 
+// The columns of dictionary_columns, leaf column indices in the parquet
+// schema, are read as arrow dictionary arrays.
 ::arrow::Status OpenParquetReader(
     std::unique_ptr<::parquet::arrow::FileReader>* reader,
-    const std::shared_ptr<::arrow::io::RandomAccessFile>& file);
+    const std::shared_ptr<::arrow::io::RandomAccessFile>& file,
+    const std::vector<int>& dictionary_columns = {});
 
 ::arrow::Status GetParquetDataFrameFields(
     std::vector<std::string>* field_names,
@@ -114,6 +117,23 @@ Status MakeTensorsFromArrowArray(
     const std::shared_ptr<::arrow::Array>& arrow_array,
     std::vector<Tensor>* output_tensors);
 
+// The hash buckets of the entries of the last dictionary read of a string
+// column, the batches of a column chunk share the entries of its dictionary
+// so that they are hashed once.
+struct DictionaryHashCache {
+  std::shared_ptr<::arrow::Array> dictionary;
+  std::vector<int64> buckets;
+};
+
+// Makes the int64 tensor of the `Fingerprint64(s) % num_buckets` of the
+// strings of arrow_array, like StringToHashBucketFast, and its row splits.
+// The strings of dictionary arrays are not materialized, their indices are
+// mapped to the buckets of the dictionary entries.
+Status MakeHashedTensorsFromArrowArray(
+    int32 ragged_rank, int64 num_buckets,
+    const std::shared_ptr<::arrow::Array>& arrow_array,
+    DictionaryHashCache* cache, std::vector<Tensor>* output_tensors);
+
 }  // namespace ArrowUtil
 }  // namespace data
 }  // namespace tensorflow
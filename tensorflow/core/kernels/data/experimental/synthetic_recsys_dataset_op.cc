@@ -0,0 +1,473 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+#include <cmath>
+
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/variant.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+namespace {
+
+// Samples the ranks 1..n with probabilities proportional to 1 / rank^s in
+// constant time and without tables, by the rejection-inversion method of
+// Hormann and Derflinger, so that the vocabularies can be as large as the
+// real ones.
+class ZipfSampler {
+ public:
+  ZipfSampler(int64 n, double s)
+      : n_(n),
+        s_(s),
+        h_integral_x1_(HIntegral(1.5) - 1.0),
+        h_integral_n_(HIntegral(n + 0.5)),
+        threshold_(2.0 - HIntegralInverse(HIntegral(2.5) - H(2.0))) {}
+
+  int64 Sample(random::SimplePhilox* rng) const {
+    while (true) {
+      const double u =
+          h_integral_n_ + rng->RandDouble() * (h_integral_x1_ - h_integral_n_);
+      const double x = HIntegralInverse(u);
+      int64 k = static_cast<int64>(x + 0.5);
+      k = std::min(std::max<int64>(k, 1), n_);
+      if (k - x <= threshold_ || u >= HIntegral(k + 0.5) - H(k)) {
+        return k;
+      }
+    }
+  }
+
+ private:
+  double H(double x) const { return std::exp(-s_ * std::log(x)); }
+
+  double HIntegral(double x) const {
+    const double log_x = std::log(x);
+    return Helper2((1.0 - s_) * log_x) * log_x;
+  }
+
+  double HIntegralInverse(double x) const {
+    const double t = std::max(x * (1.0 - s_), -1.0);
+    return std::exp(Helper1(t) * x);
+  }
+
+  // log1p(x) / x and expm1(x) / x, which are stable around 0.
+  static double Helper1(double x) {
+    if (std::abs(x) > 1e-8) {
+      return std::log1p(x) / x;
+    }
+    return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+  }
+
+  static double Helper2(double x) {
+    if (std::abs(x) > 1e-8) {
+      return std::expm1(x) / x;
+    }
+    return 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+  }
+
+  const int64 n_;
+  const double s_;
+  const double h_integral_x1_;
+  const double h_integral_n_;
+  const double threshold_;
+};
+
+// Describes the ids of a sparse or a sequence feature.
+struct IdFeature {
+  int64 vocab_size;
+  float zipf_exponent;
+  int64 max_length;
+};
+
+class SyntheticRecsysDatasetOp : public DatasetOpKernel {
+ public:
+  explicit SyntheticRecsysDatasetOp(OpKernelConstruction* ctx)
+      : DatasetOpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_dense", &num_dense_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_labels", &num_labels_));
+    OP_REQUIRES_OK(ctx,
+                   ctx->GetAttr("label_positive_rate", &label_positive_rate_));
+    OP_REQUIRES(ctx, label_positive_rate_ >= 0 && label_positive_rate_ <= 1,
+                errors::InvalidArgument(
+                    "label_positive_rate must be in [0, 1], got ",
+                    label_positive_rate_));
+    OP_REQUIRES_OK(ctx, GetFeatures(ctx, "sparse", &sparse_features_));
+    OP_REQUIRES_OK(ctx, GetFeatures(ctx, "sequence", &sequence_features_));
+  }
+
+  void MakeDataset(OpKernelContext* ctx, DatasetBase** output) override {
+    int64 seed;
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<int64>(ctx, "seed", &seed));
+    // By TensorFlow convention, passing 0 indicates that the dataset should
+    // be seeded non-deterministically.
+    if (seed == 0) {
+      seed = random::New64();
+    }
+
+    int64 batch_size;
+    OP_REQUIRES_OK(ctx,
+                   ParseScalarArgument<int64>(ctx, "batch_size", &batch_size));
+    OP_REQUIRES(ctx, batch_size > 0,
+                errors::InvalidArgument("batch_size must be positive, got ",
+                                        batch_size));
+
+    int64 num_batches;
+    OP_REQUIRES_OK(ctx,
+                   ParseScalarArgument<int64>(ctx, "num_batches", &num_batches));
+
+    *output = new Dataset(ctx, seed, batch_size, num_batches, num_dense_,
+                          num_labels_, label_positive_rate_, sparse_features_,
+                          sequence_features_);
+  }
+
+ private:
+  static Status GetFeatures(OpKernelConstruction* ctx, const string& prefix,
+                            std::vector<IdFeature>* features) {
+    std::vector<int64> vocab_sizes;
+    std::vector<float> zipf_exponents;
+    std::vector<int64> max_lengths;
+    TF_RETURN_IF_ERROR(
+        ctx->GetAttr(strings::StrCat(prefix, "_vocab_sizes"), &vocab_sizes));
+    TF_RETURN_IF_ERROR(ctx->GetAttr(
+        strings::StrCat(prefix, "_zipf_exponents"), &zipf_exponents));
+    TF_RETURN_IF_ERROR(
+        ctx->GetAttr(strings::StrCat(prefix, "_max_lengths"), &max_lengths));
+    if (zipf_exponents.size() != vocab_sizes.size() ||
+        max_lengths.size() != vocab_sizes.size()) {
+      return errors::InvalidArgument(
+          prefix, "_vocab_sizes, ", prefix, "_zipf_exponents and ", prefix,
+          "_max_lengths must have the same length");
+    }
+    for (size_t i = 0; i < vocab_sizes.size(); ++i) {
+      if (vocab_sizes[i] <= 0 || zipf_exponents[i] < 0 ||
+          max_lengths[i] <= 0) {
+        return errors::InvalidArgument(
+            "Invalid ", prefix, " feature ", i, ": vocab_size ",
+            vocab_sizes[i], ", zipf_exponent ", zipf_exponents[i],
+            ", max_length ", max_lengths[i]);
+      }
+      features->push_back({vocab_sizes[i], zipf_exponents[i], max_lengths[i]});
+    }
+    return Status::OK();
+  }
+
+  class Dataset : public DatasetBase {
+   public:
+    Dataset(OpKernelContext* ctx, int64 seed, int64 batch_size,
+            int64 num_batches, int64 num_dense, int64 num_labels,
+            float label_positive_rate,
+            const std::vector<IdFeature>& sparse_features,
+            const std::vector<IdFeature>& sequence_features)
+        : DatasetBase(DatasetContext(ctx)),
+          seed_(seed),
+          batch_size_(batch_size),
+          num_batches_(num_batches),
+          num_dense_(num_dense),
+          num_labels_(num_labels),
+          label_positive_rate_(label_positive_rate),
+          sparse_features_(sparse_features),
+          sequence_features_(sequence_features) {
+      for (const IdFeature& f : sparse_features_) {
+        sparse_samplers_.emplace_back(f.vocab_size, f.zipf_exponent);
+      }
+      for (const IdFeature& f : sequence_features_) {
+        sequence_samplers_.emplace_back(f.vocab_size, f.zipf_exponent);
+      }
+      output_dtypes_.push_back(DT_FLOAT);
+      output_shapes_.push_back({batch_size_, num_labels_});
+      if (num_dense_ > 0) {
+        output_dtypes_.push_back(DT_FLOAT);
+        output_shapes_.push_back({batch_size_, num_dense_});
+      }
+      // The sparse features are SparseTensors boxed as by SerializeSparse.
+      for (size_t i = 0; i < sparse_features_.size(); ++i) {
+        output_dtypes_.push_back(DT_VARIANT);
+        output_shapes_.push_back({3});
+      }
+      for (const IdFeature& f : sequence_features_) {
+        output_dtypes_.push_back(DT_INT64);
+        output_shapes_.push_back({batch_size_, f.max_length});
+        output_dtypes_.push_back(DT_INT64);
+        output_shapes_.push_back({batch_size_});
+      }
+    }
+
+    std::unique_ptr<IteratorBase> MakeIteratorInternal(
+        const string& prefix) const override {
+      return absl::make_unique<Iterator>(
+          Iterator::Params{this, strings::StrCat(prefix, "::SyntheticRecsys")});
+    }
+
+    const DataTypeVector& output_dtypes() const override {
+      return output_dtypes_;
+    }
+
+    const std::vector<PartialTensorShape>& output_shapes() const override {
+      return output_shapes_;
+    }
+
+    string DebugString() const override {
+      return strings::StrCat("SyntheticRecsysDatasetOp(", seed_, ", ",
+                             batch_size_, ", ", num_batches_, ")::Dataset");
+    }
+
+    int64 Cardinality() const override {
+      return num_batches_ < 0 ? kInfiniteCardinality : num_batches_;
+    }
+
+    Status CheckExternalState() const override { return Status::OK(); }
+
+   protected:
+    Status AsGraphDefInternal(SerializationContext* ctx,
+                              DatasetGraphDefBuilder* b,
+                              Node** output) const override {
+      Node* seed = nullptr;
+      Node* batch_size = nullptr;
+      Node* num_batches = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(seed_, &seed));
+      TF_RETURN_IF_ERROR(b->AddScalar(batch_size_, &batch_size));
+      TF_RETURN_IF_ERROR(b->AddScalar(num_batches_, &num_batches));
+      std::vector<std::pair<StringPiece, AttrValue>> attrs;
+      AttrValue num_dense;
+      b->BuildAttrValue(num_dense_, &num_dense);
+      attrs.emplace_back("num_dense", num_dense);
+      AttrValue num_labels;
+      b->BuildAttrValue(num_labels_, &num_labels);
+      attrs.emplace_back("num_labels", num_labels);
+      AttrValue label_positive_rate;
+      b->BuildAttrValue(label_positive_rate_, &label_positive_rate);
+      attrs.emplace_back("label_positive_rate", label_positive_rate);
+      AddFeatureAttrs(b, sparse_features_, "sparse_vocab_sizes",
+                      "sparse_zipf_exponents", "sparse_max_lengths", &attrs);
+      AddFeatureAttrs(b, sequence_features_, "sequence_vocab_sizes",
+                      "sequence_zipf_exponents", "sequence_max_lengths",
+                      &attrs);
+      TF_RETURN_IF_ERROR(
+          b->AddDataset(this, {seed, batch_size, num_batches}, attrs, output));
+      return Status::OK();
+    }
+
+   private:
+    static void AddFeatureAttrs(
+        DatasetGraphDefBuilder* b, const std::vector<IdFeature>& features,
+        StringPiece vocab_sizes_name, StringPiece zipf_exponents_name,
+        StringPiece max_lengths_name,
+        std::vector<std::pair<StringPiece, AttrValue>>* attrs) {
+      std::vector<int64> vocab_sizes;
+      std::vector<float> zipf_exponents;
+      std::vector<int64> max_lengths;
+      for (const IdFeature& f : features) {
+        vocab_sizes.push_back(f.vocab_size);
+        zipf_exponents.push_back(f.zipf_exponent);
+        max_lengths.push_back(f.max_length);
+      }
+      AttrValue value;
+      b->BuildAttrValue(vocab_sizes, &value);
+      attrs->emplace_back(vocab_sizes_name, value);
+      b->BuildAttrValue(zipf_exponents, &value);
+      attrs->emplace_back(zipf_exponents_name, value);
+      b->BuildAttrValue(max_lengths, &value);
+      attrs->emplace_back(max_lengths_name, value);
+    }
+
+    class Iterator : public DatasetIterator<Dataset> {
+     public:
+      explicit Iterator(const Params& params)
+          : DatasetIterator<Dataset>(params) {}
+
+      Status GetNextInternal(IteratorContext* ctx,
+                             std::vector<Tensor>* out_tensors,
+                             bool* end_of_sequence) override {
+        int64 batch_index;
+        {
+          mutex_lock l(mu_);
+          if (dataset()->num_batches_ >= 0 &&
+              next_batch_index_ >= dataset()->num_batches_) {
+            *end_of_sequence = true;
+            return Status::OK();
+          }
+          batch_index = next_batch_index_++;
+        }
+        *end_of_sequence = false;
+        dataset()->GenerateBatch(ctx, batch_index, out_tensors);
+        return Status::OK();
+      }
+
+     protected:
+      std::shared_ptr<model::Node> CreateNode(
+          IteratorContext* ctx, model::Node::Args args) const override {
+        return model::MakeSourceNode(std::move(args));
+      }
+
+      Status SaveInternal(IteratorStateWriter* writer) override {
+        mutex_lock l(mu_);
+        TF_RETURN_IF_ERROR(writer->WriteScalar(full_name("next_batch_index"),
+                                               next_batch_index_));
+        return Status::OK();
+      }
+
+      Status RestoreInternal(IteratorContext* ctx,
+                             IteratorStateReader* reader) override {
+        mutex_lock l(mu_);
+        TF_RETURN_IF_ERROR(reader->ReadScalar(full_name("next_batch_index"),
+                                              &next_batch_index_));
+        return Status::OK();
+      }
+
+     private:
+      mutex mu_;
+      int64 next_batch_index_ GUARDED_BY(mu_) = 0;
+    };
+
+    // Every output of a batch is generated by its own task, from a stream
+    // keyed by the seed, the batch index and the output index, so that the
+    // batches only depend on the seed and are generated in parallel.
+    void GenerateBatch(IteratorContext* ctx, int64 batch_index,
+                       std::vector<Tensor>* out_tensors) const {
+      const int num_outputs = output_dtypes_.size();
+      out_tensors->resize(num_outputs);
+      Allocator* allocator = ctx->allocator({});
+      std::vector<std::function<void()>> tasks;
+      auto stream = [this, batch_index, num_outputs](int output) {
+        return random::PhiloxRandom(seed_,
+                                    batch_index * num_outputs + output);
+      };
+      int output = 0;
+      Tensor* labels = &(*out_tensors)[output];
+      tasks.push_back([this, allocator, labels, stream, output]() {
+        random::PhiloxRandom philox = stream(output);
+        random::SimplePhilox rng(&philox);
+        *labels = Tensor(allocator, DT_FLOAT, {batch_size_, num_labels_});
+        auto labels_flat = labels->flat<float>();
+        for (int64 i = 0; i < labels_flat.size(); ++i) {
+          labels_flat(i) = rng.RandFloat() < label_positive_rate_ ? 1.0f : 0.0f;
+        }
+      });
+      ++output;
+      if (num_dense_ > 0) {
+        Tensor* dense = &(*out_tensors)[output];
+        tasks.push_back([this, allocator, dense, stream, output]() {
+          random::PhiloxRandom philox = stream(output);
+          random::SimplePhilox rng(&philox);
+          *dense = Tensor(allocator, DT_FLOAT, {batch_size_, num_dense_});
+          auto dense_flat = dense->flat<float>();
+          for (int64 i = 0; i < dense_flat.size(); ++i) {
+            dense_flat(i) = rng.RandFloat();
+          }
+        });
+        ++output;
+      }
+      for (size_t f = 0; f < sparse_features_.size(); ++f) {
+        Tensor* sparse = &(*out_tensors)[output];
+        tasks.push_back([this, allocator, sparse, stream, output, f]() {
+          random::PhiloxRandom philox = stream(output);
+          random::SimplePhilox rng(&philox);
+          const IdFeature& feature = sparse_features_[f];
+          std::vector<int64> lengths(batch_size_);
+          int64 nnz = 0;
+          for (int64 i = 0; i < batch_size_; ++i) {
+            lengths[i] = 1 + rng.Uniform64(feature.max_length);
+            nnz += lengths[i];
+          }
+          Tensor indices(allocator, DT_INT64, {nnz, 2});
+          Tensor values(allocator, DT_INT64, {nnz});
+          Tensor dense_shape(allocator, DT_INT64, {2});
+          auto indices_matrix = indices.matrix<int64>();
+          auto values_flat = values.flat<int64>();
+          int64 n = 0;
+          for (int64 i = 0; i < batch_size_; ++i) {
+            for (int64 j = 0; j < lengths[i]; ++j, ++n) {
+              indices_matrix(n, 0) = i;
+              indices_matrix(n, 1) = j;
+              values_flat(n) = sparse_samplers_[f].Sample(&rng) - 1;
+            }
+          }
+          dense_shape.vec<int64>()(0) = batch_size_;
+          dense_shape.vec<int64>()(1) = feature.max_length;
+          *sparse = Tensor(allocator, DT_VARIANT, {3});
+          auto sparse_vec = sparse->vec<Variant>();
+          sparse_vec(0) = std::move(indices);
+          sparse_vec(1) = std::move(values);
+          sparse_vec(2) = std::move(dense_shape);
+        });
+        ++output;
+      }
+      for (size_t f = 0; f < sequence_features_.size(); ++f) {
+        Tensor* ids = &(*out_tensors)[output];
+        Tensor* lengths = &(*out_tensors)[output + 1];
+        tasks.push_back([this, allocator, ids, lengths, stream, output, f]() {
+          random::PhiloxRandom philox = stream(output);
+          random::SimplePhilox rng(&philox);
+          const int64 max_length = sequence_features_[f].max_length;
+          *ids = Tensor(allocator, DT_INT64, {batch_size_, max_length});
+          *lengths = Tensor(allocator, DT_INT64, {batch_size_});
+          auto ids_matrix = ids->matrix<int64>();
+          auto lengths_vec = lengths->vec<int64>();
+          for (int64 i = 0; i < batch_size_; ++i) {
+            lengths_vec(i) = 1 + rng.Uniform64(max_length);
+            for (int64 j = 0; j < max_length; ++j) {
+              ids_matrix(i, j) = j < lengths_vec(i)
+                                     ? sequence_samplers_[f].Sample(&rng) - 1
+                                     : 0;
+            }
+          }
+        });
+        output += 2;
+      }
+      BlockingCounter counter(tasks.size() - 1);
+      for (size_t i = 1; i < tasks.size(); ++i) {
+        (*ctx->runner())([&tasks, &counter, i]() {
+          tasks[i]();
+          counter.DecrementCount();
+        });
+      }
+      tasks[0]();
+      counter.Wait();
+    }
+
+    const int64 seed_;
+    const int64 batch_size_;
+    const int64 num_batches_;
+    const int64 num_dense_;
+    const int64 num_labels_;
+    const float label_positive_rate_;
+    const std::vector<IdFeature> sparse_features_;
+    const std::vector<IdFeature> sequence_features_;
+    std::vector<ZipfSampler> sparse_samplers_;
+    std::vector<ZipfSampler> sequence_samplers_;
+    DataTypeVector output_dtypes_;
+    std::vector<PartialTensorShape> output_shapes_;
+  };
+
+  int64 num_dense_;
+  int64 num_labels_;
+  float label_positive_rate_;
+  std::vector<IdFeature> sparse_features_;
+  std::vector<IdFeature> sequence_features_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("SyntheticRecsysDataset").Device(DEVICE_CPU),
+                        SyntheticRecsysDatasetOp);
+
+}  // namespace
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
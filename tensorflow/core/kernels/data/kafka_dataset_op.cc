@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/resource_op_kernel.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/platform/logging.h"
 
 namespace tensorflow {
@@ -27,7 +28,12 @@ namespace data {
 
 class KafkaDatasetOp : public DatasetOpKernel {
  public:
-  using DatasetOpKernel::DatasetOpKernel;
+  explicit KafkaDatasetOp(OpKernelConstruction* ctx) : DatasetOpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("batch_size", &batch_size_));
+    OP_REQUIRES(ctx, batch_size_ >= 0,
+                errors::InvalidArgument(
+                    "batch_size must not be negative, got ", batch_size_));
+  }
 
   void MakeDataset(OpKernelContext* ctx, DatasetBase** output) override {
     const Tensor* topics_tensor;
@@ -78,7 +84,7 @@ class KafkaDatasetOp : public DatasetOpKernel {
 
     *output = new Dataset(ctx, std::move(topics), servers, group, eof, timeout,
                           std::move(config_global), std::move(config_topic),
-                          message_key);
+                          message_key, batch_size_);
   }
 
  private:
@@ -87,7 +93,8 @@ class KafkaDatasetOp : public DatasetOpKernel {
     Dataset(OpKernelContext* ctx, std::vector<string> topics,
             const string& servers, const string& group, const bool eof,
             const int64 timeout, std::vector<string> config_global,
-            std::vector<string> config_topic, const bool message_key)
+            std::vector<string> config_topic, const bool message_key,
+            const int64 batch_size)
         : DatasetBase(DatasetContext(ctx)),
           topics_(std::move(topics)),
           servers_(servers),
@@ -96,7 +103,16 @@ class KafkaDatasetOp : public DatasetOpKernel {
           timeout_(timeout),
           config_global_(std::move(config_global)),
           config_topic_(std::move(config_topic)),
-          message_key_(message_key) {}
+          message_key_(message_key),
+          batch_size_(batch_size) {
+      const int num_outputs = message_key_ ? 2 : 1;
+      output_dtypes_.assign(num_outputs, DT_STRING);
+      // In batch mode every element is a vector of up to batch_size
+      // messages.
+      output_shapes_.assign(num_outputs, batch_size_ > 0
+                                             ? PartialTensorShape({-1})
+                                             : PartialTensorShape({}));
+    }
 
     std::unique_ptr<IteratorBase> MakeIteratorInternal(
         const string& prefix) const override {
@@ -105,24 +121,11 @@ class KafkaDatasetOp : public DatasetOpKernel {
     }
 
     const DataTypeVector& output_dtypes() const override {
-      if (message_key_) {
-        static DataTypeVector* dtypes =
-            new DataTypeVector({DT_STRING, DT_STRING});
-        return *dtypes;
-      }
-      static DataTypeVector* dtypes = new DataTypeVector({DT_STRING});
-      return *dtypes;
+      return output_dtypes_;
     }
 
     const std::vector<PartialTensorShape>& output_shapes() const override {
-      if (message_key_) {
-        static std::vector<PartialTensorShape>* shapes =
-            new std::vector<PartialTensorShape>({{}, {}});
-        return *shapes;
-      }
-      static std::vector<PartialTensorShape>* shapes =
-          new std::vector<PartialTensorShape>({{}});
-      return *shapes;
+      return output_shapes_;
     }
 
     string DebugString() const override { return "KafkaDatasetOp::Dataset"; }
@@ -147,11 +150,13 @@ class KafkaDatasetOp : public DatasetOpKernel {
       TF_RETURN_IF_ERROR(b->AddVector(config_topic_, &config_topic));
       Node* message_key = nullptr;
       TF_RETURN_IF_ERROR(b->AddScalar(message_key_, &message_key));
+      AttrValue batch_size;
+      b->BuildAttrValue(batch_size_, &batch_size);
       TF_RETURN_IF_ERROR(
           b->AddDataset(this,
                         {topics, servers, group, eof, timeout, config_global,
                          config_topic, message_key},
-                        output));
+                        {{"batch_size", batch_size}}, output));
       return Status::OK();
     }
 
@@ -213,6 +218,10 @@ class KafkaDatasetOp : public DatasetOpKernel {
           init_ = true;
         }
 
+        if (dataset()->batch_size_ > 0) {
+          return GetNextBatchLocked(ctx, out_tensors, end_of_sequence);
+        }
+
         while (run_) {
           int64 ts_min = -1;
           int index = -1, i = 0;
@@ -308,6 +317,9 @@ class KafkaDatasetOp : public DatasetOpKernel {
         TF_RETURN_IF_ERROR(
             writer->WriteTensor(full_name("current_pos"), offset_tensor));
         LOG(INFO) << "Save all topic partition current offset." << offset_tensor.DebugString();
+        if (dataset()->batch_size_ > 0) {
+          CommitOffsetsLocked();
+        }
         return Status::OK();
       }
 
@@ -342,6 +354,158 @@ class KafkaDatasetOp : public DatasetOpKernel {
       }
 
      private:
+      struct ConsumerInfo {
+        std::unique_ptr<RdKafka::TopicPartition> topic_partition_;
+        std::unique_ptr<RdKafka::KafkaConsumer> consumer_;
+        std::unique_ptr<RdKafka::Message> message_;
+        int64 offset_ = 0;
+        int64 limit_ = -1;
+        bool eof_ = false;
+        // Whether offset_ is the one of a consumed message, which is
+        // committed on save in batch mode.
+        bool consumed_ = false;
+      };
+
+      // Consumes up to batch_size messages, the partitions in parallel, and
+      // outputs them as one vector. Only the first poll of a partition waits
+      // for up to timeout, the following ones take what librdkafka has
+      // already fetched, so a batch never waits for more than one timeout.
+      Status GetNextBatchLocked(IteratorContext* ctx,
+                                std::vector<Tensor>* out_tensors,
+                                bool* end_of_sequence)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        while (run_) {
+          std::vector<int> active;
+          for (int i = 0; i < consumer_infos_.size(); ++i) {
+            if (!consumer_infos_[i].eof_) {
+              active.push_back(i);
+            }
+          }
+          if (active.empty()) {
+            *end_of_sequence = true;
+            return Status::OK();
+          }
+          const int64 quota =
+              (dataset()->batch_size_ + active.size() - 1) / active.size();
+          std::vector<std::vector<std::unique_ptr<RdKafka::Message>>>
+              messages(active.size());
+          std::vector<Status> statuses(active.size());
+          if (active.size() == 1) {
+            statuses[0] = ConsumeBatch(&consumer_infos_[active[0]], quota,
+                                       &messages[0]);
+          } else {
+            BlockingCounter counter(active.size());
+            for (int j = 0; j < active.size(); ++j) {
+              ConsumerInfo* info = &consumer_infos_[active[j]];
+              (*ctx->runner())([this, info, &messages, &statuses, &counter,
+                                quota, j]() {
+                statuses[j] = ConsumeBatch(info, quota, &messages[j]);
+                counter.DecrementCount();
+              });
+            }
+            counter.Wait();
+          }
+          for (const Status& status : statuses) {
+            TF_RETURN_IF_ERROR(status);
+          }
+
+          int64 total = 0;
+          for (const auto& partition_messages : messages) {
+            total += partition_messages.size();
+          }
+          if (total == 0) {
+            continue;
+          }
+          Tensor line_tensor(cpu_allocator(), DT_STRING, {total});
+          auto lines = line_tensor.vec<string>();
+          Tensor key_tensor;
+          if (dataset()->message_key_) {
+            key_tensor = Tensor(cpu_allocator(), DT_STRING, {total});
+          }
+          int64 k = 0;
+          for (const auto& partition_messages : messages) {
+            for (const auto& message : partition_messages) {
+              lines(k).assign(static_cast<const char*>(message->payload()),
+                              message->len());
+              if (dataset()->message_key_ && message->key() != nullptr) {
+                key_tensor.vec<string>()(k) = *message->key();
+              }
+              ++k;
+            }
+          }
+          out_tensors->emplace_back(std::move(line_tensor));
+          if (dataset()->message_key_) {
+            out_tensors->emplace_back(std::move(key_tensor));
+          }
+          *end_of_sequence = false;
+          return Status::OK();
+        }
+        return errors::Internal(
+            "Failed to consume due to all brokers down");
+      }
+
+      // Consumes up to 'quota' messages of one partition, called without
+      // other threads touching the same ConsumerInfo.
+      Status ConsumeBatch(
+          ConsumerInfo* info, int64 quota,
+          std::vector<std::unique_ptr<RdKafka::Message>>* messages) {
+        messages->reserve(quota);
+        while (messages->size() < quota) {
+          if (info->limit_ >= 0 && info->offset_ >= info->limit_) {
+            info->eof_ = true;
+            break;
+          }
+          std::unique_ptr<RdKafka::Message> message(info->consumer_->consume(
+              messages->empty() ? dataset()->timeout_ : 0));
+          if (message->err() == RdKafka::ERR_NO_ERROR) {
+            info->offset_ = message->offset();
+            info->consumed_ = true;
+            messages->emplace_back(std::move(message));
+          } else if (message->err() == RdKafka::ERR__PARTITION_EOF) {
+            if (dataset()->eof_) {
+              info->eof_ = true;
+            }
+            break;
+          } else if (message->err() == RdKafka::ERR__TIMED_OUT) {
+            break;
+          } else if (message->err() == RdKafka::ERR__TRANSPORT) {
+            // Not return error here because consumer will try re-connect.
+            LOG(ERROR) << "Broker transport failure: " << message->errstr();
+            break;
+          } else {
+            LOG(ERROR) << "Failed to consume: " << message->errstr();
+            return errors::Internal("Failed to consume: ", message->errstr());
+          }
+        }
+        return Status::OK();
+      }
+
+      // Commits the offsets saved in the checkpoint to the consumer group,
+      // so that the group position never runs ahead of the checkpoint.
+      void CommitOffsetsLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (dataset()->group_.empty()) {
+          return;
+        }
+        for (auto& iter : consumer_infos_) {
+          if (iter.consumer_ == nullptr || !iter.consumed_) {
+            continue;
+          }
+          // The committed offset is the one of the next message to read.
+          std::vector<RdKafka::TopicPartition*> offsets = {
+              RdKafka::TopicPartition::create(
+                  iter.topic_partition_->topic(),
+                  iter.topic_partition_->partition(), iter.offset_ + 1)};
+          RdKafka::ErrorCode err = iter.consumer_->commitSync(offsets);
+          if (err != RdKafka::ERR_NO_ERROR) {
+            LOG(WARNING) << "Failed to commit offset " << iter.offset_ + 1
+                         << " of " << iter.topic_partition_->topic() << ":"
+                         << iter.topic_partition_->partition() << ": "
+                         << RdKafka::err2str(err);
+          }
+          RdKafka::TopicPartition::destroy(offsets);
+        }
+      }
+
       // Sets up Kafka streams
       Status SetupStreamsLocked(Env* env) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
         int32_t size = dataset()->topics_.size();
@@ -371,6 +535,7 @@ class KafkaDatasetOp : public DatasetOpKernel {
               RdKafka::TopicPartition::create(topic, partition, offset));
 
           consumer_infos_[i].offset_ = consumer_infos_[i].topic_partition_->offset();
+          consumer_infos_[i].consumed_ = false;
           consumer_infos_[i].limit_ = -1;
           if (parts.size() > 3) {
             if (!strings::safe_strto64(parts[3], &consumer_infos_[i].limit_)) {
@@ -474,14 +639,6 @@ class KafkaDatasetOp : public DatasetOpKernel {
 
       mutex mu_;
       bool run_ GUARDED_BY(mu_) = true;
-      struct ConsumerInfo {
-        std::unique_ptr<RdKafka::TopicPartition> topic_partition_;
-        std::unique_ptr<RdKafka::KafkaConsumer> consumer_;
-        std::unique_ptr<RdKafka::Message> message_;
-        int64 offset_ = 0;
-        int64 limit_ = -1;
-        bool eof_ = false;
-      };
       bool init_ = false;
       std::vector<ConsumerInfo> consumer_infos_ GUARDED_BY(mu_);
       KafkaEventCb kafka_event_cb = KafkaEventCb(run_);
@@ -495,7 +652,12 @@ class KafkaDatasetOp : public DatasetOpKernel {
     const std::vector<string> config_global_;
     const std::vector<string> config_topic_;
     const bool message_key_;
+    const int64 batch_size_;
+    DataTypeVector output_dtypes_;
+    std::vector<PartialTensorShape> output_shapes_;
   };
+
+  int64 batch_size_;
 };
 
 class WriteKafkaOp : public OpKernel {
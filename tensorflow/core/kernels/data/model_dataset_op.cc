@@ -13,6 +13,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <ctime>
+
 #include "absl/memory/memory.h"
 #include "tensorflow/core/common_runtime/metrics.h"
 #include "tensorflow/core/framework/dataset.h"
@@ -32,6 +34,31 @@ constexpr int64 kOptimizationPeriodThresholdMs = 60 * EnvTime::kSecondsToMillis;
 // Default share of available RAM that can be used by model's internal buffers.
 constexpr double kRamBudgetShare = 0.5;
 
+// The CPU time used by the process and by the input pipeline up to some time.
+struct CpuUsage {
+  int64 wall_nanos = 0;
+  int64 process_nanos = 0;
+  int64 pipeline_nanos = 0;
+};
+
+// Returns the share of `num_cpus` which the rest of the process, e.g. the
+// training threads, left to the input pipeline since `last`, and updates
+// `last` to `now`.
+int64 SharedCpuBudget(int64 num_cpus, const CpuUsage& now, CpuUsage* last) {
+  int64 cpu_budget = num_cpus;
+  const int64 wall_nanos = now.wall_nanos - last->wall_nanos;
+  if (last->wall_nanos > 0 && wall_nanos > 0) {
+    const int64 other_nanos =
+        (now.process_nanos - last->process_nanos) -
+        (now.pipeline_nanos - last->pipeline_nanos);
+    cpu_budget -= std::llround(static_cast<double>(std::max<int64>(
+                                   other_nanos, 0)) /
+                               wall_nanos);
+  }
+  *last = now;
+  return std::max<int64>(cpu_budget, 1);
+}
+
 class ModelDatasetOp : public UnaryDatasetOpKernel {
  public:
   explicit ModelDatasetOp(OpKernelConstruction* ctx)
@@ -44,6 +71,9 @@ class ModelDatasetOp : public UnaryDatasetOpKernel {
       algorithm_ = model::AutotuneAlgorithm::HILL_CLIMB;
     }
     OP_REQUIRES_OK(ctx, ctx->GetAttr("cpu_budget", &cpu_budget_));
+    // Without an explicit budget, the input pipeline shares the cores with
+    // the rest of the process.
+    shared_cpu_budget_ = cpu_budget_ == 0;
     if (cpu_budget_ == 0) {
       cpu_budget_ = port::NumSchedulableCPUs();
     }
@@ -55,7 +85,8 @@ class ModelDatasetOp : public UnaryDatasetOpKernel {
 
   void MakeDataset(OpKernelContext* ctx, DatasetBase* input,
                    DatasetBase** output) override {
-    *output = new Dataset(ctx, input, algorithm_, cpu_budget_, ram_budget_);
+    *output = new Dataset(ctx, input, algorithm_, cpu_budget_,
+                          shared_cpu_budget_, ram_budget_);
   }
 
  private:
@@ -63,11 +94,12 @@ class ModelDatasetOp : public UnaryDatasetOpKernel {
    public:
     Dataset(OpKernelContext* ctx, const DatasetBase* input,
             model::AutotuneAlgorithm algorithm, int64 cpu_budget,
-            int64 ram_budget)
+            bool shared_cpu_budget, int64 ram_budget)
         : DatasetBase(DatasetContext(ctx)),
           input_(input),
           algorithm_(algorithm),
           cpu_budget_(cpu_budget),
+          shared_cpu_budget_(shared_cpu_budget),
           ram_budget_(ram_budget) {
       input_->Ref();
     }
@@ -181,6 +213,7 @@ class ModelDatasetOp : public UnaryDatasetOpKernel {
         int64 optimization_period_ms = 10;
         int64 current_time_ms =
             ctx->env()->NowMicros() / EnvTime::kMillisToMicros;
+        CpuUsage last_usage;
         while (true) {
           {
             mutex_lock l(mu_);
@@ -196,7 +229,18 @@ class ModelDatasetOp : public UnaryDatasetOpKernel {
             }
             if (cancelled_) return;
           }
-          model_->Optimize(dataset()->algorithm_, dataset()->cpu_budget_,
+          int64 cpu_budget = dataset()->cpu_budget_;
+          if (dataset()->shared_cpu_budget_) {
+            CpuUsage usage;
+            usage.wall_nanos = ctx->env()->NowNanos();
+            usage.process_nanos = static_cast<int64>(
+                static_cast<double>(std::clock()) *
+                EnvTime::kSecondsToNanos / CLOCKS_PER_SEC);
+            usage.pipeline_nanos = model_->TotalProcessingTimeNanos();
+            cpu_budget = SharedCpuBudget(cpu_budget, usage, &last_usage);
+            VLOG(2) << "CPU budget of the input pipeline: " << cpu_budget;
+          }
+          model_->Optimize(dataset()->algorithm_, cpu_budget,
                            dataset()->ram_budget_);
           // Exponentially increase the period of running the optimization
           // until a threshold is reached.
@@ -220,11 +264,13 @@ class ModelDatasetOp : public UnaryDatasetOpKernel {
     const DatasetBase* input_;
     const model::AutotuneAlgorithm algorithm_;
     const int64 cpu_budget_;
+    const bool shared_cpu_budget_;
     const int64 ram_budget_;
   };
 
   model::AutotuneAlgorithm algorithm_;
   int64 cpu_budget_;
+  bool shared_cpu_budget_;
   int64 ram_budget_;
 };
 
@@ -14,17 +14,149 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/parquet_batch_reader.h"
 
+#include <algorithm>
 #include <memory>
 #include <numeric>
 #include <string>
 #include <vector>
 
 #include "absl/strings/match.h"
+#include "arrow/compute/api.h"
+#include "parquet/metadata.h"
+#include "parquet/statistics.h"
 #include "tensorflow/core/kernels/data/arrow_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace tensorflow {
 namespace data {
 
+namespace {
+// Threads decoding the columns of all parquet batch readers, nullptr when
+// ARROW_NUM_THREADS = 0.
+thread::ThreadPool* GetColumnReaderThreadPool() {
+  static thread::ThreadPool* pool = []() -> thread::ThreadPool* {
+    int num_threads = ArrowUtil::UpdateArrowCpuThreadPoolCapacityFromEnv();
+    if (num_threads == 0) {
+      return nullptr;
+    }
+    if (num_threads < 0) {
+      num_threads = port::NumSchedulableCPUs();
+    }
+    return new thread::ThreadPool(Env::Default(), "parquet_column_reader",
+                                  num_threads);
+  }();
+  return pool;
+}
+
+enum class FilterOp { EQ, NE, LT, LE, GT, GE };
+
+// A predicate `column op value` on a primitive column.
+struct Filter {
+  string name;
+  FilterOp op;
+  // Name of the arrow compute function of op.
+  string function;
+  std::shared_ptr<::arrow::Scalar> scalar;
+  // Index of the column reader of the column.
+  size_t reader_index = 0;
+  // Leaf column index in the parquet schema, -1 when the row group
+  // statistics of the column are not used.
+  int leaf_index = -1;
+  bool is_integer = false;
+  bool is_floating = false;
+  bool is_string = false;
+  int64 int_value = 0;
+  double float_value = 0;
+  string string_value;
+};
+
+Status ParseFilterOp(const string& op, FilterOp* filter_op,
+                     string* function) {
+  static const std::vector<std::pair<string, FilterOp>> kOps = {
+      {"==", FilterOp::EQ}, {"!=", FilterOp::NE}, {"<", FilterOp::LT},
+      {"<=", FilterOp::LE}, {">", FilterOp::GT},  {">=", FilterOp::GE}};
+  static const std::vector<string> kFunctions = {
+      "equal", "not_equal", "less", "less_equal", "greater", "greater_equal"};
+  for (size_t i = 0; i < kOps.size(); ++i) {
+    if (kOps[i].first == op) {
+      *filter_op = kOps[i].second;
+      *function = kFunctions[i];
+      return Status::OK();
+    }
+  }
+  return errors::InvalidArgument("Unsupported filter operator `", op,
+                                 "`, which should be one of ==, !=, <, <=, "
+                                 ">, >=");
+}
+
+// Returns false when no value in [min, max] satisfies `value op v`.
+template <typename T>
+bool RangeMayMatch(FilterOp op, const T& min, const T& max, const T& v) {
+  switch (op) {
+    case FilterOp::EQ:
+      return min <= v && v <= max;
+    case FilterOp::NE:
+      return !(min == v && max == v);
+    case FilterOp::LT:
+      return min < v;
+    case FilterOp::LE:
+      return min <= v;
+    case FilterOp::GT:
+      return max > v;
+    case FilterOp::GE:
+      return max >= v;
+  }
+  return true;
+}
+
+// Returns false when no row of the column chunk satisfies filter.
+bool RowGroupMayMatch(const Filter& filter,
+                      const std::shared_ptr<::parquet::Statistics>& stats) {
+  if (!stats || !stats->HasMinMax()) {
+    return true;
+  }
+  switch (stats->physical_type()) {
+    case ::parquet::Type::INT32: {
+      if (!filter.is_integer) return true;
+      auto typed = static_cast<::parquet::Int32Statistics*>(stats.get());
+      return RangeMayMatch<int64>(filter.op, typed->min(), typed->max(),
+                                  filter.int_value);
+    }
+    case ::parquet::Type::INT64: {
+      if (!filter.is_integer) return true;
+      auto typed = static_cast<::parquet::Int64Statistics*>(stats.get());
+      return RangeMayMatch<int64>(filter.op, typed->min(), typed->max(),
+                                  filter.int_value);
+    }
+    case ::parquet::Type::FLOAT: {
+      if (!filter.is_floating) return true;
+      auto typed = static_cast<::parquet::FloatStatistics*>(stats.get());
+      return RangeMayMatch<double>(filter.op, typed->min(), typed->max(),
+                                   filter.float_value);
+    }
+    case ::parquet::Type::DOUBLE: {
+      if (!filter.is_floating) return true;
+      auto typed = static_cast<::parquet::DoubleStatistics*>(stats.get());
+      return RangeMayMatch<double>(filter.op, typed->min(), typed->max(),
+                                   filter.float_value);
+    }
+    case ::parquet::Type::BYTE_ARRAY: {
+      if (!filter.is_string) return true;
+      auto typed = static_cast<::parquet::ByteArrayStatistics*>(stats.get());
+      return RangeMayMatch<string>(
+          filter.op, ::parquet::ByteArrayToString(typed->min()),
+          ::parquet::ByteArrayToString(typed->max()), filter.string_value);
+    }
+    default:
+      return true;
+  }
+}
+}  // namespace
+
 class ParquetBatchReader::Impl {
  public:
   Impl(const string& filename, const int64 batch_size,
@@ -32,7 +164,10 @@ class ParquetBatchReader::Impl {
        const DataTypeVector& field_dtypes,
        const std::vector<int32>& field_ragged_ranks,
        const int64 partition_count, const int64 partition_index,
-       const bool drop_remainder)
+       const bool drop_remainder, const std::vector<string>& filter_names,
+       const std::vector<string>& filter_ops,
+       const std::vector<string>& filter_values,
+       const std::vector<int64>& field_hash_buckets)
       : filename_(filename),
         batch_size_(batch_size),
         field_names_(field_names),
@@ -40,10 +175,19 @@ class ParquetBatchReader::Impl {
         field_ragged_ranks_(field_ragged_ranks),
         partition_count_(partition_count),
         partition_index_(partition_index),
-        drop_remainder_(drop_remainder) {}
+        drop_remainder_(drop_remainder),
+        filter_names_(filter_names),
+        filter_ops_(filter_ops),
+        filter_values_(filter_values),
+        field_hash_buckets_(field_hash_buckets),
+        hash_caches_(field_names.size()) {
+    if (field_hash_buckets_.empty()) {
+      field_hash_buckets_.resize(field_names_.size(), 0);
+    }
+  }
 
   Status Open() {
-    if (TF_PREDICT_TRUE(batch_reader_)) {
+    if (TF_PREDICT_TRUE(opened_)) {
       return Status::OK();
     }
     if (TF_PREDICT_FALSE(partition_index_ >= partition_count_)) {
@@ -55,21 +199,35 @@ class ParquetBatchReader::Impl {
       return errors::InvalidArgument("Partition index ", partition_index_,
                                      "must be greater than 0");
     }
+    if (TF_PREDICT_FALSE(filter_ops_.size() != filter_names_.size() ||
+                         filter_values_.size() != filter_names_.size())) {
+      return errors::InvalidArgument(
+          "Filters have ", filter_names_.size(), " names, ",
+          filter_ops_.size(), " operators and ", filter_values_.size(),
+          " values");
+    }
+    if (TF_PREDICT_FALSE(drop_remainder_ && !filter_names_.empty())) {
+      return errors::InvalidArgument(
+          "drop_remainder is not supported with filters, the filtered "
+          "batches have less than batch_size rows");
+    }
+    if (TF_PREDICT_FALSE(field_hash_buckets_.size() != field_names_.size())) {
+      return errors::InvalidArgument(
+          "Fields have ", field_names_.size(), " names and ",
+          field_hash_buckets_.size(), " hash buckets");
+    }
 
     std::shared_ptr<::arrow::io::RandomAccessFile> file;
     TF_RETURN_IF_ARROW_ERROR(ArrowUtil::OpenArrowFile(&file, filename_));
     TF_RETURN_IF_ARROW_ERROR(ArrowUtil::OpenParquetReader(&reader_, file));
 
-    int num_row_groups = reader_->num_row_groups();
-    for (int g = partition_index_; g < num_row_groups; g += partition_count_) {
-      row_group_indices_.push_back(g);
-    }
     std::shared_ptr<::arrow::Schema> schema;
     TF_RETURN_IF_ARROW_ERROR(reader_->GetSchema(&schema));
     if (TF_PREDICT_FALSE(!schema->HasDistinctFieldNames())) {
       return errors::InvalidArgument(filename_,
                                      " must has distinct column names");
     }
+    std::vector<int> dictionary_columns;
     for (size_t i = 0; i < field_names_.size(); ++i) {
       auto& cname = field_names_[i];
       int column_index = schema->GetFieldIndex(cname);
@@ -96,37 +254,307 @@ class ParquetBatchReader::Impl {
             "Field ", cname, " in ", filename_, " has unexpected ragged rank ",
             actual_ragged_rank, ", which should be ", expected_ragged_rank);
       }
+      if (field_hash_buckets_[i] > 0) {
+        if (TF_PREDICT_FALSE(actual_dtype != DT_STRING)) {
+          return errors::InvalidArgument("Field ", cname, " in ", filename_,
+                                         " to hash must be a string field");
+        }
+        // The strings of lists are hashed one by one.
+        if (expected_ragged_rank == 0) {
+          dictionary_columns.push_back(
+              reader_->manifest().schema_fields[column_index].column_index);
+        }
+      }
+    }
+    TF_RETURN_IF_ERROR(MakeFilters(*schema));
+    // The columns to hash are read as dictionaries, which needs a reader
+    // opened with them.
+    if (!dictionary_columns.empty()) {
+      TF_RETURN_IF_ARROW_ERROR(
+          ArrowUtil::OpenParquetReader(&reader_, file, dictionary_columns));
+    }
+
+    // The row groups whose statistics show that no row satisfies the
+    // filters are skipped.
+    auto metadata = reader_->parquet_reader()->metadata();
+    int num_row_groups = reader_->num_row_groups();
+    for (int g = partition_index_; g < num_row_groups; g += partition_count_) {
+      bool may_match = true;
+      auto row_group = metadata->RowGroup(g);
+      for (auto& filter : filters_) {
+        if (filter.leaf_index >= 0 &&
+            !RowGroupMayMatch(
+                filter,
+                row_group->ColumnChunk(filter.leaf_index)->statistics())) {
+          may_match = false;
+          break;
+        }
+      }
+      if (may_match) {
+        row_group_indices_.push_back(g);
+      }
     }
+    VLOG(1) << "Reading " << row_group_indices_.size() << " row groups of "
+            << filename_;
     reader_->set_batch_size(batch_size_);
 
-    TF_RETURN_IF_ARROW_ERROR(reader_->GetRecordBatchReader(
-        row_group_indices_, column_indices_, &batch_reader_));
+    // Every column has its own reader, so that the columns are decoded
+    // and converted to tensors at the same time.
+    column_readers_.resize(column_indices_.size());
+    for (size_t i = 0; i < column_indices_.size(); ++i) {
+      TF_RETURN_IF_ARROW_ERROR(reader_->GetRecordBatchReader(
+          row_group_indices_, {column_indices_[i]}, &column_readers_[i]));
+    }
+    opened_ = true;
     return Status::OK();
   }
 
+  ~Impl() {
+    // The prefetched batch uses the column readers.
+    if (next_batch_) {
+      WaitForBatch(next_batch_.get()).IgnoreError();
+    }
+  }
+
   Status Read(std::vector<Tensor>* output_tensors) {
-    // Read next batch from parquet file.
-    std::shared_ptr<::arrow::RecordBatch> batch;
-    TF_RETURN_IF_ARROW_ERROR(batch_reader_->ReadNext(&batch));
-    if (TF_PREDICT_FALSE(!batch)) {
-      return errors::OutOfRange("Reached end of parquet file ", filename_);
+    while (true) {
+      // Read next batch from parquet file, the batch after it is prefetched
+      // while the tensors of this batch are consumed.
+      if (!next_batch_) {
+        next_batch_ = StartReadBatch();
+      }
+      std::unique_ptr<Batch> batch = std::move(next_batch_);
+      TF_RETURN_IF_ERROR(WaitForBatch(batch.get()));
+      int64 num_rows = -1;
+      for (size_t i = 0; i < batch->num_rows.size(); ++i) {
+        if (TF_PREDICT_FALSE(i > 0 && batch->num_rows[i] != num_rows)) {
+          return errors::Internal("Column ", column_name(i), " in ",
+                                  filename_, " has ", batch->num_rows[i],
+                                  " rows in the batch, which should be ",
+                                  num_rows);
+        }
+        num_rows = batch->num_rows[i];
+      }
+      if (TF_PREDICT_FALSE(num_rows < 0)) {
+        return errors::OutOfRange("Reached end of parquet file ", filename_);
+      }
+      if (TF_PREDICT_FALSE(drop_remainder_ && num_rows < batch_size_)) {
+        return errors::OutOfRange("Reached end of parquet file ", filename_,
+                                  " after dropping reminder batch");
+      }
+      next_batch_ = StartReadBatch();
+
+      if (!filters_.empty()) {
+        int64 num_selected_rows = 0;
+        TF_RETURN_IF_ERROR(FilterBatch(batch.get(), &num_selected_rows));
+        if (num_selected_rows == 0) {
+          continue;
+        }
+      }
+
+      // Populate tensors from record batch.
+      for (size_t i = 0; i < field_names_.size(); ++i) {
+        auto& tensors = batch->column_tensors[i];
+        output_tensors->insert(output_tensors->end(), tensors.begin(),
+                               tensors.end());
+      }
+      return Status::OK();
+    }
+  }
+
+ private:
+  // The tensors of a batch read by the column readers.
+  struct Batch {
+    explicit Batch(size_t num_columns)
+        : arrays(num_columns),
+          column_tensors(num_columns),
+          num_rows(num_columns, -1) {}
+
+    // The arrays of the columns, which are kept before the filters are
+    // applied.
+    std::vector<std::shared_ptr<::arrow::Array>> arrays;
+    std::vector<std::vector<Tensor>> column_tensors;
+    // -1 when the column has no more rows.
+    std::vector<int64> num_rows;
+    mutex mu;
+    condition_variable cv;
+    size_t pending_columns GUARDED_BY(mu) = 0;
+    Status status GUARDED_BY(mu);
+  };
+
+  const string& column_name(size_t i) const {
+    return i < field_names_.size() ? field_names_[i]
+                                   : filter_names_[extra_filter_columns_[
+                                         i - field_names_.size()]];
+  }
+
+  Status MakeFilters(const ::arrow::Schema& schema) {
+    const auto& manifest = reader_->manifest();
+    for (size_t i = 0; i < filter_names_.size(); ++i) {
+      Filter filter;
+      filter.name = filter_names_[i];
+      TF_RETURN_IF_ERROR(
+          ParseFilterOp(filter_ops_[i], &filter.op, &filter.function));
+      int column_index = schema.GetFieldIndex(filter.name);
+      if (TF_PREDICT_FALSE(column_index < 0)) {
+        return errors::NotFound("No column called `", filter.name,
+                                "` to filter found in ", filename_);
+      }
+      auto type = schema.field(column_index)->type();
+      if (TF_PREDICT_FALSE(type->id() == ::arrow::Type::LIST)) {
+        return errors::InvalidArgument("Column ", filter.name, " in ",
+                                       filename_,
+                                       " to filter must not be a list");
+      }
+      TF_CHECKED_ARROW_ASSIGN(filter.scalar,
+                              ::arrow::Scalar::Parse(type, filter_values_[i]));
+
+      // The filter columns which are not outputs have extra readers.
+      auto it = std::find(column_indices_.begin(), column_indices_.end(),
+                          column_index);
+      filter.reader_index = it - column_indices_.begin();
+      if (TF_PREDICT_FALSE(it != column_indices_.end() &&
+                           field_hash_buckets_[filter.reader_index] > 0)) {
+        return errors::InvalidArgument("Column ", filter.name, " in ",
+                                       filename_,
+                                       " to filter must not be hashed");
+      }
+      if (it == column_indices_.end()) {
+        column_indices_.push_back(column_index);
+        extra_filter_columns_.push_back(i);
+      }
+
+      // Unsigned integers are not compared by the signed statistics.
+      if (::arrow::is_signed_integer(type->id())) {
+        filter.is_integer =
+            strings::safe_strto64(filter_values_[i], &filter.int_value);
+      } else if (::arrow::is_floating(type->id())) {
+        filter.is_floating =
+            strings::safe_strtod(filter_values_[i].c_str(),
+                                 &filter.float_value);
+      } else if (type->id() == ::arrow::Type::STRING ||
+                 type->id() == ::arrow::Type::BINARY) {
+        filter.is_string = true;
+        filter.string_value = filter_values_[i];
+      }
+      if (filter.is_integer || filter.is_floating || filter.is_string) {
+        filter.leaf_index = manifest.schema_fields[column_index].column_index;
+      }
+      filters_.emplace_back(std::move(filter));
+    }
+    return Status::OK();
+  }
+
+  // Runs fn of the columns in the column reader threads, or in the calling
+  // thread when there are no column reader threads.
+  void RunColumns(Batch* batch, const std::function<Status(size_t)>& fn) {
+    const size_t num_columns = column_readers_.size();
+    {
+      mutex_lock l(batch->mu);
+      batch->pending_columns = num_columns;
     }
-    if (TF_PREDICT_FALSE(drop_remainder_ && batch->num_rows() < batch_size_)) {
-      return errors::OutOfRange("Reached end of parquet file ", filename_,
-                                " after dropping reminder batch");
+    auto run = [batch, fn](size_t i) {
+      Status s = fn(i);
+      mutex_lock l(batch->mu);
+      batch->status.Update(s);
+      if (--batch->pending_columns == 0) {
+        batch->cv.notify_all();
+      }
+    };
+    thread::ThreadPool* pool = GetColumnReaderThreadPool();
+    for (size_t i = 0; i < num_columns; ++i) {
+      if (pool == nullptr) {
+        run(i);
+      } else {
+        pool->Schedule([run, i]() { run(i); });
+      }
     }
+  }
 
-    // Populate tensors from record batch.
-    auto arrays = batch->columns();
-    for (size_t i = 0; i < arrays.size(); ++i) {
-      TF_RETURN_IF_ERROR(ArrowUtil::MakeTensorsFromArrowArray(
-          field_dtypes_[i], field_ragged_ranks_[i], arrays[i], output_tensors));
+  Status ReadColumn(Batch* batch, size_t i) {
+    std::shared_ptr<::arrow::RecordBatch> record_batch;
+    TF_RETURN_IF_ARROW_ERROR(column_readers_[i]->ReadNext(&record_batch));
+    if (!record_batch) {
+      return Status::OK();
+    }
+    batch->num_rows[i] = record_batch->num_rows();
+    batch->arrays[i] = record_batch->column(0);
+    if (!filters_.empty()) {
+      return Status::OK();
     }
+    return MakeColumnTensors(i, batch->arrays[i], &batch->column_tensors[i]);
+  }
 
-    return Status::OK();
+  // The columns of a batch are converted by one thread at a time, so that
+  // the dictionary hash cache of a column is not shared.
+  Status MakeColumnTensors(size_t i,
+                           const std::shared_ptr<::arrow::Array>& array,
+                           std::vector<Tensor>* tensors) {
+    if (field_hash_buckets_[i] > 0) {
+      return ArrowUtil::MakeHashedTensorsFromArrowArray(
+          field_ragged_ranks_[i], field_hash_buckets_[i], array,
+          &hash_caches_[i], tensors);
+    }
+    return ArrowUtil::MakeTensorsFromArrowArray(
+        field_dtypes_[i], field_ragged_ranks_[i], array, tensors);
+  }
+
+  std::unique_ptr<Batch> StartReadBatch() {
+    std::unique_ptr<Batch> batch(new Batch(column_readers_.size()));
+    Batch* b = batch.get();
+    RunColumns(b, [this, b](size_t i) { return ReadColumn(b, i); });
+    return batch;
+  }
+
+  // Drops the rows of batch which do not satisfy the filters before the
+  // arrays are converted to tensors.
+  Status FilterBatch(Batch* batch, int64* num_selected_rows) {
+    ::arrow::Datum mask;
+    for (auto& filter : filters_) {
+      ::arrow::Datum selected;
+      TF_CHECKED_ARROW_ASSIGN(
+          selected, ::arrow::compute::CallFunction(
+                        filter.function,
+                        {batch->arrays[filter.reader_index], filter.scalar}));
+      if (mask.kind() == ::arrow::Datum::NONE) {
+        mask = selected;
+      } else {
+        TF_CHECKED_ARROW_ASSIGN(
+            mask, ::arrow::compute::CallFunction("and", {mask, selected}));
+      }
+    }
+    auto mask_array =
+        std::static_pointer_cast<::arrow::BooleanArray>(mask.make_array());
+    // The rows compared with null are dropped.
+    *num_selected_rows = mask_array->true_count();
+    if (*num_selected_rows == 0) {
+      return Status::OK();
+    }
+    const bool filter_rows = *num_selected_rows != mask_array->length();
+    RunColumns(batch, [this, batch, &mask, filter_rows](size_t i) -> Status {
+      if (i >= field_names_.size()) {
+        return Status::OK();
+      }
+      std::shared_ptr<::arrow::Array> array = batch->arrays[i];
+      if (filter_rows) {
+        ::arrow::Datum filtered;
+        TF_CHECKED_ARROW_ASSIGN(filtered,
+                                ::arrow::compute::Filter(array, mask));
+        array = filtered.make_array();
+      }
+      return MakeColumnTensors(i, array, &batch->column_tensors[i]);
+    });
+    return WaitForBatch(batch);
+  }
+
+  Status WaitForBatch(Batch* batch) {
+    mutex_lock l(batch->mu);
+    while (batch->pending_columns > 0) {
+      batch->cv.wait(l);
+    }
+    return batch->status;
   }
 
- private:
   const string filename_;
   const int64 batch_size_;
   std::vector<string> field_names_;
@@ -135,8 +563,19 @@ class ParquetBatchReader::Impl {
   int64 partition_count_;
   int64 partition_index_;
   bool drop_remainder_;
+  std::vector<string> filter_names_;
+  std::vector<string> filter_ops_;
+  std::vector<string> filter_values_;
+  std::vector<int64> field_hash_buckets_;
+  std::vector<ArrowUtil::DictionaryHashCache> hash_caches_;
+  std::vector<Filter> filters_;
+  // Index in the filters of the filter columns which are not outputs,
+  // their readers follow the readers of the outputs.
+  std::vector<size_t> extra_filter_columns_;
   std::unique_ptr<::parquet::arrow::FileReader> reader_;
-  std::unique_ptr<::arrow::RecordBatchReader> batch_reader_;
+  bool opened_ = false;
+  std::vector<std::unique_ptr<::arrow::RecordBatchReader>> column_readers_;
+  std::unique_ptr<Batch> next_batch_;
   std::vector<int> row_group_indices_;
   std::vector<int> column_indices_;
 };
@@ -145,10 +584,15 @@ ParquetBatchReader::ParquetBatchReader(
     const string& filename, const int64 batch_size,
     const std::vector<string>& field_names, const DataTypeVector& field_dtypes,
     const std::vector<int32>& field_ragged_ranks, const int64 partition_count,
-    const int64 partition_index, const bool drop_remainder)
+    const int64 partition_index, const bool drop_remainder,
+    const std::vector<string>& filter_names,
+    const std::vector<string>& filter_ops,
+    const std::vector<string>& filter_values,
+    const std::vector<int64>& field_hash_buckets)
     : pimpl_(new ParquetBatchReader::Impl(
           filename, batch_size, field_names, field_dtypes, field_ragged_ranks,
-          partition_count, partition_index, drop_remainder)) {}
+          partition_count, partition_index, drop_remainder, filter_names,
+          filter_ops, filter_values, field_hash_buckets)) {}
 
 Status ParquetBatchReader::Open() { return pimpl_->Open(); }
 
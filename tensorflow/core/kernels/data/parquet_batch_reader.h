@@ -24,6 +24,14 @@ limitations under the License.
 namespace tensorflow {
 namespace data {
 
+// Reads batches of the fields from the row groups of a parquet file.
+// The rows are filtered by the conjunction of `filter_names[i]
+// filter_ops[i] filter_values[i]`, the row groups whose statistics show no
+// row satisfies the filters are skipped, and the other rows are dropped
+// before they are converted to tensors. The string fields i with
+// field_hash_buckets[i] > 0 are read as the int64 hash buckets of their
+// strings, like StringToHashBucketFast, hashing the entries of the
+// dictionaries of the dictionary-encoded columns once.
 class ParquetBatchReader {
  public:
   ParquetBatchReader(const string& filename, const int64 batch_size,
@@ -31,7 +39,11 @@ class ParquetBatchReader {
                      const DataTypeVector& field_dtypes,
                      const std::vector<int32>& field_ragged_ranks,
                      const int64 partition_count, const int64 partition_index,
-                     const bool drop_remainder);
+                     const bool drop_remainder,
+                     const std::vector<string>& filter_names,
+                     const std::vector<string>& filter_ops,
+                     const std::vector<string>& filter_values,
+                     const std::vector<int64>& field_hash_buckets = {});
 
   Status Open();
 
@@ -38,7 +38,10 @@ class ParquetTabularDatasetOp::Dataset : public DatasetBase {
           const DataTypeVector& field_dtypes,
           const std::vector<int32>& field_ragged_ranks,
           const int64 partition_count, const int64 partition_index,
-          const bool drop_remainder)
+          const bool drop_remainder, const std::vector<string>& filter_names,
+          const std::vector<string>& filter_ops,
+          const std::vector<string>& filter_values,
+          const std::vector<int64>& field_hash_buckets)
       : DatasetBase(DatasetContext(ctx)),
         filename_(std::move(filename)),
         batch_size_(batch_size),
@@ -47,10 +50,19 @@ class ParquetTabularDatasetOp::Dataset : public DatasetBase {
         field_ragged_ranks_(std::move(field_ragged_ranks)),
         partition_count_(partition_count),
         partition_index_(partition_index),
-        drop_remainder_(drop_remainder) {
+        drop_remainder_(drop_remainder),
+        filter_names_(filter_names),
+        filter_ops_(filter_ops),
+        filter_values_(filter_values),
+        field_hash_buckets_(field_hash_buckets) {
     int64 num_outputs = field_names.size();
     for (int64 i = 0; i < field_names.size(); ++i) {
-      output_dtypes_.push_back(std::move(field_dtypes[i]));
+      // The hashed string fields are int64 buckets.
+      if (i < field_hash_buckets_.size() && field_hash_buckets_[i] > 0) {
+        output_dtypes_.push_back(DT_INT64);
+      } else {
+        output_dtypes_.push_back(field_dtypes[i]);
+      }
       for (int64 j = 0; j < field_ragged_ranks_[i]; ++j) {
         output_dtypes_.push_back(DT_INT32);
       }
@@ -64,7 +76,8 @@ class ParquetTabularDatasetOp::Dataset : public DatasetBase {
     reader_ = absl::make_unique<ParquetBatchReader>(
         filename_, batch_size_, field_names_, field_dtypes_,
         field_ragged_ranks_, partition_count_, partition_index_,
-        drop_remainder_);
+        drop_remainder_, filter_names_, filter_ops_, filter_values_,
+        field_hash_buckets_);
   }
 
   Status Open() {
@@ -107,6 +120,14 @@ class ParquetTabularDatasetOp::Dataset : public DatasetBase {
     b->BuildAttrValue(partition_index_, &partition_index);
     AttrValue drop_remainder;
     b->BuildAttrValue(drop_remainder_, &drop_remainder);
+    AttrValue filter_names;
+    b->BuildAttrValue(filter_names_, &filter_names);
+    AttrValue filter_ops;
+    b->BuildAttrValue(filter_ops_, &filter_ops);
+    AttrValue filter_values;
+    b->BuildAttrValue(filter_values_, &filter_values);
+    AttrValue field_hash_buckets;
+    b->BuildAttrValue(field_hash_buckets_, &field_hash_buckets);
     TF_RETURN_IF_ERROR(
         b->AddDataset(this, {{0, filename}, {1, batch_size}}, {},
                       {{"field_names", field_names},
@@ -114,7 +135,11 @@ class ParquetTabularDatasetOp::Dataset : public DatasetBase {
                        {"field_ragged_ranks", field_ragged_ranks},
                        {"partition_count", partition_count},
                        {"partition_index", partition_index},
-                       {"drop_remainder", drop_remainder}},
+                       {"drop_remainder", drop_remainder},
+                       {"filter_names", filter_names},
+                       {"filter_ops", filter_ops},
+                       {"filter_values", filter_values},
+                       {"field_hash_buckets", field_hash_buckets}},
                       output));
     return Status::OK();
   }
@@ -129,6 +154,10 @@ class ParquetTabularDatasetOp::Dataset : public DatasetBase {
   const int64 partition_count_;
   const int64 partition_index_;
   const bool drop_remainder_;
+  const std::vector<string> filter_names_;
+  const std::vector<string> filter_ops_;
+  const std::vector<string> filter_values_;
+  const std::vector<int64> field_hash_buckets_;
   DataTypeVector output_dtypes_;
   std::vector<PartialTensorShape> output_shapes_;
   std::unique_ptr<ParquetBatchReader> reader_;
@@ -157,6 +186,11 @@ class ParquetTabularDatasetOp::Dataset::Iterator
   }
 
  protected:
+  std::shared_ptr<model::Node> CreateNode(
+      IteratorContext* ctx, model::Node::Args args) const override {
+    return model::MakeSourceNode(std::move(args));
+  }
+
   Status SaveInternal(IteratorStateWriter* writer) override {
     return errors::Unimplemented("SaveInternal is currently not supported");
   }
@@ -189,6 +223,11 @@ ParquetTabularDatasetOp::ParquetTabularDatasetOp(OpKernelConstruction* ctx)
   OP_REQUIRES_OK(ctx, ctx->GetAttr("partition_count", &partition_count_));
   OP_REQUIRES_OK(ctx, ctx->GetAttr("partition_index", &partition_index_));
   OP_REQUIRES_OK(ctx, ctx->GetAttr("drop_remainder", &drop_remainder_));
+  OP_REQUIRES_OK(ctx, ctx->GetAttr("filter_names", &filter_names_));
+  OP_REQUIRES_OK(ctx, ctx->GetAttr("filter_ops", &filter_ops_));
+  OP_REQUIRES_OK(ctx, ctx->GetAttr("filter_values", &filter_values_));
+  OP_REQUIRES_OK(ctx,
+                 ctx->GetAttr("field_hash_buckets", &field_hash_buckets_));
 }
 
 void ParquetTabularDatasetOp::MakeDataset(OpKernelContext* ctx,
@@ -203,7 +242,8 @@ void ParquetTabularDatasetOp::MakeDataset(OpKernelContext* ctx,
 
   Dataset* ds = new Dataset(
       ctx, filename, batch_size, field_names_, field_dtypes_,
-      field_ragged_ranks_, partition_count_, partition_index_, drop_remainder_);
+      field_ragged_ranks_, partition_count_, partition_index_, drop_remainder_,
+      filter_names_, filter_ops_, filter_values_, field_hash_buckets_);
   OP_REQUIRES_OK(ctx, ds->Open());
   *output = ds;
 }
@@ -35,6 +35,10 @@ class ParquetTabularDatasetOp : public DatasetOpKernel {
   int64 partition_count_;
   int64 partition_index_;
   bool drop_remainder_;
+  std::vector<string> filter_names_;
+  std::vector<string> filter_ops_;
+  std::vector<string> filter_values_;
+  std::vector<int64> field_hash_buckets_;
 };
 
 }  // namespace data
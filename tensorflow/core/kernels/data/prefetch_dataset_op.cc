@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/metrics.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/framework/stall_stats.h"
 #include "tensorflow/core/framework/stats_aggregator.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/data/dataset_utils.h"
@@ -148,6 +149,8 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
       if (buffer_size_->value == model::kAutotune) {
         buffer_size_->value = 0;
       }
+      stall_counters_ =
+          StallStats::Global()->Get(strings::StrCat("Dataset/", prefix()));
       TF_RETURN_IF_ERROR(
           ConnectCancellationManagers(ctx->cancellation_manager(),
                                       &cancellation_manager_, &deregister_fn_));
@@ -163,12 +166,16 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
         TF_RETURN_IF_ERROR(EnsurePrefetchThreadStarted(ctx));
         // Wait until the next element in the buffer has been
         // produced, or we are shutting down.
+        int64 wait_start_nanos = 0;
         if (legacy_autotune_) {
           while (!cancellation_manager_.IsCancelled() && buffer_.empty() &&
                  !prefetch_thread_finished_ &&
                  auto_tuner_.buffer_limit() != 0) {
             auto_tuner_.RecordEmpty();
             buffer_size_->value = auto_tuner_.buffer_limit();
+            if (wait_start_nanos == 0) {
+              wait_start_nanos = ctx->env()->NowNanos();
+            }
             RecordStop(ctx);
             cond_var_->wait(l);
             RecordStart(ctx);
@@ -176,11 +183,18 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
         } else {
           while (!cancellation_manager_.IsCancelled() && buffer_.empty() &&
                  !prefetch_thread_finished_ && buffer_size_->value != 0) {
+            if (wait_start_nanos == 0) {
+              wait_start_nanos = ctx->env()->NowNanos();
+            }
             RecordStop(ctx);
             cond_var_->wait(l);
             RecordStart(ctx);
           }
         }
+        if (wait_start_nanos > 0) {
+          stall_counters_->RecordConsumerWait(ctx->env()->NowNanos() -
+                                              wait_start_nanos);
+        }
 
         if (cancellation_manager_.IsCancelled()) {
           return errors::Cancelled(
@@ -377,12 +391,20 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
         // 1. Wait for a slot in the buffer.
         {
           mutex_lock l(*mu_);
+          int64 wait_start_nanos = 0;
           while (!cancellation_manager_.IsCancelled() &&
                  buffer_.size() >= buffer_limit()) {
+            if (wait_start_nanos == 0) {
+              wait_start_nanos = ctx->env()->NowNanos();
+            }
             RecordStop(ctx.get());
             cond_var_->wait(l);
             RecordStart(ctx.get());
           }
+          if (wait_start_nanos > 0) {
+            stall_counters_->RecordProducerWait(ctx->env()->NowNanos() -
+                                                wait_start_nanos);
+          }
 
           if (cancellation_manager_.IsCancelled()) {
             return;
@@ -474,6 +496,9 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
     std::unique_ptr<IteratorBase> input_impl_ GUARDED_BY(*parent_mu_);
     const std::shared_ptr<condition_variable> cond_var_;
     PrefetchAutotuner auto_tuner_ GUARDED_BY(*mu_);
+    // The waits of GetNext for elements and of the prefetch thread for
+    // buffer slots, shared by the iterators of the same stage.
+    StallCounters* stall_counters_ = nullptr;
     std::deque<BufferElement> buffer_ GUARDED_BY(*mu_);
     std::unique_ptr<Thread> prefetch_thread_ GUARDED_BY(*mu_);
     bool cancelled_ GUARDED_BY(*mu_) = false;
@@ -18,12 +18,16 @@ limitations under the License.
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/data/name_utils.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
 #include "tensorflow/core/lib/io/buffered_inputstream.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
 #include "tensorflow/core/lib/io/random_inputstream.h"
 #include "tensorflow/core/lib/io/record_reader.h"
 #include "tensorflow/core/lib/io/zlib_compression_options.h"
 #include "tensorflow/core/lib/io/zlib_inputstream.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
 
 namespace tensorflow {
 namespace data {
@@ -39,6 +43,82 @@ namespace data {
 constexpr char kCurrentFileIndex[] = "current_file_index";
 constexpr char kOffset[] = "offset";
 
+namespace {
+
+// Parses the file slice `<filename>#<begin>:<end>`, which holds the records
+// whose header starts in the byte range [begin, end) of the file.
+bool ParseFileSlice(const string& spec, string* filename, uint64* begin,
+                    uint64* end) {
+  const size_t pos = spec.rfind('#');
+  if (pos == string::npos) {
+    return false;
+  }
+  std::vector<string> range = str_util::Split(spec.substr(pos + 1), ':');
+  if (range.size() != 2 || !strings::safe_strtou64(range[0], begin) ||
+      !strings::safe_strtou64(range[1], end) || *begin > *end) {
+    return false;
+  }
+  *filename = spec.substr(0, pos);
+  return true;
+}
+
+// Finds the offset of the first record whose header starts in [begin, end)
+// of an uncompressed TFRecord file of `file_size` bytes, `end` if there is
+// none. A candidate must have both the CRC of its length and the CRC of its
+// data right, so the data of a record is practically never taken for a
+// header.
+Status FindFirstRecord(RandomAccessFile* file, uint64 file_size, uint64 begin,
+                       uint64 end, uint64* offset) {
+  constexpr size_t kHeaderSize = io::RecordReader::kHeaderSize;
+  constexpr size_t kFooterSize = io::RecordReader::kFooterSize;
+  constexpr uint64 kScanSize = 256 << 10;
+  end = std::min(end, file_size);
+  if (begin == 0 || begin >= end) {
+    *offset = std::min(begin, end);
+    return Status::OK();
+  }
+  std::unique_ptr<char[]> scratch(new char[kScanSize + kHeaderSize]);
+  string data;
+  for (uint64 window_begin = begin; window_begin < end;
+       window_begin += kScanSize) {
+    const uint64 num_candidates = std::min(kScanSize, end - window_begin);
+    StringPiece window;
+    Status s = file->Read(window_begin, num_candidates + kHeaderSize - 1,
+                          &window, scratch.get());
+    if (!s.ok() && !errors::IsOutOfRange(s)) {
+      return s;
+    }
+    for (uint64 i = 0; i < num_candidates && i + kHeaderSize <= window.size();
+         ++i) {
+      const char* header = window.data() + i;
+      if (crc32c::Unmask(core::DecodeFixed32(header + sizeof(uint64))) !=
+          crc32c::Value(header, sizeof(uint64))) {
+        continue;
+      }
+      const uint64 candidate = window_begin + i;
+      const uint64 length = core::DecodeFixed64(header);
+      if (candidate + kHeaderSize + kFooterSize > file_size ||
+          length > file_size - candidate - kHeaderSize - kFooterSize) {
+        continue;
+      }
+      data.resize(length + kFooterSize);
+      StringPiece record;
+      TF_RETURN_IF_ERROR(file->Read(candidate + kHeaderSize, data.size(),
+                                    &record, &data[0]));
+      if (record.size() == data.size() &&
+          crc32c::Unmask(core::DecodeFixed32(record.data() + length)) ==
+              crc32c::Value(record.data(), length)) {
+        *offset = candidate;
+        return Status::OK();
+      }
+    }
+  }
+  *offset = end;
+  return Status::OK();
+}
+
+}  // namespace
+
 class TFRecordDatasetOp::Dataset : public DatasetBase {
  public:
   explicit Dataset(OpKernelContext* ctx, std::vector<string> filenames,
@@ -106,8 +186,12 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
         if (reader_) {
           out_tensors->emplace_back(ctx->allocator({}), DT_STRING,
                                     TensorShape({}));
-          Status s =
-              reader_->ReadRecord(&out_tensors->back().scalar<string>()());
+          // A file slice ends before the first record which starts after
+          // it, which the next slice reads.
+          Status s = reader_->TellOffset() < slice_end_
+                         ? reader_->ReadRecord(
+                               &out_tensors->back().scalar<string>()())
+                         : errors::OutOfRange("end of file slice");
           if (s.ok()) {
             metrics::RecordTFDataBytesRead(
                 kDatasetType, out_tensors->back().scalar<tstring>()().size());
@@ -185,10 +269,29 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
       }
 
       // Actually move on to next file.
-      const string& next_filename = dataset()->filenames_[current_file_index_];
+      string next_filename = dataset()->filenames_[current_file_index_];
+      uint64 slice_begin = 0;
+      slice_end_ = kuint64max;
+      const bool is_slice = ParseFileSlice(next_filename, &next_filename,
+                                           &slice_begin, &slice_end_);
+      if (is_slice && dataset()->options_.compression_type !=
+                          io::RecordReaderOptions::NONE) {
+        return errors::InvalidArgument(
+            "File slices of compressed TFRecord files are not supported: ",
+            dataset()->filenames_[current_file_index_]);
+      }
       TF_RETURN_IF_ERROR(env->NewRandomAccessFile(next_filename, &file_));
       reader_ = absl::make_unique<io::SequentialRecordReader>(
           file_.get(), dataset()->options_);
+      if (is_slice) {
+        uint64 file_size = 0;
+        TF_RETURN_IF_ERROR(env->GetFileSize(next_filename, &file_size));
+        uint64 first_record = 0;
+        TF_RETURN_IF_ERROR(FindFirstRecord(file_.get(), file_size,
+                                           slice_begin, slice_end_,
+                                           &first_record));
+        TF_RETURN_IF_ERROR(reader_->SeekOffset(first_record));
+      }
       return Status::OK();
     }
 
@@ -196,6 +299,7 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
     void ResetStreamsLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       reader_.reset();
       file_.reset();
+      slice_end_ = kuint64max;
     }
 
     mutex mu_;
@@ -205,6 +309,8 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
     // we must destroy `reader_` before `file_`.
     std::unique_ptr<RandomAccessFile> file_ GUARDED_BY(mu_);
     std::unique_ptr<io::SequentialRecordReader> reader_ GUARDED_BY(mu_);
+    // The end of the byte range of a file slice, kuint64max for a file.
+    uint64 slice_end_ GUARDED_BY(mu_) = kuint64max;
   };
 
   const std::vector<string> filenames_;
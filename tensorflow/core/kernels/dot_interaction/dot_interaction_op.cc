@@ -0,0 +1,168 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+int64 OutputWidth(int64 num, int64 dim, bool concat_first_feature) {
+  return num * (num - 1) / 2 + (concat_first_feature ? dim : 0);
+}
+
+template <typename T>
+T Dot(const T* a, const T* b, int64 dim) {
+  T sum = 0;
+  for (int64 d = 0; d < dim; ++d) {
+    sum += a[d] * b[d];
+  }
+  return sum;
+}
+
+}  // namespace
+
+// Computes only the pairwise dots that DLRM keeps, instead of the batch
+// matmul of all pairs, the mask of its lower triangle, the boolean_mask,
+// reshape and concat of the unfused graph.
+template <typename T>
+class DotInteractionOp : public OpKernel {
+ public:
+  explicit DotInteractionOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("concat_first_feature",
+                                             &concat_first_feature_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& features_tensor = context->input(0);
+    OP_REQUIRES(context, features_tensor.dims() == 3,
+                errors::InvalidArgument("features must be 3-D, got ",
+                                        features_tensor.shape().DebugString()));
+    const int64 batch = features_tensor.dim_size(0);
+    const int64 num = features_tensor.dim_size(1);
+    const int64 dim = features_tensor.dim_size(2);
+    const int64 width = OutputWidth(num, dim, concat_first_feature_);
+    OP_REQUIRES(context, !concat_first_feature_ || num > 0,
+                errors::InvalidArgument(
+                    "features must have a first feature to concat"));
+
+    Tensor* output_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, TensorShape({batch, width}), &output_tensor));
+
+    const T* features = features_tensor.flat<T>().data();
+    T* output = output_tensor->flat<T>().data();
+    const bool concat_first_feature = concat_first_feature_;
+
+    auto compute = [&](int64 begin, int64 end) {
+      for (int64 n = begin; n < end; ++n) {
+        const T* f = features + n * num * dim;
+        T* out = output + n * width;
+        if (concat_first_feature) {
+          std::copy_n(f, dim, out);
+          out += dim;
+        }
+        for (int64 i = 1; i < num; ++i) {
+          const T* f_i = f + i * dim;
+          for (int64 j = 0; j < i; ++j) {
+            *out++ = Dot(f_i, f + j * dim, dim);
+          }
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, batch,
+          num * num * dim + width, compute);
+  }
+
+ private:
+  bool concat_first_feature_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("DotInteraction")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<float>("T"),
+                        DotInteractionOp<float>);
+
+template <typename T>
+class DotInteractionGradOp : public OpKernel {
+ public:
+  explicit DotInteractionGradOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("concat_first_feature",
+                                             &concat_first_feature_));
+  }
+
+  // The gradient of the dot of features i and j, g, adds g * f_j to the
+  // gradient of f_i and g * f_i to the gradient of f_j.
+  void Compute(OpKernelContext* context) override {
+    const Tensor& grad_tensor = context->input(0);
+    const Tensor& features_tensor = context->input(1);
+    OP_REQUIRES(context, features_tensor.dims() == 3,
+                errors::InvalidArgument("features must be 3-D, got ",
+                                        features_tensor.shape().DebugString()));
+    const int64 batch = features_tensor.dim_size(0);
+    const int64 num = features_tensor.dim_size(1);
+    const int64 dim = features_tensor.dim_size(2);
+    const int64 width = OutputWidth(num, dim, concat_first_feature_);
+    OP_REQUIRES(context,
+                grad_tensor.shape() == TensorShape({batch, width}),
+                errors::InvalidArgument("Mismatched shape of output_grad ",
+                                        grad_tensor.shape().DebugString()));
+
+    Tensor* features_grad_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, features_tensor.shape(),
+                                &features_grad_tensor));
+
+    const T* grad = grad_tensor.flat<T>().data();
+    const T* features = features_tensor.flat<T>().data();
+    T* features_grad = features_grad_tensor->flat<T>().data();
+    const bool concat_first_feature = concat_first_feature_;
+
+    auto compute = [&](int64 begin, int64 end) {
+      for (int64 n = begin; n < end; ++n) {
+        const T* f = features + n * num * dim;
+        const T* g = grad + n * width;
+        T* df = features_grad + n * num * dim;
+        if (concat_first_feature) {
+          std::copy_n(g, dim, df);
+          std::fill(df + dim, df + num * dim, static_cast<T>(0));
+          g += dim;
+        } else {
+          std::fill(df, df + num * dim, static_cast<T>(0));
+        }
+        for (int64 i = 1; i < num; ++i) {
+          const T* f_i = f + i * dim;
+          T* df_i = df + i * dim;
+          for (int64 j = 0; j < i; ++j) {
+            const T g_ij = *g++;
+            const T* f_j = f + j * dim;
+            T* df_j = df + j * dim;
+            for (int64 d = 0; d < dim; ++d) {
+              df_i[d] += g_ij * f_j[d];
+              df_j[d] += g_ij * f_i[d];
+            }
+          }
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, batch,
+          2 * num * num * dim, compute);
+  }
+
+ private:
+  bool concat_first_feature_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("DotInteractionGrad")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<float>("T"),
+                        DotInteractionGradOp<float>);
+
+}  // namespace tensorflow
@@ -0,0 +1,62 @@
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class DotInteractionOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op, bool concat_first_feature) {
+    NodeDefBuilder builder("dot_interaction", op);
+    if (op == "DotInteractionGrad") {
+      builder.Input(FakeInput(DT_FLOAT));
+    }
+    TF_EXPECT_OK(builder.Input(FakeInput(DT_FLOAT))
+                     .Attr("concat_first_feature", concat_first_feature)
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+};
+
+// features [1, 3, 2]: f0 = [1, 2], f1 = [3, 4], f2 = [5, 6].
+TEST_F(DotInteractionOpTest, LowerTriangle) {
+  MakeOp("DotInteraction", true);
+  AddInputFromArray<float>(TensorShape({1, 3, 2}), {1, 2, 3, 4, 5, 6});
+  TF_ASSERT_OK(RunOpKernel());
+
+  // f0, then f1.f0, f2.f0, f2.f1
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({1, 5}));
+  test::FillValues<float>(&expected, {1, 2, 11, 17, 39});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(DotInteractionOpTest, WithoutFirstFeature) {
+  MakeOp("DotInteraction", false);
+  AddInputFromArray<float>(TensorShape({2, 2, 1}), {1, 2, 3, 4});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 1}));
+  test::FillValues<float>(&expected, {2, 12});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(DotInteractionOpTest, Grad) {
+  MakeOp("DotInteractionGrad", true);
+  AddInputFromArray<float>(TensorShape({1, 5}), {1, 1, 1, 0, 2});
+  AddInputFromArray<float>(TensorShape({1, 3, 2}), {1, 2, 3, 4, 5, 6});
+  TF_ASSERT_OK(RunOpKernel());
+
+  // df0 = [1, 1] + 1 * f1, df1 = 1 * f0 + 2 * f2, df2 = 2 * f1
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({1, 3, 2}));
+  test::FillValues<float>(&expected, {4, 5, 11, 14, 6, 8});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,402 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#include "tensorflow/core/kernels/embedding_delta_stream.h"
+
+#include <cstring>
+
+#include "rdkafkacpp.h"
+#include "tensorflow/core/framework/embedding/embedding_var.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/raw_coding.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace embedding {
+
+namespace {
+// The layout of an encoded batch, the integers are little endian:
+//  * magic, fixed32.
+//  * delta_seq, timestamp_ms, value_len and the number of keys, fixed64.
+//  * The size of tensor_name, fixed32, and its bytes.
+//  * The keys, int64, and the values, float.
+const uint32 kEmbeddingDeltaMagic = 0x31445645;
+const size_t kEmbeddingDeltaHeaderBytes = 4 + 4 * 8 + 4;
+
+template <class K>
+Status ApplyRows(ResourceMgr* rm, const EmbeddingDeltaBatch& batch) {
+  EmbeddingVar<K, float>* ev = nullptr;
+  TF_RETURN_IF_ERROR(
+      rm->Lookup(rm->default_container(), batch.tensor_name, &ev));
+  core::ScopedUnref unref(ev);
+  if (ev->ValueLen() != batch.value_len) {
+    return errors::InvalidArgument("The value_len ", batch.value_len,
+        " of the delta of ", batch.tensor_name,
+        " mismatches the EmbeddingVariable of value_len ", ev->ValueLen());
+  }
+  std::vector<K> keys(batch.keys.begin(), batch.keys.end());
+  return ev->ApplyDelta(keys.data(), batch.values.data(), keys.size());
+}
+} // namespace
+
+void EmbeddingDeltaBatch::Encode(std::string* out) const {
+  out->clear();
+  out->reserve(kEmbeddingDeltaHeaderBytes + tensor_name.size() +
+               keys.size() * sizeof(int64) + values.size() * sizeof(float));
+  core::PutFixed32(out, kEmbeddingDeltaMagic);
+  core::PutFixed64(out, delta_seq);
+  core::PutFixed64(out, timestamp_ms);
+  core::PutFixed64(out, value_len);
+  core::PutFixed64(out, keys.size());
+  core::PutFixed32(out, tensor_name.size());
+  out->append(tensor_name);
+  out->append(reinterpret_cast<const char*>(keys.data()),
+              keys.size() * sizeof(int64));
+  out->append(reinterpret_cast<const char*>(values.data()),
+              values.size() * sizeof(float));
+}
+
+Status EmbeddingDeltaBatch::Decode(StringPiece data) {
+  if (data.size() < kEmbeddingDeltaHeaderBytes ||
+      core::DecodeFixed32(data.data()) != kEmbeddingDeltaMagic) {
+    return errors::DataLoss("Invalid EmbeddingDeltaBatch of ", data.size(),
+                            " bytes");
+  }
+  const char* p = data.data() + 4;
+  delta_seq = core::DecodeFixed64(p);
+  timestamp_ms = core::DecodeFixed64(p + 8);
+  value_len = core::DecodeFixed64(p + 16);
+  const uint64 num_keys = core::DecodeFixed64(p + 24);
+  const uint32 name_size = core::DecodeFixed32(p + 32);
+  p += 36;
+  const uint64 row_bytes = sizeof(int64) + value_len * sizeof(float);
+  if (value_len < 0 ||
+      data.size() - kEmbeddingDeltaHeaderBytes < name_size ||
+      (data.size() - kEmbeddingDeltaHeaderBytes - name_size) !=
+          num_keys * row_bytes) {
+    return errors::DataLoss("Truncated EmbeddingDeltaBatch of ",
+                            data.size(), " bytes");
+  }
+  tensor_name.assign(p, name_size);
+  p += name_size;
+  keys.resize(num_keys);
+  memcpy(keys.data(), p, num_keys * sizeof(int64));
+  p += num_keys * sizeof(int64);
+  values.resize(num_keys * value_len);
+  memcpy(values.data(), p, values.size() * sizeof(float));
+  return Status::OK();
+}
+
+EmbeddingDeltaPublisher* EmbeddingDeltaPublisher::GetInstance() {
+  static EmbeddingDeltaPublisher publisher("TF_EV_DELTA_STREAM", "none");
+  return &publisher;
+}
+
+EmbeddingDeltaPublisher* EmbeddingDeltaPublisher::GetReplicaInstance() {
+  static EmbeddingDeltaPublisher publisher("TF_EV_REPLICA", "lz4");
+  return &publisher;
+}
+
+EmbeddingDeltaPublisher::EmbeddingDeltaPublisher(
+    const std::string& env_prefix, const std::string& default_compression) {
+  std::string brokers;
+  std::string compression;
+  TF_CHECK_OK(ReadStringFromEnvVar(env_prefix + "_BROKERS", "",
+                                   &brokers));
+  TF_CHECK_OK(ReadStringFromEnvVar(env_prefix + "_TOPIC", "",
+                                   &topic_));
+  TF_CHECK_OK(ReadInt64FromEnvVar(env_prefix + "_BATCH_KEYS", 4096,
+                                  &batch_keys_));
+  TF_CHECK_OK(ReadStringFromEnvVar(env_prefix + "_COMPRESSION",
+                                   default_compression, &compression));
+  if (batch_keys_ <= 0) {
+    batch_keys_ = 4096;
+  }
+  if (brokers.empty() || topic_.empty()) {
+    return;
+  }
+  std::string errstr;
+  std::unique_ptr<RdKafka::Conf> conf(
+      RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL));
+  if (conf->set("bootstrap.servers", brokers, errstr) !=
+          RdKafka::Conf::CONF_OK ||
+      conf->set("linger.ms", "5", errstr) != RdKafka::Conf::CONF_OK ||
+      conf->set("compression.codec", compression, errstr) !=
+          RdKafka::Conf::CONF_OK) {
+    LOG(ERROR) << "Failed to configure the " << env_prefix
+               << " producer: " << errstr;
+    return;
+  }
+  producer_.reset(RdKafka::Producer::create(conf.get(), errstr));
+  if (producer_ == nullptr) {
+    LOG(ERROR) << "Failed to create the " << env_prefix << " producer: "
+               << errstr;
+    return;
+  }
+  LOG(INFO) << "Publish the " << env_prefix << " deltas to topic "
+            << topic_ << " of " << brokers;
+}
+
+EmbeddingDeltaPublisher::~EmbeddingDeltaPublisher() {
+  if (producer_ != nullptr) {
+    producer_->flush(10 * 1000);
+  }
+}
+
+Status EmbeddingDeltaPublisher::Publish(const EmbeddingDeltaBatch& batch) {
+  if (producer_ == nullptr) {
+    return errors::FailedPrecondition(
+        "The delta stream publisher is disabled.");
+  }
+  std::string payload;
+  batch.Encode(&payload);
+  mutex_lock l(mu_);
+  while (true) {
+    RdKafka::ErrorCode err = producer_->produce(topic_,
+        RdKafka::Topic::PARTITION_UA, RdKafka::Producer::RK_MSG_COPY,
+        const_cast<char*>(payload.data()), payload.size(),
+        batch.tensor_name.data(), batch.tensor_name.size(),
+        batch.timestamp_ms, nullptr);
+    if (err == RdKafka::ERR_NO_ERROR) {
+      break;
+    }
+    if (err != RdKafka::ERR__QUEUE_FULL) {
+      return errors::Unavailable("Failed to publish the delta of ",
+                                 batch.tensor_name, ": ",
+                                 RdKafka::err2str(err));
+    }
+    // The local queue drains as the brokers acknowledge the messages.
+    producer_->poll(100);
+  }
+  producer_->poll(0);
+  return Status::OK();
+}
+
+Status EmbeddingDeltaPublisher::Flush(int64 timeout_ms) {
+  if (producer_ == nullptr) {
+    return Status::OK();
+  }
+  mutex_lock l(mu_);
+  RdKafka::ErrorCode err = producer_->flush(timeout_ms);
+  if (err != RdKafka::ERR_NO_ERROR) {
+    return errors::DeadlineExceeded("Failed to flush the delta stream: ",
+                                    RdKafka::err2str(err));
+  }
+  return Status::OK();
+}
+
+EmbeddingDeltaSubscriber::EmbeddingDeltaSubscriber(
+    const std::string& brokers, const std::string& topic,
+    const std::string& group, const std::string& offset_reset)
+    : brokers_(brokers), topic_(topic), group_(group),
+      offset_reset_(offset_reset) {}
+
+EmbeddingDeltaSubscriber::~EmbeddingDeltaSubscriber() {
+  if (consumer_ != nullptr) {
+    consumer_->close();
+  }
+}
+
+Status EmbeddingDeltaSubscriber::Init() {
+  std::string errstr;
+  std::unique_ptr<RdKafka::Conf> conf(
+      RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL));
+  if (conf->set("bootstrap.servers", brokers_, errstr) !=
+          RdKafka::Conf::CONF_OK ||
+      conf->set("group.id", group_, errstr) != RdKafka::Conf::CONF_OK ||
+      conf->set("auto.offset.reset", offset_reset_, errstr) !=
+          RdKafka::Conf::CONF_OK ||
+      conf->set("enable.auto.commit", "true", errstr) !=
+          RdKafka::Conf::CONF_OK) {
+    return errors::InvalidArgument(
+        "Failed to configure the delta stream consumer: ", errstr);
+  }
+  consumer_.reset(RdKafka::KafkaConsumer::create(conf.get(), errstr));
+  if (consumer_ == nullptr) {
+    return errors::Internal(
+        "Failed to create the delta stream consumer: ", errstr);
+  }
+  RdKafka::ErrorCode err = consumer_->subscribe({topic_});
+  if (err != RdKafka::ERR_NO_ERROR) {
+    return errors::Unavailable("Failed to subscribe to ", topic_, ": ",
+                               RdKafka::err2str(err));
+  }
+  return Status::OK();
+}
+
+Status EmbeddingDeltaSubscriber::Consume(int64 timeout_ms,
+    EmbeddingDeltaBatch* batch, bool* has_batch) {
+  *has_batch = false;
+  std::unique_ptr<RdKafka::Message> message(consumer_->consume(timeout_ms));
+  switch (message->err()) {
+    case RdKafka::ERR_NO_ERROR:
+      TF_RETURN_IF_ERROR(batch->Decode(StringPiece(
+          static_cast<const char*>(message->payload()), message->len())));
+      *has_batch = true;
+      return Status::OK();
+    case RdKafka::ERR__TIMED_OUT:
+    case RdKafka::ERR__PARTITION_EOF:
+      return Status::OK();
+    default:
+      return errors::Unavailable("Failed to consume the delta stream: ",
+                                 message->errstr());
+  }
+}
+
+Status ApplyEmbeddingDeltaBatch(ResourceMgr* rm,
+                                const EmbeddingDeltaBatch& batch) {
+  if (batch.values.size() != batch.keys.size() * batch.value_len) {
+    return errors::InvalidArgument("The delta of ", batch.tensor_name,
+        " has ", batch.keys.size(), " keys but ", batch.values.size(),
+        " values of value_len ", batch.value_len);
+  }
+  Status s = ApplyRows<int64>(rm, batch);
+  if (errors::IsNotFound(s)) {
+    s = ApplyRows<int32>(rm, batch);
+  }
+  return s;
+}
+
+EmbeddingReplicaApplier::EmbeddingReplicaApplier(ResourceMgr* rm,
+    std::unique_ptr<EmbeddingDeltaSubscriber> subscriber)
+    : rm_(rm), subscriber_(std::move(subscriber)) {
+  if (subscriber_ != nullptr) {
+    thread_.reset(Env::Default()->StartThread(
+        ThreadOptions(), "ev_replica_applier", [this] { Loop(); }));
+  }
+}
+
+EmbeddingReplicaApplier::~EmbeddingReplicaApplier() {
+  stop_ = true;
+  // Joins the thread.
+  thread_.reset();
+}
+
+void EmbeddingReplicaApplier::MaybeStart(ResourceMgr* rm) {
+  bool standby = false;
+  TF_CHECK_OK(ReadBoolFromEnvVar("TF_EV_REPLICA_STANDBY", false, &standby));
+  if (!standby) {
+    return;
+  }
+  static mutex mu(LINKER_INITIALIZED);
+  static EmbeddingReplicaApplier* applier = nullptr;
+  mutex_lock l(mu);
+  if (applier != nullptr) {
+    return;
+  }
+  std::string brokers, topic, group;
+  TF_CHECK_OK(ReadStringFromEnvVar("TF_EV_REPLICA_BROKERS", "", &brokers));
+  TF_CHECK_OK(ReadStringFromEnvVar("TF_EV_REPLICA_TOPIC", "", &topic));
+  TF_CHECK_OK(ReadStringFromEnvVar("TF_EV_REPLICA_GROUP",
+                                   topic + "_standby", &group));
+  if (brokers.empty() || topic.empty()) {
+    LOG(ERROR) << "TF_EV_REPLICA_STANDBY needs TF_EV_REPLICA_BROKERS and"
+               << " TF_EV_REPLICA_TOPIC.";
+    return;
+  }
+  std::unique_ptr<EmbeddingDeltaSubscriber> subscriber(
+      new EmbeddingDeltaSubscriber(brokers, topic, group, "earliest"));
+  Status s = subscriber->Init();
+  if (!s.ok()) {
+    LOG(ERROR) << "Failed to start the EmbeddingVariable replica: " << s;
+    return;
+  }
+  applier = new EmbeddingReplicaApplier(rm, std::move(subscriber));
+  LOG(INFO) << "Replicate the EmbeddingVariables of topic " << topic
+            << " of " << brokers;
+}
+
+void EmbeddingReplicaApplier::Apply(const EmbeddingDeltaBatch& batch) {
+  Status s = ApplyEmbeddingDeltaBatch(rm_, batch);
+  if (!errors::IsNotFound(s)) {
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to apply the replica of " << batch.tensor_name
+                   << ": " << s;
+    }
+    return;
+  }
+  mutex_lock l(mu_);
+  PendingRows& pending = pending_[batch.tensor_name];
+  pending.value_len = batch.value_len;
+  for (size_t i = 0; i < batch.keys.size(); i++) {
+    const float* row = batch.values.data() + i * batch.value_len;
+    pending.rows[batch.keys[i]].assign(row, row + batch.value_len);
+  }
+}
+
+void EmbeddingReplicaApplier::ApplyPending() {
+  mutex_lock l(mu_);
+  for (auto it = pending_.begin(); it != pending_.end();) {
+    EmbeddingDeltaBatch batch;
+    batch.tensor_name = it->first;
+    batch.value_len = it->second.value_len;
+    batch.keys.reserve(it->second.rows.size());
+    batch.values.reserve(it->second.rows.size() * batch.value_len);
+    for (const auto& row : it->second.rows) {
+      batch.keys.push_back(row.first);
+      batch.values.insert(batch.values.end(), row.second.begin(),
+                          row.second.end());
+    }
+    Status s = ApplyEmbeddingDeltaBatch(rm_, batch);
+    if (errors::IsNotFound(s)) {
+      ++it;
+      continue;
+    }
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to apply the replica of " << it->first
+                   << ": " << s;
+    } else {
+      LOG(INFO) << "Applied " << batch.keys.size() << " replicated rows of "
+                << it->first;
+    }
+    it = pending_.erase(it);
+  }
+}
+
+int64 EmbeddingReplicaApplier::NumPendingRows() {
+  mutex_lock l(mu_);
+  int64 num_rows = 0;
+  for (const auto& pending : pending_) {
+    num_rows += pending.second.rows.size();
+  }
+  return num_rows;
+}
+
+void EmbeddingReplicaApplier::Loop() {
+  const int64 kConsumeTimeoutMs = 100;
+  const int64 kApplyPendingIntervalUs = 1000 * 1000;
+  int64 last_apply_pending_us = Env::Default()->NowMicros();
+  while (!stop_) {
+    EmbeddingDeltaBatch batch;
+    bool has_batch = false;
+    Status s = subscriber_->Consume(kConsumeTimeoutMs, &batch, &has_batch);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to consume the EmbeddingVariable replica: "
+                   << s;
+    } else if (has_batch) {
+      Apply(batch);
+    }
+    const int64 now = Env::Default()->NowMicros();
+    if (now - last_apply_pending_us >= kApplyPendingIntervalUs) {
+      ApplyPending();
+      last_apply_pending_us = now;
+    }
+  }
+}
+
+} // embedding
+} // tensorflow
@@ -0,0 +1,190 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_EMBEDDING_DELTA_STREAM_H_
+#define TENSORFLOW_CORE_KERNELS_EMBEDDING_DELTA_STREAM_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace RdKafka {
+class KafkaConsumer;
+class Producer;
+} // RdKafka
+
+namespace tensorflow {
+namespace embedding {
+
+// The rows of an EmbeddingVariable written by one delta checkpoint, see
+// IndicesIncrRecorder::IsDeltaOnly. The rows of a checkpoint are split in
+// several batches of the same delta_seq.
+struct EmbeddingDeltaBatch {
+  std::string tensor_name;
+  int64 delta_seq = 0;
+  int64 timestamp_ms = 0;
+  int64 value_len = 0;
+  std::vector<int64> keys;
+  // keys.size() rows of value_len values.
+  std::vector<float> values;
+
+  void Encode(std::string* out) const;
+  Status Decode(StringPiece data);
+};
+
+// Publishes the rows of the delta checkpoints to the Kafka topic
+// TF_EV_DELTA_STREAM_TOPIC of the brokers TF_EV_DELTA_STREAM_BROKERS, it
+// is disabled when either is empty. The messages of a tensor are keyed by
+// its name, they share one partition and are consumed in order.
+class EmbeddingDeltaPublisher {
+ public:
+  // The payload of a message stays below the 1MB message.max.bytes of the
+  // default broker configs.
+  static const int64 kMaxMessageBytes = 900 << 10;
+
+  static EmbeddingDeltaPublisher* GetInstance();
+
+  // Publishes the rows updated on a parameter server to its standby, see
+  // EmbeddingReplicaApplier. Configured like the delta stream by
+  // TF_EV_REPLICA_BROKERS, TF_EV_REPLICA_TOPIC, TF_EV_REPLICA_BATCH_KEYS,
+  // and TF_EV_REPLICA_COMPRESSION, the codec of the messages, lz4 by
+  // default.
+  static EmbeddingDeltaPublisher* GetReplicaInstance();
+
+  ~EmbeddingDeltaPublisher();
+
+  bool IsEnabled() const {
+    return producer_ != nullptr;
+  }
+
+  // TF_EV_DELTA_STREAM_BATCH_KEYS, the max number of rows of a batch.
+  int64 BatchKeys() const {
+    return batch_keys_;
+  }
+
+  Status Publish(const EmbeddingDeltaBatch& batch);
+
+  // Waits for the published batches to be acknowledged by the brokers.
+  Status Flush(int64 timeout_ms);
+
+ private:
+  // Reads the configs from the environment variables env_prefix + "_*".
+  EmbeddingDeltaPublisher(const std::string& env_prefix,
+                          const std::string& default_compression);
+
+  mutex mu_;
+  std::unique_ptr<RdKafka::Producer> producer_;
+  std::string topic_;
+  int64 batch_keys_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(EmbeddingDeltaPublisher);
+};
+
+// Consumes the batches published by EmbeddingDeltaPublisher. A consumer
+// of a new group starts from the offset_reset offsets of the topic,
+// "latest" skips the batches published before it joined the group,
+// "earliest" replays the retained ones.
+class EmbeddingDeltaSubscriber {
+ public:
+  EmbeddingDeltaSubscriber(const std::string& brokers,
+                           const std::string& topic,
+                           const std::string& group,
+                           const std::string& offset_reset = "latest");
+  ~EmbeddingDeltaSubscriber();
+
+  Status Init();
+
+  // Waits at most timeout_ms for a batch, *has_batch is false when no batch
+  // came.
+  Status Consume(int64 timeout_ms, EmbeddingDeltaBatch* batch,
+                 bool* has_batch);
+
+ private:
+  std::string brokers_;
+  std::string topic_;
+  std::string group_;
+  std::string offset_reset_;
+  std::unique_ptr<RdKafka::KafkaConsumer> consumer_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(EmbeddingDeltaSubscriber);
+};
+
+// Keeps a standby of a parameter server up to date with the rows the
+// parameter server publishes through GetReplicaInstance. The batches of
+// the EmbeddingVariables of rm are applied at once. The rows of the others,
+// which the standby creates when it takes over, are kept in memory, the
+// latest row of a key only, and applied once they exist. The topic is
+// replayed from its earliest retained offsets, its batches of a tensor are
+// in order so the rows end up at their latest values.
+//
+// Started on the parameter servers by TF_EV_REPLICA_STANDBY, it consumes
+// TF_EV_REPLICA_TOPIC of TF_EV_REPLICA_BROKERS in the consumer group
+// TF_EV_REPLICA_GROUP, the topic followed by "_standby" by default.
+class EmbeddingReplicaApplier {
+ public:
+  EmbeddingReplicaApplier(ResourceMgr* rm,
+                          std::unique_ptr<EmbeddingDeltaSubscriber> subscriber);
+  ~EmbeddingReplicaApplier();
+
+  // Starts an applier for rm once per process if TF_EV_REPLICA_STANDBY is
+  // set.
+  static void MaybeStart(ResourceMgr* rm);
+
+  // Applies batch, or keeps its rows until its EmbeddingVariable exists.
+  void Apply(const EmbeddingDeltaBatch& batch);
+
+  // Applies the kept rows of the EmbeddingVariables created since.
+  void ApplyPending();
+
+  // The number of rows kept for the EmbeddingVariables not created yet.
+  int64 NumPendingRows();
+
+ private:
+  struct PendingRows {
+    int64 value_len = 0;
+    std::unordered_map<int64, std::vector<float>> rows;
+  };
+
+  void Loop();
+
+  ResourceMgr* rm_;
+  std::unique_ptr<EmbeddingDeltaSubscriber> subscriber_;
+  mutex mu_;
+  std::unordered_map<std::string, PendingRows> pending_ GUARDED_BY(mu_);
+  std::atomic<bool> stop_{false};
+  std::unique_ptr<Thread> thread_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(EmbeddingReplicaApplier);
+};
+
+// Overwrites the rows of the EmbeddingVariable batch.tensor_name of the
+// default container of rm with the rows of batch, returns NotFound when rm
+// has no such EmbeddingVariable.
+Status ApplyEmbeddingDeltaBatch(ResourceMgr* rm,
+                                const EmbeddingDeltaBatch& batch);
+
+} // embedding
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_KERNELS_EMBEDDING_DELTA_STREAM_H_
@@ -0,0 +1,328 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/embedding_tier_advisor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "tensorflow/core/framework/embedding/cache_factory.h"
+#include "tensorflow/core/framework/embedding/embedding_var.h"
+#include "tensorflow/core/framework/embedding/id_trace_recorder.h"
+#include "tensorflow/core/framework/embedding/multi_tier_storage.h"
+#include "tensorflow/core/framework/embedding/storage_factory.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace embedding {
+
+Status ReadIdTrace(const string& filename, std::vector<IdBatch>* trace) {
+  string content;
+  TF_RETURN_IF_ERROR(ReadFileToString(Env::Default(), filename, &content));
+  if (IdTraceRecorder::IsTrace(content)) {
+    return IdTraceRecorder::ReadTrace(filename, trace);
+  }
+  trace->clear();
+  for (const string& line :
+       str_util::Split(content, '\n', str_util::SkipEmpty())) {
+    IdBatch batch;
+    for (const string& field :
+         str_util::Split(line, " ,\t\r", str_util::SkipEmpty())) {
+      int64 id;
+      if (!strings::safe_strto64(field, &id)) {
+        return errors::InvalidArgument("Invalid id ", field, " in ",
+                                       filename);
+      }
+      batch.push_back(id);
+    }
+    if (!batch.empty()) {
+      trace->push_back(std::move(batch));
+    }
+  }
+  return Status::OK();
+}
+
+std::vector<IdBatch> GenerateZipfTrace(int64 num_batches, int64 batch_size,
+                                       int64 num_ids, double alpha,
+                                       uint64 seed) {
+  std::vector<double> cdf(num_ids);
+  double sum = 0;
+  for (int64 i = 0; i < num_ids; i++) {
+    sum += 1.0 / std::pow(i + 1, alpha);
+    cdf[i] = sum;
+  }
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<double> uniform(0, sum);
+  std::vector<IdBatch> trace(num_batches);
+  for (auto& batch : trace) {
+    batch.resize(batch_size);
+    for (auto& id : batch) {
+      id = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) -
+           cdf.begin();
+      id = std::min(id, num_ids - 1);
+    }
+  }
+  return trace;
+}
+
+string TierReport::DebugString() const {
+  return strings::StrCat(
+      StorageType_Name(storage_type),
+      " capacity_rows=[", str_util::Join(capacity_rows, ","),
+      "] lookups=", lookups, " creations=", creations,
+      " hit_ratio=", HitRatio(),
+      " tier_hits=[", str_util::Join(tier_hits, ","),
+      "] bytes_moved=[", str_util::Join(bytes_moved, ","),
+      "] estimated_usecs=", estimated_usecs,
+      " measured_usecs=",
+      measured_usecs < 0 ? "n/a" : strings::StrCat(measured_usecs));
+}
+
+int64 TierAdvisor::RowBytes() const {
+  // Rows of the normal layouts are padded to 16 bytes, see
+  // Storage::ComputeAllocLen.
+  return (options_.embedding_dim * sizeof(float) + 15) / 16 * 16;
+}
+
+TierReport TierAdvisor::Simulate(StorageType storage_type,
+                                 const std::vector<int64>& capacity_rows,
+                                 const std::vector<IdBatch>& trace) const {
+  TierReport report;
+  report.storage_type = storage_type;
+  report.capacity_rows = capacity_rows;
+  report.tier_hits.resize(capacity_rows.size() + 1, 0);
+  report.bytes_moved.resize(capacity_rows.size(), 0);
+  std::vector<std::unique_ptr<BatchCache<int64>>> caches;
+  for (size_t t = 0; t < capacity_rows.size(); t++) {
+    caches.emplace_back(CacheFactory::Create<int64>(
+        options_.cache_strategy, "TierAdvisor"));
+  }
+
+  const int64 row_bytes = RowBytes();
+  std::unordered_map<int64, int> tier_of;
+  std::vector<int64> evic_ids;
+  for (const auto& batch : trace) {
+    for (int64 id : batch) {
+      report.lookups++;
+      auto it = tier_of.find(id);
+      if (it == tier_of.end()) {
+        report.creations++;
+        tier_of.emplace(id, 0);
+        continue;
+      }
+      report.tier_hits[it->second]++;
+      // A row found in a lower tier crosses every link above it.
+      for (int t = 0; t < it->second; t++) {
+        report.bytes_moved[t] += row_bytes;
+      }
+      it->second = 0;
+    }
+    caches[0]->update(batch.data(), batch.size());
+
+    for (size_t t = 0; t < caches.size(); t++) {
+      int64 k_size = static_cast<int64>(caches[t]->size()) - capacity_rows[t];
+      if (k_size <= 0) {
+        continue;
+      }
+      evic_ids.resize(k_size);
+      size_t true_size = caches[t]->get_evic_ids(evic_ids.data(), k_size);
+      // The caches keep the ids promoted out of their tier, like the DRAM
+      // cache of HbmDramSsdStorage, so they are skipped here.
+      size_t num_moved = 0;
+      for (size_t i = 0; i < true_size; i++) {
+        auto it = tier_of.find(evic_ids[i]);
+        if (it->second != static_cast<int>(t)) {
+          continue;
+        }
+        it->second = t + 1;
+        report.bytes_moved[t] += row_bytes;
+        evic_ids[num_moved++] = evic_ids[i];
+      }
+      if (t + 1 < caches.size() && num_moved > 0) {
+        caches[t + 1]->update(evic_ids.data(), num_moved);
+      }
+    }
+  }
+  report.estimated_usecs = EstimateUsecs(report);
+  return report;
+}
+
+double TierAdvisor::EstimateUsecs(const TierReport& report) const {
+  std::vector<double> access_usecs;
+  std::vector<double> link_bytes_per_usec;
+  switch (report.storage_type) {
+    case StorageType::HBM_DRAM:
+      access_usecs = {options_.hbm_access_usecs, options_.dram_access_usecs};
+      link_bytes_per_usec = {options_.pcie_bytes_per_usec};
+      break;
+    case StorageType::DRAM_SSDHASH:
+      access_usecs = {options_.dram_access_usecs, options_.ssd_access_usecs};
+      link_bytes_per_usec = {options_.ssd_bytes_per_usec};
+      break;
+    case StorageType::HBM_DRAM_SSDHASH:
+      access_usecs = {options_.hbm_access_usecs, options_.dram_access_usecs,
+                      options_.ssd_access_usecs};
+      link_bytes_per_usec = {options_.pcie_bytes_per_usec,
+                             options_.ssd_bytes_per_usec};
+      break;
+    default:
+      LOG(FATAL) << "TierAdvisor doesn't support "
+                 << StorageType_Name(report.storage_type);
+  }
+  if (report.lookups == 0) {
+    return 0;
+  }
+  double usecs = report.creations * access_usecs[0];
+  for (size_t t = 0; t < report.tier_hits.size(); t++) {
+    usecs += report.tier_hits[t] * access_usecs[t];
+  }
+  for (size_t t = 0; t < report.bytes_moved.size(); t++) {
+    usecs += report.bytes_moved[t] / link_bytes_per_usec[t];
+  }
+  return usecs / report.lookups;
+}
+
+Status TierAdvisor::MeasureDramSsdHash(int64 capacity_rows,
+                                       const std::vector<IdBatch>& trace,
+                                       double* usecs_per_lookup) const {
+  Tensor value(DT_FLOAT, TensorShape({options_.embedding_dim}));
+  value.flat<float>().setZero();
+  auto emb_config = EmbeddingConfig(
+      /*emb_index = */0, /*primary_emb_index = */0,
+      /*block_num = */1, /*slot_num = */0,
+      /*name = */"", /*steps_to_live = */0,
+      /*filter_freq = */0, /*max_freq = */999999,
+      /*l2_weight_threshold = */-1.0, /*layout = */"normal_contiguous",
+      /*max_element_size = */0, /*false_positive_probability = */-1.0,
+      /*counter_type = */DT_UINT64);
+  auto storage = StorageFactory::Create<int64, float>(
+      StorageConfig(StorageType::DRAM_SSDHASH, options_.ssd_path,
+                    {capacity_rows * RowBytes()}, "normal_contiguous",
+                    emb_config, options_.cache_strategy),
+      cpu_allocator(), "TierAdvisor");
+  // The variable owns the storage.
+  auto variable = new EmbeddingVar<int64, float>(
+      "TierAdvisor", storage, emb_config, cpu_allocator());
+  core::ScopedUnref unref(variable);
+  TF_RETURN_IF_ERROR(variable->Init(value, 1));
+  variable->InitCache(options_.cache_strategy);
+  auto multi_tier = dynamic_cast<MultiTierStorage<int64, float>*>(storage);
+  if (multi_tier == nullptr) {
+    return errors::Internal("DRAM_SSDHASH storage isn't multi-tier.");
+  }
+
+  Env* env = Env::Default();
+  int64 lookups = 0;
+  uint64 lookup_micros = 0;
+  for (const auto& batch : trace) {
+    const uint64 start = env->NowMicros();
+    for (int64 id : batch) {
+      ValuePtr<float>* value_ptr = nullptr;
+      TF_RETURN_IF_ERROR(variable->LookupOrCreateKey(id, &value_ptr));
+    }
+    lookup_micros += env->NowMicros() - start;
+    lookups += batch.size();
+    // Updates the cache and evicts synchronously, instead of on the cache
+    // thread pool, so that the replay is deterministic.
+    multi_tier->Cache()->update(batch.data(), batch.size());
+    while (multi_tier->NeedsEviction() && multi_tier->BatchEviction() > 0) {
+    }
+  }
+  *usecs_per_lookup =
+      lookups == 0 ? 0 : static_cast<double>(lookup_micros) / lookups;
+  return Status::OK();
+}
+
+std::vector<TierReport> TierAdvisor::Sweep(
+    const std::vector<IdBatch>& trace) const {
+  const int64 row_bytes = RowBytes();
+  std::unordered_set<int64> distinct_ids;
+  for (const auto& batch : trace) {
+    distinct_ids.insert(batch.begin(), batch.end());
+  }
+  // HBM_DRAM keeps all the rows in DRAM.
+  const bool fits_in_dram =
+      static_cast<int64>(distinct_ids.size()) * row_bytes <=
+      options_.dram_bytes;
+  const int64 dram_rows = options_.dram_bytes / row_bytes;
+
+  std::vector<TierReport> reports;
+  for (double fraction : options_.capacity_fractions) {
+    const int64 hbm_rows =
+        static_cast<int64>(options_.hbm_bytes * fraction) / row_bytes;
+    const int64 swept_dram_rows =
+        static_cast<int64>(options_.dram_bytes * fraction) / row_bytes;
+    if (hbm_rows > 0 && fits_in_dram) {
+      reports.push_back(Simulate(StorageType::HBM_DRAM, {hbm_rows}, trace));
+    }
+    if (swept_dram_rows > 0) {
+      reports.push_back(
+          Simulate(StorageType::DRAM_SSDHASH, {swept_dram_rows}, trace));
+      if (!options_.ssd_path.empty()) {
+        Status s = MeasureDramSsdHash(swept_dram_rows, trace,
+                                      &reports.back().measured_usecs);
+        if (!s.ok()) {
+          LOG(WARNING) << "Failed to replay the trace through DRAM_SSDHASH: "
+                       << s.ToString();
+        }
+      }
+    }
+    if (hbm_rows > 0 && dram_rows > 0) {
+      reports.push_back(Simulate(StorageType::HBM_DRAM_SSDHASH,
+                                 {hbm_rows, dram_rows}, trace));
+    }
+  }
+  return reports;
+}
+
+const TierReport* TierAdvisor::Recommend(
+    const std::vector<TierReport>& reports) const {
+  // The layout of least cost given the largest capacities.
+  const TierReport* best = nullptr;
+  for (const auto& report : reports) {
+    if (best == nullptr ||
+        report.estimated_usecs < best->estimated_usecs ||
+        (report.estimated_usecs == best->estimated_usecs &&
+         report.capacity_rows[0] < best->capacity_rows[0])) {
+      best = &report;
+    }
+  }
+  if (best == nullptr) {
+    return nullptr;
+  }
+  // The smallest first tier of this layout nearly as fast, which leaves the
+  // rest of the budget to other variables.
+  const TierReport* recommended = best;
+  for (const auto& report : reports) {
+    if (report.storage_type == best->storage_type &&
+        report.estimated_usecs <= best->estimated_usecs * 1.05 &&
+        report.capacity_rows[0] < recommended->capacity_rows[0]) {
+      recommended = &report;
+    }
+  }
+  return recommended;
+}
+
+}  // namespace embedding
+}  // namespace tensorflow
@@ -0,0 +1,123 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_EMBEDDING_TIER_ADVISOR_H_
+#define TENSORFLOW_CORE_KERNELS_EMBEDDING_TIER_ADVISOR_H_
+
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/embedding/config.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// The ids looked up by one training step.
+typedef std::vector<int64> IdBatch;
+
+// Reads a trace written by IdTraceRecorder, or a text trace of one batch per
+// line, the ids of a line separated by spaces or commas.
+Status ReadIdTrace(const string& filename, std::vector<IdBatch>* trace);
+
+// Returns a trace of ids drawn from a Zipf distribution of exponent alpha
+// over num_ids ids.
+std::vector<IdBatch> GenerateZipfTrace(int64 num_batches, int64 batch_size,
+                                       int64 num_ids, double alpha,
+                                       uint64 seed);
+
+struct TierAdvisorOptions {
+  int64 embedding_dim = 64;
+  CacheStrategy cache_strategy = CacheStrategy::LFU;
+  // Budgets of the first tiers, the last tier is unbounded.
+  int64 hbm_bytes = 16LL << 30;
+  int64 dram_bytes = 64LL << 30;
+  // The first tier capacities are swept over these fractions of the
+  // budget of their medium.
+  std::vector<double> capacity_fractions = {0.125, 0.25, 0.5, 1.0};
+  // Nominal costs of the cost model, in microseconds per row access and
+  // bytes per microsecond of transfer between tiers.
+  double hbm_access_usecs = 0.01;
+  double dram_access_usecs = 0.1;
+  double ssd_access_usecs = 20.0;
+  double pcie_bytes_per_usec = 10000.0;
+  double ssd_bytes_per_usec = 1000.0;
+  // Directory of the SSD tier of the measured replays, empty to skip them.
+  string ssd_path;
+};
+
+struct TierReport {
+  StorageType storage_type;
+  // Rows of the bounded tiers, the last tier is unbounded.
+  std::vector<int64> capacity_rows;
+  int64 lookups = 0;
+  // Lookups of new ids, which are created in the first tier.
+  int64 creations = 0;
+  // Lookups of existing ids per tier they were found in.
+  std::vector<int64> tier_hits;
+  // Bytes moved across the link below each bounded tier, both ways.
+  std::vector<int64> bytes_moved;
+  // Cost model estimate per lookup.
+  double estimated_usecs = 0;
+  // Lookup latency of the replay through the real storage, or -1 if it was
+  // not measured, e.g. for HBM tiers.
+  double measured_usecs = -1;
+
+  double HitRatio() const {
+    return lookups == 0 ? 0 : static_cast<double>(tier_hits[0]) / lookups;
+  }
+  string DebugString() const;
+};
+
+// Replays id traces through the cache classes of MultiTierStorage to compare
+// the tier layouts of a multi-tier EmbeddingVariable.
+class TierAdvisor {
+ public:
+  explicit TierAdvisor(const TierAdvisorOptions& options)
+      : options_(options) {}
+
+  // Replays trace through the caches of storage_type with the given first
+  // tier capacities. Ids evicted from a tier enter the next one, ids found
+  // in a lower tier are promoted to the first one.
+  TierReport Simulate(StorageType storage_type,
+                      const std::vector<int64>& capacity_rows,
+                      const std::vector<IdBatch>& trace) const;
+
+  // Replays trace through a real DRAM_SSDHASH EmbeddingVariable whose DRAM
+  // tier holds capacity_rows rows, returns the mean lookup latency.
+  Status MeasureDramSsdHash(int64 capacity_rows,
+                            const std::vector<IdBatch>& trace,
+                            double* usecs_per_lookup) const;
+
+  // Simulates HBM_DRAM, DRAM_SSDHASH and HBM_DRAM_SSDHASH over the swept
+  // capacities which fit the budgets.
+  std::vector<TierReport> Sweep(const std::vector<IdBatch>& trace) const;
+
+  // Returns the layout of least estimated cost, with the smallest swept
+  // first tier whose cost is within 5% of it, or nullptr if reports is empty.
+  const TierReport* Recommend(const std::vector<TierReport>& reports) const;
+
+ private:
+  int64 RowBytes() const;
+  double EstimateUsecs(const TierReport& report) const;
+
+  TierAdvisorOptions options_;
+};
+
+}  // namespace embedding
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_EMBEDDING_TIER_ADVISOR_H_
@@ -0,0 +1,112 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Replays an id trace through the tier layouts of a multi-tier
+// EmbeddingVariable and recommends one, e.g.
+//
+//   embedding_tier_advisor --trace=ids.txt --dim=16 --hbm_mb=1024 \
+//       --dram_mb=8192 --ssd_path=/tmp/advisor
+//
+// The trace has one batch of ids per line. Without --trace, a Zipf trace is
+// generated.
+
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/embedding/config.pb.h"
+#include "tensorflow/core/kernels/embedding_tier_advisor.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+int main(int argc, char* argv[]) {
+  using tensorflow::int64;
+  using tensorflow::string;
+
+  string trace_path;
+  string cache_strategy = "LFU";
+  int64 embedding_dim = 64;
+  int64 hbm_mb = 16 << 10;
+  int64 dram_mb = 64 << 10;
+  string ssd_path;
+  int64 num_batches = 1000;
+  int64 batch_size = 4096;
+  int64 num_ids = 1 << 20;
+  float zipf_alpha = 1.05;
+  std::vector<tensorflow::Flag> flag_list = {
+      tensorflow::Flag("trace", &trace_path,
+                       "file of one batch of ids per line"),
+      tensorflow::Flag("dim", &embedding_dim, "embedding dimension"),
+      tensorflow::Flag("cache_strategy", &cache_strategy,
+                       "LRU, LFU, SHARDED_CLOCK, W_TINY_LFU or FREQ_RECENCY"),
+      tensorflow::Flag("hbm_mb", &hbm_mb, "HBM budget in MB"),
+      tensorflow::Flag("dram_mb", &dram_mb, "DRAM budget in MB"),
+      tensorflow::Flag("ssd_path", &ssd_path,
+                       "directory to replay DRAM_SSDHASH in, empty to only "
+                       "simulate it"),
+      tensorflow::Flag("num_batches", &num_batches,
+                       "batches of the generated trace"),
+      tensorflow::Flag("batch_size", &batch_size,
+                       "ids per batch of the generated trace"),
+      tensorflow::Flag("num_ids", &num_ids,
+                       "distinct ids of the generated trace"),
+      tensorflow::Flag("zipf_alpha", &zipf_alpha,
+                       "Zipf exponent of the generated trace"),
+  };
+  string usage = tensorflow::Flags::Usage(argv[0], flag_list);
+  const bool parse_result = tensorflow::Flags::Parse(&argc, argv, flag_list);
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  if (!parse_result || argc > 1) {
+    LOG(ERROR) << usage;
+    return -1;
+  }
+
+  tensorflow::embedding::TierAdvisorOptions options;
+  options.embedding_dim = embedding_dim;
+  options.hbm_bytes = hbm_mb << 20;
+  options.dram_bytes = dram_mb << 20;
+  options.ssd_path = ssd_path;
+  if (!tensorflow::embedding::CacheStrategy_Parse(
+          cache_strategy, &options.cache_strategy)) {
+    LOG(ERROR) << "Invalid cache strategy " << cache_strategy;
+    return -1;
+  }
+
+  std::vector<tensorflow::embedding::IdBatch> trace;
+  if (trace_path.empty()) {
+    trace = tensorflow::embedding::GenerateZipfTrace(
+        num_batches, batch_size, num_ids, zipf_alpha, /*seed=*/1);
+  } else {
+    tensorflow::Status s =
+        tensorflow::embedding::ReadIdTrace(trace_path, &trace);
+    if (!s.ok()) {
+      LOG(ERROR) << s.ToString();
+      return -1;
+    }
+  }
+
+  tensorflow::embedding::TierAdvisor advisor(options);
+  auto reports = advisor.Sweep(trace);
+  for (const auto& report : reports) {
+    LOG(INFO) << report.DebugString();
+  }
+  auto recommended = advisor.Recommend(reports);
+  if (recommended == nullptr) {
+    LOG(ERROR) << "No tier layout fits the budgets.";
+    return -1;
+  }
+  LOG(INFO) << "Recommended: " << recommended->DebugString();
+  return 0;
+}
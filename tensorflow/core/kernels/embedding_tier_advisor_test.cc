@@ -0,0 +1,122 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/embedding_tier_advisor.h"
+
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace embedding {
+namespace {
+
+TierAdvisorOptions SmallOptions() {
+  TierAdvisorOptions options;
+  options.embedding_dim = 4;
+  // 16 bytes per row.
+  options.hbm_bytes = 16 * 64;
+  options.dram_bytes = 16 * 1024;
+  options.cache_strategy = CacheStrategy::LRU;
+  return options;
+}
+
+TEST(TierAdvisorTest, ReadIdTrace) {
+  const string filename = io::JoinPath(testing::TmpDir(), "ids.txt");
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), filename,
+                                 "1 2,3\n\n4\t5\n"));
+  std::vector<IdBatch> trace;
+  TF_ASSERT_OK(ReadIdTrace(filename, &trace));
+  ASSERT_EQ(2, trace.size());
+  EXPECT_EQ(IdBatch({1, 2, 3}), trace[0]);
+  EXPECT_EQ(IdBatch({4, 5}), trace[1]);
+
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), filename, "1 x\n"));
+  EXPECT_FALSE(ReadIdTrace(filename, &trace).ok());
+}
+
+TEST(TierAdvisorTest, SimulateMovesEvictedRows) {
+  TierAdvisor advisor(SmallOptions());
+  // Ids 0 and 1 are evicted by 2 and 3, then promoted back.
+  std::vector<IdBatch> trace = {{0, 1}, {2, 3}, {0, 1}};
+  TierReport report =
+      advisor.Simulate(StorageType::DRAM_SSDHASH, {2}, trace);
+  EXPECT_EQ(6, report.lookups);
+  EXPECT_EQ(4, report.creations);
+  EXPECT_EQ(0, report.tier_hits[0]);
+  EXPECT_EQ(2, report.tier_hits[1]);
+  // 2 rows down after the second batch, 2 rows up and 2 rows down in the
+  // third one.
+  EXPECT_EQ(6 * 16, report.bytes_moved[0]);
+
+  trace = {{0, 1}, {0, 1}, {0, 1}};
+  report = advisor.Simulate(StorageType::HBM_DRAM_SSDHASH, {1, 1}, trace);
+  EXPECT_EQ(2, report.creations);
+  EXPECT_EQ(4, report.tier_hits[0] + report.tier_hits[1] +
+               report.tier_hits[2]);
+}
+
+TEST(TierAdvisorTest, RecommendsSmallestSufficientTier) {
+  TierAdvisorOptions options = SmallOptions();
+  options.capacity_fractions = {0.25, 0.5, 1.0};
+  TierAdvisor advisor(options);
+  // 16 ids fit in a quarter of the HBM budget.
+  auto trace = GenerateZipfTrace(/*num_batches=*/50, /*batch_size=*/8,
+                                 /*num_ids=*/16, /*alpha=*/1.0, /*seed=*/1);
+  auto reports = advisor.Sweep(trace);
+  ASSERT_EQ(9, reports.size());
+  const TierReport* recommended = advisor.Recommend(reports);
+  ASSERT_NE(nullptr, recommended);
+  EXPECT_EQ(StorageType::HBM_DRAM, recommended->storage_type);
+  EXPECT_EQ(16, recommended->capacity_rows[0]);
+  EXPECT_EQ(0, recommended->bytes_moved[0]);
+  EXPECT_EQ(recommended->lookups - recommended->creations,
+            recommended->tier_hits[0]);
+}
+
+TEST(TierAdvisorTest, MeasureDramSsdHash) {
+  TierAdvisorOptions options = SmallOptions();
+  options.ssd_path = testing::TmpDir();
+  TierAdvisor advisor(options);
+  auto trace = GenerateZipfTrace(/*num_batches=*/20, /*batch_size=*/64,
+                                 /*num_ids=*/1024, /*alpha=*/1.0, /*seed=*/1);
+  double usecs = -1;
+  TF_ASSERT_OK(advisor.MeasureDramSsdHash(128, trace, &usecs));
+  EXPECT_GE(usecs, 0);
+}
+
+void BM_TierAdvisorSimulate(int iters, int capacity_rows) {
+  testing::StopTiming();
+  TierAdvisorOptions options;
+  options.embedding_dim = 16;
+  TierAdvisor advisor(options);
+  auto trace = GenerateZipfTrace(/*num_batches=*/100, /*batch_size=*/1024,
+                                 /*num_ids=*/1 << 16, /*alpha=*/1.05,
+                                 /*seed=*/1);
+  testing::StartTiming();
+  for (int i = 0; i < iters; i++) {
+    advisor.Simulate(StorageType::HBM_DRAM_SSDHASH,
+                     {capacity_rows, 4 * capacity_rows}, trace);
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * 100 * 1024);
+}
+
+BENCHMARK(BM_TierAdvisorSimulate)->Arg(1 << 10)->Arg(1 << 12)->Arg(1 << 14);
+
+}  // namespace
+}  // namespace embedding
+}  // namespace tensorflow
@@ -0,0 +1,355 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Benchmarks of the lookup, lookup-or-create, apply, eviction, save and
+// restore of EmbeddingVars over the storage backends, e.g.
+//
+//   bazel run -c opt //tensorflow/core/kernels:embedding_variable_benchmark_test \
+//       -- --benchmarks=BM_EVLookup_DRAM_SSDHASH
+//
+// The first argument of a benchmark is the Zipf exponent of its ids in
+// hundredths, 0 for uniform ids, the second one the embedding dim. With
+// TEST_REPORT_FILE_PREFIX set, the results are also written as
+// BenchmarkEntries protos, one file per benchmark, to compare releases.
+
+#include <atomic>
+
+#include "tensorflow/core/framework/embedding/storage_factory.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/embedding_tier_advisor.h"
+#include "tensorflow/core/kernels/kv_variable_ops.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+namespace tensorflow {
+namespace embedding {
+namespace {
+
+const int64 kNumIds = 1 << 17;
+const int64 kBatchSize = 1 << 14;
+const int64 kNumBatches = 16;
+// The first tier of the multi-tier storages holds a quarter of the ids.
+const int64 kFirstTierIds = kNumIds / 4;
+
+class EVBenchmark {
+ public:
+  EVBenchmark(StorageType type, int alpha_x100, int dim, int num_threads)
+      : dim_(dim),
+        trace_(GenerateZipfTrace(kNumBatches, kBatchSize, kNumIds,
+                                 alpha_x100 / 100.0, /*seed=*/1)) {
+    if (num_threads > 1) {
+      thread_pool_.reset(new thread::ThreadPool(
+          Env::Default(), "EVBenchmark", num_threads));
+    }
+    variable_ = CreateVariable(type);
+  }
+
+  ~EVBenchmark() {
+    variable_->Unref();
+  }
+
+  EmbeddingVar<int64, float>* CreateVariable(StorageType type) {
+    static std::atomic<int64> num_variables(0);
+    const string name =
+        strings::StrCat("EVBenchmark_", num_variables.fetch_add(1));
+    Tensor value(DT_FLOAT, TensorShape({dim_}));
+    test::FillValues<float>(&value, std::vector<float>(dim_, 1.0));
+    auto emb_config = EmbeddingConfig(
+        /*emb_index = */0, /*primary_emb_index = */0,
+        /*block_num = */1, /*slot_num = */0,
+        /*name = */"", /*steps_to_live = */0,
+        /*filter_freq = */0, /*max_freq = */999999,
+        /*l2_weight_threshold = */-1.0, /*layout = */"normal_contiguous",
+        /*max_element_size = */0, /*false_positive_probability = */-1.0,
+        /*counter_type = */DT_UINT64);
+    const int64 first_tier_bytes = kFirstTierIds * dim_ * sizeof(float);
+    auto storage = StorageFactory::Create<int64, float>(
+        StorageConfig(type, io::JoinPath(testing::TmpDir(), name),
+                      {first_tier_bytes, first_tier_bytes << 2},
+                      "normal_contiguous", emb_config),
+        cpu_allocator(), name);
+    auto variable = new EmbeddingVar<int64, float>(
+        name, storage, emb_config, cpu_allocator());
+    TF_CHECK_OK(variable->Init(value, 1));
+    if (variable->IsMultiLevel()) {
+      variable->InitCache(CacheStrategy::LFU);
+    }
+    return variable;
+  }
+
+  // Creates every id of the trace.
+  void Populate() {
+    for (const auto& batch : trace_) {
+      LookupOrCreate(batch);
+      Evict(variable_, batch);
+    }
+  }
+
+  // Runs fn(i) for the ids of the batch, split across the threads.
+  template <typename Fn>
+  void ParallelRun(const IdBatch& batch, Fn fn) {
+    if (thread_pool_ == nullptr) {
+      for (int64 id : batch) {
+        fn(id);
+      }
+      return;
+    }
+    const int num_shards = thread_pool_->NumThreads();
+    const int64 shard_size = (batch.size() + num_shards - 1) / num_shards;
+    BlockingCounter counter(num_shards);
+    for (int i = 0; i < num_shards; i++) {
+      thread_pool_->Schedule([&batch, &fn, &counter, shard_size, i]() {
+        const int64 end = std::min(static_cast<int64>(batch.size()),
+                                   (i + 1) * shard_size);
+        for (int64 j = i * shard_size; j < end; j++) {
+          fn(batch[j]);
+        }
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+
+  void Lookup(const IdBatch& batch) {
+    ParallelRun(batch, [this](int64 id) {
+      static thread_local std::vector<float> val;
+      val.resize(dim_);
+      variable_->Lookup(id, val.data(), nullptr).IgnoreError();
+    });
+  }
+
+  void LookupOrCreate(const IdBatch& batch) {
+    ParallelRun(batch, [this](int64 id) {
+      static thread_local std::vector<float> val;
+      val.resize(dim_);
+      variable_->LookupOrCreate(id, val.data(), nullptr);
+    });
+  }
+
+  // Applies a gradient descent step of a constant gradient, like
+  // KvSparseApplyGradientDescent.
+  void Apply(const IdBatch& batch) {
+    ParallelRun(batch, [this](int64 id) {
+      ValuePtr<float>* value_ptr = nullptr;
+      TF_CHECK_OK(variable_->LookupOrCreateKey(id, &value_ptr));
+      auto v = variable_->flat(value_ptr, id);
+      v -= v.constant(0.01f);
+    });
+  }
+
+  // Moves the rows beyond the first tier of a multi-tier storage down, as
+  // the eviction thread does after the lookups of the batch.
+  static void Evict(EmbeddingVar<int64, float>* variable,
+                    const IdBatch& batch) {
+    auto multi_tier = dynamic_cast<MultiTierStorage<int64, float>*>(
+        variable->storage());
+    if (multi_tier == nullptr) {
+      return;
+    }
+    multi_tier->Cache()->update(batch.data(), batch.size());
+    while (multi_tier->NeedsEviction() && multi_tier->BatchEviction() > 0) {
+    }
+  }
+
+  Status Save(const string& prefix) {
+    Tensor part_offset_tensor(DT_INT32,
+                              TensorShape({kSavedPartitionNum + 1}));
+    BundleWriter writer(Env::Default(), prefix);
+    TF_RETURN_IF_ERROR(DumpEmbeddingValues(variable_, "var/part_0", &writer,
+                                           &part_offset_tensor));
+    return writer.Finish();
+  }
+
+  static Status Restore(EmbeddingVar<int64, float>* variable,
+                        const string& prefix) {
+    BundleReader reader(Env::Default(), prefix);
+    TF_RETURN_IF_ERROR(reader.status());
+    return EVRestoreDynamically(
+        variable, "var/part_0", 0, 1, nullptr, &reader,
+        "-partition_offset", "-keys", "-values", "-versions", "-freqs");
+  }
+
+  const IdBatch& batch(int iter) const {
+    return trace_[iter % trace_.size()];
+  }
+
+  EmbeddingVar<int64, float>* variable() const {
+    return variable_;
+  }
+
+  int64 dim() const {
+    return dim_;
+  }
+
+ private:
+  int64 dim_;
+  std::vector<IdBatch> trace_;
+  std::unique_ptr<thread::ThreadPool> thread_pool_;
+  EmbeddingVar<int64, float>* variable_;
+};
+
+void ReportItems(int iters, int64 items_per_iter, int64 dim) {
+  const int64 items = static_cast<int64>(iters) * items_per_iter;
+  testing::ItemsProcessed(items);
+  testing::BytesProcessed(items * dim * sizeof(float));
+}
+
+void BM_EVLookup(int iters, StorageType type, int alpha_x100, int dim,
+                 int num_threads) {
+  testing::StopTiming();
+  testing::UseRealTime();
+  EVBenchmark benchmark(type, alpha_x100, dim, num_threads);
+  benchmark.Populate();
+  for (int i = 0; i < iters; i++) {
+    testing::StartTiming();
+    benchmark.Lookup(benchmark.batch(i));
+    testing::StopTiming();
+    EVBenchmark::Evict(benchmark.variable(), benchmark.batch(i));
+  }
+  ReportItems(iters, kBatchSize, dim);
+}
+
+void BM_EVLookupOrCreate(int iters, StorageType type, int alpha_x100,
+                         int dim, int num_threads) {
+  testing::StopTiming();
+  testing::UseRealTime();
+  EVBenchmark benchmark(type, alpha_x100, dim, num_threads);
+  for (int i = 0; i < iters; i++) {
+    testing::StartTiming();
+    benchmark.LookupOrCreate(benchmark.batch(i));
+    testing::StopTiming();
+    EVBenchmark::Evict(benchmark.variable(), benchmark.batch(i));
+  }
+  ReportItems(iters, kBatchSize, dim);
+}
+
+void BM_EVApply(int iters, StorageType type, int alpha_x100, int dim,
+                int num_threads) {
+  testing::StopTiming();
+  testing::UseRealTime();
+  EVBenchmark benchmark(type, alpha_x100, dim, num_threads);
+  benchmark.Populate();
+  for (int i = 0; i < iters; i++) {
+    testing::StartTiming();
+    benchmark.Apply(benchmark.batch(i));
+    testing::StopTiming();
+    EVBenchmark::Evict(benchmark.variable(), benchmark.batch(i));
+  }
+  ReportItems(iters, kBatchSize, dim);
+}
+
+void BM_EVEviction(int iters, StorageType type, int alpha_x100, int dim) {
+  testing::StopTiming();
+  testing::UseRealTime();
+  EVBenchmark benchmark(type, alpha_x100, dim, /*num_threads=*/1);
+  for (int i = 0; i < iters; i++) {
+    benchmark.LookupOrCreate(benchmark.batch(i));
+    testing::StartTiming();
+    EVBenchmark::Evict(benchmark.variable(), benchmark.batch(i));
+    testing::StopTiming();
+  }
+  ReportItems(iters, kBatchSize, dim);
+}
+
+void BM_EVSave(int iters, StorageType type, int alpha_x100, int dim) {
+  testing::StopTiming();
+  testing::UseRealTime();
+  EVBenchmark benchmark(type, alpha_x100, dim, /*num_threads=*/1);
+  benchmark.Populate();
+  const string prefix = io::JoinPath(testing::TmpDir(), "EVBenchmarkSave");
+  testing::StartTiming();
+  for (int i = 0; i < iters; i++) {
+    TF_CHECK_OK(benchmark.Save(prefix));
+  }
+  testing::StopTiming();
+  ReportItems(iters, benchmark.variable()->Size(), dim);
+}
+
+void BM_EVRestore(int iters, StorageType type, int alpha_x100, int dim) {
+  testing::StopTiming();
+  testing::UseRealTime();
+  EVBenchmark benchmark(type, alpha_x100, dim, /*num_threads=*/1);
+  benchmark.Populate();
+  const string prefix =
+      io::JoinPath(testing::TmpDir(), "EVBenchmarkRestore");
+  TF_CHECK_OK(benchmark.Save(prefix));
+  for (int i = 0; i < iters; i++) {
+    auto variable = benchmark.CreateVariable(type);
+    testing::StartTiming();
+    TF_CHECK_OK(EVBenchmark::Restore(variable, prefix));
+    testing::StopTiming();
+    variable->Unref();
+  }
+  ReportItems(iters, benchmark.variable()->Size(), dim);
+}
+
+// Uniform and Zipf ids of exponents 0.8, 1.0 and 1.2, by dims 16, 64 and
+// 256.
+#define EV_BENCHMARK_ARGS                                      \
+  ArgPair(0, 16)->ArgPair(0, 64)->ArgPair(0, 256)              \
+      ->ArgPair(80, 16)->ArgPair(80, 64)->ArgPair(80, 256)     \
+      ->ArgPair(100, 16)->ArgPair(100, 64)->ArgPair(100, 256)  \
+      ->ArgPair(120, 16)->ArgPair(120, 64)->ArgPair(120, 256)
+
+#define BM_EV_THREADED(OP, TYPE, THREADS)                            \
+  void BM_EV##OP##_##TYPE##_T##THREADS(int iters, int alpha_x100,    \
+                                       int dim) {                    \
+    BM_EV##OP(iters, StorageType::TYPE, alpha_x100, dim, THREADS);   \
+  }                                                                  \
+  BENCHMARK(BM_EV##OP##_##TYPE##_T##THREADS)->EV_BENCHMARK_ARGS;
+
+#define BM_EV_SERIAL(OP, TYPE)                                       \
+  void BM_EV##OP##_##TYPE(int iters, int alpha_x100, int dim) {      \
+    BM_EV##OP(iters, StorageType::TYPE, alpha_x100, dim);            \
+  }                                                                  \
+  BENCHMARK(BM_EV##OP##_##TYPE)->EV_BENCHMARK_ARGS;
+
+#define BM_EV_STORAGE(TYPE)                                          \
+  BM_EV_THREADED(Lookup, TYPE, 1)                                    \
+  BM_EV_THREADED(Lookup, TYPE, 4)                                    \
+  BM_EV_THREADED(Lookup, TYPE, 16)                                   \
+  BM_EV_THREADED(LookupOrCreate, TYPE, 1)                            \
+  BM_EV_THREADED(LookupOrCreate, TYPE, 4)                            \
+  BM_EV_THREADED(LookupOrCreate, TYPE, 16)                           \
+  BM_EV_THREADED(Apply, TYPE, 1)                                     \
+  BM_EV_THREADED(Apply, TYPE, 4)                                     \
+  BM_EV_THREADED(Apply, TYPE, 16)                                    \
+  BM_EV_SERIAL(Save, TYPE)                                           \
+  BM_EV_SERIAL(Restore, TYPE)
+
+BM_EV_STORAGE(DRAM)
+BM_EV_STORAGE(DRAM_SSDHASH)
+BM_EV_STORAGE(DRAM_LEVELDB)
+BM_EV_SERIAL(Eviction, DRAM_SSDHASH)
+BM_EV_SERIAL(Eviction, DRAM_LEVELDB)
+#ifdef TENSORFLOW_USE_PMEM
+BM_EV_STORAGE(DRAM_PMEM)
+BM_EV_SERIAL(Eviction, DRAM_PMEM)
+#endif  // TENSORFLOW_USE_PMEM
+
+#undef BM_EV_STORAGE
+#undef BM_EV_SERIAL
+#undef BM_EV_THREADED
+#undef EV_BENCHMARK_ARGS
+
+}  // namespace
+}  // namespace embedding
+}  // namespace tensorflow
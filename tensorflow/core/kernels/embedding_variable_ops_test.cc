@@ -1,3 +1,6 @@
+#include <map>
+#include <numeric>
+#include <set>
 #include <thread>
 
 #include "tensorflow/core/framework/op.h"
@@ -36,7 +39,18 @@
 #include <time.h>
 #include <sys/resource.h>
 #include "tensorflow/core/framework/embedding/kv_interface.h"
+#include "tensorflow/core/framework/embedding/row_copy.h"
 #include "tensorflow/core/framework/embedding/cache.h"
+#include "tensorflow/core/framework/embedding/epoch_reclaimer.h"
+#include "tensorflow/core/framework/embedding/float_math_row.h"
+#include "tensorflow/core/framework/embedding/hbm_cache_budget.h"
+#include "tensorflow/core/framework/embedding/host_shared_embedding_cache.h"
+#include "tensorflow/core/framework/embedding/hot_row_cache.h"
+#include "tensorflow/core/framework/embedding/id_trace_recorder.h"
+#include "tensorflow/core/framework/embedding/intra_thread_copy_id_allocator.h"
+#include "tensorflow/core/framework/embedding/lock_contention.h"
+#include "tensorflow/core/framework/embedding/serving_row_cache.h"
+#include "tensorflow/core/framework/embedding/worker_embedding_cache.h"
 #include "tensorflow/core/kernels/kv_variable_ops.h"
 #ifdef TENSORFLOW_USE_JEMALLOC
 #include "jemalloc/jemalloc.h"
@@ -155,6 +169,42 @@ TEST(TensorBundleTest, TestEVShrinkL2) {
   ASSERT_EQ(emb_var->Size(), 2);
 }
 
+TEST(TensorBundleTest, TestEVIncrementalShrinkL2) {
+  int64 value_size = 3;
+  int64 insert_num = 5;
+  Tensor value(DT_FLOAT, TensorShape({value_size}));
+  test::FillValues<float>(&value, std::vector<float>(value_size, 1.0));
+  EmbeddingConfig emb_config =
+      EmbeddingConfig(0, 0, 1, 1, "", 0, 0, 99999, 14.0);
+  auto storage = embedding::StorageFactory::Create<int64, float>(
+      embedding::StorageConfig(
+          StorageType::DRAM,
+          "", {1024, 1024, 1024, 1024},
+          "light",
+          emb_config),
+      cpu_allocator(),
+      "name");
+  auto emb_var = new EmbeddingVar<int64, float>("name",
+        storage, emb_config,
+        cpu_allocator());
+  emb_var->Init(value, 1);
+
+  for (int64 i = 0; i < insert_num; ++i) {
+    ValuePtr<float>* value_ptr = nullptr;
+    Status s = emb_var->LookupOrCreateKey(i, &value_ptr);
+    typename TTypes<float>::Flat vflat = emb_var->flat(value_ptr, i);
+    vflat += vflat.constant((float)i);
+  }
+
+  // Each call checks 2 keys, the 3rd one finishes the pass.
+  embedding::ShrinkArgs shrink_args(0, value_size);
+  TF_CHECK_OK(storage->IncrementalShrink(shrink_args, 2));
+  ASSERT_GT(emb_var->Size(), 2);
+  TF_CHECK_OK(storage->IncrementalShrink(shrink_args, 2));
+  TF_CHECK_OK(storage->IncrementalShrink(shrink_args, 2));
+  ASSERT_EQ(emb_var->Size(), 2);
+}
+
 TEST(TensorBundleTest, TestEVShrinkLockless) {
 
   int64 value_size = 64;
@@ -1029,6 +1079,44 @@ TEST(EmbeddingVariableTest, TestEVStorageType_DRAM) {
   LOG(INFO) << "size:" << variable->Size();
 }
 
+TEST(EmbeddingVariableTest, TestEVStorageType_DRAM_NUMA) {
+  int64 value_size = 16;
+  Tensor value(DT_FLOAT, TensorShape({value_size}));
+  test::FillValues<float>(&value, std::vector<float>(value_size, 9.0));
+  EmbeddingConfig emb_config =
+      EmbeddingConfig(0, 0, 1, 1, "", 0, 0, 99999, -1.0);
+  auto storage = embedding::StorageFactory::Create<int64, float>(
+      embedding::StorageConfig(
+          StorageType::DRAM_NUMA,
+          "", {1024, 1024, 1024, 1024},
+          "normal",
+          emb_config),
+      cpu_allocator(),
+      "EmbeddingVar");
+  auto variable = new EmbeddingVar<int64, float>("EmbeddingVar",
+      storage, emb_config, cpu_allocator());
+  variable->Init(value, 1);
+
+  int64 ev_size = 4096;
+  std::vector<int64> keys(2 * ev_size);
+  std::vector<ValuePtr<float>*> created(ev_size);
+  for (int64 i = 0; i < ev_size; i++) {
+    TF_CHECK_OK(variable->LookupOrCreateKey(i, &created[i]));
+  }
+  ASSERT_EQ(variable->Size(), ev_size);
+  for (int64 i = 0; i < 2 * ev_size; i++) {
+    keys[i] = i;
+  }
+  std::vector<ValuePtr<float>*> value_ptrs(2 * ev_size);
+  storage->BatchGet(keys.data(), value_ptrs.data(), keys.size());
+  for (int64 i = 0; i < ev_size; i++) {
+    ASSERT_EQ(value_ptrs[i], created[i]);
+  }
+  for (int64 i = ev_size; i < 2 * ev_size; i++) {
+    ASSERT_EQ(value_ptrs[i], nullptr);
+  }
+}
+
 void t1(KVInterface<int64, float>* hashmap) {
   for (int i = 0; i< 100; ++i) {
     hashmap->Insert(i, new NormalValuePtr<float>(ev_allocator(), 100));
@@ -1049,6 +1137,68 @@ TEST(EmbeddingVariableTest, TestRemoveLockless) {
   LOG(INFO) << "2 size:" << hashmap->Size();
 }
 
+TEST(EmbeddingVariableTest, TestBatchLookupLockless) {
+  KVInterface<int64, float>* hashmap = new LocklessHashMap<int64, float>();
+  std::vector<ValuePtr<float>*> inserted(100);
+  for (int64 i = 0; i < 100; ++i) {
+    inserted[i] = new NormalValuePtr<float>(ev_allocator(), 100);
+    TF_CHECK_OK(hashmap->Insert(i, inserted[i]));
+  }
+  std::vector<int64> keys(200);
+  for (int64 i = 0; i < 200; ++i) {
+    keys[i] = i;
+  }
+  std::vector<ValuePtr<float>*> value_ptrs(200);
+  TF_CHECK_OK(hashmap->BatchLookup(keys.data(), keys.size(),
+                                   value_ptrs.data()));
+  for (int64 i = 0; i < 100; ++i) {
+    ASSERT_EQ(value_ptrs[i], inserted[i]);
+  }
+  for (int64 i = 100; i < 200; ++i) {
+    ASSERT_EQ(value_ptrs[i], nullptr);
+  }
+  delete hashmap;
+}
+
+TEST(EmbeddingVariableTest, TestSwissHashMap) {
+  KVInterface<int64, float>* hashmap = new SwissHashMap<int64, float>();
+  int64 num_keys = 100000;
+  std::vector<ValuePtr<float>*> inserted(num_keys);
+  for (int64 i = 0; i < num_keys; ++i) {
+    inserted[i] = new NormalValuePtr<float>(ev_allocator(), 10);
+    TF_CHECK_OK(hashmap->Insert(i, inserted[i]));
+  }
+  ASSERT_EQ(hashmap->Size(), num_keys);
+  ASSERT_EQ(hashmap->Insert(0, inserted[0]).ok(), false);
+  for (int64 i = 0; i < num_keys; i += 2) {
+    TF_CHECK_OK(hashmap->Remove(i));
+  }
+  ASSERT_EQ(hashmap->Size(), num_keys / 2);
+  std::vector<int64> keys(num_keys);
+  for (int64 i = 0; i < num_keys; ++i) {
+    keys[i] = i;
+  }
+  std::vector<ValuePtr<float>*> value_ptrs(num_keys);
+  TF_CHECK_OK(hashmap->BatchLookup(keys.data(), keys.size(),
+                                   value_ptrs.data()));
+  for (int64 i = 0; i < num_keys; ++i) {
+    if (i % 2 == 0) {
+      ASSERT_EQ(value_ptrs[i], nullptr);
+      ASSERT_EQ(hashmap->Contains(i).ok(), false);
+    } else {
+      ASSERT_EQ(value_ptrs[i], inserted[i]);
+    }
+  }
+  std::vector<int64> key_list;
+  std::vector<ValuePtr<float>*> value_ptr_list;
+  TF_CHECK_OK(hashmap->GetSnapshot(&key_list, &value_ptr_list));
+  ASSERT_EQ(key_list.size(), num_keys / 2);
+  for (int64 i = 0; i < key_list.size(); ++i) {
+    ASSERT_EQ(value_ptr_list[i], inserted[key_list[i]]);
+  }
+  delete hashmap;
+}
+
 TEST(EmbeddingVariableTest, TestBatchCommitofDBKV) {
   int64 value_size = 4;
   KVInterface<int64, float>* hashmap =
@@ -1122,6 +1272,72 @@ TEST(EmbeddingVariableTest, TestSSDIterator) {
   }
 }
 
+TEST(EmbeddingVariableTest, TestEmbPosition) {
+  uint64 posi = embedding::EmbPosition::Pack(4096, 70000, false);
+  ASSERT_EQ(embedding::EmbPosition::Offset(posi), 4096);
+  ASSERT_EQ(embedding::EmbPosition::Version(posi), 70000);
+  ASSERT_FALSE(embedding::EmbPosition::Flushed(posi));
+  posi = embedding::EmbPosition::SetFlushed(posi);
+  ASSERT_EQ(embedding::EmbPosition::Offset(posi), 4096);
+  ASSERT_EQ(embedding::EmbPosition::Version(posi), 70000);
+  ASSERT_TRUE(embedding::EmbPosition::Flushed(posi));
+  ASSERT_NE(posi, embedding::kEmptyEmbPosition);
+}
+
+TEST(EmbeddingVariableTest, TestLockContention) {
+  LockContention lock_contention;
+  LockContention::Site* holder =
+      lock_contention.GetSite("test_lock", __FILE__, 1);
+  LockContention::Site* waiter =
+      lock_contention.GetSite("test_lock", __FILE__, 2);
+  ASSERT_EQ(holder, lock_contention.GetSite("test_lock", __FILE__, 1));
+  const std::vector<LockContention::Snapshot> before =
+      lock_contention.Snapshots();
+
+  mutex mu;
+  std::unique_ptr<std::thread> t;
+  {
+    profiled_mutex_lock l(mu, holder);
+    t.reset(new std::thread([&mu, waiter]() {
+      profiled_mutex_lock l(mu, waiter);
+    }));
+    Env::Default()->SleepForMicroseconds(10000);
+  }
+  t->join();
+  ASSERT_EQ(holder->acquisitions.load(), 1);
+  ASSERT_EQ(holder->contentions.load(), 0);
+  ASSERT_GE(holder->hold_micros.load(), 10000);
+  ASSERT_EQ(waiter->acquisitions.load(), 1);
+  ASSERT_EQ(waiter->contentions.load(), 1);
+  ASSERT_GT(waiter->wait_micros.load(), 0);
+
+  // The holder is exported with the waiter of its lock.
+  std::vector<std::string> names;
+  std::vector<double> values;
+  lock_contention.Append(&names, &values);
+  std::map<std::string, double> stats;
+  for (size_t i = 0; i < names.size(); ++i) {
+    stats[names[i]] = values[i];
+  }
+  const std::string file(io::Basename(__FILE__));
+  ASSERT_EQ(stats["lock/test_lock@" + file + ":2/contentions"], 1);
+  ASSERT_GE(stats["lock/test_lock@" + file + ":1/hold_micros"], 10000);
+
+  StepStats step_stats;
+  lock_contention.AddStepStats(before, 0, &step_stats);
+  ASSERT_EQ(step_stats.dev_stats_size(), 1);
+  ASSERT_EQ(step_stats.dev_stats(0).device(), "/lock_contention");
+  ASSERT_EQ(step_stats.dev_stats(0).node_stats_size(), 1);
+  ASSERT_EQ(step_stats.dev_stats(0).node_stats(0).node_name(),
+            "test_lock@" + file + ":2");
+
+  ASSERT_EQ(LockContention::Site::Bucket(0), 0);
+  ASSERT_EQ(LockContention::Site::Bucket(1), 1);
+  ASSERT_EQ(LockContention::Site::Bucket(3), 2);
+  ASSERT_EQ(LockContention::Site::Bucket(1LL << 40),
+            LockContention::kNumBuckets - 1);
+}
+
 TEST(EmbeddingVariableTest, TestLevelDBIterator) {
   auto hashmap = new LevelDBKV<int64, float>(testing::TmpDir());
   hashmap->SetTotalDims(126);
@@ -1331,6 +1547,340 @@ TEST(EmbeddingVariableTest, TestLFUCache) {
   }
 }
 
+TEST(EmbeddingVariableTest, TestShardedClockCache) {
+  BatchCache<int64>* cache = new ShardedClockCache<int64>();
+  int num_ids = 30;
+  int num_access = 100;
+  int num_evict = 50;
+  int64 ids[num_access] = {0};
+  int64 evict_ids[num_evict] = {0};
+  for (int i = 0; i < num_access; i++){
+    ids[i] = i % num_ids;
+  }
+  cache->update(ids, num_access);
+  ASSERT_EQ(cache->size(), num_ids);
+  int64 size = cache->get_evic_ids(evict_ids, num_evict);
+  ASSERT_EQ(size, num_ids);
+  ASSERT_EQ(cache->size(), 0);
+  std::set<int64> evicted(evict_ids, evict_ids + size);
+  ASSERT_EQ(evicted.size(), num_ids);
+  delete cache;
+}
+
+TEST(EmbeddingVariableTest, TestShardedClockCacheSecondChance) {
+  BatchCache<int64>* cache = new ShardedClockCache<int64>(4);
+  int num_ids = 20;
+  std::vector<int64> ids(num_ids);
+  for (int i = 0; i < num_ids; i++) {
+    ids[i] = i;
+  }
+  cache->update(ids.data(), num_ids);
+  // Reference the first half again, the second half is evicted first.
+  cache->update(ids.data(), num_ids / 2);
+  std::vector<int64> evict_ids(num_ids / 2);
+  int64 size = cache->get_evic_ids(evict_ids.data(), num_ids / 2);
+  ASSERT_EQ(size, num_ids / 2);
+  for (int i = 0; i < size; i++) {
+    ASSERT_GE(evict_ids[i], num_ids / 2);
+  }
+  std::vector<int64> cached_ids(num_ids);
+  ASSERT_EQ(cache->get_cached_ids(cached_ids.data(), num_ids,
+                                  nullptr, nullptr), num_ids / 2);
+  delete cache;
+}
+
+TEST(EmbeddingVariableTest, TestShardedClockCacheMultiThread) {
+  BatchCache<int64>* cache = new ShardedClockCache<int64>();
+  int num_threads = 8;
+  int num_ids = 10000;
+  std::vector<std::thread> update_threads(num_threads);
+  for (int t = 0; t < num_threads; t++) {
+    update_threads[t] = std::thread([cache, num_ids, t]() {
+      std::vector<int64> ids(num_ids);
+      for (int i = 0; i < num_ids; i++) {
+        ids[i] = (i * 7 + t) % num_ids;
+      }
+      cache->update(ids.data(), num_ids);
+    });
+  }
+  for (auto& t : update_threads) {
+    t.join();
+  }
+  ASSERT_EQ(cache->size(), num_ids);
+  std::vector<int64> evict_ids(num_ids);
+  ASSERT_EQ(cache->get_evic_ids(evict_ids.data(), num_ids), num_ids);
+  ASSERT_EQ(cache->size(), 0);
+  delete cache;
+}
+
+TEST(EmbeddingVariableTest, TestTinyLFUCache) {
+  BatchCache<int64>* cache = new TinyLFUCache<int64>();
+  int num_ids = 30;
+  std::vector<int64> ids(num_ids);
+  for (int i = 0; i < num_ids; i++) {
+    ids[i] = i;
+  }
+  cache->update(ids.data(), num_ids);
+  cache->update(ids.data(), num_ids / 2);
+  ASSERT_EQ(cache->size(), num_ids);
+  std::vector<int64> cached_ids(num_ids);
+  ASSERT_EQ(cache->get_cached_ids(cached_ids.data(), num_ids,
+                                  nullptr, nullptr), num_ids);
+  std::vector<int64> evict_ids(num_ids);
+  ASSERT_EQ(cache->get_evic_ids(evict_ids.data(), num_ids), num_ids);
+  std::sort(evict_ids.begin(), evict_ids.end());
+  for (int i = 0; i < num_ids; i++) {
+    ASSERT_EQ(evict_ids[i], i);
+  }
+  ASSERT_EQ(cache->size(), 0);
+  delete cache;
+}
+
+TEST(EmbeddingVariableTest, TestTinyLFUCacheAdmission) {
+  BatchCache<int64>* cache = new TinyLFUCache<int64>();
+  int num_hot_ids = 100;
+  std::vector<int64> hot_ids(num_hot_ids);
+  for (int i = 0; i < num_hot_ids; i++) {
+    hot_ids[i] = i;
+  }
+  for (int i = 0; i < 5; i++) {
+    cache->update(hot_ids.data(), num_hot_ids);
+  }
+  // A scan of ids seen once must not evict the frequent ids.
+  std::vector<int64> cold_ids(num_hot_ids);
+  for (int i = 0; i < num_hot_ids; i++) {
+    cold_ids[i] = num_hot_ids + i;
+  }
+  cache->update(cold_ids.data(), num_hot_ids);
+  int num_evict_ids = num_hot_ids / 2;
+  std::vector<int64> evict_ids(num_evict_ids);
+  ASSERT_EQ(cache->get_evic_ids(evict_ids.data(), num_evict_ids),
+            num_evict_ids);
+  for (int i = 0; i < num_evict_ids; i++) {
+    ASSERT_GE(evict_ids[i], num_hot_ids);
+  }
+  delete cache;
+}
+
+TEST(EmbeddingVariableTest, TestFreqRecencyCache) {
+  BatchCache<int64>* cache = new FreqRecencyCache<int64>();
+  int num_ids = 30;
+  std::vector<int64> ids(num_ids);
+  for (int i = 0; i < num_ids; i++) {
+    ids[i] = i;
+  }
+  cache->update(ids.data(), num_ids);
+  cache->update(ids.data(), num_ids / 2);
+  ASSERT_EQ(cache->size(), num_ids);
+  // Prefetched ids are pinned until they are added back to the cache.
+  cache->add_to_prefetch_list(ids.data() + num_ids - 1, 1);
+  ASSERT_EQ(cache->size(), num_ids - 1);
+  std::vector<int64> evict_ids(num_ids);
+  ASSERT_EQ(cache->get_evic_ids(evict_ids.data(), num_ids / 2 - 1),
+            num_ids / 2 - 1);
+  for (int i = 0; i < num_ids / 2 - 1; i++) {
+    ASSERT_GE(evict_ids[i], num_ids / 2);
+    ASSERT_LT(evict_ids[i], num_ids - 1);
+  }
+  cache->add_to_cache(ids.data() + num_ids - 1, 1);
+  ASSERT_EQ(cache->size(), num_ids / 2 + 1);
+  delete cache;
+}
+
+TEST(EmbeddingVariableTest, TestFreqRecencyCacheDecay) {
+  BatchCache<int64>* cache = new FreqRecencyCache<int64>();
+  int64 old_id = 0;
+  int64 recent_id = 1;
+  for (int i = 0; i < 50; i++) {
+    cache->update(&old_id, 1);
+  }
+  // The frequency of an id is halved for every 1000 batches without it.
+  for (int i = 0; i < 3000; i++) {
+    cache->update(nullptr, 0);
+  }
+  for (int i = 0; i < 7; i++) {
+    cache->update(&recent_id, 1);
+  }
+  int64 evict_id = -1;
+  ASSERT_EQ(cache->get_evic_ids(&evict_id, 1), 1);
+  ASSERT_EQ(evict_id, old_id);
+  delete cache;
+}
+
+TEST(EmbeddingVariableTest, TestCountMinSketch) {
+  CountMinSketch<int64> sketch(1024);
+  for (int i = 0; i < 5; i++) {
+    sketch.Add(1);
+  }
+  sketch.Add(2);
+  ASSERT_GE(sketch.Estimate(1), 5);
+  ASSERT_GE(sketch.Estimate(2), 1);
+  ASSERT_LT(sketch.Estimate(2), sketch.Estimate(1));
+  // Counters are halved after 10 * width additions.
+  for (int i = 0; i < 10 * 1024; i++) {
+    sketch.Add(2);
+  }
+  ASSERT_LT(sketch.Estimate(1), 5);
+}
+
+TEST(EmbeddingVariableTest, TestBlockedCountingBloomFilter) {
+  BlockedCountingBloomFilter<int64> filter(1 << 16, 4);
+  for (int64 i = 0; i < 1000; i++) {
+    filter.Add(i, i % 7);
+  }
+  for (int64 i = 0; i < 1000; i++) {
+    ASSERT_GE(filter.Get(i), i % 7);
+  }
+  // Counters saturate instead of wrapping around.
+  filter.Add(1, 200);
+  filter.Add(1, 200);
+  ASSERT_EQ(filter.Get(1), 255);
+  filter.Set(2, 10);
+  ASSERT_EQ(filter.Get(2), 10);
+
+  BlockedCountingBloomFilter<int64> decayed(1 << 16, 4,
+                                            /*decay_interval=*/4);
+  decayed.Add(1, 100);
+  for (int64 i = 0; i < 3; i++) {
+    decayed.Add(1000 + i, 1);
+  }
+  ASSERT_EQ(decayed.Get(1), 50);
+}
+
+TEST(EmbeddingVariableTest, TestIdTraceRecorder) {
+  const std::string dir = io::JoinPath(testing::TmpDir(), "id_trace");
+  int64 undeleted_files, undeleted_dirs;
+  Env::Default()->DeleteRecursively(dir, &undeleted_files, &undeleted_dirs)
+      .IgnoreError();
+  setenv("TF_EV_ID_TRACE_DIR", dir.c_str(), 1);
+  setenv("TF_EV_ID_TRACE_BUFFER_KB", "1", 1);
+  std::vector<std::vector<int64>> batches;
+  {
+    auto recorder = IdTraceRecorder::Create("scope/EmbeddingVar");
+    ASSERT_NE(recorder, nullptr);
+    for (int64 i = 0; i < 1000; i++) {
+      std::vector<int64> keys = {i * 7, -i, i * 7, 1LL << 40};
+      recorder->Record(keys.data(), keys.size());
+    }
+  }
+  std::vector<string> files;
+  TF_CHECK_OK(Env::Default()->GetMatchingPaths(
+      io::JoinPath(dir, "scope_EmbeddingVar*.idtrace"), &files));
+  ASSERT_EQ(files.size(), 1);
+  TF_CHECK_OK(IdTraceRecorder::ReadTrace(files[0], &batches));
+  ASSERT_EQ(batches.size(), 1000);
+  std::multiset<int64> ids;
+  for (auto& batch : batches) {
+    ASSERT_EQ(batch.size(), 4);
+    ids.insert(batch.begin(), batch.end());
+  }
+  for (int64 i = 0; i < 1000; i++) {
+    ASSERT_EQ(ids.count(i * 7), i == 0 ? 3 : 2);
+  }
+  ASSERT_EQ(ids.count(1LL << 40), 1000);
+
+  setenv("TF_EV_ID_TRACE_SAMPLE_RATE", "0.25", 1);
+  {
+    auto recorder = IdTraceRecorder::Create("Sampled");
+    ASSERT_NE(recorder, nullptr);
+    std::vector<int64> keys(10000);
+    std::iota(keys.begin(), keys.end(), 0);
+    recorder->Record(keys.data(), keys.size());
+  }
+  TF_CHECK_OK(Env::Default()->GetMatchingPaths(
+      io::JoinPath(dir, "Sampled*.idtrace"), &files));
+  ASSERT_EQ(files.size(), 1);
+  TF_CHECK_OK(IdTraceRecorder::ReadTrace(files[0], &batches));
+  ASSERT_EQ(batches.size(), 1);
+  ASSERT_GT(batches[0].size(), 2000);
+  ASSERT_LT(batches[0].size(), 3000);
+  unsetenv("TF_EV_ID_TRACE_DIR");
+  unsetenv("TF_EV_ID_TRACE_BUFFER_KB");
+  unsetenv("TF_EV_ID_TRACE_SAMPLE_RATE");
+}
+
+TEST(EmbeddingVariableTest, TestEmbeddingVarStats) {
+  EmbeddingVarStats stats;
+  {
+    EmbeddingVarStats::LookupTimer timer(&stats, 8);
+  }
+  stats.RecordLookup(2, 10);
+  stats.RecordCreation();
+  stats.RecordCreation();
+  stats.RecordRejections(5);
+  stats.RecordRejections(0);
+
+  std::vector<std::string> names;
+  std::vector<double> values;
+  stats.Append(&names, &values);
+  ASSERT_EQ(names.size(), values.size());
+  std::map<std::string, double> stats_map;
+  for (size_t i = 0; i < names.size(); i++) {
+    stats_map[names[i]] = values[i];
+  }
+  ASSERT_EQ(stats_map["lookups"], 10);
+  ASSERT_EQ(stats_map["lookup_calls"], 2);
+  ASSERT_GE(stats_map["lookup_micros"], 10);
+  ASSERT_EQ(stats_map["creations"], 2);
+  ASSERT_EQ(stats_map["filter_rejections"], 5);
+  ASSERT_NEAR(stats_map["creation_ratio"], 0.2, 1e-6);
+  ASSERT_NEAR(stats_map["filter_rejection_ratio"], 0.5, 1e-6);
+}
+
+TEST(EmbeddingVariableTest, TestServingRowCache) {
+  typedef ServingRowCache<int64, float> Cache;
+  const int64 value_len = 4;
+  std::atomic<int64> num_read(0);
+  auto read_rows = [&num_read](const int64* keys, float* rows, int64 n) {
+    for (int64 i = 0; i < n; ++i) {
+      std::fill(rows + i * value_len, rows + (i + 1) * value_len,
+                static_cast<float>(keys[i]));
+    }
+    num_read += n;
+  };
+  unsetenv("TF_SERVING_ROW_CACHE_MB");
+  ASSERT_EQ(Cache::Create(value_len, read_rows), nullptr);
+  setenv("TF_SERVING_ROW_CACHE_MB", "1", 1);
+  setenv("TF_SERVING_ROW_CACHE_REFRESH_SECS", "0", 1);
+  std::unique_ptr<Cache> cache(Cache::Create(value_len, read_rows));
+  ASSERT_NE(cache.get(), nullptr);
+
+  // The key 7 is sampled in each lookup, the others in few of them.
+  std::vector<int64> keys(Cache::kSampleStride, 7);
+  keys.push_back(100);
+  std::vector<float> rows(keys.size() * value_len);
+  std::unique_ptr<bool[]> hits(new bool[keys.size()]);
+  for (int i = 0; i < 16; ++i) {
+    ASSERT_EQ(cache->Lookup(keys.data(), keys.size(), rows.data(),
+                            hits.get()), 0);
+  }
+  ASSERT_TRUE(cache->StartRefresh());
+  ASSERT_FALSE(cache->StartRefresh());
+  cache->Refresh();
+  ASSERT_GE(cache->NumRows(), 1);
+  ASSERT_LE(cache->NumRows(), cache->MaxRows());
+
+  std::fill(rows.begin(), rows.end(), -1);
+  ASSERT_GE(cache->Lookup(keys.data(), keys.size(), rows.data(), hits.get()),
+            Cache::kSampleStride);
+  ASSERT_TRUE(hits[0]);
+  ASSERT_EQ(rows[0], 7);
+  ASSERT_EQ(rows[value_len - 1], 7);
+
+  // Invalidated by an update of the rows, read again by the next refresh.
+  const int64 num_read_before = num_read;
+  cache->Invalidate();
+  ASSERT_EQ(cache->NumRows(), 0);
+  ASSERT_EQ(cache->Lookup(keys.data(), keys.size(), rows.data(),
+                          hits.get()), 0);
+  ASSERT_TRUE(cache->StartRefresh());
+  cache->Refresh();
+  ASSERT_GT(num_read, num_read_before);
+  ASSERT_GE(cache->Lookup(keys.data(), 1, rows.data(), hits.get()), 1);
+  unsetenv("TF_SERVING_ROW_CACHE_MB");
+  unsetenv("TF_SERVING_ROW_CACHE_REFRESH_SECS");
+}
+
 TEST(EmbeddingVariableTest, TestCacheRestore) {
   int64 value_size = 4;
   Tensor value(DT_FLOAT, TensorShape({value_size}));
@@ -1443,6 +1993,220 @@ TEST(EmbeddingVariableTest, TestGPUValuePtr) {
   }
 }//Forbidden, due to no gpu allocator at that time
 
+void TestQuantizedValuePtr(RowQuantization type, int64 block_size,
+                           float tolerance) {
+  int64 dim = 70;
+  std::vector<float> row(dim);
+  for (int i = 0; i < dim; i++) {
+    row[i] = (i < 32) ? 0.01 * i : 3.0 - 0.1 * i;
+  }
+  QuantizedValuePtr<float> value_ptr(cpu_allocator(), dim, type, block_size);
+  ASSERT_FALSE(value_ptr.IsInitialized());
+  float* val = value_ptr.GetOrAllocate(cpu_allocator(), dim, row.data(),
+                                       0, 0);
+  ASSERT_TRUE(value_ptr.IsInitialized());
+  std::vector<float> out(dim);
+  value_ptr.Dequantize(out.data(), dim);
+  std::vector<float> acc(dim, 1.0);
+  value_ptr.Accumulate(2.0, acc.data(), dim);
+  for (int i = 0; i < dim; i++) {
+    ASSERT_NEAR(out[i], row[i], tolerance);
+    ASSERT_EQ(val[i], out[i]);
+    ASSERT_NEAR(acc[i], 1.0 + 2.0 * out[i], 1e-5);
+  }
+  value_ptr.Destroy(cpu_allocator());
+}
+
+TEST(EmbeddingVariableTest, TestQuantizedValuePtr) {
+  // Half of the quantization step of the row, 3.9 / 127 / 2.
+  TestQuantizedValuePtr(RowQuantization::INT8, 0, 0.016);
+  // Half of the quantization step of the first block, 0.31 / 127 / 2.
+  TestQuantizedValuePtr(RowQuantization::INT8, 32, 0.016);
+  TestQuantizedValuePtr(RowQuantization::FP16, 0, 0.002);
+}
+
+TEST(EmbeddingVariableTest, TestQuantizedRowBlocks) {
+  std::vector<float> row(40, 0.0);
+  row[0] = 127.0;
+  row[39] = 1.0;
+  std::vector<char> q(QuantizedRowBytes(RowQuantization::INT8, 40, 16));
+  ASSERT_EQ(q.size(), 3 * sizeof(float) + 40);
+  QuantizeRow(RowQuantization::INT8, row.data(), 40, 16, q.data());
+  std::vector<float> out(40);
+  DequantizeRow(RowQuantization::INT8, q.data(), 40, 16, out.data());
+  // Values of the last block don't lose precision to the first one.
+  ASSERT_EQ(out[0], 127.0);
+  ASSERT_NEAR(out[39], 1.0, 1e-6);
+}
+
+TEST(EmbeddingVariableTest, TestOptimizerStateRow) {
+  // Two blocks, values spanning 12 octaves, and 0.
+  const int64 dim = 300;
+  std::vector<float> values(dim);
+  for (int64 i = 0; i < dim; i++) {
+    values[i] = ((i % 2) ? -1 : 1) * std::pow(2.0f, -(i % 13) + 0.3f);
+  }
+  values[7] = 0.0;
+  const int64 state_len = Int8StateLen<float>(dim);
+  ASSERT_EQ(state_len, (2 * sizeof(float) + dim + 3) / sizeof(float));
+  std::vector<float> state(state_len);
+  QuantizeRow(RowQuantization::DYNAMIC_INT8, values.data(), dim,
+              kStateBlockSize, reinterpret_cast<char*>(state.data()));
+
+  OptimizerStateRow<float> state_row(state.data(), dim, true);
+  auto flat = state_row.flat();
+  for (int64 i = 0; i < dim; i++) {
+    ASSERT_NEAR(flat(i), values[i], std::abs(values[i]) * 0.0625);
+  }
+  ASSERT_EQ(flat(7), 0.0);
+  // Values far below the max of their block are not flushed to 0.
+  flat(3) = flat(0) * 1e-9;
+  state_row.Commit();
+  OptimizerStateRow<float> updated(state.data(), dim, true);
+  ASSERT_GT(updated.flat()(3), 0.0);
+  ASSERT_NEAR(updated.flat()(0), values[0], std::abs(values[0]) * 0.0625);
+
+  // Full-precision rows are used in place.
+  OptimizerStateRow<float> full_row(values.data(), dim, false);
+  ASSERT_EQ(full_row.flat().data(), values.data());
+}
+
+TEST(EmbeddingVariableTest, TestBFloat16MathRow) {
+  // Covers both the vectorized part and the tail.
+  const int64 dim = 37;
+  std::vector<float> values(dim);
+  std::vector<bfloat16> row(dim);
+  for (int64 i = 0; i < dim; i++) {
+    values[i] = (i - 18) * 0.3731;
+    row[i] = static_cast<bfloat16>(values[i]);
+  }
+  std::vector<bfloat16> converted(dim);
+  FloatToBFloat16(values.data(), dim, converted.data());
+  for (int64 i = 0; i < dim; i++) {
+    ASSERT_EQ(converted[i].value, row[i].value);
+  }
+
+  // Updates smaller than the bfloat16 step of the values add up in float
+  // until the row is committed.
+  FloatMathRow<bfloat16> math_row(row.data(), dim);
+  for (int step = 0; step < 100; step++) {
+    math_row.flat() += math_row.flat().constant(0.001);
+  }
+  math_row.Commit();
+  for (int64 i = 0; i < dim; i++) {
+    float expected = static_cast<float>(static_cast<bfloat16>(values[i]));
+    ASSERT_NEAR(static_cast<float>(row[i]), expected + 0.1,
+                std::abs(expected + 0.1) / 128 + 1e-6);
+  }
+}
+
+TEST(EmbeddingVariableTest, TestMixedDimLayout) {
+  setenv("TF_EV_DIM_CLASSES", "2,4", 1);
+  setenv("TF_EV_DIM_PROMOTION_FREQS", "2,4", 1);
+  int64 value_size = 8;
+  Tensor value(DT_FLOAT, TensorShape({value_size}));
+  test::FillValues<float>(&value, std::vector<float>(value_size, 1.0));
+  EmbeddingConfig emb_config = EmbeddingConfig(0, 0, 1, 0, "", 0, 0, 999999,
+      -1.0, "mixed_dim", 0, -1.0, DT_UINT64, 1, .0, true);
+  auto storage = embedding::StorageFactory::Create<int64, float>(
+      embedding::StorageConfig(
+          StorageType::DRAM, "", {1024, 1024, 1024, 1024}, "mixed_dim",
+          emb_config),
+      cpu_allocator(),
+      "EmbeddingVar");
+  auto emb_var = new EmbeddingVar<int64, float>("EmbeddingVar",
+      storage, emb_config, cpu_allocator());
+  emb_var->Init(value, 1);
+  ASSERT_TRUE(emb_var->IsMixedDim());
+
+  for (int64 i = 0; i < 6; i++) {
+    ValuePtr<float>* value_ptr = nullptr;
+    TF_CHECK_OK(emb_var->LookupOrCreateKey(i, &value_ptr));
+    value_ptr->SetFreq(i);
+    typename TTypes<float>::Flat vflat = emb_var->flat(value_ptr, i);
+    for (int64 j = 0; j < value_size; j++) {
+      vflat(j) = 10 * i + j;
+    }
+  }
+  embedding::ShrinkArgs shrink_args;
+  TF_CHECK_OK(emb_var->Shrink(shrink_args));
+  std::vector<int64> row_dims = {2, 2, 4, 4, 8, 8};
+  std::vector<float> out(value_size);
+  for (int64 i = 0; i < 6; i++) {
+    ASSERT_EQ(emb_var->RowDims(i), row_dims[i]);
+    ValuePtr<float>* value_ptr = nullptr;
+    TF_CHECK_OK(emb_var->LookupKey(i, &value_ptr));
+    static_cast<MixedDimValuePtr<float>*>(value_ptr)->ReadPrimary(
+        out.data(), value_size);
+    for (int64 j = 0; j < value_size; j++) {
+      ASSERT_EQ(out[j], (j < row_dims[i]) ? 10 * i + j : 0);
+    }
+  }
+
+  // Rows are promoted to value_size dims again when they are written.
+  ValuePtr<float>* value_ptr = nullptr;
+  TF_CHECK_OK(emb_var->LookupKey(1, &value_ptr));
+  typename TTypes<float>::Flat vflat = emb_var->flat(value_ptr, 1);
+  ASSERT_EQ(emb_var->RowDims(1), value_size);
+  for (int64 j = 0; j < value_size; j++) {
+    ASSERT_EQ(vflat(j), (j < 2) ? 10 + j : 0);
+  }
+  // And to the dims of their freq by Shrink.
+  value_ptr->SetFreq(3);
+  TF_CHECK_OK(emb_var->Shrink(shrink_args));
+  ASSERT_EQ(emb_var->RowDims(1), 4);
+  emb_var->Unref();
+  unsetenv("TF_EV_DIM_CLASSES");
+  unsetenv("TF_EV_DIM_PROMOTION_FREQS");
+}
+
+TEST(EmbeddingVariableTest, TestLazySlot) {
+  setenv("TF_EV_LAZY_SLOT_FREQ", "3", 1);
+  int64 value_size = 4;
+  Tensor value(DT_FLOAT, TensorShape({value_size}));
+  test::FillValues<float>(&value, std::vector<float>(value_size, 1.0));
+  EmbeddingConfig primary_config = EmbeddingConfig(0, 0, 1, 1, "", 0, 0,
+      999999, -1.0, "normal");
+  auto storage = embedding::StorageFactory::Create<int64, float>(
+      embedding::StorageConfig(
+          StorageType::DRAM, "", {1024, 1024, 1024, 1024}, "normal",
+          primary_config),
+      cpu_allocator(),
+      "EmbeddingVar");
+  auto primary = new EmbeddingVar<int64, float>("EmbeddingVar",
+      storage, primary_config, cpu_allocator());
+  primary->Init(value, 1);
+  auto slot = new EmbeddingVar<int64, float>("EmbeddingVar/Slot",
+      storage, EmbeddingConfig(1, 0, 1, 1, "", 0, 0, 999999, -1.0, "normal"),
+      cpu_allocator());
+  slot->Init(value, 1);
+
+  ValuePtr<float>* value_ptr = nullptr;
+  bool is_filter = false;
+  TF_CHECK_OK(primary->LookupOrCreateKey(1, &value_ptr, &is_filter, false,
+                                         2));
+  ASSERT_EQ(value_ptr->GetFreq(), 2);
+  // Cold keys update a stand-in of the default value of their slots.
+  typename TTypes<float>::Flat vflat = slot->flat(value_ptr, 1);
+  vflat(0) = 5.0;
+  ASSERT_EQ(value_ptr->GetValue(1, storage->GetOffset(1)), nullptr);
+  ASSERT_EQ(slot->flat(value_ptr, 1)(0), 1.0);
+  ASSERT_NE(primary->flat(value_ptr, 1).data(), nullptr);
+
+  // The slot is created once the frequency of the key reaches 3.
+  TF_CHECK_OK(primary->LookupOrCreateKey(1, &value_ptr, &is_filter, false,
+                                         1));
+  ASSERT_EQ(value_ptr->GetFreq(), 3);
+  auto state_row = slot->StateRow(value_ptr, 1);
+  state_row.flat()(0) = 5.0;
+  state_row.Commit();
+  ASSERT_NE(value_ptr->GetValue(1, storage->GetOffset(1)), nullptr);
+  ASSERT_EQ(slot->flat(value_ptr, 1)(0), 5.0);
+  slot->Unref();
+  primary->Unref();
+  unsetenv("TF_EV_LAZY_SLOT_FREQ");
+}
+
 TEST(EmbeddingVariableTest, TestCommitValue) {
   int ev_list_size = 32;
   ValuePtr<float>* ptr_ = new NormalGPUValuePtr<float>(ev_allocator(),ev_list_size);
@@ -1593,6 +2357,179 @@ TEST(EmbeddingVariableTest, TestCPUGPUMalloc) {
 }
 #endif //GOOGLE_CUDA
 
+TEST(EmbeddingVariableTest, TestEmbeddingMemoryPoolConcurrent) {
+  EmbeddingMemoryPool<float> mem_pool(cpu_allocator(), 4, 4 * 4 * 1000);
+  const int th_num = 8;
+  std::vector<std::vector<float*>> held(th_num);
+  std::vector<std::thread> th_arr;
+  for (int t = 0; t < th_num; ++t) {
+    th_arr.emplace_back([&mem_pool, &held, t]() {
+      for (int round = 0; round < 100; ++round) {
+        for (int i = 0; i < 300; ++i) {
+          held[t].emplace_back(mem_pool.Allocate());
+        }
+        for (int i = 0; i < 250; ++i) {
+          mem_pool.Deallocate(held[t].back());
+          held[t].pop_back();
+        }
+      }
+    });
+  }
+  for (auto& th : th_arr) {
+    th.join();
+  }
+  std::set<float*> distinct;
+  int64 total = 0;
+  for (auto& ptrs : held) {
+    distinct.insert(ptrs.begin(), ptrs.end());
+    total += ptrs.size();
+  }
+  ASSERT_EQ(total, distinct.size());
+}
+
+TEST(EmbeddingVariableTest, TestEpochReclaimer) {
+  EpochReclaimer reclaimer;
+  std::atomic<int> num_deleted(0);
+  {
+    EpochGuard guard(&reclaimer);
+    reclaimer.Retire([&num_deleted]() { num_deleted++; });
+    for (int i = 0; i < 4; ++i) {
+      reclaimer.TryReclaim();
+    }
+    // The guard entered before the retirement is still active.
+    ASSERT_EQ(num_deleted, 0);
+    ASSERT_EQ(reclaimer.NumPending(), 1);
+  }
+  for (int i = 0; i < 2; ++i) {
+    reclaimer.TryReclaim();
+  }
+  ASSERT_EQ(num_deleted, 1);
+  ASSERT_EQ(reclaimer.NumPending(), 0);
+}
+
+TEST(EmbeddingVariableTest, TestEpochReclaimerConcurrent) {
+  EpochReclaimer reclaimer;
+  const int th_num = 8;
+  const int num_retires = 100000;
+  // Readers check the values they see have not been reclaimed yet.
+  std::atomic<int*> shared(new int(0));
+  std::atomic<bool> done(false);
+  std::atomic<int64> num_bad(0);
+  std::vector<std::thread> th_arr;
+  for (int t = 0; t < th_num; ++t) {
+    th_arr.emplace_back([&]() {
+      while (!done) {
+        EpochGuard guard(&reclaimer);
+        int* value = shared.load();
+        if (*value < 0) {
+          num_bad++;
+        }
+      }
+    });
+  }
+  for (int i = 1; i <= num_retires; ++i) {
+    int* old_value = shared.exchange(new int(i));
+    reclaimer.Retire([old_value]() {
+      *old_value = -1;
+      delete old_value;
+    });
+  }
+  done = true;
+  for (auto& th : th_arr) {
+    th.join();
+  }
+  for (int i = 0; i < 2; ++i) {
+    reclaimer.TryReclaim();
+  }
+  ASSERT_EQ(num_bad, 0);
+  ASSERT_EQ(reclaimer.NumPending(), 0);
+  delete shared.load();
+}
+
+TEST(EmbeddingVariableTest, TestHbmCacheBudget) {
+  const int64 kMB = 1 << 20;
+  HbmCacheBudget budget;
+  int a = 0, b = 0;
+  int64 a_bytes = 0, b_bytes = 0;
+  budget.Register(&a, 300 * kMB, [&a_bytes](int64 bytes) {
+    a_bytes = bytes;
+  });
+  budget.Register(&b, 100 * kMB, [&b_bytes](int64 bytes) {
+    b_bytes = bytes;
+  });
+  // Without a plan the caches keep their sizes.
+  ASSERT_EQ(a_bytes, 300 * kMB);
+  ASSERT_EQ(b_bytes, 100 * kMB);
+  budget.SetDeviceBytes(1024 * kMB);
+  ASSERT_EQ(a_bytes, 300 * kMB);
+  // 200MB left after the dense ops and the 512MB reserved by default.
+  budget.SetDenseBytes(312 * kMB);
+  ASSERT_EQ(a_bytes, 150 * kMB);
+  ASSERT_EQ(b_bytes, 50 * kMB);
+  ASSERT_EQ(budget.CacheBytes(&a), 150 * kMB);
+  // Shrinking activations give the memory back to the caches.
+  budget.SetDenseBytes(100 * kMB);
+  ASSERT_EQ(a_bytes, 300 * kMB);
+  ASSERT_EQ(b_bytes, 100 * kMB);
+  budget.SetDenseBytes(1024 * kMB);
+  ASSERT_EQ(a_bytes, 0);
+  budget.Unregister(&b);
+  ASSERT_EQ(budget.CacheBytes(&b), -1);
+}
+
+TEST(EmbeddingVariableTest, TestIntraThreadCopyIdAllocator) {
+  const int th_num = 8;
+  IntraThreadCopyIdAllocator copy_id_alloc(th_num);
+  IntraThreadCopyIdAllocator other_copy_id_alloc(th_num);
+  uint64 main_thread_id = Env::Default()->GetCurrentThreadId();
+  ASSERT_EQ(copy_id_alloc.GetCopyIdOfThread(main_thread_id), th_num);
+  std::vector<int64> copy_ids(th_num);
+  std::atomic<int64> num_changed(0);
+  std::vector<std::thread> th_arr;
+  for (int t = 0; t < th_num; ++t) {
+    th_arr.emplace_back([&, t]() {
+      copy_ids[t] = copy_id_alloc.GetCopyIdOfThread(main_thread_id);
+      for (int i = 0; i < 100; ++i) {
+        // Interleaving another allocator must not change the copy id.
+        other_copy_id_alloc.GetCopyIdOfThread(main_thread_id);
+        if (copy_id_alloc.GetCopyIdOfThread(main_thread_id) != copy_ids[t]) {
+          num_changed++;
+        }
+      }
+    });
+  }
+  for (auto& th : th_arr) {
+    th.join();
+  }
+  ASSERT_EQ(num_changed, 0);
+  std::set<int64> distinct(copy_ids.begin(), copy_ids.end());
+  ASSERT_EQ(distinct.size(), th_num);
+  for (int64 copy_id : copy_ids) {
+    ASSERT_TRUE(copy_id >= 0 && copy_id < th_num);
+  }
+}
+
+TEST(EmbeddingVariableTest, TestCopyDefaultValue) {
+  std::vector<char> src(1024 + 16);
+  for (int i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<char>(i * 7 + 1);
+  }
+  // Covers the unaligned heads and tails around the streaming stores.
+  for (int bytes : {0, 17, 255, 256, 300, 1024}) {
+    for (int offset = 0; offset < 16; offset += 5) {
+      std::vector<char> dst(bytes + 32, 0);
+      CopyDefaultValue(dst.data() + offset, src.data() + 3, bytes);
+      for (int i = 0; i < offset; ++i) {
+        ASSERT_EQ(dst[i], 0);
+      }
+      ASSERT_EQ(memcmp(dst.data() + offset, src.data() + 3, bytes), 0);
+      for (int i = offset + bytes; i < dst.size(); ++i) {
+        ASSERT_EQ(dst[i], 0);
+      }
+    }
+  }
+}
+
 void malloc_free_use_allocator(Allocator* allocator){
   timespec start;
   timespec end;
@@ -1717,6 +2654,10 @@ void TestCompaction() {
       ASSERT_EQ(v[4+j], i + 2);
     }
   }
+  CompactionMetrics metrics = hashmap->GetCompactionMetrics();
+  int64 val_len = sizeof(FixedLengthHeader) + 124 * sizeof(float);
+  ASSERT_EQ(metrics.bytes_written, (262144 + 131073 + 131071 + 1) * val_len);
+  ASSERT_GE(metrics.WriteAmplification(), 1.0);
   delete hashmap;
 }
 
@@ -1730,6 +2671,31 @@ TEST(KVInterfaceTest, TestSSDKVSyncCompaction) {
   TestCompaction();
 }
 
+TEST(KVInterfaceTest, TestSSDKVCompactionWithIoBudget) {
+  setenv("TF_SSDHASH_ASYNC_COMPACTION", "true", 1);
+  setenv("TF_SSDHASH_COMPACTION_BANDWIDTH_MB", "1024", 1);
+  setenv("TF_SSDHASH_COMPACTION_LOW_PRIORITY", "true", 1);
+  setenv("TF_SSDHASH_COMPACTION_MAX_FILES", "1", 1);
+  TestCompaction();
+  unsetenv("TF_SSDHASH_COMPACTION_BANDWIDTH_MB");
+  unsetenv("TF_SSDHASH_COMPACTION_LOW_PRIORITY");
+  unsetenv("TF_SSDHASH_COMPACTION_MAX_FILES");
+}
+
+TEST(KVInterfaceTest, TestCompactionSchedulerPickVictims) {
+  setenv("TF_SSDHASH_COMPACTION_MAX_FILES", "2", 1);
+  CompactionScheduler scheduler;
+  unsetenv("TF_SSDHASH_COMPACTION_MAX_FILES");
+  // {version, count, invalid_count}
+  std::vector<CompactionScheduler::Candidate> candidates = {
+      {9, 100, 40}, {1, 100, 40}, {5, 100, 90}, {8, 100, 0}};
+  std::vector<int64> victims = scheduler.PickVictims(candidates, 10);
+  ASSERT_EQ(victims.size(), 2);
+  // The most garbage first, then the older of the equal ones.
+  ASSERT_EQ(victims[0], 5);
+  ASSERT_EQ(victims[1], 1);
+}
+
 void TestReadEmbFile() {
   std::string temp_dir = testing::TmpDir();
   auto hashmap = new SSDHashKV<int64, float>(
@@ -1772,6 +2738,162 @@ TEST(KVInterfaceTest, TestDirectIoFile) {
 }
 
 
+void TestBatchReadEmbFile() {
+  std::string temp_dir = testing::TmpDir();
+  auto hashmap = new SSDHashKV<int64, float>(
+      temp_dir, cpu_allocator());
+  hashmap->SetTotalDims(124);
+  std::vector<int64> ids;
+  for (int i = 0; i < 262145; i++) {
+    ids.emplace_back(i);
+  }
+  SingleCommit(hashmap, ids, 3);
+  sleep(1);
+  // Keys of the same page, keys far apart, in descending order, and a
+  // missing key.
+  std::vector<int64> keys;
+  for (int i = 262143; i >= 0; i -= 7) {
+    keys.emplace_back(i);
+  }
+  keys.emplace_back(300000);
+  std::vector<ValuePtr<float>*> value_ptrs(keys.size());
+  TF_CHECK_OK(hashmap->BatchLookup(keys.data(), keys.size(),
+                                   value_ptrs.data()));
+  ASSERT_EQ(value_ptrs.back(), nullptr);
+  for (int i = 0; i < keys.size() - 1; i++) {
+    float* v = (float*)value_ptrs[i]->GetPtr();
+    for (int j = 0; j < 124; j++){
+      ASSERT_EQ(v[4+j], keys[i]+3);
+    }
+    hashmap->FreeValuePtr(value_ptrs[i]);
+  }
+  delete hashmap;
+}
+
+TEST(KVInterfaceTest, TestMmapMadviseFileBatchRead) {
+  setenv("TF_SSDHASH_IO_SCHEME", "mmap_and_madvise", 1);
+  TestBatchReadEmbFile();
+}
+
+TEST(KVInterfaceTest, TestMmapFileBatchRead) {
+  setenv("TF_SSDHASH_IO_SCHEME", "mmap", 1);
+  TestBatchReadEmbFile();
+}
+
+TEST(KVInterfaceTest, TestDirectIoFileBatchRead) {
+  setenv("TF_SSDHASH_IO_SCHEME", "directio", 1);
+  TestBatchReadEmbFile();
+}
+
+// The rows of 124 values are a primary embedding of 62 values and a slot.
+void TestSSDKVCodec(float emb_tolerance, bool slot_dropped) {
+  std::string temp_dir = testing::TmpDir();
+  auto hashmap = new SSDHashKV<int64, float>(
+      temp_dir, cpu_allocator());
+  hashmap->SetEmbeddingDims(62);
+  hashmap->SetTotalDims(124);
+  std::vector<int64> ids;
+  for (int i = 0; i < 200000; i++) {
+    ids.emplace_back(i);
+  }
+  std::vector<ValuePtr<float>*> value_ptrs;
+  for (int64 i = 0; i < ids.size(); ++i) {
+    ValuePtr<float>* tmp =
+      new NormalContiguousValuePtr<float>(cpu_allocator(), 124);
+    float* v = (float*)tmp->GetPtr() + 4;
+    for (int j = 0; j < 124; j++) {
+      v[j] = (i % 1000) * 0.01 - j * 0.1;
+    }
+    tmp->SetStep(i);
+    // Marks the slot initialized.
+    *((int8*)tmp->GetPtr() + 6) |= 2;
+    value_ptrs.push_back(tmp);
+  }
+  for (int64 i = 0; i < ids.size(); i++) {
+    hashmap->Commit(ids[i], value_ptrs[i]);
+  }
+  std::vector<int64> keys = {0, 1, 999, 100000, 199999, 300000};
+  std::vector<ValuePtr<float>*> lookup_ptrs(keys.size());
+  TF_CHECK_OK(hashmap->BatchLookup(keys.data(), keys.size(),
+                                   lookup_ptrs.data()));
+  ASSERT_EQ(lookup_ptrs.back(), nullptr);
+  for (int i = 0; i < keys.size() - 1; i++) {
+    ValuePtr<float>* val = nullptr;
+    TF_CHECK_OK(hashmap->Lookup(keys[i], &val));
+    for (auto value_ptr : {lookup_ptrs[i], val}) {
+      float* v = (float*)value_ptr->GetPtr() + 4;
+      ASSERT_EQ(value_ptr->GetStep(), keys[i]);
+      for (int j = 0; j < 62; j++) {
+        ASSERT_NEAR(v[j], (keys[i] % 1000) * 0.01 - j * 0.1,
+                    emb_tolerance);
+      }
+      for (int j = 62; j < 124; j++) {
+        if (slot_dropped) {
+          ASSERT_EQ(v[j], 0);
+        } else {
+          ASSERT_NEAR(v[j], (keys[i] % 1000) * 0.01 - j * 0.1,
+                      emb_tolerance);
+        }
+      }
+      int8 meta = *((int8*)value_ptr->GetPtr() + 6);
+      ASSERT_EQ((meta & 2) == 0, slot_dropped);
+      hashmap->FreeValuePtr(value_ptr);
+    }
+  }
+  for (auto value_ptr : value_ptrs) {
+    delete value_ptr;
+  }
+  delete hashmap;
+}
+
+TEST(KVInterfaceTest, TestSSDKVFp16Codec) {
+  setenv("TF_SSDHASH_CODEC", "fp16", 1);
+  setenv("TF_SSDHASH_SLOT_CODEC", "fp16", 1);
+  TestSSDKVCodec(0.01, false);
+  unsetenv("TF_SSDHASH_CODEC");
+  unsetenv("TF_SSDHASH_SLOT_CODEC");
+}
+
+TEST(KVInterfaceTest, TestSSDKVInt8Codec) {
+  setenv("TF_SSDHASH_CODEC", "int8", 1);
+  setenv("TF_SSDHASH_SLOT_CODEC", "drop", 1);
+  // Half of the quantization step of the rows, at most 9.99 / 127 / 2.
+  TestSSDKVCodec(0.05, true);
+  unsetenv("TF_SSDHASH_CODEC");
+  unsetenv("TF_SSDHASH_SLOT_CODEC");
+}
+
+TEST(KVInterfaceTest, TestSSDKVSlotTtl) {
+  setenv("TF_SSDHASH_SLOT_TTL_STEPS", "1000", 1);
+  std::string temp_dir = testing::TmpDir();
+  auto hashmap = new SSDHashKV<int64, float>(
+      temp_dir, cpu_allocator());
+  hashmap->SetEmbeddingDims(62);
+  hashmap->SetTotalDims(124);
+  unsetenv("TF_SSDHASH_SLOT_TTL_STEPS");
+  for (int64 i = 0; i < 3; i++) {
+    ValuePtr<float>* tmp =
+      new NormalContiguousValuePtr<float>(cpu_allocator(), 124);
+    tmp->SetValue(1.0, 124);
+    tmp->SetStep(i * 1000);
+    // Marks the slot initialized.
+    *((int8*)tmp->GetPtr() + 6) |= 2;
+    TF_CHECK_OK(hashmap->Commit(i, tmp));
+    delete tmp;
+  }
+  // The slot of the record more than 1000 steps older than the latest one
+  // is dropped.
+  for (int64 i = 0; i < 3; i++) {
+    ValuePtr<float>* val = nullptr;
+    TF_CHECK_OK(hashmap->Lookup(i, &val));
+    float* v = (float*)val->GetPtr() + 4;
+    ASSERT_EQ(v[0], 1.0);
+    ASSERT_EQ(v[62], (i == 0) ? 0.0 : 1.0);
+    hashmap->FreeValuePtr(val);
+  }
+  delete hashmap;
+}
+
 void InsertKey(EmbeddingVar<int64, float>* variable, int value_size) {
   float *val = (float *)malloc((value_size+1)*sizeof(float));
   for (int64 i = 0; i < 100000000; i++) {
@@ -1819,6 +2941,505 @@ TEST(EmbeddingVariableTest, TestLookupRemoveConcurrency) {
    }
  }
 
+TEST(EmbeddingVariableTest, TestHotRowCache) {
+  auto cache = new HotRowCache<int64, float>(2);
+  std::vector<int64> keys = {1, 2, 3, 4};
+  std::vector<float> values = {1, 1, 2, 2, 3, 3, 4, 4};
+  std::vector<int64> freqs = {5, 50, 1, 20};
+  // Keeps the 2 most frequent keys with freq >= 2.
+  cache->Refresh(keys.data(), values.data(), freqs.data(), 4,
+                 /*max_rows = */2, /*min_freq = */2, /*step = */10);
+  std::vector<float> out(8);
+  bool hits[4];
+  ASSERT_TRUE(cache->Lookup(keys.data(), 4, 12, 5, out.data(), hits));
+  ASSERT_FALSE(hits[0]);
+  ASSERT_TRUE(hits[1]);
+  ASSERT_FALSE(hits[2]);
+  ASSERT_TRUE(hits[3]);
+  ASSERT_EQ(out[2], 2);
+  ASSERT_EQ(out[6], 4);
+  ASSERT_EQ(out[0], 0);
+  // Stale 5 steps after the refresh.
+  ASSERT_FALSE(cache->Lookup(keys.data(), 4, 15, 5, out.data(), hits));
+  ASSERT_FALSE(hits[1]);
+
+  std::vector<int64> flush_keys;
+  std::vector<float> flush_grads;
+  std::vector<float> grads = {1, 2, 3, 4};
+  cache->Accumulate(keys.data() + 1, grads.data(), 2, 10, 3,
+                    &flush_keys, &flush_grads);
+  cache->Accumulate(keys.data() + 1, grads.data(), 2, 12, 3,
+                    &flush_keys, &flush_grads);
+  ASSERT_TRUE(flush_keys.empty());
+  cache->Accumulate(keys.data() + 1, grads.data(), 1, 13, 3,
+                    &flush_keys, &flush_grads);
+  ASSERT_EQ(flush_keys.size(), 2);
+  ASSERT_EQ(flush_keys[0], 2);
+  ASSERT_EQ(flush_grads[0], 3);
+  ASSERT_EQ(flush_grads[1], 6);
+  ASSERT_EQ(flush_keys[1], 3);
+  ASSERT_EQ(flush_grads[2], 6);
+  ASSERT_EQ(flush_grads[3], 8);
+  cache->Unref();
+}
+
+TEST(EmbeddingVariableTest, TestWorkerEmbeddingCache) {
+  auto cache = new WorkerEmbeddingCache<int64, float>(2);
+  std::vector<int64> keys = {1, 2};
+  std::vector<float> out(4);
+  bool hits[2];
+  std::vector<int64> miss_keys;
+  std::vector<int64> miss_versions;
+  cache->Lookup(keys.data(), 2, 2, out.data(), hits,
+                &miss_keys, &miss_versions);
+  ASSERT_FALSE(hits[0]);
+  ASSERT_FALSE(hits[1]);
+  ASSERT_EQ(miss_versions[0], (WorkerEmbeddingCache<int64, float>::kNoVersion));
+  bool modified[2] = {true, true};
+  std::vector<float> modified_values = {1, 1, 2, 2};
+  std::vector<int64> versions = {5, 6};
+  cache->Merge(2, hits, miss_keys.data(), modified, modified_values.data(),
+               versions.data(), /*capacity = */2, 2, out.data());
+  ASSERT_EQ(out[2], 2);
+
+  // Fetched 1 step ago.
+  miss_keys.clear();
+  miss_versions.clear();
+  cache->Lookup(keys.data(), 2, 2, out.data(), hits,
+                &miss_keys, &miss_versions);
+  ASSERT_TRUE(hits[0]);
+  ASSERT_TRUE(hits[1]);
+  ASSERT_TRUE(miss_keys.empty());
+  ASSERT_EQ(out[0], 1);
+
+  // Expired, only the row of key 2 is modified on the PS.
+  cache->Lookup(keys.data(), 2, 2, out.data(), hits,
+                &miss_keys, &miss_versions);
+  ASSERT_FALSE(hits[0]);
+  ASSERT_EQ(miss_keys.size(), 2);
+  ASSERT_EQ(miss_versions[0], 5);
+  ASSERT_EQ(miss_versions[1], 6);
+  modified[0] = false;
+  modified_values = {3, 3};
+  versions = {5, 7};
+  cache->Merge(2, hits, miss_keys.data(), modified, modified_values.data(),
+               versions.data(), 2, 2, out.data());
+  ASSERT_EQ(out[0], 1);
+  ASSERT_EQ(out[2], 3);
+
+  // The cache is full of fresh rows, key 3 is not cached.
+  std::vector<int64> new_keys = {3};
+  miss_keys.clear();
+  miss_versions.clear();
+  cache->Lookup(new_keys.data(), 1, 2, out.data(), hits,
+                &miss_keys, &miss_versions);
+  modified[0] = true;
+  modified_values = {4, 4};
+  cache->Merge(1, hits, miss_keys.data(), modified, modified_values.data(),
+               versions.data(), 2, 2, out.data());
+  ASSERT_EQ(out[0], 4);
+  ASSERT_EQ(cache->Size(), 2);
+  cache->Unref();
+}
+
+TEST(EmbeddingVariableTest, TestWorkerEmbeddingCacheSnapshot) {
+  const string path = io::JoinPath(testing::TmpDir(), "worker_cache");
+  Env::Default()->DeleteFile(path).IgnoreError();
+  auto cache = new WorkerEmbeddingCache<int64, float>(2);
+  TF_ASSERT_OK(cache->SetSnapshot(Env::Default(), path, 1));
+  std::vector<int64> keys = {1, 2};
+  std::vector<float> out(4);
+  bool hits[2];
+  std::vector<int64> miss_keys;
+  std::vector<int64> miss_versions;
+  cache->Lookup(keys.data(), 2, 4, out.data(), hits,
+                &miss_keys, &miss_versions);
+  bool modified[2] = {true, true};
+  std::vector<float> modified_values = {1, 1, 2, 2};
+  std::vector<int64> versions = {5, 6};
+  cache->Merge(2, hits, miss_keys.data(), modified, modified_values.data(),
+               versions.data(), 0, 4, out.data());
+  TF_ASSERT_OK(cache->MaybeSnapshot());
+  cache->Unref();
+
+  // The restarted cache revalidates the loaded rows by their versions.
+  auto restarted = new WorkerEmbeddingCache<int64, float>(2);
+  TF_ASSERT_OK(restarted->SetSnapshot(Env::Default(), path, 1));
+  ASSERT_EQ(restarted->Size(), 2);
+  miss_keys.clear();
+  miss_versions.clear();
+  restarted->Lookup(keys.data(), 2, 4, out.data(), hits,
+                    &miss_keys, &miss_versions);
+  ASSERT_FALSE(hits[0]);
+  ASSERT_FALSE(hits[1]);
+  ASSERT_EQ(miss_versions[0], 5);
+  ASSERT_EQ(miss_versions[1], 6);
+  ASSERT_EQ(out[2], 2);
+  restarted->Unref();
+
+  // A snapshot of rows of another length is rejected.
+  auto other = new WorkerEmbeddingCache<int64, float>(3);
+  ASSERT_FALSE(other->SetSnapshot(Env::Default(), path, 1).ok());
+  ASSERT_EQ(other->Size(), 0);
+  other->Unref();
+}
+
+TEST(EmbeddingVariableTest, TestHostSharedEmbeddingCache) {
+  const std::string name =
+      HostSharedEmbeddingCache<int64, float>::SharedMemoryName(
+          strings::StrCat("test", getpid()), "var");
+  auto writer = new WorkerEmbeddingCache<int64, float>(2);
+  auto reader = new WorkerEmbeddingCache<int64, float>(2);
+  writer->SetHostCache(std::unique_ptr<HostSharedEmbeddingCache<int64, float>>(
+      new HostSharedEmbeddingCache<int64, float>(name, 2, 16, true,
+                                                 60 * 1000000LL)));
+  reader->SetHostCache(std::unique_ptr<HostSharedEmbeddingCache<int64, float>>(
+      new HostSharedEmbeddingCache<int64, float>(name, 2, 16, false,
+                                                 60 * 1000000LL)));
+  std::vector<int64> keys = {1, 2};
+  std::vector<float> out(4);
+  bool hits[2];
+  std::vector<int64> miss_keys;
+  std::vector<int64> miss_versions;
+  writer->Lookup(keys.data(), 1, 2, out.data(), hits,
+                 &miss_keys, &miss_versions);
+  ASSERT_FALSE(hits[0]);
+  bool modified[1] = {true};
+  std::vector<float> modified_values = {1, 1};
+  std::vector<int64> versions = {5};
+  writer->Merge(1, hits, miss_keys.data(), modified, modified_values.data(),
+                versions.data(), 0, 2, out.data());
+
+  // The reader takes the row of key 1 from the writer, key 2 misses.
+  miss_keys.clear();
+  miss_versions.clear();
+  reader->Lookup(keys.data(), 2, 2, out.data(), hits,
+                 &miss_keys, &miss_versions);
+  ASSERT_TRUE(hits[0]);
+  ASSERT_EQ(out[0], 1);
+  ASSERT_FALSE(hits[1]);
+  ASSERT_EQ(miss_keys.size(), 1);
+  ASSERT_EQ(miss_keys[0], 2);
+
+  // The writer is the only one to publish.
+  bool reader_modified[1] = {true};
+  modified_values = {2, 2};
+  versions = {6};
+  reader->Merge(2, hits, miss_keys.data(), reader_modified,
+                modified_values.data(), versions.data(), 0, 2, out.data());
+  ASSERT_EQ(out[2], 2);
+  float row[2];
+  int64 version;
+  HostSharedEmbeddingCache<int64, float> other(name, 2, 16, false,
+                                               60 * 1000000LL);
+  other.MaybeAttach();
+  ASSERT_TRUE(other.Lookup(1, row, &version));
+  ASSERT_EQ(version, 5);
+  ASSERT_FALSE(other.Lookup(2, row, &version));
+  reader->Unref();
+  writer->Unref();
+}
+
+TEST(EmbeddingVariableTest, TestEVStreamingSave) {
+  int64 value_size = 8;
+  Tensor value(DT_FLOAT, TensorShape({value_size}));
+  test::FillValues<float>(&value, std::vector<float>(value_size, 9.0));
+  auto storage = embedding::StorageFactory::Create<int64, float>(
+      embedding::StorageConfig(), cpu_allocator(), "EmbeddingVar");
+  auto variable = new EmbeddingVar<int64, float>("EmbeddingVar",
+      storage, EmbeddingConfig(0, 0, 1, 1, "", 5),
+      cpu_allocator());
+  variable->Init(value, 1);
+  for (int64 i = 0; i < 30000; i += 7) {
+    ValuePtr<float>* value_ptr = nullptr;
+    variable->LookupOrCreateKey(i, &value_ptr);
+    typename TTypes<float>::Flat vflat = variable->flat(value_ptr, i);
+    vflat(i % value_size) = i;
+  }
+
+  Tensor part_offset_tensor(DT_INT32, TensorShape({kSavedPartitionNum + 1}));
+  for (auto streaming : {"false", "true"}) {
+    setenv("TF_EV_STREAMING_SAVE", streaming, 1);
+    BundleWriter writer(Env::Default(), Prefix(streaming));
+    TF_ASSERT_OK(DumpEmbeddingValues(variable, "var/part_0", &writer,
+                                     &part_offset_tensor));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  unsetenv("TF_EV_STREAMING_SAVE");
+
+  BundleReader reader(Env::Default(), Prefix("false"));
+  BundleReader streaming_reader(Env::Default(), Prefix("true"));
+  TF_ASSERT_OK(reader.status());
+  TF_ASSERT_OK(streaming_reader.status());
+  auto keys = AllTensorKeys(&reader);
+  EXPECT_EQ(keys, AllTensorKeys(&streaming_reader));
+  for (auto& key : keys) {
+    DataType dtype;
+    TensorShape shape;
+    TF_ASSERT_OK(reader.LookupDtypeAndShape(key, &dtype, &shape));
+    Tensor val(dtype, shape);
+    Tensor streaming_val(dtype, shape);
+    TF_ASSERT_OK(reader.Lookup(key, &val));
+    TF_ASSERT_OK(streaming_reader.Lookup(key, &streaming_val));
+    EXPECT_EQ(val.tensor_data(), streaming_val.tensor_data()) << key;
+  }
+  variable->Unref();
+}
+
+TEST(EmbeddingVariableTest, TestEVParallelRestore) {
+  int64 value_size = 8;
+  Tensor value(DT_FLOAT, TensorShape({value_size}));
+  test::FillValues<float>(&value, std::vector<float>(value_size, 9.0));
+  auto storage = embedding::StorageFactory::Create<int64, float>(
+      embedding::StorageConfig(), cpu_allocator(), "EmbeddingVar");
+  auto variable = new EmbeddingVar<int64, float>("EmbeddingVar",
+      storage, EmbeddingConfig(0, 0, 1, 1, "", 5),
+      cpu_allocator());
+  variable->Init(value, 1);
+  for (int64 i = 0; i < 30000; i += 7) {
+    ValuePtr<float>* value_ptr = nullptr;
+    variable->LookupOrCreateKey(i, &value_ptr);
+    typename TTypes<float>::Flat vflat = variable->flat(value_ptr, i);
+    vflat(i % value_size) = i;
+  }
+  Tensor part_offset_tensor(DT_INT32, TensorShape({kSavedPartitionNum + 1}));
+  BundleWriter writer(Env::Default(), Prefix("parallel_restore"));
+  TF_ASSERT_OK(DumpEmbeddingValues(variable, "var/part_0", &writer,
+                                   &part_offset_tensor));
+  TF_ASSERT_OK(writer.Finish());
+
+  setenv("TF_EV_PARALLEL_RESTORE", "true", 1);
+  auto restore_storage = embedding::StorageFactory::Create<int64, float>(
+      embedding::StorageConfig(), cpu_allocator(), "EmbeddingVar");
+  auto restore_variable = new EmbeddingVar<int64, float>("EmbeddingVar",
+      restore_storage, EmbeddingConfig(0, 0, 1, 1, "", 5),
+      cpu_allocator());
+  restore_variable->Init(value, 1);
+  BundleReader reader(Env::Default(), Prefix("parallel_restore"));
+  TF_ASSERT_OK(reader.status());
+  TF_ASSERT_OK(EVRestoreDynamically(
+      restore_variable, "var/part_0", 0, 1, nullptr, &reader,
+      "-partition_offset", "-keys", "-values", "-versions", "-freqs"));
+  unsetenv("TF_EV_PARALLEL_RESTORE");
+
+  ASSERT_EQ(restore_variable->Size(), variable->Size());
+  for (int64 i = 0; i < 30000; i += 7) {
+    ValuePtr<float>* value_ptr = nullptr;
+    restore_variable->LookupOrCreateKey(i, &value_ptr);
+    typename TTypes<float>::Flat vflat =
+        restore_variable->flat(value_ptr, i);
+    ASSERT_EQ(vflat(i % value_size), i);
+    ASSERT_EQ(vflat((i + 1) % value_size), 9.0);
+  }
+  variable->Unref();
+  restore_variable->Unref();
+}
+
+TEST(EmbeddingVariableTest, TestEVTailFolding) {
+  int64 value_size = 8;
+  Tensor value(DT_FLOAT, TensorShape({value_size}));
+  test::FillValues<float>(&value, std::vector<float>(value_size, 9.0));
+  EmbeddingConfig emb_config(0, 0, 1, 1, "", 0, 0, 999999, -1.0, "normal",
+                             0, -1.0, DT_UINT64, 4096, .0,
+                             /*record_freq=*/true);
+  auto storage = embedding::StorageFactory::Create<int64, float>(
+      embedding::StorageConfig(), cpu_allocator(), "EmbeddingVar");
+  auto variable = new EmbeddingVar<int64, float>("EmbeddingVar",
+      storage, emb_config, cpu_allocator());
+  variable->Init(value, 1);
+  // The even keys are seen 10 times, the odd keys once.
+  for (int64 i = 0; i < 100; ++i) {
+    ValuePtr<float>* value_ptr = nullptr;
+    variable->LookupOrCreateKey(i, &value_ptr);
+    value_ptr->SetFreq(i % 2 == 0 ? 10 : 1);
+    typename TTypes<float>::Flat vflat = variable->flat(value_ptr, i);
+    for (int64 j = 0; j < value_size; ++j) {
+      vflat(j) = i;
+    }
+  }
+  Tensor part_offset_tensor(DT_INT32, TensorShape({kSavedPartitionNum + 1}));
+  BundleWriter writer(Env::Default(), Prefix("tail_folding"));
+  TF_ASSERT_OK(DumpEmbeddingValues(variable, "var/part_0", &writer,
+                                   &part_offset_tensor));
+  TF_ASSERT_OK(writer.Finish());
+
+  setenv("TF_EV_TAIL_FOLD_MIN_FREQ", "5", 1);
+  setenv("TF_EV_TAIL_FOLD_BUCKETS", "1", 1);
+  auto restore_storage = embedding::StorageFactory::Create<int64, float>(
+      embedding::StorageConfig(), cpu_allocator(), "EmbeddingVar");
+  auto restore_variable = new EmbeddingVar<int64, float>("EmbeddingVar",
+      restore_storage, emb_config, cpu_allocator());
+  restore_variable->Init(value, 1);
+  unsetenv("TF_EV_TAIL_FOLD_MIN_FREQ");
+  unsetenv("TF_EV_TAIL_FOLD_BUCKETS");
+  ASSERT_TRUE(restore_variable->IsTailFolding());
+  BundleReader reader(Env::Default(), Prefix("tail_folding"));
+  TF_ASSERT_OK(reader.status());
+  TF_ASSERT_OK(EVRestoreDynamically(
+      restore_variable, "var/part_0", 0, 1, nullptr, &reader,
+      "-partition_offset", "-keys", "-values", "-versions", "-freqs"));
+  restore_variable->ReportTailFolding();
+
+  ASSERT_EQ(restore_variable->Size(), 50);
+  for (int64 i = 0; i < 100; i += 2) {
+    ValuePtr<float>* value_ptr = nullptr;
+    restore_variable->LookupOrCreateKey(i, &value_ptr);
+    typename TTypes<float>::Flat vflat =
+        restore_variable->flat(value_ptr, i);
+    ASSERT_EQ(vflat(0), i);
+  }
+  // The odd keys are folded into the only row, their mean.
+  const float* tail_row = restore_variable->TailRow(1);
+  ASSERT_NE(tail_row, nullptr);
+  for (int64 j = 0; j < value_size; ++j) {
+    EXPECT_NEAR(tail_row[j], 50.0, 1e-4);
+  }
+  variable->Unref();
+  restore_variable->Unref();
+}
+
+TEST(EmbeddingVariableTest, TestEVMmapKV) {
+  int64 value_size = 8;
+  Tensor value(DT_FLOAT, TensorShape({value_size}));
+  test::FillValues<float>(&value, std::vector<float>(value_size, 9.0));
+  auto storage = embedding::StorageFactory::Create<int64, float>(
+      embedding::StorageConfig(), cpu_allocator(), "EmbeddingVar");
+  auto variable = new EmbeddingVar<int64, float>("EmbeddingVar",
+      storage, EmbeddingConfig(0, 0, 1, 1, "", 5),
+      cpu_allocator());
+  variable->Init(value, 1);
+  for (int64 i = 0; i < 10000; i += 3) {
+    ValuePtr<float>* value_ptr = nullptr;
+    variable->LookupOrCreateKey(i, &value_ptr);
+    typename TTypes<float>::Flat vflat = variable->flat(value_ptr, i);
+    vflat(i % value_size) = i;
+  }
+  setenv("TF_EV_SAVE_MMAP_KV", "true", 1);
+  Tensor part_offset_tensor(DT_INT32, TensorShape({kSavedPartitionNum + 1}));
+  BundleWriter writer(Env::Default(), Prefix("mmap_kv"));
+  TF_ASSERT_OK(DumpEmbeddingValues(variable, "var/part_0", &writer,
+                                   &part_offset_tensor, Prefix("mmap_kv")));
+  TF_ASSERT_OK(writer.Finish());
+  unsetenv("TF_EV_SAVE_MMAP_KV");
+
+  const std::string path = Prefix("mmap_kv") + "-var_part_0-mmap_kv";
+  embedding::MmapKV<int64, float> mmap_kv;
+  TF_ASSERT_OK(mmap_kv.Open(path, value_size));
+  ASSERT_EQ(mmap_kv.Size(), variable->Size());
+  for (int64 i = 0; i < 10000; i++) {
+    const float* row = mmap_kv.FindRow(i);
+    if (i % 3 != 0) {
+      ASSERT_EQ(row, nullptr);
+      continue;
+    }
+    ASSERT_NE(row, nullptr);
+    ASSERT_EQ(row[i % value_size], i);
+    ASSERT_EQ(row[(i + 1) % value_size], 9.0);
+  }
+  ASSERT_EQ(mmap_kv.FindRow(-1), nullptr);
+  ASSERT_EQ(mmap_kv.FindRow(10000), nullptr);
+  ASSERT_FALSE(mmap_kv.Remove(0).ok());
+
+  auto serve_storage = embedding::StorageFactory::Create<int64, float>(
+      embedding::StorageConfig(), cpu_allocator(), "EmbeddingVar");
+  auto serve_variable = new EmbeddingVar<int64, float>("EmbeddingVar",
+      serve_storage, EmbeddingConfig(0, 0, 1, 1, "", 5),
+      cpu_allocator());
+  serve_variable->Init(value, 1);
+  ASSERT_FALSE(serve_variable->ServeFromMmapKV(path + "_missing").ok());
+  TF_ASSERT_OK(serve_variable->ServeFromMmapKV(path));
+  ASSERT_TRUE(serve_variable->IsServedFromMmapKV());
+  ASSERT_EQ(serve_variable->Size(), variable->Size());
+  variable->Unref();
+  serve_variable->Unref();
+}
+
+TEST(EmbeddingVariableTest, TestFreqSampler) {
+  FreqSampler exact(0);
+  ASSERT_FALSE(exact.enabled());
+  ASSERT_EQ(exact.Sample(1000000, 3), 3);
+
+  FreqSampler sampler(10);
+  ASSERT_TRUE(sampler.enabled());
+  const int64 num_lookups = 100000;
+  int64 freq = 0;
+  int64 num_writes = 0;
+  for (int64 i = 0; i < num_lookups; ++i) {
+    const int64 count = sampler.Sample(freq, 1);
+    if (count > 0) {
+      freq += count;
+      ++num_writes;
+    }
+    // The counts below (100 / 10)^2 are exact.
+    if (i < 100) {
+      ASSERT_EQ(freq, i + 1);
+    }
+  }
+  ASSERT_NEAR(freq, num_lookups, num_lookups * 0.4);
+  ASSERT_LT(num_writes, num_lookups / 20);
+}
+
+TEST(EmbeddingVariableTest, TestVersionSlack) {
+  int64 value_size = 4;
+  Tensor value(DT_FLOAT, TensorShape({value_size}));
+  test::FillValues<float>(&value, std::vector<float>(value_size, 9.0));
+  setenv("TF_EV_VERSION_SLACK_STEPS", "2", 1);
+  EmbeddingConfig emb_config = EmbeddingConfig(0, 0, 1, 1, "", 5);
+  auto storage = embedding::StorageFactory::Create<int64, float>(
+      embedding::StorageConfig(
+          StorageType::DRAM, "", {1024, 1024, 1024, 1024}, "normal",
+          emb_config),
+      cpu_allocator(), "EmbeddingVar");
+  auto variable = new EmbeddingVar<int64, float>("EmbeddingVar",
+      storage, emb_config, cpu_allocator());
+  unsetenv("TF_EV_VERSION_SLACK_STEPS");
+  variable->Init(value, 1);
+
+  ValuePtr<float>* value_ptr = nullptr;
+  TF_ASSERT_OK(variable->LookupOrCreateKey(1, &value_ptr));
+  variable->UpdateVersion(value_ptr, 10);
+  ASSERT_EQ(value_ptr->GetStep(), 10);
+  // Within the slack, the version is not written.
+  variable->UpdateVersion(value_ptr, 12);
+  ASSERT_EQ(value_ptr->GetStep(), 10);
+  variable->UpdateVersion(value_ptr, 13);
+  ASSERT_EQ(value_ptr->GetStep(), 13);
+  // An older step, e.g. after a restore, is always written.
+  variable->UpdateVersion(value_ptr, 3);
+  ASSERT_EQ(value_ptr->GetStep(), 3);
+  variable->Unref();
+}
+
+
+template <class Impl>
+void CheckValuePtrAccess(Impl* value_ptr, bool has_version) {
+  typedef ValuePtrAccess<float, Impl> Access;
+  typedef ValuePtrAccess<float, ValuePtr<float>> AnyAccess;
+  std::vector<float> default_v(4, 2.0);
+  ASSERT_EQ(Access::GetValue(value_ptr, 0, 0), nullptr);
+  float* row = Access::GetOrAllocate(value_ptr, cpu_allocator(), 4,
+                                     default_v.data(), 0, 0);
+  ASSERT_EQ(row[3], 2.0);
+  ASSERT_EQ(Access::GetValue(value_ptr, 0, 0), row);
+  ASSERT_EQ(AnyAccess::GetValue(value_ptr, 0, 0), row);
+  if (has_version) {
+    Access::SetStep(value_ptr, 7);
+    Access::AddFreq(value_ptr, 3);
+    ASSERT_EQ(AnyAccess::GetStep(value_ptr), 7);
+    ASSERT_EQ(AnyAccess::GetFreq(value_ptr), 3);
+    ASSERT_EQ(Access::GetFreq(value_ptr), 3);
+  }
+  value_ptr->Destroy(cpu_allocator());
+  delete value_ptr;
+}
+
+TEST(EmbeddingVariableTest, TestValuePtrAccess) {
+  CheckValuePtrAccess(new LightValuePtr<float>(cpu_allocator(), 1), false);
+  CheckValuePtrAccess(new NormalValuePtr<float>(cpu_allocator(), 1), true);
+  CheckValuePtrAccess(
+      new NormalContiguousValuePtr<float>(cpu_allocator(), 4), true);
+}
+
 } // namespace
 } // namespace embedding
 } // namespace tensorflow
@@ -0,0 +1,220 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#include "tensorflow/core/kernels/ev_columnar_checkpoint.h"
+
+#include "zstd.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/raw_coding.h"
+
+namespace tensorflow {
+
+namespace {
+
+uint64 ZigZag(int64 v) {
+  return (static_cast<uint64>(v) << 1) ^ static_cast<uint64>(v >> 63);
+}
+
+int64 UnZigZag(uint64 v) {
+  return static_cast<int64>(v >> 1) ^ -static_cast<int64>(v & 1);
+}
+
+} // namespace
+
+void EVColumnarPutKeys(const int64* keys, int64 n, string* dst) {
+  if (n == 0) {
+    return;
+  }
+  core::PutFixed64(dst, static_cast<uint64>(keys[0]));
+  // The keys are sorted, the deltas are computed modulo 2^64 so that they
+  // don't overflow between keys of opposite signs.
+  uint64 max_delta = 0;
+  for (int64 i = 1; i < n; i++) {
+    max_delta = std::max(max_delta,
+        static_cast<uint64>(keys[i]) - static_cast<uint64>(keys[i - 1]));
+  }
+  int width = 0;
+  while (width < 64 && (max_delta >> width) != 0) {
+    width++;
+  }
+  dst->push_back(static_cast<char>(width));
+  const size_t start = dst->size();
+  dst->resize(start + ((n - 1) * width + 7) / 8, '\0');
+  unsigned char* out = reinterpret_cast<unsigned char*>(&(*dst)[start]);
+  uint64 bit = 0;
+  for (int64 i = 1; i < n; i++) {
+    uint64 delta =
+        static_cast<uint64>(keys[i]) - static_cast<uint64>(keys[i - 1]);
+    for (int b = 0; b < width; b++, bit++) {
+      if ((delta >> b) & 1) {
+        out[bit / 8] |= 1 << (bit % 8);
+      }
+    }
+  }
+}
+
+bool EVColumnarGetKeys(StringPiece* src, int64 n, int64* keys) {
+  if (n == 0) {
+    return true;
+  }
+  if (src->size() < sizeof(uint64) + 1) {
+    return false;
+  }
+  keys[0] = static_cast<int64>(core::DecodeFixed64(src->data()));
+  const int width = static_cast<unsigned char>((*src)[sizeof(uint64)]);
+  const size_t packed_bytes = ((n - 1) * width + 7) / 8;
+  if (width > 64 || src->size() < sizeof(uint64) + 1 + packed_bytes) {
+    return false;
+  }
+  const unsigned char* in =
+      reinterpret_cast<const unsigned char*>(src->data()) + sizeof(uint64) + 1;
+  uint64 bit = 0;
+  for (int64 i = 1; i < n; i++) {
+    uint64 delta = 0;
+    for (int b = 0; b < width; b++, bit++) {
+      if ((in[bit / 8] >> (bit % 8)) & 1) {
+        delta |= static_cast<uint64>(1) << b;
+      }
+    }
+    keys[i] = static_cast<int64>(static_cast<uint64>(keys[i - 1]) + delta);
+  }
+  src->remove_prefix(sizeof(uint64) + 1 + packed_bytes);
+  return true;
+}
+
+void EVColumnarPutVarints(const int64* values, int64 n, string* dst) {
+  for (int64 i = 0; i < n; i++) {
+    core::PutVarint64(dst, ZigZag(values[i]));
+  }
+}
+
+bool EVColumnarGetVarints(StringPiece* src, int64 n, int64* values) {
+  for (int64 i = 0; i < n; i++) {
+    uint64 v;
+    if (!core::GetVarint64(src, &v)) {
+      return false;
+    }
+    values[i] = UnZigZag(v);
+  }
+  return true;
+}
+
+Status EVColumnarCompress(StringPiece raw, int level, string* dst) {
+  const size_t bound = ZSTD_compressBound(raw.size());
+  dst->resize(sizeof(uint64) + bound);
+  core::EncodeFixed64(&(*dst)[0], raw.size());
+  size_t bytes = ZSTD_compress(&(*dst)[sizeof(uint64)], bound, raw.data(),
+                               raw.size(), level);
+  if (ZSTD_isError(bytes)) {
+    return errors::Internal("zstd compression failed: ",
+                            ZSTD_getErrorName(bytes));
+  }
+  dst->resize(sizeof(uint64) + bytes);
+  return Status::OK();
+}
+
+Status EVColumnarUncompress(StringPiece src, string* raw) {
+  if (src.size() < sizeof(uint64)) {
+    return errors::DataLoss("Truncated block in a columnar checkpoint");
+  }
+  raw->resize(core::DecodeFixed64(src.data()));
+  size_t bytes = ZSTD_decompress(&(*raw)[0], raw->size(),
+                                 src.data() + sizeof(uint64),
+                                 src.size() - sizeof(uint64));
+  if (ZSTD_isError(bytes) || bytes != raw->size()) {
+    return errors::DataLoss("Corrupted block in a columnar checkpoint");
+  }
+  return Status::OK();
+}
+
+Status EVColumnarWriter::Open(Env* env, const string& path) {
+  return env->NewWritableFile(path, &file_);
+}
+
+Status EVColumnarWriter::AddBlock(StringPiece block, int64 num_rows,
+                                  int64 bucket) {
+  TF_RETURN_IF_ERROR(file_->Append(block));
+  index_.push_back(
+      {offset_, static_cast<int64>(block.size()), num_rows, bucket});
+  offset_ += block.size();
+  num_rows_ += num_rows;
+  return Status::OK();
+}
+
+Status EVColumnarWriter::Finish(int64 value_len, int64 num_buckets,
+                                int32 key_bytes, bool value_fp16) {
+  EVColumnarFooter footer;
+  memset(&footer, 0, sizeof(footer));
+  footer.magic = kEVColumnarMagic;
+  footer.num_rows = num_rows_;
+  footer.num_blocks = index_.size();
+  footer.index_offset = offset_;
+  footer.value_len = value_len;
+  footer.num_buckets = num_buckets;
+  footer.key_bytes = key_bytes;
+  footer.value_fp16 = value_fp16;
+  TF_RETURN_IF_ERROR(file_->Append(StringPiece(
+      reinterpret_cast<const char*>(index_.data()),
+      index_.size() * sizeof(EVColumnarBlockIndex))));
+  TF_RETURN_IF_ERROR(file_->Append(StringPiece(
+      reinterpret_cast<const char*>(&footer), sizeof(footer))));
+  return file_->Close();
+}
+
+Status EVColumnarReader::Open(Env* env, const string& path) {
+  uint64 file_size;
+  TF_RETURN_IF_ERROR(env->GetFileSize(path, &file_size));
+  if (file_size < sizeof(EVColumnarFooter)) {
+    return errors::DataLoss("Truncated columnar checkpoint ", path);
+  }
+  TF_RETURN_IF_ERROR(env->NewRandomAccessFile(path, &file_));
+  StringPiece result;
+  TF_RETURN_IF_ERROR(file_->Read(file_size - sizeof(EVColumnarFooter),
+      sizeof(EVColumnarFooter), &result,
+      reinterpret_cast<char*>(&footer_)));
+  if (result.data() != reinterpret_cast<char*>(&footer_)) {
+    memcpy(&footer_, result.data(), sizeof(footer_));
+  }
+  const uint64 index_bytes =
+      footer_.num_blocks * sizeof(EVColumnarBlockIndex);
+  if (footer_.magic != kEVColumnarMagic ||
+      footer_.index_offset + index_bytes + sizeof(EVColumnarFooter) !=
+          file_size) {
+    return errors::DataLoss("Not a columnar checkpoint: ", path);
+  }
+  index_.resize(footer_.num_blocks);
+  if (index_bytes > 0) {
+    char* scratch = reinterpret_cast<char*>(index_.data());
+    TF_RETURN_IF_ERROR(file_->Read(footer_.index_offset, index_bytes,
+                                   &result, scratch));
+    if (result.data() != scratch) {
+      memcpy(scratch, result.data(), index_bytes);
+    }
+  }
+  return Status::OK();
+}
+
+Status EVColumnarReader::ReadBlock(int64 i, string* raw,
+                                   int64* num_rows) const {
+  const EVColumnarBlockIndex& block = index_[i];
+  string compressed(block.bytes, '\0');
+  StringPiece result;
+  TF_RETURN_IF_ERROR(file_->Read(block.offset, block.bytes, &result,
+                                 &compressed[0]));
+  *num_rows = block.num_rows;
+  return EVColumnarUncompress(result, raw);
+}
+
+} // tensorflow
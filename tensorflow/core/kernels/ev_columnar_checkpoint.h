@@ -0,0 +1,284 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_EV_COLUMNAR_CHECKPOINT_H_
+#define TENSORFLOW_CORE_KERNELS_EV_COLUMNAR_CHECKPOINT_H_
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/embedding/filter_policy.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// The layout of the columnar checkpoint files of the EmbeddingVariables,
+// written instead of the rows of the "-keys", "-values", "-versions" and
+// "-freqs" tensors with TF_EV_COLUMNAR_SAVE:
+//  * the blocks of at most block_rows rows of one bucket key % num_buckets
+//    of the saved partitions, in the order of the buckets and then of the
+//    keys, each compressed with zstd on its own, so they are decoded in
+//    parallel and a restore only reads the blocks of its buckets:
+//      - the first key, and the deltas of the next keys bit packed with the
+//        width of the largest delta of the block,
+//      - the rows, in float16 with value_fp16 or with their own type,
+//      - the versions and the freqs, zigzag varints.
+//  * num_blocks EVColumnarBlockIndex, with the bucket of every block.
+//  * EVColumnarFooter.
+struct EVColumnarFooter {
+  uint64 magic;
+  int64 num_rows;
+  int64 num_blocks;
+  int64 index_offset;
+  int64 value_len;
+  int64 num_buckets;
+  int32 key_bytes;
+  int32 value_fp16;
+};
+
+struct EVColumnarBlockIndex {
+  int64 offset;
+  int64 bytes;
+  int64 num_rows;
+  int64 bucket;
+};
+
+const uint64 kEVColumnarMagic = 0x31524c4f43564545ULL;
+
+// Appends the keys, sorted, as the first key and the bit packed deltas.
+void EVColumnarPutKeys(const int64* keys, int64 n, string* dst);
+bool EVColumnarGetKeys(StringPiece* src, int64 n, int64* keys);
+
+// Appends the values as zigzag varints.
+void EVColumnarPutVarints(const int64* values, int64 n, string* dst);
+bool EVColumnarGetVarints(StringPiece* src, int64 n, int64* values);
+
+Status EVColumnarCompress(StringPiece raw, int level, string* dst);
+Status EVColumnarUncompress(StringPiece src, string* raw);
+
+// Appends the compressed blocks of a file and then its index and footer.
+class EVColumnarWriter {
+ public:
+  Status Open(Env* env, const string& path);
+  Status AddBlock(StringPiece block, int64 num_rows, int64 bucket);
+  Status Finish(int64 value_len, int64 num_buckets, int32 key_bytes,
+                bool value_fp16);
+
+ private:
+  std::unique_ptr<WritableFile> file_;
+  std::vector<EVColumnarBlockIndex> index_;
+  int64 offset_ = 0;
+  int64 num_rows_ = 0;
+};
+
+// Reads the blocks of a file, ReadBlock can be called concurrently.
+class EVColumnarReader {
+ public:
+  Status Open(Env* env, const string& path);
+  const EVColumnarFooter& footer() const { return footer_; }
+  int64 NumBlocks() const { return index_.size(); }
+  int64 BlockBucket(int64 i) const { return index_[i].bucket; }
+  // Reads and uncompresses block i.
+  Status ReadBlock(int64 i, string* raw, int64* num_rows) const;
+
+ private:
+  std::unique_ptr<RandomAccessFile> file_;
+  EVColumnarFooter footer_;
+  std::vector<EVColumnarBlockIndex> index_;
+};
+
+// The rows are stored in float16 only with value_fp16 and for the value
+// types wider than 2 bytes.
+template <class V>
+bool EVColumnarUseFp16(bool value_fp16) {
+  return value_fp16 && sizeof(V) > 2;
+}
+
+// Encodes rows [start, end) of order into a compressed block.
+template <class K, class V>
+Status EncodeEVColumnarBlock(const std::vector<int64>& order,
+    int64 start, int64 end, const std::vector<K>& keys,
+    const std::vector<V*>& rows, const std::vector<int64>& versions,
+    const std::vector<int64>& freqs, int64 value_len, bool value_fp16,
+    int level, string* block) {
+  const int64 n = end - start;
+  std::vector<int64> column(n);
+  string raw;
+  for (int64 i = 0; i < n; i++) {
+    column[i] = static_cast<int64>(keys[order[start + i]]);
+  }
+  EVColumnarPutKeys(column.data(), n, &raw);
+  for (int64 i = 0; i < n; i++) {
+    const V* row = rows[order[start + i]];
+    if (value_fp16) {
+      for (int64 j = 0; j < value_len; j++) {
+        Eigen::half h(static_cast<float>(row[j]));
+        raw.append(reinterpret_cast<const char*>(&h), sizeof(h));
+      }
+    } else {
+      raw.append(reinterpret_cast<const char*>(row), value_len * sizeof(V));
+    }
+  }
+  // Versions and freqs not recorded are saved as -1 and 0, like the
+  // restore of the tensors fills them.
+  for (int64 i = 0; i < n; i++) {
+    int64 idx = order[start + i];
+    column[i] = idx < versions.size() ? versions[idx] : -1;
+  }
+  EVColumnarPutVarints(column.data(), n, &raw);
+  for (int64 i = 0; i < n; i++) {
+    int64 idx = order[start + i];
+    column[i] = idx < freqs.size() ? freqs[idx] : 0;
+  }
+  EVColumnarPutVarints(column.data(), n, &raw);
+  return EVColumnarCompress(raw, level, block);
+}
+
+// Writes the rows to a columnar file at path, the blocks of a wave are
+// encoded in parallel on pool while the previous wave is written.
+template <class K, class V>
+Status WriteEVColumnarFile(Env* env, const string& path,
+    const std::vector<K>& keys, const std::vector<V*>& rows,
+    const std::vector<int64>& versions, const std::vector<int64>& freqs,
+    int64 value_len, bool value_fp16, int64 num_buckets, int64 block_rows,
+    int level, thread::ThreadPool* pool) {
+  value_fp16 = EVColumnarUseFp16<V>(value_fp16);
+  const int64 n = keys.size();
+  std::vector<int64> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&keys, num_buckets](int64 a, int64 b) {
+    const int64 bucket_a = keys[a] % num_buckets;
+    const int64 bucket_b = keys[b] % num_buckets;
+    return bucket_a != bucket_b ? bucket_a < bucket_b : keys[a] < keys[b];
+  });
+  // The start rows of the blocks, and n.
+  std::vector<int64> starts;
+  for (int64 i = 0; i < n; i++) {
+    if (starts.empty() || i - starts.back() == block_rows ||
+        keys[order[i]] % num_buckets != keys[order[i - 1]] % num_buckets) {
+      starts.emplace_back(i);
+    }
+  }
+  const int64 num_blocks = starts.size();
+  starts.emplace_back(n);
+
+  EVColumnarWriter writer;
+  TF_RETURN_IF_ERROR(writer.Open(env, path));
+  const int64 wave = 2 * pool->NumThreads();
+  for (int64 first = 0; first < num_blocks; first += wave) {
+    const int64 last = std::min(num_blocks, first + wave);
+    std::vector<string> blocks(last - first);
+    std::vector<Status> statuses(last - first);
+    pool->ParallelFor(last - first, /*cost_per_unit=*/1 << 20,
+        [&](int64 begin, int64 limit) {
+      for (int64 b = begin; b < limit; b++) {
+        statuses[b] = EncodeEVColumnarBlock(order, starts[first + b],
+            starts[first + b + 1], keys, rows, versions, freqs,
+            value_len, value_fp16, level, &blocks[b]);
+      }
+    });
+    for (int64 b = 0; b < last - first; b++) {
+      TF_RETURN_IF_ERROR(statuses[b]);
+      const int64 start = starts[first + b];
+      TF_RETURN_IF_ERROR(writer.AddBlock(blocks[b],
+          starts[first + b + 1] - start,
+          keys[order[start]] % num_buckets));
+    }
+  }
+  return writer.Finish(value_len, num_buckets, sizeof(K), value_fp16);
+}
+
+// Decodes the rows of the keys kept by keep of an uncompressed block into
+// buff, as the RestoreBuffer of num_kept rows read from the tensors.
+template <class K, class V>
+Status DecodeEVColumnarBlock(const EVColumnarFooter& footer,
+    StringPiece raw, int64 num_rows, const std::function<bool(K)>& keep,
+    RestoreBuffer* buff, int64* num_kept) {
+  if (footer.key_bytes != sizeof(K)) {
+    return errors::InvalidArgument("The columnar checkpoint has keys of ",
+                                   footer.key_bytes, " bytes instead of ",
+                                   sizeof(K));
+  }
+  const int64 value_len = footer.value_len;
+  std::vector<int64> keys(num_rows);
+  std::vector<int64> versions(num_rows);
+  std::vector<int64> freqs(num_rows);
+  if (!EVColumnarGetKeys(&raw, num_rows, keys.data())) {
+    return errors::DataLoss("Corrupted keys in a columnar checkpoint");
+  }
+  const size_t value_bytes = footer.value_fp16 ? sizeof(Eigen::half)
+                                               : sizeof(V);
+  StringPiece values(raw.data(), num_rows * value_len * value_bytes);
+  if (raw.size() < values.size()) {
+    return errors::DataLoss("Corrupted rows in a columnar checkpoint");
+  }
+  raw.remove_prefix(values.size());
+  if (!EVColumnarGetVarints(&raw, num_rows, versions.data()) ||
+      !EVColumnarGetVarints(&raw, num_rows, freqs.data())) {
+    return errors::DataLoss("Corrupted versions or freqs in a columnar "
+                            "checkpoint");
+  }
+
+  std::vector<int64> kept;
+  kept.reserve(num_rows);
+  for (int64 i = 0; i < num_rows; i++) {
+    if (keep(static_cast<K>(keys[i]))) {
+      kept.emplace_back(i);
+    }
+  }
+  const int64 m = kept.size();
+  buff->key_buffer = new char[std::max<int64>(m, 1) * sizeof(K)];
+  buff->value_buffer = new char[std::max<int64>(m * value_len, 1) * sizeof(V)];
+  buff->version_buffer = new char[std::max<int64>(m, 1) * sizeof(int64)];
+  buff->freq_buffer = new char[std::max<int64>(m, 1) * sizeof(int64)];
+  K* key_out = reinterpret_cast<K*>(buff->key_buffer);
+  V* value_out = reinterpret_cast<V*>(buff->value_buffer);
+  int64* version_out = reinterpret_cast<int64*>(buff->version_buffer);
+  int64* freq_out = reinterpret_cast<int64*>(buff->freq_buffer);
+  for (int64 i = 0; i < m; i++) {
+    const int64 r = kept[i];
+    key_out[i] = static_cast<K>(keys[r]);
+    version_out[i] = versions[r];
+    freq_out[i] = freqs[r];
+    const char* row = values.data() + r * value_len * value_bytes;
+    if (footer.value_fp16) {
+      const Eigen::half* half_row = reinterpret_cast<const Eigen::half*>(row);
+      for (int64 j = 0; j < value_len; j++) {
+        value_out[i * value_len + j] =
+            static_cast<V>(static_cast<float>(half_row[j]));
+      }
+    } else {
+      memcpy(value_out + i * value_len, row, value_len * sizeof(V));
+    }
+  }
+  *num_kept = m;
+  return Status::OK();
+}
+
+} // tensorflow
+
+#endif // TENSORFLOW_CORE_KERNELS_EV_COLUMNAR_CHECKPOINT_H_
@@ -0,0 +1,142 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#include "tensorflow/core/kernels/ev_columnar_checkpoint.h"
+
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(EVColumnarCheckpointTest, KeysRoundTrip) {
+  std::vector<int64> keys = {kint64min, -5, -1, 0, 3, 4, 1000000,
+                             kint64max};
+  string buf;
+  EVColumnarPutKeys(keys.data(), keys.size(), &buf);
+  StringPiece src(buf);
+  std::vector<int64> decoded(keys.size());
+  ASSERT_TRUE(EVColumnarGetKeys(&src, keys.size(), decoded.data()));
+  EXPECT_EQ(keys, decoded);
+  EXPECT_TRUE(src.empty());
+
+  // Dense keys are packed with one bit per delta.
+  std::vector<int64> dense(1024);
+  std::iota(dense.begin(), dense.end(), 100);
+  buf.clear();
+  EVColumnarPutKeys(dense.data(), dense.size(), &buf);
+  EXPECT_EQ(sizeof(uint64) + 1 + (dense.size() - 1 + 7) / 8, buf.size());
+}
+
+TEST(EVColumnarCheckpointTest, VarintsRoundTrip) {
+  std::vector<int64> values = {-1, 0, 1, 63, -64, kint64max, kint64min};
+  string buf;
+  EVColumnarPutVarints(values.data(), values.size(), &buf);
+  StringPiece src(buf);
+  std::vector<int64> decoded(values.size());
+  ASSERT_TRUE(EVColumnarGetVarints(&src, values.size(), decoded.data()));
+  EXPECT_EQ(values, decoded);
+  EXPECT_FALSE(EVColumnarGetVarints(&src, 1, decoded.data()));
+}
+
+void WriteAndRead(bool value_fp16, int64 num_buckets) {
+  const int64 n = 1000;
+  const int64 value_len = 4;
+  std::vector<int64> keys(n);
+  std::vector<float> values(n * value_len);
+  std::vector<float*> rows(n);
+  std::vector<int64> versions(n);
+  std::vector<int64> freqs(n);
+  for (int64 i = 0; i < n; i++) {
+    keys[i] = (n - i) * 7 - 300;
+    for (int64 j = 0; j < value_len; j++) {
+      values[i * value_len + j] = 0.25f * i + j;
+    }
+    rows[i] = &values[i * value_len];
+    versions[i] = i % 3 == 0 ? -1 : i;
+    freqs[i] = i * 2;
+  }
+  const string path = io::JoinPath(testing::TmpDir(),
+      strings::StrCat(value_fp16 ? "columnar_fp16_" : "columnar_raw_",
+                      num_buckets));
+  thread::ThreadPool pool(Env::Default(), "columnar_test", 4);
+  TF_ASSERT_OK(WriteEVColumnarFile(Env::Default(), path, keys, rows,
+      versions, freqs, value_len, value_fp16, num_buckets, /*block_rows=*/64,
+      /*level=*/3, &pool));
+
+  EVColumnarReader reader;
+  TF_ASSERT_OK(reader.Open(Env::Default(), path));
+  EXPECT_EQ(n, reader.footer().num_rows);
+  EXPECT_EQ(num_buckets, reader.footer().num_buckets);
+  if (num_buckets == 1) {
+    EXPECT_EQ((n + 63) / 64, reader.NumBlocks());
+  }
+  EXPECT_EQ(value_fp16, reader.footer().value_fp16 != 0);
+
+  std::function<bool(int64)> keep = [](int64 key) { return key % 2 == 0; };
+  int64 total = 0;
+  int64 prev_bucket = kint64min;
+  int64 prev_key = kint64min;
+  for (int64 b = 0; b < reader.NumBlocks(); b++) {
+    // The blocks are ordered by bucket, and then by key in a bucket.
+    const int64 bucket = reader.BlockBucket(b);
+    EXPECT_LE(prev_bucket, bucket);
+    if (bucket != prev_bucket) {
+      prev_key = kint64min;
+    }
+    prev_bucket = bucket;
+    string raw;
+    int64 num_rows = 0;
+    TF_ASSERT_OK(reader.ReadBlock(b, &raw, &num_rows));
+    RestoreBuffer buff;
+    int64 num_kept = 0;
+    TF_ASSERT_OK((DecodeEVColumnarBlock<int64, float>(reader.footer(), raw,
+        num_rows, keep, &buff, &num_kept)));
+    const int64* key_out = reinterpret_cast<int64*>(buff.key_buffer);
+    const float* value_out = reinterpret_cast<float*>(buff.value_buffer);
+    const int64* version_out = reinterpret_cast<int64*>(buff.version_buffer);
+    const int64* freq_out = reinterpret_cast<int64*>(buff.freq_buffer);
+    for (int64 k = 0; k < num_kept; k++) {
+      EXPECT_EQ(bucket, key_out[k] % num_buckets);
+      EXPECT_LT(prev_key, key_out[k]);
+      prev_key = key_out[k];
+      const int64 i = n - (key_out[k] + 300) / 7;
+      EXPECT_EQ(versions[i], version_out[k]);
+      EXPECT_EQ(freqs[i], freq_out[k]);
+      for (int64 j = 0; j < value_len; j++) {
+        EXPECT_NEAR(values[i * value_len + j], value_out[k * value_len + j],
+                    value_fp16 ? 0.25 : 0);
+      }
+    }
+    total += num_kept;
+  }
+  EXPECT_EQ(n / 2, total);
+}
+
+TEST(EVColumnarCheckpointTest, WriteAndReadRaw) {
+  WriteAndRead(false, 1);
+}
+
+TEST(EVColumnarCheckpointTest, WriteAndReadFp16) {
+  WriteAndRead(true, 1);
+}
+
+TEST(EVColumnarCheckpointTest, WriteAndReadBuckets) {
+  WriteAndRead(false, 10);
+}
+
+} // namespace
+} // tensorflow
@@ -0,0 +1,191 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+Status ValidateInputs(const Tensor& x0, const Tensor& xl, const Tensor& w) {
+  if (x0.dims() != 2 || x0.shape() != xl.shape()) {
+    return errors::InvalidArgument(
+        "x0 and xl must be matrices of the same shape, got ",
+        x0.shape().DebugString(), " and ", xl.shape().DebugString());
+  }
+  if (w.dims() != 1 || w.dim_size(0) != x0.dim_size(1)) {
+    return errors::InvalidArgument("w must be a vector of ", x0.dim_size(1),
+                                   " elements, got ",
+                                   w.shape().DebugString());
+  }
+  return Status::OK();
+}
+
+template <typename T>
+T Dot(const T* a, const T* b, int64 dim) {
+  T sum = 0;
+  for (int64 d = 0; d < dim; ++d) {
+    sum += a[d] * b[d];
+  }
+  return sum;
+}
+
+}  // namespace
+
+// Computes a DCN cross layer in one pass over the rows, instead of the
+// Mul, Sum, Mul, Add and Add of the unfused graph, each of which writes a
+// temporary of the batch.
+template <typename T>
+class FusedCrossLayerOp : public OpKernel {
+ public:
+  explicit FusedCrossLayerOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& x0_tensor = context->input(0);
+    const Tensor& xl_tensor = context->input(1);
+    const Tensor& w_tensor = context->input(2);
+    const Tensor& b_tensor = context->input(3);
+    OP_REQUIRES_OK(context, ValidateInputs(x0_tensor, xl_tensor, w_tensor));
+    OP_REQUIRES(context, b_tensor.shape() == w_tensor.shape(),
+                errors::InvalidArgument("b must have the shape of w, got ",
+                                        b_tensor.shape().DebugString()));
+
+    const int64 rows = x0_tensor.dim_size(0);
+    const int64 dim = x0_tensor.dim_size(1);
+    Tensor* y_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, x0_tensor.shape(), &y_tensor));
+
+    const T* x0 = x0_tensor.flat<T>().data();
+    const T* xl = xl_tensor.flat<T>().data();
+    const T* w = w_tensor.flat<T>().data();
+    const T* b = b_tensor.flat<T>().data();
+    T* y = y_tensor->flat<T>().data();
+
+    auto compute = [&](int64 begin, int64 end) {
+      for (int64 n = begin; n < end; ++n) {
+        const T* x0_row = x0 + n * dim;
+        const T* xl_row = xl + n * dim;
+        T* y_row = y + n * dim;
+        const T xw = Dot(xl_row, w, dim);
+        for (int64 d = 0; d < dim; ++d) {
+          y_row[d] = x0_row[d] * xw + b[d] + xl_row[d];
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, rows, 6 * dim,
+          compute);
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("FusedCrossLayer")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<float>("T"),
+                        FusedCrossLayerOp<float>);
+
+template <typename T>
+class FusedCrossLayerGradOp : public OpKernel {
+ public:
+  explicit FusedCrossLayerGradOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  // With xw = xl w and s = sum(dy * x0) per row:
+  //   dx0 = dy * xw
+  //   dxl = dy + s * w
+  //   dw = sum_rows(s * xl)
+  //   db = sum_rows(dy)
+  void Compute(OpKernelContext* context) override {
+    const Tensor& grad_tensor = context->input(0);
+    const Tensor& x0_tensor = context->input(1);
+    const Tensor& xl_tensor = context->input(2);
+    const Tensor& w_tensor = context->input(3);
+    OP_REQUIRES_OK(context, ValidateInputs(x0_tensor, xl_tensor, w_tensor));
+    OP_REQUIRES(context, grad_tensor.shape() == x0_tensor.shape(),
+                errors::InvalidArgument("Mismatched shape of y_grad ",
+                                        grad_tensor.shape().DebugString()));
+
+    const int64 rows = x0_tensor.dim_size(0);
+    const int64 dim = x0_tensor.dim_size(1);
+    Tensor* x0_grad_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, x0_tensor.shape(),
+                                                     &x0_grad_tensor));
+    Tensor* xl_grad_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(1, xl_tensor.shape(),
+                                                     &xl_grad_tensor));
+    Tensor* w_grad_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(2, w_tensor.shape(),
+                                                     &w_grad_tensor));
+    Tensor* b_grad_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(3, w_tensor.shape(),
+                                                     &b_grad_tensor));
+
+    const T* grad = grad_tensor.flat<T>().data();
+    const T* x0 = x0_tensor.flat<T>().data();
+    const T* xl = xl_tensor.flat<T>().data();
+    const T* w = w_tensor.flat<T>().data();
+    T* x0_grad = x0_grad_tensor->flat<T>().data();
+    T* xl_grad = xl_grad_tensor->flat<T>().data();
+    T* w_grad = w_grad_tensor->flat<T>().data();
+    T* b_grad = b_grad_tensor->flat<T>().data();
+    std::fill(w_grad, w_grad + dim, static_cast<T>(0));
+    std::fill(b_grad, b_grad + dim, static_cast<T>(0));
+    if (rows == 0) {
+      return;
+    }
+
+    // One unit is a block of rows, which sums its share of w_grad and
+    // b_grad in a buffer of its own, added up once all the units are done.
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    const int64 num_units =
+        std::min(rows, static_cast<int64>(worker_threads->num_threads));
+    const int64 rows_per_unit = (rows + num_units - 1) / num_units;
+    std::vector<T> unit_grads(num_units * 2 * dim, static_cast<T>(0));
+
+    auto compute = [&](int64 begin_unit, int64 end_unit) {
+      for (int64 unit = begin_unit; unit < end_unit; ++unit) {
+        T* unit_w_grad = unit_grads.data() + unit * 2 * dim;
+        T* unit_b_grad = unit_w_grad + dim;
+        const int64 end = std::min(rows, (unit + 1) * rows_per_unit);
+        for (int64 n = unit * rows_per_unit; n < end; ++n) {
+          const T* dy = grad + n * dim;
+          const T* x0_row = x0 + n * dim;
+          const T* xl_row = xl + n * dim;
+          T* dx0 = x0_grad + n * dim;
+          T* dxl = xl_grad + n * dim;
+          const T xw = Dot(xl_row, w, dim);
+          const T s = Dot(dy, x0_row, dim);
+          for (int64 d = 0; d < dim; ++d) {
+            dx0[d] = dy[d] * xw;
+            dxl[d] = dy[d] + s * w[d];
+            unit_w_grad[d] += s * xl_row[d];
+            unit_b_grad[d] += dy[d];
+          }
+        }
+      }
+    };
+    Shard(worker_threads->num_threads, worker_threads->workers, num_units,
+          rows_per_unit * dim * 10, compute);
+
+    for (int64 unit = 0; unit < num_units; ++unit) {
+      const T* unit_w_grad = unit_grads.data() + unit * 2 * dim;
+      const T* unit_b_grad = unit_w_grad + dim;
+      for (int64 d = 0; d < dim; ++d) {
+        w_grad[d] += unit_w_grad[d];
+        b_grad[d] += unit_b_grad[d];
+      }
+    }
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("FusedCrossLayerGrad")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<float>("T"),
+                        FusedCrossLayerGradOp<float>);
+
+}  // namespace tensorflow
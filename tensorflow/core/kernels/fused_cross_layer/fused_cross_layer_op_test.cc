@@ -0,0 +1,73 @@
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class FusedCrossLayerOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op) {
+    TF_EXPECT_OK(NodeDefBuilder("fused_cross_layer", op)
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+};
+
+TEST_F(FusedCrossLayerOpTest, Forward) {
+  MakeOp("FusedCrossLayer");
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});   // x0
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 1, 2, -1});  // xl
+  AddInputFromArray<float>(TensorShape({2}), {1, 2});            // w
+  AddInputFromArray<float>(TensorShape({2}), {0.5, -0.5});       // b
+  TF_ASSERT_OK(RunOpKernel());
+
+  // xw = [3, 0]
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected, {4.5, 6.5, 2.5, -1.5});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(FusedCrossLayerOpTest, Grad) {
+  MakeOp("FusedCrossLayerGrad");
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 0, 0, 1});   // y_grad
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});   // x0
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 1, 2, -1});  // xl
+  AddInputFromArray<float>(TensorShape({2}), {1, 2});            // w
+  TF_ASSERT_OK(RunOpKernel());
+
+  // xw = [3, 0], s = [1, 4]
+  Tensor expected_x0(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected_x0, {3, 0, 0, 0});
+  test::ExpectTensorNear<float>(expected_x0, *GetOutput(0), 1e-5);
+  Tensor expected_xl(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected_xl, {2, 2, 4, 9});
+  test::ExpectTensorNear<float>(expected_xl, *GetOutput(1), 1e-5);
+  Tensor expected_w(allocator(), DT_FLOAT, TensorShape({2}));
+  test::FillValues<float>(&expected_w, {9, -3});
+  test::ExpectTensorNear<float>(expected_w, *GetOutput(2), 1e-5);
+  Tensor expected_b(allocator(), DT_FLOAT, TensorShape({2}));
+  test::FillValues<float>(&expected_b, {1, 1});
+  test::ExpectTensorNear<float>(expected_b, *GetOutput(3), 1e-5);
+}
+
+TEST_F(FusedCrossLayerOpTest, MismatchedShapes) {
+  MakeOp("FusedCrossLayer");
+  AddInputFromArray<float>(TensorShape({1, 2}), {1, 2});
+  AddInputFromArray<float>(TensorShape({1, 2}), {1, 2});
+  AddInputFromArray<float>(TensorShape({3}), {1, 2, 3});
+  AddInputFromArray<float>(TensorShape({3}), {1, 2, 3});
+  EXPECT_FALSE(RunOpKernel().ok());
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -142,6 +142,7 @@ class FusedEmbeddingSparsePreLookUpGPU : public OpKernel {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("partition_axis", &partition_axis_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("fill_empty_row", &fill_empty_row_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("prune_invalid_id", &prune_invalid_id_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("sort_values", &sort_values_));
     int temp_default_id;
     OP_REQUIRES_OK(ctx, ctx->GetAttr("default_id", &temp_default_id));
     default_id_ = int64_t(temp_default_id);
@@ -185,7 +186,7 @@ class FusedEmbeddingSparsePreLookUpGPU : public OpKernel {
     size_t max_cub_bytes = 0;
     size_t temp_storage_bytes = 0;
 
-    if (num_partitions_ > 1) {
+    if (num_partitions_ > 1 || sort_values_) {
       cub::DeviceRadixSort::SortPairs(
           (void*)nullptr, temp_storage_bytes, (int64_t*)nullptr,
           (int64_t*)nullptr, (IndicePair*)nullptr, (IndicePair*)nullptr,
@@ -366,12 +367,24 @@ class FusedEmbeddingSparsePreLookUpGPU : public OpKernel {
           partitioned_indices.allocate(
               0, TensorShape({static_cast<int64_t>(new_nnz), 2}), &pi_out));
 
-      cudaMemcpyAsync(pv_out->flat<int64>().data(), values_in,
-                      sizeof(int64_t) * new_nnz, cudaMemcpyDeviceToDevice,
-                      stream);
-      cudaMemcpyAsync(pi_out->flat<int64>().data(), indices_in,
-                      sizeof(IndicePair) * new_nnz, cudaMemcpyDeviceToDevice,
-                      stream);
+      if (sort_values_) {
+        // sort by value so that the gathers read the rows in order, as in
+        // the multi-partitions case
+        cub::DeviceRadixSort::SortPairs(
+            cub_temp_storage.flat<int8>().data(), max_cub_bytes, values_in,
+            reinterpret_cast<int64_t*>(pv_out->flat<int64>().data()),
+            indices_in,
+            reinterpret_cast<IndicePair*>(pi_out->flat<int64>().data()),
+            int(new_nnz), 0, sizeof(int64_t) * 8, stream);
+        CK_CUDA_THROW_(cudaGetLastError());
+      } else {
+        cudaMemcpyAsync(pv_out->flat<int64>().data(), values_in,
+                        sizeof(int64_t) * new_nnz, cudaMemcpyDeviceToDevice,
+                        stream);
+        cudaMemcpyAsync(pi_out->flat<int64>().data(), indices_in,
+                        sizeof(IndicePair) * new_nnz, cudaMemcpyDeviceToDevice,
+                        stream);
+      }
 
     } else {
       // multi-partitions case, calcaulate indices and split them.
@@ -506,6 +519,7 @@ class FusedEmbeddingSparsePreLookUpGPU : public OpKernel {
   int partition_axis_;
   bool fill_empty_row_;
   bool prune_invalid_id_;
+  bool sort_values_;
   int64_t default_id_;
   std::vector<int64_t> partition_sizes_accumulate_;
   std::vector<int64_t> elements_offset_per_partition_;
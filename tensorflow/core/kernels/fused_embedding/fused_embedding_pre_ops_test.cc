@@ -35,7 +35,8 @@ class FusedEmbeddingSparsePreLookUpOpTest : public OpsTestBase {
  protected:
   void MakeOpAndSetDevice(Device device, const int num_partitions,
                           const bool fill_empty_row,
-                          const bool prune_invalid_id, const int default_id) {
+                          const bool prune_invalid_id, const int default_id,
+                          const bool sort_values = false) {
     if (device == Device::GPU) {
       SetDevice(DEVICE_GPU,
                 std::unique_ptr<tensorflow::Device>(DeviceFactory::NewDevice(
@@ -49,6 +50,7 @@ class FusedEmbeddingSparsePreLookUpOpTest : public OpsTestBase {
                      .Attr("fill_empty_row", fill_empty_row)
                      .Attr("prune_invalid_id", prune_invalid_id)
                      .Attr("default_id", default_id)
+                     .Attr("sort_values", sort_values)
                      .Input(FakeInput(num_partitions, DT_INT64))
                      .Input(FakeInput(DT_INT64))
                      .Input(FakeInput(DT_INT64))
@@ -109,6 +111,29 @@ TEST_F(FusedEmbeddingSparsePreLookUpOpTest, Partition3_Int64) {
   }
 }
 
+TEST_F(FusedEmbeddingSparsePreLookUpOpTest, Partition1_Sort_Values) {
+  MakeOpAndSetDevice(Device::GPU, 1, false, false, -1, true);
+  // partition_shapes 0
+  AddInputFromArray<int64>(TensorShape({2}), {8, 4});
+  // sp_values
+  AddInputFromArray<int64>(TensorShape({4}), {5, 1, 5, 0});
+  // sp_indices
+  AddInputFromArray<int64>(TensorShape({4, 2}), {0, 0, 0, 1, 1, 0, 2, 0});
+  // sp_dense_shape
+  AddInputFromArray<int64>(TensorShape({2}), {3, 4});
+
+  TF_ASSERT_OK(RunOpKernel());
+  TF_EXPECT_OK(device_->Sync());
+
+  Tensor expected_values(allocator(), DT_INT64, TensorShape({4}));
+  test::FillValues<int64>(&expected_values, {0, 1, 5, 5});
+  test::ExpectTensorEqual<int64>(expected_values, *GetOutput(0));
+
+  Tensor expected_indices(allocator(), DT_INT64, TensorShape({4, 2}));
+  test::FillValues<int64>(&expected_indices, {2, 0, 0, 1, 0, 0, 1, 0});
+  test::ExpectTensorEqual<int64>(expected_indices, *GetOutput(1));
+}
+
 TEST_F(FusedEmbeddingSparsePreLookUpOpTest, Partition2_Fill_Empty) {
   MakeOpAndSetDevice(Device::GPU, 2, true, false, -1);
   // partition_shapes 0
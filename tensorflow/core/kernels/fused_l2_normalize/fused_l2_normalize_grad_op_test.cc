@@ -120,6 +120,8 @@ BM_FusedL2NormGrad_NTH(1024, 127);
 BM_FusedL2NormGrad_NTH(1024, 255);
 BM_FusedL2NormGrad_NTH(1024, 511);
 BM_FusedL2NormGrad_NTH(1024, 1023);
+BM_FusedL2NormGrad_NTH(16384, 64);
+BM_FusedL2NormGrad_NTH(16384, 128);
 
 }
 }
@@ -72,6 +72,10 @@ public:
           if (end_row > rows) {
             end_row = rows;
           }
+          // Normalize 4 rows at a time to interleave their reductions
+          for (; begin_row + 3 < end_row; begin_row += 4) {
+            forward_rows_avx512<4>(input, output, begin_row, cols);
+          }
           forward_avx512<8>(input, output, begin_row, end_row, cols, block_num, remainder_block_num,
                                remainder_block_num_total, remainder_128, remainder_16);
         });
@@ -189,6 +193,61 @@ private:
     }
   }
 
+  // Compute the rows locate in the range of [start_row, start_row + ROWS)
+  template <int ROWS>
+  void forward_rows_avx512(const T* input, T* output, int64 start_row,
+                           int64 cols) {
+    const int64 remainder_16 = cols & 0x0F;
+    const __mmask16 mask = 0xFFFF >> (16 - remainder_16);
+    __m512 vsum[ROWS];
+
+    // Sum of squares of the inputs
+    auto setzero = [&](auto idx) { vsum[idx] = _mm512_setzero_ps(); };
+    functor::compile_time_for<ROWS>::op(setzero);
+    int64 j = 0;
+    for (; j + 15 < cols; j += 16) {
+      auto sum = [&](auto idx) {
+        __m512 vx = _mm512_loadu_ps(input + (start_row + idx) * cols + j);
+        vsum[idx] = _mm512_fmadd_ps(vx, vx, vsum[idx]);
+      };
+      functor::compile_time_for<ROWS>::op(sum);
+    }
+    if (remainder_16) {
+      auto sum = [&](auto idx) {
+        __m512 vx =
+            _mm512_maskz_loadu_ps(mask, input + (start_row + idx) * cols + j);
+        vsum[idx] = _mm512_fmadd_ps(vx, vx, vsum[idx]);
+      };
+      functor::compile_time_for<ROWS>::op(sum);
+    }
+
+    // Square root
+    auto rsqrt = [&](auto idx) {
+      float row_sum = _mm512_reduce_add_ps(vsum[idx]) + epsilon;
+      vsum[idx] = _mm512_set1_ps(1.0 / std::sqrt(row_sum));
+    };
+    functor::compile_time_for<ROWS>::op(rsqrt);
+
+    // Mul & store
+    for (j = 0; j + 15 < cols; j += 16) {
+      auto mul = [&](auto idx) {
+        __m512 vx = _mm512_loadu_ps(input + (start_row + idx) * cols + j);
+        _mm512_storeu_ps(output + (start_row + idx) * cols + j,
+                         _mm512_mul_ps(vx, vsum[idx]));
+      };
+      functor::compile_time_for<ROWS>::op(mul);
+    }
+    if (remainder_16) {
+      auto mul = [&](auto idx) {
+        __m512 vx =
+            _mm512_maskz_loadu_ps(mask, input + (start_row + idx) * cols + j);
+        _mm512_mask_storeu_ps(output + (start_row + idx) * cols + j, mask,
+                              _mm512_mul_ps(vx, vsum[idx]));
+      };
+      functor::compile_time_for<ROWS>::op(mul);
+    }
+  }
+
   // data type: FP32, 16 FP32 per __m512
   //  v0: v0_0, v0_1, ..., v0_15
   //  v1: v1_0, v1_1, ..., v1_15
@@ -293,6 +352,9 @@ public:
           if (end_row > rows) {
             end_row = rows;
           }
+          for (; begin_row + 3 < end_row; begin_row += 4) {
+            backward_rows_avx512<4>(y_grad, x, x_grad, begin_row, cols);
+          }
           backward_avx512<8>(y_grad, x, x_grad, begin_row, end_row, cols, block_num, 
                                remainder_block_num, remainder_block_num_total, remainder_128, remainder_16);
         });
@@ -452,6 +514,78 @@ private:
     }
   }
 
+  // Compute the rows locate in the range of [start_row, start_row + ROWS)
+  template <int ROWS>
+  void backward_rows_avx512(const float* y_grad, const float* x,
+                            float* x_grad, int64 start_row, int64 cols) {
+    const int64 remainder_16 = cols & 0x0F;
+    const __mmask16 mask = 0xFFFF >> (16 - remainder_16);
+    __m512 vx_sum[ROWS], vy_grad_sum[ROWS];
+
+    // sum of squares of x and sum of y_grad * x
+    auto setzero = [&](auto idx) {
+      vx_sum[idx] = _mm512_setzero_ps();
+      vy_grad_sum[idx] = _mm512_setzero_ps();
+    };
+    functor::compile_time_for<ROWS>::op(setzero);
+    int64 j = 0;
+    for (; j + 15 < cols; j += 16) {
+      auto sum = [&](auto idx) {
+        __m512 vx = _mm512_loadu_ps(x + (start_row + idx) * cols + j);
+        __m512 vy_grad = _mm512_loadu_ps(y_grad + (start_row + idx) * cols + j);
+        vx_sum[idx] = _mm512_fmadd_ps(vx, vx, vx_sum[idx]);
+        vy_grad_sum[idx] = _mm512_fmadd_ps(vy_grad, vx, vy_grad_sum[idx]);
+      };
+      functor::compile_time_for<ROWS>::op(sum);
+    }
+    if (remainder_16) {
+      auto sum = [&](auto idx) {
+        __m512 vx =
+            _mm512_maskz_loadu_ps(mask, x + (start_row + idx) * cols + j);
+        __m512 vy_grad =
+            _mm512_maskz_loadu_ps(mask, y_grad + (start_row + idx) * cols + j);
+        vx_sum[idx] = _mm512_fmadd_ps(vx, vx, vx_sum[idx]);
+        vy_grad_sum[idx] = _mm512_fmadd_ps(vy_grad, vx, vy_grad_sum[idx]);
+      };
+      functor::compile_time_for<ROWS>::op(sum);
+    }
+
+    auto rsqrt = [&](auto idx) {
+      float x_row_sum = _mm512_reduce_add_ps(vx_sum[idx]) + epsilon;
+      x_row_sum = 1.0 / std::sqrt(x_row_sum);  // rvar
+      float y_grad_row_sum = _mm512_reduce_add_ps(vy_grad_sum[idx]);
+      y_grad_row_sum = (y_grad_row_sum * x_row_sum) * (x_row_sum * x_row_sum);
+      vx_sum[idx] = _mm512_set1_ps(x_row_sum);
+      vy_grad_sum[idx] = _mm512_set1_ps(y_grad_row_sum);
+    };
+    functor::compile_time_for<ROWS>::op(rsqrt);
+
+    // Calculate x_grad = y_grad * rvar - x * ((sum * rvar) * (rvar * rvar))
+    for (j = 0; j + 15 < cols; j += 16) {
+      auto grad = [&](auto idx) {
+        __m512 vx = _mm512_loadu_ps(x + (start_row + idx) * cols + j);
+        __m512 vy_grad = _mm512_loadu_ps(y_grad + (start_row + idx) * cols + j);
+        __m512 vx_grad = _mm512_fnmadd_ps(
+            vx, vy_grad_sum[idx], _mm512_mul_ps(vy_grad, vx_sum[idx]));
+        _mm512_storeu_ps(x_grad + (start_row + idx) * cols + j, vx_grad);
+      };
+      functor::compile_time_for<ROWS>::op(grad);
+    }
+    if (remainder_16) {
+      auto grad = [&](auto idx) {
+        __m512 vx =
+            _mm512_maskz_loadu_ps(mask, x + (start_row + idx) * cols + j);
+        __m512 vy_grad =
+            _mm512_maskz_loadu_ps(mask, y_grad + (start_row + idx) * cols + j);
+        __m512 vx_grad = _mm512_fnmadd_ps(
+            vx, vy_grad_sum[idx], _mm512_mul_ps(vy_grad, vx_sum[idx]));
+        _mm512_mask_storeu_ps(x_grad + (start_row + idx) * cols + j, mask,
+                              vx_grad);
+      };
+      functor::compile_time_for<ROWS>::op(grad);
+    }
+  }
+
   template <int BLOCK_NUM>
   inline __m512 reduce_sum_block(const __m512* v) {
     __m512 block_sum = _mm512_setzero_ps();
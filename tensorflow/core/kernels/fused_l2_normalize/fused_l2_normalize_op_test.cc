@@ -99,5 +99,7 @@ BM_FusedL2Norm_NTH(1024, 127);
 BM_FusedL2Norm_NTH(1024, 255);
 BM_FusedL2Norm_NTH(1024, 511);
 BM_FusedL2Norm_NTH(1024, 1023);
+BM_FusedL2Norm_NTH(16384, 64);
+BM_FusedL2Norm_NTH(16384, 128);
 }
 }
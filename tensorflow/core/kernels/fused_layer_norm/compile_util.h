@@ -6,14 +6,17 @@
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/shape_inference.h"
 #include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/kernels/cpu_isa_dispatch.h"
 #include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/macros.h"
 
 using namespace tensorflow;
-// A class for forced loop unrolling at compile time
+// A class for forced loop unrolling at compile time, always inlined so that
+// the lambdas of the AVX512 kernels are inlined in them.
 template <int i>
 struct compile_time_for {
   template <typename Lambda, typename... Args>
-  inline static void op(const Lambda& function, Args... args) {
+  TF_ATTRIBUTE_ALWAYS_INLINE static void op(const Lambda& function, Args... args) {
     compile_time_for<i - 1>::op(function, args...);
     function(std::integral_constant<int, i - 1>{}, args...);
   }
@@ -21,7 +24,7 @@ struct compile_time_for {
 template <>
 struct compile_time_for<1> {
   template <typename Lambda, typename... Args>
-  inline static void op(const Lambda& function, Args... args) {
+  TF_ATTRIBUTE_ALWAYS_INLINE static void op(const Lambda& function, Args... args) {
     function(std::integral_constant<int, 0>{}, args...);
   }
 };
@@ -29,9 +32,10 @@ template <>
 struct compile_time_for<0> {
   // 0 loops, do nothing
   template <typename Lambda, typename... Args>
-  inline static void op(const Lambda& function, Args... args) {}
+  TF_ATTRIBUTE_ALWAYS_INLINE static void op(const Lambda& function, Args... args) {}
 };
-#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
+#ifdef TF_CPU_ISA_AVX512
+TF_CPU_ISA_AVX512_BEGIN
 
 template <int BLOCK_NUM>
 inline __m512 reduce_sum_block(const __m512* v) {
@@ -73,5 +77,6 @@ static inline float horizontal_add(__m512 src) {
   return _mm_cvtss_f32(_mm_hadd_ps(r, r));
 }
 
-#endif  // #if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
+TF_CPU_ISA_END
+#endif  // TF_CPU_ISA_AVX512
 #endif  // TENSORFLOW_CORE_KERNELS_FUSED_LAYER_NORMALIZE_COMPILE_UTIL_OP_H_
@@ -2,6 +2,368 @@
 
 using namespace tensorflow;
 
+#ifdef TF_CPU_ISA_AVX512
+TF_CPU_ISA_AVX512_BEGIN
+namespace {
+
+// The AVX512 variants of the kernels, called when the CPU supports
+// AVX512 whatever the -march of the build.
+
+// AVX512 block size = 8; pack 8 * 16 = 128;
+inline void forward_avx512(const float* input, const float* gamma, const float* beta, float* output, 
+                            float* mean, float* rvariance, int64 cols, int64 begin_row, int64 end_row,
+                            int64 block_num, int64 remainder_block_num,int64 remainder_block_num_total, 
+                            int64 remainder_128, int64 remainder_16, const float one_over_cols,
+                           float epsilon) {
+  for (int64 i = begin_row; i < end_row; ++i) {
+    // Sum
+    for (int64 j = 0; j < block_num; ++j) {
+    __m512 inputs[8];
+    auto load = [&](auto idx) {
+        inputs[idx] = _mm512_loadu_ps(input + cols * i + 128 * j + 16 * idx);
+      };
+    compile_time_for<8>::op(load);
+    __m512 block_sum = reduce_sum_block<8>(inputs);
+    mean[i] += _mm512_reduce_add_ps(block_sum);
+    }
+    if (remainder_block_num_total) { // remainder sum
+      __m512 inputs[remainder_block_num_total];
+      for (int64 idx = 0; idx < remainder_block_num; idx++){
+        inputs[idx] = _mm512_loadu_ps(input + cols * i + cols - remainder_128 + 16 * idx);
+      }
+      if (remainder_16) {
+        __mmask16 mask = 0xFFFF >> (16 - remainder_16);
+        inputs[remainder_block_num] = _mm512_maskz_loadu_ps(
+            mask, input + cols * i + cols - remainder_16);
+      }
+      __m512 block_sum = reduce_sum_block_ps(inputs, remainder_block_num_total);
+      mean[i] += _mm512_reduce_add_ps(block_sum);
+    }
+
+    // Mean
+    mean[i] *= one_over_cols;
+    __m512 means = _mm512_set1_ps(mean[i]);
+
+    // Variance
+    for (int64 j = 0; j < block_num; ++j) {
+      __m512 inputs[8];
+      auto load_var = [&](auto idx) {
+        inputs[idx] = _mm512_loadu_ps(input + cols * i + 128 * j + 16 * idx);
+        inputs[idx] = _mm512_sub_ps(inputs[idx], means);
+        inputs[idx] = _mm512_mul_ps(inputs[idx], inputs[idx]);
+      };
+      compile_time_for<8>::op(load_var);
+      __m512 block_sum = reduce_sum_block<8>(inputs);
+      rvariance[i] += _mm512_reduce_add_ps(block_sum);
+    }
+    if (remainder_block_num_total) { // remainder var
+      __m512 inputs[remainder_block_num_total];
+      for (int64 idx = 0; idx < remainder_block_num; idx++){
+        inputs[idx] = _mm512_loadu_ps(input + cols * i + cols - remainder_128 + 16 * idx);
+        inputs[idx] = _mm512_sub_ps(inputs[idx], means);
+        inputs[idx] = _mm512_mul_ps(inputs[idx], inputs[idx]);
+      }
+      if (remainder_16) {
+        __mmask16 mask = 0xFFFF >> (16 - remainder_16);
+        inputs[remainder_block_num] = _mm512_maskz_loadu_ps(
+            mask, input + cols * i + cols - remainder_16);
+        inputs[remainder_block_num] = _mm512_maskz_sub_ps(mask, inputs[remainder_block_num], means);
+        inputs[remainder_block_num] = _mm512_maskz_mul_ps(mask, inputs[remainder_block_num], inputs[remainder_block_num]);
+      }
+      __m512 block_sum = reduce_sum_block_ps(inputs, remainder_block_num_total);
+      rvariance[i] += _mm512_reduce_add_ps(block_sum);
+    }
+
+    rvariance[i] *= one_over_cols;
+    rvariance[i] += epsilon;
+    rvariance[i] = 1.0f / sqrtf(rvariance[i]);
+    __m512 rvariances = _mm512_set1_ps(rvariance[i]);
+    // Normalize and store
+    for (int64 j = 0; j < block_num; ++j) {
+      __m512 inputs[8];
+      __m512 nums[8]; // used to load gammas and betas 
+      auto load_normalize = [&](auto idx) {
+        // (x - mean) / sqrt(var + eps)
+        inputs[idx] = _mm512_loadu_ps(input + cols * i + 128 * j + 16 * idx);
+        inputs[idx] = _mm512_sub_ps(inputs[idx], means);
+        inputs[idx] = _mm512_mul_ps(inputs[idx], rvariances);
+        // Mul gamma
+        nums[idx] = _mm512_loadu_ps(gamma + 128 * j + 16 * idx);
+        inputs[idx] = _mm512_mul_ps(inputs[idx], nums[idx]);
+        // Add beta
+        nums[idx] = _mm512_loadu_ps(beta + 128 * j + 16 * idx);
+        inputs[idx] = _mm512_add_ps(inputs[idx], nums[idx]);
+
+        // Store
+        _mm512_storeu_ps(output + cols * i + 128 * j + 16 * idx, inputs[idx]);
+      };
+      compile_time_for<8>::op(load_normalize);
+    }
+    if (remainder_block_num_total) { // remainder normalize and store
+      __m512 inputs;
+      __m512 nums; // used to load gammas and betas 
+      for (int64 idx = 0; idx < remainder_block_num; idx++){ // remainder of 128
+        // (x - mean) / sqrt(var + eps)
+        inputs = _mm512_loadu_ps(input + cols * i + cols - remainder_128 + 16 * idx);
+        inputs = _mm512_sub_ps(inputs, means);
+        inputs = _mm512_mul_ps(inputs, rvariances);
+        // Mul gamma
+        nums = _mm512_loadu_ps(gamma + cols - remainder_128 + 16 * idx);
+        inputs = _mm512_mul_ps(inputs, nums);
+        // Add beta
+        nums = _mm512_loadu_ps(beta + cols - remainder_128 + 16 * idx);
+        inputs = _mm512_add_ps(inputs, nums);
+
+        // Store
+        _mm512_storeu_ps(output + cols * i + cols - remainder_128 + 16 * idx, inputs);
+      }
+      if (remainder_16) { // remainder of 16
+        __mmask16 mask = 0xFFFF >> (16 - remainder_16);
+        // (x - mean) / sqrt(var + eps)
+        inputs = _mm512_maskz_loadu_ps(mask, input + cols * i + cols - remainder_16);
+        inputs = _mm512_maskz_sub_ps(mask, inputs, means);
+        inputs = _mm512_maskz_mul_ps(mask, inputs, rvariances);
+        // Mul gamma
+        nums = _mm512_maskz_loadu_ps(mask, gamma + cols - remainder_16);
+        inputs = _mm512_maskz_mul_ps(mask, inputs, nums);
+        // Add beta
+        nums = _mm512_maskz_loadu_ps(mask, beta + cols - remainder_16);
+        inputs = _mm512_maskz_add_ps(mask, inputs, nums);
+
+        // Store
+        _mm512_mask_storeu_ps(output + cols * i + cols - remainder_16, mask, inputs);
+      }
+    }
+  }
+}
+
+
+// Compute the rows locate in the range of [start_row, start_row + ROWS)
+template <int ROWS>
+inline void forward_rows_avx512(const float* input, const float* gamma,
+                                const float* beta, float* output,
+                                float* mean, float* rvariance, int64 cols,
+                                int64 start_row, const float one_over_cols,
+                                float epsilon) {
+  const int64 remainder_16 = cols & 0x0F;
+  const __mmask16 mask = 0xFFFF >> (16 - remainder_16);
+  __m512 vsum[ROWS], vmean[ROWS], vrvariance[ROWS];
+
+  // Sum
+  auto setzero = [&](auto idx) { vsum[idx] = _mm512_setzero_ps(); };
+  compile_time_for<ROWS>::op(setzero);
+  int64 j = 0;
+  for (; j + 15 < cols; j += 16) {
+    auto sum = [&](auto idx) {
+      __m512 vx = _mm512_loadu_ps(input + (start_row + idx) * cols + j);
+      vsum[idx] = _mm512_add_ps(vsum[idx], vx);
+    };
+    compile_time_for<ROWS>::op(sum);
+  }
+  if (remainder_16) {
+    auto sum = [&](auto idx) {
+      __m512 vx =
+          _mm512_maskz_loadu_ps(mask, input + (start_row + idx) * cols + j);
+      vsum[idx] = _mm512_add_ps(vsum[idx], vx);
+    };
+    compile_time_for<ROWS>::op(sum);
+  }
+
+  // Mean
+  auto get_mean = [&](auto idx) {
+    mean[start_row + idx] = horizontal_add(vsum[idx]) * one_over_cols;
+    vmean[idx] = _mm512_set1_ps(mean[start_row + idx]);
+    vsum[idx] = _mm512_setzero_ps();
+  };
+  compile_time_for<ROWS>::op(get_mean);
+
+  // Variance
+  for (j = 0; j + 15 < cols; j += 16) {
+    auto var = [&](auto idx) {
+      __m512 vx = _mm512_loadu_ps(input + (start_row + idx) * cols + j);
+      vx = _mm512_sub_ps(vx, vmean[idx]);
+      vsum[idx] = _mm512_fmadd_ps(vx, vx, vsum[idx]);
+    };
+    compile_time_for<ROWS>::op(var);
+  }
+  if (remainder_16) {
+    auto var = [&](auto idx) {
+      __m512 vx =
+          _mm512_maskz_loadu_ps(mask, input + (start_row + idx) * cols + j);
+      vx = _mm512_maskz_sub_ps(mask, vx, vmean[idx]);
+      vsum[idx] = _mm512_fmadd_ps(vx, vx, vsum[idx]);
+    };
+    compile_time_for<ROWS>::op(var);
+  }
+
+  auto get_rvariance = [&](auto idx) {
+    float var = horizontal_add(vsum[idx]) * one_over_cols + epsilon;
+    rvariance[start_row + idx] = 1.0f / sqrtf(var);
+    vrvariance[idx] = _mm512_set1_ps(rvariance[start_row + idx]);
+  };
+  compile_time_for<ROWS>::op(get_rvariance);
+
+  // Normalize and store
+  for (j = 0; j + 15 < cols; j += 16) {
+    __m512 vgamma = _mm512_loadu_ps(gamma + j);
+    __m512 vbeta = _mm512_loadu_ps(beta + j);
+    auto normalize = [&](auto idx) {
+      __m512 vx = _mm512_loadu_ps(input + (start_row + idx) * cols + j);
+      vx = _mm512_mul_ps(_mm512_sub_ps(vx, vmean[idx]), vrvariance[idx]);
+      vx = _mm512_fmadd_ps(vx, vgamma, vbeta);
+      _mm512_storeu_ps(output + (start_row + idx) * cols + j, vx);
+    };
+    compile_time_for<ROWS>::op(normalize);
+  }
+  if (remainder_16) {
+    __m512 vgamma = _mm512_maskz_loadu_ps(mask, gamma + j);
+    __m512 vbeta = _mm512_maskz_loadu_ps(mask, beta + j);
+    auto normalize = [&](auto idx) {
+      __m512 vx =
+          _mm512_maskz_loadu_ps(mask, input + (start_row + idx) * cols + j);
+      vx = _mm512_mul_ps(_mm512_sub_ps(vx, vmean[idx]), vrvariance[idx]);
+      vx = _mm512_fmadd_ps(vx, vgamma, vbeta);
+      _mm512_mask_storeu_ps(output + (start_row + idx) * cols + j, mask, vx);
+    };
+    compile_time_for<ROWS>::op(normalize);
+  }
+}
+
+template <int ROWS>
+inline void backward_rows_avx512(const float* y_grad, const float* x,
+                            const float* mean, const float* rvariance,
+                            const float* gamma, float* x_grad,
+                            float* gamma_grad, float* beta_grad, int64 cols,
+                            int64 start_row) {
+  float sum_m[ROWS], sum_r[ROWS];
+  __m512 vsum_m[ROWS], vsum_r[ROWS], vmean[ROWS], vrvariance[ROWS];
+
+  // Init
+  auto setzero = [&](auto idx) {
+    vsum_m[idx] = _mm512_setzero_ps();
+    vsum_r[idx] = _mm512_setzero_ps();
+    vmean[idx] = _mm512_set1_ps(mean[start_row + idx]);
+    vrvariance[idx] = _mm512_set1_ps(rvariance[start_row + idx]);
+  };
+  compile_time_for<ROWS>::op(setzero);
+
+  // Compute sum for y_grad * gamma and y_grad * gamma * (x - mean)
+  int64 j = 0;
+  for (; j + 15 < cols; j += 16) {
+    auto compute_sum = [&](auto idx) {
+      __m512 vy_grad = _mm512_loadu_ps(y_grad + (start_row + idx) * cols + j);
+      __m512 vgamma = _mm512_loadu_ps(gamma + j);
+
+      __m512 mul = _mm512_mul_ps(vy_grad, vgamma);
+      vsum_m[idx] = _mm512_add_ps(mul, vsum_m[idx]);
+
+      __m512 vx = _mm512_loadu_ps(x + (start_row + idx) * cols + j);
+      __m512 x_minus_mean = _mm512_sub_ps(vx, vmean[idx]);
+      vsum_r[idx] = _mm512_fmadd_ps(mul, x_minus_mean, vsum_r[idx]);
+    };
+
+    compile_time_for<ROWS>::op(compute_sum);
+  }
+
+  auto reduce_sum = [&](auto idx) {
+    sum_m[idx] = horizontal_add(vsum_m[idx]);
+    sum_r[idx] = horizontal_add(vsum_r[idx]);
+
+    for (int64 c = j; c < cols; ++c) {
+      const auto offset = (start_row + idx) * cols + c;
+      sum_m[idx] += y_grad[offset] * gamma[c];
+      sum_r[idx] +=
+          y_grad[offset] * gamma[c] * (x[offset] - mean[start_row + idx]);
+    }
+
+    sum_m[idx] /= cols;
+    sum_r[idx] *= rvariance[start_row + idx] * rvariance[start_row + idx];
+    sum_r[idx] /= cols;
+
+    vsum_m[idx] = _mm512_set1_ps(sum_m[idx]);
+    vsum_r[idx] = _mm512_set1_ps(sum_r[idx]);
+  };
+
+  compile_time_for<ROWS>::op(reduce_sum);
+
+  // Compute gradient for x, gamma, beta
+  for (j = 0; j + 15 < cols; j += 16) {
+    __m512 vgamma_grad = _mm512_loadu_ps(gamma_grad + j);
+    __m512 vbeta_grad = _mm512_loadu_ps(beta_grad + j);
+
+    auto compute_grad = [&](auto idx) {
+      __m512 vy_grad = _mm512_loadu_ps(y_grad + (start_row + idx) * cols + j);
+      __m512 vgamma = _mm512_loadu_ps(gamma + j);
+
+      __m512 vx_grad = _mm512_mul_ps(vy_grad, vgamma);
+
+      __m512 vx = _mm512_loadu_ps(x + (start_row + idx) * cols + j);
+      __m512 x_minus_mean = _mm512_sub_ps(vx, vmean[idx]);
+
+      vx_grad = _mm512_sub_ps(
+          vx_grad, _mm512_fmadd_ps(vsum_r[idx], x_minus_mean, vsum_m[idx]));
+      vx_grad = _mm512_mul_ps(vx_grad, vrvariance[idx]);
+
+      // save gradient of x
+      _mm512_storeu_ps(x_grad + (start_row + idx) * cols + j, vx_grad);
+
+      // gradient for gamma and beta
+      vgamma_grad = _mm512_fmadd_ps(_mm512_mul_ps(vy_grad, x_minus_mean),
+                                    vrvariance[idx], vgamma_grad);
+      vbeta_grad = _mm512_add_ps(vy_grad, vbeta_grad);
+    };
+
+    compile_time_for<ROWS>::op(compute_grad);
+
+    // save gradient of gamma, beta
+    _mm512_storeu_ps(gamma_grad + j, vgamma_grad);
+    _mm512_storeu_ps(beta_grad + j, vbeta_grad);
+  }
+
+  // Deal with the remain data
+  if (cols % 16 != 0) {
+    int remain = cols % 16;
+    auto remain_grad = [&](auto idx) {
+      for (int64 c = j; c < cols; ++c) {
+        const auto offset = (start_row + idx) * cols + c;
+        float vx_grad = y_grad[offset] * gamma[c];
+        float x_minus_mean = x[offset] - mean[start_row + idx];
+        vx_grad -= sum_m[idx] + sum_r[idx] * x_minus_mean;
+        vx_grad *= rvariance[start_row + idx];
+
+        // save gradient of x
+        x_grad[offset] = vx_grad;
+
+        // gradient for gamma and beta
+        gamma_grad[c] +=
+            y_grad[offset] * x_minus_mean * rvariance[start_row + idx];
+        beta_grad[c] += y_grad[offset];
+      }
+    };
+
+    compile_time_for<ROWS>::op(remain_grad);
+  }
+}
+
+void backward_avx512(const float* diff, const float* x, const float* mean,
+                     const float* rvariance, const float* gamma, float* x_diff,
+                     float* gamma_diff, float* beta_diff, int64 cols,
+                     int begin_row, int end_row) {
+  int i = begin_row;
+  for (; i + 3 < end_row; i += 4) {
+    backward_rows_avx512<4>(diff, x, mean, rvariance, gamma, x_diff,
+                            gamma_diff, beta_diff, cols, i);
+  }
+  for (; i < end_row; ++i) {
+    backward_rows_avx512<1>(diff, x, mean, rvariance, gamma, x_diff,
+                            gamma_diff, beta_diff, cols, i);
+  }
+}
+
+}  // namespace
+TF_CPU_ISA_END
+#endif  // TF_CPU_ISA_AVX512
+
 template <typename T>
 class FusedLayerNormOp : public OpKernel {
  private:
@@ -68,13 +430,14 @@ class FusedLayerNormOp : public OpKernel {
     const int64 total_unit = (rows + 15) / 16;
     const int64 unit_cost = 16 * cols * 50;  // assume every element consumes 50 cycles
 
-#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
+#ifdef TF_CPU_ISA_AVX512
+    const bool use_avx512 = CpuIsaSupported(CpuIsa::kAvx512);
     int64 block_num = cols >> 7;
     int64 remainder_128 = cols & 0x7F;
     int64 remainder_16 = remainder_128 & 0x0F;
     int64 remainder_block_num = remainder_128 >> 4;
     int64 remainder_block_num_total = remainder_block_num + !!remainder_16;
-#endif  //AVX512F
+#endif  // TF_CPU_ISA_AVX512
     const float one_over_cols = 1.0f / cols;
 
     auto& worker_threads =
@@ -88,12 +451,22 @@ class FusedLayerNormOp : public OpKernel {
           if (end_row > rows) {
             end_row = rows;
           }
-#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
-          forward_avx512(input, gamma, beta, output, mean, rvariance, cols, begin_row, end_row, block_num, 
-                         remainder_block_num, remainder_block_num_total, remainder_128, remainder_16, one_over_cols);
-#else
+#ifdef TF_CPU_ISA_AVX512
+          if (use_avx512) {
+            // Normalize 4 rows at a time, so that the reductions of the rows
+            // interleave and gamma and beta are loaded once for all of them.
+            for (; begin_row + 3 < end_row; begin_row += 4) {
+              forward_rows_avx512<4>(input, gamma, beta, output, mean,
+                                     rvariance, cols, begin_row,
+                                     one_over_cols, epsilon);
+            }
+            forward_avx512(input, gamma, beta, output, mean, rvariance, cols, begin_row, end_row, block_num, 
+                           remainder_block_num, remainder_block_num_total, remainder_128, remainder_16, one_over_cols,
+                           epsilon);
+            return;
+          }
+#endif  // TF_CPU_ISA_AVX512
           forward(input, gamma, beta, output, mean, rvariance, cols, begin_row, end_row, one_over_cols);
-#endif  //AVX512F
         });
   }
 
@@ -170,135 +543,6 @@ class FusedLayerNormOp : public OpKernel {
     }
   }
 
-#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
-  // AVX512 block size = 8; pack 8 * 16 = 128;
-  inline void forward_avx512(const float* input, const float* gamma, const float* beta, float* output, 
-                              float* mean, float* rvariance, int64 cols, int64 begin_row, int64 end_row,
-                              int64 block_num, int64 remainder_block_num,int64 remainder_block_num_total, 
-                              int64 remainder_128, int64 remainder_16, const float one_over_cols) {
-    for (int64 i = begin_row; i < end_row; ++i) {
-      // Sum
-      for (int64 j = 0; j < block_num; ++j) {
-      __m512 inputs[8];
-      auto load = [&](auto idx) {
-          inputs[idx] = _mm512_loadu_ps(input + cols * i + 128 * j + 16 * idx);
-        };
-      compile_time_for<8>::op(load);
-      __m512 block_sum = reduce_sum_block<8>(inputs);
-      mean[i] += _mm512_reduce_add_ps(block_sum);
-      }
-      if (remainder_block_num_total) { // remainder sum
-        __m512 inputs[remainder_block_num_total];
-        for (int64 idx = 0; idx < remainder_block_num; idx++){
-          inputs[idx] = _mm512_loadu_ps(input + cols * i + cols - remainder_128 + 16 * idx);
-        }
-        if (remainder_16) {
-          __mmask16 mask = 0xFFFF >> (16 - remainder_16);
-          inputs[remainder_block_num] = _mm512_maskz_loadu_ps(
-              mask, input + cols * i + cols - remainder_16);
-        }
-        __m512 block_sum = reduce_sum_block_ps(inputs, remainder_block_num_total);
-        mean[i] += _mm512_reduce_add_ps(block_sum);
-      }
-
-      // Mean
-      mean[i] *= one_over_cols;
-      __m512 means = _mm512_set1_ps(mean[i]);
-
-      // Variance
-      for (int64 j = 0; j < block_num; ++j) {
-        __m512 inputs[8];
-        auto load_var = [&](auto idx) {
-          inputs[idx] = _mm512_loadu_ps(input + cols * i + 128 * j + 16 * idx);
-          inputs[idx] = _mm512_sub_ps(inputs[idx], means);
-          inputs[idx] = _mm512_mul_ps(inputs[idx], inputs[idx]);
-        };
-        compile_time_for<8>::op(load_var);
-        __m512 block_sum = reduce_sum_block<8>(inputs);
-        rvariance[i] += _mm512_reduce_add_ps(block_sum);
-      }
-      if (remainder_block_num_total) { // remainder var
-        __m512 inputs[remainder_block_num_total];
-        for (int64 idx = 0; idx < remainder_block_num; idx++){
-          inputs[idx] = _mm512_loadu_ps(input + cols * i + cols - remainder_128 + 16 * idx);
-          inputs[idx] = _mm512_sub_ps(inputs[idx], means);
-          inputs[idx] = _mm512_mul_ps(inputs[idx], inputs[idx]);
-        }
-        if (remainder_16) {
-          __mmask16 mask = 0xFFFF >> (16 - remainder_16);
-          inputs[remainder_block_num] = _mm512_maskz_loadu_ps(
-              mask, input + cols * i + cols - remainder_16);
-          inputs[remainder_block_num] = _mm512_maskz_sub_ps(mask, inputs[remainder_block_num], means);
-          inputs[remainder_block_num] = _mm512_maskz_mul_ps(mask, inputs[remainder_block_num], inputs[remainder_block_num]);
-        }
-        __m512 block_sum = reduce_sum_block_ps(inputs, remainder_block_num_total);
-        rvariance[i] += _mm512_reduce_add_ps(block_sum);
-      }
-
-      rvariance[i] *= one_over_cols;
-      rvariance[i] += epsilon;
-      rvariance[i] = 1.0f / sqrtf(rvariance[i]);
-      __m512 rvariances = _mm512_set1_ps(rvariance[i]);
-      // Normalize and store
-      for (int64 j = 0; j < block_num; ++j) {
-        __m512 inputs[8];
-        __m512 nums[8]; // used to load gammas and betas 
-        auto load_normalize = [&](auto idx) {
-          // (x - mean) / sqrt(var + eps)
-          inputs[idx] = _mm512_loadu_ps(input + cols * i + 128 * j + 16 * idx);
-          inputs[idx] = _mm512_sub_ps(inputs[idx], means);
-          inputs[idx] = _mm512_mul_ps(inputs[idx], rvariances);
-          // Mul gamma
-          nums[idx] = _mm512_loadu_ps(gamma + 128 * j + 16 * idx);
-          inputs[idx] = _mm512_mul_ps(inputs[idx], nums[idx]);
-          // Add beta
-          nums[idx] = _mm512_loadu_ps(beta + 128 * j + 16 * idx);
-          inputs[idx] = _mm512_add_ps(inputs[idx], nums[idx]);
-
-          // Store
-          _mm512_storeu_ps(output + cols * i + 128 * j + 16 * idx, inputs[idx]);
-        };
-        compile_time_for<8>::op(load_normalize);
-      }
-      if (remainder_block_num_total) { // remainder normalize and store
-        __m512 inputs;
-        __m512 nums; // used to load gammas and betas 
-        for (int64 idx = 0; idx < remainder_block_num; idx++){ // remainder of 128
-          // (x - mean) / sqrt(var + eps)
-          inputs = _mm512_loadu_ps(input + cols * i + cols - remainder_128 + 16 * idx);
-          inputs = _mm512_sub_ps(inputs, means);
-          inputs = _mm512_mul_ps(inputs, rvariances);
-          // Mul gamma
-          nums = _mm512_loadu_ps(gamma + cols - remainder_128 + 16 * idx);
-          inputs = _mm512_mul_ps(inputs, nums);
-          // Add beta
-          nums = _mm512_loadu_ps(beta + cols - remainder_128 + 16 * idx);
-          inputs = _mm512_add_ps(inputs, nums);
-
-          // Store
-          _mm512_storeu_ps(output + cols * i + cols - remainder_128 + 16 * idx, inputs);
-        }
-        if (remainder_16) { // remainder of 16
-          __mmask16 mask = 0xFFFF >> (16 - remainder_16);
-          // (x - mean) / sqrt(var + eps)
-          inputs = _mm512_maskz_loadu_ps(mask, input + cols * i + cols - remainder_16);
-          inputs = _mm512_maskz_sub_ps(mask, inputs, means);
-          inputs = _mm512_maskz_mul_ps(mask, inputs, rvariances);
-          // Mul gamma
-          nums = _mm512_maskz_loadu_ps(mask, gamma + cols - remainder_16);
-          inputs = _mm512_maskz_mul_ps(mask, inputs, nums);
-          // Add beta
-          nums = _mm512_maskz_loadu_ps(mask, beta + cols - remainder_16);
-          inputs = _mm512_maskz_add_ps(mask, inputs, nums);
-
-          // Store
-          _mm512_mask_storeu_ps(output + cols * i + cols - remainder_16, mask, inputs);
-        }
-      }
-    }
-  }
-
-#endif // forward layer norm avx512 impl
 };
 
 REGISTER_KERNEL_BUILDER(Name("FusedLayerNorm")
@@ -348,60 +592,62 @@ class FusedLayerNormGradOp : public OpKernel {
     // Init
     memset(gamma_grad, 0, sizeof(float) * cols);
     memset(beta_grad, 0, sizeof(float) * cols);
+    if (rows == 0) {
+      return;
+    }
 
     auto& worker_threads =
         *(context->device()->tensorflow_cpu_worker_threads());
     thread::ThreadPool* thread_pool = worker_threads.workers;
 
-#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
+    // Every unit accumulates the gradients of gamma and beta of its rows in
+    // its own buffer, the buffers being summed up at the end, so that the
+    // units don't race on gamma_grad and beta_grad.
     const int total_unit = (rows >= 128 ? 8 : (rows + 15) / 16);
-    const int64 rows_per_unit = (rows + total_unit - 1) / total_unit; 
+    const int64 rows_per_unit = (rows + total_unit - 1) / total_unit;
     const int64 unit_cost = rows_per_unit * cols * 100;
-    thread_pool->ParallelFor(total_unit, unit_cost, 
-        [&](int64 begin_unit, int64 end_unit) 
-        {auto begin_row = begin_unit * rows_per_unit; 
-            auto end_row = end_unit * rows_per_unit; 
-            if (end_row > rows) 
-            {end_row = rows;}
-            backward(y_grad, x, mean, rvariance, gamma, x_grad, gamma_grad,
-                     beta_grad, cols, begin_row, end_row); 
-        }); 
-#else
-    const float one_over_cols = 1.0f / cols;
-    const int64 total_unit = (rows + 15) / 16;
-    const int64 unit_cost =
-        16 * cols * 100;  // assume every element consumes 100 cycles
+    Tensor unit_grads_tensor;
+    OP_REQUIRES_OK(context, context->allocate_temp(
+                                DT_FLOAT, TensorShape({total_unit, 2, cols}),
+                                &unit_grads_tensor));
+    float* unit_grads = unit_grads_tensor.flat<float>().data();
+    memset(unit_grads, 0, sizeof(float) * total_unit * 2 * cols);
+#ifdef TF_CPU_ISA_AVX512
+    const bool use_avx512 = CpuIsaSupported(CpuIsa::kAvx512);
+#endif  // TF_CPU_ISA_AVX512
 
-    thread_pool->ParallelFor(
-        total_unit, unit_cost, [&](int64 begin_unit, int64 end_unit) {
-          auto begin_row = begin_unit * 16;
-          auto end_row = end_unit * 16;
+    thread_pool->ParallelFor(total_unit, unit_cost,
+        [&](int64 begin_unit, int64 end_unit) {
+          auto begin_row = begin_unit * rows_per_unit;
+          auto end_row = end_unit * rows_per_unit;
           if (end_row > rows) {
             end_row = rows;
           }
-          backward(y_grad, x, mean, rvariance, gamma, x_grad, gamma_grad,
-                   beta_grad, begin_row, end_row, cols, one_over_cols);
+          float* unit_gamma_grad = unit_grads + begin_unit * 2 * cols;
+          float* unit_beta_grad = unit_gamma_grad + cols;
+#ifdef TF_CPU_ISA_AVX512
+          if (use_avx512) {
+            backward_avx512(y_grad, x, mean, rvariance, gamma, x_grad,
+                            unit_gamma_grad, unit_beta_grad, cols, begin_row,
+                            end_row);
+            return;
+          }
+#endif  // TF_CPU_ISA_AVX512
+          backward(y_grad, x, mean, rvariance, gamma, x_grad, unit_gamma_grad,
+                   unit_beta_grad, cols, begin_row, end_row);
         });
-#endif // backward compute
-  }
 
- private:
-#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
-  void backward(const float* diff, const float* x, const float* mean,
-                   const float* rvariance, const float* gamma, float* x_diff,
-                   float* gamma_diff, float* beta_diff, int64 cols,
-                   int begin_row, int end_row) {
-    int i = begin_row;
-    for (; i + 3 < end_row; i += 4) {
-      backward_avx512<4>(diff, x, mean, rvariance, gamma, x_diff, gamma_diff,
-                       beta_diff, cols, i);
-    }
-    for (; i < end_row; ++i) {
-      backward_avx512<1>(diff, x, mean, rvariance, gamma, x_diff, gamma_diff,
-                       beta_diff, cols, i);
+    for (int unit = 0; unit < total_unit; ++unit) {
+      const float* unit_gamma_grad = unit_grads + unit * 2 * cols;
+      const float* unit_beta_grad = unit_gamma_grad + cols;
+      for (int64 j = 0; j < cols; ++j) {
+        gamma_grad[j] += unit_gamma_grad[j];
+        beta_grad[j] += unit_beta_grad[j];
+      }
     }
   }
-#else
+
+ private:
   // For gradient of x, it comes from 3 parts: x-mean, mean, and rvariance
   //   grad from (x - mean): y_grad * gamma * [rvariance]
   //   grad from mean: - sum_row(y_grad * gamma * [rvariance]) / #cols
@@ -410,8 +656,9 @@ class FusedLayerNormGradOp : public OpKernel {
   // For gradient of beta, grad = y_grad
   void backward(const float* y_grad, const float* x, const float* mean,
                     const float* rvariance, const float* gamma, float* x_grad,
-                    float* gamma_grad, float* beta_grad, int64 begin_row,
-                    int64 end_row, int64 cols, const float one_over_cols) {
+                    float* gamma_grad, float* beta_grad, int64 cols,
+                    int64 begin_row, int64 end_row) {
+    const float one_over_cols = 1.0f / cols;
     for (int64 i = begin_row; i < end_row; ++i) {
       int64 j = 0;
       float sum_m = 0;
@@ -514,125 +761,7 @@ class FusedLayerNormGradOp : public OpKernel {
       }
     }
   }
-#endif // backward define
-
-#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
-  template <int ROWS>
-  inline void backward_avx512(const float* y_grad, const float* x,
-                              const float* mean, const float* rvariance,
-                              const float* gamma, float* x_grad,
-                              float* gamma_grad, float* beta_grad, int64 cols,
-                              int64 start_row) {
-    float sum_m[ROWS], sum_r[ROWS];
-    __m512 vsum_m[ROWS], vsum_r[ROWS], vmean[ROWS], vrvariance[ROWS];
-
-    // Init
-    auto setzero = [&](auto idx) {
-      vsum_m[idx] = _mm512_setzero_ps();
-      vsum_r[idx] = _mm512_setzero_ps();
-      vmean[idx] = _mm512_set1_ps(mean[start_row + idx]);
-      vrvariance[idx] = _mm512_set1_ps(rvariance[start_row + idx]);
-    };
-    compile_time_for<ROWS>::op(setzero);
-
-    // Compute sum for y_grad * gamma and y_grad * gamma * (x - mean)
-    int64 j = 0;
-    for (; j + 15 < cols; j += 16) {
-      auto compute_sum = [&](auto idx) {
-        __m512 vy_grad = _mm512_loadu_ps(y_grad + (start_row + idx) * cols + j);
-        __m512 vgamma = _mm512_loadu_ps(gamma + j);
-
-        __m512 mul = _mm512_mul_ps(vy_grad, vgamma);
-        vsum_m[idx] = _mm512_add_ps(mul, vsum_m[idx]);
-
-        __m512 vx = _mm512_loadu_ps(x + (start_row + idx) * cols + j);
-        __m512 x_minus_mean = _mm512_sub_ps(vx, vmean[idx]);
-        vsum_r[idx] = _mm512_fmadd_ps(mul, x_minus_mean, vsum_r[idx]);
-      };
-
-      compile_time_for<ROWS>::op(compute_sum);
-    }
-
-    auto reduce_sum = [&](auto idx) {
-      sum_m[idx] = horizontal_add(vsum_m[idx]);
-      sum_r[idx] = horizontal_add(vsum_r[idx]);
-
-      for (int64 c = j; c < cols; ++c) {
-        const auto offset = (start_row + idx) * cols + c;
-        sum_m[idx] += y_grad[offset] * gamma[c];
-        sum_r[idx] +=
-            y_grad[offset] * gamma[c] * (x[offset] - mean[start_row + idx]);
-      }
-
-      sum_m[idx] /= cols;
-      sum_r[idx] *= rvariance[start_row + idx] * rvariance[start_row + idx];
-      sum_r[idx] /= cols;
-
-      vsum_m[idx] = _mm512_set1_ps(sum_m[idx]);
-      vsum_r[idx] = _mm512_set1_ps(sum_r[idx]);
-    };
 
-    compile_time_for<ROWS>::op(reduce_sum);
-
-    // Compute gradient for x, gamma, beta
-    for (j = 0; j + 15 < cols; j += 16) {
-      __m512 vgamma_grad = _mm512_loadu_ps(gamma_grad + j);
-      __m512 vbeta_grad = _mm512_loadu_ps(beta_grad + j);
-
-      auto compute_grad = [&](auto idx) {
-        __m512 vy_grad = _mm512_loadu_ps(y_grad + (start_row + idx) * cols + j);
-        __m512 vgamma = _mm512_loadu_ps(gamma + j);
-
-        __m512 vx_grad = _mm512_mul_ps(vy_grad, vgamma);
-
-        __m512 vx = _mm512_loadu_ps(x + (start_row + idx) * cols + j);
-        __m512 x_minus_mean = _mm512_sub_ps(vx, vmean[idx]);
-
-        vx_grad = _mm512_sub_ps(
-            vx_grad, _mm512_fmadd_ps(vsum_r[idx], x_minus_mean, vsum_m[idx]));
-        vx_grad = _mm512_mul_ps(vx_grad, vrvariance[idx]);
-
-        // save gradient of x
-        _mm512_storeu_ps(x_grad + (start_row + idx) * cols + j, vx_grad);
-
-        // gradient for gamma and beta
-        vgamma_grad = _mm512_fmadd_ps(_mm512_mul_ps(vy_grad, x_minus_mean),
-                                      vrvariance[idx], vgamma_grad);
-        vbeta_grad = _mm512_add_ps(vy_grad, vbeta_grad);
-      };
-
-      compile_time_for<ROWS>::op(compute_grad);
-
-      // save gradient of gamma, beta
-      _mm512_storeu_ps(gamma_grad + j, vgamma_grad);
-      _mm512_storeu_ps(beta_grad + j, vbeta_grad);
-    }
-
-    // Deal with the remain data
-    if (cols % 16 != 0) {
-      int remain = cols % 16;
-      auto remain_grad = [&](auto idx) {
-        for (int64 c = j; c < cols; ++c) {
-          const auto offset = (start_row + idx) * cols + c;
-          float vx_grad = y_grad[offset] * gamma[c];
-          float x_minus_mean = x[offset] - mean[start_row + idx];
-          vx_grad -= sum_m[idx] + sum_r[idx] * x_minus_mean;
-          vx_grad *= rvariance[start_row + idx];
-
-          // save gradient of x
-          x_grad[offset] = vx_grad;
-
-          // gradient for gamma and beta
-          gamma_grad[c] +=
-              y_grad[offset] * x_minus_mean * rvariance[start_row + idx];
-          beta_grad[c] += y_grad[offset];
-        }
-      };
-
-      compile_time_for<ROWS>::op(remain_grad);
-    }
-  }
-#endif // backward layer norm avx512 impl
 };
 
 REGISTER_KERNEL_BUILDER(Name("FusedLayerNormGrad")
@@ -200,6 +200,8 @@ BM_FusedLayerNorm_NTH(1024, 1023);
 BM_FusedLayerNorm_NTH(1024, 1024);
 BM_FusedLayerNorm_NTH(1024, 2048);
 BM_FusedLayerNorm_NTH(1024, 4096);
+BM_FusedLayerNorm_NTH(16384, 64);
+BM_FusedLayerNorm_NTH(16384, 128);
 
 }
 
@@ -258,6 +260,8 @@ BM_FusedLayerNormGrad_NTH(1024, 1023);
 BM_FusedLayerNormGrad_NTH(1024, 1024);
 BM_FusedLayerNormGrad_NTH(1024, 2048);
 BM_FusedLayerNormGrad_NTH(1024, 4096);
+BM_FusedLayerNormGrad_NTH(16384, 64);
+BM_FusedLayerNormGrad_NTH(16384, 128);
 
 }
 
@@ -0,0 +1,235 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+
+namespace {
+// Output columns computed together, one AVX-512 register of floats.
+const int kPanelWidth = 16;
+// Rows sharing each load of the weights.
+const int kRowGroup = 4;
+// Rows of a shard. Their activations, two rows of the widest layer each,
+// stay in L2 from a layer to the next.
+const int64 kShardRows = 16;
+
+// The weights of a layer packed in panels of kPanelWidth columns, each
+// panel holding its in_dim rows contiguously, so that a panel is read
+// sequentially once per group of rows.
+struct PackedLayer {
+  int64 in_dim = 0;
+  int64 out_dim = 0;
+  // out_dim rounded up to kPanelWidth, the padding being zeros.
+  int64 padded_dim = 0;
+  std::vector<float> panels;
+  std::vector<float> bias;
+  bool relu = false;
+};
+
+struct PackedWeights {
+  // Buffers of the weights and biases that were packed.
+  std::vector<const void*> sources;
+  std::vector<PackedLayer> layers;
+  int64 max_padded_dim = 0;
+};
+
+template <int ROWS>
+void ComputePanel(const float* in, int64 in_stride, const PackedLayer& layer,
+                  int64 panel, float* out, int64 out_stride) {
+  const float* w = layer.panels.data() + panel * layer.in_dim * kPanelWidth;
+  const float* bias = layer.bias.data() + panel * kPanelWidth;
+  float acc[ROWS][kPanelWidth];
+  for (int r = 0; r < ROWS; r++) {
+    for (int j = 0; j < kPanelWidth; j++) {
+      acc[r][j] = bias[j];
+    }
+  }
+  for (int64 k = 0; k < layer.in_dim; k++) {
+    const float* w_k = w + k * kPanelWidth;
+    for (int r = 0; r < ROWS; r++) {
+      const float a = in[r * in_stride + k];
+      for (int j = 0; j < kPanelWidth; j++) {
+        acc[r][j] += a * w_k[j];
+      }
+    }
+  }
+  for (int r = 0; r < ROWS; r++) {
+    float* o = out + r * out_stride + panel * kPanelWidth;
+    for (int j = 0; j < kPanelWidth; j++) {
+      o[j] = layer.relu ? std::max(acc[r][j], 0.0f) : acc[r][j];
+    }
+  }
+}
+
+void ComputeLayer(const float* in, int64 in_stride, int64 rows,
+                  const PackedLayer& layer, float* out, int64 out_stride) {
+  for (int64 p = 0; p < layer.padded_dim / kPanelWidth; p++) {
+    int64 r = 0;
+    for (; r + kRowGroup <= rows; r += kRowGroup) {
+      ComputePanel<kRowGroup>(in + r * in_stride, in_stride, layer, p,
+                              out + r * out_stride, out_stride);
+    }
+    for (; r < rows; r++) {
+      ComputePanel<1>(in + r * in_stride, in_stride, layer, p,
+                      out + r * out_stride, out_stride);
+    }
+  }
+}
+}  // namespace
+
+// Runs consecutive dense layers over shards of kShardRows rows, so that the
+// intermediate activations of a shard never leave the cache of its thread.
+// This suits the small batches of online serving, for which the GEMM of a
+// single layer is too small to amortize its packing and threading.
+class FusedMLPOp : public OpKernel {
+ public:
+  explicit FusedMLPOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("num_layers", &num_layers_));
+    OP_REQUIRES_OK(context, context->GetAttr("activations", &activations_));
+    OP_REQUIRES(context, static_cast<int>(activations_.size()) == num_layers_,
+                errors::InvalidArgument(
+                    "activations must have num_layers elements, got ",
+                    activations_.size()));
+    for (const string& activation : activations_) {
+      OP_REQUIRES(context, activation == "Relu" || activation == "Identity",
+                  errors::InvalidArgument("Unsupported activation ",
+                                          activation));
+    }
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& x = context->input(0);
+    OpInputList weights;
+    OpInputList biases;
+    OP_REQUIRES_OK(context, context->input_list("weights", &weights));
+    OP_REQUIRES_OK(context, context->input_list("biases", &biases));
+    OP_REQUIRES(context, TensorShapeUtils::IsMatrix(x.shape()),
+                errors::InvalidArgument("x must be a matrix, got ",
+                                        x.shape().DebugString()));
+    int64 dim = x.dim_size(1);
+    for (int i = 0; i < num_layers_; i++) {
+      OP_REQUIRES(context,
+                  TensorShapeUtils::IsMatrix(weights[i].shape()) &&
+                      weights[i].dim_size(0) == dim,
+                  errors::InvalidArgument(
+                      "weights ", i, " must be a matrix of ", dim,
+                      " rows, got ", weights[i].shape().DebugString()));
+      dim = weights[i].dim_size(1);
+      OP_REQUIRES(context,
+                  TensorShapeUtils::IsVector(biases[i].shape()) &&
+                      biases[i].dim_size(0) == dim,
+                  errors::InvalidArgument(
+                      "biases ", i, " must be a vector of ", dim,
+                      " elements, got ", biases[i].shape().DebugString()));
+    }
+
+    std::shared_ptr<const PackedWeights> packed = GetPackedWeights(weights,
+                                                                   biases);
+    const int64 rows = x.dim_size(0);
+    const int64 out_dim = dim;
+    Tensor* y_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, TensorShape({rows, out_dim}), &y_tensor));
+    if (rows == 0 || out_dim == 0) {
+      return;
+    }
+    const float* x_data = x.flat<float>().data();
+    float* y = y_tensor->flat<float>().data();
+    const int64 in_dim = x.dim_size(1);
+
+    int64 flops_per_row = 0;
+    for (const PackedLayer& layer : packed->layers) {
+      flops_per_row += 2 * layer.in_dim * layer.padded_dim;
+    }
+    const int64 num_shards = (rows + kShardRows - 1) / kShardRows;
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    worker_threads.workers->ParallelFor(
+        num_shards, kShardRows * flops_per_row,
+        [&](int64 begin_shard, int64 end_shard) {
+          const int64 stride = packed->max_padded_dim;
+          std::vector<float> buffers(2 * kShardRows * stride);
+          for (int64 s = begin_shard; s < end_shard; s++) {
+            const int64 begin_row = s * kShardRows;
+            const int64 num_rows = std::min(kShardRows, rows - begin_row);
+            const float* in = x_data + begin_row * in_dim;
+            int64 in_stride = in_dim;
+            float* out = buffers.data();
+            for (const PackedLayer& layer : packed->layers) {
+              ComputeLayer(in, in_stride, num_rows, layer, out, stride);
+              in = out;
+              in_stride = stride;
+              out = (out == buffers.data()) ? out + kShardRows * stride
+                                            : buffers.data();
+            }
+            for (int64 r = 0; r < num_rows; r++) {
+              std::copy_n(in + r * stride, out_dim,
+                          y + (begin_row + r) * out_dim);
+            }
+          }
+        });
+  }
+
+ private:
+  // Packs the weights at the first run, and again if they are fed from
+  // other buffers.
+  std::shared_ptr<const PackedWeights> GetPackedWeights(
+      const OpInputList& weights, const OpInputList& biases) {
+    std::vector<const void*> sources;
+    for (int i = 0; i < num_layers_; i++) {
+      sources.emplace_back(weights[i].tensor_data().data());
+      sources.emplace_back(biases[i].tensor_data().data());
+    }
+    mutex_lock l(mu_);
+    if (packed_ != nullptr && packed_->sources == sources) {
+      return packed_;
+    }
+    auto packed = std::make_shared<PackedWeights>();
+    packed->sources = std::move(sources);
+    for (int i = 0; i < num_layers_; i++) {
+      PackedLayer layer;
+      layer.in_dim = weights[i].dim_size(0);
+      layer.out_dim = weights[i].dim_size(1);
+      layer.padded_dim =
+          (layer.out_dim + kPanelWidth - 1) / kPanelWidth * kPanelWidth;
+      layer.relu = (activations_[i] == "Relu");
+      layer.panels.resize(layer.in_dim * layer.padded_dim, 0.0f);
+      layer.bias.resize(layer.padded_dim, 0.0f);
+      auto w = weights[i].matrix<float>();
+      for (int64 k = 0; k < layer.in_dim; k++) {
+        for (int64 n = 0; n < layer.out_dim; n++) {
+          int64 panel = n / kPanelWidth;
+          layer.panels[(panel * layer.in_dim + k) * kPanelWidth +
+                       n % kPanelWidth] = w(k, n);
+        }
+      }
+      auto b = biases[i].vec<float>();
+      std::copy_n(b.data(), layer.out_dim, layer.bias.begin());
+      packed->max_padded_dim =
+          std::max(packed->max_padded_dim, layer.padded_dim);
+      packed->layers.emplace_back(std::move(layer));
+    }
+    packed_ = packed;
+    return packed_;
+  }
+
+  int num_layers_;
+  std::vector<string> activations_;
+  mutex mu_;
+  std::shared_ptr<const PackedWeights> packed_ GUARDED_BY(mu_);
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("FusedMLP").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    FusedMLPOp);
+
+}  // namespace tensorflow
@@ -0,0 +1,100 @@
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class FusedMLPOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const std::vector<string>& activations) {
+    const int num_layers = activations.size();
+    TF_EXPECT_OK(NodeDefBuilder("fused_mlp", "FusedMLP")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(num_layers, DT_FLOAT))
+                     .Input(FakeInput(num_layers, DT_FLOAT))
+                     .Attr("num_layers", num_layers)
+                     .Attr("activations", activations)
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+};
+
+float Value(int i, int salt) {
+  return ((i * 7 + salt * 13) % 19 - 9) / 10.0;
+}
+
+TEST_F(FusedMLPOpTest, MatchesUnfusedLayers) {
+  // Widths that aren't multiples of the panel width, and more rows than a
+  // shard.
+  const std::vector<int> dims = {37, 50, 17, 3};
+  const int rows = 21;
+  const std::vector<string> activations = {"Relu", "Relu", "Identity"};
+  MakeOp(activations);
+
+  std::vector<float> x(rows * dims[0]);
+  for (int i = 0; i < x.size(); i++) {
+    x[i] = Value(i, 0);
+  }
+  AddInputFromArray<float>(TensorShape({rows, dims[0]}), x);
+  std::vector<std::vector<float>> weights(3);
+  std::vector<std::vector<float>> biases(3);
+  for (int l = 0; l < 3; l++) {
+    weights[l].resize(dims[l] * dims[l + 1]);
+    for (int i = 0; i < weights[l].size(); i++) {
+      weights[l][i] = Value(i, l + 1);
+    }
+    AddInputFromArray<float>(TensorShape({dims[l], dims[l + 1]}),
+                             weights[l]);
+  }
+  for (int l = 0; l < 3; l++) {
+    biases[l].resize(dims[l + 1]);
+    for (int i = 0; i < biases[l].size(); i++) {
+      biases[l][i] = Value(i, l + 4);
+    }
+    AddInputFromArray<float>(TensorShape({dims[l + 1]}), biases[l]);
+  }
+  TF_ASSERT_OK(RunOpKernel());
+
+  std::vector<float> in = x;
+  for (int l = 0; l < 3; l++) {
+    std::vector<float> out(rows * dims[l + 1]);
+    for (int r = 0; r < rows; r++) {
+      for (int n = 0; n < dims[l + 1]; n++) {
+        float sum = biases[l][n];
+        for (int k = 0; k < dims[l]; k++) {
+          sum += in[r * dims[l] + k] * weights[l][k * dims[l + 1] + n];
+        }
+        out[r * dims[l + 1] + n] =
+            activations[l] == "Relu" ? std::max(sum, 0.0f) : sum;
+      }
+    }
+    in = out;
+  }
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({rows, dims[3]}));
+  test::FillValues<float>(&expected, in);
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-4);
+
+  // The packed weights are reused.
+  TF_ASSERT_OK(RunOpKernel());
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-4);
+}
+
+TEST_F(FusedMLPOpTest, MismatchedWeights) {
+  MakeOp({"Relu", "Identity"});
+  AddInputFromArray<float>(TensorShape({1, 2}), {1, 2});
+  AddInputFromArray<float>(TensorShape({2, 3}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<float>(TensorShape({2, 1}), {1, 2});
+  AddInputFromArray<float>(TensorShape({3}), {1, 2, 3});
+  AddInputFromArray<float>(TensorShape({1}), {1});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -16,6 +16,13 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_GATHER_FUNCTOR_H_
 #define TENSORFLOW_CORE_KERNELS_GATHER_FUNCTOR_H_
 
+#if defined(__AVX512F__) && !defined(__CUDACC__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 
 #include "tensorflow/core/framework/bounds_check.h"
@@ -33,6 +40,45 @@ typedef Eigen::GpuDevice GPUDevice;
 
 namespace functor {
 
+// Rows of params prefetched ahead of the row being copied. The rows of an
+// embedding table are gathered at random, a single row ahead does not hide
+// the latency of the misses.
+constexpr int kGatherPrefetchDistance = 8;
+// Bytes of the rows prefetched and copied with AVX512, those of the small
+// dims of the embeddings.
+constexpr size_t kGatherRowBytes = 256;
+
+inline void PrefetchGatherRow(const void* row, size_t bytes) {
+  const char* p = static_cast<const char*>(row);
+  const size_t n = std::min(bytes, kGatherRowBytes);
+  for (size_t offset = 0; offset < n; offset += 64) {
+    port::prefetch<port::PREFETCH_HINT_T0>(p + offset);
+  }
+}
+
+// Copies a row of bytes, with unaligned 64 bytes loads and stores and a
+// masked tail for the rows up to kGatherRowBytes, which memcpy handles with
+// a call and a dispatch on the size.
+inline void CopyGatherRow(void* dst, const void* src, size_t bytes) {
+#if defined(__AVX512F__) && !defined(__CUDACC__)
+  if (bytes <= kGatherRowBytes && bytes % sizeof(int32) == 0) {
+    char* d = static_cast<char*>(dst);
+    const char* s = static_cast<const char*>(src);
+    size_t offset = 0;
+    for (; offset + 64 <= bytes; offset += 64) {
+      _mm512_storeu_si512(d + offset, _mm512_loadu_si512(s + offset));
+    }
+    if (offset < bytes) {
+      const __mmask16 mask = (1 << ((bytes - offset) / sizeof(int32))) - 1;
+      _mm512_mask_storeu_epi32(d + offset, mask,
+                               _mm512_maskz_loadu_epi32(mask, s + offset));
+    }
+    return;
+  }
+#endif
+  memcpy(dst, src, bytes);
+}
+
 // Helper method to copy using memcpy.
 template <typename T, typename Index, typename SliceIndex,
           SliceIndex static_slice_elems>
@@ -60,23 +106,34 @@ SliceIndex HandleCopies(OpKernelContext* ctx,
   auto work = [&](int64 start, int64 end) {
     SliceIndex batch_idx = static_cast<SliceIndex>(start / indices_size);
     SliceIndex indices_idx = static_cast<SliceIndex>(start % indices_size);
-    SliceIndex batch_idx_end = static_cast<SliceIndex>(end / indices_size);
-    SliceIndex indices_idx_end = static_cast<SliceIndex>(end % indices_size);
-
-    while ((batch_idx < batch_idx_end) ||
-           (batch_idx == batch_idx_end && indices_idx < indices_idx_end)) {
-      SliceIndex i_next = indices_idx + 1;
-      SliceIndex b_next = batch_idx + 1;
-      if ((batch_idx == batch_idx_end && i_next < indices_idx_end) ||
-          (i_next < indices_size)) {
-        port::prefetch<port::PREFETCH_HINT_T0>(
-            &params(batch_idx, indices(i_next), 0));
-        port::prefetch<port::PREFETCH_HINT_T0>(&out(batch_idx, i_next, 0));
-        b_next = batch_idx;
-      } else if (b_next <= batch_idx_end) {
-        port::prefetch<port::PREFETCH_HINT_T0>(&params(b_next, indices(0), 0));
-        port::prefetch<port::PREFETCH_HINT_T0>(&out(b_next, 0, 0));
-        i_next = 0;
+
+    // A second cursor prefetches the rows kGatherPrefetchDistance ahead. The
+    // invalid indices are not prefetched, the copies report them.
+    int64 ahead = start;
+    SliceIndex ahead_batch = batch_idx;
+    SliceIndex ahead_idx = indices_idx;
+    auto prefetch_ahead = [&]() {
+      const Index index = internal::SubtleMustCopy(indices(ahead_idx));
+      if (FastBoundsCheck(index, limit)) {
+        PrefetchGatherRow(
+            params_base + (ahead_batch * static_cast<SliceIndex>(limit) +
+                           static_cast<SliceIndex>(index)) *
+                              slice_elems,
+            slice_bytes);
+      }
+      if (++ahead_idx == indices_size) {
+        ahead_idx = 0;
+        ++ahead_batch;
+      }
+      ++ahead;
+    };
+    for (int i = 0; i < kGatherPrefetchDistance && ahead < end; ++i) {
+      prefetch_ahead();
+    }
+
+    for (; start < end; ++start) {
+      if (ahead < end) {
+        prefetch_ahead();
       }
       const Index index = internal::SubtleMustCopy(indices(indices_idx));
       if (!FastBoundsCheck(index, limit)) {
@@ -89,7 +146,7 @@ SliceIndex HandleCopies(OpKernelContext* ctx,
       // ahead-of-time compilation binary size).
       if (is_simple_type<T>::value) {
         // Avoid auto-promotion to Index from SliceIndex by casting.
-        memcpy(
+        CopyGatherRow(
             out_base + (batch_idx * indices_size + indices_idx) * slice_elems,
             params_base + (batch_idx * static_cast<SliceIndex>(limit) +
                            static_cast<SliceIndex>(index)) *
@@ -100,8 +157,10 @@ SliceIndex HandleCopies(OpKernelContext* ctx,
         out.template chip<0>(batch_idx).template chip<0>(indices_idx) =
             params.template chip<0>(batch_idx).template chip<0>(index);
       }
-      indices_idx = i_next;
-      batch_idx = b_next;
+      if (++indices_idx == indices_size) {
+        indices_idx = 0;
+        ++batch_idx;
+      }
     }
   };
 
@@ -139,12 +198,29 @@ struct GatherFunctorCPU {
     }                                                                    \
   } while (0)
 
-    if (slice_size == 10)
-      CALL(10);
-    else if (slice_size == 20)
-      CALL(20);
-    else
-      CALL(-1);
+    // Static slice sizes of the common embedding dims unroll the copies.
+    switch (slice_size) {
+      case 8:
+        CALL(8);
+        break;
+      case 10:
+        CALL(10);
+        break;
+      case 16:
+        CALL(16);
+        break;
+      case 20:
+        CALL(20);
+        break;
+      case 32:
+        CALL(32);
+        break;
+      case 64:
+        CALL(64);
+        break;
+      default:
+        CALL(-1);
+    }
 #undef CALL
 
     return bad_i;
@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_types.h"
 #include "tensorflow/core/framework/type_traits.h"
 #include "tensorflow/core/framework/variant.h"
+#include "tensorflow/core/kernels/gather_functor.h"
 #include "tensorflow/core/platform/prefetch.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/util/work_sharder.h"
@@ -66,6 +67,36 @@ SliceIndex HandleCopiesBatched(OpKernelContext* ctx,
     SliceIndex indices_idx = static_cast<SliceIndex>(r_start % indices_size);
 
     SliceIndex batch_offset = batch_idx * indices_size;
+
+    // A second cursor prefetches the rows kGatherPrefetchDistance ahead, as
+    // in HandleCopies.
+    int64 ahead = start;
+    SliceIndex ahead_batch = batch_idx;
+    SliceIndex ahead_outer = outer_idx;
+    SliceIndex ahead_idx = indices_idx;
+    SliceIndex ahead_offset = batch_offset;
+    auto prefetch_ahead = [&]() {
+      const Index index =
+          internal::SubtleMustCopy(indices(ahead_offset + ahead_idx));
+      if (FastBoundsCheck(index, limit)) {
+        PrefetchGatherRow(&params(ahead_batch, ahead_outer,
+                                  static_cast<SliceIndex>(index), 0),
+                          slice_bytes);
+      }
+      if (++ahead_idx >= indices_size) {
+        ahead_idx = 0;
+        if (++ahead_outer >= outer_size) {
+          ahead_outer = 0;
+          ++ahead_batch;
+          ahead_offset += indices_size;
+        }
+      }
+      ++ahead;
+    };
+    for (int i = 0; i < kGatherPrefetchDistance && ahead < end; ++i) {
+      prefetch_ahead();
+    }
+
     for (; start < end; ++start) {
       SliceIndex i_next = indices_idx + 1;
       SliceIndex o_next = outer_idx;
@@ -80,10 +111,8 @@ SliceIndex HandleCopiesBatched(OpKernelContext* ctx,
           b_offset_next += indices_size;
         }
       }
-      if (start + 1 < end) {
-        port::prefetch<port::PREFETCH_HINT_T0>(
-            &params(b_next, o_next, indices(b_offset_next + i_next), 0));
-        port::prefetch<port::PREFETCH_HINT_T0>(&out(b_next, o_next, i_next, 0));
+      if (ahead < end) {
+        prefetch_ahead();
       }
       const Index index = internal::SubtleMustCopy(
           indices(batch_offset + indices_idx));
@@ -98,7 +127,7 @@ SliceIndex HandleCopiesBatched(OpKernelContext* ctx,
       // ahead-of-time compilation binary size).
       if (is_simple_type<T>::value) {
         // Avoid auto-promotion to Index from SliceIndex by casting.
-        memcpy(
+        CopyGatherRow(
             &out(batch_idx, outer_idx, indices_idx, 0),
             &params(batch_idx, outer_idx, static_cast<SliceIndex>(index), 0),
             slice_bytes);
@@ -156,12 +185,28 @@ struct GatherFunctorBatchedCPU {
 
     // TODO(rmlarsen): Investigate whether these specializations are still
     // needed and, if yes, whether the slice sizes are apropriate.
-    if (slice_size == 10)
-      CALL(10);
-    else if (slice_size == 20)
-      CALL(20);
-    else
-      CALL(-1);
+    switch (slice_size) {
+      case 8:
+        CALL(8);
+        break;
+      case 10:
+        CALL(10);
+        break;
+      case 16:
+        CALL(16);
+        break;
+      case 20:
+        CALL(20);
+        break;
+      case 32:
+        CALL(32);
+        break;
+      case 64:
+        CALL(64);
+        break;
+      default:
+        CALL(-1);
+    }
 #undef CALL
 
     return bad_i;
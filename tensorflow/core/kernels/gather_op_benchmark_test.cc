@@ -0,0 +1,88 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+
+// The lookups of a batch of ids in a dense embedding table, whose rows are
+// gathered at random from a table larger than the caches.
+static const int kEmbeddingLookups = 64 * 1024;
+static const int64 kEmbeddingTableBytes = 256 << 20;
+
+static Graph* EmbeddingGather(int dim, int batch_dims) {
+  Graph* g = new Graph(OpRegistry::Global());
+  const int64 rows = kEmbeddingTableBytes / (dim * sizeof(float));
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+
+  Tensor params;
+  Tensor indices;
+  if (batch_dims == 0) {
+    params = Tensor(DT_FLOAT, TensorShape({rows, dim}));
+    indices = Tensor(DT_INT64, TensorShape({kEmbeddingLookups}));
+  } else {
+    // A table per batch, as the tables of the multi-hash embeddings.
+    const int64 batch_size = 4;
+    params = Tensor(DT_FLOAT, TensorShape({batch_size, rows / batch_size,
+                                           dim}));
+    indices = Tensor(DT_INT64, TensorShape({batch_size,
+                                            kEmbeddingLookups / batch_size}));
+  }
+  params.flat<float>().setRandom();
+  const int64 limit = params.dim_size(batch_dims);
+  auto flat_indices = indices.flat<int64>();
+  for (int64 i = 0; i < flat_indices.size(); ++i) {
+    flat_indices(i) = rnd.Uniform64(limit);
+  }
+  Tensor axis(DT_INT32, TensorShape({}));
+  axis.scalar<int32>()() = batch_dims;
+
+  Node* ret = nullptr;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "GatherV2")
+                  .Input(test::graph::Constant(g, params, "params"))
+                  .Input(test::graph::Constant(g, indices, "indices"))
+                  .Input(test::graph::HostConstant(g, axis))
+                  .Attr("batch_dims", batch_dims)
+                  .Finalize(g, &ret));
+  return g;
+}
+
+#define BM_EMBEDDING_GATHER(BATCH_DIMS)                                    \
+  static void BM_cpu_embedding_gather_##BATCH_DIMS(int iters, int dim) {  \
+    const int64 tot = static_cast<int64>(iters) * kEmbeddingLookups * dim; \
+    testing::ItemsProcessed(static_cast<int64>(iters) * kEmbeddingLookups); \
+    testing::BytesProcessed(tot * sizeof(float));                          \
+    testing::UseRealTime();                                                \
+    test::Benchmark("cpu", EmbeddingGather(dim, BATCH_DIMS)).Run(iters);   \
+  }                                                                        \
+  BENCHMARK(BM_cpu_embedding_gather_##BATCH_DIMS)                          \
+      ->Arg(8)                                                             \
+      ->Arg(16)                                                            \
+      ->Arg(24)                                                            \
+      ->Arg(32)                                                            \
+      ->Arg(64)                                                            \
+      ->Arg(100)                                                           \
+      ->Arg(128)
+
+BM_EMBEDDING_GATHER(0);
+BM_EMBEDDING_GATHER(1);
+
+}  // namespace tensorflow
@@ -0,0 +1,178 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace {
+
+auto* raw_bytes = monitoring::Counter<0>::New(
+    "/tensorflow/core/gradient_compression/raw_bytes",
+    "Bytes of the dense gradients compressed before a send.");
+
+auto* compressed_bytes = monitoring::Counter<0>::New(
+    "/tensorflow/core/gradient_compression/compressed_bytes",
+    "Bytes of the dense gradients sent after compression.");
+
+// The compressed gradient is
+//   int32 dims, int64 dim_sizes[dims], int32 block_size,
+//   float scales[num_blocks], int8 values[num_elements].
+int64 HeaderBytes(int dims) {
+  return sizeof(int32) + dims * sizeof(int64) + sizeof(int32);
+}
+
+int64 NumBlocks(int64 n, int64 block_size) {
+  return (n + block_size - 1) / block_size;
+}
+
+}  // namespace
+
+class CompressGradientOp : public OpKernel {
+ public:
+  explicit CompressGradientOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("block_size", &block_size_));
+    OP_REQUIRES(ctx, block_size_ > 0,
+                errors::InvalidArgument("block_size must be positive, got ",
+                                        block_size_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& gradient = ctx->input(0);
+    const int64 n = gradient.NumElements();
+    const int dims = gradient.dims();
+    const int64 blocks = NumBlocks(n, block_size_);
+    const int64 header = HeaderBytes(dims);
+
+    Tensor* compressed = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(
+        0, TensorShape({header + blocks * sizeof(float) + n}), &compressed));
+    char* out = reinterpret_cast<char*>(compressed->flat<uint8>().data());
+    const int32 dims32 = dims;
+    memcpy(out, &dims32, sizeof(int32));
+    for (int d = 0; d < dims; ++d) {
+      const int64 size = gradient.dim_size(d);
+      memcpy(out + sizeof(int32) + d * sizeof(int64), &size, sizeof(int64));
+    }
+    const int32 block_size32 = block_size_;
+    memcpy(out + header - sizeof(int32), &block_size32, sizeof(int32));
+    float* scales = reinterpret_cast<float*>(out + header);
+    int8* values = reinterpret_cast<int8*>(out + header +
+                                           blocks * sizeof(float));
+
+    const float* g = gradient.flat<float>().data();
+    mutex_lock l(mu_);
+    // The residual of another shape, e.g. of a previous graph, is stale.
+    if (residual_.NumElements() != n) {
+      residual_ = Tensor(DT_FLOAT, TensorShape({n}));
+      residual_.flat<float>().setZero();
+    }
+    float* r = residual_.flat<float>().data();
+    for (int64 b = 0; b < blocks; ++b) {
+      const int64 begin = b * block_size_;
+      const int64 end = std::min(n, begin + block_size_);
+      float max_abs = 0;
+      for (int64 i = begin; i < end; ++i) {
+        r[i] += g[i];
+        max_abs = std::max(max_abs, std::fabs(r[i]));
+      }
+      const float scale = max_abs / 127.0f;
+      scales[b] = scale;
+      const float inv_scale = scale > 0 ? 1.0f / scale : 0.0f;
+      for (int64 i = begin; i < end; ++i) {
+        const float q = std::max(-127.0f,
+                                 std::min(127.0f, std::round(r[i] * inv_scale)));
+        values[i] = static_cast<int8>(q);
+        r[i] -= q * scale;
+      }
+    }
+
+    raw_bytes->GetCell()->IncrementBy(n * sizeof(float));
+    compressed_bytes->GetCell()->IncrementBy(compressed->NumElements());
+    VLOG(2) << "Compressed gradient " << name() << " of "
+            << n * sizeof(float) << " bytes into "
+            << compressed->NumElements() << " bytes.";
+  }
+
+ private:
+  int64 block_size_;
+  mutex mu_;
+  // The quantization error of the previous steps, added to the next
+  // gradient.
+  Tensor residual_ GUARDED_BY(mu_);
+};
+
+REGISTER_KERNEL_BUILDER(Name("_CompressGradient").Device(DEVICE_CPU),
+                        CompressGradientOp);
+
+class DecompressGradientOp : public OpKernel {
+ public:
+  explicit DecompressGradientOp(OpKernelConstruction* ctx) : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& compressed = ctx->input(0);
+    const int64 bytes = compressed.NumElements();
+    const char* in =
+        reinterpret_cast<const char*>(compressed.flat<uint8>().data());
+    OP_REQUIRES(ctx, bytes >= HeaderBytes(0),
+                errors::InvalidArgument("Truncated compressed gradient"));
+    int32 dims = 0;
+    memcpy(&dims, in, sizeof(int32));
+    OP_REQUIRES(ctx, dims >= 0 && bytes >= HeaderBytes(dims),
+                errors::InvalidArgument("Truncated compressed gradient"));
+    TensorShape shape;
+    for (int d = 0; d < dims; ++d) {
+      int64 size = 0;
+      memcpy(&size, in + sizeof(int32) + d * sizeof(int64), sizeof(int64));
+      OP_REQUIRES(ctx, size >= 0,
+                  errors::InvalidArgument("Invalid compressed gradient"));
+      shape.AddDim(size);
+    }
+    const int64 header = HeaderBytes(dims);
+    int32 block_size = 0;
+    memcpy(&block_size, in + header - sizeof(int32), sizeof(int32));
+    const int64 n = shape.num_elements();
+    OP_REQUIRES(ctx, block_size > 0,
+                errors::InvalidArgument("Invalid compressed gradient"));
+    const int64 blocks = NumBlocks(n, block_size);
+    OP_REQUIRES(ctx, bytes == header + blocks * sizeof(float) + n,
+                errors::InvalidArgument(
+                    "Compressed gradient of ", bytes, " bytes, expected ",
+                    header + blocks * sizeof(float) + n, " for shape ",
+                    shape.DebugString()));
+
+    Tensor* gradient = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, shape, &gradient));
+    const float* scales = reinterpret_cast<const float*>(in + header);
+    const int8* values = reinterpret_cast<const int8*>(
+        in + header + blocks * sizeof(float));
+    float* g = gradient->flat<float>().data();
+    for (int64 i = 0; i < n; ++i) {
+      g[i] = values[i] * scales[i / block_size];
+    }
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("_DecompressGradient").Device(DEVICE_CPU),
+                        DecompressGradientOp);
+
+}  // namespace tensorflow
@@ -0,0 +1,107 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace tensorflow {
+namespace {
+
+class GradientCompressionTest : public OpsTestBase {
+ protected:
+  // Compresses 'gradient' 'steps' times with one kernel.
+  std::vector<Tensor> Compress(const TensorShape& shape,
+                               const std::vector<float>& gradient,
+                               int steps, int block_size) {
+    TF_CHECK_OK(NodeDefBuilder("compress", "_CompressGradient")
+                    .Input(FakeInput(DT_FLOAT))
+                    .Attr("block_size", block_size)
+                    .Finalize(node_def()));
+    TF_CHECK_OK(InitOp());
+    std::vector<Tensor> compressed;
+    for (int i = 0; i < steps; ++i) {
+      inputs_.clear();
+      AddInputFromArray<float>(shape, gradient);
+      TF_CHECK_OK(RunOpKernel());
+      compressed.push_back(*GetOutput(0));
+    }
+    return compressed;
+  }
+
+  std::vector<Tensor> Decompress(const std::vector<Tensor>& compressed) {
+    TF_CHECK_OK(NodeDefBuilder("decompress", "_DecompressGradient")
+                    .Input(FakeInput(DT_UINT8))
+                    .Finalize(node_def()));
+    TF_CHECK_OK(InitOp());
+    std::vector<Tensor> gradients;
+    for (const Tensor& t : compressed) {
+      inputs_.clear();
+      AddInputFromArray<uint8>(
+          t.shape(), gtl::ArraySlice<uint8>(t.flat<uint8>().data(),
+                                            t.NumElements()));
+      TF_CHECK_OK(RunOpKernel());
+      gradients.push_back(*GetOutput(0));
+    }
+    return gradients;
+  }
+};
+
+TEST_F(GradientCompressionTest, RoundTrip) {
+  std::vector<Tensor> compressed =
+      Compress(TensorShape({2, 3}), {127, -63.5, 0, 1, 2, -4}, 1, 3);
+  // 4 bytes of dims, 2 * 8 of dim sizes, 4 of block size, 2 scales and
+  // 6 values.
+  EXPECT_EQ(4 + 16 + 4 + 2 * 4 + 6, compressed[0].NumElements());
+  std::vector<Tensor> gradients = Decompress(compressed);
+  Tensor expected(DT_FLOAT, TensorShape({2, 3}));
+  test::FillValues<float>(&expected, {127, -63.5, 0, 1, 2, -4});
+  test::ExpectTensorNear<float>(expected, gradients[0], 4.0f / 127);
+}
+
+TEST_F(GradientCompressionTest, ErrorFeedback) {
+  // 0.3 is lost at every step without the residual of the previous steps.
+  const std::vector<float> gradient = {100, 0.3};
+  const int kSteps = 10;
+  std::vector<Tensor> gradients =
+      Decompress(Compress(TensorShape({2}), gradient, kSteps, 256));
+  float sum[2] = {0, 0};
+  for (const Tensor& g : gradients) {
+    sum[0] += g.flat<float>()(0);
+    sum[1] += g.flat<float>()(1);
+  }
+  // The applied sum only misses the residual of the last step.
+  EXPECT_NEAR(kSteps * gradient[0], sum[0], 1.0f);
+  EXPECT_NEAR(kSteps * gradient[1], sum[1], 1.0f);
+  EXPECT_GT(sum[1], 0);
+}
+
+TEST_F(GradientCompressionTest, InvalidInput) {
+  TF_ASSERT_OK(NodeDefBuilder("decompress", "_DecompressGradient")
+                   .Input(FakeInput(DT_UINT8))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInputFromArray<uint8>(TensorShape({3}), {1, 2, 3});
+  EXPECT_FALSE(RunOpKernel().ok());
+}
+
+}  // namespace
+}  // namespace tensorflow
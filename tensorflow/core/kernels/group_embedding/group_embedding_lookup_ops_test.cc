@@ -651,7 +651,8 @@ void fill_ev_vector_expected<SqrtnAndMaxNorm200>(Tensor* expected) {
 class GroupEmbeddingVariableForWardOpTest : public OpsTestBase {
  protected:
   template <typename TKey, typename TValue, TestCase test_case>
-  void Run(DEVICE device) {
+  void Run(DEVICE device, bool output_pointer = false,
+           bool shared_ev = false, bool concat = false) {
     if (device == DEVICE::GPU) {
       SetDevice(DEVICE_GPU,
                 std::unique_ptr<tensorflow::Device>(DeviceFactory::NewDevice(
@@ -734,8 +735,16 @@ class GroupEmbeddingVariableForWardOpTest : public OpsTestBase {
     std::vector<TKey> sp_values_vec{3, 1, 4, 5, 7, 3, 12, 12, 15, 4};
     get_node_attr_from_test_case<test_case>(combiner_str, max_norm);
 
-    TF_EXPECT_OK(NodeDefBuilder("group_embedding_variable_lookup",
-                                "GroupEmbeddingVarLookup")
+    // The outputs of the lookups are concatenated in the reverse order.
+    const std::vector<int> concat_positions{1, 0};
+    const char* op_name = output_pointer ? "_OPT_GroupEmbeddingVarLookup"
+                          : concat       ? "_GroupEmbeddingVarLookupConcat"
+                                         : "GroupEmbeddingVarLookup";
+    NodeDefBuilder builder("group_embedding_variable_lookup", op_name);
+    if (concat) {
+      builder.Attr("concat_positions", concat_positions);
+    }
+    TF_EXPECT_OK(builder
                      .Input(FakeInput(num_lookups, DT_RESOURCE))  // ev
                      .Input(FakeInput(num_lookups, k_dtype))      // sp_values
                      .Input(FakeInput(num_lookups, DT_INT64))     // sp_indices
@@ -754,7 +763,15 @@ class GroupEmbeddingVariableForWardOpTest : public OpsTestBase {
                      .Finalize(node_def()));
     TF_EXPECT_OK(InitOp());
 
+    std::vector<EmbeddingVar<TKey, TValue>*> embedding_vars;
     for (int i = 0; i < num_lookups; ++i) {
+      if (shared_ev && i > 0) {
+        // The lookups of one EmbeddingVar, looked up as a group.
+        embedding_vars.push_back(embedding_vars[0]);
+        AddInputFromArray<ResourceHandle>(
+            TensorShape({}), {inputs_[0]->scalar<ResourceHandle>()()});
+        continue;
+      }
       EmbeddingVar<TKey, TValue>* embedding_var = nullptr;
       Allocator* gpu_allocator = device_->GetAllocator(AllocatorAttributes());
       auto embedding_config =
@@ -779,6 +796,7 @@ class GroupEmbeddingVariableForWardOpTest : public OpsTestBase {
             embedding_var->LookupOrCreateKey(sp_values_vec[j], &value_ptr);
         typename TTypes<TValue>::Flat vflat = embedding_var->flat(value_ptr);
       }
+      embedding_vars.push_back(embedding_var);
       AddResourceInput<EmbeddingVar<TKey, TValue>>("", "EV" + std::to_string(i),
                                                    embedding_var);
     }
@@ -826,12 +844,32 @@ class GroupEmbeddingVariableForWardOpTest : public OpsTestBase {
     }
     TF_EXPECT_OK(device_->Sync());
 
+    // The index of the unique_keys of lookup 0.
+    const int output_base = concat ? 1 : num_lookups;
     for (int i = 0; i < num_lookups; ++i) {
-      const Tensor& emb_vector = *GetOutput(i);
-      const Tensor& values_offset = *GetOutput(num_lookups + i);
-      const Tensor& unique_idx_output = *GetOutput(2 * num_lookups + i);
-      const Tensor& batch_size_output = *GetOutput(3 * num_lookups + i);
-      test::ExpectTensorNear<TValue>(emb_vector_expected, emb_vector, 1e-4);
+      const Tensor& values_offset = *GetOutput(output_base + i);
+      const Tensor& unique_idx_output =
+          *GetOutput(output_base + num_lookups + i);
+      const Tensor& batch_size_output =
+          *GetOutput(output_base + 2 * num_lookups + i);
+      if (concat) {
+        const Tensor& concat_output = *GetOutput(0);
+        ASSERT_EQ(concat_output.dim_size(1), num_lookups * emb_vector_dim);
+        Tensor emb_vector(v_dtype, {batch_size, emb_vector_dim});
+        for (int b = 0; b < batch_size; ++b) {
+          for (int d = 0; d < emb_vector_dim; ++d) {
+            emb_vector.matrix<TValue>()(b, d) = concat_output.matrix<TValue>()(
+                b, concat_positions[i] * emb_vector_dim + d);
+          }
+        }
+        test::ExpectTensorNear<TValue>(emb_vector_expected, emb_vector, 1e-4);
+        test::ExpectTensorEqual<int32>(
+            test::AsTensor<int32>({batch_size, emb_vector_dim}),
+            *GetOutput(output_base + 3 * num_lookups + i));
+      } else {
+        test::ExpectTensorNear<TValue>(emb_vector_expected, *GetOutput(i),
+                                       1e-4);
+      }
       // Currently GPU do not have Unique logic.
       if (device == DEVICE::CPU) {
         test::ExpectTensorEqual<int64>(sp_values_offset_expected,
@@ -839,6 +877,17 @@ class GroupEmbeddingVariableForWardOpTest : public OpsTestBase {
         test::ExpectTensorEqual<int32>(unique_idx_expected, unique_idx_output);
       }
       test::ExpectTensorEqual<int32>(batch_size_expected, batch_size_output);
+      if (output_pointer) {
+        const Tensor& pointer_output = *GetOutput(4 * num_lookups + i);
+        ASSERT_EQ(pointer_output.NumElements(), values_offset.NumElements());
+        for (int j = 0; j < pointer_output.NumElements(); ++j) {
+          ValuePtr<TValue>* value_ptr = nullptr;
+          TF_EXPECT_OK(embedding_vars[i]->LookupOrCreateKey(
+              values_offset.flat<TKey>()(j), &value_ptr));
+          EXPECT_EQ(reinterpret_cast<int64>(value_ptr),
+                    pointer_output.flat<int64>()(j));
+        }
+      }
     }
   }
 };
@@ -881,6 +930,31 @@ TEST_F(GroupEmbeddingVariableForWardOpTest,
   Run<int64, float, Sum>(DEVICE::CPU);
 }
 
+TEST_F(GroupEmbeddingVariableForWardOpTest,
+       EmbeddingVarLocalSparseLookUpOutputPointerFloatMeanCpu) {
+  Run<int64, float, Mean>(DEVICE::CPU, true);
+}
+
+TEST_F(GroupEmbeddingVariableForWardOpTest,
+       EmbeddingVarLocalSparseLookUpSharedEVFloatMeanCpu) {
+  Run<int64, float, Mean>(DEVICE::CPU, false, true);
+}
+
+TEST_F(GroupEmbeddingVariableForWardOpTest,
+       EmbeddingVarLocalSparseLookUpSharedEVOutputPointerFloatSumCpu) {
+  Run<int64, float, Sum>(DEVICE::CPU, true, true);
+}
+
+TEST_F(GroupEmbeddingVariableForWardOpTest,
+       EmbeddingVarLocalSparseLookUpConcatFloatSqrtnCpu) {
+  Run<int64, float, Sqrtn>(DEVICE::CPU, false, false, true);
+}
+
+TEST_F(GroupEmbeddingVariableForWardOpTest,
+       EmbeddingVarLocalSparseLookUpConcatSharedEVFloatMeanCpu) {
+  Run<int64, float, Mean>(DEVICE::CPU, false, true, true);
+}
+
 // TEST_F(GroupEmbeddingForWardOpTest,
 //        EmbeddingLocalSparseLookUpFloatSqrtnAndMaxNorm200Cpu) {
 //   Run<int64, float, SqrtnAndMaxNorm200>(DEVICE::CPU);
@@ -889,7 +963,7 @@ TEST_F(GroupEmbeddingVariableForWardOpTest,
 class GroupEmbeddingVariableBackWardOpTest : public OpsTestBase {
  protected:
   template <typename TKey, typename TValue, TestCase test_case>
-  void Run(DEVICE device) {
+  void Run(DEVICE device, bool concat = false) {
     if (device == DEVICE::GPU) {
       SetDevice(DEVICE_GPU,
                 std::unique_ptr<tensorflow::Device>(DeviceFactory::NewDevice(
@@ -911,9 +985,19 @@ class GroupEmbeddingVariableBackWardOpTest : public OpsTestBase {
     std::vector<TKey> sp_values_vec{3, 1, 4, 5, 7, 3, 12, 12, 15, 4};
     get_node_attr_from_test_case<test_case>(combiner_str, max_norm);
 
-    TF_EXPECT_OK(NodeDefBuilder("group_embedding_variable_lookup_grad",
-                                "GroupEmbeddingVariableLookupGrad")
-                     .Input(FakeInput(num_lookups, DT_FLOAT))     // grads
+    // The gradients of the lookups are the columns of the gradient of a
+    // concat in the reverse order.
+    const std::vector<int> concat_positions{1, 0};
+    NodeDefBuilder builder("group_embedding_variable_lookup_grad",
+                           concat ? "_GroupEmbeddingVariableLookupConcatGrad"
+                                  : "GroupEmbeddingVariableLookupGrad");
+    if (concat) {
+      builder.Input(FakeInput(DT_FLOAT))  // grad
+          .Attr("concat_positions", concat_positions);
+    } else {
+      builder.Input(FakeInput(num_lookups, DT_FLOAT));  // grads
+    }
+    TF_EXPECT_OK(builder
                      .Input(FakeInput(num_lookups, DT_RESOURCE))  // ev
                      .Input(FakeInput(num_lookups, k_dtype))      // unique_key
                      .Input(FakeInput(num_lookups, DT_INT64))     // unique_idx
@@ -927,15 +1011,28 @@ class GroupEmbeddingVariableBackWardOpTest : public OpsTestBase {
                      .Finalize(node_def()));
     TF_EXPECT_OK(InitOp());
 
-    for (int i = 0; i < num_lookups; ++i) {
-      Tensor top_grad(DT_FLOAT, {batch_size, emb_vector_dim});
-      test::FillValues<float>(
-          &top_grad,
-          {0.0,  1.0,  2.0,  3.0,  4.0,  5.0,  6.0,  7.0,  8.0,  9.0,  10.0,
-           11.0, 12.0, 13.0, 14.0, 15.0, 16.0, 17.0, 18.0, 19.0, 20.0, 21.0,
-           22.0, 23.0, 24.0, 25.0, 26.0, 27.0, 28.0, 29.0, 30.0, 31.0});
-
-      AddInputFromArray<float>(top_grad.shape(), top_grad.flat<float>());
+    Tensor top_grad(DT_FLOAT, {batch_size, emb_vector_dim});
+    test::FillValues<float>(
+        &top_grad,
+        {0.0,  1.0,  2.0,  3.0,  4.0,  5.0,  6.0,  7.0,  8.0,  9.0,  10.0,
+         11.0, 12.0, 13.0, 14.0, 15.0, 16.0, 17.0, 18.0, 19.0, 20.0, 21.0,
+         22.0, 23.0, 24.0, 25.0, 26.0, 27.0, 28.0, 29.0, 30.0, 31.0});
+    if (concat) {
+      Tensor concat_grad(DT_FLOAT, {batch_size, num_lookups * emb_vector_dim});
+      for (int i = 0; i < num_lookups; ++i) {
+        for (int b = 0; b < batch_size; ++b) {
+          for (int d = 0; d < emb_vector_dim; ++d) {
+            concat_grad.matrix<float>()(
+                b, concat_positions[i] * emb_vector_dim + d) =
+                top_grad.matrix<float>()(b, d);
+          }
+        }
+      }
+      AddInputFromArray<float>(concat_grad.shape(), concat_grad.flat<float>());
+    } else {
+      for (int i = 0; i < num_lookups; ++i) {
+        AddInputFromArray<float>(top_grad.shape(), top_grad.flat<float>());
+      }
     }
 
     for (int i = 0; i < num_lookups; ++i) {
@@ -1072,6 +1169,16 @@ TEST_F(GroupEmbeddingVariableBackWardOpTest,
   Run<int64, float, Sum>(DEVICE::CPU);
 }
 
+TEST_F(GroupEmbeddingVariableBackWardOpTest,
+       EmbeddingVarLocalSparseLookUpConcatGradFloatMeanCpu) {
+  Run<int64, float, Mean>(DEVICE::CPU, true);
+}
+
+TEST_F(GroupEmbeddingVariableBackWardOpTest,
+       EmbeddingVarLocalSparseLookUpConcatGradFloatSumCpu) {
+  Run<int64, float, Sum>(DEVICE::CPU, true);
+}
+
 // TEST_F(GroupEmbeddingVariableBackWardOpTest,
 //        EmbeddingLocalSparseLookUpGradFloatMeanAndMaxNorm100Cpu) {
 //   Run<int64, float, MeanAndMaxNorm100>(DEVICE::CPU);
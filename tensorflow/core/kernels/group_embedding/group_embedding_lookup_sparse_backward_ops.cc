@@ -18,6 +18,9 @@ limitations under the License.
 
 namespace tensorflow {
 
+// As _GroupEmbeddingVariableLookupConcatGrad, the gradients of the lookups
+// are read from their columns of the gradient of the concat, input 0, whose
+// other inputs are shifted accordingly.
 template <typename TKey, typename TValue>
 class GroupEmbeddingVarLookupGradCpuOp : public OpKernel {
  public:
@@ -27,21 +30,46 @@ class GroupEmbeddingVarLookupGradCpuOp : public OpKernel {
     OP_REQUIRES_OK(c, c->GetAttr("num_lookups", &num_lookups_));
     OP_REQUIRES_OK(c, c->GetAttr("dimension", &dimension_));
     OP_REQUIRES_OK(c, c->GetAttr("max_norm", &max_norm_));
+    input_base_ = 2 * num_lookups_;
+    if (c->HasAttr("concat_positions")) {
+      OP_REQUIRES_OK(c, c->GetAttr("concat_positions", &concat_positions_));
+      OP_REQUIRES(c, concat_positions_.size() == num_lookups_,
+                  errors::InvalidArgument(
+                      "concat_positions must have num_lookups elements"));
+      input_base_ = 1 + num_lookups_;
+    }
   }
 
   void Compute(OpKernelContext* ctx) override {
     auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
 
     for (int i = 0; i < num_lookups_; ++i) {
-      const Tensor grads_tensor = ctx->input(i);
-      auto* grads = grads_tensor.flat<TValue>().data();
-      const Tensor unique_keys_tensor = ctx->input(2 * num_lookups_ + i);
+      // The gradients of the samples are grads_stride apart in the concat.
+      const TValue* grads = nullptr;
+      int64 grads_stride = dimension_;
+      if (concat_positions_.empty()) {
+        grads = ctx->input(i).flat<TValue>().data();
+      } else {
+        const Tensor& concat_grads_tensor = ctx->input(0);
+        OP_REQUIRES(ctx,
+                    concat_grads_tensor.dims() == 2 &&
+                        concat_grads_tensor.dim_size(1) ==
+                            num_lookups_ * dimension_,
+                    errors::InvalidArgument(
+                        "grad must be [batch_size, num_lookups * dimension]"));
+        grads = concat_grads_tensor.flat<TValue>().data() +
+                concat_positions_[i] * dimension_;
+        grads_stride = num_lookups_ * dimension_;
+      }
+      const Tensor unique_keys_tensor = ctx->input(input_base_ + i);
       auto* unique_keys = unique_keys_tensor.flat<TKey>().data();
       int unique_nnz = unique_keys_tensor.NumElements();
 
-      const Tensor sp_indices_tensor = ctx->input(3 * num_lookups_ + i);
+      const Tensor sp_indices_tensor =
+          ctx->input(input_base_ + num_lookups_ + i);
       auto* sp_indices = sp_indices_tensor.flat<int64>().data();
-      const Tensor batch_nums_tensor = ctx->input(4 * num_lookups_ + i);
+      const Tensor batch_nums_tensor =
+          ctx->input(input_base_ + 2 * num_lookups_ + i);
       auto* batch_nums = batch_nums_tensor.flat<int>().data();
 
       Tensor* grads_sp_values_tensor;
@@ -54,8 +82,8 @@ class GroupEmbeddingVarLookupGradCpuOp : public OpKernel {
       int slice_bytes = unique_nnz * dimension_ * 1000;
       if (combiner_ == "mean") {
         auto embedding_var_grad_combiner = [this, &grads_sp_values, sp_indices,
-                                            grads, batch_nums](int64 start,
-                                                               int64 end) {
+                                            grads, grads_stride, batch_nums](
+                                               int64 start, int64 end) {
           for (int64 i = start; i < end; ++i) {
             // Code Not Help
             // #if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
@@ -79,7 +107,7 @@ class GroupEmbeddingVarLookupGradCpuOp : public OpKernel {
             int scale = batch_nums[segment_id] - batch_offset;
             for (int d = 0; d < dimension_; ++d) {
               grads_sp_values[i * dimension_ + d] =
-                  grads[segment_id * dimension_ + d] / scale;
+                  grads[segment_id * grads_stride + d] / scale;
             }
             // #endif
           }
@@ -89,12 +117,12 @@ class GroupEmbeddingVarLookupGradCpuOp : public OpKernel {
               embedding_var_grad_combiner);  // Parallel on batch
       } else if (combiner_ == "sum") {
         auto embedding_var_grad_combiner = [this, &grads_sp_values, sp_indices,
-                                            grads, batch_nums](int64 start,
-                                                               int64 end) {
+                                            grads, grads_stride, batch_nums](
+                                               int64 start, int64 end) {
           for (int64 i = start; i < end; ++i) {
             int segment_id = sp_indices[i];
             memcpy(grads_sp_values + i * dimension_,
-                   grads + segment_id * dimension_,
+                   grads + segment_id * grads_stride,
                    sizeof(TValue) * dimension_);
           }
         };
@@ -102,8 +130,8 @@ class GroupEmbeddingVarLookupGradCpuOp : public OpKernel {
               slice_bytes /*cost*/, embedding_var_grad_combiner);
       } else {
         auto embedding_var_grad_combiner = [this, &grads_sp_values, sp_indices,
-                                            grads, batch_nums](int64 start,
-                                                               int64 end) {
+                                            grads, grads_stride, batch_nums](
+                                               int64 start, int64 end) {
           for (int64 i = start; i < end; ++i) {
 // #if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
 //             int segment_id = sp_indices[i];
@@ -125,7 +153,7 @@ class GroupEmbeddingVarLookupGradCpuOp : public OpKernel {
             int scale = batch_nums[segment_id] - batch_offset;
             for (int d = 0; d < dimension_; ++d) {
               grads_sp_values[i * dimension_ + d] =
-                  grads[segment_id * dimension_ + d] / sqrtf(scale);
+                  grads[segment_id * grads_stride + d] / sqrtf(scale);
             }
 // #endif
           }
@@ -142,14 +170,24 @@ class GroupEmbeddingVarLookupGradCpuOp : public OpKernel {
   float max_norm_;
   int num_lookups_;
   int dimension_;
+  // The index of the unique_keys input of lookup 0, 1 + num_lookups after
+  // the gradient of the concat.
+  int input_base_;
+  std::vector<int> concat_positions_;
 };
 
-#define REGISTER_CPU_KERNELS(key_type, value_type) \
-  REGISTER_KERNEL_BUILDER(                         \
-      Name("GroupEmbeddingVariableLookupGrad")     \
-          .Device(DEVICE_CPU)                      \
-          .TypeConstraint<key_type>("Tkeys")       \
-          .TypeConstraint<value_type>("dtype"),    \
+#define REGISTER_CPU_KERNELS(key_type, value_type)             \
+  REGISTER_KERNEL_BUILDER(                                     \
+      Name("GroupEmbeddingVariableLookupGrad")                 \
+          .Device(DEVICE_CPU)                                  \
+          .TypeConstraint<key_type>("Tkeys")                   \
+          .TypeConstraint<value_type>("dtype"),                \
+      GroupEmbeddingVarLookupGradCpuOp<key_type, value_type>) \
+  REGISTER_KERNEL_BUILDER(                                     \
+      Name("_GroupEmbeddingVariableLookupConcatGrad")          \
+          .Device(DEVICE_CPU)                                  \
+          .TypeConstraint<key_type>("Tkeys")                   \
+          .TypeConstraint<value_type>("dtype"),                \
       GroupEmbeddingVarLookupGradCpuOp<key_type, value_type>)
 
 REGISTER_CPU_KERNELS(int32, float);
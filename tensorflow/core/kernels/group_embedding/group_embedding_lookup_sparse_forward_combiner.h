@@ -0,0 +1,287 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+=======================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_GROUP_EMBEDDING_GROUP_EMBEDDING_LOOKUP_SPARSE_FORWARD_COMBINER_H_
+#define TENSORFLOW_CORE_KERNELS_GROUP_EMBEDDING_GROUP_EMBEDDING_LOOKUP_SPARSE_FORWARD_COMBINER_H_
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#include "tensorflow/core/lib/bfloat16/bfloat16.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace group_embedding {
+
+enum class Combiner { kSum, kMean, kSqrtn };
+
+inline Combiner CombinerFromString(const std::string& combiner) {
+  if (combiner == "mean") {
+    return Combiner::kMean;
+  } else if (combiner == "sum") {
+    return Combiner::kSum;
+  }
+  return Combiner::kSqrtn;
+}
+
+// Combines the rows embeddings + indices[j] * dim, j in [0, num), weighted
+// by weights[j], into out[0, dim). Rows of bfloat16 are accumulated in
+// float.
+template <typename TIn>
+using CombineFn = void (*)(const TIn* embeddings, const int* indices,
+                           const float* weights, int num, int dim,
+                           float* out);
+
+namespace internal {
+
+inline float ToFloat(float v) { return v; }
+inline float ToFloat(bfloat16 v) { return static_cast<float>(v); }
+
+#if defined(__AVX512F__)
+inline __m512 Load16(const float* p) { return _mm512_loadu_ps(p); }
+inline __m512 Load16(const bfloat16* p) {
+  __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(v), 16));
+}
+#endif  // __AVX512F__
+
+#if defined(__AVX2__) && defined(__FMA__)
+inline __m256 Load8(const float* p) { return _mm256_loadu_ps(p); }
+inline __m256 Load8(const bfloat16* p) {
+  __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(v), 16));
+}
+#endif  // __AVX2__ && __FMA__
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+inline float32x4_t Load4(const float* p) { return vld1q_f32(p); }
+inline float32x4_t Load4(const bfloat16* p) {
+  uint16x4_t v = vld1_u16(reinterpret_cast<const uint16_t*>(p));
+  return vreinterpretq_f32_u32(vshll_n_u16(v, 16));
+}
+#endif  // __aarch64__ && __ARM_NEON
+
+// Returns the factor the weighted sum of a sample is multiplied with.
+template <Combiner combiner>
+inline float TotalWeight(const float* weights, int num) {
+  if (combiner == Combiner::kSum || num == 0) {
+    return 1.0f;
+  }
+  float total = 0.0f;
+  for (int j = 0; j < num; ++j) {
+    total = (combiner == Combiner::kMean)
+                ? total + weights[j]
+                : std::fma(weights[j], weights[j], total);
+  }
+  return (combiner == Combiner::kMean) ? total : sqrtf(total);
+}
+
+// The accumulators of a row of kDim floats live in registers, the loops
+// below have constant trip counts and are fully unrolled.
+template <Combiner combiner, int kDim, typename TIn>
+void CombineFixedDim(const TIn* embeddings, const int* indices,
+                     const float* weights, int num, int dim, float* out) {
+  const float total_weight = TotalWeight<combiner>(weights, num);
+#if defined(__AVX512F__)
+  if (kDim % 16 == 0) {
+    constexpr int kVecs = (kDim + 15) / 16;
+    __m512 acc[kVecs];
+    for (int k = 0; k < kVecs; ++k) {
+      acc[k] = _mm512_setzero_ps();
+    }
+    for (int j = 0; j < num; ++j) {
+      const TIn* row = embeddings + static_cast<int64>(indices[j]) * kDim;
+      __m512 w = _mm512_set1_ps(weights[j]);
+      for (int k = 0; k < kVecs; ++k) {
+        acc[k] = _mm512_fmadd_ps(Load16(row + k * 16), w, acc[k]);
+      }
+    }
+    __m512 total = _mm512_set1_ps(total_weight);
+    for (int k = 0; k < kVecs; ++k) {
+      _mm512_storeu_ps(out + k * 16, _mm512_div_ps(acc[k], total));
+    }
+    return;
+  }
+#endif  // __AVX512F__
+#if defined(__AVX2__) && defined(__FMA__)
+  if (kDim % 8 == 0) {
+    constexpr int kVecs = (kDim + 7) / 8;
+    __m256 acc[kVecs];
+    for (int k = 0; k < kVecs; ++k) {
+      acc[k] = _mm256_setzero_ps();
+    }
+    for (int j = 0; j < num; ++j) {
+      const TIn* row = embeddings + static_cast<int64>(indices[j]) * kDim;
+      __m256 w = _mm256_set1_ps(weights[j]);
+      for (int k = 0; k < kVecs; ++k) {
+        acc[k] = _mm256_fmadd_ps(Load8(row + k * 8), w, acc[k]);
+      }
+    }
+    __m256 total = _mm256_set1_ps(total_weight);
+    for (int k = 0; k < kVecs; ++k) {
+      _mm256_storeu_ps(out + k * 8, _mm256_div_ps(acc[k], total));
+    }
+    return;
+  }
+#endif  // __AVX2__ && __FMA__
+#if defined(__aarch64__) && defined(__ARM_NEON)
+  // NEON rather than SVE: the accumulators of SVE have no size known at
+  // compile time and can't be kept in an array.
+  if (kDim % 4 == 0) {
+    constexpr int kVecs = (kDim + 3) / 4;
+    float32x4_t acc[kVecs];
+    for (int k = 0; k < kVecs; ++k) {
+      acc[k] = vdupq_n_f32(0.0f);
+    }
+    for (int j = 0; j < num; ++j) {
+      const TIn* row = embeddings + static_cast<int64>(indices[j]) * kDim;
+      float32x4_t w = vdupq_n_f32(weights[j]);
+      for (int k = 0; k < kVecs; ++k) {
+        acc[k] = vfmaq_f32(acc[k], Load4(row + k * 4), w);
+      }
+    }
+    float32x4_t total = vdupq_n_f32(total_weight);
+    for (int k = 0; k < kVecs; ++k) {
+      vst1q_f32(out + k * 4, vdivq_f32(acc[k], total));
+    }
+    return;
+  }
+#endif  // __aarch64__ && __ARM_NEON
+  float acc[kDim] = {0.0f};
+  for (int j = 0; j < num; ++j) {
+    const TIn* row = embeddings + static_cast<int64>(indices[j]) * kDim;
+    const float w = weights[j];
+    for (int d = 0; d < kDim; ++d) {
+      acc[d] = std::fma(ToFloat(row[d]), w, acc[d]);
+    }
+  }
+  for (int d = 0; d < kDim; ++d) {
+    out[d] = acc[d] / total_weight;
+  }
+}
+
+// Any dim, accumulates into out directly.
+template <Combiner combiner, typename TIn>
+void CombineAnyDim(const TIn* embeddings, const int* indices,
+                   const float* weights, int num, int dim, float* out) {
+  const float total_weight = TotalWeight<combiner>(weights, num);
+#if defined(__AVX512F__)
+  for (int d = 0; d < dim; d += 16) {
+    int remain = dim - d;
+    __mmask16 mask = (remain >= 16 ? 0xffff : (1 << remain) - 1);
+    __m512 acc = _mm512_setzero_ps();
+    for (int j = 0; j < num; ++j) {
+      const TIn* row = embeddings + static_cast<int64>(indices[j]) * dim;
+      __m512 item;
+      if (remain >= 16) {
+        item = Load16(row + d);
+      } else {
+        float tail[16];
+        for (int k = 0; k < remain; ++k) {
+          tail[k] = ToFloat(row[d + k]);
+        }
+        item = _mm512_maskz_loadu_ps(mask, tail);
+      }
+      acc = _mm512_fmadd_ps(item, _mm512_set1_ps(weights[j]), acc);
+    }
+    acc = _mm512_div_ps(acc, _mm512_set1_ps(total_weight));
+    _mm512_mask_storeu_ps(out + d, mask, acc);
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  float32x4_t total = vdupq_n_f32(total_weight);
+  int d = 0;
+  for (; d + 4 <= dim; d += 4) {
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (int j = 0; j < num; ++j) {
+      const TIn* row = embeddings + static_cast<int64>(indices[j]) * dim;
+      acc = vfmaq_f32(acc, Load4(row + d), vdupq_n_f32(weights[j]));
+    }
+    vst1q_f32(out + d, vdivq_f32(acc, total));
+  }
+  for (; d < dim; ++d) {
+    float acc = 0.0f;
+    for (int j = 0; j < num; ++j) {
+      const TIn* row = embeddings + static_cast<int64>(indices[j]) * dim;
+      acc = std::fma(ToFloat(row[d]), weights[j], acc);
+    }
+    out[d] = acc / total_weight;
+  }
+#else
+  memset(out, 0, sizeof(float) * dim);
+  for (int j = 0; j < num; ++j) {
+    const TIn* row = embeddings + static_cast<int64>(indices[j]) * dim;
+    const float w = weights[j];
+    for (int d = 0; d < dim; ++d) {
+      out[d] = std::fma(ToFloat(row[d]), w, out[d]);
+    }
+  }
+  for (int d = 0; d < dim; ++d) {
+    out[d] /= total_weight;
+  }
+#endif  // __AVX512F__, __aarch64__ && __ARM_NEON
+}
+
+template <Combiner combiner, typename TIn>
+CombineFn<TIn> GetCombineFnForDim(int dim) {
+  switch (dim) {
+    case 8:
+      return CombineFixedDim<combiner, 8, TIn>;
+    case 16:
+      return CombineFixedDim<combiner, 16, TIn>;
+    case 32:
+      return CombineFixedDim<combiner, 32, TIn>;
+    case 64:
+      return CombineFixedDim<combiner, 64, TIn>;
+    default:
+      return CombineAnyDim<combiner, TIn>;
+  }
+}
+
+}  // namespace internal
+
+// Returns the factor the weighted sum of num rows is divided by.
+inline float TotalWeight(Combiner combiner, const float* weights, int num) {
+  switch (combiner) {
+    case Combiner::kSum:
+      return internal::TotalWeight<Combiner::kSum>(weights, num);
+    case Combiner::kMean:
+      return internal::TotalWeight<Combiner::kMean>(weights, num);
+    default:
+      return internal::TotalWeight<Combiner::kSqrtn>(weights, num);
+  }
+}
+
+// Returns the combiner kernel for rows of dim elements, dims of 8, 16, 32
+// and 64 get kernels specialized at compile time.
+template <typename TIn>
+CombineFn<TIn> GetCombineFn(Combiner combiner, int dim) {
+  switch (combiner) {
+    case Combiner::kSum:
+      return internal::GetCombineFnForDim<Combiner::kSum, TIn>(dim);
+    case Combiner::kMean:
+      return internal::GetCombineFnForDim<Combiner::kMean, TIn>(dim);
+    default:
+      return internal::GetCombineFnForDim<Combiner::kSqrtn, TIn>(dim);
+  }
+}
+
+}  // namespace group_embedding
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_GROUP_EMBEDDING_GROUP_EMBEDDING_LOOKUP_SPARSE_FORWARD_COMBINER_H_
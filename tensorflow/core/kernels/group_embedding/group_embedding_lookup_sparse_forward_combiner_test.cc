@@ -0,0 +1,147 @@
+/* Copyright 2022 The DeepRec Authors. All Rights Reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+=======================================================================*/
+
+#include "tensorflow/core/kernels/group_embedding/group_embedding_lookup_sparse_forward_combiner.h"
+
+#include <random>
+#include <vector>
+
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace group_embedding {
+namespace {
+
+const int kNumRows = 1024;
+
+template <typename TIn>
+void ReferenceCombine(Combiner combiner, const TIn* embeddings,
+                      const int* indices, const float* weights, int num,
+                      int dim, float* out) {
+  double total = 0.0;
+  for (int j = 0; j < num; ++j) {
+    total += (combiner == Combiner::kSqrtn) ? weights[j] * weights[j]
+                                            : weights[j];
+  }
+  if (combiner == Combiner::kSum || num == 0) {
+    total = 1.0;
+  } else if (combiner == Combiner::kSqrtn) {
+    total = std::sqrt(total);
+  }
+  for (int d = 0; d < dim; ++d) {
+    double acc = 0.0;
+    for (int j = 0; j < num; ++j) {
+      acc += static_cast<float>(embeddings[indices[j] * dim + d]) *
+             weights[j];
+    }
+    out[d] = acc / total;
+  }
+}
+
+template <typename TIn>
+void TestCombiner(Combiner combiner, int dim, int num) {
+  std::mt19937 gen(dim * 131 + num);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  std::uniform_int_distribution<int> row_dist(0, kNumRows - 1);
+  std::vector<TIn> embeddings(kNumRows * dim);
+  for (auto& v : embeddings) {
+    v = static_cast<TIn>(dist(gen));
+  }
+  std::vector<int> indices(num);
+  std::vector<float> weights(num);
+  for (int j = 0; j < num; ++j) {
+    indices[j] = row_dist(gen);
+    weights[j] = dist(gen) + 2.0f;
+  }
+  std::vector<float> expected(dim);
+  std::vector<float> actual(dim, -1.0f);
+  ReferenceCombine(combiner, embeddings.data(), indices.data(),
+                   weights.data(), num, dim, expected.data());
+  GetCombineFn<TIn>(combiner, dim)(embeddings.data(), indices.data(),
+                                   weights.data(), num, dim, actual.data());
+  for (int d = 0; d < dim; ++d) {
+    EXPECT_NEAR(expected[d], actual[d], 1e-4)
+        << "dim: " << dim << ", num: " << num << ", d: " << d;
+  }
+}
+
+template <typename TIn>
+void TestAllCombiners() {
+  for (Combiner combiner :
+       {Combiner::kSum, Combiner::kMean, Combiner::kSqrtn}) {
+    for (int dim : {4, 8, 12, 16, 24, 32, 64, 100}) {
+      for (int num : {0, 1, 7, 50}) {
+        TestCombiner<TIn>(combiner, dim, num);
+      }
+    }
+  }
+}
+
+TEST(GroupEmbeddingCombinerTest, Float) { TestAllCombiners<float>(); }
+
+TEST(GroupEmbeddingCombinerTest, BFloat16) { TestAllCombiners<bfloat16>(); }
+
+TEST(GroupEmbeddingCombinerTest, CombinerFromString) {
+  EXPECT_EQ(CombinerFromString("sum"), Combiner::kSum);
+  EXPECT_EQ(CombinerFromString("mean"), Combiner::kMean);
+  EXPECT_EQ(CombinerFromString("sqrtn"), Combiner::kSqrtn);
+}
+
+// Combines batch_size samples of 20 rows each, as the lookup op does.
+template <typename TIn>
+void BM_Combine(int iters, int dim, bool specialized) {
+  testing::StopTiming();
+  const int batch_size = 1024;
+  const int num = 20;
+  std::mt19937 gen(dim);
+  std::uniform_int_distribution<int> row_dist(0, kNumRows - 1);
+  std::vector<TIn> embeddings(kNumRows * dim, static_cast<TIn>(0.5f));
+  std::vector<int> indices(batch_size * num);
+  for (auto& idx : indices) {
+    idx = row_dist(gen);
+  }
+  std::vector<float> weights(batch_size * num, 1.0f);
+  std::vector<float> out(batch_size * dim);
+  CombineFn<TIn> combine =
+      specialized ? GetCombineFn<TIn>(Combiner::kMean, dim)
+                  : internal::CombineAnyDim<Combiner::kMean, TIn>;
+  testing::StartTiming();
+  for (int it = 0; it < iters; ++it) {
+    for (int i = 0; i < batch_size; ++i) {
+      combine(embeddings.data(), indices.data() + i * num,
+              weights.data() + i * num, num, dim, out.data() + i * dim);
+    }
+  }
+  testing::StopTiming();
+  testing::ItemsProcessed(static_cast<int64>(iters) * batch_size * num);
+}
+
+static void BM_CombineFloat(int iters, int dim) {
+  BM_Combine<float>(iters, dim, true);
+}
+
+static void BM_CombineFloatAnyDim(int iters, int dim) {
+  BM_Combine<float>(iters, dim, false);
+}
+
+static void BM_CombineBFloat16(int iters, int dim) {
+  BM_Combine<bfloat16>(iters, dim, true);
+}
+
+BENCHMARK(BM_CombineFloat)->Arg(8)->Arg(16)->Arg(32)->Arg(64);
+BENCHMARK(BM_CombineFloatAnyDim)->Arg(8)->Arg(16)->Arg(32)->Arg(64);
+BENCHMARK(BM_CombineBFloat16)->Arg(8)->Arg(16)->Arg(32)->Arg(64);
+
+}  // namespace
+}  // namespace group_embedding
+}  // namespace tensorflow
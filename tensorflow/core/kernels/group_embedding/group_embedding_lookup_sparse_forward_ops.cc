@@ -12,7 +12,12 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#if defined(__x86_64__)
 #include <immintrin.h>
+#endif
+
+#include <unordered_map>
+#include <vector>
 
 #include "tensorflow/core/framework/embedding/cache.h"
 #include "tensorflow/core/framework/embedding/embedding_var.h"
@@ -21,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/kernels/group_embedding/group_embedding_lookup_sparse_forward_base_ops.h"
+#include "tensorflow/core/kernels/group_embedding/group_embedding_lookup_sparse_forward_combiner.h"
 #include "tensorflow/core/util/work_sharder.h"
 namespace tensorflow {
 
@@ -32,7 +38,14 @@ namespace tensorflow {
 
 using CPUDevice = Eigen::ThreadPoolDevice;
 
-template <typename TKey, typename TValue>
+// With output_pointer, the value pointers of the unique keys are created in
+// the forward pass and output, so that the _OPT_ optimizer ops can update
+// them without probing the hash map again.
+//
+// As _GroupEmbeddingVarLookupConcat, the combiners write the rows of every
+// lookup to its columns of the concat of the outputs, output 0, whose
+// other outputs are shifted accordingly.
+template <typename TKey, typename TValue, bool output_pointer>
 class GroupEmbeddingVariableLookupCpuOp
     : public GroupLookupBaseCpuOp<TKey, TValue> {
   USING_BASE_CLASS_MEMBER
@@ -43,6 +56,17 @@ class GroupEmbeddingVariableLookupCpuOp
 
     OP_REQUIRES_OK(c, c->GetAttr("is_use_default_value_tensor",
                                  &m_is_use_default_value_tensor));
+    m_output_base = m_num_lookup;
+    if (c->HasAttr("concat_positions")) {
+      OP_REQUIRES_OK(c, c->GetAttr("concat_positions", &m_concat_positions));
+      OP_REQUIRES(c, m_concat_positions.size() == m_num_lookup,
+                  errors::InvalidArgument(
+                      "concat_positions must have num_lookups elements"));
+      OP_REQUIRES(c, !m_is_sequence,
+                  errors::InvalidArgument(
+                      "The outputs of sequence lookups are not concatenated"));
+      m_output_base = 1;
+    }
   }
 
   void Compute(OpKernelContext *ctx) override {
@@ -50,329 +74,454 @@ class GroupEmbeddingVariableLookupCpuOp
       step 1: unique and assign unique output and index
       step 2: doing unique value gather
       step 3: assign unique embedding to batch result and pooling
+      The lookups of the same EmbeddingVar are planned as a group, see
+      ComputeGroup.
     */
-    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
-
+    std::vector<core::RefCountPtr<EmbeddingVar<TKey, TValue>>> embedding_vars(
+        m_num_lookup);
+    std::vector<std::vector<int>> groups;
+    std::unordered_map<EmbeddingVar<TKey, TValue> *, int> group_of;
     for (int i = 0; i < m_num_lookup; ++i) {
-      EmbeddingVar<TKey, TValue> *embedding_var = nullptr;
-      OP_REQUIRES_OK(
-          ctx, LookupResource(ctx, HandleFromInput(ctx, i), &embedding_var));
-      core::ScopedUnref unref_me(embedding_var);
+      OP_REQUIRES_OK(ctx, LookupResource(ctx, HandleFromInput(ctx, i),
+                                         &embedding_vars[i]));
+      auto it = group_of.emplace(embedding_vars[i].get(), groups.size());
+      if (it.second) {
+        groups.emplace_back();
+      }
+      groups[it.first->second].push_back(i);
+    }
 
-      const Tensor &sp_values_tensor = ctx->input(m_num_lookup + i);
-      const Tensor &sp_indices_tensor = ctx->input(m_num_lookup * 2 + i);
-      auto sp_indices = sp_indices_tensor.flat<int64>().data();
-      int nnz = sp_values_tensor.NumElements();
-      const Tensor &dense_shape_tensor = ctx->input(m_num_lookup * 4 + i);
-      auto dense_shape = dense_shape_tensor.flat<int64>().data();
-      int64 batch_size = dense_shape[0];
+    Tensor *concat_output = nullptr;
+    if (!m_concat_positions.empty()) {
+      const int64 batch_size = ctx->input(m_num_lookup * 4).flat<int64>()(0);
+      for (int i = 0; i < m_num_lookup; ++i) {
+        OP_REQUIRES(ctx,
+                    ctx->input(m_num_lookup * 4 + i).flat<int64>()(0) ==
+                        batch_size,
+                    errors::InvalidArgument(
+                        "The batch sizes of concatenated lookups differ"));
+      }
+      OP_REQUIRES_OK(ctx, ctx->allocate_output(
+                              0, TensorShape({batch_size,
+                                              m_num_lookup * m_dimension}),
+                              &concat_output));
+    }
 
-      OP_REQUIRES(
-          ctx,
-          !embedding_var->IsMultiLevel() || (embedding_var->IsMultiLevel() &&
-                                             embedding_var->CacheSize() >= nnz),
-          errors::InvalidArgument("MultiLevel EV's Cache size ",
-                                  embedding_var->CacheSize(),
-                                  " should large than IDs in batch ", nnz));
+    for (const std::vector<int> &lookups : groups) {
+      EmbeddingVar<TKey, TValue> *embedding_var =
+          embedding_vars[lookups[0]].get();
+      // The default value tensor is per position of a lookup, which a
+      // lookup of the group has not.
+      if (lookups.size() > 1 && !m_is_use_default_value_tensor) {
+        ComputeGroup(ctx, lookups, embedding_var, concat_output);
+      } else {
+        for (int i : lookups) {
+          ComputeLookup(ctx, i, embedding_var, concat_output);
+          if (!ctx->status().ok()) return;
+        }
+      }
+      if (!ctx->status().ok()) return;
+    }
+  }
 
-      // Stage 1
-      Tensor unique_idx_tensor;
-      Tensor unique_tensor;
-      Tensor unique_counter;
+ private:
+  void ComputeLookup(OpKernelContext *ctx, int i,
+                     EmbeddingVar<TKey, TValue> *embedding_var,
+                     Tensor *concat_output) {
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    const Tensor &sp_values_tensor = ctx->input(m_num_lookup + i);
+    int nnz = sp_values_tensor.NumElements();
+
+    OP_REQUIRES(
+        ctx,
+        !embedding_var->IsMultiLevel() || (embedding_var->IsMultiLevel() &&
+                                           embedding_var->CacheSize() >= nnz),
+        errors::InvalidArgument("MultiLevel EV's Cache size ",
+                                embedding_var->CacheSize(),
+                                " should large than IDs in batch ", nnz));
+
+    // Stage 1
+    Tensor unique_idx_tensor;
+    Tensor unique_tensor;
+    Tensor unique_counter;
+
+    UniqueWithoutAxis<TKey, int32>(ctx, sp_values_tensor, &unique_idx_tensor,
+                                   &unique_tensor, &unique_counter, 0,
+                                   this->partition_size_, this->serial_,
+                                   this->unique_ratio_hint_, this->map_flag_);
+
+    ctx->set_output(m_output_base + i, unique_tensor);
+    ctx->set_output(m_output_base + m_num_lookup + i, unique_idx_tensor);
+
+    auto *unique = unique_tensor.flat<TKey>().data();
+    auto *unique_idx = unique_idx_tensor.flat<int>().data();
+
+    int unique_nnz = unique_tensor.shape().dim_size(0);
+    TensorShape unique_shape{static_cast<int64>(unique_nnz)};
+
+    const int *batch_nums = ComputeBatchNums(ctx, i, nnz);
+    if (!ctx->status().ok()) return;
+
+    // Stage 2
+    // The rows of quantized EVs are not gathered, stage 3 dequantizes
+    // them in the combiner.
+    const bool is_quantized = embedding_var->IsQuantized() &&
+        !m_is_use_default_value_tensor && !output_pointer;
+    std::vector<ValuePtr<TValue> *> quantized_ptrs;
+    Tensor unique_embedding;
+    TValue *unique_embedding_data = nullptr;
+    EmbeddingVarContext<CPUDevice> ev_ctx(ctx); 
+    if (!is_quantized) {
+      unique_shape.AppendShape({static_cast<int64>(m_dimension)});
+      AllocatorAttributes attr;
+      attr.set_on_host(true);
+      OP_REQUIRES_OK(
+          ctx, ctx->allocate_temp(DataTypeToEnum<TValue>::v(), unique_shape,
+                                  &unique_embedding, attr));
+      unique_embedding_data = unique_embedding.flat<TValue>().data();
+    }
+    if (is_quantized) {
+      quantized_ptrs.resize(unique_nnz);
+      auto lookup = [embedding_var, unique, &quantized_ptrs](int64 start,
+                                                             int64 end) {
+        embedding_var->BatchLookupKey(unique + start,
+                                      quantized_ptrs.data() + start,
+                                      end - start);
+      };
+      Shard(worker_threads->num_threads, worker_threads->workers,
+            unique_nnz, 1000 /*cost*/, lookup);
+    } else if (m_is_use_default_value_tensor) {
+      embedding_var->GetEmbeddings(ev_ctx, unique, unique_embedding_data,
+          unique_nnz, reinterpret_cast<TValue *>(ctx->input(m_num_lookup * 4 + 1).data()));
+    } else if (output_pointer) {
+      Tensor *pointer_tensor = nullptr;
+      OP_REQUIRES_OK(ctx, ctx->allocate_output(
+                              m_output_base + 3 * m_num_lookup + i,
+                              unique_tensor.shape(), &pointer_tensor));
+      auto value_ptrs = reinterpret_cast<ValuePtr<TValue> **>(
+          pointer_tensor->flat<int64>().data());
+      embedding_var->GetOrCreateKey(ev_ctx, unique_tensor, value_ptrs,
+                                    unique_nnz);
+      embedding_var->GatherEmbeddings(ev_ctx, unique_tensor, value_ptrs,
+                                      unique_embedding_data, unique_nnz);
+    } else {
+      embedding_var->GetEmbeddings(ev_ctx, unique, unique_embedding_data, unique_nnz);
+      embedding_var->UpdateCache(unique_tensor, unique_counter, true/*called_by_gather*/);
+    }
 
-      UniqueWithoutAxis<TKey, int32>(ctx, sp_values_tensor, &unique_idx_tensor,
-                                     &unique_tensor, &unique_counter, 0,
-                                     this->partition_size_, this->serial_,
-                                     this->unique_ratio_hint_, this->map_flag_);
+    // Stage 3
+    Combine(ctx, i, nnz, batch_nums, unique_idx, unique_embedding_data,
+            unique, quantized_ptrs.data(), is_quantized, embedding_var,
+            concat_output);
+  }
 
-      ctx->set_output(m_num_lookup + i, unique_tensor);
-      ctx->set_output(2 * m_num_lookup + i, unique_idx_tensor);
+  // Looks up the lookups of one EmbeddingVar, e.g. the features sharing an
+  // embedding table, together: their IDs are concatenated, deduplicated by
+  // one unique and looked up once, and the rows of the group are combined
+  // for each lookup. The unique keys and the unique indices of each lookup,
+  // which the backward and the optimizers expect per lookup, are derived
+  // from the ones of the group.
+  void ComputeGroup(OpKernelContext *ctx, const std::vector<int> &lookups,
+                    EmbeddingVar<TKey, TValue> *embedding_var,
+                    Tensor *concat_output) {
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    const int num_group_lookups = lookups.size();
+    std::vector<int64> offsets(num_group_lookups + 1, 0);
+    for (int g = 0; g < num_group_lookups; ++g) {
+      offsets[g + 1] =
+          offsets[g] + ctx->input(m_num_lookup + lookups[g]).NumElements();
+    }
+    Tensor group_values_tensor;
+    OP_REQUIRES_OK(ctx, ctx->allocate_temp(DataTypeToEnum<TKey>::v(),
+                                           TensorShape({offsets.back()}),
+                                           &group_values_tensor));
+    auto *group_values = group_values_tensor.flat<TKey>().data();
+    for (int g = 0; g < num_group_lookups; ++g) {
+      const Tensor &sp_values_tensor = ctx->input(m_num_lookup + lookups[g]);
+      memcpy(group_values + offsets[g], sp_values_tensor.flat<TKey>().data(),
+             sp_values_tensor.NumElements() * sizeof(TKey));
+    }
 
-      auto *unique = unique_tensor.flat<TKey>().data();
-      auto *unique_idx = unique_idx_tensor.flat<int>().data();
+    // Stage 1
+    Tensor group_idx_tensor;
+    Tensor group_unique_tensor;
+    Tensor group_counter;
+    UniqueWithoutAxis<TKey, int32>(ctx, group_values_tensor, &group_idx_tensor,
+                                   &group_unique_tensor, &group_counter, 0,
+                                   this->partition_size_, this->serial_,
+                                   this->unique_ratio_hint_, this->map_flag_);
+    if (!ctx->status().ok()) return;
+    auto *group_unique = group_unique_tensor.flat<TKey>().data();
+    auto *group_idx = group_idx_tensor.flat<int>().data();
+    const int group_unique_nnz = group_unique_tensor.dim_size(0);
+
+    OP_REQUIRES(
+        ctx,
+        !embedding_var->IsMultiLevel() ||
+            embedding_var->CacheSize() >= group_unique_nnz,
+        errors::InvalidArgument("MultiLevel EV's Cache size ",
+                                embedding_var->CacheSize(),
+                                " should large than IDs in batch ",
+                                group_unique_nnz));
+
+    // The unique keys of a lookup are its group unique keys in the order of
+    // their first occurrence, as the ones of UniqueWithoutAxis.
+    std::vector<std::vector<int>> positions(num_group_lookups);
+    std::vector<Tensor> unique_tensors(num_group_lookups);
+    std::vector<Tensor> unique_idx_tensors(num_group_lookups);
+    std::vector<int> remap(group_unique_nnz, -1);
+    for (int g = 0; g < num_group_lookups; ++g) {
+      const int i = lookups[g];
+      const int64 nnz = offsets[g + 1] - offsets[g];
+      OP_REQUIRES_OK(ctx, ctx->allocate_temp(DT_INT32, TensorShape({nnz}),
+                                             &unique_idx_tensors[g]));
+      auto *unique_idx = unique_idx_tensors[g].flat<int>().data();
+      std::vector<int> &position = positions[g];
+      for (int64 k = 0; k < nnz; ++k) {
+        const int p = group_idx[offsets[g] + k];
+        if (remap[p] < 0) {
+          remap[p] = position.size();
+          position.push_back(p);
+        }
+        unique_idx[k] = remap[p];
+      }
+      for (int p : position) {
+        remap[p] = -1;
+      }
+      OP_REQUIRES_OK(ctx, ctx->allocate_temp(
+                              DataTypeToEnum<TKey>::v(),
+                              TensorShape({static_cast<int64>(position.size())}),
+                              &unique_tensors[g]));
+      auto *unique = unique_tensors[g].flat<TKey>().data();
+      for (size_t j = 0; j < position.size(); ++j) {
+        unique[j] = group_unique[position[j]];
+      }
+      ctx->set_output(m_output_base + i, unique_tensors[g]);
+      ctx->set_output(m_output_base + m_num_lookup + i,
+                      unique_idx_tensors[g]);
+    }
 
-      int unique_nnz = unique_tensor.shape().dim_size(0);
-      TensorShape unique_shape{static_cast<int64>(unique_nnz)};
+    // Stage 2
+    const bool is_quantized = embedding_var->IsQuantized() && !output_pointer;
+    std::vector<ValuePtr<TValue> *> group_ptrs;
+    Tensor group_embedding;
+    TValue *group_embedding_data = nullptr;
+    EmbeddingVarContext<CPUDevice> ev_ctx(ctx);
+    if (is_quantized) {
+      group_ptrs.resize(group_unique_nnz);
+      auto lookup = [embedding_var, group_unique, &group_ptrs](int64 start,
+                                                               int64 end) {
+        embedding_var->BatchLookupKey(group_unique + start,
+                                      group_ptrs.data() + start, end - start);
+      };
+      Shard(worker_threads->num_threads, worker_threads->workers,
+            group_unique_nnz, 1000 /*cost*/, lookup);
+    } else if (output_pointer) {
+      group_ptrs.resize(group_unique_nnz);
+      embedding_var->GetOrCreateKey(ev_ctx, group_unique_tensor,
+                                    group_ptrs.data(), group_unique_nnz);
+    } else {
+      AllocatorAttributes attr;
+      attr.set_on_host(true);
+      OP_REQUIRES_OK(ctx, ctx->allocate_temp(
+                              DataTypeToEnum<TValue>::v(),
+                              TensorShape({group_unique_nnz, m_dimension}),
+                              &group_embedding, attr));
+      group_embedding_data = group_embedding.flat<TValue>().data();
+      embedding_var->GetEmbeddings(ev_ctx, group_unique, group_embedding_data,
+                                   group_unique_nnz);
+      embedding_var->UpdateCache(group_unique_tensor, group_counter,
+                                 true /*called_by_gather*/);
+    }
 
-      TensorShape batch_nums_tensor_shape =
-          TensorShape(std::vector<int64>({batch_size}));
-      Tensor *batch_nums_tensor = nullptr;
-      // allocate output
-      OP_REQUIRES_OK(ctx, ctx->allocate_output(3 * m_num_lookup + i,
-                                               batch_nums_tensor_shape,
-                                               &batch_nums_tensor));
-      auto batch_nums = batch_nums_tensor->flat<int>().data();
-      memset(batch_nums, 0, batch_size * sizeof(int));
-      for (int k = 0; k < nnz; ++k) {
-        int batch_id = sp_indices[k * dense_shape_tensor.NumElements()];
-        batch_nums[batch_id] += 1;
+    // Stage 3
+    for (int g = 0; g < num_group_lookups; ++g) {
+      const int i = lookups[g];
+      const int64 nnz = offsets[g + 1] - offsets[g];
+      const int *batch_nums = ComputeBatchNums(ctx, i, nnz);
+      if (!ctx->status().ok()) return;
+      if (!output_pointer) {
+        Combine(ctx, i, nnz, batch_nums, group_idx + offsets[g],
+                group_embedding_data, group_unique, group_ptrs.data(),
+                is_quantized, embedding_var, concat_output);
+        if (!ctx->status().ok()) return;
+        continue;
       }
-      for (int k = 1; k < batch_size; ++k) {
-        batch_nums[k] += batch_nums[k - 1];
+      // The rows are gathered per lookup, which counts the frequency of a
+      // key once per lookup as without the group.
+      const Tensor &unique_tensor = unique_tensors[g];
+      const int64 unique_nnz = unique_tensor.NumElements();
+      Tensor *pointer_tensor = nullptr;
+      OP_REQUIRES_OK(ctx, ctx->allocate_output(
+                              m_output_base + 3 * m_num_lookup + i,
+                              unique_tensor.shape(), &pointer_tensor));
+      auto value_ptrs = reinterpret_cast<ValuePtr<TValue> **>(
+          pointer_tensor->flat<int64>().data());
+      for (int64 j = 0; j < unique_nnz; ++j) {
+        value_ptrs[j] = group_ptrs[positions[g][j]];
       }
-
-      // Stage 2
       Tensor unique_embedding;
-      unique_shape.AppendShape({static_cast<int64>(m_dimension)});
       AllocatorAttributes attr;
       attr.set_on_host(true);
-      OP_REQUIRES_OK(
-          ctx, ctx->allocate_temp(DataTypeToEnum<TValue>::v(), unique_shape,
-                                  &unique_embedding, attr));
-      auto unique_embedding_data = unique_embedding.flat<TValue>().data();
-      EmbeddingVarContext<CPUDevice> ev_ctx(ctx); 
-      if (m_is_use_default_value_tensor) {
-        embedding_var->GetEmbeddings(ev_ctx, unique, unique_embedding_data,
-            unique_nnz, reinterpret_cast<TValue *>(ctx->input(m_num_lookup * 4 + 1).data()));
-      } else {
-        embedding_var->GetEmbeddings(ev_ctx, unique, unique_embedding_data, unique_nnz);
-        embedding_var->UpdateCache(unique_tensor, unique_counter, true/*called_by_gather*/);
-      }
+      OP_REQUIRES_OK(ctx, ctx->allocate_temp(
+                              DataTypeToEnum<TValue>::v(),
+                              TensorShape({unique_nnz, m_dimension}),
+                              &unique_embedding, attr));
+      auto *unique_embedding_data = unique_embedding.flat<TValue>().data();
+      embedding_var->GatherEmbeddings(ev_ctx, unique_tensor, value_ptrs,
+                                      unique_embedding_data, unique_nnz);
+      Combine(ctx, i, nnz, batch_nums, unique_idx_tensors[g].flat<int>().data(),
+              unique_embedding_data, unique_tensor.flat<TKey>().data(),
+              nullptr, false, embedding_var, concat_output);
+      if (!ctx->status().ok()) return;
+    }
+  }
 
-      std::vector<TValue> default_weights(nnz, 1.0);
-      TValue *sp_weights = default_weights.data();
-      if (!this->m_ignore_weights) {
-        const Tensor &sp_weights_tensor =
-            ctx->input(this->m_num_lookup * 3 + i);
-        sp_weights =
-            const_cast<TValue *>(sp_weights_tensor.flat<TValue>().data());
-      }
+  // Allocates and returns the batch_nums output of lookup i, the end of the
+  // IDs of each sample, or null on error.
+  int *ComputeBatchNums(OpKernelContext *ctx, int i, int64 nnz) {
+    const Tensor &sp_indices_tensor = ctx->input(m_num_lookup * 2 + i);
+    auto sp_indices = sp_indices_tensor.flat<int64>().data();
+    const Tensor &dense_shape_tensor = ctx->input(m_num_lookup * 4 + i);
+    int64 batch_size = dense_shape_tensor.flat<int64>().data()[0];
+
+    TensorShape batch_nums_tensor_shape =
+        TensorShape(std::vector<int64>({batch_size}));
+    Tensor *batch_nums_tensor = nullptr;
+    // allocate output
+    Status s = ctx->allocate_output(m_output_base + 2 * m_num_lookup + i,
+                                    batch_nums_tensor_shape,
+                                    &batch_nums_tensor);
+    if (!s.ok()) {
+      ctx->CtxFailureWithWarning(__FILE__, __LINE__, s);
+      return nullptr;
+    }
+    auto batch_nums = batch_nums_tensor->flat<int>().data();
+    memset(batch_nums, 0, batch_size * sizeof(int));
+    for (int k = 0; k < nnz; ++k) {
+      int batch_id = sp_indices[k * dense_shape_tensor.NumElements()];
+      batch_nums[batch_id] += 1;
+    }
+    for (int k = 1; k < batch_size; ++k) {
+      batch_nums[k] += batch_nums[k - 1];
+    }
+    return batch_nums;
+  }
 
-      // Stage 3
-      TensorShape emb_vectors_tensor_shape;
-      // Special case for sequence categorical column output
-      if (m_is_sequence) {
-        emb_vectors_tensor_shape = TensorShape(
-            std::vector<int64>({batch_size, dense_shape[1], m_dimension}));
-      } else {
-        emb_vectors_tensor_shape =
-            TensorShape(std::vector<int64>({batch_size, m_dimension}));
-      }
+  // Combines the rows of the IDs of each sample of lookup i into output i,
+  // or into its columns of concat_output unless null, the rows of the j-th
+  // ID being the unique_idx[j]-th ones of unique_embedding_data, or of
+  // quantized_ptrs if is_quantized.
+  void Combine(OpKernelContext *ctx, int i, int64 nnz, const int *batch_nums,
+               const int *unique_idx, const TValue *unique_embedding_data,
+               const TKey *unique, ValuePtr<TValue> *const *quantized_ptrs,
+               bool is_quantized, EmbeddingVar<TKey, TValue> *embedding_var,
+               Tensor *concat_output) {
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    const Tensor &dense_shape_tensor = ctx->input(m_num_lookup * 4 + i);
+    auto dense_shape = dense_shape_tensor.flat<int64>().data();
+    int64 batch_size = dense_shape[0];
+
+    std::vector<TValue> default_weights(nnz, 1.0);
+    TValue *sp_weights = default_weights.data();
+    if (!this->m_ignore_weights) {
+      const Tensor &sp_weights_tensor =
+          ctx->input(this->m_num_lookup * 3 + i);
+      sp_weights =
+          const_cast<TValue *>(sp_weights_tensor.flat<TValue>().data());
+    }
+
+    TensorShape emb_vectors_tensor_shape;
+    // Special case for sequence categorical column output
+    if (m_is_sequence) {
+      emb_vectors_tensor_shape = TensorShape(
+          std::vector<int64>({batch_size, dense_shape[1], m_dimension}));
+    } else {
+      emb_vectors_tensor_shape =
+          TensorShape(std::vector<int64>({batch_size, m_dimension}));
+    }
+    // The rows of the samples are out_stride apart in the concat.
+    TValue *gather_embedding = nullptr;
+    int64 out_stride = m_dimension;
+    if (concat_output != nullptr) {
+      Tensor *output_shape_tensor = nullptr;
+      OP_REQUIRES_OK(ctx, ctx->allocate_output(
+                              m_output_base + 3 * m_num_lookup + i,
+                              TensorShape({2}), &output_shape_tensor));
+      output_shape_tensor->flat<int32>()(0) = batch_size;
+      output_shape_tensor->flat<int32>()(1) = m_dimension;
+      out_stride = m_num_lookup * m_dimension;
+      gather_embedding = concat_output->flat<TValue>().data() +
+                         m_concat_positions[i] * m_dimension;
+    } else {
       Tensor *gather_embedding_tensor = nullptr;
       // allocate output
       OP_REQUIRES_OK(ctx, ctx->allocate_output(i, emb_vectors_tensor_shape,
                                                &gather_embedding_tensor));
-      auto gather_embedding = gather_embedding_tensor->flat<TValue>().data();
-
-      int slice_bytes = nnz / batch_size * m_dimension * 1000;
-      // todo: clean these redundant code
-      if (this->m_combiner == "mean") {
-        auto embedding_var_mean_combiner = [this, &gather_embedding, batch_nums,
-                                            unique_idx, unique,
-                                            unique_embedding_data, sp_weights](
-                                               int64 start, int64 end) {
-          for (int64 i = start; i < end; ++i) {
-#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
-            __m512 batch_total_weights = _mm512_set1_ps(0.0f);
-            int tmp_length = (m_dimension + 15) / 16;
-            __m512 tmp_embedding[tmp_length];
-            for (int i = 0; i < tmp_length; ++i) {
-              tmp_embedding[i] = _mm512_set1_ps(0.0f);
-            }
-            int batch_offset = i == 0 ? 0 : batch_nums[i - 1];
-            int batch_num = batch_nums[i] - batch_offset;
-            for (int j = 0; j < batch_num; ++j) {
-              int unique_indice = unique_idx[batch_offset + j];
-              float *u_embedding =
-                  unique_embedding_data + unique_indice * m_dimension;
-              __m512 _weights =
-                  _mm512_set1_ps(*(sp_weights + batch_offset + j));
-              batch_total_weights = _mm512_add_ps(batch_total_weights, _weights);
-              for (int d = 0; d < m_dimension; d += 16) {
-                int index = d / 16;
-                int remain = m_dimension - d;
-                __mmask16 mask = (remain >= 16 ? 0xffff : (1 << remain) - 1);
-                __m512 _item = _mm512_maskz_loadu_ps(mask, u_embedding + d);
-                tmp_embedding[index] = _mm512_mask3_fmadd_ps(
-                    _item, _weights, tmp_embedding[index], mask);
-              }
-            }
-
-            if (batch_num == 0) batch_total_weights = _mm512_set1_ps(1.0f);
-            for (int d = 0; d < m_dimension; d += 16) {
-              int index = d / 16;
-              int remain = m_dimension - d;
-              __mmask16 mask = (remain >= 16 ? 0xffff : (1 << remain) - 1);
-              tmp_embedding[index] = _mm512_div_ps(tmp_embedding[index], batch_total_weights);
-              _mm512_mask_storeu_ps(gather_embedding + i * m_dimension + d,
-                                    mask, tmp_embedding[index]);
-            }
-#else
-            TValue batch_total_weights = 0.0f;
-            std::vector<TValue> tmp_embedding(m_dimension, 0.0f);
-            int batch_offset = i == 0 ? 0 : batch_nums[i - 1];
-            int batch_num = batch_nums[i] - batch_offset;
-            for (int j = 0; j < batch_num; ++j) {
-              int unique_indice = unique_idx[batch_offset + j];
-              float *u_embedding =
-                  unique_embedding_data + unique_indice * m_dimension;
-              TValue sp_weight = sp_weights[batch_offset + j];
-              batch_total_weights += sp_weight;
-              for (int d = 0; d < m_dimension; ++d) {
-                tmp_embedding[d] =
-                    std::fma(*(u_embedding + d), sp_weight, tmp_embedding[d]);
-              }
-            }
-
-            for (int d = 0; d < m_dimension; ++d) {
-              tmp_embedding[d] /= batch_total_weights;
-            }
-
-            memcpy(gather_embedding + i * m_dimension, tmp_embedding.data(),
-                   sizeof(float) * m_dimension);
-#endif
-          }
-        };
-        Shard(worker_threads->num_threads, worker_threads->workers, batch_size,
-              slice_bytes /*cost*/, embedding_var_mean_combiner);
-      } else if (this->m_combiner == "sum") {
-        auto embedding_var_sum_combiner = [this, &gather_embedding, batch_nums,
-                                           unique_idx, unique,
-                                           unique_embedding_data,
-                                           sp_weights](int64 start, int64 end) {
-          for (int64 i = start; i < end; ++i) {
-#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
-            int tmp_length = (m_dimension + 15) / 16;
-            __m512 tmp_embedding[tmp_length];
-            for (int i = 0; i < tmp_length; ++i) {
-              tmp_embedding[i] = _mm512_set1_ps(0.0f);
-            }
-            int batch_offset = i == 0 ? 0 : batch_nums[i - 1];
-            int batch_num = batch_nums[i] - batch_offset;
-            for (int j = 0; j < batch_num; ++j) {
-              int unique_indice = unique_idx[batch_offset + j];
-              float *u_embedding =
-                  unique_embedding_data + unique_indice * m_dimension;
-              __m512 _weights =
-                  _mm512_set1_ps(*(sp_weights + batch_offset + j));
-              for (int d = 0; d < m_dimension; d += 16) {
-                int index = d / 16;
-                int remain = m_dimension - d;
-                __mmask16 mask = (remain >= 16 ? 0xffff : (1 << remain) - 1);
-                __m512 _item = _mm512_maskz_loadu_ps(mask, u_embedding + d);
-                tmp_embedding[index] = _mm512_mask3_fmadd_ps(
-                    _item, _weights, tmp_embedding[index], mask);
-              }
-            }
-            for (int d = 0; d < m_dimension; d += 16) {
-              int index = d / 16;
-              int remain = m_dimension - d;
-              __mmask16 mask = (remain >= 16 ? 0xffff : (1 << remain) - 1);
-              _mm512_mask_storeu_ps(gather_embedding + i * m_dimension + d,
-                                    mask, tmp_embedding[index]);
-            }
-#else
-            std::vector<TValue> tmp_embedding(m_dimension, 0.0f);
-            int batch_offset = i == 0 ? 0 : batch_nums[i - 1];
-            int batch_num = batch_nums[i] - batch_offset;
-            for (int j = 0; j < batch_num; ++j) {
-              int unique_indice = unique_idx[batch_offset + j];
-              float *u_embedding =
-                  unique_embedding_data + unique_indice * m_dimension;
-              for (int d = 0; d < m_dimension; ++d) {
-                tmp_embedding[d] =
-                    std::fma(u_embedding[d], sp_weights[batch_offset + j],
-                             tmp_embedding[d]);
-              }
-            }
-            memcpy(gather_embedding + i * m_dimension, tmp_embedding.data(),
-                   sizeof(float) * m_dimension);
-#endif
-          }
-        };
-        Shard(worker_threads->num_threads, worker_threads->workers, batch_size,
-              slice_bytes /*cost*/, embedding_var_sum_combiner);
-      } else {
-        auto embedding_var_sqrtn_combiner = [this, &gather_embedding,
-                                             batch_nums, unique_idx, unique,
-                                             unique_embedding_data, sp_weights](
-                                                int64 start, int64 end) {
-          for (int64 i = start; i < end; ++i) {
-#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
-            TValue batch_total_weights = 0.0f;
-            int tmp_length = (m_dimension + 15) / 16;
-            __m512 tmp_embedding[tmp_length];
-            for (int i = 0; i < tmp_length; ++i) {
-              tmp_embedding[i] = _mm512_set1_ps(0.0f);
-            }
-            int batch_offset = i == 0 ? 0 : batch_nums[i - 1];
-            int batch_num = batch_nums[i] - batch_offset;
-            for (int j = 0; j < batch_num; ++j) {
-              int unique_indice = unique_idx[batch_offset + j];
-              float *u_embedding =
-                  unique_embedding_data + unique_indice * m_dimension;
-	      TValue local_weight = *(sp_weights + batch_offset + j);
-              __m512 _weights = _mm512_set1_ps(local_weight);
-              batch_total_weights = std::fma(local_weight, local_weight, batch_total_weights);
-              for (int d = 0; d < m_dimension; d += 16) {
-                int index = d / 16;
-                int remain = m_dimension - d;
-                __mmask16 mask = (remain >= 16 ? 0xffff : (1 << remain) - 1);
-                __m512 _item = _mm512_maskz_loadu_ps(mask, u_embedding + d);
-                tmp_embedding[index] = _mm512_mask3_fmadd_ps(
-                    _item, _weights, tmp_embedding[index], mask);
-              }
-            }
-            __m512 _total_weights;
-            if (batch_num != 0) {
-              _total_weights = _mm512_set1_ps(sqrtf(batch_total_weights));
-            } else {
-              _total_weights = _mm512_set1_ps(1.0f);
-            }
-
-            for (int d = 0; d < m_dimension; d += 16) {
-              int index = d / 16;
-              int remain = m_dimension - d;
-              __mmask16 mask = (remain >= 16 ? 0xffff : (1 << remain) - 1);
-              tmp_embedding[index] = _mm512_div_ps(tmp_embedding[index], _total_weights);
-              _mm512_mask_storeu_ps(gather_embedding + i * m_dimension + d,
-                                    mask, tmp_embedding[index]);
-            }
-#else
-            TValue batch_total_weights = 0.0f;
-            std::vector<TValue> tmp_embedding(m_dimension, 0.0f);
-            int batch_offset = i == 0 ? 0 : batch_nums[i - 1];
-            int batch_num = batch_nums[i] - batch_offset;
-            for (int j = 0; j < batch_num; ++j) {
-              int unique_indice = unique_idx[batch_offset + j];
-              float *u_embedding =
-                  unique_embedding_data + unique_indice * m_dimension;
-              TValue sp_weight = sp_weights[batch_offset + j];
-              batch_total_weights = std::fma(sp_weight, sp_weight, batch_total_weights);
-              for (int d = 0; d < m_dimension; ++d) {
-                tmp_embedding[d] =
-                    std::fma(u_embedding[d], sp_weight, tmp_embedding[d]);
-              }
-            }
-
-            if (batch_num != 0) {
-              batch_total_weights = sqrtf(batch_total_weights);
-            } else {
-              batch_total_weights = 1.0f;
-            }
-            for (int d = 0; d < m_dimension; ++d) {
-              tmp_embedding[d] /= batch_total_weights;
-            }
+      gather_embedding = gather_embedding_tensor->flat<TValue>().data();
+    }
 
-            memcpy(gather_embedding + i * m_dimension, tmp_embedding.data(),
-                   sizeof(float) * m_dimension);
-#endif
-          }
-        };
-        Shard(worker_threads->num_threads, worker_threads->workers, batch_size,
-              slice_bytes /*cost*/, embedding_var_sqrtn_combiner);
+    int slice_bytes = nnz / batch_size * m_dimension * 1000;
+    auto combiner = group_embedding::CombinerFromString(this->m_combiner);
+    auto combine = group_embedding::GetCombineFn<TValue>(combiner,
+                                                         m_dimension);
+    auto embedding_var_combiner = [this, gather_embedding, out_stride,
+                                   batch_nums, unique_idx,
+                                   unique_embedding_data,
+                                   sp_weights, combine, combiner,
+                                   is_quantized, embedding_var, unique,
+                                   quantized_ptrs](int64 start, int64 end) {
+      for (int64 i = start; i < end; ++i) {
+        int batch_offset = i == 0 ? 0 : batch_nums[i - 1];
+        int batch_num = batch_nums[i] - batch_offset;
+        TValue *out = gather_embedding + i * out_stride;
+        if (!is_quantized) {
+          combine(unique_embedding_data, unique_idx + batch_offset,
+                  sp_weights + batch_offset, batch_num, m_dimension, out);
+          continue;
+        }
+        memset(out, 0, sizeof(TValue) * m_dimension);
+        for (int j = batch_offset; j < batch_offset + batch_num; ++j) {
+          int idx = unique_idx[j];
+          embedding_var->AccumulateEmbedding(unique[idx],
+                                             quantized_ptrs[idx],
+                                             sp_weights[j], out);
+        }
+        float total_weight = group_embedding::TotalWeight(
+            combiner, sp_weights + batch_offset, batch_num);
+        for (int d = 0; d < m_dimension; ++d) {
+          out[d] /= total_weight;
+        }
       }
-    }
+    };
+    Shard(worker_threads->num_threads, worker_threads->workers, batch_size,
+          slice_bytes /*cost*/, embedding_var_combiner);
   }
+
+  // The index of the unique_keys output of lookup 0, 1 after the concat.
+  int m_output_base;
+  std::vector<int> m_concat_positions;
 };
 
-#define REGISTER_CPU_KERNELS(key_type, value_type) \
-  REGISTER_KERNEL_BUILDER(                         \
-      Name("GroupEmbeddingVarLookup")              \
-          .Device(DEVICE_CPU)                      \
-          .TypeConstraint<key_type>("Tkeys")       \
-          .TypeConstraint<value_type>("dtype"),    \
-      GroupEmbeddingVariableLookupCpuOp<key_type, value_type>)
+#define REGISTER_CPU_KERNELS(key_type, value_type)                    \
+  REGISTER_KERNEL_BUILDER(                                            \
+      Name("GroupEmbeddingVarLookup")                                 \
+          .Device(DEVICE_CPU)                                         \
+          .TypeConstraint<key_type>("Tkeys")                          \
+          .TypeConstraint<value_type>("dtype"),                       \
+      GroupEmbeddingVariableLookupCpuOp<key_type, value_type, false>) \
+  REGISTER_KERNEL_BUILDER(                                            \
+      Name("_OPT_GroupEmbeddingVarLookup")                            \
+          .Device(DEVICE_CPU)                                         \
+          .TypeConstraint<key_type>("Tkeys")                          \
+          .TypeConstraint<value_type>("dtype"),                       \
+      GroupEmbeddingVariableLookupCpuOp<key_type, value_type, true>)  \
+  REGISTER_KERNEL_BUILDER(                                            \
+      Name("_GroupEmbeddingVarLookupConcat")                          \
+          .Device(DEVICE_CPU)                                         \
+          .TypeConstraint<key_type>("Tkeys")                          \
+          .TypeConstraint<value_type>("dtype"),                       \
+      GroupEmbeddingVariableLookupCpuOp<key_type, value_type, false>)
 
 REGISTER_CPU_KERNELS(int32, float);
 REGISTER_CPU_KERNELS(int64, float);
@@ -17,6 +17,9 @@ limitations under the License.
 
 #include <cuda_runtime.h>
 
+#include <unordered_map>
+#include <vector>
+
 #include "tensorflow/core/common_runtime/gpu/gpu_event_mgr.h"
 #include "tensorflow/core/framework/embedding/embedding_var.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -56,6 +59,10 @@ class GroupEmbeddingVarLookupOp
     std::vector<Tensor> tensor_list;
     tensor_list.reserve(this->num_lookups_);
 
+    std::vector<TValue*> host_out_bases(this->num_lookups_, nullptr);
+    LookupOnHost(ctx, &host_out_bases, &tensor_list);
+    if (!ctx->status().ok()) return;
+
     for (int i = 0; i < this->num_lookups_; ++i) {
       EmbeddingVar<TFKey, TValue>* ev = nullptr;
       OP_REQUIRES_OK(ctx, LookupResource(ctx, HandleFromInput(ctx, i), &ev));
@@ -81,15 +88,14 @@ class GroupEmbeddingVarLookupOp
         default_v = ev->GetDefaultValuePtr();
       }
 
-      // DEBUG
       const TFKey* key_base = sp_values.data();
-      Tensor out_tensor;
-      OP_REQUIRES_OK(ctx, ctx->allocate_temp(DataTypeToEnum<TValue>::value,
-                                             {N * dimension}, &out_tensor));
-      TValue* out_base = out_tensor.flat<TValue>().data();
-      
-      EmbeddingVarContext<GPUDevice> ev_ctx(ctx);
+      TValue* out_base = host_out_bases[i];
       if (ev->IsSingleHbm()) {
+        Tensor out_tensor;
+        OP_REQUIRES_OK(ctx, ctx->allocate_temp(DataTypeToEnum<TValue>::value,
+                                               {N * dimension}, &out_tensor));
+        out_base = out_tensor.flat<TValue>().data();
+        EmbeddingVarContext<GPUDevice> ev_ctx(ctx);
         if (is_use_default_value_tensor_) {
           Tensor default_values(ctx->input(5 * this->num_lookups_));
           auto default_value_num = default_values.NumElements() / dimension;
@@ -100,18 +106,7 @@ class GroupEmbeddingVarLookupOp
         } else {
           ev->GetEmbeddings(ev_ctx, key_base, out_base, N);
         }
-      } else {
-        TensorShape indices_host_shape = sp_values_tensor.shape();
-        Tensor indices_host(sp_indices_tensor.dtype(), indices_host_shape);
-        //Copy ids from GPU to CPU for CPU Lookup.
-        auto stream = ctx->op_device_context()->stream();
-        auto event_mgr = ctx->device()->tensorflow_gpu_device_info()->event_mgr;
-        se::DeviceMemoryBase gpu_src(const_cast<TFKey*>(key_base), N * sizeof(TFKey));
-        stream->ThenMemcpy(indices_host.data(), gpu_src, N * sizeof(TFKey));
-        SyncWithEventMgr(stream, event_mgr);
-        EmbeddingVarContext<GPUDevice> ev_ctx(ctx);
-        ev->GetEmbeddings(ev_ctx, (TFKey*)indices_host.data(), out_base, N);
-        ev->UpdateCache(indices_host, true);
+        tensor_list.emplace_back(out_tensor);
       }
 
       TensorShape emb_vectors_tensor_shape;
@@ -168,7 +163,6 @@ class GroupEmbeddingVarLookupOp
           values_offset, nnz);
 
       lookuper.set(group_embedding_args);
-      tensor_list.emplace_back(out_tensor);
     }
 
     if (this->combiner_ == "sum") {
@@ -182,6 +176,81 @@ class GroupEmbeddingVarLookupOp
   }
 
  private:
+  // Looks up the rows of the lookups of the EmbeddingVars not in a single
+  // HBM, whose keys are looked up on the host. The keys of all of them are
+  // copied to the host before one sync, instead of one per lookup, and the
+  // lookups of the same EmbeddingVar are batched into one lookup. The rows
+  // of lookup i are written to (*out_bases)[i], in tensors added to
+  // tensor_list.
+  void LookupOnHost(OpKernelContext* ctx, std::vector<TValue*>* out_bases,
+                    std::vector<Tensor>* tensor_list) {
+    std::vector<core::RefCountPtr<EmbeddingVar<TFKey, TValue>>> evs(
+        this->num_lookups_);
+    std::vector<std::vector<int>> groups;
+    std::unordered_map<EmbeddingVar<TFKey, TValue>*, int> group_of;
+    for (int i = 0; i < this->num_lookups_; ++i) {
+      OP_REQUIRES_OK(ctx, LookupResource(ctx, HandleFromInput(ctx, i),
+                                         &evs[i]));
+      if (evs[i]->IsSingleHbm()) {
+        continue;
+      }
+      auto it = group_of.emplace(evs[i].get(), groups.size());
+      if (it.second) {
+        groups.emplace_back();
+      }
+      groups[it.first->second].push_back(i);
+    }
+    if (groups.empty()) {
+      return;
+    }
+
+    //Copy ids from GPU to CPU for CPU Lookup.
+    auto stream = ctx->op_device_context()->stream();
+    auto event_mgr = ctx->device()->tensorflow_gpu_device_info()->event_mgr;
+    std::vector<Tensor> keys_host(groups.size());
+    for (size_t g = 0; g < groups.size(); ++g) {
+      int64 num_keys = 0;
+      for (int i : groups[g]) {
+        num_keys += ctx->input(this->num_lookups_ + i).NumElements();
+      }
+      keys_host[g] = Tensor(DataTypeToEnum<TFKey>::value, {num_keys});
+      TFKey* keys = keys_host[g].flat<TFKey>().data();
+      for (int i : groups[g]) {
+        const Tensor& sp_values_tensor = ctx->input(this->num_lookups_ + i);
+        int64 N = sp_values_tensor.NumElements();
+        if (N > 0) {
+          se::DeviceMemoryBase gpu_src(
+              const_cast<TFKey*>(sp_values_tensor.flat<TFKey>().data()),
+              N * sizeof(TFKey));
+          stream->ThenMemcpy(keys, gpu_src, N * sizeof(TFKey));
+        }
+        keys += N;
+      }
+    }
+    SyncWithEventMgr(stream, event_mgr);
+
+    EmbeddingVarContext<GPUDevice> ev_ctx(ctx);
+    for (size_t g = 0; g < groups.size(); ++g) {
+      EmbeddingVar<TFKey, TValue>* ev = evs[groups[g][0]].get();
+      int64 dimension = ev->ValueLen();
+      int64 num_keys = keys_host[g].NumElements();
+      Tensor out_tensor;
+      OP_REQUIRES_OK(ctx, ctx->allocate_temp(DataTypeToEnum<TValue>::value,
+                                             {num_keys * dimension},
+                                             &out_tensor));
+      TValue* out_base = out_tensor.flat<TValue>().data();
+      ev->GetEmbeddings(ev_ctx, keys_host[g].flat<TFKey>().data(), out_base,
+                        num_keys);
+      ev->UpdateCache(keys_host[g], true);
+      for (int i : groups[g]) {
+        (*out_bases)[i] = out_base;
+        out_base += ctx->input(this->num_lookups_ + i).NumElements() *
+                    dimension;
+      }
+      tensor_list->emplace_back(out_tensor);
+    }
+  }
+
   bool is_use_default_value_tensor_;
 };
 
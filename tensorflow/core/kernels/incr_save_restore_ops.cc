@@ -18,6 +18,73 @@ limitations under the License.
 
 namespace tensorflow {
 
+// Publishes the deltas of the replicated EmbeddingVariables to their
+// standby every TF_EV_REPLICA_INTERVAL_MS, 1000 by default, see
+// IndicesIncrRecorder::ReplicateDelta. A longer interval publishes a row
+// updated in between once.
+class EmbeddingReplicator {
+ public:
+  static EmbeddingReplicator* Global() {
+    static EmbeddingReplicator* replicator = new EmbeddingReplicator;
+    return replicator;
+  }
+
+  // Replicates the EmbeddingVariable var_name of rm, whose updates are
+  // recorded by the IndicesIncrRecorder var_name + "_sparse_incr".
+  void Register(ResourceMgr* rm, const string& var_name) {
+    mutex_lock l(mu_);
+    variables_.emplace_back(rm, var_name);
+  }
+
+ private:
+  EmbeddingReplicator() {
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_REPLICA_INTERVAL_MS", 1000,
+                                    &interval_ms_));
+    thread_.reset(Env::Default()->StartThread(
+        ThreadOptions(), "ev_replicator", [this] { Loop(); }));
+  }
+
+  void Loop() {
+    while (true) {
+      Env::Default()->SleepForMicroseconds(
+          std::max<int64>(interval_ms_, 1) * 1000);
+      std::vector<std::pair<ResourceMgr*, string>> variables;
+      {
+        mutex_lock l(mu_);
+        variables = variables_;
+      }
+      for (const auto& variable : variables) {
+        Status s = Replicate<int64>(variable.first, variable.second);
+        if (errors::IsNotFound(s)) {
+          s = Replicate<int32>(variable.first, variable.second);
+        }
+        if (!s.ok() && !errors::IsNotFound(s)) {
+          LOG(WARNING) << "Failed to replicate " << variable.second << ": "
+                       << s;
+        }
+      }
+    }
+  }
+
+  template <typename K>
+  Status Replicate(ResourceMgr* rm, const string& var_name) {
+    IndicesIncrRecorder<K>* recorder = nullptr;
+    TF_RETURN_IF_ERROR(rm->Lookup("", var_name + "_sparse_incr", &recorder));
+    core::ScopedUnref unref_recorder(recorder);
+    // Only the EmbeddingVariables are replicated.
+    EmbeddingVar<K, float>* variable = nullptr;
+    TF_RETURN_IF_ERROR(
+        rm->Lookup(rm->default_container(), var_name, &variable));
+    core::ScopedUnref unref_variable(variable);
+    return recorder->ReplicateDelta(var_name, variable);
+  }
+
+  int64 interval_ms_;
+  mutex mu_;
+  std::vector<std::pair<ResourceMgr*, string>> variables_ GUARDED_BY(mu_);
+  std::unique_ptr<Thread> thread_;
+};
+
 template <typename TIndex>
 class RecordSparseIndicesOp: public OpKernel {
  public:
@@ -37,11 +104,15 @@ class RecordSparseIndicesOp: public OpKernel {
         ctx,
         rm->LookupOrCreate<IndicesIncrRecorder<TIndex>>(
             "", sparse_incr_res_name_ + "_sparse_incr", &sparse_incr_res,
-            [this](IndicesIncrRecorder<TIndex>** ptr) {
+            [this, rm](IndicesIncrRecorder<TIndex>** ptr) {
               *ptr = new IndicesIncrRecorder<TIndex>(sparse_incr_res_name_);
               if (auto_record_) {
                 (*ptr)->UpdateGlobalVersion();
               }
+              if ((*ptr)->IsReplicated()) {
+                EmbeddingReplicator::Global()->Register(
+                    rm, sparse_incr_res_name_);
+              }
               VLOG(2) << "sparse_incr_res created, name:"
                       << sparse_incr_res_name_;
               return Status::OK();
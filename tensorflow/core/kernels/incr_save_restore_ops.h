@@ -15,7 +15,10 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_INCR_SAVE_RESTORE_OPS_H_
 #define TENSORFLOW_CORE_KERNELS_INCR_SAVE_RESTORE_OPS_H_
 
+#include <atomic>
 #include <string>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 
 #include "tensorflow/core/framework/bounds_check.h"
@@ -23,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/kernels/embedding_delta_stream.h"
 #include "tensorflow/core/kernels/save_restore_tensor.h"
 #include "tensorflow/core/kernels/variable_ops.h"
 #include "tensorflow/core/kernels/kv_variable_ops.h"
@@ -34,7 +38,10 @@ limitations under the License.
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/util/saved_tensor_slice_util.h"
 #include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/tensor_slice_reader.h"
+#include "tensorflow/core/util/work_sharder.h"
 #include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
 
@@ -174,6 +181,73 @@ class ParallelHashMap {
   int min_part_size_;
 };
 
+// Keys touched since the last Collect. Every worker thread inserts into
+// its own set without locks, the other threads share one set under a
+// mutex. The sets are kept in two epochs, Collect starts a new epoch and
+// takes the sets of the previous one once the inserts into them are over.
+template <typename T>
+class PerThreadTouchedSets {
+ public:
+  explicit PerThreadTouchedSets(int num_threads)
+      : num_threads_(num_threads), slots_(num_threads + 1) {}
+
+  // thread_id is the id of the worker thread in [0, num_threads), the
+  // other threads, e.g. -1, share one set.
+  void Insert(int thread_id, const T* keys, int64 start, int64 end) {
+    if (thread_id < 0 || thread_id >= num_threads_) {
+      mutex_lock l(shared_mu_);
+      InsertInto(&slots_[num_threads_].keys[epoch_.load() & 1],
+                 keys, start, end);
+      return;
+    }
+    Slot& slot = slots_[thread_id];
+    int64 epoch;
+    do {
+      epoch = epoch_.load();
+      slot.busy_epoch.store(epoch + 1);
+    } while (epoch_.load() != epoch);
+    InsertInto(&slot.keys[epoch & 1], keys, start, end);
+    slot.busy_epoch.store(0);
+  }
+
+  // Appends the keys touched since the last Collect to out, a key touched
+  // by several threads is appended once per thread. Collect should not be
+  // called concurrently.
+  void Collect(std::vector<std::unordered_set<T>>* out) {
+    int64 epoch;
+    {
+      mutex_lock l(shared_mu_);
+      epoch = epoch_.fetch_add(1);
+    }
+    for (int i = 0; i <= num_threads_; i++) {
+      while (slots_[i].busy_epoch.load() == epoch + 1) {
+        std::this_thread::yield();
+      }
+      out->emplace_back();
+      out->back().swap(slots_[i].keys[epoch & 1]);
+    }
+  }
+
+ private:
+  struct Slot {
+    std::unordered_set<T> keys[2];
+    // epoch + 1 while inserting into keys[epoch & 1], 0 otherwise.
+    std::atomic<int64> busy_epoch{0};
+  };
+
+  static void InsertInto(std::unordered_set<T>* set, const T* keys,
+                         int64 start, int64 end) {
+    for (int64 i = start; i < end; i++) {
+      set->insert(keys[i]);
+    }
+  }
+
+  const int num_threads_;
+  std::vector<Slot> slots_;
+  std::atomic<int64> epoch_{0};
+  mutex shared_mu_;
+};
+
 template <class K>
 class IncrKeyDumpIterator : public DumpIterator<K> {
  public:
@@ -349,13 +423,29 @@ class IndicesIncrRecorder: public ResourceBase {
   explicit IndicesIncrRecorder(const std::string &name,
       int32 part_count = 16, int32 min_part_size = 128)
       : name_(name),
-      incr_indices_(min_part_size, part_count) {}
+      incr_indices_(min_part_size, part_count),
+      touched_sets_(port::MaxParallelism()),
+      replica_sets_(port::MaxParallelism()) {
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_INCR_SAVE_DELTA_ONLY", false,
+                                   &delta_only_));
+    replicate_ =
+        embedding::EmbeddingDeltaPublisher::GetReplicaInstance()->IsEnabled();
+  }
 
   void UpdateIndices(const Tensor& indices, OpKernelContext *ctx) {
+    // The replica follows all the updates, not only those since the
+    // checkpoints are activated.
+    if (replicate_) {
+      UpdateTouchedSets(&replica_sets_, indices, ctx);
+    }
     if (global_version_ == -1) {
       return;
     }
 
+    if (delta_only_) {
+      UpdateTouchedSets(&touched_sets_, indices, ctx);
+      return;
+    }
     incr_indices_.Update(indices, ctx);
   }
 
@@ -363,6 +453,43 @@ class IndicesIncrRecorder: public ResourceBase {
     global_version_ = 1;
     mutex_lock l(mu_);
     incr_indices_.Clear();
+    std::vector<std::unordered_set<K>> discarded;
+    touched_sets_.Collect(&discarded);
+    delta_seq_ = 0;
+  }
+
+  // With TF_INCR_SAVE_DELTA_ONLY, the incremental checkpoints only keep
+  // the keys touched since the previous incremental checkpoint instead of
+  // the previous full checkpoint.
+  bool IsDeltaOnly() const {
+    return delta_only_;
+  }
+
+  // With TF_EV_REPLICA_BROKERS and TF_EV_REPLICA_TOPIC, the keys updated
+  // are recorded for ReplicateDelta.
+  bool IsReplicated() const {
+    return replicate_;
+  }
+
+  // Publishes the rows of the keys updated since the previous call to the
+  // standby of the parameter server, see EmbeddingReplicaApplier.
+  Status ReplicateDelta(const string& tensor_name,
+                        EmbeddingVar<K, V>* emb_var) {
+    mutex_lock l(replica_mu_);
+    std::vector<std::unordered_set<K>> touched;
+    replica_sets_.Collect(&touched);
+    std::unordered_set<K> keys_set;
+    for (auto& keys : touched) {
+      keys_set.insert(keys.begin(), keys.end());
+    }
+    if (keys_set.empty()) {
+      return Status::OK();
+    }
+    std::vector<K> keys(keys_set.begin(), keys_set.end());
+    TF_RETURN_IF_ERROR(PublishDelta(tensor_name, emb_var, keys, replica_seq_,
+        embedding::EmbeddingDeltaPublisher::GetReplicaInstance()));
+    replica_seq_++;
+    return Status::OK();
   }
 
   void SwapIndices(std::unordered_map<K, uint64>& indices) {
@@ -376,7 +503,15 @@ class IndicesIncrRecorder: public ResourceBase {
     char* dump_buffer = (char*)malloc(sizeof(char) * bytes_limit);
 
     std::set<K> incr_keys_set;
-    incr_indices_.GetKeys(incr_keys_set);
+    if (delta_only_) {
+      std::vector<std::unordered_set<K>> touched;
+      CollectTouchedSets(&touched);
+      for (auto& keys : touched) {
+        incr_keys_set.insert(keys.begin(), keys.end());
+      }
+    } else {
+      incr_indices_.GetKeys(incr_keys_set);
+    }
     std::vector<K> incr_keys;
     incr_keys.assign(incr_keys_set.begin(), incr_keys_set.end());
 
@@ -407,6 +542,9 @@ class IndicesIncrRecorder: public ResourceBase {
       EmbeddingVar<K, V>* emb_var, BundleWriter* writer,
       OpKernelContext* context) {
     mutex_lock l(mu_);
+    if (delta_only_) {
+      return DumpDeltaEmbeddingTensor(tensor_name, emb_var, writer, context);
+    }
     size_t bytes_limit = 8 << 20;
     char* dump_buffer = (char*)malloc(sizeof(char) * bytes_limit);
 
@@ -496,10 +634,186 @@ class IndicesIncrRecorder: public ResourceBase {
   }
 
  private:
+  void UpdateTouchedSets(PerThreadTouchedSets<K>* sets,
+                         const Tensor& indices, OpKernelContext* ctx) {
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    const K* keys = reinterpret_cast<const K*>(indices.data());
+    thread::ThreadPool* workers = worker_threads->workers;
+    Shard(worker_threads->num_threads, workers, indices.NumElements(),
+          100 /* cost per key */,
+          [sets, keys, workers](int64 start, int64 end) {
+            sets->Insert(workers->CurrentThreadId(), keys, start, end);
+          });
+  }
+
+  void CollectTouchedSets(std::vector<std::unordered_set<K>>* touched)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    touched_sets_.Collect(touched);
+  }
+
+  // Dumps the keys touched since the previous dump in the layout of
+  // DumpSparseEmbeddingTensor, partitioned and written on
+  // KvSaveThreadPool. "-sparse_incr_delta_seq" is the sequence numbers of
+  // the previous and this delta since the full checkpoint, at 0, so that
+  // the deltas are applied in order.
+  Status DumpDeltaEmbeddingTensor(const string& tensor_name,
+      EmbeddingVar<K, V>* emb_var, BundleWriter* writer,
+      OpKernelContext* context) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    std::vector<std::unordered_set<K>> touched;
+    CollectTouchedSets(&touched);
+
+    // Every shard partitions the touched keys of its range of partitions.
+    const int64 num_shards = KvSaveThreadPool::ThreadNum();
+    const int64 shard_parts =
+        (kSavedPartitionNum + num_shards - 1) / num_shards;
+    std::vector<std::vector<K>> keys_parts(kSavedPartitionNum);
+    const int64 min_freq = emb_var->MinFreq();
+    RunShards(KvSaveThreadPool::GetInstance(), num_shards, num_shards,
+        [&](int64 shard, int64, int64) {
+          int64 first = shard * shard_parts;
+          int64 last = std::min(static_cast<int64>(kSavedPartitionNum),
+                                first + shard_parts);
+          for (auto& keys : touched) {
+            for (auto key : keys) {
+              int64 partid = key % kSavedPartitionNum;
+              if (partid >= first && partid < last &&
+                  emb_var->GetFreq(key) >= min_freq) {
+                keys_parts[partid].emplace_back(key);
+              }
+            }
+          }
+          for (int64 partid = first; partid < last; partid++) {
+            auto& part = keys_parts[partid];
+            std::sort(part.begin(), part.end());
+            part.erase(std::unique(part.begin(), part.end()), part.end());
+          }
+        });
+
+    Tensor part_offset_tensor;
+    TF_RETURN_IF_ERROR(context->allocate_temp(DT_INT32,
+        TensorShape({kSavedPartitionNum + 1}), &part_offset_tensor));
+    auto part_offset_flat = part_offset_tensor.flat<int32>();
+    part_offset_flat(0) = 0;
+    for (int partid = 0; partid < kSavedPartitionNum; partid++) {
+      part_offset_flat(partid + 1) =
+          part_offset_flat(partid) + keys_parts[partid].size();
+    }
+    const int64 num_keys = part_offset_flat(kSavedPartitionNum);
+    std::vector<K> partitioned_incr_keys(num_keys);
+    RunShards(KvSaveThreadPool::GetInstance(), num_shards,
+        kSavedPartitionNum, [&](int64, int64 start, int64 end) {
+          for (int64 partid = start; partid < end; partid++) {
+            std::copy(keys_parts[partid].begin(), keys_parts[partid].end(),
+                      partitioned_incr_keys.begin() +
+                          part_offset_flat(partid));
+          }
+        });
+    TF_RETURN_IF_ERROR(
+        writer->Add(tensor_name + "-incr_partition_offset",
+                    part_offset_tensor));
+
+    Tensor delta_seq_tensor(DT_INT64, TensorShape({2}));
+    delta_seq_tensor.flat<int64>()(0) = delta_seq_;
+    delta_seq_tensor.flat<int64>()(1) = delta_seq_ + 1;
+    TF_RETURN_IF_ERROR(
+        writer->Add(tensor_name + "-sparse_incr_delta_seq",
+                    delta_seq_tensor));
+
+    const int64 value_len = emb_var->ValueLen();
+    TF_RETURN_IF_ERROR(SaveTensorInParallel<K>(
+        tensor_name + "-sparse_incr_keys", writer, TensorShape({num_keys}),
+        [&](int64 start, int64 end, K* out) {
+          std::copy(partitioned_incr_keys.begin() + start,
+                    partitioned_incr_keys.begin() + end, out);
+        }));
+    TF_RETURN_IF_ERROR(SaveTensorInParallel<V>(
+        tensor_name + "-sparse_incr_values", writer,
+        TensorShape({num_keys, value_len}),
+        [&](int64 start, int64 end, V* out) {
+          for (int64 i = start; i < end; i++) {
+            K key = partitioned_incr_keys[i];
+            ValuePtr<V>* value_ptr = nullptr;
+            TF_CHECK_OK(emb_var->LookupOrCreateKey(key, &value_ptr));
+            auto value = emb_var->flat(value_ptr, key);
+            for (int64 j = 0; j < value_len; j++) {
+              *out++ = value(j);
+            }
+          }
+        }));
+    TF_RETURN_IF_ERROR(SaveTensorInParallel<int64>(
+        tensor_name + "-sparse_incr_versions", writer,
+        TensorShape({num_keys}),
+        [&](int64 start, int64 end, int64* out) {
+          for (int64 i = start; i < end; i++) {
+            *out++ = emb_var->StepsToLive() == 0 ?
+                0 : emb_var->GetVersion(partitioned_incr_keys[i]);
+          }
+        }));
+    TF_RETURN_IF_ERROR(SaveTensorInParallel<int64>(
+        tensor_name + "-sparse_incr_freqs", writer,
+        TensorShape({num_keys}),
+        [&](int64 start, int64 end, int64* out) {
+          for (int64 i = start; i < end; i++) {
+            *out++ = emb_var->GetFreq(partitioned_incr_keys[i]);
+          }
+        }));
+    auto publisher = embedding::EmbeddingDeltaPublisher::GetInstance();
+    if (publisher->IsEnabled()) {
+      TF_RETURN_IF_ERROR(PublishDelta(tensor_name, emb_var,
+          partitioned_incr_keys, delta_seq_, publisher));
+    }
+    delta_seq_++;
+    return Status::OK();
+  }
+
+  // Streams the rows of keys, a delta checkpoint to the serving processors
+  // or a delta to the standby, in batches of at most BatchKeys rows.
+  Status PublishDelta(const string& tensor_name,
+      EmbeddingVar<K, V>* emb_var, const std::vector<K>& keys,
+      int64 delta_seq, embedding::EmbeddingDeltaPublisher* publisher) {
+    const int64 value_len = emb_var->ValueLen();
+    const int64 batch_keys = std::max<int64>(1, std::min(
+        publisher->BatchKeys(),
+        embedding::EmbeddingDeltaPublisher::kMaxMessageBytes /
+            static_cast<int64>(sizeof(int64) + value_len * sizeof(float))));
+    embedding::EmbeddingDeltaBatch batch;
+    batch.tensor_name = tensor_name;
+    batch.delta_seq = delta_seq;
+    batch.timestamp_ms = Env::Default()->NowMicros() / 1000;
+    batch.value_len = value_len;
+    const int64 num_keys = keys.size();
+    for (int64 start = 0; start < num_keys; start += batch_keys) {
+      int64 end = std::min(num_keys, start + batch_keys);
+      batch.keys.resize(end - start);
+      batch.values.resize((end - start) * value_len);
+      float* out = batch.values.data();
+      for (int64 i = start; i < end; i++) {
+        batch.keys[i - start] = keys[i];
+        ValuePtr<V>* value_ptr = nullptr;
+        TF_RETURN_IF_ERROR(emb_var->LookupOrCreateKey(keys[i], &value_ptr));
+        auto value = emb_var->flat(value_ptr, keys[i]);
+        for (int64 j = 0; j < value_len; j++) {
+          *out++ = static_cast<float>(value(j));
+        }
+      }
+      TF_RETURN_IF_ERROR(publisher->Publish(batch));
+    }
+    return Status::OK();
+  }
+
   mutex mu_;
   string name_;
   ParallelHashMap<K> incr_indices_;
   std::atomic<int64> global_version_ = {-1};
+  bool delta_only_ = false;
+  // The worker threads beyond MaxParallelism share one set.
+  PerThreadTouchedSets<K> touched_sets_;
+  int64 delta_seq_ GUARDED_BY(mu_) = 0;
+  bool replicate_ = false;
+  PerThreadTouchedSets<K> replica_sets_;
+  // Serializes the collections of replica_sets_.
+  mutex replica_mu_;
+  int64 replica_seq_ GUARDED_BY(replica_mu_) = 0;
 
   TF_DISALLOW_COPY_AND_ASSIGN(IndicesIncrRecorder);
 };
@@ -139,6 +139,105 @@ TEST(IndicesIncrRecorderTest, TestUpdateAndSwap) {
   EXPECT_EQ(2, out_indices[3]);
 }
 
+TEST(PerThreadTouchedSetsTest, TestInsertAndCollect) {
+  const int num_threads = 4;
+  const int64 num_keys = 100000;
+  PerThreadTouchedSets<int64> touched_sets(num_threads);
+  std::vector<int64> keys(num_keys);
+  for (int64 i = 0; i < num_keys; i++) {
+    keys[i] = i;
+  }
+
+  thread::ThreadPool pool(Env::Default(), "test", num_threads + 1);
+  std::vector<std::unordered_set<int64>> collected;
+  {
+    BlockingCounter counter(num_threads + 1);
+    // Thread num_threads shares the set of the other threads.
+    for (int t = 0; t <= num_threads; t++) {
+      pool.Schedule([&touched_sets, &keys, &counter, t]() {
+        for (int64 start = t; start < num_keys; start += 1000) {
+          touched_sets.Insert(t, keys.data(), start, start + 1);
+        }
+        counter.DecrementCount();
+      });
+    }
+    for (int i = 0; i < 10; i++) {
+      touched_sets.Collect(&collected);
+    }
+    counter.Wait();
+  }
+  touched_sets.Collect(&collected);
+
+  std::set<int64> all_keys;
+  for (auto& keys_set : collected) {
+    all_keys.insert(keys_set.begin(), keys_set.end());
+  }
+  std::set<int64> expect_keys;
+  for (int64 start = 0; start < num_keys; start += 1000) {
+    for (int t = 0; t <= num_threads; t++) {
+      expect_keys.insert(start + t);
+    }
+  }
+  EXPECT_EQ(expect_keys, all_keys);
+
+  std::vector<std::unordered_set<int64>> empty;
+  touched_sets.Collect(&empty);
+  for (auto& keys_set : empty) {
+    EXPECT_TRUE(keys_set.empty());
+  }
+}
+
+TEST(EmbeddingDeltaBatchTest, TestEncodeDecode) {
+  embedding::EmbeddingDeltaBatch batch;
+  batch.tensor_name = "emb/part_0";
+  batch.delta_seq = 3;
+  batch.timestamp_ms = 1234567;
+  batch.value_len = 4;
+  for (int64 i = 0; i < 10; i++) {
+    batch.keys.emplace_back(i * 1000);
+    for (int64 j = 0; j < batch.value_len; j++) {
+      batch.values.emplace_back(i + j * 0.5f);
+    }
+  }
+  string payload;
+  batch.Encode(&payload);
+
+  embedding::EmbeddingDeltaBatch decoded;
+  TF_EXPECT_OK(decoded.Decode(payload));
+  EXPECT_EQ(batch.tensor_name, decoded.tensor_name);
+  EXPECT_EQ(batch.delta_seq, decoded.delta_seq);
+  EXPECT_EQ(batch.timestamp_ms, decoded.timestamp_ms);
+  EXPECT_EQ(batch.value_len, decoded.value_len);
+  EXPECT_EQ(batch.keys, decoded.keys);
+  EXPECT_EQ(batch.values, decoded.values);
+
+  EXPECT_TRUE(errors::IsDataLoss(
+      decoded.Decode(StringPiece(payload.data(), payload.size() - 1))));
+  EXPECT_TRUE(errors::IsDataLoss(decoded.Decode("")));
+}
+
+TEST(EmbeddingReplicaApplierTest, TestKeepsTheLatestPendingRows) {
+  ResourceMgr rm;
+  embedding::EmbeddingReplicaApplier applier(&rm, nullptr);
+  embedding::EmbeddingDeltaBatch batch;
+  batch.tensor_name = "emb/part_0";
+  batch.value_len = 2;
+  batch.keys = {1, 2};
+  batch.values = {1, 1, 2, 2};
+  applier.Apply(batch);
+  EXPECT_EQ(2, applier.NumPendingRows());
+
+  // The newer row of key 2 replaces the kept one.
+  batch.keys = {2, 3};
+  batch.values = {4, 4, 3, 3};
+  applier.Apply(batch);
+  EXPECT_EQ(3, applier.NumPendingRows());
+
+  // The EmbeddingVariable isn't created yet, its rows stay pending.
+  applier.ApplyPending();
+  EXPECT_EQ(3, applier.NumPendingRows());
+}
+
 TEST(DivSparsePartitionerTest, TestCalcGlobalOffset) {
   // part_count: 4, hash_bucket_size: 15
   // [0, 4), [4, 8), [8, 12), [12, 15)
@@ -67,6 +67,7 @@ Status InitializableLookupTable::Initialize(InitTableIterator& iter) {
   if (!errors::IsOutOfRange(iter.status())) {
     return iter.status();
   }
+  TF_RETURN_IF_ERROR(DoFreeze());
 
   // Prevent compiler/memory reordering of is_initialized and
   // the initialization itself.
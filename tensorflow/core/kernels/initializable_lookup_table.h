@@ -149,6 +149,10 @@ class InitializableLookupTable : public LookupInterface {
   // underlying data structure.
   virtual Status DoInsert(const Tensor& keys, const Tensor& values) = 0;
 
+  // Called once the table is populated, before it is marked initialized and
+  // read-only, so that the table may be rebuilt in a layout for lookups.
+  virtual Status DoFreeze() { return Status::OK(); }
+
   // Performs the batch find operation on the underlying data structure.
   virtual Status DoFind(const Tensor& keys, Tensor* values,
                         const Tensor& default_value) = 0;
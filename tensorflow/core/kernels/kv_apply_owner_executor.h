@@ -0,0 +1,197 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_KV_APPLY_OWNER_EXECUTOR_H_
+#define TENSORFLOW_CORE_KERNELS_KV_APPLY_OWNER_EXECUTOR_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/env_var.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+// Applies the rows of the sparse applies of the EmbeddingVariables on owner
+// threads: a key is always updated by the thread its hash maps to, so the
+// concurrent applies of a variable, such as the gradients pushed by several
+// workers to a parameter server, never update a row at the same time and
+// need no lock. Each owner has its own queue, and an apply is queued to all
+// its owners at once, so the applies sharing a key update it in the order
+// they were queued, on every owner. The rows of an owner stay in the cache
+// of its core from one apply to the next.
+//
+// Configured by TF_EV_APPLY_OWNER_THREADS, the number of owners, 0 (default)
+// disables it.
+class KvApplyOwnerExecutor {
+ public:
+  explicit KvApplyOwnerExecutor(int num_owners) : queues_(num_owners) {
+    for (int i = 0; i < num_owners; ++i) {
+      queues_[i].reset(new Queue);
+      threads_.emplace_back(Env::Default()->StartThread(
+          ThreadOptions(), "kv_apply_owner", [this, i] { OwnerLoop(i); }));
+    }
+  }
+
+  ~KvApplyOwnerExecutor() {
+    for (auto& queue : queues_) {
+      mutex_lock l(queue->mu);
+      queue->stopped = true;
+      queue->ready.notify_one();
+    }
+    // Joins the owner threads.
+    threads_.clear();
+  }
+
+  static KvApplyOwnerExecutor* Global() {
+    static KvApplyOwnerExecutor* executor = [] {
+      int64 num_owners = 0;
+      TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_APPLY_OWNER_THREADS", 0,
+                                      &num_owners));
+      return new KvApplyOwnerExecutor(num_owners);
+    }();
+    return executor;
+  }
+
+  bool enabled() const { return !queues_.empty(); }
+  int num_owners() const { return queues_.size(); }
+
+  // The owner of a key, or of a row pointer.
+  int Owner(uint64 key) const {
+    return ((key * 0x9E3779B97F4A7C15ULL) >> 32) % queues_.size();
+  }
+
+  // Runs work(owner) on the thread of each owner of 'owners', returns once
+  // they all returned.
+  void Run(const std::vector<int>& owners,
+           const std::function<void(int)>& work) {
+    BlockingCounter counter(owners.size());
+    Task task{&work, &counter};
+    {
+      // Queues the task to all its owners before any other apply.
+      mutex_lock submit(submit_mu_);
+      for (int owner : owners) {
+        Queue* queue = queues_[owner].get();
+        mutex_lock l(queue->mu);
+        queue->tasks.push_back(&task);
+        queue->ready.notify_one();
+      }
+    }
+    counter.Wait();
+  }
+
+ private:
+  struct Task {
+    const std::function<void(int)>* work;
+    BlockingCounter* counter;
+  };
+
+  // Many appliers queue the tasks of an owner, its thread runs them.
+  struct Queue {
+    mutex mu;
+    condition_variable ready;
+    std::deque<Task*> tasks GUARDED_BY(mu);
+    bool stopped GUARDED_BY(mu) = false;
+  };
+
+  void OwnerLoop(int owner) {
+    Queue* queue = queues_[owner].get();
+    std::deque<Task*> tasks;
+    while (true) {
+      {
+        mutex_lock l(queue->mu);
+        while (queue->tasks.empty() && !queue->stopped) {
+          queue->ready.wait(l);
+        }
+        if (queue->tasks.empty()) return;
+        tasks.swap(queue->tasks);
+      }
+      for (Task* task : tasks) {
+        (*task->work)(owner);
+        task->counter->DecrementCount();
+      }
+      tasks.clear();
+    }
+  }
+
+  mutex submit_mu_;
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::unique_ptr<Thread>> threads_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(KvApplyOwnerExecutor);
+};
+
+// Runs do_work(i, i + 1) for the rows i of 'indices' by their owners when
+// the owner executor is enabled, otherwise do_work on shards of the rows on
+// 'worker_threads'. The rows of the applies whose indices are value pointers
+// are owned by their pointer, so the applies of a variable should either all
+// take pointers or all take keys.
+template <typename TKey>
+void ShardKvApply(const DeviceBase::CpuWorkerThreads& worker_threads,
+                  const Tensor& indices, int64 cost,
+                  const std::function<void(int64, int64)>& do_work) {
+  const int64 N = indices.NumElements();
+  KvApplyOwnerExecutor* executor = KvApplyOwnerExecutor::Global();
+  if (!executor->enabled()) {
+    Shard(worker_threads.num_threads, worker_threads.workers, N, cost,
+          do_work);
+    return;
+  }
+
+  // Sorts the rows by owner, keeping the order of the rows of an owner.
+  const TKey* keys = indices.flat<TKey>().data();
+  const int num_owners = executor->num_owners();
+  std::vector<int> row_owners(N);
+  std::vector<int64> offsets(num_owners + 1, 0);
+  for (int64 i = 0; i < N; ++i) {
+    row_owners[i] = executor->Owner(static_cast<uint64>(keys[i]));
+    ++offsets[row_owners[i] + 1];
+  }
+  std::vector<int> owners;
+  for (int owner = 0; owner < num_owners; ++owner) {
+    if (offsets[owner + 1] > 0) owners.push_back(owner);
+    offsets[owner + 1] += offsets[owner];
+  }
+  std::vector<int64> rows(N);
+  std::vector<int64> next(offsets.begin(), offsets.end() - 1);
+  for (int64 i = 0; i < N; ++i) {
+    rows[next[row_owners[i]]++] = i;
+  }
+
+  executor->Run(owners, [&do_work, &rows, &offsets](int owner) {
+    for (int64 r = offsets[owner]; r < offsets[owner + 1]; ++r) {
+      do_work(rows[r], rows[r] + 1);
+    }
+  });
+}
+
+// ShardKvApply on the worker threads of ctx.
+template <typename TKey>
+void ShardKvApply(OpKernelContext* ctx, const Tensor& indices, int64 cost,
+                  const std::function<void(int64, int64)>& do_work) {
+  ShardKvApply<TKey>(*(ctx->device()->tensorflow_cpu_worker_threads()),
+                     indices, cost, do_work);
+}
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_KV_APPLY_OWNER_EXECUTOR_H_
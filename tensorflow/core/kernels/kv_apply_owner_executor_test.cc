@@ -0,0 +1,93 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/kv_apply_owner_executor.h"
+
+#include <atomic>
+#include <vector>
+
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(KvApplyOwnerExecutorTest, Disabled) {
+  EXPECT_FALSE(KvApplyOwnerExecutor(0).enabled());
+  EXPECT_TRUE(KvApplyOwnerExecutor(2).enabled());
+}
+
+TEST(KvApplyOwnerExecutorTest, SpreadsTheKeys) {
+  const int kOwners = 4;
+  KvApplyOwnerExecutor executor(kOwners);
+  std::vector<int> keys_per_owner(kOwners, 0);
+  for (uint64 key = 0; key < 4096; ++key) {
+    const int owner = executor.Owner(key);
+    ASSERT_GE(owner, 0);
+    ASSERT_LT(owner, kOwners);
+    EXPECT_EQ(owner, executor.Owner(key));
+    ++keys_per_owner[owner];
+  }
+  for (int count : keys_per_owner) {
+    EXPECT_GT(count, 4096 / kOwners / 2);
+  }
+}
+
+TEST(KvApplyOwnerExecutorTest, RunsOnTheGivenOwners) {
+  KvApplyOwnerExecutor executor(4);
+  std::vector<std::atomic<int>> runs(4);
+  for (auto& r : runs) r = 0;
+  executor.Run({1, 3}, [&runs](int owner) { ++runs[owner]; });
+  EXPECT_EQ(0, runs[0]);
+  EXPECT_EQ(1, runs[1]);
+  EXPECT_EQ(0, runs[2]);
+  EXPECT_EQ(1, runs[3]);
+}
+
+TEST(KvApplyOwnerExecutorTest, ConcurrentAppliesDoNotRace) {
+  const int kOwners = 4;
+  const int kKeys = 64;
+  const int kApplies = 16;
+  const int kRepeats = 100;
+  KvApplyOwnerExecutor executor(kOwners);
+  // Updated without atomics, only by the owners of the keys.
+  std::vector<int64> rows(kKeys, 0);
+  {
+    thread::ThreadPool pool(Env::Default(), "owner_test", kApplies);
+    for (int a = 0; a < kApplies; ++a) {
+      pool.Schedule([&executor, &rows] {
+        std::vector<int> owners;
+        for (int owner = 0; owner < kOwners; ++owner) {
+          owners.push_back(owner);
+        }
+        for (int repeat = 0; repeat < kRepeats; ++repeat) {
+          executor.Run(owners, [&executor, &rows](int owner) {
+            for (int key = 0; key < kKeys; ++key) {
+              if (executor.Owner(key) == owner) {
+                rows[key] = rows[key] + 1;
+              }
+            }
+          });
+        }
+      });
+    }
+  }
+  for (int key = 0; key < kKeys; ++key) {
+    EXPECT_EQ(kApplies * kRepeats, rows[key]);
+  }
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,193 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_KV_DELAYED_APPLY_EXECUTOR_H_
+#define TENSORFLOW_CORE_KERNELS_KV_DELAYED_APPLY_EXECUTOR_H_
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+
+// Applies the sparse gradients of the EmbeddingVariables in the background:
+// a delayed apply returns once it is queued, so the forward of the next step
+// runs while an applier thread updates the rows. An apply is queued after
+// the previous apply of its variable finished, so a variable is at most one
+// apply behind. A lookup of keys with a pending apply waits for that apply,
+// or reads the rows before it if stale reads are allowed. The error of a
+// delayed apply fails the next apply or lookup of its variable.
+//
+// Configured by TF_EV_DELAYED_APPLY_THREADS, the number of applier threads,
+// 0 (default) disables it, and TF_EV_DELAYED_APPLY_STALE_READS, false by
+// default.
+class KvDelayedApplyExecutor {
+ public:
+  KvDelayedApplyExecutor(int num_threads, bool stale_reads)
+      : stale_reads_(stale_reads) {
+    if (num_threads > 0) {
+      appliers_.reset(new thread::ThreadPool(
+          Env::Default(), "kv_delayed_apply", num_threads));
+      // The rows of an apply are sharded on their own workers, so that the
+      // appliers never wait for a thread they occupy.
+      workers_.reset(new thread::ThreadPool(
+          Env::Default(), "kv_delayed_apply_worker", port::MaxParallelism()));
+      worker_threads_.num_threads = port::MaxParallelism();
+      worker_threads_.workers = workers_.get();
+    }
+  }
+
+  static KvDelayedApplyExecutor* Global() {
+    static KvDelayedApplyExecutor* executor = [] {
+      int64 num_threads = 0;
+      bool stale_reads = false;
+      TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_DELAYED_APPLY_THREADS", 0,
+                                      &num_threads));
+      TF_CHECK_OK(ReadBoolFromEnvVar("TF_EV_DELAYED_APPLY_STALE_READS",
+                                     false, &stale_reads));
+      return new KvDelayedApplyExecutor(num_threads, stale_reads);
+    }();
+    return executor;
+  }
+
+  bool enabled() const { return appliers_ != nullptr; }
+  bool stale_reads() const { return stale_reads_; }
+
+  // The threads the delayed applies shard their rows on.
+  const DeviceBase::CpuWorkerThreads& worker_threads() const {
+    return worker_threads_;
+  }
+
+  // Waits for the previous apply of 'var', then queues apply(), which
+  // updates the rows of 'keys'. Returns the error of the previous apply
+  // instead of queueing.
+  template <typename TKey>
+  Status Schedule(const void* var, const Tensor& keys,
+                  std::function<Status()> apply) {
+    {
+      mutex_lock l(mu_);
+      TF_RETURN_IF_ERROR(WaitForVarLocked(var, &l));
+      VarState& state = states_[var];
+      state.pending = true;
+      ++num_pending_;
+      if (!stale_reads_) {
+        auto keys_flat = keys.flat<TKey>();
+        state.keys.reserve(keys_flat.size());
+        for (int64 i = 0; i < keys_flat.size(); ++i) {
+          state.keys.insert(static_cast<int64>(keys_flat(i)));
+        }
+      }
+    }
+    appliers_->Schedule([this, var, apply] {
+      Status s = apply();
+      mutex_lock l(mu_);
+      --num_pending_;
+      auto it = states_.find(var);
+      if (s.ok()) {
+        states_.erase(it);
+      } else {
+        it->second.pending = false;
+        it->second.keys.clear();
+        it->second.status = s;
+      }
+      done_.notify_all();
+    });
+    return Status::OK();
+  }
+
+  // Waits for the pending apply of 'var' if it updates any of the 'n' keys,
+  // unless stale reads are allowed.
+  template <typename TKey>
+  Status WaitForKeys(const void* var, const TKey* keys, int64 n) {
+    mutex_lock l(mu_);
+    while (true) {
+      auto it = states_.find(var);
+      if (it == states_.end()) return Status::OK();
+      VarState& state = it->second;
+      if (!state.pending) return TakeStatusLocked(it);
+      if (stale_reads_) return Status::OK();
+      bool has_pending_key = false;
+      for (int64 i = 0; i < n && !has_pending_key; ++i) {
+        has_pending_key = state.keys.count(static_cast<int64>(keys[i])) > 0;
+      }
+      if (!has_pending_key) return Status::OK();
+      done_.wait(l);
+    }
+  }
+
+  // Waits for the pending applies of all the variables, such as before
+  // saving them, as an apply also updates the slots of its variable. Their
+  // errors are left to the next apply or lookup of their variables.
+  void Flush() {
+    if (!enabled()) return;
+    mutex_lock l(mu_);
+    while (num_pending_ > 0) {
+      done_.wait(l);
+    }
+  }
+
+ private:
+  struct VarState {
+    bool pending = false;
+    // The keys of the pending apply, without stale reads.
+    std::unordered_set<int64> keys;
+    // The error of the last apply, until it is reported.
+    Status status;
+  };
+
+  Status WaitForVarLocked(const void* var, mutex_lock* l)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    while (true) {
+      auto it = states_.find(var);
+      if (it == states_.end()) return Status::OK();
+      if (!it->second.pending) return TakeStatusLocked(it);
+      done_.wait(*l);
+    }
+  }
+
+  Status TakeStatusLocked(
+      std::unordered_map<const void*, VarState>::iterator it)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    Status s = it->second.status;
+    states_.erase(it);
+    return s;
+  }
+
+  const bool stale_reads_;
+  std::unique_ptr<thread::ThreadPool> appliers_;
+  std::unique_ptr<thread::ThreadPool> workers_;
+  DeviceBase::CpuWorkerThreads worker_threads_;
+
+  mutex mu_;
+  condition_variable done_;
+  int64 num_pending_ GUARDED_BY(mu_) = 0;
+  std::unordered_map<const void*, VarState> states_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(KvDelayedApplyExecutor);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_KV_DELAYED_APPLY_EXECUTOR_H_
@@ -0,0 +1,113 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/kv_delayed_apply_executor.h"
+
+#include <atomic>
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(KvDelayedApplyExecutorTest, Disabled) {
+  EXPECT_FALSE(KvDelayedApplyExecutor(0, false).enabled());
+  EXPECT_TRUE(KvDelayedApplyExecutor(1, false).enabled());
+}
+
+TEST(KvDelayedApplyExecutorTest, LookupsWaitForPendingKeys) {
+  KvDelayedApplyExecutor executor(1, /*stale_reads=*/false);
+  int var = 0;
+  Notification release;
+  std::atomic<bool> applied(false);
+  TF_ASSERT_OK(executor.Schedule<int64>(
+      &var, test::AsTensor<int64>({1, 2}), [&release, &applied] {
+        release.WaitForNotification();
+        applied = true;
+        return Status::OK();
+      }));
+
+  // Keys without a pending apply are read at once.
+  const int64 other_keys[] = {3, 4};
+  TF_EXPECT_OK(executor.WaitForKeys<int64>(&var, other_keys, 2));
+  EXPECT_FALSE(applied);
+
+  const int64 pending_keys[] = {4, 2};
+  std::unique_ptr<Thread> lookup(Env::Default()->StartThread(
+      ThreadOptions(), "lookup", [&executor, &var, &pending_keys, &applied] {
+        TF_EXPECT_OK(executor.WaitForKeys<int64>(&var, pending_keys, 2));
+        EXPECT_TRUE(applied);
+      }));
+  Env::Default()->SleepForMicroseconds(10 * 1000);
+  release.Notify();
+  lookup.reset();
+  executor.Flush();
+}
+
+TEST(KvDelayedApplyExecutorTest, StaleReadsDoNotWait) {
+  KvDelayedApplyExecutor executor(1, /*stale_reads=*/true);
+  int var = 0;
+  Notification release;
+  TF_ASSERT_OK(executor.Schedule<int64>(
+      &var, test::AsTensor<int64>({1}), [&release] {
+        release.WaitForNotification();
+        return Status::OK();
+      }));
+  const int64 keys[] = {1};
+  TF_EXPECT_OK(executor.WaitForKeys<int64>(&var, keys, 1));
+  release.Notify();
+  executor.Flush();
+}
+
+TEST(KvDelayedApplyExecutorTest, AppliesOfAVariableRunInOrder) {
+  const int kApplies = 32;
+  KvDelayedApplyExecutor executor(4, /*stale_reads=*/false);
+  int var = 0;
+  // Updated without atomics, by one apply at a time.
+  int64 last = -1;
+  bool ordered = true;
+  for (int64 i = 0; i < kApplies; ++i) {
+    TF_ASSERT_OK(executor.Schedule<int64>(
+        &var, test::AsTensor<int64>({i}), [&last, &ordered, i] {
+          ordered = ordered && last == i - 1;
+          last = i;
+          return Status::OK();
+        }));
+  }
+  executor.Flush();
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ(kApplies - 1, last);
+}
+
+TEST(KvDelayedApplyExecutorTest, ErrorFailsTheNextApply) {
+  KvDelayedApplyExecutor executor(1, /*stale_reads=*/false);
+  int var = 0;
+  TF_ASSERT_OK(executor.Schedule<int64>(
+      &var, test::AsTensor<int64>({1}),
+      [] { return errors::Internal("apply failed"); }));
+  executor.Flush();
+  Status s = executor.Schedule<int64>(&var, test::AsTensor<int64>({1}),
+                                      [] { return Status::OK(); });
+  EXPECT_EQ(error::INTERNAL, s.code());
+  // The error is reported once.
+  const int64 keys[] = {1};
+  TF_EXPECT_OK(executor.WaitForKeys<int64>(&var, keys, 1));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,211 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_KV_SPARSE_APPLY_COMBINER_H_
+#define TENSORFLOW_CORE_KERNELS_KV_SPARSE_APPLY_COMBINER_H_
+
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+
+// The sparse gradient of one apply of an EmbeddingVariable.
+struct SparseGradPush {
+  Tensor indices;
+  Tensor grad;
+  Tensor counts;  // Empty without counts.
+  int64 global_step = 0;
+
+  // Set by the leader once the batch of the push is applied.
+  Status status;
+  Notification done;
+};
+
+// Combines the concurrent sparse applies of an EmbeddingVariable, such as
+// the gradient pushes of several workers to a parameter server, into one
+// dedup+apply. The first push to an idle variable leads: it waits for at
+// most 'window_us', or until 'max_pushes' pushes are queued, then merges and
+// applies the queued pushes while the others wait for it. So a gradient is
+// applied at most one window late, and a hot id is looked up once per batch
+// instead of once per push.
+//
+// Configured by TF_EV_APPLY_COMBINE_WINDOW_US, 0 (default) disables it, and
+// TF_EV_APPLY_COMBINE_MAX_PUSHES, 8 by default.
+class SparseApplyCombiner {
+ public:
+  SparseApplyCombiner(int64 window_us, int64 max_pushes)
+      : window_us_(window_us), max_pushes_(max_pushes) {}
+
+  static SparseApplyCombiner* Global() {
+    static SparseApplyCombiner* combiner = [] {
+      int64 window_us = 0, max_pushes = 8;
+      TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_APPLY_COMBINE_WINDOW_US", 0,
+                                      &window_us));
+      TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_APPLY_COMBINE_MAX_PUSHES", 8,
+                                      &max_pushes));
+      return new SparseApplyCombiner(window_us, max_pushes);
+    }();
+    return combiner;
+  }
+
+  bool enabled() const { return window_us_ > 0 && max_pushes_ > 1; }
+
+  // Queues 'push' for 'var'. Returns true if the caller leads, then it must
+  // apply the pushes of 'batch', which includes 'push', and call Finish.
+  // Otherwise returns false once the leader applied 'push', with its status
+  // in push->status.
+  bool Join(const void* var, SparseGradPush* push,
+            std::vector<SparseGradPush*>* batch) {
+    {
+      mutex_lock l(mu_);
+      Queue& queue = queues_[var];
+      queue.pushes.push_back(push);
+      if (!queue.has_leader) {
+        queue.has_leader = true;
+        const uint64 deadline = Env::Default()->NowMicros() + window_us_;
+        while (queue.pushes.size() < max_pushes_) {
+          const uint64 now = Env::Default()->NowMicros();
+          if (now >= deadline) break;
+          queue.full.wait_for(l, std::chrono::microseconds(deadline - now));
+        }
+        batch->swap(queue.pushes);
+        // Later pushes find no queue and lead a new batch.
+        queues_.erase(var);
+        return true;
+      }
+      if (queue.pushes.size() >= max_pushes_) {
+        queue.full.notify_one();
+      }
+    }
+    push->done.WaitForNotification();
+    return false;
+  }
+
+  // Wakes up the pushes of 'batch' with status 's'.
+  void Finish(const std::vector<SparseGradPush*>& batch, const Status& s) {
+    for (SparseGradPush* push : batch) {
+      push->status = s;
+      push->done.Notify();
+    }
+  }
+
+ private:
+  struct Queue {
+    bool has_leader = false;
+    std::vector<SparseGradPush*> pushes;
+    condition_variable full;
+  };
+
+  const int64 window_us_;
+  const size_t max_pushes_;
+  mutex mu_;
+  std::unordered_map<const void*, Queue> queues_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SparseApplyCombiner);
+};
+
+// Merges the pushes of 'batch' into one push without duplicated ids: the
+// gradients and the counts of an id are summed, and the global step is the
+// latest one.
+template <typename TKey, typename T>
+Status MergeSparseGradPushes(OpKernelContext* ctx,
+                             const std::vector<SparseGradPush*>& batch,
+                             SparseGradPush* merged) {
+  const bool has_counts = batch[0]->counts.dtype() == DT_INT64;
+  int64 row_len = 1;
+  for (int d = 1; d < batch[0]->grad.dims(); ++d) {
+    row_len *= batch[0]->grad.dim_size(d);
+  }
+  int64 total = 0;
+  std::unordered_map<TKey, int64> rows;
+  std::vector<TKey> keys;
+  // The merged row of each row of each push.
+  std::vector<std::vector<int64>> push_rows(batch.size());
+  merged->global_step = batch[0]->global_step;
+  for (size_t p = 0; p < batch.size(); ++p) {
+    SparseGradPush* push = batch[p];
+    const int64 n = push->indices.NumElements();
+    if (push->grad.NumElements() != n * row_len ||
+        (has_counts && push->counts.NumElements() != n)) {
+      return errors::InvalidArgument(
+          "Mismatched sparse gradients in a combined apply: ",
+          push->indices.shape().DebugString(), " and ",
+          push->grad.shape().DebugString());
+    }
+    auto indices = push->indices.flat<TKey>();
+    push_rows[p].resize(n);
+    for (int64 i = 0; i < n; ++i) {
+      auto it = rows.emplace(indices(i), keys.size());
+      if (it.second) {
+        keys.push_back(indices(i));
+      }
+      push_rows[p][i] = it.first->second;
+    }
+    total += n;
+    merged->global_step = std::max(merged->global_step, push->global_step);
+  }
+
+  const int64 unique = keys.size();
+  TensorShape grad_shape = batch[0]->grad.shape();
+  grad_shape.set_dim(0, unique);
+  TF_RETURN_IF_ERROR(ctx->allocate_temp(batch[0]->indices.dtype(),
+                                        TensorShape({unique}),
+                                        &merged->indices));
+  TF_RETURN_IF_ERROR(ctx->allocate_temp(batch[0]->grad.dtype(), grad_shape,
+                                        &merged->grad));
+  std::copy(keys.begin(), keys.end(), merged->indices.flat<TKey>().data());
+  T* grad = merged->grad.flat<T>().data();
+  std::fill(grad, grad + unique * row_len, static_cast<T>(0));
+  int64* counts = nullptr;
+  if (has_counts) {
+    TF_RETURN_IF_ERROR(ctx->allocate_temp(DT_INT64, TensorShape({unique}),
+                                          &merged->counts));
+    counts = merged->counts.flat<int64>().data();
+    std::fill(counts, counts + unique, 0);
+  }
+
+  for (size_t p = 0; p < batch.size(); ++p) {
+    SparseGradPush* push = batch[p];
+    const T* push_grad = push->grad.flat<T>().data();
+    const int64* push_counts =
+        has_counts ? push->counts.flat<int64>().data() : nullptr;
+    for (int64 i = 0; i < push_rows[p].size(); ++i) {
+      const int64 row = push_rows[p][i];
+      typename TTypes<T>::UnalignedFlat dst(grad + row * row_len, row_len);
+      typename TTypes<T>::UnalignedConstFlat src(push_grad + i * row_len,
+                                                 row_len);
+      dst += src;
+      if (counts != nullptr) {
+        counts[row] += push_counts[i];
+      }
+    }
+  }
+  VLOG(2) << "Combined " << batch.size() << " sparse applies of " << total
+          << " ids into " << unique << " ids.";
+  return Status::OK();
+}
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_KV_SPARSE_APPLY_COMBINER_H_
@@ -0,0 +1,159 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/kv_sparse_apply_combiner.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(SparseApplyCombinerTest, Disabled) {
+  EXPECT_FALSE(SparseApplyCombiner(0, 8).enabled());
+  EXPECT_FALSE(SparseApplyCombiner(100, 1).enabled());
+  EXPECT_TRUE(SparseApplyCombiner(100, 8).enabled());
+}
+
+TEST(SparseApplyCombinerTest, LeadsAloneAfterWindow) {
+  SparseApplyCombiner combiner(1000, 8);
+  int var = 0;
+  SparseGradPush push;
+  std::vector<SparseGradPush*> batch;
+  EXPECT_TRUE(combiner.Join(&var, &push, &batch));
+  ASSERT_EQ(1, batch.size());
+  EXPECT_EQ(&push, batch[0]);
+  combiner.Finish(batch, Status::OK());
+  EXPECT_TRUE(push.done.HasBeenNotified());
+}
+
+TEST(SparseApplyCombinerTest, CombinesUpToMaxPushes) {
+  const int kPushes = 4;
+  // The window is long enough that only max_pushes ends the batch.
+  SparseApplyCombiner combiner(60 * 1000 * 1000, kPushes);
+  int var = 0;
+  std::vector<std::unique_ptr<SparseGradPush>> pushes(kPushes);
+  std::atomic<int> leaders(0);
+  std::atomic<int> batch_size(0);
+  {
+    thread::ThreadPool pool(Env::Default(), "combiner_test", kPushes);
+    for (int i = 0; i < kPushes; ++i) {
+      pushes[i].reset(new SparseGradPush);
+      SparseGradPush* push = pushes[i].get();
+      pool.Schedule([&combiner, &var, &leaders, &batch_size, push] {
+        std::vector<SparseGradPush*> batch;
+        if (combiner.Join(&var, push, &batch)) {
+          ++leaders;
+          batch_size = batch.size();
+          combiner.Finish(batch, errors::Internal("apply failed"));
+        }
+      });
+    }
+  }
+  EXPECT_EQ(1, leaders);
+  EXPECT_EQ(kPushes, batch_size);
+  for (const auto& push : pushes) {
+    EXPECT_TRUE(push->done.HasBeenNotified());
+    EXPECT_EQ(error::INTERNAL, push->status.code());
+  }
+}
+
+TEST(SparseApplyCombinerTest, VariablesAreCombinedSeparately) {
+  SparseApplyCombiner combiner(1000, 8);
+  int var_a = 0, var_b = 0;
+  SparseGradPush push_a, push_b;
+  std::vector<SparseGradPush*> batch_a, batch_b;
+  EXPECT_TRUE(combiner.Join(&var_a, &push_a, &batch_a));
+  EXPECT_TRUE(combiner.Join(&var_b, &push_b, &batch_b));
+  EXPECT_EQ(1, batch_a.size());
+  EXPECT_EQ(1, batch_b.size());
+}
+
+class KvSparseGradientAccumulateTest : public OpsTestBase {
+ protected:
+  void CreateOp(int n, int m) {
+    TF_ASSERT_OK(NodeDefBuilder("op", "_KvSparseGradientAccumulate")
+                     .Input(FakeInput(n, DT_FLOAT))
+                     .Input(FakeInput(n, DT_INT64))
+                     .Input(FakeInput(m, DT_INT64))
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(KvSparseGradientAccumulateTest, MergesTheMicroBatches) {
+  CreateOp(2, 0);
+  AddInputFromArray<float>(TensorShape({3, 2}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<float>(TensorShape({2, 2}), {10, 20, 30, 40});
+  AddInputFromArray<int64>(TensorShape({3}), {7, 3, 9});
+  AddInputFromArray<int64>(TensorShape({2}), {9, 7});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_indices(DT_INT64, TensorShape({3}));
+  test::FillValues<int64>(&expected_indices, {7, 3, 9});
+  Tensor expected_grad(DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(&expected_grad, {31, 42, 3, 4, 15, 26});
+  test::ExpectTensorEqual<int64>(expected_indices, *GetOutput(0));
+  test::ExpectTensorEqual<float>(expected_grad, *GetOutput(1));
+  EXPECT_EQ(0, GetOutput(2)->NumElements());
+}
+
+TEST_F(KvSparseGradientAccumulateTest, SumsTheCounts) {
+  CreateOp(2, 2);
+  AddInputFromArray<float>(TensorShape({1, 1}), {1});
+  AddInputFromArray<float>(TensorShape({2, 1}), {2, 3});
+  AddInputFromArray<int64>(TensorShape({1}), {5});
+  AddInputFromArray<int64>(TensorShape({2}), {6, 5});
+  AddInputFromArray<int64>(TensorShape({1}), {2});
+  AddInputFromArray<int64>(TensorShape({2}), {4, 1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_grad(DT_FLOAT, TensorShape({2, 1}));
+  test::FillValues<float>(&expected_grad, {4, 2});
+  Tensor expected_counts(DT_INT64, TensorShape({2}));
+  test::FillValues<int64>(&expected_counts, {3, 4});
+  test::ExpectTensorEqual<float>(expected_grad, *GetOutput(1));
+  test::ExpectTensorEqual<int64>(expected_counts, *GetOutput(2));
+}
+
+TEST_F(KvSparseGradientAccumulateTest, EmptyMicroBatch) {
+  CreateOp(2, 2);
+  AddInputFromArray<float>(TensorShape({0, 2}), {});
+  AddInputFromArray<float>(TensorShape({1, 2}), {1, 2});
+  AddInputFromArray<int64>(TensorShape({0}), {});
+  AddInputFromArray<int64>(TensorShape({1}), {8});
+  AddInputFromArray<int64>(TensorShape({0}), {});
+  AddInputFromArray<int64>(TensorShape({1}), {3});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_grad(DT_FLOAT, TensorShape({1, 2}));
+  test::FillValues<float>(&expected_grad, {1, 2});
+  Tensor expected_counts(DT_INT64, TensorShape({1}));
+  test::FillValues<int64>(&expected_counts, {3});
+  test::ExpectTensorEqual<float>(expected_grad, *GetOutput(1));
+  test::ExpectTensorEqual<int64>(expected_counts, *GetOutput(2));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -19,26 +19,42 @@ limitations under the License.
 #define EIGEN_USE_GPU
 #endif
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/embedding/cache.h"
 #include "tensorflow/core/framework/embedding/config.pb.h"
 #include "tensorflow/core/framework/embedding/embedding_var.h"
 #include "tensorflow/core/framework/embedding/embedding_var_context.h"
+#include "tensorflow/core/framework/embedding/hot_row_cache.h"
+#include "tensorflow/core/framework/embedding/worker_embedding_cache.h"
+#include "tensorflow/core/framework/ev_allocator.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/tensor_types.h"
 #include "tensorflow/core/kernels/dense_update_functor.h"
 #include "tensorflow/core/kernels/gather_functor.h"
+#include "tensorflow/core/kernels/kv_delayed_apply_executor.h"
 #include "tensorflow/core/kernels/kv_variable_ops.h"
 #include "tensorflow/core/kernels/scatter_functor.h"
 #include "tensorflow/core/kernels/training_op_helpers.h"
 #include "tensorflow/core/kernels/variable_ops.h"
+#include "tensorflow/core/lib/core/coding.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/gtl/cleanup.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/mem.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/util/env_var.h"
+#include "tensorflow/core/util/guarded_philox_random.h"
 #include "tensorflow/core/util/util.h"
 #include "tensorflow/core/util/work_sharder.h"
 
@@ -107,6 +123,8 @@ class KvResourceLookupIDOp : public OpKernel {
     core::ScopedUnref unref_me(ev);
     const Tensor& indices = c->input(1);
     const int64 N = indices.NumElements();
+    OP_REQUIRES_OK(c, KvDelayedApplyExecutor::Global()->WaitForKeys(
+                          ev, indices.flat<TKey>().data(), N));
 
     TensorShape result_shape = indices.shape();
 
@@ -266,6 +284,8 @@ class KvResourceGatherOp : public OpKernel {
     core::ScopedUnref unref_me(ev);
     const Tensor& indices = c->input(1);
     const int64 N = indices.NumElements();
+    OP_REQUIRES_OK(c, KvDelayedApplyExecutor::Global()->WaitForKeys(
+                          ev, indices.flat<TKey>().data(), N));
 
     TensorShape result_shape = indices.shape();
     TensorShape value_shape({ev->ValueLen()});
@@ -340,6 +360,713 @@ TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_CPU)
 #undef REGISTER_KERNELS_ALL
 #undef REGISTER_KERNELS
 
+// Truncates, looks up, pads and pools ragged sequences of ids in one
+// kernel, instead of the reshape, slice, gather, mask and reduce ops of the
+// unfused graph. Only the kept ids are looked up.
+template <typename TKey, typename TValue>
+class KvResourceSequenceGatherOp : public OpKernel {
+ public:
+  explicit KvResourceSequenceGatherOp(OpKernelConstruction* c)
+      : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("max_length", &max_length_));
+    OP_REQUIRES_OK(c, c->GetAttr("combiner", &combiner_));
+    OP_REQUIRES_OK(c, c->GetAttr("keep_last", &keep_last_));
+  }
+
+  void Compute(OpKernelContext* c) override {
+    EmbeddingVar<TKey, TValue>* ev = nullptr;
+    OP_REQUIRES_OK(c, LookupResource(c, HandleFromInput(c, 0), &ev));
+    core::ScopedUnref unref_me(ev);
+    const Tensor& values = c->input(1);
+    const Tensor& row_splits = c->input(2);
+    OP_REQUIRES(c, TensorShapeUtils::IsVector(values.shape()) &&
+                       TensorShapeUtils::IsVector(row_splits.shape()) &&
+                       row_splits.NumElements() > 0,
+                errors::InvalidArgument(
+                    "values and row_splits must be vectors, got ",
+                    values.shape().DebugString(), " and ",
+                    row_splits.shape().DebugString()));
+    const int64 batch = row_splits.NumElements() - 1;
+    const int64 num_values = values.NumElements();
+    const int64 dim = ev->ValueLen();
+    OP_REQUIRES_OK(c, KvDelayedApplyExecutor::Global()->WaitForKeys(
+                          ev, values.flat<TKey>().data(), num_values));
+    const int64 max_length = max_length_;
+    auto splits = row_splits.vec<int64>();
+    OP_REQUIRES(c, splits(0) == 0 && splits(batch) == num_values,
+                errors::InvalidArgument(
+                    "row_splits must start with 0 and end with the number "
+                    "of values ", num_values));
+
+    Tensor* ids_tensor = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(1, TensorShape({batch, max_length}),
+                                         &ids_tensor));
+    Tensor* lengths_tensor = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(2, TensorShape({batch}),
+                                         &lengths_tensor));
+    auto ids = ids_tensor->matrix<TKey>();
+    auto lengths = lengths_tensor->vec<int32>();
+    ids.setZero();
+
+    // The kept ids of all sequences are packed, sequence b from offsets[b].
+    std::vector<int64> offsets(batch + 1, 0);
+    for (int64 b = 0; b < batch; ++b) {
+      const int64 length = splits(b + 1) - splits(b);
+      OP_REQUIRES(c, length >= 0,
+                  errors::InvalidArgument("row_splits must be sorted"));
+      lengths(b) = static_cast<int32>(std::min(length, max_length));
+      offsets[b + 1] = offsets[b] + lengths(b);
+    }
+    const int64 num_kept = offsets[batch];
+    Tensor keys_tensor;
+    OP_REQUIRES_OK(c, c->allocate_temp(DataTypeToEnum<TKey>::v(),
+                                       TensorShape({num_kept}), &keys_tensor));
+    TKey* keys = keys_tensor.flat<TKey>().data();
+    const TKey* values_data = values.flat<TKey>().data();
+    for (int64 b = 0; b < batch; ++b) {
+      const int64 begin = keep_last_ ? splits(b + 1) - lengths(b) : splits(b);
+      for (int64 t = 0; t < lengths(b); ++t) {
+        keys[offsets[b] + t] = values_data[begin + t];
+        ids(b, t) = values_data[begin + t];
+      }
+    }
+
+    Tensor embeddings_tensor;
+    OP_REQUIRES_OK(c, c->allocate_temp(DataTypeToEnum<TValue>::v(),
+                                       TensorShape({num_kept, dim}),
+                                       &embeddings_tensor));
+    TValue* embeddings = embeddings_tensor.flat<TValue>().data();
+    if (num_kept > 0) {
+      EmbeddingVarContext<CPUDevice> ev_ctx(c);
+      ev->GetEmbeddings(ev_ctx, keys, embeddings, num_kept);
+      ev->UpdateCache(keys_tensor, true);
+    }
+
+    const bool pooled = combiner_ != "none";
+    const bool mean = combiner_ == "mean";
+    TensorShape output_shape({batch});
+    if (!pooled) {
+      output_shape.AddDim(max_length);
+    }
+    output_shape.AddDim(dim);
+    Tensor* output_tensor = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(0, output_shape, &output_tensor));
+    TValue* output = output_tensor->flat<TValue>().data();
+    const int64 out_stride = pooled ? dim : max_length * dim;
+
+    auto fill = [&](int64 begin, int64 end) {
+      for (int64 b = begin; b < end; ++b) {
+        const TValue* emb = embeddings + offsets[b] * dim;
+        const int64 length = lengths(b);
+        TValue* out = output + b * out_stride;
+        if (!pooled) {
+          std::copy_n(emb, length * dim, out);
+          std::fill(out + length * dim, out + out_stride,
+                    static_cast<TValue>(0));
+          continue;
+        }
+        std::fill(out, out + dim, static_cast<TValue>(0));
+        for (int64 t = 0; t < length; ++t) {
+          for (int64 d = 0; d < dim; ++d) {
+            out[d] += emb[t * dim + d];
+          }
+        }
+        if (mean && length > 0) {
+          const TValue scale = static_cast<TValue>(1.0 / length);
+          for (int64 d = 0; d < dim; ++d) {
+            out[d] *= scale;
+          }
+        }
+      }
+    };
+    auto worker_threads = c->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, batch,
+          max_length * dim, fill);
+  }
+
+ private:
+  int64 max_length_;
+  string combiner_;
+  bool keep_last_;
+};
+
+#define REGISTER_KERNELS(dev, ktype, vtype)                       \
+  REGISTER_KERNEL_BUILDER(Name("KvResourceSequenceGather")        \
+                              .Device(DEVICE_##dev)               \
+                              .TypeConstraint<vtype>("dtype")     \
+                              .TypeConstraint<ktype>("Tkeys"),    \
+                          KvResourceSequenceGatherOp<ktype, vtype>)
+
+#define REGISTER_KERNELS_ALL(dev, type)                           \
+  REGISTER_KERNELS(dev, int32, type);                             \
+  REGISTER_KERNELS(dev, int64, type)
+#define REGISTER_KERNELS_CPU(type) REGISTER_KERNELS_ALL(CPU, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_CPU)
+#undef REGISTER_KERNELS_CPU
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+
+// Samples the negatives of the positives of a batch, from the other
+// positives and from an item pool by an alias table of the frequencies of
+// the items, and looks up the distinct sampled ids with one gather. The
+// table is rebuilt every refresh_steps runs, and when the pool changes.
+template <typename TKey, typename TValue>
+class KvResourceSampleNegativesOp : public OpKernel {
+ public:
+  explicit KvResourceSampleNegativesOp(OpKernelConstruction* c)
+      : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("num_negatives", &num_negatives_));
+    OP_REQUIRES_OK(c, c->GetAttr("num_in_batch", &num_in_batch_));
+    OP_REQUIRES_OK(c, c->GetAttr("distortion", &distortion_));
+    OP_REQUIRES_OK(c, c->GetAttr("refresh_steps", &refresh_steps_));
+    OP_REQUIRES(c, num_in_batch_ <= num_negatives_,
+                errors::InvalidArgument(
+                    "num_in_batch ", num_in_batch_,
+                    " must not exceed num_negatives ", num_negatives_));
+    OP_REQUIRES_OK(c, generator_.Init(c));
+  }
+
+  void Compute(OpKernelContext* c) override {
+    EmbeddingVar<TKey, TValue>* ev = nullptr;
+    OP_REQUIRES_OK(c, LookupResource(c, HandleFromInput(c, 0), &ev));
+    core::ScopedUnref unref_me(ev);
+    const Tensor& item_pool = c->input(1);
+    const Tensor& positives = c->input(2);
+    OP_REQUIRES(c, TensorShapeUtils::IsVector(item_pool.shape()) &&
+                       TensorShapeUtils::IsVector(positives.shape()),
+                errors::InvalidArgument(
+                    "item_pool and positives must be vectors, got ",
+                    item_pool.shape().DebugString(), " and ",
+                    positives.shape().DebugString()));
+    const int64 batch = positives.NumElements();
+    const int64 dim = ev->ValueLen();
+    // A batch of one positive has no in-batch negatives.
+    const int64 num_in_batch = batch > 1 ? num_in_batch_ : 0;
+    OP_REQUIRES(c, num_in_batch == num_negatives_ ||
+                       item_pool.NumElements() > 0,
+                errors::InvalidArgument("item_pool must not be empty"));
+
+    Tensor* ids_tensor = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(
+                          1, TensorShape({batch, num_negatives_}),
+                          &ids_tensor));
+    auto ids = ids_tensor->matrix<TKey>();
+    auto positive_ids = positives.vec<TKey>();
+    {
+      mutex_lock l(mu_);
+      if (num_in_batch < num_negatives_) {
+        MaybeRebuildTable(c, ev, item_pool);
+      }
+      // Uniform64 and RandFloat draw three 32-bit samples at most.
+      random::PhiloxRandom philox =
+          generator_.ReserveSamples32(batch * num_negatives_ * 3);
+      random::SimplePhilox rng(&philox);
+      for (int64 b = 0; b < batch; ++b) {
+        for (int64 k = 0; k < num_in_batch; ++k) {
+          int64 other = rng.Uniform64(batch - 1);
+          if (other >= b) {
+            ++other;
+          }
+          ids(b, k) = positive_ids(other);
+        }
+        for (int64 k = num_in_batch; k < num_negatives_; ++k) {
+          const int64 i = rng.Uniform64(prob_.size());
+          ids(b, k) = pool_keys_[rng.RandFloat() < prob_[i] ? i : alias_[i]];
+        }
+      }
+    }
+
+    const int64 num_ids = batch * num_negatives_;
+    const TKey* ids_data = ids_tensor->flat<TKey>().data();
+    std::unordered_map<TKey, int64> slot_of;
+    slot_of.reserve(num_ids);
+    std::vector<int64> slots(num_ids);
+    std::vector<TKey> unique_ids;
+    for (int64 i = 0; i < num_ids; ++i) {
+      auto it = slot_of.emplace(ids_data[i], unique_ids.size());
+      if (it.second) {
+        unique_ids.push_back(ids_data[i]);
+      }
+      slots[i] = it.first->second;
+    }
+    const int64 num_unique = unique_ids.size();
+    OP_REQUIRES(c, !ev->IsMultiLevel() || ev->CacheSize() >= num_unique,
+                errors::InvalidArgument(
+                    "MultiLevel EV's Cache size ", ev->CacheSize(),
+                    " should large than IDs in batch ", num_unique));
+    Tensor keys_tensor;
+    OP_REQUIRES_OK(c, c->allocate_temp(DataTypeToEnum<TKey>::v(),
+                                       TensorShape({num_unique}),
+                                       &keys_tensor));
+    std::copy(unique_ids.begin(), unique_ids.end(),
+              keys_tensor.flat<TKey>().data());
+    Tensor embeddings_tensor;
+    OP_REQUIRES_OK(c, c->allocate_temp(DataTypeToEnum<TValue>::v(),
+                                       TensorShape({num_unique, dim}),
+                                       &embeddings_tensor));
+    TValue* embeddings = embeddings_tensor.flat<TValue>().data();
+    if (num_unique > 0) {
+      EmbeddingVarContext<CPUDevice> ev_ctx(c);
+      ev->GetEmbeddings(ev_ctx, keys_tensor.flat<TKey>().data(), embeddings,
+                        num_unique);
+      ev->UpdateCache(keys_tensor, true);
+    }
+
+    Tensor* output_tensor = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(
+                          0, TensorShape({batch, num_negatives_, dim}),
+                          &output_tensor));
+    TValue* output = output_tensor->flat<TValue>().data();
+    auto fill = [&](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        std::copy_n(embeddings + slots[i] * dim, dim, output + i * dim);
+      }
+    };
+    auto worker_threads = c->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_ids, dim,
+          fill);
+  }
+
+ private:
+  // Builds the alias table of the pool by Vose's method, from the weights
+  // (freq + 1) ^ distortion, so that the items never seen are drawn too.
+  void MaybeRebuildTable(OpKernelContext* c, EmbeddingVar<TKey, TValue>* ev,
+                         const Tensor& item_pool)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    const int64 n = item_pool.NumElements();
+    const TKey* pool = item_pool.flat<TKey>().data();
+    const uint64 fingerprint = Fingerprint64(StringPiece(
+        reinterpret_cast<const char*>(pool), n * sizeof(TKey)));
+    if (!prob_.empty() && fingerprint == pool_fingerprint_ &&
+        ++steps_since_rebuild_ < refresh_steps_) {
+      return;
+    }
+    pool_keys_.assign(pool, pool + n);
+    pool_fingerprint_ = fingerprint;
+    steps_since_rebuild_ = 0;
+
+    std::vector<double> weights(n);
+    const double distortion = distortion_;
+    auto weigh = [&](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        weights[i] = std::pow(ev->GetFreq(pool[i]) + 1.0, distortion);
+      }
+    };
+    auto worker_threads = c->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, n, 1000,
+          weigh);
+
+    const double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+    std::vector<int64> small, large;
+    for (int64 i = 0; i < n; ++i) {
+      weights[i] *= n / total;
+      (weights[i] < 1.0 ? small : large).push_back(i);
+    }
+    prob_.assign(n, 1.0f);
+    alias_.resize(n);
+    std::iota(alias_.begin(), alias_.end(), 0);
+    while (!small.empty() && !large.empty()) {
+      const int64 s = small.back();
+      small.pop_back();
+      const int64 l = large.back();
+      prob_[s] = weights[s];
+      alias_[s] = l;
+      weights[l] -= 1.0 - weights[s];
+      if (weights[l] < 1.0) {
+        large.pop_back();
+        small.push_back(l);
+      }
+    }
+  }
+
+  int64 num_negatives_;
+  int64 num_in_batch_;
+  float distortion_;
+  int64 refresh_steps_;
+  GuardedPhiloxRandom generator_;
+
+  mutex mu_;
+  std::vector<TKey> pool_keys_ GUARDED_BY(mu_);
+  std::vector<float> prob_ GUARDED_BY(mu_);
+  std::vector<int64> alias_ GUARDED_BY(mu_);
+  uint64 pool_fingerprint_ GUARDED_BY(mu_) = 0;
+  int64 steps_since_rebuild_ GUARDED_BY(mu_) = 0;
+};
+
+#define REGISTER_KERNELS(dev, ktype, vtype)                       \
+  REGISTER_KERNEL_BUILDER(Name("KvResourceSampleNegatives")       \
+                              .Device(DEVICE_##dev)               \
+                              .TypeConstraint<vtype>("dtype")     \
+                              .TypeConstraint<ktype>("Tkeys"),    \
+                          KvResourceSampleNegativesOp<ktype, vtype>)
+
+#define REGISTER_KERNELS_ALL(dev, type)                           \
+  REGISTER_KERNELS(dev, int32, type);                             \
+  REGISTER_KERNELS(dev, int64, type)
+#define REGISTER_KERNELS_CPU(type) REGISTER_KERNELS_ALL(CPU, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_CPU)
+#undef REGISTER_KERNELS_CPU
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+
+namespace {
+
+// The crosses of KvResourceSparseCrossGather looked up at once.
+constexpr int64 kCrossGatherChunkKeys = 1 << 14;
+
+// The scale of the embeddings of a row of n crosses, for the combiner.
+double CrossCombinerScale(const string& combiner, int64 n) {
+  if (n == 0 || combiner == "sum") {
+    return 1.0;
+  }
+  return combiner == "mean" ? 1.0 / n : 1.0 / std::sqrt(n);
+}
+
+}  // namespace
+
+// Crosses the sparse features like SparseCross with hashed_output, and
+// looks up and combines the embeddings of the crosses of each row, without
+// the crossed SparseTensor between them. The crosses are looked up by
+// chunks, so that only their int64 keys are kept for all the batch.
+template <typename TValue>
+class KvResourceSparseCrossGatherOp : public OpKernel {
+ public:
+  explicit KvResourceSparseCrossGatherOp(OpKernelConstruction* c)
+      : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("num_buckets", &num_buckets_));
+    // Read as int64 since uint64 attributes are not supported.
+    int64 signed_hash_key;
+    OP_REQUIRES_OK(c, c->GetAttr("hash_key", &signed_hash_key));
+    hash_key_ = static_cast<uint64>(signed_hash_key);
+    OP_REQUIRES_OK(c, c->GetAttr("combiner", &combiner_));
+  }
+
+  void Compute(OpKernelContext* c) override {
+    EmbeddingVar<int64, TValue>* ev = nullptr;
+    OP_REQUIRES_OK(c, LookupResource(c, HandleFromInput(c, 0), &ev));
+    core::ScopedUnref unref_me(ev);
+    OpInputList indices_list;
+    OP_REQUIRES_OK(c, c->input_list("indices", &indices_list));
+    OpInputList values_list;
+    OP_REQUIRES_OK(c, c->input_list("values", &values_list));
+    OpInputList shapes_list;
+    OP_REQUIRES_OK(c, c->input_list("shapes", &shapes_list));
+    const int num_columns = indices_list.size();
+    const int64 dim = ev->ValueLen();
+
+    // The features of row b of column i are fingerprints[i] from
+    // starts[i][b] to starts[i][b + 1].
+    int64 batch = 0;
+    std::vector<std::vector<int64>> starts(num_columns);
+    std::vector<std::vector<uint64>> fingerprints(num_columns);
+    for (int i = 0; i < num_columns; ++i) {
+      const Tensor& indices = indices_list[i];
+      const Tensor& values = values_list[i];
+      const Tensor& shape = shapes_list[i];
+      OP_REQUIRES(c, TensorShapeUtils::IsMatrix(indices.shape()) &&
+                         TensorShapeUtils::IsVector(values.shape()) &&
+                         TensorShapeUtils::IsVector(shape.shape()) &&
+                         shape.NumElements() == 2 &&
+                         indices.dim_size(0) == values.NumElements(),
+                  errors::InvalidArgument("Input ", i,
+                                          " is not a 2-D SparseTensor"));
+      if (i == 0) {
+        batch = shape.vec<int64>()(0);
+      }
+      OP_REQUIRES(c, shape.vec<int64>()(0) == batch,
+                  errors::InvalidArgument(
+                      "Expected batch size ", batch, ", got ",
+                      shape.vec<int64>()(0), " at input ", i));
+      const int64 nnz = values.NumElements();
+      auto rows = indices.matrix<int64>();
+      starts[i].assign(batch + 1, 0);
+      for (int64 n = 0; n < nnz; ++n) {
+        OP_REQUIRES(c, rows(n, 0) >= 0 && rows(n, 0) < batch &&
+                           (n == 0 || rows(n, 0) >= rows(n - 1, 0)),
+                    errors::InvalidArgument(
+                        "The indices of input ", i, " must be ordered rows "
+                        "in [0, ", batch, "), got ", rows(n, 0)));
+        starts[i][rows(n, 0) + 1]++;
+      }
+      std::partial_sum(starts[i].begin(), starts[i].end(), starts[i].begin());
+      fingerprints[i].resize(nnz);
+      if (values.dtype() == DT_STRING) {
+        auto strings = values.vec<tstring>();
+        for (int64 n = 0; n < nnz; ++n) {
+          fingerprints[i][n] = Fingerprint64(strings(n));
+        }
+      } else {
+        auto ids = values.vec<int64>();
+        for (int64 n = 0; n < nnz; ++n) {
+          fingerprints[i][n] = static_cast<uint64>(ids(n));
+        }
+      }
+    }
+
+    Tensor* splits_tensor = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(2, TensorShape({batch + 1}),
+                                         &splits_tensor));
+    auto splits = splits_tensor->vec<int64>();
+    splits(0) = 0;
+    for (int64 b = 0; b < batch; ++b) {
+      int64 count = num_columns > 0 ? 1 : 0;
+      for (int i = 0; i < num_columns; ++i) {
+        count *= starts[i][b + 1] - starts[i][b];
+      }
+      splits(b + 1) = splits(b) + count;
+    }
+    const int64 num_keys = splits(batch);
+    Tensor* keys_tensor = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(1, TensorShape({num_keys}),
+                                         &keys_tensor));
+    int64* keys = keys_tensor->flat<int64>().data();
+
+    auto cross = [&](int64 begin, int64 end) {
+      gtl::InlinedVector<int64, 8> pos(num_columns);
+      for (int64 b = begin; b < end; ++b) {
+        std::fill(pos.begin(), pos.end(), 0);
+        for (int64 k = splits(b); k < splits(b + 1); ++k) {
+          uint64 hash = hash_key_;
+          for (int i = 0; i < num_columns; ++i) {
+            hash = FingerprintCat64(hash,
+                                    fingerprints[i][starts[i][b] + pos[i]]);
+          }
+          keys[k] = num_buckets_ > 0 ? hash % num_buckets_ : hash % kint64max;
+          // The next cross, the last column varies fastest.
+          for (int i = num_columns - 1; i >= 0; --i) {
+            if (++pos[i] < starts[i][b + 1] - starts[i][b]) {
+              break;
+            }
+            pos[i] = 0;
+          }
+        }
+      }
+    };
+    auto worker_threads = c->device()->tensorflow_cpu_worker_threads();
+    const int64 row_cost =
+        (num_keys / std::max<int64>(batch, 1) + 1) * num_columns * 20;
+    Shard(worker_threads->num_threads, worker_threads->workers, batch,
+          row_cost, cross);
+
+    Tensor* output_tensor = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(0, TensorShape({batch, dim}),
+                                         &output_tensor));
+    TValue* output = output_tensor->flat<TValue>().data();
+    std::fill(output, output + batch * dim, static_cast<TValue>(0));
+    if (num_keys == 0) {
+      return;
+    }
+
+    Tensor chunk_tensor;
+    const int64 chunk_keys = std::min(num_keys, kCrossGatherChunkKeys);
+    OP_REQUIRES_OK(c, c->allocate_temp(DataTypeToEnum<TValue>::v(),
+                                       TensorShape({chunk_keys, dim}),
+                                       &chunk_tensor));
+    TValue* chunk = chunk_tensor.flat<TValue>().data();
+    EmbeddingVarContext<CPUDevice> ev_ctx(c);
+    int64 first_row = 0;
+    for (int64 k0 = 0; k0 < num_keys; k0 += kCrossGatherChunkKeys) {
+      const int64 k1 = std::min(num_keys, k0 + kCrossGatherChunkKeys);
+      ev->GetEmbeddings(ev_ctx, keys + k0, chunk, k1 - k0);
+      while (splits(first_row + 1) <= k0) {
+        ++first_row;
+      }
+      int64 last_row = first_row;
+      while (last_row < batch && splits(last_row) < k1) {
+        ++last_row;
+      }
+      auto combine = [&](int64 begin, int64 end) {
+        for (int64 b = first_row + begin; b < first_row + end; ++b) {
+          const int64 n = splits(b + 1) - splits(b);
+          const TValue scale =
+              static_cast<TValue>(CrossCombinerScale(combiner_, n));
+          TValue* out = output + b * dim;
+          for (int64 k = std::max(splits(b), k0);
+               k < std::min(splits(b + 1), k1); ++k) {
+            const TValue* emb = chunk + (k - k0) * dim;
+            for (int64 d = 0; d < dim; ++d) {
+              out[d] += emb[d] * scale;
+            }
+          }
+        }
+      };
+      Shard(worker_threads->num_threads, worker_threads->workers,
+            last_row - first_row, (k1 - k0) / (last_row - first_row) * dim,
+            combine);
+    }
+    ev->UpdateCache(*keys_tensor, true);
+  }
+
+ private:
+  int64 num_buckets_;
+  uint64 hash_key_;
+  string combiner_;
+};
+
+// Sums the gradients of the crosses of KvResourceSparseCrossGather by key,
+// so that every key is updated once.
+template <typename TValue>
+class KvResourceSparseCrossGatherGradOp : public OpKernel {
+ public:
+  explicit KvResourceSparseCrossGatherGradOp(OpKernelConstruction* c)
+      : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("combiner", &combiner_));
+  }
+
+  void Compute(OpKernelContext* c) override {
+    const Tensor& grad = c->input(0);
+    const Tensor& keys_tensor = c->input(1);
+    const Tensor& row_splits = c->input(2);
+    OP_REQUIRES(c, TensorShapeUtils::IsMatrix(grad.shape()) &&
+                       TensorShapeUtils::IsVector(keys_tensor.shape()) &&
+                       row_splits.NumElements() == grad.dim_size(0) + 1,
+                errors::InvalidArgument(
+                    "Expected a [batch, dim] grad and batch + 1 row_splits, "
+                    "got ", grad.shape().DebugString(), " and ",
+                    row_splits.shape().DebugString()));
+    const int64 batch = grad.dim_size(0);
+    const int64 dim = grad.dim_size(1);
+    auto splits = row_splits.vec<int64>();
+    const int64* keys = keys_tensor.flat<int64>().data();
+    OP_REQUIRES(c, splits(batch) == keys_tensor.NumElements(),
+                errors::InvalidArgument(
+                    "row_splits must end with the number of keys ",
+                    keys_tensor.NumElements()));
+
+    std::unordered_map<int64, int64> index;
+    index.reserve(keys_tensor.NumElements());
+    std::vector<int64> unique_keys;
+    std::vector<int64> slots(keys_tensor.NumElements());
+    for (int64 k = 0; k < keys_tensor.NumElements(); ++k) {
+      auto it = index.emplace(keys[k], unique_keys.size());
+      if (it.second) {
+        unique_keys.push_back(keys[k]);
+      }
+      slots[k] = it.first->second;
+    }
+
+    const int64 num_unique = unique_keys.size();
+    Tensor* keys_out = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(0, TensorShape({num_unique}),
+                                         &keys_out));
+    std::copy(unique_keys.begin(), unique_keys.end(),
+              keys_out->flat<int64>().data());
+    Tensor* values_out = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(1, TensorShape({num_unique, dim}),
+                                         &values_out));
+    TValue* values = values_out->flat<TValue>().data();
+    std::fill(values, values + num_unique * dim, static_cast<TValue>(0));
+    const TValue* grad_data = grad.flat<TValue>().data();
+    for (int64 b = 0; b < batch; ++b) {
+      OP_REQUIRES(c, splits(b) <= splits(b + 1),
+                  errors::InvalidArgument("row_splits must be sorted"));
+      const TValue scale = static_cast<TValue>(
+          CrossCombinerScale(combiner_, splits(b + 1) - splits(b)));
+      const TValue* g = grad_data + b * dim;
+      for (int64 k = splits(b); k < splits(b + 1); ++k) {
+        TValue* row = values + slots[k] * dim;
+        for (int64 d = 0; d < dim; ++d) {
+          row[d] += g[d] * scale;
+        }
+      }
+    }
+  }
+
+ private:
+  string combiner_;
+};
+
+#define REGISTER_KERNELS(type)                                      \
+  REGISTER_KERNEL_BUILDER(Name("KvResourceSparseCrossGather")       \
+                              .Device(DEVICE_CPU)                   \
+                              .TypeConstraint<type>("dtype"),       \
+                          KvResourceSparseCrossGatherOp<type>)      \
+  REGISTER_KERNEL_BUILDER(Name("KvResourceSparseCrossGatherGrad")   \
+                              .Device(DEVICE_CPU)                   \
+                              .TypeConstraint<type>("dtype"),       \
+                          KvResourceSparseCrossGatherGradOp<type>)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS)
+#undef REGISTER_KERNELS
+
+// Gathers the keys from all the tables of an EmbeddingVariable group with
+// one probe of their shared storage, then copies the rows of every table
+// from the entries found.
+template <typename TKey, typename TValue>
+class KvResourceGroupGatherOp : public OpKernel {
+ public:
+  explicit KvResourceGroupGatherOp(OpKernelConstruction* c) : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("num_tables", &num_tables_));
+  }
+
+  void Compute(OpKernelContext* c) override {
+    std::vector<EmbeddingVar<TKey, TValue>*> evs;
+    auto unref_evs = gtl::MakeCleanup([&evs]() {
+      for (auto ev : evs) {
+        ev->Unref();
+      }
+    });
+    for (int i = 0; i < num_tables_; ++i) {
+      EmbeddingVar<TKey, TValue>* ev = nullptr;
+      OP_REQUIRES_OK(c, LookupResource(c, HandleFromInput(c, i), &ev));
+      evs.push_back(ev);
+      OP_REQUIRES(c, ev->storage() == evs[0]->storage(),
+          errors::InvalidArgument(
+              "The tables of a group must share the storage of their"
+              " primary, ", HandleFromInput(c, i).name(),
+              " does not share the one of ", HandleFromInput(c, 0).name()));
+    }
+    const Tensor& indices = c->input(num_tables_);
+    const int64 N = indices.NumElements();
+    OP_REQUIRES(c, !evs[0]->IsMultiLevel() || evs[0]->CacheSize() >= N,
+        errors::InvalidArgument(
+            "MultiLevel EV's Cache size ", evs[0]->CacheSize(),
+            " should large than IDs in batch ", N));
+    for (auto ev : evs) {
+      OP_REQUIRES_OK(c, KvDelayedApplyExecutor::Global()->WaitForKeys(
+                            ev, indices.flat<TKey>().data(), N));
+    }
+
+    Tensor* pointers = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(num_tables_, indices.shape(),
+                                         &pointers));
+    auto value_ptrs = reinterpret_cast<ValuePtr<TValue>**>(
+        pointers->flat<int64>().data());
+    EmbeddingVarContext<CPUDevice> ev_ctx(c);
+    if (N > 0) {
+      evs[0]->GetOrCreateKey(ev_ctx, indices, value_ptrs, N);
+    }
+    for (int i = 0; i < num_tables_; ++i) {
+      TensorShape result_shape = indices.shape();
+      result_shape.AddDim(evs[i]->ValueLen());
+      Tensor* out = nullptr;
+      OP_REQUIRES_OK(c, c->allocate_output(i, result_shape, &out));
+      if (N > 0) {
+        evs[i]->GatherEmbeddings(ev_ctx, indices, value_ptrs,
+                                 out->flat<TValue>().data(), N);
+      }
+    }
+  }
+
+ private:
+  int num_tables_;
+};
+
+#define REGISTER_KERNELS(dev, ktype, vtype)                       \
+  REGISTER_KERNEL_BUILDER(Name("KvResourceGroupGather")           \
+                              .Device(DEVICE_##dev)               \
+                              .TypeConstraint<vtype>("dtype")     \
+                              .TypeConstraint<ktype>("Tkeys"),    \
+                          KvResourceGroupGatherOp<ktype, vtype>)
+
+#define REGISTER_KERNELS_ALL(dev, type)                           \
+  REGISTER_KERNELS(dev, int32, type);                             \
+  REGISTER_KERNELS(dev, int64, type)
+#define REGISTER_KERNELS_CPU(type) REGISTER_KERNELS_ALL(CPU, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_CPU)
+#undef REGISTER_KERNELS_CPU
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+
 #if GOOGLE_CUDA
 template <typename Device, typename TKey, typename TValue, bool has_counts>
 class KvResourceGatherGPUOp : public OpKernel {
@@ -533,6 +1260,110 @@ TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_ALL)
 #undef REGISTER_KERNELS_ALL
 #undef REGISTER_KERNELS
 
+template <typename TKey, typename TValue>
+class EVGetStatsOp : public OpKernel {
+ public:
+  explicit EVGetStatsOp(OpKernelConstruction* c) : OpKernel(c) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    EmbeddingVar<TKey, TValue>* ev = nullptr;
+    OP_REQUIRES_OK(ctx,
+                   LookupResource(ctx, HandleFromInput(ctx, 0), &ev));
+    core::ScopedUnref unref_me(ev);
+    std::vector<string> names;
+    std::vector<double> values;
+    ev->GetStats(&names, &values);
+
+    const int64 num_stats = names.size();
+    Tensor* names_output;
+    OP_REQUIRES_OK(ctx,
+        ctx->allocate_output(0, {num_stats}, &names_output));
+    Tensor* values_output;
+    OP_REQUIRES_OK(ctx,
+        ctx->allocate_output(1, {num_stats}, &values_output));
+    for (int64 i = 0; i < num_stats; ++i) {
+      names_output->flat<tstring>()(i) = names[i];
+      values_output->flat<double>()(i) = values[i];
+    }
+  }
+};
+
+#define REGISTER_KERNELS(ktype, vtype)                          \
+  REGISTER_KERNEL_BUILDER(Name("EVGetStats")                    \
+                            .Device(DEVICE_CPU)                 \
+                            .TypeConstraint<ktype>("Tkeys")     \
+                            .TypeConstraint<vtype>("Tvalues"),  \
+                          EVGetStatsOp<ktype, vtype>);
+#define REGISTER_KERNELS_ALL(type)                              \
+  REGISTER_KERNELS(int32, type)                                 \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_ALL)
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+
+#if GOOGLE_CUDA
+#define REGISTER_KERNELS(ktype, vtype)                          \
+  REGISTER_KERNEL_BUILDER(Name("EVGetStats")                    \
+                            .Device(DEVICE_GPU)                 \
+                            .HostMemory("names")                \
+                            .HostMemory("values")               \
+                            .TypeConstraint<ktype>("Tkeys")     \
+                            .TypeConstraint<vtype>("Tvalues"),  \
+                          EVGetStatsOp<ktype, vtype>);
+#define REGISTER_KERNELS_ALL(type)                              \
+  REGISTER_KERNELS(int32, type)                                 \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_GPU_NUMBER_TYPES(REGISTER_KERNELS_ALL)
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+#endif  // GOOGLE_CUDA
+
+template <typename TKey, typename TValue>
+class KvResourcePrefetchOp : public OpKernel {
+ public:
+  explicit KvResourcePrefetchOp(OpKernelConstruction* c) : OpKernel(c) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    EmbeddingVar<TKey, TValue>* ev = nullptr;
+    OP_REQUIRES_OK(ctx,
+                   LookupResource(ctx, HandleFromInput(ctx, 0), &ev));
+    core::ScopedUnref unref_me(ev);
+    const Tensor& indices = ctx->input(1);
+    if (indices.NumElements() > 0) {
+      ev->Prefetch(indices);
+    }
+  }
+};
+
+#define REGISTER_KERNELS(ktype, vtype)                          \
+  REGISTER_KERNEL_BUILDER(Name("KvResourcePrefetch")            \
+                            .Device(DEVICE_CPU)                 \
+                            .TypeConstraint<ktype>("Tkeys")     \
+                            .TypeConstraint<vtype>("dtype"),    \
+                          KvResourcePrefetchOp<ktype, vtype>);
+#define REGISTER_KERNELS_ALL(type)                              \
+  REGISTER_KERNELS(int32, type)                                 \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_ALL)
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+
+#if GOOGLE_CUDA
+#define REGISTER_KERNELS(ktype, vtype)                          \
+  REGISTER_KERNEL_BUILDER(Name("KvResourcePrefetch")            \
+                            .Device(DEVICE_GPU)                 \
+                            .HostMemory("indices")              \
+                            .TypeConstraint<ktype>("Tkeys")     \
+                            .TypeConstraint<vtype>("dtype"),    \
+                          KvResourcePrefetchOp<ktype, vtype>);
+#define REGISTER_KERNELS_ALL(type)                              \
+  REGISTER_KERNELS(int32, type)                                 \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_GPU_NUMBER_TYPES(REGISTER_KERNELS_ALL)
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+#endif  // GOOGLE_CUDA
+
 template <typename TKey, typename TValue>
 class KvResourceLookupTierOp : public OpKernel {
  public:
@@ -586,4 +1417,702 @@ TF_CALL_GPU_NUMBER_TYPES(REGISTER_KERNELS_ALL)
 #undef REGISTER_KERNELS
 #endif  // GOOGLE_CUDA
 
+#define REGISTER_KERNELS(ktype, vtype)                          \
+  REGISTER_KERNEL_BUILDER(Name("HotRowCacheHandleOp")           \
+                            .Device(DEVICE_CPU)                 \
+                            .TypeConstraint<ktype>("Tkeys")     \
+                            .TypeConstraint<vtype>("dtype"),    \
+                          ResourceHandleOp<                     \
+                              embedding::HotRowCache<ktype, vtype>>);
+#define REGISTER_KERNELS_ALL(type)                              \
+  REGISTER_KERNELS(int32, type)                                 \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_ALL)
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+
+template <typename TKey, typename TValue>
+Status LookupOrCreateHotRowCache(OpKernelContext* ctx, int64 value_len,
+    embedding::HotRowCache<TKey, TValue>** cache) {
+  TF_RETURN_IF_ERROR(LookupOrCreateResource<
+      embedding::HotRowCache<TKey, TValue>>(
+          ctx, HandleFromInput(ctx, 0), cache,
+          [value_len](embedding::HotRowCache<TKey, TValue>** ptr) {
+            *ptr = new embedding::HotRowCache<TKey, TValue>(value_len);
+            return Status::OK();
+          }));
+  if ((*cache)->ValueLen() != value_len) {
+    int64 cache_len = (*cache)->ValueLen();
+    (*cache)->Unref();
+    return errors::InvalidArgument("The hot row cache has ", cache_len,
+                                   " dims, but ", value_len, " are given.");
+  }
+  return Status::OK();
+}
+
+template <typename TKey, typename TValue>
+class HotRowCacheLookupOp : public OpKernel {
+ public:
+  explicit HotRowCacheLookupOp(OpKernelConstruction* c) : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("value_dim", &value_dim_));
+    OP_REQUIRES_OK(c, c->GetAttr("max_staleness_steps",
+                                 &max_staleness_steps_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    embedding::HotRowCache<TKey, TValue>* cache = nullptr;
+    OP_REQUIRES_OK(ctx, LookupOrCreateHotRowCache(ctx, value_dim_, &cache));
+    core::ScopedUnref unref_me(cache);
+    const Tensor& ids = ctx->input(1);
+    int64 step = ctx->input(2).scalar<int64>()();
+    int64 n = ids.NumElements();
+
+    Tensor* values = nullptr;
+    Tensor* hits = nullptr;
+    Tensor* is_stale = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, {n, value_dim_}, &values));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(1, {n}, &hits));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(2, {}, &is_stale));
+    is_stale->scalar<bool>()() = !cache->Lookup(
+        ids.flat<TKey>().data(), n, step, max_staleness_steps_,
+        values->flat<TValue>().data(), hits->flat<bool>().data());
+  }
+
+ private:
+  int64 value_dim_;
+  int64 max_staleness_steps_;
+};
+
+#define REGISTER_KERNELS(ktype, vtype)                          \
+  REGISTER_KERNEL_BUILDER(Name("HotRowCacheLookup")             \
+                            .Device(DEVICE_CPU)                 \
+                            .TypeConstraint<ktype>("Tkeys")     \
+                            .TypeConstraint<vtype>("dtype"),    \
+                          HotRowCacheLookupOp<ktype, vtype>);
+#define REGISTER_KERNELS_ALL(type)                              \
+  REGISTER_KERNELS(int32, type)                                 \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_ALL)
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+
+template <typename TKey, typename TValue>
+class HotRowCacheRefreshOp : public OpKernel {
+ public:
+  explicit HotRowCacheRefreshOp(OpKernelConstruction* c) : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("max_rows", &max_rows_));
+    OP_REQUIRES_OK(c, c->GetAttr("min_freq", &min_freq_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& ids = ctx->input(1);
+    const Tensor& values = ctx->input(2);
+    const Tensor& freqs = ctx->input(3);
+    int64 n = ids.NumElements();
+    OP_REQUIRES(ctx, TensorShapeUtils::IsMatrix(values.shape()) &&
+                     values.dim_size(0) == n && freqs.NumElements() == n,
+                errors::InvalidArgument(
+                    "values should be [", n, ", dim] and freqs should be [",
+                    n, "], got ", values.shape().DebugString(), " and ",
+                    freqs.shape().DebugString()));
+    embedding::HotRowCache<TKey, TValue>* cache = nullptr;
+    OP_REQUIRES_OK(ctx, LookupOrCreateHotRowCache(ctx, values.dim_size(1),
+                                                  &cache));
+    core::ScopedUnref unref_me(cache);
+    cache->Refresh(ids.flat<TKey>().data(), values.flat<TValue>().data(),
+                   freqs.flat<int64>().data(), n, max_rows_, min_freq_,
+                   ctx->input(4).scalar<int64>()());
+  }
+
+ private:
+  int64 max_rows_;
+  int64 min_freq_;
+};
+
+#define REGISTER_KERNELS(ktype, vtype)                          \
+  REGISTER_KERNEL_BUILDER(Name("HotRowCacheRefresh")            \
+                            .Device(DEVICE_CPU)                 \
+                            .TypeConstraint<ktype>("Tkeys")     \
+                            .TypeConstraint<vtype>("dtype"),    \
+                          HotRowCacheRefreshOp<ktype, vtype>);
+#define REGISTER_KERNELS_ALL(type)                              \
+  REGISTER_KERNELS(int32, type)                                 \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_ALL)
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+
+template <typename TKey, typename TValue>
+class HotRowCacheAccumulateOp : public OpKernel {
+ public:
+  explicit HotRowCacheAccumulateOp(OpKernelConstruction* c) : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("max_staleness_steps",
+                                 &max_staleness_steps_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& ids = ctx->input(1);
+    const Tensor& grads = ctx->input(2);
+    int64 n = ids.NumElements();
+    OP_REQUIRES(ctx, TensorShapeUtils::IsMatrix(grads.shape()) &&
+                     grads.dim_size(0) == n,
+                errors::InvalidArgument(
+                    "grads should be [", n, ", dim], got ",
+                    grads.shape().DebugString()));
+    int64 value_len = grads.dim_size(1);
+    embedding::HotRowCache<TKey, TValue>* cache = nullptr;
+    OP_REQUIRES_OK(ctx, LookupOrCreateHotRowCache(ctx, value_len, &cache));
+    core::ScopedUnref unref_me(cache);
+
+    std::vector<TKey> flush_ids;
+    std::vector<TValue> flush_grads;
+    cache->Accumulate(ids.flat<TKey>().data(), grads.flat<TValue>().data(),
+                      n, ctx->input(3).scalar<int64>()(),
+                      max_staleness_steps_, &flush_ids, &flush_grads);
+    int64 num_flushed = flush_ids.size();
+    Tensor* ids_out = nullptr;
+    Tensor* grads_out = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, {num_flushed}, &ids_out));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(1, {num_flushed, value_len},
+                                             &grads_out));
+    if (num_flushed > 0) {
+      memcpy(ids_out->flat<TKey>().data(), flush_ids.data(),
+             num_flushed * sizeof(TKey));
+      memcpy(grads_out->flat<TValue>().data(), flush_grads.data(),
+             num_flushed * value_len * sizeof(TValue));
+    }
+  }
+
+ private:
+  int64 max_staleness_steps_;
+};
+
+#define REGISTER_KERNELS(ktype, vtype)                          \
+  REGISTER_KERNEL_BUILDER(Name("HotRowCacheAccumulate")         \
+                            .Device(DEVICE_CPU)                 \
+                            .TypeConstraint<ktype>("Tkeys")     \
+                            .TypeConstraint<vtype>("dtype"),    \
+                          HotRowCacheAccumulateOp<ktype, vtype>);
+#define REGISTER_KERNELS_ALL(type)                              \
+  REGISTER_KERNELS(int32, type)                                 \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_ALL)
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+
+template <typename TKey, typename TValue>
+class KvResourceGatherIfModifiedOp : public OpKernel {
+ public:
+  explicit KvResourceGatherIfModifiedOp(OpKernelConstruction* c)
+      : OpKernel(c) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    EmbeddingVar<TKey, TValue>* ev = nullptr;
+    OP_REQUIRES_OK(ctx, LookupResource(ctx, HandleFromInput(ctx, 0), &ev));
+    core::ScopedUnref unref_me(ev);
+    const Tensor& indices = ctx->input(1);
+    const Tensor& versions = ctx->input(2);
+    const int64 N = indices.NumElements();
+    OP_REQUIRES(ctx, versions.NumElements() == N,
+                errors::InvalidArgument(
+                    "versions should have ", N, " elements, got ",
+                    versions.NumElements()));
+    auto indices_flat = indices.flat<TKey>();
+    auto versions_flat = versions.flat<int64>();
+
+    Tensor* modified = nullptr;
+    Tensor* output_versions = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, {N}, &modified));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(2, {N}, &output_versions));
+    auto modified_flat = modified->flat<bool>();
+    auto output_versions_flat = output_versions->flat<int64>();
+    bool is_record_version = ev->IsRecordVersion();
+    std::vector<TKey> modified_keys;
+    for (int64 i = 0; i < N; i++) {
+      int64 version = embedding::WorkerEmbeddingCache<TKey, TValue>::kNoVersion;
+      if (is_record_version) {
+        version = ev->GetVersion(indices_flat(i));
+      }
+      output_versions_flat(i) = version;
+      modified_flat(i) = !is_record_version ||
+          versions_flat(i) ==
+              embedding::WorkerEmbeddingCache<TKey, TValue>::kNoVersion ||
+          versions_flat(i) != version;
+      if (modified_flat(i)) {
+        modified_keys.emplace_back(indices_flat(i));
+      }
+    }
+
+    const int64 num_modified = modified_keys.size();
+    Tensor* out = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(
+        1, {num_modified, ev->ValueLen()}, &out));
+    if (num_modified > 0) {
+      EmbeddingVarContext<CPUDevice> ev_ctx(ctx);
+      ev->GetEmbeddings(ev_ctx, modified_keys.data(),
+                        out->flat<TValue>().data(), num_modified);
+      Tensor keys_tensor(DataTypeToEnum<TKey>::v(), {num_modified});
+      memcpy(keys_tensor.flat<TKey>().data(), modified_keys.data(),
+             num_modified * sizeof(TKey));
+      ev->UpdateCache(keys_tensor, true);
+    }
+  }
+};
+
+#define REGISTER_KERNELS(ktype, vtype)                          \
+  REGISTER_KERNEL_BUILDER(Name("KvResourceGatherIfModified")    \
+                            .Device(DEVICE_CPU)                 \
+                            .TypeConstraint<ktype>("Tkeys")     \
+                            .TypeConstraint<vtype>("dtype"),    \
+                          KvResourceGatherIfModifiedOp<ktype, vtype>);
+#define REGISTER_KERNELS_ALL(type)                              \
+  REGISTER_KERNELS(int32, type)                                 \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_ALL)
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+
+template <typename TKey, typename TValue>
+class KvResourceGatherRowAddressesOp : public OpKernel {
+ public:
+  explicit KvResourceGatherRowAddressesOp(OpKernelConstruction* c)
+      : OpKernel(c) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    EmbeddingVar<TKey, TValue>* ev = nullptr;
+    OP_REQUIRES_OK(ctx, LookupResource(ctx, HandleFromInput(ctx, 0), &ev));
+    core::ScopedUnref unref_me(ev);
+    const Tensor& indices = ctx->input(1);
+    const int64 N = indices.NumElements();
+    auto indices_flat = indices.flat<TKey>();
+
+    Tensor* addresses = nullptr;
+    Tensor* remote_keys = nullptr;
+    Tensor* row_bytes = nullptr;
+    Tensor* versions = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, {N}, &addresses));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(1, {N}, &remote_keys));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(2, {N}, &row_bytes));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(3, {N}, &versions));
+    auto addresses_flat = addresses->flat<int64>();
+    auto remote_keys_flat = remote_keys->flat<int64>();
+    auto row_bytes_flat = row_bytes->flat<int64>();
+    auto versions_flat = versions->flat<int64>();
+    const bool is_record_version = ev->IsRecordVersion();
+    for (int64 i = 0; i < N; i++) {
+      int64 bytes = 0;
+      uint32 remote_key = 0;
+      const void* address = ev->RowAddress(indices_flat(i), &bytes);
+      if (address == nullptr || !EVRemoteKey(address, bytes, &remote_key)) {
+        address = nullptr;
+        bytes = 0;
+      }
+      addresses_flat(i) = reinterpret_cast<int64>(address);
+      remote_keys_flat(i) = remote_key;
+      row_bytes_flat(i) = bytes;
+      versions_flat(i) =
+          address != nullptr && is_record_version
+              ? ev->GetVersion(indices_flat(i))
+              : embedding::WorkerEmbeddingCache<TKey, TValue>::kNoVersion;
+    }
+  }
+};
+
+#define REGISTER_KERNELS(ktype, vtype)                          \
+  REGISTER_KERNEL_BUILDER(Name("KvResourceGatherRowAddresses")  \
+                            .Device(DEVICE_CPU)                 \
+                            .TypeConstraint<ktype>("Tkeys")     \
+                            .TypeConstraint<vtype>("dtype"),    \
+                          KvResourceGatherRowAddressesOp<ktype, vtype>);
+#define REGISTER_KERNELS_ALL(type)                              \
+  REGISTER_KERNELS(int32, type)                                 \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_ALL)
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+
+#define REGISTER_KERNELS(ktype, vtype)                          \
+  REGISTER_KERNEL_BUILDER(Name("EVWorkerCacheHandleOp")         \
+                            .Device(DEVICE_CPU)                 \
+                            .TypeConstraint<ktype>("Tkeys")     \
+                            .TypeConstraint<vtype>("dtype"),    \
+                          ResourceHandleOp<                     \
+                              embedding::WorkerEmbeddingCache<  \
+                                  ktype, vtype>>);
+#define REGISTER_KERNELS_ALL(type)                              \
+  REGISTER_KERNELS(int32, type)                                 \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_ALL)
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+
+// The worker cache of a variable also reads or, on the writer process of
+// the host, publishes the rows of a HostSharedEmbeddingCache when
+// TF_EV_HOST_CACHE_ROWS > 0.
+template <typename TKey, typename TValue>
+Status CreateHostSharedEmbeddingCache(const ResourceHandle& handle,
+    int64 value_len, embedding::WorkerEmbeddingCache<TKey, TValue>* cache) {
+  int64 num_slots = 0;
+  TF_RETURN_IF_ERROR(ReadInt64FromEnvVar("TF_EV_HOST_CACHE_ROWS", 0,
+                                         &num_slots));
+  if (num_slots <= 0) {
+    return Status::OK();
+  }
+  bool is_writer = false;
+  int64 max_staleness_ms = 0;
+  string name_space;
+  TF_RETURN_IF_ERROR(ReadBoolFromEnvVar("TF_EV_HOST_CACHE_WRITER", false,
+                                        &is_writer));
+  TF_RETURN_IF_ERROR(ReadInt64FromEnvVar("TF_EV_HOST_CACHE_STALENESS_MS",
+                                         1000, &max_staleness_ms));
+  TF_RETURN_IF_ERROR(ReadStringFromEnvVar("TF_EV_HOST_CACHE_NAMESPACE",
+                                          "deeprec", &name_space));
+  const string name = embedding::HostSharedEmbeddingCache<TKey, TValue>::
+      SharedMemoryName(name_space,
+                       strings::StrCat(handle.container(), "/",
+                                       handle.name()));
+  cache->SetHostCache(
+      std::unique_ptr<embedding::HostSharedEmbeddingCache<TKey, TValue>>(
+          new embedding::HostSharedEmbeddingCache<TKey, TValue>(
+              name, value_len, num_slots, is_writer,
+              max_staleness_ms * 1000)));
+  return Status::OK();
+}
+
+// With TF_EV_WORKER_CACHE_SNAPSHOT_DIR, the rows of the worker cache of a
+// variable are written to a file of that local directory every
+// TF_EV_WORKER_CACHE_SNAPSHOT_STEPS steps, and loaded back from it when the
+// worker restarts. A snapshot which can't be loaded is ignored.
+template <typename TKey, typename TValue>
+Status SetWorkerEmbeddingCacheSnapshot(const ResourceHandle& handle,
+    embedding::WorkerEmbeddingCache<TKey, TValue>* cache) {
+  string snapshot_dir;
+  int64 snapshot_steps = 0;
+  TF_RETURN_IF_ERROR(ReadStringFromEnvVar("TF_EV_WORKER_CACHE_SNAPSHOT_DIR",
+                                          "", &snapshot_dir));
+  TF_RETURN_IF_ERROR(ReadInt64FromEnvVar("TF_EV_WORKER_CACHE_SNAPSHOT_STEPS",
+                                         1000, &snapshot_steps));
+  if (snapshot_dir.empty()) {
+    return Status::OK();
+  }
+  Env* env = Env::Default();
+  TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(snapshot_dir));
+  string file_name = strings::StrCat(handle.container(), "-", handle.name());
+  std::replace(file_name.begin(), file_name.end(), '/', '_');
+  const string path = io::JoinPath(snapshot_dir, file_name);
+  Status s = cache->SetSnapshot(env, path, std::max<int64>(snapshot_steps, 1));
+  if (!s.ok()) {
+    LOG(WARNING) << "Ignore the worker cache snapshot " << path << ": " << s;
+  } else {
+    VLOG(1) << "Loaded " << cache->Size() << " rows of the worker cache "
+            << "snapshot " << path;
+  }
+  return Status::OK();
+}
+
+template <typename TKey, typename TValue>
+Status LookupOrCreateWorkerEmbeddingCache(OpKernelContext* ctx,
+    int64 value_len, embedding::WorkerEmbeddingCache<TKey, TValue>** cache) {
+  const ResourceHandle& handle = HandleFromInput(ctx, 0);
+  TF_RETURN_IF_ERROR(LookupOrCreateResource<
+      embedding::WorkerEmbeddingCache<TKey, TValue>>(
+          ctx, handle, cache,
+          [value_len, &handle](
+              embedding::WorkerEmbeddingCache<TKey, TValue>** ptr) {
+            *ptr = new embedding::WorkerEmbeddingCache<TKey, TValue>(
+                value_len);
+            TF_RETURN_IF_ERROR(
+                CreateHostSharedEmbeddingCache(handle, value_len, *ptr));
+            return SetWorkerEmbeddingCacheSnapshot(handle, *ptr);
+          }));
+  if ((*cache)->ValueLen() != value_len) {
+    int64 cache_len = (*cache)->ValueLen();
+    (*cache)->Unref();
+    return errors::InvalidArgument("The worker embedding cache has ",
+                                   cache_len, " dims, but ", value_len,
+                                   " are given.");
+  }
+  return Status::OK();
+}
+
+template <typename TKey, typename TValue>
+class EVWorkerCacheLookupOp : public OpKernel {
+ public:
+  explicit EVWorkerCacheLookupOp(OpKernelConstruction* c) : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("value_dim", &value_dim_));
+    OP_REQUIRES_OK(c, c->GetAttr("max_staleness_steps",
+                                 &max_staleness_steps_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    embedding::WorkerEmbeddingCache<TKey, TValue>* cache = nullptr;
+    OP_REQUIRES_OK(ctx, LookupOrCreateWorkerEmbeddingCache(ctx, value_dim_,
+                                                           &cache));
+    core::ScopedUnref unref_me(cache);
+    const Tensor& ids = ctx->input(1);
+    int64 n = ids.NumElements();
+
+    TensorShape values_shape = ids.shape();
+    values_shape.AddDim(value_dim_);
+    Tensor* values = nullptr;
+    Tensor* hits = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, values_shape, &values));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(1, ids.shape(), &hits));
+    std::vector<TKey> miss_ids;
+    std::vector<int64> miss_versions;
+    cache->Lookup(ids.flat<TKey>().data(), n, max_staleness_steps_,
+                  values->flat<TValue>().data(), hits->flat<bool>().data(),
+                  &miss_ids, &miss_versions);
+
+    const int64 num_misses = miss_ids.size();
+    Tensor* miss_ids_out = nullptr;
+    Tensor* miss_versions_out = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(2, {num_misses},
+                                             &miss_ids_out));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(3, {num_misses},
+                                             &miss_versions_out));
+    if (num_misses > 0) {
+      memcpy(miss_ids_out->flat<TKey>().data(), miss_ids.data(),
+             num_misses * sizeof(TKey));
+      memcpy(miss_versions_out->flat<int64>().data(), miss_versions.data(),
+             num_misses * sizeof(int64));
+    }
+  }
+
+ private:
+  int64 value_dim_;
+  int64 max_staleness_steps_;
+};
+
+#define REGISTER_KERNELS(ktype, vtype)                          \
+  REGISTER_KERNEL_BUILDER(Name("EVWorkerCacheLookup")           \
+                            .Device(DEVICE_CPU)                 \
+                            .TypeConstraint<ktype>("Tkeys")     \
+                            .TypeConstraint<vtype>("dtype"),    \
+                          EVWorkerCacheLookupOp<ktype, vtype>);
+#define REGISTER_KERNELS_ALL(type)                              \
+  REGISTER_KERNELS(int32, type)                                 \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_ALL)
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+
+template <typename TKey, typename TValue>
+class EVWorkerCacheMergeOp : public OpKernel {
+ public:
+  explicit EVWorkerCacheMergeOp(OpKernelConstruction* c) : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("capacity", &capacity_));
+    OP_REQUIRES_OK(c, c->GetAttr("max_staleness_steps",
+                                 &max_staleness_steps_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& values = ctx->input(1);
+    const Tensor& hits = ctx->input(2);
+    const Tensor& miss_ids = ctx->input(3);
+    const Tensor& modified = ctx->input(4);
+    const Tensor& modified_values = ctx->input(5);
+    const Tensor& versions = ctx->input(6);
+    int64 n = hits.NumElements();
+    int64 num_misses = miss_ids.NumElements();
+    OP_REQUIRES(ctx, values.dims() >= 1 && n > 0 ?
+                     values.NumElements() % n == 0 : true,
+                errors::InvalidArgument(
+                    "values ", values.shape().DebugString(),
+                    " doesn't match hits ", hits.shape().DebugString()));
+    int64 value_len = (n > 0) ? values.NumElements() / n
+                              : values.dim_size(values.dims() - 1);
+    OP_REQUIRES(ctx, modified.NumElements() == num_misses &&
+                     versions.NumElements() == num_misses,
+                errors::InvalidArgument(
+                    "modified and versions should have ", num_misses,
+                    " elements, got ", modified.NumElements(), " and ",
+                    versions.NumElements()));
+    embedding::WorkerEmbeddingCache<TKey, TValue>* cache = nullptr;
+    OP_REQUIRES_OK(ctx, LookupOrCreateWorkerEmbeddingCache(ctx, value_len,
+                                                           &cache));
+    core::ScopedUnref unref_me(cache);
+
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, values.shape(), &output));
+    if (n == 0) {
+      return;
+    }
+    memcpy(output->flat<TValue>().data(), values.flat<TValue>().data(),
+           values.NumElements() * sizeof(TValue));
+    cache->Merge(n, hits.flat<bool>().data(), miss_ids.flat<TKey>().data(),
+                 modified.flat<bool>().data(),
+                 modified_values.flat<TValue>().data(),
+                 versions.flat<int64>().data(), capacity_,
+                 max_staleness_steps_, output->flat<TValue>().data());
+    Status s = cache->MaybeSnapshot();
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to snapshot the worker cache: " << s;
+    }
+  }
+
+ private:
+  int64 capacity_;
+  int64 max_staleness_steps_;
+};
+
+#define REGISTER_KERNELS(ktype, vtype)                          \
+  REGISTER_KERNEL_BUILDER(Name("EVWorkerCacheMerge")            \
+                            .Device(DEVICE_CPU)                 \
+                            .TypeConstraint<ktype>("Tkeys")     \
+                            .TypeConstraint<vtype>("dtype"),    \
+                          EVWorkerCacheMergeOp<ktype, vtype>);
+#define REGISTER_KERNELS_ALL(type)                              \
+  REGISTER_KERNELS(int32, type)                                 \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_ALL)
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+
+// The ids are encoded as: the number of unique ids, the deltas of the sorted
+// unique ids from the previous one (from 0 for the first), then optionally
+// their counts, all as varints. The deltas are taken on the ids as uint64,
+// so that they wrap around for negative ids.
+template <typename TKey>
+class KvIdsDedupEncodeOp : public OpKernel {
+ public:
+  explicit KvIdsDedupEncodeOp(OpKernelConstruction* c) : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("encode_counts", &encode_counts_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& ids = ctx->input(0);
+    const Tensor& counts = ctx->input(1);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsVector(ids.shape()),
+                errors::InvalidArgument("ids must be a vector, got ",
+                                        ids.shape().DebugString()));
+    const int64 n = ids.NumElements();
+    const bool has_counts = counts.NumElements() > 0;
+    OP_REQUIRES(ctx, !has_counts || counts.NumElements() == n,
+                errors::InvalidArgument(
+                    "counts should be empty or have ", n,
+                    " elements, got ", counts.NumElements()));
+    auto ids_flat = ids.flat<TKey>();
+
+    std::vector<int64> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&ids_flat](int64 a, int64 b) {
+      return ids_flat(a) < ids_flat(b);
+    });
+    Tensor* idx = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(1, ids.shape(), &idx));
+    auto idx_flat = idx->flat<int32>();
+    std::vector<TKey> unique_ids;
+    std::vector<int64> unique_counts;
+    for (int64 i : order) {
+      if (unique_ids.empty() || unique_ids.back() != ids_flat(i)) {
+        unique_ids.push_back(ids_flat(i));
+        unique_counts.push_back(0);
+      }
+      idx_flat(i) = unique_ids.size() - 1;
+      unique_counts.back() += has_counts ? counts.flat<int64>()(i) : 1;
+    }
+
+    string bytes;
+    core::PutVarint64(&bytes, unique_ids.size());
+    uint64 prev = 0;
+    for (TKey id : unique_ids) {
+      const uint64 cur = static_cast<uint64>(static_cast<int64>(id));
+      core::PutVarint64(&bytes, cur - prev);
+      prev = cur;
+    }
+    if (encode_counts_) {
+      for (int64 count : unique_counts) {
+        core::PutVarint64(&bytes, count);
+      }
+    }
+    Tensor* encoded = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(
+                            0, TensorShape({static_cast<int64>(bytes.size())}),
+                            &encoded));
+    memcpy(encoded->flat<uint8>().data(), bytes.data(), bytes.size());
+  }
+
+ private:
+  bool encode_counts_;
+};
+
+#define REGISTER_KERNELS(ktype)                                 \
+  REGISTER_KERNEL_BUILDER(Name("KvIdsDedupEncode")              \
+                            .Device(DEVICE_CPU)                 \
+                            .TypeConstraint<ktype>("Tkeys"),    \
+                          KvIdsDedupEncodeOp<ktype>);
+REGISTER_KERNELS(int32)
+REGISTER_KERNELS(int64)
+#undef REGISTER_KERNELS
+
+template <typename TKey>
+class KvIdsDecodeOp : public OpKernel {
+ public:
+  explicit KvIdsDecodeOp(OpKernelConstruction* c) : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("decode_counts", &decode_counts_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& encoded = ctx->input(0);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsVector(encoded.shape()),
+                errors::InvalidArgument("encoded must be a vector, got ",
+                                        encoded.shape().DebugString()));
+    const char* p =
+        reinterpret_cast<const char*>(encoded.flat<uint8>().data());
+    const char* limit = p + encoded.NumElements();
+    uint64 n = 0;
+    p = core::GetVarint64Ptr(p, limit, &n);
+    // Each varint takes at least a byte.
+    OP_REQUIRES(ctx, p != nullptr &&
+                     n <= static_cast<uint64>(encoded.NumElements()),
+                errors::InvalidArgument("The encoded ids are corrupted"));
+
+    Tensor* ids = nullptr;
+    Tensor* counts = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(
+                            0, TensorShape({static_cast<int64>(n)}), &ids));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(
+                            1, TensorShape({decode_counts_ ?
+                                            static_cast<int64>(n) : 0}),
+                            &counts));
+    auto ids_flat = ids->flat<TKey>();
+    uint64 cur = 0;
+    for (uint64 i = 0; i < n; ++i) {
+      uint64 delta = 0;
+      p = core::GetVarint64Ptr(p, limit, &delta);
+      OP_REQUIRES(ctx, p != nullptr,
+                  errors::InvalidArgument("The encoded ids are truncated"));
+      cur += delta;
+      ids_flat(i) = static_cast<TKey>(static_cast<int64>(cur));
+    }
+    if (decode_counts_) {
+      auto counts_flat = counts->flat<int64>();
+      for (uint64 i = 0; i < n; ++i) {
+        uint64 count = 0;
+        p = core::GetVarint64Ptr(p, limit, &count);
+        OP_REQUIRES(ctx, p != nullptr,
+                    errors::InvalidArgument(
+                        "The encoded counts are truncated"));
+        counts_flat(i) = static_cast<int64>(count);
+      }
+    }
+    OP_REQUIRES(ctx, p == limit,
+                errors::InvalidArgument(
+                    "The encoded ids have ", limit - p, " trailing bytes"));
+  }
+
+ private:
+  bool decode_counts_;
+};
+
+#define REGISTER_KERNELS(ktype)                                 \
+  REGISTER_KERNEL_BUILDER(Name("KvIdsDecode")                   \
+                            .Device(DEVICE_CPU)                 \
+                            .TypeConstraint<ktype>("Tkeys"),    \
+                          KvIdsDecodeOp<ktype>);
+REGISTER_KERNELS(int32)
+REGISTER_KERNELS(int64)
+#undef REGISTER_KERNELS
+
 }  // namespace tensorflow
@@ -75,6 +75,16 @@ Status MoveSsdFiles(Env* env,
         input_prefix + "*-emb_files";
     TF_RETURN_IF_ERROR(MoveMatchingFiles(
         env, input_emb_files_pattern, merged_prefix, input_prefix.size()));
+
+    const tstring& input_mmap_kv_pattern =
+        input_prefix + "*-mmap_kv";
+    TF_RETURN_IF_ERROR(MoveMatchingFiles(
+        env, input_mmap_kv_pattern, merged_prefix, input_prefix.size()));
+
+    const tstring& input_ev_columnar_pattern =
+        input_prefix + "*-ev_columnar";
+    TF_RETURN_IF_ERROR(MoveMatchingFiles(
+        env, input_ev_columnar_pattern, merged_prefix, input_prefix.size()));
   }
   return Status::OK();
 }
@@ -195,6 +205,7 @@ class InitializeKvVariableOp : public OpKernel {
     OP_REQUIRES_OK(c, c->GetAttr("slot_num", &slot_num_));
     OP_REQUIRES_OK(c, c->GetAttr("record_freq", &record_freq_));
     OP_REQUIRES_OK(c, c->GetAttr("record_version", &record_version_));
+    OP_REQUIRES_OK(c, c->GetAttr("int8_state", &int8_state_));
     int embedding_var_type= 0;
     Status s = c->GetAttr("embedding_variable_type", &embedding_var_type);
     if (!s.ok()) {
@@ -234,13 +245,17 @@ class InitializeKvVariableOp : public OpKernel {
       filter_freq_ = 0;
     }
 
+    // Single tier storages on CPU choose layouts the same way as DRAM.
+    bool is_single_tier_cpu = storage_type <= 5 ||
+                              storage_type == embedding::DRAM_SWISS ||
+                              storage_type == embedding::DRAM_NUMA;
     OP_REQUIRES_OK(c, c->GetAttr("layout", &layout_));
     if (!layout_.empty()) {
       // use layout by user configuration
     } else if ((filter_freq_ != 0 && max_element_size_ == 0)
                || steps_to_live_ != 0 || record_freq_
-               || record_version_ || storage_type > 5) {
-      if (block_num_ > 1 || (filter_freq_ != 0 && storage_type <= 5)) {
+               || record_version_ || !is_single_tier_cpu) {
+      if (block_num_ > 1 || (filter_freq_ != 0 && is_single_tier_cpu)) {
         layout_ = "normal";
       } else {
         if (storage_type == embedding::HBM_DRAM ||
@@ -258,9 +273,33 @@ class InitializeKvVariableOp : public OpKernel {
 
     if ("compact" == layout_) {
       OP_REQUIRES(c, shape_.dim_size(0) == 1 &&
-            storage_type_ == embedding::StorageType::DRAM,
+            (storage_type_ == embedding::StorageType::DRAM ||
+             storage_type_ == embedding::StorageType::DRAM_SWISS ||
+             storage_type_ == embedding::StorageType::DRAM_NUMA),
           errors::InvalidArgument("embedding_dim must be 1 and storage type"
-                                  " should be DRAM when layout is 'compact'."));
+                                  " should be DRAM, DRAM_SWISS or DRAM_NUMA"
+                                  " when layout is 'compact'."));
+    }
+
+    if ("quantized_int8" == layout_ || "quantized_fp16" == layout_) {
+      OP_REQUIRES(c, block_num_ == 1 && slot_num_ == 0 &&
+            (storage_type_ == embedding::StorageType::DRAM ||
+             storage_type_ == embedding::StorageType::DRAM_SWISS ||
+             storage_type_ == embedding::StorageType::DRAM_NUMA),
+          errors::InvalidArgument("Quantized layouts are inference only,"
+                                  " they need storage type DRAM, DRAM_SWISS"
+                                  " or DRAM_NUMA and no slots."));
+    }
+
+    if ("mixed_dim" == layout_) {
+      OP_REQUIRES(c, block_num_ == 1 && record_freq_ &&
+            l2_weight_threshold_ < 0 &&
+            (storage_type_ == embedding::StorageType::DRAM ||
+             storage_type_ == embedding::StorageType::DRAM_SWISS ||
+             storage_type_ == embedding::StorageType::DRAM_NUMA),
+          errors::InvalidArgument("The mixed_dim layout needs record_freq,"
+                                  " no l2_weight_threshold and storage type"
+                                  " DRAM, DRAM_SWISS or DRAM_NUMA."));
     }
 
     if (steps_to_live_ == kEmbeddingVarUseDB ||
@@ -343,7 +382,11 @@ class InitializeKvVariableOp : public OpKernel {
                 gpu_allocator);
             return Status::OK();
           }));
-      ev->Init(default_values, default_value_dim_);
+      // The EmbeddingVars shared with the previous model version are
+      // already initialized and restored.
+      if (!ev->IsShared()) {
+        ev->Init(default_values, default_value_dim_);
+      }
     } else {
       EmbeddingVar<TKey, TValue>* primary_variable = nullptr;
       OP_REQUIRES_OK(
@@ -387,20 +430,23 @@ class InitializeKvVariableOp : public OpKernel {
             context, handle_self, &ev,
             [this, default_values, opname, primary_variable,
              handle_self, context](EmbeddingVar<TKey, TValue>** ptr) {
+          auto embedding_config = EmbeddingConfig(
+              emb_index_ + block_num_ * slot_index_,
+              emb_index_,
+              block_num_, slot_num_, opname,
+              steps_to_live_, filter_freq_,
+              max_freq_, l2_weight_threshold_,
+              layout_, max_element_size_,
+              false_positive_probability_,
+              counter_type_, default_value_dim_,
+              default_value_no_permission_,
+              record_freq_, record_version_,
+              is_inference_);
+          embedding_config.int8_state = int8_state_;
           *ptr = new EmbeddingVar<TKey, TValue>(handle_self.name(),
               primary_variable->storage(),
-              EmbeddingConfig(emb_index_ + block_num_ * slot_index_,
-                              emb_index_,
-                              block_num_, slot_num_, opname,
-                              steps_to_live_, filter_freq_,
-                              max_freq_, l2_weight_threshold_,
-                              layout_, max_element_size_,
-                              false_positive_probability_,
-                              counter_type_, default_value_dim_,
-                              default_value_no_permission_,
-                              record_freq_, record_version_,
-                              is_inference_),
-          primary_variable->GetAllocator());
+              embedding_config,
+              primary_variable->GetAllocator());
           return (*ptr)->Init(default_values, default_value_dim_);
         }));
       core::ScopedUnref unref_me(primary_variable);
@@ -426,6 +472,7 @@ class InitializeKvVariableOp : public OpKernel {
   int64 max_freq_;
   float l2_weight_threshold_;
   std::string layout_;
+  bool int8_state_;
   int64 max_element_size_;
   float false_positive_probability_;
   embedding::StorageType storage_type_;
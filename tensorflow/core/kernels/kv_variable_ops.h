@@ -23,10 +23,13 @@ limitations under the License.
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/kernels/ev_columnar_checkpoint.h"
 #include "tensorflow/core/kernels/save_restore_tensor.h"
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/random.h"
@@ -56,13 +59,17 @@ class EVKeyDumpIterator: public  DumpIterator<T> {
   std::vector<T>& key_list_;
 };
 
+// row_dims_list is the values stored for each row of the mixed_dim
+// layout, the rest of the row is dumped as 0.
 template<class K, class T>
 class EVValueDumpIterator: public  DumpIterator<T> {
  public:
   EVValueDumpIterator(EmbeddingVar<K, T>*& ev,
-      std::vector<T* >& valueptr_list)
+      std::vector<T* >& valueptr_list,
+      const std::vector<int64>* row_dims_list = nullptr)
         : ev_(ev),
-          valueptr_list_(valueptr_list) {
+          valueptr_list_(valueptr_list),
+          row_dims_list_(row_dims_list) {
     keys_idx_ = 0;
     col_idx_ = 0;
   }
@@ -82,6 +89,11 @@ class EVValueDumpIterator: public  DumpIterator<T> {
       keys_idx_++;
       col_idx_ = 0;
     }
+    if (row_dims_list_ != nullptr &&
+        col_idx_ >= (*row_dims_list_)[keys_idx_]) {
+      col_idx_++;
+      return T(0);
+    }
     Eigen::array<Eigen::DenseIndex, 1> dims({ev_->ValueLen()});
     typename TTypes<T>::Flat value_flat =
       typename TTypes<T>::Flat(valueptr_list_[keys_idx_], dims);
@@ -91,6 +103,7 @@ class EVValueDumpIterator: public  DumpIterator<T> {
  private:
   EmbeddingVar<K, T>* ev_;
   std::vector<T* >& valueptr_list_;
+  const std::vector<int64>* row_dims_list_;
   int64 keys_idx_;
   int64 col_idx_;
 };
@@ -267,9 +280,7 @@ void CopyEmbeddingfilesToCkptDir(
 
   for (int64 i = 0; i < ssd_rec_desc.file_list.size(); i++) {
     int64 file_id = ssd_rec_desc.file_list[i];
-    std::stringstream old_ss;
-    old_ss << std::setw(4) << std::setfill('0') << file_id << ".emb";
-    std::string file_path = ssd_rec_desc.file_prefix + old_ss.str();
+    const std::string& file_path = ssd_rec_desc.file_path_list[i];
     std::string file_name = file_path.substr(file_path.rfind("/"));
     std::stringstream new_ss;
     new_ss << file_id << ".emb";
@@ -281,6 +292,357 @@ void CopyEmbeddingfilesToCkptDir(
   }
 }
 
+// Writes the admitted rows of the snapshot of ev to
+// "<prefix>-<var_name>-mmap_kv" in the layout of embedding::MmapKV, served
+// by the inference EmbeddingVariables restored with TF_EV_MMAP_SERVING.
+template <class K, class V>
+Status DumpMmapKV(EmbeddingVar<K, V>* ev,
+    const std::vector<K>& key_list,
+    const std::vector<V*>& valueptr_list,
+    const std::string& prefix,
+    const std::string& var_name) {
+  std::string var_name_temp(var_name);
+  std::string new_str = "_";
+  int64 pos = var_name_temp.find("/");
+  while (pos != std::string::npos) {
+    var_name_temp.replace(pos, 1, new_str.data(), 1);
+    pos = var_name_temp.find("/");
+  }
+
+  std::vector<K> keys;
+  std::vector<const V*> rows;
+  keys.reserve(key_list.size());
+  rows.reserve(key_list.size());
+  for (size_t i = 0; i < key_list.size(); i++) {
+    if (valueptr_list[i] == reinterpret_cast<V*>(-1)) {
+      // only forward, no backward, bypass
+    } else if (valueptr_list[i] == nullptr) {
+      if (ev->MinFreq() == 0) {
+        keys.emplace_back(key_list[i]);
+        rows.emplace_back(ev->GetDefaultValue(key_list[i]));
+      }
+    } else {
+      keys.emplace_back(key_list[i]);
+      rows.emplace_back(valueptr_list[i]);
+    }
+  }
+  return embedding::WriteMmapKVFile<K, V>(Env::Default(),
+      prefix + "-" + var_name_temp + "-mmap_kv", keys, rows,
+      ev->ValueLen());
+}
+
+// The name of the columnar checkpoint file of the EV var_name.
+inline std::string EVColumnarFileName(const std::string& prefix,
+                                      const std::string& var_name) {
+  std::string var_name_temp(var_name);
+  std::string new_str = "_";
+  int64 pos = var_name_temp.find("/");
+  while (pos != std::string::npos) {
+    var_name_temp.replace(pos, 1, new_str.data(), 1);
+    pos = var_name_temp.find("/");
+  }
+  return prefix + "-" + var_name_temp + "-ev_columnar";
+}
+
+// The threads of the streaming save, see DumpEmbeddingValuesStreaming.
+class KvSaveThreadPool {
+ public:
+  static thread::ThreadPool* GetInstance() {
+    static thread::ThreadPool tp(Env::Default(),
+        "save_ev_threadpool", ThreadNum());
+    return &tp;
+  }
+
+  static int64 ThreadNum() {
+    static int64 thread_num = [] {
+      int64 num = 4;
+      TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_SAVE_THREAD_NUM", 4, &num));
+      return std::max(num, static_cast<int64>(1));
+    }();
+    return thread_num;
+  }
+};
+
+// The threads of the parallel restore, see ImportRestoreBuffer. They are
+// not the threads of KvRestoreThreadPool, which run the restore ops
+// waiting for them.
+class KvImportThreadPool {
+ public:
+  static thread::ThreadPool* GetInstance() {
+    static thread::ThreadPool tp(Env::Default(),
+        "import_ev_threadpool", ThreadNum());
+    return &tp;
+  }
+
+  static int64 ThreadNum() {
+    static int64 thread_num = [] {
+      int64 num = 4;
+      TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_IMPORT_THREAD_NUM", 4, &num));
+      return std::max(num, static_cast<int64>(1));
+    }();
+    return thread_num;
+  }
+};
+
+// Runs fn(shard, start, end) on num_shards contiguous shards of [0, n) with
+// the threads of tp.
+inline void RunShards(thread::ThreadPool* tp, int64 num_shards, int64 n,
+    const std::function<void(int64, int64, int64)>& fn) {
+  const int64 shard_size = (n + num_shards - 1) / num_shards;
+  BlockingCounter counter(num_shards);
+  for (int64 i = 0; i < num_shards; i++) {
+    tp->Schedule([&fn, &counter, i, n, shard_size]() {
+      int64 start = std::min(n, i * shard_size);
+      fn(i, start, std::min(n, start + shard_size));
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+}
+
+// Writes the rows of tensor_name through a SegmentBundleWriter. The rows
+// are filled by fill_rows(start, end, out) in chunks of about 4MB on
+// KvSaveThreadPool, the chunks of the next wave are filled while the
+// current wave is written, so at most 2 waves of chunks are buffered.
+template <class T>
+Status SaveTensorInParallel(const string& tensor_name, BundleWriter* writer,
+    const TensorShape& shape,
+    const std::function<void(int64, int64, T*)>& fill_rows) {
+  SegmentBundleWriter segment_writer(writer, tensor_name, shape,
+                                     DataTypeToEnum<T>::v());
+  TF_RETURN_IF_ERROR(segment_writer.Begin());
+  const int64 rows = shape.dims() > 0 ? shape.dim_size(0) : 0;
+  const int64 row_len = shape.dims() > 1 ? shape.dim_size(1) : 1;
+  if (rows > 0 && row_len > 0) {
+    const int64 chunk_rows =
+        std::max((4 << 20) / static_cast<int64>(row_len * sizeof(T)),
+                 static_cast<int64>(1));
+    const int64 num_chunks = (rows + chunk_rows - 1) / chunk_rows;
+    const int64 wave_chunks = KvSaveThreadPool::ThreadNum();
+    const int64 num_waves = (num_chunks + wave_chunks - 1) / wave_chunks;
+    std::vector<std::vector<T>> buffers[2];
+    std::unique_ptr<BlockingCounter> counters[2];
+    auto fill_wave = [&](int64 wave) {
+      auto& bufs = buffers[wave % 2];
+      int64 first = wave * wave_chunks;
+      int64 last = std::min(num_chunks, first + wave_chunks);
+      bufs.resize(last - first);
+      counters[wave % 2].reset(new BlockingCounter(last - first));
+      BlockingCounter* counter = counters[wave % 2].get();
+      for (int64 c = first; c < last; c++) {
+        std::vector<T>* buf = &bufs[c - first];
+        KvSaveThreadPool::GetInstance()->Schedule([&fill_rows, buf, counter,
+                                                   c, chunk_rows, rows,
+                                                   row_len]() {
+          int64 start = c * chunk_rows;
+          int64 end = std::min(rows, start + chunk_rows);
+          buf->resize((end - start) * row_len);
+          fill_rows(start, end, buf->data());
+          counter->DecrementCount();
+        });
+      }
+    };
+    fill_wave(0);
+    Status st;
+    for (int64 wave = 0; wave < num_waves && st.ok(); wave++) {
+      counters[wave % 2]->Wait();
+      if (wave + 1 < num_waves) {
+        fill_wave(wave + 1);
+      }
+      for (auto& buf : buffers[wave % 2]) {
+        st = segment_writer.WriteData(buf.data(), buf.size() * sizeof(T));
+        if (!st.ok()) {
+          // The next wave refers to the buffers.
+          if (wave + 1 < num_waves) {
+            counters[(wave + 1) % 2]->Wait();
+          }
+          break;
+        }
+      }
+    }
+    TF_RETURN_IF_ERROR(st);
+  }
+  return segment_writer.End();
+}
+
+// Dumps the snapshot of ev in the layout of DumpEmbeddingValues:
+//  * The keys are partitioned by key % kSavedPartitionNum on
+//    KvSaveThreadPool into one index of the snapshot, instead of copying
+//    the keys, values, versions and freqs into the lists of every
+//    partition.
+//  * The tensors are written by SaveTensorInParallel with bounded buffers.
+template <class K, class V>
+Status DumpEmbeddingValuesStreaming(EmbeddingVar<K, V>* ev,
+    const string& tensor_key, BundleWriter* writer,
+    Tensor* part_offset_tensor,
+    const std::vector<K>& key_list,
+    const std::vector<V*>& valueptr_list,
+    const std::vector<int64>& version_list,
+    const std::vector<int64>& freq_list) {
+  bool save_unfiltered_features = true;
+  TF_CHECK_OK(ReadBoolFromEnvVar(
+      "TF_EV_SAVE_FILTERED_FEATURES", true, &save_unfiltered_features));
+  const int64 filter_freq = ev->MinFreq();
+  const int64 n = key_list.size();
+  const int64 num_shards = KvSaveThreadPool::ThreadNum();
+  // -1 for the keys skipped, 0 for the admitted and 1 for the filtered.
+  auto kind_of = [&](int64 i) {
+    if (valueptr_list[i] == reinterpret_cast<V*>(-1) ||
+        key_list[i] % kSavedPartitionNum < 0) {
+      // only forward, no backward, bypass
+      return -1;
+    } else if (valueptr_list[i] == nullptr && filter_freq != 0) {
+      return save_unfiltered_features ? 1 : -1;
+    }
+    return 0;
+  };
+
+  // counts[kind][shard * kSavedPartitionNum + partid]
+  std::vector<int64> counts[2];
+  counts[0].resize(num_shards * kSavedPartitionNum, 0);
+  counts[1].resize(num_shards * kSavedPartitionNum, 0);
+  RunShards(KvSaveThreadPool::GetInstance(), num_shards, n,
+            [&](int64 shard, int64 start, int64 end) {
+    for (int64 i = start; i < end; i++) {
+      int kind = kind_of(i);
+      if (kind >= 0) {
+        counts[kind][shard * kSavedPartitionNum +
+                     key_list[i] % kSavedPartitionNum]++;
+      }
+    }
+  });
+  // The shards of a partition keep the order of the snapshot.
+  std::vector<int64> part_offsets[2];
+  for (int kind = 0; kind < 2; kind++) {
+    part_offsets[kind].resize(kSavedPartitionNum + 1);
+    int64 offset = 0;
+    for (int partid = 0; partid < kSavedPartitionNum; partid++) {
+      part_offsets[kind][partid] = offset;
+      for (int64 shard = 0; shard < num_shards; shard++) {
+        int64& count = counts[kind][shard * kSavedPartitionNum + partid];
+        int64 shard_count = count;
+        count = offset;
+        offset += shard_count;
+      }
+    }
+    part_offsets[kind][kSavedPartitionNum] = offset;
+  }
+  std::vector<int64> orders[2];
+  orders[0].resize(part_offsets[0][kSavedPartitionNum]);
+  orders[1].resize(part_offsets[1][kSavedPartitionNum]);
+  RunShards(KvSaveThreadPool::GetInstance(), num_shards, n,
+            [&](int64 shard, int64 start, int64 end) {
+    for (int64 i = start; i < end; i++) {
+      int kind = kind_of(i);
+      if (kind >= 0) {
+        orders[kind][counts[kind][shard * kSavedPartitionNum +
+                                  key_list[i] % kSavedPartitionNum]++] = i;
+      }
+    }
+  });
+
+  auto part_offset_flat = part_offset_tensor->flat<int32>();
+  for (int i = 0; i < kSavedPartitionNum + 1; i++) {
+    part_offset_flat(i) = part_offsets[0][i];
+  }
+  writer->Add(tensor_key + "-partition_offset", *part_offset_tensor);
+  for (int i = 0; i < kSavedPartitionNum + 1; i++) {
+    part_offset_flat(i) = part_offsets[1][i];
+  }
+  writer->Add(tensor_key + "-partition_filter_offset", *part_offset_tensor);
+  VLOG(1) << "EV streaming save:" << tensor_key << ", keysize:" << n
+          << ", saved keys:" << orders[0].size()
+          << ", saved filtered keys:" << orders[1].size();
+
+  const int64 value_len = ev->ValueLen();
+  const bool is_mixed_dim = ev->IsMixedDim();
+  const std::string suffixes[2] = {"", "_filtered"};
+  for (int kind = 0; kind < 2; kind++) {
+    const std::vector<int64>& order = orders[kind];
+    const int64 num_keys = order.size();
+    TF_RETURN_IF_ERROR(SaveTensorInParallel<K>(
+        tensor_key + "-keys" + suffixes[kind], writer,
+        TensorShape({num_keys}), [&](int64 start, int64 end, K* out) {
+          for (int64 i = start; i < end; i++) {
+            *out++ = key_list[order[i]];
+          }
+        }));
+    if (kind == 0) {
+      TF_RETURN_IF_ERROR(SaveTensorInParallel<V>(
+          tensor_key + "-values", writer,
+          TensorShape({num_keys, value_len}),
+          [&](int64 start, int64 end, V* out) {
+            for (int64 i = start; i < end; i++, out += value_len) {
+              K key = key_list[order[i]];
+              V* value = valueptr_list[order[i]];
+              if (value == nullptr) {
+                value = ev->GetDefaultValue(key);
+              }
+              int64 dims = is_mixed_dim ? ev->RowDims(key) : value_len;
+              memcpy(out, value, dims * sizeof(V));
+              std::fill(out + dims, out + value_len, static_cast<V>(0));
+            }
+          }));
+    }
+    TF_RETURN_IF_ERROR(SaveTensorInParallel<int64>(
+        tensor_key + "-versions" + suffixes[kind], writer,
+        TensorShape({version_list.empty() ? 0 : num_keys}),
+        [&](int64 start, int64 end, int64* out) {
+          for (int64 i = start; i < end; i++) {
+            *out++ = version_list[order[i]];
+          }
+        }));
+    TF_RETURN_IF_ERROR(SaveTensorInParallel<int64>(
+        tensor_key + "-freqs" + suffixes[kind], writer,
+        TensorShape({freq_list.empty() ? 0 : num_keys}),
+        [&](int64 start, int64 end, int64* out) {
+          for (int64 i = start; i < end; i++) {
+            *out++ = freq_list[order[i]];
+          }
+        }));
+  }
+  return Status::OK();
+}
+
+// Writes the admitted rows of the saved partitions to the columnar file of
+// the EV, see ev_columnar_checkpoint.h. TF_EV_COLUMNAR_FP16 stores the
+// values in float16, TF_EV_COLUMNAR_BLOCK_ROWS (default 65536) and
+// TF_EV_COLUMNAR_ZSTD_LEVEL (default 3) set the rows and the compression
+// level of the blocks.
+template <class K, class V>
+Status DumpEVColumnar(EmbeddingVar<K, V>* ev,
+    const std::vector<std::vector<K>>& key_list_parts,
+    const std::vector<std::vector<V*>>& valueptr_list_parts,
+    const std::vector<std::vector<int64>>& version_list_parts,
+    const std::vector<std::vector<int64>>& freq_list_parts,
+    const std::string& prefix, const std::string& var_name) {
+  bool value_fp16 = false;
+  int64 block_rows = 65536;
+  int64 level = 3;
+  TF_CHECK_OK(ReadBoolFromEnvVar("TF_EV_COLUMNAR_FP16", false, &value_fp16));
+  TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_COLUMNAR_BLOCK_ROWS", 65536,
+                                  &block_rows));
+  TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_COLUMNAR_ZSTD_LEVEL", 3, &level));
+  std::vector<K> keys;
+  std::vector<V*> rows;
+  std::vector<int64> versions;
+  std::vector<int64> freqs;
+  for (int partid = 0; partid < kSavedPartitionNum; partid++) {
+    keys.insert(keys.end(), key_list_parts[partid].begin(),
+                key_list_parts[partid].end());
+    rows.insert(rows.end(), valueptr_list_parts[partid].begin(),
+                valueptr_list_parts[partid].end());
+    versions.insert(versions.end(), version_list_parts[partid].begin(),
+                    version_list_parts[partid].end());
+    freqs.insert(freqs.end(), freq_list_parts[partid].begin(),
+                 freq_list_parts[partid].end());
+  }
+  return WriteEVColumnarFile(Env::Default(),
+      EVColumnarFileName(prefix, var_name), keys, rows, versions, freqs,
+      ev->ValueLen(), value_fp16, kSavedPartitionNum,
+      std::max<int64>(block_rows, 1), level, KvSaveThreadPool::GetInstance());
+}
+
 template <class K, class V>
 Status DumpEmbeddingValues(EmbeddingVar<K, V>* ev,
     const string& tensor_key, BundleWriter* writer,
@@ -319,6 +681,42 @@ Status DumpEmbeddingValues(EmbeddingVar<K, V>* ev,
         &tot_freq_list, &it);
   }
 
+  bool save_mmap_kv = false;
+  TF_CHECK_OK(ReadBoolFromEnvVar("TF_EV_SAVE_MMAP_KV", false,
+                                 &save_mmap_kv));
+  if (save_mmap_kv && it == nullptr && !ev->IsUsePersistentStorage() &&
+      !ev->IsSingleHbm() && !ev->IsQuantized() && !ev->IsMixedDim() &&
+      ev->GetEmbeddingIndex() == 0 && !prefix.empty()) {
+    TF_RETURN_IF_ERROR(DumpMmapKV(ev, tot_key_list, tot_valueptr_list,
+                                  prefix, tensor_key));
+  }
+
+  // With TF_EV_COLUMNAR_SAVE, the admitted rows are written to the columnar
+  // file of the EV, and the tensors of the bundle only keep the filtered
+  // features.
+  bool columnar_save = false;
+  TF_CHECK_OK(ReadBoolFromEnvVar("TF_EV_COLUMNAR_SAVE", false,
+                                 &columnar_save));
+  columnar_save = columnar_save && it == nullptr &&
+      !ev->IsUsePersistentStorage() && !ev->IsUseHbm() &&
+      !ev->IsMixedDim() && !prefix.empty();
+
+  bool streaming_save = false;
+  TF_CHECK_OK(ReadBoolFromEnvVar("TF_EV_STREAMING_SAVE", false,
+                                 &streaming_save));
+  if (streaming_save && !columnar_save && it == nullptr &&
+      !ev->IsUsePersistentStorage()) {
+    Status st = DumpEmbeddingValuesStreaming(ev, tensor_key, writer,
+        part_offset_tensor, tot_key_list, tot_valueptr_list,
+        tot_version_list, tot_freq_list);
+    if (ev->IsSingleHbm() && tot_valueptr_list.size() > 0) {
+      TypedAllocator::Deallocate(
+          cpu_allocator(), tot_valueptr_list[0],
+          tot_valueptr_list.size() * ev->ValueLen());
+    }
+    return st;
+  }
+
   VLOG(1) << "EV:" << tensor_key << ", save size:" << num_of_keys;
   int64 iterator_size = 0;
   int64 filter_iterator_size = 0;
@@ -436,6 +834,18 @@ Status DumpEmbeddingValues(EmbeddingVar<K, V>* ev,
   }
   // LOG(INFO) << "EV:" << tensor_key << ", key_list_parts:" << key_list_parts.size();
 
+  if (columnar_save) {
+    TF_RETURN_IF_ERROR(DumpEVColumnar(ev, key_list_parts,
+        valueptr_list_parts, version_list_parts, freq_list_parts,
+        prefix, tensor_key));
+    for (int partid = 0; partid < kSavedPartitionNum; partid++) {
+      key_list_parts[partid].clear();
+      valueptr_list_parts[partid].clear();
+      version_list_parts[partid].clear();
+      freq_list_parts[partid].clear();
+    }
+  }
+
   auto part_offset_flat = part_offset_tensor->flat<int32>();
   part_offset_flat(0) = 0;
   part_filter_offset[0] = 0;
@@ -509,7 +919,14 @@ Status DumpEmbeddingValues(EmbeddingVar<K, V>* ev,
     return st;
   }
 
-  EVValueDumpIterator<K, V> ev_value_dump_iter(ev, partitioned_tot_valueptr_list);
+  std::vector<int64> partitioned_tot_row_dims_list;
+  if (ev->IsMixedDim()) {
+    for (auto key : partitioned_tot_key_list) {
+      partitioned_tot_row_dims_list.emplace_back(ev->RowDims(key));
+    }
+  }
+  EVValueDumpIterator<K, V> ev_value_dump_iter(ev, partitioned_tot_valueptr_list,
+      ev->IsMixedDim() ? &partitioned_tot_row_dims_list : nullptr);
   st = SaveTensorWithFixedBuffer(tensor_key + "-values", writer, dump_buffer,
       bytes_limit, &ev_value_dump_iter,
       TensorShape({partitioned_tot_key_list.size() + iterator_size, ev->ValueLen()}),
@@ -592,6 +1009,87 @@ namespace {
 const static string part_str = "part_";
 }
 
+// With TF_EV_PARALLEL_RESTORE, the EVs in single tier DRAM storages are
+// pre-sized with the key counts of the checkpoint, and the rows read are
+// imported by KvImportThreadPool.
+template <class K, class V>
+bool IsParallelRestore(EmbeddingVar<K, V>* ev) {
+  bool parallel_restore = false;
+  TF_CHECK_OK(ReadBoolFromEnvVar("TF_EV_PARALLEL_RESTORE", false,
+                                 &parallel_restore));
+  return parallel_restore && !ev->IsMultiLevel() && !ev->IsSingleHbm();
+}
+
+// Imports the key_num rows of restore_buff as EmbeddingVar::Import. With
+// the parallel restore, the rows are split into contiguous shards imported
+// concurrently, the keys of a checkpoint are unique. With the tail folding
+// of the EmbeddingVar, only the rows of its head keys are imported.
+template <class K, class V>
+Status ImportRestoreBuffer(EmbeddingVar<K, V>* ev,
+    RestoreBuffer& restore_buff, int64 key_num, int bucket_num,
+    int64 partition_id, int64 partition_num, bool is_filter,
+    const Eigen::GpuDevice* device) {
+  if (ev->IsTailFolding()) {
+    key_num = ev->FoldTailRows(restore_buff, key_num, bucket_num,
+                               partition_id, partition_num, is_filter);
+    if (key_num == 0) {
+      return Status::OK();
+    }
+  }
+  const int64 num_shards = KvImportThreadPool::ThreadNum();
+  if (!IsParallelRestore(ev) || num_shards == 1 || key_num < num_shards) {
+    return ev->Import(restore_buff, key_num, bucket_num, partition_id,
+                      partition_num, is_filter, device);
+  }
+  std::vector<Status> statuses(num_shards);
+  const int64 value_len = ev->ValueLen();
+  RunShards(KvImportThreadPool::GetInstance(), num_shards, key_num,
+            [&](int64 shard, int64 start, int64 end) {
+    if (start == end) {
+      return;
+    }
+    RestoreBuffer shard_buff;
+    shard_buff.key_buffer = restore_buff.key_buffer + start * sizeof(K);
+    shard_buff.value_buffer =
+        restore_buff.value_buffer + start * value_len * sizeof(V);
+    shard_buff.version_buffer =
+        restore_buff.version_buffer + start * sizeof(int64);
+    shard_buff.freq_buffer = restore_buff.freq_buffer + start * sizeof(int64);
+    statuses[shard] = ev->Import(shard_buff, end - start, bucket_num,
+        partition_id, partition_num, is_filter, device);
+    // The buffers belong to restore_buff.
+    shard_buff.key_buffer = nullptr;
+    shard_buff.value_buffer = nullptr;
+    shard_buff.version_buffer = nullptr;
+    shard_buff.freq_buffer = nullptr;
+  });
+  for (auto& st : statuses) {
+    TF_RETURN_IF_ERROR(st);
+  }
+  return Status::OK();
+}
+
+// Adds the keys of the sub partitions loaded_parts in the partition offset
+// tensor offset_tensor_name to num_keys, returns false if it isn't found.
+inline bool CountKeysToRestore(BundleReader* reader,
+    const string& offset_tensor_name, const std::vector<int>& loaded_parts,
+    int64* num_keys) {
+  DataType dtype;
+  TensorShape shape;
+  if (!reader->LookupDtypeAndShape(offset_tensor_name, &dtype, &shape).ok()) {
+    return false;
+  }
+  Tensor offset_tensor(cpu_allocator(), dtype, shape);
+  if (!reader->Lookup(offset_tensor_name, &offset_tensor).ok()) {
+    return false;
+  }
+  auto offset_flat = offset_tensor.flat<int32>();
+  for (int part : loaded_parts) {
+    *num_keys += offset_flat(part + 1) - offset_flat(part);
+  }
+  return true;
+}
+
 template<typename K, typename V>
 Status DynamicRestoreValue(EmbeddingVar<K, V>* ev, BundleReader* reader,
     std::string name_string, int orig_partnum, const GPUDevice* device,
@@ -753,8 +1251,8 @@ Status DynamicRestoreValue(EmbeddingVar<K, V>* ev, BundleReader* reader,
           tmp_ptr.reset(restore_buff.value_buffer);
           restore_buff.value_buffer = tmp;
         }
-        st = ev->Import(restore_buff, read_key_num, kSavedPartitionNum,
-            partition_id, partition_num, false, device);
+        st = ImportRestoreBuffer(ev, restore_buff, read_key_num,
+            kSavedPartitionNum, partition_id, partition_num, false, device);
         if (cache_for_restore_hbm) {
           cache_for_restore_hbm->update(
               (K*)restore_buff.key_buffer, read_key_num,
@@ -823,6 +1321,8 @@ Status EVRestoreNoPartition(EmbeddingVar<K, V>* ev, BundleReader* reader,
     }else {
       return st;
     }
+  } else if (IsParallelRestore(ev)) {
+    ev->Reserve(key_shape.dim_size(0) + key_filter_shape.dim_size(0));
   }
   st = reader->LookupTensorShape(tensor_version + "_filtered",
       &version_filter_shape);
@@ -979,7 +1479,8 @@ Status EVRestoreNoPartition(EmbeddingVar<K, V>* ev, BundleReader* reader,
         tmp_ptr.reset(restore_buff.value_buffer);
         restore_buff.value_buffer = tmp;
       }
-      st = ev->Import(restore_buff, read_key_num, 1, 0, 1, false, device);
+      st = ImportRestoreBuffer(ev, restore_buff, read_key_num, 1, 0, 1,
+          false, device);
       if (cache_for_restore_hbm) {
         cache_for_restore_hbm->update(
             (K*)restore_buff.key_buffer, read_key_num,
@@ -1016,7 +1517,8 @@ Status EVRestoreNoPartition(EmbeddingVar<K, V>* ev, BundleReader* reader,
         read_key_num = key_filter_bytes_read / sizeof(K);
         VLOG(2) << "restore, read_key_num:" << read_key_num;
 
-        st = ev->Import(restore_buff, read_key_num, 1, 0, 1, true, device);
+        st = ImportRestoreBuffer(ev, restore_buff, read_key_num, 1, 0, 1,
+            true, device);
         if (cache_for_restore_hbm) {
           cache_for_restore_hbm->update(
               (K*)restore_buff.key_buffer, read_key_num,
@@ -1164,6 +1666,26 @@ Status EVRestoreDynamically(EmbeddingVar<K, V>* ev,
           cache_strategy, "hbm_restore_cache for " + name_string);
     }
 
+    if (IsParallelRestore(ev)) {
+      string pre_subname = name_string.substr(0, name_string.find(part_str));
+      string post_subname = name_string.substr(name_string.find(part_str)
+          + part_str.size() + curr_partid_str.size());
+      int64 num_keys = 0;
+      for (int part = 0; ; part++) {
+        string tensor_name =
+            pre_subname + part_str + std::to_string(part) + post_subname;
+        if (!CountKeysToRestore(reader,
+                tensor_name + part_offset_tensor_suffix, loaded_parts,
+                &num_keys)) {
+          break;
+        }
+        CountKeysToRestore(reader, tensor_name + "-partition_filter_offset",
+                           loaded_parts, &num_keys);
+      }
+      VLOG(1) << "Reserve " << num_keys << " keys for " << name_string;
+      ev->Reserve(num_keys);
+    }
+
     int orig_partnum = 0;
     size_t buffer_size = 8 << 20;
     RestoreBuffer restore_buff;
@@ -1421,8 +1943,8 @@ Status EVRestoreDynamically(EmbeddingVar<K, V>* ev,
               restore_buff.value_buffer = tmp;
             }
 
-            st = ev->Import(restore_buff, read_key_num, kSavedPartitionNum,
-                partition_id, partition_num, false, device);
+            st = ImportRestoreBuffer(ev, restore_buff, read_key_num,
+                kSavedPartitionNum, partition_id, partition_num, false, device);
             if (cache_for_restore_hbm) {
               cache_for_restore_hbm->update(
                   (K*)restore_buff.key_buffer, read_key_num,
@@ -1474,8 +1996,8 @@ Status EVRestoreDynamically(EmbeddingVar<K, V>* ev,
             if (key_filter_bytes_read > 0) {
               read_key_num = key_filter_bytes_read / sizeof(K);
               VLOG(2) << "restore, read_key_num:" << read_key_num;
-              st = ev->Import(restore_buff, read_key_num, kSavedPartitionNum,
-                  partition_id, partition_num, true, device);
+              st = ImportRestoreBuffer(ev, restore_buff, read_key_num,
+                  kSavedPartitionNum, partition_id, partition_num, true, device);
               if (cache_for_restore_hbm) {
                 cache_for_restore_hbm->update(
                     (K*)restore_buff.key_buffer, read_key_num,
@@ -1515,6 +2037,97 @@ Status EVRestoreDynamically(EmbeddingVar<K, V>* ev,
 }
 
 
+// Imports the rows of partition_id of the columnar files written for the
+// partitions of the EV name_string with TF_EV_COLUMNAR_SAVE, if any. Only
+// the blocks of the buckets of partition_id are read, the blocks of a wave
+// are read and decoded in parallel on KvImportThreadPool.
+template<typename K, typename V>
+Status EVRestoreColumnar(EmbeddingVar<K, V>* ev,
+    const std::string& file_name_string, const std::string& name_string,
+    int64 partition_id, int64 partition_num, bool reset_version,
+    const Eigen::GpuDevice* device = nullptr) {
+  std::vector<std::string> files;
+  std::function<bool(K)> keep;
+  int bucket_num = 1;
+  if (name_string.find(part_str) == std::string::npos) {
+    files.emplace_back(EVColumnarFileName(file_name_string, name_string));
+    keep = [](K key) { return true; };
+    partition_id = 0;
+    partition_num = 1;
+  } else {
+    const string& curr_partid_str = std::to_string(partition_id);
+    string pre_subname = name_string.substr(0, name_string.find(part_str));
+    string post_subname = name_string.substr(name_string.find(part_str)
+        + part_str.size() + curr_partid_str.size());
+    for (int part = 0; ; part++) {
+      std::string file_name = EVColumnarFileName(file_name_string,
+          pre_subname + part_str + std::to_string(part) + post_subname);
+      if (!Env::Default()->FileExists(file_name).ok()) {
+        break;
+      }
+      files.emplace_back(file_name);
+    }
+    keep = [partition_id, partition_num](K key) {
+      return key % kSavedPartitionNum % partition_num == partition_id;
+    };
+    bucket_num = kSavedPartitionNum;
+  }
+
+  thread::ThreadPool* pool = KvImportThreadPool::GetInstance();
+  for (const std::string& file : files) {
+    if (!Env::Default()->FileExists(file).ok()) {
+      continue;
+    }
+    EVColumnarReader reader;
+    TF_RETURN_IF_ERROR(reader.Open(Env::Default(), file));
+    if (reader.footer().value_len != ev->ValueLen()) {
+      return errors::InvalidArgument("The rows of ", file, " have ",
+          reader.footer().value_len, " values instead of ", ev->ValueLen());
+    }
+    std::vector<int64> blocks;
+    for (int64 b = 0; b < reader.NumBlocks(); b++) {
+      if (reader.footer().num_buckets != bucket_num ||
+          reader.BlockBucket(b) % partition_num == partition_id) {
+        blocks.emplace_back(b);
+      }
+    }
+    const int64 num_blocks = blocks.size();
+    const int64 wave = 2 * pool->NumThreads();
+    for (int64 first = 0; first < num_blocks; first += wave) {
+      const int64 last = std::min(num_blocks, first + wave);
+      std::vector<RestoreBuffer> buffs(last - first);
+      std::vector<int64> num_keys(last - first, 0);
+      std::vector<Status> statuses(last - first);
+      pool->ParallelFor(last - first, /*cost_per_unit=*/1 << 20,
+          [&](int64 begin, int64 limit) {
+        for (int64 b = begin; b < limit; b++) {
+          string raw;
+          int64 num_rows = 0;
+          statuses[b] = reader.ReadBlock(blocks[first + b], &raw, &num_rows);
+          if (statuses[b].ok()) {
+            statuses[b] = DecodeEVColumnarBlock<K, V>(reader.footer(), raw,
+                num_rows, keep, &buffs[b], &num_keys[b]);
+          }
+        }
+      });
+      for (int64 b = 0; b < last - first; b++) {
+        TF_RETURN_IF_ERROR(statuses[b]);
+        if (num_keys[b] == 0) {
+          continue;
+        }
+        if (reset_version) {
+          memset(buffs[b].version_buffer, 0, num_keys[b] * sizeof(int64));
+        }
+        TF_RETURN_IF_ERROR(ImportRestoreBuffer(ev, buffs[b], num_keys[b],
+            bucket_num, partition_id, partition_num, false, device));
+      }
+    }
+    VLOG(1) << "Restore " << name_string << " from " << num_blocks
+            << " of the " << reader.NumBlocks() << " blocks of " << file;
+  }
+  return Status::OK();
+}
+
 template<class K>
 int64 ReadRecord(
     BundleReader* reader,
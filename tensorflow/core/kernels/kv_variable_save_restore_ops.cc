@@ -25,12 +25,14 @@ limitations under the License.
 #include "tensorflow/core/framework/embedding/cache.h"
 #include "tensorflow/core/framework/embedding/config.pb.h"
 #include "tensorflow/core/framework/embedding/embedding_var.h"
+#include "tensorflow/core/framework/embedding/lock_contention.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/tensor_types.h"
 #include "tensorflow/core/kernels/dense_update_functor.h"
 #include "tensorflow/core/kernels/gather_functor.h"
+#include "tensorflow/core/kernels/kv_delayed_apply_executor.h"
 #include "tensorflow/core/kernels/kv_variable_ops.h"
 #include "tensorflow/core/kernels/scatter_functor.h"
 #include "tensorflow/core/kernels/training_op_helpers.h"
@@ -60,6 +62,24 @@ class KvRestoreThreadPool {
     return &tp;
   }
 
+  // Schedules fn on the pool. Its wait for a thread and its run are
+  // recorded as the contention of the pool when profiled.
+  static void Schedule(std::function<void()> fn) {
+    embedding::LockContention::Site* site =
+        LOCK_CONTENTION_SITE("kv_restore_thread_pool");
+    if (site == nullptr) {
+      GetInstance()->Schedule(std::move(fn));
+      return;
+    }
+    const uint64 scheduled = Env::Default()->NowNanos();
+    GetInstance()->Schedule([site, scheduled, fn]() {
+      const uint64 start = Env::Default()->NowNanos();
+      site->RecordAcquisition(true, start - scheduled);
+      fn();
+      site->RecordHold(Env::Default()->NowNanos() - start);
+    });
+  }
+
  private:
   static int64 thread_num_;
 };
@@ -190,7 +210,11 @@ class KvResourceImportV2Op: public AsyncOpKernel {
                 allocator);
             return Status::OK();
         }));
-      ev->Init(default_values, default_value_dim_);
+      // The EmbeddingVars shared with the previous model version are
+      // already initialized and restored.
+      if (!ev->IsShared()) {
+        ev->Init(default_values, default_value_dim_);
+      }
     } else {
       EmbeddingVar<TKey, TValue>* primary_variable = nullptr;
       OP_REQUIRES_OK(
@@ -248,6 +272,10 @@ class KvResourceImportV2Op: public AsyncOpKernel {
       core::ScopedUnref unref_me(primary_variable);
     }
     core::ScopedUnref unref_me(ev);
+    if (ev->IsShared()) {
+      done();
+      return;
+    }
 
     auto do_compute = [this, context, file_name_string, ev,
          name_string, done] () {
@@ -262,13 +290,13 @@ class KvResourceImportV2Op: public AsyncOpKernel {
           ev, name_string, partition_id_, partition_num_, context, &reader,
           "-partition_offset", "-keys", "-values", "-versions", "-freqs",
           reset_version_);
+      ev->ReportTailFolding();
       ev->SetInitialized();
       done();
     };
 
     if (ev_async_restore_) {
-      auto tp = KvRestoreThreadPool::GetInstance();
-      tp->Schedule(do_compute);
+      KvRestoreThreadPool::Schedule(do_compute);
     } else {
       do_compute();
     }
@@ -354,6 +382,8 @@ class KvResourceImportV3Op: public AsyncOpKernel {
 
     TF_CHECK_OK(ReadBoolFromEnvVar("TF_ENABLE_EV_ASYNC_RESTORE", true,
                                    &ev_async_restore_));
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_EV_MMAP_SERVING", false,
+                                   &mmap_serving_));
   }
 
   void ComputeAsync(OpKernelContext* context, DoneCallback done) override {
@@ -366,6 +396,12 @@ class KvResourceImportV3Op: public AsyncOpKernel {
     OP_REQUIRES_OK(context, LookupResource(context, HandleFromInput(context, 1), &ev));
 
     core::ScopedUnref unref_me(ev);
+    // The EmbeddingVars shared with the previous model version are already
+    // restored.
+    if (ev->IsShared()) {
+      done();
+      return;
+    }
 
     auto do_compute = [this, context, file_name_string, ev,
          name_string, done] () {
@@ -395,6 +431,23 @@ class KvResourceImportV3Op: public AsyncOpKernel {
           LoadSsdData(ev, ssd_record_file_name, ssd_emb_file_name);
         }
       }
+      std::string mmap_kv_file_name =
+          file_name_string + "-" + name_string_temp + "-mmap_kv";
+      if (mmap_serving_ && ev->IsInference() &&
+          ev->GetEmbeddingIndex() == 0 && !ev->IsSingleHbm() &&
+          Env::Default()->FileExists(mmap_kv_file_name).ok()) {
+        s = ev->ServeFromMmapKV(mmap_kv_file_name);
+        if (s.ok()) {
+          LOG(INFO) << "Serve EV " << name_string << " from "
+                    << mmap_kv_file_name << ", size: " << ev->Size();
+          ev->SetInitialized();
+          done();
+          return;
+        }
+        LOG(WARNING) << "Failed to serve EV " << name_string << " from "
+                     << mmap_kv_file_name << ", restore it instead: "
+                     << s.ToString();
+      }
       if (ev->IsSingleHbm()) {
 #if GOOGLE_CUDA
         se::cuda::ScopedActivateExecutorContext scoped_activation{
@@ -410,14 +463,26 @@ class KvResourceImportV3Op: public AsyncOpKernel {
             ev, name_string, partition_id_, partition_num_, context, &reader,
             "-partition_offset", "-keys", "-values", "-versions", "-freqs",
             reset_version_, nullptr);
+        s = EVRestoreColumnar(ev, file_name_string, name_string,
+            partition_id_, partition_num_, reset_version_);
+        if (!s.ok()) {
+          LOG(FATAL) << "Restore EV " << name_string
+                     << " from the columnar checkpoint failure: "
+                     << s.ToString();
+        }
+      }
+      if (ev->IsQuantized()) {
+        // The rows are quantized by EmbeddingVar::Import.
+        LOG(INFO) << "Restore EV " << name_string
+                  << " into a quantized layout, size: " << ev->Size();
       }
+      ev->ReportTailFolding();
       ev->SetInitialized();
       done();
     };
 
     if (ev_async_restore_) {
-      auto tp = KvRestoreThreadPool::GetInstance();
-      tp->Schedule(do_compute);
+      KvRestoreThreadPool::Schedule(do_compute);
     } else {
       do_compute();
     }
@@ -430,6 +495,7 @@ class KvResourceImportV3Op: public AsyncOpKernel {
   TensorShape shape_;
   bool reset_version_;
   bool ev_async_restore_;
+  bool mmap_serving_;
 };
 
 #define REGISTER_KERNELS(dev, ktype, vtype, device)            \
@@ -499,7 +565,9 @@ class KvResourceIncrImportOp: public AsyncOpKernel {
         ev, name_string, partition_id_, partition_num_, context, &reader,
         "-incr_partition_offset", "-sparse_incr_keys", "-sparse_incr_values",
         "-sparse_incr_versions", "-sparse_incr_freqs");
+    ev->ReportTailFolding();
     ev->SetInitialized();
+    ev->SetDiverged();
     done();
   }
 
@@ -537,6 +605,77 @@ TF_CALL_GPU_NUMBER_TYPES(REGISTER_KERNELS_GPU)
 #undef REGISTER_KERNELS_ALL
 #undef REGISTER_KERNELS
 
+// Outputs the rows of a snapshot of 'ev' as keys, values, versions and
+// freqs.
+template<typename TKey, typename TValue>
+void OutputSnapshot(OpKernelContext* ctx, EmbeddingVar<TKey, TValue>* ev,
+                    const std::vector<TKey>& key_list,
+                    const std::vector<TValue*>& valueptr_list,
+                    const std::vector<int64>& version_list,
+                    const std::vector<int64>& freq_list) {
+  const int64 total_size = key_list.size();
+  Tensor *keys_output_tensor = NULL;
+  Tensor *values_output_tensor = NULL;
+  Tensor *versions_output_tensor = NULL;
+  Tensor *freq_output_tensor = NULL;
+
+  OP_REQUIRES_OK(ctx, ctx->allocate_output(
+        0, TensorShape({total_size}), &keys_output_tensor));
+  OP_REQUIRES_OK(ctx, ctx->allocate_output(
+        1, TensorShape({total_size, ev->ValueLen()}),
+        &values_output_tensor));
+  OP_REQUIRES_OK(ctx, ctx->allocate_output(
+        2, TensorShape({version_list.size()}),
+        &versions_output_tensor));
+  OP_REQUIRES_OK(ctx, ctx->allocate_output(
+        3, TensorShape({freq_list.size()}),
+        &freq_output_tensor));
+
+  auto keys_output = keys_output_tensor->template flat<TKey>();
+  auto val_matrix = values_output_tensor->matrix<TValue>();
+  auto versions_output = versions_output_tensor->template flat<int64>();
+  auto freq_output = freq_output_tensor->template flat<int64>();
+
+  for(size_t i = 0; i < total_size; i++) {
+    keys_output(i) = key_list[i];
+    TValue *value = valueptr_list[i];
+    // Demoted rows of the mixed_dim layout are padded with 0.
+    int64 row_dims = ev->IsMixedDim() ?
+        ev->RowDims(key_list[i]) : ev->ValueLen();
+    for(int64 m = 0; m < ev->ValueLen(); m++) {
+      val_matrix(i, m) = (m < row_dims) ? *(value + m) : TValue(0);
+    }
+    if (version_list.size() != 0) {
+      versions_output(i) = version_list[i];
+    }
+    if (freq_list.size() != 0) {
+      freq_output(i) = freq_list[i];
+    }
+  }
+}
+
+// Returns the buckets of the 'buckets' input as a mask of 'bucket_num'.
+static Status GetBucketMask(const Tensor& buckets, int64 bucket_num,
+                            std::vector<bool>* mask) {
+  mask->assign(bucket_num, false);
+  auto buckets_flat = buckets.flat<int32>();
+  for (int64 i = 0; i < buckets_flat.size(); i++) {
+    if (buckets_flat(i) < 0 || buckets_flat(i) >= bucket_num) {
+      return errors::InvalidArgument("Bucket ", buckets_flat(i),
+                                     " is out of [0, ", bucket_num, ")");
+    }
+    (*mask)[buckets_flat(i)] = true;
+  }
+  return Status::OK();
+}
+
+// The bucket of 'key', as `key % bucket_num` of the python routing.
+template<typename TKey>
+int64 BucketOf(TKey key, int64 bucket_num) {
+  int64 bucket = static_cast<int64>(key) % bucket_num;
+  return bucket < 0 ? bucket + bucket_num : bucket;
+}
+
 // Op that outputs tensors of all keys and all values.
 template<typename TKey, typename TValue>
 class KvResourceExportOp : public OpKernel {
@@ -547,51 +686,16 @@ class KvResourceExportOp : public OpKernel {
     EmbeddingVar<TKey, TValue> *ev = nullptr;
     OP_REQUIRES_OK(ctx, LookupResource(ctx, HandleFromInput(ctx, 0), &ev));
     core::ScopedUnref unref_me(ev);
+    KvDelayedApplyExecutor::Global()->Flush();
     std::vector<TKey> tot_key_list;
     std::vector<TValue *> tot_valueptr_list;
     std::vector<int64> tot_version_list;
     std::vector<int64> tot_freq_list;
     embedding::Iterator* it = nullptr;
-    int64 total_size = ev->GetSnapshot(
-        &tot_key_list, &tot_valueptr_list, &tot_version_list,
-        &tot_freq_list, &it);
-
-    // Create an output tensor
-    Tensor *keys_output_tensor = NULL;
-    Tensor *values_output_tensor = NULL;
-    Tensor *versions_output_tensor = NULL;
-    Tensor *freq_output_tensor = NULL;
-
-    OP_REQUIRES_OK(ctx, ctx->allocate_output(
-          0, TensorShape({total_size}), &keys_output_tensor));
-    OP_REQUIRES_OK(ctx, ctx->allocate_output(
-          1, TensorShape({total_size, ev->ValueLen()}),
-          &values_output_tensor));
-    OP_REQUIRES_OK(ctx, ctx->allocate_output(
-          2, TensorShape({tot_version_list.size()}),
-          &versions_output_tensor));
-    OP_REQUIRES_OK(ctx, ctx->allocate_output(
-          3, TensorShape({tot_freq_list.size()}),
-          &freq_output_tensor));
-
-    auto keys_output = keys_output_tensor->template flat<TKey>();
-    auto val_matrix = values_output_tensor->matrix<TValue>();
-    auto versions_output = versions_output_tensor->template flat<int64>();
-    auto freq_output = freq_output_tensor->template flat<int64>();
-
-    for(size_t i = 0; i < total_size; i++) {
-      keys_output(i) = tot_key_list[i];
-      TValue *value = tot_valueptr_list[i];
-      for(int64 m = 0; m < ev->ValueLen(); m++) {
-        val_matrix(i, m) = *(value + m);
-      }
-      if (tot_version_list.size() != 0) {
-        versions_output(i) = tot_version_list[i];
-      }
-      if (tot_freq_list.size() != 0) {
-        freq_output(i) = tot_freq_list[i];
-      }
-    }
+    ev->GetSnapshot(&tot_key_list, &tot_valueptr_list, &tot_version_list,
+                    &tot_freq_list, &it);
+    OutputSnapshot(ctx, ev, tot_key_list, tot_valueptr_list,
+                   tot_version_list, tot_freq_list);
   }
 };
 
@@ -616,5 +720,205 @@ TF_CALL_GPU_NUMBER_TYPES(REGISTER_KERNELS_GPU)
 
 #undef REGISTER_KERNELS_ALL
 #undef REGISTER_KERNELS
+
+template <typename TKey, typename TValue>
+class KvResourceApplyDeltaOp : public OpKernel {
+ public:
+  explicit KvResourceApplyDeltaOp(OpKernelConstruction *ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext *ctx) override {
+    EmbeddingVar<TKey, TValue> *ev = nullptr;
+    OP_REQUIRES_OK(ctx, LookupResource(ctx, HandleFromInput(ctx, 0), &ev));
+    core::ScopedUnref unref_me(ev);
+    const Tensor& keys = ctx->input(1);
+    const Tensor& values = ctx->input(2);
+    OP_REQUIRES(ctx, values.dims() == 2 &&
+        values.dim_size(0) == keys.NumElements() &&
+        values.dim_size(1) == ev->ValueLen(),
+        errors::InvalidArgument("The values of shape ",
+            values.shape().DebugString(), " mismatch ", keys.NumElements(),
+            " keys of value_len ", ev->ValueLen()));
+    OP_REQUIRES_OK(ctx, ev->ApplyDelta(keys.flat<TKey>().data(),
+        values.flat<TValue>().data(), keys.NumElements()));
+  }
+};
+
+#define REGISTER_KERNELS(ktype, vtype)                         \
+  REGISTER_KERNEL_BUILDER(Name("KvResourceApplyDelta")         \
+                            .Device(DEVICE_CPU)                \
+                            .TypeConstraint<ktype>("Tkeys")    \
+                            .TypeConstraint<vtype>("Tvalues"), \
+                          KvResourceApplyDeltaOp<ktype, vtype>);
+#define REGISTER_KERNELS_CPU(type)                             \
+  REGISTER_KERNELS(int32, type)                                \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_CPU)
+#undef REGISTER_KERNELS_CPU
+#undef REGISTER_KERNELS
+
+// Op that outputs the rows of the keys in some buckets, to move them to
+// another partition.
+template<typename TKey, typename TValue>
+class KvResourceExportBucketsOp : public OpKernel {
+ public:
+  explicit KvResourceExportBucketsOp(OpKernelConstruction *ctx)
+      : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("bucket_num", &bucket_num_));
+    OP_REQUIRES(ctx, bucket_num_ > 0,
+                errors::InvalidArgument("bucket_num must be positive."));
+  }
+
+  void Compute(OpKernelContext *ctx) override {
+    EmbeddingVar<TKey, TValue> *ev = nullptr;
+    OP_REQUIRES_OK(ctx, LookupResource(ctx, HandleFromInput(ctx, 0), &ev));
+    core::ScopedUnref unref_me(ev);
+    std::vector<bool> mask;
+    OP_REQUIRES_OK(ctx, GetBucketMask(ctx->input(1), bucket_num_, &mask));
+
+    std::vector<TKey> tot_key_list;
+    std::vector<TValue *> tot_valueptr_list;
+    std::vector<int64> tot_version_list;
+    std::vector<int64> tot_freq_list;
+    embedding::Iterator* it = nullptr;
+    ev->GetSnapshot(&tot_key_list, &tot_valueptr_list, &tot_version_list,
+                    &tot_freq_list, &it);
+
+    std::vector<TKey> key_list;
+    std::vector<TValue *> valueptr_list;
+    std::vector<int64> version_list;
+    std::vector<int64> freq_list;
+    for (size_t i = 0; i < tot_key_list.size(); i++) {
+      if (!mask[BucketOf(tot_key_list[i], bucket_num_)]) {
+        continue;
+      }
+      key_list.push_back(tot_key_list[i]);
+      valueptr_list.push_back(tot_valueptr_list[i]);
+      if (!tot_version_list.empty()) {
+        version_list.push_back(tot_version_list[i]);
+      }
+      if (!tot_freq_list.empty()) {
+        freq_list.push_back(tot_freq_list[i]);
+      }
+    }
+    OutputSnapshot(ctx, ev, key_list, valueptr_list, version_list,
+                   freq_list);
+  }
+
+ private:
+  int64 bucket_num_;
+};
+
+#define REGISTER_KERNELS(ktype, vtype)                         \
+  REGISTER_KERNEL_BUILDER(Name("KvResourceExportBuckets")      \
+                            .Device(DEVICE_CPU)                \
+                            .HostMemory("buckets")             \
+                            .TypeConstraint<ktype>("Tkeys")    \
+                            .TypeConstraint<vtype>("Tvalues"), \
+                          KvResourceExportBucketsOp<ktype, vtype>);
+#define REGISTER_KERNELS_CPU(type)                             \
+  REGISTER_KERNELS(int32, type)                                \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_CPU)
+#undef REGISTER_KERNELS_CPU
+#undef REGISTER_KERNELS
+
+template<typename TKey, typename TValue>
+class KvResourceRemoveBucketsOp : public OpKernel {
+ public:
+  explicit KvResourceRemoveBucketsOp(OpKernelConstruction *ctx)
+      : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("bucket_num", &bucket_num_));
+    OP_REQUIRES(ctx, bucket_num_ > 0,
+                errors::InvalidArgument("bucket_num must be positive."));
+  }
+
+  void Compute(OpKernelContext *ctx) override {
+    EmbeddingVar<TKey, TValue> *ev = nullptr;
+    OP_REQUIRES_OK(ctx, LookupResource(ctx, HandleFromInput(ctx, 0), &ev));
+    core::ScopedUnref unref_me(ev);
+    std::vector<bool> mask;
+    OP_REQUIRES_OK(ctx, GetBucketMask(ctx->input(1), bucket_num_, &mask));
+
+    std::vector<TKey> tot_key_list;
+    std::vector<TValue *> tot_valueptr_list;
+    std::vector<int64> tot_version_list;
+    std::vector<int64> tot_freq_list;
+    embedding::Iterator* it = nullptr;
+    ev->GetSnapshot(&tot_key_list, &tot_valueptr_list, &tot_version_list,
+                    &tot_freq_list, &it);
+    std::vector<TKey> key_list;
+    for (TKey key : tot_key_list) {
+      if (mask[BucketOf(key, bucket_num_)]) {
+        key_list.push_back(key);
+      }
+    }
+    OP_REQUIRES_OK(ctx, ev->RemoveKeys(key_list.data(), key_list.size()));
+  }
+
+ private:
+  int64 bucket_num_;
+};
+
+#define REGISTER_KERNELS(ktype, vtype)                         \
+  REGISTER_KERNEL_BUILDER(Name("KvResourceRemoveBuckets")      \
+                            .Device(DEVICE_CPU)                \
+                            .HostMemory("buckets")             \
+                            .TypeConstraint<ktype>("Tkeys")    \
+                            .TypeConstraint<vtype>("Tvalues"), \
+                          KvResourceRemoveBucketsOp<ktype, vtype>);
+#define REGISTER_KERNELS_CPU(type)                             \
+  REGISTER_KERNELS(int32, type)                                \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_CPU)
+#undef REGISTER_KERNELS_CPU
+#undef REGISTER_KERNELS
+
+template <typename TKey, typename TValue>
+class KvResourceImportRowsOp : public OpKernel {
+ public:
+  explicit KvResourceImportRowsOp(OpKernelConstruction *ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext *ctx) override {
+    EmbeddingVar<TKey, TValue> *ev = nullptr;
+    OP_REQUIRES_OK(ctx, LookupResource(ctx, HandleFromInput(ctx, 0), &ev));
+    core::ScopedUnref unref_me(ev);
+    const Tensor& keys = ctx->input(1);
+    const Tensor& values = ctx->input(2);
+    const Tensor& versions = ctx->input(3);
+    const Tensor& freqs = ctx->input(4);
+    const int64 num_keys = keys.NumElements();
+    OP_REQUIRES(ctx, values.dims() == 2 &&
+        values.dim_size(0) == num_keys &&
+        values.dim_size(1) == ev->ValueLen(),
+        errors::InvalidArgument("The values of shape ",
+            values.shape().DebugString(), " mismatch ", num_keys,
+            " keys of value_len ", ev->ValueLen()));
+    OP_REQUIRES(ctx, (versions.NumElements() == 0 ||
+                      versions.NumElements() == num_keys) &&
+                     (freqs.NumElements() == 0 ||
+                      freqs.NumElements() == num_keys),
+        errors::InvalidArgument("The versions and freqs must be empty or"
+                                " have one element per key."));
+    OP_REQUIRES_OK(ctx, ev->ApplyDelta(keys.flat<TKey>().data(),
+        values.flat<TValue>().data(), num_keys,
+        versions.NumElements() > 0 ? versions.flat<int64>().data() : nullptr,
+        freqs.NumElements() > 0 ? freqs.flat<int64>().data() : nullptr));
+  }
+};
+
+#define REGISTER_KERNELS(ktype, vtype)                         \
+  REGISTER_KERNEL_BUILDER(Name("KvResourceImportRows")         \
+                            .Device(DEVICE_CPU)                \
+                            .TypeConstraint<ktype>("Tkeys")    \
+                            .TypeConstraint<vtype>("Tvalues"), \
+                          KvResourceImportRowsOp<ktype, vtype>);
+#define REGISTER_KERNELS_CPU(type)                             \
+  REGISTER_KERNELS(int32, type)                                \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_CPU)
+#undef REGISTER_KERNELS_CPU
+#undef REGISTER_KERNELS
 }  // namespace tensorflow
 
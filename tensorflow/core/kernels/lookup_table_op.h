@@ -16,6 +16,11 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_LOOKUP_TABLE_OP_H_
 #define TENSORFLOW_CORE_KERNELS_LOOKUP_TABLE_OP_H_
 
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/lookup_interface.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -26,8 +31,10 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
@@ -148,13 +155,201 @@ inline const Variant& SubtleMustCopyIfIntegral(const Variant& value) {
   return value;
 }
 
+inline uint64 PerfectHashFingerprint(int64 key) {
+  // The finalizer of MurmurHash3, a bijection, so that different integer
+  // keys never have the same fingerprint.
+  uint64 h = static_cast<uint64>(key);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+inline uint64 PerfectHashFingerprint(const tstring& key) {
+  return Fingerprint64(StringPiece(key.data(), key.size()));
+}
+
+// A read-only map of n keys on a perfect hash function, in the way of
+// PTHash: the keys are split into about n / 4 buckets, and every bucket has
+// a pilot, found by trial when the map is built, that sends its keys to free
+// slots of flat arrays of 1.125n slots. A lookup hashes the key once, reads
+// the pilot of its bucket and one slot, and compares the key of the slot,
+// without the pointer chasing of the chains of a std::unordered_map.
+template <class K, class V>
+class PerfectHashMap {
+ public:
+  // Returns false when no pilot sends the keys of a bucket to free slots,
+  // e.g. two strings have the same fingerprint.
+  bool Build(const std::unordered_map<K, V>& map) {
+    const int64 n = map.size();
+    num_buckets_ = std::max<int64>(1, (n + 3) / 4);
+    num_slots_ = std::max<int64>(1, n + n / 8);
+    std::vector<const std::pair<const K, V>*> entries;
+    std::vector<uint64> fps;
+    entries.reserve(n);
+    fps.reserve(n);
+    for (const auto& entry : map) {
+      entries.push_back(&entry);
+      fps.push_back(PerfectHashFingerprint(entry.first));
+    }
+
+    // The entries grouped by bucket, the largest buckets are placed first
+    // while most slots are free.
+    std::vector<int64> bucket_start(num_buckets_ + 1, 0);
+    for (int64 i = 0; i < n; ++i) {
+      bucket_start[Bucket(fps[i]) + 1]++;
+    }
+    std::partial_sum(bucket_start.begin(), bucket_start.end(),
+                     bucket_start.begin());
+    std::vector<int64> by_bucket(n);
+    std::vector<int64> next(bucket_start.begin(), bucket_start.end() - 1);
+    for (int64 i = 0; i < n; ++i) {
+      by_bucket[next[Bucket(fps[i])]++] = i;
+    }
+    std::vector<int64> order(num_buckets_);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&bucket_start](int64 a, int64 b) {
+                       return bucket_start[a + 1] - bucket_start[a] >
+                              bucket_start[b + 1] - bucket_start[b];
+                     });
+
+    pilots_.assign(num_buckets_, 0);
+    std::vector<bool> taken(num_slots_, false);
+    std::vector<int64> slots;
+    std::vector<int64> entry_slots(n);
+    for (int64 b : order) {
+      const int64 begin = bucket_start[b];
+      const int64 end = bucket_start[b + 1];
+      if (begin == end) {
+        break;
+      }
+      bool placed = false;
+      for (uint32 pilot = 0; pilot < kMaxPilot && !placed; ++pilot) {
+        slots.clear();
+        for (int64 j = begin; j < end; ++j) {
+          const int64 slot = Slot(fps[by_bucket[j]], pilot);
+          if (taken[slot] ||
+              std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+            break;
+          }
+          slots.push_back(slot);
+        }
+        if (static_cast<int64>(slots.size()) == end - begin) {
+          pilots_[b] = pilot;
+          for (int64 j = begin; j < end; ++j) {
+            taken[slots[j - begin]] = true;
+            entry_slots[by_bucket[j]] = slots[j - begin];
+          }
+          placed = true;
+        }
+      }
+      if (!placed) {
+        pilots_.clear();
+        return false;
+      }
+    }
+
+    fps_.assign(num_slots_, 0);
+    occupied_.assign(num_slots_, 0);
+    keys_.assign(num_slots_, K());
+    values_.assign(num_slots_, V());
+    for (int64 i = 0; i < n; ++i) {
+      const int64 slot = entry_slots[i];
+      fps_[slot] = fps[i];
+      occupied_[slot] = 1;
+      keys_[slot] = entries[i]->first;
+      values_[slot] = entries[i]->second;
+    }
+    size_ = n;
+    return true;
+  }
+
+  // Looks up the keys by batches, the slots of a batch are prefetched
+  // before they are read so that their cache misses overlap.
+  void Find(const K* keys, int64 n, const V& default_value, V* values) const {
+    constexpr int64 kBatch = 16;
+    uint64 fps[kBatch];
+    int64 slots[kBatch];
+    for (int64 start = 0; start < n; start += kBatch) {
+      const int64 size = std::min(kBatch, n - start);
+      for (int64 i = 0; i < size; ++i) {
+        fps[i] = PerfectHashFingerprint(keys[start + i]);
+        slots[i] = Slot(fps[i], pilots_[Bucket(fps[i])]);
+        __builtin_prefetch(&fps_[slots[i]]);
+        __builtin_prefetch(&keys_[slots[i]]);
+      }
+      for (int64 i = 0; i < size; ++i) {
+        const int64 slot = slots[i];
+        values[start + i] = occupied_[slot] && fps_[slot] == fps[i] &&
+                                    keys_[slot] == keys[start + i]
+                                ? values_[slot]
+                                : default_value;
+      }
+    }
+  }
+
+  template <typename Fn>
+  void ForEach(Fn fn) const {
+    for (int64 slot = 0; slot < num_slots_; ++slot) {
+      if (occupied_[slot]) {
+        fn(keys_[slot], values_[slot]);
+      }
+    }
+  }
+
+  int64 size() const { return size_; }
+
+  int64 MemoryUsed() const {
+    return num_buckets_ * sizeof(uint32) +
+           num_slots_ * (sizeof(uint64) + 1 + sizeof(K) + sizeof(V));
+  }
+
+ private:
+  static constexpr uint32 kMaxPilot = 1 << 20;
+
+  int64 Bucket(uint64 fp) const { return (fp >> 32) % num_buckets_; }
+
+  // The fingerprint is mixed again after the pilot, as the low bits of
+  // fp ^ pilot alone keep the collisions of small numbers of slots.
+  int64 Slot(uint64 fp, uint32 pilot) const {
+    return PerfectHashFingerprint(
+               static_cast<int64>(fp ^ (pilot * 0x9e3779b97f4a7c15ULL))) %
+           num_slots_;
+  }
+
+  int64 size_ = 0;
+  int64 num_buckets_ = 1;
+  int64 num_slots_ = 1;
+  std::vector<uint32> pilots_;
+  std::vector<uint64> fps_;
+  std::vector<uint8> occupied_;
+  std::vector<K> keys_;
+  std::vector<V> values_;
+};
+
+// Whether the HashTables are rebuilt as PerfectHashMaps once initialized,
+// TF_LOOKUP_TABLE_PERFECT_HASH, true by default.
+inline bool PerfectHashTablesEnabled() {
+  static const bool enabled = [] {
+    bool value;
+    TF_CHECK_OK(
+        ReadBoolFromEnvVar("TF_LOOKUP_TABLE_PERFECT_HASH", true, &value));
+    return value;
+  }();
+  return enabled;
+}
+
 // Lookup table that wraps an unordered_map, where the key and value data type
 // is specified.
 //
 // This table is recommended for any variations to key values.
 //
 // For look up, the table is required to be initialized (allocated
-// and populated). Once the table is marked as initialized it becomes read-only.
+// and populated). Once the table is marked as initialized it becomes read-only,
+// and the unordered_map is replaced by a PerfectHashMap.
 //
 // Sample use case:
 //
@@ -179,6 +374,9 @@ class HashTable : public InitializableLookupTable {
       return 0;
     }
     std::atomic_thread_fence(std::memory_order_acquire);
+    if (perfect_table_) {
+      return perfect_table_->size();
+    }
     return table_ ? table_->size() : 0;
   }
 
@@ -187,7 +385,7 @@ class HashTable : public InitializableLookupTable {
       return errors::Aborted("HashTable is not initialized.");
     }
 
-    const int64 size = table_->size();
+    const int64 size = this->size();
 
     Tensor* keys;
     Tensor* values;
@@ -199,6 +397,15 @@ class HashTable : public InitializableLookupTable {
     auto keys_data = keys->flat<K>();
     auto values_data = values->flat<V>();
     int64 i = 0;
+    if (perfect_table_) {
+      perfect_table_->ForEach([&keys_data, &values_data, &i](const K& key,
+                                                             const V& value) {
+        keys_data(i) = key;
+        values_data(i) = value;
+        ++i;
+      });
+      return Status::OK();
+    }
     for (auto it = table_->begin(); it != table_->end(); ++it, ++i) {
       keys_data(i) = it->first;
       values_data(i) = it->second;
@@ -247,12 +454,33 @@ class HashTable : public InitializableLookupTable {
     return Status::OK();
   }
 
+  Status DoFreeze() override {
+    if (!PerfectHashTablesEnabled() || !table_) {
+      return Status::OK();
+    }
+    std::unique_ptr<PerfectHashMap<K, V>> perfect_table(
+        new PerfectHashMap<K, V>());
+    if (!perfect_table->Build(*table_)) {
+      LOG(WARNING) << "No perfect hash function found for a HashTable of "
+                   << table_->size() << " keys, it keeps its unordered_map.";
+      return Status::OK();
+    }
+    perfect_table_ = std::move(perfect_table);
+    table_.reset();
+    return Status::OK();
+  }
+
   Status DoFind(const Tensor& key, Tensor* value,
                 const Tensor& default_value) override {
     const V default_val = default_value.flat<V>()(0);
     const auto key_values = key.flat<K>();
     auto value_values = value->flat<V>();
 
+    if (perfect_table_) {
+      perfect_table_->Find(key_values.data(), key_values.size(), default_val,
+                           value_values.data());
+      return Status::OK();
+    }
     for (int64 i = 0; i < key_values.size(); ++i) {
       value_values(i) = gtl::FindWithDefault(
           *table_, SubtleMustCopyIfIntegral(key_values(i)), default_val);
@@ -261,6 +489,9 @@ class HashTable : public InitializableLookupTable {
   }
 
   int64 MemoryUsed() const override {
+    if (perfect_table_) {
+      return perfect_table_->MemoryUsed();
+    }
     if (table_) {
       const int64 num_elements = table_->size();
       return num_elements * (sizeof(K) + sizeof(V));
@@ -271,6 +502,7 @@ class HashTable : public InitializableLookupTable {
 
  private:
   std::unique_ptr<std::unordered_map<K, V>> table_;
+  std::unique_ptr<PerfectHashMap<K, V>> perfect_table_;
 };
 
 }  // namespace lookup
@@ -21,8 +21,10 @@ limitations under the License.
 #include <unordered_map>
 #include <vector>
 
+#include "tensorflow/core/common_runtime/step_stats_collector.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/stall_stats.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/lib/gtl/optional.h"
@@ -101,10 +103,32 @@ class StagingMap : public ResourceBase {
   tensorflow::condition_variable full_;
   IncompleteType incomplete_ GUARDED_BY(mu_);
   MapType map_ GUARDED_BY(mu_);
+  StallCounters* stall_counters_;
 
  private:
   // private methods
 
+  // Waits on cond until ready() holds, recording the time it blocked in
+  // stall and in the producer or the consumer stall counters
+  template <typename Ready>
+  void wait_until(tensorflow::condition_variable* cond,
+                  tensorflow::mutex_lock* lock, Ready ready, bool is_producer,
+                  StallTime* stall) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (ready()) {
+      return;
+    }
+    stall->start_nanos = Env::Default()->NowNanos();
+    do {
+      cond->wait(*lock);
+    } while (!ready());
+    stall->wait_nanos = Env::Default()->NowNanos() - stall->start_nanos;
+    if (is_producer) {
+      stall_counters_->RecordProducerWait(stall->wait_nanos);
+    } else {
+      stall_counters_->RecordConsumerWait(stall->wait_nanos);
+    }
+  }
+
   // If map is configured for bounded capacity, notify
   // waiting inserters that space is now available
   void notify_inserters_if_bounded() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
@@ -250,8 +274,8 @@ class StagingMap : public ResourceBase {
 
   // Insert incomplete data into the Barrier
   Status put_incomplete(const KeyType& key, const Tensor& indices,
-                        OptionalTuple* tuple, tensorflow::mutex_lock* lock)
-      EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+                        OptionalTuple* tuple, tensorflow::mutex_lock* lock,
+                        StallTime* stall) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
     auto findices = indices.flat<int>();
 
     // Search for the key in our incomplete set
@@ -262,9 +286,12 @@ class StagingMap : public ResourceBase {
     TF_RETURN_IF_ERROR(check_memory_limit(tuple_bytes));
 
     // Wait until we don't exceed the memory limit
-    while (would_exceed_memory_limit(tuple_bytes)) {
-      full_.wait(*lock);
-    }
+    wait_until(
+        &full_, lock,
+        [tuple_bytes, this]() {
+          return !would_exceed_memory_limit(tuple_bytes);
+        },
+        /*is_producer=*/true, stall);
 
     // This key isn't present in the incomplete set
     // Create OptionalTuple and insert
@@ -339,13 +366,16 @@ class StagingMap : public ResourceBase {
  public:
   // public methods
   explicit StagingMap(const DataTypeVector& dtypes, std::size_t capacity,
-                      std::size_t memory_limit)
+                      std::size_t memory_limit, const string& name)
       : dtypes_(dtypes),
         capacity_(capacity),
         memory_limit_(memory_limit),
-        current_bytes_(0) {}
+        current_bytes_(0),
+        stall_counters_(
+            StallStats::Global()->Get(strings::StrCat("MapStage/", name))) {}
 
-  Status put(KeyType* key, const Tensor* indices, OptionalTuple* tuple) {
+  Status put(KeyType* key, const Tensor* indices, OptionalTuple* tuple,
+             StallTime* stall) {
     tensorflow::mutex_lock lock(mu_);
 
     // Sanity check the indices
@@ -353,7 +383,7 @@ class StagingMap : public ResourceBase {
 
     // Handle incomplete inserts
     if (indices->NumElements() != dtypes_.size()) {
-      return put_incomplete(*key, *indices, tuple, &lock);
+      return put_incomplete(*key, *indices, tuple, &lock, stall);
     }
 
     std::size_t tuple_bytes = get_tuple_bytes(*tuple);
@@ -361,9 +391,13 @@ class StagingMap : public ResourceBase {
     TF_RETURN_IF_ERROR(check_memory_limit(tuple_bytes));
 
     // Wait until there's space for insertion.
-    while (would_exceed_memory_limit(tuple_bytes) || is_capacity_full()) {
-      full_.wait(lock);
-    }
+    wait_until(
+        &full_, &lock,
+        [tuple_bytes, this]() {
+          return !would_exceed_memory_limit(tuple_bytes) &&
+                 !is_capacity_full();
+        },
+        /*is_producer=*/true, stall);
 
     // Do the put operation
     TF_RETURN_IF_ERROR(put_complete(*key, tuple));
@@ -374,7 +408,8 @@ class StagingMap : public ResourceBase {
     return Status::OK();
   }
 
-  Status get(const KeyType* key, const Tensor* indices, Tuple* tuple) {
+  Status get(const KeyType* key, const Tensor* indices, Tuple* tuple,
+             StallTime* stall) {
     tensorflow::mutex_lock lock(mu_);
 
     // Sanity check the indices
@@ -383,9 +418,10 @@ class StagingMap : public ResourceBase {
     typename MapType::iterator it;
 
     // Wait until the element with the requested key is present
-    while ((it = map_.find(*key)) == map_.end()) {
-      not_empty_.wait(lock);
-    }
+    wait_until(
+        &not_empty_, &lock,
+        [key, &it, this]() { return (it = map_.find(*key)) != map_.end(); },
+        /*is_producer=*/false, stall);
 
     TF_RETURN_IF_ERROR(
         copy_or_move_tensors(&it->second, *key, *indices, tuple, true));
@@ -396,7 +432,8 @@ class StagingMap : public ResourceBase {
     return Status::OK();
   }
 
-  Status pop(const KeyType* key, const Tensor* indices, Tuple* tuple) {
+  Status pop(const KeyType* key, const Tensor* indices, Tuple* tuple,
+             StallTime* stall) {
     tensorflow::mutex_lock lock(mu_);
 
     // Sanity check the indices
@@ -405,9 +442,10 @@ class StagingMap : public ResourceBase {
     typename MapType::iterator it;
 
     // Wait until the element with the requested key is present
-    while ((it = map_.find(*key)) == map_.end()) {
-      not_empty_.wait(lock);
-    }
+    wait_until(
+        &not_empty_, &lock,
+        [key, &it, this]() { return (it = map_.find(*key)) != map_.end(); },
+        /*is_producer=*/false, stall);
 
     TF_RETURN_IF_ERROR(
         copy_or_move_tensors(&it->second, *key, *indices, tuple));
@@ -427,16 +465,17 @@ class StagingMap : public ResourceBase {
     return Status::OK();
   }
 
-  Status popitem(KeyType* key, const Tensor* indices, Tuple* tuple) {
+  Status popitem(KeyType* key, const Tensor* indices, Tuple* tuple,
+                 StallTime* stall) {
     tensorflow::mutex_lock lock(mu_);
 
     // Sanity check the indices
     TF_RETURN_IF_ERROR(check_index_ordering(*indices));
 
     // Wait until map is not empty
-    while (this->map_.empty()) {
-      not_empty_.wait(lock);
-    }
+    wait_until(
+        &not_empty_, &lock, [this]() { return !map_.empty(); },
+        /*is_producer=*/false, stall);
 
     // Move from the first element and erase it
 
@@ -493,14 +532,15 @@ Status GetStagingMap(OpKernelContext* ctx, const NodeDef& ndef,
   ContainerInfo cinfo;
 
   // Lambda for creating the Staging Area
-  auto create_fn = [&ndef](StagingMap<Ordered>** ret) -> Status {
+  auto create_fn = [&ndef, &cinfo](StagingMap<Ordered>** ret) -> Status {
     DataTypeVector dtypes;
     int64 capacity;
     int64 memory_limit;
     TF_RETURN_IF_ERROR(GetNodeAttr(ndef, "dtypes", &dtypes));
     TF_RETURN_IF_ERROR(GetNodeAttr(ndef, "capacity", &capacity));
     TF_RETURN_IF_ERROR(GetNodeAttr(ndef, "memory_limit", &memory_limit));
-    *ret = new StagingMap<Ordered>(dtypes, capacity, memory_limit);
+    *ret = new StagingMap<Ordered>(dtypes, capacity, memory_limit,
+                                   cinfo.name());
     return Status::OK();
   };
 
@@ -545,7 +585,11 @@ class MapStageOp : public OpKernel {
     }
 
     // Store the tuple in the map
-    OP_REQUIRES_OK(ctx, map->put(&key, indices_tensor, &tuple));
+    StallTime stall;
+    Status s = map->put(&key, indices_tensor, &tuple, &stall);
+    RecordWaitInStepStats(ctx, "producer_wait", stall.start_nanos,
+                          stall.wait_nanos);
+    OP_REQUIRES_OK(ctx, s);
   }
 };
 
@@ -595,7 +639,11 @@ class MapUnstageOp : public OpKernel {
 
     OP_REQUIRES_OK(ctx, ctx->input("key", &key_tensor));
     OP_REQUIRES_OK(ctx, ctx->input("indices", &indices_tensor));
-    OP_REQUIRES_OK(ctx, map->pop(key_tensor, indices_tensor, &tuple));
+    StallTime stall;
+    Status s = map->pop(key_tensor, indices_tensor, &tuple, &stall);
+    RecordWaitInStepStats(ctx, "consumer_wait", stall.start_nanos,
+                          stall.wait_nanos);
+    OP_REQUIRES_OK(ctx, s);
 
     OP_REQUIRES(
         ctx, tuple.size() == indices_tensor->NumElements(),
@@ -656,7 +704,11 @@ class MapPeekOp : public OpKernel {
 
     OP_REQUIRES_OK(ctx, ctx->input("key", &key_tensor));
     OP_REQUIRES_OK(ctx, ctx->input("indices", &indices_tensor));
-    OP_REQUIRES_OK(ctx, map->get(key_tensor, indices_tensor, &tuple));
+    StallTime stall;
+    Status s = map->get(key_tensor, indices_tensor, &tuple, &stall);
+    RecordWaitInStepStats(ctx, "consumer_wait", stall.start_nanos,
+                          stall.wait_nanos);
+    OP_REQUIRES_OK(ctx, s);
 
     OP_REQUIRES(
         ctx, tuple.size() == indices_tensor->NumElements(),
@@ -714,7 +766,11 @@ class MapUnstageNoKeyOp : public OpKernel {
     const Tensor* indices_tensor;
 
     OP_REQUIRES_OK(ctx, ctx->input("indices", &indices_tensor));
-    OP_REQUIRES_OK(ctx, map->popitem(&key, indices_tensor, &tuple));
+    StallTime stall;
+    Status s = map->popitem(&key, indices_tensor, &tuple, &stall);
+    RecordWaitInStepStats(ctx, "consumer_wait", stall.start_nanos,
+                          stall.wait_nanos);
+    OP_REQUIRES_OK(ctx, s);
 
     // Allocate a key tensor and assign the key as the first output
     ctx->set_output(0, key);
@@ -0,0 +1,451 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cmath>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+template <typename T>
+using RowMajorMatrix =
+    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+// The row-major matrices of an expert within the [batch, experts, dim]
+// layout, whose rows are experts * dim apart.
+template <typename T>
+using ConstExpertMatrix =
+    Eigen::Map<const RowMajorMatrix<T>, Eigen::Unaligned, Eigen::OuterStride<>>;
+template <typename T>
+using ExpertMatrix =
+    Eigen::Map<RowMajorMatrix<T>, Eigen::Unaligned, Eigen::OuterStride<>>;
+
+// Rows of the batch a unit of the grouped matmuls computes, a block small
+// enough for its inputs and outputs to stay in the cache of the thread.
+constexpr int64 kRowBlock = 64;
+
+struct MultiExpertDims {
+  int64 batch;
+  int64 experts;
+  int64 in;
+  int64 out;
+  // Whether x is [batch, in], the input of all the experts.
+  bool shared_input;
+  // The distance between the rows of x.
+  int64 x_stride() const { return shared_input ? in : experts * in; }
+};
+
+Status GetMultiExpertDims(const Tensor& x, const Tensor& w,
+                          MultiExpertDims* dims) {
+  if (w.dims() != 3) {
+    return errors::InvalidArgument("w must be [experts, in, out], got ",
+                                   w.shape().DebugString());
+  }
+  dims->experts = w.dim_size(0);
+  dims->in = w.dim_size(1);
+  dims->out = w.dim_size(2);
+  dims->shared_input = x.dims() == 2;
+  if (!(x.dims() == 2 ||
+        (x.dims() == 3 && x.dim_size(1) == dims->experts)) ||
+      x.dim_size(x.dims() - 1) != dims->in) {
+    return errors::InvalidArgument(
+        "x must be [batch, ", dims->in, "] or [batch, ", dims->experts, ", ",
+        dims->in, "], got ", x.shape().DebugString());
+  }
+  dims->batch = x.dim_size(0);
+  return Status::OK();
+}
+
+bool ParseActivation(const string& activation) { return activation == "relu"; }
+
+}  // namespace
+
+// Computes the dense layers of all the experts in one sharded pass. A unit
+// is a block of rows of an expert, whose matmul writes its output straight
+// into the stacked [batch, experts, out] layout, with the bias and the
+// activation applied while the block is in the cache. The unfused graph
+// runs a MatMul, a BiasAdd and a Relu per expert, and a Pack.
+template <typename T>
+class MultiExpertDenseOp : public OpKernel {
+ public:
+  explicit MultiExpertDenseOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    string activation;
+    OP_REQUIRES_OK(context, context->GetAttr("activation", &activation));
+    relu_ = ParseActivation(activation);
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& x_tensor = context->input(0);
+    const Tensor& w_tensor = context->input(1);
+    const Tensor& b_tensor = context->input(2);
+    MultiExpertDims dims;
+    OP_REQUIRES_OK(context, GetMultiExpertDims(x_tensor, w_tensor, &dims));
+    OP_REQUIRES(context,
+                b_tensor.dims() == 2 && b_tensor.dim_size(0) == dims.experts &&
+                    b_tensor.dim_size(1) == dims.out,
+                errors::InvalidArgument("b must be [", dims.experts, ", ",
+                                        dims.out, "], got ",
+                                        b_tensor.shape().DebugString()));
+
+    Tensor* y_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       0, TensorShape({dims.batch, dims.experts, dims.out}),
+                       &y_tensor));
+    if (y_tensor->NumElements() == 0) {
+      return;
+    }
+
+    const T* x = x_tensor.flat<T>().data();
+    const T* w = w_tensor.flat<T>().data();
+    const T* b = b_tensor.flat<T>().data();
+    T* y = y_tensor->flat<T>().data();
+    const int64 row_blocks = (dims.batch + kRowBlock - 1) / kRowBlock;
+    const int64 x_stride = dims.x_stride();
+    const int64 y_stride = dims.experts * dims.out;
+    const bool relu = relu_;
+
+    auto compute = [&](int64 begin, int64 end) {
+      for (int64 unit = begin; unit < end; ++unit) {
+        const int64 e = unit / row_blocks;
+        const int64 row = (unit % row_blocks) * kRowBlock;
+        const int64 rows = std::min(kRowBlock, dims.batch - row);
+        const T* x_block =
+            x + row * x_stride + (dims.shared_input ? 0 : e * dims.in);
+        ConstExpertMatrix<T> x_e(x_block, rows, dims.in,
+                                 Eigen::OuterStride<>(x_stride));
+        ConstExpertMatrix<T> w_e(w + e * dims.in * dims.out, dims.in,
+                                 dims.out, Eigen::OuterStride<>(dims.out));
+        ExpertMatrix<T> y_e(y + row * y_stride + e * dims.out, rows, dims.out,
+                            Eigen::OuterStride<>(y_stride));
+        y_e.noalias() = x_e * w_e;
+        const T* b_e = b + e * dims.out;
+        for (int64 n = 0; n < rows; ++n) {
+          T* y_row = y_e.row(n).data();
+          for (int64 d = 0; d < dims.out; ++d) {
+            const T v = y_row[d] + b_e[d];
+            y_row[d] = relu && v < static_cast<T>(0) ? static_cast<T>(0) : v;
+          }
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          dims.experts * row_blocks, kRowBlock * dims.in * dims.out * 2,
+          compute);
+  }
+
+ private:
+  bool relu_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("MultiExpertDense")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<float>("T"),
+                        MultiExpertDenseOp<float>);
+
+template <typename T>
+class MultiExpertDenseGradOp : public OpKernel {
+ public:
+  explicit MultiExpertDenseGradOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    string activation;
+    OP_REQUIRES_OK(context, context->GetAttr("activation", &activation));
+    relu_ = ParseActivation(activation);
+  }
+
+  // With dz = dy, masked by y > 0 for relu:
+  //   dx_e = dz_e w[e]^T, summed over the experts for a shared x
+  //   dw[e] = x_e^T dz_e
+  //   db[e] = sum_rows(dz_e)
+  void Compute(OpKernelContext* context) override {
+    const Tensor& grad_tensor = context->input(0);
+    const Tensor& x_tensor = context->input(1);
+    const Tensor& w_tensor = context->input(2);
+    const Tensor& y_tensor = context->input(3);
+    MultiExpertDims dims;
+    OP_REQUIRES_OK(context, GetMultiExpertDims(x_tensor, w_tensor, &dims));
+    const TensorShape y_shape({dims.batch, dims.experts, dims.out});
+    OP_REQUIRES(context,
+                grad_tensor.shape() == y_shape && y_tensor.shape() == y_shape,
+                errors::InvalidArgument(
+                    "y_grad and y must be ", y_shape.DebugString(), ", got ",
+                    grad_tensor.shape().DebugString(), " and ",
+                    y_tensor.shape().DebugString()));
+
+    Tensor* x_grad_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, x_tensor.shape(),
+                                                     &x_grad_tensor));
+    Tensor* w_grad_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(1, w_tensor.shape(),
+                                                     &w_grad_tensor));
+    Tensor* b_grad_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                2, TensorShape({dims.experts, dims.out}),
+                                &b_grad_tensor));
+    T* x_grad = x_grad_tensor->flat<T>().data();
+    T* w_grad = w_grad_tensor->flat<T>().data();
+    T* b_grad = b_grad_tensor->flat<T>().data();
+    if (dims.batch == 0 || dims.experts == 0 || dims.in == 0 ||
+        dims.out == 0) {
+      x_grad_tensor->flat<T>().setZero();
+      w_grad_tensor->flat<T>().setZero();
+      b_grad_tensor->flat<T>().setZero();
+      return;
+    }
+
+    const T* x = x_tensor.flat<T>().data();
+    const T* w = w_tensor.flat<T>().data();
+    const int64 row_blocks = (dims.batch + kRowBlock - 1) / kRowBlock;
+    const int64 x_stride = dims.x_stride();
+    const int64 y_stride = dims.experts * dims.out;
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+
+    // The gradient through the activation, shared by the three outputs.
+    const T* dz = grad_tensor.flat<T>().data();
+    Tensor dz_tensor;
+    if (relu_) {
+      OP_REQUIRES_OK(context, context->allocate_temp(DataTypeToEnum<T>::v(),
+                                                     y_shape, &dz_tensor));
+      const T* dy = grad_tensor.flat<T>().data();
+      const T* y = y_tensor.flat<T>().data();
+      T* masked = dz_tensor.flat<T>().data();
+      auto mask = [&](int64 begin, int64 end) {
+        for (int64 i = begin; i < end; ++i) {
+          masked[i] = y[i] > static_cast<T>(0) ? dy[i] : static_cast<T>(0);
+        }
+      };
+      Shard(worker_threads->num_threads, worker_threads->workers,
+            y_tensor.NumElements(), 2, mask);
+      dz = masked;
+    }
+
+    // x_grad by blocks of rows. A shared x sums the experts in the block,
+    // without a temporary per expert.
+    auto compute_x_grad = [&](int64 begin, int64 end) {
+      for (int64 unit = begin; unit < end; ++unit) {
+        const int64 e_begin = dims.shared_input ? 0 : unit / row_blocks;
+        const int64 e_end = dims.shared_input ? dims.experts : e_begin + 1;
+        const int64 row = (unit % row_blocks) * kRowBlock;
+        const int64 rows = std::min(kRowBlock, dims.batch - row);
+        for (int64 e = e_begin; e < e_end; ++e) {
+          ConstExpertMatrix<T> dz_e(dz + row * y_stride + e * dims.out, rows,
+                                    dims.out, Eigen::OuterStride<>(y_stride));
+          ConstExpertMatrix<T> w_e(w + e * dims.in * dims.out, dims.in,
+                                   dims.out, Eigen::OuterStride<>(dims.out));
+          ExpertMatrix<T> dx_e(
+              x_grad + row * x_stride + (dims.shared_input ? 0 : e * dims.in),
+              rows, dims.in, Eigen::OuterStride<>(x_stride));
+          if (e == e_begin) {
+            dx_e.noalias() = dz_e * w_e.transpose();
+          } else {
+            dx_e.noalias() += dz_e * w_e.transpose();
+          }
+        }
+      }
+    };
+    const int64 x_units = dims.shared_input ? row_blocks
+                                            : dims.experts * row_blocks;
+    const int64 x_unit_experts = dims.shared_input ? dims.experts : 1;
+    Shard(worker_threads->num_threads, worker_threads->workers, x_units,
+          x_unit_experts * kRowBlock * dims.in * dims.out * 2,
+          compute_x_grad);
+
+    // w_grad and b_grad by expert and block of input columns, each unit
+    // reducing the whole batch for its block.
+    const int64 col_blocks = (dims.in + kRowBlock - 1) / kRowBlock;
+    auto compute_w_grad = [&](int64 begin, int64 end) {
+      for (int64 unit = begin; unit < end; ++unit) {
+        const int64 e = unit / col_blocks;
+        const int64 col = (unit % col_blocks) * kRowBlock;
+        const int64 cols = std::min(kRowBlock, dims.in - col);
+        ConstExpertMatrix<T> x_e(x + (dims.shared_input ? 0 : e * dims.in),
+                                 dims.batch, dims.in,
+                                 Eigen::OuterStride<>(x_stride));
+        ConstExpertMatrix<T> dz_e(dz + e * dims.out, dims.batch, dims.out,
+                                  Eigen::OuterStride<>(y_stride));
+        ExpertMatrix<T> dw_e(w_grad + e * dims.in * dims.out + col * dims.out,
+                             cols, dims.out, Eigen::OuterStride<>(dims.out));
+        dw_e.noalias() = x_e.middleCols(col, cols).transpose() * dz_e;
+        if (col == 0) {
+          Eigen::Map<Eigen::Matrix<T, 1, Eigen::Dynamic>> db_e(
+              b_grad + e * dims.out, dims.out);
+          db_e = dz_e.colwise().sum();
+        }
+      }
+    };
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          dims.experts * col_blocks, dims.batch * kRowBlock * dims.out * 2,
+          compute_w_grad);
+  }
+
+ private:
+  bool relu_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("MultiExpertDenseGrad")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<float>("T"),
+                        MultiExpertDenseGradOp<float>);
+
+namespace {
+
+Status ValidateGateInputs(const Tensor& experts, const Tensor& gates) {
+  if (experts.dims() != 3 || gates.dims() != 2 ||
+      experts.dim_size(0) != gates.dim_size(0) ||
+      experts.dim_size(1) != gates.dim_size(1)) {
+    return errors::InvalidArgument(
+        "experts must be [batch, experts, dim] and the gates [batch, "
+        "experts], got ",
+        experts.shape().DebugString(), " and ", gates.shape().DebugString());
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+// Computes the softmax of the gate of a task and the sum of the experts it
+// weights in one pass over the rows, instead of the Softmax, ExpandDims,
+// Mul and Sum of the unfused graph, whose Mul writes a temporary as large
+// as the stacked experts.
+template <typename T>
+class MultiExpertGateOp : public OpKernel {
+ public:
+  explicit MultiExpertGateOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& experts_tensor = context->input(0);
+    const Tensor& logits_tensor = context->input(1);
+    OP_REQUIRES_OK(context, ValidateGateInputs(experts_tensor, logits_tensor));
+
+    const int64 rows = experts_tensor.dim_size(0);
+    const int64 num_experts = experts_tensor.dim_size(1);
+    const int64 dim = experts_tensor.dim_size(2);
+    Tensor* y_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, TensorShape({rows, dim}), &y_tensor));
+    Tensor* gates_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(1, logits_tensor.shape(),
+                                                     &gates_tensor));
+
+    const T* experts = experts_tensor.flat<T>().data();
+    const T* logits = logits_tensor.flat<T>().data();
+    T* y = y_tensor->flat<T>().data();
+    T* gates = gates_tensor->flat<T>().data();
+    if (num_experts == 0) {
+      y_tensor->flat<T>().setZero();
+      return;
+    }
+
+    auto compute = [&](int64 begin, int64 end) {
+      for (int64 n = begin; n < end; ++n) {
+        const T* logits_row = logits + n * num_experts;
+        T* gates_row = gates + n * num_experts;
+        T max_logit = logits_row[0];
+        for (int64 e = 1; e < num_experts; ++e) {
+          max_logit = std::max(max_logit, logits_row[e]);
+        }
+        T sum = 0;
+        for (int64 e = 0; e < num_experts; ++e) {
+          gates_row[e] = std::exp(logits_row[e] - max_logit);
+          sum += gates_row[e];
+        }
+        T* y_row = y + n * dim;
+        std::fill(y_row, y_row + dim, static_cast<T>(0));
+        for (int64 e = 0; e < num_experts; ++e) {
+          gates_row[e] /= sum;
+          const T gate = gates_row[e];
+          const T* expert = experts + (n * num_experts + e) * dim;
+          for (int64 d = 0; d < dim; ++d) {
+            y_row[d] += gate * expert[d];
+          }
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, rows,
+          num_experts * (dim * 2 + 10), compute);
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("MultiExpertGate")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<float>("T"),
+                        MultiExpertGateOp<float>);
+
+template <typename T>
+class MultiExpertGateGradOp : public OpKernel {
+ public:
+  explicit MultiExpertGateGradOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  // With dg[n, e] = dot(dy[n], experts[n, e]):
+  //   dexperts[n, e] = gates[n, e] * dy[n]
+  //   dlogits[n] = gates[n] * (dg[n] - dot(gates[n], dg[n]))
+  void Compute(OpKernelContext* context) override {
+    const Tensor& grad_tensor = context->input(0);
+    const Tensor& experts_tensor = context->input(1);
+    const Tensor& gates_tensor = context->input(2);
+    OP_REQUIRES_OK(context, ValidateGateInputs(experts_tensor, gates_tensor));
+    const int64 rows = experts_tensor.dim_size(0);
+    const int64 num_experts = experts_tensor.dim_size(1);
+    const int64 dim = experts_tensor.dim_size(2);
+    OP_REQUIRES(context, grad_tensor.shape() == TensorShape({rows, dim}),
+                errors::InvalidArgument("Mismatched shape of y_grad ",
+                                        grad_tensor.shape().DebugString()));
+
+    Tensor* experts_grad_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, experts_tensor.shape(),
+                                                     &experts_grad_tensor));
+    Tensor* logits_grad_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(1, gates_tensor.shape(),
+                                                     &logits_grad_tensor));
+
+    const T* grad = grad_tensor.flat<T>().data();
+    const T* experts = experts_tensor.flat<T>().data();
+    const T* gates = gates_tensor.flat<T>().data();
+    T* experts_grad = experts_grad_tensor->flat<T>().data();
+    T* logits_grad = logits_grad_tensor->flat<T>().data();
+
+    auto compute = [&](int64 begin, int64 end) {
+      for (int64 n = begin; n < end; ++n) {
+        const T* dy = grad + n * dim;
+        const T* gates_row = gates + n * num_experts;
+        T* dlogits = logits_grad + n * num_experts;
+        T weighted = 0;
+        for (int64 e = 0; e < num_experts; ++e) {
+          const T gate = gates_row[e];
+          const T* expert = experts + (n * num_experts + e) * dim;
+          T* dexpert = experts_grad + (n * num_experts + e) * dim;
+          T dg = 0;
+          for (int64 d = 0; d < dim; ++d) {
+            dg += dy[d] * expert[d];
+            dexpert[d] = gate * dy[d];
+          }
+          dlogits[e] = dg;
+          weighted += gate * dg;
+        }
+        for (int64 e = 0; e < num_experts; ++e) {
+          dlogits[e] = gates_row[e] * (dlogits[e] - weighted);
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, rows,
+          num_experts * (dim * 3 + 4), compute);
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("MultiExpertGateGrad")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<float>("T"),
+                        MultiExpertGateGradOp<float>);
+
+}  // namespace tensorflow
@@ -0,0 +1,115 @@
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class MultiExpertOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op, int num_inputs, const string& activation) {
+    NodeDefBuilder builder("multi_expert", op);
+    for (int i = 0; i < num_inputs; ++i) {
+      builder.Input(FakeInput(DT_FLOAT));
+    }
+    if (!activation.empty()) {
+      builder.Attr("activation", activation);
+    }
+    TF_EXPECT_OK(builder.Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+};
+
+TEST_F(MultiExpertOpTest, DenseSharedInput) {
+  MakeOp("MultiExpertDense", 3, "relu");
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, -4});  // x
+  // Two experts of 2 x 1 weights.
+  AddInputFromArray<float>(TensorShape({2, 2, 1}), {1, 1, 2, -1});  // w
+  AddInputFromArray<float>(TensorShape({2, 1}), {0.5, 0});          // b
+  TF_ASSERT_OK(RunOpKernel());
+
+  // Row 0: [3.5, 0], row 1: [-0.5, 10], before the relu.
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 2, 1}));
+  test::FillValues<float>(&expected, {3.5, 0, 0, 10});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(MultiExpertOpTest, DensePerExpertInput) {
+  MakeOp("MultiExpertDense", 3, "none");
+  // x[:, 0, :] = [[1, 2], [3, 4]], x[:, 1, :] = [[1, 0], [0, 1]]
+  AddInputFromArray<float>(TensorShape({2, 2, 2}), {1, 2, 1, 0, 3, 4, 0, 1});
+  AddInputFromArray<float>(TensorShape({2, 2, 1}), {1, 1, 2, -1});  // w
+  AddInputFromArray<float>(TensorShape({2, 1}), {0, 1});            // b
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 2, 1}));
+  test::FillValues<float>(&expected, {3, 3, 7, 0});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(MultiExpertOpTest, DenseGradSharedInput) {
+  MakeOp("MultiExpertDenseGrad", 4, "relu");
+  AddInputFromArray<float>(TensorShape({2, 2, 1}), {1, 1, 1, 2});  // y_grad
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, -4});    // x
+  AddInputFromArray<float>(TensorShape({2, 2, 1}), {1, 1, 2, -1});  // w
+  AddInputFromArray<float>(TensorShape({2, 2, 1}), {3.5, 0, 0, 10});  // y
+  TF_ASSERT_OK(RunOpKernel());
+
+  // dz = [[1, 0], [0, 2]]
+  Tensor expected_x(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected_x, {1, 1, 4, -2});
+  test::ExpectTensorNear<float>(expected_x, *GetOutput(0), 1e-5);
+  Tensor expected_w(allocator(), DT_FLOAT, TensorShape({2, 2, 1}));
+  test::FillValues<float>(&expected_w, {1, 2, 6, -8});
+  test::ExpectTensorNear<float>(expected_w, *GetOutput(1), 1e-5);
+  Tensor expected_b(allocator(), DT_FLOAT, TensorShape({2, 1}));
+  test::FillValues<float>(&expected_b, {1, 2});
+  test::ExpectTensorNear<float>(expected_b, *GetOutput(2), 1e-5);
+}
+
+TEST_F(MultiExpertOpTest, Gate) {
+  MakeOp("MultiExpertGate", 2, "");
+  // Two rows of two experts of dim 2.
+  AddInputFromArray<float>(TensorShape({2, 2, 2}), {1, 2, 3, 4, 1, 1, 5, 5});
+  AddInputFromArray<float>(TensorShape({2, 2}), {0, 0, 0, 100});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_y(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected_y, {2, 3, 5, 5});
+  test::ExpectTensorNear<float>(expected_y, *GetOutput(0), 1e-5);
+  Tensor expected_gates(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected_gates, {0.5, 0.5, 0, 1});
+  test::ExpectTensorNear<float>(expected_gates, *GetOutput(1), 1e-5);
+}
+
+TEST_F(MultiExpertOpTest, GateGrad) {
+  MakeOp("MultiExpertGateGrad", 3, "");
+  AddInputFromArray<float>(TensorShape({1, 2}), {1, 0});              // y_grad
+  AddInputFromArray<float>(TensorShape({1, 2, 2}), {1, 2, 3, 4});     // experts
+  AddInputFromArray<float>(TensorShape({1, 2}), {0.5, 0.5});          // gates
+  TF_ASSERT_OK(RunOpKernel());
+
+  // dg = [1, 3], dot(gates, dg) = 2
+  Tensor expected_experts(allocator(), DT_FLOAT, TensorShape({1, 2, 2}));
+  test::FillValues<float>(&expected_experts, {0.5, 0, 0.5, 0});
+  test::ExpectTensorNear<float>(expected_experts, *GetOutput(0), 1e-5);
+  Tensor expected_logits(allocator(), DT_FLOAT, TensorShape({1, 2}));
+  test::FillValues<float>(&expected_logits, {-0.5, 0.5});
+  test::ExpectTensorNear<float>(expected_logits, *GetOutput(1), 1e-5);
+}
+
+TEST_F(MultiExpertOpTest, MismatchedExperts) {
+  MakeOp("MultiExpertDense", 3, "relu");
+  AddInputFromArray<float>(TensorShape({1, 3, 2}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<float>(TensorShape({2, 2, 1}), {1, 1, 2, -1});
+  AddInputFromArray<float>(TensorShape({2, 1}), {0, 0});
+  EXPECT_FALSE(RunOpKernel().ok());
+}
+
+}  // namespace
+}  // namespace tensorflow
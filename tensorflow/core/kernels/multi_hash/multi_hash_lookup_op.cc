@@ -0,0 +1,138 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+// Composes the embeddings of a multi-hash variable in one pass over the
+// ids, instead of the FloorDiv, FloorMod, two gathers and the combining op
+// of the unfused graph. The two tables are small enough to stay in cache.
+template <typename T, typename Tindices>
+class MultiHashEmbeddingLookupOp : public OpKernel {
+ public:
+  enum Operation { kAdd, kMul, kConcat };
+
+  explicit MultiHashEmbeddingLookupOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("num_buckets", &num_buckets_));
+    string operation;
+    OP_REQUIRES_OK(context, context->GetAttr("operation", &operation));
+    if (operation == "add") {
+      operation_ = kAdd;
+    } else if (operation == "mul") {
+      operation_ = kMul;
+    } else {
+      operation_ = kConcat;
+    }
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& params_q_tensor = context->input(0);
+    const Tensor& params_r_tensor = context->input(1);
+    const Tensor& ids_tensor = context->input(2);
+    OP_REQUIRES(context,
+                params_q_tensor.dims() == 2 && params_r_tensor.dims() == 2 &&
+                    params_q_tensor.dim_size(1) == params_r_tensor.dim_size(1),
+                errors::InvalidArgument(
+                    "params_q and params_r must be matrices of the same "
+                    "width, got ",
+                    params_q_tensor.shape().DebugString(), " and ",
+                    params_r_tensor.shape().DebugString()));
+
+    const int64 rows_q = params_q_tensor.dim_size(0);
+    const int64 rows_r = params_r_tensor.dim_size(0);
+    const int64 dim = params_q_tensor.dim_size(1);
+    const int64 out_dim = (operation_ == kConcat) ? 2 * dim : dim;
+    TensorShape output_shape = ids_tensor.shape();
+    output_shape.AddDim(out_dim);
+    Tensor* output_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, output_shape, &output_tensor));
+
+    const T* params_q = params_q_tensor.matrix<T>().data();
+    const T* params_r = params_r_tensor.matrix<T>().data();
+    const Tindices* ids = ids_tensor.flat<Tindices>().data();
+    T* output = output_tensor->flat<T>().data();
+    const int64 num_ids = ids_tensor.NumElements();
+    const int64 num_buckets = num_buckets_;
+    const Operation operation = operation_;
+
+    // The position of an id out of range, if any. Each shard stops at its
+    // first one.
+    mutex mu;
+    int64 bad_id = -1;
+    auto compute = [&](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        const int64 id = static_cast<int64>(ids[i]);
+        // Floor division and modulo, as FloorDiv and FloorMod.
+        int64 q = id / num_buckets;
+        int64 r = id % num_buckets;
+        if (r < 0) {
+          q -= 1;
+          r += num_buckets;
+        }
+        if (q < 0 || q >= rows_q || r >= rows_r) {
+          mutex_lock l(mu);
+          bad_id = i;
+          return;
+        }
+        const T* row_q = params_q + q * dim;
+        const T* row_r = params_r + r * dim;
+        T* out = output + i * out_dim;
+        switch (operation) {
+          case kAdd:
+            for (int64 d = 0; d < dim; ++d) {
+              out[d] = row_q[d] + row_r[d];
+            }
+            break;
+          case kMul:
+            for (int64 d = 0; d < dim; ++d) {
+              out[d] = row_q[d] * row_r[d];
+            }
+            break;
+          case kConcat:
+            std::copy_n(row_q, dim, out);
+            std::copy_n(row_r, dim, out + dim);
+            break;
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_ids,
+          3 * out_dim, compute);
+    OP_REQUIRES(context, bad_id < 0,
+                errors::InvalidArgument(
+                    "ids[", bad_id, "] = ", ids[std::max<int64>(bad_id, 0)],
+                    " is out of the range of params_q ", rows_q,
+                    " x params_r ", rows_r, " with ", num_buckets,
+                    " buckets"));
+  }
+
+ private:
+  int64 num_buckets_;
+  Operation operation_;
+};
+
+#define REGISTER_MULTI_HASH_LOOKUP(T, Tindices)                       \
+  REGISTER_KERNEL_BUILDER(Name("MultiHashEmbeddingLookup")            \
+                              .Device(DEVICE_CPU)                     \
+                              .TypeConstraint<T>("T")                 \
+                              .TypeConstraint<Tindices>("Tindices"),  \
+                          MultiHashEmbeddingLookupOp<T, Tindices>);
+#define REGISTER_MULTI_HASH_LOOKUP_ALL(T) \
+  REGISTER_MULTI_HASH_LOOKUP(T, int32)    \
+  REGISTER_MULTI_HASH_LOOKUP(T, int64)
+
+TF_CALL_float(REGISTER_MULTI_HASH_LOOKUP_ALL);
+TF_CALL_double(REGISTER_MULTI_HASH_LOOKUP_ALL);
+
+#undef REGISTER_MULTI_HASH_LOOKUP_ALL
+#undef REGISTER_MULTI_HASH_LOOKUP
+
+}  // namespace tensorflow
@@ -0,0 +1,70 @@
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class MultiHashEmbeddingLookupOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& operation) {
+    TF_EXPECT_OK(NodeDefBuilder("multi_hash_lookup", "MultiHashEmbeddingLookup")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT64))
+                     .Attr("num_buckets", 3)
+                     .Attr("operation", operation)
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+    // params_q [2, 2], params_r [3, 2]
+    AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});
+    AddInputFromArray<float>(TensorShape({3, 2}), {10, 20, 30, 40, 50, 60});
+  }
+};
+
+// ids 0, 4, 5 map to (q, r) = (0, 0), (1, 1), (1, 2).
+TEST_F(MultiHashEmbeddingLookupOpTest, Add) {
+  MakeOp("add");
+  AddInputFromArray<int64>(TensorShape({3}), {0, 4, 5});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(&expected, {11, 22, 33, 44, 53, 64});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(MultiHashEmbeddingLookupOpTest, Mul) {
+  MakeOp("mul");
+  AddInputFromArray<int64>(TensorShape({1, 2}), {0, 5});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({1, 2, 2}));
+  test::FillValues<float>(&expected, {10, 40, 150, 240});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(MultiHashEmbeddingLookupOpTest, Concat) {
+  MakeOp("concat");
+  AddInputFromArray<int64>(TensorShape({2}), {4, 0});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 4}));
+  test::FillValues<float>(&expected, {3, 4, 30, 40, 1, 2, 10, 20});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(MultiHashEmbeddingLookupOpTest, OutOfRange) {
+  MakeOp("add");
+  AddInputFromArray<int64>(TensorShape({2}), {1, 6});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+}  // namespace
+}  // namespace tensorflow
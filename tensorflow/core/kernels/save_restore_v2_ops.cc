@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/kernels/kv_delayed_apply_executor.h"
 #include "tensorflow/core/kernels/kv_variable_ops.h"
 #include "tensorflow/core/kernels/save_restore_tensor.h"
 #include "tensorflow/core/kernels/variable_ops.h"
@@ -132,6 +133,7 @@ class SaveV2 : public OpKernel {
                            &part_offset_tensor);
     TGlobalStep global_step_scalar = global_step.scalar<TGlobalStep>()();
     core::ScopedUnref s(variable);
+    KvDelayedApplyExecutor::Global()->Flush();
     embedding::ShrinkArgs shrink_args;
     shrink_args.global_step = global_step_scalar;
     OP_REQUIRES_OK(context, variable->Shrink(shrink_args));
@@ -310,6 +312,7 @@ class SaveV3 : public OpKernel {
                            &part_offset_tensor);
     TGlobalStep global_step_scalar = global_step.scalar<TGlobalStep>()();
     core::ScopedUnref s(variable);
+    KvDelayedApplyExecutor::Global()->Flush();
     embedding::ShrinkArgs shrink_args;
     shrink_args.global_step = global_step_scalar;
     OP_REQUIRES_OK(context, variable->Shrink(shrink_args));
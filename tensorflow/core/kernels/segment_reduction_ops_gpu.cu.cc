@@ -20,6 +20,8 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/gpu/gpu_event_mgr.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/bounds_check.h"
+#include "tensorflow/core/kernels/gpu_prim_helpers.h"
+#include "tensorflow/core/lib/core/bits.h"
 #include "tensorflow/core/util/gpu_kernel_helper.h"
 
 #if GOOGLE_CUDA
@@ -643,92 +645,171 @@ TF_CALL_complex128(REGISTER_SUM_GPU_UNSORTED_KERNELS_ALL);
 
 /*---------------------------- SparseSegment Begin ----------------------------*/
 
-template <typename T, typename Index>
-__global__ void SparseSegmentSumKernel(const int64 data_sparse_size,
-                                       const int64 output_total_size,
-                                       const int64 data_inner_dim,
-                                       const T* data,
-                                       const Index* indices,
-                                       const int32* seg_ids,
-                                       T* output) {
-
-  for (int input_index : GpuGridRangeX(data_sparse_size)) {
-    const Index sparse_row = input_index / data_inner_dim;
-    const Index sparse_offset = input_index % data_inner_dim;
-    const Index data_row = indices[sparse_row];
-    const Index data_idx = data_row * data_inner_dim + sparse_offset;
-    const Index output_row = seg_ids[sparse_row];
-    const Index output_idx = output_row * data_inner_dim + sparse_offset;
-    if (output_idx < 0 || output_idx >= output_total_size) {
-      continue;
-    }
-    functor::AtomicSumOpGpu()(output + output_idx, ldg(data + data_idx));
+// The number of threads reducing a row of inner_vecs vectors: the smallest
+// power of two covering the row, at most a warp, so that narrow rows of
+// embeddings do not leave most of a warp idle.
+inline int SparseSegmentGroupSize(const int64 inner_vecs) {
+  int group_size = 1;
+  while (group_size < inner_vecs && group_size < 32) {
+    group_size <<= 1;
   }
+  return group_size;
 }
-template <typename T, typename Index>
-__global__ void SparseSegmentGradKernel(const int64 data_sparse_size,
-                                        const int64 output_total_size,
-                                        const int64 data_inner_dim,
-                                        const T* data,
-                                        const int32* seg_ids,
-                                        const int32* seg_lens,
-                                        const Index* indices,
-                                        T* output, const bool is_sqrtn) {
-
-  for (int input_index : GpuGridRangeX(data_sparse_size)) {
-    const Index sparse_row = input_index / data_inner_dim;
-    const Index sparse_offset = input_index % data_inner_dim;
-    const Index data_row = seg_ids[sparse_row];
-    const Index data_idx = data_row * data_inner_dim + sparse_offset;
-    const Index output_row = indices[sparse_row];
-    const Index output_idx = output_row * data_inner_dim + sparse_offset;
-    if (output_idx < 0 || output_idx >= output_total_size) {
-      continue;
+
+// Reduces the rows data[indices[j]] of each segment s, the positions j in
+// [segment_offsets[s], segment_offsets[s + 1]) as segment ids are sorted, in
+// registers: a group of group_size threads reduces a segment, each thread
+// kVec columns of a row at a time. Each output element is written once, so
+// neither atomics nor an initialization of the output are needed.
+template <typename T, typename Index, int kVec>
+__global__ void SparseSegmentReduceKernel(
+    const int32 num_segments, const int64 inner_vecs, const int group_size,
+    const Index data_rows, const T* __restrict__ data,
+    const Index* __restrict__ indices,
+    const int32* __restrict__ segment_offsets, const bool is_mean,
+    const bool is_sqrtn, T* __restrict__ output) {
+  typedef AlignedVector<T, kVec> Vec;
+  const Vec* data_vecs = reinterpret_cast<const Vec*>(data);
+  Vec* output_vecs = reinterpret_cast<Vec*>(output);
+  const int64 thread =
+      blockIdx.x * static_cast<int64>(blockDim.x) + threadIdx.x;
+  const int lane = thread % group_size;
+  const int64 num_groups =
+      gridDim.x * static_cast<int64>(blockDim.x) / group_size;
+  for (int64 s = thread / group_size; s < num_segments; s += num_groups) {
+    const int32 begin = ldg(segment_offsets + s);
+    const int32 end = ldg(segment_offsets + s + 1);
+    const int32 count = end - begin;
+    for (int64 v = lane; v < inner_vecs; v += group_size) {
+      Vec sum(T(0));
+      for (int32 j = begin; j < end; ++j) {
+        const Index row = ldg(indices + j);
+        if (row < 0 || row >= data_rows) {
+          continue;
+        }
+        const Vec in = data_vecs[row * inner_vecs + v];
+#pragma unroll
+        for (int i = 0; i < kVec; ++i) {
+          sum[i] += in[i];
+        }
+      }
+      if ((is_mean || is_sqrtn) && count > 1) {
+        const T divisor = is_mean ? T(count) : std::sqrt(T(count));
+#pragma unroll
+        for (int i = 0; i < kVec; ++i) {
+          sum[i] /= divisor;
+        }
+      }
+      output_vecs[s * inner_vecs + v] = sum;
     }
-    const int32 seg_len = seg_lens[data_row];
-    T scale = seg_len > 1 ? T(1.0)/(is_sqrtn ? std::sqrt(T(seg_len)) : \
-        T(seg_len)) : T(1.0);
-    functor::AtomicSumOpGpu()(output + output_idx, ldg(data + data_idx) * scale);
   }
 }
 
-template <typename T, typename Index>
-__global__ void SparseSegmentLenSumKernel(const int64 num_ids,
-                                          const int64 output_row_size,
-                                          const Index* seg_ids,
-                                          T* seg_lens) {
-  for (int input_index : GpuGridRangeX(num_ids)) {
-    const Index output_idx = seg_ids[input_index];
-    if (output_idx < 0 || output_idx>=output_row_size) {
-      continue;
+// Scatters the gradient of the segments to the rows of the output without
+// atomics: the positions of the indices sorted by index, those of output row
+// r in [row_offsets[r], row_offsets[r + 1]) of sorted_positions, are reduced
+// by a group of threads as in SparseSegmentReduceKernel. segment_offsets
+// give the length of each segment, which scales its gradient.
+template <typename T, int kVec>
+__global__ void SparseSegmentGradKernel(
+    const int32 output_rows, const int64 inner_vecs, const int group_size,
+    const int32 num_segments, const T* __restrict__ grad,
+    const int32* __restrict__ segment_ids,
+    const int32* __restrict__ segment_offsets,
+    const int32* __restrict__ sorted_positions,
+    const int32* __restrict__ row_offsets, const bool is_sqrtn,
+    T* __restrict__ output) {
+  typedef AlignedVector<T, kVec> Vec;
+  const Vec* grad_vecs = reinterpret_cast<const Vec*>(grad);
+  Vec* output_vecs = reinterpret_cast<Vec*>(output);
+  const int64 thread =
+      blockIdx.x * static_cast<int64>(blockDim.x) + threadIdx.x;
+  const int lane = thread % group_size;
+  const int64 num_groups =
+      gridDim.x * static_cast<int64>(blockDim.x) / group_size;
+  for (int64 r = thread / group_size; r < output_rows; r += num_groups) {
+    const int32 begin = ldg(row_offsets + r);
+    const int32 end = ldg(row_offsets + r + 1);
+    for (int64 v = lane; v < inner_vecs; v += group_size) {
+      Vec sum(T(0));
+      for (int32 k = begin; k < end; ++k) {
+        const int32 s = ldg(segment_ids + ldg(sorted_positions + k));
+        if (s < 0 || s >= num_segments) {
+          continue;
+        }
+        const int32 count =
+            ldg(segment_offsets + s + 1) - ldg(segment_offsets + s);
+        const T scale = count > 1 ? T(1.0) / (is_sqrtn ? std::sqrt(T(count))
+                                                       : T(count))
+                                  : T(1.0);
+        const Vec in = grad_vecs[s * inner_vecs + v];
+#pragma unroll
+        for (int i = 0; i < kVec; ++i) {
+          sum[i] += in[i] * scale;
+        }
+      }
+      output_vecs[r * inner_vecs + v] = sum;
     }
-    functor::AtomicSumOpGpu()(seg_lens + output_idx, T(1));
   }
 }
 
-template <typename T, typename Index>
-__global__ void SparseSegmentMeanKernel(const int64 output_total_size,
-                                        const int64 data_inner_dim,
-                                        T* output,
-                                        const T* seg_lens) {
-  for (int input_index : GpuGridRangeX(output_total_size)) {
-    const Index output_row = input_index / data_inner_dim;
-    T count = ldg(seg_lens + output_row);
-    output[input_index] /= (count > 0 ? count : 1);
+// Replaces the invalid indices by output_rows, sorted after the valid ones
+// and ignored by the offsets of the rows.
+template <typename Index>
+__global__ void SparseSegmentSortKeysKernel(const int32 size,
+                                            const int32 output_rows,
+                                            const Index* indices,
+                                            int32* keys) {
+  GPU_1D_KERNEL_LOOP(i, size) {
+    const Index row = ldg(indices + i);
+    keys[i] = row < 0 || row >= output_rows ? output_rows : row;
   }
 }
 
 template <typename T, typename Index>
-__global__ void SparseSegmentSqrtNKernel(const int64 output_total_size,
-                                         const int64 data_inner_dim,
-                                         T* output,
-                                         const T* seg_lens) {
-  for (int input_index : GpuGridRangeX(output_total_size)) {
-    const Index output_row = input_index / data_inner_dim;
-    T count = ldg(seg_lens + output_row);
-    output[input_index] /= std::sqrt(count > 0 ? count : 1);
-  }
-}
+struct LaunchSparseSegmentReduce {
+  template <int kVec>
+  struct Vectorized {
+    Status operator()(const GPUDevice& d, const int32 num_segments,
+                      const int64 inner_dim, const Index data_rows,
+                      const T* data, const Index* indices,
+                      const int32* segment_offsets, const bool is_mean,
+                      const bool is_sqrtn, T* output) const {
+      const int64 inner_vecs = inner_dim / kVec;
+      const int group_size = SparseSegmentGroupSize(inner_vecs);
+      GpuLaunchConfig config =
+          GetGpuLaunchConfig(num_segments * group_size, d);
+      return GpuLaunchKernel(
+          SparseSegmentReduceKernel<T, Index, kVec>, config.block_count,
+          config.thread_per_block, 0, d.stream(), num_segments, inner_vecs,
+          group_size, data_rows, data, indices, segment_offsets, is_mean,
+          is_sqrtn, output);
+    }
+  };
+};
+
+template <typename T>
+struct LaunchSparseSegmentGrad {
+  template <int kVec>
+  struct Vectorized {
+    Status operator()(const GPUDevice& d, const int32 output_rows,
+                      const int64 inner_dim, const int32 num_segments,
+                      const T* grad, const int32* segment_ids,
+                      const int32* segment_offsets,
+                      const int32* sorted_positions, const int32* row_offsets,
+                      const bool is_sqrtn, T* output) const {
+      const int64 inner_vecs = inner_dim / kVec;
+      const int group_size = SparseSegmentGroupSize(inner_vecs);
+      GpuLaunchConfig config =
+          GetGpuLaunchConfig(output_rows * group_size, d);
+      return GpuLaunchKernel(
+          SparseSegmentGradKernel<T, kVec>, config.block_count,
+          config.thread_per_block, 0, d.stream(), output_rows, inner_vecs,
+          group_size, num_segments, grad, segment_ids, segment_offsets,
+          sorted_positions, row_offsets, is_sqrtn, output);
+    }
+  };
+};
 
 namespace functor {
 template <typename T, typename Index>
@@ -740,68 +821,35 @@ void SparseSegmentReduceFunctor<T, Index>::operator()(OpKernelContext* ctx,
                                                       const bool is_mean,
                                                       const bool is_sqrtn) {
   const int64 num_ids = indices->NumElements();
-  if (input->NumElements() == 0 || num_ids == 0) {
+  const int32 output_rows = output->dim_size(0);
+  if (output->NumElements() == 0) {
     return;
   }
 
-  Tensor seg_lens;
   const auto data_flat = input->flat_outer_dims<T>();
-  const auto indices_flat = indices->flat<Index>();
-  const auto segment_flat = seg_ids->flat<int32>();
-  auto output_flat = output->flat<T>();
-
-  const int64 data_inner_dim = data_flat.dimension(1);
-  const int64 data_sparse_size = num_ids * data_inner_dim;
-  const int64 output_total_size = output->NumElements();
-  const int64 output_row_size = output_total_size/data_inner_dim;
-
-  const GPUDevice d = ctx->eigen_device<GPUDevice>();
-
-  // initialize output by default value
-  GpuLaunchConfig config = GetGpuLaunchConfig(output_total_size, d);
-  SetToValue<<<config.block_count, config.thread_per_block,
-      0, d.stream()>>>(static_cast<int>(output_total_size),
-      output_flat.data(), T(0.0));
-
-  config = GetGpuLaunchConfig(data_sparse_size, d);
-  // launch a kernel
-  SparseSegmentSumKernel<T, Index>
-      <<<config.block_count, config.thread_per_block, 0, d.stream()>>>(
-          data_sparse_size, output_total_size, data_inner_dim, data_flat.data(),
-          indices_flat.data(), segment_flat.data(), output_flat.data());
-
-  if (is_mean | is_sqrtn) {
-    OP_REQUIRES_OK(ctx, ctx->allocate_temp(output->dtype(),
-                        TensorShape({output_row_size}),
-                   &seg_lens));
-    auto segment_lens_flat = seg_lens.flat<T>();
-    config = GetGpuLaunchConfig(output_row_size, d);
-    SetZero<T><<<config.block_count, config.thread_per_block,
-      0, d.stream()>>>(static_cast<int>(output_row_size),
-      segment_lens_flat.data());
-    // launch a kernel to sum the seg_lens for each segment
-    config = GetGpuLaunchConfig(num_ids, d);
-    SparseSegmentLenSumKernel<T, int32>
-      <<<config.block_count, config.thread_per_block, 0, d.stream()>>>(
-          num_ids, output_row_size, segment_flat.data(),
-          segment_lens_flat.data());
-  }
-  // for mean
-  if (is_mean) {
-    auto segment_lens_flat = seg_lens.flat<T>();
-    config = GetGpuLaunchConfig(output_total_size, d);
-    SparseSegmentMeanKernel<T, Index>
-      <<<config.block_count, config.thread_per_block, 0, d.stream()>>>
-      (output_total_size, data_inner_dim, output_flat.data(),
-       segment_lens_flat.data());
-  } else if (is_sqrtn) {
-    auto segment_lens_flat = seg_lens.flat<T>();
-    config = GetGpuLaunchConfig(output_total_size, d);
-    SparseSegmentSqrtNKernel<T, Index>
-      <<<config.block_count, config.thread_per_block, 0, d.stream()>>>
-      (output_total_size, data_inner_dim, output_flat.data(),
-       segment_lens_flat.data());
-  }
+  const int64 data_inner_dim = output->NumElements() / output_rows;
+  const GPUDevice& d = ctx->eigen_device<GPUDevice>();
+
+  // The segment ids are sorted, each segment is a range of the indices.
+  Tensor segment_offsets;
+  OP_REQUIRES_OK(ctx, ctx->allocate_temp(DT_INT32,
+                                         TensorShape({output_rows + 1}),
+                                         &segment_offsets));
+  int32* segment_offsets_ptr = segment_offsets.flat<int32>().data();
+  OP_REQUIRES_OK(ctx, LaunchSegmentOffsetsKernel(
+                          d, static_cast<int32>(num_ids), output_rows,
+                          seg_ids->flat<int32>().data(), segment_offsets_ptr));
+
+  const T* data = data_flat.data();
+  T* output_data = output->flat<T>().data();
+  OP_REQUIRES_OK(
+      ctx, DispatchToVectorized<
+               T, LaunchSparseSegmentReduce<T, Index>::template Vectorized>(
+               MinAlignmentOf(data, output_data, data_inner_dim), d,
+               output_rows, data_inner_dim,
+               static_cast<Index>(data_flat.dimension(0)), data,
+               indices->flat<Index>().data(), segment_offsets_ptr, is_mean,
+               is_sqrtn, output_data));
 }
 
 template <typename T, typename Index>
@@ -813,47 +861,55 @@ void SparseSegmentReduceGradFunctor<T, Index>::operator()(OpKernelContext* ctx,
                                                           const bool is_sqrtn) {
     typedef int32 SegmentId;
     const SegmentId num_segments = input->dim_size(0);
-    const int64 N = indices->NumElements();
-    auto output_flat = output->flat_outer_dims<T>();
-    const int64 seg_lens_size = num_segments;
-    // place this on gpu
-    Tensor seg_lens;
-    // prepare counting
-    OP_REQUIRES_OK(ctx, ctx->allocate_temp(DT_INT32,
-                        TensorShape({seg_lens_size}),
-                   &seg_lens));
-    auto segment_lens_flat = seg_lens.flat<int32>();
-    const int64 data_inner_dim = output_flat.dimension(1);
-    const int64 data_sparse_size = N * data_inner_dim;
-    const int64 output_total_size = output->NumElements();
-    const int64 output_row_size = output_total_size/data_inner_dim;
-    const GPUDevice d = ctx->eigen_device<GPUDevice>();
-    // initialize output by default value
-    GpuLaunchConfig config = GetGpuLaunchConfig(output_total_size, d);
-    SetToValue<<<config.block_count, config.thread_per_block,
-        0, d.stream()>>>(static_cast<int>(output_total_size),
-        output->flat<T>().data(), T(0.0));
-    // obtain seg_lens (counts)
-    config = GetGpuLaunchConfig(seg_lens_size, d);
-    SetZero<int32><<<config.block_count, config.thread_per_block,
-      0, d.stream()>>>(static_cast<int>(seg_lens_size),
-      segment_lens_flat.data());
-    // launch a kernel to sum the seg_lens for each segment
-    config = GetGpuLaunchConfig(N, d);
-    SparseSegmentLenSumKernel<int32, SegmentId>
-      <<<config.block_count, config.thread_per_block, 0, d.stream()>>>(
-          N, seg_lens_size, seg_ids->flat<SegmentId>().data(),
-          segment_lens_flat.data());
-    // launch a kernel to sum up values
-    config = GetGpuLaunchConfig(data_sparse_size, d);
-    SparseSegmentGradKernel<T, Index>
-        <<<config.block_count, config.thread_per_block, 0, d.stream()>>>(
-            data_sparse_size, output_total_size, data_inner_dim,
-            input->flat<T>().data(),
-            seg_ids->flat<SegmentId>().data(),
-            segment_lens_flat.data(),
-            indices->flat<Index>().data(),
-            output->flat<T>().data(), is_sqrtn);
+    const int32 N = indices->NumElements();
+    const int32 output_rows = output->dim_size(0);
+    const int64 data_inner_dim = output->NumElements() / output_rows;
+    const GPUDevice& d = ctx->eigen_device<GPUDevice>();
+    if (N == 0) {
+      GpuLaunchConfig config = GetGpuLaunchConfig(output->NumElements(), d);
+      SetToValue<<<config.block_count, config.thread_per_block,
+          0, d.stream()>>>(static_cast<int>(output->NumElements()),
+          output->flat<T>().data(), T(0.0));
+      return;
+    }
+
+    // The offsets of the segments, then those of the output rows in the
+    // indices sorted with their positions.
+    Tensor temp;
+    OP_REQUIRES_OK(ctx, ctx->allocate_temp(
+        DT_INT32, TensorShape({num_segments + output_rows + 2 + 3 * N}),
+        &temp));
+    int32* segment_offsets = temp.flat<int32>().data();
+    int32* row_offsets = segment_offsets + num_segments + 1;
+    int32* keys = row_offsets + output_rows + 1;
+    int32* sorted_keys = keys + N;
+    int32* sorted_positions = sorted_keys + N;
+    const SegmentId* segment_ids = seg_ids->flat<SegmentId>().data();
+    OP_REQUIRES_OK(ctx, LaunchSegmentOffsetsKernel(d, N, num_segments,
+                                                   segment_ids,
+                                                   segment_offsets));
+
+    GpuLaunchConfig config = GetGpuLaunchConfig(N, d);
+    OP_REQUIRES_OK(ctx, GpuLaunchKernel(
+        SparseSegmentSortKeysKernel<Index>, config.block_count,
+        config.thread_per_block, 0, d.stream(), N, output_rows,
+        indices->flat<Index>().data(), keys));
+    OP_REQUIRES_OK(ctx, GpuRadixSort(ctx, N, keys, sorted_keys,
+                                     static_cast<const int32*>(nullptr),
+                                     sorted_positions,
+                                     Log2Ceiling(output_rows + 1)));
+    OP_REQUIRES_OK(ctx, LaunchSegmentOffsetsKernel(d, N, output_rows,
+                                                   sorted_keys, row_offsets));
+
+    const T* grad = input->flat<T>().data();
+    T* output_data = output->flat<T>().data();
+    OP_REQUIRES_OK(
+        ctx, DispatchToVectorized<T, LaunchSparseSegmentGrad<T>::template
+                                         Vectorized>(
+                 MinAlignmentOf(grad, output_data, data_inner_dim), d,
+                 output_rows, data_inner_dim, num_segments, grad, segment_ids,
+                 segment_offsets, sorted_positions, row_offsets, is_sqrtn,
+                 output_data));
 }
 
 // for sparse gpu functors
@@ -898,6 +954,7 @@ void SetValueDefault<T>::operator()(OpKernelContext* ctx,
       target->flat<T>().data(), default_val);
 }
 
+// The segment ids are sorted, only the last one is copied.
 template <typename Index>
 void FindMaxSegId<Index>::operator()(OpKernelContext* ctx,
                                      const Tensor* seg_ids,
@@ -905,22 +962,18 @@ void FindMaxSegId<Index>::operator()(OpKernelContext* ctx,
   AllocatorAttributes attr;
   attr.set_on_host(true);
   attr.set_gpu_compatible(true);
-  Tensor seg_ids_cpu;
-  ctx->allocate_temp(seg_ids->dtype(), TensorShape{seg_ids->NumElements()},
-                         &seg_ids_cpu, attr);
+  Tensor seg_id_cpu;
+  ctx->allocate_temp(seg_ids->dtype(), TensorShape{1}, &seg_id_cpu, attr);
   if (!ctx->status().ok()) {
     return;
   }
-  auto dst_vec = seg_ids_cpu.flat<Index>();
   auto src_vec = seg_ids->flat<Index>();
 
   // copy data
-  ctx->eigen_gpu_device().memcpy(dst_vec.data(),
-       src_vec.data(), seg_ids->NumElements()*sizeof(Index));
+  ctx->eigen_gpu_device().memcpy(seg_id_cpu.flat<Index>().data(),
+       src_vec.data() + seg_ids->NumElements() - 1, sizeof(Index));
   ctx->eigen_gpu_device().synchronize();
-  // find the max
-  max_id = *std::max_element(dst_vec.data(),
-                             dst_vec.data() + seg_ids->NumElements());
+  max_id = seg_id_cpu.flat<Index>()(0);
 }
 
 } // end of namespace functor
@@ -1149,7 +1202,7 @@ class SparseSegmentGradGpuOpBase : public OpKernel {
     TensorShape output_shape = input.shape();
     output_shape.set_dim(0, M);
     OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
-    if (M == 0 || N == 0) return;
+    if (M == 0 || output->NumElements() == 0) return;
     // invoke gpu functors
     functor::SparseSegmentReduceGradFunctor<T, Index> reduction_grad_functor_;
     reduction_grad_functor_(context, &input, &indices,
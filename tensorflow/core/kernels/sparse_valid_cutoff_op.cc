@@ -25,9 +25,12 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/string_to_hash_bucket_ali_op.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/util/sorter.h"
 #include "tensorflow/core/util/sparse/dim_comparator.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -89,14 +92,14 @@ class SparseValidCutoffOp : public OpKernel {
     }
     // set output value and indices
     Tensor* indices_out_t;
-    Tensor* values_out_t;
     Tensor* dense_shape_out_t;
-    context->allocate_output(0, {count, dense_shape.size()}, &indices_out_t);
-    context->allocate_output(1, {count}, &values_out_t);
-    context->allocate_output(2, {dense_shape.size()}, &dense_shape_out_t);
+    OP_REQUIRES_OK(context, context->allocate_output(
+        0, {count, dense_shape.size()}, &indices_out_t));
+    OP_REQUIRES_OK(context, context->allocate_output(
+        2, {dense_shape.size()}, &dense_shape_out_t));
     auto indices_out = indices_out_t->matrix<int64>();
-    auto values_out = values_out_t->vec<T>();
     auto dense_shape_out = dense_shape_out_t->vec<int64>();
+    std::vector<int64> kept(count);
     count = 0;
     for (int i = 0; i < values.size(); ++i) {
       int current_column_id = GetColumnId(indices, dense_shape, i, cutoff_axis);
@@ -106,15 +109,30 @@ class SparseValidCutoffOp : public OpKernel {
         for (int j = 0; j < dense_shape.size(); ++j) {
           indices_out(count, j) = (j == cutoff_axis) ? cutoff_idx : indices(i, j);
         }
-        values_out(count) = values(i);
+        kept[count] = i;
         ++count;
       }
     }
+    OutputValues(context, *values_t, kept);
     for (int i = 0; i < dense_shape.size(); ++i) {
       dense_shape_out(i) = (i == cutoff_axis) ? length_ : dense_shape(i);
     }
   }
 
+ protected:
+  // Writes values of the kept positions to output_values.
+  virtual void OutputValues(OpKernelContext* context, const Tensor& values_t,
+                            const std::vector<int64>& kept) {
+    Tensor* values_out_t;
+    OP_REQUIRES_OK(context, context->allocate_output(
+        1, {static_cast<int64>(kept.size())}, &values_out_t));
+    auto values = values_t.vec<T>();
+    auto values_out = values_out_t->vec<T>();
+    for (size_t k = 0; k < kept.size(); ++k) {
+      values_out(k) = values(kept[k]);
+    }
+  }
+
  private:
   int axis_;
   int length_;
@@ -159,4 +177,47 @@ class SparseValidCutoffOp : public OpKernel {
 
 TF_CALL_ALL_TYPES(REGISTER_KERNELS);
 #undef REGISTER_KERNELS
+
+// Same as SparseValidCutoff(indices, StringToHashBucketFast(values),
+// dense_shape), only the values kept by the cutoff are hashed and the hashed
+// values of the input are never materialized.
+class SparseValidCutoffToHashBucketFastOp : public SparseValidCutoffOp<string> {
+ public:
+  explicit SparseValidCutoffToHashBucketFastOp(OpKernelConstruction* context)
+      : SparseValidCutoffOp<string>(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("num_buckets", &num_buckets_));
+  }
+
+ protected:
+  void OutputValues(OpKernelContext* context, const Tensor& values_t,
+                    const std::vector<int64>& kept) override {
+    Tensor* values_out_t;
+    OP_REQUIRES_OK(context, context->allocate_output(
+        1, {static_cast<int64>(kept.size())}, &values_out_t));
+    auto values = values_t.vec<string>();
+    auto values_out = values_out_t->vec<int64>();
+    auto RunTask = [this, &values, &values_out, &kept](int64 start,
+                                                       int64 end) {
+      auto batcher = MakeStringHashBatcher<Fingerprint64>(
+          [this, &values_out](int64 k, uint64 input_hash) {
+            values_out(k) = static_cast<int64>(input_hash % num_buckets_);
+          });
+      for (int64 k = start; k < end; ++k) {
+        batcher.Add(k, values(kept[k]));
+      }
+      batcher.Flush();
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    const int64 element_cost = 100;  // Estimated for 32 byte strings.
+    Shard(worker_threads->num_threads - 1, worker_threads->workers,
+          kept.size(), element_cost, RunTask);
+  }
+
+ private:
+  int64 num_buckets_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("SparseValidCutoffToHashBucketFast").Device(DEVICE_CPU),
+    SparseValidCutoffToHashBucketFastOp);
 }  // namespace tensorflow
@@ -19,8 +19,10 @@ limitations under the License.
 #include <numeric>
 #include <vector>
 
+#include "tensorflow/core/common_runtime/step_stats_collector.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/stall_stats.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/lib/strings/strcat.h"
@@ -34,11 +36,15 @@ class Buffer : public ResourceBase {
  public:
   using Tuple = std::vector<Tensor>;
 
-  explicit Buffer(std::size_t capacity, std::size_t memory_limit)
-      : capacity_(capacity), memory_limit_(memory_limit), current_bytes_(0) {}
+  Buffer(std::size_t capacity, std::size_t memory_limit, const string& name)
+      : capacity_(capacity),
+        memory_limit_(memory_limit),
+        current_bytes_(0),
+        stall_counters_(
+            StallStats::Global()->Get(strings::StrCat("Stage/", name))) {}
 
   // the Buffer takes ownership of the Tuple
-  Status Put(Tuple* tuple) {
+  Status Put(Tuple* tuple, StallTime* stall) {
     std::unique_lock<std::mutex> lock(mu_);
 
     std::size_t tuple_bytes = GetTupleBytes(*tuple);
@@ -56,7 +62,7 @@ class Buffer : public ResourceBase {
 
     // If buffer capacity is bounded wait until elements have been removed
     if (IsBounded()) {
-      full_cond_var_.wait(lock, [tuple_bytes, this]() {
+      auto has_space = [tuple_bytes, this]() {
         // If there's a memory limit, check if there's space for insertion
         bool memory_limit_valid =
             memory_limit_ > 0 ? !WouldExceedMemoryLimit(tuple_bytes) : true;
@@ -65,7 +71,13 @@ class Buffer : public ResourceBase {
 
         // Stop waiting upon success for both conditions
         return capacity_valid && memory_limit_valid;
-      });
+      };
+      if (!has_space()) {
+        stall->start_nanos = Env::Default()->NowNanos();
+        full_cond_var_.wait(lock, has_space);
+        stall->wait_nanos = Env::Default()->NowNanos() - stall->start_nanos;
+        stall_counters_->RecordProducerWait(stall->wait_nanos);
+      }
     }
 
     // Update bytes in the Staging Area
@@ -86,11 +98,17 @@ class Buffer : public ResourceBase {
   }
 
   // Get tuple at front of the buffer
-  void Get(Tuple* tuple) {  // TODO(zhifengc): Support cancellation.
+  void Get(Tuple* tuple,
+           StallTime* stall) {  // TODO(zhifengc): Support cancellation.
     std::unique_lock<std::mutex> lock(mu_);
 
     // Wait for data if the buffer is empty
-    non_empty_cond_var_.wait(lock, [this]() { return !buf_.empty(); });
+    if (buf_.empty()) {
+      stall->start_nanos = Env::Default()->NowNanos();
+      non_empty_cond_var_.wait(lock, [this]() { return !buf_.empty(); });
+      stall->wait_nanos = Env::Default()->NowNanos() - stall->start_nanos;
+      stall_counters_->RecordConsumerWait(stall->wait_nanos);
+    }
 
     // Move data into the output tuple
     *tuple = std::move(buf_.front());
@@ -174,6 +192,7 @@ class Buffer : public ResourceBase {
   std::condition_variable non_empty_cond_var_;
   std::condition_variable full_cond_var_;
   std::deque<Tuple> buf_;
+  StallCounters* stall_counters_;
 };
 
 Status GetBuffer(OpKernelContext* ctx, const NodeDef& ndef, Buffer** buf) {
@@ -181,12 +200,12 @@ Status GetBuffer(OpKernelContext* ctx, const NodeDef& ndef, Buffer** buf) {
   ContainerInfo cinfo;
 
   // Lambda for creating the Staging Area
-  auto create_fn = [&ndef](Buffer** ret) -> Status {
+  auto create_fn = [&ndef, &cinfo](Buffer** ret) -> Status {
     int64 capacity;
     int64 memory_limit;
     TF_RETURN_IF_ERROR(GetNodeAttr(ndef, "capacity", &capacity));
     TF_RETURN_IF_ERROR(GetNodeAttr(ndef, "memory_limit", &memory_limit));
-    *ret = new Buffer(capacity, memory_limit);
+    *ret = new Buffer(capacity, memory_limit, cinfo.name());
     return Status::OK();
   };
 
@@ -211,7 +230,11 @@ class StageOp : public OpKernel {
     for (int i = 0; i < ctx->num_inputs(); ++i) {
       tuple.push_back(ctx->input(i));
     }
-    OP_REQUIRES_OK(ctx, buf->Put(&tuple));
+    StallTime stall;
+    Status s = buf->Put(&tuple, &stall);
+    RecordWaitInStepStats(ctx, "producer_wait", stall.start_nanos,
+                          stall.wait_nanos);
+    OP_REQUIRES_OK(ctx, s);
   }
 };
 
@@ -236,7 +259,10 @@ class UnstageOp : public OpKernel {
     core::ScopedUnref scope(buf);
     Buffer::Tuple tuple;
 
-    buf->Get(&tuple);
+    StallTime stall;
+    buf->Get(&tuple, &stall);
+    RecordWaitInStepStats(ctx, "consumer_wait", stall.start_nanos,
+                          stall.wait_nanos);
 
     OP_REQUIRES(
         ctx, tuple.size() == (size_t)ctx->num_outputs(),
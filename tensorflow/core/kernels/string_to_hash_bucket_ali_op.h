@@ -29,6 +29,71 @@ limitations under the License.
 
 namespace tensorflow {
 
+// Hashes strings eight at a time with Hash64Farm_Batch512. Strings are queued
+// by their FarmHashBatchClass, a queue is hashed as one batch once it holds
+// eight strings, so batched strings need not have the same length. The batch
+// gives the same hashes as Fingerprint64, strings longer than 64 bytes and
+// the strings still queued at Flush are hashed by hash one by one.
+// output(index, hash) is called once for every Add(index, str).
+template <uint64 hash(StringPiece), typename Output>
+class StringHashBatcher {
+ public:
+  explicit StringHashBatcher(const Output& output) : output_(output) {}
+
+  // str must stay alive until it is hashed, i.e. until Flush returns.
+  inline void Add(int64 index, StringPiece str) {
+#if defined(__AVX512F__)
+    const int batch_class = FarmHashBatchClass(str.size());
+    if (batch_class >= 0) {
+      Batch& batch = batches_[batch_class];
+      batch.data[batch.size] = str.data();
+      batch.lens[batch.size] = str.size();
+      batch.indices[batch.size] = index;
+      if (++batch.size == kBatchSize) {
+        uint64_t batch_hash[kBatchSize];
+        Hash64Farm_Batch512(batch.data, batch_hash, batch.lens);
+        for (int j = 0; j < kBatchSize; ++j) {
+          output_(batch.indices[j], batch_hash[j]);
+        }
+        batch.size = 0;
+      }
+      return;
+    }
+#endif
+    output_(index, hash(str));
+  }
+
+  void Flush() {
+#if defined(__AVX512F__)
+    for (Batch& batch : batches_) {
+      for (int j = 0; j < batch.size; ++j) {
+        output_(batch.indices[j],
+                hash(StringPiece(batch.data[j], batch.lens[j])));
+      }
+      batch.size = 0;
+    }
+#endif
+  }
+
+ private:
+#if defined(__AVX512F__)
+  static const int kBatchSize = 8;
+  struct Batch {
+    const char* data[kBatchSize];
+    size_t lens[kBatchSize];
+    int64 indices[kBatchSize];
+    int size = 0;
+  };
+  Batch batches_[kFarmHashBatchClasses];
+#endif
+  Output output_;
+};
+
+template <uint64 hash(StringPiece), typename Output>
+StringHashBatcher<hash, Output> MakeStringHashBatcher(const Output& output) {
+  return StringHashBatcher<hash, Output>(output);
+}
+
 template <uint64 hash(StringPiece)>
 class StringToHashBucketAliOp : public OpKernel {
  public:
@@ -94,53 +159,17 @@ class StringToHashBucketBatchAliOp : public OpKernel {
     auto output_flat = output_tensor->flat<int64>();
 
     auto RunTask = [this, &input_flat, &output_flat](int64 start, int64 end) {
-      typedef decltype(input_flat.size()) Index;
-      Index batch_end = end - (end - start)%8;
-      Index i = start;
-#if defined(__AVX512F__)
-      const char* batch_ptr[8]; 
-      uint64_t input_hash[8];
-      bool enable_batch_hash = true;
-      if (batch_end - start >= 8) {
-        for(; i < batch_end; i+=8) {
-          // first unrolling by 8 (for Hash64V3_Batch512)
-          // double check whether all the 8 strings within 
-          // a batch having the same string length.
-          enable_batch_hash = true;
-          Index size_0 = input_flat(i).size();
-          batch_ptr[0] = input_flat(i).data();
-          for(int j=1; j<8; j++) {
-            if (input_flat(i+j).size() == size_0) {
-              batch_ptr[j] = input_flat(i+j).data();
-            } else {
-              enable_batch_hash = false;
-              break;
-            }
-          }
-          if (enable_batch_hash) {
-            Hash64Farm_Batch512(batch_ptr, &input_hash[0], size_0);
-          } else {
-            // roll back to normal Hash64 function
-            for(int j=0; j<8; j++) {
-                input_hash[j] = (uint64_t)hash(input_flat(i+j)); 
-            }
-          }
-          // feed ids to output tensor
-          for(int j=0; j<8; j++) {
-            output_flat(i+j) = static_cast<int64>(input_hash[j]%num_buckets_);
-          }
-        }
-      } 
-#endif
-      // for remained iterations
-      for(; i < end; ++i) {
-        const uint64 input_hash = hash(input_flat(i));
-        const uint64 bucket_id = input_hash % num_buckets_;
-        // The number of buckets is always in the positive range of int64 so is
-        // the resulting bucket_id. Casting the bucket_id from uint64 to int64
-        // is safe.
-        output_flat(i) = static_cast<int64>(bucket_id);
+      // The number of buckets is always in the positive range of int64 so is
+      // the resulting bucket_id. Casting the bucket_id from uint64 to int64
+      // is safe.
+      auto batcher = MakeStringHashBatcher<hash>(
+          [this, &output_flat](int64 i, uint64 input_hash) {
+            output_flat(i) = static_cast<int64>(input_hash % num_buckets_);
+          });
+      for (int64 i = start; i < end; ++i) {
+        batcher.Add(i, input_flat(i));
       }
+      batcher.Flush();
     };
 
     auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
@@ -230,53 +259,15 @@ class StringToHash64Op : public OpKernel {
                                             &output_tensor));
     auto output_flat = output_tensor->flat<int64>();
 
-    auto RunTask = [this, &input_flat, &output_flat](int64 start, int64 end) {
-      typedef decltype(input_flat.size()) Index;
-      auto batch_end = end - (end - start)%8;
-      auto i = start;
-#if defined(__AVX512F__)
-      const char* batch_ptr[8];
-      uint64_t input_hash[8];
-      bool enable_batch_hash = true;
-      if (batch_end - start >= 8) {
-        for(; i < batch_end; i+=8) {
-          // first unrolling by 8 (for Hash64V3_Batch512)
-          // double check whether all the 8 strings within
-          // a batch having the same string length.
-          enable_batch_hash = true;
-          Index size_0 = input_flat(i).size();
-          batch_ptr[0] = input_flat(i).data();
-          for(int j=1; j<8; j++) {
-            if (input_flat(i+j).size() == size_0) {
-              batch_ptr[j] = input_flat(i+j).data();
-            } else {
-              enable_batch_hash = false;
-              break;
-            }
-          }
-          if (enable_batch_hash) {
-            Hash64Farm_Batch512(batch_ptr, &input_hash[0], size_0);
-          } else {
-            // roll back to normal Hash64 function
-            for(int j=0; j<8; j++) {
-                input_hash[j] = (uint64_t)hash(input_flat(i+j));
-            }
-          }
-          // feed ids to output tensor
-          for(int j=0; j<8; j++) {
-            output_flat(i+j) = input_hash[j] & kint64max;
-          }
-        }
-      }
-#endif
-      // for remained iterations
-      for(; i < end; ++i) {
-        const uint64 input_hash = hash(input_flat(i));
-        // The number of buckets is always in the positive range of int64 so is
-        // the resulting bucket_id. Casting the bucket_id from uint64 to int64
-        // is safe.
-        output_flat(i) = input_hash & kint64max;
+    auto RunTask = [&input_flat, &output_flat](int64 start, int64 end) {
+      auto batcher = MakeStringHashBatcher<hash>(
+          [&output_flat](int64 i, uint64 input_hash) {
+            output_flat(i) = input_hash & kint64max;
+          });
+      for (int64 i = start; i < end; ++i) {
+        batcher.Add(i, input_flat(i));
       }
+      batcher.Flush();
     };
 
     auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
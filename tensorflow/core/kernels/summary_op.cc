@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/stall_stats.h"
 #include "tensorflow/core/framework/summary.pb.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/histogram/histogram.h"
@@ -168,6 +169,39 @@ class SummaryMergeOp : public OpKernel {
   }
 };
 
+// Summarizes the time the producers and the consumers of each input pipeline
+// stage of the process have waited so far, in seconds.
+class InputStallSummaryOp : public OpKernel {
+ public:
+  explicit InputStallSummaryOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* c) override {
+    const Tensor& tag = c->input(0);
+    OP_REQUIRES(c, IsLegacyScalar(tag.shape()),
+                errors::InvalidArgument("tag must be scalar"));
+    const string prefix(tag.scalar<tstring>()());
+    Summary s;
+    for (const auto& stage : StallStats::Global()->Snapshot()) {
+      Summary::Value* v = s.add_value();
+      v->set_tag(
+          strings::StrCat(prefix, "/", stage.first, "/producer_wait_seconds"));
+      v->set_simple_value(stage.second.producer_wait_nanos / 1e9);
+      v = s.add_value();
+      v->set_tag(
+          strings::StrCat(prefix, "/", stage.first, "/consumer_wait_seconds"));
+      v->set_simple_value(stage.second.consumer_wait_nanos / 1e9);
+    }
+
+    Tensor* summary_tensor = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(0, TensorShape({}), &summary_tensor));
+    CHECK(SerializeToTString(s, &summary_tensor->scalar<tstring>()()));
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("InputStallSummary").Device(DEVICE_CPU),
+                        InputStallSummaryOp);
+
 REGISTER_KERNEL_BUILDER(Name("MergeSummary").Device(DEVICE_CPU),
                         SummaryMergeOp);
 
@@ -0,0 +1,223 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+Status ValidateInputs(const Tensor& scores, const Tensor& values,
+                      const Tensor& mask) {
+  if (scores.dims() != 3 || values.dims() != 3 || mask.dims() != 2) {
+    return errors::InvalidArgument(
+        "scores and values must be 3-D and mask 2-D, got ",
+        scores.shape().DebugString(), ", ", values.shape().DebugString(),
+        " and ", mask.shape().DebugString());
+  }
+  const int64 batch = scores.dim_size(0);
+  const int64 length = scores.dim_size(2);
+  if (values.dim_size(0) != batch || values.dim_size(1) != length ||
+      mask.dim_size(1) != length) {
+    return errors::InvalidArgument(
+        "Mismatched shapes of scores ", scores.shape().DebugString(),
+        ", values ", values.shape().DebugString(), " and mask ",
+        mask.shape().DebugString());
+  }
+  if (mask.dim_size(0) == 0 || batch % mask.dim_size(0) != 0) {
+    return errors::InvalidArgument("Batch of mask ", mask.dim_size(0),
+                                   " must divide batch of scores ", batch);
+  }
+  return Status::OK();
+}
+
+// Softmax of one row of masked scores into 'probs'. Masked positions take
+// the value 'padding', exactly as the unfused graph does.
+template <typename T>
+void MaskedSoftmax(const T* scores, const bool* mask, int64 length,
+                   float padding, T* probs) {
+  T max_score = std::numeric_limits<T>::lowest();
+  for (int64 l = 0; l < length; ++l) {
+    probs[l] = mask[l] ? scores[l] : static_cast<T>(padding);
+    max_score = std::max(max_score, probs[l]);
+  }
+  T sum = 0;
+  for (int64 l = 0; l < length; ++l) {
+    probs[l] = std::exp(probs[l] - max_score);
+    sum += probs[l];
+  }
+  const T inv_sum = static_cast<T>(1) / sum;
+  for (int64 l = 0; l < length; ++l) {
+    probs[l] *= inv_sum;
+  }
+}
+
+}  // namespace
+
+template <typename T>
+class TargetAttentionOp : public OpKernel {
+ public:
+  explicit TargetAttentionOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("padding", &padding_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& scores_tensor = context->input(0);
+    const Tensor& values_tensor = context->input(1);
+    const Tensor& mask_tensor = context->input(2);
+    OP_REQUIRES_OK(context,
+                   ValidateInputs(scores_tensor, values_tensor, mask_tensor));
+
+    const int64 batch = scores_tensor.dim_size(0);
+    const int64 queries = scores_tensor.dim_size(1);
+    const int64 length = scores_tensor.dim_size(2);
+    const int64 dim = values_tensor.dim_size(2);
+    const int64 mask_batch = mask_tensor.dim_size(0);
+
+    Tensor* output_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+        0, TensorShape({batch, queries, dim}), &output_tensor));
+
+    const T* scores = scores_tensor.flat<T>().data();
+    const T* values = values_tensor.flat<T>().data();
+    const bool* mask = mask_tensor.flat<bool>().data();
+    T* output = output_tensor->flat<T>().data();
+    const float padding = padding_;
+
+    // One unit is one query row: a softmax over the sequence and the
+    // weighted sum of its values. Positions whose probability underflows to
+    // zero, the padded tail of short sequences, skip the value row.
+    auto compute = [&](int64 begin, int64 end) {
+      std::vector<T> probs(length);
+      for (int64 row = begin; row < end; ++row) {
+        const int64 n = row / queries;
+        MaskedSoftmax(scores + row * length,
+                      mask + (n % mask_batch) * length, length, padding,
+                      probs.data());
+        T* out = output + row * dim;
+        std::fill(out, out + dim, static_cast<T>(0));
+        const T* v = values + n * length * dim;
+        for (int64 l = 0; l < length; ++l) {
+          const T p = probs[l];
+          if (p == static_cast<T>(0)) continue;
+          const T* v_row = v + l * dim;
+          for (int64 d = 0; d < dim; ++d) {
+            out[d] += p * v_row[d];
+          }
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          batch * queries, length * (dim + 4), compute);
+  }
+
+ private:
+  float padding_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("TargetAttention")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<float>("T"),
+                        TargetAttentionOp<float>);
+
+template <typename T>
+class TargetAttentionGradOp : public OpKernel {
+ public:
+  explicit TargetAttentionGradOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("padding", &padding_));
+  }
+
+  // With P = softmax(where(mask, S, padding)) and Y = P V:
+  //   dV = P^T dY
+  //   dP = dY V^T
+  //   dS = mask ? P * (dP - sum(P * dP)) : 0
+  void Compute(OpKernelContext* context) override {
+    const Tensor& grad_tensor = context->input(0);
+    const Tensor& scores_tensor = context->input(1);
+    const Tensor& values_tensor = context->input(2);
+    const Tensor& mask_tensor = context->input(3);
+    OP_REQUIRES_OK(context,
+                   ValidateInputs(scores_tensor, values_tensor, mask_tensor));
+
+    const int64 batch = scores_tensor.dim_size(0);
+    const int64 queries = scores_tensor.dim_size(1);
+    const int64 length = scores_tensor.dim_size(2);
+    const int64 dim = values_tensor.dim_size(2);
+    const int64 mask_batch = mask_tensor.dim_size(0);
+    OP_REQUIRES(context,
+                grad_tensor.shape() == TensorShape({batch, queries, dim}),
+                errors::InvalidArgument("Mismatched shape of output_grad ",
+                                        grad_tensor.shape().DebugString()));
+
+    Tensor* scores_grad_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+        0, scores_tensor.shape(), &scores_grad_tensor));
+    Tensor* values_grad_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+        1, values_tensor.shape(), &values_grad_tensor));
+
+    const T* grad = grad_tensor.flat<T>().data();
+    const T* scores = scores_tensor.flat<T>().data();
+    const T* values = values_tensor.flat<T>().data();
+    const bool* mask = mask_tensor.flat<bool>().data();
+    T* scores_grad = scores_grad_tensor->flat<T>().data();
+    T* values_grad = values_grad_tensor->flat<T>().data();
+    const float padding = padding_;
+
+    // One unit is one batch row, which owns its slice of values_grad.
+    auto compute = [&](int64 begin, int64 end) {
+      std::vector<T> probs(length);
+      for (int64 n = begin; n < end; ++n) {
+        const bool* m = mask + (n % mask_batch) * length;
+        const T* v = values + n * length * dim;
+        T* dv = values_grad + n * length * dim;
+        std::fill(dv, dv + length * dim, static_cast<T>(0));
+        for (int64 q = 0; q < queries; ++q) {
+          const int64 row = n * queries + q;
+          MaskedSoftmax(scores + row * length, m, length, padding,
+                        probs.data());
+          const T* dy = grad + row * dim;
+          T* ds = scores_grad + row * length;
+          T dot = 0;
+          for (int64 l = 0; l < length; ++l) {
+            const T p = probs[l];
+            const T* v_row = v + l * dim;
+            T* dv_row = dv + l * dim;
+            T dp = 0;
+            for (int64 d = 0; d < dim; ++d) {
+              dp += dy[d] * v_row[d];
+              dv_row[d] += p * dy[d];
+            }
+            ds[l] = dp;
+            dot += p * dp;
+          }
+          for (int64 l = 0; l < length; ++l) {
+            ds[l] = m[l] ? probs[l] * (ds[l] - dot) : static_cast<T>(0);
+          }
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, batch,
+          queries * length * (2 * dim + 4), compute);
+  }
+
+ private:
+  float padding_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("TargetAttentionGrad")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<float>("T"),
+                        TargetAttentionGradOp<float>);
+
+}  // namespace tensorflow
@@ -0,0 +1,87 @@
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class TargetAttentionOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op, float padding) {
+    NodeDefBuilder builder("target_attention", op);
+    if (op == "TargetAttentionGrad") {
+      builder.Input(FakeInput(DT_FLOAT));
+    }
+    TF_EXPECT_OK(builder.Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_BOOL))
+                     .Attr("padding", padding)
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+};
+
+// scores [2, 1, 3], values [2, 3, 2], the second sequence has length 2.
+TEST_F(TargetAttentionOpTest, MaskedSoftmaxMatMul) {
+  MakeOp("TargetAttention", -1e9);
+  AddInputFromArray<float>(TensorShape({2, 1, 3}), {0, 0, 0, 1, 1, 5});
+  AddInputFromArray<float>(TensorShape({2, 3, 2}),
+                           {1, 2, 3, 4, 5, 6, 1, 2, 3, 4, 5, 6});
+  AddInputFromArray<bool>(TensorShape({2, 3}),
+                          {true, true, true, true, true, false});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 1, 2}));
+  test::FillValues<float>(&expected, {3, 4, 2, 3});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+// Two heads stacked on the batch share the mask of one sequence.
+TEST_F(TargetAttentionOpTest, MaskBroadcastOverHeads) {
+  MakeOp("TargetAttention", -1e9);
+  AddInputFromArray<float>(TensorShape({2, 1, 2}), {0, 7, 0, -7});
+  AddInputFromArray<float>(TensorShape({2, 2, 1}), {1, 2, 3, 4});
+  AddInputFromArray<bool>(TensorShape({1, 2}), {true, false});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 1, 1}));
+  test::FillValues<float>(&expected, {1, 3});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(TargetAttentionOpTest, Grad) {
+  MakeOp("TargetAttentionGrad", -1e9);
+  // One query over a sequence of 2 with equal scores, P = [0.5, 0.5].
+  AddInputFromArray<float>(TensorShape({1, 1, 1}), {1});
+  AddInputFromArray<float>(TensorShape({1, 1, 2}), {0, 0});
+  AddInputFromArray<float>(TensorShape({1, 2, 1}), {1, 3});
+  AddInputFromArray<bool>(TensorShape({1, 2}), {true, true});
+  TF_ASSERT_OK(RunOpKernel());
+
+  // dP = [1, 3], sum(P * dP) = 2, dS = P * (dP - 2) = [-0.5, 0.5].
+  Tensor expected_scores(allocator(), DT_FLOAT, TensorShape({1, 1, 2}));
+  test::FillValues<float>(&expected_scores, {-0.5, 0.5});
+  test::ExpectTensorNear<float>(expected_scores, *GetOutput(0), 1e-5);
+  Tensor expected_values(allocator(), DT_FLOAT, TensorShape({1, 2, 1}));
+  test::FillValues<float>(&expected_values, {0.5, 0.5});
+  test::ExpectTensorNear<float>(expected_values, *GetOutput(1), 1e-5);
+}
+
+TEST_F(TargetAttentionOpTest, MaskBatchMustDivide) {
+  MakeOp("TargetAttention", -1e9);
+  AddInputFromArray<float>(TensorShape({3, 1, 1}), {0, 0, 0});
+  AddInputFromArray<float>(TensorShape({3, 1, 1}), {1, 2, 3});
+  AddInputFromArray<bool>(TensorShape({2, 1}), {true, true});
+  EXPECT_FALSE(RunOpKernel().ok());
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -15,6 +15,12 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/tensor_buffer_ops.h"
 
+#include <cstring>
+
+#include "tensorflow/core/common_runtime/step_stats_collector.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+
 namespace tensorflow {
 
 class TensorBufferOp : public OpKernel {
@@ -31,11 +37,11 @@ class TensorBufferOp : public OpKernel {
     TensorBuf* buffer = nullptr;
     OP_REQUIRES_OK(ctx, rm->LookupOrCreate<TensorBuf>(
                             cinfo.container(), cinfo.name(), &buffer,
-                            [&ndef](TensorBuf** pbuf) -> Status {
+                            [&ndef, &cinfo](TensorBuf** pbuf) -> Status {
                               int64 capacity;
                               TF_RETURN_IF_ERROR(GetNodeAttr(
                                   ndef, "shared_capacity", &capacity));
-                              *pbuf = new TensorBuf(capacity);
+                              *pbuf = new TensorBuf(capacity, cinfo.name());
                               return Status::OK();
                             }));
     core::ScopedUnref scope(buffer);
@@ -63,11 +69,12 @@ class TensorBufferAsyncOp : public AsyncOpKernel {
     TensorBuf* buffer = nullptr;
     OP_REQUIRES_OK_ASYNC(ctx, rm->LookupOrCreate<TensorBuf>(
                                   cinfo.container(), cinfo.name(), &buffer,
-                                  [&ndef](TensorBuf** resource) {
+                                  [&ndef, &cinfo](TensorBuf** resource) {
                                     int64 capacity;
                                     TF_RETURN_IF_ERROR(GetNodeAttr(
                                         ndef, "shared_capacity", &capacity));
-                                    *resource = new TensorBuf(capacity);
+                                    *resource =
+                                        new TensorBuf(capacity, cinfo.name());
                                     return Status::OK();
                                   }),
                          done);
@@ -95,19 +102,62 @@ class TensorBufferPutOp : public TensorBufferOp {
  public:
   explicit TensorBufferPutOp(OpKernelConstruction* ctx) : TensorBufferOp(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("timeout_millis", &timeout_millis_));
+    OP_REQUIRES_OK(ctx,
+                   ctx->GetAttr("use_pinned_memory", &use_pinned_memory_));
   }
 
   void ComputeWithTensorBuf(OpKernelContext* ctx, TensorBuf* buf) override {
+    int64 slot;
+    StallTime stall;
+    OP_REQUIRES_OK(ctx, buf->Reserve(timeout_millis_, &slot, &stall));
+    RecordWaitInStepStats(ctx, "producer_wait", stall.start_nanos,
+                          stall.wait_nanos);
+    if (slot < 0) {
+      return;
+    }
+
+    // The slot is committed even if the copy fails, otherwise the records
+    // reserved after it could never be taken.
+    Status s;
     std::vector<Tensor> record;
     record.reserve(ctx->num_inputs());
     for (int i = 0; i < ctx->num_inputs(); ++i) {
+      if (use_pinned_memory_ && s.ok()) {
+        Tensor pinned;
+        s = CopyToPinnedMemory(ctx, i, &pinned);
+        if (s.ok()) {
+          record.push_back(std::move(pinned));
+          continue;
+        }
+      }
       record.push_back(ctx->input(i));
     }
-    ctx->SetStatus(buf->Put(record, timeout_millis_));
+    buf->Commit(slot, std::move(record));
+    ctx->SetStatus(s);
   }
 
  private:
+  // Copies a host input to GPU compatible host memory, so that it is copied
+  // to GPU by DMA without another staging copy. Other inputs are shared.
+  Status CopyToPinnedMemory(OpKernelContext* ctx, int i, Tensor* pinned) {
+    const Tensor& input = ctx->input(i);
+    if (ctx->input_memory_type(i) != HOST_MEMORY ||
+        !DataTypeCanUseMemcpy(input.dtype()) || input.TotalBytes() == 0) {
+      *pinned = input;
+      return Status::OK();
+    }
+    AllocatorAttributes attr;
+    attr.set_on_host(true);
+    attr.set_gpu_compatible(true);
+    TF_RETURN_IF_ERROR(
+        ctx->allocate_temp(input.dtype(), input.shape(), pinned, attr));
+    memcpy(const_cast<char*>(pinned->tensor_data().data()),
+           input.tensor_data().data(), input.TotalBytes());
+    return Status::OK();
+  }
+
   int64 timeout_millis_;
+  bool use_pinned_memory_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("TensorBufferPut").Device(DEVICE_CPU),
@@ -130,7 +180,10 @@ class TensorBufferTakeOp : public TensorBufferAsyncOp {
                                  AsyncOpKernel::DoneCallback done,
                                  TensorBuf* buf) override {
     std::vector<Tensor> record;
-    Status s = buf->Take(&record);
+    StallTime stall;
+    Status s = buf->Take(&record, &stall);
+    RecordWaitInStepStats(ctx, "consumer_wait", stall.start_nanos,
+                          stall.wait_nanos);
     if (TF_PREDICT_FALSE(!s.ok())) {
       ctx->SetStatus(s);
       done();
@@ -230,4 +283,189 @@ REGISTER_KERNEL_BUILDER(
     TensorBufferSizeOp);
 #endif  // TENSORFLOW_USE_SYCL
 
+namespace {
+
+// The packed tensors are aligned as allocated tensors, so that their views
+// can be read as Eigen tensors.
+constexpr int64 kPackAlignment = Allocator::kAllocatorAlignment;
+
+int64 AlignPackOffset(int64 offset) {
+  return (offset + kPackAlignment - 1) / kPackAlignment * kPackAlignment;
+}
+
+// Reads the shapes and the offsets of the tensors in the header of a packed
+// buffer, which lists the rank, the dims and the offset of each tensor.
+Status ParsePackedTensors(const Tensor& packed, const DataTypeVector& dtypes,
+                          std::vector<TensorShape>* shapes,
+                          std::vector<int64>* offsets) {
+  const int64 size = packed.NumElements();
+  const int64 header_len = size / sizeof(int64);
+  const int64* header =
+      reinterpret_cast<const int64*>(packed.tensor_data().data());
+  int64 pos = 0;
+  for (size_t i = 0; i < dtypes.size(); ++i) {
+    if (pos >= header_len || header[pos] < 0 ||
+        pos + header[pos] + 2 > header_len) {
+      return errors::InvalidArgument("The header of packed tensor ", i,
+                                     " is truncated");
+    }
+    const int64 dims = header[pos++];
+    TensorShape shape;
+    TF_RETURN_IF_ERROR(
+        TensorShapeUtils::MakeShape(header + pos, dims, &shape));
+    pos += dims;
+    const int64 offset = header[pos++];
+    const int64 bytes = shape.num_elements() * DataTypeSize(dtypes[i]);
+    if (offset % kPackAlignment != 0 ||
+        offset < pos * static_cast<int64>(sizeof(int64)) ||
+        offset + bytes > size) {
+      return errors::InvalidArgument("Packed tensor ", i, " of ",
+                                     shape.DebugString(), " at ", offset,
+                                     " is out of the ", size, " bytes");
+    }
+    shapes->push_back(shape);
+    offsets->push_back(offset);
+  }
+  return Status::OK();
+}
+
+// A tensor of 'shape' sharing the bytes of 'buffer' from 'offset'.
+Status PackedView(const Tensor& buffer, int64 offset, DataType dtype,
+                  const TensorShape& shape, Tensor* view) {
+  const int64 bytes = shape.num_elements() * DataTypeSize(dtype);
+  return view->BitcastFrom(buffer.Slice(offset, offset + bytes), dtype,
+                           shape);
+}
+
+}  // namespace
+
+class TensorPackPinnedOp : public OpKernel {
+ public:
+  explicit TensorPackPinnedOp(OpKernelConstruction* ctx) : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    int64 header_len = 0;
+    for (int i = 0; i < ctx->num_inputs(); ++i) {
+      const Tensor& input = ctx->input(i);
+      OP_REQUIRES(ctx, DataTypeCanUseMemcpy(input.dtype()),
+                  errors::InvalidArgument("Tensors of ",
+                                          DataTypeString(input.dtype()),
+                                          " can't be packed"));
+      header_len += input.dims() + 2;
+    }
+    std::vector<int64> offsets(ctx->num_inputs());
+    int64 size = AlignPackOffset(header_len * sizeof(int64));
+    for (int i = 0; i < ctx->num_inputs(); ++i) {
+      offsets[i] = size;
+      size = AlignPackOffset(size + ctx->input(i).TotalBytes());
+    }
+
+    AllocatorAttributes attr;
+    attr.set_on_host(true);
+    attr.set_gpu_compatible(true);
+    Tensor* packed = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, TensorShape({size}), &packed,
+                                             attr));
+    char* base = const_cast<char*>(packed->tensor_data().data());
+    int64* header = reinterpret_cast<int64*>(base);
+    for (int i = 0; i < ctx->num_inputs(); ++i) {
+      const Tensor& input = ctx->input(i);
+      *header++ = input.dims();
+      for (int d = 0; d < input.dims(); ++d) {
+        *header++ = input.dim_size(d);
+      }
+      *header++ = offsets[i];
+      memcpy(base + offsets[i], input.tensor_data().data(),
+             input.TotalBytes());
+    }
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("TensorPackPinned").Device(DEVICE_CPU),
+                        TensorPackPinnedOp);
+
+// With copy_to_device, the device tensors are copied from the packed buffer
+// to one device buffer by a single DMA on the host-to-device stream, and are
+// views of it. The other tensors are views of the packed buffer.
+template <bool copy_to_device>
+class TensorUnpackToDeviceOp : public AsyncOpKernel {
+ public:
+  explicit TensorUnpackToDeviceOp(OpKernelConstruction* ctx)
+      : AsyncOpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("Tdevice", &device_dtypes_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("Thost", &host_dtypes_));
+    dtypes_ = device_dtypes_;
+    dtypes_.insert(dtypes_.end(), host_dtypes_.begin(), host_dtypes_.end());
+  }
+
+  void ComputeAsync(OpKernelContext* ctx, DoneCallback done) override {
+    const Tensor& packed = ctx->input(0);
+    std::vector<TensorShape> shapes;
+    std::vector<int64> offsets;
+    OP_REQUIRES_OK_ASYNC(
+        ctx, ParsePackedTensors(packed, dtypes_, &shapes, &offsets), done);
+
+    const size_t num_device = device_dtypes_.size();
+    const size_t first_host = copy_to_device ? num_device : 0;
+    for (size_t i = first_host; i < dtypes_.size(); ++i) {
+      Tensor view;
+      OP_REQUIRES_OK_ASYNC(
+          ctx, PackedView(packed, offsets[i], dtypes_[i], shapes[i], &view),
+          done);
+      ctx->set_output(i, view);
+    }
+    if (!copy_to_device || num_device == 0) {
+      done();
+      return;
+    }
+
+    // The device tensors are packed before the host tensors.
+    const int64 begin = offsets[0];
+    const int64 end =
+        offsets[num_device - 1] +
+        shapes[num_device - 1].num_elements() *
+            DataTypeSize(dtypes_[num_device - 1]);
+    Tensor device_buffer;
+    OP_REQUIRES_OK_ASYNC(
+        ctx, ctx->allocate_temp(DT_UINT8, TensorShape({end - begin}),
+                                &device_buffer),
+        done);
+    Tensor host_buffer = packed.Slice(begin, end);
+    auto unpack = [this, ctx, done, host_buffer, device_buffer, begin, shapes,
+                   offsets](const Status& s) {
+      OP_REQUIRES_OK_ASYNC(ctx, s, done);
+      for (size_t i = 0; i < device_dtypes_.size(); ++i) {
+        Tensor view;
+        OP_REQUIRES_OK_ASYNC(ctx,
+                             PackedView(device_buffer, offsets[i] - begin,
+                                        dtypes_[i], shapes[i], &view),
+                             done);
+        ctx->set_output(i, view);
+      }
+      done();
+    };
+    if (end == begin) {
+      unpack(Status::OK());
+      return;
+    }
+    ctx->op_device_context()->CopyCPUTensorToDevice(
+        &host_buffer, ctx->device(), &device_buffer, unpack);
+  }
+
+ private:
+  DataTypeVector device_dtypes_;
+  DataTypeVector host_dtypes_;
+  DataTypeVector dtypes_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("TensorUnpackToDevice").Device(DEVICE_CPU),
+                        TensorUnpackToDeviceOp<false>);
+#if GOOGLE_CUDA
+REGISTER_KERNEL_BUILDER(Name("TensorUnpackToDevice")
+                            .Device(DEVICE_GPU)
+                            .HostMemory("packed")
+                            .HostMemory("host_tensors"),
+                        TensorUnpackToDeviceOp<true>);
+#endif  // GOOGLE_CUDA
+
 }  // namespace tensorflow
@@ -23,6 +23,7 @@ limitations under the License.
 
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/stall_stats.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/status.h"
@@ -36,29 +37,61 @@ limitations under the License.
 
 #include <chrono>
 #include <cstddef>
-#include <deque>
 #include <vector>
 
 namespace tensorflow {
 
 #define TF_RESOURCE_DEBUG_STRING_CONST const
 
+// A ring of capacity slots. A producer reserves the next slot, fills it
+// without holding the lock and then commits it, so that N producers can
+// prepare their records, e.g. copy them to pinned host memory, at the same
+// time. Records are taken in the order their slots are reserved.
 class TensorBuf : public ResourceBase {
  public:
-  explicit TensorBuf(int64 capacity)
-      : capacity_(capacity), is_cancelled_(false), is_closed_(false) {}
+  TensorBuf(int64 capacity, const string& name)
+      : capacity_(capacity), slots_(capacity), head_(0), tail_(0),
+        is_cancelled_(false), is_closed_(false),
+        stall_counters_(StallStats::Global()->Get(
+            strings::StrCat("TensorBuffer/", name))) {}
 
   ~TensorBuf() { Cancel(); }
 
   Status Put(const std::vector<Tensor>& record, int64 timeout_millis) {
+    int64 slot;
+    TF_RETURN_IF_ERROR(Reserve(timeout_millis, &slot));
+    if (slot >= 0) {
+      Commit(slot, record);
+    }
+    return Status::OK();
+  }
+
+  // Reserves the next slot. slot is set to -1 if no slot is available
+  // within timeout_millis, and the record should be dropped. The time spent
+  // waiting for a free slot is added to stall if not null.
+  Status Reserve(int64 timeout_millis, int64* slot,
+                 StallTime* stall = nullptr) {
     std::unique_lock<std::mutex> lock(mu_);
 
-    bool should_retry = !put_cv_.wait_for(
-        lock, std::chrono::milliseconds(timeout_millis),
-        [this]() { return buffer_.size() < capacity_ || is_cancelled_; });
+    auto is_free = [this]() {
+      return tail_ - head_ < capacity_ || is_cancelled_;
+    };
+    bool should_retry = false;
+    if (!is_free()) {
+      const int64 start_nanos = Env::Default()->NowNanos();
+      should_retry = !put_cv_.wait_for(
+          lock, std::chrono::milliseconds(timeout_millis), is_free);
+      const int64 wait_nanos = Env::Default()->NowNanos() - start_nanos;
+      stall_counters_->RecordProducerWait(wait_nanos);
+      if (stall != nullptr) {
+        stall->start_nanos = start_nanos;
+        stall->wait_nanos = wait_nanos;
+      }
+    }
     if (should_retry) {
       lock.unlock();
       LOG(WARNING) << "Prefetching was ignored since timeout.";
+      *slot = -1;
       return Status::OK();
     }
 
@@ -67,34 +100,63 @@ class TensorBuf : public ResourceBase {
       return Status(errors::Cancelled("Session was closed."));
     }
 
-    buffer_.push_back(std::move(record));
+    *slot = tail_++;
+    return Status::OK();
+  }
 
-    lock.unlock();
-    take_cv_.notify_all();
+  // Fills a reserved slot, the slot can be taken once all the slots
+  // reserved before it are committed.
+  void Commit(int64 slot, std::vector<Tensor> record) {
+    std::unique_lock<std::mutex> lock(mu_);
+    Slot& s = slots_[slot % capacity_];
+    s.record = std::move(record);
+    s.is_ready = true;
+    const bool is_head = (slot == head_);
 
-    return Status::OK();
+    lock.unlock();
+    if (is_head) {
+      take_cv_.notify_all();
+    }
   }
 
-  Status Take(std::vector<Tensor>* record) {
+  // The time spent waiting for a record is added to stall if not null.
+  Status Take(std::vector<Tensor>* record, StallTime* stall = nullptr) {
     std::unique_lock<std::mutex> lock(mu_);
 
-    take_cv_.wait(lock, [this]() { return !buffer_.empty() || is_cancelled_; });
+    auto is_ready = [this]() { return IsHeadReady() || is_cancelled_; };
+    if (!is_ready()) {
+      const int64 start_nanos = Env::Default()->NowNanos();
+      take_cv_.wait(lock, is_ready);
+      const int64 wait_nanos = Env::Default()->NowNanos() - start_nanos;
+      stall_counters_->RecordConsumerWait(wait_nanos);
+      if (stall != nullptr) {
+        stall->start_nanos = start_nanos;
+        stall->wait_nanos = wait_nanos;
+      }
+    }
 
-    if (TF_PREDICT_FALSE(is_closed_ && buffer_.empty())) {
+    if (TF_PREDICT_FALSE(is_closed_ && !IsHeadReady())) {
       lock.unlock();
       return Status(errors::OutOfRange("EOF reached."));
     }
 
-    if (TF_PREDICT_FALSE(is_cancelled_ && buffer_.empty())) {
+    if (TF_PREDICT_FALSE(is_cancelled_ && !IsHeadReady())) {
       lock.unlock();
       return Status(errors::Cancelled("Session was closed."));
     }
 
-    *record = std::move(buffer_.front());
-    buffer_.pop_front();
+    Slot& s = slots_[head_ % capacity_];
+    *record = std::move(s.record);
+    s.record.clear();
+    s.is_ready = false;
+    ++head_;
+    const bool is_next_ready = IsHeadReady();
 
     lock.unlock();
     put_cv_.notify_all();
+    if (is_next_ready) {
+      take_cv_.notify_all();
+    }
 
     return Status::OK();
   }
@@ -124,7 +186,7 @@ class TensorBuf : public ResourceBase {
 
   Status GetSize(Tensor* size) {
     std::unique_lock<std::mutex> lock(mu_);
-    size->scalar<int32>().setConstant(static_cast<int64>(buffer_.size()));
+    size->scalar<int32>().setConstant(static_cast<int64>(tail_ - head_));
     return Status::OK();
   }
 
@@ -151,14 +213,27 @@ class TensorBuf : public ResourceBase {
   }
 
  private:
-  std::deque<std::vector<Tensor> > buffer_;
-  std::size_t capacity_;
+  struct Slot {
+    std::vector<Tensor> record;
+    bool is_ready = false;
+  };
+
+  bool IsHeadReady() const {
+    return head_ < tail_ && slots_[head_ % capacity_].is_ready;
+  }
+
+  const int64 capacity_;
+  std::vector<Slot> slots_;
+  // Sequence numbers of the next slot to take and to reserve.
+  int64 head_;
+  int64 tail_;
   bool is_cancelled_;
   bool is_closed_;
   std::mutex mu_;
   std::condition_variable take_cv_;
   std::condition_variable put_cv_;
   std::shared_ptr<thread::ThreadPool> threads_;
+  StallCounters* stall_counters_;
 };
 }
 
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_TRAINING_ALI_OP_HELPERS_H_
 #define TENSORFLOW_CORE_KERNELS_TRAINING_ALI_OP_HELPERS_H_
 
+#include "tensorflow/core/framework/embedding/epoch_reclaimer.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/variant_op_registry.h"
 #include "tensorflow/core/kernels/dense_update_functor.h"
@@ -60,10 +61,12 @@ struct EmbeddingVariableInputLockHolder {
  public:
   EmbeddingVariableInputLockHolder(std::vector<EmbeddingVar<K, V>*> vars,
                           std::unique_ptr<std::vector<mutex_lock>> locks)
-      : vars_(std::move(vars)), locks_(std::move(locks)) {}
+      : vars_(std::move(vars)), locks_(std::move(locks)),
+        epoch_guard_(new embedding::EpochGuard()) {}
 
   EmbeddingVariableInputLockHolder(EmbeddingVariableInputLockHolder&& other)
-      : vars_(std::move(other.vars_)), locks_(std::move(other.locks_)) {}
+      : vars_(std::move(other.vars_)), locks_(std::move(other.locks_)),
+        epoch_guard_(std::move(other.epoch_guard_)) {}
 
   ~EmbeddingVariableInputLockHolder() {
     // Release the locks before unreffing the Vars, because each lock
@@ -79,6 +82,9 @@ struct EmbeddingVariableInputLockHolder {
   // NOTE: Use a `std::unique_ptr` instead of moving in a vector directly,
   // because a `std::vector<mutex_lock>` is not movable on all platforms.
   std::unique_ptr<std::vector<mutex_lock>> locks_;
+  // Keeps the ValuePtrs the op updates from being reclaimed by a concurrent
+  // eviction, with or without the locks.
+  std::unique_ptr<embedding::EpochGuard> epoch_guard_;
 };
 
 template<typename K, typename V>
@@ -161,15 +167,14 @@ void LookupOrCreateEmbedding(
     std::vector<std::pair<EmbeddingVar<K, V>*, V**>>& vars,
     ValuePtr<V>** value_ptrs,
     const K* indices,
-    int64 num_of_keys,
-    IntraThreadCopyIdAllocator* thread_copy_id_alloc) {
+    int64 num_of_keys) {
   for (auto it: vars) {
     EmbeddingVar<K, V>* var = it.first;
     V** var_ptr = it.second;
     EmbeddingVarContext<Eigen::GpuDevice> ev_ctx(ctx);
     var->BatchLookupOrCreateEmb(
         ev_ctx, var_ptr, value_ptrs,
-        indices, num_of_keys, thread_copy_id_alloc);
+        indices, num_of_keys);
   }
 }
 
@@ -178,14 +183,13 @@ void GetEmbeddingPointers(
     OpKernelContext* ctx,
     std::vector<std::pair<EmbeddingVar<K, V>*, V**>>& vars,
     const K* indices, Tstep gs, bool indices_as_pointer,
-    int counts_index, int64 num_of_keys,
-    IntraThreadCopyIdAllocator* thread_copy_id_alloc) {
+    int counts_index, int64 num_of_keys) {
   std::vector<ValuePtr<V>*> value_ptrs(num_of_keys);
   LookupKeyAndSetVersion(ctx, vars[0].first, value_ptrs.data(),
                          gs, indices, num_of_keys,
                          indices_as_pointer, counts_index);
   LookupOrCreateEmbedding(ctx, vars, value_ptrs.data(),
-                          indices, num_of_keys, thread_copy_id_alloc);
+                          indices, num_of_keys);
 }
 }  // end namespace tensorflow
 
@@ -20,11 +20,16 @@ limitations under the License.
 #include "tensorflow/core/lib/bfloat16/bfloat16.h"
 
 #include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 #include "tensorflow/core/framework/bounds_check.h"
-#include "tensorflow/core/framework/embedding/intra_thread_copy_id_allocator.h"
+#include "tensorflow/core/framework/embedding/float_math_row.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/kernels/kv_apply_owner_executor.h"
+#include "tensorflow/core/kernels/kv_delayed_apply_executor.h"
+#include "tensorflow/core/kernels/kv_sparse_apply_combiner.h"
 #include "tensorflow/core/kernels/kv_variable_ops.h"
 #include "tensorflow/core/kernels/training_op_helpers.h"
 #include "tensorflow/core/kernels/training_ali_op_helpers.h"
@@ -69,7 +74,7 @@ struct ApplyAdagradDecay<CPUDevice, T> {
 }
 
 template <typename TKey, typename T, typename Tstep,
-          bool indices_as_pointer, bool has_counts>
+          bool indices_as_pointer, bool has_counts, bool has_scale = false>
 class KvSparseApplyAdagradOp : public OpKernel {
  public:
   explicit KvSparseApplyAdagradOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
@@ -77,9 +82,6 @@ class KvSparseApplyAdagradOp : public OpKernel {
   }
 
   void Compute(OpKernelContext* ctx) override NO_THREAD_SAFETY_ANALYSIS {
-    auto locks =
-        MaybeLockEmbeddingVariableInputMutexesInOrder<TKey, T>(ctx, use_exclusive_lock_, {0, 1});
-
     EmbeddingVar<TKey, T>* var = NULL;
     OP_REQUIRES_OK(ctx, GetInputEmbeddingVar(ctx, 0, &var));
     core::ScopedUnref unref_var(var);
@@ -120,55 +122,173 @@ class KvSparseApplyAdagradOp : public OpKernel {
     OP_REQUIRES(ctx, inner_dim > 0,
                 errors::InvalidArgument(
                     "Inner dimension should be greater than zero."));
+    if (N == 0) {
+      return;
+    }
+    T lr_scalar = lr.scalar<T>()();
+    Tstep gs = global_step.scalar<Tstep>()();
+    // The scale of the gradients clipped by a global norm, applied to the
+    // rows as they are read instead of in a pass of its own.
+    M grad_scale = 1;
+    if (has_scale) {
+      const Tensor& grad_scale_tensor = ctx->input(has_counts ? 7 : 6);
+      OP_REQUIRES(ctx, IsLegacyScalar(grad_scale_tensor.shape()),
+                  errors::InvalidArgument(
+                      "grad_scale is not a scalar: ",
+                      grad_scale_tensor.shape().DebugString()));
+      grad_scale = static_cast<M>(grad_scale_tensor.scalar<T>()());
+    }
+
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *(ctx->device()->tensorflow_cpu_worker_threads());
+
+    // The apply leaves the critical path of the step: it is queued, and the
+    // next step runs while it is applied.
+    KvDelayedApplyExecutor* delayed = KvDelayedApplyExecutor::Global();
+    if (!indices_as_pointer && delayed->enabled()) {
+      const Tensor counts = has_counts ? ctx->input(6) : Tensor();
+      var->Ref();
+      accum->Ref();
+      // Outlives the kernel, which may be deleted before the apply runs.
+      const bool do_lock = use_exclusive_lock_;
+      auto apply = [delayed, do_lock, var, accum, lr_scalar, gs, indices, grad,
+                    counts, grad_scale]() {
+        core::ScopedUnref unref_var(var);
+        core::ScopedUnref unref_accum(accum);
+        auto locks = LockEmbeddingVariableMutexes(do_lock, var, accum);
+        return ApplyGradients(delayed->worker_threads(), var, accum,
+                              lr_scalar, gs, indices, grad, counts,
+                              grad_scale);
+      };
+      Status s = delayed->Schedule<TKey>(var, indices, apply);
+      if (!s.ok()) {
+        var->Unref();
+        accum->Unref();
+      }
+      OP_REQUIRES_OK(ctx, s);
+      return;
+    }
+
+    // Concurrent applies of the variable, such as the gradients pushed by
+    // several workers, are deduplicated and applied at once. The scaled
+    // gradients are not, their scales may differ.
+    SparseApplyCombiner* combiner = SparseApplyCombiner::Global();
+    if (!indices_as_pointer && !has_scale && combiner->enabled()) {
+      SparseGradPush push;
+      push.indices = indices;
+      push.grad = grad;
+      if (has_counts) {
+        push.counts = ctx->input(6);
+      }
+      push.global_step = gs;
+      std::vector<SparseGradPush*> batch;
+      if (!combiner->Join(var, &push, &batch)) {
+        OP_REQUIRES_OK(ctx, push.status);
+        return;
+      }
+      SparseGradPush merged;
+      Status s = MergeSparseGradPushes<TKey, T>(ctx, batch, &merged);
+      if (s.ok()) {
+        auto locks = MaybeLockEmbeddingVariableInputMutexesInOrder<TKey, T>(
+            ctx, use_exclusive_lock_, {0, 1});
+        s = ApplyGradients(worker_threads, var, accum, lr_scalar,
+                           merged.global_step, merged.indices, merged.grad,
+                           merged.counts);
+      }
+      combiner->Finish(batch, s);
+      OP_REQUIRES_OK(ctx, s);
+      return;
+    }
+
+    auto locks =
+        MaybeLockEmbeddingVariableInputMutexesInOrder<TKey, T>(ctx, use_exclusive_lock_, {0, 1});
+    OP_REQUIRES_OK(ctx, ApplyGradients(worker_threads, var, accum, lr_scalar,
+                                       gs, indices, grad,
+                                       has_counts ? ctx->input(6) : Tensor(),
+                                       grad_scale));
+  }
+
+ private:
+  typedef typename embedding::FloatMathRow<T>::MathType M;
+
+  // Locks the mutexes of var and accum in order, for a delayed apply, which
+  // has no ctx to lock its inputs with.
+  static std::vector<mutex_lock> LockEmbeddingVariableMutexes(
+      bool do_lock, EmbeddingVar<TKey, T>* var, EmbeddingVar<TKey, T>* accum) {
+    std::vector<mutex_lock> locks;
+    if (!do_lock) return locks;
+    mutex* first = std::min(var->mu(), accum->mu());
+    mutex* second = std::max(var->mu(), accum->mu());
+    locks.reserve(2);
+    locks.emplace_back(*first);
+    if (second != first) {
+      locks.emplace_back(*second);
+    }
+    return locks;
+  }
+
+  static Status ApplyGradients(
+      const DeviceBase::CpuWorkerThreads& worker_threads,
+      EmbeddingVar<TKey, T>* var, EmbeddingVar<TKey, T>* accum, T lr_scalar,
+      Tstep gs, const Tensor& indices, const Tensor& grad,
+      const Tensor& counts_tensor, M grad_scale = 1) {
+    const int64 N = indices.dim_size(0);
     int64* indices_counts = nullptr;
     std::function<int64(int64*, int64)> get_count_fn = 0;
     if (has_counts) {
-      const Tensor& counts_tensor = ctx->input(6);
       indices_counts = (int64*)counts_tensor.data();
       get_count_fn = [](int64* counts, int64 index) {return counts[index];};
     } else {
       get_count_fn = [](int64* counts, int64 index) {return 1;};
     }
 
-    if (N > 0) {
-      if (inner_dim > 0) {
-        auto indices_vec = indices.vec<TKey>();
-        auto grad_flat = grad.flat_outer_dims<T>();
-        T lr_scalar = lr.scalar<T>()();
-        Tstep gs = global_step.scalar<Tstep>()();
-        auto do_work = [this, ctx, &indices_vec, var, accum, &grad_flat,
-            &gs, &lr_scalar, indices_counts, get_count_fn]
-            (int64 start_i, int64 limit_i) {
-          for (int64 i = start_i; i < limit_i; i++) {
-            const TKey index = indices_vec(i);
-            ValuePtr<T>* value_ptr = nullptr;
-            bool is_filter = false;
-            int64 count = get_count_fn(indices_counts, i);
-            OP_REQUIRES_OK(ctx, var->LookupOrCreateKey(index, &value_ptr,
-                           &is_filter, indices_as_pointer, count));
-            var->UpdateVersion(value_ptr, gs);
-            if (is_filter) {
-              auto a = accum->flat(value_ptr, index);
-              auto g = grad_flat.template chip<0>(i);
-              auto v = var->flat(value_ptr, index);
-              a += g.square();
-              v -= g.constant(lr_scalar) * g * a.rsqrt();
-            }
-          }
-        };
-        const int64 cost = 1000; //very unreliable estimate for cost per step.
-        auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
-        Shard(worker_threads.num_threads, worker_threads.workers, N, cost, do_work);
-
-        if (has_counts && !indices_as_pointer) {
-          const Tensor& indices_counts = ctx->input(6);
-          var->UpdateCache(indices, indices_counts);
+    auto indices_vec = indices.vec<TKey>();
+    auto grad_flat = grad.flat_outer_dims<T>();
+    mutex status_mu;
+    Status status;
+    auto do_work = [&indices_vec, var, accum, &grad_flat, &gs, &lr_scalar,
+        grad_scale, indices_counts, get_count_fn, &status_mu, &status]
+        (int64 start_i, int64 limit_i) {
+      for (int64 i = start_i; i < limit_i; i++) {
+        const TKey index = indices_vec(i);
+        ValuePtr<T>* value_ptr = nullptr;
+        bool is_filter = false;
+        int64 count = get_count_fn(indices_counts, i);
+        Status s = var->LookupOrCreateKey(index, &value_ptr, &is_filter,
+                                          indices_as_pointer, count);
+        if (!s.ok()) {
+          mutex_lock l(status_mu);
+          status.Update(s);
+          return;
+        }
+        var->UpdateVersion(value_ptr, gs);
+        if (is_filter) {
+          const int64 dim = var->ValueLen();
+          embedding::FloatMathRow<T> a_row(
+              accum->flat(value_ptr, index).data(), dim);
+          embedding::FloatMathRow<T> v_row(
+              var->flat(value_ptr, index).data(), dim);
+          embedding::ConstFloatMathRow<T> g_row(&grad_flat(i, 0), dim);
+          auto a = a_row.flat();
+          auto v = v_row.flat();
+          auto g = g_row.flat() * g_row.flat().constant(grad_scale);
+          a += g.square();
+          v -= g.constant(static_cast<M>(lr_scalar)) * g * a.rsqrt();
+          a_row.Commit();
+          v_row.Commit();
         }
       }
+    };
+    const int64 cost = 1000; //very unreliable estimate for cost per step.
+    ShardKvApply<TKey>(worker_threads, indices, cost, do_work);
+    TF_RETURN_IF_ERROR(status);
+
+    if (has_counts && !indices_as_pointer) {
+      var->UpdateCache(indices, counts_tensor);
     }
+    return Status::OK();
   }
 
- private:
   bool use_exclusive_lock_;
 };
 
@@ -196,13 +316,125 @@ class KvSparseApplyAdagradOp : public OpKernel {
                               .TypeConstraint<T>("T")                \
                               .TypeConstraint<Tindices>("Tindices")  \
                               .TypeConstraint<Tstep>("Tstep"),       \
-                          KvSparseApplyAdagradOp<Tindices, T, Tstep, true, true>);
+                          KvSparseApplyAdagradOp<Tindices, T, Tstep, true, true>);\
+  REGISTER_KERNEL_BUILDER(Name("KvResourceSparseApplyAdagradScaled")       \
+                              .Device(DEVICE_CPU)                    \
+                              .TypeConstraint<T>("T")                \
+                              .TypeConstraint<Tindices>("Tindices")  \
+                              .TypeConstraint<Tstep>("Tstep"),       \
+                          KvSparseApplyAdagradOp<Tindices, T, Tstep, false, false, true>); \
+  REGISTER_KERNEL_BUILDER(Name("KvResourceSparseApplyAdagradScaledWithCounts") \
+                              .Device(DEVICE_CPU)                    \
+                              .TypeConstraint<T>("T")                \
+                              .TypeConstraint<Tindices>("Tindices")  \
+                              .TypeConstraint<Tstep>("Tstep"),       \
+                          KvSparseApplyAdagradOp<Tindices, T, Tstep, false, true, true>);
 #define REGISTER_CPU_KERNELS(T)        \
   REGISTER_KERNELS(int32, T, int32);   \
   REGISTER_KERNELS(int64, T, int32);   \
   REGISTER_KERNELS(int32, T, int64);   \
   REGISTER_KERNELS(int64, T, int64);
 
+TF_CALL_bfloat16(REGISTER_CPU_KERNELS);
+TF_CALL_float(REGISTER_CPU_KERNELS);
+
+#undef REGISTER_CPU_KERNELS
+#undef REGISTER_KERNELS
+
+// Sums the gradient rows of the same indices in one pass, and computes the
+// squared norm of the summed rows as they are summed: adding v to a row s
+// adds |s + v|^2 - |s|^2 to the norm.
+template <typename T, typename Tindices>
+class KvSparseGradAggregateOp : public OpKernel {
+ public:
+  explicit KvSparseGradAggregateOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& values = ctx->input(0);
+    const Tensor& indices = ctx->input(1);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsVector(indices.shape()),
+                errors::InvalidArgument("indices must be one-dimensional"));
+    OP_REQUIRES(ctx, values.dims() >= 1 &&
+                values.dim_size(0) == indices.dim_size(0),
+                errors::InvalidArgument(
+                    "values must be the same size as indices in the first "
+                    "dimension, got ", values.shape().DebugString(), " and ",
+                    indices.shape().DebugString()));
+    const int64 N = indices.dim_size(0);
+    const int64 row_len = N > 0 ? values.NumElements() / N : 0;
+
+    auto indices_flat = indices.flat<Tindices>();
+    std::unordered_map<Tindices, int64> rows;
+    rows.reserve(N);
+    std::vector<int64> row_of(N);
+    std::vector<Tindices> keys;
+    for (int64 i = 0; i < N; ++i) {
+      auto it = rows.emplace(indices_flat(i), keys.size());
+      if (it.second) {
+        keys.push_back(indices_flat(i));
+      }
+      row_of[i] = it.first->second;
+    }
+    const int64 unique = keys.size();
+
+    TensorShape summed_shape = values.shape();
+    summed_shape.set_dim(0, unique);
+    Tensor* summed_values = nullptr;
+    Tensor* unique_indices = nullptr;
+    Tensor* indices_counts = nullptr;
+    Tensor* squared_norm = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, summed_shape,
+                                             &summed_values));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(1, TensorShape({unique}),
+                                             &unique_indices));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(2, TensorShape({unique}),
+                                             &indices_counts));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(3, TensorShape({}),
+                                             &squared_norm));
+    std::copy(keys.begin(), keys.end(),
+              unique_indices->flat<Tindices>().data());
+    int64* counts = indices_counts->flat<int64>().data();
+    std::fill(counts, counts + unique, 0);
+
+    const T* src = values.flat<T>().data();
+    T* dst = summed_values->flat<T>().data();
+    double norm = 0.0;
+    for (int64 i = 0; i < N; ++i) {
+      const int64 r = row_of[i];
+      const T* v = src + i * row_len;
+      T* s = dst + r * row_len;
+      if (counts[r]++ == 0) {
+        for (int64 j = 0; j < row_len; ++j) {
+          const double x = static_cast<float>(v[j]);
+          s[j] = v[j];
+          norm += x * x;
+        }
+      } else {
+        for (int64 j = 0; j < row_len; ++j) {
+          const double old_x = static_cast<float>(s[j]);
+          s[j] = static_cast<T>(static_cast<float>(s[j]) +
+                                static_cast<float>(v[j]));
+          const double new_x = static_cast<float>(s[j]);
+          norm += new_x * new_x - old_x * old_x;
+        }
+      }
+    }
+    squared_norm->scalar<float>()() = static_cast<float>(std::max(norm, 0.0));
+  }
+};
+
+#define REGISTER_KERNELS(T, Tindices)                                  \
+  REGISTER_KERNEL_BUILDER(Name("KvSparseGradAggregate")                \
+                              .Device(DEVICE_CPU)                      \
+                              .TypeConstraint<T>("T")                  \
+                              .TypeConstraint<Tindices>("Tindices"),   \
+                          KvSparseGradAggregateOp<T, Tindices>);
+#define REGISTER_CPU_KERNELS(T)  \
+  REGISTER_KERNELS(T, int32);    \
+  REGISTER_KERNELS(T, int64);
+
+TF_CALL_bfloat16(REGISTER_CPU_KERNELS);
 TF_CALL_float(REGISTER_CPU_KERNELS);
 
 #undef REGISTER_CPU_KERNELS
@@ -215,12 +447,6 @@ class KvSparseApplyAdagradGPUOp : public OpKernel {
  public:
   explicit KvSparseApplyAdagradGPUOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
-
-    int num_worker_threads = ctx->device()
-                             ->tensorflow_cpu_worker_threads()
-                             ->num_threads;
-    thread_copy_id_alloc_.reset(
-        new IntraThreadCopyIdAllocator(num_worker_threads));
   }
 
   void ApplyGradients(
@@ -331,7 +557,7 @@ class KvSparseApplyAdagradGPUOp : public OpKernel {
           vars[1] = std::pair<EmbeddingVar<TKey, T>*, T**>(accum, a);
           GetEmbeddingPointers(ctx, vars, (TKey*)indices_host_ptr->data(),
                                gs, indices_as_pointer,
-                               counts_index, N, thread_copy_id_alloc_.get());
+                               counts_index, N);
 
           ApplyGradients(
               var, accum, v, a,
@@ -353,7 +579,6 @@ class KvSparseApplyAdagradGPUOp : public OpKernel {
 
  private:
   bool use_exclusive_lock_;
-  std::unique_ptr<IntraThreadCopyIdAllocator> thread_copy_id_alloc_;
 };
 
 namespace functor {
@@ -597,8 +822,7 @@ class KvSparseApplyFtrlOp : public OpKernel {
         };
 
         const int64 cost = 4500; //very unreliable estimate for cost per step.
-        auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
-        Shard(worker_threads.num_threads, worker_threads.workers, N, cost, do_work);
+        ShardKvApply<TKey>(ctx, indices, cost, do_work);
 
         if (has_counts && !indices_as_pointer) {
           const int counts_input_index = has_l2_shrinkage ? 10 : 9;
@@ -1326,8 +1550,7 @@ class KvSparseApplyAdagradDecayOp : public OpKernel {
           }
         };
         const int64 cost = 1000;
-        auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
-        Shard(worker_threads.num_threads, worker_threads.workers, N, cost, do_work);
+        ShardKvApply<Tindex>(ctx, indices, cost, do_work);
         if (has_counts && !indices_as_pointer) {
           const Tensor& indices_counts = ctx->input(10);
           var->UpdateCache(indices, indices_counts);
@@ -1486,15 +1709,17 @@ class KvSparseApplyAdamOp : public OpKernel {
     }
 
     if (N > 0) {
-      T beta1_power_scalar = beta1_power.scalar<T>()();
-      T beta2_power_scalar = beta2_power.scalar<T>()();
-      T lr_scalar = lr.scalar<T>()();
-      T beta1_scalar = beta1.scalar<T>()();
-      T beta2_scalar = beta2.scalar<T>()();
-      T epsilon_scalar = epsilon.scalar<T>()();
-      const T alpha = lr_scalar *
-          Eigen::numext::sqrt(static_cast<T>(1) - beta2_power_scalar) /
-          (static_cast<T>(1) - beta1_power_scalar);
+      // bfloat16 rows are updated in float.
+      typedef typename embedding::FloatMathRow<T>::MathType M;
+      M beta1_power_scalar = static_cast<M>(beta1_power.scalar<T>()());
+      M beta2_power_scalar = static_cast<M>(beta2_power.scalar<T>()());
+      M lr_scalar = static_cast<M>(lr.scalar<T>()());
+      M beta1_scalar = static_cast<M>(beta1.scalar<T>()());
+      M beta2_scalar = static_cast<M>(beta2.scalar<T>()());
+      M epsilon_scalar = static_cast<M>(epsilon.scalar<T>()());
+      const M alpha = lr_scalar *
+          Eigen::numext::sqrt(static_cast<M>(1) - beta2_power_scalar) /
+          (static_cast<M>(1) - beta1_power_scalar);
 
       auto DoWork = [this, ctx, inner_dim, &var, &m, &v, &grad, &indices,
            &beta1_power_scalar, &beta2_power_scalar, &lr_scalar, &beta1_scalar,
@@ -1515,22 +1740,36 @@ class KvSparseApplyAdamOp : public OpKernel {
                            &is_filter, indices_as_pointer, count));
             var->UpdateVersion(value_ptr, gs);
             if (is_filter) {
-              auto var_i = var->flat(value_ptr, index);
-              auto m_a = m->flat(value_ptr, index);
-              auto v_a = v->flat(value_ptr, index);
-
-              auto g = grad_flat.template chip<0>(i);
-              m_a += (g - m_a) * (static_cast<T>(1) - beta1_scalar);
-              v_a += (g.square() - v_a) * (static_cast<T>(1) - beta2_scalar);
+              auto m_state = m->StateRow(value_ptr, index);
+              auto v_state = v->StateRow(value_ptr, index);
+              embedding::FloatMathRow<T> var_row(
+                  var->flat(value_ptr, index).data(), inner_dim);
+              embedding::FloatMathRow<T> m_row(
+                  m_state.flat().data(), inner_dim);
+              embedding::FloatMathRow<T> v_row(
+                  v_state.flat().data(), inner_dim);
+              embedding::ConstFloatMathRow<T> g_row(&grad_flat(i, 0),
+                                                    inner_dim);
+              auto var_i = var_row.flat();
+              auto m_a = m_row.flat();
+              auto v_a = v_row.flat();
+
+              auto g = g_row.flat();
+              m_a += (g - m_a) * (static_cast<M>(1) - beta1_scalar);
+              v_a += (g.square() - v_a) * (static_cast<M>(1) - beta2_scalar);
               var_i -= (m_a * alpha) / (v_a.sqrt() + epsilon_scalar);
+              var_row.Commit();
+              m_row.Commit();
+              v_row.Commit();
+              m_state.Commit();
+              v_state.Commit();
             }
           }
         }
       };
 
       const int64 cost = 1000;
-      auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
-      Shard(worker_threads.num_threads, worker_threads.workers, N, cost, DoWork);
+      ShardKvApply<Tindex>(ctx, indices, cost, DoWork);
       if (has_counts && !indices_as_pointer) {
         const Tensor& indices_counts = ctx->input(12);
         var->UpdateCache(indices, indices_counts);
@@ -1568,6 +1807,7 @@ class KvSparseApplyAdamOp : public OpKernel {
   REGISTER_KERNELS(T, int32);   \
   REGISTER_KERNELS(T, int64);
 
+TF_CALL_bfloat16(REGISTER_CPU_KERNELS);
 TF_CALL_float(REGISTER_CPU_KERNELS);
 
 #undef REGISTER_CPU_KERNELS
@@ -1580,12 +1820,6 @@ class KvSparseApplyAdamGPUOp : public OpKernel {
  public:
   explicit KvSparseApplyAdamGPUOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
-
-    int num_worker_threads = ctx->device()
-                             ->tensorflow_cpu_worker_threads()
-                             ->num_threads;
-    thread_copy_id_alloc_.reset(
-        new IntraThreadCopyIdAllocator(num_worker_threads));
   }
 
   void ApplyGradients(
@@ -1726,7 +1960,7 @@ class KvSparseApplyAdamGPUOp : public OpKernel {
         vars[2] = std::pair<EmbeddingVar<Tindex, T>*, T**>(v, v_ptr);
         GetEmbeddingPointers(ctx, vars, indices_flat.data(),
                              gs, indices_as_pointer,
-                             counts_index, N, thread_copy_id_alloc_.get());
+                             counts_index, N);
 
         auto stream = ctx->op_device_context()->stream();
         auto event_mgr = ctx->device()->tensorflow_gpu_device_info()->event_mgr;
@@ -1750,7 +1984,6 @@ class KvSparseApplyAdamGPUOp : public OpKernel {
 
  private:
   bool use_exclusive_lock_;
-  std::unique_ptr<IntraThreadCopyIdAllocator> thread_copy_id_alloc_;
   std::function<T*(T*, Tindex, int64, int64, int64)> get_default_v_fn_;
 };
 
@@ -2419,8 +2652,10 @@ class KvSparseApplyAdamAsyncOp : public OpKernel {
                            &is_filter, indices_as_pointer, count));
             var->UpdateVersion(value_ptr, gs);
             if (is_filter) {
-              auto v_ = v->flat(value_ptr, index);
-              auto m_ = m->flat(value_ptr, index);
+              auto v_state = v->StateRow(value_ptr, index);
+              auto m_state = m->StateRow(value_ptr, index);
+              auto v_ = v_state.flat();
+              auto m_ = m_state.flat();
               auto grad_ = grad_flat.template chip<0>(i);
 
               v_ = v_ * v_.constant(beta2_scalar) +
@@ -2431,12 +2666,13 @@ class KvSparseApplyAdamAsyncOp : public OpKernel {
 
               auto v = var->flat(value_ptr, index);
               v -= m_;
+              v_state.Commit();
+              m_state.Commit();
             }
           }
         };
         const int64 cost = 1000;
-        auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
-        Shard(worker_threads.num_threads, worker_threads.workers, N, cost, do_work);
+        ShardKvApply<Tindex>(ctx, indices, cost, do_work);
       } else {
         auto beta1_power_scalar = beta1_power.scalar<T>();
         auto beta2_power_scalar = beta2_power.scalar<T>();
@@ -2468,22 +2704,25 @@ class KvSparseApplyAdamAsyncOp : public OpKernel {
                              &is_filter, indices_as_pointer, count));
               var->UpdateVersion(value_ptr, gs);
               if (is_filter) {
-                auto m_a = m->flat(value_ptr, index);
-                auto v_a = v->flat(value_ptr, index);
+                auto m_state = m->StateRow(value_ptr, index);
+                auto v_state = v->StateRow(value_ptr, index);
+                auto m_a = m_state.flat();
+                auto v_a = v_state.flat();
                 auto g = grad_flat.template chip<0>(i);
                 auto var_i = var->flat(value_ptr, index);
 
                 m_a = m_a * beta1_scalar + g * (static_cast<T>(1) - beta1_scalar);
                 v_a = v_a * beta2_scalar + g.square() * (static_cast<T>(1) - beta2_scalar);
                 var_i -= (m_a * alpha) / (v_a.sqrt() + epsilon_scalar);
+                m_state.Commit();
+                v_state.Commit();
               }
             }
           }
         };
 
         const int64 cost = 1000;
-        auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
-        Shard(worker_threads.num_threads, worker_threads.workers, N, cost, do_work);
+        ShardKvApply<Tindex>(ctx, indices, cost, do_work);
 
         beta1_power_scalar() *= beta1_scalar;
         beta2_power_scalar() *= beta2_scalar;
@@ -2550,12 +2789,6 @@ class KvSparseApplyAdamAsyncGPUOp : public OpKernel {
   explicit KvSparseApplyAdamAsyncGPUOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("apply_sparse_rmsprop", &apply_sparse_rmsprop_));
-
-    int num_worker_threads = ctx->device()
-                             ->tensorflow_cpu_worker_threads()
-                             ->num_threads;
-    thread_copy_id_alloc_.reset(
-        new IntraThreadCopyIdAllocator(num_worker_threads));
   }
 
   void ApplyGradients(
@@ -2736,7 +2969,7 @@ class KvSparseApplyAdamAsyncGPUOp : public OpKernel {
         vars[2] = std::pair<EmbeddingVar<Tindex, T>*, T**>(v, v_ptr);
         GetEmbeddingPointers(ctx, vars, (Tindex*)indices_host_ptr->data(),
                              gs, indices_as_pointer,
-                             counts_index, N, thread_copy_id_alloc_.get());
+                             counts_index, N);
 
         ApplyGradients(
             var, m, v, var_ptr,
@@ -2763,7 +2996,6 @@ class KvSparseApplyAdamAsyncGPUOp : public OpKernel {
  private:
   bool use_exclusive_lock_;
   bool apply_sparse_rmsprop_;
-  std::unique_ptr<IntraThreadCopyIdAllocator> thread_copy_id_alloc_;
 };
 
 #define REGISTER_KERNELS(D, T, Tindices, Tstep)                             \
@@ -2953,8 +3185,7 @@ class KvResourceSparseApplyGradientDescentOp : public OpKernel {
           }
         };
         const int64 cost = 1000;
-        auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
-        Shard(worker_threads.num_threads, worker_threads.workers, N, cost, do_work);
+        ShardKvApply<Tindex>(ctx, indices, cost, do_work);
         if (has_counts && !indices_as_pointer) {
           const Tensor& indices = ctx->input(5);
           var->UpdateCache(indices, indices_counts);
@@ -3143,23 +3374,26 @@ class KvSparseApplyAdamWOp : public OpKernel {
                            &is_filter, indices_as_pointer, count));
             var->UpdateVersion(value_ptr, gs);
             if (is_filter) {
+              auto m_state = m->StateRow(value_ptr, index);
+              auto v_state = v->StateRow(value_ptr, index);
               auto var_i = var->flat(value_ptr, index);
-              auto m_a = m->flat(value_ptr, index);
-              auto v_a = v->flat(value_ptr, index);
+              auto m_a = m_state.flat();
+              auto v_a = v_state.flat();
               auto g = grad_flat.template chip<0>(i);
               // m_a = beta1 * m + (1 - beta1) * g
               m_a += (g - m_a) * (static_cast<T>(1) - beta1_scalar);
               // v_a = beta2 * v + (1 - beta2) * (g * g)
               v_a += (g.square() - v_a) * (static_cast<T>(1) - beta2_scalar);
               var_i -= (m_a * alpha) / (v_a.sqrt() + epsilon_scalar) + weight_decay_scalar * var_i;
+              m_state.Commit();
+              v_state.Commit();
             }
           }
         }
       };
 
       const int64 cost = 1000;
-      auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
-      Shard(worker_threads.num_threads, worker_threads.workers, N, cost, DoWork);
+      ShardKvApply<Tindex>(ctx, indices, cost, DoWork);
       if (has_counts && !indices_as_pointer) {
         const Tensor& indices_counts = ctx->input(13);
         var->UpdateCache(indices, indices_counts);
@@ -3209,12 +3443,6 @@ class KvSparseApplyAdamWGPUOp : public OpKernel {
  public:
   explicit KvSparseApplyAdamWGPUOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
-
-    int num_worker_threads = ctx->device()
-                             ->tensorflow_cpu_worker_threads()
-                             ->num_threads;
-    thread_copy_id_alloc_.reset(
-        new IntraThreadCopyIdAllocator(num_worker_threads));
   }
 
   void ApplyGradients(
@@ -3358,7 +3586,7 @@ class KvSparseApplyAdamWGPUOp : public OpKernel {
         vars[2] = std::pair<EmbeddingVar<Tindex, T>*, T**>(v, v_ptr);
         GetEmbeddingPointers(ctx, vars, indices_flat.data(),
                              gs, indices_as_pointer,
-                             counts_index, N, thread_copy_id_alloc_.get());
+                             counts_index, N);
 
         auto stream = ctx->op_device_context()->stream();
         auto event_mgr = ctx->device()->tensorflow_gpu_device_info()->event_mgr;
@@ -3383,7 +3611,6 @@ class KvSparseApplyAdamWGPUOp : public OpKernel {
 
  private:
   bool use_exclusive_lock_;
-  std::unique_ptr<IntraThreadCopyIdAllocator> thread_copy_id_alloc_;
 };
 
 #define REGISTER_KERNELS(T, Tindices)                                 \
@@ -3455,4 +3682,70 @@ TF_CALL_float(REGISTER_GPU_KERNELS);
 #undef REGISTER_KERNELS
 #endif  // GOOGLE_CUDA
 
+template <typename T, typename Tindices>
+class KvSparseGradientAccumulateOp : public OpKernel {
+ public:
+  explicit KvSparseGradientAccumulateOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    OpInputList grads, indices, counts;
+    OP_REQUIRES_OK(ctx, ctx->input_list("grads", &grads));
+    OP_REQUIRES_OK(ctx, ctx->input_list("indices", &indices));
+    OP_REQUIRES_OK(ctx, ctx->input_list("counts", &counts));
+    OP_REQUIRES(ctx, counts.size() == 0 || counts.size() == grads.size(),
+                errors::InvalidArgument("Expected 0 or ", grads.size(),
+                                        " counts, got ", counts.size()));
+
+    std::vector<SparseGradPush> pushes(grads.size());
+    std::vector<SparseGradPush*> batch;
+    for (int i = 0; i < grads.size(); ++i) {
+      OP_REQUIRES(ctx, TensorShapeUtils::IsVector(indices[i].shape()),
+                  errors::InvalidArgument("indices must be a vector: ",
+                                          indices[i].shape().DebugString()));
+      OP_REQUIRES(ctx, grads[i].dims() >= 1 &&
+                  grads[i].dim_size(0) == indices[i].dim_size(0),
+                  errors::InvalidArgument(
+                      "grad must be the same size as indices in the first "
+                      "dimension: ", grads[i].shape().DebugString(), " vs ",
+                      indices[i].shape().DebugString()));
+      pushes[i].grad = grads[i];
+      pushes[i].indices = indices[i];
+      if (counts.size() > 0) {
+        pushes[i].counts = counts[i];
+      }
+      batch.push_back(&pushes[i]);
+    }
+
+    SparseGradPush merged;
+    OP_REQUIRES_OK(ctx, MergeSparseGradPushes<Tindices, T>(ctx, batch,
+                                                             &merged));
+    ctx->set_output(0, merged.indices);
+    ctx->set_output(1, merged.grad);
+    if (counts.size() > 0) {
+      ctx->set_output(2, merged.counts);
+    } else {
+      Tensor* empty = nullptr;
+      OP_REQUIRES_OK(ctx, ctx->allocate_output(2, TensorShape({0}), &empty));
+    }
+  }
+};
+
+#define REGISTER_KERNELS(T, Tindices)                                 \
+  REGISTER_KERNEL_BUILDER(Name("_KvSparseGradientAccumulate")         \
+                              .Device(DEVICE_CPU)                     \
+                              .TypeConstraint<T>("T")                 \
+                              .TypeConstraint<Tindices>("Tindices"),  \
+                          KvSparseGradientAccumulateOp<T, Tindices>);
+#define REGISTER_CPU_KERNELS(T) \
+  REGISTER_KERNELS(T, int32);   \
+  REGISTER_KERNELS(T, int64);
+
+TF_CALL_float(REGISTER_CPU_KERNELS);
+TF_CALL_double(REGISTER_CPU_KERNELS);
+TF_CALL_bfloat16(REGISTER_CPU_KERNELS);
+
+#undef REGISTER_CPU_KERNELS
+#undef REGISTER_KERNELS
+
 }  // namespace tensorflow
@@ -136,6 +136,12 @@ struct KvSparseApplyAdagradHbm<GPUDevice, TKey, T> {
   }
 };
 
+// The fused Adam kernels update a row per warp.
+inline int64 FusedApplyGridSize(int block_size, int64 task_size) {
+  const int rows_per_block = block_size / 32;
+  return (task_size + rows_per_block - 1) / rows_per_block;
+}
+
 template <typename TKey, typename T>
 struct KvSparseApplyAdamHbm<GPUDevice, TKey, T> {
   void operator()(int block_size, int embedding_dim,
@@ -144,11 +150,11 @@ struct KvSparseApplyAdamHbm<GPUDevice, TKey, T> {
                   T beta1, T beta2, T epsilon, int64 task_size,
                   const GPUDevice& device) {
     TF_CHECK_OK(GpuLaunchKernel(
-        SparseApplyAdamGPU<T>,
-        (task_size + block_size - 1) / block_size * embedding_dim,
+        FusedSparseApplyAdamGPU<T>,
+        FusedApplyGridSize(block_size, task_size),
         block_size, 0, device.stream(),
         dev_var, dev_m, dev_v, grad_base,
-        alpha, beta1, beta2, epsilon,
+        alpha, beta1, beta2, epsilon, static_cast<T>(0),
         embedding_dim, task_size));
   }
 };
@@ -162,13 +168,17 @@ struct KvSparseApplyAdamAsyncHbm<GPUDevice, TKey, T> {
                   T* beta2_power_ptr, int64 task_size,
                   const GPUDevice& device) {
     TF_CHECK_OK(GpuLaunchKernel(
-        SparseApplyAdamAsyncGPU<T>,
-        (task_size + block_size - 1) / block_size * embedding_dim,
+        FusedSparseApplyAdamAsyncGPU<T>,
+        FusedApplyGridSize(block_size, task_size),
         block_size, 0, device.stream(),
         dev_var, dev_m, dev_v, grad_base,
         lr, beta1, beta2, epsilon,
         beta1_power_ptr, beta2_power_ptr,
         embedding_dim, task_size));
+    // Advanced by a kernel of its own, as the blocks above aren't ordered.
+    TF_CHECK_OK(GpuLaunchKernel(
+        UpdateBetaPowersGPU<T>, 1, 1, 0, device.stream(),
+        beta1_power_ptr, beta2_power_ptr, beta1, beta2));
   }
 };
 
@@ -197,8 +207,8 @@ struct KvSparseApplyAdamWHbm<GPUDevice, TKey, T> {
                   T beta2, T epsilon, T weight_decay,
                   int64 task_size, const GPUDevice& device) {
     TF_CHECK_OK(GpuLaunchKernel(
-        SparseApplyAdamWGPU<T>,
-        (task_size + block_size - 1) / block_size * embedding_dim,
+        FusedSparseApplyAdamGPU<T>,
+        FusedApplyGridSize(block_size, task_size),
         block_size, 0, device.stream(),
         dev_var, dev_m, dev_v, grad_base,
         lr, beta1, beta2, epsilon,
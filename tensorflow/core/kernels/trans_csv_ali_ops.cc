@@ -46,23 +46,34 @@
 //     TransCsvToDenseOp: normal CSV number string to Dense matrix tensor.
 //             input arguments: "records", "max_id"
 //             attribute arguments: "T", "field_delim".
+//             Also decoded on GPU, see TransCsvToDenseGpuOp.
 //         example:
 //             Input: records(["0.2,0.1","-0.3","0.4,0.2"]), max_id(4)
 //             Attr: T(DT_FLOAT32), field_delim(',')
 //             Output: [[0.1,0.2,0.0,0.0],[-0.3,0.0,0.0,0.0],[0.4,0.2,0.0,0.0]]
 //
 
+#if GOOGLE_CUDA
+#define EIGEN_USE_GPU
+#endif  // GOOGLE_CUDA
+
 #include <algorithm>
 #include <cmath>
 #include <vector>
 #include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/trans_csv_ali_ops.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/util/work_sharder.h"
 
+#if GOOGLE_CUDA
+#include "tensorflow/core/platform/stream_executor.h"
+#endif  // GOOGLE_CUDA
+
 #define OP_CHECK_STATUS(OBJ, MU, EXP, STATUS) \
 if (!TF_PREDICT_TRUE(EXP)) {                  \
   mutex_lock l((MU));                         \
@@ -958,4 +969,125 @@ REGISTER_KERNEL_BUILDER(Name("TransCsvKV2Sparse").Device(DEVICE_CPU), TransCsvKV
 REGISTER_KERNEL_BUILDER(Name("TransCsvKV2Dense").Device(DEVICE_CPU), TransCsvKV2DenseOp);
 REGISTER_KERNEL_BUILDER(Name("TransCsvToDense").Device(DEVICE_CPU), TransCsvToDenseOp);
 
+#if GOOGLE_CUDA
+// TransCsvToDenseOp on GPU. The records are packed into one pinned buffer
+// and copied to the device at once, the columns are found and parsed on the
+// device and the output stays in device memory. Only the number of columns
+// and the first invalid record are copied back, to shape the output.
+template <typename T>
+class TransCsvToDenseGpuOp : public OpKernel {
+ public:
+  explicit TransCsvToDenseGpuOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    string delim;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("field_delim", &delim));
+    OP_REQUIRES(ctx, (delim.size() == 1 && DelimSupported(delim[0])),
+        errors::InvalidArgument("field_delim is not one char or not supported."));
+    delim_ = delim[0];
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor* records;
+    OP_REQUIRES_OK(ctx, ctx->input("records", &records));
+
+    const Tensor* max_id_tensor;
+    OP_REQUIRES_OK(ctx, ctx->input("max_id", &max_id_tensor));
+    int64 max_id = max_id_tensor->scalar<int64>()();
+    OP_REQUIRES(ctx, (max_id >= 0 || max_id == ID_AUTO_DETECT_TAG),
+                errors::InvalidArgument("invalid max_id setting: ", max_id));
+
+    auto records_t = records->flat<string>();
+    const int64 batch_size = records_t.size();
+
+    // Layout of the buffer: offsets of the records (batch_size + 1), stats
+    // (2) and the chars of the records.
+    const int64 header_size = (batch_size + 3) * sizeof(int64);
+    int64 buffer_size = header_size;
+    for (int64 batch_id = 0; batch_id < batch_size; ++batch_id) {
+      buffer_size += records_t(batch_id).size();
+    }
+    AllocatorAttributes host_attr;
+    host_attr.set_on_host(true);
+    host_attr.set_gpu_compatible(true);
+    Tensor host_buffer;
+    OP_REQUIRES_OK(ctx, ctx->allocate_temp(DT_INT8, TensorShape({buffer_size}),
+                                           &host_buffer, host_attr));
+    char* host_data = reinterpret_cast<char*>(host_buffer.flat<int8>().data());
+    int64* offsets = reinterpret_cast<int64*>(host_data);
+    uint64* stats = reinterpret_cast<uint64*>(offsets + batch_size + 1);
+    offsets[0] = 0;
+    for (int64 batch_id = 0; batch_id < batch_size; ++batch_id) {
+      const string& record = records_t(batch_id);
+      memcpy(host_data + header_size + offsets[batch_id], record.data(),
+             record.size());
+      offsets[batch_id + 1] = offsets[batch_id] + record.size();
+    }
+    stats[0] = 0;
+    stats[1] = batch_size;
+
+    Tensor device_buffer;
+    OP_REQUIRES_OK(ctx, ctx->allocate_temp(DT_INT8, TensorShape({buffer_size}),
+                                           &device_buffer));
+    char* device_data =
+        reinterpret_cast<char*>(device_buffer.flat<int8>().data());
+    const int64* device_offsets = reinterpret_cast<const int64*>(device_data);
+    uint64* device_stats =
+        reinterpret_cast<uint64*>(device_data) + batch_size + 1;
+
+    auto* stream = ctx->op_device_context()->stream();
+    OP_REQUIRES(ctx, stream, errors::Internal("No GPU stream available."));
+    se::DeviceMemoryBase device_mem(device_data, buffer_size);
+    OP_REQUIRES(ctx,
+                stream->ThenMemcpy(&device_mem, host_data, buffer_size).ok(),
+                errors::Internal("Failed to launch copy from host to device."));
+
+    const GPUDevice& d = ctx->eigen_device<GPUDevice>();
+    functor::TransCsvToDense<GPUDevice, T> decode;
+    decode.Count(d, device_data + header_size, device_offsets, batch_size,
+                 delim_, device_stats);
+    se::DeviceMemoryBase device_stats_mem(device_stats, 2 * sizeof(uint64));
+    OP_REQUIRES(ctx,
+                stream->ThenMemcpy(stats, device_stats_mem,
+                                   2 * sizeof(uint64)).ok(),
+                errors::Internal("Failed to launch copy from device to host."));
+    OP_REQUIRES_OK(ctx, stream->BlockHostUntilDone());
+
+    const int64 invalid_id = stats[1];
+    OP_REQUIRES(ctx, invalid_id == batch_size,
+                errors::InvalidArgument("values in record ", invalid_id,
+                    " is not valid : ",
+                    invalid_id < batch_size ? records_t(invalid_id) : ""));
+    const int64 max_col_id = stats[0];
+    if (max_id == ID_AUTO_DETECT_TAG) {
+      max_id = max_col_id;
+    } else {
+      OP_REQUIRES(ctx, max_id >= max_col_id,
+                  errors::InvalidArgument("max_id set as ", max_id,
+                      " but less then real maximum col id ", max_col_id));
+    }
+
+    Tensor* values = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(
+        0, TensorShape({batch_size, max_id}), &values));
+    decode(d, device_data + header_size, device_offsets, batch_size, delim_,
+           max_id, values->flat<T>().data());
+  }
+
+ private:
+  typedef Eigen::GpuDevice GPUDevice;
+  char delim_;
+};
+
+#define REGISTER_GPU_KERNELS(type)                          \
+  REGISTER_KERNEL_BUILDER(Name("TransCsvToDense")           \
+                              .Device(DEVICE_GPU)           \
+                              .HostMemory("records")        \
+                              .HostMemory("max_id")         \
+                              .TypeConstraint<type>("T"),   \
+                          TransCsvToDenseGpuOp<type>);
+TF_CALL_int32(REGISTER_GPU_KERNELS);
+TF_CALL_int64(REGISTER_GPU_KERNELS);
+TF_CALL_float(REGISTER_GPU_KERNELS);
+#undef REGISTER_GPU_KERNELS
+#endif  // GOOGLE_CUDA
+
 }  // namespace tensorflow
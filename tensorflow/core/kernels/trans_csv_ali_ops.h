@@ -0,0 +1,35 @@
+// Copyright (c) 2017, Alibaba Inc.
+// All right reserved.
+//
+// Description
+//     Device functors of TransCsvToDenseOp.
+//
+
+#ifndef TENSORFLOW_CORE_KERNELS_TRANS_CSV_ALI_OPS_H_
+#define TENSORFLOW_CORE_KERNELS_TRANS_CSV_ALI_OPS_H_
+
+#include "tensorflow/core/framework/types.h"
+
+namespace tensorflow {
+namespace functor {
+
+// Records are packed into data, record i is data[offsets[i], offsets[i+1]).
+// The numbers are parsed the same as SplitNum of trans_csv_ali_ops.cc.
+template <typename Device, typename T>
+struct TransCsvToDense {
+  // Sets stats[0] to the maximum number of columns of the records and
+  // stats[1] to the first invalid record, stats must be {0, batch_size}
+  // before.
+  void Count(const Device& d, const char* data, const int64* offsets,
+             int64 batch_size, char delim, uint64* stats);
+
+  // Writes the records to the batch_size x max_id matrix output, the
+  // records must be valid and have no more than max_id columns.
+  void operator()(const Device& d, const char* data, const int64* offsets,
+                  int64 batch_size, char delim, int64 max_id, T* output);
+};
+
+}  // namespace functor
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_TRANS_CSV_ALI_OPS_H_
@@ -0,0 +1,232 @@
+// Copyright (c) 2017, Alibaba Inc.
+// All right reserved.
+//
+// Description
+//     GPU kernels of TransCsvToDenseOp. Every record is decoded by one warp,
+//     the lanes look for the starts of the columns of 32 chars at a time and
+//     every lane parses the column starting at its char, so the columns of a
+//     record are parsed in parallel and written to the output directly.
+//
+
+#if GOOGLE_CUDA
+#define EIGEN_USE_GPU
+
+#include <algorithm>
+
+#include "tensorflow/core/kernels/trans_csv_ali_ops.h"
+#include "tensorflow/core/util/gpu_kernel_helper.h"
+
+namespace tensorflow {
+
+typedef Eigen::GpuDevice GPUDevice;
+
+namespace {
+
+const int kWarpSize = 32;
+const int kThreadsPerBlock = 256;
+const int kWarpsPerBlock = kThreadsPerBlock / kWarpSize;
+
+__device__ inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Same as GetValueOnTheFly of trans_csv_ali_ops.cc, without reading past the
+// record.
+__device__ bool ParseValue(const char* input, int64 size, int64* pos,
+                           int64* value) {
+  int64 p = *pos;
+  int64 sign = 1;
+  if (p < size && input[p] == '-') {
+    sign = -1;
+    ++p;
+  } else if (p < size && input[p] == '+') {
+    ++p;
+  }
+  if (p >= size || !IsDigit(input[p])) {
+    return false;
+  }
+  int64 v = 0;
+  while (p < size && IsDigit(input[p])) {
+    v = v * 10 + input[p] - '0';
+    ++p;
+  }
+  *value = v * sign;
+  *pos = p;
+  return true;
+}
+
+__device__ bool ParseValue(const char* input, int64 size, int64* pos,
+                           int32* value) {
+  int64 v;
+  if (ParseValue(input, size, pos, &v)) {
+    *value = static_cast<int32>(v);
+    return true;
+  }
+  return false;
+}
+
+// The roundings are explicit so that the digits accumulate as they do on
+// CPU, only the scaling of an exponent may differ in the last bits.
+__device__ bool ParseValue(const char* input, int64 size, int64* pos,
+                           float* value) {
+  const float log2_10 = 3.32192809488736234787f;
+  int64 p = *pos;
+  if (p >= size) {
+    return false;
+  }
+  float fsign = 1.0f;
+  float ftail = 0.1f;
+  float v = 0.0f;
+  bool gotvalue = false;
+  if (input[p] == '-') {
+    fsign = -1.0f;
+    ++p;
+  } else if (input[p] == '+') {
+    ++p;
+  }
+  while (p < size && IsDigit(input[p])) {
+    v = __fadd_rn(__fmul_rn(v, 10.0f), static_cast<float>(input[p] - '0'));
+    gotvalue = true;
+    ++p;
+  }  // integer part
+  if (p < size && input[p] == '.') {
+    ++p;
+    while (p < size && IsDigit(input[p])) {
+      v = __fadd_rn(v, __fmul_rn(ftail, static_cast<float>(input[p] - '0')));
+      ftail = __fmul_rn(ftail, 0.1f);
+      gotvalue = true;
+      ++p;
+    }
+  }  // fraction part
+  if (!gotvalue) {
+    return false;
+  }
+  v *= fsign;
+  if (p < size && (input[p] == 'E' || input[p] == 'e')) {
+    ++p;
+    int64 fexp_int = 0;
+    if (p >= size || !ParseValue(input, size, &p, &fexp_int)) {
+      return false;
+    }
+    v *= exp2f(static_cast<float>(fexp_int) * log2_10);
+  }  // exponent part
+  *value = v;
+  *pos = p;
+  return true;
+}
+
+// Parses the column starting at pos as SplitNum does.
+template <typename T>
+__device__ bool ParseColumn(const char* input, int64 size, int64 pos,
+                            char delim, T* value) {
+  if (delim != ' ') {
+    while (pos < size && input[pos] == ' ') {
+      ++pos;
+    }
+  }
+  if (!ParseValue(input, size, &pos, value)) {
+    return false;
+  }
+  if (delim != ' ') {
+    while (pos < size && input[pos] == ' ') {
+      ++pos;
+    }
+  }
+  return pos == size || input[pos] == delim;
+}
+
+// A column starts after every delim, but an empty column at the end of the
+// record doesn't count. Runs of spaces are one delim when delim is ' '.
+__device__ inline bool IsColumnStart(const char* input, int64 pos,
+                                     char delim) {
+  if (delim == ' ') {
+    return input[pos] != ' ' && (pos == 0 || input[pos - 1] == ' ');
+  }
+  return pos == 0 || input[pos - 1] == delim;
+}
+
+template <typename T, bool kWrite>
+__global__ void TransCsvToDenseKernel(const char* data, const int64* offsets,
+                                      int64 batch_size, char delim,
+                                      int64 max_id, T* output,
+                                      uint64* stats) {
+  const int lane = threadIdx.x % kWarpSize;
+  const int64 num_warps = static_cast<int64>(gridDim.x) * kWarpsPerBlock;
+  for (int64 row = static_cast<int64>(blockIdx.x) * kWarpsPerBlock +
+                   threadIdx.x / kWarpSize;
+       row < batch_size; row += num_warps) {
+    const char* input = data + offsets[row];
+    const int64 size = offsets[row + 1] - offsets[row];
+    int64 cols = 0;
+    bool valid = true;
+    for (int64 base = 0; base < size; base += kWarpSize) {
+      const int64 pos = base + lane;
+      const bool start = pos < size && IsColumnStart(input, pos, delim);
+      const unsigned starts = GpuBallotSync(kGpuWarpAll, start);
+      if (start) {
+        const int64 col = cols + __popc(starts & ((1u << lane) - 1));
+        T value;
+        if (!ParseColumn(input, size, pos, delim, &value)) {
+          valid = false;
+        } else if (kWrite) {
+          output[row * max_id + col] = value;
+        }
+      }
+      cols += __popc(starts);
+    }
+    if (kWrite) {
+      for (int64 col = cols + lane; col < max_id; col += kWarpSize) {
+        output[row * max_id + col] = static_cast<T>(0);
+      }
+    } else {
+      valid = GpuAllSync(kGpuWarpAll, valid);
+      if (lane == 0) {
+        GpuAtomicMax(stats, static_cast<uint64>(cols));
+        if (!valid) {
+          GpuAtomicMin(stats + 1, static_cast<uint64>(row));
+        }
+      }
+    }
+  }
+}
+
+int NumBlocks(const GPUDevice& d, int64 batch_size) {
+  const int64 max_blocks = static_cast<int64>(d.getNumGpuMultiProcessors()) *
+                           d.maxGpuThreadsPerMultiProcessor() /
+                           kThreadsPerBlock;
+  return std::max<int64>(
+      1, std::min<int64>(max_blocks,
+                         (batch_size + kWarpsPerBlock - 1) / kWarpsPerBlock));
+}
+
+}  // namespace
+
+namespace functor {
+
+template <typename T>
+struct TransCsvToDense<GPUDevice, T> {
+  void Count(const GPUDevice& d, const char* data, const int64* offsets,
+             int64 batch_size, char delim, uint64* stats) {
+    if (batch_size == 0) return;
+    TF_CHECK_OK(GpuLaunchKernel(TransCsvToDenseKernel<T, false>,
+                                NumBlocks(d, batch_size), kThreadsPerBlock, 0,
+                                d.stream(), data, offsets, batch_size, delim,
+                                0, nullptr, stats));
+  }
+
+  void operator()(const GPUDevice& d, const char* data, const int64* offsets,
+                  int64 batch_size, char delim, int64 max_id, T* output) {
+    if (batch_size == 0 || max_id == 0) return;
+    TF_CHECK_OK(GpuLaunchKernel(TransCsvToDenseKernel<T, true>,
+                                NumBlocks(d, batch_size), kThreadsPerBlock, 0,
+                                d.stream(), data, offsets, batch_size, delim,
+                                max_id, output, nullptr));
+  }
+};
+
+template struct TransCsvToDense<GPUDevice, int32>;
+template struct TransCsvToDense<GPUDevice, int64>;
+template struct TransCsvToDense<GPUDevice, float>;
+
+}  // namespace functor
+}  // namespace tensorflow
+
+#endif  // GOOGLE_CUDA
@@ -8,6 +8,7 @@
 //     Unit test cases for TransCSVxxxOp.
 //
 
+#include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/fake_input.h"
 #include "tensorflow/core/framework/node_def_builder.h"
@@ -919,6 +920,121 @@ TEST_F(TransCsvToDenseTest, MaxIdNotBigEnough) {
   EXPECT_EQ(::tensorflow::error::INVALID_ARGUMENT, RunOpKernel().code());
 }
 
+#if GOOGLE_CUDA
+class TransCsvToDenseGpuTest : public TransCsvToDenseTest {
+ protected:
+  void CreateGpuOp(DataType dtype, string delim) {
+    CreateOp(dtype, delim);
+    SetDevice(DEVICE_GPU,
+              std::unique_ptr<tensorflow::Device>(DeviceFactory::NewDevice(
+                  "GPU", {}, "/job:a/replica:0/task:0")));
+  }
+};
+
+TEST_F(TransCsvToDenseGpuTest, NormalProcess_int32) {
+  CreateGpuOp(DT_INT32, ",");
+  TF_ASSERT_OK(InitOp());
+
+  // input records
+  AddInputFromArray<string>(TensorShape({3}), {
+                            "1,  -2 ,  4, 10",
+                            "",
+                            "-24,84, 96, -0,"});
+  // max_id
+  AddInputFromArray<int64>(TensorShape({}), {-1048575});
+
+  TF_ASSERT_OK(RunOpKernel());
+  TF_EXPECT_OK(device_->Sync());
+
+  Tensor expected_values(allocator(), DT_INT32, {3, 4});
+  test::FillValues<int32>(&expected_values, {
+                             1, -2, 4, 10,
+                             0, 0, 0, 0,
+                             -24, 84, 96, 0});
+  test::ExpectTensorEqual<int32>(expected_values, *GetOutput(0));
+}
+
+TEST_F(TransCsvToDenseGpuTest, LongRecords_int64) {
+  CreateGpuOp(DT_INT64, " ");
+  TF_ASSERT_OK(InitOp());
+
+  // Records longer than a warp, the columns spread over several chunks.
+  std::vector<string> records(64);
+  std::vector<int64> expected(64 * 40, 0);
+  for (int i = 0; i < 64; ++i) {
+    for (int j = 0; j < i % 40; ++j) {
+      records[i] += strings::Printf("  %d", i * 1000 + j);
+      expected[i * 40 + j] = i * 1000 + j;
+    }
+  }
+  AddInputFromArray<string>(TensorShape({64}), records);
+  // max_id
+  AddInputFromArray<int64>(TensorShape({}), {40});
+
+  TF_ASSERT_OK(RunOpKernel());
+  TF_EXPECT_OK(device_->Sync());
+
+  Tensor expected_values(allocator(), DT_INT64, {64, 40});
+  test::FillValues<int64>(&expected_values, expected);
+  test::ExpectTensorEqual<int64>(expected_values, *GetOutput(0));
+}
+
+TEST_F(TransCsvToDenseGpuTest, NormalProcess_float) {
+  CreateGpuOp(DT_FLOAT, "~");
+  TF_ASSERT_OK(InitOp());
+
+  // input records
+  AddInputFromArray<string>(TensorShape({4}), {
+                            "0.1~ 0.2~  0.4~ 1.0",
+                            "+0.99E-01 ~-.24~ 0.84 ",
+                            "",
+                            ""});
+  // max_id
+  AddInputFromArray<int64>(TensorShape({}), {5});
+
+  TF_ASSERT_OK(RunOpKernel());
+  TF_EXPECT_OK(device_->Sync());
+
+  Tensor expected_values(allocator(), DT_FLOAT, {4, 5});
+  test::FillValues<float>(&expected_values, {
+                             0.1, 0.2, 0.4, 1.0, 0.,
+                             0.099, -0.24, 0.84, 0., 0.,
+                             0., 0., 0., 0., 0.,
+                             0., 0., 0., 0., 0.});
+  test::ExpectTensorNear<float>(expected_values, *GetOutput(0), 1e-6);
+}
+
+TEST_F(TransCsvToDenseGpuTest, InvalidValue) {
+  CreateGpuOp(DT_FLOAT, ",");
+  TF_ASSERT_OK(InitOp());
+
+  // input records
+  AddInputFromArray<string>(TensorShape({3}), {
+                            "0.1, 2, 0.4 1.0",
+                            "0.22, 0.33, 0.99",
+                            "0.99 ,, 0.84 "});
+  // max_id
+  AddInputFromArray<int64>(TensorShape({}), {12});
+
+  EXPECT_EQ(::tensorflow::error::INVALID_ARGUMENT, RunOpKernel().code());
+}
+
+TEST_F(TransCsvToDenseGpuTest, MaxIdNotBigEnough) {
+  CreateGpuOp(DT_FLOAT, ",");
+  TF_ASSERT_OK(InitOp());
+
+  // input records
+  AddInputFromArray<string>(TensorShape({3}), {
+                            "0.1,  0.2,  0.4, 1.0",
+                            "0.22, 0.33, 0.99",
+                            "0.99 ,0.24, 0.84 "});
+  // max_id
+  AddInputFromArray<int64>(TensorShape({}), {3});
+
+  EXPECT_EQ(::tensorflow::error::INVALID_ARGUMENT, RunOpKernel().code());
+}
+#endif  // GOOGLE_CUDA
+
 
 template <typename T>
 static Graph* CsvID2Sparse(Tensor& records_t) {
@@ -990,6 +1106,22 @@ static Graph* CsvKV2Dense(Tensor& records_t) {
   return g;
 }
 
+template <typename T>
+static Graph* CsvToDense(Tensor& records_t) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor zerol(DT_INT64, TensorShape({}));
+  zerol.flat<int64>()(0) = static_cast<int64>(-1048575);
+  Node *node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("op"), "TransCsvToDense")
+                  .Input(test::graph::HostConstant(g, records_t))
+                  .Input(test::graph::HostConstant(g, zerol))
+                  .Attr("T", DataTypeToEnum<T>::v())
+                  .Attr("field_delim", ",")
+                  .Finalize(g, &node));
+
+  return g;
+}
+
 }  // namespace
 
 #define BM_INDEX(T, KIND, B, C, S, NTH)                                        \
@@ -1092,4 +1224,34 @@ BM_KV(float, Dense, 128, 338, 4, 16);
 BM_KV(float, Dense, 1280, 338, 4, 16);
 BM_KV(float, Dense, 2000, 338, 5, 16);
 
+#define BM_TO_DENSE(T, B, C, DEVICE)                                           \
+  static void BM_Csv_ToDense_##T##_##B##_##C##_##DEVICE(int iters) {           \
+    testing::StopTiming();                                                     \
+    testing::ItemsProcessed(static_cast<int64>(iters) * B * C);                \
+    std::string label("ToDense_"#T" : Batch "#B" on "#DEVICE);                 \
+    testing::SetLabel(label);                                                  \
+    testing::UseRealTime();                                                    \
+    Tensor records_t(DT_STRING, TensorShape({B}));                             \
+    auto records = records_t.flat<string>();                                   \
+    for (int i = 0; i < (B); ++i) {                                            \
+      std::string line;                                                        \
+      for (int j = 0; j < (C) - 1 ; ++j) {                                     \
+        line += strings::Printf(" %d.25 ,", j);                                \
+      }                                                                        \
+      line += strings::Printf(" %d.25", (C) - 1);                              \
+      records(i) = line;                                                       \
+    }                                                                          \
+    auto g = CsvToDense<T>(records_t);                                         \
+    testing::StartTiming();                                                    \
+    test::Benchmark(#DEVICE, g).Run(iters);                                    \
+  }                                                                            \
+  BENCHMARK(BM_Csv_ToDense_##T##_##B##_##C##_##DEVICE);
+
+BM_TO_DENSE(float, 1280, 128, cpu);
+BM_TO_DENSE(float, 12800, 128, cpu);
+#if GOOGLE_CUDA
+BM_TO_DENSE(float, 1280, 128, gpu);
+BM_TO_DENSE(float, 12800, 128, gpu);
+#endif  // GOOGLE_CUDA
+
 }  // namespace tensorflow
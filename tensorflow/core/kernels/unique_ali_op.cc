@@ -40,6 +40,7 @@ const char* kMultiMapString = "MULTIMAP";
 const char* kStlHashMapString = "STL";
 const char* kAbslHashMapString = "ABSL";
 const char* kGoogleHashMapString = "GOOGLE";
+const char* kPartitionHashMapString = "PARTITION";
 const int64 kDefaultUniqueRatioHint = 4;
 }
 
@@ -65,7 +66,8 @@ class UniqueAliOp : public OpKernel {
     //     "MULTIMAP" for multimap parrallel process,
     //     "STL" for std::unordred_map,
     //     "ABSL" for absl::flat_hash_map,
-    //     "GOOGLE" for google::dense_hash_map.
+    //     "GOOGLE" for google::dense_hash_map,
+    //     "PARTITION" for radix partitioned parallel process of integers.
     std::string hash_map_str;
     OP_REQUIRES_OK(context, ReadStringFromEnvVar(kUniqueOpHashMapEnv,
                                                  kGoogleHashMapString,
@@ -92,6 +94,8 @@ class UniqueAliOp : public OpKernel {
       map_flag_ = ABSL;
     } else if (!hash_map_str.compare(kGoogleHashMapString)) {
       map_flag_ = GOOGLE;
+    } else if (!hash_map_str.compare(kPartitionHashMapString)) {
+      map_flag_ = PARTITION;
     } else {
       map_flag_ = GOOGLE;
     }
@@ -179,6 +183,92 @@ TF_CALL_REAL_NUMBER_TYPES(REGISTER_UNIQUE);
 REGISTER_UNIQUE(string)
 #undef REGISTER_UNIQUE
 
+// Unique with the unique keys grouped by partition, key mod num_partitions,
+// in the order of their first occurrence within a partition.
+template <typename T, typename TIndex>
+class UniqueWithPartitionsOp : public OpKernel {
+ public:
+  explicit UniqueWithPartitionsOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("num_partitions",
+                                             &num_partitions_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& input = context->input(0);
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(input.shape()),
+                errors::InvalidArgument("unique expects a 1D vector."));
+    auto x = input.vec<T>();
+    const int64 N = x.size();
+
+    auto partition = [this](T key) {
+      const int64 p = static_cast<int64>(key) % num_partitions_;
+      return p < 0 ? p + num_partitions_ : p;
+    };
+    // The rank of a key within its partition.
+    absl::flat_hash_map<T, TIndex> ranks;
+    ranks.reserve(N / kDefaultUniqueRatioHint);
+    std::vector<std::vector<T>> keys(num_partitions_);
+    std::vector<std::vector<TIndex>> counts(num_partitions_);
+    std::vector<TIndex> key_ranks(N);
+    for (int64 i = 0; i < N; ++i) {
+      const int64 p = partition(x(i));
+      auto it = ranks.emplace(x(i), keys[p].size());
+      if (it.second) {
+        keys[p].push_back(x(i));
+        counts[p].push_back(0);
+      }
+      key_ranks[i] = it.first->second;
+      ++counts[p][key_ranks[i]];
+    }
+
+    std::vector<TIndex> offsets(num_partitions_ + 1, 0);
+    for (int p = 0; p < num_partitions_; ++p) {
+      offsets[p + 1] = offsets[p] + keys[p].size();
+    }
+    const int64 uniq_size = offsets[num_partitions_];
+    Tensor* output = nullptr;
+    Tensor* idx = nullptr;
+    Tensor* output_counter = nullptr;
+    Tensor* partition_sizes = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, {uniq_size}, &output));
+    OP_REQUIRES_OK(context, context->allocate_output(1, {N}, &idx));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(2, {uniq_size}, &output_counter));
+    OP_REQUIRES_OK(context, context->allocate_output(3, {num_partitions_},
+                                                     &partition_sizes));
+    T* y = output->flat<T>().data();
+    TIndex* count = output_counter->flat<TIndex>().data();
+    for (int p = 0; p < num_partitions_; ++p) {
+      std::copy(keys[p].begin(), keys[p].end(), y + offsets[p]);
+      std::copy(counts[p].begin(), counts[p].end(), count + offsets[p]);
+      partition_sizes->vec<TIndex>()(p) = keys[p].size();
+    }
+    auto idx_vec = idx->vec<TIndex>();
+    for (int64 i = 0; i < N; ++i) {
+      idx_vec(i) = offsets[partition(x(i))] + key_ranks[i];
+    }
+  }
+
+ private:
+  int num_partitions_;
+};
+
+#define REGISTER_UNIQUE_WITH_PARTITIONS(type)                    \
+  REGISTER_KERNEL_BUILDER(Name("UniqueWithPartitions")           \
+                              .Device(DEVICE_CPU)                \
+                              .TypeConstraint<type>("T")         \
+                              .TypeConstraint<int32>("out_idx"), \
+                          UniqueWithPartitionsOp<type, int32>);  \
+  REGISTER_KERNEL_BUILDER(Name("UniqueWithPartitions")           \
+                              .Device(DEVICE_CPU)                \
+                              .TypeConstraint<type>("T")         \
+                              .TypeConstraint<int64>("out_idx"), \
+                          UniqueWithPartitionsOp<type, int64>)
+TF_CALL_int32(REGISTER_UNIQUE_WITH_PARTITIONS);
+TF_CALL_int64(REGISTER_UNIQUE_WITH_PARTITIONS);
+#undef REGISTER_UNIQUE_WITH_PARTITIONS
+
 #if GOOGLE_CUDA
 #define REGISTER_UNIQUE(type)                                    \
   REGISTER_KERNEL_BUILDER(Name("UniqueWithCounts")               \
@@ -16,6 +16,7 @@ limitations under the License.
 #define EIGEN_USE_GPU
 
 #include <bitset>
+#include <limits>
 #include "cub/device/device_radix_sort.cuh"
 #include "cub/device/device_scan.cuh"
 #include "cub/iterator/constant_input_iterator.cuh"
@@ -238,6 +239,228 @@ class UniqueAliV2GpuOp : public AsyncOpKernel {
   }
 };
 
+// The partition of a key, key mod num_partitions.
+template <typename T>
+__device__ __forceinline__ int PartitionOfKey(const T key,
+                                              const int num_partitions) {
+  const int p = static_cast<int64>(key) % num_partitions;
+  return p < 0 ? p + num_partitions : p;
+}
+
+// The finalizer of MurmurHash3, the slots of consecutive keys scattered.
+template <typename T>
+__device__ __forceinline__ uint64 HashOfKey(const T key) {
+  uint64 h = static_cast<uint64>(key);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// Inserts the keys into an open addressing table of capacity mask + 1,
+// whose slots hold the position of a key in keys, -1 if empty. Counts the
+// occurrences of the key of each slot and records the slot of each key.
+template <typename T>
+__global__ void InsertKeysKernel(const T* keys, const int64 size,
+                                 const int64 mask, int* slots,
+                                 int* slot_counts, int* key_slots) {
+  GPU_1D_KERNEL_LOOP(i, size) {
+    const T key = ldg(keys + i);
+    int64 slot = HashOfKey(key) & mask;
+    while (true) {
+      const int holder = atomicCAS(slots + slot, -1, static_cast<int>(i));
+      if (holder == -1 || ldg(keys + holder) == key) {
+        break;
+      }
+      slot = (slot + 1) & mask;
+    }
+    atomicAdd(slot_counts + slot, 1);
+    key_slots[i] = slot;
+  }
+}
+
+// Ranks the keys of the occupied slots within their partitions, counting
+// the keys of each partition.
+template <typename T>
+__global__ void RankSlotsKernel(const T* keys, const int* slots,
+                                const int64 capacity,
+                                const int num_partitions,
+                                int* partition_sizes, int* slot_ranks) {
+  GPU_1D_KERNEL_LOOP(slot, capacity) {
+    const int holder = ldg(slots + slot);
+    if (holder != -1) {
+      const int p = PartitionOfKey(ldg(keys + holder), num_partitions);
+      slot_ranks[slot] = atomicAdd(partition_sizes + p, 1);
+    }
+  }
+}
+
+__global__ void PartitionOffsetsKernel(const int* partition_sizes,
+                                       const int num_partitions,
+                                       int* offsets) {
+  offsets[0] = 0;
+  for (int p = 0; p < num_partitions; ++p) {
+    offsets[p + 1] = offsets[p] + partition_sizes[p];
+  }
+}
+
+// Writes the key and the count of each occupied slot to its position in
+// the output, offsets[p] plus its rank, which replaces the rank.
+template <typename T, typename TIndex>
+__global__ void ScatterSlotsKernel(const T* keys, const int* slots,
+                                   const int* slot_counts,
+                                   const int* offsets, const int64 capacity,
+                                   const int num_partitions, int* slot_ranks,
+                                   T* output, TIndex* count) {
+  GPU_1D_KERNEL_LOOP(slot, capacity) {
+    const int holder = ldg(slots + slot);
+    if (holder != -1) {
+      const T key = ldg(keys + holder);
+      const int pos = ldg(offsets + PartitionOfKey(key, num_partitions)) +
+                      slot_ranks[slot];
+      output[pos] = key;
+      count[pos] = ldg(slot_counts + slot);
+      slot_ranks[slot] = pos;
+    }
+  }
+}
+
+template <typename TIndex>
+__global__ void GatherIndicesKernel(const int* key_slots,
+                                    const int* slot_positions,
+                                    const int64 size, TIndex* idx) {
+  GPU_1D_KERNEL_LOOP(i, size) {
+    idx[i] = ldg(slot_positions + ldg(key_slots + i));
+  }
+}
+
+// UniqueWithPartitions on a hash table rather than on a radix sort: the
+// keys are inserted into an open addressing table of at least twice as
+// many slots, whose occupied slots are ranked within the partitions of
+// their keys, and then written to the output grouped by partition. Only
+// the number of unique keys of each partition is copied to the host, to
+// allocate the outputs.
+template <typename T, typename TIndex>
+class UniqueWithPartitionsGpuOp : public OpKernel {
+ public:
+  explicit UniqueWithPartitionsGpuOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_partitions", &num_partitions_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& input_tensor = ctx->input(0);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsVector(input_tensor.shape()),
+                errors::InvalidArgument("unique expects a 1D vector."));
+    const T* keys = input_tensor.flat<T>().data();
+    const int64 N = input_tensor.NumElements();
+    OP_REQUIRES(ctx, N <= std::numeric_limits<int>::max() / 4,
+                errors::InvalidArgument("Too many keys to unique: ", N));
+    const GPUDevice& device = ctx->eigen_device<GPUDevice>();
+    const cudaStream_t& cu_stream = GetGpuStream(ctx);
+    auto* stream = ctx->op_device_context()->stream();
+    OP_REQUIRES(ctx, stream, errors::Internal("No GPU stream available."));
+
+    int64 capacity = 1;
+    while (capacity < 2 * N) {
+      capacity <<= 1;
+    }
+    // The slots, their counts and their ranks, then the slots of the keys
+    // and the sizes and offsets of the partitions.
+    Tensor temp_tensor;
+    OP_REQUIRES_OK(ctx, ctx->allocate_temp(
+        DT_INT32, {3 * capacity + N + 2 * num_partitions_ + 1},
+        &temp_tensor));
+    int* slots = temp_tensor.flat<int>().data();
+    int* slot_counts = slots + capacity;
+    int* slot_ranks = slot_counts + capacity;
+    int* key_slots = slot_ranks + capacity;
+    int* partition_sizes = key_slots + N;
+    int* offsets = partition_sizes + num_partitions_;
+    cudaMemsetAsync(slots, 0xff, capacity * sizeof(int), cu_stream);
+    cudaMemsetAsync(slot_counts, 0, capacity * sizeof(int), cu_stream);
+    cudaMemsetAsync(partition_sizes, 0, num_partitions_ * sizeof(int),
+                    cu_stream);
+
+    if (N > 0) {
+      GpuLaunchConfig config = GetGpuLaunchConfig(N, device);
+      InsertKeysKernel<T>
+          <<<config.block_count, config.thread_per_block, 0, cu_stream>>>(
+              keys, N, capacity - 1, slots, slot_counts, key_slots);
+      config = GetGpuLaunchConfig(capacity, device);
+      RankSlotsKernel<T>
+          <<<config.block_count, config.thread_per_block, 0, cu_stream>>>(
+              keys, slots, capacity, num_partitions_, partition_sizes,
+              slot_ranks);
+    }
+    PartitionOffsetsKernel<<<1, 1, 0, cu_stream>>>(
+        partition_sizes, num_partitions_, offsets);
+
+    ScratchSpace<int> host_offsets(ctx, num_partitions_ + 1,
+                                   /*on_host=*/true);
+    se::DeviceMemoryBase wrapped_offsets(offsets,
+                                         (num_partitions_ + 1) * sizeof(int));
+    OP_REQUIRES(ctx,
+                stream->ThenMemcpy(host_offsets.mutable_data(),
+                                   wrapped_offsets,
+                                   (num_partitions_ + 1) * sizeof(int)).ok(),
+                errors::Internal("Failed to launch copy from device to host."));
+    OP_REQUIRES_OK(ctx, stream->BlockHostUntilDone());
+    const int* sizes_offsets = host_offsets.data();
+    const int64 uniq_size = sizes_offsets[num_partitions_];
+
+    Tensor* output_tensor = nullptr;
+    Tensor* idx_tensor = nullptr;
+    Tensor* count_tensor = nullptr;
+    Tensor* partition_sizes_tensor = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, {uniq_size}, &output_tensor));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(1, {N}, &idx_tensor));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(2, {uniq_size}, &count_tensor));
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(3, {num_partitions_},
+                                             &partition_sizes_tensor));
+    auto partition_sizes_vec = partition_sizes_tensor->vec<TIndex>();
+    for (int p = 0; p < num_partitions_; ++p) {
+      partition_sizes_vec(p) = sizes_offsets[p + 1] - sizes_offsets[p];
+    }
+    if (N == 0) {
+      return;
+    }
+
+    GpuLaunchConfig config = GetGpuLaunchConfig(capacity, device);
+    ScatterSlotsKernel<T, TIndex>
+        <<<config.block_count, config.thread_per_block, 0, cu_stream>>>(
+            keys, slots, slot_counts, offsets, capacity, num_partitions_,
+            slot_ranks, output_tensor->flat<T>().data(),
+            count_tensor->flat<TIndex>().data());
+    config = GetGpuLaunchConfig(N, device);
+    GatherIndicesKernel<TIndex>
+        <<<config.block_count, config.thread_per_block, 0, cu_stream>>>(
+            key_slots, slot_ranks, N, idx_tensor->flat<TIndex>().data());
+  }
+
+ private:
+  int num_partitions_;
+};
+
+#define REGISTER_UNIQUE_WITH_PARTITIONS_GPU_KERNEL(T, TIndex)   \
+  REGISTER_KERNEL_BUILDER(Name("UniqueWithPartitions")          \
+                          .Device(DEVICE_GPU)                   \
+                          .HostMemory("partition_sizes")        \
+                          .TypeConstraint<T>("T")               \
+                          .TypeConstraint<TIndex>("out_idx"),   \
+                          UniqueWithPartitionsGpuOp<T, TIndex>)
+#define REGISTER_UNIQUE_WITH_PARTITIONS_GPU(T)          \
+  REGISTER_UNIQUE_WITH_PARTITIONS_GPU_KERNEL(T, int32); \
+  REGISTER_UNIQUE_WITH_PARTITIONS_GPU_KERNEL(T, int64)
+
+TF_CALL_int32(REGISTER_UNIQUE_WITH_PARTITIONS_GPU);
+TF_CALL_int64(REGISTER_UNIQUE_WITH_PARTITIONS_GPU);
+
+#undef REGISTER_UNIQUE_WITH_PARTITIONS_GPU
+#undef REGISTER_UNIQUE_WITH_PARTITIONS_GPU_KERNEL
+
 #define REGISTER_UNIQUE_ALI_V2_GPU_KERNEL(T, TIndex)			\
   REGISTER_KERNEL_BUILDER(Name("Unique")				\
                           .Device(DEVICE_GPU)				\
@@ -19,8 +19,14 @@ limitations under the License.
 #include <algorithm>
 #include <limits>
 #include <functional>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 #include "absl/container/flat_hash_map.h"
 #include "sparsehash/dense_hash_map"
@@ -53,7 +59,8 @@ typedef enum {
   MULTIMAP = 0,
   STL = 1,
   ABSL = 2,
-  GOOGLE = 3
+  GOOGLE = 3,
+  PARTITION = 4
 } UniqueMaps;
 
 }  // namespace
@@ -561,6 +568,361 @@ void MultiMapCompute(OpKernelContext* context, const Tensor& input,
   t2_runner.Run();
 }
 
+namespace {
+// Slots of a PartitionTable probed at once.
+const int64 kProbeGroupSize = 4;
+// Cache budget of the hash table of a partition in PartitionCompute.
+const int64 kPartitionTableBytes = 256 * 1024;
+const int64 kMaxNumPartitions = 4096;
+
+inline int64 NextPowerOfTwo(int64 n) {
+  int64 p = 1;
+  while (p < n) { p <<= 1; }
+  return p;
+}
+
+// Sets bit i of *match when keys[i] == key and of *empty when slot i is
+// empty, for the kProbeGroupSize slots of a group.
+template <typename T>
+inline void ProbeGroup(const T* keys, const int32* ids, const T& key,
+                       uint32* match, uint32* empty) {
+  *match = 0;
+  *empty = 0;
+  for (int64 i = 0; i < kProbeGroupSize; ++i) {
+    *empty |= static_cast<uint32>(ids[i] < 0) << i;
+    *match |= static_cast<uint32>(keys[i] == key) << i;
+  }
+  *match &= ~*empty;
+}
+
+#if defined(__AVX2__)
+inline void ProbeGroup(const int64* keys, const int32* ids, const int64& key,
+                       uint32* match, uint32* empty) {
+  __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys));
+  __m256i eq = _mm256_cmpeq_epi64(k, _mm256_set1_epi64x(key));
+  __m128i id = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ids));
+  __m128i neg = _mm_cmplt_epi32(id, _mm_setzero_si128());
+  *empty = _mm_movemask_ps(_mm_castsi128_ps(neg));
+  *match = _mm256_movemask_pd(_mm256_castsi256_pd(eq)) & ~*empty;
+}
+#endif  // __AVX2__
+
+#if defined(__SSE2__)
+inline void ProbeGroup(const int32* keys, const int32* ids, const int32& key,
+                       uint32* match, uint32* empty) {
+  __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys));
+  __m128i eq = _mm_cmpeq_epi32(k, _mm_set1_epi32(key));
+  __m128i id = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ids));
+  __m128i neg = _mm_cmplt_epi32(id, _mm_setzero_si128());
+  *empty = _mm_movemask_ps(_mm_castsi128_ps(neg));
+  *match = _mm_movemask_ps(_mm_castsi128_ps(eq)) & ~*empty;
+}
+#endif  // __SSE2__
+
+// Open addressing hash table of the keys of a partition. Slots are probed
+// in groups of kProbeGroupSize, keys get ids in the order they are first
+// inserted and the number of insertions of each key is counted.
+template <typename T, typename TIndex>
+class PartitionTable {
+ public:
+  void Reset(int64 expected_keys) {
+    Resize(NextPowerOfTwo(std::max(2 * expected_keys, 2 * kProbeGroupSize)));
+    uniq_keys_.clear();
+    uniq_counts_.clear();
+  }
+
+  // Returns the id of key, low bits of hash select the slot.
+  inline int32 Insert(const T& key, uint64 hash) {
+    if (unlikely(2 * (uniq_keys_.size() + 1) > keys_.size())) {
+      Grow();
+    }
+    int32 id = Find(key, hash, true);
+    ++uniq_counts_[id];
+    return id;
+  }
+
+  inline int64 Size() const { return uniq_keys_.size(); }
+  inline const T& Key(int32 id) const { return uniq_keys_[id]; }
+  inline TIndex Count(int32 id) const { return uniq_counts_[id]; }
+
+ private:
+  inline int32 Find(const T& key, uint64 hash, bool count_new) {
+    int64 group = (hash & mask_) & ~(kProbeGroupSize - 1);
+    while (true) {
+      uint32 match, empty;
+      ProbeGroup(&keys_[group], &ids_[group], key, &match, &empty);
+      if (match) {
+        return ids_[group + __builtin_ctz(match)];
+      }
+      if (empty) {
+        int64 slot = group + __builtin_ctz(empty);
+        keys_[slot] = key;
+        ids_[slot] = static_cast<int32>(uniq_keys_.size());
+        if (count_new) {
+          uniq_keys_.push_back(key);
+          uniq_counts_.push_back(0);
+        }
+        return ids_[slot];
+      }
+      group = (group + kProbeGroupSize) & mask_;
+    }
+  }
+
+  void Resize(int64 capacity) {
+    keys_.resize(capacity);
+    ids_.assign(capacity, -1);
+    mask_ = capacity - 1;
+  }
+
+  void Grow() {
+    static IdHash hasher;
+    Resize(2 * keys_.size());
+    std::vector<T> uniq_keys;
+    uniq_keys.swap(uniq_keys_);
+    for (size_t i = 0; i < uniq_keys.size(); ++i) {
+      Find(uniq_keys[i], hasher(uniq_keys[i]), false);
+      uniq_keys_.push_back(uniq_keys[i]);
+    }
+  }
+
+  std::vector<T> keys_;
+  std::vector<int32> ids_;
+  int64 mask_ = 0;
+  std::vector<T> uniq_keys_;
+  std::vector<TIndex> uniq_counts_;
+};
+
+// Returns the number of partitions of N keys with about N / unique_ratio_hint
+// unique keys, so that the hash table of a partition fits kPartitionTableBytes.
+inline int64 NumPartitions(int64 N, int64 unique_ratio_hint,
+                           int64 slot_bytes, int32 max_threads) {
+  const int64 est_uniq = std::max<int64>(1, N / unique_ratio_hint);
+  int64 num_partitions = NextPowerOfTwo(std::max<int64>(max_threads,
+      (2 * est_uniq * slot_bytes + kPartitionTableBytes - 1) /
+          kPartitionTableBytes));
+  return std::min(num_partitions, kMaxNumPartitions);
+}
+
+// Keys scattered to partitions by the high bits of their hashes, the keys
+// of a partition are contiguous and kept in the order of input.
+template <typename T>
+class PartitionedKeys {
+ public:
+  explicit PartitionedKeys(int64 num_partitions)
+      : num_partitions_(num_partitions), starts_(num_partitions + 1, 0) {
+    while ((int64{1} << partition_bits_) < num_partitions_) {
+      ++partition_bits_;
+    }
+  }
+
+  inline int64 PartitionOf(uint64 hash) const {
+    return partition_bits_ == 0 ? 0 : hash >> (64 - partition_bits_);
+  }
+
+  // Counts keys of each partition in the sections of parter in parallel,
+  // then scatters keys and their positions in input.
+  void Scatter(const T* input, const Partitioner& parter, int32 num_tasks,
+               thread::ThreadPool* thread_pool) {
+    static IdHash hasher;
+    const int64 P = num_partitions_;
+    std::vector<int64> offsets(num_tasks * P, 0);
+    auto CountTask = [this, input, &offsets, &parter, P]
+        (int32 task_id, int32 num_tasks) {
+      int64* counts = &offsets[task_id * P];
+      const Range* range = parter.GetRange(task_id);
+      for (int64 i = range->Start(); i < range->End(); ++i) {
+        ++counts[PartitionOf(hasher(input[i]))];
+      }
+    };
+    TaskRunner count_runner(CountTask, thread_pool, num_tasks);
+    count_runner.Run();
+
+    // Partition p of task t starts at offsets[t * P + p].
+    int64 start = 0;
+    for (int64 p = 0; p < P; ++p) {
+      starts_[p] = start;
+      for (int32 t = 0; t < num_tasks; ++t) {
+        int64 count = offsets[t * P + p];
+        offsets[t * P + p] = start;
+        start += count;
+      }
+    }
+    starts_[P] = start;
+
+    keys_.reset(new T[start]);
+    positions_.reset(new int32[start]);
+    auto ScatterTask = [this, input, &offsets, &parter, P]
+        (int32 task_id, int32 num_tasks) {
+      int64* next = &offsets[task_id * P];
+      const Range* range = parter.GetRange(task_id);
+      for (int64 i = range->Start(); i < range->End(); ++i) {
+        int64 pos = next[PartitionOf(hasher(input[i]))]++;
+        keys_[pos] = input[i];
+        positions_[pos] = static_cast<int32>(i);
+      }
+    };
+    TaskRunner scatter_runner(ScatterTask, thread_pool, num_tasks);
+    scatter_runner.Run();
+  }
+
+  // Frees the scattered keys and positions.
+  void Clear() {
+    keys_.reset();
+    positions_.reset();
+  }
+
+  inline int64 NumPartitions() const { return num_partitions_; }
+  inline int64 Begin(int64 p) const { return starts_[p]; }
+  inline int64 End(int64 p) const { return starts_[p + 1]; }
+  inline const T& Key(int64 i) const { return keys_[i]; }
+  inline int32 Position(int64 i) const { return positions_[i]; }
+
+ private:
+  const int64 num_partitions_;
+  int partition_bits_ = 0;
+  std::vector<int64> starts_;
+  std::unique_ptr<T[]> keys_;
+  std::unique_ptr<int32[]> positions_;
+};
+}  // namespace
+
+// NOTE: A radix partitioned scheme for parallel unique computing. Keys are
+// scattered into P partitions by the high bits of their hashes, the hash
+// table of each partition is sized to stay in L2 cache and the partitions
+// are deduplicated in parallel without any sharing.
+// Step 1: Count keys of each partition in T1 sections of input in parallel.
+// Step 2: Scatter keys and their positions to the partitions, keys of a
+//         partition are kept in the order of input.
+// Step 3: Deduplicate each partition, write the local index of every key
+//         and count the keys, as many tasks as threads.
+// Step 4: Write output keys and counts, and add the global offset of its
+//         partition to the index of every key.
+// Unique keys are ordered by partition, not by their first occurrence.
+template<typename T, typename TIndex>
+void PartitionCompute(OpKernelContext* context, const Tensor& input,
+                      Tensor* idx, int64 axis, int64* uniq_size_out,
+                      int64 partition_size, int64 unique_ratio_hint,
+                      Tensor* output, Tensor* output_counter,
+                      int num_outputs) {
+  auto Tin = input.vec<T>();
+  const int64 N = input.NumElements();
+  OP_REQUIRES(context, N <= std::numeric_limits<int32>::max(),
+              errors::InvalidArgument(
+                  "unique does not support input tensors larger than ",
+                  std::numeric_limits<int32>::max(), " elements"));
+  auto idx_vec = idx->template vec<TIndex>();
+  int32 max_threads =
+    context->device()->tensorflow_cpu_worker_threads()->num_threads;
+  auto thread_pool =
+    context->device()->tensorflow_cpu_worker_threads()->workers;
+  static IdHash hasher;
+
+  const int64 num_partitions = NumPartitions(N, unique_ratio_hint,
+      sizeof(T) + sizeof(int32), max_threads);
+
+  // Parallel Step 1 and 2: Count and scatter keys of each partition.
+  int32 num_tasks_t1 = std::max<int64>(1, std::min<int64>(max_threads,
+      (N + partition_size - 1) / partition_size));
+  Partitioner input_parter(N, num_tasks_t1);
+  PartitionedKeys<T> parts(num_partitions);
+  parts.Scatter(Tin.data(), input_parter, num_tasks_t1, thread_pool);
+
+  // Parallel Step 3: Deduplicate partitions.
+  int32 num_tasks_t3 = std::min<int64>(max_threads, num_partitions);
+  std::vector<PartitionTable<T, TIndex>> tables(num_partitions);
+  auto DedupTask = [&tables, &parts, &idx_vec, num_partitions,
+      unique_ratio_hint] (int32 task_id, int32 num_tasks) {
+    for (int64 p = task_id; p < num_partitions; p += num_tasks) {
+      PartitionTable<T, TIndex>& table = tables[p];
+      const int64 begin = parts.Begin(p);
+      const int64 end = parts.End(p);
+      table.Reset(std::max<int64>(kProbeGroupSize,
+                                  (end - begin) / unique_ratio_hint));
+      for (int64 i = begin; i < end; ++i) {
+        const T& key = parts.Key(i);
+        idx_vec(parts.Position(i)) = table.Insert(key, hasher(key));
+      }
+    }
+  };
+  TaskRunner t3_runner(DedupTask, thread_pool, num_tasks_t3);
+  t3_runner.Run();
+  parts.Clear();
+
+  std::vector<int64> global_offsets(num_partitions + 1, 0);
+  for (int64 p = 0; p < num_partitions; ++p) {
+    global_offsets[p + 1] = global_offsets[p] + tables[p].Size();
+  }
+  const int64 uniq_size = global_offsets[num_partitions];
+
+  *uniq_size_out = uniq_size;
+  TensorShape output_shape(input.shape());
+  output_shape.set_dim(axis, uniq_size);
+  AllocatorAttributes attr;
+  attr.set_on_host(true);
+  OP_REQUIRES_OK(context, context->allocate_temp(
+      DataTypeToEnum<T>::v(), output_shape, output, attr));
+  auto key_output_vec = output->template vec<T>();
+  TIndex* count_output = nullptr;
+  if (num_outputs > 2) {
+    OP_REQUIRES_OK(context, context->allocate_temp(
+        DataTypeToEnum<TIndex>::v(), TensorShape({uniq_size}),
+        output_counter, attr));
+    count_output = output_counter->template vec<TIndex>().data();
+  }
+
+  // Parallel Step 4: Write output keys, counts and global indices.
+  auto KeyOutputTask = [&tables, &global_offsets, &key_output_vec,
+      count_output, num_partitions] (int32 task_id, int32 num_tasks) {
+    for (int64 p = task_id; p < num_partitions; p += num_tasks) {
+      const PartitionTable<T, TIndex>& table = tables[p];
+      const int64 offset = global_offsets[p];
+      for (int64 id = 0; id < table.Size(); ++id) {
+        key_output_vec(offset + id) = table.Key(id);
+        if (count_output != nullptr) {
+          count_output[offset + id] = table.Count(id);
+        }
+      }
+    }
+  };
+  TaskRunner t4_runner(KeyOutputTask, thread_pool, num_tasks_t3);
+  t4_runner.Run();
+
+  auto IndexOutputTask = [&Tin, &idx_vec, &global_offsets, &input_parter,
+      &parts] (int32 task_id, int32 num_tasks) {
+    const Range* range = input_parter.GetRange(task_id);
+    for (int64 i = range->Start(); i < range->End(); ++i) {
+      idx_vec(i) += global_offsets[parts.PartitionOf(hasher(Tin(i)))];
+    }
+  };
+  TaskRunner t5_runner(IndexOutputTask, thread_pool, num_tasks_t1);
+  t5_runner.Run();
+}
+
+template<typename T, typename TIndex, typename Enable = void>
+struct PartitionUnique {
+  static constexpr bool kSupported = false;
+  static void Compute(OpKernelContext* context, const Tensor& input,
+                      Tensor* idx, int64 axis, int64* uniq_size_out,
+                      int64 partition_size, int64 unique_ratio_hint,
+                      Tensor* output, Tensor* output_counter,
+                      int num_outputs) {}
+};
+
+template<typename T, typename TIndex>
+struct PartitionUnique<T, TIndex,
+    typename std::enable_if<std::is_integral<T>::value>::type> {
+  static constexpr bool kSupported = true;
+  static void Compute(OpKernelContext* context, const Tensor& input,
+                      Tensor* idx, int64 axis, int64* uniq_size_out,
+                      int64 partition_size, int64 unique_ratio_hint,
+                      Tensor* output, Tensor* output_counter,
+                      int num_outputs) {
+    PartitionCompute<T, TIndex>(context, input, idx, axis, uniq_size_out,
+        partition_size, unique_ratio_hint, output, output_counter,
+        num_outputs);
+  }
+};
+
 template<typename T, typename TIndex>
 void MultipleElements(OpKernelContext* context, const Tensor& input,
                       Tensor* idx, Tensor* output, int64* uniq_size,
@@ -705,6 +1067,18 @@ void UniqueInternal(OpKernelContext* context, const Tensor& input,
         ComputeInternalWithHashMap<T, TIndex, DefaultHashMap>
             (context, input, idx, axis, &uniq_size_out, N, serial, output);
         break;
+      case PARTITION:
+        if (PartitionUnique<T, TIndex>::kSupported && num_buckets > 1 &&
+            !serial) {
+          // Counts are computed with the indices.
+          PartitionUnique<T, TIndex>::Compute(context, input, idx, axis,
+              &uniq_size_out, partition_size, unique_ratio_hint, output,
+              output_counter, num_outputs);
+          return;
+        }
+        ComputeInternalWithHashMap<T, TIndex, DefaultHashMap>
+            (context, input, idx, axis, &uniq_size_out, N, serial, output);
+        break;
       default:
         ComputeInternalWithHashMap<T, TIndex, DefaultHashMap>
             (context, input, idx, axis, &uniq_size_out, N, serial, output);
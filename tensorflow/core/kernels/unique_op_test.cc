@@ -13,8 +13,11 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <stdlib.h>
+#include <algorithm>
 #include <functional>
 #include <memory>
+#include <unordered_set>
 
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -191,6 +194,166 @@ TensorProto GetRandomStringsTensorProto(int dim, int max_str_len) {
   ->Arg(64 * 1024)							\
   ->Arg(256 * 1024);
 
+// Compares the hash maps of Unique on int64 keys, dup_ratio is the average
+// number of occurrences of a key.
+static void BM_Unique_INT64_Map(int iters, int dim, int dup_ratio,
+                                const char* map) {
+  testing::StopTiming();
+  setenv("DEEPREC_UNIQUE_OP_HASH_MAP", map, 1);
+  Graph* g = new Graph(OpRegistry::Global());
+
+  Tensor input(DT_INT64, TensorShape({dim}));
+  auto input_flat = input.flat<int64>();
+  const int64 num_keys = std::max(1, dim / dup_ratio);
+  for (int i = 0; i < dim; ++i) {
+    input_flat(i) = (static_cast<int64>(std::rand()) << 16) % num_keys;
+  }
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Unique")
+                  .Input(test::graph::Constant(g, input))
+                  .Attr("T", DT_INT64)
+                  .Attr("out_idx", DT_INT64)
+                  .Finalize(g, &node));
+
+  testing::BytesProcessed(static_cast<int64>(iters) * dim * sizeof(int64));
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+  testing::StopTiming();
+  unsetenv("DEEPREC_UNIQUE_OP_HASH_MAP");
+}
+
+#define BM_Unique_INT64_MAP(MAP)                                        \
+  static void BM_Unique_INT64_##MAP(int iters, int dim, int dup_ratio) { \
+    BM_Unique_INT64_Map(iters, dim, dup_ratio, #MAP);                   \
+  }                                                                     \
+  BENCHMARK(BM_Unique_INT64_##MAP)                                      \
+      ->ArgPair(1024 * 1024, 1)                                         \
+      ->ArgPair(1024 * 1024, 4)                                         \
+      ->ArgPair(1024 * 1024, 64)                                        \
+      ->ArgPair(4 * 1024 * 1024, 1)                                     \
+      ->ArgPair(4 * 1024 * 1024, 4)                                     \
+      ->ArgPair(4 * 1024 * 1024, 64)                                    \
+      ->ArgPair(10 * 1000 * 1000, 1)                                    \
+      ->ArgPair(10 * 1000 * 1000, 4)                                    \
+      ->ArgPair(10 * 1000 * 1000, 64);
+
+BM_Unique_INT64_MAP(GOOGLE);
+BM_Unique_INT64_MAP(MULTIMAP);
+BM_Unique_INT64_MAP(PARTITION);
+
+// Compares UniqueSegmentSum with Unique followed by UnsortedSegmentSum on
+// dim rows of 16 floats.
+static void BM_UniqueSegmentSum(int iters, int dim, int dup_ratio,
+                                bool fused) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+
+  const int64 row_size = 16;
+  Tensor ids(DT_INT64, TensorShape({dim}));
+  auto ids_flat = ids.flat<int64>();
+  const int64 num_keys = std::max(1, dim / dup_ratio);
+  std::unordered_set<int64> keys;
+  for (int i = 0; i < dim; ++i) {
+    ids_flat(i) = (static_cast<int64>(std::rand()) << 16) % num_keys;
+    keys.insert(ids_flat(i));
+  }
+  Tensor data(DT_FLOAT, TensorShape({dim, row_size}));
+  data.flat<float>().setRandom();
+
+  Node* node;
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "UniqueSegmentSum")
+                    .Input(test::graph::Constant(g, data))
+                    .Input(test::graph::Constant(g, ids))
+                    .Attr("T", DT_FLOAT)
+                    .Attr("Tindices", DT_INT64)
+                    .Finalize(g, &node));
+  } else {
+    Node* unique;
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Unique")
+                    .Input(test::graph::Constant(g, ids))
+                    .Attr("T", DT_INT64)
+                    .Attr("out_idx", DT_INT64)
+                    .Finalize(g, &unique));
+    Tensor num_segments(DT_INT64, TensorShape({}));
+    num_segments.scalar<int64>()() = keys.size();
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "UnsortedSegmentSum")
+                    .Input(test::graph::Constant(g, data))
+                    .Input(unique, 1)
+                    .Input(test::graph::Constant(g, num_segments))
+                    .Finalize(g, &node));
+  }
+
+  testing::BytesProcessed(static_cast<int64>(iters) * dim *
+                          (sizeof(int64) + row_size * sizeof(float)));
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+#define BM_UNIQUE_SEGMENT_SUM(NAME, FUSED)                              \
+  static void BM_UniqueSegmentSum_##NAME(int iters, int dim,            \
+                                         int dup_ratio) {               \
+    BM_UniqueSegmentSum(iters, dim, dup_ratio, FUSED);                  \
+  }                                                                     \
+  BENCHMARK(BM_UniqueSegmentSum_##NAME)                                 \
+      ->ArgPair(64 * 1024, 4)                                           \
+      ->ArgPair(1024 * 1024, 4)                                         \
+      ->ArgPair(1024 * 1024, 64);
+
+BM_UNIQUE_SEGMENT_SUM(Fused, true);
+BM_UNIQUE_SEGMENT_SUM(Unfused, false);
+
+// Compares UniqueWithPartitions over 8 partitions with Unique on int64
+// keys, dup_ratio is the average number of occurrences of a key.
+static void BM_UniqueWithPartitions(int iters, int dim, int dup_ratio,
+                                    const char* device, bool partitioned) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+
+  Tensor input(DT_INT64, TensorShape({dim}));
+  auto input_flat = input.flat<int64>();
+  const int64 num_keys = std::max(1, dim / dup_ratio);
+  for (int i = 0; i < dim; ++i) {
+    input_flat(i) = (static_cast<int64>(std::rand()) << 16) % num_keys;
+  }
+
+  Node* node;
+  if (partitioned) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "UniqueWithPartitions")
+                    .Input(test::graph::Constant(g, input))
+                    .Attr("T", DT_INT64)
+                    .Attr("num_partitions", 8)
+                    .Finalize(g, &node));
+  } else {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Unique")
+                    .Input(test::graph::Constant(g, input))
+                    .Attr("T", DT_INT64)
+                    .Finalize(g, &node));
+  }
+
+  testing::BytesProcessed(static_cast<int64>(iters) * dim * sizeof(int64));
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark(device, g).Run(iters);
+}
+
+#define BM_UNIQUE_WITH_PARTITIONS(DEVICE, NAME, PARTITIONED)            \
+  static void BM_UniqueWithPartitions_##DEVICE##_##NAME(                \
+      int iters, int dim, int dup_ratio) {                              \
+    BM_UniqueWithPartitions(iters, dim, dup_ratio, #DEVICE,             \
+                            PARTITIONED);                               \
+  }                                                                     \
+  BENCHMARK(BM_UniqueWithPartitions_##DEVICE##_##NAME)                  \
+      ->ArgPair(1024 * 1024, 4)                                         \
+      ->ArgPair(10 * 1000 * 1000, 1)                                    \
+      ->ArgPair(10 * 1000 * 1000, 4)                                    \
+      ->ArgPair(10 * 1000 * 1000, 64);
+
+BM_UNIQUE_WITH_PARTITIONS(cpu, Partitioned, true);
+
 BM_Unique_INT32_DEV(cpu);
 BM_Unique_INT32_Repeat_DEV(cpu);
 BM_Unique_STRING_DEV(cpu);
@@ -198,6 +361,8 @@ BM_Unique_STRING_DEV(cpu);
 #ifdef GOOGLE_CUDA
 BM_Unique_INT32_DEV(gpu);
 BM_Unique_INT32_Repeat_DEV(gpu);  
+BM_UNIQUE_WITH_PARTITIONS(gpu, Partitioned, true);
+BM_UNIQUE_WITH_PARTITIONS(gpu, Unique, false);
 #endif  // end of GOOGLE_CUDA
 }  // namespace
 }  // namespace tensorflow
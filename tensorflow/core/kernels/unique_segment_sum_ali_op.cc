@@ -0,0 +1,188 @@
+/* Copyright 2015 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/math_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/task_runner.h"
+#include "tensorflow/core/kernels/unique_ali_op_util.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/util/env_var.h"
+#include "third_party/eigen3/Eigen/Core"
+
+namespace tensorflow {
+
+namespace {
+const char* kUniqueOpUniqRatioHint = "DEEPREC_UNIQUE_OP_UNIQ_RATIO_HINT";
+const char* kUniqueOpPartitionSizeEnv = "DEEPREC_UNIQUE_OP_PARTITION_SIZE";
+const int64 kDefaultUniqueRatioHint = 4;
+}
+
+// NOTE: Fused Unique and UnsortedSegmentSum of the sparse gradients. Ids are
+// scattered into partitions as PartitionCompute of Unique does, every
+// partition is deduplicated and its rows of data are accumulated into its
+// own rows of output by one task, so the rows of data are read once, idx is
+// never materialized and no row of output is shared between tasks.
+// The rows of an id are summed in the order of ids as UnsortedSegmentSum does.
+template <typename T, typename Tindices>
+class UniqueSegmentSumOp : public OpKernel {
+ public:
+  explicit UniqueSegmentSumOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, ReadInt64FromEnvVar(kUniqueOpPartitionSizeEnv,
+                                             kPartitionSize, &partition_size_));
+    OP_REQUIRES(context, partition_size_ > 0,
+                errors::InvalidArgument("Invaild PARTITION_SIZE=",
+                                        partition_size_));
+    OP_REQUIRES_OK(context, ReadInt64FromEnvVar(kUniqueOpUniqRatioHint,
+        kDefaultUniqueRatioHint, &unique_ratio_hint_));
+    OP_REQUIRES(context, unique_ratio_hint_ > 0,
+                errors::InvalidArgument("Invaild ", kUniqueOpUniqRatioHint, "=",
+                                        unique_ratio_hint_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& data = context->input(0);
+    const Tensor& ids = context->input(1);
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(ids.shape()),
+                errors::InvalidArgument("ids should be a vector, got shape ",
+                                        ids.shape().DebugString()));
+    OP_REQUIRES(context, data.dims() >= 1 &&
+                data.dim_size(0) == ids.dim_size(0),
+                errors::InvalidArgument(
+                    "data.shape = ", data.shape().DebugString(),
+                    " does not start with ids.shape = ",
+                    ids.shape().DebugString()));
+    const int64 N = ids.NumElements();
+    OP_REQUIRES(context, N <= std::numeric_limits<int32>::max(),
+                errors::InvalidArgument(
+                    "unique does not support input tensors larger than ",
+                    std::numeric_limits<int32>::max(), " elements"));
+    const int64 row_size = N == 0 ? 0 : data.NumElements() / N;
+    int32 max_threads =
+      context->device()->tensorflow_cpu_worker_threads()->num_threads;
+    auto thread_pool =
+      context->device()->tensorflow_cpu_worker_threads()->workers;
+    static IdHash hasher;
+
+    // Parallel Step 1: Scatter ids to partitions.
+    const int64 num_partitions = N < kPartitionLimit ? 1 :
+        NumPartitions(N, unique_ratio_hint_, sizeof(Tindices) + sizeof(int32),
+                      max_threads);
+    int32 num_tasks_t1 = std::max<int64>(1, std::min<int64>(max_threads,
+        (N + partition_size_ - 1) / partition_size_));
+    Partitioner input_parter(N, num_tasks_t1);
+    PartitionedKeys<Tindices> parts(num_partitions);
+    parts.Scatter(ids.vec<Tindices>().data(), input_parter, num_tasks_t1,
+                  thread_pool);
+
+    // Parallel Step 2: Deduplicate partitions, keep the local index of
+    // every scattered id.
+    int32 num_tasks_t2 = std::min<int64>(max_threads, num_partitions);
+    std::vector<PartitionTable<Tindices, int32>> tables(num_partitions);
+    std::unique_ptr<int32[]> local_idx(new int32[N]);
+    auto DedupTask = [this, &tables, &parts, &local_idx, num_partitions]
+        (int32 task_id, int32 num_tasks) {
+      for (int64 p = task_id; p < num_partitions; p += num_tasks) {
+        PartitionTable<Tindices, int32>& table = tables[p];
+        const int64 begin = parts.Begin(p);
+        const int64 end = parts.End(p);
+        table.Reset(std::max<int64>(kProbeGroupSize,
+                                    (end - begin) / unique_ratio_hint_));
+        for (int64 i = begin; i < end; ++i) {
+          const Tindices& id = parts.Key(i);
+          local_idx[i] = table.Insert(id, hasher(id));
+        }
+      }
+    };
+    TaskRunner t2_runner(DedupTask, thread_pool, num_tasks_t2);
+    t2_runner.Run();
+
+    std::vector<int64> global_offsets(num_partitions + 1, 0);
+    for (int64 p = 0; p < num_partitions; ++p) {
+      global_offsets[p + 1] = global_offsets[p] + tables[p].Size();
+    }
+    const int64 uniq_size = global_offsets[num_partitions];
+
+    TensorShape output_shape(data.shape());
+    output_shape.set_dim(0, uniq_size);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, output_shape, &output));
+    Tensor* unique_ids = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+        1, TensorShape({uniq_size}), &unique_ids));
+
+    // Parallel Step 3: Write unique ids and sum the rows of every partition.
+    const T* data_ptr = data.flat<T>().data();
+    T* output_ptr = output->flat<T>().data();
+    auto unique_ids_vec = unique_ids->vec<Tindices>();
+    typedef Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>> Row;
+    typedef Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>> ConstRow;
+    auto SumTask = [&tables, &parts, &local_idx, &global_offsets,
+        &unique_ids_vec, data_ptr, output_ptr, row_size, num_partitions]
+        (int32 task_id, int32 num_tasks) {
+      for (int64 p = task_id; p < num_partitions; p += num_tasks) {
+        const PartitionTable<Tindices, int32>& table = tables[p];
+        const int64 offset = global_offsets[p];
+        for (int64 id = 0; id < table.Size(); ++id) {
+          unique_ids_vec(offset + id) = table.Key(id);
+        }
+        std::vector<bool> written(table.Size(), false);
+        for (int64 i = parts.Begin(p); i < parts.End(p); ++i) {
+          const int32 id = local_idx[i];
+          T* out_row = output_ptr + (offset + id) * row_size;
+          const T* in_row =
+              data_ptr + static_cast<int64>(parts.Position(i)) * row_size;
+          if (!written[id]) {
+            std::copy(in_row, in_row + row_size, out_row);
+            written[id] = true;
+          } else {
+            Row(out_row, row_size) += ConstRow(in_row, row_size);
+          }
+        }
+      }
+    };
+    TaskRunner t3_runner(SumTask, thread_pool, num_tasks_t2);
+    t3_runner.Run();
+  }
+
+ private:
+  int64 partition_size_ = 0;
+  int64 unique_ratio_hint_;
+};
+
+#define REGISTER_UNIQUE_SEGMENT_SUM(type, index_type)                \
+  REGISTER_KERNEL_BUILDER(Name("UniqueSegmentSum")                   \
+                              .Device(DEVICE_CPU)                    \
+                              .TypeConstraint<type>("T")             \
+                              .TypeConstraint<index_type>("Tindices"), \
+                          UniqueSegmentSumOp<type, index_type>);
+#define REGISTER_UNIQUE_SEGMENT_SUM_FOR_EACH_INDEX_TYPE(type) \
+  REGISTER_UNIQUE_SEGMENT_SUM(type, int32)                    \
+  REGISTER_UNIQUE_SEGMENT_SUM(type, int64)
+TF_CALL_REAL_NUMBER_TYPES(REGISTER_UNIQUE_SEGMENT_SUM_FOR_EACH_INDEX_TYPE);
+#undef REGISTER_UNIQUE_SEGMENT_SUM_FOR_EACH_INDEX_TYPE
+#undef REGISTER_UNIQUE_SEGMENT_SUM
+
+}  // namespace tensorflow
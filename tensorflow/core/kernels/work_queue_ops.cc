@@ -13,11 +13,15 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstddef>
 #include <deque>
 #include <mutex>
 #include <numeric>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #define EIGEN_USE_THREADS
@@ -26,9 +30,11 @@ limitations under the License.
 #endif  // GOOGLE_CUDA
 
 #include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/step_stats_collector.h"
 #include "tensorflow/core/framework/common_shape_fns.h"
 #include "tensorflow/core/framework/dataset_stateful_op_whitelist.h"
 #include "tensorflow/core/framework/device_attributes.pb.h"
+#include "tensorflow/core/framework/embedding/lock_contention.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/numeric_op.h"
 #include "tensorflow/core/framework/op.h"
@@ -36,6 +42,7 @@ limitations under the License.
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/framework/stall_stats.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_types.h"
@@ -67,9 +74,18 @@ namespace tensorflow {
 
 using shape_inference::InferenceContext;
 
+// Works are distributed round-robin to num_shards shards, each shard has its
+// own lock. A client takes works from its local shard first and steals works
+// from the other shards when the local shard is empty, so that the clients
+// mostly do not contend on the same lock. With one shard the works are taken
+// in the order they are put.
 class WorkQueue : public ResourceBase {
  public:
-  WorkQueue(const string& name) : name_(name), is_closed_(false) {}
+  WorkQueue(const string& name, int64 num_shards)
+      : name_(name), is_closed_(false), size_(0), next_put_shard_(0),
+        next_take_shard_(0), shards_(std::max<int64>(1, num_shards)),
+        stall_counters_(
+            StallStats::Global()->Get(strings::StrCat("WorkQueue/", name))) {}
 
   ~WorkQueue() { Close(); }
 
@@ -78,91 +94,173 @@ class WorkQueue : public ResourceBase {
   }
 
   int64 MemoryUsed() const override {
-    return static_cast<int64>(queue_.size() * DataTypeSize(DT_STRING));
+    return size_.load() * static_cast<int64>(DataTypeSize(DT_STRING));
   }
 
   Status Put(const Tensor& inputs) {
     const int64 num_puts = inputs.shape().dim_size(0);
 
-    std::unique_lock<std::mutex> lock(mu_);
-    if (TF_PREDICT_FALSE(is_closed_)) {
-      lock.unlock();
+    if (TF_PREDICT_FALSE(is_closed_.load())) {
       take_cv_.notify_all();
       LOG(WARNING) << "Work queue " << name_ << " reinitialized.";
 
       return Status::OK();
     }
 
-    for (int64 i = 0; i < num_puts; ++i) {
-      queue_.push_back(inputs.flat<string>()(i));
+    const int64 num_shards = shards_.size();
+    const size_t first_shard = next_put_shard_.fetch_add(num_puts);
+    for (int64 s = 0; s < num_shards && s < num_puts; ++s) {
+      Shard& shard = shards_[(first_shard + s) % num_shards];
+      embedding::profiled_lock<std::mutex> lock(
+          shard.mu, LOCK_CONTENTION_SITE("work_queue_shard"));
+      for (int64 i = s; i < num_puts; i += num_shards) {
+        shard.works.push_back(inputs.flat<string>()(i));
+      }
     }
+    size_ += num_puts;
 
-    lock.unlock();
-    take_cv_.notify_all();
-
+    NotifyTakers();
     return Status::OK();
   }
 
-  Status Take(Tensor* output) {
-    std::unique_lock<std::mutex> lock(mu_);
-
-    take_cv_.wait(lock, [this]() { return !queue_.empty() || is_closed_; });
+  // Takes a work from the shard of client_index, or from the shards in turn
+  // when client_index is negative. The time spent waiting for works to be
+  // put is added to stall.
+  Status Take(int64 client_index, Tensor* output, StallTime* stall) {
+    const size_t num_shards = shards_.size();
+    const size_t local_shard = client_index >= 0
+        ? client_index % num_shards
+        : next_take_shard_.fetch_add(1) % num_shards;
+    while (true) {
+      for (size_t s = 0; s < num_shards; ++s) {
+        if (TryTake(&shards_[(local_shard + s) % num_shards], output)) {
+          RecordWait(stall);
+          return Status::OK();
+        }
+      }
+
+      std::unique_lock<std::mutex> lock(mu_);
+      if (stall->start_nanos == 0) {
+        stall->start_nanos = Env::Default()->NowNanos();
+      }
+      take_cv_.wait(lock, [this]() { return size_ > 0 || is_closed_; });
+      if (TF_PREDICT_FALSE(size_ <= 0 && is_closed_)) {
+        RecordWait(stall);
+        return Status(errors::OutOfRange(
+            strings::StrCat("All works in work queue ", name_, " are taken.")));
+      }
+    }
+  }
 
-    if (TF_PREDICT_FALSE(queue_.empty() && is_closed_)) {
-      return Status(errors::OutOfRange(
-          strings::StrCat("All works in work queue ", name_, " are taken.")));
+  // Keeps the last num_leases works taken by client_id, which Release puts
+  // back when the client leaves before finishing them. A work taken after
+  // the client released its works is put back at once.
+  void Lease(const string& client_id, int64 client_index, int64 num_leases,
+             const string& work) {
+    std::deque<string> works;
+    {
+      std::lock_guard<std::mutex> lock(lease_mu_);
+      if (released_.count(client_id) == 0) {
+        std::deque<string>& leases = leases_[client_id];
+        leases.push_back(work);
+        while (leases.size() > static_cast<size_t>(num_leases)) {
+          leases.pop_front();
+        }
+        return;
+      }
     }
+    works.push_back(work);
+    PutFront(client_index, &works);
+  }
 
-    output->scalar<string>().setConstant(std::move(queue_.front()));
-    queue_.pop_front();
+  // Puts the works leased by client_id back to the front of the shard of
+  // client_index, so that the other clients take them next. The client
+  // takes no more works.
+  int64 Release(const string& client_id, int64 client_index) {
+    std::deque<string> works;
+    {
+      std::lock_guard<std::mutex> lock(lease_mu_);
+      released_.insert(client_id);
+      auto it = leases_.find(client_id);
+      if (it != leases_.end()) {
+        works.swap(it->second);
+        leases_.erase(it);
+      }
+    }
+    const int64 num_releases = works.size();
+    PutFront(client_index, &works);
+    LOG(INFO) << "Work queue " << name_ << " released " << num_releases
+              << " works of " << client_id << ".";
+    return num_releases;
+  }
 
-    return Status::OK();
+  bool IsReleased(const string& client_id) {
+    std::lock_guard<std::mutex> lock(lease_mu_);
+    return released_.count(client_id) > 0;
   }
 
   Status GetSize(Tensor* size) {
-    std::unique_lock<std::mutex> lock(mu_);
-    size->scalar<int64>().setConstant(static_cast<int64>(queue_.size()));
+    size->scalar<int64>().setConstant(std::max<int64>(0, size_.load()));
     return Status::OK();
   }
 
   Status Restore(const Tensor& restorable) {
     const int64 num_works = restorable.shape().dim_size(0);
+    const size_t num_shards = shards_.size();
 
-    std::unique_lock<std::mutex> lock(mu_);
-
-    queue_.clear();
+    std::vector<std::unique_lock<std::mutex>> locks = LockShards();
+    for (auto& shard : shards_) {
+      shard.works.clear();
+    }
     for (int64 i = 0; i < num_works; ++i) {
-      queue_.push_back(restorable.flat<string>()(i));
+      shards_[i % num_shards].works.push_back(restorable.flat<string>()(i));
+    }
+    next_put_shard_ = num_works;
+    size_ = num_works;
+    locks.clear();
+    {
+      std::lock_guard<std::mutex> lock(lease_mu_);
+      leases_.clear();
+      released_.clear();
     }
 
-    lock.unlock();
-    take_cv_.notify_all();
+    NotifyTakers();
     return Status::OK();
   }
 
+  // Saves the works of the shards in turn, which is the order they are put
+  // when the queue has one shard. Restore distributes the saved works to
+  // the shards in turn again.
   Status Save(OpKernelContext* ctx, Tensor** saveable) {
-    std::unique_lock<std::mutex> lock(mu_);
+    std::vector<std::unique_lock<std::mutex>> locks = LockShards();
 
+    size_t num_works = 0;
+    size_t max_shard_works = 0;
+    for (auto& shard : shards_) {
+      num_works += shard.works.size();
+      max_shard_works = std::max(max_shard_works, shard.works.size());
+    }
     TF_RETURN_IF_ERROR(ctx->allocate_output(
-        0, TensorShape({static_cast<int64>(queue_.size())}), saveable));
-    for (size_t i = 0; i < queue_.size(); ++i) {
-      (*saveable)->flat<string>()(i) = queue_[i];
+        0, TensorShape({static_cast<int64>(num_works)}), saveable));
+    auto saved = (*saveable)->flat<string>();
+    int64 index = 0;
+    for (size_t i = 0; i < max_shard_works; ++i) {
+      for (auto& shard : shards_) {
+        if (i < shard.works.size()) {
+          saved(index++) = shard.works[i];
+        }
+      }
     }
 
     return Status::OK();
   }
 
   Status Close() {
-    std::unique_lock<std::mutex> lock(mu_);
-
-    if (is_closed_) {
+    if (is_closed_.exchange(true)) {
       return Status::OK();
     }
 
-    is_closed_ = true;
-
-    lock.unlock();
-    take_cv_.notify_all();
+    NotifyTakers();
     return Status::OK();
   }
 
@@ -184,14 +282,83 @@ class WorkQueue : public ResourceBase {
   }
 
  private:
-  // TODO(yuanman.ym): Use memory efficient data structure, e.g. HAT-trie,
-  // to implement the string queue. (See https://github.com/Tessil/hat-trie)
-  std::deque<string> queue_;
+  struct Shard {
+    std::mutex mu;
+    // TODO(yuanman.ym): Use memory efficient data structure, e.g. HAT-trie,
+    // to implement the string queue. (See https://github.com/Tessil/hat-trie)
+    std::deque<string> works;
+  };
+
+  // Records the wait of a Take which blocked.
+  void RecordWait(StallTime* stall) {
+    if (stall->start_nanos > 0) {
+      stall->wait_nanos = Env::Default()->NowNanos() - stall->start_nanos;
+      stall_counters_->RecordConsumerWait(stall->wait_nanos);
+    }
+  }
+
+  void PutFront(int64 client_index, std::deque<string>* works) {
+    if (works->empty()) {
+      return;
+    }
+    const int64 num_works = works->size();
+    Shard& shard = shards_[std::max<int64>(0, client_index) % shards_.size()];
+    {
+      embedding::profiled_lock<std::mutex> lock(
+          shard.mu, LOCK_CONTENTION_SITE("work_queue_shard"));
+      shard.works.insert(shard.works.begin(),
+                         std::make_move_iterator(works->begin()),
+                         std::make_move_iterator(works->end()));
+    }
+    size_ += num_works;
+
+    NotifyTakers();
+  }
+
+  bool TryTake(Shard* shard, Tensor* output) {
+    embedding::profiled_lock<std::mutex> lock(
+        shard->mu, LOCK_CONTENTION_SITE("work_queue_shard"));
+    if (shard->works.empty()) {
+      return false;
+    }
+    output->scalar<string>().setConstant(std::move(shard->works.front()));
+    shard->works.pop_front();
+    --size_;
+    return true;
+  }
+
+  std::vector<std::unique_lock<std::mutex>> LockShards() {
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(shards_.size());
+    for (auto& shard : shards_) {
+      locks.emplace_back(shard.mu);
+    }
+    return locks;
+  }
+
+  // Takers check size_ and is_closed_ under mu_ before waiting, so locking
+  // mu_ after they change ensures no taker misses the notification.
+  void NotifyTakers() {
+    {
+      embedding::profiled_lock<std::mutex> lock(
+          mu_, LOCK_CONTENTION_SITE("work_queue"));
+    }
+    take_cv_.notify_all();
+  }
+
   string name_;
-  bool is_closed_;
+  std::atomic<bool> is_closed_;
+  std::atomic<int64> size_;
+  std::atomic<size_t> next_put_shard_;
+  std::atomic<size_t> next_take_shard_;
+  std::vector<Shard> shards_;
   std::mutex mu_;
   std::condition_variable take_cv_;
   std::shared_ptr<thread::ThreadPool> threads_;
+  StallCounters* stall_counters_;
+  std::mutex lease_mu_;
+  std::unordered_map<string, std::deque<string>> leases_;
+  std::unordered_set<string> released_;
 };
 
 REGISTER_RESOURCE_HANDLE_KERNEL(WorkQueue);
@@ -202,10 +369,11 @@ class WorkQueueCreateOp : public OpKernel {
  public:
   explicit WorkQueueCreateOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("shared_name", &shared_name_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_shards", &num_shards_));
   }
 
   void Compute(OpKernelContext* ctx) override {
-    WorkQueue* work_queue = new WorkQueue(shared_name_);
+    WorkQueue* work_queue = new WorkQueue(shared_name_, num_shards_);
     Status s = CreateResource(ctx, HandleFromInput(ctx, 0), work_queue);
     if (!s.ok() && s.code() != error::ALREADY_EXISTS) {
       OP_REQUIRES(ctx, false, s);
@@ -214,6 +382,7 @@ class WorkQueueCreateOp : public OpKernel {
 
  private:
   string shared_name_;
+  int64 num_shards_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("WorkQueueCreate").Device(DEVICE_CPU),
@@ -305,6 +474,9 @@ class WorkQueueTakeOp : public AsyncOpKernel {
  public:
   explicit WorkQueueTakeOp(OpKernelConstruction* ctx) : AsyncOpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("num_clients", &num_clients_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("client_index", &client_index_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("client_id", &client_id_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_leases", &num_leases_));
   }
 
   void ComputeAsync(OpKernelContext* ctx,
@@ -317,18 +489,84 @@ class WorkQueueTakeOp : public AsyncOpKernel {
       Tensor* work;
       OP_REQUIRES_OK_ASYNC(ctx, ctx->allocate_output(0, TensorShape({}), &work),
                            done);
-      OP_REQUIRES_OK_ASYNC(ctx, work_queue->Take(work), done);
+      if (num_leases_ > 0 && work_queue->IsReleased(client_id_)) {
+        OP_REQUIRES_OK_ASYNC(
+            ctx, errors::OutOfRange("Works of ", client_id_, " are released."),
+            done);
+      }
+      StallTime stall;
+      Status s = work_queue->Take(client_index_, work, &stall);
+      RecordWaitInStepStats(ctx, "consumer_wait", stall.start_nanos,
+                            stall.wait_nanos);
+      OP_REQUIRES_OK_ASYNC(ctx, s, done);
+      if (num_leases_ > 0) {
+        work_queue->Lease(client_id_, client_index_, num_leases_,
+                          work->scalar<string>()());
+      }
       done();
     });
   }
 
  private:
   int64 num_clients_;
+  int64 client_index_;
+  string client_id_;
+  int64 num_leases_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("WorkQueueTake").Device(DEVICE_CPU),
                         WorkQueueTakeOp);
 
+class WorkQueueReleaseOp : public OpKernel {
+ public:
+  explicit WorkQueueReleaseOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("client_index", &client_index_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("client_id", &client_id_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    WorkQueue* work_queue;
+    OP_REQUIRES_OK(ctx,
+                   LookupResource(ctx, HandleFromInput(ctx, 0), &work_queue));
+    core::ScopedUnref scoped_list(work_queue);
+    Tensor* num_releases;
+    OP_REQUIRES_OK(ctx,
+                   ctx->allocate_output(0, TensorShape({}), &num_releases));
+    num_releases->scalar<int64>()() =
+        work_queue->Release(client_id_, client_index_);
+  }
+
+ private:
+  int64 client_index_;
+  string client_id_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("WorkQueueRelease").Device(DEVICE_CPU),
+                        WorkQueueReleaseOp);
+
+// Returns the file of restore_works_dir where a worker saves the work it
+// took, named by the record range of the work.
+Status LocalWorkFile(const string& work, const string& job_name,
+                     int64 task_index, const string& restore_works_dir,
+                     string* range, string* slice_file) {
+  Env* const env = Env::Default();
+  std::vector<string> work_parts = str_util::Split(work, "?");
+  if (work_parts.size() != 2) {
+    return errors::InvalidArgument("Invalid table path format: ", work);
+  }
+  TF_RETURN_IF_ERROR(env->IsDirectory(restore_works_dir));
+
+  *range = str_util::StringReplace(work_parts[1], "=", "_", true);
+  *range = str_util::StringReplace(*range, "&", "_", true);
+  string worker_id = strings::StrCat(job_name, "_", task_index);
+  string worker_dir = strings::StrCat(restore_works_dir, "/", worker_id);
+  if (!env->IsDirectory(worker_dir).ok()) {
+    TF_RETURN_IF_ERROR(env->CreateDir(worker_dir));
+  }
+  *slice_file = strings::StrCat(worker_dir, "/", *range);
+  return Status::OK();
+}
+
 class SaveLocalWorkOp : public OpKernel {
  public:
   explicit SaveLocalWorkOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
@@ -343,21 +581,12 @@ class SaveLocalWorkOp : public OpKernel {
     const string& work = input_->scalar<string>()();
 
     Env* const env = Env::Default();
-    std::vector<string> work_parts = str_util::Split(work, "?");
-
-    OP_REQUIRES(ctx, work_parts.size() == 2,
-                errors::InvalidArgument("Invalid table path format: ", work));
-    OP_REQUIRES_OK(ctx, env->IsDirectory(restore_works_dir_));
-
     uint64 start_time = env->NowMicros();
-    string range = str_util::StringReplace(work_parts[1], "=", "_", true);
-    range = str_util::StringReplace(range, "&", "_", true);
-    string worker_id = strings::StrCat(job_name_, "_", task_index_);
-    string worker_dir = strings::StrCat(restore_works_dir_, "/", worker_id);
-    if (!env->IsDirectory(worker_dir).ok()) {
-      OP_REQUIRES_OK(ctx, env->CreateDir(worker_dir));
-    }
-    string slice_file = strings::StrCat(worker_dir, "/", range);
+    string range;
+    string slice_file;
+    OP_REQUIRES_OK(ctx, LocalWorkFile(work, job_name_, task_index_,
+                                      restore_works_dir_, &range,
+                                      &slice_file));
     std::unique_ptr<WritableFile> wfile;
     OP_REQUIRES_OK(ctx, env->NewWritableFile(slice_file, &wfile));
     OP_REQUIRES_OK(ctx, wfile->Append(work));
@@ -376,4 +605,44 @@ class SaveLocalWorkOp : public OpKernel {
 
 REGISTER_KERNEL_BUILDER(Name("SaveLocalWork").Device(DEVICE_CPU),
                         SaveLocalWorkOp);
+
+// Saves the number of records of a work already processed next to the
+// saved work, so that a restarted worker resumes the work after them. The
+// offset is written to a temporary file first and renamed, a worker killed
+// meanwhile leaves the previous offset.
+class SaveLocalWorkOffsetOp : public OpKernel {
+ public:
+  explicit SaveLocalWorkOffsetOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("job_name", &job_name_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("task_index", &task_index_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("restore_works_dir", &restore_works_dir_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const string& work = ctx->input(0).scalar<string>()();
+    const int64 offset = ctx->input(1).scalar<int64>()();
+
+    Env* const env = Env::Default();
+    string range;
+    string slice_file;
+    OP_REQUIRES_OK(ctx, LocalWorkFile(work, job_name_, task_index_,
+                                      restore_works_dir_, &range,
+                                      &slice_file));
+    const string offset_file = strings::StrCat(slice_file, ".offset");
+    const string tmp_file = strings::StrCat(offset_file, ".tmp");
+    OP_REQUIRES_OK(ctx, WriteStringToFile(env, tmp_file,
+                                          strings::StrCat(offset)));
+    OP_REQUIRES_OK(ctx, env->RenameFile(tmp_file, offset_file));
+    VLOG(1) << "Job_name:" << job_name_ << ", task_index:" << task_index_
+            << ", work_range:" << range << ", offset:" << offset;
+  }
+
+ private:
+  string job_name_;
+  int64 task_index_;
+  string restore_works_dir_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("SaveLocalWorkOffset").Device(DEVICE_CPU),
+                        SaveLocalWorkOffsetOp);
 }  // namespace tensorflow
@@ -17,25 +17,219 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/platform/context.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/denormal.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/platform/setround.h"
 #include "tensorflow/core/platform/tracing.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 namespace thread {
 
+// The active threads of a pool and the load measured for the adaptive
+// sizing. The workers of index NumActiveThreads() and above park after their
+// task, while the tasks left in their queues are stolen by the active ones.
+struct ThreadPoolLoad {
+  ThreadPoolLoad(int num_threads, int min_threads, bool measure)
+      : num_threads(num_threads), min_threads(min_threads), measure(measure),
+        active_threads(num_threads) {}
+
+  void MaybePark(int index) {
+    if (index < active_threads.load(std::memory_order_relaxed)) {
+      return;
+    }
+    mutex_lock l(mu);
+    while (index >= active_threads.load(std::memory_order_relaxed)) {
+      cv.wait(l);
+    }
+  }
+
+  void SetActiveThreads(int n) {
+    {
+      mutex_lock l(mu);
+      active_threads.store(n, std::memory_order_relaxed);
+    }
+    cv.notify_all();
+  }
+
+  const int num_threads;
+  const int min_threads;
+  const bool measure;
+  std::atomic<int> active_threads;
+  mutex mu;
+  condition_variable cv;
+
+  // Measured when measure is set.
+  std::atomic<int64> scheduled{0};
+  std::atomic<int64> started{0};
+  std::atomic<int> running{0};
+  std::atomic<int64> queue_nanos{0};
+  std::atomic<int64> busy_nanos{0};
+};
+
+namespace {
+
+// The pool and the index of the current thread, if it is a worker.
+struct WorkerIndex {
+  const ThreadPoolLoad* load = nullptr;
+  int index = -1;
+};
+thread_local WorkerIndex worker_index;
+
+bool AdaptiveThreadPoolsEnabled() {
+  static const bool enabled = [] {
+    bool enabled = false;
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_ADAPTIVE_THREAD_POOLS", false,
+                                   &enabled));
+    return enabled;
+  }();
+  return enabled;
+}
+
+// Resizes the registered pools every period: a pool whose tasks wait while
+// all its active threads are busy, or wait longer than kMaxQueueNanos, gets
+// more active threads, a pool busy less than half of the time gets fewer.
+// The active threads of all the pools are kept within the schedulable CPUs
+// by shrinking the pools which are the least busy, so the cores go to the
+// pools which are the bottleneck.
+class AdaptiveThreadPoolController {
+ public:
+  static AdaptiveThreadPoolController* Global() {
+    static AdaptiveThreadPoolController* controller =
+        new AdaptiveThreadPoolController;
+    return controller;
+  }
+
+  void Register(ThreadPoolLoad* load) {
+    mutex_lock l(mu_);
+    loads_.push_back({load, 0, 0, 0});
+    if (thread_ == nullptr) {
+      thread_.reset(Env::Default()->StartThread(
+          ThreadOptions(), "adaptive_thread_pools", [this]() { Loop(); }));
+    }
+  }
+
+  void Unregister(ThreadPoolLoad* load) {
+    mutex_lock l(mu_);
+    for (size_t i = 0; i < loads_.size(); i++) {
+      if (loads_[i].load == load) {
+        loads_.erase(loads_.begin() + i);
+        return;
+      }
+    }
+  }
+
+ private:
+  static constexpr int64 kPeriodMicros = 50000;
+  static constexpr int64 kMaxQueueNanos = 1000000;
+
+  struct Sample {
+    ThreadPoolLoad* load;
+    int64 started;
+    int64 queue_nanos;
+    int64 busy_nanos;
+  };
+
+  AdaptiveThreadPoolController()
+      : budget_(std::max(1, port::NumSchedulableCPUs())) {}
+
+  void Loop() {
+    while (true) {
+      Env::Default()->SleepForMicroseconds(kPeriodMicros);
+      mutex_lock l(mu_);
+      Resize();
+    }
+  }
+
+  void Resize() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    const int n = loads_.size();
+    std::vector<double> busy(n);
+    std::vector<bool> bottleneck(n);
+    std::vector<int> active(n);
+    int total = 0;
+    for (int i = 0; i < n; i++) {
+      Sample& sample = loads_[i];
+      ThreadPoolLoad* load = sample.load;
+      const int64 started = load->started.load(std::memory_order_relaxed);
+      const int64 queue_nanos =
+          load->queue_nanos.load(std::memory_order_relaxed);
+      const int64 busy_nanos = load->busy_nanos.load(std::memory_order_relaxed);
+      const int64 tasks = started - sample.started;
+      const int64 pending =
+          load->scheduled.load(std::memory_order_relaxed) - started;
+      active[i] = load->active_threads.load(std::memory_order_relaxed);
+      busy[i] = (busy_nanos - sample.busy_nanos) /
+                (kPeriodMicros * 1000.0 * active[i]);
+      // Tasks waiting while all the threads are busy may wait for a blocked
+      // task, which needs a thread to complete, so the pool grows then even
+      // beyond the budget.
+      bottleneck[i] =
+          pending > 0 &&
+          (load->running.load(std::memory_order_relaxed) >= active[i] ||
+           (tasks > 0 &&
+            (queue_nanos - sample.queue_nanos) / tasks > kMaxQueueNanos));
+      sample.started = started;
+      sample.queue_nanos = queue_nanos;
+      sample.busy_nanos = busy_nanos;
+
+      if (bottleneck[i] && active[i] < load->num_threads) {
+        active[i] += std::min(std::max(1, active[i] / 4),
+                              load->num_threads - active[i]);
+      } else if (!bottleneck[i] && busy[i] < 0.5 &&
+                 active[i] > load->min_threads) {
+        active[i] -= std::min(std::max(1, active[i] / 4),
+                              active[i] - load->min_threads);
+      }
+      total += active[i];
+    }
+    while (total > budget_) {
+      int victim = -1;
+      for (int i = 0; i < n; i++) {
+        if (!bottleneck[i] && active[i] > loads_[i].load->min_threads &&
+            (victim < 0 || busy[i] < busy[victim])) {
+          victim = i;
+        }
+      }
+      if (victim < 0) {
+        break;
+      }
+      active[victim]--;
+      total--;
+    }
+    for (int i = 0; i < n; i++) {
+      ThreadPoolLoad* load = loads_[i].load;
+      if (active[i] != load->active_threads.load(std::memory_order_relaxed)) {
+        load->SetActiveThreads(active[i]);
+      }
+    }
+  }
+
+  const int budget_;
+  mutex mu_;
+  std::vector<Sample> loads_ GUARDED_BY(mu_);
+  std::unique_ptr<Thread> thread_ GUARDED_BY(mu_);
+};
+
+}  // namespace
+
 struct EigenEnvironment {
   typedef Thread EnvThread;
   struct TaskImpl {
     std::function<void()> f;
     Context context;
     uint64 trace_id;
+    // When the task was scheduled if the load is measured, else 0.
+    uint64 schedule_nanos;
   };
   struct Task {
     Task() {}
@@ -49,13 +243,23 @@ struct EigenEnvironment {
   Env* const env_;
   const ThreadOptions thread_options_;
   const string name_;
+  int num_created_threads_;
+  const std::shared_ptr<ThreadPoolLoad> load_;
 
   EigenEnvironment(Env* env, const ThreadOptions& thread_options,
-                   const string& name)
-      : env_(env), thread_options_(thread_options), name_(name) {}
+                   const string& name, std::shared_ptr<ThreadPoolLoad> load)
+      : env_(env), thread_options_(thread_options), name_(name),
+        num_created_threads_(0), load_(std::move(load)) {}
 
   EnvThread* CreateThread(std::function<void()> f) {
+    const int cpu = thread_options_.cpus.empty() ? -1 :
+        thread_options_.cpus[num_created_threads_ %
+                             thread_options_.cpus.size()];
+    // The threads are created in the order of their index in the pool.
+    const int index = num_created_threads_++;
     return env_->StartThread(thread_options_, name_, [=]() {
+      worker_index.load = load_.get();
+      worker_index.index = index;
       // Set the processor flag to flush denormals to zero.
       port::ScopedFlushDenormal flush;
       // Set the processor rounding mode to ROUND TO NEAREST.
@@ -63,6 +267,16 @@ struct EigenEnvironment {
       if (thread_options_.numa_node != port::kNUMANoAffinity) {
         port::NUMASetThreadNodeAffinity(thread_options_.numa_node);
       }
+#if defined(__linux__)
+      if (cpu >= 0) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu, &cpuset);
+        if (sched_setaffinity(0, sizeof(cpu_set_t), &cpuset) != 0) {
+          LOG(WARNING) << "Failed to pin thread " << name_ << " to cpu " << cpu;
+        }
+      }
+#endif
       f();
     });
   }
@@ -74,11 +288,18 @@ struct EigenEnvironment {
       tracing::RecordEvent(tracing::EventCategory::kScheduleClosure, id);
     }
 
+    uint64 schedule_nanos = 0;
+    if (load_->measure) {
+      load_->scheduled.fetch_add(1, std::memory_order_relaxed);
+      schedule_nanos = env_->NowNanos();
+    }
+
     return Task{
         std::unique_ptr<TaskImpl>(new TaskImpl{
             std::move(f),
             Context(ContextKind::kThread),
             id,
+            schedule_nanos,
         }), cost
     };
   }
@@ -87,7 +308,24 @@ struct EigenEnvironment {
     WithContext wc(t.f->context);
     tracing::ScopedRegion region(tracing::EventCategory::kRunClosure,
                                  t.f->trace_id);
-    t.f->f();
+    if (t.f->schedule_nanos == 0) {
+      t.f->f();
+    } else {
+      const uint64 start_nanos = env_->NowNanos();
+      load_->started.fetch_add(1, std::memory_order_relaxed);
+      load_->queue_nanos.fetch_add(start_nanos - t.f->schedule_nanos,
+                                   std::memory_order_relaxed);
+      load_->running.fetch_add(1, std::memory_order_relaxed);
+      t.f->f();
+      load_->running.fetch_sub(1, std::memory_order_relaxed);
+      load_->busy_nanos.fetch_add(env_->NowNanos() - start_nanos,
+                                  std::memory_order_relaxed);
+    }
+    // Tasks which can't be queued run in the scheduling thread, which may
+    // be a worker of another pool.
+    if (worker_index.load == load_.get()) {
+      load_->MaybePark(worker_index.index);
+    }
   }
 };
 
@@ -102,9 +340,15 @@ ThreadPool::ThreadPool(Env* env, const ThreadOptions& thread_options,
                        const string& name, int num_threads,
                        bool low_latency_hint, Eigen::Allocator* allocator) {
   CHECK_GE(num_threads, 1);
+  const bool adaptive = AdaptiveThreadPoolsEnabled() && num_threads > 1;
+  load_ = std::make_shared<ThreadPoolLoad>(
+      num_threads, std::max(1, num_threads / 4), adaptive);
   eigen_threadpool_.reset(new Eigen::ThreadPoolTempl<EigenEnvironment>(
       num_threads, low_latency_hint,
-      EigenEnvironment(env, thread_options, "tf_" + name)));
+      EigenEnvironment(env, thread_options, "tf_" + name, load_)));
+  if (adaptive) {
+    AdaptiveThreadPoolController::Global()->Register(load_.get());
+  }
   underlying_threadpool_ = eigen_threadpool_.get();
   threadpool_device_.reset(new Eigen::ThreadPoolDevice(underlying_threadpool_,
                                                        num_threads, allocator));
@@ -116,7 +360,15 @@ ThreadPool::ThreadPool(thread::ThreadPoolInterface* user_threadpool) {
       underlying_threadpool_, underlying_threadpool_->NumThreads(), nullptr));
 }
 
-ThreadPool::~ThreadPool() {}
+ThreadPool::~ThreadPool() {
+  if (load_ != nullptr) {
+    if (load_->measure) {
+      AdaptiveThreadPoolController::Global()->Unregister(load_.get());
+    }
+    // The parked threads must exit with the others.
+    load_->SetActiveThreads(load_->num_threads);
+  }
+}
 
 void ThreadPool::SetThreadPoolAffinity(const cpu_set_t& cpuset) {
   underlying_threadpool_->SetThreadPoolAffinity(cpuset);
@@ -216,6 +468,20 @@ int ThreadPool::NumThreads() const {
   return underlying_threadpool_->NumThreads();
 }
 
+int ThreadPool::NumActiveThreads() const {
+  if (load_ == nullptr) {
+    return NumThreads();
+  }
+  return load_->active_threads.load(std::memory_order_relaxed);
+}
+
+void ThreadPool::SetNumActiveThreads(int num_threads) {
+  if (load_ != nullptr) {
+    load_->SetActiveThreads(
+        std::min(std::max(num_threads, 1), load_->num_threads));
+  }
+}
+
 int ThreadPool::CurrentThreadId() const {
   return underlying_threadpool_->CurrentThreadId();
 }
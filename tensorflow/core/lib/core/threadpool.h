@@ -38,6 +38,7 @@ namespace tensorflow {
 namespace thread {
 
 struct EigenEnvironment;
+struct ThreadPoolLoad;
 
 class ThreadPool {
  public:
@@ -136,6 +137,17 @@ class ThreadPool {
   // Returns the number of threads in the pool.
   int NumThreads() const;
 
+  // Returns the number of threads which take tasks. It is NumThreads() unless
+  // it is set by SetNumActiveThreads(), or by the adaptive sizing of the
+  // pools enabled by the environment variable TF_ADAPTIVE_THREAD_POOLS,
+  // which moves the active threads to the pools whose tasks wait.
+  int NumActiveThreads() const;
+
+  // Parks the threads of index num_threads and above after their current
+  // task, until the number of active threads grows back. Ignored by the
+  // pools wrapping a user_threadpool.
+  void SetNumActiveThreads(int num_threads);
+
   // Returns current thread id between 0 and NumThreads() - 1, if called from a
   // thread in the pool. Returns -1 otherwise.
   int CurrentThreadId() const;
@@ -153,6 +165,8 @@ class ThreadPool {
   // user_threadpool is not in the constructor.
   std::unique_ptr<Eigen::ThreadPoolTempl<EigenEnvironment>> eigen_threadpool_;
   std::unique_ptr<Eigen::ThreadPoolDevice> threadpool_device_;
+  // The active threads of eigen_threadpool_, null with a user_threadpool.
+  std::shared_ptr<ThreadPoolLoad> load_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(ThreadPool);
 };
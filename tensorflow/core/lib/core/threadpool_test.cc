@@ -210,6 +210,28 @@ TEST(ThreadPool, Parallelism) {
   }
 }
 
+TEST(ThreadPool, NumActiveThreads) {
+  ThreadPool pool(Env::Default(), "test", kNumThreads);
+  EXPECT_EQ(kNumThreads, pool.NumActiveThreads());
+  pool.SetNumActiveThreads(2);
+  EXPECT_EQ(2, pool.NumActiveThreads());
+  // The tasks queued to the parked threads are run by the active ones.
+  for (int iter = 0; iter < 10; iter++) {
+    absl::BlockingCounter counter(4 * kNumThreads);
+    for (int t = 0; t < 4 * kNumThreads; ++t) {
+      pool.Schedule([&counter]() {
+        Env::Default()->SleepForMicroseconds(10);
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+  pool.SetNumActiveThreads(kNumThreads + 1);
+  EXPECT_EQ(kNumThreads, pool.NumActiveThreads());
+  pool.SetNumActiveThreads(1);
+  // The pool is destroyed with parked threads.
+}
+
 static void BM_Sequential(int iters) {
   ThreadPool pool(Env::Default(), "test", kNumThreads);
   // Decrement count sequentially until 0.
@@ -840,5 +840,167 @@ void Hash64Farm_Batch512(const char** data, uint64_t* h_out, size_t len) {
   _mm512_storeu_si512((void*)h_out, ret);
 
 }
+
+// Pointers to the bytes at lens[i] - offset of data[i].
+inline void TailBatch(const char** data, const size_t* lens, size_t offset,
+                      const char** tail) {
+  for (int i = 0; i < 8; ++i) {
+    tail[i] = data[i] + lens[i] - offset;
+  }
+}
+
+// Same as HashLen0to16Batch with the length of every lane, the lengths are
+// in the same range of 0, [1, 3], [4, 7] or [8, 16].
+inline void HashLen0to16BatchVar(const char** data, uint64_t* h_out,
+                                 const size_t* lens) {
+  __m512i k0_batch = _mm512_set1_epi64(k0);
+  __m512i k2_batch = _mm512_set1_epi64(k2);
+  __m512i factor_len_batch = _mm512_loadu_si512((const void*)lens);
+  const char* tail[8];
+
+  if (lens[0] >= 8) {
+    __m512i mul = _mm512_add_epi64(factor_len_batch, factor_len_batch);
+    mul = _mm512_add_epi64(mul, k2_batch);
+    __m512i a = Fetch64Batch(data, 0);
+    a = _mm512_add_epi64(a, k2_batch);
+    TailBatch(data, lens, 8, tail);
+    __m512i b = Fetch64Batch(tail, 0);
+    __m512i c = Rotate64Batch(b, 37);
+    c = _mm512_mullo_epi64_hand(c, mul);
+    c = _mm512_add_epi64(c, a);
+    __m512i d = Rotate64Batch(a, 25);
+    d = _mm512_add_epi64(d, b);
+    d = _mm512_mullo_epi64_hand(d, mul);
+    __m512i ret = HashLen16Batch(c, d, mul);
+    _mm512_storeu_si512((void*)h_out, ret);
+    return;
+  }
+  if (lens[0] >= 4) {
+    __m512i mul = _mm512_add_epi64(factor_len_batch, factor_len_batch);
+    mul = _mm512_add_epi64(mul, k2_batch);
+    __m512i a = Fetch32Batch(data, 0);
+    a = _mm512_slli_epi64(a, 3);
+    a = _mm512_add_epi64(a, factor_len_batch);
+    TailBatch(data, lens, 4, tail);
+    __m512i ret = HashLen16Batch(a, Fetch32Batch(tail, 0), mul);
+    _mm512_storeu_si512((void*)h_out, ret);
+    return;
+  }
+  if (lens[0] > 0) {
+    const char* middle[8];
+    for (int i = 0; i < 8; ++i) {
+      middle[i] = data[i] + (lens[i] >> 1);
+    }
+    TailBatch(data, lens, 1, tail);
+    __m512i a = Fetch8Batch(data, 0);
+    __m512i b = Fetch8Batch(middle, 0);
+    __m512i c = Fetch8Batch(tail, 0);
+    __m512i y = _mm512_slli_epi64(b, 8);
+    y = _mm512_add_epi64(y, a);
+    __m512i z = _mm512_slli_epi64(c, 2);
+    z = _mm512_add_epi64(z, factor_len_batch);
+    y = _mm512_mullo_epi64_hand(y, k2_batch);
+    z = _mm512_mullo_epi64_hand(z, k0_batch);
+    y = _mm512_xor_si512(y, z);
+    __m512i ret = _mm512_mullo_epi64_hand(ShiftMixBatch(y), k2_batch);
+    _mm512_storeu_si512((void*)h_out, ret);
+    return;
+  }
+  _mm512_storeu_si512((void*)h_out, k2_batch);
+}
+
+// Same as HashLen17to32Batch with the length of every lane.
+inline void HashLen17to32BatchVar(const char** data, uint64_t* h_out,
+                                  const size_t* lens) {
+  __m512i k2_batch = _mm512_set1_epi64(k2);
+  __m512i k1_batch = _mm512_set1_epi64(k1);
+  __m512i factor_len_batch = _mm512_loadu_si512((const void*)lens);
+  __m512i mul = _mm512_add_epi64(factor_len_batch, factor_len_batch);
+  mul = _mm512_add_epi64(mul, k2_batch);
+  const char* tail[8];
+  __m512i a = Fetch64Batch(data, 0);
+  a = _mm512_mullo_epi64_hand(a, k1_batch);
+  __m512i b = Fetch64Batch(data, 8);
+  TailBatch(data, lens, 8, tail);
+  __m512i c = Fetch64Batch(tail, 0);
+  c = _mm512_mullo_epi64_hand(c, mul);
+  TailBatch(data, lens, 16, tail);
+  __m512i d = Fetch64Batch(tail, 0);
+  d = _mm512_mullo_epi64_hand(d, k2_batch);
+  __m512i r1 = Rotate64Batch(_mm512_add_epi64(a, b), 43);
+  __m512i r2 = Rotate64Batch(c, 30);
+  __m512i r3 = Rotate64Batch(_mm512_add_epi64(b, k2_batch), 18);
+  r2 = _mm512_add_epi64(r2, d);
+  r3 = _mm512_add_epi64(r3, a);
+  r3 = _mm512_add_epi64(r3, c);
+  __m512i ret = HashLen16Batch(_mm512_add_epi64(r1, r2), r3, mul);
+  _mm512_storeu_si512((void*)h_out, ret);
+}
+
+// Same as HashLen33to64Batch with the length of every lane.
+inline void HashLen33to64BatchVar(const char** data, uint64_t* h_out,
+                                  const size_t* lens) {
+  __m512i k2_batch = _mm512_set1_epi64(k2);
+  __m512i factor_len_batch = _mm512_loadu_si512((const void*)lens);
+  __m512i mul = _mm512_add_epi64(factor_len_batch, factor_len_batch);
+  mul = _mm512_add_epi64(mul, k2_batch);
+  const char* tail[8];
+  __m512i a = Fetch64Batch(data, 0);
+  a = _mm512_mullo_epi64_hand(a, k2_batch);
+  __m512i b = Fetch64Batch(data, 8);
+  TailBatch(data, lens, 8, tail);
+  __m512i c = Fetch64Batch(tail, 0);
+  c = _mm512_mullo_epi64_hand(c, mul);
+  TailBatch(data, lens, 16, tail);
+  __m512i d = Fetch64Batch(tail, 0);
+  d = _mm512_mullo_epi64_hand(d, k2_batch);
+  __m512i r1 = Rotate64Batch(_mm512_add_epi64(a, b), 43);
+  __m512i r2 = Rotate64Batch(c, 30);
+  __m512i y = _mm512_add_epi64(r1, r2);
+  y = _mm512_add_epi64(y, d);
+  r2 = Rotate64Batch(_mm512_add_epi64(b, k2_batch), 18);
+  r2 = _mm512_add_epi64(r2, a);
+  r2 = _mm512_add_epi64(r2, c);
+  __m512i z = HashLen16Batch(y, r2, mul);
+  __m512i e = Fetch64Batch(data, 16);
+  e = _mm512_mullo_epi64_hand(e, mul);
+  __m512i f = Fetch64Batch(data, 24);
+  TailBatch(data, lens, 32, tail);
+  __m512i g = Fetch64Batch(tail, 0);
+  g = _mm512_add_epi64(g, y);
+  g = _mm512_mullo_epi64_hand(g, mul);
+  TailBatch(data, lens, 24, tail);
+  __m512i h = Fetch64Batch(tail, 0);
+  h = _mm512_add_epi64(h, z);
+  h = _mm512_mullo_epi64_hand(h, mul);
+
+  r1 = Rotate64Batch(_mm512_add_epi64(e, f), 43);
+  r2 = Rotate64Batch(g, 30);
+  r1 = _mm512_add_epi64(r1, r2);
+  r1 = _mm512_add_epi64(r1, h);
+  r2 = Rotate64Batch(_mm512_add_epi64(f, a), 18);
+  r2 = _mm512_add_epi64(r2, e);
+  r2 = _mm512_add_epi64(r2, g);
+
+  __m512i ret = HashLen16Batch(r1, r2, mul);
+  _mm512_storeu_si512((void*)h_out, ret);
+}
+
+void Hash64Farm_Batch512(const char** data, uint64_t* h_out,
+                         const size_t* lens) {
+  switch (FarmHashBatchClass(lens[0])) {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+      HashLen0to16BatchVar(data, h_out, lens);
+      return;
+    case 4:
+      HashLen17to32BatchVar(data, h_out, lens);
+      return;
+    default:
+      HashLen33to64BatchVar(data, h_out, lens);
+  }
+}
 #endif
 }  // namespace tensorflow
@@ -74,8 +74,25 @@ extern inline void HashLen33to64Batch(const char** data, uint64_t* h_out,
 extern void Hash64V3_Batch512(const char** data, uint64* h_out, 
                               size_t n, uint64 seed);
 extern void Hash64Farm_Batch512(const char** data, uint64_t* h_out, size_t n);
+// Same as Hash64Farm_Batch512 with lens[i] being the length of data[i], the
+// lengths must be of the same FarmHashBatchClass.
+extern void Hash64Farm_Batch512(const char** data, uint64_t* h_out,
+                                const size_t* lens);
 #endif
 
+// Number of the classes of string lengths hashed together by the batched
+// farmhash, strings longer than 64 bytes have no class (-1).
+const int kFarmHashBatchClasses = 6;
+inline int FarmHashBatchClass(size_t len) {
+  if (len == 0) return 0;
+  if (len < 4) return 1;
+  if (len < 8) return 2;
+  if (len <= 16) return 3;
+  if (len <= 32) return 4;
+  if (len <= 64) return 5;
+  return -1;
+}
+
 inline uint64 Hash64(const char* data, size_t n) {
   return Hash64(data, n, 0xDECAFCAFFE);
 }
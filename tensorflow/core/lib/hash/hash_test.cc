@@ -300,6 +300,39 @@ TEST(Hash, SignedUnsignedIssueHash64FarmBatch) {
     EXPECT_EQ(c.hash64, h_value[7]);
   }
 }
+
+TEST(Hash, Hash64FarmBatchMixedLengths) {
+  char buf[64];
+  for (int i = 0; i < 64; ++i) {
+    buf[i] = static_cast<char>(i * 37 + 11);
+  }
+  const char* data_batch[8];
+  for (int j = 0; j < 8; ++j) {
+    data_batch[j] = buf + j % 3;
+  }
+  // Lanes of the same class, the lengths differ from lane to lane.
+  for (const std::vector<size_t>& lens : std::vector<std::vector<size_t>>{
+           {0, 0, 0, 0, 0, 0, 0, 0},
+           {1, 2, 3, 1, 2, 3, 3, 1},
+           {4, 5, 6, 7, 7, 6, 5, 4},
+           {8, 9, 11, 12, 13, 14, 15, 16},
+           {17, 18, 20, 23, 25, 28, 31, 32},
+           {33, 36, 40, 45, 50, 55, 60, 61},
+       }) {
+    uint64_t h_value[8];
+    Hash64Farm_Batch512(data_batch, &h_value[0], lens.data());
+    for (int j = 0; j < 8; ++j) {
+      EXPECT_EQ(FarmHashBatchClass(lens[0]), FarmHashBatchClass(lens[j]));
+      uint64_t expected[8];
+      const char* same_batch[8];
+      for (int k = 0; k < 8; ++k) {
+        same_batch[k] = data_batch[j];
+      }
+      Hash64Farm_Batch512(same_batch, &expected[0], lens[j]);
+      EXPECT_EQ(expected[0], h_value[j]);
+    }
+  }
+}
 #endif
 
 TEST(Hash, HashPtrIsNotIdentityFunction) {
@@ -0,0 +1,105 @@
+#include "tensorflow/core/framework/common_shape_fns.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+namespace {
+
+Status IdsAndEmbeddingsShapeFn(InferenceContext* c) {
+  ShapeHandle handle, ids, embeddings;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &handle));
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &ids));
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &embeddings));
+  DimensionHandle unused;
+  TF_RETURN_IF_ERROR(c->Merge(c->Dim(ids, 0), c->Dim(embeddings, 0), &unused));
+  return Status::OK();
+}
+
+}  // namespace
+
+// An approximate nearest neighbor index of item embeddings, for the
+// retrieval of two-tower models: an HNSW graph kept in the resource manager
+// of the session, searched by the user embeddings of the requests.
+REGISTER_OP("AnnIndexHandleOp")
+    .Attr("container: string = ''")
+    .Attr("shared_name: string = ''")
+    .Output("resource: resource")
+    .SetIsStateful()
+    .SetShapeFn(shape_inference::ScalarShape);
+
+// Replaces the index with one of 'embeddings', the rows of which are the
+// items 'ids'. 'metric' is "ip" to rank the items by inner product or "l2"
+// by euclidean distance.
+REGISTER_OP("AnnIndexBuild")
+    .Input("resource: resource")
+    .Input("ids: int64")
+    .Input("embeddings: float")
+    .Attr("metric: {'ip', 'l2'} = 'ip'")
+    .Attr("m: int >= 2 = 16")
+    .Attr("ef_construction: int >= 1 = 200")
+    .Attr("ef_search: int >= 1 = 64")
+    .SetIsStateful()
+    .SetShapeFn(IdsAndEmbeddingsShapeFn);
+
+// Inserts the items 'ids' or updates their embeddings. The items whose
+// embeddings are unchanged are skipped, so that all items can be upserted
+// again after each incremental update of the model.
+REGISTER_OP("AnnIndexUpsert")
+    .Input("resource: resource")
+    .Input("ids: int64")
+    .Input("embeddings: float")
+    .SetIsStateful()
+    .SetShapeFn(IdsAndEmbeddingsShapeFn);
+
+// Removes the items 'ids' from the results of the searches.
+REGISTER_OP("AnnIndexRemove")
+    .Input("resource: resource")
+    .Input("ids: int64")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &unused));
+      return Status::OK();
+    });
+
+// The 'k' items nearest to each of 'queries', best first. When the index
+// has fewer than 'k' items, the missing ids are -1 and their scores -inf.
+// The score is the inner product, or the negated squared distance for "l2".
+REGISTER_OP("AnnIndexSearch")
+    .Input("resource: resource")
+    .Input("queries: float")
+    .Output("ids: int64")
+    .Output("scores: float")
+    .Attr("k: int >= 1")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle handle, queries;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &handle));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &queries));
+      int k;
+      TF_RETURN_IF_ERROR(c->GetAttr("k", &k));
+      ShapeHandle output = c->Matrix(c->Dim(queries, 0), k);
+      c->set_output(0, output);
+      c->set_output(1, output);
+      return Status::OK();
+    });
+
+// The number of items in the index.
+REGISTER_OP("AnnIndexSize")
+    .Input("resource: resource")
+    .Output("size: int64")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    });
+
+}  // namespace tensorflow
@@ -1741,6 +1741,28 @@ REGISTER_OP("UniqueWithCountsV2")
       return Status::OK();
     });
 
+REGISTER_OP("UniqueWithPartitions")
+    .Input("x: T")
+    .Output("y: T")
+    .Output("idx: out_idx")
+    .Output("count: out_idx")
+    .Output("partition_sizes: out_idx")
+    .Attr("T: {int32, int64}")
+    .Attr("num_partitions: int >= 1")
+    .Attr("out_idx: {int32, int64} = DT_INT32")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 1, &input));
+      int num_partitions;
+      TF_RETURN_IF_ERROR(c->GetAttr("num_partitions", &num_partitions));
+      auto uniq = c->Vector(InferenceContext::kUnknownDim);
+      c->set_output(0, uniq);
+      c->set_output(1, input);
+      c->set_output(2, uniq);
+      c->set_output(3, c->Vector(num_partitions));
+      return Status::OK();
+    });
+
 namespace {
 
 Status ShapeShapeFn(InferenceContext* c) {
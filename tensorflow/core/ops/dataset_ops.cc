@@ -879,6 +879,7 @@ REGISTER_OP("IOKafkaDataset")
     .Input("config_topic: string")
     .Input("message_key: bool")
     .Output("handle: variant")
+    .Attr("batch_size: int = 0")
     .SetIsStateful()
     .SetShapeFn(shape_inference::ScalarShape);
 
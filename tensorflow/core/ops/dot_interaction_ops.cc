@@ -0,0 +1,52 @@
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+// The dot interaction of DLRM. For features of shape [batch, num, dim],
+// output row n holds features[n, 0, :] when concat_first_feature is set,
+// followed by the dots of features[n, i, :] and features[n, j, :] for all
+// j < i, in the order i = 1..num-1, j = 0..i-1. This is the strictly lower
+// triangle of matmul(features, features, transpose_b=True), packed by rows.
+REGISTER_OP("DotInteraction")
+    .Input("features: T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("concat_first_feature: bool = true")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle features;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 3, &features));
+      bool concat_first_feature;
+      TF_RETURN_IF_ERROR(
+          c->GetAttr("concat_first_feature", &concat_first_feature));
+      DimensionHandle num = c->Dim(features, 1);
+      DimensionHandle width;
+      if (c->ValueKnown(num)) {
+        const int64 n = c->Value(num);
+        width = c->MakeDim(n * (n - 1) / 2);
+      } else {
+        width = c->UnknownDim();
+      }
+      if (concat_first_feature) {
+        TF_RETURN_IF_ERROR(c->Add(width, c->Dim(features, 2), &width));
+      }
+      c->set_output(0, c->Matrix(c->Dim(features, 0), width));
+      return Status::OK();
+    });
+
+REGISTER_OP("DotInteractionGrad")
+    .Input("output_grad: T")
+    .Input("features: T")
+    .Output("features_grad: T")
+    .Attr("T: {float}")
+    .Attr("concat_first_feature: bool = true")
+    .SetShapeFn([](InferenceContext* c) {
+      c->set_output(0, c->input(1));
+      return Status::OK();
+    });
+
+}  // namespace tensorflow
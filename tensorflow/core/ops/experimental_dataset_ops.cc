@@ -890,6 +890,31 @@ REGISTER_OP("ExperimentalStatsAggregatorSummary")
     .Output("summary: string")
     .SetShapeFn(shape_inference::ScalarShape);
 
+REGISTER_OP("SyntheticRecsysDataset")
+    .Input("seed: int64")
+    .Input("batch_size: int64")
+    .Input("num_batches: int64")
+    .Output("handle: variant")
+    .Attr("num_dense: int >= 0 = 0")
+    .Attr("num_labels: int >= 1 = 1")
+    .Attr("label_positive_rate: float = 0.25")
+    .Attr("sparse_vocab_sizes: list(int) >= 0 = []")
+    .Attr("sparse_zipf_exponents: list(float) >= 0 = []")
+    .Attr("sparse_max_lengths: list(int) >= 0 = []")
+    .Attr("sequence_vocab_sizes: list(int) >= 0 = []")
+    .Attr("sequence_zipf_exponents: list(float) >= 0 = []")
+    .Attr("sequence_max_lengths: list(int) >= 0 = []")
+    .SetIsStateful()  // TODO(b/123753214): Source dataset ops must be marked
+                      // stateful to inhibit constant folding.
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      shape_inference::ShapeHandle unused;
+      // seed, batch_size and num_batches should be scalars.
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
+      return shape_inference::ScalarShape(c);
+    });
+
 REGISTER_OP("TakeWhileDataset")
     .Input("input_dataset: variant")
     .Input("other_arguments: Targuments")
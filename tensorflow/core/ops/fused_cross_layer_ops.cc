@@ -0,0 +1,53 @@
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+// The cross layer of DCN:
+//   y = x0 * reduce_sum(xl * w, axis=1, keepdims=True) + b + xl
+// where x0 is the input of the cross network and xl the output of the
+// previous cross layer.
+REGISTER_OP("FusedCrossLayer")
+    .Input("x0: T")
+    .Input("xl: T")
+    .Input("w: T")
+    .Input("b: T")
+    .Output("y: T")
+    .Attr("T: {float}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle x0, xl, w, b, y;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &x0));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &xl));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &w));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 1, &b));
+      TF_RETURN_IF_ERROR(c->Merge(x0, xl, &y));
+      DimensionHandle dim;
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(y, 1), c->Dim(w, 0), &dim));
+      TF_RETURN_IF_ERROR(c->Merge(dim, c->Dim(b, 0), &dim));
+      c->set_output(0, c->Matrix(c->Dim(y, 0), dim));
+      return Status::OK();
+    });
+
+REGISTER_OP("FusedCrossLayerGrad")
+    .Input("y_grad: T")
+    .Input("x0: T")
+    .Input("xl: T")
+    .Input("w: T")
+    .Output("x0_grad: T")
+    .Output("xl_grad: T")
+    .Output("w_grad: T")
+    .Output("b_grad: T")
+    .Attr("T: {float}")
+    .SetShapeFn([](InferenceContext* c) {
+      c->set_output(0, c->input(1));
+      c->set_output(1, c->input(2));
+      c->set_output(2, c->input(3));
+      c->set_output(3, c->input(3));
+      return Status::OK();
+    });
+
+}  // namespace tensorflow
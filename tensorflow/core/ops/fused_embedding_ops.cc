@@ -71,6 +71,7 @@ REGISTER_OP("FusedEmbeddingSparsePreLookUp")
     .Attr("prune_invalid_id: bool = false")
     .Attr("default_id: int = -1")
     .Attr("partition_strategy: {'div','mod'} = 'div'")
+    .Attr("sort_values: bool = false")
     .Input("partition_shapes: num_partitions * int64")
     .Input("sp_values: int64")
     .Input("sp_indices: int64")
@@ -123,7 +124,9 @@ REGISTER_OP("FusedEmbeddingSparsePreLookUp")
 // This op will first read the partition pattern of embedding variables through partition_shapes,
 // then sort, re-calculate and assign the embedding indices to the corresponding partition. Several Gather ops
 // usually should be appended after this op to gather embedding shards from multiple partitioned embedding
-// variables. This op has no gradient function.
+// variables. With sort_values, the GPU kernel also sorts the values of a single partition, so that
+// the Gather ops read the rows in order, as the values of multiple partitions always are.
+// This op has no gradient function.
 //     )doc");
 
 REGISTER_OP("FusedEmbeddingSparsePostLookUp")
@@ -0,0 +1,42 @@
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+// Consecutive dense layers fused for inference,
+// y = act_n(...act_1(x * weights_1 + biases_1)... * weights_n + biases_n).
+// The weights are packed at the first run, so they must be constant.
+REGISTER_OP("FusedMLP")
+    .Input("x: T")
+    .Input("weights: num_layers * T")
+    .Input("biases: num_layers * T")
+    .Output("y: T")
+    .Attr("T: {float}")
+    .Attr("num_layers: int >= 1")
+    .Attr("activations: list(string)")
+    .SetShapeFn([](InferenceContext* c) {
+      int num_layers;
+      TF_RETURN_IF_ERROR(c->GetAttr("num_layers", &num_layers));
+      ShapeHandle x;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &x));
+      DimensionHandle in_dim = c->Dim(x, 1);
+      ShapeHandle weights;
+      for (int i = 0; i < num_layers; i++) {
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(1 + i), 2, &weights));
+        DimensionHandle unused;
+        TF_RETURN_IF_ERROR(c->Merge(in_dim, c->Dim(weights, 0), &unused));
+        in_dim = c->Dim(weights, 1);
+        ShapeHandle bias;
+        TF_RETURN_IF_ERROR(
+            c->WithRank(c->input(1 + num_layers + i), 1, &bias));
+        TF_RETURN_IF_ERROR(c->Merge(in_dim, c->Dim(bias, 0), &unused));
+      }
+      c->set_output(0, c->Matrix(c->Dim(x, 0), in_dim));
+      return Status::OK();
+    });
+
+}  // namespace tensorflow
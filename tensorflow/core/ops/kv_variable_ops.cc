@@ -153,6 +153,7 @@ REGISTER_OP("InitializeKvVariableOp")
     .Attr("default_value_no_permission: float = .0")
     .Attr("record_freq: bool = false")
     .Attr("record_version: bool = false")
+    .Attr("int8_state: bool = false")
     .SetShapeFn([](InferenceContext* c) { 
       return Status::OK();
     })
@@ -200,6 +201,7 @@ REGISTER_OP("InitializeKvVariableV2Op")
     .Attr("record_freq: bool = false")
     .Attr("record_version: bool = false")
     .Attr("embedding_variable_type: int = 0")
+    .Attr("int8_state: bool = false")
     .SetShapeFn([](InferenceContext* c) {
       return Status::OK();
     })
@@ -401,6 +403,237 @@ Produces an output tensor with shape `indices.shape + params.shape[1:]` where:
 
 )doc");
 
+REGISTER_OP("KvResourceSequenceGather")
+    .Input("resource: resource")
+    .Input("values: Tkeys")
+    .Input("row_splits: int64")
+    .Output("output: dtype")
+    .Output("ids: Tkeys")
+    .Output("lengths: int32")
+    .Attr("max_length: int >= 1")
+    .Attr("combiner: {'none', 'sum', 'mean'} = 'none'")
+    .Attr("keep_last: bool = true")
+    .Attr("dtype: type")
+    .Attr("Tkeys: {int64, int32}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeAndType handle_shape_and_type;
+      TF_RETURN_IF_ERROR(
+          ValidateVariableResourceHandle(c, 0, &handle_shape_and_type));
+      ShapeHandle value_shape;
+      TF_RETURN_IF_ERROR(
+          c->WithRank(handle_shape_and_type.shape, 1, &value_shape));
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &unused));
+      ShapeHandle row_splits;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &row_splits));
+      DimensionHandle batch;
+      TF_RETURN_IF_ERROR(c->Subtract(c->Dim(row_splits, 0), 1, &batch));
+      int64 max_length;
+      TF_RETURN_IF_ERROR(c->GetAttr("max_length", &max_length));
+      string combiner;
+      TF_RETURN_IF_ERROR(c->GetAttr("combiner", &combiner));
+      if (combiner == "none") {
+        c->set_output(0, c->MakeShape({batch, c->MakeDim(max_length),
+                                       c->Dim(value_shape, 0)}));
+      } else {
+        c->set_output(0, c->Matrix(batch, c->Dim(value_shape, 0)));
+      }
+      c->set_output(1, c->Matrix(batch, max_length));
+      c->set_output(2, c->Vector(batch));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Looks up the ragged sequences of ids `values` and `row_splits` from the
+variable pointed to by `resource`, truncated to `max_length`.
+
+Sequence `b` is `values[row_splits[b]:row_splits[b + 1]]`. Its last
+`max_length` ids are kept when `keep_last` is set, the first ones otherwise.
+With `combiner` 'none', `output` is `[batch, max_length, dim]` with the
+embeddings of the kept ids followed by zeros; with 'sum' or 'mean' it is
+`[batch, dim]`, their sum or mean, zero for empty sequences.
+
+ids: The kept ids, `[batch, max_length]`, padded with zeros.
+lengths: The number of kept ids of each sequence.
+)doc");
+
+REGISTER_OP("KvResourceSampleNegatives")
+    .Input("resource: resource")
+    .Input("item_pool: Tkeys")
+    .Input("positives: Tkeys")
+    .Output("output: dtype")
+    .Output("ids: Tkeys")
+    .Attr("num_negatives: int >= 1")
+    .Attr("num_in_batch: int >= 0 = 0")
+    .Attr("distortion: float = 0.75")
+    .Attr("refresh_steps: int >= 1 = 1000")
+    .Attr("seed: int = 0")
+    .Attr("seed2: int = 0")
+    .Attr("dtype: type")
+    .Attr("Tkeys: {int64, int32}")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeAndType handle_shape_and_type;
+      TF_RETURN_IF_ERROR(
+          ValidateVariableResourceHandle(c, 0, &handle_shape_and_type));
+      ShapeHandle value_shape;
+      TF_RETURN_IF_ERROR(
+          c->WithRank(handle_shape_and_type.shape, 1, &value_shape));
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &unused));
+      ShapeHandle positives;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &positives));
+      int64 num_negatives;
+      TF_RETURN_IF_ERROR(c->GetAttr("num_negatives", &num_negatives));
+      DimensionHandle batch = c->Dim(positives, 0);
+      c->set_output(0, c->MakeShape({batch, c->MakeDim(num_negatives),
+                                     c->Dim(value_shape, 0)}));
+      c->set_output(1, c->Matrix(batch, num_negatives));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Samples `num_negatives` negatives for each of the `positives` and looks up
+their embeddings from the variable pointed to by `resource`.
+
+`num_in_batch` of them are the positives of other rows of the batch, the
+others are drawn from `item_pool` by an alias table of the weights
+`(freq + 1) ^ distortion`, the frequencies of the items in the variable.
+The table is rebuilt every `refresh_steps` runs and when `item_pool`
+changes. The distinct sampled ids are looked up at once.
+
+output: The embeddings of the negatives, `[batch, num_negatives, dim]`.
+ids: The sampled ids, `[batch, num_negatives]`.
+)doc");
+
+REGISTER_OP("KvResourceSparseCrossGather")
+    .Input("resource: resource")
+    .Input("indices: N * int64")
+    .Input("values: sparse_types")
+    .Input("shapes: N * int64")
+    .Output("output: dtype")
+    .Output("keys: int64")
+    .Output("row_splits: int64")
+    .Attr("N: int >= 1")
+    .Attr("num_buckets: int >= 0")
+    .Attr("hash_key: int")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'} = 'sum'")
+    .Attr("sparse_types: list({int64, string}) >= 1")
+    .Attr("dtype: type")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeAndType handle_shape_and_type;
+      TF_RETURN_IF_ERROR(
+          ValidateVariableResourceHandle(c, 0, &handle_shape_and_type));
+      ShapeHandle value_shape;
+      TF_RETURN_IF_ERROR(
+          c->WithRank(handle_shape_and_type.shape, 1, &value_shape));
+      c->set_output(0, c->Matrix(c->UnknownDim(), c->Dim(value_shape, 0)));
+      c->set_output(1, c->Vector(c->UnknownDim()));
+      c->set_output(2, c->Vector(c->UnknownDim()));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Looks up the hashed crosses of the sparse features `indices`, `values` and
+`shapes` from the variable pointed to by `resource`, and combines the
+embeddings of the crosses of each row.
+
+The keys are those of SparseCross with `hashed_output`, `num_buckets` and
+`hash_key`, without building the crossed SparseTensor. `output` is
+`[batch, dim]`, zero for the rows without crosses.
+
+keys: The keys of the crosses, row after row.
+row_splits: The crosses of row `b` are `keys[row_splits[b]:row_splits[b + 1]]`.
+)doc");
+
+REGISTER_OP("KvResourceSparseCrossGatherGrad")
+    .Input("grad: dtype")
+    .Input("keys: int64")
+    .Input("row_splits: int64")
+    .Output("unique_keys: int64")
+    .Output("values: dtype")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'} = 'sum'")
+    .Attr("dtype: type")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle grad;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &grad));
+      c->set_output(0, c->Vector(c->UnknownDim()));
+      c->set_output(1, c->Matrix(c->UnknownDim(), c->Dim(grad, 1)));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+The gradient of KvResourceSparseCrossGather, summed by key.
+
+grad: The gradient of its `output`.
+unique_keys: The keys of the crosses, once each.
+values: The gradients of the rows of `unique_keys`.
+)doc");
+
+REGISTER_OP("KvResourceGroupGather")
+    .Input("resources: num_tables * resource")
+    .Input("indices: Tkeys")
+    .Output("outputs: num_tables * dtype")
+    .Output("pointers: int64")
+    .Attr("num_tables: int >= 1")
+    .Attr("dtype: type")
+    .Attr("Tkeys: {int64, int32}")
+    .SetShapeFn([](InferenceContext* c) {
+      int num_tables;
+      TF_RETURN_IF_ERROR(c->GetAttr("num_tables", &num_tables));
+      ShapeHandle indices_shape = c->input(num_tables);
+      for (int i = 0; i < num_tables; ++i) {
+        ShapeAndType handle_shape_and_type;
+        TF_RETURN_IF_ERROR(
+            ValidateVariableResourceHandle(c, i, &handle_shape_and_type));
+        ShapeHandle value_shape;
+        TF_RETURN_IF_ERROR(
+            c->WithRank(handle_shape_and_type.shape, 1, &value_shape));
+        ShapeHandle out;
+        TF_RETURN_IF_ERROR(c->Concatenate(indices_shape, value_shape, &out));
+        c->set_output(i, out);
+      }
+      c->set_output(num_tables, indices_shape);
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Gathers `indices` from the variables pointed to by `resources`, which share
+one key index, probing it once for all of them.
+
+The variables are the tables of an EmbeddingVariable group: a primary and
+the variables created with it as their primary, whose rows are held by the
+same entries of its storage.
+
+outputs: The rows of `indices` of each table.
+pointers: The entries of `indices` in the storage, which the apply ops of
+  the tables take as indices with `indices_as_pointer`.
+)doc");
+
+Status GroupEmbeddingVarLookupShapeFn(InferenceContext* c) {
+  int num_lookups;
+  TF_RETURN_IF_ERROR(c->GetAttr("num_lookups", &num_lookups));
+
+  for (int i = 0; i < num_lookups; ++i) {
+    ShapeAndType handle_shape_and_type;
+    TF_RETURN_IF_ERROR(
+        ValidateVariableResourceHandle(c, i, &handle_shape_and_type));
+
+    ShapeHandle unused;
+    TF_RETURN_IF_ERROR(
+        c->WithRankAtLeast(handle_shape_and_type.shape, 1, &unused));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(num_lookups*2+i), 2, &unused));
+    // TF_RETURN_IF_ERROR(c->WithRank(c->input(num_lookups*3+i), 1, &unused));
+    ShapeHandle params_subshape;
+    params_subshape = handle_shape_and_type.shape;
+
+    ShapeHandle indices_shape = c->input(num_lookups+i);
+    ShapeHandle out;
+    TF_RETURN_IF_ERROR(c->Concatenate(indices_shape, params_subshape, &out));
+    c->set_output(i, out);
+    c->set_output(num_lookups + i, c->Vector(InferenceContext::kUnknownDim));
+    c->set_output(num_lookups * 2 + i, c->input(num_lookups+i));
+    c->set_output(num_lookups * 3 + i, c->Vector(InferenceContext::kUnknownDim));
+  }
+
+  return Status::OK();
+}
+
 REGISTER_OP("GroupEmbeddingVarLookup")
     .Input("resource: num_lookups * resource")
     .Input("sp_values: num_lookups * Tkeys")
@@ -422,34 +655,94 @@ REGISTER_OP("GroupEmbeddingVarLookup")
     .Attr("max_norm: float = -1.0")
     .Attr("num_lookups: int >= 1")
     .Attr("is_inference: bool = false")
+    .SetShapeFn(GroupEmbeddingVarLookupShapeFn);
+
+REGISTER_OP("_OPT_GroupEmbeddingVarLookup")
+    .Input("resource: num_lookups * resource")
+    .Input("sp_values: num_lookups * Tkeys")
+    .Input("sp_indices: num_lookups * int64")
+    .Input("sp_weights: num_lookups * dtype")
+    .Input("dense_shape: num_lookups * int64")
+    .Input("default_value: dtype")
+    .Attr("ignore_weights: bool = false")
+    .Attr("is_use_default_value_tensor: bool = false")
+    .Attr("is_sequence: bool = false")
+    .Attr("combiner: {'sqrtn', 'mean', 'sum'}")
+    .Attr("dimension: int")
+    .Output("output: num_lookups * dtype")
+    .Output("unique_keys: num_lookups * Tkeys")
+    .Output("unique_idx: num_lookups * int32")
+    .Output("batch_nums: num_lookups * int32")
+    .Output("pointer: num_lookups * int64")
+    .Attr("dtype: type")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("max_norm: float = -1.0")
+    .Attr("num_lookups: int >= 1")
+    .Attr("is_inference: bool = false")
     .SetShapeFn([](InferenceContext* c) {
+      TF_RETURN_IF_ERROR(GroupEmbeddingVarLookupShapeFn(c));
       int num_lookups;
       TF_RETURN_IF_ERROR(c->GetAttr("num_lookups", &num_lookups));
-      
       for (int i = 0; i < num_lookups; ++i) {
-        ShapeAndType handle_shape_and_type;
-        TF_RETURN_IF_ERROR(
-            ValidateVariableResourceHandle(c, i, &handle_shape_and_type));
+        c->set_output(num_lookups * 4 + i, c->output(num_lookups + i));
+      }
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Same as GroupEmbeddingVarLookup, additionally outputs the `pointer` of every
+unique key so that the optimizer can update it without looking it up again.
+)doc");
 
-        ShapeHandle unused;
-        TF_RETURN_IF_ERROR(
-            c->WithRankAtLeast(handle_shape_and_type.shape, 1, &unused));
-        TF_RETURN_IF_ERROR(c->WithRank(c->input(num_lookups*2+i), 2, &unused));
-        // TF_RETURN_IF_ERROR(c->WithRank(c->input(num_lookups*3+i), 1, &unused));
-        ShapeHandle params_subshape;
-        params_subshape = handle_shape_and_type.shape;
-        
-        ShapeHandle indices_shape = c->input(num_lookups+i);
-        ShapeHandle out;
-        TF_RETURN_IF_ERROR(c->Concatenate(indices_shape, params_subshape, &out));
-        c->set_output(i, out);
-        c->set_output(num_lookups + i, c->Vector(InferenceContext::kUnknownDim));
-        c->set_output(num_lookups * 2 + i, c->input(num_lookups+i));
-        c->set_output(num_lookups * 3 + i, c->Vector(InferenceContext::kUnknownDim));
+REGISTER_OP("_GroupEmbeddingVarLookupConcat")
+    .Input("resource: num_lookups * resource")
+    .Input("sp_values: num_lookups * Tkeys")
+    .Input("sp_indices: num_lookups * int64")
+    .Input("sp_weights: num_lookups * dtype")
+    .Input("dense_shape: num_lookups * int64")
+    .Input("default_value: dtype")
+    .Attr("ignore_weights: bool = false")
+    .Attr("is_use_default_value_tensor: bool = false")
+    .Attr("is_sequence: bool = false")
+    .Attr("combiner: {'sqrtn', 'mean', 'sum'}")
+    .Attr("dimension: int")
+    .Attr("concat_positions: list(int)")
+    .Output("output: dtype")
+    .Output("unique_keys: num_lookups * Tkeys")
+    .Output("unique_idx: num_lookups * int32")
+    .Output("batch_nums: num_lookups * int32")
+    .Output("output_shapes: num_lookups * int32")
+    .Attr("dtype: type")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("max_norm: float = -1.0")
+    .Attr("num_lookups: int >= 1")
+    .Attr("is_inference: bool = false")
+    .SetShapeFn([](InferenceContext* c) {
+      int num_lookups;
+      TF_RETURN_IF_ERROR(c->GetAttr("num_lookups", &num_lookups));
+      int dimension;
+      TF_RETURN_IF_ERROR(c->GetAttr("dimension", &dimension));
+      c->set_output(0, c->Matrix(InferenceContext::kUnknownDim,
+                                 num_lookups * dimension));
+      for (int i = 0; i < num_lookups; ++i) {
+        c->set_output(1 + i, c->Vector(InferenceContext::kUnknownDim));
+        c->set_output(1 + num_lookups + i, c->input(num_lookups + i));
+        c->set_output(1 + num_lookups * 2 + i,
+                      c->Vector(InferenceContext::kUnknownDim));
+        c->set_output(1 + num_lookups * 3 + i, c->Vector(2));
       }
-      
       return Status::OK();
-    });
+    })
+    .Doc(R"doc(
+GroupEmbeddingVarLookup followed by the ConcatV2 of its outputs along the
+columns, which the combiner of every lookup writes to directly instead of
+to an output of its own.
+
+concat_positions: The position of the output of each lookup in the concat.
+output: The concat of the outputs of the lookups, [batch_size,
+  num_lookups * dimension].
+output_shapes: The shape of the output of each lookup, for the consumers
+  of the shapes of the outputs, e.g. the gradient of the concat.
+)doc");
 
 REGISTER_OP("GroupEmbeddingVariableLookupGrad")
     .Input("grads: num_lookups * dtype")
@@ -475,6 +768,37 @@ REGISTER_OP("GroupEmbeddingVariableLookupGrad")
       return Status::OK();
     });
 
+REGISTER_OP("_GroupEmbeddingVariableLookupConcatGrad")
+    .Input("grad: dtype")
+    .Input("embedding_resources: num_lookups * resource")
+    .Input("unique_keys: num_lookups * Tkeys")
+    .Input("sp_indices: num_lookups * int64")
+    .Input("batch_nums: num_lookups * int32")
+    .Output("nnz_grads: num_lookups * dtype")
+    .Attr("dimension: int")
+    .Attr("combiner: {'sqrtn', 'mean', 'sum'}")
+    .Attr("concat_positions: list(int)")
+    .Attr("num_lookups: int >=1")
+    .Attr("dtype: type")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("max_norm: float = -1.0")
+    .SetShapeFn([](InferenceContext* ctx) {
+      int num_lookups = ctx->num_outputs();
+      int dimension;
+      TF_RETURN_IF_ERROR(ctx->GetAttr("dimension", &dimension));
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(ctx->WithRank(ctx->input(0), 2, &unused));
+      for (int i = 0; i < num_lookups; ++i) {
+        ctx->set_output(i, ctx->Matrix(ctx->UnknownDim(), dimension));
+      }
+      return Status::OK();
+    })
+    .Doc(R"doc(
+GroupEmbeddingVariableLookupGrad of the gradient of the output of
+_GroupEmbeddingVarLookupConcat, which reads the gradient of every lookup
+from its columns of `grad` instead of from a slice of its own.
+)doc");
+
 REGISTER_OP("GroupVariableLookup")
     .Input("emb_variables: num_lookups * dtype")
     .Input("sp_values: num_lookups * Tkeys")
@@ -849,6 +1173,108 @@ versions: Vector of all versions present in the table.
 freqs: Vector of all freqs present in the table.
 )doc");
 
+REGISTER_OP("KvResourceApplyDelta")
+    .Input("resource_handle: resource")
+    .Input("keys: Tkeys")
+    .Input("values: Tvalues")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("Tvalues: type")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle keys;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &keys));
+      ShapeHandle values;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &values));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(keys, 0), c->Dim(values, 0), &unused));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Overwrites the rows of keys in the kv resource, the missing keys are created.
+
+resource_handle: Handle to the kvResource.
+keys: Vector of the keys of a delta checkpoint.
+values: The rows of keys. Indexed in parallel with `keys`.
+)doc");
+
+REGISTER_OP("KvResourceExportBuckets")
+    .Input("resource_handle: resource")
+    .Input("buckets: int32")
+    .Output("keys: Tkeys")
+    .Output("values: Tvalues")
+    .Output("versions: int64")
+    .Output("freqs: int64")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("Tvalues: type")
+    .Attr("bucket_num: int = 1000")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle buckets;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &buckets));
+      c->set_output(0, c->Vector(InferenceContext::kUnknownDim));
+      c->set_output(1, c->Matrix(InferenceContext::kUnknownDim,
+                                 InferenceContext::kUnknownDim));
+      c->set_output(2, c->Vector(InferenceContext::kUnknownDim));
+      c->set_output(3, c->Vector(InferenceContext::kUnknownDim));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Outputs the rows of the keys in the given buckets, `key % bucket_num`.
+
+resource_handle: Handle to the kvResource.
+buckets: The buckets to export.
+keys: Vector of the keys in the buckets.
+values: The rows of keys. Indexed in parallel with `keys`.
+versions: The versions of keys, empty if they are not recorded.
+freqs: The freqs of keys, empty if they are not recorded.
+)doc");
+
+REGISTER_OP("KvResourceRemoveBuckets")
+    .Input("resource_handle: resource")
+    .Input("buckets: int32")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("Tvalues: type")
+    .Attr("bucket_num: int = 1000")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle buckets;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &buckets));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Removes the rows of the keys in the given buckets, with all their slots.
+
+resource_handle: Handle to the primary kvResource.
+buckets: The buckets to remove.
+)doc");
+
+REGISTER_OP("KvResourceImportRows")
+    .Input("resource_handle: resource")
+    .Input("keys: Tkeys")
+    .Input("values: Tvalues")
+    .Input("versions: int64")
+    .Input("freqs: int64")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("Tvalues: type")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle keys;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &keys));
+      ShapeHandle values;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &values));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(keys, 0), c->Dim(values, 0), &unused));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Overwrites the rows of keys in the kv resource with the rows exported from
+another partition, the missing keys are created.
+
+resource_handle: Handle to the kvResource.
+keys: Vector of the keys to import.
+values: The rows of keys. Indexed in parallel with `keys`.
+versions: The versions of keys, or empty.
+freqs: The freqs of keys, or empty.
+)doc");
+
 REGISTER_OP("EVGetFrequency")
     .Input("resource_handle: resource")
     .Input("ids: Tkeys")
@@ -871,6 +1297,26 @@ REGISTER_OP("EVGetVersion")
     })
     .Doc(R"doc()doc");
 
+REGISTER_OP("EVGetStats")
+    .Input("resource_handle: resource")
+    .Output("names: string")
+    .Output("values: double")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("Tvalues: type")
+    .SetShapeFn([](InferenceContext* c) {
+      c->set_output(0, c->Vector(InferenceContext::kUnknownDim));
+      c->set_output(1, c->Vector(InferenceContext::kUnknownDim));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Returns the runtime statistics of an EmbeddingVariable.
+
+names: The names of the statistics, e.g. lookups, lookup_usecs_per_call,
+  creation_ratio, filter_rejection_ratio, first_tier_hit_ratio,
+  row_cache_hit_ratio and tier0_bytes.
+values: The values of the statistics, in the order of names.
+)doc");
+
 REGISTER_OP("KvResourceLookupTier")
     .Input("resource_handle: resource")
     .Input("ids: Tkeys")
@@ -882,6 +1328,20 @@ REGISTER_OP("KvResourceLookupTier")
     })
     .Doc(R"doc()doc");
 
+REGISTER_OP("KvResourcePrefetch")
+    .Input("resource_handle: resource")
+    .Input("indices: Tkeys")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("dtype: type")
+    .SetIsStateful()
+    .SetShapeFn(shape_inference::NoOutputs)
+    .Doc(R"doc(
+Promotes the embeddings of `indices` to the first tier of the variable
+pointed to by `resource` in the background, ahead of their lookup.
+
+Only multi-tier storages with HBM as the first tier prefetch.
+)doc");
+
 REGISTER_OP("KvResourceLookupResource")
     .Input("resource_handle: resource")
     .Attr("Tkeys: {int64, int32}")
@@ -893,4 +1353,264 @@ REGISTER_OP("KvResourceLookupResource")
     })
     .Doc(R"doc()doc");
 
+REGISTER_OP("HotRowCacheHandleOp")
+    .Attr("container: string = ''")
+    .Attr("shared_name: string = ''")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("dtype: type")
+    .Output("resource: resource")
+    .SetIsStateful()
+    .SetShapeFn(shape_inference::ScalarShape)
+    .Doc(R"doc(
+Creates a handle to a worker side cache of the hot rows of an
+EmbeddingVariable.
+)doc");
+
+REGISTER_OP("HotRowCacheLookup")
+    .Input("cache: resource")
+    .Input("ids: Tkeys")
+    .Input("global_step: int64")
+    .Output("values: dtype")
+    .Output("hits: bool")
+    .Output("is_stale: bool")
+    .Attr("value_dim: int")
+    .Attr("max_staleness_steps: int")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("dtype: type")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle ids;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &ids));
+      int64 value_dim;
+      TF_RETURN_IF_ERROR(c->GetAttr("value_dim", &value_dim));
+      c->set_output(0, c->Matrix(c->Dim(ids, 0), value_dim));
+      c->set_output(1, ids);
+      c->set_output(2, c->Scalar());
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Reads the cached rows of `ids`, `hits` marks the ids found in the cache and
+the values of the others are zeros.
+
+`is_stale` is true when the cache was refreshed `max_staleness_steps` or
+more steps before `global_step`, then all the ids miss.
+)doc");
+
+REGISTER_OP("HotRowCacheRefresh")
+    .Input("cache: resource")
+    .Input("ids: Tkeys")
+    .Input("values: dtype")
+    .Input("freqs: int64")
+    .Input("global_step: int64")
+    .Attr("max_rows: int")
+    .Attr("min_freq: int = 0")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("dtype: type")
+    .SetIsStateful()
+    .SetShapeFn(shape_inference::NoOutputs)
+    .Doc(R"doc(
+Replaces the cached rows with the rows of at most `max_rows` of the most
+frequent `ids` whose `freqs` are at least `min_freq`.
+)doc");
+
+REGISTER_OP("HotRowCacheAccumulate")
+    .Input("cache: resource")
+    .Input("ids: Tkeys")
+    .Input("grads: dtype")
+    .Input("global_step: int64")
+    .Output("flush_ids: Tkeys")
+    .Output("flush_grads: dtype")
+    .Attr("max_staleness_steps: int")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("dtype: type")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle grads;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &grads));
+      c->set_output(0, c->Vector(c->UnknownDim()));
+      c->set_output(1, c->Matrix(c->UnknownDim(), c->Dim(grads, 1)));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Sums `grads` per id into the cache, and outputs the sums once per
+`max_staleness_steps` steps. The outputs are empty on the other steps.
+)doc");
+
+REGISTER_OP("KvResourceGatherIfModified")
+    .Input("resource: resource")
+    .Input("indices: Tkeys")
+    .Input("versions: int64")
+    .Output("modified: bool")
+    .Output("output: dtype")
+    .Output("output_versions: int64")
+    .Attr("dtype: type")
+    .Attr("Tkeys: {int32,int64}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeAndType handle_shape_and_type;
+      TF_RETURN_IF_ERROR(
+          ValidateVariableResourceHandle(c, 0, &handle_shape_and_type));
+      ShapeHandle indices;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &indices));
+      ShapeHandle out;
+      TF_RETURN_IF_ERROR(c->Concatenate(c->Vector(c->UnknownDim()),
+                                        handle_shape_and_type.shape, &out));
+      c->set_output(0, indices);
+      c->set_output(1, out);
+      c->set_output(2, indices);
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Gathers the embeddings of the `indices` whose versions differ from
+`versions`, `modified` marks them in `indices` and `output` is their
+embeddings in order. `output_versions` is the versions of all the `indices`.
+
+When the variable doesn't record the versions, all the `indices` are
+modified and `output_versions` are -1.
+)doc");
+
+REGISTER_OP("KvResourceGatherRowAddresses")
+    .Input("resource: resource")
+    .Input("indices: Tkeys")
+    .Output("addresses: int64")
+    .Output("remote_keys: int64")
+    .Output("row_bytes: int64")
+    .Output("versions: int64")
+    .Attr("dtype: type")
+    .Attr("Tkeys: {int32,int64}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeAndType handle_shape_and_type;
+      TF_RETURN_IF_ERROR(
+          ValidateVariableResourceHandle(c, 0, &handle_shape_and_type));
+      ShapeHandle indices;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &indices));
+      for (int i = 0; i < 4; ++i) {
+        c->set_output(i, indices);
+      }
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Outputs where the rows of the `indices` are in the memory of the process, for
+the workers to read them with one-sided RDMA READs instead of gathering them.
+Reading `row_bytes` at `addresses` with `remote_keys` returns a 16 bytes
+header followed by the row, the low 48 bits of the first 8 bytes are the
+global step of the last update of the row. `versions` is that step when the
+variable records the versions, -1 otherwise.
+
+The `addresses` are 0 for the keys without a row, and for all the keys when
+the rows aren't single blocks of DRAM registered for remote reads. Those keys
+are to be gathered.
+)doc");
+
+REGISTER_OP("EVWorkerCacheHandleOp")
+    .Attr("container: string = ''")
+    .Attr("shared_name: string = ''")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("dtype: type")
+    .Output("resource: resource")
+    .SetIsStateful()
+    .SetShapeFn(shape_inference::ScalarShape)
+    .Doc(R"doc(
+Creates a handle to a worker side cache of the embeddings read from a remote
+EmbeddingVariable.
+)doc");
+
+REGISTER_OP("EVWorkerCacheLookup")
+    .Input("cache: resource")
+    .Input("ids: Tkeys")
+    .Output("values: dtype")
+    .Output("hits: bool")
+    .Output("miss_ids: Tkeys")
+    .Output("miss_versions: int64")
+    .Attr("value_dim: int")
+    .Attr("max_staleness_steps: int")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("dtype: type")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      int64 value_dim;
+      TF_RETURN_IF_ERROR(c->GetAttr("value_dim", &value_dim));
+      ShapeHandle values;
+      TF_RETURN_IF_ERROR(c->Concatenate(c->input(1), c->Vector(value_dim),
+                                        &values));
+      c->set_output(0, values);
+      c->set_output(1, c->input(1));
+      c->set_output(2, c->Vector(c->UnknownDim()));
+      c->set_output(3, c->Vector(c->UnknownDim()));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Reads the cached embeddings of `ids`, `values` is shaped as the output of
+KvResourceGather and `hits` as `ids`. The ids fetched within the last
+`max_staleness_steps` lookups hit, the others are `miss_ids` with the
+versions of their cached embeddings, -1 for the ids not in the cache.
+)doc");
+
+REGISTER_OP("EVWorkerCacheMerge")
+    .Input("cache: resource")
+    .Input("values: dtype")
+    .Input("hits: bool")
+    .Input("miss_ids: Tkeys")
+    .Input("modified: bool")
+    .Input("modified_values: dtype")
+    .Input("versions: int64")
+    .Output("output: dtype")
+    .Attr("capacity: int = 0")
+    .Attr("max_staleness_steps: int")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("dtype: type")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      c->set_output(0, c->input(1));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Merges the embeddings gathered by KvResourceGatherIfModified for the
+`miss_ids` of EVWorkerCacheLookup into its `values`, and caches them.
+`capacity` > 0 bounds the number of cached embeddings.
+)doc");
+
+REGISTER_OP("KvIdsDedupEncode")
+    .Input("ids: Tkeys")
+    .Input("counts: int64")
+    .Output("encoded: uint8")
+    .Output("idx: int32")
+    .Attr("encode_counts: bool = false")
+    .Attr("Tkeys: {int64, int32}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle ids;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 1, &ids));
+      c->set_output(0, c->Vector(c->UnknownDim()));
+      c->set_output(1, ids);
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Encodes the `ids` of a lookup of an EmbeddingVariable on a remote PS: the
+unique ids are sorted, and their deltas are encoded as varints. KvIdsDecode
+decodes them on the PS for the gather, and the rows gathered in that order
+are expanded back by gathering them with `idx`, the position of each of the
+`ids` in the sorted unique ids.
+
+With `encode_counts`, the counts of the unique ids are encoded after them,
+the sums of their `counts`, or their numbers of occurrences when `counts` is
+empty.
+)doc");
+
+REGISTER_OP("KvIdsDecode")
+    .Input("encoded: uint8")
+    .Output("ids: Tkeys")
+    .Output("counts: int64")
+    .Attr("decode_counts: bool = false")
+    .Attr("Tkeys: {int64, int32}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 1, &unused));
+      c->set_output(0, c->Vector(c->UnknownDim()));
+      c->set_output(1, c->Vector(c->UnknownDim()));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Decodes the sorted unique ids encoded by KvIdsDedupEncode, and their counts
+with `decode_counts`, `counts` is empty otherwise.
+)doc");
+
 }  // namespace tensorflow
@@ -92,6 +92,12 @@ REGISTER_OP("ScalarSummary")
     .Attr("T: realnumbertype")
     .SetShapeFn(shape_inference::ScalarShape);
 
+REGISTER_OP("InputStallSummary")
+    .Input("tag: string")
+    .Output("summary: string")
+    .SetIsStateful()
+    .SetShapeFn(shape_inference::ScalarShape);
+
 REGISTER_OP("HistogramSummary")
     .Input("tag: string")
     .Input("values: T")
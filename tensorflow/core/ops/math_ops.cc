@@ -1410,6 +1410,29 @@ REGISTER_OP("UnsortedSegmentProd")
     .Attr("Tnumsegments: {int32,int64} = DT_INT32")
     .SetShapeFn(shape_inference::UnsortedSegmentReductionShapeFn);
 
+REGISTER_OP("UniqueSegmentSum")
+    .Input("data: T")
+    .Input("ids: Tindices")
+    .Output("output: T")
+    .Output("unique_ids: Tindices")
+    .Attr("T: realnumbertype")
+    .Attr("Tindices: {int32,int64}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle ids;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &ids));
+      ShapeHandle data;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 1, &data));
+      TF_RETURN_IF_ERROR(c->MergePrefix(data, ids, &data, &ids));
+      ShapeHandle data_suffix;
+      TF_RETURN_IF_ERROR(c->Subshape(data, 1, &data_suffix));
+      ShapeHandle out;
+      TF_RETURN_IF_ERROR(c->Concatenate(
+          c->Vector(InferenceContext::kUnknownDim), data_suffix, &out));
+      c->set_output(0, out);
+      c->set_output(1, c->Vector(InferenceContext::kUnknownDim));
+      return Status::OK();
+    });
+
 #ifndef TF_API_COMPATIBLE_1150
 REGISTER_OP("SparseSegmentSum")
     .Input("data: T")
@@ -0,0 +1,96 @@
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+// The dense layers of the experts of MMoE and PLE as one grouped matmul:
+//   y[:, e, :] = act(x_e * w[e] + b[e])
+// where x_e is x for an input shared by the experts, [batch, in], or
+// x[:, e, :] for an input per expert, [batch, experts, in]. y is
+// [batch, experts, out], the layout of the experts stacked on axis 1.
+REGISTER_OP("MultiExpertDense")
+    .Input("x: T")
+    .Input("w: T")
+    .Input("b: T")
+    .Output("y: T")
+    .Attr("T: {float}")
+    .Attr("activation: {'none', 'relu'} = 'relu'")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle x, w, b;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 2, &x));
+      TF_RETURN_IF_ERROR(c->WithRankAtMost(x, 3, &x));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 3, &w));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &b));
+      DimensionHandle experts, in, out;
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(w, 0), c->Dim(b, 0), &experts));
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(w, 2), c->Dim(b, 1), &out));
+      if (c->Rank(x) == 3) {
+        TF_RETURN_IF_ERROR(c->Merge(experts, c->Dim(x, 1), &experts));
+      }
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(x, -1), c->Dim(w, 1), &in));
+      c->set_output(0, c->MakeShape({c->Dim(x, 0), experts, out}));
+      return Status::OK();
+    });
+
+REGISTER_OP("MultiExpertDenseGrad")
+    .Input("y_grad: T")
+    .Input("x: T")
+    .Input("w: T")
+    .Input("y: T")
+    .Output("x_grad: T")
+    .Output("w_grad: T")
+    .Output("b_grad: T")
+    .Attr("T: {float}")
+    .Attr("activation: {'none', 'relu'} = 'relu'")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle w;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 3, &w));
+      c->set_output(0, c->input(1));
+      c->set_output(1, w);
+      c->set_output(2, c->Matrix(c->Dim(w, 0), c->Dim(w, 2)));
+      return Status::OK();
+    });
+
+// The gate of a task of MMoE and PLE, the softmax of the gate logits and
+// the sum of the experts it weights:
+//   gates = softmax(gate_logits)
+//   y[n] = sum_e gates[n, e] * experts[n, e, :]
+// gates is output for the gradient.
+REGISTER_OP("MultiExpertGate")
+    .Input("experts: T")
+    .Input("gate_logits: T")
+    .Output("y: T")
+    .Output("gates: T")
+    .Attr("T: {float}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle experts, logits;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 3, &experts));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &logits));
+      DimensionHandle batch, num_experts;
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(experts, 0), c->Dim(logits, 0),
+                                  &batch));
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(experts, 1), c->Dim(logits, 1),
+                                  &num_experts));
+      c->set_output(0, c->Matrix(batch, c->Dim(experts, 2)));
+      c->set_output(1, c->Matrix(batch, num_experts));
+      return Status::OK();
+    });
+
+REGISTER_OP("MultiExpertGateGrad")
+    .Input("y_grad: T")
+    .Input("experts: T")
+    .Input("gates: T")
+    .Output("experts_grad: T")
+    .Output("gate_logits_grad: T")
+    .Attr("T: {float}")
+    .SetShapeFn([](InferenceContext* c) {
+      c->set_output(0, c->input(1));
+      c->set_output(1, c->input(2));
+      return Status::OK();
+    });
+
+}  // namespace tensorflow
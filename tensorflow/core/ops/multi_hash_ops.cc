@@ -0,0 +1,41 @@
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+// The lookup of a multi-hash variable with the quotient-remainder strategy:
+// the embedding of id is composed from row floor(id / num_buckets) of
+// params_q and row id mod num_buckets of params_r, added, multiplied or
+// concatenated.
+REGISTER_OP("MultiHashEmbeddingLookup")
+    .Input("params_q: T")
+    .Input("params_r: T")
+    .Input("ids: Tindices")
+    .Output("output: T")
+    .Attr("T: {float, double}")
+    .Attr("Tindices: {int32, int64}")
+    .Attr("num_buckets: int >= 1")
+    .Attr("operation: {'add', 'mul', 'concat'}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle params_q, params_r;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &params_q));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &params_r));
+      DimensionHandle dim;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(params_q, 1), c->Dim(params_r, 1), &dim));
+      string operation;
+      TF_RETURN_IF_ERROR(c->GetAttr("operation", &operation));
+      if (operation == "concat") {
+        TF_RETURN_IF_ERROR(c->Multiply(dim, 2, &dim));
+      }
+      ShapeHandle output;
+      TF_RETURN_IF_ERROR(c->Concatenate(c->input(2), c->Vector(dim), &output));
+      c->set_output(0, output);
+      return Status::OK();
+    });
+
+}  // namespace tensorflow
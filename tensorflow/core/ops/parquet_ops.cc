@@ -28,6 +28,10 @@ REGISTER_OP("ParquetTabularDatasetV1")
     .Attr("partition_count: int = 1")
     .Attr("partition_index: int = 0")
     .Attr("drop_remainder: bool = false")
+    .Attr("filter_names: list(string) = []")
+    .Attr("filter_ops: list(string) = []")
+    .Attr("filter_values: list(string) = []")
+    .Attr("field_hash_buckets: list(int) = []")
     .SetIsStateful()  // NOTE: Source dataset ops must be marked stateful to
                       // inhibit constant folding.
     .SetShapeFn([](shape_inference::InferenceContext* c) {
@@ -168,4 +168,35 @@ client_terminated: If set to true, this indicates that the node was added
   locally by the caller.
 )doc");
 
+REGISTER_OP("_CompressGradient")
+    .Input("gradient: float")
+    .Output("compressed: uint8")
+    .Attr("block_size: int = 256")
+    .SetIsStateful()
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      c->set_output(0, c->Vector(c->UnknownDim()));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Quantizes a dense gradient to 8 bits before it is sent to another task.
+
+Every block of block_size values is scaled by its max absolute value. The
+quantization error is kept by the kernel and added to the gradient of the
+next step (error feedback), so no update is lost over the steps.
+
+gradient: The gradient to send.
+compressed: The shape, the scales and the 8-bit values of the gradient.
+)doc");
+
+REGISTER_OP("_DecompressGradient")
+    .Input("compressed: uint8")
+    .Output("gradient: float")
+    .SetShapeFn(shape_inference::UnknownShape)
+    .Doc(R"doc(
+Restores the gradient quantized by _CompressGradient.
+
+compressed: The output of _CompressGradient.
+gradient: The dequantized gradient.
+)doc");
+
 }  // end namespace tensorflow
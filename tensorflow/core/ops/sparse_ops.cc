@@ -276,6 +276,29 @@ REGISTER_OP("SparseValidCutoff")
       return Status::OK();
     });
 
+REGISTER_OP("SparseValidCutoffToHashBucketFast")
+    .Input("indices: int64")
+    .Input("values: string")
+    .Input("dense_shape: int64")
+    .Output("output_indices: int64")
+    .Output("output_values: int64")
+    .Output("output_dense_shape: int64")
+    .Attr("num_buckets: int >= 1")
+    .Attr("axis: int")
+    .Attr("length: int")
+    .Attr("side: {'left', 'right'} = 'right'")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle indices;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &indices));
+      ShapeHandle shape;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &shape));
+      c->set_output(
+          0, c->Matrix(InferenceContext::kUnknownDim, c->Dim(indices, 1)));
+      c->set_output(1, c->Vector(c->UnknownDim()));
+      c->set_output(2, shape);
+      return Status::OK();
+    });
+
 REGISTER_OP("SparseReverse")
     .Input("indices: int64")
     .Input("values: T")
@@ -124,6 +124,25 @@ REGISTER_OP("StringSplitAndPad")
       return Status::OK();
     });
 
+REGISTER_OP("StringSplitAndPadToHashBucketFast")
+    .Input("input: string")
+    .Input("delimiter: string")
+    .Input("max_length: int64")
+    .Input("default_value: string")
+    .Output("output: int64")
+    .Attr("num_buckets: int >= 1")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 1, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 0, &unused));
+
+      c->set_output(0, c->Matrix(c->Dim(c->input(0), 0),
+                                 InferenceContext::kUnknownDim));
+      return Status::OK();
+    });
+
 REGISTER_OP("DenseDecode")
     .Input("input: string")
     .Input("max_id: int64")
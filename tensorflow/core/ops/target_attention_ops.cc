@@ -0,0 +1,54 @@
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+// Masked softmax of attention scores followed by the weighted sum of the
+// values, as in the target attention of DIN, DIEN and BST:
+//   output = matmul(softmax(where(mask, scores, padding)), values)
+// The batch of mask may divide the batch of scores, row n of scores uses
+// row n % batch(mask) of mask. This covers heads that are stacked on the
+// batch dimension.
+REGISTER_OP("TargetAttention")
+    .Input("scores: T")
+    .Input("values: T")
+    .Input("mask: bool")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("padding: float = -4294967295.0")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle scores, values, mask;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 3, &scores));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 3, &values));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &mask));
+      DimensionHandle batch, length, unused;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(scores, 0), c->Dim(values, 0), &batch));
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(scores, 2), c->Dim(values, 1), &length));
+      TF_RETURN_IF_ERROR(c->Merge(length, c->Dim(mask, 1), &unused));
+      c->set_output(0, c->MakeShape({batch, c->Dim(scores, 1),
+                                     c->Dim(values, 2)}));
+      return Status::OK();
+    });
+
+REGISTER_OP("TargetAttentionGrad")
+    .Input("output_grad: T")
+    .Input("scores: T")
+    .Input("values: T")
+    .Input("mask: bool")
+    .Output("scores_grad: T")
+    .Output("values_grad: T")
+    .Attr("T: {float}")
+    .Attr("padding: float = -4294967295.0")
+    .SetShapeFn([](InferenceContext* c) {
+      c->set_output(0, c->input(1));
+      c->set_output(1, c->input(2));
+      return Status::OK();
+    });
+
+}  // namespace tensorflow
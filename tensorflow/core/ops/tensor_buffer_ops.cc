@@ -32,6 +32,7 @@ REGISTER_OP("TensorBufferPut")
     .Attr("shared_name: string = ''")
     .Attr("shared_capacity: int >= 1 = 1")
     .Attr("timeout_millis: int >= 1 = 1000")
+    .Attr("use_pinned_memory: bool = false")
     .SetShapeFn(shape_inference::UnknownShape)
     .SetIsStateful();
 
@@ -68,4 +69,29 @@ REGISTER_OP("TensorBufferSize")
     .SetShapeFn(shape_inference::ScalarShape)
     .SetIsStateful();
 
+// Packs the tensors of a sample into one buffer of GPU compatible host memory,
+// so that they are copied to GPU at once: a header of their shapes and
+// offsets, then the device_tensors and the host_tensors, each aligned.
+REGISTER_OP("TensorPackPinned")
+    .Input("device_tensors: Tdevice")
+    .Input("host_tensors: Thost")
+    .Output("packed: uint8")
+    .Attr("Tdevice: list(type) >= 0")
+    .Attr("Thost: list(type) >= 0")
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      c->set_output(0, c->Vector(c->UnknownDim()));
+      return Status::OK();
+    });
+
+// Unpacks the tensors packed by TensorPackPinned. On GPU, the device_tensors
+// are copied from the packed buffer by one copy, and the host_tensors stay in
+// it.
+REGISTER_OP("TensorUnpackToDevice")
+    .Input("packed: uint8")
+    .Output("device_tensors: Tdevice")
+    .Output("host_tensors: Thost")
+    .Attr("Tdevice: list(type) >= 0")
+    .Attr("Thost: list(type) >= 0")
+    .SetShapeFn(shape_inference::UnknownShape);
+
 }
@@ -132,6 +132,73 @@ REGISTER_OP_BY_NAME("KvResourceSparseApplyAdagradWithCounts");
 REGISTER_OP_BY_NAME("_OPT_KvResourceSparseApplyAdagradWithCounts");
 #undef REGISTER_OP_BY_NAME
 
+// The sparse Adagrad applies of the gradients clipped by a global norm: the
+// gradients are scaled by grad_scale while they are applied.
+static Status KvResourceApplyAdagradScaledShapeFn(InferenceContext* c) {
+  ShapeHandle unused;
+  TF_RETURN_IF_ERROR(KvResourceApplyAdagradShapeFn(c, true /* sparse */));
+  TF_RETURN_IF_ERROR(
+      c->WithRank(c->input(c->num_inputs() - 1), 0, &unused));  // grad_scale
+  return Status::OK();
+}
+
+REGISTER_OP("KvResourceSparseApplyAdagradScaled")
+    .Input("var: resource")
+    .Input("accum: resource")
+    .Input("lr: T")
+    .Input("grad: T")
+    .Input("indices: Tindices")
+    .Input("global_step: Tstep")
+    .Input("grad_scale: T")
+    .Attr("T: numbertype")
+    .Attr("Tindices: {int32, int64}")
+    .Attr("Tstep: {int32, int64}")
+    .Attr("use_locking: bool = false")
+    .SetShapeFn(KvResourceApplyAdagradScaledShapeFn);
+
+REGISTER_OP("KvResourceSparseApplyAdagradScaledWithCounts")
+    .Input("var: resource")
+    .Input("accum: resource")
+    .Input("lr: T")
+    .Input("grad: T")
+    .Input("indices: Tindices")
+    .Input("global_step: Tstep")
+    .Input("indices_counts: int64")
+    .Input("grad_scale: T")
+    .Attr("T: numbertype")
+    .Attr("Tindices: {int32, int64}")
+    .Attr("Tstep: {int32, int64}")
+    .Attr("use_locking: bool = false")
+    .SetShapeFn(KvResourceApplyAdagradScaledShapeFn);
+
+// Sums the rows of values of the same indices, as unique and
+// unsorted_segment_sum do, and outputs the squared L2 norm of the summed
+// rows, computed while they are summed.
+REGISTER_OP("KvSparseGradAggregate")
+    .Input("values: T")
+    .Input("indices: Tindices")
+    .Output("summed_values: T")
+    .Output("unique_indices: Tindices")
+    .Output("indices_counts: int64")
+    .Output("squared_norm: float")
+    .Attr("T: {bfloat16, float}")
+    .Attr("Tindices: {int32, int64}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle values, indices, rows;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 1, &values));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &indices));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(values, 0), c->Dim(indices, 0), &unused));
+      TF_RETURN_IF_ERROR(
+          c->ReplaceDim(values, 0, c->UnknownDim(), &rows));
+      c->set_output(0, rows);
+      c->set_output(1, c->Vector(c->UnknownDim()));
+      c->set_output(2, c->Vector(c->UnknownDim()));
+      c->set_output(3, c->Scalar());
+      return Status::OK();
+    });
+
 static Status KvResourceApplyFtrlShapeFn(InferenceContext* c, bool sparse) {
   ShapeHandle unused;
   ShapeHandle s = ShapeOrHandleShape(c, 0);                       // var
@@ -763,4 +830,29 @@ REGISTER_OP_BY_NAME("KvResourceSparseApplyAdamWWithCounts");
 REGISTER_OP_BY_NAME("_OPT_KvResourceSparseApplyAdamWWithCounts");
 #undef REGISTER_OP_BY_NAME
 
+// Merges the sparse gradients of the micro batches of an apply of an
+// EmbeddingVariable under Auto Micro Batch, so that the apply looks up each
+// id once per mini batch: the gradients and the counts of an id are summed.
+// merged_counts is empty without counts.
+REGISTER_OP("_KvSparseGradientAccumulate")
+    .Input("grads: N * T")
+    .Input("indices: N * Tindices")
+    .Input("counts: M * int64")
+    .Output("merged_indices: Tindices")
+    .Output("merged_grad: T")
+    .Output("merged_counts: int64")
+    .Attr("N: int >= 1")
+    .Attr("M: int >= 0")
+    .Attr("T: numbertype")
+    .Attr("Tindices: {int32, int64}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle grad;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 1, &grad));
+      TF_RETURN_IF_ERROR(c->ReplaceDim(grad, 0, c->UnknownDim(), &grad));
+      c->set_output(0, c->Vector(InferenceContext::kUnknownDim));
+      c->set_output(1, grad);
+      c->set_output(2, c->Vector(InferenceContext::kUnknownDim));
+      return Status::OK();
+    });
+
 }  // namespace tensorflow
@@ -39,12 +39,14 @@ handle: Handle of a work queue.
 REGISTER_OP("WorkQueueCreate")
     .Input("handle: resource")
     .Attr("shared_name: string")
+    .Attr("num_shards: int >= 1 = 1")
     .SetShapeFn(tensorflow::shape_inference::NoOutputs)
     .Doc(R"doc(
 Creates a work queue and returns a handle to it.
 
 handle: Handle of a work queue.
 shared_name: Name of the work queue.
+num_shards: Number of shards of the work queue, each shard has its own lock.
 )doc");
 
 REGISTER_OP("WorkQueueClose")
@@ -109,6 +111,9 @@ REGISTER_OP("WorkQueueTake")
     .Input("handle: resource")
     .Output("work: string")
     .Attr("num_clients: int >= 1 = 1")
+    .Attr("client_index: int = -1")
+    .Attr("client_id: string = ''")
+    .Attr("num_leases: int >= 0 = 0")
     .SetShapeFn(shape_inference::ScalarShape)
     .SetIsStateful()
     .Doc(R"doc(
@@ -117,6 +122,30 @@ Take a work from the work queue.
 handle: Handle of a work queue.
 work: A tensor of taken work.
 num_clients:  Number of threads for taking works.
+client_index: Index of the client, works are taken from shard
+  `client_index % num_shards` first and from the other shards when it is empty.
+  If negative, the shards are used in turn.
+client_id: Unique id of the client process, which leases the works it takes.
+num_leases: Number of the last works taken by `client_id` kept leased, which
+  `WorkQueueRelease` puts back. 0 by default, which keeps none.
+)doc");
+
+REGISTER_OP("WorkQueueRelease")
+    .Input("handle: resource")
+    .Output("num_releases: int64")
+    .Attr("client_index: int = -1")
+    .Attr("client_id: string")
+    .SetShapeFn(shape_inference::ScalarShape)
+    .SetIsStateful()
+    .Doc(R"doc(
+Puts the works leased by a client back to the work queue, so that the other
+clients take them when it leaves before finishing them.
+
+handle: Handle of a work queue.
+num_releases: Number of works put back.
+client_index: Index of the client, the works are put to the front of shard
+  `client_index % num_shards`.
+client_id: Unique id of the client process, as in `WorkQueueTake`.
 )doc");
 
 REGISTER_OP("SaveLocalWork")
@@ -142,6 +171,30 @@ task_index: index of current tf-worker.
 restore_works_dir: a directory that restore works for WorkQueue when failover.
 )doc");
 
+REGISTER_OP("SaveLocalWorkOffset")
+    .Input("work: string")
+    .Input("offset: int64")
+    .Attr("job_name: string = ''")
+    .Attr("task_index: int >= 0 = 0")
+    .Attr("restore_works_dir: string = ''")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      shape_inference::ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Save the number of records of a work already processed, a worker restored
+after failover for inference job resumes the work after them.
+
+work: a tensor containing work.
+offset: the number of records of work already processed.
+job_name: name of current tf-worker.
+task_index: index of current tf-worker.
+restore_works_dir: a directory that restore works for WorkQueue when failover.
+)doc");
+
 WHITELIST_STATEFUL_OP_FOR_DATASET_FUNCTIONS("QueueDequeueV2");
 
 } // tensorflow
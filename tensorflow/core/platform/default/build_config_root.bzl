@@ -73,6 +73,7 @@ def tf_additional_star_deps():
         str(Label("//tensorflow:with_star_support")): [
              str(Label("//tensorflow/contrib/star:star_server_base_lib")),
              str(Label("//tensorflow/contrib/star_server:star_server_lib")),
+             str(Label("//tensorflow/contrib/star:rdma_star_server_lib")),
         ],
         "//conditions:default": [],
     })
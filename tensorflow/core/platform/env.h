@@ -439,6 +439,9 @@ struct ThreadOptions {
   /// Guard area size to use near thread stacks to use (in bytes)
   size_t guard_size = 0;  // 0: use system default value
   int numa_node = port::kNUMANoAffinity;
+  /// If not empty, the i-th thread started by a thread pool is pinned to
+  /// cpus[i % cpus.size()].
+  std::vector<unsigned> cpus;
 };
 
 /// A utility routine: copy contents of `src` in file system `src_fs`
@@ -229,6 +229,11 @@ class alignas(alignof(T) * N) AlignedVector {
     UNROLL_ON_DEVICE for (int i = 0; i < kSize; ++i) { values_[i] = uniform; }
   }
 
+  __host__ __device__ value_type& operator[](int i) { return values_[i]; }
+  __host__ __device__ const value_type& operator[](int i) const {
+    return values_[i];
+  }
+
  private:
   value_type values_[N];
 };
@@ -117,6 +117,69 @@ class ParquetDatasetTest(test_base.DatasetTestBase):
         end_row = (i + 1) * batch_size
         np.testing.assert_equal(result[fld], c[start_row:end_row].to_numpy())
 
+  def test_read_with_filters(self):
+    batch_size = 32
+    with tf.Graph().as_default() as graph:
+      ds = parquet_dataset_ops.ParquetDataset(
+        self._filename,
+        batch_size=batch_size,
+        fields=[parquet_dataset_ops.DataFrame.Field('C', tf.int64)],
+        filters=[('A', '<', 50), ('B', '>=', 10)])
+      batch = tf.data.make_one_shot_iterator(ds).get_next()
+
+    expected = self._df[(self._df['A'] < 50) & (self._df['B'] >= 10)]
+    results = []
+    with tf.Session(graph=graph) as sess:
+      while True:
+        try:
+          results.append(sess.run(batch)['C'])
+        except tf.errors.OutOfRangeError:
+          break
+    np.testing.assert_equal(np.concatenate(results),
+                            expected['C'].to_numpy())
+
+  def test_read_with_filters_skip_row_groups(self):
+    with tf.Graph().as_default() as graph:
+      ds = parquet_dataset_ops.ParquetDataset(
+        self._filename,
+        batch_size=32,
+        fields=[parquet_dataset_ops.DataFrame.Field('C', tf.int64)],
+        filters=[('A', '>', 1000)])
+      batch = tf.data.make_one_shot_iterator(ds).get_next()
+
+    with tf.Session(graph=graph) as sess:
+      with self.assertRaises(tf.errors.OutOfRangeError):
+        sess.run(batch)
+
+  def test_read_hash_buckets(self):
+    filename = os.path.join(self._workspace, 'test_strings.parquet')
+    df = pd.DataFrame({
+        'S': ['s%d' % (i % 7) for i in xrange(200)],
+        'A': np.arange(200, dtype=np.int64)})
+    # pandas writes the string columns dictionary encoded.
+    df.to_parquet(filename)
+    batch_size = 32
+    with tf.Graph().as_default() as graph:
+      ds = parquet_dataset_ops.ParquetDataset(
+        filename,
+        batch_size=batch_size,
+        fields=[parquet_dataset_ops.DataFrame.Field('S', tf.string),
+                parquet_dataset_ops.DataFrame.Field('A', tf.int64)],
+        hash_buckets={'S': 1000})
+      self.assertEqual(ds.element_spec['S'].dtype, tf.int64)
+      batch = tf.data.make_one_shot_iterator(ds).get_next()
+      expected = tf.strings.to_hash_bucket_fast(df['S'].to_numpy(), 1000)
+
+    with tf.Session(graph=graph) as sess:
+      expected = sess.run(expected)
+      for i in xrange(200 // batch_size):
+        result = sess.run(batch)
+        start_row = i * batch_size
+        end_row = (i + 1) * batch_size
+        np.testing.assert_equal(result['S'], expected[start_row:end_row])
+        np.testing.assert_equal(result['A'],
+                                df['A'][start_row:end_row].to_numpy())
+
   def test_read_from_generator(self):
     num_epochs = 2
     batch_size = 100
@@ -0,0 +1,91 @@
+# Copyright 2023 The DeepRec Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =============================================================================
+"""Tests for `SyntheticRecsysDataset`."""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import numpy as np
+
+from tensorflow.python.data.experimental.ops import synthetic_recsys_dataset_ops
+from tensorflow.python.data.kernel_tests import test_base
+from tensorflow.python.framework import errors
+from tensorflow.python.framework import test_util
+from tensorflow.python.platform import test
+
+
+@test_util.run_all_in_graph_and_eager_modes
+class SyntheticRecsysDatasetTest(test_base.DatasetTestBase):
+
+  def _dataset(self, seed):
+    return synthetic_recsys_dataset_ops.SyntheticRecsysDataset(
+        batch_size=64,
+        num_batches=3,
+        seed=seed,
+        num_dense=4,
+        num_labels=2,
+        sparse_features=[
+            synthetic_recsys_dataset_ops.IdFeature(1000, 1.1, 3),
+            synthetic_recsys_dataset_ops.IdFeature(10, 0.0, 1)],
+        sequence_features=[
+            synthetic_recsys_dataset_ops.IdFeature(100000, 1.2, 8)])
+
+  def _batches(self, dataset):
+    next_element = self.getNext(dataset)
+    batches = []
+    for _ in range(3):
+      batches.append(self.evaluate(next_element()))
+    with self.assertRaises(errors.OutOfRangeError):
+      self.evaluate(next_element())
+    return batches
+
+  def testBatches(self):
+    for features, labels in self._batches(self._dataset(seed=7)):
+      self.assertEqual((64, 2), labels.shape)
+      self.assertTrue(np.all((labels == 0) | (labels == 1)))
+      self.assertEqual((64, 4), features['dense'].shape)
+      self.assertTrue(np.all((features['dense'] >= 0) &
+                             (features['dense'] < 1)))
+      sparse = features['sparse_0']
+      self.assertAllEqual([64, 3], sparse.dense_shape)
+      self.assertTrue(np.all((sparse.values >= 0) & (sparse.values < 1000)))
+      lengths = np.bincount(sparse.indices[:, 0], minlength=64)
+      self.assertTrue(np.all((lengths >= 1) & (lengths <= 3)))
+      one_hot = features['sparse_1']
+      self.assertAllEqual(np.arange(64), one_hot.indices[:, 0])
+      self.assertTrue(np.all(one_hot.values < 10))
+      sequence = features['sequence_0']
+      sequence_length = features['sequence_0_length']
+      self.assertEqual((64, 8), sequence.shape)
+      self.assertTrue(np.all((sequence_length >= 1) & (sequence_length <= 8)))
+      for ids, length in zip(sequence, sequence_length):
+        self.assertTrue(np.all(ids[length:] == 0))
+        self.assertTrue(np.all(ids < 100000))
+
+  def testDeterministic(self):
+    batches = self._batches(self._dataset(seed=7))
+    other_batches = self._batches(self._dataset(seed=7))
+    for (features, labels), (other_features, other_labels) in zip(
+        batches, other_batches):
+      self.assertAllEqual(labels, other_labels)
+      self.assertAllEqual(features['dense'], other_features['dense'])
+      self.assertAllEqual(features['sparse_0'].values,
+                          other_features['sparse_0'].values)
+      self.assertAllEqual(features['sequence_0'],
+                          other_features['sequence_0'])
+
+
+if __name__ == "__main__":
+  test.main()
@@ -105,7 +105,8 @@ class OptimizationOptions(options.OptionsBase):
       "When autotuning is enabled (through `autotune`), determines the CPU "
       "budget to use. Values greater than the number of schedulable CPU cores "
       "are allowed but may result in CPU contention. If None, defaults to the "
-      "number of schedulable CPU cores.")
+      "number of schedulable CPU cores less the cores the rest of the process, "
+      "e.g. the training threads, used since the previous optimization.")
 
   filter_fusion = options.create_option(
       name="filter_fusion",
@@ -86,6 +86,32 @@ class DataFrameValueSpec(type_spec.BatchableTypeSpec):
     return self._field.output_classes
 
 
+def _make_filters(filters):
+  """Split `(name, op, value)` filters into names, ops and values."""
+  names, ops_, values = [], [], []
+  for f in filters or []:
+    if len(f) != 3:
+      raise ValueError(f'Filter {f} should be a (name, op, value) tuple')
+    name, op, value = f
+    if op not in ('==', '!=', '<', '<=', '>', '>='):
+      raise ValueError(f'Filter {f} has unsupported operator {op}')
+    names.append(name)
+    ops_.append(op)
+    if isinstance(value, bool):
+      value = 'true' if value else 'false'
+    values.append(value.decode() if isinstance(value, bytes) else str(value))
+  return names, ops_, values
+
+
+def _make_hashed_field(field):
+  """The field of the int64 hash buckets of a string field."""
+  if field.dtype != dtypes.string:
+    raise ValueError(f'Field {field} to hash should be a string field')
+  return DataFrame.Field(
+    field.name, dtypes.int64, ragged_rank=field.ragged_rank,
+    shape=field.shape)
+
+
 class _ParquetDataset(dataset_ops.DatasetSource):  # pylint: disable=abstract-method
   """A Parquet Dataset that reads batches from parquet files."""
 
@@ -93,7 +119,9 @@ class _ParquetDataset(dataset_ops.DatasetSource):  # pylint: disable=abstract-me
       self, filename, batch_size, fields,
       partition_count=1,
       partition_index=0,
-      drop_remainder=False):
+      drop_remainder=False,
+      filters=None,
+      hash_buckets=None):
     """Create a `ParquetDataset`.
 
     Args:
@@ -104,7 +132,18 @@ class _ParquetDataset(dataset_ops.DatasetSource):  # pylint: disable=abstract-me
       partition_index: (Optional.) Index of row group partitions.
       drop_remainder: (Optional.) If True, only keep batches with exactly
         `batch_size` samples.
+      filters: (Optional.) List of `(name, op, value)` filters.
+      hash_buckets: (Optional.) Dict of the number of hash buckets of the
+        string fields read as int64 hash buckets.
     """
+    hash_buckets = hash_buckets or {}
+    field_names = [f.name for f in fields]
+    for name in hash_buckets:
+      if name not in field_names:
+        raise ValueError(f'Field {name} to hash is not in fields')
+    output_fields = [
+      _make_hashed_field(f) if hash_buckets.get(f.name, 0) > 0 else f
+      for f in fields]
     self._filename = ops.convert_to_tensor(
       filename, dtype=dtypes.string, name='filename')
     self._batch_size = ops.convert_to_tensor(
@@ -116,7 +155,7 @@ class _ParquetDataset(dataset_ops.DatasetSource):  # pylint: disable=abstract-me
         if f.ragged_rank > 0
         else tensor_spec.TensorSpec(
             shape=[batch_size if drop_remainder else None], dtype=f.dtype))
-      for f in self._fields}
+      for f in output_fields}
     self._field_names = nest.flatten({f.name: f.name for f in self._fields})
     self._field_dtypes = nest.flatten({f.name: f.dtype for f in self._fields})
     self._field_ragged_ranks = nest.flatten(
@@ -124,6 +163,10 @@ class _ParquetDataset(dataset_ops.DatasetSource):  # pylint: disable=abstract-me
     self._partition_count = partition_count
     self._partition_index = partition_index
     self._drop_remainder = drop_remainder
+    self._filter_names, self._filter_ops, self._filter_values = (
+      _make_filters(filters))
+    self._field_hash_buckets = nest.flatten(
+      {f.name: hash_buckets.get(f.name, 0) for f in self._fields})
 
     variant_tensor = gen_parquet_ops.parquet_tabular_dataset_v1(
       self._filename,
@@ -133,7 +176,11 @@ class _ParquetDataset(dataset_ops.DatasetSource):  # pylint: disable=abstract-me
       field_ragged_ranks=self._field_ragged_ranks,
       partition_count=self._partition_count,
       partition_index=self._partition_index,
-      drop_remainder=self._drop_remainder)
+      drop_remainder=self._drop_remainder,
+      filter_names=self._filter_names,
+      filter_ops=self._filter_ops,
+      filter_values=self._filter_values,
+      field_hash_buckets=self._field_hash_buckets)
     super().__init__(variant_tensor)
 
   @property
@@ -168,7 +215,9 @@ class ParquetDataset(dataset_ops.DatasetV2):  # pylint: disable=abstract-method
       partition_index=0,
       drop_remainder=False,
       num_parallel_reads=None,
-      num_sequential_reads=1):
+      num_sequential_reads=1,
+      filters=None,
+      hash_buckets=None):
     """Create a `ParquetDataset`.
 
     Args:
@@ -185,11 +234,24 @@ class ParquetDataset(dataset_ops.DatasetV2):  # pylint: disable=abstract-method
         sequentially.
       num_sequential_reads: (Optional.) A `tf.int64` scalar representing the
         number of batches to read in sequential. Defaults to 1.
+      filters: (Optional.) List of `(name, op, value)` filters, only the rows
+        satisfying all filters are read. `op` is one of `==`, `!=`, `<`,
+        `<=`, `>`, `>=`, `name` must be a column of primitive type which may
+        be not in `fields`. The row groups whose statistics show no row
+        satisfies the filters are skipped. Not supported with
+        `drop_remainder`.
+      hash_buckets: (Optional.) Dict from the names of string fields to
+        numbers of hash buckets, these fields are read as the int64
+        `StringToHashBucketFast` buckets of their strings. The dictionary
+        encoded string columns are hashed once per dictionary entry, without
+        materializing the strings. The fields can't be filtered.
     """
     filenames, self._fields = parquet_filenames_and_fields(filenames, fields)
     self._partition_count = partition_count
     self._partition_index = partition_index
     self._drop_remainder = drop_remainder
+    self._filters = filters
+    self._hash_buckets = hash_buckets
 
     def _create_dataset(f):
       f = ops.convert_to_tensor(f, dtypes.string, name='filename')
@@ -198,7 +260,9 @@ class ParquetDataset(dataset_ops.DatasetV2):  # pylint: disable=abstract-method
         fields=self._fields,
         partition_count=self._partition_count,
         partition_index=self._partition_index,
-        drop_remainder=self._drop_remainder)
+        drop_remainder=self._drop_remainder,
+        filters=self._filters,
+        hash_buckets=self._hash_buckets)
     self._impl = self._build_dataset(
       _create_dataset, filenames,
       num_parallel_reads=num_parallel_reads,
@@ -221,6 +285,14 @@ class ParquetDataset(dataset_ops.DatasetV2):  # pylint: disable=abstract-method
   def drop_remainder(self):
     return self._drop_remainder
 
+  @property
+  def filters(self):
+    return self._filters
+
+  @property
+  def hash_buckets(self):
+    return self._hash_buckets
+
   def _inputs(self):
     return self._impl._inputs()  # pylint: disable=protected-access
 
@@ -254,7 +326,9 @@ def read_parquet(
     partition_index=0,
     drop_remainder=False,
     num_parallel_reads=None,
-    num_sequential_reads=1):
+    num_sequential_reads=1,
+    filters=None,
+    hash_buckets=None):
   """Create a `ParquetDataset` from filenames dataset.
 
     Args:
@@ -269,6 +343,9 @@ def read_parquet(
         sequentially.
       num_sequential_reads: (Optional.) A `tf.int64` scalar representing the
         number of batches to read in sequential. Defaults to 1.
+      filters: (Optional.) List of `(name, op, value)` filters.
+      hash_buckets: (Optional.) Dict of the number of hash buckets of the
+        string fields read as int64 hash buckets.
     """
   def _apply_fn(filenames):
     return ParquetDataset(
@@ -279,6 +356,8 @@ def read_parquet(
       partition_index=partition_index,
       drop_remainder=drop_remainder,
       num_parallel_reads=num_parallel_reads,
-      num_sequential_reads=num_sequential_reads)
+      num_sequential_reads=num_sequential_reads,
+      filters=filters,
+      hash_buckets=hash_buckets)
 
   return _apply_fn
@@ -0,0 +1,160 @@
+# Copyright 2023 The DeepRec Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =============================================================================
+"""Dataset of synthetic recommendation samples for benchmarking."""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import collections
+
+from tensorflow.python.data.ops import dataset_ops
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import ops
+from tensorflow.python.framework import sparse_tensor
+from tensorflow.python.framework import tensor_spec
+from tensorflow.python.framework import tensor_util
+from tensorflow.python.ops import gen_experimental_dataset_ops
+
+
+class IdFeature(collections.namedtuple(
+    'IdFeature', ['vocab_size', 'zipf_exponent', 'max_length'])):
+  """Ids of a sparse or a sequence feature.
+
+  The ids are in `[0, vocab_size)`, the id `r - 1` having a probability
+  proportional to `1 / r^zipf_exponent`, and every sample has between 1 and
+  `max_length` ids.
+  """
+
+  def __new__(cls, vocab_size, zipf_exponent=1.0, max_length=1):
+    return super(IdFeature, cls).__new__(
+        cls, vocab_size, zipf_exponent, max_length)
+
+
+class _SyntheticRecsysDataset(dataset_ops.DatasetSource):  # pylint: disable=abstract-method
+  """A `Dataset` of synthetic batches, as a flat tuple."""
+
+  def __init__(self, batch_size, num_batches, seed, num_dense, num_labels,
+               label_positive_rate, sparse_features, sequence_features):
+    self._batch_size = ops.convert_to_tensor(
+        batch_size, dtype=dtypes.int64, name='batch_size')
+    static_batch_size = tensor_util.constant_value(self._batch_size)
+    self._num_dense = num_dense
+    self._num_sparse = len(sparse_features)
+    self._num_sequence = len(sequence_features)
+    specs = [tensor_spec.TensorSpec(
+        [static_batch_size, num_labels], dtypes.float32)]
+    if num_dense > 0:
+      specs.append(tensor_spec.TensorSpec(
+          [static_batch_size, num_dense], dtypes.float32))
+    for f in sparse_features:
+      specs.append(sparse_tensor.SparseTensorSpec(
+          [static_batch_size, f.max_length], dtypes.int64))
+    for f in sequence_features:
+      specs.append(tensor_spec.TensorSpec(
+          [static_batch_size, f.max_length], dtypes.int64))
+      specs.append(tensor_spec.TensorSpec([static_batch_size], dtypes.int64))
+    self._element_spec = tuple(specs)
+    variant_tensor = gen_experimental_dataset_ops.synthetic_recsys_dataset(
+        seed=ops.convert_to_tensor(seed, dtype=dtypes.int64, name='seed'),
+        batch_size=self._batch_size,
+        num_batches=ops.convert_to_tensor(
+            num_batches, dtype=dtypes.int64, name='num_batches'),
+        num_dense=num_dense,
+        num_labels=num_labels,
+        label_positive_rate=label_positive_rate,
+        sparse_vocab_sizes=[f.vocab_size for f in sparse_features],
+        sparse_zipf_exponents=[f.zipf_exponent for f in sparse_features],
+        sparse_max_lengths=[f.max_length for f in sparse_features],
+        sequence_vocab_sizes=[f.vocab_size for f in sequence_features],
+        sequence_zipf_exponents=[f.zipf_exponent for f in sequence_features],
+        sequence_max_lengths=[f.max_length for f in sequence_features])
+    super(_SyntheticRecsysDataset, self).__init__(variant_tensor)
+
+  @property
+  def element_spec(self):
+    return self._element_spec
+
+  def to_features_and_labels(self, *components):
+    """Packs the flat components of a batch as (features, labels)."""
+    components = list(components)
+    labels = components.pop(0)
+    features = {}
+    if self._num_dense > 0:
+      features['dense'] = components.pop(0)
+    for i in range(self._num_sparse):
+      features['sparse_{}'.format(i)] = components.pop(0)
+    for i in range(self._num_sequence):
+      features['sequence_{}'.format(i)] = components.pop(0)
+      features['sequence_{}_length'.format(i)] = components.pop(0)
+    return features, labels
+
+
+class SyntheticRecsysDataset(dataset_ops.DatasetV2):
+  """A `Dataset` of synthetic batches of recommendation samples.
+
+  Generates the batches natively, as fast as the memory allows, so that the
+  training of a model can be benchmarked without the input pipeline being a
+  bottleneck. Each element is a `(features, labels)` tuple, where labels is
+  a float tensor of shape `[batch_size, num_labels]` of 0 and 1, and the
+  features are:
+  - 'dense': uniform floats in `[0, 1)` of shape `[batch_size, num_dense]`,
+    if `num_dense > 0`.
+  - 'sparse_<i>': a `SparseTensor` of the int64 ids of the i-th sparse
+    feature, of dense shape `[batch_size, max_length]`.
+  - 'sequence_<i>': the int64 ids of the i-th sequence feature, of shape
+    `[batch_size, max_length]` and padded with 0, and
+    'sequence_<i>_length' their lengths, of shape `[batch_size]`.
+
+  Every batch is a function of the seed and of its index only, so the
+  datasets of the same seed produce the same batches.
+  """
+
+  def __init__(self,
+               batch_size,
+               num_batches=-1,
+               seed=None,
+               num_dense=0,
+               num_labels=1,
+               label_positive_rate=0.25,
+               sparse_features=None,
+               sequence_features=None):
+    """Creates a `SyntheticRecsysDataset`.
+
+    Args:
+      batch_size: The number of samples of each batch.
+      num_batches: (Optional.) The number of batches, -1 for infinitely many.
+      seed: (Optional.) The seed of the batches, a random seed if None or 0.
+      num_dense: (Optional.) The number of dense float features.
+      num_labels: (Optional.) The number of binary labels.
+      label_positive_rate: (Optional.) The probability of a label to be 1.
+      sparse_features: (Optional.) List of `IdFeature`s of the multi-hot
+        sparse features.
+      sequence_features: (Optional.) List of `IdFeature`s of the sequence
+        features.
+    """
+    self._impl = _SyntheticRecsysDataset(  # pylint: disable=abstract-class-instantiated
+        batch_size, num_batches, seed or 0, num_dense, num_labels,
+        label_positive_rate, list(sparse_features or []),
+        list(sequence_features or []))
+    self._dataset = self._impl.map(self._impl.to_features_and_labels)
+    super(SyntheticRecsysDataset, self).__init__(
+        self._dataset._variant_tensor)  # pylint: disable=protected-access
+
+  def _inputs(self):
+    return self._dataset._inputs()  # pylint: disable=protected-access
+
+  @property
+  def element_spec(self):
+    return self._dataset.element_spec
@@ -166,5 +166,31 @@ class TFRecordDatasetTest(test_base.DatasetTestBase):
     self.assertDatasetProduces(
         dataset, expected_output=expected_output * 10, assert_items_equal=True)
 
+  def testReadFileSlices(self):
+    fn = self.test_filenames[0]
+    file_size = os.path.getsize(fn)
+    expected_output = [self._record(0, i) for i in range(self._num_records)]
+    for slice_size in [1, 7, 37, file_size // 2, file_size]:
+      slices = [
+          "%s#%d:%d" % (fn, begin, min(begin + slice_size, file_size))
+          for begin in range(0, file_size, slice_size)]
+      dataset = self.dataset_fn(slices)
+      self.assertDatasetProduces(dataset, expected_output=expected_output)
+
+  def testReadFileSlicesInParallel(self):
+    slices = []
+    for fn in self.test_filenames:
+      file_size = os.path.getsize(fn)
+      slices.extend(
+          "%s#%d:%d" % (fn, begin, min(begin + 50, file_size))
+          for begin in range(0, file_size, 50))
+    expected_output = []
+    for j in range(self._num_files):
+      expected_output.extend(
+          [self._record(j, i) for i in range(self._num_records)])
+    dataset = readers.TFRecordDataset(slices, num_parallel_reads=4)
+    self.assertDatasetProduces(
+        dataset, expected_output=expected_output, assert_items_equal=True)
+
 if __name__ == "__main__":
   test.main()
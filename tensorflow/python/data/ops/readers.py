@@ -511,6 +511,7 @@ class KafkaDataset(dataset_ops.Dataset):
         config_global=None,
         config_topic=None,
         message_key=False,
+        batch_size=0,
     ):
         """Create a KafkaReader.
 
@@ -535,6 +536,10 @@ class KafkaDataset(dataset_ops.Dataset):
                     please refer to 'Topic configuration properties'
                     in librdkafka doc.
       message_key: If True, the kafka will output both message value and key.
+      batch_size: If positive, every element is a vector of up to
+                  `batch_size` messages, consumed from the partitions in
+                  parallel, and the offsets are committed to the consumer
+                  `group` whenever the iterator is saved.
     """
         self._topics = ops.convert_to_tensor(topics, dtype=dtypes.string, name="topics")
         self._servers = ops.convert_to_tensor(
@@ -554,6 +559,7 @@ class KafkaDataset(dataset_ops.Dataset):
             config_topic, dtype=dtypes.string, name="config_topic"
         )
         self._message_key = message_key
+        self._batch_size = batch_size
         super(KafkaDataset, self).__init__()
 
     def _inputs(self):
@@ -569,6 +575,7 @@ class KafkaDataset(dataset_ops.Dataset):
             self._config_global,
             self._config_topic,
             self._message_key,
+            batch_size=self._batch_size,
         )
 
     @property
@@ -577,11 +584,9 @@ class KafkaDataset(dataset_ops.Dataset):
 
     @property
     def output_shapes(self):
-        return (
-            (tensor_shape.TensorShape([]))
-            if not self._message_key
-            else (tensor_shape.TensorShape([]), tensor_shape.TensorShape([]))
-        )
+        shape = (tensor_shape.TensorShape([None]) if self._batch_size > 0
+                 else tensor_shape.TensorShape([]))
+        return shape if not self._message_key else (shape, shape)
 
     @property
     def output_types(self):
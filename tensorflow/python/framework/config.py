@@ -651,6 +651,10 @@ def enable_distributed_strategy(strategy="collective"):
       raise ImportError("While param `strategy` in enable_distributed_strategy"
                         "is given `collective`, sok module initialize error,"
                         "please double check")
+  elif strategy == "sharded":
+    # EmbeddingVariables partitioned across the local GPUs of one process,
+    # no extra module is required.
+    group_embedding_types.set_group_lookup_strategy(strategy)
   else:
     raise ValueError("param `strategy` is given {}, Currently only support \
-                     `collective`".format(strategy))
\ No newline at end of file
+                     `collective` and `sharded`".format(strategy))
\ No newline at end of file
@@ -25,6 +25,7 @@ class DistStrategy(Enum):
   COLLECTIVE = "collective"
   DISTRIBUTED = "ps"
   LOCALIZED = "localized"
+  SHARDED = "sharded"
   UNKNOWN = "unknown"
 
 _group_lookup_strategy = DistStrategy.LOCALIZED
@@ -37,6 +38,8 @@ def set_group_lookup_strategy(strategy):
       return DistStrategy.DISTRIBUTED
     elif strategy == "localized":
       return DistStrategy.LOCALIZED
+    elif strategy == "sharded":
+      return DistStrategy.SHARDED
 
   global _group_lookup_strategy
   _group_lookup_strategy = str_to_strategy(strategy)
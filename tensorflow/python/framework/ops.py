@@ -6212,6 +6212,10 @@ class GraphKeys(object):
   # NOTE(yuanbyu): internal and experimental.
   _STREAMING_MODEL_PORTS = "streaming_model_ports"
 
+  # Key for the rows of EmbeddingVariables read from the worker side hot
+  # row caches, their gradients are merged by the optimizers.
+  _EV_HOT_ROWS = "ev_hot_rows"
+
   @decorator_utils.classproperty
   @deprecation.deprecated(None, "Use `tf.GraphKeys.GLOBAL_VARIABLES` instead.")
   def VARIABLES(cls):  # pylint: disable=no-self-argument
@@ -335,6 +335,29 @@ class StaticHashTableTest(BaseLookupTableTest):
     result = self.evaluate(output)
     self.assertAllEqual([b"brain", b"salad", b"n/a"], result)
 
+  def testStaticHashTableLargeVocabulary(self):
+    # Enough keys for many buckets of the perfect hash, and lookups of more
+    # keys than a batch of its Find.
+    default_val = -1
+    vocab = ["word_%d" % i for i in range(1000)]
+    table = self.getHashTable()(
+        lookup_ops.KeyValueTensorInitializer(
+            vocab, constant_op.constant(range(1000), dtypes.int64)),
+        default_val)
+    self.initialize_table(table)
+
+    self.assertAllEqual(1000, self.evaluate(table.size()))
+
+    input_string = constant_op.constant(
+        ["word_%d" % i for i in range(990, 1010)] + ["", "word_"])
+    result = self.evaluate(table.lookup(input_string))
+    self.assertAllEqual(list(range(990, 1000)) + [-1] * 12, result)
+
+    exported_keys_tensor, exported_values_tensor = table.export()
+    exported = dict(zip(self.evaluate(exported_keys_tensor),
+                        self.evaluate(exported_values_tensor)))
+    self.assertEqual({w.encode(): i for i, w in enumerate(vocab)}, exported)
+
   def testTableUseInFunction(self):
     if not context.executing_eagerly():
       self.skipTest("Only Eager mode test.")
@@ -896,6 +896,35 @@ class SparseSegmentReductionOpTest(SparseSegmentReductionHelper):
             delta=1)
       self.assertAllClose(jacob_t, jacob_n)
 
+  def testRowWidthsWithDuplicateIndices(self):
+    # Rows narrower than a warp, not a multiple of a vector, and wider than a
+    # warp of vectors, with indices repeated within and across segments.
+    num_rows = 50
+    segment_indices = np.sort(np.random.randint(0, 40, 300)).astype(np.int32)
+    tf_indices = np.random.randint(0, num_rows, 300).astype(np.int32)
+    ops_list = [
+        math_ops.sparse_segment_sum, math_ops.sparse_segment_mean,
+        math_ops.sparse_segment_sqrt_n
+    ]
+    grad_ops_list = [
+        math_ops.sparse_segment_mean_grad, math_ops.sparse_segment_sqrt_n_grad
+    ]
+    for dtype in [dtypes_lib.float32, dtypes_lib.float64]:
+      for width in [1, 3, 4, 6, 33, 130]:
+        tf_x, _ = self._input_numeric([num_rows, width], dtype=dtype)
+        tf_grad, _ = self._input_numeric(
+            [segment_indices[-1] + 1, width], dtype=dtype)
+        results = []
+        for use_gpu in [False, True]:
+          with self.session(use_gpu=use_gpu):
+            results.append(self.evaluate(
+                [tf_op(data=tf_x, indices=tf_indices,
+                       segment_ids=segment_indices) for tf_op in ops_list] +
+                [tf_op(tf_grad, tf_indices, segment_indices, num_rows)
+                 for tf_op in grad_ops_list]))
+        for cpu_ans, gpu_ans in zip(*results):
+          self.assertAllClose(cpu_ans, gpu_ans)
+
   def testGradientValid(self):
     # Baseline for the testGradient*Invalid* methods below.
     tf_x, _ = self._input([3, 4], dtype=dtypes_lib.float32)
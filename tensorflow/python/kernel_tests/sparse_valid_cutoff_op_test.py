@@ -21,8 +21,10 @@ from __future__ import print_function
 import numpy as np
 
 from tensorflow.python.framework import sparse_tensor
+from tensorflow.python.ops import gen_sparse_ops
 from tensorflow.python.ops import gradient_checker
 from tensorflow.python.ops import sparse_ops
+from tensorflow.python.ops import string_ops
 import tensorflow.python.ops.sparse_grad  # pylint: disable=unused-import
 from tensorflow.python.platform import test
 
@@ -136,6 +138,25 @@ class SparseSliceOpTest(test.TestCase):
       self.assertAllEqual(sparse_tensor3.values.eval(), [b'a0', b'a1', b'c0', b'c1'])
       self.assertAllEqual(sparse_tensor3.dense_shape.eval(), [3, 2, 2])
 
+  def testCutoffToHashBucketFast(self):
+    with self.test_session(use_gpu=False):
+      sp_input = self._SparseTensor_3x4x2()
+      for axis, length, side in [(1, 2, "right"), (1, 2, "left"),
+                                 (2, 1, "right"), (1, 8, "left")]:
+        expect = sparse_ops.sparse_valid_cutoff(
+            sparse_tensor.SparseTensor(
+                sp_input.indices,
+                string_ops.string_to_hash_bucket_fast(sp_input.values, 100),
+                sp_input.dense_shape),
+            axis, length, side=side)
+        indices, values, dense_shape = (
+            gen_sparse_ops.sparse_valid_cutoff_to_hash_bucket_fast(
+                sp_input.indices, sp_input.values, sp_input.dense_shape,
+                num_buckets=100, axis=axis, length=length, side=side))
+        self.assertAllEqual(expect.indices.eval(), indices.eval())
+        self.assertAllEqual(expect.values.eval(), values.eval())
+        self.assertAllEqual(expect.dense_shape.eval(), dense_shape.eval())
+
 
 if __name__ == '__main__':
   test.main()
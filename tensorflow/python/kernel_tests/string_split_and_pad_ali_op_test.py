@@ -78,5 +78,33 @@ class StringSplitAndPadTest(test_util.TensorFlowTestCase):
       string_ops.string_split_and_pad(x, max_length=4, delimiter=",")
 
 
+class StringSplitAndPadToHashBucketFastTest(test_util.TensorFlowTestCase):
+
+  def _testMatchesUnfused(self, source, max_length, delimiter):
+    with self.test_session():
+      expect = string_ops.string_to_hash_bucket_fast(
+          string_ops.string_split_and_pad(
+              source, max_length=max_length, delimiter=delimiter),
+          num_buckets=1000).eval()
+      y_tf = string_ops.string_split_and_pad_to_hash_bucket_fast(
+          source, max_length=max_length, num_buckets=1000,
+          delimiter=delimiter).eval()
+      self.assertAllEqual(expect, y_tf)
+
+  def testMatchesUnfused(self):
+    source = ["f1,f2,f3,f4", "", ",,a,,bb,", "x" * 100 + ",y",
+              ",".join("t%d" % i for i in range(40))]
+    for max_length in [0, 1, 4, 64]:
+      self._testMatchesUnfused(source, max_length, ",")
+    self._testMatchesUnfused(source, 8, ",t")
+    self._testMatchesUnfused(source, 8, "")
+
+  def testInputInvalidAxis(self):
+    with self.assertRaisesRegexp(
+        ValueError, "Shape must be rank 1 but is rank 0"):
+      string_ops.string_split_and_pad_to_hash_bucket_fast(
+          "f1,f2", max_length=4, num_buckets=10, delimiter=",")
+
+
 if __name__ == "__main__":
   googletest.main()
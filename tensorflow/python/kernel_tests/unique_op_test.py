@@ -29,6 +29,7 @@ from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import errors_impl
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import gen_array_ops
+from tensorflow.python.ops import gen_math_ops
 from tensorflow.python.platform import test
 
 
@@ -173,6 +174,12 @@ class UniqueTest(test.TestCase):
   def testUniqueDenseHashMap(self):
     self.RunUniqueWithDifferentMaps('GOOGLE')
 
+  def testUniquePartitionMap(self):
+    # Small partitions to run the inputs of the tests in parallel.
+    os.environ['DEEPREC_UNIQUE_OP_PARTITION_SIZE'] = '256'
+    self.RunUniqueWithDifferentMaps('PARTITION')
+    del os.environ['DEEPREC_UNIQUE_OP_PARTITION_SIZE']
+
 class UniqueWithCountsTest(test.TestCase):
 
   def testInt32(self):
@@ -278,6 +285,104 @@ class UniqueWithCountsTest(test.TestCase):
   def testUniqueWithCountsDenseHashMap(self):
     self.RunUniqueWithCountsWithDifferentMaps('GOOGLE')
 
+  def testUniqueWithCountsPartitionMap(self):
+    os.environ['DEEPREC_UNIQUE_OP_PARTITION_SIZE'] = '256'
+    self.RunUniqueWithCountsWithDifferentMaps('PARTITION')
+    del os.environ['DEEPREC_UNIQUE_OP_PARTITION_SIZE']
+
+
+class UniqueWithPartitionsTest(test.TestCase):
+
+  def _checkUniqueWithPartitions(self, x, num_partitions, out_idx):
+    with self.cached_session(use_gpu=True) as sess:
+      tf_y, tf_idx, tf_count, tf_sizes = sess.run(
+          gen_array_ops.unique_with_partitions(
+              x, num_partitions=num_partitions, out_idx=out_idx))
+
+    self.assertEqual(len(x), len(tf_idx))
+    self.assertAllEqual(np.sort(tf_y), np.unique(x))
+    for i in range(len(x)):
+      self.assertEqual(x[i], tf_y[tf_idx[i]])
+    for value, count in zip(tf_y, tf_count):
+      self.assertEqual(count, np.sum(x == value))
+    self.assertEqual(len(tf_sizes), num_partitions)
+    self.assertEqual(np.sum(tf_sizes), len(tf_y))
+    offsets = np.concatenate([[0], np.cumsum(tf_sizes)])
+    for p in range(num_partitions):
+      self.assertAllEqual(
+          np.mod(tf_y[offsets[p]:offsets[p + 1]], num_partitions), p)
+
+  def testInt32(self):
+    x = np.random.randint(0, high=1000, size=70000).astype(np.int32)
+    self._checkUniqueWithPartitions(x, 4, dtypes.int32)
+
+  def testInt64OutIdxInt64(self):
+    x = np.random.randint(-(1 << 40), high=1 << 40, size=7000)
+    x = np.concatenate([x, x[:3000]]).astype(np.int64)
+    self._checkUniqueWithPartitions(x, 3, dtypes.int64)
+
+  def testSinglePartition(self):
+    x = np.random.randint(0, high=100, size=1000).astype(np.int64)
+    self._checkUniqueWithPartitions(x, 1, dtypes.int32)
+
+  def testOrderOfFirstOccurrence(self):
+    x = np.array([1, 1, 2, 4, 4, 4, 7, 8, 8], dtype=np.int64)
+    with self.cached_session(use_gpu=False) as sess:
+      y, idx, count, sizes = sess.run(
+          gen_array_ops.unique_with_partitions(x, num_partitions=2))
+    self.assertAllEqual(y, [2, 4, 8, 1, 7])
+    self.assertAllEqual(idx, [3, 3, 0, 1, 1, 1, 4, 2, 2])
+    self.assertAllEqual(count, [1, 3, 2, 2, 1])
+    self.assertAllEqual(sizes, [3, 2])
+
+  def testEmpty(self):
+    x = np.zeros([0], dtype=np.int64)
+    with self.cached_session(use_gpu=True) as sess:
+      y, idx, count, sizes = sess.run(
+          gen_array_ops.unique_with_partitions(x, num_partitions=2))
+    self.assertEqual(len(y), 0)
+    self.assertEqual(len(idx), 0)
+    self.assertEqual(len(count), 0)
+    self.assertAllEqual(sizes, [0, 0])
+
+
+class UniqueSegmentSumTest(test.TestCase):
+
+  def _checkUniqueSegmentSum(self, ids, data):
+    with self.cached_session() as sess:
+      output, unique_ids = sess.run(gen_math_ops.unique_segment_sum(data, ids))
+    self.assertEqual(len(unique_ids), len(np.unique(ids)))
+    self.assertEqual(output.shape, (len(unique_ids),) + data.shape[1:])
+    for i, unique_id in enumerate(unique_ids):
+      self.assertAllClose(output[i], np.sum(data[ids == unique_id], axis=0))
+
+  def testInt32(self):
+    ids = np.random.randint(0, 10, size=64).astype(np.int32)
+    data = np.random.rand(64, 3, 2).astype(np.float32)
+    self._checkUniqueSegmentSum(ids, data)
+
+  def testInt64Partitions(self):
+    # Large enough ids to be partitioned.
+    os.environ['DEEPREC_UNIQUE_OP_PARTITION_SIZE'] = '256'
+    ids = np.random.randint(0, 2000, size=20000).astype(np.int64)
+    data = np.random.rand(20000, 8).astype(np.float64)
+    self._checkUniqueSegmentSum(ids, data)
+    del os.environ['DEEPREC_UNIQUE_OP_PARTITION_SIZE']
+
+  def testEmpty(self):
+    ids = np.zeros([0], dtype=np.int64)
+    data = np.zeros([0, 4], dtype=np.float32)
+    self._checkUniqueSegmentSum(ids, data)
+
+  def testInvalidShape(self):
+    with self.cached_session():
+      with self.assertRaisesOpError("does not start with ids.shape"):
+        gen_math_ops.unique_segment_sum(
+            array_ops.placeholder_with_default(np.zeros([3, 2], np.float32),
+                                               shape=None),
+            array_ops.placeholder_with_default(np.zeros([4], np.int64),
+                                               shape=None)).output.eval()
+
 
 if __name__ == '__main__':
   test.main()
@@ -0,0 +1,91 @@
+# Copyright 2023 The DeepRec Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Approximate nearest neighbor retrieval of item embeddings."""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+from tensorflow.python.framework import ops
+from tensorflow.python.ops import gen_ann_index_ops
+
+
+class AnnIndex(object):
+  """An HNSW index of item embeddings, for the retrieval of two-tower models.
+
+  The index lives in the session, built by the op of `build`, typically run
+  by the main op of the exported model, and updated by the op of `upsert`,
+  typically run by its incremental main op with all the item embeddings:
+  the items whose embeddings are unchanged are skipped.
+
+  ```python
+  index = AnnIndex("item_index")
+  build_op = index.build(item_ids, item_embeddings)
+  ids, scores = index.search(user_embeddings, k=100)
+  ```
+  """
+
+  def __init__(self, name, container=""):
+    with ops.name_scope(name) as scope:
+      self._handle = gen_ann_index_ops.ann_index_handle_op(
+          container=container, shared_name=scope.rstrip("/"))
+
+  @property
+  def handle(self):
+    return self._handle
+
+  def build(self, ids, embeddings, metric="ip", m=16, ef_construction=200,
+            ef_search=64, name=None):
+    """Replaces the index with one of the rows of `embeddings`.
+
+    Args:
+      ids: An int64 vector, the items of the rows of `embeddings`.
+      embeddings: A float matrix.
+      metric: "ip" to rank the items by inner product, "l2" by euclidean
+        distance.
+      m: The neighbors of an item on each level of the graph, twice as many
+        on level 0. Higher is more accurate, slower and larger.
+      ef_construction: The candidates kept while linking an item.
+      ef_search: The candidates kept by a search, at least its k.
+      name: A name for the operation.
+
+    Returns:
+      The operation.
+    """
+    return gen_ann_index_ops.ann_index_build(
+        self._handle, ids, embeddings, metric=metric, m=m,
+        ef_construction=ef_construction, ef_search=ef_search, name=name)
+
+  def upsert(self, ids, embeddings, name=None):
+    """Inserts the items `ids` or updates those whose embeddings changed."""
+    return gen_ann_index_ops.ann_index_upsert(
+        self._handle, ids, embeddings, name=name)
+
+  def remove(self, ids, name=None):
+    """Removes the items `ids` from the results of the searches."""
+    return gen_ann_index_ops.ann_index_remove(self._handle, ids, name=name)
+
+  def search(self, queries, k, name=None):
+    """The `k` items nearest to each row of `queries`, best first.
+
+    Returns:
+      The ids, -1 past the items of the index, and the scores of the items:
+      the inner products, or the negated squared distances for "l2".
+    """
+    return gen_ann_index_ops.ann_index_search(
+        self._handle, queries, k=k, name=name)
+
+  def size(self, name=None):
+    return gen_ann_index_ops.ann_index_size(self._handle, name=name)
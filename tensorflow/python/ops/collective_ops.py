@@ -39,8 +39,9 @@ def all_reduce(t, group_size, group_key, instance_key, merge_op, final_op,
       independent subdivision should begin.  Use [0] if no subdivision should
       be done.
     communication_hint: preferred collective communication.  The implementation
-      may fall back to another mechanism.  Options include `auto`, `ring`, and
-      `nccl`.
+      may fall back to another mechanism.  Options include `auto`, `ring`,
+      `nccl`, and `hierarchical`, which reduces within each task before a ring
+      among the tasks.
 
   Returns:
     An Op implementing the distributed reduction.
@@ -17,6 +17,7 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+import os
 import sys
 from six.moves import xrange  # pylint: disable=redefined-builtin
 from collections import defaultdict
@@ -34,6 +35,8 @@ from tensorflow.python.ops import clip_ops
 # Imports gradient definitions.
 from tensorflow.python.ops import data_flow_grad  # pylint: disable=unused-import
 from tensorflow.python.ops import data_flow_ops
+from tensorflow.python.ops import gen_kv_variable_ops
+from tensorflow.python.ops import gen_multi_hash_ops
 from tensorflow.python.ops import kv_variable_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import resource_variable_ops
@@ -45,6 +48,31 @@ from tensorflow.python.platform import tf_logging as logging
 from tensorflow.python.util.tf_export import tf_export
 
 
+@ops.RegisterGradient("MultiHashEmbeddingLookup")
+def _MultiHashEmbeddingLookupGrad(op, grad):
+  """The gradients of the two tables, as IndexedSlices of their rows."""
+  params_q, params_r, ids = op.inputs
+  num_buckets = op.get_attr("num_buckets")
+  operation = op.get_attr("operation").decode()
+  ids = array_ops.reshape(ids, [-1])
+  ids_q = math_ops.floordiv(ids, num_buckets)
+  ids_r = math_ops.floormod(ids, num_buckets)
+  dim = array_ops.shape(params_q)[1]
+  grad = array_ops.reshape(grad, [array_ops.size(ids), -1])
+  if operation == "add":
+    grad_q = grad
+    grad_r = grad
+  elif operation == "mul":
+    grad_q = grad * array_ops.gather(params_r, ids_r)
+    grad_r = grad * array_ops.gather(params_q, ids_q)
+  else:
+    grad_q = grad[:, :dim]
+    grad_r = grad[:, dim:]
+  return [ops.IndexedSlices(grad_q, ids_q, array_ops.shape(params_q)),
+          ops.IndexedSlices(grad_r, ids_r, array_ops.shape(params_r)),
+          None]
+
+
 def _clip(params, ids, max_norm):
   """Helper function for _embedding_lookup_and_transform.
   This function optionally clips embeddings to an l2-norm of max_norm.
@@ -82,6 +110,47 @@ def _clip(params, ids, max_norm):
       axes=(list(range(ids_rank, params_rank)) if ids_static and params_static
             else math_ops.range(ids_rank, params_rank)))
 
+def _use_hot_key_replica(param, ev_init_value, counts):
+  """Whether the hot rows of `param` are read from the worker side cache."""
+  return (isinstance(param, kv_variable_ops.EmbeddingVariable) and
+          getattr(param, "_hot_key_option", None) is not None and
+          ev_init_value is None and counts is None)
+
+def _use_encoded_ids(param, ev_init_value):
+  """Whether the ids of the lookups of `param` are sent deduplicated and encoded.
+
+  Enabled by the environment variable TF_EV_ENCODE_LOOKUP_IDS=1 for the
+  partitioned EmbeddingVariables, which are usually on remote PS.
+  """
+  return (os.environ.get("TF_EV_ENCODE_LOOKUP_IDS", "0") == "1" and
+          isinstance(param, kv_variable_ops.EmbeddingVariable) and
+          not isinstance(param, kv_variable_ops.DynamicEmbeddingVariable) and
+          ev_init_value is None)
+
+def _encoded_ids_gather(param, ids, counts, transform_fn, max_norm):
+  """Gathers the rows of `ids` in `param` by their sorted unique ids.
+
+  The unique ids are encoded as varint deltas colocated with `ids`, decoded
+  colocated with `param` and gathered in that order, and their rows are then
+  expanded back to `ids`, so that a duplicated id is sent and gathered once.
+  The counts of the unique ids are sent with them when the gather needs them.
+  """
+  encode_counts = counts is not None or param.need_counts()
+  if counts is None:
+    counts = array_ops.zeros([0], dtypes.int64)
+  with ops.colocate_with(ids):
+    encoded, idx = gen_kv_variable_ops.kv_ids_dedup_encode(
+        ids, math_ops.cast(counts, dtypes.int64),
+        encode_counts=encode_counts)
+  with ops.colocate_with(param):
+    unique_ids, unique_counts = gen_kv_variable_ops.kv_ids_decode(
+        encoded, decode_counts=encode_counts, Tkeys=ids.dtype)
+    rows = param.sparse_read(
+        unique_ids, counts=unique_counts if encode_counts else None)
+    if transform_fn:
+      rows = transform_fn(_clip(rows, unique_ids, max_norm))
+  return array_ops.gather(rows, idx)
+
 def _gather_fae(ids, blocknums, embs, params):
   concat_embs=[]
   indices = math_ops.range(0, array_ops.squeeze(array_ops.shape(ids)), 1)
@@ -146,6 +215,14 @@ def _embedding_lookup_and_transform(params,
     params = [params]
   if isinstance(params[0], kv_variable_ops.MultiHashVariable):
     if params[0].mhvconfig.strategy == "Q-R":
+      if not any(isinstance(v, variables.PartitionedVariable)
+                 for v in params[0]._val_list):
+        ret = gen_multi_hash_ops.multi_hash_embedding_lookup(
+            params[0]._val_list[0], params[0]._val_list[1], ids,
+            num_buckets=params[0].mhvconfig.size[1][0],
+            operation=params[0].mhvconfig.operation, name=name)
+        ops.add_to_collections(ops.GraphKeys.ASYNC_EMBEDDING_OUTPUT_TENSORS, ret)
+        return ret
       ids_tensor = ops.convert_to_tensor(ids, dtypes.int64)
       ids_Q = math_ops.floordiv(ids_tensor, params[0].mhvconfig.size[0][0])
       ids_R = math_ops.floormod(ids_tensor, params[0].mhvconfig.size[1][0])
@@ -185,6 +262,11 @@ def _embedding_lookup_and_transform(params,
         ret = array_ops.scatter_nd(indices=indice_cnt, updates=embs_nozero, shape=[array_ops.shape(ids)[0], array_ops.shape(embs_nozero)[1]])
         ops.add_to_collections(ops.GraphKeys.ASYNC_EMBEDDING_OUTPUT_TENSORS, ret)
         return ret
+      elif _use_hot_key_replica(params[0], ev_init_value, counts):
+        result = _clip(params[0].hot_key_sparse_read(ids, name=name),
+                       ids, max_norm)
+        if transform_fn:
+          result = transform_fn(result)
       else:
         with ops.colocate_with(params[0]):
           result = _clip(array_ops.gather(params[0], ids, name=name,
@@ -216,7 +298,8 @@ def _embedding_lookup_and_transform(params,
 
       if isinstance(params[0], kv_variable_ops.EmbeddingVariable):
          new_ids = flat_ids
-         p_assignments = flat_ids % 1000 % np 
+         p_assignments = kv_variable_ops.ev_partition_assignments(params,
+                                                                  flat_ids)
       elif partition_strategy == "mod":
         p_assignments = flat_ids % np
         new_ids = flat_ids // np
@@ -294,6 +377,15 @@ def _embedding_lookup_and_transform(params,
           indice_cnt = array_ops.expand_dims(array_ops.boolean_mask(indices, math_ops.greater_equal(pblocknums, 1)), 1)
           result = array_ops.scatter_nd(indices=indice_cnt, updates=result_nozero, shape=[array_ops.shape(pids)[0], array_ops.shape(result_nozero)[1]])
           partitioned_result.append(result)
+        elif _use_hot_key_replica(params[p], ev_init_value, counts):
+          result = params[p].hot_key_sparse_read(pids)
+          if transform_fn:
+            result = transform_fn(_clip(result, pids, max_norm))
+          partitioned_result.append(result)
+        elif _use_encoded_ids(params[p], ev_init_value):
+          partitioned_result.append(_encoded_ids_gather(
+              params[p], pids, None if counts is None else gather_counts[p],
+              transform_fn, max_norm))
         else:
           with ops.colocate_with(params[p]):
             if ev_init_value is None:
@@ -1589,6 +1681,86 @@ def safe_adaptive_embedding_lookup_sparse(hash_embedding_weights,
         (original_rank_dim - 1).value).concatenate(result.get_shape()[1:]))
     return final_result
 
+def _sharded_group_embedding_lookup_sparse(params,
+                                            sp_ids,
+                                            combiners,
+                                            sp_weights,
+                                            ignore_weights,
+                                            is_sequence,
+                                            name):
+  """Group lookup of EmbeddingVariables partitioned across local devices.
+
+  The ids of each lookup are exchanged to the shards owning them, with the
+  same assignment as the lookup of partitioned EmbeddingVariables, see
+  `kv_variable_ops.ev_partition_assignments`. The shards on the same device with the same
+  dimension are looked up by one fused op, which pools the ids it owns,
+  and the partial results are exchanged back and summed up. The gradients
+  return to the shards through the reverse of the exchange.
+  """
+  shard_groups = defaultdict(list)
+  partial_outputs = [[] for _ in range(len(params))]
+  row_weights = [None for _ in range(len(params))]
+  with ops.name_scope(name, 'sharded_group_embedding_lookup',
+                      sp_ids) as name_scope:
+    for (index, param) in enumerate(params):
+      shards = list(param) if isinstance(
+          param, variables.PartitionedVariable) else [param]
+      for shard in shards:
+        if not isinstance(shard, kv_variable_ops.EmbeddingVariable):
+          raise TypeError("Only EmbeddingVariable is supported by the "
+                          "sharded strategy of group_embedding_lookup_sparse.")
+      sp_id = sp_ids[index]
+      if not isinstance(sp_id, sparse_tensor.SparseTensor):
+        try:  # assume RaggedTensor
+          sp_id = sp_id.to_sparse()
+        except:
+          raise ValueError('sp_id is neither SparseTensor nor RaggedTensor!')
+      weights = None if ignore_weights else sp_weights[index].values
+      num_shards = len(shards)
+      p_assignments = kv_variable_ops.ev_partition_assignments(
+          shards, sp_id.values)
+      positions = data_flow_ops.dynamic_partition(
+          math_ops.range(array_ops.size(sp_id.values)),
+          p_assignments, num_shards)
+      for (shard, position) in zip(shards, positions):
+        key = (shard.device, shard.shape[0].value)
+        shard_groups[key].append(
+            (index, shard.handle,
+             array_ops.gather(sp_id.values, position),
+             array_ops.gather(sp_id.indices, position),
+             None if ignore_weights else array_ops.gather(weights, position),
+             sp_id.dense_shape))
+      if combiners[index] == 'mean' and not is_sequence:
+        row_weights[index] = math_ops.unsorted_segment_sum(
+            array_ops.ones_like(sp_id.values, dtype=param.dtype)
+            if ignore_weights else weights,
+            sp_id.indices[:, 0], sp_id.dense_shape[0])
+
+    for ((device, dim), lookups) in shard_groups.items():
+      with ops.device(device):
+        outputs = group_embedding_lookup_ops.group_embedding_var_lookup(
+            [lookup[1] for lookup in lookups],
+            [lookup[2] for lookup in lookups],
+            [lookup[3] for lookup in lookups],
+            None if ignore_weights else [lookup[4] for lookup in lookups],
+            'sum',
+            [lookup[5] for lookup in lookups],
+            dim,
+            ignore_weights,
+            is_sequence,
+            )[0]
+      for (lookup, output) in zip(lookups, outputs):
+        partial_outputs[lookup[0]].append(output)
+
+    emb_vec = []
+    for (index, outputs) in enumerate(partial_outputs):
+      emb = math_ops.add_n(outputs)
+      if row_weights[index] is not None:
+        emb = math_ops.div_no_nan(
+            emb, array_ops.expand_dims(row_weights[index], -1))
+      emb_vec.append(emb)
+    return emb_vec
+
 @tf_export('nn.group_embedding_lookup_sparse')
 def group_embedding_lookup_sparse(params,
                                   sp_ids,
@@ -1642,6 +1814,14 @@ def group_embedding_lookup_sparse(params,
     if not isinstance(params, list):
         params = [params]
 
+    ignore_weights = sp_weights is None
+    if get_group_lookup_strategy() == DistStrategy.SHARDED:
+        if len(combiners) != len(sp_ids) or len(combiners) != len(params):
+            raise ValueError('len of combiners must be equal to len of sp_ids and params')
+        return _sharded_group_embedding_lookup_sparse(
+            params, list(sp_ids), combiners, sp_weights, ignore_weights,
+            is_sequence, name)
+
     #Currently do not support PartitionedVariable.
     for index, param in enumerate(params):
       if isinstance(param, variables.PartitionedVariable):
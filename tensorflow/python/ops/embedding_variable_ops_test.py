@@ -17,6 +17,7 @@ import os
 from six.moves import xrange  # pylint: disable=redefined-builtin
 
 from tensorflow.core.framework import attr_value_pb2
+from tensorflow.python.framework import constant_op
 from tensorflow.python.framework import ops
 from tensorflow.python.framework import test_util
 from tensorflow.python.ops import string_ops
@@ -24,11 +25,14 @@ from tensorflow.python.ops.check_ops import assert_equal
 from tensorflow.python.platform import googletest
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import embedding_ops
+from tensorflow.python.ops import gen_kv_variable_ops
 from tensorflow.python.ops import kv_variable_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import init_ops
 from tensorflow.python.ops import nn_ops
 from tensorflow.python.ops import partitioned_variables
+from tensorflow.python.ops import sparse_ops
+from tensorflow.python.ops.ragged import ragged_factory_ops
 from tensorflow.python.ops import variable_scope
 from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import meta_graph
@@ -486,6 +490,181 @@ class EmbeddingVariableTest(test_util.TensorFlowTestCase):
         self.assertAllEqual([1, 1, 1, 1, 1, 1], fetches[2])
         self.assertAllEqual([1, 1, 1, 1, 1, 1], fetches[3])
 
+  def testEmbeddingVariableForReshard(self):
+    print("testEmbeddingVariableForReshard")
+    routing = [b % 2 for b in range(kv_variable_ops.EV_ROUTING_BUCKETS)]
+    grown = kv_variable_ops.rebalance_ev_routing(routing, [0, 1, 2])
+    moved = [b for b in range(len(routing)) if routing[b] != grown[b]]
+    self.assertEqual(333, len(moved))
+    self.assertEqual(set([2]), set(grown[b] for b in moved))
+    with ops.device('/cpu:0'):
+      var = variable_scope.get_embedding_variable("var_1", embedding_dim=3,
+              initializer=init_ops.ones_initializer(dtypes.float32),
+              partitioner=partitioned_variables.fixed_size_partitioner(num_shards=2))
+      routing_table = kv_variable_ops.enable_ev_resharding(var)
+      emb = embedding_ops.embedding_lookup(var,
+          math_ops.cast([0, 1, 2, 3, 1001], dtypes.int64))
+      loss = math_ops.reduce_sum(emb * [[1.0], [2.0], [3.0], [4.0], [5.0]])
+      opt = adagrad.AdagradOptimizer(0.1)
+      train_op = opt.minimize(loss)
+      shards = list(var)
+      accums = [opt.get_slot(v, "accumulator") for v in shards]
+      new_routing = array_ops.placeholder(
+          dtypes.int32, [kv_variable_ops.EV_ROUTING_BUCKETS])
+      reshard = kv_variable_ops.reshard_embedding_variable(
+          var, new_routing, slots=[accums])
+      var_keys = [v.export()[0] for v in shards]
+      accum_keys = [v.export()[0] for v in accums]
+      init = variables.global_variables_initializer()
+      with self.test_session() as sess:
+        sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_VAR_OPS))
+        sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_SLOT_OPS))
+        sess.run([init])
+        sess.run(ops.get_collection(ops.GraphKeys.TABLE_INITIALIZERS))
+        sess.run(train_op)
+        emb_before = sess.run(emb)
+        routing = kv_variable_ops.rebalance_ev_routing(
+            sess.run(routing_table).tolist(), [0])
+        sess.run(reshard, {new_routing: routing})
+        self.assertAllEqual(routing, sess.run(routing_table))
+        keys = sess.run(var_keys + accum_keys)
+        self.assertAllEqual([0, 1, 2, 3, 1001], sorted(keys[0]))
+        self.assertEqual(0, len(keys[1]))
+        self.assertAllEqual([0, 1, 2, 3, 1001], sorted(keys[2]))
+        self.assertEqual(0, len(keys[3]))
+        self.assertAllClose(emb_before, sess.run(emb))
+        sess.run(train_op)
+
+  def testEmbeddingVariableForLookupSequence(self):
+    print("testEmbeddingVariableForLookupSequence")
+    with ops.device("/cpu:0"):
+      var = variable_scope.get_embedding_variable("var_1",
+              embedding_dim = 3,
+              initializer=init_ops.random_normal_initializer(seed=1))
+    ids = ragged_factory_ops.constant([[1, 2, 3], [4], []], dtype=dtypes.int64)
+    emb, lengths = kv_variable_ops.lookup_sequence(var, ids, max_length=2)
+    emb_mean, _ = kv_variable_ops.lookup_sequence(var, ids, max_length=2,
+                                                  combiner="mean",
+                                                  keep_last=False)
+    rows = embedding_ops.embedding_lookup(
+        var, math_ops.cast([1, 2, 3, 4], dtypes.int64))
+    opt = gradient_descent.GradientDescentOptimizer(0.1)
+    train_op = opt.minimize(math_ops.reduce_sum(emb))
+    init = variables.global_variables_initializer()
+    with self.test_session() as sess:
+      sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_VAR_OPS))
+      sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_SLOT_OPS))
+      sess.run([init])
+      r = sess.run(rows)
+      emb_val, lengths_val, emb_mean_val = sess.run([emb, lengths, emb_mean])
+      self.assertAllEqual([2, 1, 0], lengths_val)
+      self.assertAllClose([[r[1], r[2]], [r[3], [0] * 3], [[0] * 3] * 2],
+                          emb_val)
+      self.assertAllClose([(r[0] + r[1]) / 2, r[3], [0] * 3], emb_mean_val)
+      sess.run(train_op)
+      # Only the kept ids are updated.
+      self.assertAllClose([r[0], r[1] - 0.1, r[2] - 0.1, r[3] - 0.1],
+                          sess.run(rows))
+
+  def testEmbeddingVariableForSampleNegatives(self):
+    print("testEmbeddingVariableForSampleNegatives")
+    with ops.device("/cpu:0"):
+      var = variable_scope.get_embedding_variable("var_1",
+              embedding_dim = 3,
+              initializer=init_ops.random_normal_initializer(seed=1))
+    pool = math_ops.cast([10, 11, 12, 13], dtypes.int64)
+    positives = math_ops.cast([1, 2, 3], dtypes.int64)
+    emb, ids = kv_variable_ops.sample_negatives(var, pool, positives,
+                                                num_negatives=5,
+                                                num_in_batch=2, seed=1)
+    rows = embedding_ops.embedding_lookup(var, ids)
+    opt = gradient_descent.GradientDescentOptimizer(0.1)
+    train_op = opt.minimize(math_ops.reduce_sum(emb))
+    init = variables.global_variables_initializer()
+    with self.test_session() as sess:
+      sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_VAR_OPS))
+      sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_SLOT_OPS))
+      sess.run([init])
+      emb_val, ids_val = sess.run([emb, ids])
+      self.assertAllEqual([3, 5, 3], emb_val.shape)
+      for b, positive in enumerate([1, 2, 3]):
+        # The in-batch negatives are the other positives.
+        for k in range(2):
+          self.assertIn(ids_val[b][k], [1, 2, 3])
+          self.assertNotEqual(ids_val[b][k], positive)
+        for k in range(2, 5):
+          self.assertIn(ids_val[b][k], [10, 11, 12, 13])
+      emb_val, rows_val = sess.run([emb, rows])
+      self.assertAllClose(rows_val, emb_val)
+      sess.run(train_op)
+
+  def testEmbeddingVariableForLookupGroup(self):
+    print("testEmbeddingVariableForLookupGroup")
+    with ops.device("/cpu:0"):
+      tables = variable_scope.get_embedding_variable_group("group_1",
+              embedding_dims=[1, 3],
+              initializer=init_ops.ones_initializer(dtypes.float32))
+    ids = math_ops.cast([1, 2, 1], dtypes.int64)
+    embs = kv_variable_ops.lookup_group(tables, ids)
+    rows = [embedding_ops.embedding_lookup(table, ids) for table in tables]
+    loss = math_ops.reduce_sum(embs[0]) + math_ops.reduce_sum(embs[1])
+    opt = adagrad.AdagradOptimizer(0.1)
+    train_op = opt.minimize(loss)
+    init = variables.global_variables_initializer()
+    with self.test_session() as sess:
+      sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_VAR_OPS))
+      sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_SLOT_OPS))
+      sess.run([init])
+      emb_vals = sess.run(embs)
+      self.assertAllClose([[1]] * 3, emb_vals[0])
+      self.assertAllClose([[1] * 3] * 3, emb_vals[1])
+      sess.run(train_op)
+      updated = sess.run(rows)
+      self.assertAllClose(sess.run(embs), updated)
+      # Id 1 is looked up twice, id 2 once, in both tables.
+      self.assertAllClose(updated[0][0], updated[0][2])
+      self.assertNotAllClose(updated[0][0], updated[0][1])
+      self.assertAllClose([updated[0][0][0]] * 3, updated[1][0])
+      self.assertAllEqual([1, 2], sorted(sess.run(tables[0].export())[0]))
+
+  def testEmbeddingVariableForLookupSparseCross(self):
+    print("testEmbeddingVariableForLookupSparseCross")
+    with ops.device("/cpu:0"):
+      var = variable_scope.get_embedding_variable("var_1",
+              embedding_dim = 3,
+              initializer=init_ops.random_normal_initializer(seed=1))
+    ids = sparse_tensor.SparseTensor(
+        indices=[[0, 0], [0, 1], [1, 0], [2, 0]],
+        values=math_ops.cast([1, 2, 3, 4], dtypes.int64),
+        dense_shape=[3, 2])
+    words = sparse_tensor.SparseTensor(
+        indices=[[0, 0], [1, 0], [1, 1]],
+        values=["a", "b", "c"],
+        dense_shape=[3, 2])
+    emb = kv_variable_ops.lookup_sparse_cross(var, [ids, words],
+                                              num_buckets=1000)
+    emb_mean = kv_variable_ops.lookup_sparse_cross(var, [ids, words],
+                                                   num_buckets=1000,
+                                                   combiner="mean")
+    crosses = sparse_ops.sparse_cross_hashed([ids, words], num_buckets=1000)
+    rows = embedding_ops.embedding_lookup(var, crosses.values)
+    opt = gradient_descent.GradientDescentOptimizer(0.1)
+    train_op = opt.minimize(math_ops.reduce_sum(emb))
+    init = variables.global_variables_initializer()
+    with self.test_session() as sess:
+      sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_VAR_OPS))
+      sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_SLOT_OPS))
+      sess.run([init])
+      # Row 0 crosses (1, a) and (2, a), row 1 (3, b) and (3, c), row 2 has
+      # no word.
+      r = sess.run(rows)
+      emb_val, emb_mean_val = sess.run([emb, emb_mean])
+      self.assertAllClose([r[0] + r[1], r[2] + r[3], [0] * 3], emb_val)
+      self.assertAllClose([(r[0] + r[1]) / 2, (r[2] + r[3]) / 2, [0] * 3],
+                          emb_mean_val)
+      sess.run(train_op)
+      self.assertAllClose(r - 0.1, sess.run(rows))
+
   def testEmbeddingVariableForGetShape(self):
     print("testEmbeddingVariableForGetShape")
     with ops.device("/cpu:0"):
@@ -560,6 +739,35 @@ class EmbeddingVariableTest(test_util.TensorFlowTestCase):
         for i in range(ids.shape.as_list()[0]):
           self.assertAllEqual(val_list[0][i], val_list[1][i])
 
+  def testEmbeddingVariableForMultiHashFusedLookup(self):
+    print("testEmbeddingVariableForMultiHashFusedLookup")
+    operation_list = ['concat', 'add', 'mul']
+    for operation in operation_list:
+      with ops.Graph().as_default():
+        ids = math_ops.cast([0, 1, 2, 4, 6, 7, 7], dtypes.int64)
+        embs = []
+        train_ops = []
+        # The unpartitioned tables take the fused lookup.
+        for partitioner in [None,
+                            partitioned_variables.fixed_size_partitioner(num_shards=2)]:
+          var_multi = variable_scope.get_multihash_variable(
+              "var_multi_" + str(len(embs)), [[3, 4], [3, 4]],
+              complementary_strategy="Q-R",
+              operation=operation,
+              initializer=init_ops.ones_initializer,
+              partitioner=partitioner)
+          emb = embedding_ops.embedding_lookup(var_multi, ids)
+          loss = math_ops.reduce_sum(math_ops.square(emb))
+          opt = gradient_descent.GradientDescentOptimizer(0.1)
+          train_ops.append(opt.minimize(loss))
+          embs.append(emb)
+        self.assertEqual("MultiHashEmbeddingLookup", embs[0].op.type)
+        with self.test_session() as sess:
+          sess.run(variables.global_variables_initializer())
+          self.assertAllClose(*sess.run(embs))
+          sess.run(train_ops)
+          self.assertAllClose(*sess.run(embs))
+
   def testCategoricalColumnWithEmbeddingVariableFunction(self):
     print("testCategoricalColumnWithEmbeddingVariableFunction")
     operation_list = ['concat', 'add', 'mul']
@@ -2071,6 +2279,62 @@ class EmbeddingVariableTest(test_util.TensorFlowTestCase):
       self.assertAllEqual(np.array([3,1,2,0,2,0,1]), f)
       self.assertAllEqual(np.array([2,0,1,-1,2,-1,2]), v)
 
+  def testEmbeddingVariableForGetStats(self):
+    print("testEmbeddingVariableForGetStats")
+    with ops.device("/cpu:0"):
+      var = variable_scope.get_embedding_variable("var_1",
+              embedding_dim = 3,
+              initializer=init_ops.ones_initializer(dtypes.float32))
+    ids = array_ops.placeholder(dtype=dtypes.int64, name='ids')
+    emb = embedding_ops.embedding_lookup(var, ids)
+    stats = var.get_stats()
+    init = variables.global_variables_initializer()
+    with self.test_session() as sess:
+      sess.run([init])
+      sess.run([emb], feed_dict={'ids:0': [1,2,3]})
+      sess.run([emb], feed_dict={'ids:0': [1,3,5]})
+      names, values = sess.run(stats)
+      stats = dict(zip([name.decode() for name in names], values))
+      self.assertEqual(4, stats["num_keys"])
+      self.assertGreaterEqual(stats["lookups"], 6)
+      self.assertGreaterEqual(stats["lookup_calls"], 2)
+      self.assertEqual(0, stats["filter_rejections"])
+      self.assertGreater(stats["tier0_bytes"], 0)
+
+  def testEmbeddingVariableForHotKeyReplica(self):
+    print("testEmbeddingVariableForHotKeyReplica")
+    with ops.device("/cpu:0"):
+      var = variable_scope.get_embedding_variable("var_1",
+              embedding_dim = 3,
+              initializer=init_ops.ones_initializer(dtypes.float32),
+              ev_option = variables.EmbeddingVariableOption(
+                hot_key_option=variables.HotKeyReplicaOption(
+                  max_rows=3, max_staleness_steps=2)))
+    emb = embedding_ops.embedding_lookup(var,
+            math_ops.cast([1, 1, 2, 3], dtypes.int64))
+    fun = math_ops.multiply(emb, 2.0, name='multiply')
+    loss = math_ops.reduce_sum(fun, name='reduce_sum')
+    gs = training_util.get_or_create_global_step()
+    opt = gradient_descent.GradientDescentOptimizer(0.1)
+    g_v = opt.compute_gradients(loss)
+    train_op = opt.apply_gradients(g_v, gs)
+    rows = var.sparse_read(math_ops.cast([1, 2, 3], dtypes.int64))
+    init = variables.global_variables_initializer()
+    with self.test_session() as sess:
+      sess.run([init])
+      # Step 0 refreshes the cache, step 1 reads the cached rows.
+      r0, _ = sess.run([emb, train_op])
+      r1, _ = sess.run([emb, train_op])
+      self.assertAllClose(np.ones([4, 3]), r0)
+      self.assertAllClose(np.ones([4, 3]), r1)
+      # Step 2 refreshes the cache with the rows updated by step 0.
+      r2, _ = sess.run([emb, train_op])
+      self.assertAllClose([[.6] * 3, [.6] * 3, [.8] * 3, [.8] * 3], r2)
+      # Step 3 flushes the gradients of steps 1 and 3.
+      r3, _ = sess.run([emb, train_op])
+      self.assertAllClose(r2, r3)
+      self.assertAllClose([[-.6] * 3, [.2] * 3, [.2] * 3], sess.run(rows))
+
   def testEmbeddingVariableForInference(self):
     print("testEmbeddingVariableForInference")
     with ops.device("/cpu:0"):
@@ -2546,5 +2810,49 @@ class EmbeddingVariableTest(test_util.TensorFlowTestCase):
         self.assertNotEqual(val, 1.0)
     del os.environ["TF_EMBEDDING_FBJ_OPT"]
 
+  def testEncodedIdsDedupAndDecode(self):
+    print("testEncodedIdsDedupAndDecode")
+    ids = constant_op.constant([7, -3, 7, 1 << 40, -3, 7], dtypes.int64)
+    counts = constant_op.constant([1, 2, 3, 4, 5, 6], dtypes.int64)
+    encoded, idx = gen_kv_variable_ops.kv_ids_dedup_encode(
+        ids, counts, encode_counts=True)
+    unique_ids, unique_counts = gen_kv_variable_ops.kv_ids_decode(
+        encoded, decode_counts=True, Tkeys=dtypes.int64)
+    with self.test_session() as sess:
+      unique_ids, unique_counts, idx = sess.run(
+          [unique_ids, unique_counts, idx])
+    self.assertAllEqual([-3, 7, 1 << 40], unique_ids)
+    self.assertAllEqual([7, 10, 4], unique_counts)
+    self.assertAllEqual([1, 0, 1, 2, 0, 1], idx)
+
+  def testEmbeddingVariableForEncodedIds(self):
+    print("testEmbeddingVariableForEncodedIds")
+    def runTestAdagrad(self, encode):
+      os.environ["TF_EV_ENCODE_LOOKUP_IDS"] = "1" if encode else "0"
+      try:
+        with ops.Graph().as_default() as g:
+          var = variable_scope.get_embedding_variable("var_1",
+              embedding_dim=3,
+              initializer=init_ops.ones_initializer(dtypes.float32),
+              partitioner=partitioned_variables.fixed_size_partitioner(
+                  num_shards=2))
+          ids = math_ops.cast([1, 2, 3, 1, 5, 2, 1], dtypes.int64)
+          emb = embedding_ops.embedding_lookup(var, ids)
+          fun = math_ops.multiply(emb, math_ops.cast(
+              array_ops.reshape(math_ops.range(21), [7, 3]), dtypes.float32))
+          loss = math_ops.reduce_sum(fun, name='reduce_sum')
+          opt = adagrad.AdagradOptimizer(0.1)
+          train_op = opt.minimize(loss)
+          op_types = [op.type for op in g.get_operations()]
+          self.assertEqual(op_types.count("KvIdsDecode"), 2 if encode else 0)
+          with self.test_session(graph=g) as sess:
+            sess.run(variables.global_variables_initializer())
+            sess.run(train_op)
+            return sess.run(emb)
+      finally:
+        del os.environ["TF_EV_ENCODE_LOOKUP_IDS"]
+    self.assertAllClose(runTestAdagrad(self, False),
+                        runTestAdagrad(self, True))
+
 if __name__ == "__main__":
   googletest.main()
@@ -8,6 +8,8 @@ from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import ops
 from tensorflow.python.ops import variables
 from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import custom_gradient
+from tensorflow.python.ops import math_ops
 from tensorflow.python.framework import sparse_tensor
 from tensorflow.python.ops import gen_fused_embedding_ops
 from tensorflow.python.ops.kv_variable_ops import EmbeddingVariable
@@ -27,7 +29,8 @@ def fused_embedding_lookup_sparse(params,
                                   max_norm=None,
                                   default_id=None,
                                   prune_invalid_ids=False,
-                                  blocknums=None):
+                                  blocknums=None,
+                                  sorted_lookup=False):
   if sparse_weights is not None:
     raise ValueError("sparse_weights is not supported yet")
 
@@ -62,7 +65,8 @@ def fused_embedding_lookup_sparse(params,
           sp_dense_shape=sp_ids.dense_shape,
           fill_empty_row=True,
           default_id=default_id,
-          prune_invalid_id=bool(prune_invalid_ids)
+          prune_invalid_id=bool(prune_invalid_ids),
+          sort_values=bool(sorted_lookup)
       )
 
     # fixme(marvin): ple align the meaning between pre & post op.
@@ -73,7 +77,10 @@ def fused_embedding_lookup_sparse(params,
       param = params[i]
       sub_partition_values = partitioned_values[i]
       with ops.colocate_with(param):
-        shard = array_ops.gather(param, sub_partition_values)
+        if sorted_lookup:
+          shard = _gather_sorted_unique(param, sub_partition_values)
+        else:
+          shard = array_ops.gather(param, sub_partition_values)
         emb_shards.append(shard)
     emb_vectors, _ = fused_embedding_sparse_post_look_up(
       emb_shards=emb_shards, partitioned_indices=partitioned_indices,
@@ -86,6 +93,28 @@ def fused_embedding_lookup_sparse(params,
   return emb_vectors
 
 
+def _gather_sorted_unique(params, ids):
+  """Gathers the rows of sorted ids once per distinct id.
+
+  The rows are expanded back to the ids through the index of their run of
+  equal ids, so the gradient of params has one row per distinct id, summed
+  over the run by a sorted segment sum.
+  """
+  is_head = array_ops.concat(
+      [[True], math_ops.not_equal(ids[1:], ids[:-1])], 0)
+  is_head = is_head[:array_ops.size(ids)]
+  unique_idx = math_ops.cumsum(math_ops.cast(is_head, dtypes.int64)) - 1
+  unique_ids = array_ops.boolean_mask(ids, is_head)
+  return _expand_sorted_rows(array_ops.gather(params, unique_ids), unique_idx)
+
+
+@custom_gradient.custom_gradient
+def _expand_sorted_rows(rows, row_idx):
+  def grad(dy):
+    return math_ops.segment_sum(dy, row_idx), None
+  return array_ops.gather(rows, row_idx), grad
+
+
 @ops.RegisterGradient("FusedEmbeddingSparsePostLookUp")
 def fused_embedding_sparse_post_look_up_grad(op, top_grad_emb_vec, _):
   num_partitions = op.get_attr("num_partitions")
@@ -13,12 +13,14 @@ from tensorflow.python.ops import kv_variable_ops
 from tensorflow.python.ops import init_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import partitioned_variables
 
 from tensorflow.python.framework import ops
 from tensorflow.python.framework import test_util
 from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import sparse_tensor
 from tensorflow.python.framework import config
+from tensorflow.python.framework import group_embedding_types
 from tensorflow.core.framework.embedding import config_pb2
 from tensorflow.python.training import training_util
 from tensorflow.python.training import adagrad
@@ -187,6 +189,46 @@ class GroupEmbeddingGPUTest(test_util.TensorFlowTestCase):
             for k in range(0, 16):
                 self.assertNear(ev_result[i].tolist()[j][k], ev_result[2+i].tolist()[j][k], 1e-05)
   
+  @test_util.run_gpu_only
+  def testShardedMultiKvResourceGather(self):
+    print("testShardedMultiKvResourceGather")
+    with ops.device('/GPU:0'):
+      emb_var_0 = variable_scope.get_embedding_variable("sharded_emb_var_0",
+            embedding_dim = 8,
+            initializer=init_ops.ones_initializer(dtypes.float32),
+            partitioner=partitioned_variables.fixed_size_partitioner(num_shards=2))
+      emb_var_1 = variable_scope.get_embedding_variable("sharded_emb_var_1",
+            embedding_dim = 16,
+            initializer=init_ops.ones_initializer(dtypes.float32),
+            partitioner=partitioned_variables.fixed_size_partitioner(num_shards=2))
+
+    indices_0 = sparse_tensor.SparseTensor(
+        indices=ops.convert_to_tensor([[0, 0], [1, 1], [2, 0], [2, 1], [3, 2]], dtype=dtypes.int64),
+        values=ops.convert_to_tensor([1, 1, 3, 4, 5], dtype=dtypes.int64),
+        dense_shape=[4, 3])
+
+    group_embedding_types.set_group_lookup_strategy("sharded")
+    try:
+      emb = embedding_ops.group_embedding_lookup_sparse(
+          [emb_var_0, emb_var_1], [indices_0, indices_0], ["mean", "sum"])
+    finally:
+      group_embedding_types.set_group_lookup_strategy("localized")
+    loss = math_ops.reduce_sum(array_ops.concat(emb, axis=-1))
+    opt = adagrad.AdagradOptimizer(0.1)
+    train_op = opt.apply_gradients(opt.compute_gradients(loss))
+    init = variables.global_variables_initializer()
+    with self.test_session(use_gpu=True, force_gpu=True) as sess:
+      sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_VAR_OPS))
+      sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_SLOT_OPS))
+      sess.run([init])
+      ev_result, _ = sess.run([emb, train_op])
+    # Row 2 has the ids 3 and 4 of both shards.
+    for i in range(4):
+      for j in range(8):
+        self.assertEqual(ev_result[0].tolist()[i][j], 1)
+      for j in range(16):
+        self.assertEqual(ev_result[1].tolist()[i][j], 2 if i == 2 else 1)
+
   @test_util.run_gpu_only
   def testMultiKvResourceGatherForSparseColumnEmbeddingCol(self):
     with feature_column_v2.group_embedding_column_scope(name="test"):
@@ -29,6 +29,7 @@ from tensorflow.python.eager import context
 from tensorflow.python.eager import tape
 from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import ops
+from tensorflow.python.framework import random_seed
 from tensorflow.python.framework import tensor_shape
 from tensorflow.python.framework import tensor_util
 from tensorflow.python.ops import array_ops
@@ -284,7 +285,10 @@ class EmbeddingVariable(resource_variable_ops.ResourceVariable):
       self._false_positive_probability = -1.0
       self._counter_type = dtypes.uint64
 
-    self._record_freq = (os.environ.get("TF_RECORD_FREQ", "0") == "1")
+    self._hot_key_option = evconfig.hot_key_option
+    # The hot keys are picked by their frequencies on the PS.
+    self._record_freq = (os.environ.get("TF_RECORD_FREQ", "0") == "1" or
+                         self._hot_key_option is not None)
     self._record_version = (os.environ.get("TF_RECORD_VERSION", "0") == "1")
     self._l2_weight_threshold = evconfig.l2_weight_threshold
     self._storage_type = evconfig.storage_type
@@ -417,6 +421,7 @@ class EmbeddingVariable(resource_variable_ops.ResourceVariable):
                                   config_pb2.StorageType.DRAM_PMEM,
                                   config_pb2.StorageType.DRAM_LEVELDB,
                                   config_pb2.StorageType.DRAM_SSDHASH,
+                                  config_pb2.StorageType.DRAM_CXL,
                                   config_pb2.StorageType.HBM_DRAM,
                                   config_pb2.StorageType.DRAM_PMEM_SSDHASH,
                                   config_pb2.StorageType.HBM_DRAM_SSDHASH]
@@ -553,6 +558,7 @@ class EmbeddingVariable(resource_variable_ops.ResourceVariable):
     self._default_value_dim = init_op.get_attr("default_value_dim")
     self._default_value_no_permission= init_op.get_attr("default_value_no_permission")
     self._record_freq = init_op.get_attr("record_freq")
+    self._hot_key_option = None
     self._record_version = init_op.get_attr("record_version")
     self._storage_cache_strategy = config_pb2.CacheStrategy.LFU
     if cache_op:
@@ -682,6 +688,12 @@ class EmbeddingVariable(resource_variable_ops.ResourceVariable):
                                               ids,
                                               Tvalues=self.dtype)
 
+  def get_stats(self):
+    """Returns the names and values of the runtime statistics."""
+    return gen_kv_variable_ops.ev_get_stats(self._handle,
+                                            Tkeys=self._invalid_key_type,
+                                            Tvalues=self.dtype)
+
   def export(self):
     return gen_kv_variable_ops.kv_resource_export(self._handle,
 		    self._invalid_key_type, self.dtype)
@@ -810,6 +822,64 @@ class EmbeddingVariable(resource_variable_ops.ResourceVariable):
               name=name)
     return array_ops.identity(value)
 
+  def hot_key_sparse_read(self, indices, name=None):
+    """Reads the rows of `indices`, serving the hot ones from the worker.
+
+    The rows cached by the worker side hot row cache are read without
+    reaching the PS, see `HotKeyReplicaOption`. The optimizers merge their
+    gradients into the gradients of this variable.
+    """
+    from tensorflow.python.ops import data_flow_ops
+    from tensorflow.python.training import training_util
+    option = self._hot_key_option
+    dim = tensor_shape.dimension_value(self.get_shape()[-1])
+    with ops.colocate_with(None, ignore_existing=True):
+      with ops.name_scope("HotKeySparseRead" if name is None else name):
+        indices = ops.convert_to_tensor(indices)
+        unique_ids, idx = array_ops.unique(array_ops.reshape(indices, [-1]))
+        global_step = ops.convert_to_tensor(
+            training_util.get_or_create_global_step())
+        global_step = math_ops.cast(global_step, dtypes.int64)
+        cache = gen_kv_variable_ops.hot_row_cache_handle_op(
+            shared_name=self._handle_name.split(":")[0] + "/hot_row_cache",
+            Tkeys=self._invalid_key_type, dtype=self._dtype)
+        cached_rows, hits, is_stale = gen_kv_variable_ops.hot_row_cache_lookup(
+            cache, unique_ids, global_step, value_dim=dim,
+            max_staleness_steps=option.max_staleness_steps)
+        hit_pos = math_ops.cast(
+            array_ops.reshape(array_ops.where(hits), [-1]), dtypes.int32)
+        miss_pos = math_ops.cast(
+            array_ops.reshape(array_ops.where(math_ops.logical_not(hits)),
+                              [-1]), dtypes.int32)
+        hit_ids = array_ops.gather(unique_ids, hit_pos)
+        hit_rows = array_ops.gather(cached_rows, hit_pos)
+        miss_ids = array_ops.gather(unique_ids, miss_pos)
+        with ops.colocate_with(self):
+          miss_rows = self.sparse_read(miss_ids)
+
+        # A stale cache misses all the ids, so the rows read from the PS
+        # refresh it.
+        def _refresh():
+          with ops.colocate_with(self):
+            freqs = gen_kv_variable_ops.ev_get_frequency(
+                self._handle, miss_ids, Tvalues=self._dtype)
+          refresh = gen_kv_variable_ops.hot_row_cache_refresh(
+              cache, miss_ids, miss_rows, freqs, global_step,
+              max_rows=option.max_rows, min_freq=option.min_freq)
+          with ops.control_dependencies([refresh]):
+            return array_ops.identity(is_stale)
+        refreshed = control_flow_ops.cond(
+            is_stale, _refresh, lambda: array_ops.identity(is_stale))
+        with ops.control_dependencies([refreshed]):
+          rows = data_flow_ops.dynamic_stitch(
+              [hit_pos, miss_pos], [hit_rows, miss_rows])
+        ops.add_to_collection(ops.GraphKeys._EV_HOT_ROWS,  # pylint: disable=protected-access
+                              _HotRows(self, cache, hit_ids, hit_rows,
+                                       global_step))
+        result = array_ops.gather(rows, idx)
+        return array_ops.reshape(
+            result, array_ops.concat([array_ops.shape(indices), [dim]], 0))
+
   def to_proto(self, export_scope=None):
     """Converts a `EmbeddingVariable` to a `VariableDef` protocol buffer.
 
@@ -926,6 +996,54 @@ class MultiHashVariable(resource_variable_ops.ResourceVariable):
   def mhvconfig(self):
     return self._mhvconfig
 
+class _HotRows(object):
+  """The rows of `var` served by the hot row cache `cache` in a lookup."""
+
+  def __init__(self, var, cache, ids, rows, global_step):
+    self.var = var
+    self.cache = cache
+    self.ids = ids
+    self.rows = rows
+    self.global_step = global_step
+
+
+def merge_hot_row_gradients(grads_and_targets, hot_rows_grads):
+  """Merges the gradients of the hot rows into the gradients of the EVs.
+
+  The gradients of the hot rows are summed per id on the worker, and
+  merged into the gradients of their variable once per
+  `max_staleness_steps` steps.
+
+  Args:
+    grads_and_targets: A list of (gradient, variable) pairs.
+    hot_rows_grads: A list of (gradient, `_HotRows`) pairs.
+
+  Returns:
+    A list of (gradient, variable) pairs.
+  """
+  flushed = {}
+  for grad, hot_rows in hot_rows_grads:
+    if grad is None:
+      continue
+    var = hot_rows.var
+    with ops.colocate_with(hot_rows.rows):
+      grad = ops.convert_to_tensor(grad)
+      flush_ids, flush_grads = gen_kv_variable_ops.hot_row_cache_accumulate(
+          hot_rows.cache, hot_rows.ids, grad, hot_rows.global_step,
+          max_staleness_steps=var._hot_key_option.max_staleness_steps)
+    flushed.setdefault(id(var), []).append((flush_ids, flush_grads))
+  merged = []
+  for grad, var in grads_and_targets:
+    if id(var) in flushed and isinstance(grad, ops.IndexedSlices):
+      ids, values = zip(*flushed[id(var)])
+      grad = ops.IndexedSlices(
+          array_ops.concat([grad.values] + list(values), 0),
+          array_ops.concat([grad.indices] + list(ids), 0),
+          grad.dense_shape)
+    merged.append((grad, var))
+  return merged
+
+
 class DynamicEmbeddingVariable(resource_variable_ops.ResourceVariable):
   def __init__(self, name, ev_list):
     if not ev_list:
@@ -974,8 +1092,7 @@ def lookup_tier(var, ids):
     np = len(ev_list)
     partitioned_result = []
     original_indices = math_ops.range(array_ops.size(ids))
-    p_assignments = ids % 1000 % np
-    p_assignments = math_ops.cast(p_assignments, dtypes.int32)
+    p_assignments = ev_partition_assignments(ev_list, ids)
     from tensorflow.python.ops import data_flow_ops
     gather_ids = data_flow_ops.dynamic_partition(ids, p_assignments, np)
     pindices = data_flow_ops.dynamic_partition(original_indices,
@@ -990,12 +1107,332 @@ def lookup_tier(var, ids):
           pindices, partitioned_result)
     return ret
 
+def lookup_sequence(var, ids, max_length, combiner=None, keep_last=True,
+                    name=None):
+  """Looks up ragged sequences of ids from `var`, truncated to `max_length`.
+
+  Args:
+    var: An `EmbeddingVariable`.
+    ids: A 2-D `RaggedTensor` of ids, one sequence per row.
+    max_length: The number of ids kept of each sequence.
+    combiner: None to return the padded embeddings, or "sum" or "mean" to
+      pool them.
+    keep_last: Whether to keep the last ids of longer sequences, otherwise
+      the first ones.
+    name: A name for the operation (optional).
+
+  Returns:
+    A tuple of the embeddings, `[batch, max_length, dim]` zero padded or
+    `[batch, dim]` pooled, and the `int32` lengths of the kept sequences.
+  """
+  if not isinstance(var, EmbeddingVariable):
+    raise ValueError("lookup_sequence expects an EmbeddingVariable, got %s"
+                     % type(var))
+  output, _, lengths = gen_kv_variable_ops.kv_resource_sequence_gather(
+      var.handle, ids.values, math_ops.cast(ids.row_splits, dtypes.int64),
+      max_length=max_length, combiner=combiner or "none",
+      keep_last=keep_last, dtype=var._dtype, name=name)
+  return output, lengths
+
+def sample_negatives(var, item_pool, positives, num_negatives,
+                     num_in_batch=0, distortion=0.75, refresh_steps=1000,
+                     seed=None, name=None):
+  """Samples negatives for `positives` and looks up their embeddings.
+
+  `num_in_batch` of the negatives of a positive are the other positives of
+  the batch, the others are drawn from `item_pool` with the probabilities
+  `(freq + 1) ^ distortion`, the frequencies of the items in `var`, as
+  `get_frequency` returns them. The sampling table is rebuilt every
+  `refresh_steps` runs and when `item_pool` changes.
+
+  Args:
+    var: An `EmbeddingVariable` of the items.
+    item_pool: A 1-D tensor of the ids the negatives are drawn from.
+    positives: A 1-D tensor of the ids of the positives of the batch.
+    num_negatives: The number of negatives of each positive.
+    num_in_batch: The number of them taken from the batch.
+    distortion: The exponent of the frequencies, 0 samples uniformly.
+    refresh_steps: The number of runs between rebuilds of the table.
+    seed: A Python integer, see `tf.compat.v1.set_random_seed`.
+    name: A name for the operation (optional).
+
+  Returns:
+    A tuple of the embeddings of the negatives,
+    `[batch, num_negatives, dim]`, and their ids, `[batch, num_negatives]`.
+  """
+  if not isinstance(var, EmbeddingVariable):
+    raise ValueError("sample_negatives expects an EmbeddingVariable, got %s"
+                     % type(var))
+  seed1, seed2 = random_seed.get_seed(seed)
+  return gen_kv_variable_ops.kv_resource_sample_negatives(
+      var.handle, item_pool, positives, num_negatives=num_negatives,
+      num_in_batch=num_in_batch, distortion=distortion,
+      refresh_steps=refresh_steps, seed=seed1, seed2=seed2,
+      dtype=var._dtype, name=name)
+
+def lookup_sparse_cross(var, inputs, num_buckets=0, hash_key=None,
+                        combiner="sum", name=None):
+  """Looks up the hashed crosses of sparse features from `var`.
+
+  The crosses are the keys of `sparse_ops.sparse_cross_hashed`, but they are
+  looked up and combined by row in one op, without the crossed SparseTensor.
+
+  Args:
+    var: An `EmbeddingVariable` of `int64` keys.
+    inputs: A list of 2-D `SparseTensor`s of `int64` or `string` features.
+    num_buckets: The number of buckets of the crosses, 0 for none.
+    hash_key: The key of the FingerprintCat64 of the crosses, the default of
+      `sparse_cross_hashed` if None.
+    combiner: "sum", "mean" or "sqrtn", the combiner of the embeddings of
+      the crosses of a row.
+    name: A name for the operation (optional).
+
+  Returns:
+    The combined embeddings, `[batch, dim]`.
+  """
+  if not isinstance(var, EmbeddingVariable):
+    raise ValueError("lookup_sparse_cross expects an EmbeddingVariable, "
+                     "got %s" % type(var))
+  values = [v.values if v.values.dtype == dtypes.string
+            else math_ops.cast(v.values, dtypes.int64) for v in inputs]
+  output, _, _ = gen_kv_variable_ops.kv_resource_sparse_cross_gather(
+      var.handle, [v.indices for v in inputs], values,
+      [v.dense_shape for v in inputs], num_buckets=num_buckets,
+      hash_key=hash_key or 0xDECAFCAFFE, combiner=combiner,
+      dtype=var._dtype, name=name)
+  return output
+
+def lookup_group(tables, ids, name=None):
+  """Looks up `ids` in all the tables of an EmbeddingVariable group.
+
+  The key index shared by the tables, see
+  `variable_scope.get_embedding_variable_group`, is probed once for all of
+  them, instead of once per table by their own lookups. With
+  `TF_EMBEDDING_FBJ_OPT=1`, the apply ops of the tables reuse the entries
+  found as well.
+
+  Args:
+    tables: The `EmbeddingVariable`s of one group.
+    ids: The ids to look up.
+    name: A name for the operation (optional).
+
+  Returns:
+    The list of the embeddings of `ids` in each table.
+  """
+  for table in tables:
+    if (not isinstance(table, EmbeddingVariable) or
+        table._primary is not tables[0]._primary):
+      raise ValueError("lookup_group expects the EmbeddingVariables of one "
+                       "group, got %s" % table)
+  outputs, _ = gen_kv_variable_ops.kv_resource_group_gather(
+      [table.handle for table in tables], ids, dtype=tables[0]._dtype,
+      name=name)
+  return outputs
+
 def lookup_resource(var):
   return gen_kv_variable_ops.kv_resource_lookup_resource(
       var.handle,
       Tkeys=var._invalid_key_type,
       dtype=var._dtype)
 
+# The ids of a partitioned EmbeddingVariable are routed by their bucket,
+# `id % 1000`, which is also the unit of its checkpoints (kSavedPartitionNum).
+EV_ROUTING_BUCKETS = 1000
+
+
+def ev_partition_assignments(shards, ids):
+  """Returns the int32 partitions of `ids` among the `shards` of a
+  partitioned EmbeddingVariable: `ids % 1000 % len(shards)`, or the routing
+  table of the buckets once `enable_ev_resharding` is called."""
+  buckets = ids % EV_ROUTING_BUCKETS
+  routing_table = getattr(shards[0], "_ev_routing_table", None)
+  if routing_table is None:
+    return math_ops.cast(buckets % len(shards), dtypes.int32)
+  return array_ops.gather(routing_table, math_ops.cast(buckets, dtypes.int32))
+
+
+def enable_ev_resharding(var):
+  """Routes the ids of a partitioned EmbeddingVariable by a routing table.
+
+  The table maps the buckets of the ids to the partitions, starting from the
+  default `bucket % num_partitions`, and is changed online by
+  `reshard_embedding_variable`. It lives with the first partition, so the
+  workers see the new routing at their next lookup. It is not saved in the
+  checkpoints: the rows are restored by the default routing, and the table
+  starts over with it when the parameter servers restart.
+
+  Must be called before the lookups of `var` are built.
+
+  Args:
+    var: A `PartitionedVariable` of EmbeddingVariables.
+
+  Returns:
+    The routing table, an int32 variable of `EV_ROUTING_BUCKETS` elements.
+  """
+  from tensorflow.python.ops import state_ops
+  shards = list(var)
+  routing_table = getattr(shards[0], "_ev_routing_table", None)
+  if routing_table is not None:
+    return routing_table
+  default_routing = [b % len(shards) for b in range(EV_ROUTING_BUCKETS)]
+  with ops.colocate_with(shards[0]):
+    routing_table = variables.VariableV1(
+        default_routing, dtype=dtypes.int32, trainable=False,
+        collections=[], name=var.name + "/routing_table")
+    # Runs with the local init op of every worker, so only the first one
+    # initializes the table.
+    initializer = control_flow_ops.cond(
+        variables.is_variable_initialized(routing_table),
+        control_flow_ops.no_op,
+        lambda: state_ops.assign(routing_table, default_routing).op)
+  ops.add_to_collection(ops.GraphKeys.TABLE_INITIALIZERS, initializer)
+  for shard in shards:
+    shard._ev_routing_table = routing_table
+  return routing_table
+
+
+def rebalance_ev_routing(routing, partitions):
+  """Returns a routing table that spreads the buckets evenly among
+  `partitions`, moving the fewest buckets from `routing`.
+
+  Adding a partition to N ones moves about 1/(N+1) of the buckets, all of
+  them to the new partition, and removing one only moves its own buckets.
+
+  Args:
+    routing: The current routing table, a list of partitions per bucket.
+    partitions: The partitions to route the buckets to.
+  """
+  partitions = sorted(set(partitions))
+  if not partitions:
+    raise ValueError("At least one partition is needed.")
+  counts = dict((p, 0) for p in partitions)
+  for p in routing:
+    if p in counts:
+      counts[p] += 1
+  # The partitions with the most buckets keep the extra ones.
+  by_count = sorted(partitions, key=lambda p: (-counts[p], p))
+  quota = dict((p, len(routing) // len(partitions) +
+                (1 if i < len(routing) % len(partitions) else 0))
+               for i, p in enumerate(by_count))
+  new_routing = list(routing)
+  kept = dict((p, 0) for p in partitions)
+  moved = []
+  for bucket, p in enumerate(routing):
+    if p in kept and kept[p] < quota[p]:
+      kept[p] += 1
+    else:
+      moved.append(bucket)
+  targets = [p for p in partitions for _ in range(quota[p] - kept[p])]
+  for bucket, p in zip(moved, targets):
+    new_routing[bucket] = p
+  return new_routing
+
+
+def reshard_embedding_variable(var, new_routing, slots=None, name=None):
+  """Moves the rows of a partitioned EmbeddingVariable to a new routing.
+
+  The rows of the buckets routed elsewhere are copied to their new
+  partitions with their versions and freqs, then the routing table is
+  updated, and the rows are removed from their old partitions. It runs while
+  training goes on: the updates of the moved rows in between are lost.
+
+  Args:
+    var: A `PartitionedVariable` of EmbeddingVariables, see
+      `enable_ev_resharding`.
+    new_routing: An int32 tensor of the partition of each bucket, such as
+      the result of `rebalance_ev_routing`.
+    slots: The slots of `var` to move with it, each one a list of the
+      EmbeddingVariables of the partitions, such as
+      `[optimizer.get_slot(v, "accumulator") for v in var]`.
+    name: A name for the operation (optional).
+
+  Returns:
+    The op of the resharding.
+  """
+  from tensorflow.python.ops import data_flow_ops
+  from tensorflow.python.ops import state_ops
+  shards = list(var)
+  routing_table = getattr(shards[0], "_ev_routing_table", None)
+  if routing_table is None:
+    raise ValueError("Call enable_ev_resharding on %s before building "
+                     "its lookups." % var.name)
+  np = len(shards)
+  groups = [shards] + [list(slot) for slot in (slots or [])]
+  with ops.name_scope(name, "reshard_embedding_variable"):
+    new_routing = ops.convert_to_tensor(new_routing, dtype=dtypes.int32)
+    old_routing = array_ops.identity(routing_table)
+    buckets = math_ops.range(EV_ROUTING_BUCKETS)
+    moved = math_ops.not_equal(old_routing, new_routing)
+    moved_buckets = []
+    for p in range(np):
+      with ops.colocate_with(shards[p]):
+        moved_buckets.append(array_ops.boolean_mask(
+            buckets, math_ops.logical_and(
+                moved, math_ops.equal(old_routing, p))))
+
+    imports = []
+    for group in groups:
+      rows_to = [[] for _ in range(np)]
+      for p, shard in enumerate(group):
+        with ops.colocate_with(shard):
+          rows = gen_kv_variable_ops.kv_resource_export_buckets(
+              shard.handle, moved_buckets[p],
+              Tkeys=shard._invalid_key_type, Tvalues=shard.dtype)
+          dst = array_ops.gather(
+              new_routing,
+              math_ops.cast(rows[0] % EV_ROUTING_BUCKETS, dtypes.int32))
+          # The versions and freqs are empty when they are not recorded.
+          parts = [data_flow_ops.dynamic_partition(
+              t, dst[:array_ops.shape(t)[0]], np) for t in rows]
+        for q in range(np):
+          rows_to[q].append([part[q] for part in parts])
+      for q, shard in enumerate(group):
+        with ops.colocate_with(shard):
+          imports.append(gen_kv_variable_ops.kv_resource_import_rows(
+              shard.handle,
+              *[array_ops.concat([rows[i] for rows in rows_to[q]], 0)
+                for i in range(4)]))
+
+    with ops.control_dependencies(imports):
+      update_routing = state_ops.assign(routing_table, new_routing)
+    removes = []
+    for p, shard in enumerate(shards):
+      with ops.colocate_with(shard), \
+          ops.control_dependencies([update_routing]):
+        removes.append(gen_kv_variable_ops.kv_resource_remove_buckets(
+            shard.handle, moved_buckets[p],
+            Tkeys=shard._invalid_key_type, Tvalues=shard.dtype))
+    return control_flow_ops.group(*removes)
+
+
+def export_placement_profile(sess, path, var_list=None):
+  """Writes the placement profile of EmbeddingVariables to `path`.
+
+  The profile holds the number of keys and of looked up keys of each
+  partition, by the name of its handle op. Pointing TF_EV_PLACEMENT_PROFILE
+  at it balances the partitions between the parameter servers in the next
+  sessions of the same model.
+
+  Args:
+    sess: The session to read the statistics with.
+    path: The file to write the profile to.
+    var_list: The EmbeddingVariables to profile. Defaults to the ones in the
+      EMBEDDING_VARIABLES collection. Slots are skipped, they move with
+      their primary.
+  """
+  if var_list is None:
+    var_list = ops.get_collection(ops.GraphKeys.EMBEDDING_VARIABLES)
+  var_list = [v for v in var_list
+              if isinstance(v, EmbeddingVariable) and v._is_primary]
+  stats = sess.run([v.get_stats() for v in var_list])
+  lines = []
+  for v, (names, values) in zip(var_list, stats):
+    values = dict(zip([compat.as_str(n) for n in names], values))
+    lines.append("%s %d %d\n" % (v._handle.op.name, values["num_keys"],
+                                 values["lookups"]))
+  with open(path, "w") as f:
+    f.writelines(lines)
+
 
 # Register a conversion function which reads the value of the variable,
 # allowing instances of the class to be used as tensors.
@@ -1036,6 +1473,80 @@ def _GatherGrad(op, grad):
   indices = array_ops.reshape(indices, size)
   return [ops.IndexedSlices(values, indices, params_shape), None, None]
 
+@ops.RegisterGradient("KvResourceSequenceGather")
+def _SequenceGatherGrad(op, grad, *_):
+  """Gradient for sequence gather op, one row per kept id."""
+  handle = op.inputs[0]
+  while handle.op.type != "KvVarHandleOp":
+    handle = handle.op.inputs[0]
+  params_shape = ops.convert_to_tensor(
+      tensor_shape.TensorShape(handle.op.get_attr("shape")))
+  ids, lengths = op.outputs[1], op.outputs[2]
+  max_length = op.get_attr("max_length")
+  combiner = op.get_attr("combiner").decode()
+  mask = array_ops.sequence_mask(lengths, max_length)
+  indices = array_ops.boolean_mask(ids, mask)
+  if combiner == "none":
+    values = array_ops.boolean_mask(grad, mask)
+  else:
+    if combiner == "mean":
+      scale = math_ops.cast(math_ops.maximum(lengths, 1), grad.dtype)
+      grad = grad / array_ops.expand_dims(scale, 1)
+    rows = array_ops.tile(
+        array_ops.expand_dims(math_ops.range(array_ops.size(lengths)), 1),
+        [1, max_length])
+    values = array_ops.gather(grad, array_ops.boolean_mask(rows, mask))
+  return [ops.IndexedSlices(values, indices, params_shape), None, None]
+
+@ops.RegisterGradient("KvResourceSparseCrossGather")
+def _SparseCrossGatherGrad(op, grad, *_):
+  """Gradient for sparse cross gather op, one row per unique cross."""
+  handle = op.inputs[0]
+  while handle.op.type != "KvVarHandleOp":
+    handle = handle.op.inputs[0]
+  params_shape = ops.convert_to_tensor(
+      tensor_shape.TensorShape(handle.op.get_attr("shape")))
+  keys, values = gen_kv_variable_ops.kv_resource_sparse_cross_gather_grad(
+      grad, op.outputs[1], op.outputs[2], combiner=op.get_attr("combiner"))
+  return ([ops.IndexedSlices(values, keys, params_shape)] +
+          [None] * (len(op.inputs) - 1))
+
+@ops.RegisterGradient("KvResourceGroupGather")
+def _GroupGatherGrad(op, *grads):
+  """Gradient for group gather op, the gradients of each table."""
+  num_tables = op.get_attr("num_tables")
+  indices = op.inputs[num_tables]
+  size = array_ops.expand_dims(array_ops.size(indices), 0)
+  indices = array_ops.reshape(indices, size)
+  table_grads = []
+  for i in range(num_tables):
+    if grads[i] is None:
+      table_grads.append(None)
+      continue
+    handle = op.inputs[i]
+    while handle.op.type != "KvVarHandleOp":
+      handle = handle.op.inputs[0]
+    params_shape = ops.convert_to_tensor(
+        tensor_shape.TensorShape(handle.op.get_attr("shape")))
+    values_shape = array_ops.concat([size, params_shape[0:]], 0)
+    values = array_ops.reshape(grads[i], values_shape)
+    table_grads.append(ops.IndexedSlices(values, indices, params_shape))
+  return table_grads + [None]
+
+@ops.RegisterGradient("KvResourceSampleNegatives")
+def _SampleNegativesGrad(op, grad, _):
+  """Gradient for sample negatives op, one row per sampled id."""
+  handle = op.inputs[0]
+  while handle.op.type != "KvVarHandleOp":
+    handle = handle.op.inputs[0]
+  params_shape = ops.convert_to_tensor(
+      tensor_shape.TensorShape(handle.op.get_attr("shape")))
+  indices = array_ops.reshape(op.outputs[1], [-1])
+  values_shape = array_ops.concat(
+      [array_ops.expand_dims(array_ops.size(indices), 0), params_shape], 0)
+  values = array_ops.reshape(grad, values_shape)
+  return [ops.IndexedSlices(values, indices, params_shape), None, None]
+
 @ops.RegisterGradient("KvResourceGatherV1")
 def _GatherV1Grad(op, grad):
   """Gradient for gather op."""
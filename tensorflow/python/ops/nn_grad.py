@@ -24,10 +24,14 @@ from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import ops
 from tensorflow.python.framework import tensor_util
 from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import gen_dot_interaction_ops
 from tensorflow.python.ops import gen_nn_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import nn_ops
+from tensorflow.python.ops import gen_fused_cross_layer_ops
 from tensorflow.python.ops import gen_fused_l2_normalize_ops
+from tensorflow.python.ops import gen_multi_expert_ops
+from tensorflow.python.ops import gen_target_attention_ops
 
 
 @ops.RegisterGradient("Conv2DBackpropInput")
@@ -1181,6 +1185,51 @@ def _FusedL2NormalizeGrad(op, grad):
   return gen_fused_l2_normalize_ops.fused_l2_normalize_grad(
     grad, x, axis=axis, epsilon=epsilon)
 
+@ops.RegisterGradient("TargetAttention")
+def _TargetAttentionGrad(op, grad):
+  """Return the gradients for TargetAttention"""
+
+  scores_grad, values_grad = gen_target_attention_ops.target_attention_grad(
+      grad, op.inputs[0], op.inputs[1], op.inputs[2],
+      padding=op.get_attr("padding"))
+  return [scores_grad, values_grad, None]
+
+@ops.RegisterGradient("FusedCrossLayer")
+def _FusedCrossLayerGrad(op, grad):
+  """Return the gradients for FusedCrossLayer"""
+
+  return gen_fused_cross_layer_ops.fused_cross_layer_grad(
+      grad, op.inputs[0], op.inputs[1], op.inputs[2])
+
+@ops.RegisterGradient("DotInteraction")
+def _DotInteractionGrad(op, grad):
+  """Return the gradients for DotInteraction"""
+
+  return gen_dot_interaction_ops.dot_interaction_grad(
+      grad, op.inputs[0],
+      concat_first_feature=op.get_attr("concat_first_feature"))
+
+@ops.RegisterGradient("MultiExpertDense")
+def _MultiExpertDenseGrad(op, grad):
+  """Return the gradients for MultiExpertDense"""
+
+  return gen_multi_expert_ops.multi_expert_dense_grad(
+      grad, op.inputs[0], op.inputs[1], op.outputs[0],
+      activation=op.get_attr("activation"))
+
+@ops.RegisterGradient("MultiExpertGate")
+def _MultiExpertGateGrad(op, grad, gates_grad):
+  """Return the gradients for MultiExpertGate"""
+
+  gates = op.outputs[1]
+  experts_grad, logits_grad = gen_multi_expert_ops.multi_expert_gate_grad(
+      grad, op.inputs[0], gates)
+  if gates_grad is not None:
+    # The gates are a softmax of the logits.
+    logits_grad += gates * (gates_grad - math_ops.reduce_sum(
+        gates_grad * gates, axis=1, keepdims=True))
+  return [experts_grad, logits_grad]
+
 @ops.RegisterGradient("FusedLayerNorm")
 def _FusedLayerNormalizeGrad(op, grad, *args):
   """Return the gradients for FusedLayerNorm"""
@@ -30,13 +30,17 @@ from tensorflow.python.ops import candidate_sampling_ops
 from tensorflow.python.ops import control_flow_ops
 from tensorflow.python.ops import custom_gradient
 from tensorflow.python.ops import embedding_ops
+from tensorflow.python.ops import gen_dot_interaction_ops
 from tensorflow.python.ops import gen_array_ops  # pylint: disable=unused-import
 from tensorflow.python.ops import gen_nn_ops
 from tensorflow.python.ops import linalg_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import nn_ops
+from tensorflow.python.ops import gen_fused_cross_layer_ops
 from tensorflow.python.ops import gen_fused_l2_normalize_ops
+from tensorflow.python.ops import gen_multi_expert_ops
 from tensorflow.python.ops import gen_sparse_ops
+from tensorflow.python.ops import gen_target_attention_ops
 from tensorflow.python.ops import init_ops
 from tensorflow.python.ops import variables
 from tensorflow.python.ops import variable_scope
@@ -676,6 +680,148 @@ def fused_l2_normalize(x, epsilon=1e-12, name=None):
     return gen_fused_l2_normalize_ops.fused_l2_normalize(x, 
               epsilon=epsilon, name=name)
 
+def target_attention(scores, values, lengths=None, mask=None,
+                     padding=-2**32 + 1, name=None):
+  """Fused masked softmax of attention scores and weighted sum of values.
+
+  Computes
+
+      output = matmul(softmax(where(mask, scores, padding)), values)
+
+  in one op, as the target attention of DIN, DIEN and BST does. Padded
+  positions of short sequences don't touch their value rows.
+
+  Args:
+    scores: A float32 `Tensor` of shape `[batch, queries, length]`.
+    values: A float32 `Tensor` of shape `[batch, length, dim]`.
+    lengths: An optional int `Tensor` of shape `[mask_batch]` with the valid
+      length of every sequence. Used to build `mask` when it isn't given.
+    mask: An optional bool `Tensor` of shape `[mask_batch, length]`.
+      `mask_batch` must divide `batch`, row `n` of `scores` uses row
+      `n % mask_batch` of `mask`, so heads stacked on the batch dimension
+      share the mask of their sequence.
+    padding: The score of masked positions.
+    name: A name for this operation (optional).
+
+  Returns:
+    A `Tensor` of shape `[batch, queries, dim]`.
+  """
+  with ops.name_scope(name, "target_attention",
+                      [scores, values, lengths, mask]) as name:
+    scores = ops.convert_to_tensor(scores, name="scores")
+    values = ops.convert_to_tensor(values, name="values")
+    if mask is None:
+      if lengths is None:
+        raise ValueError("Either lengths or mask must be given.")
+      mask = array_ops.sequence_mask(lengths, array_ops.shape(scores)[2])
+    return gen_target_attention_ops.target_attention(
+        scores, values, mask, padding=padding, name=name)
+
+def fused_cross_layer(x0, xl, w, b, name=None):
+  """Fused cross layer of DCN.
+
+  Computes
+
+      output = x0 * reduce_sum(xl * w, axis=1, keepdims=True) + b + xl
+
+  in one op, without the temporaries of the batch that the unfused graph
+  writes at every step.
+
+  Args:
+    x0: A float32 `Tensor` of shape `[batch, dim]`, the input of the cross
+      network.
+    xl: A float32 `Tensor` of shape `[batch, dim]`, the output of the
+      previous cross layer.
+    w: A float32 `Tensor` of shape `[dim]`.
+    b: A float32 `Tensor` of shape `[dim]`.
+    name: A name for this operation (optional).
+
+  Returns:
+    A `Tensor` of shape `[batch, dim]`.
+  """
+  with ops.name_scope(name, "fused_cross_layer", [x0, xl, w, b]) as name:
+    x0 = ops.convert_to_tensor(x0, name="x0")
+    xl = ops.convert_to_tensor(xl, name="xl")
+    return gen_fused_cross_layer_ops.fused_cross_layer(
+        x0, xl, w, b, name=name)
+
+def dot_interaction(features, concat_first_feature=True, name=None):
+  """Pairwise dot interaction of DLRM.
+
+  For every row, computes the dots of all pairs of distinct features, the
+  strictly lower triangle of `matmul(features, features, transpose_b=True)`
+  packed by rows, without the batch matmul of all pairs and the masking
+  of the unfused graph.
+
+  Args:
+    features: A float32 `Tensor` of shape `[batch, num, dim]`.
+    concat_first_feature: Whether to put `features[:, 0, :]`, the dense
+      features of DLRM, before the dots.
+    name: A name for this operation (optional).
+
+  Returns:
+    A `Tensor` of shape `[batch, num * (num - 1) / 2]`, or of shape
+    `[batch, dim + num * (num - 1) / 2]` if `concat_first_feature`.
+  """
+  with ops.name_scope(name, "dot_interaction", [features]) as name:
+    features = ops.convert_to_tensor(features, name="features")
+    return gen_dot_interaction_ops.dot_interaction(
+        features, concat_first_feature=concat_first_feature, name=name)
+
+def multi_expert_dense(x, w, b, activation="relu", name=None):
+  """Dense layers of the experts of MMoE and PLE as one grouped matmul.
+
+  Computes
+
+      output[:, e, :] = activation(matmul(x_e, w[e]) + b[e])
+
+  for all the experts in one op, where `x_e` is `x` if the experts share
+  their input, or `x[:, e, :]`. The output is the experts stacked on axis 1,
+  so that the layers of the experts chain without reshapes, and the last
+  one feeds `multi_expert_gate`.
+
+  Args:
+    x: A float32 `Tensor` of shape `[batch, in]` shared by the experts, or of
+      shape `[batch, experts, in]`.
+    w: A float32 `Tensor` of shape `[experts, in, out]`.
+    b: A float32 `Tensor` of shape `[experts, out]`.
+    activation: `"relu"` or `"none"`.
+    name: A name for this operation (optional).
+
+  Returns:
+    A `Tensor` of shape `[batch, experts, out]`.
+  """
+  with ops.name_scope(name, "multi_expert_dense", [x, w, b]) as name:
+    x = ops.convert_to_tensor(x, name="x")
+    return gen_multi_expert_ops.multi_expert_dense(
+        x, w, b, activation=activation, name=name)
+
+def multi_expert_gate(experts, gate_logits, name=None):
+  """Gate of a task of MMoE and PLE over the stacked experts.
+
+  Computes
+
+      output = reduce_sum(experts * expand_dims(softmax(gate_logits), -1),
+                          axis=1)
+
+  in one op, without the temporary of the weighted experts that the
+  unfused graph writes.
+
+  Args:
+    experts: A float32 `Tensor` of shape `[batch, experts, dim]`.
+    gate_logits: A float32 `Tensor` of shape `[batch, experts]`.
+    name: A name for this operation (optional).
+
+  Returns:
+    A `Tensor` of shape `[batch, dim]`.
+  """
+  with ops.name_scope(name, "multi_expert_gate",
+                      [experts, gate_logits]) as name:
+    experts = ops.convert_to_tensor(experts, name="experts")
+    output, _ = gen_multi_expert_ops.multi_expert_gate(
+        experts, gate_logits, name=name)
+    return output
+
 @tf_export("nn.fused_layer_normalize")
 def fused_layer_normalize(
       x,
@@ -23,6 +23,7 @@ import collections
 from tensorflow.core.protobuf import config_pb2
 from tensorflow.python import pywrap_tensorflow as prefetch_runner
 from tensorflow.python.client.session import _REGISTERED_EXPANSIONS
+from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import errors
 from tensorflow.python.framework import ops
 from tensorflow.python.framework import sparse_tensor
@@ -30,12 +31,18 @@ from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import control_flow_ops
 from tensorflow.python.ops import gen_tensor_buffer_ops
 from tensorflow.python.ops.prefetch_runner_hook import PrefetchRunnerHook
+from tensorflow.python.ops.ragged import ragged_tensor
 from tensorflow.python.util import nest
 from tensorflow.python.util.tf_export import tf_export
 
 ops.NotDifferentiable('TensorBufferPut')
 ops.NotDifferentiable('TensorBufferTake')
 ops.NotDifferentiable('TensorBufferCancel')
+ops.NotDifferentiable('TensorPackPinned')
+ops.NotDifferentiable('TensorUnpackToDevice')
+
+# The dtypes of the components which can't be packed to prefetch_to_device.
+_UNPACKABLE_DTYPES = (dtypes.string, dtypes.resource, dtypes.variant)
 
 PREFETCH = "prefetch"
 
@@ -101,6 +108,8 @@ def staged(
     use_stage_subgraph_thread_pool=False,
     stage_subgraph_thread_pool_id = 0,
     stage_subgraph_stream_id = 0,
+    use_pinned_memory=False,
+    prefetch_to_device=None,
     name=None):
   """Prefetch samples.
 
@@ -131,6 +140,15 @@ def staged(
       thread pool to use when enable use_stage_subgraph_thread_pool. 0 by default.
     stage_subgraph_stream_id: (Optional.) Specifies which stream to use for the
       Stage subgraph. The default value is 0.
+    use_pinned_memory: (Optional.) Copy the prefetched host tensors to GPU
+      compatible pinned memory in the prefetching threads, so that they are
+      copied to GPU faster. False by default.
+    prefetch_to_device: (Optional.) The device, such as a GPU, to copy the
+      `SparseTensor`s and `RaggedTensor`s of the sample to. The prefetching
+      threads pack their components and dense shapes into one buffer of
+      pinned memory per sample, which is copied to the device by one
+      asynchronous copy when the sample is taken. The dense shapes stay in
+      host memory, where the lookups read them. None by default.
     name: (Optional.) Name of prefetching operations.
 
   Returns:
@@ -146,11 +164,43 @@ def staged(
   tensor_or_sparse_tensor_or_nones = nest.flatten(features)
 
   tensor_or_nones = []
+  # The components copied to prefetch_to_device, and the ones kept on host.
+  device_indices = []
+  host_indices = []
   for t in tensor_or_sparse_tensor_or_nones:
     if hasattr(t, 'dense_shape'):
+      device_indices.extend([len(tensor_or_nones), len(tensor_or_nones) + 1])
+      host_indices.append(len(tensor_or_nones) + 2)
       tensor_or_nones.extend([t.values, t.indices, t.dense_shape])
+    elif isinstance(t, ragged_tensor.RaggedTensor):
+      device_indices.extend(
+          range(len(tensor_or_nones),
+                len(tensor_or_nones) + t.ragged_rank + 1))
+      tensor_or_nones.append(t.flat_values)
+      tensor_or_nones.extend(t.nested_row_splits)
     else:
       tensor_or_nones.append(t)
+  if prefetch_to_device:
+    # Strings, etc. can't be packed, they are prefetched as they are.
+    device_indices = [i for i in device_indices
+                      if tensor_or_nones[i].dtype not in _UNPACKABLE_DTYPES]
+  else:
+    device_indices = []
+  if not device_indices:
+    host_indices = []
+  packed_indices = device_indices + host_indices
+  packed_dtypes = [tensor_or_nones[i].dtype for i in packed_indices]
+  packed_shapes = [tensor_or_nones[i].shape for i in packed_indices]
+  if packed_indices:
+    with ops.name_scope(name):
+      with ops.device(tensor_or_nones[packed_indices[0]].device):
+        with ops.device('/device:CPU:0'):
+          packed = gen_tensor_buffer_ops.tensor_pack_pinned(
+              [tensor_or_nones[i] for i in device_indices],
+              [tensor_or_nones[i] for i in host_indices])
+    for i in packed_indices:
+      tensor_or_nones[i] = None
+    tensor_or_nones.append(packed)
 
   tensor_indices = []
   tensors = []
@@ -173,12 +223,14 @@ def staged(
           fetch_tensors = gen_tensor_buffer_ops.tensor_buffer_put(
             tensors,
             timeout_millis=timeout_millis,
+            use_pinned_memory=use_pinned_memory,
             shared_name=name,
             shared_capacity=capacity)
       else:
         fetch_tensors = gen_tensor_buffer_ops.tensor_buffer_put(
           tensors,
           timeout_millis=timeout_millis,
+          use_pinned_memory=use_pinned_memory,
           shared_name=name,
           shared_capacity=capacity)
 
@@ -205,6 +257,17 @@ def staged(
     next_tensor_or_nones = [None] * len(tensor_or_nones)
     for i, v in enumerate(next_tensors):
       next_tensor_or_nones[tensor_indices[i]] = v
+    if packed_indices:
+      packed = next_tensor_or_nones.pop()
+      with ops.device(prefetch_to_device):
+        unpacked = gen_tensor_buffer_ops.tensor_unpack_to_device(
+            packed,
+            Tdevice=packed_dtypes[:len(device_indices)],
+            Thost=packed_dtypes[len(device_indices):])
+      unpacked = list(unpacked.device_tensors) + list(unpacked.host_tensors)
+      for i, v, shape in zip(packed_indices, unpacked, packed_shapes):
+        v.set_shape(shape)
+        next_tensor_or_nones[i] = v
     next_tensor_or_nones = collections.deque(next_tensor_or_nones)
     next_tensor_or_sparse_tensor_or_nones = []
     for t in tensor_or_sparse_tensor_or_nones:
@@ -217,6 +280,13 @@ def staged(
                 values=sparse_values,
                 indices=sparse_indices,
                 dense_shape=sparse_dense_shape))
+      elif isinstance(t, ragged_tensor.RaggedTensor):
+        ragged_flat_values = next_tensor_or_nones.popleft()
+        ragged_row_splits = [
+            next_tensor_or_nones.popleft() for _ in range(t.ragged_rank)]
+        next_tensor_or_sparse_tensor_or_nones.append(
+            ragged_tensor.RaggedTensor.from_nested_row_splits(
+                ragged_flat_values, ragged_row_splits, validate=False))
       else:
         next_tensor_or_sparse_tensor_or_nones.append(
             next_tensor_or_nones.popleft())
@@ -332,6 +402,7 @@ def prefetch_join(
         fetch_tensors = gen_tensor_buffer_ops.tensor_buffer_put(
             tensors,
             timeout_millis=timeout_millis,
+            use_pinned_memory=use_pinned_memory,
             shared_name=name,
             shared_capacity=capacity)
     thread_to_fetch_tensors.append(fetch_tensors)
@@ -26,6 +26,7 @@ from tensorflow.python.framework import ops
 from tensorflow.python.framework import sparse_tensor
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import parsing_ops
+from tensorflow.python.ops.ragged import ragged_factory_ops
 from tensorflow.python.platform import test
 from tensorflow.python.training import coordinator
 from tensorflow.python.training import monitored_session
@@ -54,6 +55,25 @@ class PrefetchTest(test.TestCase):
         self.assertAllClose(value, sess.run(y), rtol=1e-6)
       coord.request_stop()
 
+  def test_pinned_memory(self):
+    capacity = 2
+    value = [1.0, 2.0, 3.0]
+    with ops.Graph().as_default() as graph:
+      with ops.device('/cpu:0'):
+        x = array_ops.constant(value, dtype=dtypes.float32, shape=[3])
+        y = prefetch.staged(
+            x, capacity=capacity, num_threads=4, timeout_millis=1000,
+            use_pinned_memory=True)
+
+    graph.finalize()
+
+    with self.test_session(graph=graph) as sess:
+      coord = coordinator.Coordinator()
+      prefetch.make_prefetch_hook().after_create_session(sess, coord)
+      for _ in xrange(capacity * 3):
+        self.assertAllClose(value, sess.run(y), rtol=1e-6)
+      coord.request_stop()
+
   def test_string(self):
     capacity = 3
     value = "'The quick brown fox jumps over the lazy dog!'"
@@ -136,6 +156,46 @@ class PrefetchTest(test.TestCase):
         self.assertAllClose(x2_data, prefetched[1], rtol=1e-6)
       coord.request_stop()
 
+  def test_prefetch_to_device(self):
+    with ops.Graph().as_default() as graph:
+      with ops.device('/cpu:0'):
+        values = array_ops.constant([1, 2, 3], dtype=dtypes.int64)
+        indices = array_ops.constant(
+            ([0, 0], [0, 1], [2, 0]), dtype=dtypes.int64)
+        dense_shape = array_ops.constant([3, 3], dtype=dtypes.int64)
+        x1 = sparse_tensor.SparseTensor(values=values,
+                                        indices=indices,
+                                        dense_shape=dense_shape)
+        x2 = ragged_factory_ops.constant([[1.0, 2.0], [], [3.0]])
+        x3 = sparse_tensor.SparseTensor(
+            values=array_ops.constant(['a'], dtype=dtypes.string),
+            indices=array_ops.constant([[0, 0]], dtype=dtypes.int64),
+            dense_shape=dense_shape)
+        x4 = array_ops.constant(42.0, dtype=dtypes.float32, shape=[])
+        y = prefetch.staged(
+            [x1, x2, x3, x4], timeout_millis=1000,
+            prefetch_to_device=test.gpu_device_name() or '/cpu:0')
+
+    op_types = [op.type for op in graph.get_operations()]
+    self.assertEqual(op_types.count('TensorPackPinned'), 1)
+    self.assertEqual(op_types.count('TensorUnpackToDevice'), 1)
+    graph.finalize()
+
+    with self.test_session(use_gpu=True, graph=graph) as sess:
+      coord = coordinator.Coordinator()
+      prefetch.make_prefetch_hook().after_create_session(sess, coord)
+      for _ in xrange(3):
+        prefetched = sess.run(y)
+        self.assertAllEqual([1, 2, 3], prefetched[0].values)
+        self.assertAllEqual([[0, 0], [0, 1], [2, 0]], prefetched[0].indices)
+        self.assertAllEqual([3, 3], prefetched[0].dense_shape)
+        self.assertAllEqual([[1.0, 2.0], [], [3.0]],
+                            prefetched[1].to_list())
+        self.assertAllEqual([b'a'], prefetched[2].values)
+        self.assertAllEqual([3, 3], prefetched[2].dense_shape)
+        self.assertAllClose(42.0, prefetched[3], rtol=1e-6)
+      coord.request_stop()
+
   def test_dict(self):
     with ops.Graph().as_default() as graph:
       with ops.device('/cpu:0'):
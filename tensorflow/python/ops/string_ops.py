@@ -436,6 +436,25 @@ def string_split_and_pad(source, max_length, delimiter=" ",
 
 ops.NotDifferentiable("StringSplitAndPad")
 
+@tf_export("string_split_and_pad_to_hash_bucket_fast")
+def string_split_and_pad_to_hash_bucket_fast(source, max_length, num_buckets,
+                                             delimiter=" ",
+                                             default_value="</s>"):
+  """Same as `string_to_hash_bucket_fast(string_split_and_pad(...))`.
+
+  The tokens are hashed without being copied into intermediate strings.
+  """
+  source = ops.convert_to_tensor(source, dtype=dtypes.string)
+  delimiter = ops.convert_to_tensor(delimiter, dtype=dtypes.string)
+  max_length = ops.convert_to_tensor(max_length, dtype=dtypes.int64)
+  default_value = ops.convert_to_tensor(default_value, dtype=dtypes.string)
+
+  return gen_string_ops.string_split_and_pad_to_hash_bucket_fast(
+      source, delimiter=delimiter, max_length=max_length,
+      default_value=default_value, num_buckets=num_buckets)
+
+ops.NotDifferentiable("StringSplitAndPadToHashBucketFast")
+
 @tf_export("decode_dense")
 def decode_dense(values, dtype=dtypes.float32, name=None):
   return gen_string_ops.dense_decode(values, 0, dtype, name=name)
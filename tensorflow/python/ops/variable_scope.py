@@ -2206,7 +2206,8 @@ def get_embedding_variable(name,
         storage_cache_strategy = ev_option.storage_option.cache_strategy,
         layout = ev_option.storage_option.layout,
         default_value_dim=ev_option.init.default_value_dim,
-        default_value_no_permission=ev_option.init.default_value_no_permission),
+        default_value_no_permission=ev_option.init.default_value_no_permission,
+        hot_key_option=ev_option.hot_key_option),
         ht_partition_num=ev_option.ht_partition_num)
 
 
@@ -2272,7 +2273,8 @@ def get_embedding_variable_internal(name,
         storage_cache_strategy = ev_option.storage_option.cache_strategy,
         layout = ev_option.storage_option.layout,
         default_value_dim=ev_option.init.default_value_dim,
-        default_value_no_permission=ev_option.init.default_value_no_permission),
+        default_value_no_permission=ev_option.init.default_value_no_permission,
+        hot_key_option=ev_option.hot_key_option),
       ht_partition_num=ev_option.ht_partition_num)
 
 
@@ -2313,6 +2315,81 @@ def get_embedding_variable_v2_internal(name,
       ht_partition_num=ht_partition_num)
 
 
+def get_embedding_variable_group(name,
+                                 embedding_dims,
+                                 key_dtype=dtypes.int64,
+                                 value_dtype=None,
+                                 initializer=None,
+                                 trainable=True,
+                                 collections=None,
+                                 ev_option=variables.EmbeddingVariableOption()):
+  """Creates the tables of an EmbeddingVariable group, which share one key
+  index.
+
+  Features of the same id space, e.g. the wide, deep and attention tables of
+  item ids, are kept in one storage: the entry of a key holds the rows of
+  all the tables, the way it holds the slots of the optimizers. Looking them
+  up with `kv_variable_ops.lookup_group` probes the index once for all the
+  tables.
+
+  The tables are named `name/block<i>`, the first one is the primary of the
+  others. They are not partitioned, and can not use the contiguous layouts,
+  whose rows all have one size.
+
+  Args:
+    name: The name of the group.
+    embedding_dims: The embedding dim of each table.
+    key_dtype: The dtype of the keys.
+    value_dtype: The dtype of the rows.
+    initializer: The initializer of the rows.
+    trainable: Whether the tables are trainable.
+    collections: The collections of the tables.
+    ev_option: The `EmbeddingVariableOption` of the tables.
+
+  Returns:
+    The list of the tables, `EmbeddingVariable`s.
+  """
+  if len(embedding_dims) < 1:
+    raise ValueError("An EmbeddingVariable group needs at least one table.")
+  if ev_option.storage_option.layout in ("normal_contiguous",
+                                         "normal_contiguous_gpu", "compact"):
+    raise ValueError("The layout %s is not supported by the tables of an "
+                     "EmbeddingVariable group." %
+                     ev_option.storage_option.layout)
+  if initializer is None:
+    initializer = ev_option.init.initializer
+  l2_weight_threshold = -1.0
+  steps_to_live = None
+  if isinstance(ev_option.evict, variables.GlobalStepEvict):
+    steps_to_live = ev_option.evict.steps_to_live
+  elif isinstance(ev_option.evict, variables.L2WeightEvict):
+    l2_weight_threshold = ev_option.evict.l2_weight_threshold
+  tables = []
+  for i, embedding_dim in enumerate(embedding_dims):
+    tables.append(get_embedding_variable_v2_internal(
+        "%s/block%d" % (name, i), embedding_dim, key_dtype=key_dtype,
+        value_dtype=value_dtype, initializer=initializer,
+        trainable=trainable, collections=collections,
+        evconfig=variables.EmbeddingVariableConfig(
+            steps_to_live=steps_to_live,
+            ht_type=ev_option.ht_type,
+            l2_weight_threshold=l2_weight_threshold,
+            filter_strategy=ev_option.filter_strategy,
+            emb_index=i,
+            block_num=len(embedding_dims),
+            primary=tables[0] if tables else None,
+            storage_type=ev_option.storage_option.storage_type,
+            storage_path=ev_option.storage_option.storage_path,
+            storage_size=ev_option.storage_option.storage_size,
+            storage_cache_strategy=ev_option.storage_option.cache_strategy,
+            layout=ev_option.storage_option.layout,
+            default_value_dim=ev_option.init.default_value_dim,
+            default_value_no_permission=(
+                ev_option.init.default_value_no_permission)),
+        ht_partition_num=ev_option.ht_partition_num))
+  return tables
+
+
 @tf_export(v1=["get_multihash_variable"])
 def get_multihash_variable(name,
                            dims,
@@ -257,6 +257,26 @@ class StorageOption(object):
                                                        config_pb2.StorageType.DRAM_LEVELDB]:
         raise ValueError("storage_path musnt'be None when storage_type is set")
 
+@tf_export(v1=["HotKeyReplicaOption"])
+class HotKeyReplicaOption(object):
+  """Replicates the hottest rows of an EmbeddingVariable to the workers.
+
+  Every `max_staleness_steps` steps a worker reads all the ids of its batch
+  from the PS, and keeps the rows of at most `max_rows` of them whose
+  frequencies on the PS are at least `min_freq`. The rows are served from
+  the worker until the next refresh, and their gradients are summed on the
+  worker and pushed to the PS once per `max_staleness_steps` steps.
+  """
+  def __init__(self,
+               max_rows = 1000,
+               min_freq = 0,
+               max_staleness_steps = 10):
+    self.max_rows = max_rows
+    self.min_freq = min_freq
+    self.max_staleness_steps = max_staleness_steps
+    if max_staleness_steps <= 0:
+      raise ValueError("max_staleness_steps must be positive.")
+
 @tf_export(v1=["EmbeddingVariableOption"])
 class EmbeddingVariableOption(object):
   def __init__(self,
@@ -266,7 +286,8 @@ class EmbeddingVariableOption(object):
                ckpt = None,
                filter_option = None,
                storage_option = StorageOption(),
-               init_option = InitializerOption()):
+               init_option = InitializerOption(),
+               hot_key_option = None):
     self.ht_type = ht_type
     self.ht_partition_num = ht_partition_num
     self.evict = evict_option
@@ -274,6 +295,7 @@ class EmbeddingVariableOption(object):
     self.filter_strategy = filter_option
     self.storage_option = storage_option
     self.init = init_option
+    self.hot_key_option = hot_key_option
     
 @tf_export(v1=["CounterFilter"])
 class CounterFilter(object):
@@ -324,7 +346,8 @@ class EmbeddingVariableConfig(object):
                storage_cache_strategy=config_pb2.CacheStrategy.LFU,
                layout=None,
                default_value_dim=4096,
-               default_value_no_permission=.0):
+               default_value_no_permission=.0,
+               hot_key_option=None):
     self.steps_to_live = steps_to_live
     self.steps_to_live_l2reg = steps_to_live_l2reg
     self.l2reg_theta = l2reg_theta
@@ -349,6 +372,7 @@ class EmbeddingVariableConfig(object):
     self.layout = layout
     self.default_value_dim = default_value_dim
     self.default_value_no_permission = default_value_no_permission
+    self.hot_key_option = hot_key_option
 
   def reveal(self):
     if self.steps_to_live is None:
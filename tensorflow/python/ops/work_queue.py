@@ -20,11 +20,15 @@ from __future__ import print_function
 
 import os
 import re
+import signal
+import threading
+import uuid
 from six import string_types
 from six.moves import xrange
 
 from tensorflow.python.eager import context
 from tensorflow.python.framework import constant_op
+from tensorflow.python.framework import device as pydev
 from tensorflow.python.data.ops import dataset_ops
 from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import ops
@@ -54,9 +58,11 @@ ops.NotDifferentiable('WorkQueueRestore')
 ops.NotDifferentiable('WorkQueueIsInitialized')
 ops.NotDifferentiable('WorkQueuePut')
 ops.NotDifferentiable('WorkQueueTake')
+ops.NotDifferentiable('WorkQueueRelease')
 ops.NotDifferentiable('WorkQueueSize')
 ops.NotDifferentiable('WorkQueueClose')
 ops.NotDifferentiable('SaveLocalWork')
+ops.NotDifferentiable('SaveLocalWorkOffset')
 
 
 class Work(object): # pylint: disable=useless-object-inheritance
@@ -154,7 +160,11 @@ class WorkQueue(saver.BaseSaverBuilder.SaveableObject):
       num_slices=None,
       num_clients=1,
       name=None,
-      local_work_mgr=None):
+      local_work_mgr=None,
+      num_shards=1,
+      num_prefetches=1,
+      file_slice_size=None,
+      elastic=False):
     """Constructs a work queue.
 
     Args:
@@ -169,6 +179,22 @@ class WorkQueue(saver.BaseSaverBuilder.SaveableObject):
       num_slices: (Optional.) Total number of slices on all workers.
       num_clients: (Optional.) Number of threads for taking works.
       name: (Optional.) Name of the work queue.
+      local_work_mgr: (Optional.) A `LocalWorkMgr` for inference job.
+      num_shards: (Optional.) Number of shards of the work queue. Workers
+        take works from the shard of their task index first, and from the
+        other shards when it is empty. 1 by default, which takes works in
+        order.
+      num_prefetches: (Optional.) Number of works taken ahead of time by
+        `input_producer` and `input_dataset`. 1 by default.
+      file_slice_size: (Optional.) Size in bytes of the slices uncompressed
+        TFRecord works are cut into. A slice `<work>#<begin>:<end>` holds
+        the records of the work whose header starts in the byte range
+        `[begin, end)`, which `TFRecordDataset` reads without scanning the
+        records before it, so that workers read one file in parallel.
+      elastic: (Optional.) Boolean. If true, the works a worker took and may
+        not have finished, the last `num_prefetches + 1`, are leased to it,
+        and `release` or the hook of `release_hook` put them back when the
+        worker leaves, so that workers can leave and join a running job.
 
     Raises:
       ValueError: If one of the arguments is invalid.
@@ -201,6 +227,20 @@ class WorkQueue(saver.BaseSaverBuilder.SaveableObject):
 
     if num_epochs <= 0:
       raise ValueError("num_epochs must be > 0 not {}.".format(num_epochs))
+    if num_shards <= 0:
+      raise ValueError("num_shards must be > 0 not {}.".format(num_shards))
+    if num_prefetches <= 0:
+      raise ValueError(
+          "num_prefetches must be > 0 not {}.".format(num_prefetches))
+    if num_slices is not None and file_slice_size is not None:
+      raise ValueError(
+          "num_slices and file_slice_size must not be both specified.")
+    if file_slice_size is not None and file_slice_size <= 0:
+      raise ValueError(
+          "file_slice_size must be > 0 not {}.".format(file_slice_size))
+    self._num_shards = num_shards
+    self._num_prefetches = num_prefetches
+    self._num_leases = num_prefetches + 1 if elastic else 0
 
     with ops.name_scope(name):
       self._remote_device = vs.variable(
@@ -210,6 +250,10 @@ class WorkQueue(saver.BaseSaverBuilder.SaveableObject):
           validate_shape=False,
           collections=[ops.GraphKeys.LOCAL_VARIABLES]).device
       self._local_device = control_flow_ops.no_op().device
+      local_task = pydev.DeviceSpec.from_string(self._local_device or '').task
+      self._client_index = -1 if local_task is None else local_task
+      self._client_id = '{}#{}'.format(
+          self._local_device or '', uuid.uuid4().hex) if elastic else ''
       with ops.device(self._remote_device):
         self._handle = gen_work_queue_ops.work_queue_handle_op(shared_name=name)
         self._digest_op = ops.convert_to_tensor(
@@ -246,11 +290,21 @@ class WorkQueue(saver.BaseSaverBuilder.SaveableObject):
               if end > num_records:
                 end = num_records
               slices.append(work_item.get_slice(start, end))
+        elif file_slice_size is not None:
+          for work in self._works:
+            file_size = gfile.Stat(
+                (self._prefix or '') + work.decode()).length
+            logging.info(
+                "[%s] Add work %s with slices of %s bytes.",
+                name, work, file_slice_size)
+            for begin in xrange(0, max(file_size, 1), file_slice_size):
+              end = min(begin + file_slice_size, file_size)
+              slices.append(work + b'#%d:%d' % (begin, end))
         self._capacity = len(slices) if slices else len(self._works)
         works_tensor = ops.convert_to_tensor(
             slices or self._works, dtype=dtypes.string)
         self._create = gen_work_queue_ops.work_queue_create(
-            self._handle, shared_name=name)
+            self._handle, shared_name=name, num_shards=num_shards)
         for epoch_index in xrange(num_epochs):
           with ops.control_dependencies([self._create]):
             with ops.name_scope('epochs/{}'.format(epoch_index)):
@@ -294,6 +348,11 @@ class WorkQueue(saver.BaseSaverBuilder.SaveableObject):
     """Number of clients of the work queue."""
     return self._num_clients
 
+  @property
+  def num_shards(self):
+    """Number of shards of the work queue."""
+    return self._num_shards
+
   @property
   def digest(self):
     """The digest of works."""
@@ -365,7 +424,10 @@ class WorkQueue(saver.BaseSaverBuilder.SaveableObject):
         with ops.device(self._remote_device):
           taken = gen_work_queue_ops.work_queue_take(
               self._handle,
-              num_clients=self.num_clients)
+              num_clients=self.num_clients,
+              client_index=self._client_index,
+              client_id=self._client_id,
+              num_leases=self._num_leases)
 
           work_bak = control_flow_ops.no_op()
           if self._local_work_mgr:
@@ -398,6 +460,59 @@ class WorkQueue(saver.BaseSaverBuilder.SaveableObject):
       return local_work
     return string_ops.string_join([self._prefix, local_work])
 
+  def release(self):
+    """Puts the works leased to this worker back to the work queue.
+
+    Returns:
+      The number of works put back, 0 unless the queue is elastic.
+    """
+    with ops.name_scope(self.name):
+      with ops.device(self._remote_device):
+        return gen_work_queue_ops.work_queue_release(
+            self._handle,
+            client_index=self._client_index,
+            client_id=self._client_id)
+
+  def release_hook(self):
+    """Gets a Hook that releases the works of a worker leaving the job.
+
+    The hook stops the training loop on SIGTERM, e.g. sent when a spot
+    instance is reclaimed, and puts the works leased to the worker back to
+    the work queue when the session ends, for the other workers.
+    """
+    work_queue = self
+
+    class WorkQueueReleaseHook(training.SessionRunHook):
+      """Hook that releases the works of the work queue on exit."""
+      def __init__(self):
+        super(WorkQueueReleaseHook, self).__init__()
+        self._terminated = False
+        self._previous_handler = None
+
+      def begin(self):
+        self._release = work_queue.release()
+        if threading.current_thread().name == "MainThread":
+          self._previous_handler = signal.signal(
+              signal.SIGTERM, self._on_sigterm)
+
+      def _on_sigterm(self, signum, frame):
+        del signum, frame
+        logging.info("SIGTERM received, stop taking works.")
+        self._terminated = True
+
+      def after_run(self, run_context, run_values):
+        if self._terminated:
+          run_context.request_stop()
+
+      def end(self, session):
+        num_releases = session.run(self._release)
+        logging.info(
+            "Release {} works of {}.".format(num_releases, work_queue.name))
+        if self._previous_handler is not None:
+          signal.signal(signal.SIGTERM, self._previous_handler)
+
+    return WorkQueueReleaseHook()
+
   def input_producer(self):
     """Returns a FIFOQueue as input producer.
 
@@ -409,7 +524,7 @@ class WorkQueue(saver.BaseSaverBuilder.SaveableObject):
     with ops.name_scope(self.name):
       with ops.device(self._local_device):
         proxy = data_flow_ops.FIFOQueue(
-            capacity=1,
+            capacity=self._num_prefetches,
             dtypes=[dtypes.string],
             shapes=[tensor_shape.TensorShape([1])],
             name='proxy')
@@ -492,7 +607,11 @@ class LocalWorkMgr(object):
     return self._restore_works_dir
 
   def _get_local_works(self):
-    """Get the local works that needs to be restored."""
+    """Get the local works that needs to be restored.
+
+    The works with an offset saved by `save_offset` resume after the records
+    already processed, and the works fully processed are skipped.
+    """
     self._restore_works = []
     restore_work_file_dir = os.path.join(
         self._restore_works_dir,
@@ -500,13 +619,29 @@ class LocalWorkMgr(object):
     if gfile.IsDirectory(restore_work_file_dir):
       restore_work_files = gfile.ListDirectory(restore_work_file_dir)
       for work_file in restore_work_files:
+        if work_file.endswith('.offset') or work_file.endswith('.tmp'):
+          continue
         work_file_path = os.path.join(restore_work_file_dir, work_file)
+        offset = 0
+        if gfile.Exists(work_file_path + '.offset'):
+          with gfile.GFile(work_file_path + '.offset', 'r') as rfile:
+            offset = int(rfile.read().strip() or 0)
         with gfile.GFile(work_file_path, 'r') as rfile:
           for line in rfile.readlines():
             line = line.strip()
-            if not re.match(r'(.)*(?:\?start=\d+&end=\d+)$', line):
+            match = re.match(r'(.*\?start=)(\d+)(&end=)(\d+)$', line)
+            if not match:
               logging.error('Invalid format: {}'.format(line))
               continue
+            start = int(match.group(2)) + offset
+            end = int(match.group(4))
+            if start >= end:
+              logging.info('Skip processed work:{}'.format(line))
+              continue
+            if offset > 0:
+              line = '{}{}{}{}'.format(
+                  match.group(1), start, match.group(3), end)
+              logging.info('Resume work at offset {}:{}'.format(offset, line))
             self._restore_works.append(line)
     self._restore_works.sort(
         key=lambda elm: int(re.findall(r'start=(.*)&', elm)[0]))
@@ -537,6 +672,30 @@ class LocalWorkMgr(object):
               trainable=False, validate_shape=False,
               collections=[ops.GraphKeys.LOCAL_VARIABLES])
 
+  def save_offset(self, work, offset):
+    """Saves the number of records of a work already processed.
+
+    After failover the work is restored from the record after them, so that
+    the records are not processed twice.
+
+    Args:
+      work: A scalar string tensor, the work taken from the `WorkQueue`.
+      offset: A scalar int64 tensor, the number of records of `work` already
+        processed.
+
+    Returns:
+      An op saving the offset to `restore_works_dir`.
+    """
+    with ops.name_scope(self._name):
+      with ops.device(self._local_device):
+        with ops.device('/cpu:0'):
+          return gen_work_queue_ops.save_local_work_offset(
+              work,
+              math_ops.cast(offset, dtypes.int64),
+              job_name=self._job_name,
+              task_index=self._task_index,
+              restore_works_dir=self._restore_works_dir)
+
   def take(self):
     """Take work from the local workqueue."""
     with ops.name_scope(self._name):
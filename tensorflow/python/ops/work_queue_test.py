@@ -29,6 +29,7 @@ from tensorflow.python.framework import errors_impl
 from tensorflow.python.framework import ops
 from tensorflow.python.framework import test_util
 from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import gen_work_queue_ops
 from tensorflow.python.ops import resources
 from tensorflow.python.ops import variables
 from tensorflow.python.ops import variable_scope as vs
@@ -109,6 +110,34 @@ class WorkQueueTest(test_lib.TestCase):
       for thread in threads:
         thread.join()
 
+  def test_shards(self):
+    with self.test_session():
+      works = [b"to", b"be", b"or", b"not", b"to", b"be"]
+      num_epochs = 2
+      work_queue = WorkQueue(
+          works, num_epochs=num_epochs, shuffle=False,
+          num_shards=4, num_prefetches=3)
+
+      local_queue = work_queue.input_producer()
+      dequeue = local_queue.dequeue()
+      dequeue_many = local_queue.dequeue_many(len(works) * num_epochs)
+
+      resources.initialize_resources(resources.shared_resources()).run()
+      variables.global_variables_initializer().run()
+      variables.local_variables_initializer().run()
+      threads = queue_runner_impl.start_queue_runners()
+
+      local_works = dequeue_many.eval().tolist()
+      self.assertEqual(
+          sorted(works * num_epochs),
+          sorted([item for work in local_works for item in work]))
+
+      # Reached the limit.
+      with self.assertRaises(errors_impl.OutOfRangeError):
+        dequeue.eval()
+      for thread in threads:
+        thread.join()
+
   def test_slices(self):
     with self.test_session():
       works = [
@@ -140,6 +169,27 @@ class WorkQueueTest(test_lib.TestCase):
       for thread in threads:
         thread.join()
 
+  def test_elastic_release(self):
+    with self.test_session():
+      works = [b"to", b"be", b"or", b"not"]
+      work_queue = WorkQueue(
+          works, shuffle=False, num_prefetches=1, elastic=True)
+      take = work_queue.take()
+      release = work_queue.release()
+      # Another worker taking the works.
+      other_take = gen_work_queue_ops.work_queue_take(work_queue._handle)
+
+      resources.initialize_resources(resources.shared_resources()).run()
+      self.assertEqual([b"to", b"be", b"or"], [take.eval() for _ in range(3)])
+      # The last num_prefetches + 1 works are put back.
+      self.assertEqual(2, release.eval())
+      with self.assertRaises(errors_impl.OutOfRangeError):
+        take.eval()
+      self.assertEqual(
+          [b"be", b"or", b"not"], [other_take.eval() for _ in range(3)])
+      with self.assertRaises(errors_impl.OutOfRangeError):
+        other_take.eval()
+
   def test_monitored_session(self):
     ps_hosts = ["localhost:{}".format(portpicker.pick_unused_port())]
     worker_hosts = ["localhost:{}".format(portpicker.pick_unused_port())]
@@ -472,6 +522,46 @@ class WorkQueueTest(test_lib.TestCase):
     with self.assertRaises(errors_impl.OutOfRangeError):
       sess[0].run(train_ops[0])
 
+  def test_resume_work_at_offset_for_inference_job(self):
+    def _run(train_op, sess, result):
+      while True:
+        try:
+          result.append(sess.run(train_op))
+        except errors_impl.OutOfRangeError:
+          break
+    num_ps = 1
+    num_workers = 1
+    workers, _ = test_util.create_local_cluster(
+        num_workers=num_workers, num_ps=num_ps)
+    restore_work = b"hdfs://tproject/tables/ttable?start=0&end=4"
+    processed_work = b"hdfs://tproject/tables/ttable?start=4&end=8"
+    works = [b"hdfs://tproject/tables/ttable?start=8&end=12"]
+    restore_works_dir = '/tmp/workqueue_test_{}'.format(random.randint(50, 70))
+    os.system('mkdir -p {}/worker_0'.format(restore_works_dir))
+    os.system('echo \"{}\" > {}/worker_0/start_0_end_4'.format(
+        restore_work.decode(), restore_works_dir))
+    os.system('echo 3 > {}/worker_0/start_0_end_4.offset'.format(
+        restore_works_dir))
+    os.system('echo \"{}\" > {}/worker_0/start_4_end_8'.format(
+        processed_work.decode(), restore_works_dir))
+    os.system('echo 4 > {}/worker_0/start_4_end_8.offset'.format(
+        restore_works_dir))
+    sess, _, train_ops = self._get_workers(
+        num_workers, workers, works, num_epochs=1,
+        shuffle=False, restore_works_dir=restore_works_dir)
+    manager = Manager()
+    result = manager.list()
+    thread = \
+        self.checkedThread(target=_run, args=(train_ops[0], sess[0], result))
+    thread.start()
+    thread.join()
+    os.system('rm -rf {}'.format(restore_works_dir))
+
+    result = [
+        w.encode() if isinstance(w, string_types) else w for w in result]
+    self.assertEqual(
+        [b"hdfs://tproject/tables/ttable?start=3&end=4"] + works, list(result))
+
   def test_restore_work_with_prefix_for_inference_job(self):
     def _run(train_op, sess, result):
       while True:
@@ -230,6 +230,38 @@ def audio(name, tensor, sample_rate, max_outputs=3, collections=None,
   return val
 
 
+@tf_export(v1=['summary.input_stall'])
+def input_stall(name, collections=None, family=None):
+  """Outputs a `Summary` protocol buffer with the waits of input pipelines.
+
+  For every input pipeline stage of the process, i.e. prefetch datasets,
+  `TensorBuffer`, `StagingArea`, `MapStagingArea` and `WorkQueue` resources,
+  the summary holds the total time in seconds its producers waited for room,
+  tagged `<name>/<stage>/producer_wait_seconds`, and its consumers waited for
+  elements, tagged `<name>/<stage>/consumer_wait_seconds`. The consumers of
+  the bottleneck stage wait the most. The waits of ops in a step also show
+  in its `RunMetadata` step stats as `<op name>/producer_wait` and
+  `<op name>/consumer_wait` nodes.
+
+  Args:
+    name: A name for the generated node. Will also serve as the prefix of the
+      series names in TensorBoard.
+    collections: Optional list of graph collections keys. The new summary op is
+      added to these collections. Defaults to `[GraphKeys.SUMMARIES]`.
+    family: Optional; if provided, used as the prefix of the summary tag name,
+      which controls the tab name used for display on Tensorboard.
+
+  Returns:
+    A scalar `Tensor` of type `string`. Which contains a `Summary` protobuf.
+  """
+  if _distribute_summary_op_util.skip_summary():
+    return _constant_op.constant('')
+  with _summary_op_util.summary_scope(name, family) as (tag, scope):
+    val = _gen_logging_ops.input_stall_summary(tag=tag, name=scope)
+    _summary_op_util.collect(val, collections, [_ops.GraphKeys.SUMMARIES])
+  return val
+
+
 @tf_export(v1=['summary.text'])
 def text(name, tensor, collections=None):
   """Summarizes textual data.
@@ -32,6 +32,7 @@ from tensorflow.python.framework import meta_graph
 from tensorflow.python.framework import ops
 from tensorflow.python.framework import test_util
 from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import data_flow_ops
 from tensorflow.python.ops import variables
 from tensorflow.python.platform import test
 from tensorflow.python.summary import summary as summary_lib
@@ -205,6 +206,25 @@ class SummaryTest(test.TestCase):
       self.assertEqual(summ.op.type, 'TensorSummaryV2')
 
   @test_util.run_deprecated_v1
+  @test_util.run_deprecated_v1
+  def testInputStallSummary(self):
+    with self.cached_session() as s:
+      area = data_flow_ops.StagingArea(
+          [dtypes.float32], shared_name='input_stall_area')
+      put = area.put([constant_op.constant(1.0)])
+      get = area.get()
+      stall = summary_lib.input_stall('stall')
+      s.run(put)
+      s.run(get)
+      summary_str = s.run(stall)
+    summary = summary_pb2.Summary()
+    summary.ParseFromString(summary_str)
+    values = {v.tag: v.simple_value for v in summary.value}
+    self.assertIn('stall/Stage/input_stall_area/producer_wait_seconds', values)
+    self.assertIn('stall/Stage/input_stall_area/consumer_wait_seconds', values)
+    self.assertGreaterEqual(
+        values['stall/Stage/input_stall_area/consumer_wait_seconds'], 0.0)
+
   def testSummaryNameConversion(self):
     c = constant_op.constant(3)
     s = summary_lib.scalar('name with spaces', c)
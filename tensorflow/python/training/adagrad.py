@@ -18,6 +18,7 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+from tensorflow.python.framework import device as pydev
 from tensorflow.python.framework import ops
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import gen_array_ops
@@ -136,6 +137,35 @@ class AdagradOptimizer(optimizer.Optimizer):
         indices,
         use_locking=self._use_locking)
 
+  def _resource_apply_sparse_scaled(self, grad, var, indices, indices_counts,
+                                    scale):
+    if (not isinstance(var, kv_variable_ops.EmbeddingVariable) or
+        pydev.DeviceSpec.from_string(var.device).device_type == "GPU"):
+      return super(AdagradOptimizer, self)._resource_apply_sparse_scaled(
+          grad, var, indices, indices_counts, scale)
+    acc = self.get_slot(var, "accumulator")
+    global_step = training_util.get_or_create_global_step()
+    if var.need_counts():
+      return training_ops.kv_resource_sparse_apply_adagrad_scaled_with_counts(
+        var.handle,
+        acc.handle,
+        math_ops.cast(self._learning_rate_tensor, grad.dtype),
+        grad,
+        indices,
+        global_step,
+        indices_counts,
+        scale,
+        use_locking=self._use_locking)
+    return training_ops.kv_resource_sparse_apply_adagrad_scaled(
+      var.handle,
+      acc.handle,
+      math_ops.cast(self._learning_rate_tensor, grad.dtype),
+      grad,
+      indices,
+      global_step,
+      scale,
+      use_locking=self._use_locking)
+
   def _resource_apply_sparse(self, grad, var, indices, indices_counts=None):
     acc = self.get_slot(var, "accumulator")
     if isinstance(var, kv_variable_ops.EmbeddingVariable):
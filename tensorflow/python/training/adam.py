@@ -132,8 +132,8 @@ class AdamOptimizer(optimizer.Optimizer):
 
     # Create slots for the first and second moments.
     for v in var_list:
-      self._zeros_slot(v, "m", self._name, slot_config=slot_creator.SlotConfig(slot_index=1, slot_num=2))
-      self._zeros_slot(v, "v", self._name, slot_config=slot_creator.SlotConfig(slot_index=2, slot_num=2))
+      self._zeros_slot(v, "m", self._name, slot_config=slot_creator.SlotConfig(slot_index=1, slot_num=2, int8_state=True))
+      self._zeros_slot(v, "v", self._name, slot_config=slot_creator.SlotConfig(slot_index=2, slot_num=2, int8_state=True))
 
   def _prepare(self):
     lr = self._call_if_callable(self._lr)
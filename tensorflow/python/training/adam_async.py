@@ -122,8 +122,8 @@ class AdamAsyncOptimizer(optimizer.Optimizer):
     # Create slots for the moments.
     for v in var_list:
       with ops.colocate_with(v):
-        self._zeros_slot(v, "m", self._name, slot_config=slot_creator.SlotConfig(slot_index=1, slot_num=2))
-        self._zeros_slot(v, "v", self._name, slot_config=slot_creator.SlotConfig(slot_index=2, slot_num=2))
+        self._zeros_slot(v, "m", self._name, slot_config=slot_creator.SlotConfig(slot_index=1, slot_num=2, int8_state=True))
+        self._zeros_slot(v, "v", self._name, slot_config=slot_creator.SlotConfig(slot_index=2, slot_num=2, int8_state=True))
         if isinstance(v, kv_variable_ops.EmbeddingVariable):
           self._get_or_make_slot(v,
               array_ops.expand_dims(
@@ -15,6 +15,7 @@
 # ==============================================================================
 """async embedding stage class"""
 
+from tensorflow.core.framework import attr_value_pb2
 from tensorflow.python.framework import ops
 from tensorflow.python.framework import errors
 from tensorflow.python.platform import tf_logging as logging
@@ -38,17 +39,36 @@ class AsyncEmbeddingStage:
     """ async embedding stage is a helper class to add stage op after embedding
     look up operation, asynchronous embedding lookup and dense compute.
     """
-    def __init__(self, options, checkpoint_dir = None):
+    def __init__(self, options, checkpoint_dir = None, smart_stage_options = None):
         """ create async_embedding stage instance
         Args:
         options: async embedding options.
         checkpoint_dir: path to dump graph.
+        smart_stage_options: SmartStage options, the io stage is added after
+        IteratorGetNext with these options if the graph has no io stage.
         """
         self._threads_num = options.threads_num
         self._capacity = options.capacity
+        self._max_staleness = options.max_staleness
+        if self._max_staleness > 0:
+            # A staged embedding is looked up at most capacity + threads_num
+            # steps before it is consumed.
+            if self._max_staleness < 2:
+                raise ValueError('async embedding max_staleness must >= 2')
+            threads_num = min(self._threads_num, self._max_staleness - 1)
+            capacity = min(self._capacity, self._max_staleness - threads_num)
+            if threads_num != self._threads_num or capacity != self._capacity:
+                logging.warning('async embedding threads num {} and capacity {} '
+                                'are reduced to {} and {} for max staleness {}'.format(
+                                    self._threads_num, self._capacity,
+                                    threads_num, capacity, self._max_staleness))
+            self._threads_num = threads_num
+            self._capacity = capacity
+        self._smart_stage_options = smart_stage_options
         self._checkpoint_dir = checkpoint_dir if checkpoint_dir else ""
         self._use_stage_subgraph_thread_pool = options.use_stage_subgraph_thread_pool
         self._stage_subgraph_thread_pool_id = options.stage_subgraph_thread_pool_id
+        self._use_pinned_memory = options.use_pinned_memory
         self._control_flow_ops = ['Switch', '_SwitchN', 'Merge', '_XlaMerge',
                                   'Enter', 'Exit']
         self._variable_ops = ['Variable', 'VariableV2', 'VarHandleOp',
@@ -79,6 +99,7 @@ class AsyncEmbeddingStage:
         logging.info('async embedding capacity: ' + str(self._capacity))
 
         self._save_graph(graph, "graph_before_async_embedding")
+        self._stage_io(graph)
         self._find_start_node(graph)
         self._mark_nodes_status()
         self._pick_stage_nodes()
@@ -97,6 +118,52 @@ class AsyncEmbeddingStage:
                                                  "{}.pbtxt".format(name))
             logging.info("write path is {}".format(out_path))
 
+    def _stage_io(self, graph):
+        """ add the io stage after IteratorGetNext if the graph has none, so
+        that SmartStage places the io stage and the embedding stage is placed
+        after the embedding lookups, both with their own depth.
+        """
+        if self._smart_stage_options is None:
+            return
+        get_next_nodes = []
+        for node in graph.get_operations():
+            if node.type == 'TensorBufferTake':
+                return
+            if node.type == 'IteratorGetNext':
+                get_next_nodes.append(node)
+        if len(get_next_nodes) != 1:
+            logging.warning('async embedding: {} IteratorGetNext nodes found, '
+                            'io stage is not added'.format(len(get_next_nodes)))
+            return
+
+        options = self._smart_stage_options
+        name = options.name or prefetch.PREFETCH
+        capacity = options.stage_depths.get(name, options.capacity)
+        get_next_node = get_next_nodes[0]
+        consumers = {}
+        for output in get_next_node.outputs:
+            consumers[output] = list(output.consumers())
+        with graph.as_default(), ops.colocate_with(get_next_node):
+            staged_outputs = prefetch.staged(
+                list(get_next_node.outputs),
+                capacity=max(capacity, 1),
+                num_threads=max(options.num_threads, 1),
+                num_clients=max(options.num_clients, 1),
+                timeout_millis=options.timeout_millis or 300000,
+                closed_exception_types=(errors.OUT_OF_RANGE,),
+                use_stage_subgraph_thread_pool=
+                    options.runner_options.run_options.use_stage_subgraph_thread_pool,
+                stage_subgraph_thread_pool_id=
+                    options.runner_options.run_options.stage_subgraph_thread_pool_id,
+                use_pinned_memory=options.use_pinned_memory,
+                name=name)
+        for output, staged_output in zip(get_next_node.outputs, staged_outputs):
+            for consumer in consumers[output]:
+                for input_id in self._get_input_ids(consumer, output):
+                    consumer._update_input(input_id, staged_output)
+        logging.info('async embedding: io stage {} is added after {}'.format(
+            name, get_next_node.name))
+
     def _is_control_flow_op(self, node):
         node_type = node.type
         for control_flow_node_type in self._control_flow_ops:
@@ -253,7 +320,10 @@ class AsyncEmbeddingStage:
             stage_outputs[stage_node.name] = stage_node_outputs
             stage_outputs_consumers[stage_node.name] = stage_node_outputs_consumers
 
-        with ops.colocate_with(list(self._stage_nodes.keys())[0]):
+        # SmartStage leaves the embedding stage as it is.
+        with ops.colocate_with(list(self._stage_nodes.keys())[0]), \
+             ops.get_default_graph()._attr_scope(
+                 {'_async_embedding_stage': attr_value_pb2.AttrValue(b=True)}):
             stage_output_result = \
                 prefetch.staged(stage_outputs,
                                 num_threads=self._threads_num,
@@ -261,7 +331,8 @@ class AsyncEmbeddingStage:
                                 timeout_millis=1000*60*60*3,
                                 closed_exception_types= (errors.OUT_OF_RANGE,),
                                 use_stage_subgraph_thread_pool = self._use_stage_subgraph_thread_pool,
-                                stage_subgraph_thread_pool_id = self._stage_subgraph_thread_pool_id)
+                                stage_subgraph_thread_pool_id = self._stage_subgraph_thread_pool_id,
+                                use_pinned_memory = self._use_pinned_memory)
 
         need_update_ops = []
         stage_op_parsed = False
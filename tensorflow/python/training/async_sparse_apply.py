@@ -0,0 +1,220 @@
+# Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Applies the sparse gradients of EmbeddingVariables in the background."""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+from tensorflow.core.protobuf import config_pb2
+from tensorflow.python import pywrap_tensorflow as prefetch_runner
+from tensorflow.python.framework import constant_op
+from tensorflow.python.framework import ops
+from tensorflow.python.ops import control_flow_ops
+from tensorflow.python.ops import gen_tensor_buffer_ops
+from tensorflow.python.ops import kv_variable_ops
+from tensorflow.python.ops import prefetch
+from tensorflow.python.ops import state_ops
+from tensorflow.python.platform import tf_logging as logging
+from tensorflow.python.training import optimizer
+from tensorflow.python.training import sparse_grad_clip
+from tensorflow.python.util.tf_export import tf_export
+
+
+@tf_export(v1=["train.AsyncSparseApplyOptimizer"])
+class AsyncSparseApplyOptimizer(optimizer.Optimizer):
+  """Applies the gradients of the EmbeddingVariables while the next steps run.
+
+  For hybrid training, with the EmbeddingVariables on the CPU and the dense
+  layers on the GPU. A step applies the dense gradients, and puts the sparse
+  gradients of the EmbeddingVariables to a buffer on the CPU, which prefetch
+  runner threads take and apply with `sparse_opt` while the next steps run
+  on the GPU. A step waits while the buffer is full, so the gradients of a
+  step are applied at most `max_staleness` steps later.
+
+  With `do_async_embedding` and its `use_pinned_memory`, the lookups of the
+  next steps run on the CPU too, and their embeddings are copied to pinned
+  memory for the GPU, while a step runs.
+
+  The runners are started by the hook of `tf.make_prefetch_hook()`. The
+  gradients not applied yet when the runners stop are dropped.
+  """
+
+  def __init__(self,
+               opt,
+               sparse_opt=None,
+               max_staleness=2,
+               num_threads=1,
+               timeout_millis=300000,
+               name="AsyncSparseApply"):
+    """Constructs an AsyncSparseApplyOptimizer.
+
+    Args:
+      opt: The `Optimizer` of the dense gradients.
+      sparse_opt: (Optional.) The `Optimizer` of the gradients of the
+        EmbeddingVariables, `opt` by default. Use another one when `opt`
+        keeps non-slot state updated once per `apply_gradients`, such as the
+        beta powers of `AdamOptimizer`.
+      max_staleness: The max number of steps the gradients of a step are
+        applied after it, must >= 2. `num_threads` is reduced to meet it.
+      num_threads: The number of threads applying the sparse gradients.
+      timeout_millis: Max milliseconds a step waits for the buffer.
+      name: Name of the optimizer.
+
+    Raises:
+      ValueError: If `max_staleness` is less than 2.
+    """
+    super(AsyncSparseApplyOptimizer, self).__init__(False, name)
+    if max_staleness < 2:
+      raise ValueError("max_staleness must >= 2, not {}".format(max_staleness))
+    # The gradients of a step wait in the buffer for at most capacity steps,
+    # and are applied by one of the threads in the next num_threads steps.
+    self._opt = opt
+    self._sparse_opt = sparse_opt or opt
+    self._num_threads = max(1, min(num_threads, max_staleness - 1))
+    self._capacity = max_staleness - self._num_threads
+    self._timeout_millis = timeout_millis
+    if self._num_threads != num_threads:
+      logging.warning("async sparse apply threads num {} is reduced to {} for "
+                      "max staleness {}".format(num_threads, self._num_threads,
+                                                max_staleness))
+
+  def compute_gradients(self, *args, **kwargs):
+    return self._opt.compute_gradients(*args, **kwargs)
+
+  def apply_gradients(self, grads_and_vars, global_step=None, name=None):
+    """Applies the dense gradients, and stages the sparse ones.
+
+    Args:
+      grads_and_vars: List of (gradient, variable) pairs as returned by
+        `compute_gradients()`.
+      global_step: Optional `Variable` to increment by one after the
+        dense variables have been updated.
+      name: Optional name for the returned operation.
+
+    Returns:
+      An `Operation` that applies the dense gradients and puts the sparse
+      gradients to the buffer.
+    """
+    grads_and_vars = tuple(grads_and_vars)
+    sparse_grads_and_vars = []
+    dense_grads_and_vars = []
+    for grad, var in grads_and_vars:
+      if (isinstance(grad, ops.IndexedSlices) and
+          isinstance(var, kv_variable_ops.EmbeddingVariable)):
+        sparse_grads_and_vars.append((grad, var))
+      else:
+        dense_grads_and_vars.append((grad, var))
+    if not sparse_grads_and_vars:
+      return self._opt.apply_gradients(grads_and_vars, global_step, name)
+
+    graph = ops.get_default_graph()
+    buffer_name = graph.unique_name(self._name + "/sparse_grads")
+    tensors = []
+    for grad, _ in sparse_grads_and_vars:
+      tensors.extend([grad.values, grad.indices])
+      if isinstance(grad, sparse_grad_clip.ScaledIndexedSlices):
+        tensors.extend([grad.indices_counts, grad.scale])
+    with ops.name_scope(name, self._name) as scope:
+      with ops.device("/device:CPU:0"):
+        put = gen_tensor_buffer_ops.tensor_buffer_put(
+            tensors,
+            timeout_millis=self._timeout_millis,
+            shared_name=buffer_name,
+            shared_capacity=self._capacity)
+        cancel = gen_tensor_buffer_ops.tensor_buffer_cancel(
+            shared_name=buffer_name,
+            shared_capacity=self._capacity)
+        resume = gen_tensor_buffer_ops.tensor_buffer_cancel(
+            is_cancelled=False,
+            shared_name=buffer_name,
+            shared_capacity=self._capacity)
+        close = gen_tensor_buffer_ops.tensor_buffer_close(
+            shared_name=buffer_name,
+            shared_capacity=self._capacity)
+        taken = gen_tensor_buffer_ops.tensor_buffer_take(
+            dtypes=[t.dtype for t in tensors],
+            shared_name=buffer_name,
+            shared_capacity=self._capacity,
+            shared_threads=self._num_threads)
+        if not isinstance(taken, (tuple, list)):
+          taken = [taken]
+
+      staged_grads_and_vars = []
+      taken = list(taken)
+      for grad, var in sparse_grads_and_vars:
+        values, indices = taken.pop(0), taken.pop(0)
+        values.set_shape(grad.values.shape)
+        indices.set_shape(grad.indices.shape)
+        if isinstance(grad, sparse_grad_clip.ScaledIndexedSlices):
+          counts, scale = taken.pop(0), taken.pop(0)
+          counts.set_shape(grad.indices_counts.shape)
+          scale.set_shape([])
+          staged_grad = sparse_grad_clip.ScaledIndexedSlices(
+              values, indices, grad.dense_shape, counts, scale)
+        else:
+          staged_grad = ops.IndexedSlices(values, indices, grad.dense_shape)
+        staged_grads_and_vars.append((staged_grad, var))
+      # The counts of the lookups of the step are not staged, the applies
+      # count the staged indices instead.
+      counts_tensors = [v._counts_tensor for _, v in sparse_grads_and_vars]  # pylint: disable=protected-access
+      for _, var in sparse_grads_and_vars:
+        var._counts_tensor = None  # pylint: disable=protected-access
+      try:
+        sparse_update = self._sparse_opt.apply_gradients(
+            staged_grads_and_vars, name="sparse_apply")
+      finally:
+        for (_, var), counts in zip(sparse_grads_and_vars, counts_tensors):
+          var._counts_tensor = counts  # pylint: disable=protected-access
+      with ops.control_dependencies([sparse_update]):
+        applied = constant_op.constant(True, name="applied")
+
+      updates = [put]
+      if any(g is not None for g, _ in dense_grads_and_vars):
+        updates.append(self._opt.apply_gradients(
+            dense_grads_and_vars, global_step=global_step))
+      elif global_step is not None:
+        with ops.colocate_with(global_step):
+          updates.append(state_ops.assign_add(global_step, 1))
+      update = control_flow_ops.group(*updates, name=scope)
+
+    runner_options = config_pb2.PrefetchRunnerOptions()
+    prefetch.fill_prefetch_runner_options(
+        runner_options, [applied] * self._num_threads, cancel, resume, close)
+    prefetch_runner.TF_RegisterPrefetchRunner(
+        graph._graph_key, buffer_name + "_prefetch_runner", runner_options)  # pylint: disable=protected-access
+    logging.info("{} sparse gradients are applied asynchronously by {} threads "
+                 "with capacity {}.".format(len(sparse_grads_and_vars),
+                                            self._num_threads, self._capacity))
+    return update
+
+  def get_slot(self, *args, **kwargs):
+    slot = self._sparse_opt.get_slot(*args, **kwargs)
+    if slot is None and self._sparse_opt is not self._opt:
+      slot = self._opt.get_slot(*args, **kwargs)
+    return slot
+
+  def get_slot_names(self, *args, **kwargs):
+    names = self._opt.get_slot_names(*args, **kwargs)
+    if self._sparse_opt is not self._opt:
+      names = sorted(set(names) | set(
+          self._sparse_opt.get_slot_names(*args, **kwargs)))
+    return names
+
+  def variables(self):
+    opt_variables = self._opt.variables()
+    if self._sparse_opt is not self._opt:
+      opt_variables += self._sparse_opt.variables()
+    return opt_variables
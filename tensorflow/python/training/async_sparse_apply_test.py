@@ -0,0 +1,82 @@
+# Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Functional tests for async sparse apply."""
+
+from tensorflow.python.framework import constant_op
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import ops
+from tensorflow.python.ops import embedding_ops
+from tensorflow.python.ops import init_ops
+from tensorflow.python.ops import math_ops
+from tensorflow.python.ops import prefetch
+from tensorflow.python.ops import variable_scope
+from tensorflow.python.ops import variables
+from tensorflow.python.platform import test
+from tensorflow.python.training import adagrad
+from tensorflow.python.training import async_sparse_apply
+from tensorflow.python.training import coordinator
+from tensorflow.python.training import training_util
+
+
+class AsyncSparseApplyTest(test.TestCase):
+  def _build(self, max_staleness, num_threads):
+    emb_var = variable_scope.get_embedding_variable(
+        "var_1",
+        embedding_dim=3,
+        initializer=init_ops.ones_initializer(dtypes.float32))
+    dense_var = variable_scope.get_variable(
+        "var_2", shape=[3, 1],
+        initializer=init_ops.ones_initializer(dtypes.float32))
+    ids = constant_op.constant([0, 1, 2, 1], dtype=dtypes.int64)
+    emb = embedding_ops.embedding_lookup(emb_var, ids)
+    loss = math_ops.reduce_sum(math_ops.matmul(emb, dense_var))
+    global_step = training_util.get_or_create_global_step()
+    opt = async_sparse_apply.AsyncSparseApplyOptimizer(
+        adagrad.AdagradOptimizer(0.1),
+        max_staleness=max_staleness, num_threads=num_threads)
+    train_op = opt.minimize(loss, global_step=global_step)
+    return opt, dense_var, global_step, train_op
+
+  def testStageSparseGradients(self):
+    with ops.Graph().as_default() as graph, ops.device("/cpu:0"):
+      opt, dense_var, global_step, train_op = self._build(2, 1)
+      self.assertEqual(opt._num_threads, 1)
+      self.assertEqual(opt._capacity, 1)
+      op_types = [node.type for node in graph.get_operations()]
+      self.assertEqual(op_types.count("TensorBufferPut"), 1)
+      self.assertEqual(op_types.count("TensorBufferTake"), 1)
+
+      with self.test_session(graph=graph) as sess:
+        sess.run(variables.global_variables_initializer())
+        coord = coordinator.Coordinator()
+        prefetch.make_prefetch_hook().after_create_session(sess, coord)
+        for _ in range(3):
+          sess.run(train_op)
+        self.assertEqual(sess.run(global_step), 3)
+        self.assertTrue((sess.run(dense_var) < 1.0).all())
+        coord.request_stop()
+
+  def testMaxStaleness(self):
+    with ops.Graph().as_default(), ops.device("/cpu:0"):
+      opt, _, _, _ = self._build(4, 8)
+      self.assertEqual(opt._num_threads, 3)
+      self.assertEqual(opt._capacity, 1)
+    with self.assertRaises(ValueError):
+      async_sparse_apply.AsyncSparseApplyOptimizer(
+          adagrad.AdagradOptimizer(0.1), max_staleness=1)
+
+
+if __name__ == "__main__":
+  test.main()
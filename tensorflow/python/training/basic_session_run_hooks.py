@@ -619,6 +619,11 @@ class CheckpointSaverHook(session_run_hook.SessionRunHook):
     last_step = session.run(self._global_step_tensor)
     if last_step != self._timer.last_triggered_step():
       self._save(session, last_step)
+    # The session must outlive the write of an async save.
+    wait_for_async_save = getattr(self._get_saver(), "wait_for_async_save",
+                                  None)
+    if wait_for_async_save is not None:
+      wait_for_async_save()
     for l in self._listeners:
       l.end(session, last_step)
 
@@ -188,6 +188,7 @@ class Scaffold(object):
     self._enable_async_embedding = False
     self._async_embedding_checkpoint_dir = None
     self._async_embedding_options = None
+    self._smart_stage_options = None
 
   def finalize(self):
     """Creates operations if needed and finalizes the graph."""
@@ -249,7 +250,8 @@ class Scaffold(object):
     if self._enable_async_embedding:
       async_embedding_stage = async_embedding.AsyncEmbeddingStage(
         self._async_embedding_options,
-        self._async_embedding_checkpoint_dir)
+        self._async_embedding_checkpoint_dir,
+        self._smart_stage_options)
       async_embedding_stage.stage(ops.get_default_graph())
 
     ops.get_default_graph().finalize()
@@ -267,6 +269,9 @@ class Scaffold(object):
   def set_async_embedding_options(self, value):
       self._async_embedding_options = value
 
+  def set_smart_stage_options(self, value):
+      self._smart_stage_options = value
+
   @property
   def init_fn(self):
     return self._init_fn
@@ -582,6 +587,8 @@ def MonitoredTrainingSession(
     optimizer_options = config.graph_options.optimizer_options
     scaffold.set_enable_async_embedding(optimizer_options.do_async_embedding)
     scaffold.set_async_embedding_options(optimizer_options.async_embedding_options)
+    if optimizer_options.do_smart_stage:
+      scaffold.set_smart_stage_options(optimizer_options.smart_stage_options)
   scaffold.set_async_embedding_checkpoint_dir(checkpoint_dir)
 
   if worker_context:
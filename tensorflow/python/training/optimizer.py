@@ -179,6 +179,10 @@ class _DenseResourceVariableProcessor(_OptimizableVariable):
       if self._v.constraint is not None:
         raise RuntimeError(
             "Cannot use a constraint function on a sparse variable.")
+      from tensorflow.python.training import sparse_grad_clip
+      if isinstance(g, sparse_grad_clip.ScaledIndexedSlices):
+        return optimizer._resource_apply_sparse_scaled(
+            g.values, self._v, g.indices, g.indices_counts, g.scale)
       return optimizer._resource_apply_sparse_duplicate_indices(
           g.values, self._v, g.indices)
     update_op = optimizer._resource_apply_dense(g, self._v)
@@ -567,11 +571,21 @@ class Optimizer(
     if not var_list:
       raise ValueError("No variables to optimize.")
     var_refs = [p.target() for p in processors]
+    # pylint: disable=protected-access
+    var_ids = set(id(v) for v in var_list)
+    hot_rows = [h for h in ops.get_collection(ops.GraphKeys._EV_HOT_ROWS)
+                if id(h.var) in var_ids]
+    # pylint: enable=protected-access
     grads = gradients.gradients(
-        loss, var_refs, grad_ys=grad_loss,
+        loss, var_refs + [h.rows for h in hot_rows], grad_ys=grad_loss,
         gate_gradients=(gate_gradients == Optimizer.GATE_OP),
         aggregation_method=aggregation_method,
         colocate_gradients_with_ops=colocate_gradients_with_ops)
+    if hot_rows:
+      from tensorflow.python.ops import kv_variable_ops
+      grads = [g for g, _ in kv_variable_ops.merge_hot_row_gradients(
+          list(zip(grads[:len(var_list)], var_list)),
+          list(zip(grads[len(var_list):], hot_rows)))]
     if self.doing_loss_scaling():
       grads = self._unscale_grads(grads)
     if gate_gradients == Optimizer.GATE_GRAPH:
@@ -1106,6 +1120,34 @@ class Optimizer(
       return self._resource_apply_sparse(
           summed_grad, handle, unique_indices)
 
+  def _resource_apply_sparse_scaled(self, grad, handle, indices,
+                                    indices_counts, scale):
+    """Add ops to apply sparse gradients of unique indices scaled by `scale`.
+
+    The gradients clipped by `fused_clip_by_global_norm` are applied by this
+    method. By default `grad` is scaled and passed on to
+    `_resource_apply_sparse`. Optimizers with kernels that scale the gradients
+    while applying them may override it to save that pass.
+
+    Args:
+      grad: a `Tensor` representing the gradient for the affected indices.
+      handle: a `Tensor` of dtype `resource` which points to the variable
+       to be updated.
+      indices: a `Tensor` of integral type representing the indices for
+       which the gradient is nonzero. Indices are unique.
+      indices_counts: a `Tensor` of int64 representing the count of each
+       index in `indices` before deduplication.
+      scale: a scalar `Tensor` of the dtype of `grad`.
+
+    Returns:
+      An `Operation` which updates the value of the variable.
+    """
+    from tensorflow.python.ops import kv_variable_ops
+    if isinstance(handle, kv_variable_ops.EmbeddingVariable) and handle.need_counts():
+      return self._resource_apply_sparse(
+          grad * scale, handle, indices, indices_counts)
+    return self._resource_apply_sparse(grad * scale, handle, indices)
+
   def _resource_apply_sparse(self, grad, handle, indices, indices_count=None):
     """Add ops to apply sparse gradients to the variable `handle`.
 
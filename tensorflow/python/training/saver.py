@@ -25,6 +25,7 @@ from __future__ import print_function
 
 import collections
 import os.path
+import threading
 import time
 import uuid
 
@@ -43,6 +44,7 @@ from tensorflow.python.framework import meta_graph
 from tensorflow.python.framework import ops
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import control_flow_ops
+from tensorflow.python.ops import gen_array_ops
 from tensorflow.python.ops import gen_io_ops
 from tensorflow.python.ops import gen_kv_variable_ops
 from tensorflow.python.ops import io_ops
@@ -172,11 +174,14 @@ class BaseSaverBuilder(object):
   def __init__(self,
                write_version=saver_pb2.SaverDef.V2,
                build_incr_activateop = False,
-               incremental_include_normal_var = False):
+               incremental_include_normal_var = False,
+               snapshot_tensors = False):
     self._write_version = write_version
     self._build_incr_activateop = build_incr_activateop
     # if incremental_include_normal_var set False, don't save normal-Variable in incr ckpt
     self._incremental_include_normal_var = incremental_include_normal_var
+    # if snapshot_tensors set True, copy the dense tensors before saving them
+    self._snapshot_tensors = snapshot_tensors
 
   def _GetTensorNameAndIsSparse(self, spec, saveable):
     # if-else BRANCH   single-EV    part-EV    single-normal    part-normal
@@ -234,8 +239,14 @@ class BaseSaverBuilder(object):
         ev_key_types.append(saveable.key_type)
         continue
       for spec in saveable.specs:
+        tensor = spec.tensor
+        if self._snapshot_tensors:
+          # The write of an async save overlaps the next training steps, so
+          # it must not see their updates.
+          with ops.device(tensor.device):
+            tensor = gen_array_ops.snapshot(tensor)
         tensor_names.append(spec.name)
-        tensors.append(spec.tensor)
+        tensors.append(tensor)
         tensor_slices.append(spec.slice_spec)
     if self._write_version == saver_pb2.SaverDef.V1:
       return io_ops._save(
@@ -899,7 +910,8 @@ class Saver(object):
                save_relative_paths=False,
                filename=None,
                incremental_save_restore=False,
-               incremental_include_normal_var=False):
+               incremental_include_normal_var=False,
+               async_save=False):
     """Creates a `Saver`.
 
     The constructor adds ops to save and restore variables.
@@ -978,6 +990,12 @@ class Saver(object):
         checkpoint directory and reload from the copied directory.
       filename: If known at graph construction time, filename used for variable
         loading/saving.
+      async_save: If `True`, `save()` runs the save ops in a background thread
+        and returns, so training goes on while the checkpoint is written. The
+        dense variables are copied first. Only for V2 checkpoints in graph
+        mode. A checkpoint is listed in the checkpoint state file once all its
+        files are written. `save()` waits for the previous async save, so at
+        most one checkpoint is in flight.
 
     Raises:
       TypeError: If `var_list` is invalid.
@@ -1029,6 +1047,10 @@ class Saver(object):
     self._checkpoints_to_be_deleted = []
     self._incremental_save_restore = incremental_save_restore
     self._incremental_include_normal_var = incremental_include_normal_var
+    self._async_save = (async_save and not context.executing_eagerly() and
+                        write_version == saver_pb2.SaverDef.V2)
+    self._async_save_thread = None
+    self._async_save_error = None
     if context.executing_eagerly():
       self._next_checkpoint_time = (
           time.time() + self._keep_checkpoint_every_n_hours * 3600)
@@ -1061,7 +1083,8 @@ class Saver(object):
     if not self.saver_def or context.executing_eagerly():
       if self._builder is None:
         self._builder = BulkSaverBuilder(self._write_version, self._incremental_save_restore,
-                                         self._incremental_include_normal_var)
+                                         self._incremental_include_normal_var,
+                                         snapshot_tensors=self._async_save)
 
       if self._var_list is None:
         # pylint: disable=protected-access
@@ -1410,34 +1433,21 @@ class Saver(object):
         not isinstance(sess, session.SessionInterface)):
       raise TypeError("'sess' must be a Session; %s" % sess)
 
-    save_path_parent = os.path.dirname(save_path)
     if not self._is_empty:
-      try:
-        if context.executing_eagerly():
-          self._build_eager(
-              checkpoint_file, build_save=True, build_restore=False)
-          model_checkpoint_path = self.saver_def.save_tensor_name
-        else:
-          model_checkpoint_path = sess.run(
-              self.saver_def.save_tensor_name,
-              {self.saver_def.filename_tensor_name: checkpoint_file})
-
-        model_checkpoint_path = compat.as_str(model_checkpoint_path)
-        if write_state:
-          self._RecordLastCheckpoint(model_checkpoint_path)
-          checkpoint_management.update_checkpoint_state_internal(
-              save_dir=save_path_parent,
-              model_checkpoint_path=model_checkpoint_path,
-              all_model_checkpoint_paths=self.last_checkpoints,
-              latest_filename=latest_filename,
-              save_relative_paths=self._save_relative_paths)
-          self._MaybeDeleteOldCheckpoints(meta_graph_suffix=meta_graph_suffix)
-      except (errors.FailedPreconditionError, errors.NotFoundError) as exc:
-        if not gfile.IsDirectory(save_path_parent):
-          exc = ValueError(
-              "Parent directory of {} doesn't exist, can't save.".format(
-                  save_path))
-        raise exc
+      if self._async_save:
+        # Raises the error of the previous async save, if any.
+        self.wait_for_async_save()
+        model_checkpoint_path = compat.as_str(checkpoint_file)
+        self._async_save_thread = threading.Thread(
+            target=self._async_save_main,
+            args=(sess, checkpoint_file, save_path, latest_filename,
+                  meta_graph_suffix, write_state))
+        self._async_save_thread.daemon = True
+        self._async_save_thread.start()
+      else:
+        model_checkpoint_path = self._save_and_record(
+            sess, checkpoint_file, save_path, latest_filename,
+            meta_graph_suffix, write_state)
 
     if write_meta_graph:
       meta_graph_filename = checkpoint_management.meta_graph_filename(
@@ -1454,6 +1464,59 @@ class Saver(object):
     else:
       return model_checkpoint_path
 
+  def _save_and_record(self, sess, checkpoint_file, save_path,
+                       latest_filename, meta_graph_suffix, write_state):
+    """Runs the save op, then records the checkpoint in the state file."""
+    save_path_parent = os.path.dirname(save_path)
+    try:
+      if context.executing_eagerly():
+        self._build_eager(
+            checkpoint_file, build_save=True, build_restore=False)
+        model_checkpoint_path = self.saver_def.save_tensor_name
+      else:
+        model_checkpoint_path = sess.run(
+            self.saver_def.save_tensor_name,
+            {self.saver_def.filename_tensor_name: checkpoint_file})
+
+      model_checkpoint_path = compat.as_str(model_checkpoint_path)
+      if write_state:
+        self._RecordLastCheckpoint(model_checkpoint_path)
+        checkpoint_management.update_checkpoint_state_internal(
+            save_dir=save_path_parent,
+            model_checkpoint_path=model_checkpoint_path,
+            all_model_checkpoint_paths=self.last_checkpoints,
+            latest_filename=latest_filename,
+            save_relative_paths=self._save_relative_paths)
+        self._MaybeDeleteOldCheckpoints(meta_graph_suffix=meta_graph_suffix)
+    except (errors.FailedPreconditionError, errors.NotFoundError) as exc:
+      if not gfile.IsDirectory(save_path_parent):
+        exc = ValueError(
+            "Parent directory of {} doesn't exist, can't save.".format(
+                save_path))
+      raise exc
+    return model_checkpoint_path
+
+  def _async_save_main(self, sess, checkpoint_file, *args):
+    try:
+      self._save_and_record(sess, checkpoint_file, *args)
+      logging.info("Async save of %s done.", checkpoint_file)
+    except Exception as e:  # pylint: disable=broad-except
+      logging.error("Async save of %s failed: %s", checkpoint_file, e)
+      self._async_save_error = e
+
+  def wait_for_async_save(self):
+    """Waits for the checkpoint written by the last async save, if any.
+
+    Raises:
+      The error of the last async save, if it failed.
+    """
+    if self._async_save_thread is not None:
+      self._async_save_thread.join()
+      self._async_save_thread = None
+    if self._async_save_error is not None:
+      error, self._async_save_error = self._async_save_error, None
+      raise error
+
   def export_meta_graph(self,
                         filename=None,
                         collection_list=None,
@@ -772,6 +772,36 @@ class SaverTest(test.TestCase):
         error_msg_template = "Parent directory of {} doesn't exist, can't save."
         self.assertEqual(error_msg_template.format(save_path), str(exc))
 
+  @test_util.run_deprecated_v1
+  def testAsyncSave(self):
+    save_dir = os.path.join(self.get_temp_dir(), "async_save")
+    save_path = os.path.join(save_dir, "model")
+    v0 = variables.VariableV1(10.0, name="v0")
+    v1 = variables.VariableV1(20.0, name="v1")
+    save = saver_module.Saver({"v0": v0, "v1": v1}, async_save=True)
+    assign = v0.assign(30.0)
+
+    with self.cached_session() as sess:
+      self.evaluate(variables.global_variables_initializer())
+      val = save.save(sess, save_path, global_step=1)
+      self.assertEqual(save_path + "-1", val)
+      save.wait_for_async_save()
+      self.assertEqual(
+          save_path + "-1",
+          checkpoint_management.latest_checkpoint(save_dir))
+      self.evaluate(assign)
+      save.save(sess, save_path, global_step=2)
+      save.wait_for_async_save()
+      self.assertEqual([save_path + "-1", save_path + "-2"],
+                       save.last_checkpoints)
+
+    with self.cached_session() as sess:
+      save.restore(sess, save_path + "-1")
+      self.assertEqual(10.0, self.evaluate(v0))
+      save.restore(sess, save_path + "-2")
+      self.assertEqual(30.0, self.evaluate(v0))
+      self.assertEqual(20.0, self.evaluate(v1))
+
   def testSaveToURI(self):
     # ParseURI functions don't work on Windows yet.
     # TODO(jhseu): Remove this check when it works.
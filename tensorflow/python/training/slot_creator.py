@@ -39,6 +39,8 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+import os
+
 from tensorflow.core.framework import attr_value_pb2
 from tensorflow.core.framework.embedding import config_pb2
 from tensorflow.python.distribute import distribution_strategy_context
@@ -52,15 +54,49 @@ from tensorflow.python.ops import kv_variable_ops
 from tensorflow.python.ops import resource_variable_ops
 from tensorflow.python.ops import variable_scope
 from tensorflow.python.ops import variables
+from tensorflow.python.platform import tf_logging as logging
 from tensorflow.python.training import distribution_strategy_context
+from tensorflow.python.util import compat
 
 class SlotConfig:
   def __init__(self,
                slot_num=1, slot_index=0,
-               slot_type=config_pb2.SlotType.EMBEDDING_VARIABLE):
+               slot_type=config_pb2.SlotType.EMBEDDING_VARIABLE,
+               int8_state=False):
     self.slot_num = slot_num
     self.slot_index = slot_index
     self.slot_type = slot_type
+    # Whether the slot may be an 8-bit optimizer state, when
+    # TF_EV_INT8_OPTIMIZER_STATES is set, see _use_int8_state.
+    self.int8_state = int8_state
+
+def _use_int8_state(primary, slot_config):
+  """Whether the slot of the EmbeddingVariable primary is an 8-bit state.
+
+  The 8-bit states are shorter rows than the primary, which only the light
+  and normal layouts of the single tier storages on CPU allocate, an
+  EmbeddingVariable with no layout gets the normal one.
+  """
+  if not slot_config.int8_state or \
+      os.environ.get("TF_EV_INT8_OPTIMIZER_STATES", "0") != "1":
+    return False
+  cpu_storage_types = [config_pb2.StorageType.DRAM,
+                       config_pb2.StorageType.DRAM_SWISS,
+                       config_pb2.StorageType.DRAM_NUMA]
+  if primary.storage_type == config_pb2.StorageType.DEFAULT and \
+      "GPU" not in primary.device.upper():
+    cpu_storage_types.append(config_pb2.StorageType.DEFAULT)
+  if primary.storage_type not in cpu_storage_types or \
+      primary._layout not in ["", "normal", "light"]:
+    logging.warning("EmbeddingVariable %s keeps full-precision optimizer"
+                    " states, 8-bit ones need a single tier storage on CPU"
+                    " and the light or normal layout.", primary.name)
+    return False
+  if primary._layout == "":
+    primary._init_op._set_attr("layout",
+        attr_value_pb2.AttrValue(s=compat.as_bytes("normal")))
+    primary._layout = "normal"
+  return True
 
 def _is_embedding(v):
   """Returns true if v is something you get from a embedding variable."""
@@ -109,6 +145,7 @@ def _create_slot_var(primary, val, scope, validate_shape, shape, dtype, slot_con
       if slot_config.slot_type is config_pb2.SlotType.EMBEDDING_VARIABLE:
         primary._init_op._set_attr("slot_num", attr_value_pb2.AttrValue(i=slot_config.slot_num))
         primary._slot_num = slot_config.slot_num
+        int8_state = _use_int8_state(primary, slot_config)
         emb_index = primary._emb_index
         if primary.block_num > 1:
           primary = primary._primary
@@ -134,6 +171,9 @@ def _create_slot_var(primary, val, scope, validate_shape, shape, dtype, slot_con
         )
         slot._init_op._set_attr("embedding_variable_type",
             attr_value_pb2.AttrValue(i=config_pb2.EmbeddingVariableType.MUTABLE))
+        if int8_state:
+          slot._init_op._set_attr("int8_state",
+              attr_value_pb2.AttrValue(b=True))
       else:
         slot = variable_scope.get_variable(
           scope,
@@ -35,6 +35,9 @@ def SmartStageOptions(
     use_stage_subgraph_thread_pool=False,
     stage_subgraph_thread_pool_id=0,
     stage_subgraph_stream_id=0,
+    prefetch_embedding=False,
+    stage_depths=None,
+    use_pinned_memory=False,
     graph=None,
     name=None):
   """Generate SmartStageOptions.
@@ -58,6 +61,16 @@ def SmartStageOptions(
       thread pool to use when enable use_stage_subgraph_thread_pool. 0 by default.
     stage_subgraph_stream_id: (Optional.) Specifies which stream to use for the
       Stage subgraph. The default value is 0.
+    prefetch_embedding: (Optional.) Promote the embeddings of the staged ids
+      to the first tier of multi-tier EmbeddingVariables while staging, so
+      that the lookups of the coming steps hit HBM. False by default.
+    stage_depths: (Optional.) A dict from the names of stage subgraphs to
+      the max number of samples to keep in their buffers, which overrides
+      `capacity`. The name of a stage subgraph is `name` of the options, or
+      `name` of `tf.staged`.
+    use_pinned_memory: (Optional.) Copy the staged host tensors to GPU
+      compatible pinned memory in the prefetching threads, so that they are
+      copied to GPU faster. False by default.
     graph: (Optional.) Specify the graph for SmartStage, which is the graph
       passed to the Session.
     name: (Optional.) Name of prefetching operations.
@@ -100,6 +113,15 @@ def SmartStageOptions(
     raise ValueError('stage_subgraph_stream_id >= 0')
   options.stage_subgraph_stream_id = stage_subgraph_stream_id
 
+  options.prefetch_embedding = prefetch_embedding
+
+  for stage_name, depth in (stage_depths or {}).items():
+    if depth < 1:
+      raise ValueError('stage depth of {} must >= 1'.format(stage_name))
+    options.stage_depths[stage_name] = depth
+
+  options.use_pinned_memory = use_pinned_memory
+
   if graph is None:
     graph = ops.get_default_graph()
   options.graph_key = graph._graph_key
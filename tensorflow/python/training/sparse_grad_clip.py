@@ -0,0 +1,131 @@
+# Copyright 2023 The DeepRec Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Global norm clipping fused into the sparse applies of EmbeddingVariables."""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+from tensorflow.python.framework import constant_op
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import ops
+from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import kv_variable_ops
+from tensorflow.python.ops import math_ops
+from tensorflow.python.training import training_ops
+from tensorflow.python.util.tf_export import tf_export
+
+
+class ScaledIndexedSlices(ops.IndexedSlices):
+  """An `IndexedSlices` of unique indices, scaled by `scale` when applied.
+
+  The optimizers apply it without deduplicating its indices again, and pass
+  `scale` to the fused apply kernels, or scale the values first otherwise.
+  """
+
+  def __init__(self, values, indices, dense_shape, indices_counts, scale):
+    super(ScaledIndexedSlices, self).__init__(values, indices, dense_shape)
+    self._indices_counts = indices_counts
+    self._scale = scale
+
+  @property
+  def indices_counts(self):
+    """The number of occurrences of each index before deduplication."""
+    return self._indices_counts
+
+  @property
+  def scale(self):
+    """The scale of the values, a scalar of their dtype."""
+    return self._scale
+
+
+@tf_export(v1=["train.fused_clip_by_global_norm"])
+def fused_clip_by_global_norm(grads_and_vars, clip_norm, name=None):
+  """Clips the gradients by their global norm, like `clip_by_global_norm`.
+
+  The gradients of the EmbeddingVariables are deduplicated by one
+  `KvSparseGradAggregate` each, which computes their norm while it sums the
+  rows of the same ids, and they are returned unscaled as
+  `ScaledIndexedSlices`: the optimizers scale them while applying them, so
+  clipping makes no pass of its own over the sparse gradients. The other
+  gradients are scaled as `clip_by_global_norm` does.
+
+  The norm of the gradient of an EmbeddingVariable is the one of its rows
+  summed by id, i.e. of the gradient of the variable.
+
+  Args:
+    grads_and_vars: List of (gradient, variable) pairs as returned by
+      `compute_gradients()`.
+    clip_norm: A 0-D (scalar) `Tensor` > 0. The clipping ratio.
+    name: A name for the operation (optional).
+
+  Returns:
+    grads_and_vars: The list of clipped (gradient, variable) pairs.
+    global_norm: A 0-D (scalar) `Tensor` representing the global norm.
+  """
+  grads_and_vars = list(grads_and_vars)
+  with ops.name_scope(name, "fused_clip_by_global_norm") as name:
+    squared_norms = []
+    aggregated = []
+    for grad, var in grads_and_vars:
+      if grad is None:
+        aggregated.append(None)
+        continue
+      with ops.colocate_with(grad.values if isinstance(
+          grad, ops.IndexedSlices) else grad):
+        if (isinstance(grad, ops.IndexedSlices) and
+            isinstance(var, kv_variable_ops.EmbeddingVariable)):
+          summed, unique_indices, counts, squared_norm = \
+              training_ops.kv_sparse_grad_aggregate(grad.values, grad.indices)
+          aggregated.append((summed, unique_indices, counts, grad.dense_shape))
+          squared_norms.append(squared_norm)
+        else:
+          values = (grad.values if isinstance(grad, ops.IndexedSlices)
+                    else grad)
+          squared_norms.append(math_ops.cast(
+              math_ops.reduce_sum(math_ops.square(values)), dtypes.float32))
+          aggregated.append(None)
+    if not squared_norms:
+      return grads_and_vars, constant_op.constant(0.0)
+
+    global_norm = math_ops.sqrt(math_ops.add_n(squared_norms),
+                                name="global_norm")
+    clip_norm = math_ops.cast(clip_norm, dtypes.float32)
+    scale_for_finite = clip_norm * math_ops.minimum(
+        1.0 / global_norm, 1.0 / clip_norm)
+    scale = array_ops.where(
+        math_ops.is_finite(global_norm),
+        scale_for_finite,
+        # Return NaN if global_norm is not finite.
+        constant_op.constant(float("nan"), dtype=dtypes.float32))
+
+    clipped = []
+    for (grad, var), agg in zip(grads_and_vars, aggregated):
+      if grad is None:
+        clipped.append((None, var))
+      elif agg is not None:
+        summed, unique_indices, counts, dense_shape = agg
+        clipped.append((ScaledIndexedSlices(
+            summed, unique_indices, dense_shape, counts,
+            math_ops.cast(scale, summed.dtype)), var))
+      elif isinstance(grad, ops.IndexedSlices):
+        with ops.colocate_with(grad.values):
+          clipped.append((ops.IndexedSlices(
+              grad.values * math_ops.cast(scale, grad.dtype), grad.indices,
+              grad.dense_shape), var))
+      else:
+        with ops.colocate_with(grad):
+          clipped.append((grad * math_ops.cast(scale, grad.dtype), var))
+  return clipped, global_norm
@@ -0,0 +1,89 @@
+# Copyright 2023 The DeepRec Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Functional tests for fused sparse gradient clipping."""
+
+from tensorflow.python.framework import constant_op
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import ops
+from tensorflow.python.ops import clip_ops
+from tensorflow.python.ops import embedding_ops
+from tensorflow.python.ops import init_ops
+from tensorflow.python.ops import math_ops
+from tensorflow.python.ops import variable_scope
+from tensorflow.python.ops import variables
+from tensorflow.python.platform import test
+from tensorflow.python.training import adagrad
+from tensorflow.python.training import sparse_grad_clip
+from tensorflow.python.training import training_ops
+
+
+class SparseGradClipTest(test.TestCase):
+  def testSparseGradAggregate(self):
+    with ops.Graph().as_default(), ops.device("/cpu:0"):
+      values = constant_op.constant(
+          [[1.0, 2.0], [3.0, 4.0], [5.0, 6.0]], dtype=dtypes.float32)
+      indices = constant_op.constant([7, 3, 7], dtype=dtypes.int64)
+      summed, unique_indices, counts, squared_norm = \
+          training_ops.kv_sparse_grad_aggregate(values, indices)
+      with self.test_session() as sess:
+        summed, unique_indices, counts, squared_norm = sess.run(
+            [summed, unique_indices, counts, squared_norm])
+      self.assertAllEqual(unique_indices, [7, 3])
+      self.assertAllEqual(counts, [2, 1])
+      self.assertAllClose(summed, [[6.0, 8.0], [3.0, 4.0]])
+      self.assertAllClose(squared_norm, 6.0**2 + 8.0**2 + 3.0**2 + 4.0**2)
+
+  def _train(self, name, fused):
+    emb_var = variable_scope.get_embedding_variable(
+        name + "_emb",
+        embedding_dim=3,
+        initializer=init_ops.ones_initializer(dtypes.float32))
+    dense_var = variable_scope.get_variable(
+        name + "_dense", shape=[3, 1],
+        initializer=init_ops.ones_initializer(dtypes.float32))
+    ids = constant_op.constant([0, 1, 2], dtype=dtypes.int64)
+    emb = embedding_ops.embedding_lookup(emb_var, ids)
+    loss = math_ops.reduce_sum(math_ops.matmul(emb, dense_var))
+    opt = adagrad.AdagradOptimizer(0.1)
+    grads_and_vars = opt.compute_gradients(loss)
+    if fused:
+      grads_and_vars, norm = sparse_grad_clip.fused_clip_by_global_norm(
+          grads_and_vars, 0.5)
+    else:
+      grads, tvars = zip(*grads_and_vars)
+      grads, norm = clip_ops.clip_by_global_norm(grads, 0.5)
+      grads_and_vars = zip(grads, tvars)
+    train_op = opt.apply_gradients(grads_and_vars)
+    emb_out = embedding_ops.embedding_lookup(emb_var, ids)
+    return train_op, norm, emb_out, dense_var
+
+  def testFusedClipByGlobalNorm(self):
+    with ops.Graph().as_default() as graph, ops.device("/cpu:0"):
+      fused = self._train("fused", True)
+      unfused = self._train("unfused", False)
+      op_types = [node.type for node in graph.get_operations()]
+      self.assertEqual(op_types.count("KvSparseGradAggregate"), 1)
+      with self.test_session(graph=graph) as sess:
+        sess.run(variables.global_variables_initializer())
+        for _ in range(3):
+          _, _, fused_norm, unfused_norm = sess.run(
+              [fused[0], unfused[0], fused[1], unfused[1]])
+          self.assertAllClose(fused_norm, unfused_norm)
+        self.assertAllClose(sess.run(fused[2]), sess.run(unfused[2]))
+        self.assertAllClose(sess.run(fused[3]), sess.run(unfused[3]))
+
+
+if __name__ == "__main__":
+  test.main()